@@ -0,0 +1,203 @@
+#!/bin/bash
+
+# Copyright 2026  Kaldi contributors
+# Apache 2.0
+
+# This script benchmarks the decoding programs on a fixed model, graph and
+# data set, so that speed regressions in the decoders can be caught.  Each
+# decoder is run as a single process on the same utterances, with the same
+# beams, and we report, for each: the WER at a fixed LM weight, the
+# real-time factor (wall-clock time / audio length), the peak resident memory,
+# the peak GPU memory held by Kaldi's allocator (for programs that use the
+# GPU), and for online decoding the percentiles of the latency at the end of
+# the utterances.  The results are written to <out-dir>/results.json, as a
+# JSON list with one object per decoder, and printed as a table.
+#
+# The decoders are:
+#   latgen-faster         nnet3-latgen-faster on the features
+#   latgen-faster-batch   nnet3-latgen-faster-batch on the features
+#   online2               online2-wav-nnet3-latgen-faster on the wav data
+#   cuda                  batched-wav-nnet3-cuda on the wav data
+# The last two need the online-decoding directory (see
+# steps/online/nnet3/prepare_online_decoding.sh).
+#
+# E.g., after local/chain/run_tdnn.sh with test_online_decoding=true:
+#  local/chain/benchmark_decode.sh --num-utts 200 \
+#    exp/chain/tree_sp/graph_tgsmall data/dev_clean_2_hires \
+#    exp/chain/tdnn1i_sp exp/chain/tdnn1i_sp/benchmark
+# To compare two builds of Kaldi, run the script with each and compare the
+# results.json files; the numbers are only comparable on the same machine.
+
+# Begin configuration section.
+decoders="latgen-faster latgen-faster-batch online2 cuda"
+num_utts=0            # If >0, use only the first this-many utterances.
+online_dir=           # Default: <nnet-dir>_online
+ivector_dir=          # Default: exp/nnet3/ivectors_<data-dir basename>
+acwt=1.0
+post_decode_acwt=10.0
+lmwt=10               # The LM weight used for the WER, relative to
+                      # post_decode_acwt, as for local/score.sh.
+beam=15.0
+lattice_beam=8.0
+max_active=7000
+frames_per_chunk=140
+num_threads=4         # For latgen-faster-batch.
+use_gpu=yes           # For latgen-faster-batch.
+# End configuration section.
+
+echo "$0 $@"  # Print the command line for logging
+
+[ -f ./path.sh ] && . ./path.sh
+. parse_options.sh || exit 1;
+
+if [ $# -ne 4 ]; then
+  echo "Usage: $0 [options] <graph-dir> <data-dir> <nnet-dir> <out-dir>"
+  echo "e.g.: $0 exp/chain/tree_sp/graph_tgsmall data/dev_clean_2_hires \\"
+  echo "         exp/chain/tdnn1i_sp exp/chain/tdnn1i_sp/benchmark"
+  echo "main options (for others, see top of script file)"
+  echo "  --decoders <list>                  # decoders to run (default: \"$decoders\")"
+  echo "  --num-utts <n>                     # use only the first n utterances"
+  echo "  --online-dir <dir>                 # online-decoding directory"
+  echo "  --ivector-dir <dir>                # online iVectors for the data"
+  exit 1;
+fi
+
+graphdir=$1
+data=$2
+nnet_dir=$3
+dir=$4
+
+[ -z "$online_dir" ] && online_dir=${nnet_dir}_online
+[ -z "$ivector_dir" ] && ivector_dir=exp/nnet3/ivectors_$(basename $data)
+
+for f in $graphdir/HCLG.fst $graphdir/words.txt $data/text $data/wav.scp \
+         $data/feats.scp $data/spk2utt $nnet_dir/final.mdl \
+         $ivector_dir/ivector_online.scp $ivector_dir/ivector_period; do
+  [ ! -f $f ] && echo "$0: no such file $f" && exit 1;
+done
+for decoder in $decoders; do
+  case $decoder in
+    latgen-faster|latgen-faster-batch) ;;
+    online2|cuda)
+      [ ! -f $online_dir/conf/online.conf ] && \
+        echo "$0: no such file $online_dir/conf/online.conf" && exit 1;;
+    *) echo "$0: unknown decoder '$decoder'" && exit 1;;
+  esac
+done
+
+mkdir -p $dir
+if [ $num_utts -gt 0 ]; then
+  utils/subset_data_dir.sh --first $data $num_utts $dir/data || exit 1;
+  data=$dir/data
+fi
+utils/data/get_utt2dur.sh $data || exit 1;
+audio_seconds=$(awk '{x += $2} END{print x}' $data/utt2dur)
+
+if [ -x /usr/bin/time ]; then
+  have_time=true
+else
+  echo "$0: /usr/bin/time not found; not reporting the peak memory."
+  have_time=false
+fi
+
+decoder_opts="--acoustic-scale=$acwt --beam=$beam --lattice-beam=$lattice_beam
+  --max-active=$max_active --word-symbol-table=$graphdir/words.txt"
+ivector_opts="--online-ivectors=scp:$ivector_dir/ivector_online.scp
+  --online-ivector-period=$(cat $ivector_dir/ivector_period)"
+wav_rspecifier="ark,s,cs:wav-copy scp,p:$data/wav.scp ark:- |"
+
+# Sets the array 'cmd' to the command line that runs decoder $1, writing the
+# lattices to $2/lat.1.gz.  We pass --metrics-file to get the GPU memory.
+set_decoder_cmd() {
+  local decoder=$1 d=$2
+  case $decoder in
+    latgen-faster)
+      cmd=(nnet3-latgen-faster $decoder_opts $ivector_opts
+           --frames-per-chunk=$frames_per_chunk --metrics-file=$d/metrics.prom
+           $nnet_dir/final.mdl $graphdir/HCLG.fst scp:$data/feats.scp) ;;
+    latgen-faster-batch)
+      cmd=(nnet3-latgen-faster-batch $decoder_opts $ivector_opts
+           --frames-per-chunk=$frames_per_chunk --num-threads=$num_threads
+           --use-gpu=$use_gpu --metrics-file=$d/metrics.prom
+           $nnet_dir/final.mdl $graphdir/HCLG.fst scp:$data/feats.scp) ;;
+    online2)
+      cmd=(online2-wav-nnet3-latgen-faster $decoder_opts --online=true
+           --do-endpointing=false --config=$online_dir/conf/online.conf
+           --metrics-file=$d/metrics.prom
+           $online_dir/final.mdl $graphdir/HCLG.fst ark:$data/spk2utt
+           "$wav_rspecifier") ;;
+    cuda)
+      cmd=(batched-wav-nnet3-cuda $decoder_opts
+           --config=$online_dir/conf/online.conf
+           --frames-per-chunk=$frames_per_chunk --metrics-file=$d/metrics.prom
+           $online_dir/final.mdl $graphdir/HCLG.fst "$wav_rspecifier") ;;
+  esac
+  cmd+=("ark:|gzip -c >$d/lat.1.gz")
+}
+
+# Prints the value of a metric from $1/metrics.prom, or "null".
+get_metric() {
+  local value=$(awk -v name=$2 '$1 == name {print $2}' $1/metrics.prom 2>/dev/null)
+  [ -z "$value" ] && value=null
+  echo $value
+}
+
+json_results=
+table=$(printf "%-20s %8s %8s %12s %14s %12s" decoder WER RTF peak-RSS-kB \
+  peak-GPU-bytes latency-p90)
+for decoder in $decoders; do
+  d=$dir/$decoder
+  mkdir -p $d
+  rm $d/metrics.prom 2>/dev/null
+  # We write the command to a script, which is also useful for rerunning it.
+  set_decoder_cmd $decoder $d
+  printf "%q " "${cmd[@]}" >$d/run.sh
+  echo >>$d/run.sh
+  echo "$0: running $decoder, see $d/run.sh"
+  if $have_time; then
+    /usr/bin/time -f "%e %M" -o $d/time bash $d/run.sh 2>$d/log \
+      || { echo "$0: $decoder failed, see $d/log"; exit 1; }
+  else
+    start=$(date +%s.%N)
+    bash $d/run.sh 2>$d/log \
+      || { echo "$0: $decoder failed, see $d/log"; exit 1; }
+    echo "$(date +%s.%N) $start" | awk '{print $1 - $2, "null"}' >$d/time
+  fi
+  read wall_seconds peak_rss_kb <$d/time
+  rtf=$(echo $wall_seconds $audio_seconds | awk '{printf("%.4f", $1 / $2)}')
+
+  lattice-best-path \
+    --acoustic-scale=$(echo $post_decode_acwt $lmwt | awk '{print $1 / $2}') \
+    "ark:gunzip -c $d/lat.1.gz|" ark,t:- 2>$d/best_path.log | \
+    utils/int2sym.pl -f 2- $graphdir/words.txt >$d/hyp.txt || exit 1;
+  compute-wer --text --mode=present ark:$data/text ark:$d/hyp.txt \
+    >$d/wer 2>/dev/null || exit 1;
+  wer=$(awk '/%WER/ {print $2}' $d/wer)
+
+  # The latency percentiles are printed by OnlineTimingStats::Print(), as
+  # "Delay percentiles: 50% x, 90% y, 99% z seconds."
+  latency=$(grep 'Delay percentiles' $d/log | \
+    awk '{print $(NF-5), $(NF-3), $(NF-1)}' | tr -d ',')
+  [ -z "$latency" ] && latency="null null null"
+  read latency_p50 latency_p90 latency_p99 <<<"$latency"
+  peak_gpu_bytes=$(get_metric $d kaldi_cuda_cached_bytes)
+
+  result="{\"decoder\": \"$decoder\", \"wer\": $wer, \"rtf\": $rtf"
+  result="$result, \"wall_seconds\": $wall_seconds"
+  result="$result, \"audio_seconds\": $audio_seconds"
+  result="$result, \"peak_rss_kb\": $peak_rss_kb"
+  result="$result, \"peak_gpu_bytes\": $peak_gpu_bytes"
+  result="$result, \"latency_p50\": $latency_p50"
+  result="$result, \"latency_p90\": $latency_p90"
+  result="$result, \"latency_p99\": $latency_p99}"
+  json_results="$json_results${json_results:+,
+ }$result"
+  table="$table
+$(printf "%-20s %8s %8s %12s %14s %12s" $decoder $wer $rtf $peak_rss_kb \
+  $peak_gpu_bytes $latency_p90)"
+done
+
+echo "[$json_results]" >$dir/results.json
+echo "$table"
+echo "$0: wrote $dir/results.json"
+exit 0;
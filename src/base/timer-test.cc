@@ -21,6 +21,8 @@
 #include "base/timer.h"
 #include "base/kaldi-common.h"
 #include "base/kaldi-utils.h"
+#include <sstream>
+#include <thread>
 
 
 namespace kaldi {
@@ -36,10 +38,57 @@ void TimerTest() {
     KALDI_ERR << "Timer fail: waited " << f << " seconds instead of "
               <<  time_secs << " secs.";
 }
+
+static int32 CountOccurrences(const std::string &str,
+                              const std::string &substr) {
+  int32 ans = 0;
+  for (size_t pos = str.find(substr); pos != std::string::npos;
+       pos = str.find(substr, pos + 1))
+    ans++;
+  return ans;
+}
+
+static void RecordTraceSpans(int32 num_spans) {
+  for (int32 i = 0; i < num_spans; i++) {
+    KALDI_TRACE_SCOPE("outer");
+    {
+      KALDI_TRACE_SCOPE("inner \"quoted\"");
+    }
+  }
+}
+
+void TracerTest() {
+  {
+    // Nothing is recorded while tracing is disabled.
+    RecordTraceSpans(3);
+    std::ostringstream os;
+    Tracer::WriteChromeTrace(os);
+    KALDI_ASSERT(CountOccurrences(os.str(), "\"ph\"") == 0);
+  }
+  Tracer::Enable(8);
+  RecordTraceSpans(2);
+  std::thread thread(RecordTraceSpans, 10);
+  thread.join();
+  Tracer::Disable();
+  RecordTraceSpans(1);
+  std::ostringstream os;
+  Tracer::WriteChromeTrace(os);
+  std::string trace = os.str();
+  KALDI_LOG << trace;
+  // This thread recorded 4 spans; the other thread kept the last 8 of its 20.
+  KALDI_ASSERT(trace.find("{\"displayTimeUnit\"") == 0);
+  KALDI_ASSERT(CountOccurrences(trace, "\"ph\":\"X\"") == 12);
+  KALDI_ASSERT(CountOccurrences(trace, "\"name\":\"outer\"") == 6);
+  KALDI_ASSERT(CountOccurrences(trace,
+                                "\"name\":\"inner \\\"quoted\\\"\"") == 6);
+  KALDI_ASSERT(CountOccurrences(trace, "\"tid\":0,") == 4);
+  KALDI_ASSERT(CountOccurrences(trace, "\"tid\":1,") == 8);
+}
 }
 
 
 int main() {
   for (int i = 0; i < 4; i++)
     kaldi::TimerTest();
+  kaldi::TracerTest();
 }
@@ -20,9 +20,14 @@
 #include "base/timer.h"
 #include "base/kaldi-error.h"
 #include <algorithm>
+#include <chrono>
+#include <fstream>
 #include <iomanip>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
+#include <vector>
 
 namespace kaldi {
 
@@ -82,4 +87,176 @@ Profiler::~Profiler() {
   g_profile_stats.AccStats(name_, tim_.Elapsed());
 }
 
+
+// The spans recorded by one thread.
+struct TraceBuffer {
+  struct Span {
+    const char *name;
+    int64 begin;
+    int64 end;
+  };
+  // A small number identifying the thread, used as the 'tid' in the trace.
+  int32 thread_index;
+  // A ring buffer: span number i is stored in spans[i % spans.size()].
+  std::vector<Span> spans;
+  // The number of spans recorded; only the owning thread changes it.
+  std::atomic<uint64> num_recorded;
+};
+
+// This holds the buffers of all threads, which stay around after their
+// threads finish so we can write out their spans.
+class TraceRegistry {
+ public:
+  TraceRegistry(): spans_per_thread_(1 << 18) { }
+
+  TraceBuffer *NewBuffer() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    TraceBuffer *buffer = new TraceBuffer();
+    buffer->thread_index = buffers_.size();
+    buffer->spans.resize(spans_per_thread_);
+    buffer->num_recorded = 0;
+    buffers_.push_back(std::unique_ptr<TraceBuffer>(buffer));
+    return buffer;
+  }
+
+  void Reset(int32 spans_per_thread) {
+    KALDI_ASSERT(spans_per_thread > 0);
+    std::lock_guard<std::mutex> lock(mutex_);
+    spans_per_thread_ = spans_per_thread;
+    for (size_t i = 0; i < buffers_.size(); i++) {
+      buffers_[i]->spans.resize(spans_per_thread);
+      buffers_[i]->num_recorded = 0;
+    }
+  }
+
+  void SetFilename(const std::string &filename) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    filename_ = filename;
+  }
+
+  void Write(std::ostream &os) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64 start = std::numeric_limits<int64>::max();
+    for (size_t i = 0; i < buffers_.size(); i++) {
+      const TraceBuffer &buffer = *(buffers_[i]);
+      uint64 num_recorded = buffer.num_recorded.load(std::memory_order_acquire),
+          size = buffer.spans.size(),
+          num_kept = std::min(num_recorded, size);
+      for (uint64 j = num_recorded - num_kept; j < num_recorded; j++)
+        start = std::min(start, buffer.spans[j % size].begin);
+    }
+    // Times in the trace format are in microseconds.
+    std::ios_base::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+    os << std::fixed << std::setprecision(3);
+    os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    for (size_t i = 0; i < buffers_.size(); i++) {
+      const TraceBuffer &buffer = *(buffers_[i]);
+      uint64 num_recorded = buffer.num_recorded.load(std::memory_order_acquire),
+          size = buffer.spans.size(),
+          num_kept = std::min(num_recorded, size);
+      for (uint64 j = num_recorded - num_kept; j < num_recorded; j++) {
+        const TraceBuffer::Span &span = buffer.spans[j % size];
+        os << (first ? "\n" : ",\n") << "{\"name\":\"";
+        for (const char *c = span.name; *c != '\0'; c++) {
+          if (*c == '"' || *c == '\\') os << '\\';
+          os << *c;
+        }
+        os << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << buffer.thread_index
+           << ",\"ts\":" << ((span.begin - start) / 1000.0)
+           << ",\"dur\":" << ((span.end - span.begin) / 1000.0) << "}";
+        first = false;
+      }
+    }
+    os << "\n]}\n";
+    os.flags(flags);
+    os.precision(precision);
+  }
+
+  ~TraceRegistry() {
+    if (!filename_.empty()) {
+      std::ofstream os(filename_.c_str());
+      Write(os);
+      if (!os.good())
+        KALDI_WARN << "Error writing trace to " << filename_;
+    }
+  }
+
+ private:
+  std::mutex mutex_;
+  int32 spans_per_thread_;
+  std::vector<std::unique_ptr<TraceBuffer> > buffers_;
+  // If nonempty, the trace is written to this file at exit.
+  std::string filename_;
+};
+
+static TraceRegistry &GetTraceRegistry() {
+  static TraceRegistry registry;
+  return registry;
+}
+
+static thread_local TraceBuffer *t_trace_buffer = NULL;
+
+std::atomic<bool> Tracer::enabled_(false);
+void (*Tracer::range_push_)(const char *name) = NULL;
+void (*Tracer::range_pop_)() = NULL;
+
+void Tracer::Enable(int32 spans_per_thread) {
+  GetTraceRegistry().Reset(spans_per_thread);
+  enabled_.store(true, std::memory_order_relaxed);
+}
+
+void Tracer::WriteAtExit(const std::string &filename) {
+  // We make sure the registry is constructed before Enable() returns, so
+  // that it is destroyed (and the trace written) after any static objects
+  // constructed later, which may still record spans.
+  GetTraceRegistry().SetFilename(filename);
+  Enable();
+}
+
+void Tracer::WriteChromeTrace(std::ostream &os) {
+  GetTraceRegistry().Write(os);
+}
+
+int64 Tracer::Now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Tracer::RecordSpan(const char *name, int64 begin, int64 end) {
+  if (!Enabled())
+    return;
+  TraceBuffer *buffer = t_trace_buffer;
+  if (buffer == NULL)
+    buffer = t_trace_buffer = GetTraceRegistry().NewBuffer();
+  uint64 n = buffer->num_recorded.load(std::memory_order_relaxed);
+  TraceBuffer::Span &span = buffer->spans[n % buffer->spans.size()];
+  span.name = name;
+  span.begin = begin;
+  span.end = end;
+  buffer->num_recorded.store(n + 1, std::memory_order_release);
+}
+
+void Tracer::SetRangeFunctions(void (*push)(const char *name),
+                               void (*pop)()) {
+  KALDI_ASSERT((push == NULL) == (pop == NULL));
+  range_push_ = push;
+  range_pop_ = pop;
+}
+
+void TraceSpan::Begin(const char *name) {
+  name_ = name;
+  range_pop_ = Tracer::range_pop_;
+  if (range_pop_ != NULL)
+    Tracer::range_push_(name);
+  begin_ = Tracer::Now();
+}
+
+void TraceSpan::End() {
+  Tracer::RecordSpan(name_, begin_, Tracer::Now());
+  if (range_pop_ != NULL)
+    range_pop_();
+}
+
 }  // namespace kaldi
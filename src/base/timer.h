@@ -19,6 +19,9 @@
 #ifndef KALDI_BASE_TIMER_H_
 #define KALDI_BASE_TIMER_H_
 
+#include <atomic>
+#include <ostream>
+#include <string>
 #include "base/kaldi-utils.h"
 #include "base/kaldi-error.h"
 
@@ -108,6 +111,101 @@ class Profiler {
 #define KALDI_PROFILE Profiler _profiler(__func__)
 
 
+/**
+   Tracer records when things happen, so you can see the latency of individual
+   requests and what the time went on (Profiler, above, and
+   CuDevice::AccuProfile() only accumulate the total time per name).  Code
+   marks spans with KALDI_TRACE_SCOPE("name"); while tracing is enabled, each
+   span is recorded with its begin and end time in a ring buffer owned by the
+   thread, without taking any locks (a lock is taken once per thread, to
+   register its buffer).  The spans can then be written in the Chrome
+   trace-event JSON format, which chrome://tracing and Perfetto
+   (ui.perfetto.dev) can display.
+
+   While tracing is disabled a span costs an atomic load and a branch; to
+   remove the spans entirely, compile with -DKALDI_NO_TRACE.
+
+   Tracing is normally turned on by the standard --trace-file option of the
+   command-line programs (see class ParseOptions), which makes the trace be
+   written to that file when the program exits.  Once a GPU is in use, the
+   spans are also NVTX ranges (see SetRangeFunctions()), so they show up in
+   NVIDIA's profilers.
+*/
+class Tracer {
+ public:
+  /// Turns tracing on, and clears any spans recorded before; each thread will
+  /// keep its most recent 'spans_per_thread' spans.  Should not be called
+  /// while other threads may be recording spans.
+  static void Enable(int32 spans_per_thread = 1 << 18);
+
+  /// Turns tracing off; the spans recorded so far are kept.
+  static void Disable() { enabled_.store(false, std::memory_order_relaxed); }
+
+  static bool Enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+  /// Enables tracing, and makes the trace be written to 'filename' (in the
+  /// format of WriteChromeTrace()) when the program exits.
+  static void WriteAtExit(const std::string &filename);
+
+  /// Writes the spans recorded so far in the Chrome trace-event JSON format.
+  /// Spans that other threads record while this is being called may come out
+  /// wrong, so call it when they are idle.
+  static void WriteChromeTrace(std::ostream &os);
+
+  /// Returns the time used for spans, in nanoseconds from an arbitrary
+  /// starting point.
+  static int64 Now();
+
+  /// Records a span that began at 'begin' and ended at 'end' (as returned by
+  /// Now()), if tracing is enabled.  'name' must be a string constant, as only
+  /// the pointer is stored.
+  static void RecordSpan(const char *name, int64 begin, int64 end);
+
+  /// Sets functions that are called at the beginning and end of each
+  /// KALDI_TRACE_SCOPE while tracing is enabled; the CUDA code uses this to
+  /// make the spans NVTX ranges.  Both or neither may be NULL.
+  static void SetRangeFunctions(void (*push)(const char *name),
+                                void (*pop)());
+
+ private:
+  friend class TraceSpan;
+  static std::atomic<bool> enabled_;
+  static void (*range_push_)(const char *name);
+  static void (*range_pop_)();
+};
+
+/// The class behind KALDI_TRACE_SCOPE: records a span from its construction
+/// to its destruction, if tracing is enabled.
+class TraceSpan {
+ public:
+  // Caution: 'name' should be a string constant, like for class Profiler.
+  explicit TraceSpan(const char *name): name_(NULL) {
+    if (Tracer::Enabled())
+      Begin(name);
+  }
+  ~TraceSpan() {
+    if (name_ != NULL)
+      End();
+  }
+ private:
+  void Begin(const char *name);
+  void End();
+  const char *name_;
+  int64 begin_;
+  // The function to end the range with, if one was begun.
+  void (*range_pop_)();
+};
+
+#ifdef KALDI_NO_TRACE
+#define KALDI_TRACE_SCOPE(name)
+#else
+#define KALDI_TRACE_CONCAT_(a, b) a ## b
+#define KALDI_TRACE_CONCAT(a, b) KALDI_TRACE_CONCAT_(a, b)
+#define KALDI_TRACE_SCOPE(name) \
+  ::kaldi::TraceSpan KALDI_TRACE_CONCAT(kaldi_trace_span_, __LINE__)(name)
+#endif
+
+
 
 }  // namespace kaldi
 
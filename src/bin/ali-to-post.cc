@@ -60,13 +60,13 @@ int main(int argc, char *argv[]) {
 
     int32 num_done = 0;
     SequentialInt32VectorReader alignment_reader(alignments_rspecifier);
-    PosteriorWriter posterior_writer(posteriors_wspecifier);
+    CompactPosteriorWriter posterior_writer(posteriors_wspecifier);
 
     for (; !alignment_reader.Done(); alignment_reader.Next()) {
       num_done++;
       const std::vector<int32> &alignment = alignment_reader.Value();
-      // Posterior is vector<vector<pair<int32, BaseFloat> > >
-      Posterior post;
+      // CompactPosterior is written in the same format as Posterior.
+      CompactPosterior post;
       AlignmentToPosterior(alignment, &post);
       posterior_writer.Write(alignment_reader.Key(), post);
     }
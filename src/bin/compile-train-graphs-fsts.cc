@@ -51,7 +51,7 @@ int main(int argc, char *argv[]) {
     ParseOptions po(usage);
 
     TrainingGraphCompilerOptions gopts;
-    int32 batch_size = 250;
+    int32 batch_size = 250, num_threads = 1;
     gopts.transition_scale = 0.0;  // Change the default to 0.0 since we will generally add the
     // transition probs in the alignment phase (since they change each time)
     gopts.self_loop_scale = 0.0;  // Ditto for self-loop probs.
@@ -63,6 +63,8 @@ int main(int argc, char *argv[]) {
                 "more memory.  E.g. 500");
     po.Register("read-disambig-syms", &disambig_rxfilename, "File containing "
                 "list of disambiguation symbols in phone symbol table");
+    po.Register("num-threads", &num_threads, "Number of threads used to "
+                "compile each batch of graphs.");
     
     po.Read(argc, argv);
 
@@ -139,7 +141,7 @@ int main(int argc, char *argv[]) {
           grammars.push_back(new VectorFst<StdArc>(fst_reader.Value()));
         }
         std::vector<fst::VectorFst<fst::StdArc>* > fsts;
-        if (!gc.CompileGraphs(grammars, &fsts))
+        if (!gc.CompileGraphs(grammars, &fsts, num_threads))
           KALDI_ERR << "Not expecting CompileGraphs to fail.";
         KALDI_ASSERT(fsts.size() == keys.size());
 
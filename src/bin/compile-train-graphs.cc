@@ -41,15 +41,18 @@ int main(int argc, char *argv[]) {
         "<lexicon-fst-in> <transcriptions-rspecifier> <graphs-wspecifier>\n"
         "e.g.: \n"
         " compile-train-graphs tree 1.mdl lex.fst "
-        "'ark:sym2int.pl -f 2- words.txt text|' ark:graphs.fsts\n";
+        "'ark:sym2int.pl -f 2- words.txt text|' ark:graphs.fsts\n"
+        "With --cache-dir, graphs are looked up in (and added to) a cache that\n"
+        "is keyed by the transcript and by the tree, topology and lexicon, so\n"
+        "later runs with a re-estimated model but the same tree reuse them.\n";
     ParseOptions po(usage);
 
     TrainingGraphCompilerOptions gopts;
-    int32 batch_size = 250;
+    int32 batch_size = 250, num_threads = 1;
     gopts.transition_scale = 0.0;  // Change the default to 0.0 since we will generally add the
     // transition probs in the alignment phase (since they change eacm time)
     gopts.self_loop_scale = 0.0;  // Ditto for self-loop probs.
-    std::string disambig_rxfilename;
+    std::string disambig_rxfilename, cache_dir;
     gopts.Register(&po);
 
     po.Register("batch-size", &batch_size,
@@ -57,6 +60,10 @@ int main(int argc, char *argv[]) {
                 "more memory.  E.g. 500");
     po.Register("read-disambig-syms", &disambig_rxfilename, "File containing "
                 "list of disambiguation symbols in phone symbol table");
+    po.Register("num-threads", &num_threads, "Number of threads used to "
+                "compile each batch of graphs.");
+    po.Register("cache-dir", &cache_dir, "If set, a directory (which must "
+                "exist) where compiled graphs are cached between runs.");
     
     po.Read(argc, argv);
 
@@ -90,6 +97,10 @@ int main(int argc, char *argv[]) {
 
     lex_fst = NULL;  // we gave ownership to gc.
 
+    TrainingGraphCache *cache = NULL;
+    if (cache_dir != "")
+      cache = new TrainingGraphCache(cache_dir, gc.ModelId());
+
     SequentialInt32VectorReader transcript_reader(transcript_rspecifier);
     TableWriter<fst::VectorFstHolder> fst_writer(fsts_wspecifier);
 
@@ -102,8 +113,12 @@ int main(int argc, char *argv[]) {
         const std::vector<int32> &transcript = transcript_reader.Value();
         VectorFst<StdArc> decode_fst;
 
-        if (!gc.CompileGraphFromText(transcript, &decode_fst)) {
-          decode_fst.DeleteStates();  // Just make it empty.
+        if (cache == NULL || !cache->Lookup(transcript, &decode_fst)) {
+          if (!gc.CompileGraphFromText(transcript, &decode_fst)) {
+            decode_fst.DeleteStates();  // Just make it empty.
+          } else if (cache != NULL && decode_fst.Start() != fst::kNoStateId) {
+            cache->Insert(transcript, decode_fst);
+          }
         }
         if (decode_fst.Start() != fst::kNoStateId) {
           num_succeed++;
@@ -126,10 +141,33 @@ int main(int argc, char *argv[]) {
           keys.push_back(transcript_reader.Key());
           transcripts.push_back(transcript_reader.Value());
         }
-        std::vector<fst::VectorFst<fst::StdArc>* > fsts;
-        if (!gc.CompileGraphsFromText(transcripts, &fsts)) {
+        std::vector<fst::VectorFst<fst::StdArc>* > fsts(transcripts.size(),
+                                                        NULL);
+        // Compile the graphs that are not in the cache.
+        std::vector<std::vector<int32> > to_compile;
+        std::vector<size_t> to_compile_index;
+        for (size_t i = 0; i < transcripts.size(); i++) {
+          if (cache != NULL) {
+            fsts[i] = new VectorFst<StdArc>();
+            if (cache->Lookup(transcripts[i], fsts[i]))
+              continue;
+            delete fsts[i];
+            fsts[i] = NULL;
+          }
+          to_compile.push_back(transcripts[i]);
+          to_compile_index.push_back(i);
+        }
+        std::vector<fst::VectorFst<fst::StdArc>* > compiled_fsts;
+        if (!gc.CompileGraphsFromText(to_compile, &compiled_fsts,
+                                      num_threads)) {
           KALDI_ERR << "Not expecting CompileGraphs to fail.";
         }
+        KALDI_ASSERT(compiled_fsts.size() == to_compile.size());
+        for (size_t j = 0; j < compiled_fsts.size(); j++) {
+          fsts[to_compile_index[j]] = compiled_fsts[j];
+          if (cache != NULL && compiled_fsts[j]->Start() != fst::kNoStateId)
+            cache->Insert(to_compile[j], *(compiled_fsts[j]));
+        }
         KALDI_ASSERT(fsts.size() == keys.size());
         for (size_t i = 0; i < fsts.size(); i++) {
           if (fsts[i]->Start() != fst::kNoStateId) {
@@ -144,6 +182,10 @@ int main(int argc, char *argv[]) {
         DeletePointers(&fsts);
       }
     }
+    if (cache != NULL) {
+      cache->PrintStats();
+      delete cache;
+    }
     KALDI_LOG << "compile-train-graphs: succeeded for " << num_succeed
               << " graphs, failed for " << num_fail;
     return (num_succeed != 0 ? 0 : 1);
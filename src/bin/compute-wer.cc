@@ -24,6 +24,61 @@
 #include "util/parse-options.h"
 #include "tree/context-dep.h"
 #include "util/edit-distance.h"
+#include "util/kaldi-thread.h"
+
+namespace kaldi {
+
+struct WerStats {
+  int32 num_words, word_errs, num_sent, sent_errs, num_ins, num_del, num_sub;
+  WerStats(): num_words(0), word_errs(0), num_sent(0), sent_errs(0),
+              num_ins(0), num_del(0), num_sub(0) { }
+};
+
+// Scores a batch of (reference, hypothesis) pairs in operator (), and adds
+// the statistics to 'totals' in its destructor, which TaskSequencer calls
+// in order and one at a time.  Utterances are batched because scoring one of
+// them takes too little time to be worth a task of its own.
+class WerBatchTask {
+ public:
+  explicit WerBatchTask(WerStats *totals): totals_(totals) { }
+
+  void Add(const std::vector<std::string> &ref,
+           const std::vector<std::string> &hyp) {
+    refs_.push_back(ref);
+    hyps_.push_back(hyp);
+  }
+  size_t Size() const { return refs_.size(); }
+
+  void operator () () {
+    for (size_t i = 0; i < refs_.size(); i++) {
+      int32 ins, del, sub;
+      stats_.num_words += refs_[i].size();
+      stats_.word_errs += LevenshteinEditDistance(refs_[i], hyps_[i],
+                                                  &ins, &del, &sub);
+      stats_.num_ins += ins;
+      stats_.num_del += del;
+      stats_.num_sub += sub;
+      stats_.num_sent++;
+      stats_.sent_errs += (refs_[i] != hyps_[i]);
+    }
+  }
+
+  ~WerBatchTask() {
+    totals_->num_words += stats_.num_words;
+    totals_->word_errs += stats_.word_errs;
+    totals_->num_sent += stats_.num_sent;
+    totals_->sent_errs += stats_.sent_errs;
+    totals_->num_ins += stats_.num_ins;
+    totals_->num_del += stats_.num_del;
+    totals_->num_sub += stats_.num_sub;
+  }
+ private:
+  WerStats *totals_;
+  WerStats stats_;
+  std::vector<std::vector<std::string> > refs_, hyps_;
+};
+
+}  // namespace kaldi
 
 int main(int argc, char *argv[]) {
   using namespace kaldi;
@@ -52,6 +107,9 @@ int main(int argc, char *argv[]) {
     bool dummy = false;
     po.Register("text", &dummy, "Deprecated option! Keeping for compatibility reasons.");
 
+    TaskSequencerConfig sequencer_config;  // has --num-threads option
+    sequencer_config.Register(&po);
+
     po.Read(argc, argv);
 
     if (po.NumArgs() != 2) {
@@ -67,18 +125,21 @@ int main(int argc, char *argv[]) {
                 << mode;
     }
 
-    int32 num_words = 0, word_errs = 0, num_sent = 0, sent_errs = 0,
-        num_ins = 0, num_del = 0, num_sub = 0, num_absent_sents = 0;
+    WerStats stats;
+    int32 num_absent_sents = 0;
+    const size_t kBatchSize = 256;
+    const std::vector<std::string> empty_sent;
 
     // Both text and integers are loaded as vector of strings,
     SequentialTokenVectorReader ref_reader(ref_rspecifier);
     RandomAccessTokenVectorReader hyp_reader(hyp_rspecifier);
-    
+    TaskSequencer<WerBatchTask> sequencer(sequencer_config);
+    WerBatchTask *batch = new WerBatchTask(&stats);
     // Main loop, accumulate WER stats,
     for (; !ref_reader.Done(); ref_reader.Next()) {
       std::string key = ref_reader.Key();
       const std::vector<std::string> &ref_sent = ref_reader.Value();
-      std::vector<std::string> hyp_sent;
+      const std::vector<std::string> *hyp_sent = &empty_sent;
       if (!hyp_reader.HasKey(key)) {
         if (mode == "strict")
           KALDI_ERR << "No hypothesis for key " << key << " and strict "
@@ -87,18 +148,20 @@ int main(int argc, char *argv[]) {
         if (mode == "present")  // do not score this one.
           continue;
       } else {
-        hyp_sent = hyp_reader.Value(key);
+        hyp_sent = &(hyp_reader.Value(key));
+      }
+      batch->Add(ref_sent, *hyp_sent);
+      if (batch->Size() == kBatchSize) {
+        sequencer.Run(batch);  // takes ownership of 'batch'.
+        batch = new WerBatchTask(&stats);
       }
-      num_words += ref_sent.size();
-      int32 ins, del, sub;
-      word_errs += LevenshteinEditDistance(ref_sent, hyp_sent, &ins, &del, &sub);
-      num_ins += ins;
-      num_del += del;
-      num_sub += sub;
-
-      num_sent++;
-      sent_errs += (ref_sent != hyp_sent);
     }
+    sequencer.Run(batch);
+    sequencer.Wait();  // the totals are complete after this.
+    int32 num_words = stats.num_words, word_errs = stats.word_errs,
+        num_sent = stats.num_sent, sent_errs = stats.sent_errs,
+        num_ins = stats.num_ins, num_del = stats.num_del,
+        num_sub = stats.num_sub;
 
     // Compute WER, SER,
     BaseFloat percent_wer = 100.0 * static_cast<BaseFloat>(word_errs)
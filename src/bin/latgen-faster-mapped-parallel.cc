@@ -54,6 +54,7 @@ int main(int argc, char *argv[]) {
     std::string word_syms_filename;
     config.Register(&po);
     sequencer_config.Register(&po);
+    RegisterGlobalThreadPoolOptions(&po);
 
     po.Register("acoustic-scale", &acoustic_scale, "Scaling factor for acoustic likelihoods");
 
@@ -101,7 +102,8 @@ int main(int argc, char *argv[]) {
     Fst<StdArc> *decode_fst = NULL; // only used if there is a single
                                     // decoding graph.
 
-    TaskSequencer<DecodeUtteranceLatticeFasterClass> sequencer(sequencer_config);
+    TaskSequencer<DecodeUtteranceLatticeFasterClass> sequencer(
+        sequencer_config, &GlobalThreadPool());
     if (ClassifyRspecifier(fst_in_str, NULL, NULL) == kNoRspecifier) {
       SequentialBaseFloatMatrixReader loglike_reader(feature_rspecifier);
       // Input FST is just one FST, not a table of FSTs.
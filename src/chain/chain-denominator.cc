@@ -110,9 +110,13 @@ void DenominatorComputation::AlphaFirstFrame() {
 void DenominatorComputation::AlphaGeneralFrame(int32 t) {
   KALDI_ASSERT(t > 0 && t <= frames_per_sequence_);
   BaseFloat *this_alpha = alpha_.RowData(t);
-  const BaseFloat *prev_alpha_dash = alpha_.RowData(t - 1);
+  // this is the alpha, not the alpha-dash; the alpha-dash is worked out as we
+  // read it, from the alpha and the alpha-sum.
+  const BaseFloat *prev_alpha = alpha_.RowData(t - 1);
   const Int32Pair *backward_transitions = den_graph_.BackwardTransitions();
   const DenominatorGraphTransition *transitions = den_graph_.Transitions();
+  const BaseFloat *initial_probs = den_graph_.InitialProbs().Data();
+  BaseFloat leaky_hmm_coefficient = opts_.leaky_hmm_coefficient;
   int32 num_pdfs = exp_nnet_output_transposed_.NumRows(),
       num_hmm_states = den_graph_.NumStates(),
       num_sequences = num_sequences_;
@@ -134,7 +138,8 @@ void DenominatorComputation::AlphaGeneralFrame(int32 t) {
       cuda_chain_hmm_forward(dimGrid, dimBlock,
                              backward_transitions, transitions,
                              num_sequences, den_graph_.NumStates(),
-                             prob_data, probs.Stride(), prev_alpha_dash,
+                             prob_data, probs.Stride(), initial_probs,
+                             leaky_hmm_coefficient, prev_alpha,
                              this_alpha);
       CU_SAFE_CALL(cudaGetLastError());
       if (dimGrid.y == num_hmm_states) {
@@ -156,6 +161,8 @@ void DenominatorComputation::AlphaGeneralFrame(int32 t) {
     int32 prob_stride = probs.Stride();
     for (int32 h = 0; h < num_hmm_states; h++) {
       for (int32 s = 0; s < num_sequences; s++) {
+        BaseFloat prev_alpha_sum = prev_alpha[num_hmm_states * num_sequences + s],
+            leaky_scale = leaky_hmm_coefficient * prev_alpha_sum;
         double this_tot_alpha = 0.0;
         const DenominatorGraphTransition
             *trans_iter = transitions + backward_transitions[h].first,
@@ -165,8 +172,10 @@ void DenominatorComputation::AlphaGeneralFrame(int32 t) {
           int32 pdf_id = trans_iter->pdf_id,
               prev_hmm_state = trans_iter->hmm_state;
           BaseFloat prob = prob_data[pdf_id * prob_stride + s],
-              this_prev_alpha = prev_alpha_dash[prev_hmm_state * num_sequences + s];
-          this_tot_alpha += this_prev_alpha * transition_prob * prob;
+              this_prev_alpha_dash =
+              prev_alpha[prev_hmm_state * num_sequences + s] +
+              leaky_scale * initial_probs[prev_hmm_state];
+          this_tot_alpha += this_prev_alpha_dash * transition_prob * prob;
         }
         // Let arbitrary_scale be the inverse of the alpha-sum value that we
         // store in the same place we'd store the alpha for the state numbered
@@ -176,8 +185,7 @@ void DenominatorComputation::AlphaGeneralFrame(int32 t) {
         // a good numeric range.  This won't affect the posteriors, but when
         // computing the total likelihood we'll need to compensate for it later
         // on.
-        BaseFloat arbitrary_scale =
-            1.0 / prev_alpha_dash[num_hmm_states * num_sequences + s];
+        BaseFloat arbitrary_scale = 1.0 / prev_alpha_sum;
         KALDI_ASSERT(this_tot_alpha - this_tot_alpha == 0);
         this_alpha[h * num_sequences + s] = this_tot_alpha * arbitrary_scale;
       }
@@ -185,7 +193,7 @@ void DenominatorComputation::AlphaGeneralFrame(int32 t) {
   }
 }
 
-void DenominatorComputation::AlphaDash(int32 t) {
+void DenominatorComputation::AlphaSum(int32 t) {
   BaseFloat *this_alpha = alpha_.RowData(t);
 
   // create a 'fake matrix' for the regular alphas- view this row as a matrix.
@@ -195,20 +203,62 @@ void DenominatorComputation::AlphaDash(int32 t) {
                                    num_sequences_,
                                    num_sequences_);
 
-  // the alpha-dash is the sum of alpha over all states.
+  // the alpha-sum is the sum of alpha over all states.
   CuSubVector<BaseFloat> alpha_sum_vec(this_alpha +
                                        den_graph_.NumStates() * num_sequences_,
                                        num_sequences_);
   alpha_sum_vec.AddRowSumMat(1.0, alpha_mat, 0.0);
+}
 
-  alpha_mat.AddVecVec(opts_.leaky_hmm_coefficient,
-                      den_graph_.InitialProbs(),
-                      alpha_sum_vec);
-  // it's now alpha-dash.
+void DenominatorComputation::AlphaDash() {
+  int32 num_hmm_states = den_graph_.NumStates(),
+      num_sequences = num_sequences_;
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled()) {
+    CuTimer tim;
+    const BaseFloat *initial_probs = den_graph_.InitialProbs().Data();
+    BaseFloat *alpha_data = alpha_.Data();
+    dim3 dimBlock(std::min<int32>(CU1DBLOCK, num_sequences), 1, 1);
+    dim3 dimGrid(n_blocks(num_sequences, dimBlock.x), num_hmm_states, 1);
+    while (1) {
+      if (dimGrid.y > 65535)  // the hardware doesn't allow more than this.
+        dimGrid.y = 65535;
+      cuda_chain_hmm_alpha_dash(dimGrid, dimBlock, alpha_.NumRows(),
+                                num_sequences, num_hmm_states, initial_probs,
+                                opts_.leaky_hmm_coefficient,
+                                alpha_data, alpha_.Stride());
+      CU_SAFE_CALL(cudaGetLastError());
+      if (dimGrid.y == num_hmm_states) {
+        break;  // this is the normal case.
+      } else {
+        // We reach this code only in the unusual case where num_hmm_states >
+        // 65535; see AlphaGeneralFrame().
+        initial_probs += dimGrid.y;
+        alpha_data += dimGrid.y * num_sequences;
+        num_hmm_states -= dimGrid.y;
+        dimGrid.y = num_hmm_states;
+      }
+    }
+    CuDevice::Instantiate().AccuProfile(__func__, tim);
+  } else
+#endif
+  {
+    for (int32 t = 0; t <= frames_per_sequence_; t++) {
+      BaseFloat *this_alpha = alpha_.RowData(t);
+      CuSubMatrix<BaseFloat> alpha_mat(this_alpha, num_hmm_states,
+                                       num_sequences, num_sequences);
+      CuSubVector<BaseFloat> alpha_sum_vec(
+          this_alpha + num_hmm_states * num_sequences, num_sequences);
+      alpha_mat.AddVecVec(opts_.leaky_hmm_coefficient,
+                          den_graph_.InitialProbs(),
+                          alpha_sum_vec);
+    }
+  }
+  // alpha_ now contains the alpha-dash.
 }
 
-// compute beta from beta-dash.
-void DenominatorComputation::Beta(int32 t) {
+// compute the beta-dash-sum from beta-dash; beta = beta-dash + beta-dash-sum.
+void DenominatorComputation::BetaDashSum(int32 t) {
   BaseFloat *this_beta_dash = beta_.RowData(t % 2);
   // create a 'fake matrix' for the regular beta-dash (which is
   // the counterpart of alpha-dash)- view this row as a matrix.
@@ -224,19 +274,18 @@ void DenominatorComputation::Beta(int32 t) {
       num_sequences_);
   beta_dash_sum_vec.AddMatVec(opts_.leaky_hmm_coefficient, beta_dash_mat,
                               kTrans, den_graph_.InitialProbs(), 0.0);
-  // we are computing beta in place.  After the following, beta-dash-mat
-  // will contain the actual beta (i.e. the counterpart of alpha),
-  // not the beta-dash.
-  beta_dash_mat.AddVecToRows(1.0, beta_dash_sum_vec);
+  // we don't compute the beta itself: BetaDashGeneralFrame() adds the
+  // beta-dash-sum to the beta-dash as it reads it.
 }
 
 BaseFloat DenominatorComputation::Forward() {
   AlphaFirstFrame();
-  AlphaDash(0);
+  AlphaSum(0);
   for (int32 t = 1; t <= frames_per_sequence_; t++) {
     AlphaGeneralFrame(t);
-    AlphaDash(t);
+    AlphaSum(t);
   }
+  AlphaDash();
   return ComputeTotLogLike();
 }
 
@@ -282,12 +331,13 @@ bool DenominatorComputation::Backward(
     BaseFloat deriv_weight,
     CuMatrixBase<BaseFloat> *nnet_output_deriv) {
   BetaDashLastFrame();
-  Beta(frames_per_sequence_);
+  BetaDashSum(frames_per_sequence_);
   for (int32 t = frames_per_sequence_ - 1; t >= 0; t--) {
     BetaDashGeneralFrame(t);
     if (GetVerboseLevel() >= 1 || t == 0)
       BetaGeneralFrameDebug(t);
-    Beta(t);
+    if (t > 0)  // the beta for t = 0 is not needed.
+      BetaDashSum(t);
     if (t % kMaxDerivTimeSteps == 0) {
       // commit the derivative stored in nnet_output_deriv_transposed_ by adding
       // its transpose to the appropriate sub-matrix of 'nnet_output_deriv'.
@@ -339,8 +389,13 @@ void DenominatorComputation::BetaDashGeneralFrame(int32 t) {
   // matrix, storing only chunks of frames at a time, and we add it to the
   // non-transposed output whenever we finish a chunk.
   int32 t_wrapped = t % static_cast<int32>(kMaxDerivTimeSteps);
+  int32 num_hmm_states = den_graph_.NumStates(),
+      num_sequences = num_sequences_;
+  // 'next_beta' is the beta-dash of frame t + 1; the beta is worked out as we
+  // read it, by adding the beta-dash-sum.
   const BaseFloat *this_alpha_dash = alpha_.RowData(t),
-      *next_beta = beta_.RowData((t + 1) % 2);
+      *next_beta = beta_.RowData((t + 1) % 2),
+      *next_beta_sum = next_beta + num_hmm_states * num_sequences;
   BaseFloat *this_beta_dash = beta_.RowData(t % 2);
   const Int32Pair *forward_transitions = den_graph_.ForwardTransitions();
   const DenominatorGraphTransition *transitions = den_graph_.Transitions();
@@ -350,9 +405,6 @@ void DenominatorComputation::BetaDashGeneralFrame(int32 t) {
       log_prob_deriv(nnet_output_deriv_transposed_, 0, num_pdfs,
                      t_wrapped * num_sequences_, num_sequences_);
 
-  int32 num_hmm_states = den_graph_.NumStates(),
-      num_sequences = num_sequences_;
-
 #if HAVE_CUDA == 1
   if (CuDevice::Instantiate().Enabled()) {
     CuTimer tim;
@@ -364,7 +416,8 @@ void DenominatorComputation::BetaDashGeneralFrame(int32 t) {
       cuda_chain_hmm_backward(dimGrid, dimBlock, forward_transitions, transitions,
                               num_sequences, num_hmm_states,
                               probs.Data(), probs.Stride(),
-                              this_alpha_dash, next_beta, this_beta_dash,
+                              this_alpha_dash, next_beta, next_beta_sum,
+                              this_beta_dash,
                               log_prob_deriv.Data(), log_prob_deriv.Stride());
       CU_SAFE_CALL(cudaGetLastError());
       if (dimGrid.y == num_hmm_states) {
@@ -394,6 +447,7 @@ void DenominatorComputation::BetaDashGeneralFrame(int32 t) {
         BaseFloat this_alpha_dash_prob = this_alpha_dash[h * num_sequences + s],
             inv_arbitrary_scale =
             this_alpha_dash[num_hmm_states * num_sequences + s];
+        BaseFloat next_beta_dash_sum = next_beta_sum[s];
         double tot_variable_factor = 0.0;
         BaseFloat occupation_factor = this_alpha_dash_prob /
             inv_arbitrary_scale;
@@ -405,7 +459,8 @@ void DenominatorComputation::BetaDashGeneralFrame(int32 t) {
           int32 pdf_id = trans_iter->pdf_id,
               next_hmm_state = trans_iter->hmm_state;
           BaseFloat variable_factor = transition_prob *
-              next_beta[next_hmm_state * num_sequences + s] *
+              (next_beta[next_hmm_state * num_sequences + s] +
+               next_beta_dash_sum) *
               prob_data[pdf_id * prob_stride + s];
           tot_variable_factor += variable_factor;
           BaseFloat occupation_prob = variable_factor * occupation_factor;
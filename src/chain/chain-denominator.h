@@ -184,6 +184,13 @@ namespace chain {
 
    Note: in the code, the tot-alpha and tot-beta quantities go in the same
    memory location that the corresponding alpha and beta for state I would go.
+   The alpha'(t, i) and beta(t, i) quantities are not stored while we go
+   through the frames; the forward and backward computations for each frame
+   work them out from alpha(t-1, i) and tot-alpha(t-1) (respectively
+   beta'(t+1, i) and tot-beta(t+1)) as they read them, which saves a pass over
+   the whole state space per frame.  The alphas are turned into alpha' for all
+   frames at once after the forward computation, since the backward
+   computation needs them.
 
  */
 
@@ -233,11 +240,14 @@ class DenominatorComputation {
 
   // sets up the alpha for frame t = 0.
   void AlphaFirstFrame();
-  // the alpha computation for some 0 < t <= num_time_steps_.
+  // the alpha computation for some 0 < t <= num_time_steps_; it uses the
+  // alpha and the alpha-sum of frame t - 1.
   void AlphaGeneralFrame(int32 t);
-  // does the 'alpha-dash' computation for time t.  this relates to
-  // 'leaky hmm'.
-  void AlphaDash(int32 t);
+  // computes the alpha-sum (tot-alpha) for time t.
+  void AlphaSum(int32 t);
+  // does the 'alpha-dash' computation for all frames, once we have all the
+  // alphas and alpha-sums.  this relates to 'leaky hmm'.
+  void AlphaDash();
 
   // done after all the alphas, this function computes and returns the total
   // log-likelihood summed over all the sequences, and sets tot_prob_ (if we're
@@ -247,10 +257,12 @@ class DenominatorComputation {
   BaseFloat ComputeTotLogLike();
 
   void BetaDashLastFrame();
-  // beta computation for 0 <= beta < num_time_steps_.
+  // beta computation for 0 <= beta < num_time_steps_; it uses the beta-dash
+  // and the beta-dash-sum of frame t + 1.
   void BetaDashGeneralFrame(int32 t);
-  // compute the beta quantity from the beta-dash quantity (relates to leaky hmm).
-  void Beta(int32 t);
+  // compute the beta-dash-sum (tot-beta) quantity for time t, from which
+  // we get the beta from the beta-dash (relates to leaky hmm).
+  void BetaDashSum(int32 t);
 
   // some checking that we can do if debug mode is activated, or on frame zero.
   // Sets ok_ to false if a bad problem is detected.
@@ -276,18 +288,19 @@ class DenominatorComputation {
   // the derivs w.r.t. the nnet outputs (transposed)
   CuMatrix<BaseFloat> nnet_output_deriv_transposed_;
 
-  // the (temporarily) alpha and (more permanently) alpha-dash probabilities;
-  // dimension is (frames_per_sequence + 1) by (num-hmm-states * num-sequences +
-  // num_sequences).  Note, they are not logs.  The last 'num_sequences'
-  // columns, where the alpha for the state indexed 'num_hmm_states' would live,
-  // are for the alpha-sums, which relates to leaky HMM.
+  // the alpha (during the forward computation) and alpha-dash (after it)
+  // probabilities; dimension is (frames_per_sequence + 1) by (num-hmm-states *
+  // num-sequences + num_sequences).  Note, they are not logs.  The last
+  // 'num_sequences' columns, where the alpha for the state indexed
+  // 'num_hmm_states' would live, are for the alpha-sums, which relates to leaky
+  // HMM.
   CuMatrix<BaseFloat> alpha_;
 
-  // the beta (also beta-dash) probabilities (rolling buffer); dimension is 2 *
+  // the beta-dash probabilities (rolling buffer); dimension is 2 *
   // (num-hmm-states * num-sequences + num_sequences).  [the last
-  // 'num_sequences' columns are for the beta-sums, which relates to leaky HMM.]
-  // Note: for efficiency and to simplify the equations, these are actually the
-  // beta / tot_prob_.
+  // 'num_sequences' columns are for the beta-dash-sums, which relates to leaky
+  // HMM.]  Note: for efficiency and to simplify the equations, these are
+  // actually the beta-dash / tot_prob_.
   CuMatrix<BaseFloat> beta_;
 
   // the total probability for each sequence, excluding the product of
@@ -57,15 +57,13 @@ GenericNumeratorComputation::GenericNumeratorComputation(
   }
   final_probs_.Resize(num_sequences, max_num_hmm_states);
 
-  // Initialize incoming transitions for easy access
-  in_transitions_.resize(num_sequences);  // indexed by seq, state
-  out_transitions_.resize(num_sequences);  // indexed by seq, state
-  for (int seq = 0; seq < num_sequences; seq++) {
-    in_transitions_[seq] = vector<vector<DenominatorGraphTransition> >(
-        supervision_.e2e_fsts[seq].NumStates());
-    out_transitions_[seq] = vector<vector<DenominatorGraphTransition> >(
-        supervision_.e2e_fsts[seq].NumStates());
-  }
+  state_offsets_.resize(num_sequences + 1);
+  state_offsets_[0] = 0;
+  for (int seq = 0; seq < num_sequences; seq++)
+    state_offsets_[seq + 1] = state_offsets_[seq] +
+        supervision_.e2e_fsts[seq].NumStates();
+  forward_transitions_.resize(state_offsets_[num_sequences]);
+  backward_transitions_.resize(state_offsets_[num_sequences]);
 
   offsets_.Resize(num_sequences);
   std::unordered_map<int32, MatrixIndexT> pdf_to_index;
@@ -74,7 +72,12 @@ GenericNumeratorComputation::GenericNumeratorComputation(
   pdf_to_index.reserve(view_stride);
   nnet_output_stride_ = pdf_stride;
   for (int seq = 0; seq < num_sequences; seq++) {
-    for (int32 s = 0; s < supervision_.e2e_fsts[seq].NumStates(); s++) {
+    int32 num_states = supervision_.e2e_fsts[seq].NumStates();
+    // The incoming and outgoing transitions of each state of this sequence;
+    // they are appended to transitions_ below.
+    vector<vector<DenominatorGraphTransition> > in_transitions(num_states),
+        out_transitions(num_states);
+    for (int32 s = 0; s < num_states; s++) {
       final_probs_(seq, s)= -supervision_.e2e_fsts[seq].Final(s).Value();
       BaseFloat offset = 0.0;
       if (s == 0) {
@@ -108,12 +111,42 @@ GenericNumeratorComputation::GenericNumeratorComputation(
 
         transition.pdf_id = pdf_to_index[pdf_id];
         transition.hmm_state = s;
-        in_transitions_[seq][arc.nextstate].push_back(transition);
+        in_transitions[arc.nextstate].push_back(transition);
         transition.hmm_state = arc.nextstate;
-        out_transitions_[seq][s].push_back(transition);
+        out_transitions[s].push_back(transition);
       }
     }
+    for (int32 s = 0; s < num_states; s++) {
+      Int32Pair &range = forward_transitions_[state_offsets_[seq] + s];
+      range.first = transitions_.size();
+      transitions_.insert(transitions_.end(), out_transitions[s].begin(),
+                          out_transitions[s].end());
+      range.second = transitions_.size();
+    }
+    for (int32 s = 0; s < num_states; s++) {
+      Int32Pair &range = backward_transitions_[state_offsets_[seq] + s];
+      range.first = transitions_.size();
+      transitions_.insert(transitions_.end(), in_transitions[s].begin(),
+                          in_transitions[s].end());
+      range.second = transitions_.size();
+    }
   }
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled()) {
+    cu_state_offsets_ = state_offsets_;
+    cu_forward_transitions_ = forward_transitions_;
+    cu_backward_transitions_ = backward_transitions_;
+    cu_transitions_ = transitions_;
+    Vector<BaseFloat> final_probs(state_offsets_[num_sequences], kUndefined);
+    for (int seq = 0; seq < num_sequences; seq++) {
+      int32 num_states = state_offsets_[seq + 1] - state_offsets_[seq];
+      final_probs.Range(state_offsets_[seq], num_states).CopyFromVec(
+          final_probs_.Row(seq).Range(0, num_states));
+    }
+    cu_final_probs_ = final_probs;
+    cu_offsets_ = offsets_;
+  }
+#endif
 }
 
 
@@ -131,7 +164,7 @@ void GenericNumeratorComputation::AlphaFirstFrame(int seq,
 void GenericNumeratorComputation::CopySpecificPdfsIndirect(
                                     const CuMatrixBase<BaseFloat> &nnet_output,
                                     const std::vector<MatrixIndexT> &indices,
-                                    Matrix<BaseFloat> *out) {
+                                    CuMatrix<BaseFloat> *out) {
   KALDI_ASSERT(nnet_output_stride_ == nnet_output_.Stride());
   const int32 num_sequences = supervision_.num_sequences,
               frames_per_sequence = supervision_.frames_per_sequence;
@@ -172,8 +205,11 @@ BaseFloat GenericNumeratorComputation::AlphaRemainingFrames(int seq,
     const BaseFloat *alpha_tm1 = alpha->RowData(t - 1);
 
     for (int32 h = 0; h < supervision_.e2e_fsts[seq].NumStates(); h++) {
-      for (auto tr = in_transitions_[seq][h].begin();
-          tr != in_transitions_[seq][h].end(); ++tr) {
+      const Int32Pair &range = backward_transitions_[state_offsets_[seq] + h];
+      for (const DenominatorGraphTransition
+               *tr = &(transitions_[0]) + range.first,
+               *end = &(transitions_[0]) + range.second;
+           tr != end; ++tr) {
         BaseFloat transition_prob = tr->transition_prob;
         int32 pdf_id = tr->pdf_id,
               prev_hmm_state = tr->hmm_state;
@@ -221,13 +257,32 @@ bool GenericNumeratorComputation::ForwardBackward(
   const int32 num_sequences = supervision_.num_sequences;
 
   bool ok = true;
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled()) {
+    CuMatrix<BaseFloat> probs, alpha, derivs;
+    CopySpecificPdfsIndirect(nnet_output_, index_to_pdf_, &probs);
+    partial_loglike = ForwardGpu(probs, &alpha);
+    BackwardGpu(probs, alpha, &derivs);
+    if (GetVerboseLevel() >= 1) {
+      Matrix<BaseFloat> log_derivs(derivs);
+      log_derivs.ApplyLog();
+      for (int seq = 0; seq < num_sequences; ++seq)
+        ok = ok && CheckValues(seq, log_derivs);
+    }
+    AddSpecificPdfsIndirect(&derivs, index_to_pdf_, nnet_output_deriv);
+    *total_loglike = partial_loglike;
+    return ok;
+  }
+#endif
   Matrix<BaseFloat> alpha;
   Matrix<BaseFloat> beta;
   Matrix<BaseFloat> probs;
   Matrix<BaseFloat> derivs;
 
   // We selectively copy only those pdfs we need
-  CopySpecificPdfsIndirect(nnet_output_, index_to_pdf_, &probs);
+  CuMatrix<BaseFloat> cu_probs;
+  CopySpecificPdfsIndirect(nnet_output_, index_to_pdf_, &cu_probs);
+  probs.Swap(&cu_probs);
 
   derivs.Resize(probs.NumRows(), probs.NumCols());
   derivs.Set(-std::numeric_limits<BaseFloat>::infinity());
@@ -241,10 +296,13 @@ bool GenericNumeratorComputation::ForwardBackward(
     BetaLastFrame(seq, alpha, &beta);
     BetaRemainingFrames(seq, probs, alpha, &beta, &derivs);
     if (GetVerboseLevel() >= 1)
-      ok = ok && CheckValues(seq, probs, alpha, beta, derivs);
+      ok = ok && CheckValues(seq, derivs);
   }
   // Transfer and add the derivatives to the values in the matrix
-  AddSpecificPdfsIndirect(&derivs, index_to_pdf_, nnet_output_deriv);
+  CuMatrix<BaseFloat> occupation_probs;
+  occupation_probs.Swap(&derivs);
+  occupation_probs.ApplyExp();
+  AddSpecificPdfsIndirect(&occupation_probs, index_to_pdf_, nnet_output_deriv);
   *total_loglike = partial_loglike;
   return ok;
 }
@@ -253,11 +311,20 @@ BaseFloat GenericNumeratorComputation::ComputeObjf() {
   BaseFloat partial_loglike = 0;
   const int32 num_sequences = supervision_.num_sequences;
 
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled()) {
+    CuMatrix<BaseFloat> probs, alpha;
+    CopySpecificPdfsIndirect(nnet_output_, index_to_pdf_, &probs);
+    return ForwardGpu(probs, &alpha);
+  }
+#endif
   Matrix<BaseFloat> alpha;
   Matrix<BaseFloat> probs;
 
   // We selectively copy only those pdfs we need
-  CopySpecificPdfsIndirect(nnet_output_, index_to_pdf_, &probs);
+  CuMatrix<BaseFloat> cu_probs;
+  CopySpecificPdfsIndirect(nnet_output_, index_to_pdf_, &cu_probs);
+  probs.Swap(&cu_probs);
 
   for (int seq = 0; seq < num_sequences; ++seq) {
     // Forward part
@@ -267,6 +334,56 @@ BaseFloat GenericNumeratorComputation::ComputeObjf() {
   return partial_loglike;
 }
 
+#if HAVE_CUDA == 1
+BaseFloat GenericNumeratorComputation::ForwardGpu(
+    const CuMatrixBase<BaseFloat> &probs,
+    CuMatrix<BaseFloat> *alpha) {
+  const int32 num_sequences = supervision_.num_sequences,
+      num_frames = supervision_.frames_per_sequence,
+      num_states = state_offsets_[num_sequences];
+  KALDI_ASSERT(probs.NumRows() == num_frames);
+  alpha->Resize(num_frames + 1, num_states + num_sequences, kUndefined);
+  CuVector<BaseFloat> tot_log_probs(num_sequences, kUndefined);
+
+  CuTimer tim;
+  dim3 dimBlock(CU1DBLOCK), dimGrid(num_sequences);
+  cuda_chain_numerator_forward(dimGrid, dimBlock, cu_state_offsets_.Data(),
+                               cu_backward_transitions_.Data(),
+                               cu_transitions_.Data(), num_sequences,
+                               num_frames, probs.Data(), probs.Stride(),
+                               cu_final_probs_.Data(), cu_offsets_.Data(),
+                               alpha->Data(), alpha->Stride(),
+                               tot_log_probs.Data());
+  CU_SAFE_CALL(cudaGetLastError());
+  CuDevice::Instantiate().AccuProfile(__func__, tim);
+  return tot_log_probs.Sum();
+}
+
+void GenericNumeratorComputation::BackwardGpu(
+    const CuMatrixBase<BaseFloat> &probs,
+    const CuMatrixBase<BaseFloat> &alpha,
+    CuMatrix<BaseFloat> *derivs) {
+  const int32 num_sequences = supervision_.num_sequences,
+      num_frames = supervision_.frames_per_sequence,
+      num_states = state_offsets_[num_sequences];
+  CuMatrix<BaseFloat> beta(2, num_states, kUndefined);
+  derivs->Resize(probs.NumRows(), probs.NumCols());
+
+  CuTimer tim;
+  dim3 dimBlock(CU1DBLOCK), dimGrid(num_sequences);
+  cuda_chain_numerator_backward(dimGrid, dimBlock, cu_state_offsets_.Data(),
+                                cu_forward_transitions_.Data(),
+                                cu_transitions_.Data(), num_sequences,
+                                num_frames, probs.Data(), probs.Stride(),
+                                cu_final_probs_.Data(),
+                                alpha.Data(), alpha.Stride(),
+                                beta.Data(), beta.Stride(),
+                                derivs->Data(), derivs->Stride());
+  CU_SAFE_CALL(cudaGetLastError());
+  CuDevice::Instantiate().AccuProfile(__func__, tim);
+}
+#endif
+
 BaseFloat GenericNumeratorComputation::GetTotalProb(
                                           const Matrix<BaseFloat> &alpha) {
   return alpha(alpha.NumRows() - 1, alpha.NumCols() - 1);
@@ -315,8 +432,11 @@ void GenericNumeratorComputation::BetaRemainingFrames(int seq,
     for (int32 h = 0; h < supervision_.e2e_fsts[seq].NumStates(); h++) {
       BaseFloat tot_variable_factor;
       tot_variable_factor = -std::numeric_limits<BaseFloat>::infinity();
-      for (auto tr = out_transitions_[seq][h].begin();
-               tr != out_transitions_[seq][h].end(); ++tr) {
+      const Int32Pair &range = forward_transitions_[state_offsets_[seq] + h];
+      for (const DenominatorGraphTransition
+               *tr = &(transitions_[0]) + range.first,
+               *end = &(transitions_[0]) + range.second;
+           tr != end; ++tr) {
         BaseFloat transition_prob = tr->transition_prob;
         int32 pdf_id = tr->pdf_id,
             next_hmm_state = tr->hmm_state;
@@ -337,7 +457,7 @@ void GenericNumeratorComputation::BetaRemainingFrames(int seq,
 
 
 void GenericNumeratorComputation::AddSpecificPdfsIndirect(
-                                 Matrix<BaseFloat> *logprobs,
+                                 CuMatrix<BaseFloat> *probs,
                                  const std::vector<MatrixIndexT> &indices,
                                  CuMatrixBase<BaseFloat> *output) {
   const int32 num_sequences = supervision_.num_sequences,
@@ -348,8 +468,7 @@ void GenericNumeratorComputation::AddSpecificPdfsIndirect(
   KALDI_ASSERT(frames_per_sequence * num_sequences == output->NumRows());
 
   CuMatrix<BaseFloat> specific_pdfs;
-  specific_pdfs.Swap(logprobs);
-  specific_pdfs.ApplyExp();
+  specific_pdfs.Swap(probs);
   specific_pdfs.Scale(supervision_.weight);
 
   std::vector<MatrixIndexT> indices_expanded(view_stride, -1);
@@ -372,16 +491,13 @@ void GenericNumeratorComputation::AddSpecificPdfsIndirect(
 }
 
 bool GenericNumeratorComputation::CheckValues(int seq,
-                                            const Matrix<BaseFloat> &probs,
-                                            const Matrix<BaseFloat> &alpha,
-                                            const Matrix<BaseFloat> &beta,
                                             const Matrix<BaseFloat> &derivs) const {
   const int32 num_frames = supervision_.frames_per_sequence;
   // only check the derivs for the first and last frames
   const std::vector<int32> times = {0, num_frames - 1};
   for (const int32 t: times) {
     BaseFloat deriv_sum = 0.0;
-    for (int32 n = 0; n < probs.NumCols(); n++) {
+    for (int32 n = 0; n < derivs.NumCols(); n++) {
       int32 pdf_stride = nnet_output_.Stride();
       int32 pdf2seq = index_to_pdf_[n] / pdf_stride;
       if (pdf2seq != seq)  // this pdf is not in the space of this sequence
@@ -36,6 +36,7 @@
 #include "chain/chain-supervision.h"
 #include "cudamatrix/cu-matrix.h"
 #include "cudamatrix/cu-array.h"
+#include "cudamatrix/cu-vector.h"
 #include "chain/chain-datastruct.h"
 
 namespace kaldi {
@@ -65,10 +66,18 @@ namespace chain {
    class GenericNumeratorComputation is responsible for doing Forward-Backward
    on a generic FST (i.e. the kind of FST we use in end-to-end chain
    training). It is the same as DenominatorComputation with 2 differences:
-   [1] it runs on CPU
+   [1] each sequence has its own graph
    [2] it does not use leakyHMM
    The F-B computation is done in log-domain.
 
+   In the constructor, the FSTs of all the sequences are converted to a single
+   array of transitions indexed by ranges for each state (in the same way as
+   in class DenominatorGraph), with the states of the sequences numbered
+   consecutively.  If we are using a GPU, the forward and backward computations
+   are each done by a single kernel with one block of threads per sequence,
+   which goes through all the frames; otherwise they are done on the CPU, one
+   sequence at a time.
+
    When the 'e2e' flag of a supervision is set, the ComputeChainObjfAndDeriv
    function in chain-training.cc uses GenericNumeratorComputation (instead
    of NumeratorCompuation) to compute the numerator derivatives.
@@ -125,20 +134,21 @@ class GenericNumeratorComputation {
 
   BaseFloat ComputeObjf();
  private:
-  // For the remapped FSTs, copy the appropriate activations to CPU memory.
+  // For the remapped FSTs, copy the appropriate activations to 'output'.
   // For explanation of what remapped FST is, see the large comment in the
   // beginning of the file
   void CopySpecificPdfsIndirect(
                              const CuMatrixBase<BaseFloat> &nnet_output,
                              const std::vector<MatrixIndexT> &indices,
-                             Matrix<BaseFloat> *output);
+                             CuMatrix<BaseFloat> *output);
 
-  // For the remapped FSTs, copy the computed values back to gpu,
-  // expand to the original shape and add to the output matrix.
+  // For the remapped FSTs, expand the computed occupation probabilities (not
+  // their logs) to the original shape and add them, times supervision_.weight,
+  // to the output matrix.  'probs' is destroyed.
   // For explanation of what remapped FST is, see the large comment in the
   // beginning of the file.
   void AddSpecificPdfsIndirect(
-                             Matrix<BaseFloat> *logprobs,
+                             CuMatrix<BaseFloat> *probs,
                              const std::vector<MatrixIndexT> &indices,
                              CuMatrixBase<BaseFloat> *output);
 
@@ -164,17 +174,32 @@ class GenericNumeratorComputation {
                      const Matrix<BaseFloat> &alpha,
                      Matrix<BaseFloat> *beta);
 
+#if HAVE_CUDA == 1
+  // Does the forward computation for all sequences on the GPU and returns the
+  // total log-prob, not including supervision_.weight.  'probs' is as
+  // returned by CopySpecificPdfsIndirect(); 'alpha' is set to the alphas, with
+  // the num-frames + 1 rows and a column for each state of each sequence,
+  // followed by the alpha-sums for each sequence.
+  BaseFloat ForwardGpu(const CuMatrixBase<BaseFloat> &probs,
+                       CuMatrix<BaseFloat> *alpha);
+
+  // Does the backward computation for all sequences on the GPU, given the
+  // alphas from ForwardGpu(), and sets 'derivs' (which has the same dimension
+  // as 'probs') to the occupation probabilities (not their logs).
+  void BackwardGpu(const CuMatrixBase<BaseFloat> &probs,
+                   const CuMatrixBase<BaseFloat> &alpha,
+                   CuMatrix<BaseFloat> *derivs);
+#endif
+
   // returns total prob for the given matrix alpha (assumes the alpha
   // matrix was computed using AlphaFirstFrame() and AlphaRemainingFrames()
   // (it's exactly like 'tot_probe_' in DenominatorComputation)
   BaseFloat GetTotalProb(const Matrix<BaseFloat> &alpha);
 
   // some checking that we can do if debug mode is activated, or on frame zero.
+  // 'derivs' are the logs of the occupation probabilities.
   // Returns false if a bad problem is detected.
   bool CheckValues(int32 seq,
-                   const Matrix<BaseFloat> &probs,
-                   const Matrix<BaseFloat> &alpha,
-                   const Matrix<BaseFloat> &beta,
                    const Matrix<BaseFloat> &derivs) const;
 
 
@@ -185,11 +210,19 @@ class GenericNumeratorComputation {
   int32 nnet_output_stride_;   // we keep the original stride extra
                                // as the matrix can change before ForwardBackward
 
-  // in_transitions_ lists all the incoming transitions for
-  // each state of each numerator graph
-  // out_transitions_ does the same but for the outgoing transitions
-  typedef std::vector<std::vector<DenominatorGraphTransition> > TransitionMap;
-  std::vector<TransitionMap> in_transitions_, out_transitions_;
+  // state_offsets_[seq] is the index of the first state of sequence 'seq'
+  // in the numbering of the states of all the sequences that we use for
+  // forward_transitions_ and backward_transitions_; it has dimension
+  // num_sequences + 1, so the last element is the total number of states.
+  std::vector<int32> state_offsets_;
+  // forward_transitions_ is indexed by state (in the numbering over all
+  // sequences), and gives the start and end indexes into transitions_ of
+  // the transitions out of that state; backward_transitions_ does the same
+  // for the transitions into that state.  The hmm_state of the transitions is
+  // the state (within the sequence) at the other end of the transition, and
+  // the pdf_id is the index into index_to_pdf_.
+  std::vector<Int32Pair> forward_transitions_, backward_transitions_;
+  std::vector<DenominatorGraphTransition> transitions_;
   std::vector<MatrixIndexT> index_to_pdf_;
 
   // final probs for each state of each numerator graph
@@ -198,6 +231,16 @@ class GenericNumeratorComputation {
   // an offset subtracted from the logprobs of transitions out of the first
   // state of each graph to help reduce numerical problems.
   Vector<BaseFloat> offsets_;
+
+  // Copies of state_offsets_, forward_transitions_, backward_transitions_,
+  // transitions_ and offsets_ on the GPU, and the final probs indexed by
+  // the state in the numbering over all sequences; only set up if we are
+  // using a GPU.
+  CuArray<int32> cu_state_offsets_;
+  CuArray<Int32Pair> cu_forward_transitions_, cu_backward_transitions_;
+  CuArray<DenominatorGraphTransition> cu_transitions_;
+  CuVector<BaseFloat> cu_final_probs_;
+  CuVector<BaseFloat> cu_offsets_;
 };
 
 }  // namespace chain
@@ -34,6 +34,7 @@ extern "C" {
                                int32_cuda prob_stride,
                                const BaseFloat *this_alpha,
                                const BaseFloat *next_beta,
+                               const BaseFloat *next_beta_sum,
                                BaseFloat *this_beta,
                                BaseFloat *log_prob_deriv,
                                int32_cuda log_prob_deriv_stride);
@@ -45,9 +46,46 @@ extern "C" {
                               int32_cuda num_hmm_states,
                               const BaseFloat *probs,
                               int32_cuda prob_stride,
+                              const BaseFloat *initial_probs,
+                              BaseFloat leaky_hmm_coefficient,
                               const BaseFloat *prev_alpha,
                               BaseFloat *this_alpha);
 
+  void cuda_chain_hmm_alpha_dash(dim3 Gr, dim3 Bl,
+                                 int32_cuda num_frames,
+                                 int32_cuda num_sequences,
+                                 int32_cuda num_hmm_states,
+                                 const BaseFloat *initial_probs,
+                                 BaseFloat leaky_hmm_coefficient,
+                                 BaseFloat *alpha, int32_cuda alpha_stride);
+
+  void cuda_chain_numerator_forward(dim3 Gr, dim3 Bl,
+                                    const int32_cuda *state_offsets,
+                                    const Int32Pair *backward_transitions,
+                                    const DenominatorGraphTransition *transitions,
+                                    int32_cuda num_sequences,
+                                    int32_cuda num_frames,
+                                    const BaseFloat *probs,
+                                    int32_cuda prob_stride,
+                                    const BaseFloat *final_probs,
+                                    const BaseFloat *offsets,
+                                    BaseFloat *alpha, int32_cuda alpha_stride,
+                                    BaseFloat *tot_log_prob);
+
+  void cuda_chain_numerator_backward(dim3 Gr, dim3 Bl,
+                                     const int32_cuda *state_offsets,
+                                     const Int32Pair *forward_transitions,
+                                     const DenominatorGraphTransition *transitions,
+                                     int32_cuda num_sequences,
+                                     int32_cuda num_frames,
+                                     const BaseFloat *probs,
+                                     int32_cuda prob_stride,
+                                     const BaseFloat *final_probs,
+                                     const BaseFloat *alpha,
+                                     int32_cuda alpha_stride,
+                                     BaseFloat *beta, int32_cuda beta_stride,
+                                     BaseFloat *deriv, int32_cuda deriv_stride);
+
   void cuda_penalize_out_of_range(dim3 Gr, dim3 Bl, BaseFloat limit,
                                   BaseFloat scale, const BaseFloat *in_data,
                                   MatrixDim dim, int out_stride,
@@ -18,6 +18,7 @@
 
 
 #include <cfloat>
+#include <math_constants.h>
 #include "chain/chain-kernels-ansi.h"
 
 #if defined(__CUDA_ARCH__) && __CUDA_ARCH__ < 200
@@ -107,6 +108,8 @@ static void _cuda_chain_hmm_forward(const Int32Pair *backward_transitions,
                                     int32_cuda num_hmm_states,
                                     const BaseFloat *probs,
                                     int32_cuda prob_stride,
+                                    const BaseFloat *initial_probs,
+                                    BaseFloat leaky_hmm_coefficient,
                                     const BaseFloat *prev_alpha,
                                     BaseFloat *this_alpha) {
   // 'backward_transitions', indexed by hmm-state, consists of [start, end]
@@ -116,6 +119,10 @@ static void _cuda_chain_hmm_forward(const Int32Pair *backward_transitions,
   // stride is 'prob_stride'.  'prev_alpha' and 'this_alpha', which are
   // extracted from a larger matrix, both have dimension num-history-states by
   // num-sequences.
+  // 'prev_alpha' contains the alpha (not the alpha-dash) of the previous
+  // frame, followed by its alpha-sums; we work out the alpha-dash,
+  // alpha + alpha-sum * leaky_hmm_coefficient * initial_probs (this relates
+  // to leaky HMM), as we read it.
 
   // s is the index of the sequence within the minibatch,
   // from 0 .. num-egs-in-this-minibatch - 1.
@@ -125,6 +132,8 @@ static void _cuda_chain_hmm_forward(const Int32Pair *backward_transitions,
   if (s >= num_sequences)
     return;
 
+  BaseFloat prev_alpha_sum = prev_alpha[num_hmm_states * num_sequences + s],
+      leaky_scale = leaky_hmm_coefficient * prev_alpha_sum;
   double this_tot_alpha = 0.0;
   const DenominatorGraphTransition
       *trans_iter = transitions + backward_transitions[h].first,
@@ -143,9 +152,11 @@ static void _cuda_chain_hmm_forward(const Int32Pair *backward_transitions,
     int32_cuda pdf_id1 = trans_iter[1].pdf_id,
         prev_hmm_state1 = trans_iter[1].hmm_state;
     BaseFloat pseudo_loglike0 = probs[pdf_id0 * prob_stride + s],
-             this_prev_alpha0 = prev_alpha[prev_hmm_state0 * num_sequences + s],
+             this_prev_alpha0 = prev_alpha[prev_hmm_state0 * num_sequences + s] +
+                          leaky_scale * initial_probs[prev_hmm_state0],
               pseudo_loglike1 = probs[pdf_id1 * prob_stride + s],
-             this_prev_alpha1 = prev_alpha[prev_hmm_state1 * num_sequences + s];
+             this_prev_alpha1 = prev_alpha[prev_hmm_state1 * num_sequences + s] +
+                          leaky_scale * initial_probs[prev_hmm_state1];
 
     this_tot_alpha += this_prev_alpha0 * transition_prob0 * pseudo_loglike0 +
                        this_prev_alpha1 * transition_prob1 * pseudo_loglike1;
@@ -156,7 +167,8 @@ static void _cuda_chain_hmm_forward(const Int32Pair *backward_transitions,
     int32_cuda pdf_id0 = trans_iter[0].pdf_id,
        prev_hmm_state0 = trans_iter[0].hmm_state;
     BaseFloat pseudo_loglike0 = probs[pdf_id0 * prob_stride + s],
-             this_prev_alpha0 = prev_alpha[prev_hmm_state0 * num_sequences + s];
+             this_prev_alpha0 = prev_alpha[prev_hmm_state0 * num_sequences + s] +
+                          leaky_scale * initial_probs[prev_hmm_state0];
     this_tot_alpha += this_prev_alpha0 * transition_prob0 * pseudo_loglike0;
   }
 
@@ -169,18 +181,47 @@ static void _cuda_chain_hmm_forward(const Int32Pair *backward_transitions,
   // range.  This won't affect the posteriors, as it's just a constant factor
   // for each frame, but when computing the total likelihood we'll need to
   // compensate for it later on.
-  BaseFloat arbitrary_scale =
-      1.0 / prev_alpha[num_hmm_states * num_sequences + s];
+  BaseFloat arbitrary_scale = 1.0 / prev_alpha_sum;
   this_alpha[h * num_sequences + s] = this_tot_alpha * arbitrary_scale;
 }
 
 
+// This turns the alphas of all frames into alpha-dashes (this relates to leaky
+// HMM), with alpha_dash(t, h, s) = alpha(t, h, s) + leaky_hmm_coefficient *
+// initial_probs[h] * alpha_sum(t, s); it is done once, after the forward
+// computation.  As in the forward computation, the grid y determines the
+// HMM-state and the block x and grid x the sequence; each thread does all the
+// frames.  Row t of 'alpha' (with stride 'alpha_stride') contains the alphas
+// for frame t, with the alpha-sums in the place where the alphas for state
+// 'num_hmm_states' would go.
+__global__
+static void _cuda_chain_hmm_alpha_dash(int32_cuda num_frames,
+                                       int32_cuda num_sequences,
+                                       int32_cuda num_hmm_states,
+                                       const BaseFloat *initial_probs,
+                                       BaseFloat leaky_hmm_coefficient,
+                                       BaseFloat *alpha,
+                                       int32_cuda alpha_stride) {
+  int32_cuda s = threadIdx.x + blockIdx.x * blockDim.x,
+      h = blockIdx.y;
+  if (s >= num_sequences)
+    return;
+  BaseFloat scale = leaky_hmm_coefficient * initial_probs[h];
+  for (int32_cuda t = 0; t < num_frames; t++) {
+    BaseFloat *this_alpha = alpha + t * alpha_stride;
+    this_alpha[h * num_sequences + s] +=
+        scale * this_alpha[num_hmm_states * num_sequences + s];
+  }
+}
+
+
 __global__
 static void _cuda_chain_hmm_backward(const Int32Pair *forward_transitions,
                                      const DenominatorGraphTransition *transitions,
                                      int32_cuda num_sequences, int32_cuda num_hmm_states,
                                      const BaseFloat *probs, int32_cuda prob_stride,
                                      const BaseFloat *this_alpha, const BaseFloat *next_beta,
+                                     const BaseFloat *next_beta_sum,
                                      BaseFloat *this_beta, BaseFloat *log_prob_deriv,
                                      int32_cuda log_prob_deriv_stride) {
   // 'forward_transitions', indexed by hmm-state, consists of [start, end]
@@ -191,6 +232,10 @@ static void _cuda_chain_hmm_backward(const Int32Pair *forward_transitions,
   // prob_stride.
   // 'this_alpha', 'next_beta' and 'this_beta' all have dimension
   // num-history-states by num-sequences.
+  // 'next_beta' contains the beta-dash (not the beta) of the next frame; we
+  // work out the beta, beta-dash + beta-dash-sum (this relates to leaky HMM),
+  // as we read it.  'next_beta_sum' contains the beta-dash-sums of the next
+  // frame, one per sequence.
   // The beta probs are normalized in such a way (by multiplying by 1/(total-data-prob))
   // that to get occupation counts we don't need to multiply by 1/total-data-prob.
   // deriv_scale is a factor (e.g. -1.0 or -0.99) that we multiply these derivs by
@@ -209,6 +254,7 @@ static void _cuda_chain_hmm_backward(const Int32Pair *forward_transitions,
   BaseFloat this_alpha_prob = this_alpha[h * num_sequences + s],
       inv_arbitrary_scale =
       this_alpha[num_hmm_states * num_sequences + s];
+  BaseFloat next_beta_dash_sum = next_beta_sum[s];
   double tot_variable_factor = 0.0;
 
   BaseFloat occupation_factor = this_alpha_prob / inv_arbitrary_scale;
@@ -225,10 +271,10 @@ static void _cuda_chain_hmm_backward(const Int32Pair *forward_transitions,
     int32_cuda pdf_id1 = trans_iter[1].pdf_id,
         next_hmm_state1 = trans_iter[1].hmm_state;
     BaseFloat variable_factor0 = transition_prob0 *
-        next_beta[next_hmm_state0 * num_sequences + s] *
+        (next_beta[next_hmm_state0 * num_sequences + s] + next_beta_dash_sum) *
                     probs[pdf_id0 * prob_stride + s],
          variable_factor1 = transition_prob1 *
-        next_beta[next_hmm_state1 * num_sequences + s] *
+        (next_beta[next_hmm_state1 * num_sequences + s] + next_beta_dash_sum) *
                     probs[pdf_id1 * prob_stride + s];
     tot_variable_factor += variable_factor0 + variable_factor1;
     BaseFloat occupation_prob0 = variable_factor0 * occupation_factor;
@@ -244,7 +290,7 @@ static void _cuda_chain_hmm_backward(const Int32Pair *forward_transitions,
     int32_cuda pdf_id0 = trans_iter[0].pdf_id,
         next_hmm_state0 = trans_iter[0].hmm_state;
     BaseFloat variable_factor0 = transition_prob0 *
-        next_beta[next_hmm_state0 * num_sequences + s] *
+        (next_beta[next_hmm_state0 * num_sequences + s] + next_beta_dash_sum) *
                       probs[pdf_id0 * prob_stride + s];
     tot_variable_factor += variable_factor0;
     BaseFloat occupation_prob0 = variable_factor0 * occupation_factor;
@@ -262,14 +308,30 @@ void cuda_chain_hmm_forward(dim3 Gr, dim3 Bl,
                             int32_cuda num_sequences,
                             int32_cuda num_hmm_states,
                             const BaseFloat *probs, int32_cuda prob_stride,
+                            const BaseFloat *initial_probs,
+                            BaseFloat leaky_hmm_coefficient,
                             const BaseFloat *prev_alpha,
                             BaseFloat *this_alpha) {
   _cuda_chain_hmm_forward<<<Gr,Bl>>>(backward_transitions, transitions,
                                      num_sequences, num_hmm_states,
                                      probs, prob_stride,
+                                     initial_probs, leaky_hmm_coefficient,
                                      prev_alpha, this_alpha);
 }
 
+void cuda_chain_hmm_alpha_dash(dim3 Gr, dim3 Bl,
+                               int32_cuda num_frames,
+                               int32_cuda num_sequences,
+                               int32_cuda num_hmm_states,
+                               const BaseFloat *initial_probs,
+                               BaseFloat leaky_hmm_coefficient,
+                               BaseFloat *alpha, int32_cuda alpha_stride) {
+  _cuda_chain_hmm_alpha_dash<<<Gr,Bl>>>(num_frames, num_sequences,
+                                        num_hmm_states, initial_probs,
+                                        leaky_hmm_coefficient,
+                                        alpha, alpha_stride);
+}
+
 void cuda_chain_hmm_backward(dim3 Gr, dim3 Bl,
                              const Int32Pair *forward_transitions,
                              const DenominatorGraphTransition *transitions,
@@ -277,18 +339,238 @@ void cuda_chain_hmm_backward(dim3 Gr, dim3 Bl,
                              int32_cuda num_hmm_states,
                              const BaseFloat *probs, int32_cuda prob_stride,
                              const BaseFloat *this_alpha, const BaseFloat *next_beta,
+                             const BaseFloat *next_beta_sum,
                              BaseFloat *this_beta,
                              BaseFloat *log_prob_deriv,
                              int32_cuda log_prob_deriv_stride) {
   _cuda_chain_hmm_backward<<<Gr,Bl>>>(forward_transitions, transitions,
                                       num_sequences, num_hmm_states,
                                       probs, prob_stride,
-                                      this_alpha, next_beta,
+                                      this_alpha, next_beta, next_beta_sum,
                                       this_beta, log_prob_deriv,
                                       log_prob_deriv_stride);
 }
 
 
+// Returns log(exp(x) + exp(y)).
+__device__ inline BaseFloat log_add(BaseFloat x, BaseFloat y) {
+  if (x < y) {
+    BaseFloat tmp = x;
+    x = y;
+    y = tmp;
+  }
+  // now x >= y.
+  if (isinf(y))  // y == -inf (or x == y == inf).
+    return x;
+  return x + log1p(exp(y - x));
+}
+
+// Returns the log of the sum of exp(x[i]) for 0 <= i < n, to all the threads
+// of the block; it must be called by all the threads of the block, whose size
+// must be CU1DBLOCK.  The caller must synchronize the threads after writing x.
+__device__ static BaseFloat block_log_sum_exp(const BaseFloat *x,
+                                              int32_cuda n) {
+  __shared__ BaseFloat buf[CU1DBLOCK];
+  int32_cuda tid = threadIdx.x;
+  BaseFloat max = -CUDART_INF_F;
+  for (int32_cuda i = tid; i < n; i += CU1DBLOCK)
+    max = fmax(max, x[i]);
+  buf[tid] = max;
+  __syncthreads();
+  for (int32_cuda shift = CU1DBLOCK / 2; shift > 0; shift >>= 1) {
+    if (tid < shift)
+      buf[tid] = fmax(buf[tid], buf[tid + shift]);
+    __syncthreads();
+  }
+  max = buf[0];
+  __syncthreads();
+  if (isinf(max))  // all the x are -inf (or some are +inf).
+    return max;
+  BaseFloat sum = 0.0;
+  for (int32_cuda i = tid; i < n; i += CU1DBLOCK)
+    sum += exp(x[i] - max);
+  buf[tid] = sum;
+  __syncthreads();
+  for (int32_cuda shift = CU1DBLOCK / 2; shift > 0; shift >>= 1) {
+    if (tid < shift)
+      buf[tid] += buf[tid + shift];
+    __syncthreads();
+  }
+  BaseFloat ans = max + log(buf[0]);
+  __syncthreads();
+  return ans;
+}
+
+// The forward computation for the end-to-end (generic) numerator graphs; see
+// GenericNumeratorComputation::AlphaRemainingFrames() for the CPU version,
+// which this follows.  It is done in log space.  There is one block per
+// sequence (blockIdx.x is the sequence), and the threads of the block go
+// through the states of that sequence's graph, for each frame in turn.  The
+// states of sequence 'seq' are numbered from state_offsets[seq] to
+// state_offsets[seq + 1] - 1 in 'backward_transitions' and in the columns of
+// 'alpha'; the column state_offsets[num_sequences] + seq of 'alpha' is for the
+// alpha-sums of sequence 'seq'.  'alpha' has num_frames + 1 rows and 'probs'
+// (the nnet outputs, indexed by the pdf_id of the transitions) num_frames rows.
+// The total log-prob of each sequence is written to 'tot_log_prob'.
+__global__
+static void _cuda_chain_numerator_forward(
+    const int32_cuda *state_offsets,
+    const Int32Pair *backward_transitions,
+    const DenominatorGraphTransition *transitions,
+    int32_cuda num_sequences, int32_cuda num_frames,
+    const BaseFloat *probs, int32_cuda prob_stride,
+    const BaseFloat *final_probs, const BaseFloat *offsets,
+    BaseFloat *alpha, int32_cuda alpha_stride,
+    BaseFloat *tot_log_prob) {
+  int32_cuda seq = blockIdx.x, tid = threadIdx.x,
+      begin = state_offsets[seq],
+      num_states = state_offsets[seq + 1] - begin,
+      sum_index = state_offsets[num_sequences] + seq;
+  for (int32_cuda h = tid; h < num_states; h += CU1DBLOCK)
+    alpha[begin + h] = (h == 0 ? 0.0 : -CUDART_INF_F);
+  if (tid == 0)
+    alpha[sum_index] = 0.0;
+  __syncthreads();
+
+  double log_scale_product = 0.0;
+  for (int32_cuda t = 1; t <= num_frames; t++) {
+    const BaseFloat *alpha_tm1 = alpha + (t - 1) * alpha_stride,
+        *probs_tm1 = probs + (t - 1) * prob_stride;
+    BaseFloat *alpha_t = alpha + t * alpha_stride;
+    BaseFloat prev_sum = alpha_tm1[sum_index];
+    for (int32_cuda h = tid; h < num_states; h += CU1DBLOCK) {
+      BaseFloat this_alpha = -CUDART_INF_F;
+      const DenominatorGraphTransition
+          *trans_iter = transitions + backward_transitions[begin + h].first,
+          *trans_end = transitions + backward_transitions[begin + h].second;
+      for (; trans_iter != trans_end; ++trans_iter)
+        this_alpha = log_add(this_alpha,
+                             alpha_tm1[begin + trans_iter->hmm_state] +
+                             trans_iter->transition_prob +
+                             probs_tm1[trans_iter->pdf_id]);
+      alpha_t[begin + h] = this_alpha - prev_sum;
+    }
+    __syncthreads();
+    BaseFloat sum = block_log_sum_exp(alpha_t + begin, num_states);
+    if (tid == 0)
+      alpha_t[sum_index] = sum;
+    log_scale_product += sum;
+    __syncthreads();
+  }
+
+  // include the final-probs in the last alpha.
+  BaseFloat *alpha_last = alpha + num_frames * alpha_stride;
+  log_scale_product -= alpha_last[sum_index];
+  for (int32_cuda h = tid; h < num_states; h += CU1DBLOCK)
+    alpha_last[begin + h] += final_probs[begin + h];
+  __syncthreads();
+  BaseFloat sum = block_log_sum_exp(alpha_last + begin, num_states);
+  if (tid == 0) {
+    alpha_last[sum_index] = sum;
+    tot_log_prob[seq] = (sum - offsets[seq]) + log_scale_product;
+  }
+}
+
+// The backward computation for the end-to-end (generic) numerator graphs; see
+// GenericNumeratorComputation::BetaRemainingFrames() for the CPU version, and
+// _cuda_chain_numerator_forward() for the layout of the arguments.  'alpha' is
+// as output by the forward computation; 'beta' has 2 rows (for alternate
+// frames) and a column for each state of each sequence.  The occupation
+// probabilities (not their logs) are added to 'deriv', which has num_frames
+// rows; its columns, like those of 'probs', are indexed by the pdf_id of the
+// transitions.
+__global__
+static void _cuda_chain_numerator_backward(
+    const int32_cuda *state_offsets,
+    const Int32Pair *forward_transitions,
+    const DenominatorGraphTransition *transitions,
+    int32_cuda num_sequences, int32_cuda num_frames,
+    const BaseFloat *probs, int32_cuda prob_stride,
+    const BaseFloat *final_probs,
+    const BaseFloat *alpha, int32_cuda alpha_stride,
+    BaseFloat *beta, int32_cuda beta_stride,
+    BaseFloat *deriv, int32_cuda deriv_stride) {
+  int32_cuda seq = blockIdx.x, tid = threadIdx.x,
+      begin = state_offsets[seq],
+      num_states = state_offsets[seq + 1] - begin,
+      sum_index = state_offsets[num_sequences] + seq;
+  BaseFloat tot_prob = alpha[num_frames * alpha_stride + sum_index];
+  BaseFloat *beta_last = beta + (num_frames % 2) * beta_stride;
+  for (int32_cuda h = tid; h < num_states; h += CU1DBLOCK)
+    beta_last[begin + h] = final_probs[begin + h] - tot_prob;
+  __syncthreads();
+
+  for (int32_cuda t = num_frames - 1; t >= 0; t--) {
+    const BaseFloat *alpha_t = alpha + t * alpha_stride,
+        *beta_tp1 = beta + ((t + 1) % 2) * beta_stride,
+        *probs_t = probs + t * prob_stride;
+    BaseFloat *beta_t = beta + (t % 2) * beta_stride,
+        *deriv_t = deriv + t * deriv_stride;
+    BaseFloat inv_arbitrary_scale = alpha_t[sum_index];
+    for (int32_cuda h = tid; h < num_states; h += CU1DBLOCK) {
+      BaseFloat this_alpha = alpha_t[begin + h],
+          tot_variable_factor = -CUDART_INF_F;
+      const DenominatorGraphTransition
+          *trans_iter = transitions + forward_transitions[begin + h].first,
+          *trans_end = transitions + forward_transitions[begin + h].second;
+      for (; trans_iter != trans_end; ++trans_iter) {
+        int32_cuda pdf_id = trans_iter->pdf_id;
+        BaseFloat variable_factor = trans_iter->transition_prob +
+            beta_tp1[begin + trans_iter->hmm_state] +
+            probs_t[pdf_id] - inv_arbitrary_scale;
+        tot_variable_factor = log_add(tot_variable_factor, variable_factor);
+        BaseFloat occupation_prob = exp(variable_factor + this_alpha);
+        if (occupation_prob != 0.0)
+          atomic_add(deriv_t + pdf_id, occupation_prob);
+      }
+      beta_t[begin + h] = tot_variable_factor;
+    }
+    __syncthreads();
+  }
+}
+
+
+void cuda_chain_numerator_forward(dim3 Gr, dim3 Bl,
+                                  const int32_cuda *state_offsets,
+                                  const Int32Pair *backward_transitions,
+                                  const DenominatorGraphTransition *transitions,
+                                  int32_cuda num_sequences,
+                                  int32_cuda num_frames,
+                                  const BaseFloat *probs,
+                                  int32_cuda prob_stride,
+                                  const BaseFloat *final_probs,
+                                  const BaseFloat *offsets,
+                                  BaseFloat *alpha, int32_cuda alpha_stride,
+                                  BaseFloat *tot_log_prob) {
+  _cuda_chain_numerator_forward<<<Gr,Bl>>>(state_offsets, backward_transitions,
+                                           transitions, num_sequences,
+                                           num_frames, probs, prob_stride,
+                                           final_probs, offsets,
+                                           alpha, alpha_stride, tot_log_prob);
+}
+
+void cuda_chain_numerator_backward(dim3 Gr, dim3 Bl,
+                                   const int32_cuda *state_offsets,
+                                   const Int32Pair *forward_transitions,
+                                   const DenominatorGraphTransition *transitions,
+                                   int32_cuda num_sequences,
+                                   int32_cuda num_frames,
+                                   const BaseFloat *probs,
+                                   int32_cuda prob_stride,
+                                   const BaseFloat *final_probs,
+                                   const BaseFloat *alpha,
+                                   int32_cuda alpha_stride,
+                                   BaseFloat *beta, int32_cuda beta_stride,
+                                   BaseFloat *deriv, int32_cuda deriv_stride) {
+  _cuda_chain_numerator_backward<<<Gr,Bl>>>(state_offsets, forward_transitions,
+                                            transitions, num_sequences,
+                                            num_frames, probs, prob_stride,
+                                            final_probs, alpha, alpha_stride,
+                                            beta, beta_stride,
+                                            deriv, deriv_stride);
+}
+
+
 // See documentation for PenalizeOutOfRange() in chain-training.cc to see what
 // this is about.
 __global__
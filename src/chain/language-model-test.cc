@@ -98,6 +98,23 @@ void LanguageModelTest() {
   KALDI_ASSERT(fst.Properties(fst::kIEpsilons, true) == 0);
 
   ShowPerplexity(fst, data);
+
+  // Collecting the counts in blocks, and computing the backoff costs with a
+  // different number of threads, should give exactly the same LM.
+  int32 num_threads_saved = g_num_threads;
+  g_num_threads = RandInt(1, 4);
+  LanguageModelEstimator estimator2(opts);
+  size_t block_size = RandInt(1, 50);
+  for (size_t i = 0; i < data.size(); i += block_size) {
+    PhoneNgramCounts counts(opts);
+    for (size_t j = i; j < data.size() && j < i + block_size; j++)
+      counts.AddSentence(data[j]);
+    estimator2.AddCounts(counts);
+  }
+  fst::StdVectorFst fst2;
+  estimator2.Estimate(&fst2);
+  g_num_threads = num_threads_saved;
+  KALDI_ASSERT(fst::Equal(fst, fst2));
 }
 
 
@@ -20,12 +20,52 @@
 #include <algorithm>
 #include <numeric>
 #include "chain/language-model.h"
+#include "util/kaldi-thread.h"
 #include "util/simple-io-funcs.h"
 
 
 namespace kaldi {
 namespace chain {
 
+PhoneNgramCounts::PhoneNgramCounts(const LanguageModelOptions &opts):
+    ngram_order_(opts.ngram_order) {
+  KALDI_ASSERT(opts.ngram_order >= 2 && "--ngram-order must be >= 2");
+  KALDI_ASSERT(opts.ngram_order >= opts.no_prune_ngram_order);
+}
+
+void PhoneNgramCounts::AddSentence(const std::vector<int32> &sentence) {
+  // 'ngram' is the history (as in LanguageModelEstimator::AddCounts())
+  // followed by the next phone.
+  std::vector<int32> ngram(1, 0);
+  size_t num_words = sentence.size();
+  for (size_t i = 0; i <= num_words; i++) {
+    int32 next_phone = (i < num_words ? sentence[i] : 0);
+    KALDI_ASSERT(i == num_words || next_phone != 0);
+    ngram.push_back(next_phone);
+    std::pair<MapType::iterator, bool> ret =
+        ngram_index_.insert(std::pair<const std::vector<int32>, int32>(
+            ngram, ngrams_.size()));
+    if (ret.second)
+      ngrams_.push_back(std::pair<std::vector<int32>, int32>(ngram, 1));
+    else
+      ngrams_[ret.first->second].second++;
+    if (ngram.size() >= ngram_order_)
+      ngram.erase(ngram.begin());
+  }
+}
+
+void LanguageModelEstimator::AddCounts(const PhoneNgramCounts &counts) {
+  const std::vector<std::pair<std::vector<int32>, int32> > &ngrams =
+      counts.Ngrams();
+  std::vector<int32> history;
+  for (size_t i = 0; i < ngrams.size(); i++) {
+    const std::vector<int32> &ngram = ngrams[i].first;
+    KALDI_ASSERT(ngram.size() >= 2 && ngram.size() <= opts_.ngram_order);
+    history.assign(ngram.begin(), ngram.end() - 1);
+    IncrementCount(history, ngram.back(), ngrams[i].second);
+  }
+}
+
 void LanguageModelEstimator::AddCounts(const std::vector<int32> &sentence) {
   KALDI_ASSERT(opts_.ngram_order >= 2 && "--ngram-order must be >= 2");
   KALDI_ASSERT(opts_.ngram_order >= opts_.no_prune_ngram_order);
@@ -36,23 +76,23 @@ void LanguageModelEstimator::AddCounts(const std::vector<int32> &sentence) {
       end = sentence.end();
   for (; iter != end; ++iter) {
     KALDI_ASSERT(*iter != 0);
-    IncrementCount(history, *iter);
+    IncrementCount(history, *iter, 1);
     history.push_back(*iter);
     if (history.size() >= order)
       history.erase(history.begin());
   }
   // Probability of end of sentence.  This will end up getting ignored later, but
   // it still makes a difference for probability-normalization reasons.
-  IncrementCount(history, 0);
+  IncrementCount(history, 0, 1);
 }
 
 void LanguageModelEstimator::IncrementCount(const std::vector<int32> &history,
-                                            int32 next_phone) {
+                                            int32 next_phone, int32 count) {
   int32 lm_state_index = FindOrCreateLmStateIndexForHistory(history);
   if (lm_states_[lm_state_index].tot_count == 0) {
     num_active_lm_states_++;
   }
-  lm_states_[lm_state_index].AddCount(next_phone, 1);
+  lm_states_[lm_state_index].AddCount(next_phone, count);
 }
 
 void LanguageModelEstimator::SetParentCounts() {
@@ -172,15 +212,51 @@ BaseFloat LanguageModelEstimator::LmState::LogLike() const {
   return ans;
 }
 
+// Each thread handles a contiguous range of LM states.  In the first pass it
+// sets their backoff_allowed, and in the second one it computes the
+// likelihood changes of those for which it is true.  (Two passes because
+// computing a likelihood change copies the backoff state, including its
+// backoff_allowed.)  Otherwise the other LM states are only read, so the
+// threads don't interfere.
+class LanguageModelEstimator::InitializeQueueClass: public MultiThreadable {
+ public:
+  InitializeQueueClass(LanguageModelEstimator *estimator, int32 pass,
+                       std::vector<BaseFloat> *like_changes):
+      estimator_(estimator), pass_(pass), like_changes_(like_changes) { }
+
+  void operator () () {
+    int32 num_lm_states = estimator_->lm_states_.size(),
+        begin = (num_lm_states * static_cast<int64>(thread_id_)) /
+        num_threads_,
+        end = (num_lm_states * static_cast<int64>(thread_id_ + 1)) /
+        num_threads_;
+    for (int32 l = begin; l < end; l++) {
+      LmState &lm_state = estimator_->lm_states_[l];
+      if (pass_ == 0)
+        lm_state.backoff_allowed = estimator_->BackoffAllowed(l);
+      else if (lm_state.backoff_allowed)
+        (*like_changes_)[l] = estimator_->BackoffLogLikelihoodChange(l);
+    }
+  }
+ private:
+  LanguageModelEstimator *estimator_;
+  int32 pass_;
+  std::vector<BaseFloat> *like_changes_;
+};
+
 void LanguageModelEstimator::InitializeQueue() {
   int32 num_lm_states = lm_states_.size();
   while (!queue_.empty()) queue_.pop();
+  std::vector<BaseFloat> like_changes(num_lm_states);
+  for (int32 pass = 0; pass < 2; pass++) {
+    InitializeQueueClass c(this, pass, &like_changes);
+    RunMultiThreaded(c);
+  }
+  // The states are added to the queue in the same order for any number of
+  // threads, so that ties are broken in the same way.
   for (int32 l = 0; l < num_lm_states; l++) {
-    lm_states_[l].backoff_allowed = BackoffAllowed(l);
-    if (lm_states_[l].backoff_allowed) {
-      BaseFloat like_change = BackoffLogLikelihoodChange(l);
-      queue_.push(std::pair<BaseFloat,int32>(like_change, l));
-    }
+    if (lm_states_[l].backoff_allowed)
+      queue_.push(std::pair<BaseFloat,int32>(like_changes[l], l));
   }
 }
 
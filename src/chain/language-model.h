@@ -69,6 +69,40 @@ struct LanguageModelOptions {
   }
 };
 
+/**
+   This class collects the n-gram counts of a block of sentences, as
+   LanguageModelEstimator::AddCounts(const std::vector<int32>&) does, but
+   separately from the estimator, so that the counts of different blocks can
+   be collected in parallel.  The distinct n-grams are kept in the order in
+   which they were first seen, so that adding the counts of the blocks to the
+   estimator, in order, gives exactly the same language model as adding the
+   sentences one by one.
+ */
+class PhoneNgramCounts {
+ public:
+  explicit PhoneNgramCounts(const LanguageModelOptions &opts);
+
+  // Adds the counts of the n-grams of this sentence, which should contain no
+  // zeros.
+  void AddSentence(const std::vector<int32> &sentence);
+
+  // Returns the n-grams with their counts, in the order they were first seen.
+  // Each n-gram is the history (which starts with 0 at the beginning of the
+  // sentence) followed by the next phone (0 at the end of the sentence).
+  const std::vector<std::pair<std::vector<int32>, int32> > &Ngrams() const {
+    return ngrams_;
+  }
+
+ private:
+  // maps from n-gram to its index in ngrams_.
+  typedef unordered_map<std::vector<int32>, int32, VectorHasher<int32> > MapType;
+
+  int32 ngram_order_;
+  MapType ngram_index_;
+  std::vector<std::pair<std::vector<int32>, int32> > ngrams_;
+};
+
+
 /**
    This LanguageModelEstimator class estimates an n-gram language model
    with a kind of 'hard' backoff that is intended to reduce the number of
@@ -93,8 +127,15 @@ class LanguageModelEstimator {
   // should contain no zeros.
   void AddCounts(const std::vector<int32> &sentence);
 
+  // Adds the counts collected by 'counts', which must have been constructed
+  // with the same options.  This is quicker than adding the sentences one by
+  // one, as there is one lookup per distinct n-gram.
+  void AddCounts(const PhoneNgramCounts &counts);
+
   // Estimates the LM and outputs it as an FST.  Note: there is
-  // no concept here of backoff arcs.
+  // no concept here of backoff arcs.  The costs of backing off the LM states
+  // are computed with g_num_threads threads; the result does not depend on
+  // the number of threads.
   void Estimate(fst::StdVectorFst *fst);
 
  protected:
@@ -186,9 +227,9 @@ class LanguageModelEstimator {
   std::priority_queue<std::pair<BaseFloat, int32> > queue_;
 
 
-  // adds the counts for this ngram (called from AddCounts()).
+  // adds 'count' to the count of this ngram (called from AddCounts()).
   inline void IncrementCount(const std::vector<int32> &history,
-                             int32 next_phone);
+                             int32 next_phone, int32 count);
 
 
   // Computes whether backoff should be allowed for this lm_state.  (the caller
@@ -217,6 +258,10 @@ class LanguageModelEstimator {
   // >= no_prune_ngram_order.
   void InitializeQueue();
 
+  // Used by InitializeQueue() to set backoff_allowed and compute the
+  // likelihood changes for the LM states in parallel.
+  class InitializeQueueClass;
+
   // does the logic of pruning/backing-off states.
   void DoBackoff();
 
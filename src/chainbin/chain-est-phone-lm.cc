@@ -21,6 +21,39 @@
 #include "util/common-utils.h"
 #include "chain/language-model.h"
 
+namespace kaldi {
+namespace chain {
+
+// Counts the n-grams of a block of phone sequences (in operator ()), and adds
+// them to the estimator in the destructor, so that the blocks can be counted
+// in parallel by a TaskSequencer while they are added to the estimator in
+// order (which makes the LM the same for any number of threads).
+class PhoneLmCountTask {
+ public:
+  PhoneLmCountTask(const LanguageModelOptions &opts,
+                   std::vector<std::vector<int32> > *phone_seqs,
+                   LanguageModelEstimator *lm_estimator):
+      counts_(opts), lm_estimator_(lm_estimator) {
+    phone_seqs_.swap(*phone_seqs);
+  }
+
+  void operator () () {
+    for (size_t i = 0; i < phone_seqs_.size(); i++)
+      counts_.AddSentence(phone_seqs_[i]);
+  }
+
+  ~PhoneLmCountTask() {
+    lm_estimator_->AddCounts(counts_);
+  }
+ private:
+  std::vector<std::vector<int32> > phone_seqs_;
+  PhoneNgramCounts counts_;
+  LanguageModelEstimator *lm_estimator_;
+};
+
+}  // namespace chain
+}  // namespace kaldi
+
 
 int main(int argc, char *argv[]) {
   try {
@@ -36,18 +69,28 @@ int main(int argc, char *argv[]) {
         "The phone-sequences are used to train a language model.\n"
         "e.g.:\n"
         "gunzip -c input_dir/ali.*.gz | ali-to-phones input_dir/final.mdl ark:- ark:- | \\\n"
-        " chain-est-phone-lm --leftmost-context-questions=dir/leftmost_questions.txt ark:- dir/phone_G.fst\n";
+        " chain-est-phone-lm --leftmost-context-questions=dir/leftmost_questions.txt ark:- dir/phone_G.fst\n"
+        "The n-grams are counted, and the LM states' backoff costs computed,\n"
+        "with --num-threads threads; the LM is the same for any number of them.\n";
 
     bool binary_write = true;
     LanguageModelOptions lm_opts;
+    TaskSequencerConfig sequencer_config;  // has --num-threads and
+                                           // --num-threads-total options.
+    int32 block_size = 1000;
 
     ParseOptions po(usage);
     po.Register("binary", &binary_write, "Write output in binary mode");
+    po.Register("block-size", &block_size, "Number of phone sequences "
+                "whose n-grams are counted together, by one thread.");
     lm_opts.Register(&po);
+    sequencer_config.Register(&po);
 
     po.Read(argc, argv);
+    // --num-threads also applies to the estimation of the LM.
+    g_num_threads = sequencer_config.num_threads;
 
-    if (po.NumArgs() != 2) {
+    if (po.NumArgs() != 2 || block_size <= 0) {
       po.PrintUsage();
       exit(1);
     }
@@ -60,9 +103,19 @@ int main(int argc, char *argv[]) {
 
     SequentialInt32VectorReader phones_reader(phone_seqs_rspecifier);
     KALDI_LOG << "Reading phone sequences";
-    for (; !phones_reader.Done(); phones_reader.Next()) {
-      const std::vector<int32> &phone_seq = phones_reader.Value();
-      lm_estimator.AddCounts(phone_seq);
+    {
+      TaskSequencer<PhoneLmCountTask> sequencer(sequencer_config);
+      std::vector<std::vector<int32> > phone_seqs;
+      for (; !phones_reader.Done(); phones_reader.Next()) {
+        phone_seqs.push_back(phones_reader.Value());
+        if (phone_seqs.size() >= block_size)
+          sequencer.Run(new PhoneLmCountTask(lm_opts, &phone_seqs,
+                                             &lm_estimator));
+      }
+      if (!phone_seqs.empty())
+        sequencer.Run(new PhoneLmCountTask(lm_opts, &phone_seqs,
+                                           &lm_estimator));
+      sequencer.Wait();
     }
     KALDI_LOG << "Estimating phone LM";
     fst::StdVectorFst fst;
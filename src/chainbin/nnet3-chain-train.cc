@@ -20,6 +20,7 @@
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
 #include "nnet3/nnet-chain-training.h"
+#include "nnet3/nnet-chain-example-generator.h"
 #include "cudamatrix/cu-allocator.h"
 
 
@@ -35,31 +36,53 @@ int main(int argc, char *argv[]) {
         "Train nnet3+chain neural network parameters with backprop and stochastic\n"
         "gradient descent.  Minibatches are to be created by nnet3-chain-merge-egs in\n"
         "the input pipeline.  This training program is single-threaded (best to\n"
-        "use it with a GPU).\n"
+        "use it with a GPU).  With --num-workers > 1, that many copies of this\n"
+        "program (one per GPU, each reading its own examples) train the model\n"
+        "synchronously, averaging the updates with NCCL.\n"
         "\n"
         "Usage:  nnet3-chain-train [options] <raw-nnet-in> <denominator-fst-in> <chain-training-examples-in> <raw-nnet-out>\n"
+        " or:  nnet3-chain-train [options] <raw-nnet-in> <denominator-fst-in> <features-rspecifier> <chain-supervision-rspecifier> <raw-nnet-out>\n"
         "\n"
-        "nnet3-chain-train 1.raw den.fst 'ark:nnet3-merge-egs 1.cegs ark:-|' 2.raw\n";
+        "nnet3-chain-train 1.raw den.fst 'ark:nnet3-merge-egs 1.cegs ark:-|' 2.raw\n"
+        "In the second form, the minibatches are generated on the fly from the\n"
+        "features and the output of chain-get-supervision, as by\n"
+        "nnet3-chain-get-egs | nnet3-chain-shuffle-egs | nnet3-chain-merge-egs,\n"
+        "instead of from dumped egs; the options for this have the prefix --egs.\n"
+        "e.g.:\n"
+        "nnet3-chain-train --egs.left-context=25 --egs.right-context=9 \\\n"
+        "  --egs.num-frames=150,100 --egs.normalization-fst=dir/normalization.fst \\\n"
+        "  1.raw den.fst \"$feats\" ark:sup.ark 2.raw\n";
 
     int32 srand_seed = 0;
-    bool binary_write = true;
+    bool binary_write = true, share_model = false;
     std::string use_gpu = "yes";
     NnetChainTrainingOptions opts;
+    NnetPrefetchOptions prefetch_opts;
+    NnetDataParallelOptions parallel_opts;
+    NnetChainExampleGeneratorOptions generator_opts;
 
     ParseOptions po(usage);
     po.Register("srand", &srand_seed, "Seed for random number generator ");
     po.Register("binary", &binary_write, "Write output in binary mode");
     po.Register("use-gpu", &use_gpu,
                 "yes|no|optional|wait, only has effect if compiled with CUDA");
+    po.Register("share-model", &share_model, "If true, read the model through "
+                "a copy in shared memory that is shared with the other jobs on "
+                "this machine that read it with this option, so that it is "
+                "read from the file system only once.");
 
     opts.Register(&po);
+    prefetch_opts.Register(&po);
+    parallel_opts.Register(&po);
     RegisterCuAllocatorOptions(&po);
+    ParseOptions egs_po("egs", &po);
+    generator_opts.Register(&egs_po);
 
     po.Read(argc, argv);
 
     srand(srand_seed);
 
-    if (po.NumArgs() != 4) {
+    if (po.NumArgs() != 4 && po.NumArgs() != 5) {
       po.PrintUsage();
       exit(1);
     }
@@ -71,10 +94,22 @@ int main(int argc, char *argv[]) {
     std::string nnet_rxfilename = po.GetArg(1),
         den_fst_rxfilename = po.GetArg(2),
         examples_rspecifier = po.GetArg(3),
+        supervision_rspecifier,
         nnet_wxfilename = po.GetArg(4);
+    if (po.NumArgs() == 5) {
+      supervision_rspecifier = po.GetArg(4);
+      nnet_wxfilename = po.GetArg(5);
+    }
+    if (prefetch_opts.augment.Enabled() &&
+        (prefetch_opts.num_minibatches == 0 || !supervision_rspecifier.empty()))
+      KALDI_ERR << "The --augment-* options require --prefetch > 0, and are "
+                << "not supported when generating the examples on the fly.";
 
     Nnet nnet;
-    ReadKaldiObject(nnet_rxfilename, &nnet);
+    if (share_model)
+      ReadKaldiObjectNodeShared(nnet_rxfilename, &nnet);
+    else
+      ReadKaldiObject(nnet_rxfilename, &nnet);
 
     bool ok;
 
@@ -82,13 +117,31 @@ int main(int argc, char *argv[]) {
       fst::StdVectorFst den_fst;
       ReadFstKaldi(den_fst_rxfilename, &den_fst);
 
-      NnetChainTrainer trainer(opts, den_fst, &nnet);
-
-      SequentialNnetChainExampleReader example_reader(examples_rspecifier);
-
-      for (; !example_reader.Done(); example_reader.Next())
-        trainer.Train(example_reader.Value());
-
+      NnetDataParallel parallel(parallel_opts);
+      NnetChainTrainer trainer(opts, den_fst, &nnet, &parallel);
+
+      if (!supervision_rspecifier.empty()) {
+        // examples_rspecifier is the features.
+        NnetChainExampleGenerator example_reader(generator_opts,
+                                                 examples_rspecifier,
+                                                 supervision_rspecifier);
+        for (; parallel.AllHaveData(!example_reader.Done());
+             example_reader.Next())
+          trainer.Train(example_reader.Value());
+      } else if (prefetch_opts.num_minibatches > 0) {
+        NnetChainExamplePrefetcher example_reader(prefetch_opts, nnet,
+                                                   examples_rspecifier);
+        for (; parallel.AllHaveData(!example_reader.Done());
+             example_reader.Next())
+          trainer.Train(example_reader.Value(), example_reader.Inputs());
+      } else {
+        SequentialNnetChainExampleReader example_reader(examples_rspecifier);
+        for (; parallel.AllHaveData(!example_reader.Done());
+             example_reader.Next())
+          trainer.Train(example_reader.Value());
+      }
+
+      parallel.Finish(&nnet);
       ok = trainer.PrintTotalStats();
     }
 
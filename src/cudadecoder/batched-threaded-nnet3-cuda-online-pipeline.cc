@@ -0,0 +1,318 @@
+// cudadecoder/batched-threaded-nnet3-cuda-online-pipeline.cc
+//
+// Copyright 2026  Kaldi contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#if HAVE_CUDA == 1
+
+#include "cudadecoder/batched-threaded-nnet3-cuda-online-pipeline.h"
+#include <nvToolsExt.h>
+#include "base/kaldi-utils.h"
+
+namespace kaldi {
+namespace cuda_decoder {
+
+void BatchedThreadedNnet3CudaOnlinePipeline::Initialize(
+    const fst::Fst<fst::StdArc> &decode_fst, const nnet3::AmNnetSimple &am_nnet,
+    const TransitionModel &trans_model) {
+  KALDI_LOG << "BatchedThreadedNnet3CudaOnlinePipeline Initialize with "
+            << (config_.num_worker_threads > 0 ? config_.num_worker_threads :
+                GlobalThreadPool().NumThreads())
+            << (config_.num_worker_threads > 0 ? " worker threads" :
+                " shared worker threads")
+            << ", batch size " << config_.max_batch_size
+            << " and " << config_.num_channels << " channels";
+  KALDI_ASSERT(config_.max_batch_size > 0 &&
+               config_.num_channels >= config_.max_batch_size);
+
+  // Initialize this thread's device
+  CuDevice::Instantiate();
+
+  trans_model_ = &trans_model;
+  cuda_fst_.Initialize(decode_fst, trans_model_);
+
+  feature_info_ = new OnlineNnet2FeaturePipelineInfo(config_.feature_opts);
+  feature_info_->ivector_extractor_info.use_most_recent_ivector = true;
+  feature_info_->ivector_extractor_info.greedy_ivector_extractor = true;
+
+  computer_ = new nnet3::NnetBatchComputer(config_.compute_opts,
+                                           am_nnet.GetNnet(), am_nnet.Priors());
+
+  // Create threadpool for CPU work, or use the process-wide one.
+  if (config_.num_worker_threads > 0)
+    work_pool_ = new ThreadPool(config_.num_worker_threads);
+  else
+    work_pool_ = new ThreadPool(&GlobalThreadPool());
+
+  cuda_decoder_ = new CudaDecoder(cuda_fst_, config_.decoder_opts,
+                                  config_.max_batch_size, config_.num_channels);
+  if (config_.num_decoder_copy_threads > 0)
+    cuda_decoder_->SetThreadPoolAndStartCPUWorkers(
+        work_pool_, config_.num_decoder_copy_threads);
+
+  {
+    std::lock_guard<std::mutex> lk(free_channels_mutex_);
+    free_channels_.reserve(config_.num_channels);
+    // add all channels to free channel list
+    for (int i = 0; i < config_.num_channels; i++)
+      free_channels_.push_back(i);
+  }
+}
+
+void BatchedThreadedNnet3CudaOnlinePipeline::Finalize() {
+  WaitForLatticeCallbacks();
+  if (!streams_.empty())
+    KALDI_WARN << "Discarding " << streams_.size()
+               << " streams that did not finish.";
+  streams_.clear();
+
+  // The decoder must go before the pool, which its CPU workers run on.
+  delete cuda_decoder_;
+  cuda_decoder_ = NULL;
+  delete work_pool_;
+  work_pool_ = NULL;
+  delete computer_;
+  computer_ = NULL;
+  delete feature_info_;
+  feature_info_ = NULL;
+  cuda_fst_.Finalize();
+}
+
+bool BatchedThreadedNnet3CudaOnlinePipeline::TryInitCorrID(
+    CorrelationID corr_id, BaseFloat sample_rate,
+    const LatticeCallback &callback) {
+  if (streams_.count(corr_id) != 0)
+    KALDI_ERR << "Stream with correlation ID " << corr_id
+              << " is already live.";
+  ChannelId ichannel;
+  {
+    std::lock_guard<std::mutex> lk(free_channels_mutex_);
+    if (free_channels_.empty()) return false;
+    ichannel = free_channels_.back();
+    free_channels_.pop_back();
+  }
+  StreamState *stream = new StreamState(*feature_info_, computer_);
+  stream->ichannel = ichannel;
+  stream->sample_rate = sample_rate;
+  stream->callback = callback;
+  streams_[corr_id].reset(stream);
+  return true;
+}
+
+void BatchedThreadedNnet3CudaOnlinePipeline::ComputeOneFeature(
+    StreamState *stream, const VectorBase<BaseFloat> *wave_chunk,
+    bool is_last_chunk) {
+  nvtxRangePushA("ComputeOneFeature");
+  if (wave_chunk->Dim() > 0)
+    stream->feature_pipeline.AcceptWaveform(stream->sample_rate, *wave_chunk);
+  if (is_last_chunk) stream->feature_pipeline.InputFinished();
+  // All the tasks are computed at once, so the priority doesn't matter.
+  bool output_to_cpu = false;
+  stream->task_creator.CreateTasks(output_to_cpu, 0.0, &stream->nnet_tasks);
+  nvtxRangePop();
+}
+
+void BatchedThreadedNnet3CudaOnlinePipeline::ComputeBatchNnet(
+    const std::vector<StreamState *> &streams) {
+  nvtxRangePushA("ComputeBatchNnet");
+  for (StreamState *stream : streams) {
+    std::vector<nnet3::NnetInferenceTask> &ntasks = stream->nnet_tasks;
+    for (size_t j = 0; j < ntasks.size(); j++)
+      computer_->AcceptTask(&ntasks[j]);
+  }
+  // Compute all the tasks of this batch now, in as few minibatches as
+  // possible.
+  while (computer_->Compute(true));
+
+  for (StreamState *stream : streams) {
+    std::vector<nnet3::NnetInferenceTask> &ntasks = stream->nnet_tasks;
+    stream->decodable.reset();
+    if (ntasks.empty()) continue;
+    // The tasks cover consecutive output frames, starting at 'begin'.
+    int32 begin = ntasks.front().first_used_output_frame_index,
+        end = stream->task_creator.NumSubsampledFramesCreated();
+    CuMatrix<BaseFloat> &loglikes = stream->loglikes;
+    loglikes.Resize(end - begin, ntasks.front().output.NumCols(), kUndefined);
+    for (size_t j = 0; j < ntasks.size(); j++) {
+      nnet3::NnetInferenceTask &task = ntasks[j];
+      task.semaphore.Wait();  // already signaled.
+      loglikes.RowRange(task.first_used_output_frame_index - begin,
+                        task.num_used_output_frames).CopyFromMat(
+          task.output.RowRange(task.num_initial_unused_output_frames,
+                               task.num_used_output_frames));
+    }
+    // nnet output is no longer necessary as we have copied the output out
+    ntasks.clear();
+    stream->decodable.reset(
+        new DecodableCuMatrixMapped(*trans_model_, loglikes, begin));
+  }
+  nvtxRangePop();
+}
+
+void BatchedThreadedNnet3CudaOnlinePipeline::DecodeBatch(
+    const std::vector<CorrelationID> &corr_ids,
+    const std::vector<const VectorBase<BaseFloat> *> &wave_chunks,
+    const std::vector<bool> &is_last_chunk,
+    std::vector<Lattice> *partial_best_paths) {
+  int32 num_streams = corr_ids.size();
+  KALDI_ASSERT(wave_chunks.size() == num_streams &&
+               is_last_chunk.size() == num_streams &&
+               num_streams <= config_.max_batch_size);
+  std::vector<StreamState *> streams(num_streams);
+  for (int32 i = 0; i < num_streams; i++) {
+    auto it = streams_.find(corr_ids[i]);
+    if (it == streams_.end())
+      KALDI_ERR << "No live stream with correlation ID " << corr_ids[i]
+                << " (call TryInitCorrID() first).";
+    streams[i] = it->second.get();
+  }
+
+  // 1) Features, and setting up the nnet3 tasks, on the worker threads.
+  {
+    std::vector<std::future<void> > features_done;
+    features_done.reserve(num_streams);
+    for (int32 i = 0; i < num_streams; i++)
+      features_done.push_back(work_pool_->enqueue(
+          THREAD_POOL_HIGH_PRIORITY,
+          &BatchedThreadedNnet3CudaOnlinePipeline::ComputeOneFeature, this,
+          streams[i], wave_chunks[i], static_cast<bool>(is_last_chunk[i])));
+    for (size_t i = 0; i < features_done.size(); i++)
+      features_done[i].get();  // rethrows any exception.
+  }
+
+  // 2) The nnet3 output for all the streams together.
+  ComputeBatchNnet(streams);
+
+  // 3) Decoding.  The streams that have new frames are decoded together;
+  // AdvanceDecoding() stops when one of them runs out of frames, so we remove
+  // those and continue until all of them are decoded.
+  std::vector<ChannelId> init_channels, channels;
+  std::vector<CudaDecodableInterface *> decodables;
+  for (StreamState *stream : streams) {
+    if (stream->decodable == nullptr) continue;
+    if (!stream->decoding_started) {
+      init_channels.push_back(stream->ichannel);
+      stream->decoding_started = true;
+    }
+    channels.push_back(stream->ichannel);
+    decodables.push_back(stream->decodable.get());
+  }
+  if (!init_channels.empty()) cuda_decoder_->InitDecoding(init_channels);
+  while (!channels.empty()) {
+    cuda_decoder_->AdvanceDecoding(channels, decodables);
+    int32 num_left = 0;
+    for (size_t i = 0; i < channels.size(); i++) {
+      if (cuda_decoder_->NumFramesDecoded(channels[i]) <
+          decodables[i]->NumFramesReady()) {
+        channels[num_left] = channels[i];
+        decodables[num_left] = decodables[i];
+        num_left++;
+      }
+    }
+    channels.resize(num_left);
+    decodables.resize(num_left);
+  }
+
+  // 4) Partial best paths.
+  if (partial_best_paths != NULL) {
+    partial_best_paths->clear();
+    partial_best_paths->resize(num_streams);
+    // GetBestPath() is done separately for the streams that finished, because
+    // for them we use the final probs.
+    for (int32 final = 0; final < 2; final++) {
+      std::vector<ChannelId> best_path_channels;
+      std::vector<Lattice *> best_path_lattices;
+      for (int32 i = 0; i < num_streams; i++) {
+        if (streams[i]->decoding_started &&
+            static_cast<int32>(is_last_chunk[i]) == final) {
+          best_path_channels.push_back(streams[i]->ichannel);
+          best_path_lattices.push_back(&(*partial_best_paths)[i]);
+        }
+      }
+      if (!best_path_channels.empty())
+        cuda_decoder_->GetBestPath(best_path_channels, best_path_lattices,
+                                   final == 1);
+    }
+  }
+
+  // 5) Finishing the streams that received their last chunk.
+  std::vector<ChannelId> final_channels;
+  std::vector<StreamState *> final_streams;
+  for (int32 i = 0; i < num_streams; i++) {
+    if (!is_last_chunk[i]) continue;
+    StreamState *stream = streams_[corr_ids[i]].release();
+    streams_.erase(corr_ids[i]);
+    if (stream->decoding_started) final_channels.push_back(stream->ichannel);
+    final_streams.push_back(stream);
+  }
+  if (!final_channels.empty())
+    cuda_decoder_->PrepareForGetRawLattice(final_channels, true);
+  if (!final_streams.empty()) {
+    {
+      std::lock_guard<std::mutex> lk(lattice_callbacks_mutex_);
+      num_lattice_callbacks_not_done_ += final_streams.size();
+    }
+    for (StreamState *stream : final_streams)
+      work_pool_->enqueue(
+          &BatchedThreadedNnet3CudaOnlinePipeline::CompleteStream, this,
+          stream);
+  }
+}
+
+void BatchedThreadedNnet3CudaOnlinePipeline::CompleteStream(
+    StreamState *stream) {
+  nvtxRangePushA("CompleteStream");
+  // A stream too short to produce any output was never decoded; it gets an
+  // empty lattice.
+  if (stream->decoding_started)
+    cuda_decoder_->ConcurrentGetRawLatticeSingleChannel(stream->ichannel,
+                                                        &stream->lat);
+  // We are done using that channel. Putting it back into the free channels
+  {
+    std::lock_guard<std::mutex> lk(free_channels_mutex_);
+    free_channels_.push_back(stream->ichannel);
+  }
+
+  // If necessary, determinize the lattice
+  if (config_.determinize_lattice && stream->lat.NumStates() > 0) {
+    // Note this destroys the original raw lattice
+    DeterminizeLatticePhonePrunedWrapper(*trans_model_, &stream->lat,
+                                         config_.decoder_opts.lattice_beam,
+                                         &stream->dlat, config_.det_opts);
+  } else {
+    ConvertLattice(stream->lat, &stream->dlat);
+  }
+
+  if (stream->callback)  // if callable
+    stream->callback(stream->dlat);
+  delete stream;
+
+  {
+    std::lock_guard<std::mutex> lk(lattice_callbacks_mutex_);
+    if (--num_lattice_callbacks_not_done_ == 0)
+      lattice_callbacks_done_cv_.notify_all();
+  }
+  nvtxRangePop();
+}
+
+void BatchedThreadedNnet3CudaOnlinePipeline::WaitForLatticeCallbacks() {
+  std::unique_lock<std::mutex> lk(lattice_callbacks_mutex_);
+  lattice_callbacks_done_cv_.wait(
+      lk, [this] { return num_lattice_callbacks_not_done_ == 0; });
+}
+
+}  // end namespace cuda_decoder
+}  // end namespace kaldi.
+
+#endif  // HAVE_CUDA == 1
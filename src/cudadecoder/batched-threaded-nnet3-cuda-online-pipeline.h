@@ -0,0 +1,237 @@
+// cudadecoder/batched-threaded-nnet3-cuda-online-pipeline.h
+//
+// Copyright 2026  Kaldi contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_CUDA_DECODER_BATCHED_THREADED_CUDA_ONLINE_PIPELINE_H_
+#define KALDI_CUDA_DECODER_BATCHED_THREADED_CUDA_ONLINE_PIPELINE_H_
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "cudadecoder/cuda-decoder.h"
+#include "decodable-cumatrix.h"
+#include "lat/determinize-lattice-pruned.h"
+#include "nnet3/decodable-online-batched.h"
+#include "nnet3/nnet-batch-compute.h"
+#include "online2/online-nnet2-feature-pipeline.h"
+#include "thread-pool.h"
+
+namespace kaldi {
+namespace cuda_decoder {
+
+// Configuration options of the BatchedThreadedNnet3CudaOnlinePipeline.
+struct BatchedThreadedNnet3CudaOnlinePipelineConfig {
+  BatchedThreadedNnet3CudaOnlinePipelineConfig()
+      : max_batch_size(200),
+        num_channels(600),
+        num_worker_threads(-1),
+        determinize_lattice(true),
+        num_decoder_copy_threads(2) {}
+  void Register(OptionsItf *po) {
+    po->Register("max-batch-size", &max_batch_size,
+                 "The maximum number of streams decoded in one batch. "
+                 "This is also the number of lanes in the CudaDecoder. "
+                 "Larger = Faster and more GPU memory used.");
+    po->Register("num-channels", &num_channels,
+                 "The number of channels allocated to the cuda decoder, "
+                 "i.e. the maximum number of live streams.  Should be "
+                 "at least max-batch-size.  Each channel consumes a small "
+                 "amount of GPU memory.");
+    po->Register(
+        "cuda-worker-threads", &num_worker_threads,
+        "The total number of CPU threads launched to process CPU tasks.  If "
+        "<= 0, the CPU tasks are run on the process-wide thread pool, whose "
+        "size is set by --thread-pool-size.");
+    po->Register("determinize-lattice", &determinize_lattice,
+                 "Determinize the lattice before output.");
+    po->Register("cuda-decoder-copy-threads", &num_decoder_copy_threads,
+                 "Advanced - Number of worker threads used in the decoder for "
+                 "the host to host copies.");
+
+    feature_opts.Register(po);
+    decoder_opts.Register(po);
+    det_opts.Register(po);
+    compute_opts.Register(po);
+  }
+  int max_batch_size;
+  int num_channels;
+  int num_worker_threads;
+  bool determinize_lattice;
+  int num_decoder_copy_threads;
+
+  OnlineNnet2FeaturePipelineConfig feature_opts;       // constant readonly
+  CudaDecoderConfig decoder_opts;                      // constant readonly
+  fst::DeterminizeLatticePhonePrunedOptions det_opts;  // constant readonly
+  nnet3::NnetBatchComputerOptions compute_opts;        // constant readonly
+};
+
+/*
+ * BatchedThreadedNnet3CudaOnlinePipeline is the streaming counterpart of
+ * BatchedThreadedNnet3CudaPipeline: instead of complete utterances, it takes
+ * chunks of audio for many live streams, each identified by a correlation ID,
+ * and decodes them in batches on the GPU.  Each call to DecodeBatch() takes
+ * the next chunk of up to max_batch_size streams, computes their features
+ * (on the CPU worker threads) and their nnet3 output (in one set of
+ * minibatches, on the GPU), and advances the CudaDecoder on all of them
+ * together, one lane per stream; the decoder state of each stream is kept in
+ * its channel between calls.  After each chunk it can output the partial best
+ * path of each stream.  When the last chunk of a stream has been decoded, its
+ * lattice is generated and determinized (if requested) on the worker
+ * threads, and given to the callback set with TryInitCorrID().
+ *
+ * The nnet3 output is computed with the 'simple' computation, with the chunk
+ * options in compute_opts (--frames-per-chunk etc.), as in
+ * nnet3::DecodableAmNnetBatchedOnline; so a chunk of output is only decoded
+ * once enough audio for its right context has been received.
+ *
+ * Except for the callbacks, which are run on the worker threads, all the
+ * functions of this class must be called from the same thread (the one that
+ * called Initialize()), because the CudaDecoder does its work in that
+ * thread's CUDA stream.
+ *
+ * Typical use:
+ *   pipeline.Initialize(fst, am_nnet, trans_model);
+ *   // for each new stream:
+ *   if (!pipeline.TryInitCorrID(corr_id, 8000.0, callback)) ... // too many
+ *   // each time some audio is available for some streams:
+ *   pipeline.DecodeBatch(corr_ids, wave_chunks, is_last_chunk, &best_paths);
+ *   ...
+ *   pipeline.WaitForLatticeCallbacks();
+ *   pipeline.Finalize();
+ */
+class BatchedThreadedNnet3CudaOnlinePipeline {
+ public:
+  typedef uint64 CorrelationID;
+  typedef std::function<void(CompactLattice &clat)> LatticeCallback;
+
+  BatchedThreadedNnet3CudaOnlinePipeline(
+      const BatchedThreadedNnet3CudaOnlinePipelineConfig &config)
+      : config_(config), cuda_decoder_(NULL), computer_(NULL),
+        feature_info_(NULL), work_pool_(NULL),
+        num_lattice_callbacks_not_done_(0) {}
+
+  // allocates reusable objects that are common across all decodings
+  void Initialize(const fst::Fst<fst::StdArc> &decode_fst,
+                  const nnet3::AmNnetSimple &am_nnet,
+                  const TransitionModel &trans_model);
+
+  // Waits for the lattice callbacks, discards the streams that have not
+  // finished, and deallocates reusable objects.
+  void Finalize();
+
+  // Starts a new stream with ID 'corr_id', whose audio will have this sample
+  // rate.  'callback', if set, is called with the final lattice once the
+  // stream has finished; it is launched in the threadpool, so it must be
+  // threadsafe (see BatchedThreadedNnet3CudaPipeline::OpenDecodeHandle()).
+  // Returns false if there is no free channel, i.e. num_channels streams are
+  // already live (or finishing); the user may try again later.  It is an
+  // error to use the ID of a stream that is live.
+  bool TryInitCorrID(CorrelationID corr_id, BaseFloat sample_rate,
+                     const LatticeCallback &callback = LatticeCallback());
+
+  // Decodes the next chunk of audio of the streams in 'corr_ids' (which must
+  // be distinct, and no more than max_batch_size of them); wave_chunks[i] is
+  // the chunk of stream corr_ids[i], and may be empty.  If is_last_chunk[i]
+  // is true the stream finishes: its lattice callback will be called once
+  // the lattice is ready, and its ID may be reused.  If 'partial_best_paths'
+  // is not NULL, it is resized to corr_ids.size() and (*partial_best_paths)[i]
+  // is set to the best path of stream corr_ids[i] so far (taking the final
+  // probs into account if it finished, and empty if nothing has been decoded
+  // yet).  The chunks are not used after this returns.
+  void DecodeBatch(const std::vector<CorrelationID> &corr_ids,
+                   const std::vector<const VectorBase<BaseFloat> *>
+                   &wave_chunks,
+                   const std::vector<bool> &is_last_chunk,
+                   std::vector<Lattice> *partial_best_paths = NULL);
+
+  // Returns the number of streams that are live.
+  int32 NumLiveStreams() const { return streams_.size(); }
+
+  // Waits until the lattice callbacks of all the streams that have finished
+  // have been called.
+  void WaitForLatticeCallbacks();
+
+ private:
+  // The state of a live stream.
+  struct StreamState {
+    ChannelId ichannel;  // associated CudaDecoder channel
+    BaseFloat sample_rate;
+    LatticeCallback callback;
+    // True once InitDecoding() has been called on the channel.
+    bool decoding_started;
+    OnlineNnet2FeaturePipeline feature_pipeline;
+    nnet3::NnetBatchOnlineTaskCreator task_creator;
+    // The nnet3 tasks for the current chunk.
+    std::vector<nnet3::NnetInferenceTask> nnet_tasks;
+    // The log-likelihoods of the current chunk, and the decodable that serves
+    // them to the decoder.
+    CuMatrix<BaseFloat> loglikes;
+    std::unique_ptr<DecodableCuMatrixMapped> decodable;
+    // The raw and determinized lattices, set once the stream has finished.
+    Lattice lat;
+    CompactLattice dlat;
+
+    StreamState(const OnlineNnet2FeaturePipelineInfo &feature_info,
+                nnet3::NnetBatchComputer *computer)
+        : ichannel(-1), sample_rate(0), decoding_started(false),
+          feature_pipeline(feature_info),
+          task_creator(computer, feature_pipeline.InputFeature(),
+                       feature_pipeline.IvectorFeature()) {}
+  };
+
+  // Gives a chunk of audio to the features of 'stream' and creates the nnet3
+  // tasks for the chunks of output that are ready.  Run on the work pool.
+  void ComputeOneFeature(StreamState *stream,
+                         const VectorBase<BaseFloat> *wave_chunk,
+                         bool is_last_chunk);
+
+  // Computes the nnet3 tasks of the streams, and sets up their decodables.
+  void ComputeBatchNnet(const std::vector<StreamState *> &streams);
+
+  // Gets the lattice of a stream that has finished, calls its callback, and
+  // frees its channel and the stream.  PrepareForGetRawLattice was already
+  // called.  Run on the work pool.
+  void CompleteStream(StreamState *stream);
+
+  BatchedThreadedNnet3CudaOnlinePipelineConfig config_;
+
+  CudaFst cuda_fst_;
+  const TransitionModel *trans_model_;
+  CudaDecoder *cuda_decoder_;
+  nnet3::NnetBatchComputer *computer_;
+  OnlineNnet2FeaturePipelineInfo *feature_info_;
+
+  ThreadPool *work_pool_;  // thread pool for CPU work
+
+  // The live streams.  Only accessed from the main thread.
+  std::unordered_map<CorrelationID, std::unique_ptr<StreamState> > streams_;
+
+  std::vector<ChannelId> free_channels_;
+  std::mutex free_channels_mutex_;
+
+  int32 num_lattice_callbacks_not_done_;
+  std::mutex lattice_callbacks_mutex_;
+  std::condition_variable lattice_callbacks_done_cv_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(BatchedThreadedNnet3CudaOnlinePipeline);
+};
+
+}  // end namespace cuda_decoder
+}  // end namespace kaldi.
+
+#endif  // KALDI_CUDA_DECODER_BATCHED_THREADED_CUDA_ONLINE_PIPELINE_H_
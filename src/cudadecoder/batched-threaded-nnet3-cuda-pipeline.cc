@@ -22,6 +22,9 @@
 #include "cudadecoder/batched-threaded-nnet3-cuda-pipeline.h"
 #include <nvToolsExt.h>
 #include "base/kaldi-utils.h"
+#include "base/timer.h"
+#include "util/stl-utils.h"
+#include "util/text-utils.h"
 
 namespace kaldi {
 namespace cuda_decoder {
@@ -29,21 +32,110 @@ namespace cuda_decoder {
 void BatchedThreadedNnet3CudaPipeline::Initialize(
     const fst::Fst<fst::StdArc> &decode_fst, const nnet3::AmNnetSimple &am_nnet,
     const TransitionModel &trans_model) {
+  InitializeInternal(&decode_fst, "", am_nnet, trans_model);
+}
+
+void BatchedThreadedNnet3CudaPipeline::Initialize(
+    const std::string &cuda_fst_filename, const nnet3::AmNnetSimple &am_nnet,
+    const TransitionModel &trans_model) {
+  InitializeInternal(NULL, cuda_fst_filename, am_nnet, trans_model);
+}
+
+void BatchedThreadedNnet3CudaPipeline::InitializeCudaFst(
+    const fst::Fst<fst::StdArc> *decode_fst,
+    const std::string &cuda_fst_filename, CudaFst *cuda_fst) {
+  if (decode_fst != NULL)
+    cuda_fst->Initialize(*decode_fst, trans_model_);
+  else
+    cuda_fst->Map(cuda_fst_filename);
+}
+
+void BatchedThreadedNnet3CudaPipeline::InitializeInternal(
+    const fst::Fst<fst::StdArc> *decode_fst,
+    const std::string &cuda_fst_filename, const nnet3::AmNnetSimple &am_nnet,
+    const TransitionModel &trans_model) {
   KALDI_LOG << "BatchedThreadedNnet3CudaPipeline Initialize with "
-            << config_.num_control_threads << " control threads, "
-            << config_.num_worker_threads << " worker threads"
+            << config_.num_control_threads << " control threads per GPU, "
+            << (config_.num_worker_threads > 0 ? config_.num_worker_threads :
+                GlobalThreadPool().NumThreads())
+            << (config_.num_worker_threads > 0 ? " worker threads" :
+                " shared worker threads")
             << " and batch size " << config_.max_batch_size;
 
+  MetricsRegistry &registry = MetricsRegistry::Global();
+  pending_tasks_gauge_ = registry.GetGauge(
+      "kaldi_cuda_pipeline_pending_tasks",
+      "Number of tasks in the pending task queue of the CUDA pipeline.");
+  tasks_not_done_gauge_ = registry.GetGauge(
+      "kaldi_cuda_pipeline_tasks_not_done",
+      "Number of tasks added to the CUDA pipeline and not yet completed.");
+  audio_seconds_counter_ = registry.GetCounter(
+      "kaldi_cuda_pipeline_audio_seconds_total",
+      "Total length of the audio decoded by the CUDA pipeline, in seconds.");
+  std::vector<double> stage_buckets = ExponentialBuckets(0.0001, 2.0, 18);
+  features_seconds_histogram_ = registry.GetHistogram(
+      "kaldi_cuda_pipeline_features_seconds",
+      "Time taken to compute the features of a batch, in seconds.",
+      stage_buckets);
+  nnet_seconds_histogram_ = registry.GetHistogram(
+      "kaldi_cuda_pipeline_nnet_seconds",
+      "Time taken to compute the nnet output of a batch, in seconds.",
+      stage_buckets);
+  decode_seconds_histogram_ = registry.GetHistogram(
+      "kaldi_cuda_pipeline_decode_seconds",
+      "Time taken by each call to AdvanceDecoding() for a batch, in seconds.",
+      stage_buckets);
+  lattice_seconds_histogram_ = registry.GetHistogram(
+      "kaldi_cuda_pipeline_lattice_seconds",
+      "Time taken to get and determinize the lattice of a task, in seconds.",
+      stage_buckets);
+
   am_nnet_ = &am_nnet;
   trans_model_ = &trans_model;
-  cuda_fst_.Initialize(decode_fst, trans_model_);
+  nnet_input_dim_ = am_nnet.GetNnet().InputDim("input");
+  nnet_ivector_dim_ = std::max<int32>(0, am_nnet.GetNnet().InputDim("ivector"));
+  nnet_output_dim_ = am_nnet.GetNnet().OutputDim("output");
+
+  // Set up the data on each GPU.  The copies on GPUs other than this thread's
+  // are made by temporary threads that use those GPUs.
+  int32 this_gpu_id = CuDevice::Instantiate().ActiveGpuId();
+  std::vector<int32> gpu_ids;
+  if (config_.gpu_ids.empty()) {
+    gpu_ids.push_back(this_gpu_id);
+  } else {
+    if (!SplitStringToIntegers(config_.gpu_ids, ",", false, &gpu_ids))
+      KALDI_ERR << "Invalid --gpu-ids option '" << config_.gpu_ids << "'";
+    std::vector<int32> sorted_gpu_ids(gpu_ids);
+    SortAndUniq(&sorted_gpu_ids);
+    if (sorted_gpu_ids.size() != gpu_ids.size())
+      KALDI_ERR << "Repeated GPU id in --gpu-ids option '" << config_.gpu_ids
+                << "'";
+  }
+  for (int32 gpu_id : gpu_ids) {
+    DeviceState *device = new DeviceState();
+    device->gpu_id = gpu_id;
+    devices_.emplace_back(device);
+    if (gpu_id == this_gpu_id) {
+      InitializeCudaFst(decode_fst, cuda_fst_filename, &device->cuda_fst);
+    } else {
+      KALDI_LOG << "Copying the model and decoding graph to GPU " << gpu_id;
+      std::thread copy_thread([this, device, decode_fst,
+                               &cuda_fst_filename]() {
+        CuDevice::SelectThreadGpuId(device->gpu_id);
+        InitializeCudaFst(decode_fst, cuda_fst_filename, &device->cuda_fst);
+        device->nnet.reset(new nnet3::Nnet(am_nnet_->GetNnet()));
+        cudaStreamSynchronize(cudaStreamPerThread);
+      });
+      copy_thread.join();
+    }
+  }
 
   feature_info_ = new OnlineNnet2FeaturePipelineInfo(config_.feature_opts);
   feature_info_->ivector_extractor_info.use_most_recent_ivector = true;
   feature_info_->ivector_extractor_info.greedy_ivector_extractor = true;
 
   // initialize threads and save their contexts so we can join them later
-  thread_contexts_.resize(config_.num_control_threads);
+  thread_contexts_.resize(config_.num_control_threads * devices_.size());
 
   // create work queue
   pending_task_queue_ = new TaskState *[config_.max_pending_tasks + 1];
@@ -54,31 +146,39 @@ void BatchedThreadedNnet3CudaPipeline::Initialize(
   // in different streams.
   cudaStreamSynchronize(cudaStreamPerThread);
 
-  // Create threadpool for CPU work
-  work_pool_ = new ThreadPool(config_.num_worker_threads);
+  // Create threadpool for CPU work, or use the process-wide one.
+  if (config_.num_worker_threads > 0)
+    work_pool_ = new ThreadPool(config_.num_worker_threads);
+  else
+    work_pool_ = new ThreadPool(&GlobalThreadPool());
 
   exit_ = false;
   numStarted_ = 0;
 
   // start workers
-  for (int i = 0; i < config_.num_control_threads; i++) {
+  for (int i = 0; i < thread_contexts_.size(); i++) {
     thread_contexts_[i] =
         std::thread(&BatchedThreadedNnet3CudaPipeline::ExecuteWorker, this, i);
   }
 
   // wait for threads to start to ensure allocation time isn't in the timings
-  while (numStarted_ < config_.num_control_threads)
+  while (numStarted_ < thread_contexts_.size())
     kaldi::Sleep(SLEEP_BACKOFF_S);
 }
 void BatchedThreadedNnet3CudaPipeline::Finalize() {
   // Tell threads to exit and join them
   exit_ = true;
 
-  for (int i = 0; i < config_.num_control_threads; i++) {
+  for (int i = 0; i < thread_contexts_.size(); i++) {
     thread_contexts_[i].join();
   }
 
-  cuda_fst_.Finalize();
+  for (size_t i = 0; i < devices_.size(); i++)
+    devices_[i]->cuda_fst.Finalize();
+  devices_.clear();
+
+  KALDI_LOG << "Generating and determinizing the lattices took "
+            << lattice_time_ << " seconds of CPU worker time.";
 
   delete feature_info_;
   delete work_pool_;
@@ -235,19 +335,25 @@ BatchedThreadedNnet3CudaPipeline::AddTask(const std::string &key,
   {
     std::lock_guard<std::mutex> lk(group_tasks_mutex_);
     ++all_group_tasks_not_done_;
+    tasks_not_done_gauge_->Add(1.0);
     ++group_tasks_not_done_[task->group];
   }
   return task;
 }
 
-// Adds a decoding task to the decoder
-void BatchedThreadedNnet3CudaPipeline::OpenDecodeHandle(
-    const std::string &key, const WaveData &wave_data, const std::string &group,
-    const std::function<void(CompactLattice &clat)> &callback) {
-  TaskState *task = AddTask(key, group);
-  task->callback = std::move(callback);
-  task->Init(key, wave_data);
+BatchedThreadedNnet3CudaPipeline::TaskState *
+BatchedThreadedNnet3CudaPipeline::AddAutoCloseTask() {
+  TaskState *task = new TaskState();
+  task->auto_close = true;
+  {
+    std::lock_guard<std::mutex> lk(group_tasks_mutex_);
+    ++all_group_tasks_not_done_;
+    tasks_not_done_gauge_->Add(1.0);
+  }
+  return task;
+}
 
+void BatchedThreadedNnet3CudaPipeline::LaunchTask(TaskState *task) {
   if (config_.gpu_feature_extract) {
     // Feature extraction done on device
     AddTaskToPendingTaskQueue(task);
@@ -259,6 +365,16 @@ void BatchedThreadedNnet3CudaPipeline::OpenDecodeHandle(
   }
 }
 
+// Adds a decoding task to the decoder
+void BatchedThreadedNnet3CudaPipeline::OpenDecodeHandle(
+    const std::string &key, const WaveData &wave_data, const std::string &group,
+    const std::function<void(CompactLattice &clat)> &callback) {
+  TaskState *task = AddTask(key, group);
+  task->callback = std::move(callback);
+  task->Init(key, wave_data);
+  LaunchTask(task);
+}
+
 void BatchedThreadedNnet3CudaPipeline::OpenDecodeHandle(
     const std::string &key, const VectorBase<BaseFloat> &wave_data,
     float sample_rate, const std::string &group,
@@ -266,16 +382,40 @@ void BatchedThreadedNnet3CudaPipeline::OpenDecodeHandle(
   TaskState *task = AddTask(key, group);
   task->Init(key, wave_data, sample_rate);
   task->callback = std::move(callback);
+  LaunchTask(task);
+}
 
-  if (config_.gpu_feature_extract) {
-    // Feature extraction done on device
-    AddTaskToPendingTaskQueue(task);
-  } else {
-    // Feature extraction done on host thread
-    work_pool_->enqueue(THREAD_POOL_LOW_PRIORITY,
-                        &BatchedThreadedNnet3CudaPipeline::ComputeOneFeatureCPU,
-                        this, task);
+void BatchedThreadedNnet3CudaPipeline::DecodeWithCallback(
+    const WaveData &wave_data,
+    const std::function<void(CompactLattice &clat)> &callback) {
+  TaskState *task = AddAutoCloseTask();
+  task->Init(std::string(), wave_data);
+  task->callback = callback;
+  LaunchTask(task);
+}
+
+void BatchedThreadedNnet3CudaPipeline::DecodeWithCallback(
+    const VectorBase<BaseFloat> &wave_data, float sample_rate,
+    const std::function<void(CompactLattice &clat)> &callback) {
+  TaskState *task = AddAutoCloseTask();
+  task->Init(std::string(), wave_data, sample_rate);
+  task->callback = callback;
+  LaunchTask(task);
+}
+
+void BatchedThreadedNnet3CudaPipeline::AbortAutoCloseTask(TaskState *task) {
+  KALDI_ASSERT(task->auto_close);
+  if (task->callback) {
+    CompactLattice empty_clat;
+    task->callback(empty_clat);
+  }
+  delete task;
+  {
+    std::lock_guard<std::mutex> lk(group_tasks_mutex_);
+    --all_group_tasks_not_done_;
+    tasks_not_done_gauge_->Add(-1.0);
   }
+  group_done_cv_.notify_all();
 }
 
 bool BatchedThreadedNnet3CudaPipeline::GetRawLattice(const std::string &key,
@@ -357,9 +497,24 @@ void BatchedThreadedNnet3CudaPipeline::AddTaskToPendingTaskQueue(
     pending_task_queue_[tasks_back_] = task;
     // (int)tasks_back_);
     tasks_back_ = (tasks_back_ + 1) % (config_.max_pending_tasks + 1);
+    pending_tasks_gauge_->Set(NumPendingTasks());
   }
 }
 
+int64 BatchedThreadedNnet3CudaPipeline::EstimateTaskDeviceMemory(
+    const TaskState &task) {
+  const TaskData &task_data = *task.task_data;
+  int64 num_frames =
+      task_data.wave_samples->Dim() /
+      (task_data.sample_frequency * feature_info_->FrameShiftInSeconds());
+  int64 num_output_frames =
+      num_frames / config_.compute_opts.frame_subsampling_factor + 1;
+  int64 num_floats = num_output_frames * nnet_output_dim_;
+  if (config_.gpu_feature_extract)
+    num_floats += num_frames * nnet_input_dim_ + nnet_ivector_dim_;
+  return num_floats * sizeof(BaseFloat);
+}
+
 // Attempts to fill the batch from the task queue.  May not fully fill the
 // batch.
 void BatchedThreadedNnet3CudaPipeline::AquireAdditionalTasks(
@@ -371,6 +526,14 @@ void BatchedThreadedNnet3CudaPipeline::AquireAdditionalTasks(
   int tasksRequested =
       std::min(free_channels.size(), config_.max_batch_size - channels.size());
   int tasksAssigned = 0;
+  if (tasksRequested == 0) return;
+
+  // Device memory we can use for the new tasks, or -1 if unlimited
+  int64 memory_budget = -1;
+  if (config_.gpu_memory_margin >= 0)
+    memory_budget = std::max<int64>(
+        0, CuDevice::Instantiate().GetAvailableMemory() -
+               static_cast<int64>(config_.gpu_memory_margin) * 1048576);
 
   {
     // lock required because front might change from other
@@ -379,14 +542,25 @@ void BatchedThreadedNnet3CudaPipeline::AquireAdditionalTasks(
     {
       // compute number of tasks to grab
       int tasksAvailable = NumPendingTasks();
-      tasksAssigned = std::min(tasksAvailable, tasksRequested);
-
-      // grab tasks
-      for (int i = 0; i < tasksAssigned; i++) {
-        // pending_task_queue_[tasks_front_]);
-        tasks.push_back(pending_task_queue_[tasks_front_]);
+      int tasksToAssign = std::min(tasksAvailable, tasksRequested);
+
+      // grab tasks, in FIFO order, as long as they fit in memory
+      for (int i = 0; i < tasksToAssign; i++) {
+        TaskState *task = pending_task_queue_[tasks_front_];
+        if (memory_budget >= 0) {
+          int64 task_memory = EstimateTaskDeviceMemory(*task);
+          // Always taking one task if the batch is empty, otherwise nothing
+          // would ever free any memory
+          if (task_memory > memory_budget &&
+              !(channels.empty() && tasksAssigned == 0))
+            break;
+          memory_budget = std::max<int64>(0, memory_budget - task_memory);
+        }
+        tasks.push_back(task);
         tasks_front_ = (tasks_front_ + 1) % (config_.max_pending_tasks + 1);
+        tasksAssigned++;
       }
+      pending_tasks_gauge_->Set(NumPendingTasks());
     }
   }
 
@@ -608,25 +782,36 @@ void BatchedThreadedNnet3CudaPipeline::ComputeBatchFeatures(
   nvtxRangePop();
 
   nvtxRangePushA("ComputeBatchFeatures");
-  // extract features for each wave
-  count = 0;
+  // extract features for all waves with one set of kernel launches
+  std::vector<int32> wave_offsets(1, 0), feature_offsets;
+  for (int i = first; i < tasks.size(); i++)
+    wave_offsets.push_back(wave_offsets.back() +
+                           tasks[i]->task_data->wave_samples->Dim());
+  CuMatrix<BaseFloat> cu_features;
+  std::vector<CuVector<BaseFloat> > ivectors;
+  // the feature extraction doesn't depend on the sample frequency, which is
+  // only checked against the options.
+  feature_pipeline.ComputeFeaturesBatched(
+      cu_waves, wave_offsets, tasks[first]->task_data->sample_frequency,
+      &cu_features, &feature_offsets, &ivectors);
+
+  // split them into the tasks; these copies stay on the device.
   for (int i = first; i < tasks.size(); i++) {
-    TaskState &task = *tasks[i];
-    std::shared_ptr<TaskData> &task_data = task.task_data;
-
-    CuSubVector<BaseFloat> cu_wave(cu_waves, count,
-                                   task_data->wave_samples->Dim());
-    count += task_data->wave_samples->Dim();
-    feature_pipeline.ComputeFeatures(cu_wave, task_data->sample_frequency,
-                                     &task_data->input_features,
-                                     &task_data->ivector_features);
-
-    int32 numFrames = task_data->input_features.NumRows();
+    std::shared_ptr<TaskData> &task_data = tasks[i]->task_data;
+    int32 first_row = feature_offsets[i - first],
+        numFrames = feature_offsets[i - first + 1] - first_row;
 
+    task_data->ivector_features.Swap(&ivectors[i - first]);
     if (numFrames == 0) {
+      task_data->input_features.Resize(0, 0);
       // Make this a warning for now.  Need to check how this is handled
       KALDI_WARN << "Warning empty audio file";
+      continue;
     }
+    task_data->input_features.Resize(numFrames, cu_features.NumCols(),
+                                     kUndefined);
+    task_data->input_features.CopyFromMat(
+        cu_features.RowRange(first_row, numFrames));
   }
   nvtxRangePop();
 }
@@ -733,6 +918,7 @@ void BatchedThreadedNnet3CudaPipeline::PostDecodeProcessing(
 void BatchedThreadedNnet3CudaPipeline::CompleteTask(CudaDecoder *cuda_decoder,
                                                     ChannelState *channel_state,
                                                     TaskState *task) {
+  Timer timer;
   // Calling GetRawLattice for that channel. PrepareForGetRawLattice was already
   // called
   cuda_decoder->ConcurrentGetRawLatticeSingleChannel(task->ichannel,
@@ -749,10 +935,30 @@ void BatchedThreadedNnet3CudaPipeline::CompleteTask(CudaDecoder *cuda_decoder,
   if (!config_.determinize_lattice) {
     ConvertLattice(task->lat, &task->dlat);
   }
+  double elapsed = timer.Elapsed();
+  {
+    std::lock_guard<std::mutex> lk(lattice_time_mutex_);
+    lattice_time_ += elapsed;
+  }
+  lattice_seconds_histogram_->Observe(elapsed);
+  audio_seconds_counter_->Increment(task->task_data->wave_samples->Dim() /
+                                    task->task_data->sample_frequency);
 
   if (task->callback)  // if callable
     task->callback(task->dlat);
 
+  if (task->auto_close) {
+    // Nobody else refers to the task, we can delete it
+    delete task;
+    {
+      std::lock_guard<std::mutex> lk(group_tasks_mutex_);
+      --all_group_tasks_not_done_;
+      tasks_not_done_gauge_->Add(-1.0);
+    }
+    group_done_cv_.notify_all();
+    return;
+  }
+
   task->finished = true;
   // Clear working data (raw input, posteriors, etc.)
   task->task_data.reset();
@@ -760,6 +966,7 @@ void BatchedThreadedNnet3CudaPipeline::CompleteTask(CudaDecoder *cuda_decoder,
   {
     std::lock_guard<std::mutex> lk(group_tasks_mutex_);
     --all_group_tasks_not_done_;
+    tasks_not_done_gauge_->Add(-1.0);
     int32 left_in_group = --group_tasks_not_done_[task->group];
     //    std::cout << "left in group " << task->group << " " << left_in_group
     //    << std::endl;
@@ -779,18 +986,22 @@ void BatchedThreadedNnet3CudaPipeline::DeterminizeOneLattice(TaskState *task) {
 
 void BatchedThreadedNnet3CudaPipeline::ExecuteWorker(int threadId) {
   // Initialize this threads device
+  DeviceState &device = *devices_[threadId % devices_.size()];
+  if (device.gpu_id >= 0) CuDevice::SelectThreadGpuId(device.gpu_id);
   CuDevice::Instantiate();
 
   KALDI_LOG << "CudaDecoder batch_size=" << config_.max_batch_size
             << " num_channels=" << config_.num_channels;
   // Data structures that are reusable across decodes but unique to each thread
-  CudaDecoder cuda_decoder(cuda_fst_, config_.decoder_opts,
+  CudaDecoder cuda_decoder(device.cuda_fst, config_.decoder_opts,
                            config_.max_batch_size, config_.num_channels);
   if (config_.num_decoder_copy_threads > 0)
     cuda_decoder.SetThreadPoolAndStartCPUWorkers(
         work_pool_, config_.num_decoder_copy_threads);
-  nnet3::NnetBatchComputer computer(config_.compute_opts, am_nnet_->GetNnet(),
-                                    am_nnet_->Priors());
+  nnet3::NnetBatchComputer computer(
+      config_.compute_opts,
+      (device.nnet != nullptr ? *device.nnet : am_nnet_->GetNnet()),
+      am_nnet_->Priors());
 
   OnlineCudaFeaturePipeline feature_pipeline(config_.feature_opts);
 
@@ -841,9 +1052,14 @@ void BatchedThreadedNnet3CudaPipeline::ExecuteWorker(int threadId) {
 
         // New tasks are now in the in tasks[start,tasks.size())
         if (start != tasks.size()) {  // if there are new tasks
-          if (config_.gpu_feature_extract)
+          Timer timer;
+          if (config_.gpu_feature_extract) {
             ComputeBatchFeatures(start, tasks, feature_pipeline);
+            features_seconds_histogram_->Observe(timer.Elapsed());
+            timer.Reset();
+          }
           ComputeBatchNnet(computer, start, tasks);
+          nnet_seconds_histogram_->Observe(timer.Elapsed());
           AllocateDecodables(start, tasks, decodables);
         }
       }  // end if (tasks_front_!=tasks_back_)
@@ -868,7 +1084,9 @@ void BatchedThreadedNnet3CudaPipeline::ExecuteWorker(int threadId) {
         do {
           // 3) Process outstanding work in a batch
           // Advance decoding on all open channels
+          Timer timer;
           cuda_decoder.AdvanceDecoding(channel_state.channels, decodables);
+          decode_seconds_histogram_->Observe(timer.Elapsed());
 
           // Adjust channel state for all completed decodes
           RemoveCompletedChannels(cuda_decoder, channel_state, decodables,
@@ -913,6 +1131,16 @@ void BatchedThreadedNnet3CudaPipeline::ExecuteWorker(int threadId) {
             // cleanup memory
             delete decodables[i];
 
+            if (task.auto_close) {
+              // nobody will query that task, report the failure through its
+              // callback
+              work_pool_->enqueue(
+                  THREAD_POOL_NORMAL_PRIORITY,
+                  &BatchedThreadedNnet3CudaPipeline::AbortAutoCloseTask, this,
+                  &task);
+              continue;
+            }
+
             // notifiy master decode is finished
             task.finished = true;
           }
@@ -28,6 +28,7 @@
 #include "nnet3/nnet-batch-compute.h"
 #include "online2/online-nnet2-feature-pipeline.h"
 #include "cudafeat/online-cuda-feature-pipeline.h"
+#include "util/kaldi-metrics.h"
 #include "thread-pool.h"
 
 // If num_channels sets to automatic,
@@ -51,11 +52,12 @@ struct BatchedThreadedNnet3CudaPipelineConfig {
         num_channels(-1),
         batch_drain_size(10),
         num_control_threads(2),
-        num_worker_threads(20),
+        num_worker_threads(-1),
         determinize_lattice(true),
         max_pending_tasks(4000),
         num_decoder_copy_threads(2),
-        gpu_feature_extract(true) {};
+        gpu_feature_extract(true),
+        gpu_memory_margin(256) {};
   void Register(OptionsItf *po) {
     po->Register("max-batch-size", &max_batch_size,
                  "The maximum batch size to be used by the decoder. "
@@ -80,7 +82,9 @@ struct BatchedThreadedNnet3CudaPipelineConfig {
                  "and decoder).");
     po->Register(
         "cuda-worker-threads", &num_worker_threads,
-        "The total number of CPU threads launched to process CPU tasks.");
+        "The total number of CPU threads launched to process CPU tasks.  If "
+        "<= 0, the CPU tasks are run on the process-wide thread pool, whose "
+        "size is set by --thread-pool-size.");
     po->Register("determinize-lattice", &determinize_lattice,
                  "Determinize the lattice before output.");
     po->Register("max-outstanding-queue-length", &max_pending_tasks,
@@ -90,10 +94,24 @@ struct BatchedThreadedNnet3CudaPipelineConfig {
     po->Register("cuda-decoder-copy-threads", &num_decoder_copy_threads,
                  "Advanced - Number of worker threads used in the decoder for "
                  "the host to host copies.");
+    po->Register("gpu-ids", &gpu_ids,
+                 "Comma-separated list of the CUDA devices to decode on, "
+                 "e.g. '0,1,2,3'.  The model and decoding graph are copied to "
+                 "each of them, and each gets cuda-control-threads control "
+                 "threads.  If empty, only the GPU selected by --use-gpu is "
+                 "used.");
     po->Register("gpu-feature-extract", &gpu_feature_extract,
                  "Extract features on the GPU.  This reduces CPU overhead "
                  "leading to better scalability but may reduce overall "
                  "performance for a single GPU.");
+    po->Register("gpu-memory-margin", &gpu_memory_margin,
+                 "Amount of device memory, in MB, to keep free when taking "
+                 "new decodes into a batch.  A batch is filled with the "
+                 "decodes whose features and nnet3 output are estimated to "
+                 "fit in the available device memory minus this margin, up "
+                 "to max-batch-size; a batch always takes at least one "
+                 "decode.  If < 0, batches are only limited by "
+                 "max-batch-size.");
 
     feature_opts.Register(po);
     decoder_opts.Register(po);
@@ -108,7 +126,9 @@ struct BatchedThreadedNnet3CudaPipelineConfig {
   bool determinize_lattice;
   int max_pending_tasks;
   int num_decoder_copy_threads;
+  std::string gpu_ids;
   bool gpu_feature_extract;
+  int32 gpu_memory_margin;
 
   void ComputeConfig() {
     if (num_channels == -1)
@@ -132,7 +152,7 @@ class BatchedThreadedNnet3CudaPipeline {
 public:
  BatchedThreadedNnet3CudaPipeline(
      const BatchedThreadedNnet3CudaPipelineConfig &config)
-     : config_(config), all_group_tasks_not_done_(0) {
+     : config_(config), all_group_tasks_not_done_(0), lattice_time_(0.0) {
    config_.ComputeConfig();
  };
 
@@ -141,6 +161,14 @@ public:
                  const nnet3::AmNnetSimple &nnet,
                  const TransitionModel &trans_model);
 
+ // As Initialize() above, but the decoding graph is the file
+ // 'cuda_fst_filename' written by make-cuda-fst for this TransitionModel,
+ // which is memory-mapped and copied to the GPUs directly (see
+ // CudaFst::Map()) instead of being converted from an FST.
+ void Initialize(const std::string &cuda_fst_filename,
+                 const nnet3::AmNnetSimple &nnet,
+                 const TransitionModel &trans_model);
+
  // deallocates reusable objects
  void Finalize();
 
@@ -180,6 +208,24 @@ public:
      const std::function<void(CompactLattice &clat)> &callback =
          std::function<void(CompactLattice &clat)>());
 
+ // Decodes wave_data and calls callback with the lattice as soon as it is
+ // ready, without creating a decode handle: there is no key to query or
+ // close, and the resources of the decode are freed once callback returns.
+ // This lets the user handle the results in the order in which they complete
+ // rather than the order in which the decodes were submitted.  As for
+ // OpenDecodeHandle, callback is launched in the threadpool and must be
+ // threadsafe.  If the decode fails, callback is called with an empty
+ // lattice.  These decodes are not in any group, but they are counted by
+ // GetNumberOfTasksPending() and waited for by WaitForAllTasks().
+ void DecodeWithCallback(
+     const WaveData &wave_data,
+     const std::function<void(CompactLattice &clat)> &callback);
+ // When passing in a vector of data, the caller must ensure the data exists
+ // until callback is called
+ void DecodeWithCallback(
+     const VectorBase<BaseFloat> &wave_data, float sample_rate,
+     const std::function<void(CompactLattice &clat)> &callback);
+
  // Copies the raw lattice for decoded handle "key" into lat
  bool GetRawLattice(const std::string &key, Lattice *lat);
  // Determinizes raw lattice and returns a compact lattice
@@ -257,13 +303,19 @@ private:
 
    bool determinized;
 
+   // True if the task was added by DecodeWithCallback(): it has no handle,
+   // and it is deleted once it has finished.
+   bool auto_close;
+
    // (optional) callback is called task is finished and we have a lattice
    // ready
    // that way we can compute all CPU tasks in the threadpool (lattice
    // rescoring, find best path in lattice, etc.)
    std::function<void(CompactLattice &clat)> callback;
 
-   TaskState() : error(false), finished(false), determinized(false) {}
+   TaskState()
+       : error(false), finished(false), determinized(false),
+         auto_close(false) {}
 
    // Init when wave data is passed directly in.  This data is deep copied.
    void Init(const std::string &key_in, const WaveData &wave_data_in) {
@@ -280,6 +332,15 @@ private:
 
   // Creating a new task in the hashmaps
   TaskState *AddTask(const std::string &key, const std::string &group);
+  // Creating a new task for DecodeWithCallback(), which is not in the hashmaps
+  TaskState *AddAutoCloseTask();
+
+  // Sends a task whose data has been set to feature extraction
+  void LaunchTask(TaskState *task);
+
+  // Called when a task added by DecodeWithCallback() has failed: calls its
+  // callback with an empty lattice and deletes it
+  void AbortAutoCloseTask(TaskState *task);
 
   // Holds the current channel state for a worker
   struct ChannelState {
@@ -292,8 +353,14 @@ private:
   // Adds task to the PendingTaskQueue
   void AddTaskToPendingTaskQueue(TaskState *task);
 
+  // Returns an estimate of the device memory, in bytes, used by the features
+  // and nnet3 output of a task.
+  int64 EstimateTaskDeviceMemory(const TaskState &task);
+
   // Attempts to fill the batch from the task queue.  May not fully fill the
-  // batch.
+  // batch, in particular if the memory needed by the tasks at the front of
+  // the queue is more than the available device memory (cf
+  // --gpu-memory-margin).
   void AquireAdditionalTasks(CudaDecoder &cuda_decoder,
                              ChannelState &channel_state,
                              std::vector<TaskState *> &tasks);
@@ -334,6 +401,16 @@ private:
   void CompleteTask(CudaDecoder *cuda_decoder, ChannelState *channel_state,
                     TaskState *state);
 
+  // Does the work of the Initialize() functions; exactly one of decode_fst
+  // and cuda_fst_filename is set.
+  void InitializeInternal(const fst::Fst<fst::StdArc> *decode_fst,
+                          const std::string &cuda_fst_filename,
+                          const nnet3::AmNnetSimple &am_nnet,
+                          const TransitionModel &trans_model);
+  // Sets up cuda_fst from decode_fst or cuda_fst_filename, as above.
+  void InitializeCudaFst(const fst::Fst<fst::StdArc> *decode_fst,
+                         const std::string &cuda_fst_filename,
+                         CudaFst *cuda_fst);
   // Determinize one lattice
   void DeterminizeOneLattice(TaskState *task);
   // Thread execution function.  This is a single worker thread which processes
@@ -342,9 +419,22 @@ private:
 
   BatchedThreadedNnet3CudaPipelineConfig config_;
 
-  CudaFst cuda_fst_;
+  // The data that is replicated on each GPU we decode on.
+  struct DeviceState {
+    int32 gpu_id;  // CUDA device id
+    CudaFst cuda_fst;
+    // The copy of the neural net on this GPU, or NULL if this is the GPU of
+    // the thread that called Initialize(), which uses am_nnet_'s.
+    std::unique_ptr<nnet3::Nnet> nnet;
+  };
+  // One per GPU; the control threads are assigned to them round-robin.
+  std::vector<std::unique_ptr<DeviceState> > devices_;
+
   const TransitionModel *trans_model_;
   const nnet3::AmNnetSimple *am_nnet_;
+  // Input and output dimensions of the neural net, cf
+  // EstimateTaskDeviceMemory()
+  int32 nnet_input_dim_, nnet_ivector_dim_, nnet_output_dim_;
   nnet3::DecodableNnetSimpleLoopedInfo *decodable_info_;
   OnlineNnet2FeaturePipelineInfo *feature_info_;
 
@@ -371,6 +461,24 @@ private:
       tasks_lookup_;                              // Contains a map of
                                                   // utterance to TaskState
   std::vector<std::thread> thread_contexts_;      // A list of thread contexts
+
+  // Total time spent by the worker threads generating and determinizing
+  // lattices, which is logged by Finalize().
+  double lattice_time_;
+  std::mutex lattice_time_mutex_;
+
+  // Metrics (see util/kaldi-metrics.h), which are looked up in Initialize():
+  // the length of the pending task queue, the number of tasks that have been
+  // added but not completed, the total length of the audio decoded, and the
+  // time taken by the stages of the pipeline (by the host, for each batch or,
+  // for the lattice stage, each task).
+  MetricsGauge *pending_tasks_gauge_;
+  MetricsGauge *tasks_not_done_gauge_;
+  MetricsCounter *audio_seconds_counter_;
+  MetricsHistogram *features_seconds_histogram_;
+  MetricsHistogram *nnet_seconds_histogram_;
+  MetricsHistogram *decode_seconds_histogram_;
+  MetricsHistogram *lattice_seconds_histogram_;
 };
 
 }  // end namespace cuda_decoder
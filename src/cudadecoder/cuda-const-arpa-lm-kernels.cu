@@ -0,0 +1,159 @@
+// cudadecoder/cuda-const-arpa-lm-kernels.cu
+//
+// Copyright 2026  Kaldi contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cfloat>
+#include "cuda-const-arpa-lm-kernels.h"
+#include "cuda-decoder-common.h"
+
+namespace kaldi {
+namespace cuda_decoder {
+
+// The functions below are the device versions of the ConstArpaLm functions of
+// the same names; see lm/const-arpa-lm.cc for the layout of an LmState.
+
+// Returns false if 'word' is not a child of 'parent'.
+__device__ bool lm_get_child_info(const CudaConstArpaLmParams &params,
+                                  int64 parent, int32 word,
+                                  int32 *child_info) {
+  const int32 *lm_states = params.d_lm_states;
+  int32 start_index = 1, end_index = lm_states[parent + 2];
+  while (start_index <= end_index) {
+    int32 mid_index = (start_index + end_index) / 2;
+    int32 mid_word = lm_states[parent + 1 + 2 * mid_index];
+    if (mid_word == word) {
+      *child_info = lm_states[parent + 2 + 2 * mid_index];
+      return true;
+    } else if (mid_word < word) {
+      start_index = mid_index + 1;
+    } else {
+      end_index = mid_index - 1;
+    }
+  }
+  return false;
+}
+
+// Returns the child LmState, or -1 if the child is a leaf.
+__device__ int64 lm_decode_child_info(const CudaConstArpaLmParams &params,
+                                      int32 child_info, int64 parent,
+                                      float *logprob) {
+  if (child_info % 2 == 0) {
+    *logprob = __int_as_float(child_info);
+    return -1;
+  }
+  int32 child_offset = child_info / 2;
+  int64 child = (child_offset > 0 ? parent + child_offset
+                                  : params.d_overflow_buffer[-child_offset]);
+  *logprob = __int_as_float(params.d_lm_states[child]);
+  return child;
+}
+
+__device__ int64 lm_get_lm_state(const CudaConstArpaLmParams &params,
+                                 const int32 *seq, int32 len) {
+  if (len == 0 || seq[0] < 0 || seq[0] >= params.num_words) return -1;
+  int64 state = params.d_unigram_states[seq[0]];
+  for (int32 i = 1; i < len && state >= 0; ++i) {
+    int32 child_info;
+    float logprob;
+    if (!lm_get_child_info(params, state, seq[i], &child_info)) return -1;
+    state = lm_decode_child_info(params, child_info, state, &logprob);
+  }
+  return state;
+}
+
+__device__ int32 lm_map_word(const CudaConstArpaLmParams &params,
+                             int32 word) {
+  if (params.unk_symbol == -1) return word;
+  if (word >= params.num_words || params.d_unigram_states[word] < 0)
+    return params.unk_symbol;
+  return word;
+}
+
+// One thread per query. The log-probability is computed as
+// ConstArpaLm::GetNgramLogprob(word, history_states) does, with the floating
+// point operations in the same order so that the result is identical, and
+// the next history as in ConstArpaLmDeterministicFst::GetArc().
+__global__ void compute_lm_queries_kernel(CudaConstArpaLmParams params,
+                                          const CudaLmQuery *d_queries,
+                                          int32 nqueries,
+                                          CudaLmResult *d_results) {
+  KALDI_CUDA_DECODER_1D_KERNEL_LOOP(iquery, nqueries) {
+    const CudaLmQuery &query = d_queries[iquery];
+    const int32 hist_len = query.hist_len;
+
+    // The LmStates of the suffixes of the mapped history, as in
+    // ConstArpaLm::GetHistoryStates().
+    int32 mapped_hist[KALDI_CUDA_LM_MAX_HISTORY];
+    int64 history_states[KALDI_CUDA_LM_MAX_HISTORY];
+    for (int32 i = 0; i < hist_len; ++i)
+      mapped_hist[i] = lm_map_word(params, query.hist[i]);
+    for (int32 i = 0; i < hist_len; ++i)
+      history_states[i] =
+          lm_get_lm_state(params, mapped_hist + i, hist_len - i);
+
+    const int32 word = lm_map_word(params, query.word);
+    float logprob = 0.0f;
+    int32 i = 0;
+    for (; i < hist_len; ++i) {
+      int32 child_info;
+      if (history_states[i] >= 0 &&
+          lm_get_child_info(params, history_states[i], word, &child_info)) {
+        lm_decode_child_info(params, child_info, history_states[i], &logprob);
+        break;
+      }
+    }
+    if (i == hist_len) {
+      if (word >= params.num_words || params.d_unigram_states[word] < 0)
+        logprob = FLT_MIN;
+      else
+        logprob = __int_as_float(
+            params.d_lm_states[params.d_unigram_states[word]]);
+    }
+    while (i > 0) {
+      --i;
+      if (history_states[i] >= 0)
+        logprob = __int_as_float(params.d_lm_states[history_states[i] + 1]) +
+                  logprob;
+    }
+
+    // The next history is the longest suffix of hist + word, of at most
+    // ngram_order - 1 words, that has children. As in the CPU code, this uses
+    // the words before mapping.
+    int32 seq[KALDI_CUDA_LM_MAX_HISTORY + 1];
+    for (int32 j = 0; j < hist_len; ++j) seq[j] = query.hist[j];
+    const int32 len = hist_len + 1;
+    seq[hist_len] = query.word;
+    int32 begin = max(0, len - (params.ngram_order - 1));
+    for (; begin < len; ++begin) {
+      int64 state = lm_get_lm_state(params, seq + begin, len - begin);
+      if (state >= 0 && params.d_lm_states[state + 2] > 0) break;
+    }
+
+    d_results[iquery].logprob = logprob;
+    d_results[iquery].next_hist_len = len - begin;
+  }
+}
+
+void ComputeLmQueriesKernel(const dim3 &grid, const dim3 &block,
+                            const cudaStream_t &st,
+                            const CudaConstArpaLmParams &params,
+                            const CudaLmQuery *d_queries, int32 nqueries,
+                            CudaLmResult *d_results) {
+  compute_lm_queries_kernel<<<grid, block, 0, st>>>(params, d_queries,
+                                                    nqueries, d_results);
+}
+
+}  // namespace cuda_decoder
+}  // namespace kaldi
@@ -0,0 +1,72 @@
+// cudadecoder/cuda-const-arpa-lm-kernels.h
+//
+// Copyright 2026  Kaldi contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_CUDA_DECODER_CUDA_CONST_ARPA_LM_KERNELS_H_
+#define KALDI_CUDA_DECODER_CUDA_CONST_ARPA_LM_KERNELS_H_
+
+#include <cuda_runtime_api.h>
+
+#include "base/kaldi-types.h"
+
+// Longest history a query can have, i.e. the highest supported n-gram order
+// minus one.
+#define KALDI_CUDA_LM_MAX_HISTORY 7
+
+namespace kaldi {
+namespace cuda_decoder {
+
+// A lookup in the language model: the log-probability of 'word' after the
+// word sequence hist[0] ... hist[hist_len - 1], which has at most
+// NgramOrder() - 1 words. The words are the labels of the lattice; OOVs are
+// mapped to <unk> on the device, as ConstArpaLm::GetNgramLogprob() does.
+struct CudaLmQuery {
+  int32 hist[KALDI_CUDA_LM_MAX_HISTORY];
+  int32 hist_len;
+  int32 word;
+};
+
+// The answer to a CudaLmQuery. 'logprob' is what
+// ConstArpaLm::GetNgramLogprob() returns, including its
+// std::numeric_limits<float>::min() for words that are not in the model, and
+// the history that follows 'word' is the last 'next_hist_len' words of
+// hist + word, as in ConstArpaLmDeterministicFst::GetArc().
+struct CudaLmResult {
+  float logprob;
+  int32 next_hist_len;
+};
+
+// The arrays of a ConstArpaLm, in device memory. LmStates are identified by
+// their index in d_lm_states; -1 means none.
+struct CudaConstArpaLmParams {
+  const int32 *d_lm_states;
+  const int64 *d_unigram_states;  // num_words entries.
+  const int64 *d_overflow_buffer;  // overflow_buffer_size entries.
+  int32 num_words;
+  int32 unk_symbol;
+  int32 ngram_order;
+};
+
+// Answers d_queries[0] ... d_queries[nqueries - 1], one thread per query.
+void ComputeLmQueriesKernel(const dim3 &grid, const dim3 &block,
+                            const cudaStream_t &st,
+                            const CudaConstArpaLmParams &params,
+                            const CudaLmQuery *d_queries, int32 nqueries,
+                            CudaLmResult *d_results);
+
+}  // namespace cuda_decoder
+}  // namespace kaldi
+
+#endif  // KALDI_CUDA_DECODER_CUDA_CONST_ARPA_LM_KERNELS_H_
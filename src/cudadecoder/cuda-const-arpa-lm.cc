@@ -0,0 +1,320 @@
+// cudadecoder/cuda-const-arpa-lm.cc
+//
+// Copyright 2026  Kaldi contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#if HAVE_CUDA == 1
+
+#include "cudadecoder/cuda-const-arpa-lm.h"
+
+#include <cuda_runtime_api.h>
+#include <nvToolsExt.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace kaldi {
+namespace cuda_decoder {
+
+CudaConstArpaLm::CudaConstArpaLm()
+    : bos_symbol_(-1),
+      eos_symbol_(-1),
+      d_lm_states_(nullptr),
+      d_unigram_states_(nullptr),
+      d_overflow_buffer_(nullptr),
+      d_queries_(nullptr),
+      d_results_(nullptr),
+      queries_capacity_(0) {
+  params_.d_lm_states = nullptr;
+  params_.d_unigram_states = nullptr;
+  params_.d_overflow_buffer = nullptr;
+  params_.num_words = 0;
+  params_.unk_symbol = -1;
+  params_.ngram_order = 0;
+}
+
+CudaConstArpaLm::~CudaConstArpaLm() { Finalize(); }
+
+void CudaConstArpaLm::Initialize(const ConstArpaLm &lm) {
+  nvtxRangePushA("CudaConstArpaLm constructor");
+  Finalize();
+  if (lm.NgramOrder() - 1 > KALDI_CUDA_LM_MAX_HISTORY)
+    KALDI_ERR << "CudaConstArpaLm supports n-gram orders up to "
+              << KALDI_CUDA_LM_MAX_HISTORY + 1 << ", the language model has "
+              << "order " << lm.NgramOrder();
+  bos_symbol_ = lm.BosSymbol();
+  eos_symbol_ = lm.EosSymbol();
+
+  int32 num_words = lm.NumWords(),
+      overflow_buffer_size = lm.OverflowBufferSize();
+  std::vector<int64> unigram_states(num_words), overflow_buffer(
+      overflow_buffer_size);
+  for (int32 w = 0; w < num_words; ++w)
+    unigram_states[w] = lm.UnigramStateIndex(w);
+  for (int32 i = 0; i < overflow_buffer_size; ++i)
+    overflow_buffer[i] = lm.OverflowStateIndex(i);
+
+  size_t lm_states_bytes = lm.LmStatesSize() * sizeof(*d_lm_states_);
+  d_lm_states_ = static_cast<int32 *>(
+      CuDevice::Instantiate().Malloc(lm_states_bytes));
+  d_unigram_states_ = static_cast<int64 *>(CuDevice::Instantiate().Malloc(
+      std::max(num_words, 1) * sizeof(*d_unigram_states_)));
+  d_overflow_buffer_ = static_cast<int64 *>(CuDevice::Instantiate().Malloc(
+      std::max(overflow_buffer_size, 1) * sizeof(*d_overflow_buffer_)));
+  // If the language model was memory-mapped, this reads it straight from the
+  // page cache.
+  KALDI_DECODER_CUDA_API_CHECK_ERROR(cudaMemcpy(d_lm_states_, lm.LmStates(),
+                                                lm_states_bytes,
+                                                cudaMemcpyHostToDevice));
+  KALDI_DECODER_CUDA_API_CHECK_ERROR(
+      cudaMemcpy(d_unigram_states_, unigram_states.data(),
+                 num_words * sizeof(*d_unigram_states_),
+                 cudaMemcpyHostToDevice));
+  KALDI_DECODER_CUDA_API_CHECK_ERROR(
+      cudaMemcpy(d_overflow_buffer_, overflow_buffer.data(),
+                 overflow_buffer_size * sizeof(*d_overflow_buffer_),
+                 cudaMemcpyHostToDevice));
+
+  params_.d_lm_states = d_lm_states_;
+  params_.d_unigram_states = d_unigram_states_;
+  params_.d_overflow_buffer = d_overflow_buffer_;
+  params_.num_words = num_words;
+  params_.unk_symbol = lm.UnkSymbol();
+  params_.ngram_order = lm.NgramOrder();
+  nvtxRangePop();
+}
+
+void CudaConstArpaLm::ComputeQueries(const std::vector<CudaLmQuery> &queries,
+                                     std::vector<CudaLmResult> *results) {
+  KALDI_ASSERT(d_lm_states_ &&
+               "Please call CudaConstArpaLm::Initialize() first");
+  int32 nqueries = queries.size();
+  results->resize(nqueries);
+  if (nqueries == 0) return;
+  if (nqueries > queries_capacity_) {
+    if (d_queries_ != nullptr) {
+      CuDevice::Instantiate().Free(d_queries_);
+      CuDevice::Instantiate().Free(d_results_);
+    }
+    queries_capacity_ = std::max(nqueries, 2 * queries_capacity_);
+    d_queries_ = static_cast<CudaLmQuery *>(CuDevice::Instantiate().Malloc(
+        queries_capacity_ * sizeof(*d_queries_)));
+    d_results_ = static_cast<CudaLmResult *>(CuDevice::Instantiate().Malloc(
+        queries_capacity_ * sizeof(*d_results_)));
+  }
+  cudaStream_t st = cudaStreamPerThread;
+  KALDI_DECODER_CUDA_API_CHECK_ERROR(
+      cudaMemcpyAsync(d_queries_, queries.data(),
+                      nqueries * sizeof(*d_queries_), cudaMemcpyHostToDevice,
+                      st));
+  ComputeLmQueriesKernel(KaldiCudaDecoderNumBlocks(nqueries, 1),
+                         KALDI_CUDA_DECODER_1D_BLOCK, st, params_, d_queries_,
+                         nqueries, d_results_);
+  KALDI_DECODER_CUDA_API_CHECK_ERROR(cudaGetLastError());
+  KALDI_DECODER_CUDA_API_CHECK_ERROR(
+      cudaMemcpyAsync(results->data(), d_results_,
+                      nqueries * sizeof(*d_results_), cudaMemcpyDeviceToHost,
+                      st));
+  KALDI_DECODER_CUDA_API_CHECK_ERROR(cudaStreamSynchronize(st));
+}
+
+void CudaConstArpaLm::Finalize() {
+  if (d_lm_states_ == nullptr) return;
+  CuDevice::Instantiate().Free(d_lm_states_);
+  CuDevice::Instantiate().Free(d_unigram_states_);
+  CuDevice::Instantiate().Free(d_overflow_buffer_);
+  if (d_queries_ != nullptr) {
+    CuDevice::Instantiate().Free(d_queries_);
+    CuDevice::Instantiate().Free(d_results_);
+  }
+  d_lm_states_ = nullptr;
+  d_unigram_states_ = nullptr;
+  d_overflow_buffer_ = nullptr;
+  d_queries_ = nullptr;
+  d_results_ = nullptr;
+  queries_capacity_ = 0;
+}
+
+int32 CudaLatticeLmComposer::FindOrAddState(const std::vector<int32> &wseq) {
+  std::pair<unordered_map<std::vector<int32>, int32,
+                          VectorHasher<int32> >::iterator, bool> result =
+      wseq_to_state_.insert(std::make_pair(wseq, state_to_wseq_.size()));
+  if (result.second) state_to_wseq_.push_back(wseq);
+  return result.first->second;
+}
+
+void CudaLatticeLmComposer::RequestArc(int32 s, int32 word) {
+  ArcKey key(s, word);
+  if (!arcs_.insert(std::make_pair(key, ArcValue(-2, 0.0))).second) return;
+  requested_.push_back(key);
+  // The history is truncated as in ConstArpaLm::GetHistoryStates().
+  const std::vector<int32> &wseq = state_to_wseq_[s];
+  int32 hist_len = std::min<int32>(wseq.size(), lm_->NgramOrder() - 1);
+  CudaLmQuery query;
+  std::copy(wseq.end() - hist_len, wseq.end(), query.hist);
+  query.hist_len = hist_len;
+  query.word = word;
+  queries_.push_back(query);
+}
+
+void CudaLatticeLmComposer::ComputeRequestedArcs() {
+  if (requested_.empty()) return;
+  lm_->ComputeQueries(queries_, &results_);
+  std::vector<int32> wseq;
+  for (size_t i = 0; i < requested_.size(); ++i) {
+    const CudaLmQuery &query = queries_[i];
+    const CudaLmResult &result = results_[i];
+    ArcValue &value = arcs_[requested_[i]];
+    value.second = result.logprob;
+    if (result.logprob == std::numeric_limits<float>::min()) {
+      value.first = -1;
+      continue;
+    }
+    // The next history is the last next_hist_len words of hist + word.
+    wseq.assign(query.hist, query.hist + query.hist_len);
+    wseq.push_back(query.word);
+    wseq.erase(wseq.begin(), wseq.end() - result.next_hist_len);
+    value.first = FindOrAddState(wseq);
+  }
+  requested_.clear();
+  queries_.clear();
+}
+
+void CudaLatticeLmComposer::ExpandState(
+    const CompactLattice &clat, const StatePair &pair,
+    unordered_map<StatePair, StateId, PairHasher<StateId> > *state_map,
+    std::vector<StatePair> *queue, CompactLattice *composed_clat) {
+  typedef CompactLatticeArc::Weight Weight2;
+  StateId s1 = pair.first, s2 = pair.second;
+  StateId composed_state = (*state_map)[pair];
+
+  Weight2 clat_final = clat.Final(s1);
+  if (clat_final.Weight().Value1() !=
+      std::numeric_limits<BaseFloat>::infinity()) {
+    float det_fst_final = -arcs_[ArcKey(s2, lm_->EosSymbol())].second;
+    if (det_fst_final != std::numeric_limits<BaseFloat>::infinity()) {
+      Weight2 final_weight(LatticeWeight(clat_final.Weight().Value1() +
+                                         det_fst_final,
+                                         clat_final.Weight().Value2()),
+                           clat_final.String());
+      composed_clat->SetFinal(composed_state, final_weight);
+    }
+  }
+
+  for (fst::ArcIterator<CompactLattice> aiter(clat, s1); !aiter.Done();
+       aiter.Next()) {
+    const CompactLatticeArc &arc1 = aiter.Value();
+    StateId next_state2 = s2;
+    float arc2_weight = 0.0;
+    if (arc1.olabel != 0) {
+      const ArcValue &value = arcs_[ArcKey(s2, arc1.olabel)];
+      KALDI_ASSERT(value.first != -2);
+      if (value.first == -1) continue;
+      next_state2 = value.first;
+      arc2_weight = -value.second;
+    }
+    StatePair next_pair(arc1.nextstate, next_state2);
+    std::pair<unordered_map<StatePair, StateId,
+                            PairHasher<StateId> >::iterator, bool> result =
+        state_map->insert(std::make_pair(next_pair, composed_clat->NumStates()));
+    if (result.second) {
+      composed_clat->AddState();
+      queue->push_back(next_pair);
+    }
+    StateId next_state = result.first->second;
+    if (arc1.olabel == 0) {
+      composed_clat->AddArc(composed_state,
+                            CompactLatticeArc(arc1.ilabel, 0, arc1.weight,
+                                              next_state));
+    } else {
+      Weight2 composed_weight(
+          LatticeWeight(arc1.weight.Weight().Value1() + arc2_weight,
+                        arc1.weight.Weight().Value2()),
+          arc1.weight.String());
+      composed_clat->AddArc(composed_state,
+                            CompactLatticeArc(arc1.ilabel, arc1.olabel,
+                                              composed_weight, next_state));
+    }
+  }
+}
+
+void CudaLatticeLmComposer::Compose(
+    const std::vector<const CompactLattice*> &clats,
+    std::vector<CompactLattice> *composed_clats) {
+  nvtxRangePushA("CudaLatticeLmComposer::Compose");
+  // The LM states and arcs are shared by the lattices of a batch, and
+  // forgotten afterwards so that the memory used does not grow with time.
+  state_to_wseq_.clear();
+  wseq_to_state_.clear();
+  arcs_.clear();
+  int32 start_state2 = FindOrAddState(std::vector<int32>(1,
+                                                         lm_->BosSymbol()));
+
+  size_t num_lats = clats.size();
+  composed_clats->resize(num_lats);
+  std::vector<unordered_map<StatePair, StateId, PairHasher<StateId> > >
+      state_maps(num_lats);
+  // The queue of the breadth-first search of each lattice, and the position
+  // in it of the first state that is not expanded.
+  std::vector<std::vector<StatePair> > queues(num_lats);
+  std::vector<size_t> heads(num_lats, 0);
+  for (size_t i = 0; i < num_lats; ++i) {
+    CompactLattice &composed_clat = (*composed_clats)[i];
+    composed_clat.DeleteStates();
+    if (clats[i]->Start() == fst::kNoStateId) continue;
+    StatePair start_pair(clats[i]->Start(), start_state2);
+    composed_clat.SetStart(composed_clat.AddState());
+    state_maps[i][start_pair] = 0;
+    queues[i].push_back(start_pair);
+  }
+
+  while (true) {
+    // Gathers the lookups needed to expand all of the queued states...
+    bool done = true;
+    for (size_t i = 0; i < num_lats; ++i) {
+      const CompactLattice &clat = *clats[i];
+      for (size_t q = heads[i]; q < queues[i].size(); ++q) {
+        done = false;
+        StateId s1 = queues[i][q].first, s2 = queues[i][q].second;
+        if (clat.Final(s1).Weight().Value1() !=
+            std::numeric_limits<BaseFloat>::infinity())
+          RequestArc(s2, lm_->EosSymbol());
+        for (fst::ArcIterator<CompactLattice> aiter(clat, s1);
+             !aiter.Done(); aiter.Next()) {
+          if (aiter.Value().olabel != 0)
+            RequestArc(s2, aiter.Value().olabel);
+        }
+      }
+    }
+    if (done) break;
+    // ... does them in one batch, and expands those states in order, which
+    // queues the next ones.
+    ComputeRequestedArcs();
+    for (size_t i = 0; i < num_lats; ++i) {
+      for (size_t end = queues[i].size(); heads[i] < end; ++heads[i]) {
+        StatePair pair = queues[i][heads[i]];
+        ExpandState(*clats[i], pair, &state_maps[i], &queues[i],
+                    &(*composed_clats)[i]);
+      }
+    }
+  }
+  for (size_t i = 0; i < num_lats; ++i)
+    fst::Connect(&(*composed_clats)[i]);
+  nvtxRangePop();
+}
+
+}  // namespace cuda_decoder
+}  // namespace kaldi
+
+#endif  // HAVE_CUDA == 1
@@ -0,0 +1,132 @@
+// cudadecoder/cuda-const-arpa-lm.h
+//
+// Copyright 2026  Kaldi contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_CUDA_DECODER_CUDA_CONST_ARPA_LM_H_
+#define KALDI_CUDA_DECODER_CUDA_CONST_ARPA_LM_H_
+
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "cudadecoder/cuda-const-arpa-lm-kernels.h"
+#include "cudadecoder/cuda-decoder-common.h"
+#include "cudamatrix/cu-device.h"
+#include "lat/kaldi-lattice.h"
+#include "lm/const-arpa-lm.h"
+#include "util/stl-utils.h"
+
+namespace kaldi {
+namespace cuda_decoder {
+
+// A copy of a ConstArpaLm in device memory, which answers n-gram lookups in
+// batches. Only the <lm_states_> array and the unigram and overflow tables are
+// copied (as indexes into <lm_states_>), so the device memory used is about
+// the size of the ConstArpaLm file.
+class CudaConstArpaLm {
+ public:
+  CudaConstArpaLm();
+  ~CudaConstArpaLm();
+
+  // Copies 'lm' to the device. 'lm' is not used afterwards.
+  void Initialize(const ConstArpaLm &lm);
+
+  // Answers all of 'queries' with one kernel launch; see CudaLmQuery. The
+  // histories must have at most NgramOrder() - 1 words.
+  void ComputeQueries(const std::vector<CudaLmQuery> &queries,
+                      std::vector<CudaLmResult> *results);
+
+  int32 BosSymbol() const { return bos_symbol_; }
+  int32 EosSymbol() const { return eos_symbol_; }
+  int32 NgramOrder() const { return params_.ngram_order; }
+
+ private:
+  void Finalize();
+
+  int32 bos_symbol_;
+  int32 eos_symbol_;
+  // Holds the device pointers.
+  CudaConstArpaLmParams params_;
+  int32 *d_lm_states_;
+  int64 *d_unigram_states_;
+  int64 *d_overflow_buffer_;
+  // Buffers for ComputeQueries(), which only grow.
+  CudaLmQuery *d_queries_;
+  CudaLmResult *d_results_;
+  int32 queries_capacity_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(CudaConstArpaLm);
+};
+
+// Composes lattices with a CudaConstArpaLm. For each lattice the result is the
+// same as that of ComposeCompactLatticeDeterministic() with a
+// ConstArpaLmDeterministicFst, state numbering included, but the lattices of a
+// batch are composed together, breadth-first, and at each step the language
+// model lookups needed to expand the current frontiers of all of them are done
+// in one call to CudaConstArpaLm::ComputeQueries().
+class CudaLatticeLmComposer {
+ public:
+  explicit CudaLatticeLmComposer(CudaConstArpaLm *lm): lm_(lm) { }
+
+  // Sets (*composed_clats)[i] to the composition of *clats[i] with the
+  // language model. The lattices should be sorted on olabel, as for
+  // ComposeCompactLatticeDeterministic().
+  void Compose(const std::vector<const CompactLattice*> &clats,
+               std::vector<CompactLattice> *composed_clats);
+
+ private:
+  typedef CompactLatticeArc::StateId StateId;
+  typedef std::pair<StateId, StateId> StatePair;
+  typedef std::pair<int32, int32> ArcKey;  // (LM state, word)
+  // Next LM state (-1 if there is no arc) and log-probability.
+  typedef std::pair<int32, float> ArcValue;
+
+  // Returns the LM state of the history 'wseq', adding it if needed.
+  int32 FindOrAddState(const std::vector<int32> &wseq);
+
+  // Adds a query for the arc from LM state 's' with label 'word' unless it is
+  // known or already requested.
+  void RequestArc(int32 s, int32 word);
+
+  // Answers the queries requested since the last call.
+  void ComputeRequestedArcs();
+
+  // Expands the composed state 'pair' of 'clat' as
+  // ComposeCompactLatticeDeterministic() does; all of the LM arcs it needs
+  // must be known.
+  void ExpandState(const CompactLattice &clat, const StatePair &pair,
+                   unordered_map<StatePair, StateId,
+                                 PairHasher<StateId> > *state_map,
+                   std::vector<StatePair> *queue,
+                   CompactLattice *composed_clat);
+
+  CudaConstArpaLm *lm_;
+  std::vector<std::vector<int32> > state_to_wseq_;
+  unordered_map<std::vector<int32>, int32, VectorHasher<int32> >
+      wseq_to_state_;
+  // Arcs that have been computed; arcs that are requested but not yet
+  // computed have next state -2.
+  unordered_map<ArcKey, ArcValue, PairHasher<int32> > arcs_;
+  std::vector<ArcKey> requested_;
+  std::vector<CudaLmQuery> queries_;
+  std::vector<CudaLmResult> results_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(CudaLatticeLmComposer);
+};
+
+}  // namespace cuda_decoder
+}  // namespace kaldi
+
+#endif  // KALDI_CUDA_DECODER_CUDA_CONST_ARPA_LM_H_
@@ -31,6 +31,7 @@ __global__ void init_hashmap_kernel(DeviceParams cst_dev_params) {
     KALDI_CUDA_DECODER_1D_KERNEL_LOOP(idx, capacity) {
       cst_dev_params.d_hashmap_values.lane(ilane)[idx] =
           KALDI_CUDA_DECODER_HASHMAP_NO_VAL;
+      cst_dev_params.d_hashmap_n_extra_prev_tokens.lane(ilane)[idx] = 0;
     }
   }
 }
@@ -1452,6 +1453,66 @@ __global__ void fill_hashmap_with_main_q_kernel(DeviceParams cst_dev_params,
   }
 }
 
+// Pruning the extra prev tokens, before they are listed in
+// d_main_q_extra_prev_tokens and copied to the host.
+// When multiple tokens are associated with the same FST state, only the best
+// one is expanded, and the others are only used to generate the lattice. On
+// the host, an arc is kept in the lattice only if the extra cost of its token
+// (compared to the best token for that state), plus the extra cost of that
+// state in the lattice, which is >= 0, is less than lattice_beam (cf
+// CudaDecoder::ConsiderTokenForLattice). So a token whose own extra cost is
+// already >= lattice_beam can never be used, and we drop it here. The lattice
+// is unchanged, but the lists are shorter.
+// Each token that we keep gets its index in the list of its state in
+// d_main_q_n_extra_prev_tokens_local_idx (replacing the one set by
+// fill_hashmap_with_main_q_kernel, which counted all tokens), and the length
+// of that list is counted in d_hashmap_n_extra_prev_tokens. A dropped token
+// gets -1. The best token is always kept, because the lattice generation
+// needs an arc with extra_cost == 0 for each state.
+__global__ void prune_extra_prev_tokens_kernel(DeviceParams cst_dev_params,
+                                               KernelParams params) {
+  const int nlanes = params.nlanes_used;
+  KALDI_CUDA_DECODER_BATCH_KERNEL_LOOP(ilane, nlanes) {
+    const LaneCounters *lane_counters =
+        cst_dev_params.d_lanes_counters.lane(ilane);
+    const int32 ichannel = lane_counters->channel_to_compute;
+    const int32 main_q_end = lane_counters->main_q_narcs_and_end.y;
+    KALDI_CUDA_DECODER_1D_KERNEL_LOOP(main_q_idx, main_q_end) {
+      bool is_representative;  // not set yet (cf step1)
+      int32 hash_idx;
+      GetFSTStateHashIndex(
+          cst_dev_params.d_main_q_state_hash_idx.lane(ilane)[main_q_idx],
+          &hash_idx, &is_representative);
+      const HashmapValueT val =
+          cst_dev_params.d_hashmap_values.lane(ilane)[hash_idx];
+      // If the token is alone for its state, it won't be moved to the
+      // extra_prev_tokens list
+      if (val.count > 1) {
+        uint32_t best_int_cost, argmin;
+        GetMinFromPackedArgminUInt64(val.min_and_argmin_int_cost_u64,
+                                     &best_int_cost);
+        GetArgFromPackedArgminUInt64(val.min_and_argmin_int_cost_u64, &argmin);
+        // Same extra cost as the one computed in step4
+        CostType token_cost = orderedIntToFloat(
+            cst_dev_params.d_main_q_state_and_cost.channel(ichannel)[main_q_idx]
+                .y);
+        CostType extra_cost =
+            token_cost - orderedIntToFloat((int)best_int_cost);
+        int32 local_idx = -1;
+        if (main_q_idx == (int32)argmin ||
+            extra_cost < cst_dev_params.lattice_beam) {
+          local_idx = atomicAdd(
+              &cst_dev_params.d_hashmap_n_extra_prev_tokens.lane(
+                  ilane)[hash_idx],
+              1);
+        }
+        cst_dev_params.d_main_q_n_extra_prev_tokens_local_idx.lane(
+            ilane)[main_q_idx] = local_idx;
+      }
+    }
+  }
+}
+
 // preprocess_and_list_extra_prev_tokens_kernel_step[i] kernels
 // Called in PostProcessingMainQueue
 // They do two things:
@@ -1566,8 +1627,13 @@ __global__ void emitting_preprocess_and_list_extra_prev_tokens_step1_kernel(
           // that token directly in
           // d_main_q_info (its original place)
           // We only move it into the d_main_q_extra_prev_tokens list if
-          // multiple tokens are associated to that state
-          n_extra_prev_token = (h_val.count > 1) ? (h_val.count) : 0;
+          // multiple tokens are associated to that state. Only the tokens
+          // kept by prune_extra_prev_tokens_kernel are moved
+          n_extra_prev_token =
+              (h_val.count > 1)
+                  ? cst_dev_params.d_hashmap_n_extra_prev_tokens.lane(
+                        ilane)[hash_idx]
+                  : 0;
         }
       }
 
@@ -1775,26 +1841,32 @@ __global__ void emitting_preprocess_and_list_extra_prev_tokens_step4_kernel(
         CostType acoustic_cost =
             cst_dev_params.d_main_q_acoustic_cost.lane(ilane)[main_q_idx];
         // Place of that specific token in the extra_prev_tokens sublist of that
-        // specific FST state
+        // specific FST state, or -1 if prune_extra_prev_tokens_kernel dropped
+        // it
         int32 local_idx =
             cst_dev_params.d_main_q_n_extra_prev_tokens_local_idx.lane(
                 ilane)[main_q_idx];
+        // Number of tokens in that sublist
+        int32 n_extra_prev_tokens =
+            cst_dev_params.d_hashmap_n_extra_prev_tokens.lane(ilane)[hash_idx];
         // Saving the location of the extra prev tokens for that state into that
         // InfoToken
         SetSameFSTStateTokensList(
-            prev_global_idx + extra_prev_tokens_offset, same_count,
+            prev_global_idx + extra_prev_tokens_offset, n_extra_prev_tokens,
             &cst_dev_params.d_main_q_info.lane(ilane)[main_q_idx]);
-        // Where to write this token in d_main_q_extra_prev_tokens
-        int32 list_idx = extra_prev_tokens_offset + local_idx;
-        // Moving token. Also saving extra_cost
-        cst_dev_params.d_main_q_extra_prev_tokens.lane(ilane)[list_idx] =
-            inf_tok;
-        cst_dev_params.d_main_q_extra_and_acoustic_cost.lane(
-            ilane)[list_idx] = {extra_cost, acoustic_cost};
-        assert(inf_tok.prev_token >= (lane_counters->main_q_global_offset -
-                                      cst_dev_params.main_q_capacity) &&
-               inf_tok.prev_token <=
-                   (lane_counters->main_q_global_offset + main_q_end));
+        if (local_idx >= 0) {
+          // Where to write this token in d_main_q_extra_prev_tokens
+          int32 list_idx = extra_prev_tokens_offset + local_idx;
+          // Moving token. Also saving extra_cost
+          cst_dev_params.d_main_q_extra_prev_tokens.lane(ilane)[list_idx] =
+              inf_tok;
+          cst_dev_params.d_main_q_extra_and_acoustic_cost.lane(
+              ilane)[list_idx] = {extra_cost, acoustic_cost};
+          assert(inf_tok.prev_token >= (lane_counters->main_q_global_offset -
+                                        cst_dev_params.main_q_capacity) &&
+                 inf_tok.prev_token <=
+                     (lane_counters->main_q_global_offset + main_q_end));
+        }
       }
     }
   }
@@ -1823,6 +1895,7 @@ __global__ void clear_hashmap_kernel(DeviceParams cst_dev_params,
       if (is_representative) {
         cst_dev_params.d_hashmap_values.lane(ilane)[hash_idx] =
             KALDI_CUDA_DECODER_HASHMAP_NO_VAL;  // clear
+        cst_dev_params.d_hashmap_n_extra_prev_tokens.lane(ilane)[hash_idx] = 0;
       }
     }
   }
@@ -1919,6 +1992,15 @@ void FillHashmapWithMainQKernel(const dim3 &grid, const dim3 &block,
   KALDI_DECODER_CUDA_CHECK_ERROR();
 }
 
+void PruneExtraPrevTokensKernel(const dim3 &grid, const dim3 &block,
+                                const cudaStream_t &st,
+                                const DeviceParams &cst_dev_params,
+                                const KernelParams &kernel_params) {
+  prune_extra_prev_tokens_kernel<<<grid, block, 0, st>>>(cst_dev_params,
+                                                         kernel_params);
+  KALDI_DECODER_CUDA_CHECK_ERROR();
+}
+
 void EmittingPreprocessAndListExtraPrevTokensStep1Kernel(
     const dim3 &grid, const dim3 &block, const cudaStream_t &st,
     const DeviceParams &cst_dev_params, const KernelParams &kernel_params) {
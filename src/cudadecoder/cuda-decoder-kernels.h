@@ -39,6 +39,7 @@ struct DeviceParams {
   LaneMatrixView<int2> d_aux_q_state_and_cost;
   LaneMatrixView<InfoToken> d_aux_q_info;
   LaneMatrixView<HashmapValueT> d_hashmap_values;
+  LaneMatrixView<int32> d_hashmap_n_extra_prev_tokens;
   LaneMatrixView<int2> h_list_final_tokens_in_main_q;
   LaneMatrixView<float2> d_main_q_extra_and_acoustic_cost;
   LaneMatrixView<int32> d_histograms;
@@ -126,6 +127,11 @@ void FillHashmapWithMainQKernel(const dim3 &grid, const dim3 &block,
                                 const DeviceParams &cst_dev_params,
                                 const KernelParams &kernel_params);
 
+void PruneExtraPrevTokensKernel(const dim3 &grid, const dim3 &block,
+                                const cudaStream_t &st,
+                                const DeviceParams &cst_dev_params,
+                                const KernelParams &kernel_params);
+
 void EmittingPreprocessAndListExtraPrevTokensStep1Kernel(
     const dim3 &grid, const dim3 &block, const cudaStream_t &st,
     const DeviceParams &cst_dev_params, const KernelParams &kernel_params);
@@ -34,6 +34,7 @@ CudaDecoder::CudaDecoder(const CudaFst &fst, const CudaDecoderConfig &config,
     : fst_(fst),
       nlanes_(nlanes),
       nchannels_(nchannels),
+      observer_(NULL),
       channel_lock_(nchannels + 1),
       extra_cost_min_delta_(0.0f),
       thread_pool_(NULL),
@@ -92,6 +93,11 @@ void CudaDecoder::ReadConfig(const CudaDecoderConfig &cst_config) {
   // Sets the missing values using other values
   config.ComputeConfig();
   default_beam_ = config.default_beam;
+  use_cuda_graphs_ = config.use_cuda_graphs;
+#if CUDART_VERSION < 10000
+  if (use_cuda_graphs_)
+    KALDI_ERR << "--cuda-graphs requires CUDA 10 or newer.";
+#endif
   lattice_beam_ = config.lattice_beam;
   ntokens_pre_allocated_ = config.ntokens_pre_allocated;
   max_active_ = config.max_active;
@@ -131,6 +137,7 @@ void CudaDecoder::AllocateDeviceData() {
                    1);
   d_main_q_arc_offsets_.Resize(nchannels_, main_q_capacity_);
   d_hashmap_values_.Resize(nlanes_, hashmap_capacity_);
+  d_hashmap_n_extra_prev_tokens_.Resize(nlanes_, hashmap_capacity_);
   d_main_q_acoustic_cost_.Resize(nlanes_, main_q_capacity_);
   d_extra_and_acoustic_cost_concat_matrix_.Resize(nlanes_, main_q_capacity_);
   d_acoustic_cost_concat_matrix_.Resize(nlanes_, main_q_capacity_);
@@ -184,12 +191,6 @@ void CudaDecoder::AllocateHostData() {
   h_all_tokens_acoustic_cost_.resize(nchannels_);
   h_all_tokens_extra_prev_tokens_.resize(nchannels_);
   h_all_tokens_info_.resize(nchannels_);
-  for (int32 ichannel = 0; ichannel < nchannels_; ++ichannel) {
-    h_all_tokens_extra_prev_tokens_extra_and_acoustic_cost_[ichannel].reserve(
-        ntokens_pre_allocated_);
-    h_all_tokens_acoustic_cost_[ichannel].reserve(ntokens_pre_allocated_);
-    h_all_tokens_info_[ichannel].reserve(ntokens_pre_allocated_);
-  }
   h_main_q_end_lane_offsets_.resize(nlanes_ + 1);
   h_emitting_main_q_end_lane_offsets_.resize(nlanes_ + 1);
   h_n_extra_prev_tokens_lane_offsets_.resize(nlanes_ + 1);
@@ -254,6 +255,8 @@ void CudaDecoder::InitDeviceParams() {
       d_main_q_extra_prev_tokens_.GetView();
   h_device_params_->d_main_q_arc_offsets = d_main_q_arc_offsets_.GetView();
   h_device_params_->d_hashmap_values = d_hashmap_values_.GetView();
+  h_device_params_->d_hashmap_n_extra_prev_tokens =
+      d_hashmap_n_extra_prev_tokens_.GetView();
   h_device_params_->d_histograms = d_histograms_.GetView();
   h_device_params_->d_arc_e_offsets = fst_.d_e_offsets_;
   h_device_params_->d_arc_ne_offsets = fst_.d_ne_offsets_;
@@ -300,6 +303,9 @@ CudaDecoder::~CudaDecoder() {
   h2h_threads_running_ = false;
   n_h2h_main_task_todo_cv_.notify_all();
   for (std::thread &thread : cpu_dedicated_threads_) thread.join();
+#if CUDART_VERSION >= 10000
+  for (auto &p : kernel_graphs_) cudaGraphExecDestroy(p.second);
+#endif
   cudaStreamDestroy(compute_st_);
   cudaStreamDestroy(copy_st_);
 
@@ -430,6 +436,14 @@ void CudaDecoder::InitDecoding(const std::vector<ChannelId> &channels) {
 void CudaDecoder::InitDecodingH2HCopies(ChannelId ichannel) {
   // Tokens from initial main_q needed on host
   std::unique_lock<std::mutex> channel_lk(channel_lock_[ichannel]);
+  if (h_all_tokens_info_[ichannel].capacity() <
+      static_cast<size_t>(ntokens_pre_allocated_)) {
+    // First use of that channel
+    h_all_tokens_extra_prev_tokens_extra_and_acoustic_cost_[ichannel].reserve(
+        ntokens_pre_allocated_);
+    h_all_tokens_acoustic_cost_[ichannel].reserve(ntokens_pre_allocated_);
+    h_all_tokens_info_[ichannel].reserve(ntokens_pre_allocated_);
+  }
   // Deep copy
   h_all_tokens_info_[ichannel] = h_all_tokens_info_[init_channel_id_];
   h_all_tokens_acoustic_cost_[ichannel] =
@@ -625,6 +639,12 @@ void CudaDecoder::PostProcessingMainQueue() {
                              KALDI_CUDA_DECODER_1D_BLOCK, compute_st_,
                              *h_device_params_, *h_kernel_params_);
 
+  // Dropping the tokens that cannot be in the lattice, so that fewer are
+  // listed in extra_prev_tokens and copied to the host
+  PruneExtraPrevTokensKernel(KaldiCudaDecoderNumBlocks(nlanes_used_),
+                             KALDI_CUDA_DECODER_1D_BLOCK, compute_st_,
+                             *h_device_params_, *h_kernel_params_);
+
   EmittingPreprocessAndListExtraPrevTokensStep1Kernel(
       KaldiCudaDecoderNumBlocks(nlanes_used_), KALDI_CUDA_DECODER_1D_BLOCK,
       compute_st_, *h_device_params_, *h_kernel_params_);
@@ -639,7 +659,6 @@ void CudaDecoder::PostProcessingMainQueue() {
   ComputeLaneOffsetsKernel(KaldiCudaDecoderNumBlocks(1, 1),  // One CTA
                            KALDI_CUDA_DECODER_1D_BLOCK, compute_st_,
                            *h_device_params_, *h_kernel_params_);
-  cudaEventRecord(lane_offsets_ready_evt_, compute_st_);
 
   EmittingPreprocessAndListExtraPrevTokensStep3Kernel(
       KaldiCudaDecoderNumBlocks(nlanes_used_), KALDI_CUDA_DECODER_1D_BLOCK,
@@ -766,6 +785,14 @@ void CudaDecoder::AdvanceDecoding(
 
   // Looping over the frames that we will compute
   for (int32 iframe = 0; iframe < nframes_to_decode; ++iframe) {
+    int64 frame_start_time = 0;
+    if (observer_ != NULL) {
+      frame_start_time = Tracer::Now();
+      h_prev_main_q_narcs_and_end_.resize(nlanes_used_);
+      for (LaneId ilane = 0; ilane < nlanes_used_; ++ilane)
+        h_prev_main_q_narcs_and_end_[ilane] =
+            h_lanes_counters_.lane(ilane)->main_q_narcs_and_end;
+    }
     // Loglikelihoods from the acoustic model
     // Setting the loglikelihoods pointers for that frame
     for (LaneId ilane = 0; ilane < nlanes_used_; ++ilane) {
@@ -781,60 +808,19 @@ void CudaDecoder::AdvanceDecoding(
     cudaEventRecord(nnet3_done_evt_, cudaStreamPerThread);
     cudaStreamWaitEvent(compute_st_, nnet3_done_evt_, 0);
 
-    // Estimating cutoff using argmin from last frame
-    ResetForFrameAndEstimateCutoffKernel(
-        KaldiCudaDecoderNumBlocks(1, nlanes_used_), KALDI_CUDA_DECODER_1D_BLOCK,
-        compute_st_, *h_device_params_, *h_kernel_params_);
     // Reset max active status. If necessary, ApplyMaxActiveAndReduceBeam will
     // switch it back on
     compute_max_active_ = false;
 
-    // Processing emitting arcs. We've done the preprocess stage at the end of
-    // the previous frame
-    ExpandArcsEmitting();
-    // We'll loop until we have a small enough number of non-emitting arcs
-    // in the token queue. We'll then break the loop
-    for (int i = 0; i < KALDI_CUDA_DECODER_N_NON_EMITTING_MAIN_ITERATIONS;
-         ++i) {
-      // If one of the aux_q contains more than max_active_ tokens,
-      // we'll reduce the beam to only keep max_active_ tokens
-      ApplyMaxActiveAndReduceBeam(AUX_Q);
-      // Prune the aux_q. Apply the latest beam (using the one from
-      // ApplyMaxActiveAndReduceBeam if triggered)
-      // move the survival tokens to the main queue
-      // and do the preprocessing necessary for the next ExpandArcs
-      PruneAndPreprocess();
-
-      // "heavy duty" kernel for non-emitting. The long tail of small
-      // non-emitting iterations will be done in
-      // FinalizeProcessNonEmittingKernel
-      ExpandArcsNonEmitting();
-    }
-    ApplyMaxActiveAndReduceBeam(AUX_Q);
-    PruneAndPreprocess();
-    // Finalizing process non emitting. Takes care of the long tail,
-    // the final iterations with a small numbers of arcs. Do the work inside a
-    // single CTA (per lane),
-    FinalizeProcessNonEmittingKernel(KaldiCudaDecoderNumBlocks(1, nlanes_used_),
-                                     KALDI_CUDA_DECODER_LARGEST_1D_BLOCK,
-                                     compute_st_, *h_device_params_,
-                                     *h_kernel_params_);
-
-    // We now have our final token main queues for that frame
-
-    // Post processing the tokens for that frame
-    // - do the preprocess necessary for the next emitting expand (will happen
-    // with next frame)
-    // - if a state S has more than one token associated to it, generate the
-    // list of those tokens
-    // It allows to backtrack efficiently in GetRawLattice
-    // - compute the extra costs
-    PostProcessingMainQueue();
+    // All the kernels of the frame, up to PostProcessingMainQueue
+    LaunchKernels(0, [this]() { ComputeFrameKernels(); });
+    // The lane offsets were computed in PostProcessingMainQueue
+    cudaEventRecord(lane_offsets_ready_evt_, compute_st_);
 
     // Waiting on previous d2h before writing on same device memory
     cudaStreamWaitEvent(compute_st_, d2h_copy_extra_prev_tokens_evt_, 0);
     // Concatenating the data that will be moved to host into large arrays
-    ConcatenateData();
+    LaunchKernels(1, [this]() { ConcatenateData(); });
     // Copying the final lane counters for that frame
     CopyLaneCountersToHostSync();
     CheckOverflow();
@@ -843,6 +829,9 @@ void CudaDecoder::AdvanceDecoding(
     // storage
     CopyMainQueueDataToHost();
 
+    if (observer_ != NULL)
+      ReportFrameStats((Tracer::Now() - frame_start_time) * 1.0e-09);
+
     for (LaneId ilane = 0; ilane < nlanes_used_; ++ilane) {
       const ChannelId ichannel = channel_to_compute_[ilane];
       // We're done processing that frame
@@ -858,6 +847,101 @@ void CudaDecoder::AdvanceDecoding(
   SaveChannelsStateFromLanes();
 }
 
+void CudaDecoder::ReportFrameStats(double seconds) {
+  for (LaneId ilane = 0; ilane < nlanes_used_; ++ilane) {
+    const ChannelId ichannel = channel_to_compute_[ilane];
+    const LaneCounters &lane_counters = *h_lanes_counters_.lane(ilane);
+    DecoderFrameStats stats;
+    stats.channel = ichannel;
+    stats.frame = num_frames_decoded_[ichannel];
+    // The tokens of the previous frame were pruned when they were created,
+    // so they were all expanded.
+    stats.num_tokens_expanded = h_prev_main_q_narcs_and_end_[ilane].y;
+    stats.num_emitting_arcs = h_prev_main_q_narcs_and_end_[ilane].x;
+    stats.num_tokens_out = lane_counters.main_q_narcs_and_end.y;
+    stats.adaptive_beam = orderedIntToFloatHost(lane_counters.int_beam);
+    stats.cutoff = orderedIntToFloatHost(lane_counters.int_cutoff);
+    stats.seconds = seconds;
+    observer_->FrameDecoded(stats);
+  }
+}
+
+void CudaDecoder::ComputeFrameKernels() {
+  // Estimating cutoff using argmin from last frame
+  ResetForFrameAndEstimateCutoffKernel(
+      KaldiCudaDecoderNumBlocks(1, nlanes_used_), KALDI_CUDA_DECODER_1D_BLOCK,
+      compute_st_, *h_device_params_, *h_kernel_params_);
+
+  // Processing emitting arcs. We've done the preprocess stage at the end of
+  // the previous frame
+  ExpandArcsEmitting();
+  // We'll loop until we have a small enough number of non-emitting arcs
+  // in the token queue. We'll then break the loop
+  for (int i = 0; i < KALDI_CUDA_DECODER_N_NON_EMITTING_MAIN_ITERATIONS; ++i) {
+    // If one of the aux_q contains more than max_active_ tokens,
+    // we'll reduce the beam to only keep max_active_ tokens
+    ApplyMaxActiveAndReduceBeam(AUX_Q);
+    // Prune the aux_q. Apply the latest beam (using the one from
+    // ApplyMaxActiveAndReduceBeam if triggered)
+    // move the survival tokens to the main queue
+    // and do the preprocessing necessary for the next ExpandArcs
+    PruneAndPreprocess();
+
+    // "heavy duty" kernel for non-emitting. The long tail of small
+    // non-emitting iterations will be done in
+    // FinalizeProcessNonEmittingKernel
+    ExpandArcsNonEmitting();
+  }
+  ApplyMaxActiveAndReduceBeam(AUX_Q);
+  PruneAndPreprocess();
+  // Finalizing process non emitting. Takes care of the long tail,
+  // the final iterations with a small numbers of arcs. Do the work inside a
+  // single CTA (per lane),
+  FinalizeProcessNonEmittingKernel(KaldiCudaDecoderNumBlocks(1, nlanes_used_),
+                                   KALDI_CUDA_DECODER_LARGEST_1D_BLOCK,
+                                   compute_st_, *h_device_params_,
+                                   *h_kernel_params_);
+
+  // We now have our final token main queues for that frame
+
+  // Post processing the tokens for that frame
+  // - do the preprocess necessary for the next emitting expand (will happen
+  // with next frame)
+  // - if a state S has more than one token associated to it, generate the
+  // list of those tokens
+  // It allows to backtrack efficiently in GetRawLattice
+  // - compute the extra costs
+  PostProcessingMainQueue();
+}
+
+void CudaDecoder::LaunchKernels(int32 graph_id,
+                                const std::function<void()> &launch_kernels) {
+#if CUDART_VERSION >= 10000
+  if (use_cuda_graphs_) {
+    std::pair<int32, int32> key(graph_id, nlanes_used_);
+    auto it = kernel_graphs_.find(key);
+    if (it == kernel_graphs_.end()) {
+      // Capturing the kernels launched by launch_kernels. Only this thread's
+      // CUDA calls are affected by the capture
+      cudaGraph_t graph;
+      cudaGraphExec_t graph_exec;
+      KALDI_DECODER_CUDA_API_CHECK_ERROR(cudaStreamBeginCapture(
+          compute_st_, cudaStreamCaptureModeThreadLocal));
+      launch_kernels();
+      KALDI_DECODER_CUDA_API_CHECK_ERROR(
+          cudaStreamEndCapture(compute_st_, &graph));
+      KALDI_DECODER_CUDA_API_CHECK_ERROR(
+          cudaGraphInstantiate(&graph_exec, graph, NULL, NULL, 0));
+      KALDI_DECODER_CUDA_API_CHECK_ERROR(cudaGraphDestroy(graph));
+      it = kernel_graphs_.insert({key, graph_exec}).first;
+    }
+    KALDI_DECODER_CUDA_API_CHECK_ERROR(cudaGraphLaunch(it->second, compute_st_));
+    return;
+  }
+#endif
+  launch_kernels();
+}
+
 void CudaDecoder::CheckOverflow() {
   for (LaneId ilane = 0; ilane < nlanes_used_; ++ilane) {
     LaneCounters *lane_counters = h_lanes_counters_.lane(ilane);
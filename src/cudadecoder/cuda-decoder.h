@@ -21,10 +21,13 @@
 #include "cudadecoder/cuda-decodable-itf.h"
 #include "cudadecoder/cuda-decoder-common.h"
 #include "cudadecoder/cuda-fst.h"
+#include "itf/decoder-observer-itf.h"
 #include "nnet3/decodable-online-looped.h"
 #include "thread-pool.h"
 
 #include <cuda_runtime_api.h>
+#include <functional>
+#include <map>
 #include <mutex>
 #include <tuple>
 #include <vector>
@@ -37,6 +40,7 @@ struct CudaDecoderConfig {
   int32 ntokens_pre_allocated;
   int32 main_q_capacity, aux_q_capacity;
   int32 max_active;
+  bool use_cuda_graphs;
 
   CudaDecoderConfig()
       : default_beam(15.0),
@@ -44,7 +48,8 @@ struct CudaDecoderConfig {
         ntokens_pre_allocated(2000000),
         main_q_capacity(-1),
         aux_q_capacity(-1),
-        max_active(10000) {}
+        max_active(10000),
+        use_cuda_graphs(false) {}
 
   void Register(OptionsItf *opts) {
     opts->Register("beam", &default_beam,
@@ -59,9 +64,10 @@ struct CudaDecoderConfig {
                    "best max-active tokens. One token is the instantiation of "
                    "a single arc. Typical values are within the 5k-10k range.");
     opts->Register("ntokens-pre-allocated", &ntokens_pre_allocated,
-                   "Advanced - Number of tokens pre-allocated in host buffers. "
-                   "If this size is exceeded the buffer will reallocate, "
-                   "reducing performance.");
+                   "Advanced - Number of tokens pre-allocated in the host "
+                   "buffers of a channel when it is first used. If this size "
+                   "is exceeded the buffer will reallocate, reducing "
+                   "performance.");
     std::ostringstream main_q_capacity_desc;
     main_q_capacity_desc
         << "Advanced - Capacity of the main queue : Maximum number of "
@@ -100,6 +106,11 @@ struct CudaDecoderConfig {
         << "*main-q-capacity).";
     opts->Register("aux-q-capacity", &aux_q_capacity,
                    aux_q_capacity_desc.str());
+    opts->Register("cuda-graphs", &use_cuda_graphs,
+                   "Advanced - Launch the kernels of each frame as CUDA "
+                   "graphs, captured once for each number of lanes used. "
+                   "This reduces the kernel launch overhead, which matters "
+                   "for small batches. Requires CUDA 10.");
   }
 
   void Check() const {
@@ -216,6 +227,18 @@ class CudaDecoder {
                        std::vector<CudaDecodableInterface *> &decodables,
                        int32 max_num_frames = -1);
 
+  // Sets an object to be given the statistics of the search of each channel
+  // after each frame (see DecoderObserverInterface), or NULL for none.  It is
+  // called from the thread calling AdvanceDecoding().  The statistics come
+  // from the LaneCounters, which are copied to the host after each frame
+  // anyway; the GPU only knows the tokens and arcs of the main queue, so the
+  // number of tokens before pruning and the times of the phases are not set,
+  // and 'seconds' is the time for the frame of the whole batch.  This object
+  // does not take ownership of the observer.
+  void SetObserver(DecoderObserverInterface *observer) {
+    observer_ = observer;
+  }
+
   // Returns the number of frames already decoded in a given channel
   int32 NumFramesDecoded(ChannelId ichannel) const;
   // GetBestPath gets the one-best decoding traceback. If "use_final_probs" is
@@ -337,6 +360,19 @@ class CudaDecoder {
   // Once PostProcessingMainQueue, all working data is back to its original
   // state, to make sure we're ready for the next context switch
   void PostProcessingMainQueue();
+  // Enqueues the kernels of a frame, from the cutoff estimation to
+  // PostProcessingMainQueue
+  void ComputeFrameKernels();
+  // Gives observer_ the statistics of the frame just decoded for each lane,
+  // from h_lanes_counters_ (which must have been copied to the host) and
+  // h_prev_main_q_narcs_and_end_.  'seconds' is the time taken by the frame.
+  void ReportFrameStats(double seconds);
+  // Calls launch_kernels, which must only enqueue work on compute_st_. If
+  // use_cuda_graphs_, that work is captured into a CUDA graph the first time
+  // for that graph_id and nlanes_used_, and then the graph is replayed
+  // instead. The kernel arguments must only depend on nlanes_used_.
+  void LaunchKernels(int32 graph_id,
+                     const std::function<void()> &launch_kernels);
   // Moving the relevant data to host, ie the data that will be needed in
   // GetBestPath/GetRawLattice.
   // Happens when PostProcessingMainQueue is done generating that data
@@ -569,6 +605,11 @@ class CudaDecoder {
   // We do it that the very end, to only use the hashmap on post-prune, post-max
   // active tokens
   DeviceLaneMatrix<HashmapValueT> d_hashmap_values_;
+  // For each FST state in the hashmap, the number of its tokens that
+  // survived the lattice-beam pruning of the extra prev tokens (cf
+  // prune_extra_prev_tokens_kernel).  Kept next to the hashmap, rather than in
+  // HashmapValueT, so that the hashmap values stay 16 bytes
+  DeviceLaneMatrix<int32> d_hashmap_n_extra_prev_tokens_;
   // Reminder: in the GPU lattice decoder, a token is always associated
   // to a single arc. Which means that multiple tokens in the same frame
   // can be associated with the same FST state.
@@ -633,6 +674,12 @@ class CudaDecoder {
   KernelParams *h_kernel_params_;
   std::vector<ChannelId> channel_to_compute_;
   int32 nlanes_used_;  // number of lanes used in h_kernel_params_
+  // See SetObserver(); may be NULL.
+  DecoderObserverInterface *observer_;
+  // Only used if observer_ is set: for each lane, main_q_narcs_and_end at the
+  // start of the frame being decoded, i.e. the tokens of the previous frame
+  // and their emitting arcs, which this frame expands.
+  std::vector<int2> h_prev_main_q_narcs_and_end_;
   // Initial lane
   // When starting a new utterance,
   // init_channel_id is used to initialize a channel
@@ -661,6 +708,8 @@ class CudaDecoder {
   std::vector<std::vector<int32>> frame_offsets_;
   // Data storage. We store on host what we will need in
   // GetRawLattice/GetBestPath
+  // The buffers of a channel are only reserved (to ntokens_pre_allocated_)
+  // when the channel is first used, and then grow as needed
   std::vector<std::vector<InfoToken>> h_all_tokens_info_;
   std::vector<std::vector<CostType>> h_all_tokens_acoustic_cost_;
   std::vector<std::vector<InfoToken>> h_all_tokens_extra_prev_tokens_;
@@ -699,6 +748,12 @@ class CudaDecoder {
   std::vector<std::vector<std::pair<int32, CostType>>>
       list_finals_token_idx_and_cost_;
   bool compute_max_active_;
+  // Set by --cuda-graphs, cf LaunchKernels
+  bool use_cuda_graphs_;
+#if CUDART_VERSION >= 10000
+  // Instantiated graphs, indexed by (graph_id, nlanes_used)
+  std::map<std::pair<int32, int32>, cudaGraphExec_t> kernel_graphs_;
+#endif
   cudaEvent_t nnet3_done_evt_;
   cudaEvent_t d2h_copy_acoustic_evt_;
   cudaEvent_t d2h_copy_infotoken_evt_;
@@ -22,6 +22,8 @@
 #include <cuda_runtime_api.h>
 #include <nvToolsExt.h>
 
+#include "util/kaldi-io.h"
+
 namespace kaldi {
 namespace cuda_decoder {
 
@@ -33,19 +35,20 @@ void CudaFst::ComputeOffsets(const fst::Fst<StdArc> &fst) {
     ++num_states_;
 
   // allocate and initialize offset arrays
-  h_final_.resize(num_states_);
-  h_e_offsets_.resize(num_states_ + 1);
-  h_ne_offsets_.resize(num_states_ + 1);
+  HostStorage &storage = *host_storage_;
+  storage.final.resize(num_states_);
+  storage.e_offsets.resize(num_states_ + 1);
+  storage.ne_offsets.resize(num_states_ + 1);
 
   // iterate through states and arcs and count number of arcs per state
   e_count_ = 0;
   ne_count_ = 0;
 
   // Init first offsets
-  h_ne_offsets_[0] = 0;
-  h_e_offsets_[0] = 0;
+  storage.ne_offsets[0] = 0;
+  storage.e_offsets[0] = 0;
   for (int i = 0; i < num_states_; i++) {
-    h_final_[i] = fst.Final(i).Value();
+    storage.final[i] = fst.Final(i).Value();
     // count emiting and non_emitting arcs
     for (fst::ArcIterator<fst::Fst<StdArc> > aiter(fst, i); !aiter.Done();
          aiter.Next()) {
@@ -57,20 +60,31 @@ void CudaFst::ComputeOffsets(const fst::Fst<StdArc> &fst) {
         ne_count_++;
       }
     }
-    h_ne_offsets_[i + 1] = ne_count_;
-    h_e_offsets_[i + 1] = e_count_;
+    storage.ne_offsets[i + 1] = ne_count_;
+    storage.e_offsets[i + 1] = e_count_;
   }
 
   // We put the emitting arcs before the nonemitting arcs in the arc list
   // adding offset to the non emitting arcs
   // we go to num_states_+1 to take into account the last offset
   for (int i = 0; i < num_states_ + 1; i++)
-    h_ne_offsets_[i] += e_count_;  // e_arcs before
+    storage.ne_offsets[i] += e_count_;  // e_arcs before
 
   arc_count_ = e_count_ + ne_count_;
 }
 
-void CudaFst::AllocateData(const fst::Fst<StdArc> &fst) {
+void CudaFst::AllocateHostData() {
+  HostStorage &storage = *host_storage_;
+  storage.arc_weights.resize(arc_count_);
+  storage.arc_nextstate.resize(arc_count_);
+  // ilabels (id indexing)
+  storage.arc_id_ilabels.resize(arc_count_);
+  storage.arc_olabels.resize(arc_count_);
+  // ilabels (pdf indexing)
+  storage.arc_pdf_ilabels.resize(arc_count_);
+}
+
+void CudaFst::AllocateDeviceData() {
   d_e_offsets_ = static_cast<unsigned int *>(CuDevice::Instantiate().Malloc(
       (num_states_ + 1) * sizeof(*d_e_offsets_)));
   d_ne_offsets_ = static_cast<unsigned int *>(CuDevice::Instantiate().Malloc(
@@ -78,12 +92,6 @@ void CudaFst::AllocateData(const fst::Fst<StdArc> &fst) {
   d_final_ = static_cast<float *>(
       CuDevice::Instantiate().Malloc((num_states_) * sizeof(*d_final_)));
 
-  h_arc_weights_.resize(arc_count_);
-  h_arc_nextstate_.resize(arc_count_);
-  // ilabels (id indexing)
-  h_arc_id_ilabels_.resize(arc_count_);
-  h_arc_olabels_.resize(arc_count_);
-
   d_arc_weights_ = static_cast<float *>(
       CuDevice::Instantiate().Malloc(arc_count_ * sizeof(*d_arc_weights_)));
   d_arc_nextstates_ = static_cast<StateId *>(
@@ -95,6 +103,7 @@ void CudaFst::AllocateData(const fst::Fst<StdArc> &fst) {
 }
 
 void CudaFst::PopulateArcs(const fst::Fst<StdArc> &fst) {
+  HostStorage &storage = *host_storage_;
   // now populate arc data
   int e_idx = 0;
   int ne_idx = e_count_;  // starts where e_offsets_ ends
@@ -108,64 +117,75 @@ void CudaFst::PopulateArcs(const fst::Fst<StdArc> &fst) {
       } else {
         idx = ne_idx++;
       }
-      h_arc_weights_[idx] = arc.weight.Value();
-      h_arc_nextstate_[idx] = arc.nextstate;
-      h_arc_id_ilabels_[idx] = arc.ilabel;
+      storage.arc_weights[idx] = arc.weight.Value();
+      storage.arc_nextstate[idx] = arc.nextstate;
+      storage.arc_id_ilabels[idx] = arc.ilabel;
       // For now we consider id indexing == pdf indexing
       // If the two are differents, we'll call ApplyTransModelOnIlabels with a
       // TransitionModel
-      h_arc_pdf_ilabels_[idx] = arc.ilabel;
-      h_arc_olabels_[idx] = arc.olabel;
+      storage.arc_pdf_ilabels[idx] = arc.ilabel;
+      storage.arc_olabels[idx] = arc.olabel;
     }
   }
 }
 
 void CudaFst::ApplyTransitionModelOnIlabels(
     const TransitionModel &trans_model) {
+  HostStorage &storage = *host_storage_;
   // Converting ilabel here, to avoid reindexing when reading nnet3 output
   // We only need to convert the emitting arcs
   // The emitting arcs are the first e_count_ arcs
   for (int iarc = 0; iarc < e_count_; ++iarc)
-    h_arc_pdf_ilabels_[iarc] =
-        trans_model.TransitionIdToPdf(h_arc_id_ilabels_[iarc]);
+    storage.arc_pdf_ilabels[iarc] =
+        trans_model.TransitionIdToPdf(storage.arc_id_ilabels[iarc]);
 }
 
 void CudaFst::CopyDataToDevice() {
   KALDI_DECODER_CUDA_API_CHECK_ERROR(cudaMemcpy(
-      d_e_offsets_, &h_e_offsets_[0], (num_states_ + 1) * sizeof(*d_e_offsets_),
+      d_e_offsets_, h_e_offsets_, (num_states_ + 1) * sizeof(*d_e_offsets_),
       cudaMemcpyHostToDevice));
   KALDI_DECODER_CUDA_API_CHECK_ERROR(cudaMemcpy(
-      d_ne_offsets_, &h_ne_offsets_[0],
+      d_ne_offsets_, h_ne_offsets_,
       (num_states_ + 1) * sizeof(*d_ne_offsets_), cudaMemcpyHostToDevice));
-  KALDI_DECODER_CUDA_API_CHECK_ERROR(cudaMemcpy(d_final_, &h_final_[0],
+  KALDI_DECODER_CUDA_API_CHECK_ERROR(cudaMemcpy(d_final_, h_final_,
                                                 num_states_ * sizeof(*d_final_),
                                                 cudaMemcpyHostToDevice));
 
   KALDI_DECODER_CUDA_API_CHECK_ERROR(
-      cudaMemcpy(d_arc_weights_, &h_arc_weights_[0],
+      cudaMemcpy(d_arc_weights_, h_arc_weights_,
                  arc_count_ * sizeof(*d_arc_weights_), cudaMemcpyHostToDevice));
   KALDI_DECODER_CUDA_API_CHECK_ERROR(cudaMemcpy(
-      d_arc_nextstates_, &h_arc_nextstate_[0],
+      d_arc_nextstates_, h_arc_nextstate_,
       arc_count_ * sizeof(*d_arc_nextstates_), cudaMemcpyHostToDevice));
   KALDI_DECODER_CUDA_API_CHECK_ERROR(cudaMemcpy(
-      d_arc_pdf_ilabels_, &h_arc_pdf_ilabels_[0],
+      d_arc_pdf_ilabels_, h_arc_pdf_ilabels_,
       e_count_ * sizeof(*d_arc_pdf_ilabels_), cudaMemcpyHostToDevice));
 }
 
-void CudaFst::Initialize(const fst::Fst<StdArc> &fst,
-                         const TransitionModel *trans_model) {
-  nvtxRangePushA("CudaFst constructor");
+void CudaFst::InitializeHost(const fst::Fst<StdArc> &fst,
+                             const TransitionModel *trans_model) {
+  host_storage_ = std::make_shared<HostStorage>();
   start_ = fst.Start();
 
   ComputeOffsets(fst);
-  AllocateData(fst);
-  // Temporarily allocating data for this vector
-  // We just need it during CSR generation. We will clear it
-  // at the end of Initialize
-  h_arc_pdf_ilabels_.resize(arc_count_);
+  AllocateHostData();
   PopulateArcs(fst);
   if (trans_model) ApplyTransitionModelOnIlabels(*trans_model);
 
+  const HostStorage &storage = *host_storage_;
+  h_e_offsets_ = storage.e_offsets.data();
+  h_ne_offsets_ = storage.ne_offsets.data();
+  h_final_ = storage.final.data();
+  h_arc_weights_ = storage.arc_weights.data();
+  h_arc_nextstate_ = storage.arc_nextstate.data();
+  h_arc_id_ilabels_ = storage.arc_id_ilabels.data();
+  h_arc_olabels_ = storage.arc_olabels.data();
+  h_arc_pdf_ilabels_ = storage.arc_pdf_ilabels.data();
+}
+
+void CudaFst::UploadToDevice() {
+  AllocateDeviceData();
+
   KALDI_ASSERT(d_e_offsets_);
   KALDI_ASSERT(d_ne_offsets_);
   KALDI_ASSERT(d_final_);
@@ -178,7 +198,174 @@ void CudaFst::Initialize(const fst::Fst<StdArc> &fst,
   // Making sure the graph is ready
   cudaDeviceSynchronize();
   KALDI_DECODER_CUDA_CHECK_ERROR();
-  h_arc_pdf_ilabels_.clear();  // we don't need those on host
+  // we don't need those on host
+  std::vector<int32>().swap(host_storage_->arc_pdf_ilabels);
+  h_arc_pdf_ilabels_ = nullptr;
+}
+
+void CudaFst::Initialize(const fst::Fst<StdArc> &fst,
+                         const TransitionModel *trans_model) {
+  nvtxRangePushA("CudaFst constructor");
+  InitializeHost(fst, trans_model);
+  UploadToDevice();
+  nvtxRangePop();
+}
+
+size_t CudaFst::ArraysSize() const {
+  return sizeof(unsigned int) * 2 * (num_states_ + 1) +
+         sizeof(CostType) * num_states_ +
+         (sizeof(CostType) + sizeof(StateId) + 2 * sizeof(int32)) *
+             static_cast<size_t>(arc_count_) +
+         sizeof(int32) * static_cast<size_t>(e_count_);
+}
+
+void CudaFst::SetArraysFrom(const char *data) {
+  h_e_offsets_ = reinterpret_cast<const unsigned int *>(data);
+  data += sizeof(unsigned int) * (num_states_ + 1);
+  h_ne_offsets_ = reinterpret_cast<const unsigned int *>(data);
+  data += sizeof(unsigned int) * (num_states_ + 1);
+  h_final_ = reinterpret_cast<const CostType *>(data);
+  data += sizeof(CostType) * num_states_;
+  h_arc_weights_ = reinterpret_cast<const CostType *>(data);
+  data += sizeof(CostType) * static_cast<size_t>(arc_count_);
+  h_arc_nextstate_ = reinterpret_cast<const StateId *>(data);
+  data += sizeof(StateId) * static_cast<size_t>(arc_count_);
+  h_arc_id_ilabels_ = reinterpret_cast<const int32 *>(data);
+  data += sizeof(int32) * static_cast<size_t>(arc_count_);
+  h_arc_olabels_ = reinterpret_cast<const int32 *>(data);
+  data += sizeof(int32) * static_cast<size_t>(arc_count_);
+  h_arc_pdf_ilabels_ = reinterpret_cast<const int32 *>(data);
+}
+
+void CudaFst::Write(std::ostream &os, bool binary) const {
+  if (!binary) KALDI_ERR << "CudaFst::Write only supports binary mode.";
+  if (h_arc_pdf_ilabels_ == nullptr)
+    KALDI_ERR << "CudaFst::Write() can only be called after InitializeHost().";
+  int32 format = 1;
+  WriteToken(os, binary, "<CudaFst>");
+  WriteBasicType(os, binary, format);
+  WriteBasicType(os, binary, start_);
+  int32 num_states = num_states_, e_count = e_count_, ne_count = ne_count_;
+  WriteBasicType(os, binary, num_states);
+  WriteBasicType(os, binary, e_count);
+  WriteBasicType(os, binary, ne_count);
+  WriteMmapPadding(os);
+  // The arrays are written as raw memory, in the order in which
+  // SetArraysFrom() expects them.
+  os.write(reinterpret_cast<const char *>(h_e_offsets_),
+           sizeof(unsigned int) * (num_states_ + 1));
+  os.write(reinterpret_cast<const char *>(h_ne_offsets_),
+           sizeof(unsigned int) * (num_states_ + 1));
+  os.write(reinterpret_cast<const char *>(h_final_),
+           sizeof(CostType) * num_states_);
+  os.write(reinterpret_cast<const char *>(h_arc_weights_),
+           sizeof(CostType) * static_cast<size_t>(arc_count_));
+  os.write(reinterpret_cast<const char *>(h_arc_nextstate_),
+           sizeof(StateId) * static_cast<size_t>(arc_count_));
+  os.write(reinterpret_cast<const char *>(h_arc_id_ilabels_),
+           sizeof(int32) * static_cast<size_t>(arc_count_));
+  os.write(reinterpret_cast<const char *>(h_arc_olabels_),
+           sizeof(int32) * static_cast<size_t>(arc_count_));
+  os.write(reinterpret_cast<const char *>(h_arc_pdf_ilabels_),
+           sizeof(int32) * static_cast<size_t>(e_count_));
+  WriteToken(os, binary, "</CudaFst>");
+  if (!os.good()) KALDI_ERR << "Error writing CudaFst to stream.";
+}
+
+void CudaFst::ReadHeader(std::istream &is) {
+  bool binary = true;
+  int32 format, num_states, e_count, ne_count;
+  ExpectToken(is, binary, "<CudaFst>");
+  ReadBasicType(is, binary, &format);
+  if (format != 1)
+    KALDI_ERR << "This version of the code cannot read this CudaFst, "
+                 "update your code.";
+  ReadBasicType(is, binary, &start_);
+  ReadBasicType(is, binary, &num_states);
+  ReadBasicType(is, binary, &e_count);
+  ReadBasicType(is, binary, &ne_count);
+  KALDI_ASSERT(num_states >= 0 && e_count >= 0 && ne_count >= 0);
+  num_states_ = num_states;
+  e_count_ = e_count;
+  ne_count_ = ne_count;
+  arc_count_ = e_count_ + ne_count_;
+  ReadMmapPadding(is);
+}
+
+void CudaFst::Read(std::istream &is, bool binary) {
+  if (!binary) KALDI_ERR << "CudaFst::Read only supports binary mode.";
+  nvtxRangePushA("CudaFst::Read");
+  host_storage_ = std::make_shared<HostStorage>();
+  ReadHeader(is);
+  HostStorage &storage = *host_storage_;
+  storage.e_offsets.resize(num_states_ + 1);
+  storage.ne_offsets.resize(num_states_ + 1);
+  storage.final.resize(num_states_);
+  AllocateHostData();
+  storage.arc_pdf_ilabels.resize(e_count_);
+  is.read(reinterpret_cast<char *>(storage.e_offsets.data()),
+          sizeof(unsigned int) * (num_states_ + 1));
+  is.read(reinterpret_cast<char *>(storage.ne_offsets.data()),
+          sizeof(unsigned int) * (num_states_ + 1));
+  is.read(reinterpret_cast<char *>(storage.final.data()),
+          sizeof(CostType) * num_states_);
+  is.read(reinterpret_cast<char *>(storage.arc_weights.data()),
+          sizeof(CostType) * static_cast<size_t>(arc_count_));
+  is.read(reinterpret_cast<char *>(storage.arc_nextstate.data()),
+          sizeof(StateId) * static_cast<size_t>(arc_count_));
+  is.read(reinterpret_cast<char *>(storage.arc_id_ilabels.data()),
+          sizeof(int32) * static_cast<size_t>(arc_count_));
+  is.read(reinterpret_cast<char *>(storage.arc_olabels.data()),
+          sizeof(int32) * static_cast<size_t>(arc_count_));
+  is.read(reinterpret_cast<char *>(storage.arc_pdf_ilabels.data()),
+          sizeof(int32) * static_cast<size_t>(e_count_));
+  if (!is.good()) KALDI_ERR << "Error reading CudaFst from stream.";
+  ExpectToken(is, binary, "</CudaFst>");
+  h_e_offsets_ = storage.e_offsets.data();
+  h_ne_offsets_ = storage.ne_offsets.data();
+  h_final_ = storage.final.data();
+  h_arc_weights_ = storage.arc_weights.data();
+  h_arc_nextstate_ = storage.arc_nextstate.data();
+  h_arc_id_ilabels_ = storage.arc_id_ilabels.data();
+  h_arc_olabels_ = storage.arc_olabels.data();
+  h_arc_pdf_ilabels_ = storage.arc_pdf_ilabels.data();
+  if (h_e_offsets_[num_states_] != e_count_ ||
+      h_ne_offsets_[num_states_] != arc_count_)
+    KALDI_ERR << "Corrupted CudaFst: arc offsets do not match number of arcs.";
+  UploadToDevice();
+  nvtxRangePop();
+}
+
+void CudaFst::Map(const std::string &filename) {
+  bool binary;
+  Input ki(filename, &binary);
+  if (!binary) KALDI_ERR << "CudaFst::Map: expected binary file " << filename;
+  std::istream &is = ki.Stream();
+  ReadHeader(is);
+  std::streamoff offset = is.tellg();
+  // Check the end token without reading the arrays.
+  is.seekg(ArraysSize(), std::ios_base::cur);
+  ExpectToken(is, binary, "</CudaFst>");
+  if (offset < 0 || offset % sizeof(int32) != 0) {
+    KALDI_WARN << "CudaFst in " << filename << " cannot be mapped because its "
+               << "arrays are not aligned (was it written to a pipe?); "
+               << "reading it instead.";
+    Input ki2(filename, &binary);
+    Read(ki2.Stream(), binary);
+    return;
+  }
+
+  nvtxRangePushA("CudaFst::Map");
+  host_storage_ = std::make_shared<HostStorage>();
+  MappedFile &mapped_file = host_storage_->mapped_file;
+  mapped_file.Open(filename);
+  KALDI_ASSERT(offset + ArraysSize() <= mapped_file.Size());
+  SetArraysFrom(mapped_file.Data() + offset);
+  if (h_e_offsets_[num_states_] != e_count_ ||
+      h_ne_offsets_[num_states_] != arc_count_)
+    KALDI_ERR << "Corrupted CudaFst: arc offsets do not match number of arcs.";
+  // The arrays are copied to the device straight from the mapped file.
+  UploadToDevice();
   nvtxRangePop();
 }
 
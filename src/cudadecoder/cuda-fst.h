@@ -21,6 +21,7 @@
 #include "cudamatrix/cu-device.h"
 #include "lat/kaldi-lattice.h"
 #include "nnet3/decodable-online-looped.h"  // TransitionModel
+#include "util/kaldi-mmap.h"
 
 namespace kaldi {
 namespace cuda_decoder {
@@ -41,15 +42,32 @@ typedef StdArc::Label Label;
 // Emitting arcs and non-emitting arcs are stored as separate matrices for
 // efficiency
 // We then copy the FST to the device (while keeping its original copy on host)
+//
+// Building the CSR representation from a large FST is slow, so it can also be
+// written to disk (see make-cuda-fst) and later read or memory-mapped, in
+// which case the arrays are uploaded to the device directly from the file.
 class CudaFst {
  public:
   CudaFst()
-      : d_e_offsets_(nullptr),
+      : num_states_(0),
+        start_(fst::kNoStateId),
+        e_count_(0),
+        ne_count_(0),
+        arc_count_(0),
+        d_e_offsets_(nullptr),
+        h_e_offsets_(nullptr),
         d_ne_offsets_(nullptr),
+        h_ne_offsets_(nullptr),
+        h_arc_weights_(nullptr),
         d_arc_weights_(nullptr),
+        h_arc_nextstate_(nullptr),
         d_arc_nextstates_(nullptr),
+        h_arc_id_ilabels_(nullptr),
         d_arc_pdf_ilabels_(nullptr),
-        d_final_(nullptr){};
+        h_arc_olabels_(nullptr),
+        h_final_(nullptr),
+        d_final_(nullptr),
+        h_arc_pdf_ilabels_(nullptr){};
   // Creates a CSR representation of the FST,
   // then copies it to the GPU
   // If a TransitionModel is passed, we'll use it to convert the ilabels id
@@ -59,6 +77,31 @@ class CudaFst {
   // TransitionModel, you need to apply it now
   void Initialize(const fst::Fst<StdArc> &fst,
                   const TransitionModel *trans_model = NULL);
+
+  // Creates the CSR representation on the host only, as Initialize() does but
+  // without copying it to the GPU (no GPU is needed).  This is for Write().
+  void InitializeHost(const fst::Fst<StdArc> &fst,
+                      const TransitionModel *trans_model = NULL);
+
+  // Writes the CSR representation, which must have been created with
+  // InitializeHost(), in a binary format that Read() and Map() read.  The pdf
+  // ilabels are written, so the output can only be used with the
+  // TransitionModel that was given to InitializeHost().  Only binary mode is
+  // supported; as with FlatFst, the arrays are written page-aligned (if the
+  // stream position is known) so that Map() can use them in place.
+  void Write(std::ostream &os, bool binary) const;
+
+  // Reads what Write() wrote and copies it to the GPU; this replaces
+  // Initialize().
+  void Read(std::istream &is, bool binary);
+
+  // As Read(), but memory-maps the file 'filename' (which must contain just
+  // the CudaFst, e.g. as written by make-cuda-fst) and copies the arrays to
+  // the GPU straight from the mapped file.  The host copy that the decoder
+  // needs for lattice generation stays in the mapped file, so it is shared by
+  // all the CudaFst objects and processes that map the same file.
+  void Map(const std::string &filename);
+
   void Finalize();
 
   inline uint32_t NumStates() const { return num_states_; }
@@ -68,8 +111,10 @@ class CudaFst {
   friend class CudaDecoder;
   // Counts arcs and computes offsets of the fst passed in
   void ComputeOffsets(const fst::Fst<StdArc> &fst);
-  // Allocates memory to store FST
-  void AllocateData(const fst::Fst<StdArc> &fst);
+  // Allocates host memory to store FST
+  void AllocateHostData();
+  // Allocates device memory to store FST
+  void AllocateDeviceData();
   // Populate the arcs data (arc.destination, arc.weights, etc.)
   void PopulateArcs(const fst::Fst<StdArc> &fst);
   // Converting the id ilabels into pdf ilabels using the transition model
@@ -78,6 +123,18 @@ class CudaFst {
   void ApplyTransitionModelOnIlabels(const TransitionModel &trans_model);
   // Copies fst to device into the pre-allocated datastructures
   void CopyDataToDevice();
+  // Reads the header of the format that Write() outputs (everything up to the
+  // arrays).
+  void ReadHeader(std::istream &is);
+  // Returns the number of bytes the arrays take up on disk.
+  size_t ArraysSize() const;
+  // Points the host array pointers at the arrays which start at 'data', laid
+  // out as Write() outputs them.
+  void SetArraysFrom(const char *data);
+  // Allocates the device memory, uploads the arrays and frees the pdf
+  // ilabels on host; this is the part of Initialize() after the host arrays
+  // have been created.
+  void UploadToDevice();
   // Total number of states
   unsigned int num_states_;
   // Starting state of the FST
@@ -90,31 +147,48 @@ class CudaFst {
   // Offset arrays are num_states_+1 in size (last state needs
   // its +1 arc_offset)
   // Arc values for state i are stored in the range of [offset[i],offset[i+1][
+  // The host arrays point either into the vectors of host_storage_ or into
+  // its mapped file (if Map() was called).
   unsigned int *d_e_offsets_;  // Emitting offset arrays
-  std::vector<unsigned int> h_e_offsets_;
+  const unsigned int *h_e_offsets_;
   unsigned int *d_ne_offsets_;  // Non-emitting offset arrays
-  std::vector<unsigned int> h_ne_offsets_;
+  const unsigned int *h_ne_offsets_;
   // These are the values for each arc.
   // Arcs belonging to state i are found in the range of [offsets[i],
   // offsets[i+1][
   // Use e_offsets or ne_offsets depending on what you need
   // (emitting/nonemitting)
   // The ilabels arrays are of size e_count_, not arc_count_
-  std::vector<CostType> h_arc_weights_;
+  const CostType *h_arc_weights_;
   CostType *d_arc_weights_;
-  std::vector<StateId> h_arc_nextstate_;
+  const StateId *h_arc_nextstate_;
   StateId *d_arc_nextstates_;
-  std::vector<int32> h_arc_id_ilabels_;
+  const int32 *h_arc_id_ilabels_;
   int32 *d_arc_pdf_ilabels_;
-  std::vector<int32> h_arc_olabels_;
+  const int32 *h_arc_olabels_;
   // Final costs
   // final cost of state i is h_final_[i]
-  std::vector<CostType> h_final_;
+  const CostType *h_final_;
   CostType *d_final_;
 
   // ilabels (pdf indexing)
   // only populate during CSR generation, cleared after (not needed on host)
-  std::vector<int32> h_arc_pdf_ilabels_;
+  const int32 *h_arc_pdf_ilabels_;
+
+  // The memory the host arrays point into.  The CudaDecoder keeps a copy of
+  // the CudaFst, so this is shared between copies (as the device memory is).
+  struct HostStorage {
+    std::vector<unsigned int> e_offsets;
+    std::vector<unsigned int> ne_offsets;
+    std::vector<CostType> arc_weights;
+    std::vector<StateId> arc_nextstate;
+    std::vector<int32> arc_id_ilabels;
+    std::vector<int32> arc_olabels;
+    std::vector<CostType> final;
+    std::vector<int32> arc_pdf_ilabels;
+    MappedFile mapped_file;
+  };
+  std::shared_ptr<HostStorage> host_storage_;
 };
 
 }  // end namespace cuda_decoder
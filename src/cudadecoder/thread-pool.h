@@ -1,6 +1,7 @@
 // cudadecoder/thread-pool.h
 // Source:  https://github.com/progschj/ThreadPool
-// Modified to add a priority queue 
+// Modified to add a priority queue, and later to run the tasks on a
+// kaldi::ThreadPool (see util/kaldi-thread.h).
 // Ubtained under this license:
 /*
 Copyright (c) 2012 Jakob Progsch, Václav Zeman
@@ -33,10 +34,7 @@ freely, subject to the following restrictions:
 #include <future>
 #include <memory>
 #include <mutex>
-#include <queue>
-#include <stdexcept>
-#include <thread>
-#include <vector>
+#include "util/kaldi-thread.h"
 
 namespace kaldi {
 namespace cuda_decoder {
@@ -44,66 +42,55 @@ namespace cuda_decoder {
 // C++ indexes enum 0,1,2...
 enum ThreadPoolPriority  { THREAD_POOL_LOW_PRIORITY, THREAD_POOL_NORMAL_PRIORITY, THREAD_POOL_HIGH_PRIORITY };
 
+// This class gives the interface that the CUDA decoder uses (enqueue()
+// returning a std::future) to a kaldi::ThreadPool, which is either owned by
+// this object or shared, e.g. the process-wide one from GlobalThreadPool(),
+// so that the CPU work of several pipelines and any other users of the
+// shared pool doesn't oversubscribe the cores.
 class ThreadPool {
 public:
-  ThreadPool(size_t);
+  // Creates a kaldi::ThreadPool with this many threads.
+  explicit ThreadPool(size_t num_threads);
+  // Uses 'pool', which is not owned and must outlive this object.
+  explicit ThreadPool(kaldi::ThreadPool *pool);
   template <class F, class... Args>
   auto enqueue(ThreadPoolPriority priority, F &&f, Args &&... args)
       -> std::future<typename std::result_of<F(Args...)>::type>;
   template <class F, class... Args>
   auto enqueue(F &&f, Args &&... args)
       -> std::future<typename std::result_of<F(Args...)>::type>;
+  // Waits for all the tasks enqueued here to finish.
   ~ThreadPool();
 
  private:
-  // need to keep track of threads so we can join them
-  std::vector<std::thread> workers;
-  // the task queue
-  struct Task {
-	  std::function<void()> func;
-          // Ordered first by priority, then FIFO order
-          // tasks created first will have a higher priority_with_fifo.second
-          std::pair<ThreadPoolPriority, long long> priority_with_fifo;
-  };
-  friend bool operator<(const ThreadPool::Task &lhs,
-                        const ThreadPool::Task &rhs);
-
-  std::priority_queue<Task> tasks;
-  long long task_counter;
-
-  // synchronization
-  std::mutex queue_mutex;
-  std::condition_variable condition;
-
-  bool stop;
+  void TaskDone();
+
+  std::unique_ptr<kaldi::ThreadPool> owned_pool;
+  kaldi::ThreadPool *kaldi_pool;
+
+  // The number of tasks enqueued here that have not finished.
+  long long num_pending;
+  std::mutex pending_mutex;
+  std::condition_variable pending_done;
 };
 
-inline bool operator<(const ThreadPool::Task &lhs,
-                      const ThreadPool::Task &rhs) {
-  return lhs.priority_with_fifo < rhs.priority_with_fifo;
+inline ThreadPool::ThreadPool(size_t num_threads)
+    : owned_pool(new kaldi::ThreadPool(num_threads)),
+      kaldi_pool(owned_pool.get()), num_pending(0) { }
+
+inline ThreadPool::ThreadPool(kaldi::ThreadPool *pool)
+    : kaldi_pool(pool), num_pending(0) { }
+
+inline void ThreadPool::TaskDone() {
+  std::unique_lock<std::mutex> lock(pending_mutex);
+  if (--num_pending == 0) pending_done.notify_all();
 }
 
-// the constructor just launches some amount of workers
-inline ThreadPool::ThreadPool(size_t threads)
-    : task_counter(LONG_MAX), stop(false) {
-  for (size_t i = 0; i < threads; ++i)
-    workers.emplace_back([this] {
-      for (;;) {
-        Task task;
-
-	{
-          std::unique_lock<std::mutex> lock(this->queue_mutex);
-          this->condition.wait(
-              lock, [this] { return this->stop || !this->tasks.empty(); });
-          if (this->stop && this->tasks.empty()) return;
-          if (!tasks.empty()) {
-            task = std::move(this->tasks.top());
-            this->tasks.pop();
-        }
-	}
-        task.func();
-      }
-    });
+// the destructor waits for our tasks (the pool may be shared, so we can't
+// just join its threads)
+inline ThreadPool::~ThreadPool() {
+  std::unique_lock<std::mutex> lock(pending_mutex);
+  while (num_pending > 0) pending_done.wait(lock);
 }
 
 // add new work item to the pool : normal priority
@@ -123,39 +110,22 @@ auto ThreadPool::enqueue(ThreadPoolPriority priority, F &&f, Args &&... args)
       std::bind(std::forward<F>(f), std::forward<Args>(args)...));
 
   std::future<return_type> res = func->get_future();
+  kaldi::ThreadPool::Priority kaldi_priority =
+      (priority == THREAD_POOL_HIGH_PRIORITY ?
+       kaldi::ThreadPool::kHighPriority :
+       (priority == THREAD_POOL_LOW_PRIORITY ?
+        kaldi::ThreadPool::kLowPriority :
+        kaldi::ThreadPool::kNormalPriority));
   {
-    std::unique_lock<std::mutex> lock(queue_mutex);
-
-    // don't allow enqueueing after stopping the pool
-    if (stop)
-      throw std::runtime_error("enqueue on stopped ThreadPool");
-    Task task;
-    task.func = [func]() { (*func)(); };
-    long long task_fifo_id = task_counter--;
-    // The following if will temporarly break the FIFO order
-    // (leading to a perf drop for a few seconds)
-    // But it should trigger in ~50 million years
-    if (task_counter == 0) task_counter = LONG_MAX;
-    task.priority_with_fifo = {priority, task_fifo_id};
-    tasks.push(std::move(task));
+    std::unique_lock<std::mutex> lock(pending_mutex);
+    num_pending++;
   }
-  condition.notify_one();
+  kaldi_pool->Submit([this, func]() { (*func)(); TaskDone(); },
+                     kaldi_priority);
   return res;
 }
 
-// the destructor joins all threads
-inline ThreadPool::~ThreadPool() {
-  {
-    std::unique_lock<std::mutex> lock(queue_mutex);
-    stop = true;
-  }
-  condition.notify_all();
-  for (std::thread &worker : workers)
-    worker.join();
-}
-
 }  // end namespace cuda_decoder
 }  // end namespace kaldi
 
-
 #endif  // KALDI_CUDA_DECODER_THREAD_POOL_H_
@@ -127,6 +127,7 @@ int main(int argc, char *argv[]) {
     bool write_lattice = true;
     int num_todo = -1;
     int iterations = 1;
+    bool cuda_fst = false;
     ParseOptions po(usage);
     std::mutex stdout_mutex, clat_writer_mutex;
     int pipeline_length = 4000;  // length of pipeline of outstanding requests,
@@ -145,6 +146,11 @@ int main(int argc, char *argv[]) {
     po.Register("iterations", &iterations,
                 "Number of times to decode the corpus. Output will be written "
                 "only once.");
+    po.Register("cuda-fst", &cuda_fst,
+                "If true, <fst-in> is a decoding graph converted by "
+                "make-cuda-fst for this model, which is memory-mapped and "
+                "copied to the GPU directly, which is much faster than "
+                "converting an FST.");
 
     // Multi-threaded CPU and batched GPU decoder
     BatchedThreadedNnet3CudaPipelineConfig batched_decoder_config;
@@ -152,6 +158,7 @@ int main(int argc, char *argv[]) {
     CuDevice::RegisterDeviceOptions(&po);
     RegisterCuAllocatorOptions(&po);
     batched_decoder_config.Register(&po);
+    RegisterGlobalThreadPoolOptions(&po);
 
     po.Read(argc, argv);
 
@@ -180,15 +187,21 @@ int main(int argc, char *argv[]) {
     SetBatchnormTestMode(true, &(am_nnet.GetNnet()));
     SetDropoutTestMode(true, &(am_nnet.GetNnet()));
     nnet3::CollapseModel(nnet3::CollapseModelConfig(), &(am_nnet.GetNnet()));
+    // Only "output" is used in decoding; this removes e.g. "output-xent".
+    nnet3::KeepOnlyOutputs("output", &(am_nnet.GetNnet()));
 
     CompactLatticeWriter clat_writer(clat_wspecifier);
 
-    fst::Fst<fst::StdArc> *decode_fst =
-        fst::ReadFstKaldiGeneric(fst_rxfilename);
+    if (cuda_fst) {
+      cuda_pipeline.Initialize(fst_rxfilename, am_nnet, trans_model);
+    } else {
+      fst::Fst<fst::StdArc> *decode_fst =
+          fst::ReadFstKaldiGeneric(fst_rxfilename);
 
-    cuda_pipeline.Initialize(*decode_fst, am_nnet, trans_model);
+      cuda_pipeline.Initialize(*decode_fst, am_nnet, trans_model);
 
-    delete decode_fst;
+      delete decode_fst;
+    }
 
     fst::SymbolTable *word_syms = NULL;
     if (word_syms_rxfilename != "")
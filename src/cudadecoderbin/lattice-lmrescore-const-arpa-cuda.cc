@@ -0,0 +1,147 @@
+// cudadecoderbin/lattice-lmrescore-const-arpa-cuda.cc
+//
+// Copyright 2026  Kaldi contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#if HAVE_CUDA == 1
+
+#include "cudadecoder/cuda-const-arpa-lm.h"
+#include "cudamatrix/cu-allocator.h"
+#include "fstext/fstext-lib.h"
+#include "lat/kaldi-lattice.h"
+#include "lat/lattice-functions.h"
+#include "util/common-utils.h"
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    using namespace kaldi::cuda_decoder;
+
+    const char *usage =
+        "Rescores lattices with a ConstArpaLm format language model, like\n"
+        "lattice-lmrescore-const-arpa and with the same output, but with the\n"
+        "language model on the GPU: the lattices are composed with it in\n"
+        "batches of --batch-size, and the n-gram lookups of each step of the\n"
+        "composition are done for the whole batch at once.  Determinization\n"
+        "is applied on the composed lattices on the CPU.\n"
+        "\n"
+        "Usage: lattice-lmrescore-const-arpa-cuda [options] lattice-rspecifier"
+        " \\\n"
+        "                                   const-arpa-in lattice-wspecifier\n"
+        " e.g.: lattice-lmrescore-const-arpa-cuda --lm-scale=-1.0 "
+        "ark:in.lats \\\n"
+        "                                   const_arpa ark:out.lats\n";
+
+    ParseOptions po(usage);
+    BaseFloat lm_scale = 1.0;
+    bool use_mmap = false;
+    int32 batch_size = 64;
+
+    po.Register("lm-scale", &lm_scale, "Scaling factor for language model "
+                "costs; frequently 1.0 or -1.0");
+    po.Register("mmap", &use_mmap, "If true, memory-map the language model "
+                "instead of reading it (const-arpa-in must be a file).");
+    po.Register("batch-size", &batch_size, "Number of lattices that are "
+                "composed with the language model together.");
+    RegisterCuAllocatorOptions(&po);
+    RegisterHugePageOptions(&po);
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 3 || batch_size <= 0) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string lats_rspecifier = po.GetArg(1),
+        lm_rxfilename = po.GetArg(2),
+        lats_wspecifier = po.GetArg(3);
+
+    CuDevice::Instantiate().SelectGpuId("yes");
+
+    CudaConstArpaLm cuda_lm;
+    {
+      // The host copy is only needed until it has been copied to the GPU.
+      ConstArpaLm const_arpa;
+      if (use_mmap)
+        const_arpa.Map(lm_rxfilename);
+      else
+        ReadKaldiObject(lm_rxfilename, &const_arpa);
+      cuda_lm.Initialize(const_arpa);
+    }
+    CudaLatticeLmComposer composer(&cuda_lm);
+
+    SequentialCompactLatticeReader compact_lattice_reader(lats_rspecifier);
+    CompactLatticeWriter compact_lattice_writer(lats_wspecifier);
+
+    int32 n_done = 0, n_fail = 0;
+    std::vector<std::string> keys;
+    std::vector<CompactLattice> clats;
+    std::vector<const CompactLattice*> clat_ptrs;
+    std::vector<CompactLattice> composed_clats;
+    while (!compact_lattice_reader.Done()) {
+      keys.clear();
+      clats.clear();
+      for (; !compact_lattice_reader.Done() && keys.size() < batch_size;
+           compact_lattice_reader.Next()) {
+        keys.push_back(compact_lattice_reader.Key());
+        clats.push_back(compact_lattice_reader.Value());
+        compact_lattice_reader.FreeCurrent();
+      }
+
+      if (lm_scale == 0.0) {
+        // Zero scale so nothing to do.
+        for (size_t i = 0; i < keys.size(); i++)
+          compact_lattice_writer.Write(keys[i], clats[i]);
+        n_done += keys.size();
+        continue;
+      }
+
+      // See lattice-lmrescore-const-arpa for why we scale by the inverse of
+      // "lm_scale" before composing and by "lm_scale" afterwards.
+      clat_ptrs.clear();
+      for (size_t i = 0; i < clats.size(); i++) {
+        fst::ScaleLattice(fst::GraphLatticeScale(1.0/lm_scale), &clats[i]);
+        ArcSort(&clats[i], fst::OLabelCompare<CompactLatticeArc>());
+        clat_ptrs.push_back(&clats[i]);
+      }
+      composer.Compose(clat_ptrs, &composed_clats);
+
+      for (size_t i = 0; i < keys.size(); i++) {
+        Lattice composed_lat;
+        ConvertLattice(composed_clats[i], &composed_lat);
+        Invert(&composed_lat);
+        CompactLattice determinized_clat;
+        DeterminizeLattice(composed_lat, &determinized_clat);
+        fst::ScaleLattice(fst::GraphLatticeScale(lm_scale), &determinized_clat);
+        if (determinized_clat.Start() == fst::kNoStateId) {
+          KALDI_WARN << "Empty lattice for utterance " << keys[i]
+                     << " (incompatible LM?)";
+          n_fail++;
+        } else {
+          compact_lattice_writer.Write(keys[i], determinized_clat);
+          n_done++;
+        }
+      }
+    }
+
+    KALDI_LOG << "Done " << n_done << " lattices, failed for " << n_fail;
+    return (n_done != 0 ? 0 : 1);
+  } catch (const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
+
+#endif  // if HAVE_CUDA == 1
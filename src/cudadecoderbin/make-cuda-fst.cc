@@ -0,0 +1,82 @@
+// cudadecoderbin/make-cuda-fst.cc
+//
+// Copyright 2026  Kaldi contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#if HAVE_CUDA == 1
+
+#include "cudadecoder/cuda-fst.h"
+#include "fstext/fstext-lib.h"
+#include "hmm/transition-model.h"
+#include "util/common-utils.h"
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    using namespace kaldi::cuda_decoder;
+
+    const char *usage =
+        "Converts a decoding graph (e.g. HCLG.fst) into the layout that the\n"
+        "CUDA decoder uses (see CudaFst), with the input labels converted to\n"
+        "pdf-ids using the transition model, so that batched-wav-nnet3-cuda\n"
+        "--cuda-fst=true can memory-map it and copy it to the GPU instead of\n"
+        "converting the FST at every startup.  The output is specific to the\n"
+        "model's transition model, and to be mappable it should be written to\n"
+        "a file, not a pipe.  No GPU is needed.\n"
+        "\n"
+        "Usage: make-cuda-fst [options] <model-in> <fst-in> <cuda-fst-out>\n"
+        " e.g.: make-cuda-fst final.mdl graph/HCLG.fst graph/HCLG.cuda\n";
+
+    ParseOptions po(usage);
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 3) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string model_rxfilename = po.GetArg(1),
+        fst_rxfilename = po.GetArg(2),
+        cuda_fst_wxfilename = po.GetArg(3);
+
+    TransitionModel trans_model;
+    {
+      // The model is a TransitionModel followed by the acoustic model, which
+      // we don't need.
+      bool binary;
+      Input ki(model_rxfilename, &binary);
+      trans_model.Read(ki.Stream(), binary);
+    }
+
+    // the following call will throw if there is an error.
+    fst::Fst<fst::StdArc> *decode_fst =
+        fst::ReadFstKaldiGeneric(fst_rxfilename);
+    CudaFst cuda_fst;
+    cuda_fst.InitializeHost(*decode_fst, &trans_model);
+    delete decode_fst;
+
+    bool binary = true;  // CudaFst does not support non-binary write.
+    WriteKaldiObject(cuda_fst, cuda_fst_wxfilename, binary);
+
+    KALDI_LOG << "Converted FST with " << cuda_fst.NumStates()
+              << " states to CudaFst and wrote it to "
+              << cuda_fst_wxfilename;
+    return 0;
+  } catch (const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
+
+#endif  // if HAVE_CUDA == 1
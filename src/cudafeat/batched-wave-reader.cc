@@ -0,0 +1,141 @@
+// cudafeat/batched-wave-reader.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cudafeat/batched-wave-reader.h"
+
+namespace kaldi {
+
+BatchedWaveReader::BatchedWaveReader(const std::string &wav_rspecifier,
+                                     int32 batch_size, int32 channel,
+                                     BaseFloat min_duration):
+    reader_(wav_rspecifier), batch_size_(batch_size), channel_(channel),
+    min_duration_(min_duration), num_read_(0), num_utts_(0), done_(false),
+    stop_(false) {
+  KALDI_ASSERT(batch_size > 0);
+  thread_ = std::thread(&BatchedWaveReader::ReadBatches, this);
+}
+
+bool BatchedWaveReader::ReadNextBatch(Batch *batch) {
+  for (; !reader_.Done(); reader_.Next()) {
+    std::string utt = reader_.Key();
+    const WaveData &wave_data = reader_.Value();
+    // a batch must have a single sample frequency; this utterance will be
+    // the first of the next batch.
+    if (!batch->utts.empty() && wave_data.SampFreq() != batch->samp_freq)
+      break;
+    num_read_++;
+    if (wave_data.Duration() < min_duration_) {
+      KALDI_WARN << "File: " << utt << " is too short ("
+                 << wave_data.Duration() << " sec): producing no output.";
+      continue;
+    }
+    int32 num_chan = wave_data.Data().NumRows(), this_chan = channel_;
+    {  // This block works out the channel (0=left, 1=right...)
+      KALDI_ASSERT(num_chan > 0);  // should have been caught in
+      // reading code if no channels.
+      if (channel_ == -1) {
+        this_chan = 0;
+        if (num_chan != 1)
+          KALDI_WARN << "Channel not specified but you have data with "
+                     << num_chan  << " channels; defaulting to zero";
+      } else {
+        if (this_chan >= num_chan) {
+          KALDI_WARN << "File with id " << utt << " has "
+                     << num_chan << " channels but you specified channel "
+                     << channel_ << ", producing no output.";
+          continue;
+        }
+      }
+    }
+    batch->samp_freq = wave_data.SampFreq();
+    batch->utts.push_back(utt);
+    batch->waves.push_back(Vector<BaseFloat>(wave_data.Data().Row(this_chan)));
+    if (batch->utts.size() == static_cast<size_t>(batch_size_)) {
+      reader_.Next();
+      break;
+    }
+  }
+  return !batch->utts.empty();
+}
+
+void BatchedWaveReader::ReadBatches() {
+  try {
+    while (true) {
+      Batch batch;
+      bool have_batch = ReadNextBatch(&batch);
+      std::unique_lock<std::mutex> lock(mutex_);
+      num_utts_ = num_read_;
+      if (!have_batch)
+        break;
+      while (ready_batches_.size() >= kMaxReadyBatches && !stop_)
+        cond_.wait(lock);
+      if (stop_)
+        break;
+      ready_batches_.push_back(Batch());
+      Batch &ready = ready_batches_.back();
+      ready.utts.swap(batch.utts);
+      ready.waves.swap(batch.waves);
+      ready.samp_freq = batch.samp_freq;
+      cond_.notify_all();
+    }
+  } catch (...) {
+    // The error has been logged already; ReadBatch() will rethrow it.
+    std::unique_lock<std::mutex> lock(mutex_);
+    error_ = std::current_exception();
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_ = true;
+  cond_.notify_all();
+}
+
+bool BatchedWaveReader::ReadBatch(std::vector<std::string> *utts,
+                                  std::vector<Vector<BaseFloat> > *waves,
+                                  BaseFloat *samp_freq) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (ready_batches_.empty() && !done_)
+    cond_.wait(lock);
+  if (ready_batches_.empty()) {
+    if (error_)
+      std::rethrow_exception(error_);
+    return false;
+  }
+  Batch &batch = ready_batches_.front();
+  utts->swap(batch.utts);
+  waves->swap(batch.waves);
+  *samp_freq = batch.samp_freq;
+  ready_batches_.pop_front();
+  cond_.notify_all();
+  return true;
+}
+
+int32 BatchedWaveReader::NumUtts() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return num_utts_;
+}
+
+BatchedWaveReader::~BatchedWaveReader() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stop_ = true;
+    cond_.notify_all();
+  }
+  thread_.join();
+}
+
+}  // namespace kaldi
@@ -0,0 +1,114 @@
+// cudafeat/batched-wave-reader.h
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_CUDAFEAT_BATCHED_WAVE_READER_H_
+#define KALDI_CUDAFEAT_BATCHED_WAVE_READER_H_
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "feat/wave-reader.h"
+#include "util/common-utils.h"
+
+namespace kaldi {
+
+/**
+   This class reads the waveforms of a wav rspecifier in batches of up to
+   'batch_size' utterances, for the batched GPU feature extraction binaries
+   (see CudaSpectralFeatures::ComputeFeaturesBatched()).  The reading and
+   decoding is done in a background thread, which reads the next batch while
+   the caller is computing the features of the current one.
+
+   The utterances of a batch all have the same sampling frequency (a batch
+   ends early if it changes).  It selects the channel and skips utterances
+   that are too short in the same way as compute-mfcc-feats does, with a
+   warning.
+*/
+class BatchedWaveReader {
+ public:
+  /// 'channel' is -1 (expect mono, else use the first channel), 0 for the
+  /// left channel or 1 for the right one; utterances shorter than
+  /// 'min_duration' seconds are skipped.  It starts reading immediately.
+  BatchedWaveReader(const std::string &wav_rspecifier, int32 batch_size,
+                    int32 channel, BaseFloat min_duration);
+
+  /// Outputs the next batch: the utterance-ids, the waveforms (of the
+  /// selected channel) and their sampling frequency.  Returns false if there
+  /// are no more batches.  If reading the input failed, rethrows the
+  /// exception of the background thread (after the batches read before it).
+  bool ReadBatch(std::vector<std::string> *utts,
+                 std::vector<Vector<BaseFloat> > *waves,
+                 BaseFloat *samp_freq);
+
+  /// The number of utterances read so far, including those that were
+  /// skipped; after ReadBatch() has returned false, the total.
+  int32 NumUtts() const;
+
+  ~BatchedWaveReader();
+
+ private:
+  struct Batch {
+    std::vector<std::string> utts;
+    std::vector<Vector<BaseFloat> > waves;
+    BaseFloat samp_freq;
+    Batch(): samp_freq(0.0) { }
+  };
+
+  // Reads the batches; the function of the background thread.
+  void ReadBatches();
+
+  // Reads the next batch from reader_; returns false if there are no more
+  // utterances.  Called only from the background thread.
+  bool ReadNextBatch(Batch *batch);
+
+  // The maximum number of batches that have been read but not yet given to
+  // the caller.
+  static const size_t kMaxReadyBatches = 1;
+
+  SequentialTableReader<WaveHolder> reader_;
+  int32 batch_size_;
+  int32 channel_;
+  BaseFloat min_duration_;
+  // The number of utterances read; only used in the background thread.
+  int32 num_read_;
+
+  // The following are protected by mutex_.
+  mutable std::mutex mutex_;
+  std::condition_variable cond_;
+  std::deque<Batch> ready_batches_;
+  int32 num_utts_;  // num_read_ as of the last batch.
+  bool done_;  // True once the background thread has finished.
+  bool stop_;  // Tells the background thread to stop (from the destructor).
+  // The exception, if the background thread failed.
+  std::exception_ptr error_;
+
+  std::thread thread_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(BatchedWaveReader);
+};
+
+}  // namespace kaldi
+
+#endif  // KALDI_CUDAFEAT_BATCHED_WAVE_READER_H_
@@ -38,14 +38,25 @@ __launch_bounds__ (1024, 1)
 #else 
 __launch_bounds__ (1024, 2)
 #endif
+// If row_offsets is not NULL, the rows of 'data' are a batch of utterances,
+// utterance u being rows row_offsets[u] to row_offsets[u + 1] - 1, and
+// blockIdx.y is the utterance; 'num_frames' is then ignored.
 __global__ void compute_cmvn_stats_kernel(const float *data, int32_t ldd,
                                           int32_t num_frames, int32_t feat_dim,
+                                          const int32_t *row_offsets,
                                           float *stats, int32_t lds) {
   typedef cub::BlockScan<float2, 1024> BlockScan;
   __shared__ typename BlockScan::TempStorage temp_storage;
 
   int32_t feat = blockIdx.x;
 
+  if (row_offsets != NULL) {
+    int32_t first_row = row_offsets[blockIdx.y];
+    num_frames = row_offsets[blockIdx.y + 1] - first_row;
+    data += first_row * ldd;
+    stats += first_row * lds;
+  }
+
   float2 running_sum = {0.0f, 0.0f};
   // for each frame, keep threads alive for cub
   for (int32_t r = 0; r < num_frames; r += blockDim.x) {
@@ -76,15 +87,37 @@ __global__ void compute_cmvn_stats_kernel(const float *data, int32_t ldd,
   }
 }
 
+// If row_offsets is not NULL, the rows are a batch of num_utts utterances, as
+// in compute_cmvn_stats_kernel(), each of which is normalized separately.
 __global__ void apply_cmvn_kernel(
     int32_t cmvn_window, bool var_norm, bool mean_norm, const float *feat_in,
     int32_t ldi, int32_t num_rows, int32_t num_cols,
+    const int32_t *__restrict__ row_offsets, int32_t num_utts,
     const float *__restrict__ stats, int32_t lds,
     const float *__restrict__ global_stats, int32_t ldg, int32_t global_frames,
     const float *__restrict__ speaker_stats, int32_t ldss,
     int32_t speaker_frames, float *feat_out, int32_t ldo) {
   int32_t r = blockIdx.x;
 
+  if (row_offsets != NULL) {
+    // find the last utterance whose first row is <= r; this skips the
+    // utterances that have no rows.
+    int32_t lo = 0, hi = num_utts - 1;
+    while (lo < hi) {
+      int32_t mid = (lo + hi + 1) / 2;
+      if (row_offsets[mid] <= r)
+        lo = mid;
+      else
+        hi = mid - 1;
+    }
+    int32_t first_row = row_offsets[lo];
+    // from here on, r is the row within the utterance.
+    r -= first_row;
+    feat_in += first_row * ldi;
+    stats += first_row * lds;
+    feat_out += first_row * ldo;
+  }
+
   for (int c = threadIdx.x; c < num_cols; c += blockDim.x) {
     float2 frame_stats =
         reinterpret_cast<const float2 __restrict__ *>(&stats[r * lds])[c];
@@ -175,8 +208,60 @@ void CudaOnlineCmvn::ComputeFeatures(const CuMatrixBase<BaseFloat> &feats_in,
 
   // compute windowed sum/sum2 prefix sum along column of feats
   compute_cmvn_stats_kernel<<<blocks, threads>>>(
-      feats_in.Data(), feats_in.Stride(), num_frames, feat_dim, stats.Data(),
-      stats.Stride());
+      feats_in.Data(), feats_in.Stride(), num_frames, feat_dim, NULL,
+      stats.Data(), stats.Stride());
+  CU_SAFE_CALL(cudaGetLastError());
+
+  threads = (feat_dim + 31) / 32 * 32;  // round up to 32 threads
+  if (threads > 1024) threads = 1024;
+
+  const CuMatrix<float> &gstats = cmvn_state_.global_cmvn_stats;
+  const CuMatrix<float> &sstats = cmvn_state_.speaker_cmvn_stats;
+
+  int global_frames = opts_.global_frames;
+  int speaker_frames = opts_.speaker_frames;
+
+  if (gstats.NumRows() == 0) global_frames = 0;
+  if (sstats.NumRows() == 0) speaker_frames = 0;
+
+  // apply cmvn
+  apply_cmvn_kernel<<<num_frames, threads>>>(
+      opts_.cmn_window, opts_.normalize_variance, opts_.normalize_mean,
+      feats_in.Data(), feats_in.Stride(), num_frames, feat_dim, NULL, 0,
+      stats.Data(), stats.Stride(), gstats.Data(), gstats.Stride(),
+      global_frames, sstats.Data(), sstats.Stride(), speaker_frames,
+      feats_out->Data(), feats_out->Stride());
+  CU_SAFE_CALL(cudaGetLastError());
+}
+
+void CudaOnlineCmvn::ComputeFeaturesBatched(
+    const CuMatrixBase<BaseFloat> &feats_in,
+    const std::vector<int32> &row_offsets, CuMatrix<BaseFloat> *feats_out) {
+  KALDI_ASSERT(!row_offsets.empty() && row_offsets.front() == 0 &&
+               row_offsets.back() == feats_in.NumRows());
+  int32_t num_frames = feats_in.NumRows();
+  int32_t feat_dim = feats_in.NumCols();
+  int32_t num_utts = row_offsets.size() - 1;
+  feats_out->Resize(num_frames, feat_dim, kUndefined);
+  if (num_frames == 0) return;
+
+  // the source is pageable memory, so it may be reused once this returns.
+  int32_t *cu_row_offsets = static_cast<int32_t *>(
+      CuDevice::Instantiate().Malloc(row_offsets.size() * sizeof(int32_t)));
+  CU_SAFE_CALL(cudaMemcpyAsync(cu_row_offsets, &row_offsets[0],
+                               row_offsets.size() * sizeof(int32_t),
+                               cudaMemcpyHostToDevice, cudaStreamPerThread));
+
+  CuMatrix<float> stats(num_frames, feat_dim * 2, kUndefined);
+
+  int threads = 1024;
+  dim3 blocks(feat_dim, num_utts);
+
+  // compute windowed sum/sum2 prefix sum along column of feats, separately
+  // for each utterance
+  compute_cmvn_stats_kernel<<<blocks, threads>>>(
+      feats_in.Data(), feats_in.Stride(), num_frames, feat_dim,
+      cu_row_offsets, stats.Data(), stats.Stride());
   CU_SAFE_CALL(cudaGetLastError());
 
   threads = (feat_dim + 31) / 32 * 32;  // round up to 32 threads
@@ -194,10 +279,12 @@ void CudaOnlineCmvn::ComputeFeatures(const CuMatrixBase<BaseFloat> &feats_in,
   // apply cmvn
   apply_cmvn_kernel<<<num_frames, threads>>>(
       opts_.cmn_window, opts_.normalize_variance, opts_.normalize_mean,
-      feats_in.Data(), feats_in.Stride(), num_frames, feat_dim, stats.Data(),
-      stats.Stride(), gstats.Data(), gstats.Stride(), global_frames,
-      sstats.Data(), sstats.Stride(), speaker_frames, feats_out->Data(),
-      feats_out->Stride());
+      feats_in.Data(), feats_in.Stride(), num_frames, feat_dim,
+      cu_row_offsets, num_utts, stats.Data(), stats.Stride(), gstats.Data(),
+      gstats.Stride(), global_frames, sstats.Data(), sstats.Stride(),
+      speaker_frames, feats_out->Data(), feats_out->Stride());
   CU_SAFE_CALL(cudaGetLastError());
+
+  CuDevice::Instantiate().Free(cu_row_offsets);
 }
 }
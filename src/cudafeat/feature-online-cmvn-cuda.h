@@ -18,6 +18,8 @@
 #ifndef KALDI_CUDAFEAT_FEATURE_ONLINE_CMVN_CUDA_H_
 #define KALDI_CUDAFEAT_FEATURE_ONLINE_CMVN_CUDA_H_
 
+#include <vector>
+
 #include "cudamatrix/cu-matrix.h"
 #include "cudamatrix/cu-vector.h"
 #include "feat/online-feature.h"
@@ -50,6 +52,15 @@ class CudaOnlineCmvn {
   void ComputeFeatures(const CuMatrixBase<BaseFloat> &feats_in,
                        CuMatrix<BaseFloat> *feats_out);
 
+  // Normalizes a batch of utterances, stored one after the other in
+  // 'feats_in': utterance i is rows row_offsets[i] through
+  // row_offsets[i + 1] - 1, so row_offsets.back() == feats_in.NumRows().
+  // Each utterance is normalized as by ComputeFeatures(), but with a single
+  // launch of each kernel for the whole batch.
+  void ComputeFeaturesBatched(const CuMatrixBase<BaseFloat> &feats_in,
+                              const std::vector<int32> &row_offsets,
+                              CuMatrix<BaseFloat> *feats_out);
+
  private:
   const OnlineCmvnOptions &opts_;
   const CudaOnlineCmvnState &cmvn_state_;
@@ -1,4 +1,4 @@
-// cudafeature/feature-mfcc-cuda.cu
+// cudafeat/feature-spectral-cuda.cu
 //
 // Copyright (c) 2019, NVIDIA CORPORATION.  All rights reserved.
 // Justin Luitjens
@@ -20,16 +20,19 @@
 #include <cub/cub.cuh>
 #endif
 
-#include "cudafeat/feature-mfcc-cuda.h"
+#include <algorithm>
+
+#include "cudafeat/feature-spectral-cuda.h"
 #include "cudamatrix/cu-rand.h"
 
 // Each thread block processes a unique frame
 // threads in the same threadblock collaborate to
 // compute the frame together.
+// The energy is written to column 'energy_col' of the features.
 __global__ void apply_lifter_and_floor_energy(
     int num_frames, int num_cols, float cepstral_lifter, bool use_energy,
-    float energy_floor, float *log_energy, float *lifter_coeffs,
-    float *features, int32_t ldf) {
+    int32 energy_col, float energy_floor, float *log_energy,
+    float *lifter_coeffs, float *features, int32_t ldf) {
   int thread_id = threadIdx.x;
   int frame = blockIdx.x;
 
@@ -52,15 +55,17 @@ __global__ void apply_lifter_and_floor_energy(
     if (energy_floor > 0.0f && energy < log_energy_floor) {
       energy = log_energy_floor;
     }
-    feats[0] = energy;
+    feats[energy_col] = energy;
   }
 }
 
 // Each threadblock computes a different row of the matrix.
 // Threads in the same block compute the row collaboratively.
 // This kernel must be called out of place (A_in!=A_out).
-__global__ void power_spectrum_kernel(int row_length, float *A_in, int32_t ldi,
-                                      float *A_out, int32_t ldo) {
+// If use_power is false it outputs the magnitude spectrum instead.
+__global__ void power_spectrum_kernel(int row_length, bool use_power,
+                                      float *A_in, int32_t ldi, float *A_out,
+                                      int32_t ldo) {
   int thread_id = threadIdx.x;
   int block_id = blockIdx.x;
   float *Ar = A_in + block_id * ldi;
@@ -73,7 +78,7 @@ __global__ void power_spectrum_kernel(int row_length, float *A_in, int32_t ldi,
 
     float2 val = reinterpret_cast<float2 *>(Ar)[idx];
     float ret = val.x * val.x + val.y * val.y;
-    Aw[idx] = ret;
+    Aw[idx] = use_power ? ret : sqrtf(ret);
   }
 
   // handle special case
@@ -84,13 +89,16 @@ __global__ void power_spectrum_kernel(int row_length, float *A_in, int32_t ldi,
     // internal implementation
     float im = Ar[row_length];
 
-    Aw[0] = real * real;
-    Aw[half_length] = im * im;
+    Aw[0] = use_power ? real * real : fabsf(real);
+    Aw[half_length] = use_power ? im * im : fabsf(im);
   }
 }
 
 // Expects to be called with 32x8 sized thread block.
-__global__ void mel_banks_compute_kernel(int32_t num_frames, float energy_floor,
+// If use_log is true it outputs the log of the mel energies, floored to
+// energy_floor.
+__global__ void mel_banks_compute_kernel(int32_t num_frames, bool use_log,
+                                         float energy_floor,
                                          int32 *offsets, int32 *sizes,
                                          float **vecs, const float *feats,
                                          int32_t ldf, float *mels,
@@ -125,10 +133,12 @@ __global__ void mel_banks_compute_kernel(int32_t num_frames, float energy_floor,
   // Sum in cub
   sum = WarpReduce(temp_storage[wid]).Sum(sum);
   if (tid == 0) {
-    // avoid log of zero
-    if (sum < energy_floor) sum = energy_floor;
-    float val = logf(sum);
-    mels[frame * ldm + bin] = val;
+    if (use_log) {
+      // avoid log of zero
+      if (sum < energy_floor) sum = energy_floor;
+      sum = logf(sum);
+    }
+    mels[frame * ldm + bin] = sum;
   }
 }
 
@@ -258,13 +268,36 @@ __device__ inline int32 FirstSampleOfFrame(int32 frame, int32 frame_shift,
   }
 }
 
+// If batch_offsets is not NULL, 'wave' holds a batch of num_waves waveforms;
+// batch_offsets[0 ... num_waves] are the offsets of the waveforms in 'wave'
+// and batch_offsets[num_waves + 1 ... 2 * num_waves + 1] those of their
+// frames in 'windows'.
 __global__ void extract_window_kernel(
     int32 frame_shift, int32 frame_length, int32 frame_length_padded,
     int32 window_size, bool snip_edges, int32_t sample_offset,
     const BaseFloat __restrict__ *wave, int32 wave_dim,
+    const int32 *__restrict__ batch_offsets, int32 num_waves,
     BaseFloat *__restrict__ windows, int32_t wlda) {
   int frame = blockIdx.x;
   int tidx = threadIdx.x;
+  BaseFloat *window = windows + frame * wlda;
+
+  if (batch_offsets != NULL) {
+    // find the last waveform whose first frame is <= frame; this skips the
+    // waveforms that have no frames.
+    const int32 *frame_offsets = batch_offsets + num_waves + 1;
+    int32 lo = 0, hi = num_waves - 1;
+    while (lo < hi) {
+      int32 mid = (lo + hi + 1) / 2;
+      if (frame_offsets[mid] <= frame)
+        lo = mid;
+      else
+        hi = mid - 1;
+    }
+    frame -= frame_offsets[lo];
+    wave += batch_offsets[lo];
+    wave_dim = batch_offsets[lo + 1] - batch_offsets[lo];
+  }
 
   int32 start_sample =
       FirstSampleOfFrame(frame, frame_shift, window_size, snip_edges);
@@ -274,7 +307,6 @@ __global__ void extract_window_kernel(
   int32 wave_start = int32(start_sample - sample_offset),
         wave_end = wave_start + frame_length;
 
-  BaseFloat *window = windows + frame * wlda;
   if (wave_start >= 0 && wave_end <= wave_dim) {
     // the normal case-- no edge effects to consider.
     for (int i = tidx; i < frame_length; i += blockDim.x) {
@@ -339,13 +371,49 @@ __global__ void dot_log_kernel(int32_t num_frames, int32_t frame_length,
   }
 }
 
+
 namespace kaldi {
 
-CudaMfcc::CudaMfcc(const MfccOptions &opts)
-    : MfccComputer(opts),
+MfccOptions CudaSpectralFeatures::ToMfccOptions(
+    const CudaSpectralFeatureOptions &opts) {
+  if (opts.feature_type == "mfcc") return opts.mfcc_opts;
+  if (opts.feature_type != "fbank")
+    KALDI_ERR << "Invalid feature type for CudaSpectralFeatures: "
+              << opts.feature_type << " (expected mfcc or fbank)";
+  // The filterbank features are the log mel energies that the MFCC
+  // computation would pass to the DCT.
+  const FbankOptions &fbank_opts = opts.fbank_opts;
+  MfccOptions mfcc_opts;
+  mfcc_opts.frame_opts = fbank_opts.frame_opts;
+  mfcc_opts.mel_opts = fbank_opts.mel_opts;
+  mfcc_opts.num_ceps = fbank_opts.mel_opts.num_bins;
+  mfcc_opts.use_energy = fbank_opts.use_energy;
+  mfcc_opts.energy_floor = fbank_opts.energy_floor;
+  mfcc_opts.raw_energy = fbank_opts.raw_energy;
+  mfcc_opts.cepstral_lifter = 0.0;
+  mfcc_opts.htk_compat = false;
+  return mfcc_opts;
+}
+
+CudaSpectralFeatures::CudaSpectralFeatures(
+    const CudaSpectralFeatureOptions &opts)
+    : MfccComputer(ToMfccOptions(opts)),
+      is_fbank_(opts.feature_type == "fbank"),
+      use_log_fbank_(opts.fbank_opts.use_log_fbank),
+      use_power_(!is_fbank_ || opts.fbank_opts.use_power),
+      energy_column_(0),
+      mel_offset_(0),
       cu_lifter_coeffs_(lifter_coeffs_),
       cu_dct_matrix_(dct_matrix_),
-      window_function_(opts.frame_opts) {
+      window_function_(opts_.frame_opts) {
+  if (is_fbank_ && opts_.use_energy) {
+    // as in FbankComputer, htk_compat puts the energy last.
+    if (opts.fbank_opts.htk_compat)
+      energy_column_ = opts_.mel_opts.num_bins;
+    else
+      mel_offset_ = 1;
+  }
+
   const MelBanks *mel_banks = GetMelBanks(1.0);
   const std::vector<std::pair<int32, Vector<BaseFloat>>> &bins =
       mel_banks->GetBins();
@@ -376,8 +444,8 @@ CudaMfcc::CudaMfcc(const MfccOptions &opts)
                                cudaMemcpyHostToDevice, cudaStreamPerThread));
   CU_SAFE_CALL(cudaStreamSynchronize(cudaStreamPerThread));
 
-  frame_length_ = opts.frame_opts.WindowSize();
-  padded_length_ = opts.frame_opts.PaddedWindowSize();
+  frame_length_ = opts_.frame_opts.WindowSize();
+  padded_length_ = opts_.frame_opts.PaddedWindowSize();
   fft_length_ = padded_length_ / 2;  // + 1;
   fft_size_ = 800;
 
@@ -397,27 +465,35 @@ CudaMfcc::CudaMfcc(const MfccOptions &opts)
   cufftSetStream(plan_, cudaStreamPerThread);
 }
 
+int32 CudaSpectralFeatures::Dim() const {
+  if (is_fbank_)
+    return opts_.mel_opts.num_bins + (opts_.use_energy ? 1 : 0);
+  return opts_.num_ceps;
+}
+
 // ExtractWindow extracts a windowed frame of waveform with a power-of-two,
 // padded size.  It does mean subtraction, pre-emphasis and dithering as
 // requested.
-void CudaMfcc::ExtractWindows(int32_t num_frames, int64 sample_offset,
-                              const CuVectorBase<BaseFloat> &wave,
-                              const FrameExtractionOptions &opts) {
+void CudaSpectralFeatures::ExtractWindows(int32_t num_frames,
+                                          int64 sample_offset,
+                                          const CuVectorBase<BaseFloat> &wave,
+                                          const int32 *batch_offsets,
+                                          int32 num_waves,
+                                          const FrameExtractionOptions &opts) {
   KALDI_ASSERT(sample_offset >= 0 && wave.Dim() != 0);
   int32 frame_length = opts.WindowSize(),
         frame_length_padded = opts.PaddedWindowSize();
-  int64 num_samples = sample_offset + wave.Dim();
 
   extract_window_kernel<<<num_frames, CU1DBLOCK>>>(
       opts.WindowShift(), frame_length, frame_length_padded, opts.WindowSize(),
-      opts.snip_edges, sample_offset, wave.Data(), wave.Dim(),
-      cu_windows_.Data(), cu_windows_.Stride());
+      opts.snip_edges, sample_offset, wave.Data(), wave.Dim(), batch_offsets,
+      num_waves, cu_windows_.Data(), cu_windows_.Stride());
   CU_SAFE_CALL(cudaGetLastError());
 }
 
-void CudaMfcc::ProcessWindows(int num_frames,
-                              const FrameExtractionOptions &opts,
-                              CuVectorBase<BaseFloat> *log_energy_pre_window) {
+void CudaSpectralFeatures::ProcessWindows(
+    int num_frames, const FrameExtractionOptions &opts,
+    CuVectorBase<BaseFloat> *log_energy_pre_window) {
   if (num_frames == 0) return;
 
   int fft_num_frames = cu_windows_.NumRows();
@@ -433,9 +509,10 @@ void CudaMfcc::ProcessWindows(int num_frames,
   CU_SAFE_CALL(cudaGetLastError());
 }
 
-void CudaMfcc::ComputeFinalFeatures(int num_frames, BaseFloat vtln_wrap,
-                                    CuVector<BaseFloat> *cu_signal_log_energy,
-                                    CuMatrix<BaseFloat> *cu_features) {
+void CudaSpectralFeatures::ComputeFinalFeatures(
+    int num_frames, BaseFloat vtln_wrap,
+    CuVector<BaseFloat> *cu_signal_log_energy,
+    CuMatrix<BaseFloat> *cu_features) {
   Vector<float> tmp;
   assert(opts_.htk_compat == false);
 
@@ -464,42 +541,54 @@ void CudaMfcc::ComputeFinalFeatures(int num_frames, BaseFloat vtln_wrap,
                                      padded_length_ / 2 + 1, kUndefined);
 
   power_spectrum_kernel<<<num_frames, CU1DBLOCK>>>(
-      padded_length_, tmp_window_.Data(), tmp_window_.Stride(),
+      padded_length_, use_power_, tmp_window_.Data(), tmp_window_.Stride(),
       power_spectrum.Data(), power_spectrum.Stride());
   CU_SAFE_CALL(cudaGetLastError());
 
-  // mel banks
+  // mel banks; for filterbank features these are written directly to the
+  // output.
   int num_bins = bin_size_;
-  cu_mel_energies_.Resize(num_frames, num_bins, kUndefined);
+  float *mels;
+  int32_t ldm;
+  if (is_fbank_) {
+    mels = cu_features->Data() + mel_offset_;
+    ldm = cu_features->Stride();
+  } else {
+    cu_mel_energies_.Resize(num_frames, num_bins, kUndefined);
+    mels = cu_mel_energies_.Data();
+    ldm = cu_mel_energies_.Stride();
+  }
   dim3 mel_threads(32, 8);
   dim3 mel_blocks(num_bins, (num_frames + mel_threads.y - 1) / mel_threads.y);
   mel_banks_compute_kernel<<<mel_blocks, mel_threads>>>(
-      num_frames, std::numeric_limits<float>::epsilon(), offsets_, sizes_,
-      vecs_, power_spectrum.Data(), power_spectrum.Stride(),
-      cu_mel_energies_.Data(), cu_mel_energies_.Stride());
+      num_frames, !is_fbank_ || use_log_fbank_,
+      std::numeric_limits<float>::epsilon(), offsets_, sizes_, vecs_,
+      power_spectrum.Data(), power_spectrum.Stride(), mels, ldm);
   CU_SAFE_CALL(cudaGetLastError());
 
   // dct transform
-  cu_features->AddMatMat(1.0, cu_mel_energies_, kNoTrans, cu_dct_matrix_,
-                         kTrans, 0.0);
-
-  apply_lifter_and_floor_energy<<<num_frames, CU1DBLOCK>>>(
-      cu_features->NumRows(), cu_features->NumCols(), opts_.cepstral_lifter,
-      opts_.use_energy, opts_.energy_floor, cu_signal_log_energy->Data(),
-      cu_lifter_coeffs_.Data(), cu_features->Data(), cu_features->Stride());
-  CU_SAFE_CALL(cudaGetLastError());
+  if (!is_fbank_)
+    cu_features->AddMatMat(1.0, cu_mel_energies_, kNoTrans, cu_dct_matrix_,
+                           kTrans, 0.0);
+
+  if (opts_.cepstral_lifter != 0.0 || opts_.use_energy) {
+    apply_lifter_and_floor_energy<<<num_frames, CU1DBLOCK>>>(
+        cu_features->NumRows(), cu_features->NumCols(), opts_.cepstral_lifter,
+        opts_.use_energy, energy_column_, opts_.energy_floor,
+        cu_signal_log_energy->Data(), cu_lifter_coeffs_.Data(),
+        cu_features->Data(), cu_features->Stride());
+    CU_SAFE_CALL(cudaGetLastError());
+  }
 }
 
-void CudaMfcc::ComputeFeatures(const CuVectorBase<BaseFloat> &cu_wave,
-                               BaseFloat sample_freq, BaseFloat vtln_warp,
-                               CuMatrix<BaseFloat> *cu_features) {
-  nvtxRangePushA("CudaMfcc::ComputeFeatures");
+void CudaSpectralFeatures::ComputeFeaturesInternal(
+    int32 num_frames, const CuVectorBase<BaseFloat> &wave,
+    const int32 *batch_offsets, int32 num_waves,
+    CuMatrix<BaseFloat> *cu_features) {
   const FrameExtractionOptions &frame_opts = GetFrameOptions();
-  int num_frames = NumFrames(cu_wave.Dim(), frame_opts, true);
   // compute fft frames by rounding up to a multiple of fft_size_
   int fft_num_frames = num_frames + (fft_size_ - num_frames % fft_size_);
   int feature_dim = Dim();
-  bool use_raw_log_energy = NeedRawLogEnergy();
 
   CuVector<BaseFloat> raw_log_energies;
   raw_log_energies.Resize(num_frames, kUndefined);
@@ -511,6 +600,8 @@ void CudaMfcc::ComputeFeatures(const CuVectorBase<BaseFloat> &cu_wave,
   tmp_window_.Resize(fft_num_frames, padded_length_ + 2, kUndefined,
                      kStrideEqualNumCols);
 
+  if (num_frames == 0) return;
+
   if (frame_opts.dither != 0.0f) {
     // Calling cu-rand directly
     // CuRand class works on CuMatrixBase which must
@@ -523,17 +614,70 @@ void CudaMfcc::ComputeFeatures(const CuVectorBase<BaseFloat> &cu_wave,
   }
 
   // Extract Windows
-  ExtractWindows(num_frames, 0, cu_wave, frame_opts);
+  ExtractWindows(num_frames, 0, wave, batch_offsets, num_waves, frame_opts);
 
   // Process Windows
   ProcessWindows(num_frames, frame_opts, &raw_log_energies);
 
   // Compute Features
   ComputeFinalFeatures(num_frames, 1.0, &raw_log_energies, cu_features);
+}
+
+void CudaSpectralFeatures::ComputeFeatures(
+    const CuVectorBase<BaseFloat> &cu_wave, BaseFloat sample_freq,
+    BaseFloat vtln_warp, CuMatrix<BaseFloat> *cu_features) {
+  nvtxRangePushA("CudaSpectralFeatures::ComputeFeatures");
+  int num_frames = NumFrames(cu_wave.Dim(), GetFrameOptions(), true);
+  ComputeFeaturesInternal(num_frames, cu_wave, NULL, 0, cu_features);
+  nvtxRangePop();
+}
+
+void CudaSpectralFeatures::ComputeFeaturesBatched(
+    const CuVectorBase<BaseFloat> &cu_waves,
+    const std::vector<int32> &wave_offsets, BaseFloat sample_freq,
+    CuMatrix<BaseFloat> *cu_features, std::vector<int32> *feature_offsets) {
+  nvtxRangePushA("CudaSpectralFeatures::ComputeFeaturesBatched");
+  KALDI_ASSERT(!wave_offsets.empty() && wave_offsets.front() == 0 &&
+               wave_offsets.back() == cu_waves.Dim());
+  int32 num_waves = wave_offsets.size() - 1;
+
+  // The offsets of the waveforms followed by those of their frames; these
+  // are all the kernels need to know about the batch.
+  std::vector<int32> batch_offsets(2 * (num_waves + 1));
+  std::copy(wave_offsets.begin(), wave_offsets.end(), batch_offsets.begin());
+  int32 num_frames = 0;
+  for (int32 i = 0; i < num_waves; i++) {
+    batch_offsets[num_waves + 1 + i] = num_frames;
+    int32 wave_dim = wave_offsets[i + 1] - wave_offsets[i];
+    KALDI_ASSERT(wave_dim >= 0);
+    num_frames += NumFrames(wave_dim, GetFrameOptions(), true);
+  }
+  batch_offsets.back() = num_frames;
+  feature_offsets->assign(batch_offsets.begin() + num_waves + 1,
+                          batch_offsets.end());
+
+  if (num_frames == 0) {
+    cu_features->Resize(0, Dim());
+    nvtxRangePop();
+    return;
+  }
 
+  // A single small asynchronous copy.  The source is pageable, so
+  // cudaMemcpyAsync() has staged it by the time it returns.
+  int32 *cu_batch_offsets = static_cast<int32 *>(
+      CuDevice::Instantiate().Malloc(batch_offsets.size() * sizeof(int32)));
+  CU_SAFE_CALL(cudaMemcpyAsync(cu_batch_offsets, &batch_offsets[0],
+                               batch_offsets.size() * sizeof(int32),
+                               cudaMemcpyHostToDevice, cudaStreamPerThread));
+
+  ComputeFeaturesInternal(num_frames, cu_waves, cu_batch_offsets, num_waves,
+                          cu_features);
+
+  CuDevice::Instantiate().Free(cu_batch_offsets);
   nvtxRangePop();
 }
-CudaMfcc::~CudaMfcc() {
+
+CudaSpectralFeatures::~CudaSpectralFeatures() {
   delete[] cu_vecs_;
   CuDevice::Instantiate().Free(vecs_);
   CuDevice::Instantiate().Free(offsets_);
@@ -0,0 +1,141 @@
+// cudafeat/feature-spectral-cuda.h
+//
+// Copyright (c) 2019, NVIDIA CORPORATION.  All rights reserved.
+// Justin Luitjens
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_CUDAFEAT_FEATURE_SPECTRAL_CUDA_H_
+#define KALDI_CUDAFEAT_FEATURE_SPECTRAL_CUDA_H_
+
+#if HAVE_CUDA == 1
+#include <cufft.h>
+#endif
+
+#include <string>
+#include <vector>
+
+#include "cudafeat/feature-window-cuda.h"
+#include "cudamatrix/cu-matrix.h"
+#include "cudamatrix/cu-vector.h"
+#include "feat/feature-fbank.h"
+#include "feat/feature-mfcc.h"
+
+namespace kaldi {
+
+// The options of CudaSpectralFeatures: the feature type, and the options of
+// that type of feature.
+struct CudaSpectralFeatureOptions {
+  std::string feature_type;  // "mfcc" or "fbank"
+  MfccOptions mfcc_opts;
+  FbankOptions fbank_opts;
+
+  CudaSpectralFeatureOptions(): feature_type("mfcc") {}
+  explicit CudaSpectralFeatureOptions(const MfccOptions &opts)
+      : feature_type("mfcc"), mfcc_opts(opts) {}
+  explicit CudaSpectralFeatureOptions(const FbankOptions &opts)
+      : feature_type("fbank"), fbank_opts(opts) {}
+};
+
+// This class implements MFCC and filterbank computation in CUDA.
+// It takes input from device memory and outputs to
+// device memory.  It also does no synchronization.
+//
+// The filterbank features share the MFCC computation up to the mel banks,
+// so this class derives from MfccComputer in both cases; for fbank the
+// FbankOptions are converted to equivalent MfccOptions, and the DCT is
+// skipped.
+class CudaSpectralFeatures : public MfccComputer {
+ public:
+  explicit CudaSpectralFeatures(const CudaSpectralFeatureOptions &opts);
+  ~CudaSpectralFeatures();
+
+  // The feature dimension.
+  int32 Dim() const;
+
+  void ComputeFeatures(const CuVectorBase<BaseFloat> &cu_wave,
+                       BaseFloat sample_freq, BaseFloat vtln_warp,
+                       CuMatrix<BaseFloat> *cu_features);
+
+  // Computes the features of a batch of waveforms with one set of kernel
+  // launches, which is much faster than calling ComputeFeatures() for each of
+  // them when they are short.  The waveforms are stored one after the other
+  // in 'cu_waves': waveform i is elements wave_offsets[i] through
+  // wave_offsets[i + 1] - 1, so wave_offsets.size() is the number of
+  // waveforms plus one, wave_offsets[0] == 0 and wave_offsets.back() ==
+  // cu_waves.Dim().  The features of all the waveforms are output one after
+  // the other to 'cu_features', those of waveform i in rows
+  // (*feature_offsets)[i] through (*feature_offsets)[i + 1] - 1.  The result
+  // is the same as calling ComputeFeatures() on each waveform (except for the
+  // random dither, if any).
+  void ComputeFeaturesBatched(const CuVectorBase<BaseFloat> &cu_waves,
+                              const std::vector<int32> &wave_offsets,
+                              BaseFloat sample_freq,
+                              CuMatrix<BaseFloat> *cu_features,
+                              std::vector<int32> *feature_offsets);
+
+ private:
+  // Returns 'opts' converted to the MfccOptions of the base class.
+  static MfccOptions ToMfccOptions(const CudaSpectralFeatureOptions &opts);
+
+  // Computes the features of 'num_frames' frames.  If 'batch_offsets' is
+  // NULL, they are the frames of the waveform 'wave'; otherwise 'wave' is a
+  // batch of waveforms and 'batch_offsets' is a device array with their
+  // wave_offsets followed by their feature offsets (see
+  // ComputeFeaturesBatched()), and 'num_waves' is their number.
+  void ComputeFeaturesInternal(int32 num_frames,
+                               const CuVectorBase<BaseFloat> &wave,
+                               const int32 *batch_offsets, int32 num_waves,
+                               CuMatrix<BaseFloat> *cu_features);
+
+  void ExtractWindows(int32 num_frames, int64 sample_offset,
+                      const CuVectorBase<BaseFloat> &wave,
+                      const int32 *batch_offsets, int32 num_waves,
+                      const FrameExtractionOptions &opts);
+
+  void ProcessWindows(int num_frames, const FrameExtractionOptions &opts,
+                      CuVectorBase<BaseFloat> *log_energy_pre_window);
+
+  void ComputeFinalFeatures(int num_frames, BaseFloat vtln_wrap,
+                            CuVector<BaseFloat> *cu_signal_log_energy,
+                            CuMatrix<BaseFloat> *cu_features);
+
+  // True for filterbank features, false for MFCC.
+  bool is_fbank_;
+  // For filterbank features: whether to take the log of the mel energies, and
+  // whether to use the power (rather than the magnitude) spectrum.
+  bool use_log_fbank_, use_power_;
+  // The column of the energy in the features, if opts_.use_energy; the mel
+  // energies (fbank) or cepstra (mfcc) start at column mel_offset_.
+  int32 energy_column_, mel_offset_;
+
+  CuMatrix<BaseFloat> cu_windows_;
+  CuMatrix<float> tmp_window_, cu_mel_energies_;
+  CuMatrix<float> cu_dct_matrix_;
+  CuVector<float> cu_lifter_coeffs_;
+
+  int frame_length_, padded_length_, fft_length_, fft_size_;
+  cufftHandle plan_;
+  CudaFeatureWindowFunction window_function_;
+
+  int bin_size_;
+  int32 *offsets_, *sizes_;
+  CuVector<float> *cu_vecs_;
+  float **vecs_;
+
+  // for sanity checking cufft
+  int32_t stride_, tmp_stride_;
+};
+}
+
+#endif
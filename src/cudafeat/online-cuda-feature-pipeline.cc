@@ -23,9 +23,13 @@ namespace kaldi {
 
 OnlineCudaFeaturePipeline::OnlineCudaFeaturePipeline(
     const OnlineNnet2FeaturePipelineConfig &config)
-    : info_(config), mfcc(NULL), ivector(NULL) {
+    : info_(config), spectral_feat(NULL), ivector(NULL) {
   if (info_.feature_type == "mfcc") {
-    mfcc = new CudaMfcc(info_.mfcc_opts);
+    spectral_feat = new CudaSpectralFeatures(
+        CudaSpectralFeatureOptions(info_.mfcc_opts));
+  } else if (info_.feature_type == "fbank") {
+    spectral_feat = new CudaSpectralFeatures(
+        CudaSpectralFeatureOptions(info_.fbank_opts));
   }
 
   if (info_.use_ivectors) {
@@ -43,7 +47,7 @@ OnlineCudaFeaturePipeline::OnlineCudaFeaturePipeline(
 }
 
 OnlineCudaFeaturePipeline::~OnlineCudaFeaturePipeline() {
-  if (mfcc != NULL) delete mfcc;
+  if (spectral_feat != NULL) delete spectral_feat;
   if (ivector != NULL) delete ivector;
 }
 
@@ -51,10 +55,11 @@ void OnlineCudaFeaturePipeline::ComputeFeatures(
     const CuVectorBase<BaseFloat> &cu_wave, BaseFloat sample_freq,
     CuMatrix<BaseFloat> *input_features,
     CuVector<BaseFloat> *ivector_features) {
-  if (info_.feature_type == "mfcc") {
-    // MFCC
+  if (spectral_feat != NULL) {
+    // MFCC or fbank
     float vtln_warp = 1.0;
-    mfcc->ComputeFeatures(cu_wave, sample_freq, vtln_warp, input_features);
+    spectral_feat->ComputeFeatures(cu_wave, sample_freq, vtln_warp,
+                                   input_features);
   } else {
     KALDI_ASSERT(false);
   }
@@ -67,4 +72,32 @@ void OnlineCudaFeaturePipeline::ComputeFeatures(
   }
 }
 
+void OnlineCudaFeaturePipeline::ComputeFeaturesBatched(
+    const CuVectorBase<BaseFloat> &cu_waves,
+    const std::vector<int32> &wave_offsets, BaseFloat sample_freq,
+    CuMatrix<BaseFloat> *input_features, std::vector<int32> *feature_offsets,
+    std::vector<CuVector<BaseFloat> > *ivector_features) {
+  if (spectral_feat != NULL) {
+    spectral_feat->ComputeFeaturesBatched(cu_waves, wave_offsets, sample_freq,
+                                          input_features, feature_offsets);
+  } else {
+    KALDI_ASSERT(false);
+  }
+
+  // Ivector.  This is estimated separately for each utterance.
+  if (info_.use_ivectors && ivector_features != NULL) {
+    int32 num_waves = wave_offsets.size() - 1;
+    ivector_features->resize(num_waves);
+    for (int32 i = 0; i < num_waves; i++) {
+      int32 first_row = (*feature_offsets)[i],
+          num_rows = (*feature_offsets)[i + 1] - first_row;
+      if (num_rows == 0) continue;
+      ivector->GetIvector(input_features->RowRange(first_row, num_rows),
+                          &(*ivector_features)[i]);
+    }
+  } else {
+    KALDI_ASSERT(false);
+  }
+}
+
 }  // namespace kaldi
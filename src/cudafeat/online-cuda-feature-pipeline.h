@@ -25,7 +25,7 @@
 #include <vector>
 
 #include "base/kaldi-error.h"
-#include "cudafeat/feature-mfcc-cuda.h"
+#include "cudafeat/feature-spectral-cuda.h"
 #include "cudafeat/online-ivector-feature-cuda.h"
 #include "matrix/matrix-lib.h"
 #include "online2/online-nnet2-feature-pipeline.h"
@@ -43,11 +43,23 @@ class OnlineCudaFeaturePipeline {
                        CuMatrix<BaseFloat> *input_features,
                        CuVector<BaseFloat> *ivector_features);
 
+  // Computes the features of a batch of waveforms, stored one after the
+  // other in 'cu_waves' as described for
+  // CudaSpectralFeatures::ComputeFeaturesBatched().  The input features of
+  // waveform i are output to rows (*feature_offsets)[i] through
+  // (*feature_offsets)[i + 1] - 1 of 'input_features', and its i-vector (if
+  // ivector_features != NULL) to (*ivector_features)[i].
+  void ComputeFeaturesBatched(
+      const CuVectorBase<BaseFloat> &cu_waves,
+      const std::vector<int32> &wave_offsets, BaseFloat sample_freq,
+      CuMatrix<BaseFloat> *input_features, std::vector<int32> *feature_offsets,
+      std::vector<CuVector<BaseFloat> > *ivector_features);
+
   ~OnlineCudaFeaturePipeline();
 
  private:
   OnlineNnet2FeaturePipelineInfo info_;
-  CudaMfcc *mfcc;
+  CudaSpectralFeatures *spectral_feat;
   IvectorExtractorFastCuda *ivector;
 };
 }  // namespace kaldi
@@ -0,0 +1,175 @@
+// cudafeatbin/compute-fbank-feats-cuda.cc
+//
+// Copyright 2026  Kaldi contributors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "cudafeat/batched-wave-reader.h"
+#include "cudafeat/feature-spectral-cuda.h"
+#include "feat/wave-reader.h"
+#include "cudamatrix/cu-matrix.h"
+#include "cudamatrix/cu-vector.h"
+
+namespace kaldi {
+
+// Computes the features of the waveforms in 'waves' with a single batched
+// call; (*features)[i] is set to the features of waves[i].
+static void ComputeBatch(const std::vector<Vector<BaseFloat> > &waves,
+                         BaseFloat samp_freq,
+                         CudaSpectralFeatures *fbank,
+                         std::vector<Matrix<BaseFloat> > *features) {
+  std::vector<int32> wave_offsets(1, 0), feature_offsets;
+  for (size_t i = 0; i < waves.size(); i++)
+    wave_offsets.push_back(wave_offsets.back() + waves[i].Dim());
+
+  Vector<BaseFloat> all_waves(wave_offsets.back(), kUndefined);
+  for (size_t i = 0; i < waves.size(); i++)
+    all_waves.Range(wave_offsets[i], waves[i].Dim()).CopyFromVec(waves[i]);
+
+  CuVector<BaseFloat> cu_waves(all_waves);
+  CuMatrix<BaseFloat> cu_features;
+  fbank->ComputeFeaturesBatched(cu_waves, wave_offsets, samp_freq,
+                                &cu_features, &feature_offsets);
+  Matrix<BaseFloat> all_features(cu_features);
+
+  features->resize(waves.size());
+  for (size_t i = 0; i < waves.size(); i++) {
+    int32 num_frames = feature_offsets[i + 1] - feature_offsets[i];
+    if (num_frames == 0)
+      (*features)[i].Resize(0, 0);
+    else
+      (*features)[i] = all_features.RowRange(feature_offsets[i], num_frames);
+  }
+}
+
+}  // namespace kaldi
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    const char *usage =
+        "Create filterbank feature files on the GPU, computing the features\n"
+        "of batches of utterances together.  The waveforms are read in a\n"
+        "background thread, while the GPU is computing the features of the\n"
+        "previous batch.\n"
+        "Usage:  compute-fbank-feats-cuda [options...] <wav-rspecifier> "
+        "<feats-wspecifier>\n";
+
+    // construct all the global objects
+    ParseOptions po(usage);
+    FbankOptions fbank_opts;
+    bool subtract_mean = false;
+    int32 channel = -1;
+    int32 batch_size = 64;
+    BaseFloat min_duration = 0.0;
+    std::string utt2dur_wspecifier;
+    bool compress = false;
+    int32 compression_method_in = 1;
+
+    // Register the option struct
+    fbank_opts.Register(&po);
+
+    // Register the options
+    po.Register("subtract-mean", &subtract_mean, "Subtract mean of each "
+                "feature file [CMS]; not recommended to do it this way. ");
+    po.Register("channel", &channel, "Channel to extract (-1 -> expect mono, "
+                "0 -> left, 1 -> right)");
+    po.Register("min-duration", &min_duration, "Minimum duration of segments "
+                "to process (in seconds).");
+    po.Register("batch-size", &batch_size, "Number of utterances whose "
+                "features are computed together.");
+    po.Register("write-utt2dur", &utt2dur_wspecifier, "Wspecifier to write "
+                "duration of each utterance in seconds, e.g. 'ark,t:utt2dur'.");
+    po.Register("compress", &compress, "If true, write output in compressed "
+                "form (see --compression-method).");
+    po.Register("compression-method", &compression_method_in,
+                "Only relevant if --compress=true; the method (1 through 7) to "
+                "compress the matrix.  Search for CompressionMethod in "
+                "src/matrix/compressed-matrix.h.");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 2) {
+      po.PrintUsage();
+      exit(1);
+    }
+    KALDI_ASSERT(batch_size > 0);
+    CompressionMethod compression_method = static_cast<CompressionMethod>(
+        compression_method_in);
+
+    g_cuda_allocator.SetOptions(g_allocator_options);
+    CuDevice::Instantiate().SelectGpuId("yes");
+    CuDevice::Instantiate().AllowMultithreading();
+
+    std::string wav_rspecifier = po.GetArg(1);
+
+    std::string output_wspecifier = po.GetArg(2);
+
+    CudaSpectralFeatureOptions feature_opts(fbank_opts);
+    CudaSpectralFeatures fbank(feature_opts);
+
+    BatchedWaveReader reader(wav_rspecifier, batch_size, channel,
+                             min_duration);
+    BaseFloatMatrixWriter kaldi_writer;
+    CompressedMatrixWriter compressed_writer;
+    if (!(compress ? compressed_writer.Open(output_wspecifier) :
+          kaldi_writer.Open(output_wspecifier)))
+      KALDI_ERR << "Could not initialize output with wspecifier "
+                << output_wspecifier;
+    DoubleWriter utt2dur_writer(utt2dur_wspecifier);
+
+    std::vector<std::string> utts;
+    std::vector<Vector<BaseFloat> > waves;
+    std::vector<Matrix<BaseFloat> > features;
+    BaseFloat samp_freq;
+
+    int32 num_success = 0;
+    while (reader.ReadBatch(&utts, &waves, &samp_freq)) {
+      ComputeBatch(waves, samp_freq, &fbank, &features);
+      for (size_t i = 0; i < utts.size(); i++) {
+        const std::string &utt = utts[i];
+        Matrix<BaseFloat> &utt_features = features[i];
+        if (utt_features.NumRows() == 0) {
+          KALDI_WARN << "No frames for utterance " << utt
+                     << ": producing no output.";
+          continue;
+        }
+        if (subtract_mean) {
+          Vector<BaseFloat> mean(utt_features.NumCols());
+          mean.AddRowSumMat(1.0, utt_features);
+          mean.Scale(1.0 / utt_features.NumRows());
+          utt_features.AddVecToRows(-1.0, mean);
+        }
+        if (compress)
+          compressed_writer.Write(utt, CompressedMatrix(utt_features,
+                                                        compression_method));
+        else
+          kaldi_writer.Write(utt, utt_features);
+        if (utt2dur_writer.IsOpen())
+          utt2dur_writer.Write(utt, waves[i].Dim() / samp_freq);
+        KALDI_VLOG(2) << "Processed features for key " << utt;
+        num_success++;
+      }
+      KALDI_LOG << "Processed " << reader.NumUtts() << " utterances";
+    }
+
+    KALDI_LOG << " Done " << num_success << " out of " << reader.NumUtts()
+              << " utterances.";
+    return (num_success != 0 ? 0 : 1);
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
@@ -15,19 +15,58 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
-
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
+#include "cudafeat/batched-wave-reader.h"
 #include "cudafeat/feature-mfcc-cuda.h"
 #include "feat/wave-reader.h"
 #include "cudamatrix/cu-matrix.h"
 #include "cudamatrix/cu-vector.h"
+
+namespace kaldi {
+
+// Computes the features of the waveforms in 'waves' with a single batched
+// call; (*features)[i] is set to the features of waves[i].
+static void ComputeBatch(const std::vector<Vector<BaseFloat> > &waves,
+                         BaseFloat samp_freq,
+                         CudaSpectralFeatures *mfcc,
+                         std::vector<Matrix<BaseFloat> > *features) {
+  std::vector<int32> wave_offsets(1, 0), feature_offsets;
+  for (size_t i = 0; i < waves.size(); i++)
+    wave_offsets.push_back(wave_offsets.back() + waves[i].Dim());
+
+  Vector<BaseFloat> all_waves(wave_offsets.back(), kUndefined);
+  for (size_t i = 0; i < waves.size(); i++)
+    all_waves.Range(wave_offsets[i], waves[i].Dim()).CopyFromVec(waves[i]);
+
+  CuVector<BaseFloat> cu_waves(all_waves);
+  CuMatrix<BaseFloat> cu_features;
+  mfcc->ComputeFeaturesBatched(cu_waves, wave_offsets, samp_freq,
+                                &cu_features, &feature_offsets);
+  Matrix<BaseFloat> all_features(cu_features);
+
+  features->resize(waves.size());
+  for (size_t i = 0; i < waves.size(); i++) {
+    int32 num_frames = feature_offsets[i + 1] - feature_offsets[i];
+    if (num_frames == 0)
+      (*features)[i].Resize(0, 0);
+    else
+      (*features)[i] = all_features.RowRange(feature_offsets[i], num_frames);
+  }
+}
+
+}  // namespace kaldi
+
 int main(int argc, char *argv[]) {
   try {
     using namespace kaldi;
     const char *usage =
-        "Create MFCC feature files.\n"
-        "Usage:  compute-mfcc-feats [options...] <wav-rspecifier> <feats-wspecifier>\n";
+        "Create MFCC feature files on the GPU, computing the features\n"
+        "of batches of utterances together.  The waveforms are read in a\n"
+        "background thread, while the GPU is computing the features of the\n"
+        "previous batch.\n"
+        "Usage:  compute-mfcc-feats-cuda [options...] <wav-rspecifier> "
+        "<feats-wspecifier>\n";
 
     // construct all the global objects
     ParseOptions po(usage);
@@ -35,9 +74,12 @@ int main(int argc, char *argv[]) {
     bool subtract_mean = false;
     BaseFloat vtln_warp = 1.0;
     std::string vtln_map_rspecifier;
-    std::string utt2spk_rspecifier;
     int32 channel = -1;
+    int32 batch_size = 64;
     BaseFloat min_duration = 0.0;
+    std::string utt2dur_wspecifier;
+    bool compress = false;
+    int32 compression_method_in = 1;
     // Define defaults for gobal options
     std::string output_format = "kaldi";
 
@@ -49,16 +91,24 @@ int main(int argc, char *argv[]) {
                 "files [kaldi, htk]");
     po.Register("subtract-mean", &subtract_mean, "Subtract mean of each "
                 "feature file [CMS]; not recommended to do it this way. ");
-    po.Register("vtln-warp", &vtln_warp, "Vtln warp factor (only applicable "
-                "if vtln-map not specified)");
-    po.Register("vtln-map", &vtln_map_rspecifier, "Map from utterance or "
-                "speaker-id to vtln warp factor (rspecifier)");
-    po.Register("utt2spk", &utt2spk_rspecifier, "Utterance to speaker-id map "
-                "rspecifier (if doing VTLN and you have warps per speaker)");
+    po.Register("vtln-warp", &vtln_warp, "Vtln warp factor; only 1.0 "
+                "(no VTLN) is supported on the GPU.");
+    po.Register("vtln-map", &vtln_map_rspecifier, "Not supported on the GPU; "
+                "use compute-mfcc-feats.");
     po.Register("channel", &channel, "Channel to extract (-1 -> expect mono, "
                 "0 -> left, 1 -> right)");
     po.Register("min-duration", &min_duration, "Minimum duration of segments "
                 "to process (in seconds).");
+    po.Register("batch-size", &batch_size, "Number of utterances whose "
+                "features are computed together.");
+    po.Register("write-utt2dur", &utt2dur_wspecifier, "Wspecifier to write "
+                "duration of each utterance in seconds, e.g. 'ark,t:utt2dur'.");
+    po.Register("compress", &compress, "If true, write output in compressed "
+                "form (see --compression-method).");
+    po.Register("compression-method", &compression_method_in,
+                "Only relevant if --compress=true; the method (1 through 7) to "
+                "compress the matrix.  Search for CompressionMethod in "
+                "src/matrix/compressed-matrix.h.");
 
     po.Read(argc, argv);
 
@@ -66,122 +116,90 @@ int main(int argc, char *argv[]) {
       po.PrintUsage();
       exit(1);
     }
-    
+    KALDI_ASSERT(batch_size > 0);
+    // The GPU code has no VTLN; rather than silently ignoring it, we refuse.
+    if (vtln_warp != 1.0 || vtln_map_rspecifier != "")
+      KALDI_ERR << "VTLN is not supported by compute-mfcc-feats-cuda; use "
+                << "compute-mfcc-feats.";
+    if (output_format != "kaldi" && output_format != "htk")
+      KALDI_ERR << "Invalid output_format string " << output_format;
+    if (output_format == "htk" && compress)
+      KALDI_ERR << "--compress=true is not compatible with --output-format=htk";
+    CompressionMethod compression_method = static_cast<CompressionMethod>(
+        compression_method_in);
+
     g_cuda_allocator.SetOptions(g_allocator_options);
     CuDevice::Instantiate().SelectGpuId("yes");
     CuDevice::Instantiate().AllowMultithreading();
 
-
     std::string wav_rspecifier = po.GetArg(1);
 
     std::string output_wspecifier = po.GetArg(2);
 
     CudaMfcc mfcc(mfcc_opts);
 
-    SequentialTableReader<WaveHolder> reader(wav_rspecifier);
-    BaseFloatMatrixWriter kaldi_writer;  // typedef to TableWriter<something>.
+    BatchedWaveReader reader(wav_rspecifier, batch_size, channel,
+                             min_duration);
+    BaseFloatMatrixWriter kaldi_writer;
+    CompressedMatrixWriter compressed_writer;
     TableWriter<HtkMatrixHolder> htk_writer;
-
-    if (utt2spk_rspecifier != "")
-      KALDI_ASSERT(vtln_map_rspecifier != "" && "the utt2spk option is only "
-                   "needed if the vtln-map option is used.");
-    RandomAccessBaseFloatReaderMapped vtln_map_reader(vtln_map_rspecifier,
-                                                      utt2spk_rspecifier);
-    
-    if (output_format == "kaldi") {
-      if (!kaldi_writer.Open(output_wspecifier))
-        KALDI_ERR << "Could not initialize output with wspecifier "
-                  << output_wspecifier;
-    } else if (output_format == "htk") {
-      if (!htk_writer.Open(output_wspecifier))
-        KALDI_ERR << "Could not initialize output with wspecifier "
-                  << output_wspecifier;
-    } else {
-      KALDI_ERR << "Invalid output_format string " << output_format;
-    }
-
-    int32 num_utts = 0, num_success = 0;
-    for (; !reader.Done(); reader.Next()) {
-      num_utts++;
-      std::string utt = reader.Key();
-      const WaveData &wave_data = reader.Value();
-      if (wave_data.Duration() < min_duration) {
-        KALDI_WARN << "File: " << utt << " is too short ("
-                   << wave_data.Duration() << " sec): producing no output.";
-        continue;
-      }
-      int32 num_chan = wave_data.Data().NumRows(), this_chan = channel;
-      {  // This block works out the channel (0=left, 1=right...)
-        KALDI_ASSERT(num_chan > 0);  // should have been caught in
-        // reading code if no channels.
-        if (channel == -1) {
-          this_chan = 0;
-          if (num_chan != 1)
-            KALDI_WARN << "Channel not specified but you have data with "
-                       << num_chan  << " channels; defaulting to zero";
-        } else {
-          if (this_chan >= num_chan) {
-            KALDI_WARN << "File with id " << utt << " has "
-                       << num_chan << " channels but you specified channel "
-                       << channel << ", producing no output.";
-            continue;
-          }
-        }
-      }
-      BaseFloat vtln_warp_local;  // Work out VTLN warp factor.
-      if (vtln_map_rspecifier != "") {
-        if (!vtln_map_reader.HasKey(utt)) {
-          KALDI_WARN << "No vtln-map entry for utterance-id (or speaker-id) "
-                     << utt;
+    if (!(output_format == "htk" ? htk_writer.Open(output_wspecifier) :
+          compress ? compressed_writer.Open(output_wspecifier) :
+          kaldi_writer.Open(output_wspecifier)))
+      KALDI_ERR << "Could not initialize output with wspecifier "
+                << output_wspecifier;
+    DoubleWriter utt2dur_writer(utt2dur_wspecifier);
+
+    std::vector<std::string> utts;
+    std::vector<Vector<BaseFloat> > waves;
+    std::vector<Matrix<BaseFloat> > features;
+    BaseFloat samp_freq;
+
+    int32 num_success = 0;
+    while (reader.ReadBatch(&utts, &waves, &samp_freq)) {
+      ComputeBatch(waves, samp_freq, &mfcc, &features);
+      for (size_t i = 0; i < utts.size(); i++) {
+        const std::string &utt = utts[i];
+        Matrix<BaseFloat> &utt_features = features[i];
+        if (utt_features.NumRows() == 0) {
+          KALDI_WARN << "No frames for utterance " << utt
+                     << ": producing no output.";
           continue;
         }
-        vtln_warp_local = vtln_map_reader.Value(utt);
-      } else {
-        vtln_warp_local = vtln_warp;
-      }
-
-      SubVector<BaseFloat> waveform(wave_data.Data(), this_chan);
-      Matrix<BaseFloat> features;
-      try {
-        CuVector<BaseFloat> cu_waveform(waveform);
-        CuMatrix<BaseFloat> cu_features;
-        mfcc.ComputeFeatures(cu_waveform, wave_data.SampFreq(), vtln_warp_local, &cu_features);
-        features.Resize(cu_features.NumRows(), cu_features.NumCols());
-        features.CopyFromMat(cu_features);
-      } catch (...) {
-        KALDI_WARN << "Failed to compute features for utterance "
-                   << utt;
-        continue;
-      }
-      if (subtract_mean) {
-        Vector<BaseFloat> mean(features.NumCols());
-        mean.AddRowSumMat(1.0, features);
-        mean.Scale(1.0 / features.NumRows());
-        for (int32 i = 0; i < features.NumRows(); i++)
-          features.Row(i).AddVec(-1.0, mean);
-      }
-      if (output_format == "kaldi") {
-        kaldi_writer.Write(utt, features);
-      } else {
-        std::pair<Matrix<BaseFloat>, HtkHeader> p;
-        p.first.Resize(features.NumRows(), features.NumCols());
-        p.first.CopyFromMat(features);
-        HtkHeader header = {
-          features.NumRows(),
-          100000,  // 10ms shift
-          static_cast<int16>(sizeof(float)*(features.NumCols())),
-          static_cast<uint16>( 006 | // MFCC
-          (mfcc_opts.use_energy ? 0100 : 020000)) // energy; otherwise c0
-        };
-        p.second = header;
-        htk_writer.Write(utt, p);
+        if (subtract_mean) {
+          Vector<BaseFloat> mean(utt_features.NumCols());
+          mean.AddRowSumMat(1.0, utt_features);
+          mean.Scale(1.0 / utt_features.NumRows());
+          utt_features.AddVecToRows(-1.0, mean);
+        }
+        if (output_format == "htk") {
+          std::pair<Matrix<BaseFloat>, HtkHeader> p;
+          p.first.Resize(utt_features.NumRows(), utt_features.NumCols());
+          p.first.CopyFromMat(utt_features);
+          HtkHeader header = {
+            utt_features.NumRows(),
+            100000,  // 10ms shift
+            static_cast<int16>(sizeof(float)*(utt_features.NumCols())),
+            static_cast<uint16>( 006 | // MFCC
+            (mfcc_opts.use_energy ? 0100 : 020000)) // energy; otherwise c0
+          };
+          p.second = header;
+          htk_writer.Write(utt, p);
+        } else if (compress) {
+          compressed_writer.Write(utt, CompressedMatrix(utt_features,
+                                                        compression_method));
+        } else {
+          kaldi_writer.Write(utt, utt_features);
+        }
+        if (utt2dur_writer.IsOpen())
+          utt2dur_writer.Write(utt, waves[i].Dim() / samp_freq);
+        KALDI_VLOG(2) << "Processed features for key " << utt;
+        num_success++;
       }
-      if (num_utts % 10 == 0)
-        KALDI_LOG << "Processed " << num_utts << " utterances";
-      KALDI_VLOG(2) << "Processed features for key " << utt;
-      num_success++;
+      KALDI_LOG << "Processed " << reader.NumUtts() << " utterances";
     }
-    KALDI_LOG << " Done " << num_success << " out of " << num_utts
+
+    KALDI_LOG << " Done " << num_success << " out of " << reader.NumUtts()
               << " utterances.";
     return (num_success != 0 ? 0 : 1);
   } catch(const std::exception &e) {
@@ -189,4 +207,3 @@ int main(int argc, char *argv[]) {
     return -1;
   }
 }
-
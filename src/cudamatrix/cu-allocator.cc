@@ -30,6 +30,7 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <memory>
 #ifndef _MSC_VER
 #include <dlfcn.h>
 #endif
@@ -40,6 +41,7 @@
 #include "base/kaldi-error.h"
 #include "base/kaldi-utils.h"
 #include "util/common-utils.h"
+#include "util/kaldi-metrics.h"
 
 namespace kaldi {
 
@@ -119,6 +121,7 @@ CuMemoryAllocator::MemoryBlock *CuMemoryAllocator::SplitBlock(
   new_block->subregion = subregion;
   new_block->allocated = false;
   new_block->thread_id = block->thread_id;
+  new_block->stream = block->stream;
   new_block->t = block->t;
   new_block->next = next_block;
   new_block->prev = block;
@@ -191,7 +194,7 @@ void* CuMemoryAllocator::MallocFromSubregion(SubRegion *subregion,
   for (int32 i = 0;
        search_iter != subregion->free_blocks.end() && i < max_iters;
        ++i, ++search_iter) {
-    if (search_iter->second->thread_id == std::this_thread::get_id() ||
+    if (FreedByThisStream(*(search_iter->second)) ||
         search_iter->second->t <= synchronize_gpu_t_) {
       iter = search_iter;
       break;
@@ -226,8 +229,7 @@ void* CuMemoryAllocator::MallocFromSubregion(SubRegion *subregion,
     block = SplitBlock(block, size);
   }
 
-  if (std::this_thread::get_id() != block->thread_id &&
-      block->t > synchronize_gpu_t_) {
+  if (!FreedByThisStream(*block) && block->t > synchronize_gpu_t_) {
     // see NOTE ON SYNCHRONIZATION in the header.
     SynchronizeGpu();
     synchronize_gpu_t_ = t_;
@@ -237,8 +239,11 @@ void* CuMemoryAllocator::MallocFromSubregion(SubRegion *subregion,
   block->t = t_;
   allocated_block_map_[block->begin] = block;
   allocated_memory_ += (block->end - block->begin);
-  if (allocated_memory_ > max_allocated_memory_) 
+  if (allocated_memory_ > max_allocated_memory_) {
     max_allocated_memory_ = allocated_memory_;
+    max_allocated_memory_gauge_->Set(max_allocated_memory_);
+  }
+  allocated_memory_gauge_->Set(allocated_memory_);
   return block->begin;
 }
 
@@ -325,6 +330,180 @@ std::string GetFreeGpuMemory(int64* free, int64* total) {
   return os.str();
 }
 
+bool CuMemoryAllocator::FreedByThisStream(const MemoryBlock &block) const {
+  return block.thread_id == std::this_thread::get_id() &&
+      block.stream == GetCudaStream();
+}
+
+struct CuMemoryAllocator::ThreadCache {
+  // The allocator this is a cache for; set to NULL if the allocator is
+  // destroyed before the thread exits.
+  CuMemoryAllocator *allocator;
+  // The stream the blocks were freed on (see CuStreamScope).
+  cudaStream_t stream;
+  // The free blocks, indexed by size class.
+  std::map<size_t, std::vector<void*> > free_blocks;
+  // The total size of the blocks in free_blocks.
+  size_t num_bytes;
+};
+
+// Guards the 'allocator' members of the ThreadCache objects, which are used
+// when threads exit, possibly after (at program exit) the allocator has
+// been destroyed.
+static std::mutex thread_cache_exit_mutex;
+
+struct CuMemoryAllocator::ThreadCacheList {
+  std::vector<ThreadCache*> caches;
+  ~ThreadCacheList() {
+    std::unique_lock<std::mutex> lock(thread_cache_exit_mutex);
+    for (size_t i = 0; i < caches.size(); i++) {
+      CuMemoryAllocator *allocator = caches[i]->allocator;
+      if (allocator != NULL) {
+        allocator->ReleaseFromThreadCache(caches[i], 0);
+        std::unique_lock<std::mutex> allocator_lock(allocator->mutex_);
+        allocator->thread_caches_.erase(caches[i]);
+      }
+      delete caches[i];
+    }
+  }
+};
+
+CuMemoryAllocator::ThreadCache *CuMemoryAllocator::GetThreadCache() {
+  static thread_local ThreadCacheList thread_caches;
+  cudaStream_t stream = GetCudaStream();
+  for (size_t i = 0; i < thread_caches.caches.size(); i++)
+    if (thread_caches.caches[i]->allocator == this &&
+        thread_caches.caches[i]->stream == stream)
+      return thread_caches.caches[i];
+  ThreadCache *cache = new ThreadCache();
+  cache->allocator = this;
+  cache->stream = stream;
+  cache->num_bytes = 0;
+  thread_caches.caches.push_back(cache);
+  std::unique_lock<std::mutex> lock(mutex_);
+  thread_caches_.insert(cache);
+  return cache;
+}
+
+size_t CuMemoryAllocator::ThreadCacheSizeClass(size_t size) const {
+  size_t max_size = (static_cast<size_t>(opts_.thread_cache_mb) << 20) / 8;
+  size = (size + 255) & ~((size_t)255);
+  if (size == 0 || size > max_size)
+    return 0;
+  // Round up to a multiple of 'step', a power of two that is at least
+  // 1/16 of 'size' (so we waste less than 1/16 of the memory), giving 16
+  // size classes for each power of two.
+  size_t step = 256;
+  while (step * 16 < size)
+    step *= 2;
+  return (size + step - 1) & ~(step - 1);
+}
+
+void *CuMemoryAllocator::MallocFromThreadCache(size_t size_class) {
+  ThreadCache *cache = GetThreadCache();
+  void *ans;
+  std::map<size_t, std::vector<void*> >::iterator iter =
+      cache->free_blocks.find(size_class);
+  if (iter != cache->free_blocks.end() && !iter->second.empty()) {
+    ans = iter->second.back();
+    iter->second.pop_back();
+    cache->num_bytes -= size_class;
+    thread_cache_memory_ -= size_class;
+    thread_cache_hits_++;
+  } else {
+    std::unique_lock<std::mutex> lock(mutex_);
+    ans = Malloc(size_class);
+    thread_cache_misses_++;
+  }
+  ThreadCacheShard &shard = ShardForPointer(ans);
+  std::unique_lock<std::mutex> lock(shard.mutex);
+  shard.size_class[ans] = size_class;
+  return ans;
+}
+
+void CuMemoryAllocator::ReleaseFromThreadCache(ThreadCache *cache,
+                                               size_t target_bytes) {
+  // Free() records the current stream as the one the blocks were freed on.
+  std::unique_ptr<CuStreamScope> stream_scope;
+  if (cache->stream != GetCudaStream())
+    stream_scope.reset(new CuStreamScope(cache->stream));
+  std::unique_lock<std::mutex> lock(mutex_);
+  std::map<size_t, std::vector<void*> >::reverse_iterator iter =
+      cache->free_blocks.rbegin();
+  for (; iter != cache->free_blocks.rend() && cache->num_bytes > target_bytes;
+       ++iter) {
+    std::vector<void*> &blocks = iter->second;
+    while (!blocks.empty() && cache->num_bytes > target_bytes) {
+      Free(blocks.back());
+      blocks.pop_back();
+      cache->num_bytes -= iter->first;
+      thread_cache_memory_ -= iter->first;
+      thread_cache_returns_++;
+    }
+  }
+}
+
+void* CuMemoryAllocator::MallocLocking(size_t size) {
+  if (opts_.cache_memory && opts_.thread_cache_mb > 0) {
+    size_t size_class = ThreadCacheSizeClass(size);
+    if (size_class != 0)
+      return MallocFromThreadCache(size_class);
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  return Malloc(size);
+}
+
+void* CuMemoryAllocator::MallocPitchLocking(size_t row_bytes,
+                                            size_t num_rows, size_t *pitch) {
+  if (opts_.cache_memory && opts_.thread_cache_mb > 0) {
+    // The same pitch as MallocPitch() would give.
+    size_t rounded_row_bytes = (row_bytes + 255) & ~((size_t)255);
+    size_t size_class = ThreadCacheSizeClass(rounded_row_bytes * num_rows);
+    if (size_class != 0) {
+      *pitch = rounded_row_bytes;
+      return MallocFromThreadCache(size_class);
+    }
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  return MallocPitch(row_bytes, num_rows, pitch);
+}
+
+void CuMemoryAllocator::FreeLocking(void *ptr) {
+  size_t size_class = 0;
+  if (opts_.cache_memory && opts_.thread_cache_mb > 0) {
+    ThreadCacheShard &shard = ShardForPointer(ptr);
+    std::unique_lock<std::mutex> lock(shard.mutex);
+    unordered_map<void*, size_t>::iterator iter = shard.size_class.find(ptr);
+    if (iter != shard.size_class.end()) {
+      size_class = iter->second;
+      shard.size_class.erase(iter);
+    }
+  }
+  if (size_class == 0) {  // It was not allocated from a thread cache.
+    std::unique_lock<std::mutex> lock(mutex_);
+    Free(ptr);
+    return;
+  }
+  ThreadCache *cache = GetThreadCache();
+  cache->free_blocks[size_class].push_back(ptr);
+  cache->num_bytes += size_class;
+  thread_cache_memory_ += size_class;
+  size_t max_bytes = static_cast<size_t>(opts_.thread_cache_mb) << 20;
+  if (cache->num_bytes > max_bytes)
+    ReleaseFromThreadCache(cache, max_bytes / 2);
+}
+
+size_t CuMemoryAllocator::GetFreeCachedMemory() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  size_t memory_held = 0;
+  for (size_t i = 0; i < memory_regions_.size(); i++)
+    memory_held += memory_regions_[i].end - memory_regions_[i].begin;
+  // allocated_memory_ only counts the blocks given out from the cache, which
+  // include the blocks held in the thread caches.
+  return (opts_.cache_memory ?
+          memory_held - allocated_memory_ + thread_cache_memory_ : 0);
+}
+
 void CuMemoryAllocator::PrintMemoryUsage() const {
   if (!opts_.cache_memory) {
     KALDI_LOG << "Not caching allocations; time taken in "
@@ -378,6 +557,13 @@ void CuMemoryAllocator::PrintMemoryUsage() const {
             << "device memory info: " << GetFreeGpuMemory(NULL, NULL)
             << "maximum allocated: " << max_allocated_memory_  
             << "current allocated: " << allocated_memory_; 
+  if (thread_cache_hits_ + thread_cache_misses_ > 0)
+    KALDI_LOG << "Thread caches: " << thread_caches_.size() << " threads "
+              << "hold " << thread_cache_memory_ << " bytes (included in "
+              << "the allocated memory above); " << thread_cache_hits_ << "/"
+              << thread_cache_misses_ << " allocations were from the thread "
+              << "caches/from the shared pool, and " << thread_cache_returns_
+              << " blocks were returned to the shared pool.";
 }
 
 // Note: we just initialize with the default options, but we can change it later
@@ -390,9 +576,23 @@ CuMemoryAllocator::CuMemoryAllocator():
     tot_time_taken_(0.0),
     malloc_time_taken_(0.0),
     max_allocated_memory_(0),
-    allocated_memory_(0) {
+    allocated_memory_(0),
+    thread_cache_hits_(0),
+    thread_cache_misses_(0),
+    thread_cache_returns_(0),
+    thread_cache_memory_(0) {
   // Note: we don't allocate any memory regions at the start; we wait for the user
   // to call Malloc() or MallocPitch(), and then allocate one when needed.
+  MetricsRegistry &registry = MetricsRegistry::Global();
+  allocated_memory_gauge_ = registry.GetGauge(
+      "kaldi_cuda_allocated_bytes", "GPU memory currently given out by the "
+      "CUDA memory allocator, in bytes.");
+  max_allocated_memory_gauge_ = registry.GetGauge(
+      "kaldi_cuda_max_allocated_bytes", "The most GPU memory given out by the "
+      "CUDA memory allocator at any one time, in bytes.");
+  region_memory_gauge_ = registry.GetGauge(
+      "kaldi_cuda_cached_bytes", "GPU memory held by the CUDA memory "
+      "allocator (allocated or not), in bytes.");
 }
 
 
@@ -434,9 +634,11 @@ void CuMemoryAllocator::Free(void *ptr) {
   }
   MemoryBlock *block = iter->second;
   allocated_memory_ -= (block->end - block->begin);
+  allocated_memory_gauge_->Set(allocated_memory_);
   allocated_block_map_.erase(iter);
   block->t = t_;
   block->thread_id = std::this_thread::get_id();
+  block->stream = GetCudaStream();
   block->allocated = false;
 
   // If this is not the first block of the memory region and the previous block
@@ -445,10 +647,12 @@ void CuMemoryAllocator::Free(void *ptr) {
   if (prev_block != NULL && !prev_block->allocated) {
     RemoveFromFreeBlocks(prev_block);
     prev_block->end = block->end;
-    if (prev_block->thread_id != block->thread_id) {
-      // the two blocks we're merging were freed by different threads, so we
-      // give the 'nonexistent thread' as their thread, which means that
-      // whichever thread requests that block, we force synchronization.  We can
+    if (prev_block->thread_id != block->thread_id ||
+        prev_block->stream != block->stream) {
+      // the two blocks we're merging were freed by different threads (or
+      // streams), so we give the 'nonexistent thread' as their thread, which
+      // means that whichever thread requests that block, we force
+      // synchronization.  We can
       // assume that prev_block was previously allocated (prev_block->t > 0)
       // because we always start from the left when allocating blocks, and we
       // know that this block was previously allocated.
@@ -471,10 +675,12 @@ void CuMemoryAllocator::Free(void *ptr) {
     // be pointing to that previous block, so it would be a 3-way merge.
     RemoveFromFreeBlocks(next_block);
     block->end = next_block->end;
-    if (next_block->thread_id != block->thread_id && next_block->t > 0) {
-      // the two blocks we're merging were freed by different threads, so we
-      // give the 'nonexistent thread' as their thread, which means that
-      // whichever thread requests that block, we force synchronization.  there
+    if ((next_block->thread_id != block->thread_id ||
+         next_block->stream != block->stream) && next_block->t > 0) {
+      // the two blocks we're merging were freed by different threads (or
+      // streams), so we give the 'nonexistent thread' as their thread, which
+      // means that whichever thread requests that block, we force
+      // synchronization.  there
       // is no need to do this if next_block->t == 0, which would mean it had
       // never been allocated.
       block->thread_id = std::thread::id();
@@ -543,6 +749,7 @@ void CuMemoryAllocator::AllocateNewRegion(size_t size) {
 
   this_region.begin = static_cast<char*>(memory_region);
   this_region.end = this_region.begin + region_size;
+  region_memory_gauge_->Add(region_size);
   // subregion_size will be hundreds of megabytes.
   size_t subregion_size = region_size / this_num_subregions;
 
@@ -573,6 +780,7 @@ void CuMemoryAllocator::AllocateNewRegion(size_t size) {
   block->subregion = new_subregions.front();
   block->allocated = false;
   block->t = 0; // was never allocated.
+  block->stream = 0;
   block->next = NULL;
   block->prev = NULL;
   for (size_t i = 0; i < this_num_subregions; i++)
@@ -610,6 +818,13 @@ void CuMemoryAllocator::SortSubregions() {
 }
 
 CuMemoryAllocator::~CuMemoryAllocator() {
+  {
+    // The blocks in the thread caches are freed below with the regions.
+    std::unique_lock<std::mutex> lock(thread_cache_exit_mutex);
+    for (std::set<ThreadCache*>::iterator iter = thread_caches_.begin();
+         iter != thread_caches_.end(); ++iter)
+      (*iter)->allocator = NULL;
+  }
   // We mainly free these blocks of memory so that cuda-memcheck doesn't report
   // spurious errors.
   for (size_t i = 0; i < memory_regions_.size(); i++) {
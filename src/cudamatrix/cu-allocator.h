@@ -28,6 +28,7 @@
 #include <cuda_runtime_api.h>
 #endif
 
+#include <atomic>
 #include <map>
 #include <set>
 #include <mutex>
@@ -41,6 +42,8 @@
 
 namespace kaldi {
 
+class MetricsGauge;
+
 
 // For now we don't give the user a way to modify these from the command line.
 // or the code, it just documents what the default options are.  To change
@@ -64,8 +67,16 @@ struct CuAllocatorOptions {
   // memory low addresses.
   int32 num_subregions;
 
+  // When the allocator is used from multiple CPU threads, each thread keeps
+  // the blocks it frees in a cache of its own, from which it can reallocate
+  // them without locking the allocator; this is the amount of memory, in
+  // megabytes, that a thread's cache may hold before the blocks are returned
+  // to the shared pool.  0 disables the per-thread caches.
+  int32 thread_cache_mb;
+
   CuAllocatorOptions():
-      cache_memory(true), memory_proportion(0.5), num_subregions(20) { }
+      cache_memory(true), memory_proportion(0.5), num_subregions(20),
+      thread_cache_mb(32) { }
 
   void Register(OptionsItf *po) {
     po->Register("cuda-cache-memory", &cache_memory, "True if you want "
@@ -74,6 +85,10 @@ struct CuAllocatorOptions {
     po->Register("cuda-memory-proportion", &memory_proportion,
                  "Proportion of the GPU device memory that the allocator "
                  "should allocate at the start");
+    po->Register("cuda-thread-cache-mb", &thread_cache_mb, "In multi-threaded "
+                 "programs, the amount of freed GPU memory (in megabytes) "
+                 "that each CPU thread may keep for its own reuse, to avoid "
+                 "locking the allocator; 0 to disable.");
   }
 
   void Check() {
@@ -126,11 +141,29 @@ namespace kaldi {
    same CPU thread; and if that is not possible and we haven't called
    SynchronizeGpu() since the block was freed, then we call
    SynchronizeGpu().  The hope is that this will happen quite rarely.
-   Note that this is based on the assumption that the user is using the
-   per-thread default stream (indeed this is how we compile).  If the
-   user were to make explicit use of CUDA streams, this mechanism would
-   not necessarily be sufficient to prevent data-race conditions and the
-   user might have to take further precautions.
+   A thread may queue its work on streams other than its default stream
+   (see CuStreamScope in cu-device.h), so we actually record the pair
+   (thread-id, stream), the stream being GetCudaStream() at the time of the
+   Free(), and regard a block freed by the same thread on another stream like
+   one freed by another thread.  This is only sufficient if the streams are
+   synchronized by SynchronizeGpu(), i.e. if they were not created with the
+   cudaStreamNonBlocking flag.
+
+   NOTE ON THREAD CACHES: in multi-threaded programs the '*Locking' versions
+   of the functions are used, and to avoid contention for the mutex each CPU
+   thread has its own cache of freed blocks (of sizes up to 1/8 of
+   CuAllocatorOptions::thread_cache_mb, rounded up to one of a small number
+   of size classes).  A block freed by a thread goes into that thread's
+   cache, and the thread's later allocations of that size class are taken
+   from there without locking; since the block was last used on the same
+   thread's stream, no synchronization is needed.  (A thread that uses
+   several streams, see CuStreamScope, has a cache for each of them.)  When
+   a thread's cache holds more than thread_cache_mb, half of it is returned
+   to the shared pool, as is all of it when the thread exits.  To know the size of a block
+   being freed, which may have been allocated by another thread, the blocks
+   given out from the thread caches are recorded in a map that is split
+   into several parts with separate mutexes.  The shared pool regards the
+   blocks in the thread caches as allocated.
 
    NOTE ON FRAGMENTATION: Memory fragmentation is one of the main problems that
    you'll run into with allocators like this.  This allocator will allocate a
@@ -162,21 +195,15 @@ class CuMemoryAllocator {
   /// Free device memory allocated by Malloc() or MallocPitch().
   void Free(void *ptr);
 
-  /// Mutex-guarded version of Malloc(), for use in multi-threaded programs.
-  inline void* MallocLocking(size_t size) {
-    std::unique_lock<std::mutex> lock(mutex_);
-    return Malloc(size);
-  }
-  /// Mutex-guarded version of Malloc(), for use in multi-threaded programs.
-  inline void* MallocPitchLocking(size_t row_bytes, size_t num_rows, size_t *pitch) {
-    std::unique_lock<std::mutex> lock(mutex_);
-    return MallocPitch(row_bytes, num_rows, pitch);
-  }
-  /// Mutex-guarded version of Free(), for use in multi-threaded programs.
-  void FreeLocking(void *ptr) {
-    std::unique_lock<std::mutex> lock(mutex_);
-    Free(ptr);
-  }
+  /// Thread-safe version of Malloc(), for use in multi-threaded programs;
+  /// uses this thread's cache if possible (see "NOTE ON THREAD CACHES").
+  void* MallocLocking(size_t size);
+  /// Thread-safe version of MallocPitch(), for use in multi-threaded
+  /// programs.
+  void* MallocPitchLocking(size_t row_bytes, size_t num_rows, size_t *pitch);
+  /// Thread-safe version of Free(), for use in multi-threaded programs; the
+  /// memory may have been allocated by a different thread.
+  void FreeLocking(void *ptr);
 
   void PrintMemoryUsage() const;
 
@@ -186,6 +213,11 @@ class CuMemoryAllocator {
   //  returns the maximum memory used within the cache during current execution
   size_t GetMaxAllocatedMemory() { return max_allocated_memory_; }
 
+  // returns the memory held in the cache that is not currently allocated,
+  // i.e. that can be allocated without asking CUDA for more (including the
+  // memory in the thread caches).
+  size_t GetFreeCachedMemory();
+
   CuMemoryAllocator();
 
   // Allows you to set options: must be called before any Malloc function is
@@ -218,9 +250,11 @@ class CuMemoryAllocator {
                                 // block, or the invalid thread-id as created by
                                 // the constructor of std::thread::id if this
                                 // block was created by merging blocks from
-                                // different threads.  Required for
-                                // synchronization; and note that we assume
-                                // there is one CUDA stream per CPU thread.
+                                // different threads or streams.  Required
+                                // for synchronization.
+    cudaStream_t stream;  // The stream of that thread that was in use when
+                          // the block was freed (see the NOTE ON
+                          // SYNCHRONIZATION above).
 
     MemoryBlock *next;  // The next MemoryBlock within this MemoryRegion (or
                         // NULL if this is the last one); its 'begin' would be
@@ -312,6 +346,45 @@ class CuMemoryAllocator {
   // the code), and it also recomputes the largest_free_block_ array.
   void SortSubregions();
 
+  // The cache of freed blocks of one thread (see "NOTE ON THREAD CACHES"),
+  // and the list of a thread's caches (one for each allocator it has used).
+  struct ThreadCache;
+  struct ThreadCacheList;
+
+  // Returns true if 'block' was freed by the calling thread while it was using
+  // the same CUDA stream as now, so that it can be reused without
+  // synchronization.
+  bool FreedByThisStream(const MemoryBlock &block) const;
+
+  // Returns the calling thread's cache for this allocator and its current
+  // CUDA stream, creating it if needed.
+  ThreadCache *GetThreadCache();
+
+  // Returns the size that we allocate from the thread caches for a request
+  // of 'size' bytes, or 0 if the request is too large to use them.
+  size_t ThreadCacheSizeClass(size_t size) const;
+
+  // Allocates a block of size 'size_class' (as returned by
+  // ThreadCacheSizeClass()), from this thread's cache if possible.
+  void *MallocFromThreadCache(size_t size_class);
+
+  // Returns blocks from 'cache' to the shared pool, the largest first, until
+  // it holds no more than 'target_bytes'.  Locks mutex_.
+  void ReleaseFromThreadCache(ThreadCache *cache, size_t target_bytes);
+
+  // A part of the map from the blocks given out from the thread caches to
+  // their size classes.
+  struct ThreadCacheShard {
+    std::mutex mutex;
+    std::unordered_map<void*, size_t> size_class;
+  };
+  static const int32 kNumThreadCacheShards = 32;
+  ThreadCacheShard thread_cache_shards_[kNumThreadCacheShards];
+  inline ThreadCacheShard &ShardForPointer(void *ptr) {
+    return thread_cache_shards_[(reinterpret_cast<size_t>(ptr) >> 8) %
+                                kNumThreadCacheShards];
+  }
+
 
 
   CuAllocatorOptions opts_;
@@ -346,6 +419,21 @@ class CuMemoryAllocator {
   //   the application
   size_t max_allocated_memory_;
   size_t allocated_memory_;
+  // Metrics (see util/kaldi-metrics.h) that track allocated_memory_,
+  // max_allocated_memory_ and the total size of memory_regions_.
+  MetricsGauge *allocated_memory_gauge_;
+  MetricsGauge *max_allocated_memory_gauge_;
+  MetricsGauge *region_memory_gauge_;
+
+  // The thread caches for this allocator; guarded by mutex_.
+  std::set<ThreadCache*> thread_caches_;
+  // Statistics of the thread caches: the number of allocations that were
+  // taken from them and that had to go to the shared pool, the number of
+  // blocks returned to the shared pool from them, and the memory they hold.
+  std::atomic<size_t> thread_cache_hits_;
+  std::atomic<size_t> thread_cache_misses_;
+  std::atomic<size_t> thread_cache_returns_;
+  std::atomic<size_t> thread_cache_memory_;
 };
 
 
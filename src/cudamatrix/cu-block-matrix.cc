@@ -141,8 +141,8 @@ void CuBlockMatrix<Real>::SetCudaData() {
     cu_data_ = static_cast<CuBlockMatrixData*>(
         CuDevice::Instantiate().Malloc(size));
     CU_SAFE_CALL(cudaMemcpyAsync(cu_data_, &(tmp_cu_data[0]), size, 
-                                 cudaMemcpyHostToDevice, cudaStreamPerThread));
-    CU_SAFE_CALL(cudaStreamSynchronize(cudaStreamPerThread));
+                                 cudaMemcpyHostToDevice, GetCudaStream()));
+    CU_SAFE_CALL(cudaStreamSynchronize(GetCudaStream()));
     CuDevice::Instantiate().AccuProfile(__func__, tim);    
   }
 #endif
@@ -21,6 +21,8 @@
 #include <iostream>
 #include <vector>
 #include <cstdlib>
+#include <mutex>
+#include <thread>
 
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
@@ -95,6 +97,86 @@ void CudaMatrixResizeTest() {
 }
 
 
+// Each thread allocates and frees matrices, and half of the matrices it
+// allocates are freed by the next thread, to test the thread caches of the
+// allocator with blocks freed by a thread other than the one that allocated
+// them.
+static void TestCuMatrixResizeThread(
+    int32 thread, std::vector<std::vector<CuMatrix<BaseFloat>*> > *handoff,
+    std::vector<std::mutex> *handoff_mutex) {
+  int32 num_threads = handoff->size();
+  for (int32 i = 0; i < 2000; i++) {
+    CuMatrix<BaseFloat> *m = new CuMatrix<BaseFloat>(RandInt(1, 100),
+                                                    RandInt(1, 100));
+    m->Add(1.0);
+    if (i % 2 == 0) {
+      KALDI_ASSERT(m->Sum() == m->NumRows() * m->NumCols());
+      delete m;
+    } else {
+      std::unique_lock<std::mutex> lock(
+          (*handoff_mutex)[(thread + 1) % num_threads]);
+      (*handoff)[(thread + 1) % num_threads].push_back(m);
+    }
+    std::vector<CuMatrix<BaseFloat>*> mine;
+    {
+      std::unique_lock<std::mutex> lock((*handoff_mutex)[thread]);
+      mine.swap((*handoff)[thread]);
+    }
+    for (size_t j = 0; j < mine.size(); j++) {
+      KALDI_ASSERT(mine[j]->Sum() == mine[j]->NumRows() * mine[j]->NumCols());
+      delete mine[j];
+    }
+  }
+}
+
+void CudaMatrixResizeMultithreadedTest() {
+  int32 num_threads = 4;
+  std::vector<std::vector<CuMatrix<BaseFloat>*> > handoff(num_threads);
+  std::vector<std::mutex> handoff_mutex(num_threads);
+  std::vector<std::thread> threads;
+  for (int32 t = 0; t < num_threads; t++)
+    threads.push_back(std::thread(TestCuMatrixResizeThread, t, &handoff,
+                                  &handoff_mutex));
+  for (int32 t = 0; t < num_threads; t++)
+    threads[t].join();
+  for (int32 t = 0; t < num_threads; t++)
+    for (size_t j = 0; j < handoff[t].size(); j++)
+      delete handoff[t][j];
+}
+
+
+#if HAVE_CUDA == 1
+// Does the same computation on the default stream and, allocating and
+// freeing memory, on two other streams, and checks the results.
+void TestCuStreamScope() {
+  if (!CuDevice::Instantiate().Enabled())
+    return;
+  cudaStream_t streams[2];
+  for (int32 i = 0; i < 2; i++)
+    CU_SAFE_CALL(cudaStreamCreate(&(streams[i])));
+  Matrix<BaseFloat> a(100, 50), b(50, 80), c(100, 80);
+  a.SetRandn();
+  b.SetRandn();
+  c.AddMatMat(1.0, a, kNoTrans, b, kNoTrans, 0.0);
+  c.ApplyExp();
+  for (int32 iter = 0; iter < 10; iter++) {
+    for (int32 i = 0; i < 2; i++) {
+      CuStreamScope scope(streams[i]);
+      KALDI_ASSERT(GetCudaStream() == streams[i]);
+      CuMatrix<BaseFloat> cu_a(a), cu_b(b), cu_c(a.NumRows(), b.NumCols());
+      cu_c.AddMatMat(1.0, cu_a, kNoTrans, cu_b, kNoTrans, 0.0);
+      cu_c.ApplyExp();
+      Matrix<BaseFloat> c2(cu_c);
+      AssertEqual(c, c2);
+    }
+    KALDI_ASSERT(GetCudaStream() == cudaStreamPerThread);
+  }
+  for (int32 i = 0; i < 2; i++)
+    CU_SAFE_CALL(cudaStreamDestroy(streams[i]));
+}
+#endif
+
+
 } // namespace kaldi
 
 
@@ -111,6 +193,7 @@ int main() {
 
     kaldi::CudaMatrixResizeTest<float>();
 #if HAVE_CUDA == 1
+    kaldi::TestCuStreamScope();
     if (CuDevice::Instantiate().DoublePrecisionSupported()) {
       kaldi::CudaMatrixResizeTest<double>();
     } else {
@@ -122,6 +205,11 @@ int main() {
 
 #if HAVE_CUDA == 1
   }
+  CuDevice::Instantiate().AllowMultithreading();
+#endif
+  kaldi::CudaMatrixResizeMultithreadedTest();
+#if HAVE_CUDA == 1
+  CuDevice::Instantiate().PrintMemoryUsage();
   CuDevice::Instantiate().PrintProfile();
 #endif
   KALDI_LOG << "Tests succeeded.";
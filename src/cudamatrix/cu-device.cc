@@ -26,6 +26,7 @@
 #include <cublas_v2.h>
 #include <cuda.h>
 #include <cuda_runtime_api.h>
+#include <nvToolsExt.h>
 
 #include <string>
 #include <vector>
@@ -37,6 +38,7 @@
 #include "cudamatrix/cu-common.h"
 #include "cudamatrix/cu-device.h"
 #include "cudamatrix/cu-matrix.h"
+#include "cudamatrix/cu-pinned-matrix.h"
 #include "base/kaldi-error.h"
 #include "base/kaldi-utils.h"
 #include "util/common-utils.h"
@@ -46,6 +48,11 @@
 
 namespace kaldi {
 
+// These are the range functions for class Tracer, see
+// Tracer::SetRangeFunctions().
+static void NvtxRangePush(const char *name) { nvtxRangePushA(name); }
+static void NvtxRangePop() { nvtxRangePop(); }
+
 /// This function attempts to get a CUDA device context on some available device
 /// by doing 'cudaFree(0)'.  If it succeeds it returns true; if it fails, it
 /// outputs some debugging information into 'debug_str' and returns false.
@@ -105,16 +112,21 @@ void CuDevice::Initialize() {
           "CuDevice::Instantiate().AllowMultithreading() at the start of "
           "the program.";
     }
-    device_id_copy_ = device_id_;
-    cudaSetDevice(device_id_);
+    if (thread_device_id_ >= 0 && thread_device_id_ != device_id_) {
+      device_id_copy_ = thread_device_id_;
+      allocator_ = GetAllocator(thread_device_id_);
+    } else {
+      device_id_copy_ = device_id_;
+    }
+    cudaSetDevice(device_id_copy_);
     // Initialize CUBLAS.
     CUBLAS_SAFE_CALL(cublasCreate(&cublas_handle_));
-    CUBLAS_SAFE_CALL(cublasSetStream(cublas_handle_, cudaStreamPerThread));
+    CUBLAS_SAFE_CALL(cublasSetStream(cublas_handle_, cuda_stream_));
 
 #if CUDA_VERSION >= 9010
     CUSOLVER_SAFE_CALL(cusolverDnCreate(&cusolverdn_handle_));
     CUSOLVER_SAFE_CALL(cusolverDnSetStream(cusolverdn_handle_, 
-            cudaStreamPerThread));
+            cuda_stream_));
 #endif
     
 #if CUDA_VERSION >= 9000 
@@ -128,7 +140,7 @@ void CuDevice::Initialize() {
 
     // Initialize the cuSPARSE library
     CUSPARSE_SAFE_CALL(cusparseCreate(&cusparse_handle_));
-    CUSPARSE_SAFE_CALL(cusparseSetStream(cusparse_handle_, cudaStreamPerThread));
+    CUSPARSE_SAFE_CALL(cusparseSetStream(cusparse_handle_, cuda_stream_));
 
     // Initialize the generator,
     CURAND_SAFE_CALL(curandCreateGenerator(
@@ -136,7 +148,7 @@ void CuDevice::Initialize() {
     // To get same random sequence, call srand() before the constructor is invoked,
     CURAND_SAFE_CALL(curandSetGeneratorOrdering(
           curand_handle_, CURAND_ORDERING_PSEUDO_DEFAULT));
-    CURAND_SAFE_CALL(curandSetStream(curand_handle_, cudaStreamPerThread));
+    CURAND_SAFE_CALL(curandSetStream(curand_handle_, cuda_stream_));
     SeedGpu();
   }
 }
@@ -269,12 +281,12 @@ void CuDevice::FinalizeActiveGpu() {
                           // the main thread.
     // Initialize CUBLAS.
     CUBLAS_SAFE_CALL(cublasCreate(&cublas_handle_));
-    CUBLAS_SAFE_CALL(cublasSetStream(cublas_handle_, cudaStreamPerThread));
+    CUBLAS_SAFE_CALL(cublasSetStream(cublas_handle_, cuda_stream_));
     
 #if CUDA_VERSION >= 9010 
     CUSOLVER_SAFE_CALL(cusolverDnCreate(&cusolverdn_handle_));
     CUSOLVER_SAFE_CALL(cusolverDnSetStream(cusolverdn_handle_,
-            cudaStreamPerThread));
+            cuda_stream_));
 #endif
 
 #if CUDA_VERSION >= 9000 
@@ -289,7 +301,7 @@ void CuDevice::FinalizeActiveGpu() {
     
     // Initialize the cuSPARSE library
     CUSPARSE_SAFE_CALL(cusparseCreate(&cusparse_handle_));
-    CUSPARSE_SAFE_CALL(cusparseSetStream(cusparse_handle_, cudaStreamPerThread));
+    CUSPARSE_SAFE_CALL(cusparseSetStream(cusparse_handle_, cuda_stream_));
     
     // Initialize the generator,
     CURAND_SAFE_CALL(curandCreateGenerator(
@@ -299,6 +311,10 @@ void CuDevice::FinalizeActiveGpu() {
           curand_handle_, CURAND_ORDERING_PSEUDO_DEFAULT));
     SeedGpu();
 
+    // Make the spans of the tracer (see class Tracer) show up as NVTX
+    // ranges in NVIDIA's profilers.
+    Tracer::SetRangeFunctions(&NvtxRangePush, &NvtxRangePop);
+
     // Notify the user which GPU is being userd.
     char name[128];
     DeviceGetName(name,128, device_id);
@@ -458,16 +474,20 @@ bool CuDevice::SelectGpuIdAuto() {
 
 void CuDevice::AccuProfile(const char *function_name,
                            const CuTimer &timer) {
+  if (Tracer::Enabled()) {
+    int64 end = Tracer::Now();
+    Tracer::RecordSpan(function_name,
+                       end - static_cast<int64>(timer.Elapsed() * 1.0e+09),
+                       end);
+  }
   if (GetVerboseLevel() >= 1) {
     std::unique_lock<std::mutex> lock(profile_mutex_, std::defer_lock_t());
     if (multi_threaded_)
       lock.lock();
     std::string key(function_name);
-    // by passing 0 as the stream to cudaStreamSynchronize, we are using the
-    // per-thread default stream.  Since we compile with
-    // -DCUDA_API_PER_THREAD_DEFAULT_STREAM, this equates to a per-thread
-    // stream.
-    CU_SAFE_CALL(cudaStreamSynchronize(0));
+    // cuda_stream_ is the per-thread default stream unless a CuStreamScope
+    // says otherwise.
+    CU_SAFE_CALL(cudaStreamSynchronize(cuda_stream_));
     double elapsed = timer.Elapsed();
     if (profile_map_.find(key) == profile_map_.end())
       profile_map_[key] = elapsed;
@@ -477,8 +497,62 @@ void CuDevice::AccuProfile(const char *function_name,
 }
 
 void CuDevice::PrintMemoryUsage() const {
-  if (Enabled())
+  if (Enabled()) {
     g_cuda_allocator.PrintMemoryUsage();
+    g_cuda_pinned_allocator.PrintMemoryUsage();
+    std::lock_guard<std::mutex> lock(allocators_mutex_);
+    for (auto &p : other_allocators_) {
+      KALDI_LOG << "Memory usage of GPU " << p.first << ":";
+      p.second->PrintMemoryUsage();
+    }
+  }
+}
+
+int64 CuDevice::GetAvailableMemory() {
+  KALDI_ASSERT(Enabled());
+  int64 free_memory;
+  GetFreeGpuMemory(&free_memory, NULL);
+  return free_memory + static_cast<int64>(allocator_->GetFreeCachedMemory());
+}
+
+void CuDevice::SelectThreadGpuId(int32 device_id) {
+  CuDevice &device = this_thread_device_;
+  if (device_id_ == -1)
+    KALDI_ERR << "SelectThreadGpuId() requires SelectGpuId() to have "
+        "selected a GPU.";
+  if (device.initialized_)
+    KALDI_ERR << "SelectThreadGpuId() must be called before the thread "
+        "uses the GPU.";
+  int32 num_gpus = 0;
+  cudaError_t e = cudaGetDeviceCount(&num_gpus);
+  if (e != cudaSuccess)
+    KALDI_CUDA_ERR(e, "cudaGetDeviceCount() failed");
+  if (device_id < 0 || device_id >= num_gpus)
+    KALDI_ERR << "Invalid GPU id " << device_id << " (there are " << num_gpus
+              << " GPUs)";
+  device.thread_device_id_ = device_id;
+  if (device_id != device_id_) {
+    multi_gpu_ = true;
+    multi_threaded_ = true;
+  }
+}
+
+CuMemoryAllocator *CuDevice::GetAllocator(int32 device_id) {
+  if (device_id == device_id_)
+    return &g_cuda_allocator;
+  std::lock_guard<std::mutex> lock(allocators_mutex_);
+  CuMemoryAllocator *&allocator = other_allocators_[device_id];
+  if (allocator == NULL) {
+    allocator = new CuMemoryAllocator();
+    allocator->SetOptions(g_allocator_options);
+  }
+  return allocator;
+}
+
+CuMemoryAllocator *CuDevice::AllocatorForPointer(void *ptr) {
+  cudaPointerAttributes attributes;
+  CU_SAFE_CALL(cudaPointerGetAttributes(&attributes, ptr));
+  return GetAllocator(attributes.device);
 }
 
 void CuDevice::PrintProfile() {
@@ -560,9 +634,12 @@ void CuDevice::CheckGpuHealth() {
 CuDevice::CuDevice():
     initialized_(false),
     device_id_copy_(-1),
+    thread_device_id_(-1),
+    allocator_(&g_cuda_allocator),
     cublas_handle_(NULL),
     cusparse_handle_(NULL),
-    cusolverdn_handle_(NULL) {
+    cusolverdn_handle_(NULL),
+    cuda_stream_(cudaStreamPerThread) {
 }
 
 CuDevice::~CuDevice() {
@@ -590,6 +667,9 @@ CuDevice::CuDeviceOptions CuDevice::device_options_;
 // define and initialize the static members of the CuDevice object.
 int32 CuDevice::device_id_ = -1;
 bool CuDevice::multi_threaded_ = false;
+bool CuDevice::multi_gpu_ = false;
+std::map<int32, CuMemoryAllocator*> CuDevice::other_allocators_;
+std::mutex CuDevice::allocators_mutex_;
 unordered_map<std::string, double, StringHasher> CuDevice::profile_map_;
 std::mutex CuDevice::profile_mutex_;
 int64 CuDevice::free_memory_at_startup_;
@@ -597,18 +677,115 @@ cudaDeviceProp CuDevice::properties_;
 bool CuDevice::debug_stride_mode_ = false;
 
 
+// Declared extern "C" in cu-kernels-ansi.h.
+extern "C" cudaStream_t cuda_current_stream() {
+  return CuDevice::Instantiate().GetCudaStream();
+}
+
 void SynchronizeGpu() {
   cuda_legacy_noop();
   CU_SAFE_CALL(cudaGetLastError());
 }
 
+void CuDevice::SetCudaStream(cudaStream_t stream) {
+  cuda_stream_ = stream;
+  if (cublas_handle_)
+    CUBLAS_SAFE_CALL(cublasSetStream(cublas_handle_, stream));
+  if (cusparse_handle_)
+    CUSPARSE_SAFE_CALL(cusparseSetStream(cusparse_handle_, stream));
+  if (curand_handle_)
+    CURAND_SAFE_CALL(curandSetStream(curand_handle_, stream));
+#if CUDA_VERSION >= 9010
+  if (cusolverdn_handle_)
+    CUSOLVER_SAFE_CALL(cusolverDnSetStream(cusolverdn_handle_, stream));
+#endif
+}
+
+CuStreamScope::CuStreamScope(cudaStream_t stream) {
+  CuDevice &device = CuDevice::Instantiate();
+  prev_stream_ = device.GetCudaStream();
+  device.SetCudaStream(stream);
+}
+
+CuStreamScope::~CuStreamScope() {
+  CuDevice::Instantiate().SetCudaStream(prev_stream_);
+}
+
+CuTensorOpMathScope::CuTensorOpMathScope(bool enable):
+    restore_(false), prev_math_mode_(0) {
+#if CUDA_VERSION >= 9000
+  if (enable && CuDevice::Instantiate().Enabled()) {
+    cublasMath_t prev_math_mode;
+    CUBLAS_SAFE_CALL(cublasGetMathMode(GetCublasHandle(), &prev_math_mode));
+    if (prev_math_mode != CUBLAS_TENSOR_OP_MATH) {
+      CUBLAS_SAFE_CALL(cublasSetMathMode(GetCublasHandle(),
+                                         CUBLAS_TENSOR_OP_MATH));
+      prev_math_mode_ = static_cast<int>(prev_math_mode);
+      restore_ = true;
+    }
+  }
+#endif
+}
+
+CuTensorOpMathScope::~CuTensorOpMathScope() {
+#if CUDA_VERSION >= 9000
+  if (restore_)
+    CUBLAS_SAFE_CALL(cublasSetMathMode(
+        GetCublasHandle(), static_cast<cublasMath_t>(prev_math_mode_)));
+#endif
+}
+
+CuEvent::CuEvent(): created_(false) { }
+
+CuEvent::~CuEvent() {
+  if (created_)
+    cudaEventDestroy(event_);
+}
+
+void CuEvent::Record() {
+  if (!CuDevice::Instantiate().Enabled())
+    return;
+  if (!created_) {
+    CU_SAFE_CALL(cudaEventCreateWithFlags(&event_, cudaEventDisableTiming));
+    created_ = true;
+  }
+  CU_SAFE_CALL(cudaEventRecord(event_, GetCudaStream()));
+}
+
+void CuEvent::Synchronize() {
+  if (created_)
+    CU_SAFE_CALL(cudaEventSynchronize(event_));
+}
+
+void CuEvent::StreamWait() {
+  if (created_)
+    CU_SAFE_CALL(cudaStreamWaitEvent(GetCudaStream(), event_, 0));
+}
+
 }  // namespace kaldi
 
 #else  // #if HAVE_CUDA == 1
 
+#include "cudamatrix/cu-device.h"
+
 namespace kaldi {
 // SynchronizeGpu() does nothing if we didn't compile for GPU.
 void SynchronizeGpu() { }
+
+CuTensorOpMathScope::CuTensorOpMathScope(bool enable):
+    restore_(false), prev_math_mode_(0) { }
+
+CuTensorOpMathScope::~CuTensorOpMathScope() { }
+
+CuEvent::CuEvent(): created_(false) { }
+
+CuEvent::~CuEvent() { }
+
+void CuEvent::Record() { }
+
+void CuEvent::Synchronize() { }
+
+void CuEvent::StreamWait() { }
 }
 
 #endif  // #if HAVE_CUDA == 1
@@ -91,6 +91,10 @@ class CuDevice {
   }
 
   inline cublasHandle_t GetCublasHandle() { return cublas_handle_; }
+  /// Returns the CUDA stream that the calling thread's CUDA operations are
+  /// queued on: cudaStreamPerThread, unless a CuStreamScope object says
+  /// otherwise.
+  inline cudaStream_t GetCudaStream() { return cuda_stream_; }
   inline cusparseHandle_t GetCusparseHandle() { return cusparse_handle_; }
   inline curandGenerator_t GetCurandHandle() { return curand_handle_; }
   inline cusolverDnHandle_t GetCusolverDnHandle() { 
@@ -114,29 +118,32 @@ class CuDevice {
   // the results of previous allocations to avoid the very large overhead that
   // CUDA's allocation seems to give for some setups.
   inline void* Malloc(size_t size) {
-    return multi_threaded_ ? g_cuda_allocator.MallocLocking(size) :
-        g_cuda_allocator.Malloc(size);
+    return multi_threaded_ ? allocator_->MallocLocking(size) :
+        allocator_->Malloc(size);
   }
 
   inline void* MallocPitch(size_t row_bytes, size_t num_rows, size_t *pitch) {
     if (multi_threaded_) {
-      return g_cuda_allocator.MallocPitchLocking(row_bytes, num_rows, pitch);
+      return allocator_->MallocPitchLocking(row_bytes, num_rows, pitch);
     } else if (debug_stride_mode_) {
       // The pitch bucket size is hardware dependent.
       // It is 512 on K40c with CUDA 7.5
       // "% 8" ensures that any 8 adjacent allocations have different pitches
       // if their original pitches are same in the normal mode.
-      return g_cuda_allocator.MallocPitch(
+      return allocator_->MallocPitch(
           row_bytes + 512 * RandInt(0, 4), num_rows,
           pitch);
     } else {
-      return g_cuda_allocator.MallocPitch(row_bytes, num_rows, pitch);
+      return allocator_->MallocPitch(row_bytes, num_rows, pitch);
     }
   }
 
   inline void Free(void *ptr) {
-    if (multi_threaded_) g_cuda_allocator.FreeLocking(ptr);
-    else g_cuda_allocator.Free(ptr);
+    // With several GPUs, memory may be freed by a thread that uses a different
+    // GPU from the one it was allocated on.
+    if (multi_gpu_) AllocatorForPointer(ptr)->FreeLocking(ptr);
+    else if (multi_threaded_) allocator_->FreeLocking(ptr);
+    else allocator_->Free(ptr);
   }
 
   /// Select a GPU for computation.  You are supposed to call this function just
@@ -159,6 +166,20 @@ class CuDevice {
     return (device_id_ > -1);
   }
 
+  /// For programs that use more than one GPU: makes the calling thread use the
+  /// CUDA device 'device_id' instead of the one selected by SelectGpuId(),
+  /// which must already have been called and have selected a GPU.  This must
+  /// be called before the thread uses the GPU, i.e. before its first call to
+  /// Instantiate().  Each GPU has its own memory allocator, and memory may be
+  /// freed by a thread that uses a different GPU.  Data on different GPUs
+  /// must not be mixed in the same operation, except for copies.
+  static void SelectThreadGpuId(int32 device_id);
+
+  /// Returns the CUDA device used by the calling thread (the one selected by
+  /// SelectGpuId() unless SelectThreadGpuId() was called), or -1 if
+  /// !Enabled().
+  int32 ActiveGpuId() const { return device_id_copy_; }
+
   /// Returns true if either we have no GPU, or we have a GPU
   /// and it supports double precision.
   bool DoublePrecisionSupported();
@@ -166,6 +187,10 @@ class CuDevice {
   /// This function accumulates stats on timing that
   /// are printed out when you call PrintProfile().  However,
   /// it only does something if VerboseLevel() >= 1.
+  /// If tracing is enabled (see class Tracer in base/timer.h), it also
+  /// records a span for the time since 'timer' was set; note, this is the
+  /// time taken on the CPU, e.g. to launch a kernel, as we don't wait for
+  /// the GPU unless VerboseLevel() >= 1.
   void AccuProfile(const char *function_name, const CuTimer &timer);
 
   /// Print some profiling information using KALDI_LOG.
@@ -174,6 +199,12 @@ class CuDevice {
   /// Print some memory-usage information using KALDI_LOG.
   void PrintMemoryUsage() const;
 
+  /// Returns an estimate of the device memory, in bytes, that is still
+  /// available for the calling thread's allocations: the memory cached by its
+  /// allocator but not in use, plus the memory that is free on its GPU.  Other
+  /// threads and processes may of course allocate some of it in the meantime.
+  int64 GetAvailableMemory();
+
   /// The user should call this if the program plans to access the GPU (e.g. via
   /// using class CuMatrix) from more than one thread.  If you fail to call this
   /// for a multi-threaded program, it may occasionally segfault (and also
@@ -237,6 +268,12 @@ class CuDevice {
 
   static CuDeviceOptions device_options_;
 
+  // Returns the allocator for GPU 'device_id', creating it if necessary.
+  static CuMemoryAllocator *GetAllocator(int32 device_id);
+
+  // Returns the allocator for the GPU that 'ptr' was allocated on.
+  static CuMemoryAllocator *AllocatorForPointer(void *ptr);
+
   // Default constructor used to initialize this_thread_device_
   CuDevice();
   CuDevice(CuDevice&); // Disallow.
@@ -289,6 +326,15 @@ class CuDevice {
   // use locks when accessing the allocator and the profiling-related code.
   static bool multi_threaded_;
 
+  // This will be set to true by SelectThreadGpuId() if a thread uses a GPU
+  // other than the one selected by SelectGpuId().
+  static bool multi_gpu_;
+
+  // The allocators of the GPUs other than the one selected by SelectGpuId(),
+  // which uses g_cuda_allocator; guarded by allocators_mutex_.
+  static std::map<int32, CuMemoryAllocator*> other_allocators_;
+  static std::mutex allocators_mutex_;
+
   // The variable profile_map_ will only be used if the verbose level is >= 1;
   // it will accumulate some function-level timing information that is printed
   // out at program end.  This makes things a bit slower as we have to call
@@ -314,24 +360,42 @@ class CuDevice {
   // set up the cublas and cusparse handles.
   bool initialized_;
 
-  // This variable is just a copy of the static variable device_id_.  It's used
-  // to detect when this code is called in the wrong way.
+  // This variable is just a copy of the static variable device_id_, unless
+  // SelectThreadGpuId() was called, in which case it is the GPU selected for
+  // this thread.
   int32 device_id_copy_;
 
+  // If >= 0, the GPU selected by SelectThreadGpuId(), to be used by
+  // Initialize().
+  int32 thread_device_id_;
+
+  // The allocator for this thread's GPU (&g_cuda_allocator unless
+  // SelectThreadGpuId() selected another GPU).
+  CuMemoryAllocator *allocator_;
+
   cublasHandle_t cublas_handle_;
   cusparseHandle_t cusparse_handle_;
   curandGenerator_t curand_handle_;
   cusolverDnHandle_t cusolverdn_handle_;
+
+  // The stream returned by GetCudaStream(); changed by CuStreamScope.
+  cudaStream_t cuda_stream_;
+
+  // Makes the operations of this thread (including those of the cuBLAS,
+  // cuSPARSE, cuRAND and cuSOLVER handles) use 'stream'.  Called by
+  // CuStreamScope.
+  void SetCudaStream(cudaStream_t stream);
+  friend class CuStreamScope;
 }; // class CuDevice
 
 
 // Class CuTimer is a convenience wrapper for class Timer which only
-// sets the time if the verbose level is >= 1.  This helps avoid
-// an unnecessary system call if the verbose level is 0 and you
+// sets the time if the verbose level is >= 1 or tracing is enabled.  This
+// helps avoid an unnecessary system call if the verbose level is 0 and you
 // won't be accumulating the timing stats.
 class CuTimer: public Timer {
  public:
-  CuTimer(): Timer(GetVerboseLevel() >= 1) { }
+  CuTimer(): Timer(GetVerboseLevel() >= 1 || Tracer::Enabled()) { }
 };
 
 // This function is declared as a more convenient way to get the CUDA device handle for use
@@ -353,6 +417,43 @@ inline curandGenerator_t GetCurandHandle() {
   return CuDevice::Instantiate().GetCurandHandle(); 
 }
 
+// The stream that the CUDA operations of the calling thread are queued on.
+inline cudaStream_t GetCudaStream() {
+  return CuDevice::Instantiate().GetCudaStream();
+}
+
+/**
+   While an object of this class exists, all the CUDA operations of the
+   calling thread that go through this library (the kernels and copies of
+   CuMatrix, CuVector and the other cudamatrix classes, and the cuBLAS,
+   cuSPARSE, cuRAND and cuSOLVER calls) are queued on 'stream' instead of on
+   the thread's default stream, cudaStreamPerThread; when it is destroyed
+   the previous stream is restored.  Objects of this class may be nested,
+   and must be destroyed in the reverse order of their creation, by the
+   thread that created them.
+
+   This lets one thread queue independent work, e.g. the copies for one
+   stage of a pipeline and the computation for another, on different
+   streams so that it can overlap on the GPU.  As always with streams, it is
+   the caller's job to order work on different streams that uses the same
+   data, e.g. with cudaEventRecord() and cudaStreamWaitEvent(); note in
+   particular that the synchronizing copies (e.g. CuMatrix::CopyToMat())
+   only wait for the current stream.  The memory allocator takes care of
+   memory freed on one stream and reused on another.
+
+   'stream' must not have been created with cudaStreamNonBlocking, because
+   SynchronizeGpu() (which the allocator relies on) does not synchronize
+   with such streams.
+*/
+class CuStreamScope {
+ public:
+  explicit CuStreamScope(cudaStream_t stream);
+  ~CuStreamScope();
+ private:
+  cudaStream_t prev_stream_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(CuStreamScope);
+};
+
 
 }  // namespace kaldi
 
@@ -381,6 +482,59 @@ namespace kaldi {
 */
 void SynchronizeGpu();
 
+/**
+   While an object of this class exists, the cuBLAS matrix multiplications of
+   the calling thread use the tensor cores (FP16 math, with FP32 accumulation),
+   as if --cuda-use-tensor-cores=true had been given; when it is destroyed the
+   previous setting is restored.  This lets inference code use the faster,
+   less precise math for its own computation only.  It does nothing if
+   'enable' is false, if we did not compile for CUDA, if the GPU is not
+   enabled, or if the CUDA version is older than 9; and devices without tensor
+   cores fall back to normal math.
+*/
+class CuTensorOpMathScope {
+ public:
+  explicit CuTensorOpMathScope(bool enable);
+  ~CuTensorOpMathScope();
+ private:
+  // True if we changed the math mode and have to restore it.
+  bool restore_;
+  // The math mode before we changed it (a cublasMath_t).
+  int prev_math_mode_;
+};
+
+/**
+   A wrapper for a CUDA event, used to find out when work queued on a stream
+   (e.g. the asynchronous copies of CuMatrixBase::CopyToMatAsync()) has
+   finished.  If we did not compile for CUDA or the GPU is not enabled, all
+   the work was done synchronously and the functions do nothing.
+*/
+class CuEvent {
+ public:
+  CuEvent();
+  ~CuEvent();
+
+  /// Records the event on the current stream (GetCudaStream()): it happens
+  /// when the work queued on the stream so far has finished.
+  void Record();
+
+  /// Waits (on the CPU) until the last Record()ed event has happened.
+  void Synchronize();
+
+  /// Makes the work queued on the current stream after this call wait until
+  /// the last Record()ed event has happened.
+  void StreamWait();
+ private:
+#if HAVE_CUDA == 1
+  cudaEvent_t event_;
+#endif
+  // True if the event was created (on the first call to Record()).
+  bool created_;
+  // Disallow copying.
+  CuEvent(const CuEvent &other);
+  CuEvent &operator = (const CuEvent &other);
+};
+
 }   // namespace kaldi
 
 #endif // KALDI_CUDAMATRIX_CU_DEVICE_H_
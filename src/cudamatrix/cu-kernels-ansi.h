@@ -29,6 +29,8 @@
 #include "cudamatrix/cu-matrixdim.h"
 
 #if HAVE_CUDA == 1
+#include <cuda_runtime_api.h>
+
 extern "C" {
 
 // "C" version of the BaseFloat typedef-- this saves us having to write
@@ -799,6 +801,11 @@ void cuda_uncompress_uint8(dim3 Gr, dim3 Bl, BaseFloat *dest,
                           MatrixDim dim, const uint8_t *src,
                           int src_stride, float scale);
 
+// Decompresses the data of a class CompressedMatrix, as returned by its
+// function Data(), to 'dest'.
+void cuda_uncompress_compressed_matrix(dim3 Gr, dim3 Bl, BaseFloat *dest,
+                                       MatrixDim dim, const void *src);
+
 // copies the sub matrix in src[range_start, range_end] to the matrix in dst
 // if src row is outside of the clamped range it will clamp to the specified
 // rows. src and dst cannot overlap.
@@ -828,6 +835,11 @@ void cudaD_batched_copy_mats(int32_t num_mats, int32_t *num_rows,
 // device.
 void cuda_legacy_noop();
 
+// Returns the stream that the kernels above are launched on, i.e.
+// GetCudaStream() (see CuStreamScope in cu-device.h).  Defined in
+// cu-device.cc.
+cudaStream_t cuda_current_stream();
+
 
 } // extern "C"
 
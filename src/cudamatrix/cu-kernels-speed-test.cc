@@ -0,0 +1,434 @@
+// cudamatrix/cu-kernels-speed-test.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cctype>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "cudamatrix/cu-matrix.h"
+#include "cudamatrix/cu-vector.h"
+#include "cudamatrix/cu-array.h"
+
+namespace kaldi {
+
+// The result of timing one operation: the time per call, and the number of
+// floating point operations and of bytes read and written per call, from
+// which we work out the achieved GFLOP/s and GB/s.
+struct KernelSpeedResult {
+  std::string name;
+  double seconds;
+  double flops;
+  double bytes;
+};
+
+// Calls op() repeatedly for at least 'time_in_secs' seconds, after one call
+// to warm up, and returns the time per call in seconds.  We synchronize the
+// GPU after each batch of calls, so that we time the kernels rather than
+// their launches, and double the size of the batches so that the
+// synchronization does not dominate for fast kernels.
+template <class Op>
+double TimeKernel(const Op &op, double time_in_secs) {
+  op();
+  SynchronizeGpu();
+  Timer timer;
+  int64 num_calls = 0;
+  for (int64 batch = 1; ; batch *= 2) {
+    for (int64 i = 0; i < batch; i++)
+      op();
+    SynchronizeGpu();
+    num_calls += batch;
+    if (timer.Elapsed() >= time_in_secs)
+      break;
+  }
+  return timer.Elapsed() / num_calls;
+}
+
+template <typename Real>
+std::string TypeName() {
+  return (sizeof(Real) == 8 ? "<double>" : "<float>");
+}
+
+void AddResult(const std::string &name, double seconds, double flops,
+               double bytes, std::vector<KernelSpeedResult> *results) {
+  KernelSpeedResult result;
+  result.name = name;
+  result.seconds = seconds;
+  result.flops = flops;
+  result.bytes = bytes;
+  results->push_back(result);
+}
+
+// Copying a matrix; this is the reference for the bandwidth we can get.
+template <typename Real>
+void TestCopyFromMat(int32 num_rows, int32 num_cols, double time_in_secs,
+                     std::vector<KernelSpeedResult> *results) {
+  CuMatrix<Real> src(num_rows, num_cols), dest(num_rows, num_cols);
+  src.SetRandn();
+  double seconds = TimeKernel([&]() { dest.CopyFromMat(src); },
+                              time_in_secs);
+  std::ostringstream name;
+  name << "CopyFromMat" << TypeName<Real>() << " " << num_rows << "x"
+       << num_cols;
+  AddResult(name.str(), seconds, 0.0,
+            2.0 * num_rows * num_cols * sizeof(Real), results);
+}
+
+template <typename Real>
+void TestAddMatMat(int32 dim, double time_in_secs,
+                   std::vector<KernelSpeedResult> *results) {
+  CuMatrix<Real> a(dim, dim), b(dim, dim), c(dim, dim);
+  a.SetRandn();
+  b.SetRandn();
+  double seconds = TimeKernel(
+      [&]() { c.AddMatMat(1.0, a, kNoTrans, b, kNoTrans, 0.0); },
+      time_in_secs);
+  std::ostringstream name;
+  name << "AddMatMat" << TypeName<Real>() << " " << dim << "x" << dim << "x"
+       << dim;
+  AddResult(name.str(), seconds, 2.0 * dim * dim * dim,
+            3.0 * dim * dim * sizeof(Real), results);
+}
+
+// 'num_matrices' products of dim x dim matrices, as done by the
+// convolutional and attention components.
+template <typename Real>
+void TestAddMatMatBatched(int32 num_matrices, int32 dim, double time_in_secs,
+                          std::vector<KernelSpeedResult> *results) {
+  CuMatrix<Real> a(num_matrices * dim, dim), b(num_matrices * dim, dim),
+      c(num_matrices * dim, dim);
+  a.SetRandn();
+  b.SetRandn();
+  std::vector<CuSubMatrix<Real>* > a_vec, b_vec, c_vec;
+  for (int32 i = 0; i < num_matrices; i++) {
+    a_vec.push_back(new CuSubMatrix<Real>(a.RowRange(i * dim, dim)));
+    b_vec.push_back(new CuSubMatrix<Real>(b.RowRange(i * dim, dim)));
+    c_vec.push_back(new CuSubMatrix<Real>(c.RowRange(i * dim, dim)));
+  }
+  double seconds = TimeKernel(
+      [&]() { AddMatMatBatched<Real>(1.0, c_vec, a_vec, kNoTrans,
+                                     b_vec, kTrans, 0.0); },
+      time_in_secs);
+  for (int32 i = 0; i < num_matrices; i++) {
+    delete a_vec[i];
+    delete b_vec[i];
+    delete c_vec[i];
+  }
+  std::ostringstream name;
+  name << "AddMatMatBatched" << TypeName<Real>() << " " << num_matrices
+       << "*" << dim << "x" << dim << "x" << dim;
+  AddResult(name.str(), seconds, 2.0 * num_matrices * dim * dim * dim,
+            3.0 * num_matrices * dim * dim * sizeof(Real), results);
+}
+
+// CopyRows() and AddRows() with random indexes, as used by nnet3's kCopyRows
+// and kAddRows commands.
+template <typename Real>
+void TestCopyAndAddRows(int32 num_rows, int32 num_cols, double time_in_secs,
+                        std::vector<KernelSpeedResult> *results) {
+  CuMatrix<Real> src(num_rows, num_cols), dest(num_rows, num_cols);
+  src.SetRandn();
+  std::vector<MatrixIndexT> indexes(num_rows);
+  for (int32 r = 0; r < num_rows; r++)
+    indexes[r] = RandInt(0, num_rows - 1);
+  CuArray<MatrixIndexT> cu_indexes(indexes);
+  double index_bytes = num_rows * sizeof(MatrixIndexT),
+      matrix_bytes = static_cast<double>(num_rows) * num_cols * sizeof(Real);
+
+  double seconds = TimeKernel([&]() { dest.CopyRows(src, cu_indexes); },
+                              time_in_secs);
+  std::ostringstream name;
+  name << "CopyRows" << TypeName<Real>() << " " << num_rows << "x"
+       << num_cols;
+  AddResult(name.str(), seconds, 0.0, 2.0 * matrix_bytes + index_bytes,
+            results);
+
+  seconds = TimeKernel([&]() { dest.AddRows(1.0, src, cu_indexes); },
+                       time_in_secs);
+  name.str("");
+  name << "AddRows" << TypeName<Real>() << " " << num_rows << "x"
+       << num_cols;
+  AddResult(name.str(), seconds, 2.0 * num_rows * num_cols,
+            3.0 * matrix_bytes + index_bytes, results);
+}
+
+// SumColumnRanges() summing ranges of 'range_size' columns, as used by
+// SumBlockComponent and by the statistics-pooling components.
+template <typename Real>
+void TestSumColumnRanges(int32 num_rows, int32 num_cols, int32 range_size,
+                         double time_in_secs,
+                         std::vector<KernelSpeedResult> *results) {
+  int32 num_ranges = num_cols / range_size;
+  CuMatrix<Real> src(num_rows, num_cols), dest(num_rows, num_ranges);
+  src.SetRandn();
+  std::vector<Int32Pair> ranges(num_ranges);
+  for (int32 c = 0; c < num_ranges; c++) {
+    ranges[c].first = c * range_size;
+    ranges[c].second = (c + 1) * range_size;
+  }
+  CuArray<Int32Pair> cu_ranges(ranges);
+  double seconds = TimeKernel(
+      [&]() { dest.SumColumnRanges(src, cu_ranges); }, time_in_secs);
+  std::ostringstream name;
+  name << "SumColumnRanges" << TypeName<Real>() << " " << num_rows << "x"
+       << num_cols << "/" << range_size;
+  AddResult(name.str(), seconds,
+            static_cast<double>(num_rows) * num_cols,
+            (static_cast<double>(num_rows) * (num_cols + num_ranges)) *
+            sizeof(Real) + num_ranges * sizeof(Int32Pair), results);
+}
+
+template <typename Real>
+void TestDiffSoftmax(int32 num_rows, int32 num_cols, double time_in_secs,
+                     std::vector<KernelSpeedResult> *results) {
+  CuMatrix<Real> value(num_rows, num_cols), diff(num_rows, num_cols),
+      deriv(num_rows, num_cols);
+  value.SetRandn();
+  value.SoftMaxPerRow(value);
+  diff.SetRandn();
+  double matrix_bytes = static_cast<double>(num_rows) * num_cols * sizeof(Real);
+  double seconds = TimeKernel(
+      [&]() { deriv.DiffSoftmaxPerRow(value, diff); }, time_in_secs);
+  std::ostringstream name;
+  name << "DiffSoftmaxPerRow" << TypeName<Real>() << " " << num_rows << "x"
+       << num_cols;
+  // For each element: the dot product, then a multiply and a subtract.
+  AddResult(name.str(), seconds, 4.0 * num_rows * num_cols,
+            3.0 * matrix_bytes, results);
+
+  seconds = TimeKernel(
+      [&]() { deriv.DiffLogSoftmaxPerRow(value, diff); }, time_in_secs);
+  name.str("");
+  name << "DiffLogSoftmaxPerRow" << TypeName<Real>() << " " << num_rows
+       << "x" << num_cols;
+  AddResult(name.str(), seconds, 4.0 * num_rows * num_cols,
+            3.0 * matrix_bytes, results);
+}
+
+template <typename Real>
+void RunKernelSpeedTests(double time_in_secs,
+                         std::vector<KernelSpeedResult> *results) {
+  TestCopyFromMat<Real>(4096, 1024, time_in_secs, results);
+  TestAddMatMat<Real>(512, time_in_secs, results);
+  TestAddMatMat<Real>(1024, time_in_secs, results);
+  TestAddMatMatBatched<Real>(256, 32, time_in_secs, results);
+  TestAddMatMatBatched<Real>(64, 128, time_in_secs, results);
+  TestCopyAndAddRows<Real>(8192, 512, time_in_secs, results);
+  TestSumColumnRanges<Real>(1024, 4096, 4, time_in_secs, results);
+  TestSumColumnRanges<Real>(1024, 4096, 64, time_in_secs, results);
+  TestDiffSoftmax<Real>(512, 8192, time_in_secs, results);
+}
+
+// Returns the name of the device we are running on, e.g. "Tesla V100-SXM2-16GB"
+// or "cpu", and sets *peak_bandwidth to its theoretical memory bandwidth in
+// bytes per second (0 if not known, i.e. for the CPU).
+std::string GetDeviceName(double *peak_bandwidth) {
+  *peak_bandwidth = 0.0;
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled()) {
+    int device;
+    CU_SAFE_CALL(cudaGetDevice(&device));
+    cudaDeviceProp properties;
+    CU_SAFE_CALL(cudaGetDeviceProperties(&properties, device));
+    // memoryClockRate is in kHz, and memory does two transfers per clock.
+    *peak_bandwidth = 2.0 * properties.memoryClockRate * 1000.0 *
+        (properties.memoryBusWidth / 8);
+    return properties.name;
+  }
+#endif
+  return "cpu";
+}
+
+// Returns the filename of the baseline for device 'device_name' in directory
+// 'dir': the device name with characters other than letters, digits, '-'
+// and '.' replaced by '_', plus ".json".
+std::string BaselineFilename(const std::string &dir,
+                             const std::string &device_name) {
+  std::string name = device_name;
+  for (size_t i = 0; i < name.size(); i++)
+    if (!isalnum(name[i]) && name[i] != '-' && name[i] != '.')
+      name[i] = '_';
+  return dir + "/" + name + ".json";
+}
+
+// Writes the results as JSON, with one benchmark per line.
+void WriteBaseline(const std::string &filename, const std::string &device_name,
+                   const std::vector<KernelSpeedResult> &results) {
+  std::ofstream os(filename.c_str());
+  if (!os)
+    KALDI_ERR << "Could not open " << filename << " for writing.";
+  os << "{\"device\": \"" << device_name << "\", \"benchmarks\": [\n"
+     << std::setprecision(6);
+  for (size_t i = 0; i < results.size(); i++) {
+    const KernelSpeedResult &r = results[i];
+    os << "  {\"name\": \"" << r.name << "\", \"seconds\": " << r.seconds
+       << ", \"gflops\": " << (r.flops / r.seconds * 1.0e-09)
+       << ", \"gbps\": " << (r.bytes / r.seconds * 1.0e-09) << "}"
+       << (i + 1 < results.size() ? ",\n" : "\n");
+  }
+  os << "]}\n";
+  if (!os)
+    KALDI_ERR << "Error writing " << filename;
+}
+
+// Reads the time per call of each benchmark from a file written by
+// WriteBaseline().  This is not a general JSON parser: it relies on each
+// benchmark being on its own line, as WriteBaseline() writes them.
+void ReadBaseline(const std::string &filename,
+            std::unordered_map<std::string, double> *seconds) {
+  std::ifstream is(filename.c_str());
+  if (!is)
+    KALDI_ERR << "Could not open baseline " << filename
+              << " (use --write-baseline=true to create it).";
+  const std::string name_key = "\"name\": \"", seconds_key = "\"seconds\": ";
+  std::string line;
+  while (std::getline(is, line)) {
+    size_t name_pos = line.find(name_key), seconds_pos = line.find(seconds_key);
+    if (name_pos == std::string::npos || seconds_pos == std::string::npos)
+      continue;
+    name_pos += name_key.size();
+    size_t name_end = line.find('"', name_pos);
+    double value;
+    if (name_end == std::string::npos ||
+        !ConvertStringToReal(line.substr(seconds_pos + seconds_key.size(),
+                                         line.find(',', seconds_pos) -
+                                         seconds_pos - seconds_key.size()),
+                             &value))
+      KALDI_ERR << "Bad line in baseline " << filename << ": " << line;
+    (*seconds)[line.substr(name_pos, name_end - name_pos)] = value;
+  }
+}
+
+}  // namespace kaldi
+
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    const char *usage =
+        "Speed test for the cudamatrix operations that nnet3 training and\n"
+        "decoding spend most of their time in.  For each, prints the time per\n"
+        "call, the GFLOP/s and GB/s achieved, and on a GPU the bandwidth as a\n"
+        "percentage of the device's peak.  With --baseline-dir, compares the\n"
+        "times with those stored for the same device, and fails if any is\n"
+        "slower by more than --tolerance; --write-baseline=true stores the\n"
+        "current times instead.\n"
+        "\n"
+        "Usage: cu-kernels-speed-test [options]\n"
+        " e.g.: cu-kernels-speed-test --baseline-dir=baselines\n";
+    ParseOptions po(usage);
+    std::string use_gpu = "optional", baseline_dir;
+    bool write_baseline = false, test_double = false;
+    BaseFloat tolerance = 0.1, time_in_secs = 0.1;
+    po.Register("use-gpu", &use_gpu, "yes|no|optional|wait");
+    po.Register("baseline-dir", &baseline_dir, "Directory of the baselines, "
+                "one JSON file per device, named after the device.");
+    po.Register("write-baseline", &write_baseline, "If true, write the "
+                "results to the baseline for this device in --baseline-dir "
+                "instead of comparing with it.");
+    po.Register("tolerance", &tolerance, "An operation that is slower than "
+                "its baseline by more than this proportion is a regression.");
+    po.Register("time", &time_in_secs, "Seconds to spend timing each "
+                "operation.");
+    po.Register("double", &test_double, "If true, also test double "
+                "precision.");
+    po.Read(argc, argv);
+    if (po.NumArgs() != 0) {
+      po.PrintUsage();
+      exit(1);
+    }
+    if (write_baseline && baseline_dir.empty())
+      KALDI_ERR << "--write-baseline=true requires --baseline-dir.";
+
+#if HAVE_CUDA == 1
+    CuDevice::Instantiate().SelectGpuId(use_gpu);
+#endif
+    double peak_bandwidth;
+    std::string device_name = GetDeviceName(&peak_bandwidth);
+    std::vector<KernelSpeedResult> results;
+    RunKernelSpeedTests<float>(time_in_secs, &results);
+    if (test_double)
+      RunKernelSpeedTests<double>(time_in_secs, &results);
+
+    std::unordered_map<std::string, double> baseline;
+    if (!baseline_dir.empty() && !write_baseline)
+      ReadBaseline(BaselineFilename(baseline_dir, device_name), &baseline);
+
+    std::ostringstream table;
+    table << "Results for " << device_name;
+    if (peak_bandwidth > 0.0)
+      table << " (peak bandwidth " << (peak_bandwidth * 1.0e-09) << " GB/s)";
+    table << ":\n" << std::left << std::setw(44) << "operation" << std::right
+          << std::setw(12) << "usec/call" << std::setw(10) << "GFLOP/s"
+          << std::setw(10) << "GB/s" << std::setw(10) << "%peak-bw"
+          << std::setw(14) << "vs-baseline" << '\n' << std::fixed;
+    int32 num_regressions = 0;
+    for (size_t i = 0; i < results.size(); i++) {
+      const KernelSpeedResult &r = results[i];
+      double gbps = r.bytes / r.seconds * 1.0e-09;
+      table << std::left << std::setw(44) << r.name << std::right
+            << std::setprecision(1) << std::setw(12) << (r.seconds * 1.0e+06)
+            << std::setw(10) << (r.flops / r.seconds * 1.0e-09)
+            << std::setw(10) << gbps << std::setw(10);
+      if (peak_bandwidth > 0.0)
+        table << (100.0 * r.bytes / r.seconds / peak_bandwidth);
+      else
+        table << "-";
+      std::unordered_map<std::string, double>::const_iterator iter =
+          baseline.find(r.name);
+      if (iter != baseline.end()) {
+        // The ratio of the time to the baseline's: >1 means slower.
+        double ratio = r.seconds / iter->second;
+        table << std::setprecision(2) << std::setw(13) << ratio << "x";
+        if (ratio > 1.0 + tolerance) {
+          table << "  REGRESSION";
+          num_regressions++;
+        }
+      } else {
+        table << std::setw(14) << "-";
+      }
+      table << '\n';
+    }
+    KALDI_LOG << table.str();
+
+    if (write_baseline) {
+      std::string filename = BaselineFilename(baseline_dir, device_name);
+      WriteBaseline(filename, device_name, results);
+      KALDI_LOG << "Wrote baseline to " << filename;
+    }
+#if HAVE_CUDA == 1
+    CuDevice::Instantiate().PrintProfile();
+#endif
+    if (num_regressions > 0) {
+      KALDI_WARN << num_regressions << " operations were more than "
+                 << (tolerance * 100.0) << "% slower than the baseline.";
+      return 1;
+    }
+    KALDI_LOG << "Tests succeeded.";
+    return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
@@ -3614,6 +3614,52 @@ static void _cuda_uncompress(BaseFloat *dest, MatrixDim dim,
   }
 }
 
+// Decompresses the data of a class CompressedMatrix (see
+// matrix/compressed-matrix.h).  The layout assumed here must match that of
+// CompressedMatrix::GlobalHeader and CompressedMatrix::PerColHeader, and the
+// arithmetic is the same as in CompressedMatrix::CopyToMat().
+__global__
+static void _cuda_uncompress_compressed_matrix(BaseFloat *dest, MatrixDim dim,
+                                               const void *src) {
+  int i = blockIdx.x * blockDim.x + threadIdx.x;
+  int j = blockIdx.y * blockDim.y + threadIdx.y;
+  if (i >= dim.cols || j >= dim.rows)
+    return;
+  // The global header is: int32 format; float min_value; float range;
+  // int32 num_rows; int32 num_cols.
+  const int32_cuda *header = reinterpret_cast<const int32_cuda*>(src);
+  int32_cuda format = header[0];
+  float min_value = __int_as_float(header[1]), range = __int_as_float(header[2]);
+  const void *data = header + 5;
+  float f;
+  if (format == 1) {  // kOneByteWithColHeaders
+    // The four percentiles of column i, then the bytes in column-major order.
+    const uint16_t *col_header = reinterpret_cast<const uint16_t*>(data) + 4 * i;
+    float scale = range * 1.52590218966964e-05F,
+        p0 = min_value + scale * col_header[0],
+        p25 = min_value + scale * col_header[1],
+        p75 = min_value + scale * col_header[2],
+        p100 = min_value + scale * col_header[3];
+    uint8_t value = reinterpret_cast<const uint8_t*>(data)[
+        8 * dim.cols + i * dim.rows + j];
+    if (value <= 64)
+      f = p0 + (p25 - p0) * value * (1 / 64.0);
+    else if (value <= 192)
+      f = p25 + (p75 - p25) * (value - 64) * (1 / 128.0);
+    else
+      f = p75 + (p100 - p75) * (value - 192) * (1 / 63.0);
+  } else if (format == 2) {  // kTwoByte
+    float increment = range * (1.0 / 65535.0);
+    f = min_value +
+        reinterpret_cast<const uint16_t*>(data)[j * dim.cols + i] * increment;
+  } else {  // kOneByte
+    float increment = range * (1.0 / 255.0);
+    f = min_value +
+        reinterpret_cast<const uint8_t*>(data)[j * dim.cols + i] * increment;
+  }
+  dest[i + j * dim.stride] = f;
+}
+
 template <typename Real>
 __global__
 void _cuda_mat_copy_range_clamped(
@@ -3698,15 +3744,15 @@ static void _noop_kernel() {
  */
 void cuda_int32_set_const(dim3 Gr, dim3 Bl, int32_cuda* mat, int32_cuda value,
                           MatrixDim d) {
-  _set_const<<<Gr,Bl>>>(mat,value,d);
+  _set_const<<<Gr,Bl, 0, cuda_current_stream()>>>(mat,value,d);
 }
 void cuda_int32_add(dim3 Gr, dim3 Bl, int32_cuda* mat, int32_cuda value,
                     MatrixDim d) {
-  _add<<<Gr,Bl>>>(mat,value,d);
+  _add<<<Gr,Bl, 0, cuda_current_stream()>>>(mat,value,d);
 }
 void cuda_int32_sequence(dim3 Gr, dim3 Bl, int32_cuda* data, int length,
                     int32_cuda base) {
-  _sequence<<<Gr, Bl>>>(data, length, base);
+  _sequence<<<Gr, Bl, 0, cuda_current_stream()>>>(data, length, base);
 }
 
 /*
@@ -3717,156 +3763,164 @@ void cuda_int32_sequence(dim3 Gr, dim3 Bl, int32_cuda* data, int length,
  * CuMatrix
  */
 void cudaF_copy_upp_low(dim3 Gr, dim3 Bl, float* A, MatrixDim dimA) {
-  _copy_upp_low<<<Gr,Bl>>>(A,dimA);}
+  _copy_upp_low<<<Gr,Bl, 0, cuda_current_stream()>>>(A,dimA);}
 void cudaF_copy_low_upp(dim3 Gr, dim3 Bl, float* A, MatrixDim dimA) {
-  _copy_low_upp<<<Gr,Bl>>>(A,dimA);}
+  _copy_low_upp<<<Gr,Bl, 0, cuda_current_stream()>>>(A,dimA);}
 void cudaF_add_diag_vec_mat(dim3 Gr, dim3 Bl, float alpha, float *mat,
                             MatrixDim mat_dim, const float *vec,
                             const float *mat2, int mat2_row_stride,
                             int mat2_col_stride, float beta) {
-  _add_diag_vec_mat<<<Gr,Bl>>>(alpha, mat, mat_dim, vec, mat2, mat2_row_stride,
+  _add_diag_vec_mat<<<Gr,Bl, 0, cuda_current_stream()>>>(alpha, mat, mat_dim,
+      vec, mat2, mat2_row_stride,
       mat2_col_stride, beta);
 }
 
 void cudaF_copy_from_tp_trans(dim3 Gr, dim3 Bl, float* A, const float* B,
                               MatrixDim dmat) {
-  _copy_from_tp_trans<<<Gr,Bl>>>(A,B,dmat);
+  _copy_from_tp_trans<<<Gr,Bl, 0, cuda_current_stream()>>>(A,B,dmat);
 }
 void cudaFD_copy_from_tp_trans(dim3 Gr, dim3 Bl, float* A, const double* B,
                                MatrixDim dmat) {
-  _copy_from_tp_trans<<<Gr,Bl>>>(A,B,dmat);
+  _copy_from_tp_trans<<<Gr,Bl, 0, cuda_current_stream()>>>(A,B,dmat);
 }
 
 void cudaF_copy_from_tp(dim3 Gr, dim3 Bl, float* A, const float* B,
                         MatrixDim dmat) {
-  _copy_from_tp<<<Gr,Bl>>>(A,B,dmat);
+  _copy_from_tp<<<Gr,Bl, 0, cuda_current_stream()>>>(A,B,dmat);
 }
 void cudaFD_copy_from_tp(dim3 Gr, dim3 Bl, float* A, const double* B,
                          MatrixDim dmat) {
-  _copy_from_tp<<<Gr,Bl>>>(A,B,dmat);
+  _copy_from_tp<<<Gr,Bl, 0, cuda_current_stream()>>>(A,B,dmat);
 }
 
 void cudaF_copy_cols(dim3 Gr, dim3 Bl, float* dst, const float* src,
                      const MatrixIndexT_cuda* reorder, MatrixDim dst_dim,
                      int src_stride) {
-  _copy_cols<<<Gr,Bl>>>(dst, src, reorder, dst_dim, src_stride);
+  _copy_cols<<<Gr,Bl, 0, cuda_current_stream()>>>(dst, src, reorder, dst_dim,
+      src_stride);
 }
 
 void cudaF_add_cols(dim3 Gr, dim3 Bl, float* dst, const float* src,
                     const MatrixIndexT_cuda* reorder, MatrixDim dst_dim,
                     int src_stride) {
-  _add_cols<<<Gr,Bl>>>(dst, src, reorder, dst_dim, src_stride);
+  _add_cols<<<Gr,Bl, 0, cuda_current_stream()>>>(dst, src, reorder, dst_dim,
+      src_stride);
 }
 
 void cudaF_copy_rows(dim3 Gr, dim3 Bl, float* dst, const float* src,
                      const MatrixIndexT_cuda* reorder, MatrixDim dst_dim,
                      int src_stride) {
-  _copy_rows<<<Gr,Bl>>>(dst, src, reorder, dst_dim, src_stride);
+  _copy_rows<<<Gr,Bl, 0, cuda_current_stream()>>>(dst, src, reorder, dst_dim,
+      src_stride);
 }
 
 void cudaF_copy_rows_direct(dim3 Gr, dim3 Bl, float* dst,
                             const float* const * src, MatrixDim dst_dim) {
-  _copy_rows<<<Gr,Bl>>>(dst, src, dst_dim);
+  _copy_rows<<<Gr,Bl, 0, cuda_current_stream()>>>(dst, src, dst_dim);
 }
 
 void cudaF_copy_to_rows_direct(dim3 Gr, dim3 Bl, float* const * dst,
                                const float* src, MatrixDim src_dim) {
-  _copy_to_rows<<<Gr,Bl>>>(dst, src, src_dim);
+  _copy_to_rows<<<Gr,Bl, 0, cuda_current_stream()>>>(dst, src, src_dim);
 }
 
 void cudaF_add_rows(dim3 Gr, dim3 Bl, float alpha, float* dst, const float* src,
                     const MatrixIndexT_cuda* reorder, MatrixDim dst_dim,
                     int src_stride) {
-  _add_rows<<<Gr,Bl>>>(alpha, dst, src, reorder, dst_dim, src_stride);
+  _add_rows<<<Gr,Bl, 0, cuda_current_stream()>>>(alpha, dst, src, reorder,
+      dst_dim, src_stride);
 }
 
 void cudaF_mul_rows(dim3 Gr, dim3 Bl, float* dst, const float* src,
                     const MatrixIndexT_cuda* reorder, MatrixDim dst_dim,
                     int src_stride) {
-  _mul_rows<<<Gr,Bl>>>(dst, src, reorder, dst_dim, src_stride);
+  _mul_rows<<<Gr,Bl, 0, cuda_current_stream()>>>(dst, src, reorder, dst_dim,
+      src_stride);
 }
 
 void cudaF_add_rows_direct(dim3 Gr, dim3 Bl, float alpha, float* dst,
                            const float* const * src, MatrixDim dst_dim) {
-  _add_rows<<<Gr,Bl>>>(alpha, dst, src, dst_dim);
+  _add_rows<<<Gr,Bl, 0, cuda_current_stream()>>>(alpha, dst, src, dst_dim);
 }
 
 void cudaF_add_to_rows(dim3 Gr, dim3 Bl, float alpha,
                        float* dst, const float* src, const MatrixIndexT_cuda* reorder,
                        MatrixDim src_dim, int dst_stride) {
-  _add_to_rows<<<Gr,Bl>>>(alpha, dst, src, reorder, src_dim, dst_stride);
+  _add_to_rows<<<Gr,Bl, 0, cuda_current_stream()>>>(alpha, dst, src, reorder,
+      src_dim, dst_stride);
 }
 
 void cudaF_add_to_rows_direct(dim3 Gr, dim3 Bl, float alpha, float* const * dst,
                               const float* src, MatrixDim src_dim) {
-  _add_to_rows<<<Gr,Bl>>>(alpha, dst, src, src_dim);
+  _add_to_rows<<<Gr,Bl, 0, cuda_current_stream()>>>(alpha, dst, src, src_dim);
 }
 
 void cudaF_set_diag(int Gr, int Bl, float* mat, float value, MatrixDim d) {
-  _set_diag<<<Gr,Bl>>>(mat,value,d);
+  _set_diag<<<Gr,Bl, 0, cuda_current_stream()>>>(mat,value,d);
 }
 
 void cudaF_set_diag_packed(int Gr, int Bl, float* mat, float value, int dim) {
-  _set_diag_packed<<<Gr,Bl>>>(mat,value,dim);
+  _set_diag_packed<<<Gr,Bl, 0, cuda_current_stream()>>>(mat,value,dim);
 }
 
 void cudaF_add_diag_packed(int Gr, int Bl, float* mat, float value, int dim) {
-  _add_diag_packed<<<Gr,Bl>>>(mat,value,dim);
+  _add_diag_packed<<<Gr,Bl, 0, cuda_current_stream()>>>(mat,value,dim);
 }
 
 void cudaF_set_const(dim3 Gr, dim3 Bl, float* mat, float value, MatrixDim d) {
-  _set_const<<<Gr,Bl>>>(mat,value,d);
+  _set_const<<<Gr,Bl, 0, cuda_current_stream()>>>(mat,value,d);
 }
 
 void cudaF_set_zero_above_diag(dim3 Gr, dim3 Bl, float* mat, MatrixDim d) {
-  _set_zero_above_diag<<<Gr,Bl>>>(mat, d);
+  _set_zero_above_diag<<<Gr,Bl, 0, cuda_current_stream()>>>(mat, d);
 }
 
 void cudaF_add(dim3 Gr, dim3 Bl, float* mat, float value, MatrixDim d) {
-  _add<<<Gr,Bl>>>(mat,value,d);
+  _add<<<Gr,Bl, 0, cuda_current_stream()>>>(mat,value,d);
 }
 
 void cudaF_scale_diag_packed(int Gr, int Bl, float* mat, float value, int dim) {
-  _scale_diag_packed<<<Gr,Bl>>>(mat,value,dim);
+  _scale_diag_packed<<<Gr,Bl, 0, cuda_current_stream()>>>(mat,value,dim);
 }
 
 void cudaF_scale(dim3 Gr, dim3 Bl, float* mat, float value, MatrixDim d) {
-  _scale<<<Gr,Bl>>>(mat,value,d);
+  _scale<<<Gr,Bl, 0, cuda_current_stream()>>>(mat,value,d);
 }
 
 void cudaF_mul_elements(dim3 Gr, dim3 Bl, float* mat, const float* A,
                         MatrixDim dst_d, int src_stride) {
-  _mul_elements<<<Gr,Bl>>>(mat,A,dst_d,src_stride);
+  _mul_elements<<<Gr,Bl, 0, cuda_current_stream()>>>(mat,A,dst_d,src_stride);
 }
 
 void cudaF_div_elements(dim3 Gr, dim3 Bl, float* mat, const float* A,
                         MatrixDim dst_d, int src_stride) {
-  _div_elements<<<Gr,Bl>>>(mat,A,dst_d,src_stride);
+  _div_elements<<<Gr,Bl, 0, cuda_current_stream()>>>(mat,A,dst_d,src_stride);
 }
 
 void cudaF_max(dim3 Gr, dim3 Bl, float* mat, const float* A, MatrixDim dst_d,
                int src_stride) {
-  _max<<<Gr,Bl>>>(mat,A,dst_d,src_stride);
+  _max<<<Gr,Bl, 0, cuda_current_stream()>>>(mat,A,dst_d,src_stride);
 }
 
 void cudaF_min(dim3 Gr, dim3 Bl, float* mat, const float* other,
                MatrixDim mat_d, int other_stride) {
-  _min<<<Gr,Bl>>>(mat,other,mat_d,other_stride);
+  _min<<<Gr,Bl, 0, cuda_current_stream()>>>(mat,other,mat_d,other_stride);
 }
 
 void cudaF_mul_cols_vec(dim3 Gr, dim3 Bl, float* mat, const float* scale,
                         MatrixDim d) {
-  _mul_cols_vec<<<Gr,Bl>>>(mat,scale,d);
+  _mul_cols_vec<<<Gr,Bl, 0, cuda_current_stream()>>>(mat,scale,d);
 }
 
 void cudaF_mul_rows_vec(dim3 Gr, dim3 Bl, float* mat, const float* scale,
                         MatrixDim d) {
-  _mul_rows_vec<<<Gr,Bl>>>(mat,scale,d);
+  _mul_rows_vec<<<Gr,Bl, 0, cuda_current_stream()>>>(mat,scale,d);
 }
 
 void cudaF_mul_rows_group_mat(dim3 Gr, dim3 Bl, float *y, const float *x,
                               MatrixDim d, int src_stride, int group_size) {
-  _mul_rows_group_mat<<<Gr,Bl>>>(y, x, d, src_stride, group_size);
+  _mul_rows_group_mat<<<Gr,Bl, 0, cuda_current_stream()>>>(y, x, d, src_stride,
+      group_size);
 }
 
 
@@ -3874,28 +3928,31 @@ void cudaF_diff_group_pnorm(dim3 Gr, dim3 Bl, float *id, const float *iv,
                             const float *ov, const float* od, MatrixDim id_dim,
                             int iv_stride, int ov_stride, int od_stride,
                             int group_size, float power) {
-  _diff_group_pnorm<<<Gr, Bl>>>(id, iv, ov, od, id_dim, iv_stride, ov_stride,
+  _diff_group_pnorm<<<Gr, Bl, 0, cuda_current_stream()>>>(id, iv, ov, od,
+      id_dim, iv_stride, ov_stride,
       od_stride, group_size, power);
 }
 
 void cudaF_calc_group_max_deriv(dim3 Gr, dim3 Bl, float *y, const float *x1,
                                 const float *x2, MatrixDim y_dim, int x1_stride,
                                 int x2_stride, int group_size) {
-  _calc_group_max_deriv<<<Gr,Bl>>>(y, x1, x2, y_dim, x1_stride, x2_stride,
+  _calc_group_max_deriv<<<Gr,Bl, 0, cuda_current_stream()>>>(y, x1, x2, y_dim,
+      x1_stride, x2_stride,
       group_size);
 }
 
 void cudaF_div_rows_vec(dim3 Gr, dim3 Bl, float* mat, const float* vec_div,
                         MatrixDim d) {
-  _div_rows_vec<<<Gr,Bl>>>(mat, vec_div, d);
+  _div_rows_vec<<<Gr,Bl, 0, cuda_current_stream()>>>(mat, vec_div, d);
 }
 
 void cudaF_add_mat(dim3 Gr, dim3 Bl, float alpha, const float* src, float* dst,
                    MatrixDim d, int src_stride, int A_trans) {
   if (A_trans) {
-    _add_mat_trans<<<Gr,Bl>>>(alpha,src,dst,d,src_stride);
+    _add_mat_trans<<<Gr,Bl, 0,
+        cuda_current_stream()>>>(alpha,src,dst,d,src_stride);
   } else {
-    _add_mat<<<Gr,Bl>>>(alpha,src,dst,d,src_stride);
+    _add_mat<<<Gr,Bl, 0, cuda_current_stream()>>>(alpha,src,dst,d,src_stride);
   }
 }
 
@@ -3904,46 +3961,52 @@ void cudaF_add_mat_blocks(dim3 Gr, dim3 Bl, float alpha, const float* src,
                           float* dst, MatrixDim d, int src_stride,
                           int A_trans) {
   if (A_trans) {
-    _add_mat_blocks_trans<<<Gr,Bl>>>(alpha, src, num_row_blocks, num_col_blocks,
+    _add_mat_blocks_trans<<<Gr,Bl, 0, cuda_current_stream()>>>(alpha, src,
+        num_row_blocks, num_col_blocks,
         dst, d, src_stride);
   } else {
-    _add_mat_blocks<<<Gr,Bl>>>(alpha, src, num_row_blocks, num_col_blocks, dst,
+    _add_mat_blocks<<<Gr,Bl, 0, cuda_current_stream()>>>(alpha, src,
+        num_row_blocks, num_col_blocks, dst,
         d, src_stride);
   }
 }
 
 void cudaF_add_mat_repeated(dim3 Gr, dim3 Bl, float alpha, const float* src,
                             MatrixDim src_dim, float *dst, MatrixDim dst_dim) {
-  _add_mat_repeated<<<Gr,Bl>>>(alpha, src, src_dim, dst, dst_dim);
+  _add_mat_repeated<<<Gr,Bl, 0, cuda_current_stream()>>>(alpha, src, src_dim,
+      dst, dst_dim);
 }
 
 
 void cudaF_set_mat_mat_div_mat(dim3 Gr, dim3 Bl, const float *A, const float *B,
                                const float *C, float *dst, MatrixDim d,
                                int stride_a, int stride_b, int stride_c) {
-  _set_mat_mat_div_mat<<<Gr,Bl>>>(A,B,C,dst,d, stride_a, stride_b, stride_c);
+  _set_mat_mat_div_mat<<<Gr,Bl, 0, cuda_current_stream()>>>(A,B,C,dst,d,
+      stride_a, stride_b, stride_c);
 }
 
 void cudaF_sy_add_tr2(dim3 Gr, dim3 Bl, float alpha, float beta, const float* T,
                       MatrixDim tdim, float *S, MatrixDim sdim) {
-  _sy_add_tr2<<<Gr,Bl>>>(alpha, beta, T, tdim, S, sdim);
+  _sy_add_tr2<<<Gr,Bl, 0, cuda_current_stream()>>>(alpha, beta, T, tdim, S,
+      sdim);
 }
 
 void cudaF_add_vec_to_cols(dim3 Gr, dim3 Bl, float alpha, const float* col,
                            float beta, float* dst, MatrixDim d) {
-  _add_vec_to_cols<<<Gr,Bl>>>(alpha,col,beta,dst,d);
+  _add_vec_to_cols<<<Gr,Bl, 0, cuda_current_stream()>>>(alpha,col,beta,dst,d);
 }
 
 void cudaF_add_vec_to_rows(dim3 Gr, dim3 Bl, float alpha, const float* row,
                            float beta, float* dst, MatrixDim d) {
-  _add_vec_to_rows<<<Gr,Bl>>>(alpha,row,beta,dst,d);
+  _add_vec_to_rows<<<Gr,Bl, 0, cuda_current_stream()>>>(alpha,row,beta,dst,d);
 }
 
 void cudaF_add_mat_diag_vec(dim3 Gr, dim3 Bl, float alpha, float *mat,
                             MatrixDim mat_dim, const float *mat2,
                             int mat2_row_stride, int mat2_col_stride,
                             const float *vec, float beta) {
-  _add_mat_diag_vec<<<Gr,Bl>>>(alpha, mat, mat_dim, mat2, mat2_row_stride,
+  _add_mat_diag_vec<<<Gr,Bl, 0, cuda_current_stream()>>>(alpha, mat, mat_dim,
+      mat2, mat2_row_stride,
       mat2_col_stride, vec, beta);
 }
 
@@ -3951,14 +4014,15 @@ void cudaF_add_mat_mat_elements(dim3 Gr, dim3 Bl, float *data,
                                 const float *srcA_data, const float *srcB_data,
                                 MatrixDim dim, int srcA_stride, int srcB_stride,
                                 float alpha, float beta) {
-  _add_mat_mat_elements<<<Gr, Bl>>>(data, srcA_data, srcB_data, dim,
+  _add_mat_mat_elements<<<Gr, Bl, 0, cuda_current_stream()>>>(data, srcA_data,
+      srcB_data, dim,
       srcA_stride, srcB_stride, alpha, beta);
 }
 
 // CURRENTLY UNUSED...
 void cudaF_apply_mask(dim3 Gr, dim3 Bl, float* mat, const char* mask,
                       MatrixDim dmat, MatrixDim dmask) {
-  _apply_mask<<<Gr,Bl>>>(mat,mask,dmat,dmask);
+  _apply_mask<<<Gr,Bl, 0, cuda_current_stream()>>>(mat,mask,dmat,dmask);
 }
 
 /*
@@ -3967,85 +4031,91 @@ void cudaF_apply_mask(dim3 Gr, dim3 Bl, float* mat, const char* mask,
 
 void cudaF_max_mat_cols(int Gr, int Bl, float* result, const float* mat,
                         const MatrixDim d) {
-  _transform_reduce_mat_cols<<<Gr,Bl>>>(result,mat,d,
+  _transform_reduce_mat_cols<<<Gr,Bl, 0, cuda_current_stream()>>>(result,mat,d,
       TransReduceOp<MAX,float>());
 }
 void cudaF_min_mat_cols(int Gr, int Bl, float* result, const float* mat,
                         const MatrixDim d) {
-  _transform_reduce_mat_cols<<<Gr,Bl>>>(result,mat,d,
+  _transform_reduce_mat_cols<<<Gr,Bl, 0, cuda_current_stream()>>>(result,mat,d,
       TransReduceOp<MIN,float>());
 }
 void cudaF_sum_mat_cols(int Gr, int Bl, float* result, const float* mat,
                         const MatrixDim d) {
-  _transform_reduce_mat_cols<<<Gr,Bl>>>(result,mat,d,
+  _transform_reduce_mat_cols<<<Gr,Bl, 0, cuda_current_stream()>>>(result,mat,d,
       TransReduceOp<SUM,float>());
 }
 void cudaF_add_row_sum_mat(int Gr, int Bl, float* result, const float* mat,
                            const MatrixDim d, const float alpha,
                            const float beta) {
-  _transform_reduce_mat_rows<<<Gr, Bl>>>(result, mat, d,
+  _transform_reduce_mat_rows<<<Gr, Bl, 0, cuda_current_stream()>>>(result, mat,
+      d,
       TransReduceOp<SUMAB, float>(alpha, beta));
 }
 void cudaF_add_col_sum_mat(int Gr, int Bl, float* result, const float* mat,
                            const MatrixDim d, const float alpha,
                            const float beta) {
-  _transform_reduce_mat_cols<<<Gr, Bl>>>(result, mat, d,
+  _transform_reduce_mat_cols<<<Gr, Bl, 0, cuda_current_stream()>>>(result, mat,
+      d,
       TransReduceOp<SUMAB, float>(alpha, beta));
 }
 
 
 void cudaF_replace_value(int Gr, int Bl, float *v, int dim, float orig,
                          float changed) {
-  _replace_value<<<Gr,Bl>>>(v, dim, orig, changed);
+  _replace_value<<<Gr,Bl, 0, cuda_current_stream()>>>(v, dim, orig, changed);
 }
 
 void cudaF_set_bias_params(int Gr, int Bl, float* v, const float* a,
                            float param_1, float param_2, float param_3,
                            int* flag, int dim) {
-  _set_bias_params<<<Gr,Bl>>>(v,a,param_1,param_2,param_3,flag,dim);
+  _set_bias_params<<<Gr,Bl, 0,
+      cuda_current_stream()>>>(v,a,param_1,param_2,param_3,flag,dim);
 }
 
 void cublas_copy_kaldi_fd(int Gr, int Bl, int n, const float* x, int incx,
                           double* y, int incy) {
-  _cublas_copy_kaldi<<<Gr,Bl>>>(n, x, incx, y, incy);
+  _cublas_copy_kaldi<<<Gr,Bl, 0, cuda_current_stream()>>>(n, x, incx, y, incy);
 }
 
 void cublas_copy_kaldi_df(int Gr, int Bl, int n, const double* x, int incx,
                           float* y, int incy) {
-  _cublas_copy_kaldi<<<Gr,Bl>>>(n, x, incx, y, incy);
+  _cublas_copy_kaldi<<<Gr,Bl, 0, cuda_current_stream()>>>(n, x, incx, y, incy);
 }
 
 void cudaF_vec_mul_elements(int Gr, int Bl, float* v, const float* a, int dim) {
-  _vec_mul_elements<<<Gr,Bl>>>(v, a, dim);
+  _vec_mul_elements<<<Gr,Bl, 0, cuda_current_stream()>>>(v, a, dim);
 }
 
 void cudaF_vec_min(int Gr, int Bl, const float* v, float* value, int dim,
                    int inc) {
-  _vec_transform_reduce<<<Gr,Bl>>>(v, value, dim, inc,
+  _vec_transform_reduce<<<Gr,Bl, 0, cuda_current_stream()>>>(v, value, dim, inc,
       TransReduceOp<MIN, float>());
 }
 
 void cudaF_vec_max(int Gr, int Bl, const float* v, float* value, int dim,
                    int inc) {
-  _vec_transform_reduce<<<Gr,Bl>>>(v, value, dim, inc,
+  _vec_transform_reduce<<<Gr,Bl, 0, cuda_current_stream()>>>(v, value, dim, inc,
       TransReduceOp<MAX, float>());
 }
 
 void cudaF_trace_mat_mat_trans(dim3 Gr, dim3 Bl, const float* A, const float* B,
                                MatrixDim dA, int B_stride, float* value) {
-  _trace_mat_mat_trans<<<Gr,Bl>>>(A,B,dA,B_stride,value);
+  _trace_mat_mat_trans<<<Gr,Bl, 0,
+      cuda_current_stream()>>>(A,B,dA,B_stride,value);
 }
 
 void cudaF_trace_mat_mat(dim3 Gr, dim3 Bl, const float* A, const float* B,
                          MatrixDim dA, int B_stride, float* value) {
-  _trace_mat_mat<32> <<<Gr,Bl>>>(A,B,dA,B_stride,value);
+  _trace_mat_mat<32> <<<Gr,Bl, 0,
+      cuda_current_stream()>>>(A,B,dA,B_stride,value);
 }
 
 void cudaF_add_diag_mat_mat_MNT(int Gr, int Bl, const float alpha,
                                 const float* M, const MatrixDim dim_M,
                                 const float* N, const int stride_N,
                                 const float beta, float* v) {
-  _add_diag_mat_mat_MNT<<<Gr,Bl>>>(alpha,M,dim_M,N,stride_N,beta,v);
+  _add_diag_mat_mat_MNT<<<Gr,Bl, 0,
+      cuda_current_stream()>>>(alpha,M,dim_M,N,stride_N,beta,v);
 }
 
 void cudaF_add_diag_mat_mat_MTN(dim3 Gr, dim3 Bl, const float alpha,
@@ -4054,10 +4124,12 @@ void cudaF_add_diag_mat_mat_MTN(dim3 Gr, dim3 Bl, const float alpha,
                                 const float beta, float* v,
                                 const int stride_v) {
   if (Bl.x == 16) {
-    _add_diag_mat_mat_MTN<16> <<<Gr, Bl>>>(alpha, M, stride_M, N, dim_N, beta,
+    _add_diag_mat_mat_MTN<16> <<<Gr, Bl, 0, cuda_current_stream()>>>(alpha, M,
+        stride_M, N, dim_N, beta,
                                            v, stride_v);
   } else if (Bl.x == 32) {
-    _add_diag_mat_mat_MTN<32> <<<Gr, Bl>>>(alpha, M, stride_M, N, dim_N, beta,
+    _add_diag_mat_mat_MTN<32> <<<Gr, Bl, 0, cuda_current_stream()>>>(alpha, M,
+        stride_M, N, dim_N, beta,
                                            v, stride_v);
   }
 }
@@ -4067,85 +4139,92 @@ void cudaF_add_diag_mat_mat_MN(dim3 Gr, dim3 Bl, const float alpha,
                                const float* N, const MatrixDim dim_N,
                                const float beta, float* v) {
   if (Bl.x == 16) {
-    _add_diag_mat_mat_MN<16> <<<Gr,Bl>>>(alpha,M,stride_M,N,dim_N,beta,v);
+    _add_diag_mat_mat_MN<16> <<<Gr,Bl, 0,
+        cuda_current_stream()>>>(alpha,M,stride_M,N,dim_N,beta,v);
   } else if (Bl.x==32) {
-    _add_diag_mat_mat_MN<32><<<Gr,Bl>>>(alpha,M,stride_M,N,dim_N,beta,v);
+    _add_diag_mat_mat_MN<32><<<Gr,Bl, 0,
+        cuda_current_stream()>>>(alpha,M,stride_M,N,dim_N,beta,v);
   }
 }
 
 void cudaF_add_vec_vec(int Gr, int Bl, float alpha, float* v, const float* x,
                        const float* y, float beta, int dim) {
-  _add_vec_vec<<<Gr,Bl>>>(alpha,v,x,y,beta,dim);
+  _add_vec_vec<<<Gr,Bl, 0, cuda_current_stream()>>>(alpha,v,x,y,beta,dim);
 }
 
 void cudaF_vec_sum(int Gr, int Bl, float* v, float* value, int dim, int inc) {
-  _vec_transform_reduce<<<Gr,Bl>>>(v, value, dim, inc,
+  _vec_transform_reduce<<<Gr,Bl, 0, cuda_current_stream()>>>(v, value, dim, inc,
       TransReduceOp<SUM, float>());
 }
 
 void cudaF_matrix_add_elements(dim3 Gr, dim3 Bl, float *data, MatrixDim dim,
                                float alpha, MatrixElement<float>* x,
                                int num_elements) {
-  _cuda_matrix_add_elements<<<Gr, Bl>>>(data, dim, alpha, x, num_elements);
+  _cuda_matrix_add_elements<<<Gr, Bl, 0, cuda_current_stream()>>>(data, dim,
+      alpha, x, num_elements);
 }
 
 void cudaF_matrix_add_indexed_values(dim3 Gr, dim3 Bl, MatrixDim dim,
                                      float alpha, const Int32Pair* indices,
                                      const float* x, int s, float* data) {
-  _cuda_matrix_add_indexed_values<<<Gr, Bl>>>(dim, alpha, indices, x, s, data);
+  _cuda_matrix_add_indexed_values<<<Gr, Bl, 0, cuda_current_stream()>>>(dim,
+      alpha, indices, x, s, data);
 }
 
 void cudaF_matrix_add_to_elements(dim3 Gr, dim3 Bl, float alpha,
                                   float* mat, MatrixDim dim,
                                   const MatrixIndexT_cuda* elements) {
-  _cuda_matrix_add_to_elements<<<Gr, Bl>>>(alpha, mat, dim, elements);
+  _cuda_matrix_add_to_elements<<<Gr, Bl, 0, cuda_current_stream()>>>(alpha,
+      mat, dim, elements);
 }
 
 void cudaF_vector_copy_elements(dim3 Gr, dim3 Bl, float *data, int dim,
                                 const float *src_mat, int mat_stride,
                                 bool transpose,
                                 const MatrixIndexT_cuda* elements) {
-  _cuda_vector_copy_elements<<<Gr, Bl>>>(data, dim, src_mat, mat_stride,
+  _cuda_vector_copy_elements<<<Gr, Bl, 0, cuda_current_stream()>>>(data, dim,
+      src_mat, mat_stride,
                                          transpose, elements);
 }
 
 void cudaF_comp_obj_deriv(dim3 Gr, dim3 Bl, MatrixElement<float>* x, int s,
                           const float* z, MatrixDim d, float* z2, MatrixDim d2,
                           float* t) {
-  _cuda_comp_obj_deriv<<<Gr,Bl>>>(x,s,z,d,z2,d2,t);
+  _cuda_comp_obj_deriv<<<Gr,Bl, 0, cuda_current_stream()>>>(x,s,z,d,z2,d2,t);
 }
 
 void cudaD_comp_obj_deriv(dim3 Gr, dim3 Bl, MatrixElement<double>* x, int s,
                           const double* z, MatrixDim d, double* z2,
                           MatrixDim d2, double* t) {
-  _cuda_comp_obj_deriv<<<Gr,Bl>>>(x,s,z,d,z2,d2,t);
+  _cuda_comp_obj_deriv<<<Gr,Bl, 0, cuda_current_stream()>>>(x,s,z,d,z2,d2,t);
 }
 
 void cudaF_vec_copy_diag_from_packed(int Gr, int Bl, float *dst,
                                      const float *src, int dim) {
-  _vec_copy_diag_from_packed<<<Gr,Bl>>>(dst,src,dim);
+  _vec_copy_diag_from_packed<<<Gr,Bl, 0, cuda_current_stream()>>>(dst,src,dim);
 }
 
 void cudaF_vec_apply_floor(int Gr, int Bl, float* v, float floor_val,
                            float *count, int dim) {
-  _vec_apply_floor<<<Gr,Bl>>>(v,floor_val,count,dim);
+  _vec_apply_floor<<<Gr,Bl, 0, cuda_current_stream()>>>(v,floor_val,count,dim);
 }
 
 void cudaF_vec_apply_ceiling(int Gr, int Bl, float* v, float ceiling_val,
                              float *count, int dim) {
-  _vec_apply_ceiling<<<Gr,Bl>>>(v, ceiling_val,count,dim);
+  _vec_apply_ceiling<<<Gr,Bl, 0, cuda_current_stream()>>>(v,
+      ceiling_val,count,dim);
 }
 
 void cudaF_vec_apply_exp(int Gr, int Bl, float* v, int dim) {
-  _vec_apply_exp<<<Gr,Bl>>>(v,dim);
+  _vec_apply_exp<<<Gr,Bl, 0, cuda_current_stream()>>>(v,dim);
 }
 
 void cudaF_vec_apply_log(int Gr, int Bl, float* v, float* flag, int dim) {
-  _vec_apply_log<<<Gr,Bl>>>(v,flag,dim);
+  _vec_apply_log<<<Gr,Bl, 0, cuda_current_stream()>>>(v,flag,dim);
 }
 
 void cudaF_invert_elements(dim3 Gr, dim3 Bl, float* data, MatrixDim d) {
-  _invert_elements<<<Gr,Bl>>>(data, d);
+  _invert_elements<<<Gr,Bl, 0, cuda_current_stream()>>>(data, d);
 }
 
 void cudaF_add_mat_blockmat(dim3 Gr, dim3 Bl, float *data, MatrixDim d,
@@ -4155,10 +4234,12 @@ void cudaF_add_mat_blockmat(dim3 Gr, dim3 Bl, float *data, MatrixDim d,
                             int B_num_blocks, float alpha, float beta,
                             int B_trans) {
   if (B_trans) {
-    _add_mat_blockmat_trans<<<Gr,Bl>>>(data, d, Adata, A_num_rows, A_num_cols,
+    _add_mat_blockmat_trans<<<Gr,Bl, 0, cuda_current_stream()>>>(data, d,
+        Adata, A_num_rows, A_num_cols,
         A_row_stride, A_col_stride, B_cu_data, B_num_blocks, alpha, beta);
   } else {
-    _add_mat_blockmat<<<Gr,Bl>>>(data, d, Adata, A_num_rows, A_num_cols,
+    _add_mat_blockmat<<<Gr,Bl, 0, cuda_current_stream()>>>(data, d, Adata,
+        A_num_rows, A_num_cols,
         A_row_stride, A_col_stride, B_cu_data, B_num_blocks, alpha, beta);
 
   }
@@ -4169,7 +4250,8 @@ void cudaF_block_add_mat_mat(dim3 Gr, dim3 Bl, CuBlockMatrixData *B_cu_data,
                              int C_num_cols, int C_row_stride, int C_col_stride,
                              const float *D_data, int D_row_stride,
                              int D_col_stride, float alpha, float beta) {
-  _block_add_mat_mat<<<Gr,Bl>>>(B_cu_data, num_blocks, C_data, C_num_cols,
+  _block_add_mat_mat<<<Gr,Bl, 0, cuda_current_stream()>>>(B_cu_data,
+      num_blocks, C_data, C_num_cols,
       C_row_stride, C_col_stride, D_data, D_row_stride, D_col_stride, alpha,
       beta);
 }
@@ -4179,247 +4261,276 @@ void cudaF_block_add_mat_mat(dim3 Gr, dim3 Bl, CuBlockMatrixData *B_cu_data,
  */
 void cudaF_soft_hinge(dim3 Gr, dim3 Bl, float* y, const float* x, MatrixDim d,
                       int src_stride) {
-  _soft_hinge<<<Gr,Bl>>>(y, x, d, src_stride);
+  _soft_hinge<<<Gr,Bl, 0, cuda_current_stream()>>>(y, x, d, src_stride);
 }
 
 void cudaF_group_pnorm(dim3 Gr, dim3 Bl, float *y, const float *x, MatrixDim d,
                        int src_stride, int group_size, float power) {
-  _group_pnorm<<<Gr,Bl>>>(y, x, d, src_stride, group_size, power);
+  _group_pnorm<<<Gr,Bl, 0, cuda_current_stream()>>>(y, x, d, src_stride,
+      group_size, power);
 }
 
 void cudaF_group_spec_pnorm(dim3 Gr, dim3 Bl, float* y, const float* x,
                             MatrixDim d, int src_stride, int group_size,
                             float power) {
   if (power == float(0)) {
-    _group_transform_reduce<<<Gr, Bl>>>(y, x, d, src_stride, group_size,
+    _group_transform_reduce<<<Gr, Bl, 0, cuda_current_stream()>>>(y, x, d,
+        src_stride, group_size,
         TransReduceOp<L0NORM, float>());
   } else if (power == float(1)) {
-    _group_transform_reduce<<<Gr, Bl>>>(y, x, d, src_stride, group_size,
+    _group_transform_reduce<<<Gr, Bl, 0, cuda_current_stream()>>>(y, x, d,
+        src_stride, group_size,
         TransReduceOp<L1NORM, float>());
   } else if (power == float(2)) {
-    _group_transform_reduce<<<Gr, Bl>>>(y, x, d, src_stride, group_size,
+    _group_transform_reduce<<<Gr, Bl, 0, cuda_current_stream()>>>(y, x, d,
+        src_stride, group_size,
         TransReduceOp<L2NORM, float>());
   } else if (power == std::numeric_limits<float>::infinity()) {
-    _group_transform_reduce<<<Gr, Bl>>>(y, x, d, src_stride, group_size,
+    _group_transform_reduce<<<Gr, Bl, 0, cuda_current_stream()>>>(y, x, d,
+        src_stride, group_size,
         TransReduceOp<LINFNORM, float>());
   } else {
-    _group_transform_reduce<<<Gr, Bl>>>(y, x, d, src_stride, group_size,
+    _group_transform_reduce<<<Gr, Bl, 0, cuda_current_stream()>>>(y, x, d,
+        src_stride, group_size,
         TransReduceOp<LPNORM, float>(power));
   }
 }
 
 void cudaF_group_max(dim3 Gr, dim3 Bl, float *y, const float *x, MatrixDim d,
                      int src_stride, int group_size) {
-  _group_transform_reduce<<<Gr,Bl>>>(y, x, d, src_stride, group_size,
+  _group_transform_reduce<<<Gr,Bl, 0, cuda_current_stream()>>>(y, x, d,
+      src_stride, group_size,
       TransReduceOp<MAX, float>());
 }
 
 void cudaF_sigmoid(dim3 Gr, dim3 Bl, float* y, const float* x, MatrixDim d,
                    int src_stride) {
-  _sigmoid<<<Gr,Bl>>>(y, x, d, src_stride);
+  _sigmoid<<<Gr,Bl, 0, cuda_current_stream()>>>(y, x, d, src_stride);
 }
 
 void cudaF_diff_sigmoid(dim3 Gr, dim3 Bl, float* eout, const float* e,
                         const float* y, MatrixDim d, int e_stride,
                         int y_stride) {
-  _diff_sigmoid<<<Gr,Bl>>>(eout, e, y, d, e_stride, y_stride);
+  _diff_sigmoid<<<Gr,Bl, 0, cuda_current_stream()>>>(eout, e, y, d, e_stride,
+      y_stride);
 }
 
 void cudaF_tanh(dim3 Gr, dim3 Bl, float* y, const float* x, MatrixDim d,
                 int src_stride) {
-  _tanh<<<Gr,Bl>>>(y, x, d, src_stride);
+  _tanh<<<Gr,Bl, 0, cuda_current_stream()>>>(y, x, d, src_stride);
 }
 
 void cudaF_diff_tanh(dim3 Gr, dim3 Bl, float* eout, const float* e,
                      const float* y, MatrixDim d, int e_stride, int y_stride) {
-  _diff_tanh<<<Gr,Bl>>>(eout, e, y, d, e_stride, y_stride);
+  _diff_tanh<<<Gr,Bl, 0, cuda_current_stream()>>>(eout, e, y, d, e_stride,
+      y_stride);
 }
 
 void cudaF_ensure_nonzero(dim3 Gr, dim3 Bl, const float *x, MatrixDim d,
                           float epsilon, int y_stride, float *y) {
-  _ensure_nonzero<<<Gr,Bl>>>(x, d, epsilon, y_stride, y);
+  _ensure_nonzero<<<Gr,Bl, 0, cuda_current_stream()>>>(x, d, epsilon, y_stride,
+      y);
 }
 
 
 void cudaF_parametric_relu(dim3 Gr, dim3 Bl, float* y, const float* x,
                            MatrixDim d, int src_stride,
                            const float* a, const float* b) {
-  _parametric_relu<<<Gr,Bl>>>(y, x, d, src_stride, a, b);
+  _parametric_relu<<<Gr,Bl, 0, cuda_current_stream()>>>(y, x, d, src_stride, a,
+      b);
 }
 
 void cudaF_diff_parametric_relu(dim3 Gr, dim3 Bl, float* eout, const float* e,
                                 const float* y, MatrixDim d, int e_stride,
                                 int y_stride, const float* a, const float* b) {
-  _diff_parametric_relu<<<Gr,Bl>>>(eout, e, y, d, e_stride, y_stride, a, b);
+  _diff_parametric_relu<<<Gr,Bl, 0, cuda_current_stream()>>>(eout, e, y, d,
+      e_stride, y_stride, a, b);
 }
 
 void cudaF_heaviside(dim3 Gr, dim3 Bl, float* y, const float* x, MatrixDim d,
                      int src_stride) {
-  _heaviside<<<Gr,Bl>>>(y, x, d, src_stride);
+  _heaviside<<<Gr,Bl, 0, cuda_current_stream()>>>(y, x, d, src_stride);
 }
 
 void cudaF_exp(dim3 Gr, dim3 Bl, float* y, const float* x, MatrixDim d,
 	       int src_stride) {
-  _exp<<<Gr,Bl>>>(y, x, d, src_stride);
+  _exp<<<Gr,Bl, 0, cuda_current_stream()>>>(y, x, d, src_stride);
 }
 
 void cudaF_pow(dim3 Gr, dim3 Bl, float* y, const float* x, float power, MatrixDim d,
 	       int src_stride) {
-  _pow<<<Gr,Bl>>>(y, x, power, d, src_stride);
+  _pow<<<Gr,Bl, 0, cuda_current_stream()>>>(y, x, power, d, src_stride);
 }
 
 void cudaF_ceiling(dim3 Gr, dim3 Bl, float* y, const float* x, float ceiling_val,
 		   MatrixDim d, int src_stride) {
-  _ceiling<<<Gr,Bl>>>(y, x, ceiling_val, d, src_stride);
+  _ceiling<<<Gr,Bl, 0, cuda_current_stream()>>>(y, x, ceiling_val, d,
+      src_stride);
 }
 
 void cudaF_floor(dim3 Gr, dim3 Bl, float* y, const float* x, float floor_val,
 		 MatrixDim d, int src_stride) {
-  _floor<<<Gr,Bl>>>(y, x, floor_val, d, src_stride);
+  _floor<<<Gr,Bl, 0, cuda_current_stream()>>>(y, x, floor_val, d, src_stride);
 }
 
 void cudaF_exp_limited(dim3 Gr, dim3 Bl, float* y, const float* x,
 		       float lower_limit, float upper_limit, MatrixDim d, int src_stride) {
-  _exp_limited<<<Gr,Bl>>>(y, x, lower_limit, upper_limit, d, src_stride);
+  _exp_limited<<<Gr,Bl, 0, cuda_current_stream()>>>(y, x, lower_limit,
+      upper_limit, d, src_stride);
 }
 
 void cudaF_exp_special(dim3 Gr, dim3 Bl, float* y, const float* x, MatrixDim d,
 		       int src_stride) {
-  _exp_special<<<Gr, Bl>>>(y, x, d, src_stride);
+  _exp_special<<<Gr, Bl, 0, cuda_current_stream()>>>(y, x, d, src_stride);
 }
 
 void cudaF_log(dim3 Gr, dim3 Bl, float* y, const float* x, MatrixDim d, int src_stride) {
-  _log<<<Gr,Bl>>>(y, x, d, src_stride);
+  _log<<<Gr,Bl, 0, cuda_current_stream()>>>(y, x, d, src_stride);
 }
 
 void cudaF_pow_abs(dim3 Gr, dim3 Bl, float* y, const float* x, float power,
 		   bool include_sign, MatrixDim d, int src_stride) {
-  _pow_abs<<<Gr,Bl>>>(y, x, power, include_sign, d, src_stride);
+  _pow_abs<<<Gr,Bl, 0, cuda_current_stream()>>>(y, x, power, include_sign, d,
+      src_stride);
 }
 
 void cudaF_softmax_reduce(size_t Gr, size_t Bl, float* y, const float* x,
                           MatrixDim d, int src_stride) {
-  _softmax_reduce<<<Gr,Bl>>>(y, x, d, src_stride);
+  _softmax_reduce<<<Gr,Bl, 0, cuda_current_stream()>>>(y, x, d, src_stride);
 }
 
 void cudaF_log_softmax_reduce(size_t Gr, size_t Bl, float* y, const float* x,
                               MatrixDim y_dim, int x_stride) {
-  _log_softmax_reduce<<<Gr,Bl>>>(y, x, y_dim, x_stride);
+  _log_softmax_reduce<<<Gr,Bl, 0, cuda_current_stream()>>>(y, x, y_dim,
+      x_stride);
 }
 
 void cudaF_splice(dim3 Gr, dim3 Bl, float* y, const float* x,
                   const int32_cuda* off, MatrixDim d_out, MatrixDim d_in) {
-  _splice<<<Gr,Bl>>>(y,x,off,d_out,d_in);
+  _splice<<<Gr,Bl, 0, cuda_current_stream()>>>(y,x,off,d_out,d_in);
 }
 
 void cudaF_normalize_per_row(size_t Gr, size_t Bl, float *y, int y_stride,
                              const float *x, MatrixDim x_d, float target_rms,
                              bool add_log_stddev) {
-  _normalize_per_row<<<Gr, Bl>>>(y, y_stride, x, x_d, target_rms, add_log_stddev);
+  _normalize_per_row<<<Gr, Bl, 0, cuda_current_stream()>>>(y, y_stride, x, x_d,
+      target_rms, add_log_stddev);
 }
 
 void cudaF_one(int Gr, int Bl, float* x, int dim) {
-  _one<<<Gr,Bl>>>(x,dim);
+  _one<<<Gr,Bl, 0, cuda_current_stream()>>>(x,dim);
 }
 
 void cudaF_take_mean(dim3 Gr, dim3 Bl, const float* x, float* y,
                      MatrixDim d_in) {
-  _take_mean<<<Gr,Bl>>>(x,y,d_in);
+  _take_mean<<<Gr,Bl, 0, cuda_current_stream()>>>(x,y,d_in);
 }
 
 void cudaF_take_lower(dim3 Gr, dim3 Bl, const float* x, float* y,
                       MatrixDim d_in) {
-  _take_lower<<<Gr,Bl>>>(x,y,d_in);
+  _take_lower<<<Gr,Bl, 0, cuda_current_stream()>>>(x,y,d_in);
 }
 
 void cudaF_take_upper(dim3 Gr, dim3 Bl, const float* x, float* y,
                       MatrixDim d_in) {
-  _take_upper<<<Gr,Bl>>>(x,y,d_in);
+  _take_upper<<<Gr,Bl, 0, cuda_current_stream()>>>(x,y,d_in);
 }
 
 void cudaF_copy_from_sp(dim3 Gr, dim3 Bl, const float* x, float* y,
                         MatrixDim dim) {
-  _copy_from_sp<<<Gr,Bl>>>(x, y, dim);
+  _copy_from_sp<<<Gr,Bl, 0, cuda_current_stream()>>>(x, y, dim);
 }
 
 void cudaF_copy(dim3 Gr, dim3 Bl, float* y, const float* x,
                 const int32_cuda* copy_from, MatrixDim d_out, MatrixDim d_in) {
-  _copy<<<Gr,Bl>>>(y,x,copy_from,d_out,d_in);
+  _copy<<<Gr,Bl, 0, cuda_current_stream()>>>(y,x,copy_from,d_out,d_in);
 }
 
 void cudaF_randomize(dim3 Gr, dim3 Bl, float* y, const float* x,
                      const int32_cuda* copy_from, MatrixDim d_out,
                      MatrixDim d_in) {
-  _randomize<<<Gr,Bl>>>(y,x,copy_from,d_out,d_in);
+  _randomize<<<Gr,Bl, 0, cuda_current_stream()>>>(y,x,copy_from,d_out,d_in);
 }
 
 void cudaF_regularize_l1(dim3 Gr, dim3 Bl, float* wei, float* grad, float l1,
                          float lr, MatrixDim d, int stride_grad) {
-  _regularize_l1<<<Gr,Bl>>>(wei,grad,l1,lr,d,stride_grad);
+  _regularize_l1<<<Gr,Bl, 0,
+      cuda_current_stream()>>>(wei,grad,l1,lr,d,stride_grad);
 }
 
 void cudaF_find_row_max_id(dim3 Gr, dim3 Bl, const float* mat, float* vec_val,
                            int32_cuda* vec_id, MatrixDim d) {
-  _find_row_max_id<<<Gr,Bl>>>(mat, vec_val, vec_id, d);
+  _find_row_max_id<<<Gr,Bl, 0, cuda_current_stream()>>>(mat, vec_val, vec_id,
+      d);
 }
 
 void cudaF_diff_xent(dim3 Gr, dim3 Bl, const int32_cuda* vec_tgt,
                      float* mat_net_out, float* vec_log_post, MatrixDim d) {
-  _diff_xent<<<Gr,Bl>>>(vec_tgt,mat_net_out,vec_log_post,d);
+  _diff_xent<<<Gr,Bl, 0,
+      cuda_current_stream()>>>(vec_tgt,mat_net_out,vec_log_post,d);
 }
 
 void cudaF_diff_softmax(dim3 Gr, dim3 Bl, float* x, const MatrixDim dim,
                         const float* value, const int value_stride,
                         const float* diff, const int diff_stride) {
-  _diff_softmax<<<Gr, Bl>>>(x, dim, value, value_stride, diff, diff_stride);
+  _diff_softmax<<<Gr, Bl, 0, cuda_current_stream()>>>(x, dim, value,
+      value_stride, diff, diff_stride);
 }
 
 void cudaF_copy_rows_from_vec(dim3 Gr, dim3 Bl, float *mat_out, MatrixDim d_out,
                               const float *v_in) {
-  _copy_rows_from_vec<<<Gr,Bl>>>(mat_out, d_out, v_in);
+  _copy_rows_from_vec<<<Gr,Bl, 0, cuda_current_stream()>>>(mat_out, d_out,
+      v_in);
 }
 
 void cudaF_diff_log_softmax(dim3 Gr, dim3 Bl, const MatrixDim in_deriv_dim,
                             const float* out_value, const int out_value_stride,
                             const float* out_deriv, const int out_deriv_stride,
                             float* in_deriv) {
-  _diff_log_softmax<<<Gr, Bl>>>(in_deriv_dim, out_value, out_value_stride,
+  _diff_log_softmax<<<Gr, Bl, 0, cuda_current_stream()>>>(in_deriv_dim,
+      out_value, out_value_stride,
       out_deriv, out_deriv_stride, in_deriv);
 }
 
 void cudaF_copy_col_from_mat_df(int Gr, int Bl, double* v, int col,
                                 const float* mat, MatrixDim dmat, int dim) {
-  _copy_col_from_mat_df<<<Gr,Bl>>>(v,col,mat,dmat,dim);
+  _copy_col_from_mat_df<<<Gr,Bl, 0,
+      cuda_current_stream()>>>(v,col,mat,dmat,dim);
 }
 
 void cudaF_copy_col_from_mat_fd(int Gr, int Bl, float* v, int col,
                                 const float* mat, MatrixDim dmat, int dim) {
-  _copy_col_from_mat_fd<<<Gr,Bl>>>(v,col,mat,dmat,dim);
+  _copy_col_from_mat_fd<<<Gr,Bl, 0,
+      cuda_current_stream()>>>(v,col,mat,dmat,dim);
 }
 
 void cudaF_sum_column_ranges(dim3 Gr, dim3 Bl, float *data, MatrixDim dim,
                              const float *src_data, MatrixDim src_dim,
                              const Int32Pair *indices) {
-  _sum_column_ranges<<<Gr,Bl>>>(data, dim, src_data, src_dim, indices);
+  _sum_column_ranges<<<Gr,Bl, 0, cuda_current_stream()>>>(data, dim, src_data,
+      src_dim, indices);
 }
 
 void cudaF_add_row_ranges(dim3 Gr, dim3 Bl, float *data, MatrixDim dim,
                           const float *src_data, MatrixDim src_dim,
                           const Int32Pair *indexes) {
-  _add_row_ranges<<<Gr,Bl>>>(data, dim, src_data, src_dim, indexes);
+  _add_row_ranges<<<Gr,Bl, 0, cuda_current_stream()>>>(data, dim, src_data,
+      src_dim, indexes);
 }
 
 void cudaF_matrix_lookup(dim3 Gr, dim3 Bl, const float *data, MatrixDim dim,
                          const Int32Pair *indices, int indices_size,
                          float *output) {
-  _matrix_lookup<<<Gr,Bl>>>(data, dim, indices, indices_size, output);
+  _matrix_lookup<<<Gr,Bl, 0, cuda_current_stream()>>>(data, dim, indices,
+      indices_size, output);
 }
 
 void cudaF_equal_element_mask(dim3 Gr, dim3 Bl, const float *mat1,
                               const float *mat2, float *mask,
                               MatrixDim mat1_dim, int mat2_stride,
                               int mask_stride) {
-  _equal_element_mask<<<Gr,Bl>>>(mat1, mat2, mask, mat1_dim, mat2_stride,
+  _equal_element_mask<<<Gr,Bl, 0, cuda_current_stream()>>>(mat1, mat2, mask,
+      mat1_dim, mat2_stride,
       mask_stride);
 }
 
@@ -4431,186 +4542,197 @@ void cudaF_equal_element_mask(dim3 Gr, dim3 Bl, const float *mat1,
  * CuMatrix
  */
 void cudaD_copy_upp_low(dim3 Gr, dim3 Bl, double* A, MatrixDim dimA) {
-  _copy_upp_low<<<Gr,Bl>>>(A,dimA);}
+  _copy_upp_low<<<Gr,Bl, 0, cuda_current_stream()>>>(A,dimA);}
 void cudaD_copy_low_upp(dim3 Gr, dim3 Bl, double* A, MatrixDim dimA) {
-  _copy_low_upp<<<Gr,Bl>>>(A,dimA);}
+  _copy_low_upp<<<Gr,Bl, 0, cuda_current_stream()>>>(A,dimA);}
 void cudaD_add_diag_vec_mat(dim3 Gr, dim3 Bl, double alpha, double *mat,
                             MatrixDim mat_dim, const double *vec,
                             const double *mat2, int mat2_row_stride,
                             int mat2_col_stride, double beta) {
-  _add_diag_vec_mat<<<Gr,Bl>>>(alpha, mat, mat_dim, vec, mat2, mat2_row_stride,
+  _add_diag_vec_mat<<<Gr,Bl, 0, cuda_current_stream()>>>(alpha, mat, mat_dim,
+      vec, mat2, mat2_row_stride,
       mat2_col_stride, beta);
 }
 
 void cudaD_copy_from_tp_trans(dim3 Gr, dim3 Bl, double* A, const double* B,
                               MatrixDim dmat) {
-  _copy_from_tp_trans<<<Gr,Bl>>>(A,B,dmat);
+  _copy_from_tp_trans<<<Gr,Bl, 0, cuda_current_stream()>>>(A,B,dmat);
 }
 void cudaDF_copy_from_tp_trans(dim3 Gr, dim3 Bl, double* A, const float* B,
                                MatrixDim dmat) {
-  _copy_from_tp_trans<<<Gr,Bl>>>(A,B,dmat);
+  _copy_from_tp_trans<<<Gr,Bl, 0, cuda_current_stream()>>>(A,B,dmat);
 }
 
 void cudaD_copy_from_tp(dim3 Gr, dim3 Bl, double* A, const double* B,
                         MatrixDim dmat) {
-  _copy_from_tp<<<Gr,Bl>>>(A,B,dmat);
+  _copy_from_tp<<<Gr,Bl, 0, cuda_current_stream()>>>(A,B,dmat);
 }
 void cudaDF_copy_from_tp(dim3 Gr, dim3 Bl, double* A, const float* B,
                          MatrixDim dmat) {
-  _copy_from_tp<<<Gr,Bl>>>(A,B,dmat);
+  _copy_from_tp<<<Gr,Bl, 0, cuda_current_stream()>>>(A,B,dmat);
 }
 
 void cudaD_copy_cols(dim3 Gr, dim3 Bl, double* dst, const double* src,
                      const MatrixIndexT_cuda* reorder, MatrixDim dst_dim,
                      int src_stride) {
-  _copy_cols<<<Gr,Bl>>>(dst, src, reorder, dst_dim, src_stride);
+  _copy_cols<<<Gr,Bl, 0, cuda_current_stream()>>>(dst, src, reorder, dst_dim,
+      src_stride);
 }
 
 void cudaD_add_cols(dim3 Gr, dim3 Bl, double* dst, const double* src,
                     const MatrixIndexT_cuda* reorder, MatrixDim dst_dim,
                     int src_stride) {
-  _add_cols<<<Gr,Bl>>>(dst, src, reorder, dst_dim, src_stride);
+  _add_cols<<<Gr,Bl, 0, cuda_current_stream()>>>(dst, src, reorder, dst_dim,
+      src_stride);
 }
 
 void cudaD_copy_rows(dim3 Gr, dim3 Bl, double* dst, const double* src,
                      const MatrixIndexT_cuda* reorder, MatrixDim dst_dim,
                      int src_stride) {
-  _copy_rows<<<Gr,Bl>>>(dst, src, reorder, dst_dim, src_stride);
+  _copy_rows<<<Gr,Bl, 0, cuda_current_stream()>>>(dst, src, reorder, dst_dim,
+      src_stride);
 }
 
 void cudaD_copy_rows_direct(dim3 Gr, dim3 Bl, double* dst,
                             const double* const * src, MatrixDim dst_dim) {
-  _copy_rows<<<Gr,Bl>>>(dst, src, dst_dim);
+  _copy_rows<<<Gr,Bl, 0, cuda_current_stream()>>>(dst, src, dst_dim);
 }
 
 void cudaD_copy_to_rows_direct(dim3 Gr, dim3 Bl, double* const * dst,
                                const double* src, MatrixDim src_dim) {
-  _copy_to_rows<<<Gr,Bl>>>(dst, src, src_dim);
+  _copy_to_rows<<<Gr,Bl, 0, cuda_current_stream()>>>(dst, src, src_dim);
 }
 
 void cudaD_add_rows(dim3 Gr, dim3 Bl, double alpha, double* dst,
                     const double* src, const MatrixIndexT_cuda* reorder,
                     MatrixDim dst_dim, int src_stride) {
-  _add_rows<<<Gr,Bl>>>(alpha, dst, src, reorder, dst_dim, src_stride);
+  _add_rows<<<Gr,Bl, 0, cuda_current_stream()>>>(alpha, dst, src, reorder,
+      dst_dim, src_stride);
 }
 
 void cudaD_mul_rows(dim3 Gr, dim3 Bl, double* dst,
                     const double* src, const MatrixIndexT_cuda* reorder,
                     MatrixDim dst_dim, int src_stride) {
-  _mul_rows<<<Gr,Bl>>>(dst, src, reorder, dst_dim, src_stride);
+  _mul_rows<<<Gr,Bl, 0, cuda_current_stream()>>>(dst, src, reorder, dst_dim,
+      src_stride);
 }
 
 void cudaD_add_rows_direct(dim3 Gr, dim3 Bl, double alpha, double* dst,
                            const double* const * src, MatrixDim dst_dim) {
-  _add_rows<<<Gr,Bl>>>(alpha, dst, src, dst_dim);
+  _add_rows<<<Gr,Bl, 0, cuda_current_stream()>>>(alpha, dst, src, dst_dim);
 }
 
 void cudaD_add_to_rows(dim3 Gr, dim3 Bl, double alpha,
                        double* dst, const double* src, const MatrixIndexT_cuda* reorder,
                        MatrixDim src_dim, int dst_stride) {
-  _add_to_rows<<<Gr,Bl>>>(alpha, dst, src, reorder, src_dim, dst_stride);
+  _add_to_rows<<<Gr,Bl, 0, cuda_current_stream()>>>(alpha, dst, src, reorder,
+      src_dim, dst_stride);
 }
 
 void cudaD_add_to_rows_direct(dim3 Gr, dim3 Bl, double alpha,
                               double* const * dst, const double* src,
                               MatrixDim src_dim) {
-  _add_to_rows<<<Gr,Bl>>>(alpha, dst, src, src_dim);
+  _add_to_rows<<<Gr,Bl, 0, cuda_current_stream()>>>(alpha, dst, src, src_dim);
 }
 
 void cudaD_set_diag(int Gr, int Bl, double* mat, double value, MatrixDim d) {
-  _set_diag<<<Gr,Bl>>>(mat,value,d);
+  _set_diag<<<Gr,Bl, 0, cuda_current_stream()>>>(mat,value,d);
 }
 
 void cudaD_set_diag_packed(int Gr, int Bl, double* mat, double value, int dim) {
-  _set_diag_packed<<<Gr,Bl>>>(mat,value,dim);
+  _set_diag_packed<<<Gr,Bl, 0, cuda_current_stream()>>>(mat,value,dim);
 }
 
 void cudaD_add_diag_packed(int Gr, int Bl, double* mat, double value, int dim) {
-  _add_diag_packed<<<Gr,Bl>>>(mat,value,dim);
+  _add_diag_packed<<<Gr,Bl, 0, cuda_current_stream()>>>(mat,value,dim);
 }
 
 void cudaD_set_const(dim3 Gr, dim3 Bl, double* mat, double value, MatrixDim d) {
-  _set_const<<<Gr,Bl>>>(mat,value,d);
+  _set_const<<<Gr,Bl, 0, cuda_current_stream()>>>(mat,value,d);
 }
 
 void cudaD_set_zero_above_diag(dim3 Gr, dim3 Bl, double* mat, MatrixDim d) {
-  _set_zero_above_diag<<<Gr,Bl>>>(mat, d);
+  _set_zero_above_diag<<<Gr,Bl, 0, cuda_current_stream()>>>(mat, d);
 }
 
 void cudaD_add(dim3 Gr, dim3 Bl, double* mat, double value, MatrixDim d) {
-  _add<<<Gr,Bl>>>(mat,value,d);
+  _add<<<Gr,Bl, 0, cuda_current_stream()>>>(mat,value,d);
 }
 
 void cudaD_scale_diag_packed(int Gr, int Bl, double* mat, double value,
                              int dim) {
-  _scale_diag_packed<<<Gr,Bl>>>(mat,value,dim);
+  _scale_diag_packed<<<Gr,Bl, 0, cuda_current_stream()>>>(mat,value,dim);
 }
 
 void cudaD_scale(dim3 Gr, dim3 Bl, double* mat, double value, MatrixDim d) {
-  _scale<<<Gr,Bl>>>(mat,value,d);
+  _scale<<<Gr,Bl, 0, cuda_current_stream()>>>(mat,value,d);
 }
 
 void cudaD_mul_elements(dim3 Gr, dim3 Bl, double* mat, const double* A,
                         MatrixDim dst_d, int src_stride) {
-  _mul_elements<<<Gr,Bl>>>(mat,A,dst_d,src_stride);
+  _mul_elements<<<Gr,Bl, 0, cuda_current_stream()>>>(mat,A,dst_d,src_stride);
 }
 
 void cudaD_div_elements(dim3 Gr, dim3 Bl, double* mat, const double* A,
                         MatrixDim dst_d, int src_stride) {
-  _div_elements<<<Gr,Bl>>>(mat,A,dst_d,src_stride);
+  _div_elements<<<Gr,Bl, 0, cuda_current_stream()>>>(mat,A,dst_d,src_stride);
 }
 
 void cudaD_max(dim3 Gr, dim3 Bl, double* mat, const double* A, MatrixDim dst_d,
                int src_stride) {
-  _max<<<Gr,Bl>>>(mat,A,dst_d,src_stride);
+  _max<<<Gr,Bl, 0, cuda_current_stream()>>>(mat,A,dst_d,src_stride);
 }
 
 void cudaD_min(dim3 Gr, dim3 Bl, double* mat, const double* other, MatrixDim mat_d,
                int other_stride) {
-  _min<<<Gr,Bl>>>(mat,other,mat_d,other_stride);
+  _min<<<Gr,Bl, 0, cuda_current_stream()>>>(mat,other,mat_d,other_stride);
 }
 
 void cudaD_mul_cols_vec(dim3 Gr, dim3 Bl, double* mat, const double* scale,
                         MatrixDim d) {
-  _mul_cols_vec<<<Gr,Bl>>>(mat,scale,d);
+  _mul_cols_vec<<<Gr,Bl, 0, cuda_current_stream()>>>(mat,scale,d);
 }
 
 void cudaD_mul_rows_vec(dim3 Gr, dim3 Bl, double* mat, const double* scale,
                         MatrixDim d) {
-  _mul_rows_vec<<<Gr,Bl>>>(mat,scale,d);
+  _mul_rows_vec<<<Gr,Bl, 0, cuda_current_stream()>>>(mat,scale,d);
 }
 
 void cudaD_mul_rows_group_mat(dim3 Gr, dim3 Bl, double* y, const double* x,
                               MatrixDim d, int src_stride, int group_size) {
-  _mul_rows_group_mat<<<Gr,Bl>>>(y, x, d, src_stride, group_size);
+  _mul_rows_group_mat<<<Gr,Bl, 0, cuda_current_stream()>>>(y, x, d, src_stride,
+      group_size);
 }
 
 void cudaD_diff_group_pnorm(dim3 Gr, dim3 Bl, double *id, const double *iv,
                             const double *ov, const double* od,
                             MatrixDim id_dim, int iv_stride, int ov_stride,
                             int od_stride, int group_size, double power) {
-  _diff_group_pnorm<<<Gr, Bl>>>(id, iv, ov, od, id_dim, iv_stride, ov_stride,
+  _diff_group_pnorm<<<Gr, Bl, 0, cuda_current_stream()>>>(id, iv, ov, od,
+      id_dim, iv_stride, ov_stride,
       od_stride, group_size, power);
 }
 
 void cudaD_calc_group_max_deriv(dim3 Gr, dim3 Bl, double*y, const double* x1,
                                 const double* x2, MatrixDim y_dim,
                                 int x1_stride, int x2_stride, int group_size) {
-  _calc_group_max_deriv<<<Gr,Bl>>>(y, x1, x2, y_dim, x1_stride, x2_stride,
+  _calc_group_max_deriv<<<Gr,Bl, 0, cuda_current_stream()>>>(y, x1, x2, y_dim,
+      x1_stride, x2_stride,
       group_size);
 }
 
 void cudaD_div_rows_vec(dim3 Gr, dim3 Bl, double* mat, const double* vec_div,
                         MatrixDim d) {
-  _div_rows_vec<<<Gr,Bl>>>(mat, vec_div, d);
+  _div_rows_vec<<<Gr,Bl, 0, cuda_current_stream()>>>(mat, vec_div, d);
 }
 
 void cudaD_add_mat(dim3 Gr, dim3 Bl, double alpha, const double* src,
                    double* dst, MatrixDim d, int src_stride, int A_trans) {
   if (A_trans) {
-    _add_mat_trans<<<Gr,Bl>>>(alpha,src,dst,d,src_stride);
+    _add_mat_trans<<<Gr,Bl, 0,
+        cuda_current_stream()>>>(alpha,src,dst,d,src_stride);
   } else {
-    _add_mat<<<Gr,Bl>>>(alpha,src,dst,d,src_stride);
+    _add_mat<<<Gr,Bl, 0, cuda_current_stream()>>>(alpha,src,dst,d,src_stride);
   }
 }
 
@@ -4619,47 +4741,53 @@ void cudaD_add_mat_blocks(dim3 Gr, dim3 Bl, double alpha, const double* src,
                           double* dst, MatrixDim d, int src_stride,
                           int A_trans) {
   if (A_trans) {
-    _add_mat_blocks_trans<<<Gr,Bl>>>(alpha, src, num_row_blocks, num_col_blocks,
+    _add_mat_blocks_trans<<<Gr,Bl, 0, cuda_current_stream()>>>(alpha, src,
+        num_row_blocks, num_col_blocks,
         dst, d, src_stride);
   } else {
-    _add_mat_blocks<<<Gr,Bl>>>(alpha, src, num_row_blocks, num_col_blocks, dst,
+    _add_mat_blocks<<<Gr,Bl, 0, cuda_current_stream()>>>(alpha, src,
+        num_row_blocks, num_col_blocks, dst,
         d, src_stride);
   }
 }
 
 void cudaD_add_mat_repeated(dim3 Gr, dim3 Bl, double alpha, const double* src,
                             MatrixDim src_dim, double *dst, MatrixDim dst_dim) {
-  _add_mat_repeated<<<Gr,Bl>>>(alpha, src, src_dim, dst, dst_dim);
+  _add_mat_repeated<<<Gr,Bl, 0, cuda_current_stream()>>>(alpha, src, src_dim,
+      dst, dst_dim);
 }
 
 void cudaD_set_mat_mat_div_mat(dim3 Gr, dim3 Bl, const double *A,
                                const double *B, const double *C, double *dst,
                                MatrixDim d, int stride_a, int stride_b,
                                int stride_c) {
-  _set_mat_mat_div_mat<<<Gr,Bl>>>(A,B,C,dst,d,stride_a,stride_b,stride_c);
+  _set_mat_mat_div_mat<<<Gr,Bl, 0,
+      cuda_current_stream()>>>(A,B,C,dst,d,stride_a,stride_b,stride_c);
 }
 
 void cudaD_sy_add_tr2(dim3 Gr, dim3 Bl, double alpha, double beta,
                       const double* T, MatrixDim tdim, double *S,
                       MatrixDim sdim) {
-  _sy_add_tr2<<<Gr,Bl>>>(alpha, beta, T, tdim, S, sdim);
+  _sy_add_tr2<<<Gr,Bl, 0, cuda_current_stream()>>>(alpha, beta, T, tdim, S,
+      sdim);
 }
 
 void cudaD_add_vec_to_cols(dim3 Gr, dim3 Bl, double alpha, const double* col,
                            double beta, double* dst, MatrixDim d) {
-  _add_vec_to_cols<<<Gr,Bl>>>(alpha,col,beta,dst,d);
+  _add_vec_to_cols<<<Gr,Bl, 0, cuda_current_stream()>>>(alpha,col,beta,dst,d);
 }
 
 void cudaD_add_vec_to_rows(dim3 Gr, dim3 Bl, double alpha, const double* row,
                            double beta, double* dst, MatrixDim d) {
-  _add_vec_to_rows<<<Gr,Bl>>>(alpha,row,beta,dst,d);
+  _add_vec_to_rows<<<Gr,Bl, 0, cuda_current_stream()>>>(alpha,row,beta,dst,d);
 }
 
 void cudaD_add_mat_diag_vec(dim3 Gr, dim3 Bl, double alpha, double *mat,
                             MatrixDim mat_dim, const double *mat2,
                             int mat2_row_stride, int mat2_col_stride,
                             const double *vec, double beta) {
-  _add_mat_diag_vec<<<Gr,Bl>>>(alpha, mat, mat_dim, mat2, mat2_row_stride,
+  _add_mat_diag_vec<<<Gr,Bl, 0, cuda_current_stream()>>>(alpha, mat, mat_dim,
+      mat2, mat2_row_stride,
       mat2_col_stride, vec, beta);
 }
 
@@ -4668,14 +4796,15 @@ void cudaD_add_mat_mat_elements(dim3 Gr, dim3 Bl, double *data,
                                 const double *srcB_data, MatrixDim dim,
                                 int srcA_stride, int srcB_stride, double alpha,
                                 double beta) {
-  _add_mat_mat_elements<<<Gr, Bl>>>(data, srcA_data, srcB_data, dim,
+  _add_mat_mat_elements<<<Gr, Bl, 0, cuda_current_stream()>>>(data, srcA_data,
+      srcB_data, dim,
       srcA_stride, srcB_stride, alpha, beta);
 }
 
 // CURRENTLY UNUSED...
 void cudaD_apply_mask(dim3 Gr, dim3 Bl, double* mat, const char* mask,
                       MatrixDim dmat, MatrixDim dmask) {
-  _apply_mask<<<Gr,Bl>>>(mat,mask,dmat,dmask);
+  _apply_mask<<<Gr,Bl, 0, cuda_current_stream()>>>(mat,mask,dmat,dmask);
 }
 
 /*
@@ -4683,76 +4812,82 @@ void cudaD_apply_mask(dim3 Gr, dim3 Bl, double* mat, const char* mask,
  */
 void cudaD_max_mat_cols(int Gr, int Bl, double* result, const double* mat,
                         const MatrixDim d) {
-  _transform_reduce_mat_cols<<<Gr,Bl>>>(result,mat,d,
+  _transform_reduce_mat_cols<<<Gr,Bl, 0, cuda_current_stream()>>>(result,mat,d,
       TransReduceOp<MAX,double>());
 }
 void cudaD_min_mat_cols(int Gr, int Bl, double* result, const double* mat,
                         const MatrixDim d) {
-  _transform_reduce_mat_cols<<<Gr,Bl>>>(result,mat,d,
+  _transform_reduce_mat_cols<<<Gr,Bl, 0, cuda_current_stream()>>>(result,mat,d,
       TransReduceOp<MIN,double>());
 }
 void cudaD_sum_mat_cols(int Gr, int Bl, double* result, const double* mat,
                         const MatrixDim d) {
-  _transform_reduce_mat_cols<<<Gr,Bl>>>(result,mat,d,
+  _transform_reduce_mat_cols<<<Gr,Bl, 0, cuda_current_stream()>>>(result,mat,d,
       TransReduceOp<SUM,double>());
 }
 void cudaD_add_row_sum_mat(int Gr, int Bl, double* result, const double* mat,
                            const MatrixDim d, const double alpha,
                            const double beta) {
-  _transform_reduce_mat_rows<<<Gr, Bl>>>(result, mat, d,
+  _transform_reduce_mat_rows<<<Gr, Bl, 0, cuda_current_stream()>>>(result, mat,
+      d,
       TransReduceOp<SUMAB, double>(alpha, beta));
 }
 void cudaD_add_col_sum_mat(int Gr, int Bl, double* result, const double* mat,
                            const MatrixDim d, const double alpha,
                            const double beta) {
-  _transform_reduce_mat_cols<<<Gr, Bl>>>(result, mat, d,
+  _transform_reduce_mat_cols<<<Gr, Bl, 0, cuda_current_stream()>>>(result, mat,
+      d,
       TransReduceOp<SUMAB, double>(alpha, beta));
 }
 
 void cudaD_replace_value(int Gr, int Bl, double *v, int dim, double orig,
                          double changed) {
-  _replace_value<<<Gr,Bl>>>(v, dim, orig, changed);
+  _replace_value<<<Gr,Bl, 0, cuda_current_stream()>>>(v, dim, orig, changed);
 }
 
 void cudaD_set_bias_params(int Gr, int Bl, double* v, const double* a,
                            double param_1, double param_2, double param_3,
                            int* flag, int dim) {
-  _set_bias_params<<<Gr,Bl>>>(v,a,param_1,param_2,param_3,flag,dim);
+  _set_bias_params<<<Gr,Bl, 0,
+      cuda_current_stream()>>>(v,a,param_1,param_2,param_3,flag,dim);
 }
 
 void cudaD_vec_mul_elements(int Gr, int Bl, double* v, const double* a,
                             int dim) {
-  _vec_mul_elements<<<Gr,Bl>>>(v, a, dim);
+  _vec_mul_elements<<<Gr,Bl, 0, cuda_current_stream()>>>(v, a, dim);
 }
 
 void cudaD_vec_min(int Gr, int Bl, const double* v, double* value, int dim,
                    int inc) {
-  _vec_transform_reduce<<<Gr,Bl>>>(v, value, dim, inc,
+  _vec_transform_reduce<<<Gr,Bl, 0, cuda_current_stream()>>>(v, value, dim, inc,
       TransReduceOp<MIN, double>());
 }
 
 void cudaD_vec_max(int Gr, int Bl, const double* v, double* value, int dim,
                    int inc) {
-  _vec_transform_reduce<<<Gr,Bl>>>(v, value, dim, inc,
+  _vec_transform_reduce<<<Gr,Bl, 0, cuda_current_stream()>>>(v, value, dim, inc,
       TransReduceOp<MAX, double>());
 }
 
 void cudaD_trace_mat_mat_trans(dim3 Gr, dim3 Bl, const double* A,
                                const double* B, MatrixDim dA, int B_stride,
                                double* value) {
-  _trace_mat_mat_trans<<<Gr,Bl>>>(A,B,dA,B_stride,value);
+  _trace_mat_mat_trans<<<Gr,Bl, 0,
+      cuda_current_stream()>>>(A,B,dA,B_stride,value);
 }
 
 void cudaD_trace_mat_mat(dim3 Gr, dim3 Bl, const double* A, const double* B,
                          MatrixDim dA, int B_stride, double* value) {
-  _trace_mat_mat<32> <<<Gr,Bl>>>(A,B,dA,B_stride,value);
+  _trace_mat_mat<32> <<<Gr,Bl, 0,
+      cuda_current_stream()>>>(A,B,dA,B_stride,value);
 }
 
 void cudaD_add_diag_mat_mat_MNT(int Gr, int Bl, const double alpha,
                                 const double* M, const MatrixDim dim_M,
                                 const double* N, const int stride_N,
                                 const double beta, double* v) {
-  _add_diag_mat_mat_MNT<<<Gr,Bl>>>(alpha,M,dim_M,N,stride_N,beta,v);
+  _add_diag_mat_mat_MNT<<<Gr,Bl, 0,
+      cuda_current_stream()>>>(alpha,M,dim_M,N,stride_N,beta,v);
 }
 
 void cudaD_add_diag_mat_mat_MTN(dim3 Gr, dim3 Bl, const double alpha,
@@ -4761,10 +4896,12 @@ void cudaD_add_diag_mat_mat_MTN(dim3 Gr, dim3 Bl, const double alpha,
                                 const double beta, double* v,
                                 const int stride_v) {
   if (Bl.x == 16) {
-    _add_diag_mat_mat_MTN<16> <<<Gr, Bl>>>(alpha, M, stride_M, N, dim_N, beta,
+    _add_diag_mat_mat_MTN<16> <<<Gr, Bl, 0, cuda_current_stream()>>>(alpha, M,
+        stride_M, N, dim_N, beta,
                                            v, stride_v);
   } else if (Bl.x == 32) {
-    _add_diag_mat_mat_MTN<32> <<<Gr, Bl>>>(alpha, M, stride_M, N, dim_N, beta,
+    _add_diag_mat_mat_MTN<32> <<<Gr, Bl, 0, cuda_current_stream()>>>(alpha, M,
+        stride_M, N, dim_N, beta,
                                            v, stride_v);
   }
 }
@@ -4774,83 +4911,92 @@ void cudaD_add_diag_mat_mat_MN(dim3 Gr, dim3 Bl, const double alpha,
                                const double* N, const MatrixDim dim_N,
                                const double beta, double* v) {
   if (Bl.x == 16) {
-    _add_diag_mat_mat_MN<16> <<<Gr,Bl>>>(alpha,M,stride_M,N,dim_N,beta,v);
+    _add_diag_mat_mat_MN<16> <<<Gr,Bl, 0,
+        cuda_current_stream()>>>(alpha,M,stride_M,N,dim_N,beta,v);
   } else if (Bl.x==32) {
-    _add_diag_mat_mat_MN<32><<<Gr,Bl>>>(alpha,M,stride_M,N,dim_N,beta,v);
+    _add_diag_mat_mat_MN<32><<<Gr,Bl, 0,
+        cuda_current_stream()>>>(alpha,M,stride_M,N,dim_N,beta,v);
   }
 }
 
 void cudaD_add_vec_vec(int Gr, int Bl, double alpha, double* v, const double* x,
                        const double* y, double beta, int dim) {
-  _add_vec_vec<<<Gr,Bl>>>(alpha,v,x,y,beta,dim);
+  _add_vec_vec<<<Gr,Bl, 0, cuda_current_stream()>>>(alpha,v,x,y,beta,dim);
 }
 
 void cudaD_copy_col_from_mat_df(int Gr, int Bl, double* v, int col,
                                 const double* mat, MatrixDim dmat, int dim) {
-  _copy_col_from_mat_df<<<Gr,Bl>>>(v,col,mat,dmat,dim);
+  _copy_col_from_mat_df<<<Gr,Bl, 0,
+      cuda_current_stream()>>>(v,col,mat,dmat,dim);
 }
 
 void cudaD_copy_col_from_mat_fd(int Gr, int Bl, float* v, int col,
                                 const double* mat, MatrixDim dmat, int dim) {
-  _copy_col_from_mat_fd<<<Gr,Bl>>>(v,col,mat,dmat,dim);
+  _copy_col_from_mat_fd<<<Gr,Bl, 0,
+      cuda_current_stream()>>>(v,col,mat,dmat,dim);
 }
 
 void cudaD_vec_sum(int Gr, int Bl, double* v, double* value, int dim, int inc) {
-  _vec_transform_reduce<<<Gr,Bl>>>(v,value,dim,inc,
+  _vec_transform_reduce<<<Gr,Bl, 0, cuda_current_stream()>>>(v,value,dim,inc,
       TransReduceOp<SUM, double>());
 }
 
 void cudaD_matrix_add_elements(dim3 Gr, dim3 Bl, double *data, MatrixDim dim,
                                double alpha, MatrixElement<double>* x,
                                int num_elements) {
-  _cuda_matrix_add_elements<<<Gr, Bl>>>(data, dim, alpha, x, num_elements);
+  _cuda_matrix_add_elements<<<Gr, Bl, 0, cuda_current_stream()>>>(data, dim,
+      alpha, x, num_elements);
 }
 
 void cudaD_vector_copy_elements(dim3 Gr, dim3 Bl, double *data, int dim,
                                 const double *src_mat, int mat_stride,
                                 bool transpose,
                                 const MatrixIndexT_cuda* elements) {
-  _cuda_vector_copy_elements<<<Gr, Bl>>>(data, dim, src_mat, mat_stride,
+  _cuda_vector_copy_elements<<<Gr, Bl, 0, cuda_current_stream()>>>(data, dim,
+      src_mat, mat_stride,
                                          transpose, elements);
 }
 
 void cudaD_matrix_add_indexed_values(dim3 Gr, dim3 Bl, MatrixDim dim,
                                      double alpha, const Int32Pair* indices,
                                      const double* x, int s, double* data) {
-  _cuda_matrix_add_indexed_values<<<Gr, Bl>>>(dim, alpha, indices, x, s, data);
+  _cuda_matrix_add_indexed_values<<<Gr, Bl, 0, cuda_current_stream()>>>(dim,
+      alpha, indices, x, s, data);
 }
 
 void cudaD_matrix_add_to_elements(dim3 Gr, dim3 Bl, double alpha,
                                   double* mat, MatrixDim dim,
                                   const MatrixIndexT_cuda* elements) {
-  _cuda_matrix_add_to_elements<<<Gr, Bl>>>(alpha, mat, dim, elements);
+  _cuda_matrix_add_to_elements<<<Gr, Bl, 0, cuda_current_stream()>>>(alpha,
+      mat, dim, elements);
 }
 
 void cudaD_vec_copy_diag_from_packed(int Gr, int Bl, double *dst,
                                      const double *src, int dim) {
-  _vec_copy_diag_from_packed<<<Gr,Bl>>>(dst,src,dim);
+  _vec_copy_diag_from_packed<<<Gr,Bl, 0, cuda_current_stream()>>>(dst,src,dim);
 }
 
 void cudaD_vec_apply_floor(int Gr, int Bl, double* v, double floor_val,
                            float *count, int dim) {
-  _vec_apply_floor<<<Gr,Bl>>>(v,floor_val,count,dim);
+  _vec_apply_floor<<<Gr,Bl, 0, cuda_current_stream()>>>(v,floor_val,count,dim);
 }
 
 void cudaD_vec_apply_ceiling(int Gr, int Bl, double* v, double ceiling_val,
                              float *count, int dim) {
-  _vec_apply_ceiling<<<Gr,Bl>>>(v,ceiling_val,count,dim);
+  _vec_apply_ceiling<<<Gr,Bl, 0,
+      cuda_current_stream()>>>(v,ceiling_val,count,dim);
 }
 
 void cudaD_vec_apply_exp(int Gr, int Bl, double* v, int dim) {
-  _vec_apply_exp<<<Gr,Bl>>>(v,dim);
+  _vec_apply_exp<<<Gr,Bl, 0, cuda_current_stream()>>>(v,dim);
 }
 
 void cudaD_vec_apply_log(int Gr, int Bl, double* v, double* flag, int dim) {
-  _vec_apply_log<<<Gr,Bl>>>(v,flag,dim);
+  _vec_apply_log<<<Gr,Bl, 0, cuda_current_stream()>>>(v,flag,dim);
 }
 
 void cudaD_invert_elements(dim3 Gr, dim3 Bl, double* data, MatrixDim d) {
-  _invert_elements<<<Gr,Bl>>>(data, d);
+  _invert_elements<<<Gr,Bl, 0, cuda_current_stream()>>>(data, d);
 }
 
 void cudaD_add_mat_blockmat(dim3 Gr, dim3 Bl, double *data, MatrixDim d,
@@ -4860,10 +5006,12 @@ void cudaD_add_mat_blockmat(dim3 Gr, dim3 Bl, double *data, MatrixDim d,
                             int B_num_blocks, double alpha, double beta,
                             int B_trans) {
   if (B_trans) {
-    _add_mat_blockmat_trans<<<Gr,Bl>>>(data, d, Adata, A_num_rows, A_num_cols,
+    _add_mat_blockmat_trans<<<Gr,Bl, 0, cuda_current_stream()>>>(data, d,
+        Adata, A_num_rows, A_num_cols,
         A_row_stride, A_col_stride, B_cu_data, B_num_blocks, alpha, beta);
   } else {
-    _add_mat_blockmat<<<Gr,Bl>>>(data, d, Adata, A_num_rows, A_num_cols,
+    _add_mat_blockmat<<<Gr,Bl, 0, cuda_current_stream()>>>(data, d, Adata,
+        A_num_rows, A_num_cols,
         A_row_stride, A_col_stride, B_cu_data, B_num_blocks, alpha, beta);
   }
 }
@@ -4873,7 +5021,8 @@ void cudaD_block_add_mat_mat(dim3 Gr, dim3 Bl, CuBlockMatrixData *B_cu_data,
                              int C_num_cols, int C_row_stride, int C_col_stride,
                              const double *D_data, int D_row_stride,
                              int D_col_stride, double alpha, double beta) {
-  _block_add_mat_mat<<<Gr,Bl>>>(B_cu_data, num_blocks, C_data, C_num_cols,
+  _block_add_mat_mat<<<Gr,Bl, 0, cuda_current_stream()>>>(B_cu_data,
+      num_blocks, C_data, C_num_cols,
       C_row_stride, C_col_stride, D_data, D_row_stride, D_col_stride,
       alpha, beta);
 }
@@ -4883,237 +5032,264 @@ void cudaD_block_add_mat_mat(dim3 Gr, dim3 Bl, CuBlockMatrixData *B_cu_data,
  */
 void cudaD_soft_hinge(dim3 Gr, dim3 Bl, double* y, const double* x, MatrixDim d,
                       int src_stride) {
-  _soft_hinge<<<Gr,Bl>>>(y, x, d, src_stride);
+  _soft_hinge<<<Gr,Bl, 0, cuda_current_stream()>>>(y, x, d, src_stride);
 }
 
 void cudaD_group_pnorm(dim3 Gr, dim3 Bl, double* y, const double* x,
                        MatrixDim d, int src_stride, int group_size,
                        double power) {
-  _group_pnorm<<<Gr,Bl>>>(y, x, d, src_stride, group_size, power);
+  _group_pnorm<<<Gr,Bl, 0, cuda_current_stream()>>>(y, x, d, src_stride,
+      group_size, power);
 }
 
 void cudaD_group_spec_pnorm(dim3 Gr, dim3 Bl, double* y, const double* x,
                             MatrixDim d, int src_stride, int group_size,
                             double power) {
   if (power == double(0)) {
-    _group_transform_reduce<<<Gr, Bl>>>(y, x, d, src_stride, group_size,
+    _group_transform_reduce<<<Gr, Bl, 0, cuda_current_stream()>>>(y, x, d,
+        src_stride, group_size,
         TransReduceOp<L0NORM, double>());
   } else if (power == double(1)) {
-    _group_transform_reduce<<<Gr, Bl>>>(y, x, d, src_stride, group_size,
+    _group_transform_reduce<<<Gr, Bl, 0, cuda_current_stream()>>>(y, x, d,
+        src_stride, group_size,
         TransReduceOp<L1NORM, double>());
   } else if (power == double(2)) {
-    _group_transform_reduce<<<Gr, Bl>>>(y, x, d, src_stride, group_size,
+    _group_transform_reduce<<<Gr, Bl, 0, cuda_current_stream()>>>(y, x, d,
+        src_stride, group_size,
         TransReduceOp<L2NORM, double>());
   } else if (power == std::numeric_limits<double>::infinity()) {
-    _group_transform_reduce<<<Gr, Bl>>>(y, x, d, src_stride, group_size,
+    _group_transform_reduce<<<Gr, Bl, 0, cuda_current_stream()>>>(y, x, d,
+        src_stride, group_size,
         TransReduceOp<LINFNORM, double>());
   } else {
-    _group_transform_reduce<<<Gr, Bl>>>(y, x, d, src_stride, group_size,
+    _group_transform_reduce<<<Gr, Bl, 0, cuda_current_stream()>>>(y, x, d,
+        src_stride, group_size,
         TransReduceOp<LPNORM, double>(power));
   }
 }
 
 void cudaD_group_max(dim3 Gr, dim3 Bl, double* y, const double* x, MatrixDim d,
                      int src_stride, int group_size) {
-  _group_transform_reduce<<<Gr,Bl>>>(y, x, d, src_stride, group_size,
+  _group_transform_reduce<<<Gr,Bl, 0, cuda_current_stream()>>>(y, x, d,
+      src_stride, group_size,
       TransReduceOp<MAX, double>());
 }
 
 void cudaD_sigmoid(dim3 Gr, dim3 Bl, double* y, const double* x, MatrixDim d,
                    int src_stride) {
-  _sigmoid<<<Gr,Bl>>>(y, x, d, src_stride);
+  _sigmoid<<<Gr,Bl, 0, cuda_current_stream()>>>(y, x, d, src_stride);
 }
 
 void cudaD_diff_sigmoid(dim3 Gr, dim3 Bl, double* eout, const double* e,
                         const double* y, MatrixDim d, int e_stride,
                         int y_stride) {
-  _diff_sigmoid<<<Gr,Bl>>>(eout, e, y, d, e_stride, y_stride);
+  _diff_sigmoid<<<Gr,Bl, 0, cuda_current_stream()>>>(eout, e, y, d, e_stride,
+      y_stride);
 }
 
 void cudaD_tanh(dim3 Gr, dim3 Bl, double* y, const double* x, MatrixDim d,
                 int src_stride) {
-  _tanh<<<Gr,Bl>>>(y, x, d, src_stride);
+  _tanh<<<Gr,Bl, 0, cuda_current_stream()>>>(y, x, d, src_stride);
 }
 
 void cudaD_diff_tanh(dim3 Gr, dim3 Bl, double* eout, const double* e,
                      const double* y, MatrixDim d, int e_stride, int y_stride) {
-  _diff_tanh<<<Gr,Bl>>>(eout, e, y, d, e_stride, y_stride);
+  _diff_tanh<<<Gr,Bl, 0, cuda_current_stream()>>>(eout, e, y, d, e_stride,
+      y_stride);
 }
 
 void cudaD_ensure_nonzero(dim3 Gr, dim3 Bl, const double *x, MatrixDim d,
                           double epsilon, int y_stride, double *y) {
-  _ensure_nonzero<<<Gr,Bl>>>(x, d, epsilon, y_stride, y);
+  _ensure_nonzero<<<Gr,Bl, 0, cuda_current_stream()>>>(x, d, epsilon, y_stride,
+      y);
 }
 
 void cudaD_parametric_relu(dim3 Gr, dim3 Bl, double* y, const double* x,
                            MatrixDim d, int src_stride,
                            const double* a, const double* b) {
-  _parametric_relu<<<Gr,Bl>>>(y, x, d, src_stride, a, b);
+  _parametric_relu<<<Gr,Bl, 0, cuda_current_stream()>>>(y, x, d, src_stride, a,
+      b);
 }
 
 void cudaD_diff_parametric_relu(dim3 Gr, dim3 Bl, double* eout, const double* e,
                                 const double* y, MatrixDim d, int e_stride,
                                 int y_stride, const double* a, const double* b) {
-  _diff_parametric_relu<<<Gr,Bl>>>(eout, e, y, d, e_stride, y_stride, a, b);
+  _diff_parametric_relu<<<Gr,Bl, 0, cuda_current_stream()>>>(eout, e, y, d,
+      e_stride, y_stride, a, b);
 }
 
 void cudaD_heaviside(dim3 Gr, dim3 Bl, double* y, const double* x, MatrixDim d,
                      int src_stride) {
-  _heaviside<<<Gr,Bl>>>(y, x, d, src_stride);
+  _heaviside<<<Gr,Bl, 0, cuda_current_stream()>>>(y, x, d, src_stride);
 }
 
 void cudaD_exp(dim3 Gr, dim3 Bl, double* y, const double* x, MatrixDim d,
 	       int src_stride) {
-  _exp<<<Gr,Bl>>>(y, x, d, src_stride);
+  _exp<<<Gr,Bl, 0, cuda_current_stream()>>>(y, x, d, src_stride);
 }
 
 void cudaD_pow(dim3 Gr, dim3 Bl, double* y, const double* x, double power, MatrixDim d,
 	       int src_stride) {
-  _pow<<<Gr,Bl>>>(y, x, power, d, src_stride);
+  _pow<<<Gr,Bl, 0, cuda_current_stream()>>>(y, x, power, d, src_stride);
 }
 
 void cudaD_ceiling(dim3 Gr, dim3 Bl, double* y, const double* x, double ceiling_val,
 		   MatrixDim d, int src_stride) {
-  _ceiling<<<Gr,Bl>>>(y, x, ceiling_val, d, src_stride);
+  _ceiling<<<Gr,Bl, 0, cuda_current_stream()>>>(y, x, ceiling_val, d,
+      src_stride);
 }
 
 void cudaD_floor(dim3 Gr, dim3 Bl, double* y, const double* x, double floor_val,
 		 MatrixDim d, int src_stride) {
-  _floor<<<Gr,Bl>>>(y, x, floor_val, d, src_stride);
+  _floor<<<Gr,Bl, 0, cuda_current_stream()>>>(y, x, floor_val, d, src_stride);
 }
 
 void cudaD_exp_limited(dim3 Gr, dim3 Bl, double* y, const double* x,
 		       double lower_limit, double upper_limit, MatrixDim d, int src_stride) {
-  _exp_limited<<<Gr,Bl>>>(y, x, lower_limit, upper_limit, d, src_stride);
+  _exp_limited<<<Gr,Bl, 0, cuda_current_stream()>>>(y, x, lower_limit,
+      upper_limit, d, src_stride);
 }
 
 void cudaD_exp_special(dim3 Gr, dim3 Bl, double* y, const double* x, MatrixDim d,
 		       int src_stride) {
-  _exp_special<<<Gr, Bl>>>(y, x, d, src_stride);
+  _exp_special<<<Gr, Bl, 0, cuda_current_stream()>>>(y, x, d, src_stride);
 }
 
 void cudaD_log(dim3 Gr, dim3 Bl, double* y, const double* x, MatrixDim d, int src_stride) {
-  _log<<<Gr,Bl>>>(y, x, d, src_stride);
+  _log<<<Gr,Bl, 0, cuda_current_stream()>>>(y, x, d, src_stride);
 }
 
 void cudaD_pow_abs(dim3 Gr, dim3 Bl, double* y, const double* x, double power,
 		   bool include_sign, MatrixDim d, int src_stride) {
-  _pow_abs<<<Gr,Bl>>>(y, x, power, include_sign, d, src_stride);
+  _pow_abs<<<Gr,Bl, 0, cuda_current_stream()>>>(y, x, power, include_sign, d,
+      src_stride);
 }
 
 void cudaD_softmax_reduce(size_t Gr, size_t Bl, double* y, const double* x,
                           MatrixDim d, int src_stride) {
-  _softmax_reduce<<<Gr,Bl>>>(y, x, d, src_stride);
+  _softmax_reduce<<<Gr,Bl, 0, cuda_current_stream()>>>(y, x, d, src_stride);
 }
 
 void cudaD_log_softmax_reduce(size_t Gr, size_t Bl, double* y, const double* x,
                               MatrixDim y_dim, int x_stride) {
-  _log_softmax_reduce<<<Gr,Bl>>>(y, x, y_dim, x_stride);
+  _log_softmax_reduce<<<Gr,Bl, 0, cuda_current_stream()>>>(y, x, y_dim,
+      x_stride);
 }
 
 void cudaD_normalize_per_row(size_t Gr, size_t Bl, double *y, int y_stride,
                              const double *x, MatrixDim x_d, double target_rms,
                              bool add_log_stddev) {
-  _normalize_per_row<<<Gr, Bl>>>(y, y_stride, x, x_d, target_rms, add_log_stddev);
+  _normalize_per_row<<<Gr, Bl, 0, cuda_current_stream()>>>(y, y_stride, x, x_d,
+      target_rms, add_log_stddev);
 }
 
 void cudaD_splice(dim3 Gr, dim3 Bl, double* y, const double* x,
                   const int32_cuda* off, MatrixDim d_out, MatrixDim d_in) {
-  _splice<<<Gr,Bl>>>(y,x,off,d_out,d_in);
+  _splice<<<Gr,Bl, 0, cuda_current_stream()>>>(y,x,off,d_out,d_in);
 }
 
 void cudaD_one(int Gr, int Bl, double* x, int dim) {
-  _one<<<Gr,Bl>>>(x,dim);
+  _one<<<Gr,Bl, 0, cuda_current_stream()>>>(x,dim);
 }
 
 void cudaD_take_mean(dim3 Gr, dim3 Bl, const double* x, double* y,
                      MatrixDim d_in) {
-  _take_mean<<<Gr,Bl>>>(x,y,d_in);
+  _take_mean<<<Gr,Bl, 0, cuda_current_stream()>>>(x,y,d_in);
 }
 
 void cudaD_take_lower(dim3 Gr, dim3 Bl, const double* x, double* y,
                       MatrixDim d_in) {
-  _take_lower<<<Gr,Bl>>>(x,y,d_in);
+  _take_lower<<<Gr,Bl, 0, cuda_current_stream()>>>(x,y,d_in);
 }
 
 void cudaD_take_upper(dim3 Gr, dim3 Bl, const double* x, double* y,
                       MatrixDim d_in) {
-  _take_upper<<<Gr,Bl>>>(x,y,d_in);
+  _take_upper<<<Gr,Bl, 0, cuda_current_stream()>>>(x,y,d_in);
 }
 
 void cudaD_copy_from_sp(dim3 Gr, dim3 Bl, const double* x, double* y,
                         MatrixDim d_out) {
-  _copy_from_sp<<<Gr,Bl>>>(x,y,d_out);
+  _copy_from_sp<<<Gr,Bl, 0, cuda_current_stream()>>>(x,y,d_out);
 }
 
 void cudaD_copy(dim3 Gr, dim3 Bl, double* y, const double* x,
                 const int32_cuda* copy_from, MatrixDim d_out, MatrixDim d_in) {
-  _copy<<<Gr,Bl>>>(y,x,copy_from,d_out,d_in);
+  _copy<<<Gr,Bl, 0, cuda_current_stream()>>>(y,x,copy_from,d_out,d_in);
 }
 
 void cudaD_randomize(dim3 Gr, dim3 Bl, double* y, const double* x,
                      const int32_cuda* copy_from, MatrixDim d_out,
                      MatrixDim d_in) {
-  _randomize<<<Gr,Bl>>>(y,x,copy_from,d_out,d_in);
+  _randomize<<<Gr,Bl, 0, cuda_current_stream()>>>(y,x,copy_from,d_out,d_in);
 }
 
 void cudaD_regularize_l1(dim3 Gr, dim3 Bl, double* wei, double* grad, double l1,
                          double lr, MatrixDim d, int stride_grad) {
-  _regularize_l1<<<Gr,Bl>>>(wei,grad,l1,lr,d,stride_grad);
+  _regularize_l1<<<Gr,Bl, 0,
+      cuda_current_stream()>>>(wei,grad,l1,lr,d,stride_grad);
 }
 
 void cudaD_find_row_max_id(dim3 Gr, dim3 Bl, const double* mat, double* vec_val,
                            int32_cuda* vec_id, MatrixDim d) {
-  _find_row_max_id<<<Gr,Bl>>>(mat, vec_val, vec_id, d);
+  _find_row_max_id<<<Gr,Bl, 0, cuda_current_stream()>>>(mat, vec_val, vec_id,
+      d);
 }
 
 void cudaD_diff_xent(dim3 Gr, dim3 Bl, const int32_cuda* vec_tgt,
                      double* mat_net_out, double* vec_log_post, MatrixDim d) {
-  _diff_xent<<<Gr,Bl>>>(vec_tgt,mat_net_out,vec_log_post,d);
+  _diff_xent<<<Gr,Bl, 0,
+      cuda_current_stream()>>>(vec_tgt,mat_net_out,vec_log_post,d);
 }
 
 void cudaD_diff_softmax(dim3 Gr, dim3 Bl, double* x, const MatrixDim dim,
                         const double* value, const int value_stride,
                         const double* diff, const int diff_stride) {
-  _diff_softmax<<<Gr, Bl>>>(x, dim, value, value_stride, diff, diff_stride);
+  _diff_softmax<<<Gr, Bl, 0, cuda_current_stream()>>>(x, dim, value,
+      value_stride, diff, diff_stride);
 }
 
 void cudaD_diff_log_softmax(dim3 Gr, dim3 Bl, const MatrixDim in_deriv_dim,
                             const double* out_value, const int out_value_stride,
                             const double* out_deriv, const int out_deriv_stride,
                             double* in_deriv) {
-  _diff_log_softmax<<<Gr, Bl>>>(in_deriv_dim, out_value, out_value_stride,
+  _diff_log_softmax<<<Gr, Bl, 0, cuda_current_stream()>>>(in_deriv_dim,
+      out_value, out_value_stride,
       out_deriv, out_deriv_stride, in_deriv);
 }
 
 void cudaD_copy_rows_from_vec(dim3 Gr, dim3 Bl, double *mat_out,
                               MatrixDim d_out, const double *v_in) {
-  _copy_rows_from_vec<<<Gr,Bl>>>(mat_out, d_out, v_in);
+  _copy_rows_from_vec<<<Gr,Bl, 0, cuda_current_stream()>>>(mat_out, d_out,
+      v_in);
 }
 
 void cudaD_sum_column_ranges(dim3 Gr, dim3 Bl, double *data, MatrixDim dim,
                              const double *src_data, MatrixDim src_dim,
                              const Int32Pair *indices) {
-  _sum_column_ranges<<<Gr,Bl>>>(data, dim, src_data, src_dim, indices);
+  _sum_column_ranges<<<Gr,Bl, 0, cuda_current_stream()>>>(data, dim, src_data,
+      src_dim, indices);
 }
 
 void cudaD_add_row_ranges(dim3 Gr, dim3 Bl, double *data, MatrixDim dim,
                           const double *src_data, MatrixDim src_dim,
                           const Int32Pair *indexes) {
-  _add_row_ranges<<<Gr,Bl>>>(data, dim, src_data, src_dim, indexes);
+  _add_row_ranges<<<Gr,Bl, 0, cuda_current_stream()>>>(data, dim, src_data,
+      src_dim, indexes);
 }
 
 void cudaD_matrix_lookup(dim3 Gr, dim3 Bl, const double *data, MatrixDim dim,
                          const Int32Pair *indices, int indices_size,
                          double *output) {
-  _matrix_lookup<<<Gr,Bl>>>(data, dim, indices, indices_size, output);
+  _matrix_lookup<<<Gr,Bl, 0, cuda_current_stream()>>>(data, dim, indices,
+      indices_size, output);
 }
 
 void cudaD_equal_element_mask(dim3 Gr, dim3 Bl, const double *mat1,
                               const double *mat2, double *mask,
                               MatrixDim mat1_dim, int mat2_stride,
                               int mask_stride) {
-  _equal_element_mask<<<Gr,Bl>>>(mat1, mat2, mask, mat1_dim, mat2_stride,
+  _equal_element_mask<<<Gr,Bl, 0, cuda_current_stream()>>>(mat1, mat2, mask,
+      mat1_dim, mat2_stride,
       mask_stride);
 }
 
@@ -5123,129 +5299,149 @@ void cudaD_equal_element_mask(dim3 Gr, dim3 Bl, const double *mat1,
 void cuda_copy_from_mat_df(dim3 Gr, dim3 Bl, double* mat_out,
                            const float* mat_in, MatrixDim d_out,
                            MatrixDim d_in) {
-  _copy_from_mat<<<Gr,Bl>>>(mat_out,mat_in,d_out,d_in);
+  _copy_from_mat<<<Gr,Bl, 0,
+      cuda_current_stream()>>>(mat_out,mat_in,d_out,d_in);
 }
 
 void cuda_copy_from_mat_ff(dim3 Gr, dim3 Bl, float* mat_out,
                            const float* mat_in, MatrixDim d_out,
                            MatrixDim d_in) {
-  _copy_from_mat<<<Gr,Bl>>>(mat_out,mat_in,d_out,d_in);
+  _copy_from_mat<<<Gr,Bl, 0,
+      cuda_current_stream()>>>(mat_out,mat_in,d_out,d_in);
 }
 
 void cuda_copy_from_mat_fd(dim3 Gr, dim3 Bl, float *mat_out,
                            const double* mat_in, MatrixDim d_out,
                            MatrixDim d_in) {
-  _copy_from_mat<<<Gr,Bl>>>(mat_out,mat_in,d_out,d_in);
+  _copy_from_mat<<<Gr,Bl, 0,
+      cuda_current_stream()>>>(mat_out,mat_in,d_out,d_in);
 }
 
 void cuda_copy_from_mat_dd(dim3 Gr, dim3 Bl, double *mat_out,
                            const double* mat_in, MatrixDim d_out,
                            MatrixDim d_in) {
-  _copy_from_mat<<<Gr,Bl>>>(mat_out,mat_in,d_out,d_in);
+  _copy_from_mat<<<Gr,Bl, 0,
+      cuda_current_stream()>>>(mat_out,mat_in,d_out,d_in);
 }
 
 void cuda_copy_from_mat_df_trans(dim3 Gr, dim3 Bl, double* mat_out,
                                  const float* mat_in, MatrixDim d_out,
                                  MatrixDim d_in) {
-  _copy_from_mat_trans<32> <<<Gr,Bl>>>(mat_out,mat_in,d_out,d_in);
+  _copy_from_mat_trans<32> <<<Gr,Bl, 0,
+      cuda_current_stream()>>>(mat_out,mat_in,d_out,d_in);
 }
 
 void cuda_copy_from_mat_ff_trans(dim3 Gr, dim3 Bl, float* mat_out,
                                  const float* mat_in, MatrixDim d_out,
                                  MatrixDim d_in) {
-  _copy_from_mat_trans<32> <<<Gr,Bl>>>(mat_out,mat_in,d_out,d_in);
+  _copy_from_mat_trans<32> <<<Gr,Bl, 0,
+      cuda_current_stream()>>>(mat_out,mat_in,d_out,d_in);
 }
 
 void cuda_copy_from_mat_fd_trans(dim3 Gr, dim3 Bl, float *mat_out,
                                  const double* mat_in, MatrixDim d_out,
                                  MatrixDim d_in) {
-  _copy_from_mat_trans<32> <<<Gr,Bl>>>(mat_out,mat_in,d_out,d_in);
+  _copy_from_mat_trans<32> <<<Gr,Bl, 0,
+      cuda_current_stream()>>>(mat_out,mat_in,d_out,d_in);
 }
 
 void cuda_copy_from_mat_dd_trans(dim3 Gr, dim3 Bl, double *mat_out,
                                  const double* mat_in, MatrixDim d_out,
                                  MatrixDim d_in) {
-  _copy_from_mat_trans<32> <<<Gr,Bl>>>(mat_out,mat_in,d_out,d_in);
+  _copy_from_mat_trans<32> <<<Gr,Bl, 0,
+      cuda_current_stream()>>>(mat_out,mat_in,d_out,d_in);
 }
 
 void cuda_copy_from_smat_ff(dim3 Gr, dim3 Bl, float* mat, MatrixDim mat_dim,
                             const int* smat_row_ptr, const int* smat_col_idx,
                             const float* smat_val) {
-  _copy_from_smat<<<Gr, Bl>>>(mat, mat_dim, smat_row_ptr, smat_col_idx,
+  _copy_from_smat<<<Gr, Bl, 0, cuda_current_stream()>>>(mat, mat_dim,
+      smat_row_ptr, smat_col_idx,
                               smat_val);
 }
 void cuda_copy_from_smat_fd(dim3 Gr, dim3 Bl, float* mat, MatrixDim mat_dim,
                             const int* smat_row_ptr, const int* smat_col_idx,
                             const double* smat_val) {
-  _copy_from_smat<<<Gr, Bl>>>(mat, mat_dim, smat_row_ptr, smat_col_idx,
+  _copy_from_smat<<<Gr, Bl, 0, cuda_current_stream()>>>(mat, mat_dim,
+      smat_row_ptr, smat_col_idx,
                               smat_val);
 }
 void cuda_copy_from_smat_df(dim3 Gr, dim3 Bl, double* mat, MatrixDim mat_dim,
                             const int* smat_row_ptr, const int* smat_col_idx,
                             const float* smat_val) {
-  _copy_from_smat<<<Gr, Bl>>>(mat, mat_dim, smat_row_ptr, smat_col_idx,
+  _copy_from_smat<<<Gr, Bl, 0, cuda_current_stream()>>>(mat, mat_dim,
+      smat_row_ptr, smat_col_idx,
                               smat_val);
 }
 void cuda_copy_from_smat_dd(dim3 Gr, dim3 Bl, double* mat, MatrixDim mat_dim,
                             const int* smat_row_ptr, const int* smat_col_idx,
                             const double* smat_val) {
-  _copy_from_smat<<<Gr, Bl>>>(mat, mat_dim, smat_row_ptr, smat_col_idx,
+  _copy_from_smat<<<Gr, Bl, 0, cuda_current_stream()>>>(mat, mat_dim,
+      smat_row_ptr, smat_col_idx,
                               smat_val);
 }
 void cuda_copy_from_smat_ff_trans(dim3 Gr, dim3 Bl, float* mat,
                                   MatrixDim mat_dim, const int* smat_row_ptr,
                                   const int* smat_col_idx,
                                   const float* smat_val) {
-  _copy_from_smat_trans<<<Gr, Bl>>>(mat, mat_dim, smat_row_ptr, smat_col_idx,
+  _copy_from_smat_trans<<<Gr, Bl, 0, cuda_current_stream()>>>(mat, mat_dim,
+      smat_row_ptr, smat_col_idx,
                                     smat_val);
 }
 void cuda_copy_from_smat_fd_trans(dim3 Gr, dim3 Bl, float* mat,
                                   MatrixDim mat_dim, const int* smat_row_ptr,
                                   const int* smat_col_idx,
                                   const double* smat_val) {
-  _copy_from_smat_trans<<<Gr, Bl>>>(mat, mat_dim, smat_row_ptr, smat_col_idx,
+  _copy_from_smat_trans<<<Gr, Bl, 0, cuda_current_stream()>>>(mat, mat_dim,
+      smat_row_ptr, smat_col_idx,
                                     smat_val);
 }
 void cuda_copy_from_smat_df_trans(dim3 Gr, dim3 Bl, double* mat,
                                   MatrixDim mat_dim, const int* smat_row_ptr,
                                   const int* smat_col_idx,
                                   const float* smat_val) {
-  _copy_from_smat_trans<<<Gr, Bl>>>(mat, mat_dim, smat_row_ptr, smat_col_idx,
+  _copy_from_smat_trans<<<Gr, Bl, 0, cuda_current_stream()>>>(mat, mat_dim,
+      smat_row_ptr, smat_col_idx,
                                     smat_val);
 }
 void cuda_copy_from_smat_dd_trans(dim3 Gr, dim3 Bl, double* mat,
                                   MatrixDim mat_dim, const int* smat_row_ptr,
                                   const int* smat_col_idx,
                                   const double* smat_val) {
-  _copy_from_smat_trans<<<Gr, Bl>>>(mat, mat_dim, smat_row_ptr, smat_col_idx,
+  _copy_from_smat_trans<<<Gr, Bl, 0, cuda_current_stream()>>>(mat, mat_dim,
+      smat_row_ptr, smat_col_idx,
                                     smat_val);
 }
 
 void cudaF_trace_mat_smat(dim3 Gr, dim3 Bl, const float* mat, MatrixDim mat_dim,
                           const int* smat_row_ptr, const int* smat_col_idx,
                           const float* smat_val, float* trace_vec) {
-  _trace_mat_smat<<<Gr, Bl>>>(mat, mat_dim, smat_row_ptr, smat_col_idx,
+  _trace_mat_smat<<<Gr, Bl, 0, cuda_current_stream()>>>(mat, mat_dim,
+      smat_row_ptr, smat_col_idx,
                               smat_val, trace_vec);
 }
 void cudaF_trace_mat_smat_trans(dim3 Gr, dim3 Bl, const float* mat,
                                 MatrixDim mat_dim, const int* smat_row_ptr,
                                 const int* smat_col_idx, const float* smat_val,
                                 float* trace_vec) {
-  _trace_mat_smat_trans<<<Gr, Bl>>>(mat, mat_dim, smat_row_ptr, smat_col_idx,
+  _trace_mat_smat_trans<<<Gr, Bl, 0, cuda_current_stream()>>>(mat, mat_dim,
+      smat_row_ptr, smat_col_idx,
                                     smat_val, trace_vec);
 }
 void cudaD_trace_mat_smat(dim3 Gr, dim3 Bl, const double* mat,
                           MatrixDim mat_dim, const int* smat_row_ptr,
                           const int* smat_col_idx, const double* smat_val,
                           double* trace_vec) {
-  _trace_mat_smat<<<Gr, Bl>>>(mat, mat_dim, smat_row_ptr, smat_col_idx,
+  _trace_mat_smat<<<Gr, Bl, 0, cuda_current_stream()>>>(mat, mat_dim,
+      smat_row_ptr, smat_col_idx,
                               smat_val, trace_vec);
 }
 void cudaD_trace_mat_smat_trans(dim3 Gr, dim3 Bl, const double* mat,
                                 MatrixDim mat_dim, const int* smat_row_ptr,
                                 const int* smat_col_idx, const double* smat_val,
                                 double* trace_vec) {
-  _trace_mat_smat_trans<<<Gr, Bl>>>(mat, mat_dim, smat_row_ptr, smat_col_idx,
+  _trace_mat_smat_trans<<<Gr, Bl, 0, cuda_current_stream()>>>(mat, mat_dim,
+      smat_row_ptr, smat_col_idx,
                                     smat_val, trace_vec);
 }
 
@@ -5254,7 +5450,7 @@ void cudaD_lstm_nonlinearity(dim3 Gr, dim3 Bl, const double* in,
                              const int params_stride, const int out_stride,
                              const int cell_dim, const int have_dropout_mask,
                              const int num_rows, double* out) {
-  _lstm_nonlinearity<<<Gr, Bl>>>(
+  _lstm_nonlinearity<<<Gr, Bl, 0, cuda_current_stream()>>>(
       in, in_stride, params, params_stride,
       out_stride, cell_dim, have_dropout_mask, num_rows, out);
 }
@@ -5263,7 +5459,7 @@ void cudaF_lstm_nonlinearity(dim3 Gr, dim3 Bl, const float* in,
                              const int params_stride, const int out_stride,
                              const int cell_dim, const int have_dropout_mask,
                              const int num_rows, float* out) {
-  _lstm_nonlinearity<<<Gr, Bl>>>(
+  _lstm_nonlinearity<<<Gr, Bl, 0, cuda_current_stream()>>>(
       in, in_stride, params, params_stride,
       out_stride, cell_dim, have_dropout_mask, num_rows, out);
 }
@@ -5287,7 +5483,7 @@ void cudaD_diff_lstm_nonlinearity(dim3 Gr, dim3 Bl, const int cell_dim,
                                   const int deriv_sum_out_stride,
                                   double* self_repair_sum_out,
                                   const int self_repair_sum_out_stride) {
-  _diff_lstm_nonlinearity<<<Gr, Bl>>>(
+  _diff_lstm_nonlinearity<<<Gr, Bl, 0, cuda_current_stream()>>>(
       cell_dim, have_dropout_mask, num_rows, input,
       input_stride, params, params_stride, output_deriv, output_deriv_stride,
       deriv_sum_in, deriv_sum_in_stride, self_repair_config, count, input_deriv,
@@ -5315,7 +5511,7 @@ void cudaF_diff_lstm_nonlinearity(dim3 Gr, dim3 Bl, const int cell_dim,
                                   const int deriv_sum_out_stride,
                                   float* self_repair_sum_out,
                                   const int self_repair_sum_out_stride) {
-  _diff_lstm_nonlinearity<<<Gr, Bl>>>(
+  _diff_lstm_nonlinearity<<<Gr, Bl, 0, cuda_current_stream()>>>(
       cell_dim, have_dropout_mask, num_rows, input,
       input_stride, params, params_stride, output_deriv, output_deriv_stride,
       deriv_sum_in, deriv_sum_in_stride, self_repair_config, count, input_deriv,
@@ -5327,11 +5523,13 @@ void cudaF_diff_lstm_nonlinearity(dim3 Gr, dim3 Bl, const int cell_dim,
 
 void cudaD_copy_cols_from_vec(dim3 Gr, dim3 Bl, double *mat_out,
                               MatrixDim d_out, const double *v_in) {
-  _copy_cols_from_vec<<<Gr, Bl>>>(mat_out, d_out, v_in);
+  _copy_cols_from_vec<<<Gr, Bl, 0, cuda_current_stream()>>>(mat_out, d_out,
+      v_in);
 }
 void cudaF_copy_cols_from_vec(dim3 Gr, dim3 Bl, float *mat_out, MatrixDim d_out,
                               const float *v_in) {
-  _copy_cols_from_vec<<<Gr, Bl>>>(mat_out, d_out, v_in);
+  _copy_cols_from_vec<<<Gr, Bl, 0, cuda_current_stream()>>>(mat_out, d_out,
+      v_in);
 }
 
 void cudaF_diff_normalize_per_row(size_t Gr, size_t Bl, float *id,
@@ -5339,7 +5537,8 @@ void cudaF_diff_normalize_per_row(size_t Gr, size_t Bl, float *id,
                                   MatrixDim iv_dim, const float* od,
                                   int od_stride, float target_rms,
                                   bool add_log_stddev) {
-  _diff_normalize_per_row<<<Gr, Bl>>>(id, id_stride, iv, iv_dim, od, od_stride,
+  _diff_normalize_per_row<<<Gr, Bl, 0, cuda_current_stream()>>>(id, id_stride,
+      iv, iv_dim, od, od_stride,
                                       target_rms, add_log_stddev);
 }
 void cudaD_diff_normalize_per_row(size_t Gr, size_t Bl, double *id,
@@ -5347,7 +5546,8 @@ void cudaD_diff_normalize_per_row(size_t Gr, size_t Bl, double *id,
                                   MatrixDim iv_dim, const double* od,
                                   int od_stride, double target_rms,
                                   bool add_log_stddev) {
-  _diff_normalize_per_row<<<Gr, Bl>>>(id, id_stride, iv, iv_dim, od, od_stride,
+  _diff_normalize_per_row<<<Gr, Bl, 0, cuda_current_stream()>>>(id, id_stride,
+      iv, iv_dim, od, od_stride,
                                       target_rms, add_log_stddev);
 }
 void cudaD_select_rows(dim3 Gr, dim3 Bl, const int* out_row_ptr,
@@ -5355,44 +5555,51 @@ void cudaD_select_rows(dim3 Gr, dim3 Bl, const int* out_row_ptr,
                        const int* row_indexes, const int num_selected_rows,
                        const int* in_row_ptr, const int* in_col_idx,
                        const double* in_val) {
-  _select_rows<<<Gr, Bl>>>(out_row_ptr, out_col_idx, out_val, row_indexes,
+  _select_rows<<<Gr, Bl, 0, cuda_current_stream()>>>(out_row_ptr, out_col_idx,
+      out_val, row_indexes,
                            num_selected_rows, in_row_ptr, in_col_idx, in_val);
 }
 void cudaF_select_rows(dim3 Gr, dim3 Bl, const int* out_row_ptr,
                        int* out_col_idx, float* out_val, const int* row_indexes,
                        const int num_selected_rows, const int* in_row_ptr,
                        const int* in_col_idx, const float* in_val) {
-  _select_rows<<<Gr, Bl>>>(out_row_ptr, out_col_idx, out_val, row_indexes,
+  _select_rows<<<Gr, Bl, 0, cuda_current_stream()>>>(out_row_ptr, out_col_idx,
+      out_val, row_indexes,
                            num_selected_rows, in_row_ptr, in_col_idx, in_val);
 }
 void cudaD_add_smat(dim3 Gr, dim3 Bl, double* mat, MatrixDim mat_dim,
                     double alpha, const int* smat_row_ptr,
                     const int* smat_col_idx, const double* smat_val) {
-  _add_smat<<<Gr, Bl>>>(mat, mat_dim, alpha, smat_row_ptr, smat_col_idx,
+  _add_smat<<<Gr, Bl, 0, cuda_current_stream()>>>(mat, mat_dim, alpha,
+      smat_row_ptr, smat_col_idx,
                         smat_val);
 }
 void cudaF_add_smat(dim3 Gr, dim3 Bl, float* mat, MatrixDim mat_dim,
                     float alpha, const int* smat_row_ptr,
                     const int* smat_col_idx, const float* smat_val) {
-  _add_smat<<<Gr, Bl>>>(mat, mat_dim, alpha, smat_row_ptr, smat_col_idx,
+  _add_smat<<<Gr, Bl, 0, cuda_current_stream()>>>(mat, mat_dim, alpha,
+      smat_row_ptr, smat_col_idx,
                         smat_val);
 }
 void cudaD_add_smat_trans(dim3 Gr, dim3 Bl, double* mat, MatrixDim mat_dim,
                           double alpha, const int* smat_row_ptr,
                           const int* smat_col_idx, const double* smat_val) {
-  _add_smat_trans<<<Gr, Bl>>>(mat, mat_dim, alpha, smat_row_ptr, smat_col_idx,
+  _add_smat_trans<<<Gr, Bl, 0, cuda_current_stream()>>>(mat, mat_dim, alpha,
+      smat_row_ptr, smat_col_idx,
                               smat_val);
 }
 void cudaF_add_smat_trans(dim3 Gr, dim3 Bl, float* mat, MatrixDim mat_dim,
                           float alpha, const int* smat_row_ptr,
                           const int* smat_col_idx, const float* smat_val) {
-  _add_smat_trans<<<Gr, Bl>>>(mat, mat_dim, alpha, smat_row_ptr, smat_col_idx,
+  _add_smat_trans<<<Gr, Bl, 0, cuda_current_stream()>>>(mat, mat_dim, alpha,
+      smat_row_ptr, smat_col_idx,
                               smat_val);
 }
 
 void cuda_compress_uint8_sign(dim3 Gr, dim3 Bl, const BaseFloat *src, MatrixDim dim,
                               unsigned char *dest, int dest_stride) {
-  _cuda_compress_uint8_sign<<<Gr, Bl>>>(src, dim, dest, dest_stride);
+  _cuda_compress_uint8_sign<<<Gr, Bl, 0, cuda_current_stream()>>>(src, dim,
+      dest, dest_stride);
 }
 
 void cuda_compress_int16(dim3 Gr, dim3 Bl, const BaseFloat *src,
@@ -5400,9 +5607,11 @@ void cuda_compress_int16(dim3 Gr, dim3 Bl, const BaseFloat *src,
                          int dest_stride, float inv_scale,
                          bool bounds_check) {
   if (bounds_check) {
-    _cuda_compress_bounds_check<<<Gr, Bl>>>(src, dim, dest, dest_stride, inv_scale);
+    _cuda_compress_bounds_check<<<Gr, Bl, 0, cuda_current_stream()>>>(src, dim,
+        dest, dest_stride, inv_scale);
   } else {
-    _cuda_compress_no_bounds_check<<<Gr, Bl>>>(src, dim, dest, dest_stride, inv_scale);
+    _cuda_compress_no_bounds_check<<<Gr, Bl, 0, cuda_current_stream()>>>(src,
+        dim, dest, dest_stride, inv_scale);
   }
 }
 void cuda_compress_uint16(dim3 Gr, dim3 Bl, const BaseFloat *src,
@@ -5410,9 +5619,11 @@ void cuda_compress_uint16(dim3 Gr, dim3 Bl, const BaseFloat *src,
                          int dest_stride, float inv_scale,
                          bool bounds_check) {
   if (bounds_check) {
-    _cuda_compress_bounds_check<<<Gr, Bl>>>(src, dim, dest, dest_stride, inv_scale);
+    _cuda_compress_bounds_check<<<Gr, Bl, 0, cuda_current_stream()>>>(src, dim,
+        dest, dest_stride, inv_scale);
   } else {
-    _cuda_compress_no_bounds_check<<<Gr, Bl>>>(src, dim, dest, dest_stride, inv_scale);
+    _cuda_compress_no_bounds_check<<<Gr, Bl, 0, cuda_current_stream()>>>(src,
+        dim, dest, dest_stride, inv_scale);
   }
 }
 void cuda_compress_int8(dim3 Gr, dim3 Bl, const BaseFloat *src,
@@ -5420,9 +5631,11 @@ void cuda_compress_int8(dim3 Gr, dim3 Bl, const BaseFloat *src,
                          int dest_stride, float inv_scale,
                          bool bounds_check) {
   if (bounds_check) {
-    _cuda_compress_bounds_check<<<Gr, Bl>>>(src, dim, dest, dest_stride, inv_scale);
+    _cuda_compress_bounds_check<<<Gr, Bl, 0, cuda_current_stream()>>>(src, dim,
+        dest, dest_stride, inv_scale);
   } else {
-    _cuda_compress_no_bounds_check<<<Gr, Bl>>>(src, dim, dest, dest_stride, inv_scale);
+    _cuda_compress_no_bounds_check<<<Gr, Bl, 0, cuda_current_stream()>>>(src,
+        dim, dest, dest_stride, inv_scale);
   }
 }
 void cuda_compress_uint8(dim3 Gr, dim3 Bl, const BaseFloat *src,
@@ -5430,33 +5643,44 @@ void cuda_compress_uint8(dim3 Gr, dim3 Bl, const BaseFloat *src,
                          int dest_stride, float inv_scale,
                          bool bounds_check) {
   if (bounds_check) {
-    _cuda_compress_bounds_check<<<Gr, Bl>>>(src, dim, dest, dest_stride, inv_scale);
+    _cuda_compress_bounds_check<<<Gr, Bl, 0, cuda_current_stream()>>>(src, dim,
+        dest, dest_stride, inv_scale);
   } else {
-    _cuda_compress_no_bounds_check<<<Gr, Bl>>>(src, dim, dest, dest_stride, inv_scale);
+    _cuda_compress_no_bounds_check<<<Gr, Bl, 0, cuda_current_stream()>>>(src,
+        dim, dest, dest_stride, inv_scale);
   }
 }
 
 void cuda_uncompress_uint8(dim3 Gr, dim3 Bl, BaseFloat *dest,
                            MatrixDim dim, const uint8_t *src,
                            int src_stride, float scale) {
-  _cuda_uncompress<<<Gr, Bl>>>(dest, dim, src, src_stride, scale);
+  _cuda_uncompress<<<Gr, Bl, 0, cuda_current_stream()>>>(dest, dim, src,
+      src_stride, scale);
 }
 void cuda_uncompress_int8(dim3 Gr, dim3 Bl, BaseFloat *dest,
                            MatrixDim dim, const int8_t *src,
                            int src_stride, float scale) {
-  _cuda_uncompress<<<Gr, Bl>>>(dest, dim, src, src_stride, scale);
+  _cuda_uncompress<<<Gr, Bl, 0, cuda_current_stream()>>>(dest, dim, src,
+      src_stride, scale);
 }
 void cuda_uncompress_uint16(dim3 Gr, dim3 Bl, BaseFloat *dest,
                             MatrixDim dim, const uint16_t *src,
                             int src_stride, float scale) {
-  _cuda_uncompress<<<Gr, Bl>>>(dest, dim, src, src_stride, scale);
+  _cuda_uncompress<<<Gr, Bl, 0, cuda_current_stream()>>>(dest, dim, src,
+      src_stride, scale);
 }
 void cuda_uncompress_int16(dim3 Gr, dim3 Bl, BaseFloat *dest,
                            MatrixDim dim, const int16_t *src,
                            int src_stride, float scale) {
-  _cuda_uncompress<<<Gr, Bl>>>(dest, dim, src, src_stride, scale);
+  _cuda_uncompress<<<Gr, Bl, 0, cuda_current_stream()>>>(dest, dim, src,
+      src_stride, scale);
 }
 
+void cuda_uncompress_compressed_matrix(dim3 Gr, dim3 Bl, BaseFloat *dest,
+                                       MatrixDim dim, const void *src) {
+  _cuda_uncompress_compressed_matrix<<<Gr, Bl, 0, cuda_current_stream()>>>(
+      dest, dim, src);
+}
 
 // Launches a kernel that does nothing, explicitly using the legacy default stream;
 // this will synchronize all threads without blocking.
@@ -5474,7 +5698,8 @@ void cudaF_mat_copy_range_clamped(
   dim3 threads(32,32);
   dim3 blocks((num_cols+31)/32,(num_rows+31)/32);
 
-  _cuda_mat_copy_range_clamped<float><<<blocks,threads>>>(row_start, row_end, num_cols,
+  _cuda_mat_copy_range_clamped<float><<<blocks,threads, 0,
+      cuda_current_stream()>>>(row_start, row_end, num_cols,
       src, lds, clamp_low, clamp_high, dst, ldd);
 }
 
@@ -5488,7 +5713,8 @@ void cudaD_mat_copy_range_clamped(
   dim3 threads(32,32);
   dim3 blocks((num_cols+31)/32,(num_rows+31)/32);
 
-  _cuda_mat_copy_range_clamped<double><<<blocks,threads>>>(row_start, row_end, num_cols,
+  _cuda_mat_copy_range_clamped<double><<<blocks,threads, 0,
+      cuda_current_stream()>>>(row_start, row_end, num_cols,
       src, lds, clamp_low, clamp_high, dst, ldd);
 }
 
@@ -5530,7 +5756,8 @@ void cudaF_batched_copy_mats(int32_t num_mats, int32_t *num_rows,
       // through paramter passing and live in constant memory
       
       // launch batch
-       _cuda_batch_copy_mats<<<blocks,threads>>>(batch_desc);
+       _cuda_batch_copy_mats<<<blocks,threads, 0,
+           cuda_current_stream()>>>(batch_desc);
 
        // reset total counters
        total_rows=0;
@@ -5553,7 +5780,8 @@ void cudaF_batched_copy_mats(int32_t num_mats, int32_t *num_rows,
       // through paramter passing and live in constant memory
 
       // launch batch
-       _cuda_batch_copy_mats<<<blocks,threads>>>(batch_desc);
+       _cuda_batch_copy_mats<<<blocks,threads, 0,
+           cuda_current_stream()>>>(batch_desc);
   }
 }
 
@@ -5595,7 +5823,8 @@ void cudaD_batched_copy_mats(int32_t num_mats, int32_t *num_rows,
       // through paramter passing and live in constant memory
       
       // launch batch
-       _cuda_batch_copy_mats<<<blocks,threads>>>(batch_desc);
+       _cuda_batch_copy_mats<<<blocks,threads, 0,
+           cuda_current_stream()>>>(batch_desc);
 
        // reset total counters
        total_rows=0;
@@ -5618,6 +5847,7 @@ void cudaD_batched_copy_mats(int32_t num_mats, int32_t *num_rows,
       // through paramter passing and live in constant memory
 
       // launch batch
-       _cuda_batch_copy_mats<<<blocks,threads>>>(batch_desc);
+       _cuda_batch_copy_mats<<<blocks,threads, 0,
+           cuda_current_stream()>>>(batch_desc);
   }
 }
@@ -1829,6 +1829,48 @@ static void UnitTestCuMatrixCopyFromMat() {
   }
 }
 
+template<typename Real>
+static void UnitTestCuMatrixCopyFromGeneralMat() {
+  for (int32 i = 1; i < 10; i++) {
+    MatrixIndexT rows = 5 * i + Rand() % 10, cols = 3 * i + Rand() % 10;
+    Matrix<Real> A(rows, cols);
+    A.SetRandn();
+    // Tests all the formats of CompressedMatrix.
+    CompressionMethod method = static_cast<CompressionMethod>(1 + i % 7);
+    GeneralMatrix G;
+    CompressedMatrix C(A, method);
+    G.SwapCompressedMatrix(&C);
+    Matrix<Real> B(rows, cols);
+    G.GetCompressedMatrix().CopyToMat(&B);
+    CuMatrix<Real> D(rows, cols, kUndefined);
+    D.CopyFromGeneralMat(G);
+    Matrix<Real> E(D);
+    KALDI_ASSERT(B.ApproxEqual(E, 1.0e-05));
+  }
+}
+
+template<typename Real>
+static void UnitTestCuMatrixCopyAsync() {
+  for (int32 i = 1; i < 10; i++) {
+    MatrixIndexT rows = 5 * i + Rand() % 10, cols = 3 * i + Rand() % 10;
+    Matrix<Real> A(rows, cols);
+    A.SetRandn();
+    CuPinnedMatrix<Real> B(rows, cols), D(rows, cols);
+    B.CopyFromMat(A);
+    CuMatrix<Real> C(rows, cols);
+    C.CopyFromMatAsync(B);
+    C.Scale(2.0);
+    C.CopyToMatAsync(&D);
+    CuEvent done;
+    done.Record();
+    done.Synchronize();
+    A.Scale(2.0);
+    KALDI_ASSERT(ApproxEqual(A, Matrix<Real>(D)));
+    B.Resize(cols, rows);
+    KALDI_ASSERT(B.NumRows() == cols && B.NumCols() == rows);
+  }
+}
+
 template<typename Real>
 static void UnitTestCuMatrixCopyFromTp() {
   for (int32 i = 1; i < 10; i++) {
@@ -2986,6 +3028,8 @@ template<typename Real> void CudaMatrixUnitTest() {
   UnitTestCuMatrixAddMatMatBatched<Real>();
   UnitTestCuMatrixSymInvertPosDef<Real>();
   UnitTestCuMatrixCopyFromMat<Real>();
+  UnitTestCuMatrixCopyFromGeneralMat<Real>();
+  UnitTestCuMatrixCopyAsync<Real>();
   UnitTestCuMatrixCopyFromTp<Real>();
   UnitTestCuMatrixAddMatTp<Real>();
   UnitTestCuMatrixCopyCols<Real>();
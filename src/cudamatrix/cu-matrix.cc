@@ -32,6 +32,7 @@
 #endif
 
 #include "base/timer.h"
+#include "matrix/param-blob.h"
 #include "cudamatrix/cu-common.h"
 #include "cudamatrix/cu-vector.h"
 #include "cudamatrix/cu-device.h"
@@ -233,7 +234,7 @@ void CuMatrixBase<Real>::CopyFromMat(const CuMatrixBase<OtherReal> &M,
       CU_SAFE_CALL(
         cudaMemcpy2DAsync(data_, dst_pitch, M.data_, src_pitch,
                           width, M.num_rows_, cudaMemcpyDeviceToDevice,
-                          cudaStreamPerThread));
+                          GetCudaStream()));
     } else {
       if (trans == kNoTrans) {
         dim3 dimGrid, dimBlock;
@@ -324,8 +325,8 @@ void CuMatrixBase<Real>::CopyFromMat(const MatrixBase<Real> &src,
       MatrixIndexT width = src.NumCols()*sizeof(Real);
       CU_SAFE_CALL(cudaMemcpy2DAsync(data_, dst_pitch, src.Data(), src_pitch,
                                 width, src.NumRows(), cudaMemcpyHostToDevice,
-                                cudaStreamPerThread));
-      CU_SAFE_CALL(cudaStreamSynchronize(cudaStreamPerThread));
+                                GetCudaStream()));
+      CU_SAFE_CALL(cudaStreamSynchronize(GetCudaStream()));
 
       CuDevice::Instantiate().AccuProfile("CuMatrixBase::CopyFromMat(from CPU)", tim);
     } else {
@@ -461,8 +462,8 @@ void CuMatrixBase<Real>::CopyToMat(MatrixBase<OtherReal> *dst,
       MatrixIndexT width = NumCols()*sizeof(Real);
       CU_SAFE_CALL(cudaMemcpy2DAsync(dst->Data(), dst_pitch, this->data_, 
                                      src_pitch, width, this->num_rows_, 
-                                     cudaMemcpyDeviceToHost, cudaStreamPerThread));
-      CU_SAFE_CALL(cudaStreamSynchronize(cudaStreamPerThread));
+                                     cudaMemcpyDeviceToHost, GetCudaStream()));
+      CU_SAFE_CALL(cudaStreamSynchronize(GetCudaStream()));
       CuDevice::Instantiate().AccuProfile("CuMatrix::CopyToMatD2H", tim);
     }
   } else
@@ -487,11 +488,67 @@ void CuMatrixBase<double>::CopyToMat(MatrixBase<double> *dst,
                                      MatrixTransposeType trans) const;
 
 
+template<typename Real>
+void CuMatrixBase<Real>::CopyFromMatAsync(const MatrixBase<Real> &src) {
+  KALDI_ASSERT(src.NumRows() == num_rows_ && src.NumCols() == num_cols_);
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled()) {
+    if (num_rows_ == 0) return;
+    CuTimer tim;
+    CU_SAFE_CALL(cudaMemcpy2DAsync(data_, stride_ * sizeof(Real), src.Data(),
+                                   src.Stride() * sizeof(Real),
+                                   num_cols_ * sizeof(Real), num_rows_,
+                                   cudaMemcpyHostToDevice, GetCudaStream()));
+    CuDevice::Instantiate().AccuProfile("CuMatrixBase::CopyFromMatAsync", tim);
+  } else
+#endif
+  {
+    Mat().CopyFromMat(src);
+  }
+}
+
+template<typename Real>
+void CuMatrixBase<Real>::CopyToMatAsync(MatrixBase<Real> *dst) const {
+  KALDI_ASSERT(dst->NumRows() == num_rows_ && dst->NumCols() == num_cols_);
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled()) {
+    if (num_rows_ == 0) return;
+    CuTimer tim;
+    CU_SAFE_CALL(cudaMemcpy2DAsync(dst->Data(), dst->Stride() * sizeof(Real),
+                                   data_, stride_ * sizeof(Real),
+                                   num_cols_ * sizeof(Real), num_rows_,
+                                   cudaMemcpyDeviceToHost, GetCudaStream()));
+    CuDevice::Instantiate().AccuProfile("CuMatrixBase::CopyToMatAsync", tim);
+  } else
+#endif
+  {
+    dst->CopyFromMat(Mat());
+  }
+}
+
+
 
 
 
 template<typename Real>
 void CuMatrix<Real>::Read(std::istream &is, bool binary) {
+  const ParamBlob *blob = ParamBlob::CurrentReadBlob();
+  if (binary && blob != NULL && Peek(is, binary) == 'B') {
+    // The data is in a parameter blob (see matrix/param-blob.h); copy it to
+    // the device directly from there rather than through a temporary matrix.
+    ParamBlobRef ref;
+    blob->ReadRef(is, &ref);
+    if (!ref.is_matrix)
+      KALDI_ERR << "Expected a matrix in the parameter blob, got a vector";
+    Resize(ref.num_rows, ref.num_cols, kUndefined);
+    if (ref.num_rows == 0 || ref.num_cols == 0)
+      return;
+    if (ref.is_double)
+      this->CopyFromMat(blob->MatrixView<double>(ref));
+    else
+      this->CopyFromMat(blob->MatrixView<float>(ref));
+    return;
+  }
   Matrix<Real> temp;
   temp.Read(is, binary);
   Destroy();
@@ -512,7 +569,7 @@ void CuMatrixBase<Real>::SetZero() {
     CuTimer tim;
     CU_SAFE_CALL(cudaMemset2DAsync(data_, stride_ * sizeof(Real), 0,
                               num_cols_ * sizeof(Real), num_rows_ , 
-                              cudaStreamPerThread));
+                              GetCudaStream()));
     CuDevice::Instantiate().AccuProfile("CuMatrix::SetZero", tim);
   } else
 #endif
@@ -1682,7 +1739,7 @@ void CuMatrix<Real>::CompObjfAndDeriv(const std::vector<MatrixElement<Real> >& s
     CU_SAFE_CALL(cudaMemcpyAsync(addr, sv_labels.data(), sv_labels.size() * 
                                  sizeof(MatrixElement<Real>), 
                                  cudaMemcpyHostToDevice, 
-                                 cudaStreamPerThread));
+                                 GetCudaStream()));
     CuTimer tim;
     CuVector<Real> tmp(2, kUndefined);
     int dimBlock(CU1DBLOCK);
@@ -2260,7 +2317,7 @@ void AddMatMatBatched(const Real alpha, std::vector<CuSubMatrix<Real>* > &C,
 
     CU_SAFE_CALL(cudaMemcpyAsync(device_abc_array, host_abc_array, 
                                  3*size*sizeof(Real*), cudaMemcpyHostToDevice,
-                                 cudaStreamPerThread));
+                                 GetCudaStream()));
 
     CUBLAS_SAFE_CALL(cublas_gemmBatched(GetCublasHandle(),
                                         (transB==kTrans? CUBLAS_OP_T:CUBLAS_OP_N),
@@ -2277,9 +2334,14 @@ void AddMatMatBatched(const Real alpha, std::vector<CuSubMatrix<Real>* > &C,
   } else
 #endif
   {
+    std::vector<MatrixBase<Real>* > C_mat(size);
+    std::vector<const MatrixBase<Real>* > A_mat(size), B_mat(size);
     for (int32 i = 0; i < size; i++) {
-      C[i]->Mat().AddMatMat(alpha, A[i]->Mat(), transA, B[i]->Mat(), transB, beta);
+      C_mat[i] = &(C[i]->Mat());
+      A_mat[i] = &(A[i]->Mat());
+      B_mat[i] = &(B[i]->Mat());
     }
+    AddMatMatBatched(alpha, C_mat, A_mat, transA, B_mat, transB, beta);
   }
 }
 
@@ -2307,13 +2369,13 @@ void CuMatrixBase<Real>::CopyRowsFromVec(const CuVectorBase<Real> &v) {
         const Real* v_data = v.Data();
         CU_SAFE_CALL(
           cudaMemcpyAsync(data_, v_data, sizeof(Real)*num_rows_*num_cols_,
-                          cudaMemcpyDeviceToDevice, cudaStreamPerThread));
+                          cudaMemcpyDeviceToDevice, GetCudaStream()));
       } else {
         CU_SAFE_CALL(
           cudaMemcpy2DAsync(data_, stride_ * sizeof(Real), v.Data(),
                             num_cols_*sizeof(Real), num_cols_*sizeof(Real),
                             num_rows_, cudaMemcpyDeviceToDevice,
-                            cudaStreamPerThread));
+                            GetCudaStream()));
       }
     } else if (v.Dim() == num_cols_) {
       dim3 dimGrid, dimBlock;
@@ -2343,18 +2405,18 @@ void CuMatrixBase<Real>::CopyRowsFromVec(const VectorBase<Real> &v) {
         CU_SAFE_CALL(cudaMemcpyAsync(data_, v_data, 
                                      sizeof(Real)*num_rows_*num_cols_, 
                                      cudaMemcpyHostToDevice, 
-                                     cudaStreamPerThread));
+                                     GetCudaStream()));
       } else {
         const Real *v_data = v.Data();
         for (MatrixIndexT r = 0; r < num_rows_; r++) {
           Real *row_data = RowData(r);
           CU_SAFE_CALL(cudaMemcpyAsync(row_data, v_data, sizeof(Real)*num_cols_, 
                                        cudaMemcpyHostToDevice, 
-                                       cudaStreamPerThread));
+                                       GetCudaStream()));
           v_data += num_cols_;
         }
       }
-      CU_SAFE_CALL(cudaStreamSynchronize(cudaStreamPerThread));
+      CU_SAFE_CALL(cudaStreamSynchronize(GetCudaStream()));
     } else if (v.Dim() == num_cols_) {
       dim3 dimGrid, dimBlock;
       GetBlockSizesForSimpleMatrixOperation(NumRows(), NumCols(),
@@ -2625,18 +2687,18 @@ void VectorBase<Real>::CopyRowsFromMat(const CuMatrixBase<Real> &mat) {
     CuTimer tim;
     if (mat.Stride() == mat.NumCols()) {
       CU_SAFE_CALL(cudaMemcpyAsync(data_, mat.Data(), sizeof(Real)*dim_, 
-                   cudaMemcpyDeviceToHost, cudaStreamPerThread));
+                   cudaMemcpyDeviceToHost, GetCudaStream()));
     } else {
       // we could definitely do better than the following.
       Real* vec_data = data_;
       for (MatrixIndexT r = 0; r < mat.NumRows(); r++) {
         CU_SAFE_CALL(cudaMemcpyAsync(vec_data, mat.RowData(r), 
                      sizeof(Real) * mat.NumCols(), cudaMemcpyDeviceToHost, 
-                     cudaStreamPerThread));
+                     GetCudaStream()));
         vec_data += mat.NumCols();
       }
     }
-    CU_SAFE_CALL(cudaStreamSynchronize(cudaStreamPerThread));
+    CU_SAFE_CALL(cudaStreamSynchronize(GetCudaStream()));
     CuDevice::Instantiate().AccuProfile("CuVectorBase::CopyRowsFromMat", tim);
   } else
 #endif
@@ -3102,6 +3164,37 @@ void CuMatrixBase<Real>::CopyFromGeneralMat(const GeneralMatrix &src,
       return;
     }
     case kCompressedMatrix: {
+#if HAVE_CUDA == 1
+      if (CuDevice::Instantiate().Enabled() && trans == kNoTrans &&
+          sizeof(Real) == sizeof(BaseFloat)) {
+        // Copy the compressed data as it is, which is two or four times
+        // smaller than the matrix, and decompress it on the device.
+        const CompressedMatrix &cmat = src.GetCompressedMatrix();
+        KALDI_ASSERT(cmat.NumRows() == num_rows_ &&
+                     cmat.NumCols() == num_cols_);
+        if (num_rows_ == 0)
+          return;
+        CuTimer tim;
+        MatrixIndexT num_bytes = cmat.NumBytes();
+        void *cmat_data = CuDevice::Instantiate().Malloc(num_bytes);
+        CU_SAFE_CALL(cudaMemcpyAsync(cmat_data, cmat.Data(), num_bytes,
+                                     cudaMemcpyHostToDevice,
+                                     GetCudaStream()));
+        dim3 dimGrid, dimBlock;
+        GetBlockSizesForSimpleMatrixOperation(NumRows(), NumCols(),
+                                              &dimGrid, &dimBlock);
+        cuda_uncompress_compressed_matrix(
+            dimGrid, dimBlock, reinterpret_cast<BaseFloat*>(data_), Dim(),
+            cmat_data);
+        CU_SAFE_CALL(cudaGetLastError());
+        // The host data must stay valid until the copy is done.
+        CU_SAFE_CALL(cudaStreamSynchronize(GetCudaStream()));
+        CuDevice::Instantiate().Free(cmat_data);
+        CuDevice::Instantiate().AccuProfile(
+            "CuMatrixBase::CopyFromGeneralMat(compressed)", tim);
+        return;
+      }
+#endif
       Matrix<BaseFloat> mat;
       src.GetMatrix(&mat);
       this->CopyFromMat(mat, trans);
@@ -3287,7 +3380,7 @@ void CuMatrixBase<Real>::AddElements(Real alpha,
     void *addr = CuDevice::Instantiate().Malloc(input.size() * sizeof(MatrixElement<Real>));
     CU_SAFE_CALL(cudaMemcpyAsync(addr, input.data(),
                                  input.size() * sizeof(MatrixElement<Real>),
-                                 cudaMemcpyHostToDevice, cudaStreamPerThread));
+                                 cudaMemcpyHostToDevice, GetCudaStream()));
 
     CuTimer tim;
     int dimBlock(CU1DBLOCK);
@@ -3319,7 +3412,7 @@ void CuMatrixBase<Real>::AddElements(Real alpha, const CuArrayBase<Int32Pair> &i
     CuVector<Real> tmp_vec(indexes.Dim(), kUndefined);
     CU_SAFE_CALL(cudaMemcpyAsync(tmp_vec.Data(), input, 
                                  indexes.Dim() * sizeof(Real),
-                                 cudaMemcpyHostToDevice, cudaStreamPerThread));
+                                 cudaMemcpyHostToDevice, GetCudaStream()));
 
     int dimBlock(CU1DBLOCK);
     int dimGrid = n_blocks(indexes.Dim(), CU1DBLOCK);
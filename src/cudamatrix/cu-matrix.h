@@ -48,7 +48,8 @@ Real TraceMatMat(const CuMatrixBase<Real> &A, const CuMatrixBase<Real> &B,
                  MatrixTransposeType trans = kNoTrans);
 
 /// Does multiple matrix multiplications, executing them in parallel using
-/// cuBLAS's gemmBatched if we are using a GPU. Vectors A, B and C must have
+/// cuBLAS's gemmBatched if we are using a GPU (on CPU, see the version of
+/// AddMatMatBatched() in matrix/kaldi-matrix.h). Vectors A, B and C must have
 /// the same length; for each i, this function executes the matrix operation
 /// C[i] = alpha *  A[i](^T)*B[i](^T) + beta * C[i].
 template<typename Real>
@@ -266,6 +267,17 @@ class CuMatrixBase {
   void CopyToMat(MatrixBase<OtherReal> *dst,
                  MatrixTransposeType trans = kNoTrans) const;
 
+  /// Versions of CopyFromMat() and CopyToMat() that do not wait for the copy
+  /// to finish: it is queued on the current stream (see GetCudaStream() in
+  /// cu-device.h), and the host matrix must stay as it is (for
+  /// CopyFromMatAsync()), or not be used (for CopyToMatAsync()), until it has
+  /// finished, which you can find out with class CuEvent.  The copies are
+  /// only asynchronous if the host memory is pinned, e.g. if it is a
+  /// CuPinnedMatrix; otherwise CUDA does them synchronously.  If we are not
+  /// using a GPU, they are the same as CopyFromMat() and CopyToMat().
+  void CopyFromMatAsync(const MatrixBase<Real> &src);
+  void CopyToMatAsync(MatrixBase<Real> *dst) const;
+
   /// This function has two modes of operation.  If v.Dim() == NumRows() *
   /// NumCols(), then treats the vector as a row-by-row concatenation of a
   /// matrix and copies to *this.
@@ -145,7 +145,7 @@ void CuPackedMatrix<Real>::CopyFromPacked(const CuPackedMatrix<Real> &src) {
 
     CU_SAFE_CALL(
       cudaMemcpyAsync(data_, src.data_, num_bytes, cudaMemcpyDeviceToDevice,
-                      cudaStreamPerThread));
+                      GetCudaStream()));
     CuDevice::Instantiate().AccuProfile("CuPackedMatrix::CopyFromPacked1",
                                         tim);
   } else
@@ -163,8 +163,8 @@ void CuPackedMatrix<Real>::CopyFromPacked(const PackedMatrix<Real> &src) {
     if (num_rows_ == 0) return; // Nothing to do.
     CuTimer tim;
     CU_SAFE_CALL(cudaMemcpyAsync(data_, src.data_, src.SizeInBytes(),
-                                 cudaMemcpyHostToDevice, cudaStreamPerThread));
-    CU_SAFE_CALL(cudaStreamSynchronize(cudaStreamPerThread));
+                                 cudaMemcpyHostToDevice, GetCudaStream()));
+    CU_SAFE_CALL(cudaStreamSynchronize(GetCudaStream()));
     CuDevice::Instantiate().AccuProfile("CuPackedMatrix::CopyFromPacked2", tim);
   } else
 #endif
@@ -186,8 +186,8 @@ void CuPackedMatrix<Real>::CopyToPacked(PackedMatrix<Real> *dst) const {
       num_bytes = ((nr * (nr+1)) / 2) * sizeof(Real);
 
     CU_SAFE_CALL(cudaMemcpyAsync(dst->data_, data_, num_bytes,
-                                 cudaMemcpyDeviceToHost, cudaStreamPerThread));
-    CU_SAFE_CALL(cudaStreamSynchronize(cudaStreamPerThread));
+                                 cudaMemcpyDeviceToHost, GetCudaStream()));
+    CU_SAFE_CALL(cudaStreamSynchronize(GetCudaStream()));
     CuDevice::Instantiate().AccuProfile("CuPackedMatrix::CopyToPackedD2H", tim);
   } else
 #endif
@@ -215,7 +215,8 @@ void CuPackedMatrix<Real>::CopyRowsFromPacked(int32 r, const CuPackedMatrix<Real
     const Real *p_src = src.Data() + src_ro*src.Stride();
     Real *p_dst = data_ + dst_ro*stride_;
 
-    CU_SAFE_CALL(cudaMemcpy2D(p_dst, dst_pitch, p_src, src_pitch, width, r, cudaMemcpyDeviceToDevice));
+    CU_SAFE_CALL(cudaMemcpy2DAsync(p_dst, dst_pitch, p_src, src_pitch, width, r,
+                                 cudaMemcpyDeviceToDevice, GetCudaStream()));
 
     CuDevice::Instantiate().AccuProfile("CuMatrix::CopyRowsD2D", tim);
   } else
@@ -251,7 +252,7 @@ void CuPackedMatrix<Real>::SetZero() {
       num_bytes = ((nr * (nr+1)) / 2) * sizeof(Real);
 
     CU_SAFE_CALL(cudaMemsetAsync(reinterpret_cast<void*>(this->data_), 0, 
-          num_bytes, cudaStreamPerThread));
+          num_bytes, GetCudaStream()));
     CuDevice::Instantiate().AccuProfile("CuPackedMatrix::SetZero", tim);
   } else
   #endif
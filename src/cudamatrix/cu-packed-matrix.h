@@ -124,8 +124,8 @@ class CuPackedMatrix {
       Real value;
       CU_SAFE_CALL(cudaMemcpyAsync(&value, this->data_ + (r * (r+1)) / 2 + c,
                                    sizeof(Real), cudaMemcpyDeviceToHost,
-                                   cudaStreamPerThread));
-      CU_SAFE_CALL(cudaStreamSynchronize(cudaStreamPerThread));
+                                   GetCudaStream()));
+      CU_SAFE_CALL(cudaStreamSynchronize(GetCudaStream()));
       return value;
     } else
 #endif
@@ -0,0 +1,223 @@
+// cudamatrix/cu-pinned-matrix.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#if HAVE_CUDA == 1
+#include <cuda_runtime_api.h>
+#endif
+
+#include "cudamatrix/cu-pinned-matrix.h"
+#include "cudamatrix/cu-common.h"
+#include "cudamatrix/cu-device.h"
+
+namespace kaldi {
+
+
+CuPinnedMemoryAllocator::CuPinnedMemoryAllocator():
+    max_cached_bytes_(static_cast<size_t>(256) << 20), cached_bytes_(0),
+    allocated_bytes_(0), num_system_allocs_(0), num_cached_allocs_(0) { }
+
+// static
+size_t CuPinnedMemoryAllocator::SizeClass(size_t size) {
+  // Round up to a multiple of 'step', a power of two that is at least 1/8 of
+  // 'size', so we waste less than 1/8 of the memory.
+  size_t step = 256;
+  while (step * 8 < size)
+    step *= 2;
+  return (size + step - 1) & ~(step - 1);
+}
+
+void *CuPinnedMemoryAllocator::Malloc(size_t size) {
+  size_t size_class = SizeClass(size == 0 ? 1 : size);
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    std::map<size_t, std::vector<void*> >::iterator iter =
+        free_blocks_.find(size_class);
+    if (iter != free_blocks_.end() && !iter->second.empty()) {
+      void *ans = iter->second.back();
+      iter->second.pop_back();
+      cached_bytes_ -= size_class;
+      allocated_bytes_ += size_class;
+      num_cached_allocs_++;
+      return ans;
+    }
+  }
+  BlockInfo info;
+  info.size_class = size_class;
+  info.pinned = false;
+  info.huge_pages = NULL;
+  void *ans = NULL;
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled()) {
+    HugePageMode mode = GetHugePageMode();
+    if (mode != kHugePagesNone &&
+        size_class >= (static_cast<size_t>(2) << 20)) {
+      info.huge_pages = new HugePageBuffer();
+      ans = info.huge_pages->Allocate(size_class, mode);
+      CU_SAFE_CALL(cudaHostRegister(ans, size_class, cudaHostRegisterDefault));
+    } else {
+      // cudaMallocHost() gives page-aligned memory.
+      CU_SAFE_CALL(cudaMallocHost(&ans, size_class));
+    }
+    info.pinned = true;
+    info.orig = ans;
+  }
+#endif
+  if (!info.pinned) {
+    ans = KALDI_MEMALIGN(64, size_class, &info.orig);
+    if (ans == NULL)
+      KALDI_ERR << "Failed to allocate " << size_class << " bytes of memory.";
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  blocks_[ans] = info;
+  allocated_bytes_ += size_class;
+  num_system_allocs_++;
+  return ans;
+}
+
+// static
+void CuPinnedMemoryAllocator::FreeBlock(void *ptr, const BlockInfo &info) {
+#if HAVE_CUDA == 1
+  if (info.huge_pages != NULL) {
+    CU_SAFE_CALL(cudaHostUnregister(ptr));
+    delete info.huge_pages;
+    return;
+  }
+  if (info.pinned) {
+    CU_SAFE_CALL(cudaFreeHost(ptr));
+    return;
+  }
+#endif
+  KALDI_MEMALIGN_FREE(info.orig);
+}
+
+void CuPinnedMemoryAllocator::Free(void *ptr) {
+  if (ptr == NULL)
+    return;
+  std::unique_lock<std::mutex> lock(mutex_);
+  unordered_map<void*, BlockInfo>::iterator iter = blocks_.find(ptr);
+  if (iter == blocks_.end())
+    KALDI_ERR << "Attempt to free pinned memory that was not allocated: "
+              << ptr;
+  size_t size_class = iter->second.size_class;
+  allocated_bytes_ -= size_class;
+  if (cached_bytes_ + size_class <= max_cached_bytes_) {
+    free_blocks_[size_class].push_back(ptr);
+    cached_bytes_ += size_class;
+  } else {
+    FreeBlock(ptr, iter->second);
+    blocks_.erase(iter);
+  }
+}
+
+void CuPinnedMemoryAllocator::SetMaxCachedMemory(size_t bytes) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  max_cached_bytes_ = bytes;
+  // Free the largest cached blocks until we are under the limit.
+  std::map<size_t, std::vector<void*> >::reverse_iterator iter =
+      free_blocks_.rbegin();
+  for (; iter != free_blocks_.rend() && cached_bytes_ > max_cached_bytes_;
+       ++iter) {
+    while (!iter->second.empty() && cached_bytes_ > max_cached_bytes_) {
+      void *ptr = iter->second.back();
+      iter->second.pop_back();
+      unordered_map<void*, BlockInfo>::iterator block_iter = blocks_.find(ptr);
+      FreeBlock(ptr, block_iter->second);
+      blocks_.erase(block_iter);
+      cached_bytes_ -= iter->first;
+    }
+  }
+}
+
+void CuPinnedMemoryAllocator::PrintMemoryUsage() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  KALDI_LOG << "Pinned host memory: " << allocated_bytes_ << " bytes in use, "
+            << cached_bytes_ << " bytes cached; " << num_system_allocs_
+            << " allocations from the system and " << num_cached_allocs_
+            << " from the cache.";
+}
+
+CuPinnedMemoryAllocator::~CuPinnedMemoryAllocator() {
+  // We free the cached blocks so that memory checkers don't complain; the
+  // blocks still in use are left alone, as the program is exiting.
+  std::map<size_t, std::vector<void*> >::iterator iter = free_blocks_.begin();
+  for (; iter != free_blocks_.end(); ++iter) {
+    for (size_t i = 0; i < iter->second.size(); i++) {
+      const BlockInfo &info = blocks_[iter->second[i]];
+#if HAVE_CUDA == 1
+      // No need to check the return status here-- the program is exiting
+      // anyway.
+      if (info.huge_pages != NULL) {
+        cudaHostUnregister(iter->second[i]);
+        delete info.huge_pages;
+        continue;
+      }
+      if (info.pinned) {
+        cudaFreeHost(iter->second[i]);
+        continue;
+      }
+#endif
+      KALDI_MEMALIGN_FREE(info.orig);
+    }
+  }
+}
+
+CuPinnedMemoryAllocator g_cuda_pinned_allocator;
+
+
+template<typename Real>
+void CuPinnedMatrix<Real>::Init(MatrixIndexT rows, MatrixIndexT cols) {
+  KALDI_ASSERT(rows >= 0 && cols >= 0);
+  if (rows == 0 || cols == 0) {
+    this->data_ = NULL;
+    this->num_rows_ = 0;
+    this->num_cols_ = 0;
+    this->stride_ = 0;
+    return;
+  }
+  // Pad the rows to 16 bytes, as class Matrix does.
+  MatrixIndexT elems_per_16 = 16 / sizeof(Real),
+      stride = (cols + elems_per_16 - 1) / elems_per_16 * elems_per_16;
+  size_t size = static_cast<size_t>(rows) * stride * sizeof(Real);
+  this->data_ = static_cast<Real*>(g_cuda_pinned_allocator.Malloc(size));
+  this->num_rows_ = rows;
+  this->num_cols_ = cols;
+  this->stride_ = stride;
+}
+
+template<typename Real>
+void CuPinnedMatrix<Real>::Destroy() {
+  if (this->data_ != NULL)
+    g_cuda_pinned_allocator.Free(this->data_);
+  this->data_ = NULL;
+}
+
+template<typename Real>
+void CuPinnedMatrix<Real>::Resize(MatrixIndexT rows, MatrixIndexT cols) {
+  if (rows == this->num_rows_ && cols == this->num_cols_)
+    return;
+  Destroy();
+  Init(rows, cols);
+}
+
+template class CuPinnedMatrix<float>;
+template class CuPinnedMatrix<double>;
+
+
+}  // namespace kaldi
@@ -0,0 +1,135 @@
+// cudamatrix/cu-pinned-matrix.h
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+
+#ifndef KALDI_CUDAMATRIX_CU_PINNED_MATRIX_H_
+#define KALDI_CUDAMATRIX_CU_PINNED_MATRIX_H_
+
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "matrix/kaldi-matrix.h"
+#include "util/kaldi-mmap.h"
+#include "util/stl-utils.h"
+
+namespace kaldi {
+
+
+/**
+   This class allocates page-locked ("pinned") host memory, which the GPU can
+   copy to and from asynchronously (see CuMatrixBase::CopyFromMatAsync() and
+   CopyToMatAsync()) and faster than ordinary, pageable memory.  Like
+   CuMemoryAllocator does for device memory, it caches the blocks that are
+   freed, because cudaMallocHost() and cudaFreeHost() are slow (they
+   synchronize the device).  The requested sizes are rounded up to one of a
+   small number of size classes so that the cached blocks can be reused.
+
+   If huge pages were requested with --huge-pages (see HugePageBuffer in
+   util/kaldi-mmap.h), blocks of 2MB or more are allocated in huge pages and
+   then page-locked with cudaHostRegister(), so that the GPU's copies from and
+   to them, and the CPU's accesses, take fewer TLB misses.
+
+   If we did not compile for CUDA or a GPU is not being used, it gives out
+   ordinary (aligned) memory.  Unlike CuMemoryAllocator, it is always
+   thread-safe.  Use the global object g_cuda_pinned_allocator.
+*/
+class CuPinnedMemoryAllocator {
+ public:
+  CuPinnedMemoryAllocator();
+
+  /// Allocates at least 'size' bytes of host memory, aligned to 64 bytes.
+  void *Malloc(size_t size);
+
+  /// Frees memory allocated by Malloc().
+  void Free(void *ptr);
+
+  /// Sets the maximum amount of freed memory, in bytes, that is cached for
+  /// reuse; blocks freed beyond that are returned to the system.  The
+  /// default is 256MB.
+  void SetMaxCachedMemory(size_t bytes);
+
+  void PrintMemoryUsage() const;
+
+  ~CuPinnedMemoryAllocator();
+
+ private:
+  struct BlockInfo {
+    size_t size_class;
+    bool pinned;  // True if allocated with cudaMallocHost(), or registered
+                  // with cudaHostRegister() if 'huge_pages' is set.
+    void *orig;  // The pointer to free, for KALDI_MEMALIGN_FREE().
+    HugePageBuffer *huge_pages;  // The memory, if it is in huge pages.
+  };
+
+  // Returns the size that we allocate for a request of 'size' bytes.
+  static size_t SizeClass(size_t size);
+
+  // Frees the memory of a block; does not lock the mutex.
+  static void FreeBlock(void *ptr, const BlockInfo &info);
+
+  mutable std::mutex mutex_;
+  // The cached blocks, indexed by size class.
+  std::map<size_t, std::vector<void*> > free_blocks_;
+  // All the blocks, cached or given out.
+  unordered_map<void*, BlockInfo> blocks_;
+  size_t max_cached_bytes_;
+  size_t cached_bytes_;
+  size_t allocated_bytes_;
+  int64 num_system_allocs_;
+  int64 num_cached_allocs_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(CuPinnedMemoryAllocator);
+};
+
+extern CuPinnedMemoryAllocator g_cuda_pinned_allocator;
+
+
+/**
+   A matrix in pinned host memory (see CuPinnedMemoryAllocator), for use as
+   the source or destination of asynchronous copies to and from the GPU.
+   Apart from how its memory is allocated it is like class Matrix, and can
+   be used anywhere a MatrixBase is expected; but the contents are undefined
+   after construction and Resize().
+*/
+template<typename Real>
+class CuPinnedMatrix: public MatrixBase<Real> {
+ public:
+  CuPinnedMatrix() { Init(0, 0); }
+
+  CuPinnedMatrix(MatrixIndexT rows, MatrixIndexT cols) { Init(rows, cols); }
+
+  /// Changes the size; the contents are undefined afterwards.
+  void Resize(MatrixIndexT rows, MatrixIndexT cols);
+
+  ~CuPinnedMatrix() { Destroy(); }
+
+ private:
+  void Init(MatrixIndexT rows, MatrixIndexT cols);
+  void Destroy();
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(CuPinnedMatrix);
+};
+
+
+}  // namespace kaldi
+
+#endif  // KALDI_CUDAMATRIX_CU_PINNED_MATRIX_H_
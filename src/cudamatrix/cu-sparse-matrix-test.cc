@@ -222,6 +222,45 @@ static void UnitTestCuSparseMatrixCopyToSmat() {
   }
 }
 
+template <typename Real>
+static void UnitTestCuSparseMatrixCopyFromSmat() {
+  for (int32 i = 0; i < 4; i++) {
+    MatrixIndexT row = 10 + Rand() % 40;
+    MatrixIndexT col = 10 + Rand() % 50;
+
+    // Alternately a matrix with one element in each row, which is copied to
+    // the GPU differently, and a general one.
+    SparseMatrix<Real> smat;
+    if (i % 2 == 0) {
+      std::vector<int32> idx(row);
+      Vector<Real> weights(row);
+      for (int32 r = 0; r < row; r++)
+        idx[r] = Rand() % col;
+      weights.SetRandn();
+      SparseMatrix<Real> tmp(idx, weights, col, kNoTrans);
+      smat.Swap(&tmp);
+    } else {
+      smat.Resize(row, col);
+      smat.SetRandn(0.8);
+    }
+    CuSparseMatrix<Real> cu_smat(smat);
+    KALDI_ASSERT(cu_smat.NumRows() == row && cu_smat.NumCols() == col &&
+                 cu_smat.NumElements() == smat.NumElements());
+
+    Matrix<Real> mat1(row, col);
+    smat.CopyToMat(&mat1);
+    CuMatrix<Real> mat2(row, col);
+    cu_smat.CopyToMat(&mat2);
+    AssertEqual(mat1, Matrix<Real>(mat2), 0.00001);
+
+    SparseMatrix<Real> smat2;
+    cu_smat.CopyToSmat(&smat2);
+    Matrix<Real> mat3(row, col);
+    smat2.CopyToMat(&mat3);
+    AssertEqual(mat1, mat3, 0.00001);
+  }
+}
+
 template <typename Real>
 static void UnitTestCuSparseMatrixSwap() {
   for (int32 i = 0; i < 2; i++) {
@@ -275,6 +314,7 @@ void CudaSparseMatrixUnitTest() {
   UnitTestCuSparseMatrixSum<Real>();
   UnitTestCuSparseMatrixFrobeniusNorm<Real>();
   UnitTestCuSparseMatrixCopyToSmat<Real>();
+  UnitTestCuSparseMatrixCopyFromSmat<Real>();
   UnitTestCuSparseMatrixSwap<Real>();
 }
 
@@ -330,27 +330,48 @@ void CuSparseMatrix<Real>::CopyFromSmat(const SparseMatrix<OtherReal> &smat) {
     if (NumElements() == 0) {
       return;
     }
-    std::vector<int> row_ptr(NumRows() + 1);
-    std::vector<int> col_idx(NumElements());
-    Vector<Real> val(NumElements(), kUndefined);
+    CuTimer tim;
+    int32 num_rows = NumRows(), nnz = NumElements();
+    // The row pointers and the column indexes are adjacent in device memory,
+    // so they are staged in one array and copied together.
+    std::vector<int> row_ptr_col_idx(num_rows + 1 + nnz);
+    int *row_ptr = &(row_ptr_col_idx[0]), *col_idx = row_ptr + num_rows + 1;
+    Vector<Real> val(nnz, kUndefined);
+    // True if each row has exactly one element, as for posteriors from
+    // alignments and one-hot inputs; then the row pointers are 0, 1, 2 ...
+    // and are set on the device instead of being copied.
+    bool one_per_row = (nnz == num_rows);
 
     int n = 0;
-    for (int32 i = 0; i < smat.NumRows(); ++i) {
+    for (int32 i = 0; i < num_rows; ++i) {
+      const SparseVector<OtherReal> &row = smat.Row(i);
+      const std::pair<MatrixIndexT, OtherReal> *row_data = row.Data();
+      int32 row_nnz = row.NumElements();
+      one_per_row = one_per_row && (row_nnz == 1);
       row_ptr[i] = n;
-      for (int32 j = 0; j < (smat.Data() + i)->NumElements(); ++j, ++n) {
-        col_idx[n] = ((smat.Data() + i)->Data() + j)->first;
-        val(n) = static_cast<Real>(((smat.Data() + i)->Data() + j)->second);
+      for (int32 j = 0; j < row_nnz; ++j, ++n) {
+        col_idx[n] = row_data[j].first;
+        val(n) = static_cast<Real>(row_data[j].second);
       }
     }
-    row_ptr[NumRows()] = n;
-    KALDI_ASSERT(n == NumElements());
-
-    CuSubArray<int> cu_row_ptr(CsrRowPtr(), NumRows() + 1);
-    cu_row_ptr.CopyFromVec(row_ptr);
-    CuSubArray<int> cu_col_idx(CsrColIdx(), NumElements());
-    cu_col_idx.CopyFromVec(col_idx);
-    CuSubVector<Real> cu_val(CsrVal(), NumElements());
-    cu_val.CopyFromVec(val);
+    row_ptr[num_rows] = n;
+    KALDI_ASSERT(n == nnz);
+
+    if (one_per_row) {
+      CuSubArray<int> cu_row_ptr(CsrRowPtr(), num_rows + 1);
+      cu_row_ptr.Sequence(0);
+      CU_SAFE_CALL(cudaMemcpyAsync(CsrColIdx(), col_idx, nnz * sizeof(int),
+                                   cudaMemcpyHostToDevice, GetCudaStream()));
+    } else {
+      CU_SAFE_CALL(cudaMemcpyAsync(CsrRowPtr(), row_ptr,
+                                   row_ptr_col_idx.size() * sizeof(int),
+                                   cudaMemcpyHostToDevice, GetCudaStream()));
+    }
+    CU_SAFE_CALL(cudaMemcpyAsync(CsrVal(), val.Data(), nnz * sizeof(Real),
+                                 cudaMemcpyHostToDevice, GetCudaStream()));
+    // The host buffers must stay valid until the copies are done.
+    CU_SAFE_CALL(cudaStreamSynchronize(GetCudaStream()));
+    CuDevice::Instantiate().AccuProfile(__func__, tim);
   } else
 #endif
   {
@@ -27,6 +27,7 @@
 #endif
 
 #include "base/timer.h"
+#include "matrix/param-blob.h"
 #include "cudamatrix/cu-common.h"
 #include "cudamatrix/cu-vector.h"
 #include "cudamatrix/cu-device.h"
@@ -170,14 +171,14 @@ void CuVectorBase<Real>::CopyRowsFromMat(const CuMatrixBase<Real> &mat) {
     if (mat.Stride() == mat.NumCols() && mat.NumRows() != 0) {
       CU_SAFE_CALL(
         cudaMemcpyAsync(data_, mat.Data(), sizeof(Real)*dim_,
-                        cudaMemcpyDeviceToDevice, cudaStreamPerThread));
+                        cudaMemcpyDeviceToDevice, GetCudaStream()));
     } else {
       Real* vec_data = data_;
       for (MatrixIndexT r = 0; r < mat.NumRows(); r++) {
         CU_SAFE_CALL(cudaMemcpyAsync(vec_data, mat.RowData(r),
                                      sizeof(Real) * mat.NumCols(),
                                      cudaMemcpyDeviceToDevice,
-                                     cudaStreamPerThread));
+                                     GetCudaStream()));
         vec_data += mat.NumCols();
       }
     }
@@ -223,17 +224,17 @@ void CuVectorBase<Real>::CopyRowsFromMat(const MatrixBase<Real> &mat) {
     CuTimer tim;
     if (mat.Stride() == mat.NumCols()) {
       CU_SAFE_CALL(cudaMemcpyAsync(data_, mat.Data(), sizeof(Real)*dim_,
-                              cudaMemcpyHostToDevice, cudaStreamPerThread));
+                              cudaMemcpyHostToDevice, GetCudaStream()));
     } else {
       Real* vec_data = data_;
       for (MatrixIndexT r = 0; r < mat.NumRows(); r++) {
         CU_SAFE_CALL(cudaMemcpyAsync(vec_data, mat.RowData(r),
                                 sizeof(Real) * mat.NumCols(),
-                                cudaMemcpyHostToDevice, cudaStreamPerThread));
+                                cudaMemcpyHostToDevice, GetCudaStream()));
         vec_data += mat.NumCols();
       }
     }
-    CU_SAFE_CALL(cudaStreamSynchronize(cudaStreamPerThread));
+    CU_SAFE_CALL(cudaStreamSynchronize(GetCudaStream()));
     CuDevice::Instantiate().AccuProfile(__func__, tim);
   } else
 #endif
@@ -253,18 +254,18 @@ void MatrixBase<Real>::CopyRowsFromVec(const CuVectorBase<Real> &v) {
       CU_SAFE_CALL(cudaMemcpyAsync(data_, v.Data(),
                               sizeof(Real)*v.Dim(),
                               cudaMemcpyDeviceToHost,
-                              cudaStreamPerThread));
+                              GetCudaStream()));
     } else {
       const Real* vec_data = v.Data();
       for (MatrixIndexT r = 0; r < NumRows(); r++) {
         CU_SAFE_CALL(cudaMemcpyAsync(RowData(r), vec_data,
                                 sizeof(Real) * NumCols(),
                                 cudaMemcpyDeviceToHost,
-                                cudaStreamPerThread));
+                                GetCudaStream()));
         vec_data += NumCols();
       }
     }
-    CU_SAFE_CALL(cudaStreamSynchronize(cudaStreamPerThread));
+    CU_SAFE_CALL(cudaStreamSynchronize(GetCudaStream()));
     CuDevice::Instantiate().AccuProfile(__func__, tim);
   } else
 #endif
@@ -913,8 +914,8 @@ void CuVectorBase<Real>::CopyFromVec(const VectorBase<OtherReal> &src) {
       if (dim_ == 0) return;
       CuTimer tim;
       CU_SAFE_CALL(cudaMemcpyAsync(data_, src.Data(), src.Dim()*sizeof(Real), 
-                                   cudaMemcpyHostToDevice, cudaStreamPerThread));
-      CU_SAFE_CALL(cudaStreamSynchronize(cudaStreamPerThread));
+                                   cudaMemcpyHostToDevice, GetCudaStream()));
+      CU_SAFE_CALL(cudaStreamSynchronize(GetCudaStream()));
       CuDevice::Instantiate().AccuProfile("CuVector::CopyFromVecH2D", tim);
     }
   } else
@@ -947,8 +948,8 @@ void CuVectorBase<Real>::CopyToVec(VectorBase<OtherReal> *dst) const {
       CuTimer tim;
       CU_SAFE_CALL(cudaMemcpyAsync(dst->Data(), this->data_,
                               sizeof(Real) * dim_, cudaMemcpyDeviceToHost,
-                              cudaStreamPerThread));
-      CU_SAFE_CALL(cudaStreamSynchronize(cudaStreamPerThread));
+                              GetCudaStream()));
+      CU_SAFE_CALL(cudaStreamSynchronize(GetCudaStream()));
       CuDevice::Instantiate().AccuProfile(__func__, tim);
     }
   } else
@@ -961,6 +962,21 @@ void CuVectorBase<Real>::CopyToVec(VectorBase<OtherReal> *dst) const {
 
 template<typename Real>
 void CuVector<Real>::Read(std::istream &is, bool binary) {
+  const ParamBlob *blob = ParamBlob::CurrentReadBlob();
+  if (binary && blob != NULL && Peek(is, binary) == 'B') {
+    // The data is in a parameter blob (see matrix/param-blob.h); copy it to
+    // the device directly from there rather than through a temporary vector.
+    ParamBlobRef ref;
+    blob->ReadRef(is, &ref);
+    if (ref.is_matrix)
+      KALDI_ERR << "Expected a vector in the parameter blob, got a matrix";
+    Resize(ref.num_cols, kUndefined);
+    if (ref.is_double)
+      this->CopyFromVec(blob->VectorView<double>(ref));
+    else
+      this->CopyFromVec(blob->VectorView<float>(ref));
+    return;
+  }
   Vector<Real> temp;
   temp.Read(is, binary);
   Destroy();
@@ -1083,7 +1099,7 @@ void CuVectorBase<Real>::CopyFromVec(const CuVectorBase<Real> &src) {
     CuTimer tim;
     CU_SAFE_CALL(
       cudaMemcpyAsync(data_, src.data_, src.dim_ * sizeof(Real), 
-                      cudaMemcpyDeviceToDevice, cudaStreamPerThread));
+                      cudaMemcpyDeviceToDevice, GetCudaStream()));
     CuDevice::Instantiate().AccuProfile(__func__, tim);
   } else
   #endif
@@ -1103,7 +1119,7 @@ void CuVectorBase<Real>::SetZero() {
     KALDI_ASSERT(data_!=NULL);
     CuTimer tim;
     CU_SAFE_CALL(cudaMemsetAsync(data_, 0, dim_*sizeof(Real),
-          cudaStreamPerThread));
+          GetCudaStream()));
     CuDevice::Instantiate().AccuProfile("CuVector::SetZero", tim);
   } else
 #endif
@@ -17,7 +17,11 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <limits>
+
 #include "decoder/decodable-matrix.h"
+#include "util/text-utils.h"
 
 namespace kaldi {
 
@@ -59,6 +63,18 @@ BaseFloat DecodableMatrixMapped::LogLikelihood(int32 frame, int32 tid) {
 #endif
 }
 
+void DecodableMatrixMapped::LogLikelihoods(int32 frame, const int32 *tids,
+                                           BaseFloat *log_likes,
+                                           int32 num_tids) {
+#ifdef KALDI_PARANOID
+  const BaseFloat *row = likes_->RowData(frame - frame_offset_);
+#else
+  const BaseFloat *row = raw_data_ + frame * stride_;
+#endif
+  GatherVec(BaseFloat(1.0), row, &(trans_model_.TransitionIdToPdfArray()[0]),
+            tids, num_tids, log_likes);
+}
+
 int32 DecodableMatrixMapped::NumFramesReady() const {
   return frame_offset_ + likes_->NumRows();
 }
@@ -78,10 +94,93 @@ DecodableMatrixMapped::~DecodableMatrixMapped() {
 }
 
 
+DecodableMatrixMappedOffset::DecodableMatrixMappedOffset(
+    const TransitionModel &tm,
+    const DecodableFrameSkipConfig &skip_config):
+    trans_model_(tm), frame_offset_(0), input_is_finished_(false),
+    skip_config_(skip_config), num_consecutive_skipped_(0),
+    num_frames_skipped_(0), raw_data_(NULL), stride_(0) {
+  skip_config_.Check();
+  if (!skip_config_.skip_pdfs.empty()) {
+    std::vector<int32> skip_pdfs;
+    if (!SplitStringToIntegers(skip_config_.skip_pdfs, ":", false,
+                               &skip_pdfs))
+      KALDI_ERR << "Invalid --frame-skip-pdfs option: "
+                << skip_config_.skip_pdfs;
+    is_skip_pdf_.resize(tm.NumPdfs(), false);
+    for (size_t i = 0; i < skip_pdfs.size(); i++) {
+      if (skip_pdfs[i] < 0 || skip_pdfs[i] >= tm.NumPdfs())
+        KALDI_ERR << "Invalid pdf-id " << skip_pdfs[i]
+                  << " in --frame-skip-pdfs";
+      is_skip_pdf_[skip_pdfs[i]] = true;
+    }
+  }
+}
+
+bool DecodableMatrixMappedOffset::CanSkipFrame(
+    const VectorBase<BaseFloat> &row) const {
+  if (num_consecutive_skipped_ >= skip_config_.max_skip ||
+      last_kept_.Dim() == 0)
+    return false;
+  const BaseFloat *data = row.Data(), *last = last_kept_.Data();
+  int32 dim = row.Dim();
+  BaseFloat max_change = 0.0;
+  for (int32 i = 0; i < dim; i++)
+    max_change = std::max(max_change, std::abs(data[i] - last[i]));
+  if (max_change <= skip_config_.max_change)
+    return true;
+  if (!is_skip_pdf_.empty()) {
+    int32 best_pdf = 0;
+    BaseFloat best = data[0],
+        second_best = -std::numeric_limits<BaseFloat>::infinity();
+    for (int32 i = 1; i < dim; i++) {
+      if (data[i] > best) {
+        second_best = best;
+        best = data[i];
+        best_pdf = i;
+      } else if (data[i] > second_best) {
+        second_best = data[i];
+      }
+    }
+    if (is_skip_pdf_[best_pdf] &&
+        best - second_best > skip_config_.skip_pdf_margin)
+      return true;
+  }
+  return false;
+}
+
+void DecodableMatrixMappedOffset::SkipFrames(Matrix<BaseFloat> *loglikes) {
+  int32 num_rows = loglikes->NumRows();
+  std::vector<int32> kept_rows;
+  kept_rows.reserve(num_rows);
+  for (int32 r = 0; r < num_rows; r++) {
+    SubVector<BaseFloat> row(*loglikes, r);
+    if (CanSkipFrame(row)) {
+      num_consecutive_skipped_++;
+      num_frames_skipped_++;
+    } else {
+      num_consecutive_skipped_ = 0;
+      last_kept_ = row;
+      kept_rows.push_back(r);
+    }
+  }
+  int32 num_kept = kept_rows.size();
+  if (num_kept == num_rows)
+    return;
+  Matrix<BaseFloat> kept(num_kept, loglikes->NumCols(), kUndefined);
+  if (num_kept > 0)
+    kept.CopyRows(*loglikes, &(kept_rows[0]));
+  loglikes->Swap(&kept);
+}
+
 void DecodableMatrixMappedOffset::AcceptLoglikes(
     Matrix<BaseFloat> *loglikes, int32 frames_to_discard) {
   if (loglikes->NumRows() == 0) return;
   KALDI_ASSERT(loglikes->NumCols() == trans_model_.NumPdfs());
+  if (skip_config_.max_skip > 0) {
+    SkipFrames(loglikes);
+    if (loglikes->NumRows() == 0) return;
+  }
   KALDI_ASSERT(frames_to_discard <= loglikes_.NumRows() &&
                frames_to_discard >= 0);
   if (frames_to_discard == loglikes_.NumRows()) {
@@ -21,12 +21,15 @@
 #ifndef KALDI_DECODER_DECODABLE_MATRIX_H_
 #define KALDI_DECODER_DECODABLE_MATRIX_H_
 
+#include <string>
 #include <vector>
 
 #include "base/kaldi-common.h"
 #include "hmm/transition-model.h"
 #include "itf/decodable-itf.h"
+#include "itf/options-itf.h"
 #include "matrix/kaldi-matrix.h"
+#include "matrix/simd-math.h"
 
 namespace kaldi {
 
@@ -69,6 +72,13 @@ class DecodableMatrixScaledMapped: public DecodableInterface {
     return scale_ * (*likes_)(frame, trans_model_.TransitionIdToPdfFast(tid));
   }
 
+  virtual void LogLikelihoods(int32 frame, const int32 *tids,
+                              BaseFloat *log_likes, int32 num_tids) {
+    GatherVec(scale_, likes_->RowData(frame),
+              &(trans_model_.TransitionIdToPdfArray()[0]), tids, num_tids,
+              log_likes);
+  }
+
   // Indices are one-based!  This is for compatibility with OpenFst.
   virtual int32 NumIndices() const { return trans_model_.NumTransitionIds(); }
 
@@ -116,6 +126,9 @@ class DecodableMatrixMapped: public DecodableInterface {
 
   virtual BaseFloat LogLikelihood(int32 frame, int32 tid);
 
+  virtual void LogLikelihoods(int32 frame, const int32 *tids,
+                              BaseFloat *log_likes, int32 num_tids);
+
   // Note: these indices are 1-based.
   virtual int32 NumIndices() const;
 
@@ -136,6 +149,54 @@ class DecodableMatrixMapped: public DecodableInterface {
 };
 
 
+/**
+   Configuration for the optional dynamic frame-skipping in
+   DecodableMatrixMappedOffset.  When it is active, a newly supplied frame of
+   log-likelihoods is dropped (never shown to the decoder) if it is almost the
+   same as the last frame that was kept, or if its best pdf is one of
+   'skip-pdfs' (e.g. blank or silence) and wins by a large margin.  This
+   reduces the number of frames the search has to process, which is useful on
+   low-power devices; the price is that frame indices seen by the decoder no
+   longer correspond one-to-one with the frames of the neural net output, so
+   timing information in the output is compressed.  It is only suitable for
+   topologies where a state can be left after a single frame (e.g. 'chain'
+   models), and it should be tuned on held-out data since it trades accuracy
+   for speed.
+*/
+struct DecodableFrameSkipConfig {
+  int32 max_skip;  // maximum number of consecutive frames we may drop; zero
+                   // disables frame-skipping.
+  BaseFloat max_change;  // a frame is dropped if no log-likelihood differs by
+                         // more than this from the last kept frame.
+  std::string skip_pdfs;  // colon-separated list of pdf-ids, e.g. silence.
+  BaseFloat skip_pdf_margin;  // a frame whose best pdf is in 'skip_pdfs' is
+                              // dropped if it beats every other pdf by more
+                              // than this.
+
+  DecodableFrameSkipConfig(): max_skip(0), max_change(0.5),
+                              skip_pdf_margin(5.0) { }
+
+  void Register(OptionsItf *opts) {
+    opts->Register("frame-skip-max", &max_skip, "If >0, enables dynamic "
+                   "frame-skipping in the decoder: the maximum number of "
+                   "consecutive frames that may be dropped.  Compresses "
+                   "time; only use with models that allow single-frame "
+                   "states.");
+    opts->Register("frame-skip-max-change", &max_change, "With frame-skipping, "
+                   "drop a frame if none of its log-likelihoods differs by "
+                   "more than this from the last kept frame.");
+    opts->Register("frame-skip-pdfs", &skip_pdfs, "With frame-skipping, "
+                   "colon-separated list of pdf-ids (e.g. silence or blank) "
+                   "for which confident frames may be dropped.");
+    opts->Register("frame-skip-pdf-margin", &skip_pdf_margin, "With "
+                   "frame-skipping, drop a frame whose best pdf is in "
+                   "--frame-skip-pdfs and beats all others by more than this.");
+  }
+  void Check() const {
+    KALDI_ASSERT(max_skip >= 0 && max_change >= 0.0 && skip_pdf_margin >= 0.0);
+  }
+};
+
 /**
    This decodable class returns log-likes stored in a matrix; it supports
    repeatedly writing to the matrix and setting a time-offset representing the
@@ -145,14 +206,19 @@ class DecodableMatrixMapped: public DecodableInterface {
    If you try to access a log-likelihood that's no longer available because
    the frame index is less than the current offset, it is of course an error.
 
+   If 'skip_config' enables frame-skipping, AcceptLoglikes() may drop some of
+   the frames it is given (see DecodableFrameSkipConfig), so NumFramesReady()
+   counts only the frames that were kept.
+
    See also DecodableMatrixMapped, which supports the same type of thing but
    with a different interface where you are expected to re-construct the
    object each time you want to decode.
 */
 class DecodableMatrixMappedOffset: public DecodableInterface {
  public:
-  DecodableMatrixMappedOffset(const TransitionModel &tm):
-      trans_model_(tm), frame_offset_(0), input_is_finished_(false) { }
+  DecodableMatrixMappedOffset(const TransitionModel &tm,
+                              const DecodableFrameSkipConfig &skip_config =
+                              DecodableFrameSkipConfig());
 
   virtual int32 NumFramesReady() { return frame_offset_ + loglikes_.NumRows(); }
 
@@ -170,6 +236,9 @@ class DecodableMatrixMappedOffset: public DecodableInterface {
 
   void InputIsFinished() { input_is_finished_ = true; }
 
+  // Returns the number of frames dropped so far by frame-skipping.
+  int32 NumFramesSkipped() const { return num_frames_skipped_; }
+
   virtual int32 NumFramesReady() const {
     return loglikes_.NumRows() + frame_offset_;
   }
@@ -189,6 +258,18 @@ class DecodableMatrixMappedOffset: public DecodableInterface {
 #endif
   }
 
+  virtual void LogLikelihoods(int32 frame, const int32 *tids,
+                              BaseFloat *log_likes, int32 num_tids) {
+#ifdef KALDI_PARANOID
+    const BaseFloat *row = loglikes_.RowData(frame - frame_offset_);
+#else
+    const BaseFloat *row = raw_data_ + frame * stride_;
+#endif
+    GatherVec(BaseFloat(1.0), row,
+              &(trans_model_.TransitionIdToPdfArray()[0]), tids, num_tids,
+              log_likes);
+  }
+
   virtual int32 NumIndices() const { return trans_model_.NumTransitionIds(); }
 
   // nothing special to do in destructor.
@@ -199,6 +280,17 @@ class DecodableMatrixMappedOffset: public DecodableInterface {
   int32 frame_offset_;
   bool input_is_finished_;
 
+  // Returns true if frame-skipping allows us to drop the frame 'row'.
+  bool CanSkipFrame(const VectorBase<BaseFloat> &row) const;
+  // Removes the rows of 'loglikes' that frame-skipping allows us to drop.
+  void SkipFrames(Matrix<BaseFloat> *loglikes);
+
+  DecodableFrameSkipConfig skip_config_;
+  std::vector<bool> is_skip_pdf_;  // indexed by pdf-id, from skip_config_.
+  Vector<BaseFloat> last_kept_;  // the last frame we kept, if skipping is on.
+  int32 num_consecutive_skipped_;
+  int32 num_frames_skipped_;
+
   // 'raw_data_' and 'stride_' are intended as a fast look-aside which is an
   // alternative to accessing data_.  raw_data_ is a faked version of
   // data_->Data() as if it started from frame zero rather than frame_offset_.
@@ -0,0 +1,101 @@
+// decoder/decoder-stats.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <iomanip>
+
+#include "decoder/decoder-stats.h"
+
+namespace kaldi {
+
+DecoderStatsCollector::DecoderStatsCollector(MetricsRegistry *registry,
+                                             const std::string &prefix):
+    registry_(registry != NULL ? registry : &own_registry_) {
+  std::vector<double> count_buckets = ExponentialBuckets(16.0, 2.0, 16),
+      time_buckets = ExponentialBuckets(1.0e-06, 2.0, 20);
+  tokens_ = AddHistogram(prefix, "tokens", "Tokens active at the start of "
+                         "each frame.", count_buckets);
+  tokens_expanded_ = AddHistogram(prefix, "tokens_expanded", "Tokens within "
+                                  "the beam on each frame.", count_buckets);
+  tokens_out_ = AddHistogram(prefix, "tokens_out", "Tokens active at the end "
+                             "of each frame.", count_buckets);
+  emitting_arcs_ = AddHistogram(prefix, "emitting_arcs", "Emitting arcs "
+                                "expanded on each frame.", count_buckets);
+  nonemitting_arcs_ = AddHistogram(prefix, "nonemitting_arcs", "Nonemitting "
+                                   "arcs expanded on each frame.",
+                                   count_buckets);
+  adaptive_beam_ = AddHistogram(prefix, "adaptive_beam", "The beam in effect "
+                                "on each frame.", LinearBuckets(0.5, 0.5, 40));
+  emitting_seconds_ = AddHistogram(prefix, "emitting_seconds", "Time taken "
+                                   "by the emitting arcs of each frame.",
+                                   time_buckets);
+  nonemitting_seconds_ = AddHistogram(prefix, "nonemitting_seconds", "Time "
+                                      "taken by the nonemitting arcs of each "
+                                      "frame.", time_buckets);
+  prune_seconds_ = AddHistogram(prefix, "prune_seconds", "Time taken by "
+                                "pruning the lattice on each frame.",
+                                time_buckets);
+  seconds_ = AddHistogram(prefix, "seconds", "Time taken by each frame.",
+                          time_buckets);
+}
+
+MetricsHistogram *DecoderStatsCollector::AddHistogram(
+    const std::string &prefix, const std::string &name,
+    const std::string &help, const std::vector<double> &upper_bounds) {
+  MetricsHistogram *ans = registry_->GetHistogram(prefix + name, help,
+                                                  upper_bounds);
+  histograms_.push_back(std::make_pair(name, ans));
+  return ans;
+}
+
+void DecoderStatsCollector::FrameDecoded(const DecoderFrameStats &stats) {
+  // The decoders set the fields they don't know to -1.
+  if (stats.num_tokens >= 0) tokens_->Observe(stats.num_tokens);
+  if (stats.num_tokens_expanded >= 0)
+    tokens_expanded_->Observe(stats.num_tokens_expanded);
+  if (stats.num_tokens_out >= 0) tokens_out_->Observe(stats.num_tokens_out);
+  if (stats.num_emitting_arcs >= 0)
+    emitting_arcs_->Observe(stats.num_emitting_arcs);
+  if (stats.num_nonemitting_arcs >= 0)
+    nonemitting_arcs_->Observe(stats.num_nonemitting_arcs);
+  if (stats.adaptive_beam >= 0) adaptive_beam_->Observe(stats.adaptive_beam);
+  if (stats.emitting_seconds >= 0)
+    emitting_seconds_->Observe(stats.emitting_seconds);
+  if (stats.nonemitting_seconds >= 0)
+    nonemitting_seconds_->Observe(stats.nonemitting_seconds);
+  if (stats.prune_seconds >= 0) prune_seconds_->Observe(stats.prune_seconds);
+  if (stats.seconds >= 0) seconds_->Observe(stats.seconds);
+}
+
+void DecoderStatsCollector::Print(std::ostream &os) const {
+  os << std::left << std::setw(22) << "statistic" << std::right
+     << std::setw(10) << "frames" << std::setw(12) << "mean"
+     << std::setw(12) << "p50" << std::setw(12) << "p90"
+     << std::setw(12) << "p99" << '\n';
+  for (size_t i = 0; i < histograms_.size(); i++) {
+    const MetricsHistogram &h = *histograms_[i].second;
+    if (h.Count() == 0)
+      continue;
+    os << std::left << std::setw(22) << histograms_[i].first << std::right
+       << std::setw(10) << h.Count() << std::setw(12) << (h.Sum() / h.Count())
+       << std::setw(12) << h.Quantile(0.5) << std::setw(12) << h.Quantile(0.9)
+       << std::setw(12) << h.Quantile(0.99) << '\n';
+  }
+}
+
+}  // namespace kaldi
@@ -0,0 +1,86 @@
+// decoder/decoder-stats.h
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_DECODER_DECODER_STATS_H_
+#define KALDI_DECODER_DECODER_STATS_H_
+
+#include <string>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "itf/decoder-observer-itf.h"
+#include "util/kaldi-metrics.h"
+
+namespace kaldi {
+
+/**
+   DecoderStatsCollector accumulates histograms of the per-frame statistics
+   of the search (see DecoderFrameStats), e.g. to see how often max-active is
+   reached or how the time per frame is distributed when tuning the beams.  It
+   can be set as the observer of several decoders, including from different
+   threads.  The histograms are kept in a MetricsRegistry, so they can be
+   exported like other metrics (see util/kaldi-metrics.h), and Print()
+   summarizes them.
+
+   Example:
+   \code
+     DecoderStatsCollector stats;
+     decoder.SetObserver(&stats);
+     ... decode ...
+     stats.Print(std::cerr);
+   \endcode
+*/
+class DecoderStatsCollector: public DecoderObserverInterface {
+ public:
+  /// The histograms are created in 'registry' with names starting with
+  /// 'prefix', e.g. "kaldi_decoder_frame_tokens"; if 'registry' is NULL they
+  /// are created in a registry owned by this object.  Collectors with the
+  /// same registry and prefix share their histograms.
+  explicit DecoderStatsCollector(
+      MetricsRegistry *registry = NULL,
+      const std::string &prefix = "kaldi_decoder_frame_");
+
+  virtual void FrameDecoded(const DecoderFrameStats &stats);
+
+  /// Prints, for each statistic, the number of frames and the mean and the
+  /// 50th, 90th and 99th percentiles (estimated from the histogram buckets).
+  void Print(std::ostream &os) const;
+
+  const MetricsRegistry &Registry() const { return *registry_; }
+
+ private:
+  MetricsRegistry own_registry_;
+  MetricsRegistry *registry_;
+  MetricsHistogram *tokens_, *tokens_expanded_, *tokens_out_,
+      *emitting_arcs_, *nonemitting_arcs_, *adaptive_beam_,
+      *emitting_seconds_, *nonemitting_seconds_, *prune_seconds_, *seconds_;
+  // The histograms, with their names without the prefix, for Print().
+  std::vector<std::pair<std::string, const MetricsHistogram*> > histograms_;
+
+  MetricsHistogram *AddHistogram(const std::string &prefix,
+                                 const std::string &name,
+                                 const std::string &help,
+                                 const std::vector<double> &upper_bounds);
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(DecoderStatsCollector);
+};
+
+}  // namespace kaldi
+
+#endif  // KALDI_DECODER_DECODER_STATS_H_
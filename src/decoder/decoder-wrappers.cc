@@ -22,9 +22,28 @@
 #include "decoder/lattice-faster-decoder.h"
 #include "decoder/grammar-fst.h"
 #include "lat/lattice-functions.h"
+#include "util/kaldi-metrics.h"
 
 namespace kaldi {
 
+// Returns the histograms of the memory used by the decoder's lattice at the
+// end of each utterance, and by the lattice that is output, for utterances
+// decoded by DecodeUtteranceLatticeFaster() (see util/kaldi-metrics.h).
+static MetricsHistogram *DecoderLatticeBytesHistogram() {
+  static MetricsHistogram *ans = MetricsRegistry::Global().GetHistogram(
+      "kaldi_decoder_lattice_bytes", "Memory used by the tokens and links of "
+      "LatticeFasterDecoder at the end of each utterance, in bytes.",
+      ExponentialBuckets(65536.0, 2.0, 18));
+  return ans;
+}
+static MetricsHistogram *OutputLatticeBytesHistogram() {
+  static MetricsHistogram *ans = MetricsRegistry::Global().GetHistogram(
+      "kaldi_decoder_output_lattice_bytes", "Memory used by the lattice "
+      "output for each utterance (after determinization, if done), in bytes.",
+      ExponentialBuckets(4096.0, 2.0, 20));
+  return ans;
+}
+
 
 
 
@@ -260,6 +279,9 @@ bool DecodeUtteranceLatticeFaster(
     likelihood = -(weight.Value1() + weight.Value2());
   }
 
+  int64 decoder_bytes = decoder.MemoryUsage(), output_bytes;
+  DecoderLatticeBytesHistogram()->Observe(decoder_bytes);
+
   // Get lattice, and do determinization if requested.
   Lattice lat;
   decoder.GetRawLattice(&lat);
@@ -279,23 +301,29 @@ bool DecodeUtteranceLatticeFaster(
     // We'll write the lattice without acoustic scaling.
     if (acoustic_scale != 0.0)
       fst::ScaleLattice(fst::AcousticLatticeScale(1.0 / acoustic_scale), &clat);
+    output_bytes = LatticeMemoryUsage(clat);
     compact_lattice_writer->Write(utt, clat);
   } else {
     // We'll write the lattice without acoustic scaling.
     if (acoustic_scale != 0.0)
       fst::ScaleLattice(fst::AcousticLatticeScale(1.0 / acoustic_scale), &lat);
+    output_bytes = LatticeMemoryUsage(lat);
     lattice_writer->Write(utt, lat);
   }
+  OutputLatticeBytesHistogram()->Observe(output_bytes);
   KALDI_LOG << "Log-like per frame for utterance " << utt << " is "
             << (likelihood / num_frames) << " over "
             << num_frames << " frames.";
   KALDI_VLOG(2) << "Cost for utterance " << utt << " is "
                 << weight.Value1() << " + " << weight.Value2();
+  KALDI_VLOG(1) << "Memory for utterance " << utt << ": the decoder's "
+                << "lattice used " << decoder_bytes << " bytes and the output "
+                << "lattice uses " << output_bytes << " bytes.";
   *like_ptr = likelihood;
   return true;
 }
 
-// Instantiate the template above for the two required FST types.
+// Instantiate the template above for the required FST types.
 template bool DecodeUtteranceLatticeFaster(
     LatticeFasterDecoderTpl<fst::Fst<fst::StdArc> > &decoder,
     DecodableInterface &decodable,
@@ -326,6 +354,36 @@ template bool DecodeUtteranceLatticeFaster(
     LatticeWriter *lattice_writer,
     double *like_ptr);
 
+template bool DecodeUtteranceLatticeFaster(
+    LatticeFasterDecoderTpl<fst::FlatFst> &decoder,
+    DecodableInterface &decodable,
+    const TransitionModel &trans_model,
+    const fst::SymbolTable *word_syms,
+    std::string utt,
+    double acoustic_scale,
+    bool determinize,
+    bool allow_partial,
+    Int32VectorWriter *alignment_writer,
+    Int32VectorWriter *words_writer,
+    CompactLatticeWriter *compact_lattice_writer,
+    LatticeWriter *lattice_writer,
+    double *like_ptr);
+
+template bool DecodeUtteranceLatticeFaster(
+    LatticeFasterDecoderTpl<fst::LmComposeFst> &decoder,
+    DecodableInterface &decodable,
+    const TransitionModel &trans_model,
+    const fst::SymbolTable *word_syms,
+    std::string utt,
+    double acoustic_scale,
+    bool determinize,
+    bool allow_partial,
+    Int32VectorWriter *alignment_writer,
+    Int32VectorWriter *words_writer,
+    CompactLatticeWriter *compact_lattice_writer,
+    LatticeWriter *lattice_writer,
+    double *like_ptr);
+
 
 // Takes care of output.  Returns true on success.
 bool DecodeUtteranceLatticeSimple(
@@ -456,33 +514,73 @@ void ModifyGraphForCarefulAlignment(
 }
 
 
-void AlignUtteranceWrapper(
-    const AlignConfig &config,
-    const std::string &utt,
-    BaseFloat acoustic_scale,  // affects scores written to scores_writer, if
-                               // present
-    fst::VectorFst<fst::StdArc> *fst,  // non-const in case config.careful ==
-                                       // true.
-    DecodableInterface *decodable,  // not const but is really an input.
-    Int32VectorWriter *alignment_writer,
-    BaseFloatWriter *scores_writer,
-    int32 *num_done,
-    int32 *num_error,
-    int32 *num_retried,
-    double *tot_like,
-    int64 *frame_count,
-    BaseFloatVectorWriter *per_frame_acwt_writer) {
+// Writes the alignment in the best path "decoded" and adds to the stats; this
+// is the end of AlignUtteranceWrapper().
+static void WriteAlignment(const std::string &utt,
+                           BaseFloat acoustic_scale,
+                           const fst::VectorFst<LatticeArc> &decoded,
+                           int32 num_frames,
+                           Int32VectorWriter *alignment_writer,
+                           BaseFloatWriter *scores_writer,
+                           int32 *num_done,
+                           int32 *num_error,
+                           double *tot_like,
+                           int64 *frame_count,
+                           BaseFloatVectorWriter *per_frame_acwt_writer) {
+  if (decoded.NumStates() == 0) {
+    KALDI_WARN << "Error getting best path from decoder (likely a bug)";
+    if (num_error != NULL) (*num_error)++;
+    return;
+  }
+
+  std::vector<int32> alignment;
+  std::vector<int32> words;
+  LatticeWeight weight;
+
+  GetLinearSymbolSequence(decoded, &alignment, &words, &weight);
+  BaseFloat like = -(weight.Value1()+weight.Value2()) / acoustic_scale;
+
+  if (num_done != NULL) (*num_done)++;
+  if (tot_like != NULL) (*tot_like) += like;
+  if (frame_count != NULL) (*frame_count) += num_frames;
+
+  if (alignment_writer != NULL && alignment_writer->IsOpen())
+    alignment_writer->Write(utt, alignment);
+
+  if (scores_writer != NULL && scores_writer->IsOpen())
+    scores_writer->Write(utt, -(weight.Value1()+weight.Value2()));
 
+  Vector<BaseFloat> per_frame_loglikes;
+  if (per_frame_acwt_writer != NULL && per_frame_acwt_writer->IsOpen()) {
+    GetPerFrameAcousticCosts(decoded, &per_frame_loglikes);
+    per_frame_loglikes.Scale(-1 / acoustic_scale);
+    per_frame_acwt_writer->Write(utt, per_frame_loglikes);
+  }
+}
+
+
+// Checks that the beams in "config" make sense.
+static void CheckAlignConfig(const AlignConfig &config) {
   if ((config.retry_beam != 0 && config.retry_beam <= config.beam) ||
       config.beam <= 0.0) {
     KALDI_ERR << "Beams do not make sense: beam " << config.beam
               << ", retry-beam " << config.retry_beam;
   }
+}
 
+// Does the decoding part of AlignUtteranceWrapper(): outputs the best path to
+// "decoded" and returns true on success.  Sets *retried to true if it had to
+// retry with config.retry_beam.
+static bool AlignUtteranceInternal(const AlignConfig &config,
+                                   const std::string &utt,
+                                   fst::VectorFst<fst::StdArc> *fst,
+                                   DecodableInterface *decodable,
+                                   bool *retried,
+                                   fst::VectorFst<LatticeArc> *decoded) {
+  *retried = false;
   if (fst->Start() == fst::kNoStateId) {
     KALDI_WARN << "Empty decoding graph for " << utt;
-    if (num_error != NULL) (*num_error)++;
-    return;
+    return false;
   }
 
   if (config.careful)
@@ -497,7 +595,7 @@ void AlignUtteranceWrapper(
   bool ans = decoder.ReachedFinal();  // consider only final states.
 
   if (!ans && config.retry_beam != 0.0) {
-    if (num_retried != NULL) (*num_retried)++;
+    *retried = true;
     KALDI_WARN << "Retrying utterance " << utt << " with beam "
                << config.retry_beam;
     decode_opts.beam = config.retry_beam;
@@ -509,41 +607,142 @@ void AlignUtteranceWrapper(
   if (!ans) {  // Still did not reach final state.
     KALDI_WARN << "Did not successfully decode file " << utt << ", len = "
                << decodable->NumFramesReady();
-    if (num_error != NULL) (*num_error)++;
-    return;
+    return false;
   }
 
+  decoder.GetBestPath(decoded);
+  return true;
+}
+
+void AlignUtteranceWrapper(
+    const AlignConfig &config,
+    const std::string &utt,
+    BaseFloat acoustic_scale,  // affects scores written to scores_writer, if
+                               // present
+    fst::VectorFst<fst::StdArc> *fst,  // non-const in case config.careful ==
+                                       // true.
+    DecodableInterface *decodable,  // not const but is really an input.
+    Int32VectorWriter *alignment_writer,
+    BaseFloatWriter *scores_writer,
+    int32 *num_done,
+    int32 *num_error,
+    int32 *num_retried,
+    double *tot_like,
+    int64 *frame_count,
+    BaseFloatVectorWriter *per_frame_acwt_writer) {
+  CheckAlignConfig(config);
+
+  bool retried;
   fst::VectorFst<LatticeArc> decoded;  // linear FST.
-  decoder.GetBestPath(&decoded);
-  if (decoded.NumStates() == 0) {
-    KALDI_WARN << "Error getting best path from decoder (likely a bug)";
+  bool ans = AlignUtteranceInternal(config, utt, fst, decodable, &retried,
+                                    &decoded);
+  if (retried && num_retried != NULL) (*num_retried)++;
+  if (!ans) {
     if (num_error != NULL) (*num_error)++;
     return;
   }
+  WriteAlignment(utt, acoustic_scale, decoded, decodable->NumFramesReady(),
+                 alignment_writer, scores_writer, num_done, num_error,
+                 tot_like, frame_count, per_frame_acwt_writer);
+}
 
-  std::vector<int32> alignment;
-  std::vector<int32> words;
-  LatticeWeight weight;
+AlignUtteranceClass::AlignUtteranceClass(
+    const AlignConfig &config,
+    const std::string &utt,
+    BaseFloat acoustic_scale,
+    fst::VectorFst<fst::StdArc> *fst,
+    DecodableInterface *decodable,
+    Int32VectorWriter *alignment_writer,
+    BaseFloatWriter *scores_writer,
+    int32 *num_done,
+    int32 *num_error,
+    int32 *num_retried,
+    double *tot_like,
+    int64 *frame_count,
+    BaseFloatVectorWriter *per_frame_acwt_writer):
+    config_(config), utt_(utt), acoustic_scale_(acoustic_scale), fst_(fst),
+    decodable_(decodable), alignment_writer_(alignment_writer),
+    scores_writer_(scores_writer), num_done_(num_done), num_error_(num_error),
+    num_retried_(num_retried), tot_like_(tot_like), frame_count_(frame_count),
+    per_frame_acwt_writer_(per_frame_acwt_writer), success_(false),
+    retried_(false) {
+  CheckAlignConfig(config);
+}
 
-  GetLinearSymbolSequence(decoded, &alignment, &words, &weight);
-  BaseFloat like = -(weight.Value1()+weight.Value2()) / acoustic_scale;
+void AlignUtteranceClass::operator () () {
+  success_ = AlignUtteranceInternal(config_, utt_, fst_, decodable_,
+                                    &retried_, &decoded_);
+}
 
-  if (num_done != NULL) (*num_done)++;
-  if (tot_like != NULL) (*tot_like) += like;
-  if (frame_count != NULL) (*frame_count) += decodable->NumFramesReady();
+AlignUtteranceClass::~AlignUtteranceClass() {
+  if (retried_ && num_retried_ != NULL) (*num_retried_)++;
+  if (success_) {
+    WriteAlignment(utt_, acoustic_scale_, decoded_,
+                   decodable_->NumFramesReady(), alignment_writer_,
+                   scores_writer_, num_done_, num_error_, tot_like_,
+                   frame_count_, per_frame_acwt_writer_);
+  } else if (num_error_ != NULL) {
+    (*num_error_)++;
+  }
+  delete fst_;
+  delete decodable_;
+}
 
-  if (alignment_writer != NULL && alignment_writer->IsOpen())
-    alignment_writer->Write(utt, alignment);
+void AlignUtteranceWrapper(
+    const AlignConfig &config,
+    const std::string &utt,
+    BaseFloat acoustic_scale,
+    const fst::LazyTrainingGraph &fst,
+    DecodableInterface *decodable,
+    Int32VectorWriter *alignment_writer,
+    BaseFloatWriter *scores_writer,
+    int32 *num_done,
+    int32 *num_error,
+    int32 *num_retried,
+    double *tot_like,
+    int64 *frame_count,
+    BaseFloatVectorWriter *per_frame_acwt_writer) {
+  CheckAlignConfig(config);
+  if (config.careful)
+    KALDI_ERR << "Careful alignment is not supported with lazy graphs.";
 
-  if (scores_writer != NULL && scores_writer->IsOpen())
-    scores_writer->Write(utt, -(weight.Value1()+weight.Value2()));
+  if (fst.Start() == fst::kNoStateId) {
+    KALDI_WARN << "Empty decoding graph for " << utt;
+    if (num_error != NULL) (*num_error)++;
+    return;
+  }
 
-  Vector<BaseFloat> per_frame_loglikes;
-  if (per_frame_acwt_writer != NULL && per_frame_acwt_writer->IsOpen()) {
-    GetPerFrameAcousticCosts(decoded, &per_frame_loglikes);
-    per_frame_loglikes.Scale(-1 / acoustic_scale);
-    per_frame_acwt_writer->Write(utt, per_frame_loglikes);
+  LatticeFasterDecoderConfig decode_opts;
+  decode_opts.beam = config.beam;
+  // Only the best path is needed.
+  LatticeFasterDecoderTpl<fst::LazyTrainingGraph, decoder::BackpointerToken>
+      decoder(fst, decode_opts);
+  decoder.Decode(decodable);
+
+  bool ans = decoder.ReachedFinal();  // consider only final states.
+
+  if (!ans && config.retry_beam != 0.0) {
+    if (num_retried != NULL) (*num_retried)++;
+    KALDI_WARN << "Retrying utterance " << utt << " with beam "
+               << config.retry_beam;
+    decode_opts.beam = config.retry_beam;
+    decoder.SetOptions(decode_opts);
+    decoder.Decode(decodable);
+    ans = decoder.ReachedFinal();
   }
+
+  if (!ans) {  // Still did not reach final state.
+    KALDI_WARN << "Did not successfully decode file " << utt << ", len = "
+               << decodable->NumFramesReady();
+    if (num_error != NULL) (*num_error)++;
+    return;
+  }
+
+  Lattice decoded;  // linear FST.
+  decoder.GetBestPath(&decoded);
+  WriteAlignment(utt, acoustic_scale, decoded, decodable->NumFramesReady(),
+                 alignment_writer, scores_writer, num_done, num_error,
+                 tot_like, frame_count, per_frame_acwt_writer);
 }
 
 } // end namespace kaldi.
@@ -72,6 +72,69 @@ void AlignUtteranceWrapper(
     int64 *frame_count,
     BaseFloatVectorWriter *per_frame_acwt_writer = NULL);
 
+/// This class does the same as AlignUtteranceWrapper(), for use with
+/// TaskSequencer so that utterances can be aligned in parallel: the decoding
+/// happens in operator (), and the output in the destructor (which
+/// TaskSequencer calls in order, from one thread at a time).  It takes
+/// ownership of "fst" and "decodable".
+class AlignUtteranceClass {
+ public:
+  AlignUtteranceClass(const AlignConfig &config,
+                      const std::string &utt,
+                      BaseFloat acoustic_scale,
+                      fst::VectorFst<fst::StdArc> *fst,
+                      DecodableInterface *decodable,
+                      Int32VectorWriter *alignment_writer,
+                      BaseFloatWriter *scores_writer,
+                      int32 *num_done,
+                      int32 *num_error,
+                      int32 *num_retried,
+                      double *tot_like,
+                      int64 *frame_count,
+                      BaseFloatVectorWriter *per_frame_acwt_writer = NULL);
+  void operator () ();  // The decoding happens here.
+  ~AlignUtteranceClass();  // Output happens here.
+ private:
+  // The following variables correspond to inputs:
+  const AlignConfig &config_;
+  std::string utt_;
+  BaseFloat acoustic_scale_;
+  fst::VectorFst<fst::StdArc> *fst_;
+  DecodableInterface *decodable_;
+  Int32VectorWriter *alignment_writer_;
+  BaseFloatWriter *scores_writer_;
+  int32 *num_done_;
+  int32 *num_error_;
+  int32 *num_retried_;
+  double *tot_like_;
+  int64 *frame_count_;
+  BaseFloatVectorWriter *per_frame_acwt_writer_;
+
+  // The following variables are stored by the computation.
+  bool success_;
+  bool retried_;
+  fst::VectorFst<LatticeArc> decoded_;  // The best path, if success_.
+};
+
+/// This version of AlignUtteranceWrapper aligns with a LazyTrainingGraph,
+/// which expands the HMMs of the training graph as the decoder needs them
+/// instead of compiling the graph first (see gmm-align --lazy-graph).
+/// config.careful is not supported.
+void AlignUtteranceWrapper(
+    const AlignConfig &config,
+    const std::string &utt,
+    BaseFloat acoustic_scale,
+    const fst::LazyTrainingGraph &fst,
+    DecodableInterface *decodable,
+    Int32VectorWriter *alignment_writer,
+    BaseFloatWriter *scores_writer,
+    int32 *num_done,
+    int32 *num_error,
+    int32 *num_retried,
+    double *tot_like,
+    int64 *frame_count,
+    BaseFloatVectorWriter *per_frame_acwt_writer = NULL);
+
 
 
 /// This function modifies the decoding graph for what we call "careful
@@ -96,9 +159,9 @@ void ModifyGraphForCarefulAlignment(
 /// lattice_writer, else to compact_lattice_writer.  The writers for
 /// alignments and words will only be written to if they are open.
 ///
-/// Caution: this will only link correctly if FST is either fst::Fst<fst::StdArc>,
-/// or fst::GrammarFst, as the template function is defined in the .cc file and
-/// only instantiated for those two types.
+/// Caution: this will only link correctly if FST is fst::Fst<fst::StdArc>,
+/// fst::GrammarFst, fst::FlatFst or fst::LmComposeFst, as the template function
+/// is defined in the .cc file and only instantiated for those types.
 template <typename FST>
 bool DecodeUtteranceLatticeFaster(
     LatticeFasterDecoderTpl<FST> &decoder, // not const but is really an input.
@@ -0,0 +1,173 @@
+// decoder/flat-fst-speed-test.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <unistd.h>
+#include "base/kaldi-common.h"
+#include "base/timer.h"
+#include "util/common-utils.h"
+#include "util/kaldi-mmap.h"
+#include "fstext/fstext-lib.h"
+#include "hmm/transition-model.h"
+#include "decoder/decodable-matrix.h"
+#include "decoder/flat-fst.h"
+#include "decoder/lattice-faster-decoder.h"
+
+namespace kaldi {
+
+// Creates a random graph that is a bit like an HCLG, as in
+// lattice-faster-decoder-speed-test.cc; it should be much larger than the
+// caches for the TLB misses to matter.
+void CreateRandomGraph(int32 num_states, int32 num_pdfs,
+                       fst::StdVectorFst *fst) {
+  typedef fst::StdArc Arc;
+  fst->DeleteStates();
+  fst->ReserveStates(num_states);
+  for (int32 s = 0; s < num_states; s++)
+    fst->AddState();
+  fst->SetStart(0);
+  for (int32 s = 0; s < num_states; s++) {
+    fst->AddArc(s, Arc(RandInt(1, num_pdfs), 0, 0.5 * RandUniform(), s));
+    int32 num_arcs = RandInt(1, 4);
+    for (int32 i = 0; i < num_arcs; i++) {
+      int32 olabel = (WithProb(0.1) ? RandInt(1, 10000) : 0);
+      fst->AddArc(s, Arc(RandInt(1, num_pdfs), olabel, 5.0 * RandUniform(),
+                         RandInt(0, num_states - 1)));
+    }
+    if (s + 1 < num_states && WithProb(0.2))
+      fst->AddArc(s, Arc(0, 0, 3.0 * RandUniform(),
+                         RandInt(s + 1, std::min(s + 100, num_states - 1))));
+    if (WithProb(0.05))
+      fst->SetFinal(s, 2.0 * RandUniform());
+  }
+}
+
+}  // namespace kaldi
+
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    typedef kaldi::int32 int32;
+
+    const char *usage =
+        "Speed test for decoding with a FlatFst backed by ordinary pages (as\n"
+        "mapped from the file) and by huge pages, transparent and explicit\n"
+        "(see --huge-pages), to show the effect of TLB misses on the\n"
+        "real-time factor.  With no arguments it uses a large random graph and\n"
+        "random log-likelihoods; otherwise it replays log-likelihoods (e.g.\n"
+        "from nnet3-compute) against a real graph, written by make-flat-fst.\n"
+        "For --huge-pages=explicit, reserve enough huge pages first, e.g.\n"
+        "echo 2048 > /proc/sys/vm/nr_hugepages.\n"
+        "\n"
+        "Usage: flat-fst-speed-test [options] "
+        "[<model-in> <flat-fst-in> <loglikes-rspecifier>]\n"
+        " e.g.: flat-fst-speed-test final.mdl HCLG.flat ark:loglikes.ark\n";
+    ParseOptions po(usage);
+    std::string modes = "none,transparent,explicit";
+    BaseFloat acoustic_scale = 0.1, frame_shift = 0.01;
+    int32 num_utts = 20, num_states = 2000000;
+    LatticeFasterDecoderConfig config;
+    config.max_active = 7000;
+    config.Register(&po);
+    po.Register("modes", &modes, "Comma-separated list of values of "
+                "--huge-pages to compare");
+    po.Register("acoustic-scale", &acoustic_scale,
+                "Scaling factor for acoustic likelihoods");
+    po.Register("frame-shift", &frame_shift, "Frame shift in seconds, for "
+                "the real-time factor");
+    po.Register("num-utts", &num_utts,
+                "Number of utterances to decode (they are read into memory)");
+    po.Register("num-states", &num_states,
+                "Number of states of the random graph");
+    RegisterHugePageOptions(&po);
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 0 && po.NumArgs() != 3) {
+      po.PrintUsage();
+      exit(1);
+    }
+    std::vector<std::string> mode_values;
+    SplitStringToVector(modes, ",", true, &mode_values);
+
+    TransitionModel trans_model;
+    std::string fst_filename;
+    std::vector<Matrix<BaseFloat> > loglikes;
+    if (po.NumArgs() == 3) {
+      ReadKaldiObject(po.GetArg(1), &trans_model);
+      fst_filename = po.GetArg(2);
+      SequentialBaseFloatMatrixReader loglike_reader(po.GetArg(3));
+      for (; !loglike_reader.Done() && loglikes.size() < num_utts;
+           loglike_reader.Next())
+        loglikes.push_back(loglike_reader.Value());
+    } else {
+      int32 num_pdfs = 2000, num_frames = 300;
+      {
+        fst::StdVectorFst fst;
+        CreateRandomGraph(num_states, num_pdfs, &fst);
+        fst::FlatFst flat_fst(fst);
+        fst_filename = "tmpf.flat";
+        WriteKaldiObject(flat_fst, fst_filename, true);
+      }
+      loglikes.resize(std::min(num_utts, 5));
+      for (size_t i = 0; i < loglikes.size(); i++) {
+        loglikes[i].Resize(num_frames, num_pdfs);
+        loglikes[i].SetRandn();
+        loglikes[i].Scale(20.0);
+      }
+    }
+    if (loglikes.empty())
+      KALDI_ERR << "No log-likelihoods were read.";
+
+    for (size_t m = 0; m < mode_values.size(); m++) {
+      g_huge_pages = mode_values[m];
+      fst::FlatFst flat_fst;
+      flat_fst.Map(fst_filename);
+      LatticeFasterDecoderTpl<fst::FlatFst> decoder(flat_fst, config);
+      // Decode once to fault the graph in, so that we time only the lookups.
+      int32 num_frames = 0;
+      double elapsed = 0.0;
+      for (int32 pass = 0; pass < 2; pass++) {
+        Timer timer;
+        for (size_t i = 0; i < loglikes.size(); i++) {
+          if (po.NumArgs() == 3) {
+            DecodableMatrixScaledMapped decodable(trans_model, loglikes[i],
+                                                  acoustic_scale);
+            decoder.Decode(&decodable);
+          } else {
+            DecodableMatrixScaled decodable(loglikes[i], acoustic_scale);
+            decoder.Decode(&decodable);
+          }
+          if (pass == 1)
+            num_frames += decoder.NumFramesDecoded();
+        }
+        elapsed = timer.Elapsed();
+      }
+      KALDI_LOG << "For --huge-pages=" << mode_values[m] << ": "
+                << (num_frames / elapsed) << " frames per second, real-time "
+                << "factor " << (elapsed / (num_frames * frame_shift));
+    }
+    g_huge_pages = "none";
+    if (po.NumArgs() == 0)
+      unlink(fst_filename.c_str());
+    return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
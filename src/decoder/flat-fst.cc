@@ -0,0 +1,205 @@
+// decoder/flat-fst.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "decoder/flat-fst.h"
+#include "util/kaldi-io.h"
+
+namespace fst {
+
+FlatFst::FlatFst(): start_(kNoStateId), num_states_(0),
+                    final_costs_(NULL), arc_offsets_(NULL),
+                    emitting_offsets_(NULL), arcs_(NULL) {
+  AllocateStorage(0);
+}
+
+FlatFst::FlatFst(const Fst<StdArc> &fst) {
+  using namespace kaldi;
+  if (fst.Properties(kExpanded, false) == 0)
+    KALDI_ERR << "FlatFst can only be constructed from an expanded FST.";
+  start_ = fst.Start();
+  num_states_ = CountStates(fst);
+  size_t num_arcs = 0;
+  for (StateId s = 0; s < num_states_; s++)
+    num_arcs += fst.NumArcs(s);
+  if (num_arcs > static_cast<size_t>(std::numeric_limits<uint32>::max()))
+    KALDI_ERR << "FST has too many arcs (" << num_arcs << ") for FlatFst.";
+  AllocateStorage(num_arcs);
+
+  uint32 arc_index = 0;
+  for (StateId s = 0; s < num_states_; s++) {
+    final_costs_storage_[s] = fst.Final(s).Value();
+    arc_offsets_storage_[s] = arc_index;
+    // First the input-epsilon arcs, then the emitting arcs.
+    for (ArcIterator<Fst<StdArc> > aiter(fst, s); !aiter.Done(); aiter.Next())
+      if (aiter.Value().ilabel == 0)
+        arcs_storage_[arc_index++] = aiter.Value();
+    emitting_offsets_storage_[s] = arc_index;
+    for (ArcIterator<Fst<StdArc> > aiter(fst, s); !aiter.Done(); aiter.Next())
+      if (aiter.Value().ilabel != 0)
+        arcs_storage_[arc_index++] = aiter.Value();
+  }
+  arc_offsets_storage_[num_states_] = arc_index;
+}
+
+void FlatFst::AllocateStorage(int64 num_arcs) {
+  final_costs_storage_.resize(num_states_);
+  arc_offsets_storage_.resize(num_states_ + 1, 0);
+  emitting_offsets_storage_.resize(num_states_);
+  arcs_storage_.resize(num_arcs);
+  final_costs_ = final_costs_storage_.data();
+  arc_offsets_ = arc_offsets_storage_.data();
+  emitting_offsets_ = emitting_offsets_storage_.data();
+  arcs_ = arcs_storage_.data();
+}
+
+void FlatFst::FreeStorage() {
+  std::vector<float>().swap(final_costs_storage_);
+  std::vector<uint32>().swap(arc_offsets_storage_);
+  std::vector<uint32>().swap(emitting_offsets_storage_);
+  std::vector<Arc>().swap(arcs_storage_);
+}
+
+size_t FlatFst::ArraysSize(int64 num_arcs) const {
+  return sizeof(float) * num_states_ + sizeof(uint32) * (num_states_ + 1) +
+      sizeof(uint32) * num_states_ + sizeof(Arc) * num_arcs;
+}
+
+void FlatFst::SetArraysFrom(const char *data, int64 num_arcs) {
+  final_costs_ = reinterpret_cast<const float*>(data);
+  data += sizeof(float) * num_states_;
+  arc_offsets_ = reinterpret_cast<const uint32*>(data);
+  data += sizeof(uint32) * (num_states_ + 1);
+  emitting_offsets_ = reinterpret_cast<const uint32*>(data);
+  data += sizeof(uint32) * num_states_;
+  arcs_ = reinterpret_cast<const Arc*>(data);
+}
+
+void FlatFst::Write(std::ostream &os, bool binary) const {
+  using namespace kaldi;
+  if (!binary)
+    KALDI_ERR << "FlatFst::Write only supports binary mode.";
+  int32 format = 2;
+  WriteToken(os, binary, "<FlatFst>");
+  WriteBasicType(os, binary, format);
+  WriteBasicType(os, binary, start_);
+  int32 num_states = num_states_;
+  int64 num_arcs = arc_offsets_[num_states_];
+  WriteBasicType(os, binary, num_states);
+  WriteBasicType(os, binary, num_arcs);
+  WriteMmapPadding(os);
+  // The arrays are written as raw memory, so reading them back is just a
+  // matter of copying them, or of mapping them in Map().
+  os.write(reinterpret_cast<const char*>(final_costs_),
+           sizeof(float) * num_states);
+  os.write(reinterpret_cast<const char*>(arc_offsets_),
+           sizeof(uint32) * (num_states + 1));
+  os.write(reinterpret_cast<const char*>(emitting_offsets_),
+           sizeof(uint32) * num_states);
+  os.write(reinterpret_cast<const char*>(arcs_),
+           sizeof(Arc) * num_arcs);
+  WriteToken(os, binary, "</FlatFst>");
+  if (!os.good())
+    KALDI_ERR << "Error writing FlatFst to stream.";
+}
+
+void FlatFst::ReadHeader(std::istream &is, int64 *num_arcs) {
+  using namespace kaldi;
+  bool binary = true;
+  int32 format, num_states;
+  ExpectToken(is, binary, "<FlatFst>");
+  ReadBasicType(is, binary, &format);
+  if (format != 1 && format != 2)
+    KALDI_ERR << "This version of the code cannot read this FlatFst, "
+        "update your code.";
+  ReadBasicType(is, binary, &start_);
+  ReadBasicType(is, binary, &num_states);
+  ReadBasicType(is, binary, num_arcs);
+  KALDI_ASSERT(num_states >= 0 && *num_arcs >= 0);
+  num_states_ = num_states;
+  // Format 1 was the same but without the padding.
+  if (format >= 2)
+    ReadMmapPadding(is);
+}
+
+void FlatFst::Read(std::istream &is, bool binary) {
+  using namespace kaldi;
+  if (!binary)
+    KALDI_ERR << "FlatFst::Read only supports binary mode.";
+  mapped_file_.Close();
+  int64 num_arcs;
+  ReadHeader(is, &num_arcs);
+  HugePageMode mode = GetHugePageMode();
+  if (mode != kHugePagesNone) {
+    // Read the arrays, laid out as on disk, into huge pages.
+    char *data = buffer_.Allocate(ArraysSize(num_arcs), mode);
+    is.read(data, ArraysSize(num_arcs));
+    SetArraysFrom(data, num_arcs);
+    FreeStorage();
+  } else {
+    buffer_.Free();
+    AllocateStorage(num_arcs);
+    is.read(reinterpret_cast<char*>(final_costs_storage_.data()),
+            sizeof(float) * num_states_);
+    is.read(reinterpret_cast<char*>(arc_offsets_storage_.data()),
+            sizeof(uint32) * (num_states_ + 1));
+    is.read(reinterpret_cast<char*>(emitting_offsets_storage_.data()),
+            sizeof(uint32) * num_states_);
+    is.read(reinterpret_cast<char*>(arcs_storage_.data()),
+            sizeof(Arc) * num_arcs);
+  }
+  if (!is.good())
+    KALDI_ERR << "Error reading FlatFst from stream.";
+  ExpectToken(is, binary, "</FlatFst>");
+  if (arc_offsets_[num_states_] != num_arcs)
+    KALDI_ERR << "Corrupted FlatFst: arc offsets do not match number of arcs.";
+}
+
+void FlatFst::Map(const std::string &filename) {
+  using namespace kaldi;
+  bool binary;
+  Input ki(filename, &binary);
+  if (!binary)
+    KALDI_ERR << "FlatFst::Map: expected binary file " << filename;
+  std::istream &is = ki.Stream();
+  int64 num_arcs;
+  ReadHeader(is, &num_arcs);
+  std::streamoff offset = is.tellg();
+  // Check the end token without reading the arrays.
+  is.seekg(ArraysSize(num_arcs), std::ios_base::cur);
+  ExpectToken(is, binary, "</FlatFst>");
+  if (offset < 0 || offset % sizeof(uint32) != 0) {
+    KALDI_WARN << "FlatFst in " << filename << " cannot be mapped because its "
+               << "arrays are not aligned (was it written to a pipe?); "
+               << "reading it instead.";
+    Input ki2(filename, &binary);
+    Read(ki2.Stream(), binary);
+    return;
+  }
+
+  mapped_file_.Open(filename);
+  KALDI_ASSERT(offset + ArraysSize(num_arcs) <= mapped_file_.Size());
+  SetArraysFrom(mapped_file_.Data() + offset, num_arcs);
+  // Free any storage left over from before.
+  FreeStorage();
+  buffer_.Free();
+  if (arc_offsets_[num_states_] != num_arcs)
+    KALDI_ERR << "Corrupted FlatFst: arc offsets do not match number of arcs.";
+}
+
+}  // namespace fst
@@ -0,0 +1,276 @@
+// decoder/flat-fst.h
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_DECODER_FLAT_FST_H_
+#define KALDI_DECODER_FLAT_FST_H_
+
+/**
+   This header implements FlatFst, a read-only FST type that is laid out for
+   fast access from the CPU decoders.  It is the CPU analogue of CudaFst (see
+   ../cudadecoder/cuda-fst.h): the arcs of all states are stored in a single
+   array, and within each state the input-epsilon arcs come first, followed by
+   the emitting arcs, so the decoder can iterate over exactly the arcs it
+   needs in ProcessEmitting() and ProcessNonemitting() without testing the
+   ilabel of each arc.  Like GrammarFst, it does not inherit from fst::Fst; it
+   just has enough of the same interface for the decoders.
+
+   This header also defines EmittingArcIterator and EpsilonArcIterator, which
+   are what the decoders use to iterate over the emitting and input-epsilon
+   arcs of a state; for generic FST types they wrap ArcIterator and skip arcs
+   of the other kind, and for FlatFst they are specialized to iterate directly
+   over the corresponding range of arcs.
+ */
+
+#include "base/kaldi-common.h"
+#include "fst/fstlib.h"
+#include "util/kaldi-mmap.h"
+
+namespace fst {
+
+class FlatFst;
+
+// Declare that we'll be overriding class ArcIterator for class FlatFst.
+template<> class ArcIterator<FlatFst>;
+
+class FlatFst {
+ public:
+  typedef StdArc Arc;
+  typedef Arc::StateId StateId;
+  typedef Arc::Label Label;
+  typedef Arc::Weight Weight;
+
+  /// Constructs the FlatFst from any FST of StdArc type, e.g. an HCLG.fst as
+  /// read from disk.  Within each state the relative order of the epsilon arcs,
+  /// and of the emitting arcs, is preserved, so decoding with the FlatFst
+  /// gives exactly the same results as decoding with 'fst'.
+  explicit FlatFst(const Fst<StdArc> &fst);
+
+  /// This constructor should only be used prior to calling Read() or Map().
+  FlatFst();
+
+  // Writes the FST in a binary format that can be read back by Read() or
+  // Map().  Only binary mode is supported, but the option is allowed for
+  // compatibility with other Kaldi read/write functions (it will crash if
+  // binary == false).  The arrays are written page-aligned (if the stream
+  // position is known), so that Map() can use them in place.
+  void Write(std::ostream &os, bool binary) const;
+
+  // Reads the format that Write() outputs.  Will crash if binary == false.
+  // If huge pages were requested with --huge-pages (see kaldi::HugePageBuffer),
+  // the arrays are read into them; Map() then reads the file into them too.
+  void Read(std::istream &is, bool binary);
+
+  /// Memory-maps a FlatFst that was written to the file 'filename' (e.g. by
+  /// WriteKaldiObject(), possibly via make-flat-fst), instead of reading it.
+  /// The arrays are used in place from the mapped file, so this takes
+  /// negligible time and memory, and processes that map the same file share
+  /// the memory.  'filename' must be a plain file (not a pipe), and the FlatFst
+  /// must be the only thing in it.
+  void Map(const std::string &filename);
+
+  StateId Start() const { return start_; }
+
+  Weight Final(StateId s) const { return Weight(final_costs_[s]); }
+
+  StateId NumStates() const { return num_states_; }
+
+  size_t NumArcs(StateId s) const {
+    return arc_offsets_[s + 1] - arc_offsets_[s];
+  }
+
+  /// Returns the number of input-epsilon arcs leaving state s; the decoders
+  /// call this to decide whether a state needs to be processed in
+  /// ProcessNonemitting().
+  inline size_t NumInputEpsilons(StateId s) const {
+    return emitting_offsets_[s] - arc_offsets_[s];
+  }
+
+  /// Returns the arcs leaving state s: the input-epsilon arcs are in
+  /// [*begin, *mid) and the emitting arcs are in [*mid, *end).
+  inline void GetArcs(StateId s, const Arc **begin, const Arc **mid,
+                      const Arc **end) const {
+    *begin = arcs_ + arc_offsets_[s];
+    *mid = arcs_ + emitting_offsets_[s];
+    *end = arcs_ + arc_offsets_[s + 1];
+  }
+
+  inline std::string Type() const { return "flat"; }
+
+ private:
+  // Reads the header (everything up to the arrays) of the format that Write()
+  // outputs.
+  void ReadHeader(std::istream &is, int64 *num_arcs);
+
+  // Resizes the *_storage_ vectors and points the array pointers at them.
+  void AllocateStorage(int64 num_arcs);
+
+  // Frees the *_storage_ vectors, when the arrays are elsewhere.
+  void FreeStorage();
+
+  // Points the array pointers at the arrays which start at 'data' (which is
+  // laid out as Write() outputs them, e.g. in a mapped file).
+  void SetArraysFrom(const char *data, int64 num_arcs);
+
+  // Returns the number of bytes the arrays take up on disk.
+  size_t ArraysSize(int64 num_arcs) const;
+
+  StateId start_;
+  StateId num_states_;
+  // The final-cost of each state (infinity if it is not final).
+  const float *final_costs_;
+  // The arcs leaving state s are arcs_[arc_offsets_[s] ... arc_offsets_[s+1] -
+  // 1]; the size of arc_offsets_ is NumStates() + 1.
+  const uint32 *arc_offsets_;
+  // The arcs leaving s in the range arcs_[arc_offsets_[s] ...
+  // emitting_offsets_[s] - 1] are the input-epsilon arcs, and the rest are the
+  // emitting arcs.
+  const uint32 *emitting_offsets_;
+  const Arc *arcs_;
+
+  // If the FST was constructed or read with Read(), the arrays above point into
+  // these vectors, or into buffer_ if Read() was asked to use huge pages (see
+  // kaldi::GetHugePageMode()); if it was mapped with Map(), they point into
+  // mapped_file_.
+  std::vector<float> final_costs_storage_;
+  std::vector<uint32> arc_offsets_storage_;
+  std::vector<uint32> emitting_offsets_storage_;
+  std::vector<Arc> arcs_storage_;
+  kaldi::HugePageBuffer buffer_;
+  kaldi::MappedFile mapped_file_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(FlatFst);
+};
+
+
+/**
+   The overridden template for class ArcIterator for FlatFst.  It iterates over
+   all the arcs of a state (input-epsilon arcs first).  The decoders mostly use
+   EmittingArcIterator and EpsilonArcIterator instead.
+ */
+template <>
+class ArcIterator<FlatFst> {
+ public:
+  typedef FlatFst::Arc Arc;
+  typedef FlatFst::StateId StateId;
+
+  inline ArcIterator(const FlatFst &fst, StateId s) {
+    const Arc *mid;
+    fst.GetArcs(s, &arc_, &mid, &end_);
+  }
+  inline bool Done() const { return arc_ == end_; }
+  inline void Next() { ++arc_; }
+  inline const Arc &Value() const { return *arc_; }
+ private:
+  const Arc *arc_;
+  const Arc *end_;
+};
+
+
+/**
+   EmittingArcIterator iterates over the arcs with nonzero ilabel leaving a
+   state, in their original order.  This generic version works for any FST type
+   that has an ArcIterator (including GrammarFst); it is specialized below for
+   FlatFst.
+ */
+template <class FST>
+class EmittingArcIterator {
+ public:
+  typedef typename FST::Arc Arc;
+  typedef typename Arc::StateId StateId;
+
+  inline EmittingArcIterator(const FST &fst, StateId s): aiter_(fst, s) {
+    SkipEpsilons();
+  }
+  inline bool Done() { return aiter_.Done(); }
+  inline void Next() { aiter_.Next(); SkipEpsilons(); }
+  inline const Arc &Value() const { return aiter_.Value(); }
+ private:
+  inline void SkipEpsilons() {
+    while (!aiter_.Done() && aiter_.Value().ilabel == 0)
+      aiter_.Next();
+  }
+  ArcIterator<FST> aiter_;
+};
+
+/**
+   EpsilonArcIterator iterates over the arcs with zero ilabel leaving a state,
+   in their original order.  This generic version works for any FST type that
+   has an ArcIterator (including GrammarFst); it is specialized below for
+   FlatFst.
+ */
+template <class FST>
+class EpsilonArcIterator {
+ public:
+  typedef typename FST::Arc Arc;
+  typedef typename Arc::StateId StateId;
+
+  inline EpsilonArcIterator(const FST &fst, StateId s): aiter_(fst, s) {
+    SkipEmitting();
+  }
+  inline bool Done() { return aiter_.Done(); }
+  inline void Next() { aiter_.Next(); SkipEmitting(); }
+  inline const Arc &Value() const { return aiter_.Value(); }
+ private:
+  inline void SkipEmitting() {
+    while (!aiter_.Done() && aiter_.Value().ilabel != 0)
+      aiter_.Next();
+  }
+  ArcIterator<FST> aiter_;
+};
+
+template <>
+class EmittingArcIterator<FlatFst> {
+ public:
+  typedef FlatFst::Arc Arc;
+  typedef FlatFst::StateId StateId;
+
+  inline EmittingArcIterator(const FlatFst &fst, StateId s) {
+    const Arc *begin;
+    fst.GetArcs(s, &begin, &arc_, &end_);
+  }
+  inline bool Done() const { return arc_ == end_; }
+  inline void Next() { ++arc_; }
+  inline const Arc &Value() const { return *arc_; }
+ private:
+  const Arc *arc_;
+  const Arc *end_;
+};
+
+template <>
+class EpsilonArcIterator<FlatFst> {
+ public:
+  typedef FlatFst::Arc Arc;
+  typedef FlatFst::StateId StateId;
+
+  inline EpsilonArcIterator(const FlatFst &fst, StateId s) {
+    const Arc *end;
+    fst.GetArcs(s, &arc_, &end_, &end);
+  }
+  inline bool Done() const { return arc_ == end_; }
+  inline void Next() { ++arc_; }
+  inline const Arc &Value() const { return *arc_; }
+ private:
+  const Arc *arc_;
+  const Arc *end_;
+};
+
+
+}  // namespace fst
+
+#endif  // KALDI_DECODER_FLAT_FST_H_
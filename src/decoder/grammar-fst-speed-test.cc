@@ -0,0 +1,140 @@
+// decoder/grammar-fst-speed-test.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/kaldi-common.h"
+#include "base/timer.h"
+#include "util/common-utils.h"
+#include "fstext/fstext-lib.h"
+#include "hmm/transition-model.h"
+#include "decoder/decodable-matrix.h"
+#include "decoder/grammar-fst.h"
+#include "decoder/lattice-faster-decoder.h"
+
+namespace kaldi {
+
+// Decodes all of 'loglikes' with 'decoder' and returns the time taken, in
+// seconds.  'num_frames' is incremented by the number of frames decoded.
+template <typename FST>
+double DecodeAll(const TransitionModel &trans_model,
+                 const std::vector<Matrix<BaseFloat> > &loglikes,
+                 BaseFloat acoustic_scale,
+                 LatticeFasterDecoderTpl<FST> *decoder,
+                 int64 *num_frames) {
+  Timer timer;
+  for (size_t i = 0; i < loglikes.size(); i++) {
+    DecodableMatrixScaledMapped decodable(trans_model, loglikes[i],
+                                          acoustic_scale);
+    decoder->Decode(&decodable);
+    Lattice lat;
+    decoder->GetRawLattice(&lat, true);
+    *num_frames += decoder->NumFramesDecoded();
+  }
+  return timer.Elapsed();
+}
+
+}  // namespace kaldi
+
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    typedef kaldi::int32 int32;
+
+    const char *usage =
+        "Speed test for decoding with a GrammarFst, which compares the frames\n"
+        "per second of LatticeFasterDecoder on a GrammarFst with the same\n"
+        "decoder on a plain HCLG (normally the GrammarFst converted to an\n"
+        "FST with make-grammar-fst --write-as-grammar=false, so the search is\n"
+        "the same).  The GrammarFst is decoded with the states it expanded\n"
+        "kept from one utterance to the next (as a decoder normally does),\n"
+        "and with them cleared before each utterance.\n"
+        "\n"
+        "Usage: grammar-fst-speed-test [options] <model-in> <hclg-fst-in> "
+        "<grammar-fst-in> <loglikes-rspecifier>\n"
+        " e.g.: grammar-fst-speed-test final.mdl HCLG.fst HCLG.gra "
+        "ark:loglikes.ark\n";
+    ParseOptions po(usage);
+    BaseFloat acoustic_scale = 0.1;
+    int32 num_utts = 20, num_repeats = 3;
+    LatticeFasterDecoderConfig config;
+    config.Register(&po);
+    po.Register("acoustic-scale", &acoustic_scale,
+                "Scaling factor for acoustic likelihoods");
+    po.Register("num-utts", &num_utts,
+                "Number of utterances to decode (they are read into memory)");
+    po.Register("num-repeats", &num_repeats,
+                "Number of times to decode the utterances with each graph");
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 4) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    TransitionModel trans_model;
+    ReadKaldiObject(po.GetArg(1), &trans_model);
+    fst::StdFst *hclg_fst = fst::ReadFstKaldiGeneric(po.GetArg(2));
+    fst::GrammarFst grammar_fst;
+    ReadKaldiObject(po.GetArg(3), &grammar_fst);
+    std::vector<Matrix<BaseFloat> > loglikes;
+    SequentialBaseFloatMatrixReader loglike_reader(po.GetArg(4));
+    for (; !loglike_reader.Done() && loglikes.size() < num_utts;
+         loglike_reader.Next())
+      loglikes.push_back(loglike_reader.Value());
+    if (loglikes.empty())
+      KALDI_ERR << "No log-likelihoods were read.";
+
+    double hclg_seconds = 0.0, warm_seconds = 0.0, cold_seconds = 0.0;
+    int64 hclg_frames = 0, warm_frames = 0, cold_frames = 0;
+    LatticeFasterDecoder hclg_decoder(*hclg_fst, config);
+    LatticeFasterDecoderTpl<fst::GrammarFst> grammar_decoder(grammar_fst,
+                                                             config);
+    for (int32 r = 0; r < num_repeats; r++) {
+      hclg_seconds += DecodeAll(trans_model, loglikes, acoustic_scale,
+                                &hclg_decoder, &hclg_frames);
+      warm_seconds += DecodeAll(trans_model, loglikes, acoustic_scale,
+                                &grammar_decoder, &warm_frames);
+    }
+    size_t num_expanded = grammar_fst.NumExpandedStates();
+    for (int32 r = 0; r < num_repeats; r++) {
+      for (size_t i = 0; i < loglikes.size(); i++) {
+        grammar_fst.ClearExpandedStates();
+        std::vector<Matrix<BaseFloat> > utt(1, loglikes[i]);
+        cold_seconds += DecodeAll(trans_model, utt, acoustic_scale,
+                                  &grammar_decoder, &cold_frames);
+      }
+    }
+
+    double hclg_fps = hclg_frames / hclg_seconds,
+        warm_fps = warm_frames / warm_seconds,
+        cold_fps = cold_frames / cold_seconds;
+    KALDI_LOG << "HCLG: " << hclg_fps << " frames per second.";
+    KALDI_LOG << "GrammarFst, expanded states kept: " << warm_fps
+              << " frames per second (" << (100.0 * warm_fps / hclg_fps)
+              << "% of HCLG); " << num_expanded << " states were expanded.";
+    KALDI_LOG << "GrammarFst, expanded states cleared per utterance: "
+              << cold_fps << " frames per second ("
+              << (100.0 * cold_fps / hclg_fps) << "% of HCLG).";
+    delete hclg_fst;
+    return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
@@ -33,6 +33,38 @@ GrammarFst::GrammarFst(
   Init();
 }
 
+GrammarFst::GrammarFst(
+    const GrammarFst &base,
+    const std::vector<std::pair<Label, std::shared_ptr<const ConstFst<StdArc> > > > &extra_ifsts):
+    nonterm_phones_offset_(base.nonterm_phones_offset_),
+    top_fst_(base.top_fst_),
+    ifsts_(base.ifsts_),
+    nonterminal_map_(base.nonterminal_map_),
+    entry_arcs_(base.entry_arcs_) {
+  KALDI_ASSERT(top_fst_ != NULL && "GrammarFst: base was not initialized.");
+  for (size_t i = 0; i < extra_ifsts.size(); i++) {
+    int32 nonterminal = extra_ifsts[i].first;
+    if (nonterminal < GetPhoneSymbolFor(kNontermUserDefined))
+      KALDI_ERR << "Nonterminal symbol " << nonterminal
+                << " in input pairs, was expected to be >= "
+                << GetPhoneSymbolFor(kNontermUserDefined);
+    std::unordered_map<int32, int32>::const_iterator iter =
+        nonterminal_map_.find(nonterminal);
+    int32 ifst_index;
+    if (iter != nonterminal_map_.end()) {
+      ifst_index = iter->second;
+      ifsts_[ifst_index].second = extra_ifsts[i].second;
+    } else {
+      ifst_index = ifsts_.size();
+      ifsts_.push_back(extra_ifsts[i]);
+      entry_arcs_.resize(ifsts_.size());
+      nonterminal_map_[nonterminal] = ifst_index;
+    }
+    InitEntryArcs(ifst_index);
+  }
+  InitInstances();
+}
+
 void GrammarFst::Init() {
   KALDI_ASSERT(nonterm_phones_offset_ > 1);
   InitNonterminalMap();
@@ -54,16 +86,7 @@ GrammarFst::~GrammarFst() {
 }
 
 void GrammarFst::Destroy() {
-  for (size_t i = 0; i < instances_.size(); i++) {
-    FstInstance &instance = instances_[i];
-    std::unordered_map<BaseStateId, ExpandedState*>::const_iterator
-        iter = instance.expanded_states.begin(),
-        end = instance.expanded_states.end();
-    for (; iter != end; ++iter) {
-      ExpandedState *e = iter->second;
-      delete e;
-    }
-  }
+  // The ExpandedStates are freed by the shared pointers in instances_.
   top_fst_ = NULL;
   ifsts_.clear();
   nonterminal_map_.clear();
@@ -72,6 +95,43 @@ void GrammarFst::Destroy() {
 }
 
 
+void GrammarFst::ClearExpandedStates() {
+  for (size_t i = 0; i < instances_.size(); i++)
+    instances_[i].expanded_states.Clear();
+}
+
+size_t GrammarFst::NumExpandedStates() const {
+  size_t ans = 0;
+  for (size_t i = 0; i < instances_.size(); i++)
+    ans += instances_[i].expanded_states.Size();
+  return ans;
+}
+
+void GrammarFst::ExpandedStateMap::Insert(
+    BaseStateId s, std::shared_ptr<ExpandedState> expanded) {
+  KALDI_ASSERT(s != kNoStateId);
+  if (2 * (num_entries_ + 1) > buckets_.size()) {
+    // Keep the load factor at most 1/2, so the probe sequences stay short.
+    std::vector<Bucket> old_buckets(std::max<size_t>(16, 2 * buckets_.size()));
+    old_buckets.swap(buckets_);
+    shift_ = 64;
+    for (size_t n = buckets_.size(); n > 1; n >>= 1)
+      shift_--;
+    num_entries_ = 0;
+    for (size_t i = 0; i < old_buckets.size(); i++)
+      if (old_buckets[i].state != kNoStateId)
+        Insert(old_buckets[i].state, old_buckets[i].expanded);
+  }
+  size_t mask = buckets_.size() - 1, i = Hash(s);
+  while (buckets_[i].state != kNoStateId) {
+    KALDI_ASSERT(buckets_[i].state != s);
+    i = (i + 1) & mask;
+  }
+  buckets_[i].state = s;
+  buckets_[i].expanded = expanded;
+  num_entries_++;
+}
+
 void GrammarFst::DecodeSymbol(Label label,
                               int32 *nonterminal_symbol,
                               int32 *left_context_phone) {
@@ -978,6 +1038,89 @@ void PrepareForGrammarFst(int32 nonterm_phones_offset,
   p.Prepare();
 }
 
+size_t GrammarSubFstCache::HashFst(const Fst<StdArc> &fst) {
+  // FNV-1a over the start state, and the final-prob and arcs of each state.
+  uint64 hash = 14695981039346656037ULL;
+  const uint64 prime = 1099511628211ULL;
+  hash = (hash ^ static_cast<uint64>(fst.Start())) * prime;
+  for (StateIterator<Fst<StdArc> > siter(fst); !siter.Done(); siter.Next()) {
+    StdArc::StateId s = siter.Value();
+    float final_cost = fst.Final(s).Value();
+    uint32 final_bits;
+    memcpy(&final_bits, &final_cost, sizeof(final_bits));
+    hash = (hash ^ static_cast<uint64>(s)) * prime;
+    hash = (hash ^ final_bits) * prime;
+    for (ArcIterator<Fst<StdArc> > aiter(fst, s); !aiter.Done(); aiter.Next()) {
+      const StdArc &arc = aiter.Value();
+      float cost = arc.weight.Value();
+      uint32 cost_bits;
+      memcpy(&cost_bits, &cost, sizeof(cost_bits));
+      hash = (hash ^ static_cast<uint64>(arc.ilabel)) * prime;
+      hash = (hash ^ static_cast<uint64>(arc.olabel)) * prime;
+      hash = (hash ^ cost_bits) * prime;
+      hash = (hash ^ static_cast<uint64>(arc.nextstate)) * prime;
+    }
+  }
+  return static_cast<size_t>(hash);
+}
+
+std::shared_ptr<const ConstFst<StdArc> > GrammarSubFstCache::Lookup(
+    const Fst<StdArc> &fst) {
+  size_t hash = HashFst(fst);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    typedef std::unordered_multimap<size_t,
+                                    std::list<Entry>::iterator>::iterator IterType;
+    std::pair<IterType, IterType> range = index_.equal_range(hash);
+    for (IterType iter = range.first; iter != range.second; ++iter) {
+      std::list<Entry>::iterator entry = iter->second;
+      // Compare the content too, in case of hash collisions.
+      if (Equal(*(entry->second), fst, 0.0)) {
+        entries_.splice(entries_.begin(), entries_, entry);
+        num_hits_++;
+        return entry->second;
+      }
+    }
+  }
+  // Convert outside the lock, as this is the slow part; if another thread
+  // adds the same FST meanwhile we just cache it twice.
+  std::shared_ptr<const ConstFst<StdArc> > ans(new ConstFst<StdArc>(fst));
+  std::lock_guard<std::mutex> lock(mutex_);
+  num_misses_++;
+  entries_.push_front(Entry(hash, ans));
+  index_.insert(std::make_pair(hash, entries_.begin()));
+  while (entries_.size() > max_entries_) {
+    std::list<Entry>::iterator last = entries_.end();
+    --last;
+    typedef std::unordered_multimap<size_t,
+                                    std::list<Entry>::iterator>::iterator IterType;
+    std::pair<IterType, IterType> range = index_.equal_range(last->first);
+    for (IterType iter = range.first; iter != range.second; ++iter) {
+      if (iter->second == last) {
+        index_.erase(iter);
+        break;
+      }
+    }
+    entries_.erase(last);
+  }
+  return ans;
+}
+
+size_t GrammarSubFstCache::NumEntries() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return entries_.size();
+}
+
+int64 GrammarSubFstCache::NumHits() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return num_hits_;
+}
+
+int64 GrammarSubFstCache::NumMisses() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return num_misses_;
+}
+
 void CopyToVectorFst(GrammarFst *grammar_fst,
                      VectorFst<StdArc> *vector_fst) {
   typedef GrammarFstArc::StateId GrammarStateId;  // int64
@@ -32,6 +32,10 @@
 
 
 
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
 #include "fst/fstlib.h"
 #include "fstext/grammar-context-fst.h"
 
@@ -147,9 +151,33 @@ class GrammarFst {
 
   /// Copy constructor.  Useful because this object is not thread safe so cannot
   /// be used by multiple parallel decoder threads, but it is lightweight and
-  /// can copy it without causing the stored FSTs to be copied.
+  /// can copy it without causing the stored FSTs to be copied.  The copy
+  /// shares the states that 'other' has already expanded (they are never
+  /// modified once created), but states expanded afterwards are only cached
+  /// in the object that expanded them.
   GrammarFst(const GrammarFst &other) = default;
 
+  /**
+     This constructor is for inserting per-request FSTs, e.g. a list of contact
+     names for one user, into a shared grammar.  The new object shares the FSTs
+     of 'base' (it only copies the shared pointers), and adds the nonterminal
+     FSTs in 'extra_ifsts' to them.  If a nonterminal in 'extra_ifsts' already
+     has an FST in 'base', the one in 'extra_ifsts' replaces it, so 'base' can
+     contain, for instance, an FST for #nonterm:contact with an empty or generic
+     list which each request overrides.  The FSTs in 'extra_ifsts' must have
+     been prepared by PrepareForGrammarFst(), like the ones in 'base' (see
+     GrammarSubFstCache for a way to share them between requests).
+
+     This is about as cheap as the copy constructor: 'base' is not modified,
+     and the states of the new object are expanded on demand as the decoder
+     visits them, as usual.  The entry points of the extra FSTs are checked
+     immediately, so that a badly prepared per-request FST is reported here
+     and not in the middle of decoding.
+  */
+  GrammarFst(
+      const GrammarFst &base,
+      const std::vector<std::pair<int32, std::shared_ptr<const ConstFst<StdArc> > > > &extra_ifsts);
+
   ///  This constructor should only be used prior to calling Read().
   GrammarFst() { }
 
@@ -202,11 +230,80 @@ class GrammarFst {
 
   inline std::string Type() const { return "grammar"; }
 
+  /// Forgets the states expanded so far (they will be expanded again when
+  /// next visited), which releases their memory; e.g. a long-running decoder
+  /// may call this between utterances.  Must not be called while an
+  /// ArcIterator of this object is in use.
+  void ClearExpandedStates();
+
+  /// Returns the number of states expanded so far, over all FST instances.
+  size_t NumExpandedStates() const;
+
+  /// Returns the integer id of #nonterm_bos in phones.txt, as given to the
+  /// constructor.
+  int32 NontermPhonesOffset() const { return nonterm_phones_offset_; }
+
   ~GrammarFst();
  private:
 
   struct ExpandedState;
 
+  /**
+     ExpandedStateMap is the map from a state in an FST instance to its
+     ExpandedState.  It is looked up every time the decoder creates an
+     ArcIterator for a special state, so rather than std::unordered_map it
+     is a flat hash table with open addressing and linear probing, which
+     usually finds the state in the first bucket without following any
+     pointers.  The ExpandedStates are held by shared pointers so that copies
+     of the GrammarFst can share them.
+   */
+  class ExpandedStateMap {
+   public:
+    ExpandedStateMap(): num_entries_(0), shift_(64) { }
+
+    // Returns the ExpandedState for state 's', or NULL if there is none.
+    inline ExpandedState *Find(BaseStateId s) const {
+      if (num_entries_ == 0)
+        return NULL;
+      size_t mask = buckets_.size() - 1;
+      for (size_t i = Hash(s); ; i = (i + 1) & mask) {
+        const Bucket &bucket = buckets_[i];
+        if (bucket.state == s)
+          return bucket.expanded.get();
+        if (bucket.state == kNoStateId)
+          return NULL;
+      }
+    }
+
+    // Adds the ExpandedState for state 's', which must not be present.
+    void Insert(BaseStateId s, std::shared_ptr<ExpandedState> expanded);
+
+    size_t Size() const { return num_entries_; }
+
+    void Clear() {
+      buckets_.clear();
+      num_entries_ = 0;
+      shift_ = 64;
+    }
+
+   private:
+    struct Bucket {
+      BaseStateId state;  // kNoStateId if the bucket is empty.
+      std::shared_ptr<ExpandedState> expanded;
+      Bucket(): state(kNoStateId) { }
+    };
+
+    // Fibonacci hashing: the top bits of the product index the buckets.
+    inline size_t Hash(BaseStateId s) const {
+      return static_cast<size_t>((static_cast<uint64>(s) *
+                                  11400714819323198485ULL) >> shift_);
+    }
+
+    std::vector<Bucket> buckets_;  // The size is zero or a power of two.
+    size_t num_entries_;
+    int32 shift_;  // 64 - log2(buckets_.size()).
+  };
+
   friend class ArcIterator<GrammarFst>;
 
   // sets up nonterminal_map_.
@@ -348,18 +445,15 @@ class GrammarFst {
   */
   inline ExpandedState *GetExpandedState(int32 instance_id,
                                          BaseStateId state_id) {
-    std::unordered_map<BaseStateId, ExpandedState*> &expanded_states =
-        instances_[instance_id].expanded_states;
-
-    std::unordered_map<BaseStateId, ExpandedState*>::iterator iter =
-        expanded_states.find(state_id);
-    if (iter != expanded_states.end()) {
-      return iter->second;
+    ExpandedState *ans = instances_[instance_id].expanded_states.Find(state_id);
+    if (ans != NULL) {
+      return ans;
     } else {
-      ExpandedState *ans = ExpandState(instance_id, state_id);
-      // Don't use the reference 'expanded_states'; it could have been
-      // invalidated.
-      instances_[instance_id].expanded_states[state_id] = ans;
+      ans = ExpandState(instance_id, state_id);
+      // Don't keep a reference to instances_[instance_id] across the call
+      // above; it could have been invalidated.
+      instances_[instance_id].expanded_states.Insert(
+          state_id, std::shared_ptr<ExpandedState>(ans));
       return ans;
     }
   }
@@ -407,7 +501,7 @@ class GrammarFst {
     // FST that the final-prob's value equal to
     // KALDI_GRAMMAR_FST_SPECIAL_WEIGHT.  (That final-prob value is used as a
     // kind of signal to this code that the state needs expansion).
-    std::unordered_map<BaseStateId, ExpandedState*> expanded_states;
+    ExpandedStateMap expanded_states;
 
     // 'child_instances', which is populated on demand as states in this FST
     // instance are accessed, is logically a map from pair (nonterminal_index,
@@ -597,6 +691,46 @@ class ArcIterator<GrammarFst> {
 void CopyToVectorFst(GrammarFst *grammar_fst,
                      VectorFst<StdArc> *vector_fst);
 
+/**
+   GrammarSubFstCache holds the per-request nonterminal FSTs given to the
+   GrammarFst constructor that takes 'extra_ifsts', indexed by a hash of their
+   content, so that requests with the same list (e.g. the same user's contacts)
+   share a single ConstFst instead of each converting and holding their own.
+   It keeps at most 'max_entries' FSTs, dropping the least recently used ones;
+   an FST that is dropped stays alive as long as a GrammarFst uses it.  It is
+   safe to use from multiple threads.
+ */
+class GrammarSubFstCache {
+ public:
+  explicit GrammarSubFstCache(size_t max_entries = 1000):
+      max_entries_(max_entries), num_hits_(0), num_misses_(0) { }
+
+  /// Returns the cached ConstFst whose content equals 'fst', first adding a
+  /// copy of 'fst' to the cache if there is none.  'fst' must have been
+  /// prepared by PrepareForGrammarFst().
+  std::shared_ptr<const ConstFst<StdArc> > Lookup(const Fst<StdArc> &fst);
+
+  /// Returns a hash of the states, arcs and final-probs of 'fst'.
+  static size_t HashFst(const Fst<StdArc> &fst);
+
+  size_t NumEntries() const;
+  int64 NumHits() const;
+  int64 NumMisses() const;
+
+ private:
+  typedef std::pair<size_t, std::shared_ptr<const ConstFst<StdArc> > > Entry;
+
+  size_t max_entries_;
+  // The cached FSTs with their hashes, the most recently used first.
+  std::list<Entry> entries_;
+  // Maps from a hash to the positions in entries_ of the FSTs with that hash
+  // (usually just one).
+  std::unordered_multimap<size_t, std::list<Entry>::iterator> index_;
+  int64 num_hits_;
+  int64 num_misses_;
+  mutable std::mutex mutex_;
+};
+
 /**
    This function prepares 'ifst' for use in GrammarFst: it ensures that it has
    the expected properties, changing it slightly as needed.  'ifst' is expected
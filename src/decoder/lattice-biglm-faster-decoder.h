@@ -43,9 +43,17 @@ typedef LatticeFasterDecoderConfig LatticeBiglmFasterDecoderConfig;
     DeterministicOnDemandFst follows through the epsilons in G for you
     (assuming G is a standard backoff language model) and makes it look
     like a determinized FST.
-*/
 
-class LatticeBiglmFasterDecoder {
+    It is templated on the type of the difference LM, LmFst, which must be
+    fst::DeterministicOnDemandFst<fst::StdArc> or a class derived from it.
+    The decoder calls LmFst::GetArc() for every token expansion that crosses a
+    word, so if LmFst is a class declared 'final' such as
+    fst::ConcurrentCacheDeterministicOnDemandFst, those calls are not virtual
+    and can be inlined.  The tokens are hashed on PairId, which packs the
+    state in HCLG and the LM state into 64 bits.
+*/
+template <typename LmFst>
+class LatticeBiglmFasterDecoderTpl {
  public:
   typedef fst::StdArc Arc;
   typedef Arc::Label Label;
@@ -54,10 +62,10 @@ class LatticeBiglmFasterDecoder {
   typedef uint64 PairId;
   typedef Arc::Weight Weight;
   // instantiate this class once for each thing you have to decode.
-  LatticeBiglmFasterDecoder(
+  LatticeBiglmFasterDecoderTpl(
       const fst::Fst<fst::StdArc> &fst,      
       const LatticeBiglmFasterDecoderConfig &config,
-      fst::DeterministicOnDemandFst<fst::StdArc> *lm_diff_fst):
+      LmFst *lm_diff_fst):
       fst_(fst), lm_diff_fst_(lm_diff_fst), config_(config),
       warned_noarc_(false), num_toks_(0) {
     config.Check();
@@ -67,7 +75,7 @@ class LatticeBiglmFasterDecoder {
   }
   void SetOptions(const LatticeBiglmFasterDecoderConfig &config) { config_ = config; } 
   LatticeBiglmFasterDecoderConfig GetOptions() { return config_; } 
-  ~LatticeBiglmFasterDecoder() {
+  ~LatticeBiglmFasterDecoderTpl() {
     DeleteElems(toks_.Clear());    
     ClearActiveTokens();
   }
@@ -172,7 +180,7 @@ class LatticeBiglmFasterDecoder {
         for (ForwardLink *l = tok->links;
              l != NULL;
              l = l->next) {
-          unordered_map<Token*, StateId>::const_iterator iter =
+          typename unordered_map<Token*, StateId>::const_iterator iter =
               tok_map.find(l->next_tok);
           StateId nextstate = iter->second;
           KALDI_ASSERT(iter != tok_map.end());
@@ -183,7 +191,7 @@ class LatticeBiglmFasterDecoder {
         }
         if (f == num_frames) {
           if (use_final_probs && !final_costs_.empty()) {
-            std::map<Token*, BaseFloat>::const_iterator iter =
+            typename std::map<Token*, BaseFloat>::const_iterator iter =
                 final_costs_.find(tok);
             if (iter != final_costs_.end())
               ofst->SetFinal(cur_state, LatticeWeight(iter->second, 0));
@@ -297,7 +305,7 @@ class LatticeBiglmFasterDecoder {
                  must_prune_tokens(true) { }
   };
 
-  typedef HashList<PairId, Token*>::Elem Elem;
+  typedef typename HashList<PairId, Token*>::Elem Elem;
   
   void PossiblyResizeHash(size_t num_toks) {
     size_t new_sz = static_cast<size_t>(static_cast<BaseFloat>(num_toks)
@@ -840,7 +848,7 @@ class LatticeBiglmFasterDecoder {
   std::vector<BaseFloat> tmp_array_;  // used in GetCutoff.
   // make it class member to avoid internal new/delete.
   const fst::Fst<fst::StdArc> &fst_;
-  fst::DeterministicOnDemandFst<fst::StdArc> *lm_diff_fst_;  
+  LmFst *lm_diff_fst_;  
   LatticeBiglmFasterDecoderConfig config_;
   bool warned_noarc_;  
   int32 num_toks_; // current total #toks allocated...
@@ -881,6 +889,9 @@ class LatticeBiglmFasterDecoder {
   }
 };
 
+typedef LatticeBiglmFasterDecoderTpl<fst::DeterministicOnDemandFst<fst::StdArc> >
+    LatticeBiglmFasterDecoder;
+
 } // end namespace kaldi.
 
 #endif
@@ -0,0 +1,240 @@
+// decoder/lattice-faster-decoder-speed-test.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/kaldi-common.h"
+#include "base/timer.h"
+#include "util/common-utils.h"
+#include "fstext/fstext-lib.h"
+#include "hmm/transition-model.h"
+#include "decoder/decodable-matrix.h"
+#include "decoder/lattice-faster-decoder.h"
+
+namespace kaldi {
+
+// The time taken by each phase of decoding, in nanoseconds, summed over
+// utterances.
+struct DecoderPhaseTimes {
+  int64 emitting, nonemitting, prune, finalize, raw_lattice;
+  int64 num_frames, num_utts, num_lattice_arcs;
+  DecoderPhaseTimes(): emitting(0), nonemitting(0), prune(0), finalize(0),
+                       raw_lattice(0), num_frames(0), num_utts(0),
+                       num_lattice_arcs(0) { }
+};
+
+// This decoder times the phases of LatticeFasterDecoder::Decode() and
+// GetRawLattice() separately; it inherits from it so that it can call the
+// protected functions.
+class TimedLatticeFasterDecoder: public LatticeFasterDecoder {
+ public:
+  TimedLatticeFasterDecoder(const fst::StdFst &fst,
+                            const LatticeFasterDecoderConfig &config):
+      LatticeFasterDecoder(fst, config) { }
+
+  // Does the same as Decode() followed by GetRawLattice(), adding the time
+  // taken by each phase to 'times'.
+  void DecodeTimed(DecodableInterface *decodable, DecoderPhaseTimes *times) {
+    InitDecoding();
+    int64 t;
+    while (!decodable->IsLastFrame(NumFramesDecoded() - 1)) {
+      if (NumFramesDecoded() % config_.prune_interval == 0) {
+        t = Tracer::Now();
+        PruneActiveTokens(config_.lattice_beam * config_.prune_scale);
+        times->prune += Tracer::Now() - t;
+      }
+      t = Tracer::Now();
+      BaseFloat cost_cutoff = ProcessEmitting(decodable);
+      int64 emitting = Tracer::Now() - t;
+      t = Tracer::Now();
+      ProcessNonemitting(cost_cutoff);
+      int64 nonemitting = Tracer::Now() - t;
+      times->emitting += emitting;
+      times->nonemitting += nonemitting;
+      if (config_.HasFrameBudget())
+        UpdateBudgetBeam((emitting + nonemitting) * 1.0e-09);
+    }
+    t = Tracer::Now();
+    FinalizeDecoding();
+    times->finalize += Tracer::Now() - t;
+    Lattice lat;
+    t = Tracer::Now();
+    GetRawLattice(&lat, true);
+    times->raw_lattice += Tracer::Now() - t;
+    for (StateId s = 0; s < lat.NumStates(); s++)
+      times->num_lattice_arcs += lat.NumArcs(s);
+    times->num_frames += NumFramesDecoded();
+    times->num_utts++;
+  }
+};
+
+
+// Creates a random graph that is a bit like an HCLG: each state has a
+// self-loop and a few arcs to other states, with input labels between 1 and
+// 'num_pdfs', some with output labels (words); and there are some epsilon
+// arcs, which only go to higher-numbered states so there are no epsilon
+// cycles.
+void CreateRandomGraph(int32 num_states, int32 num_pdfs,
+                       fst::StdVectorFst *fst) {
+  typedef fst::StdArc Arc;
+  fst->DeleteStates();
+  for (int32 s = 0; s < num_states; s++)
+    fst->AddState();
+  fst->SetStart(0);
+  for (int32 s = 0; s < num_states; s++) {
+    fst->AddArc(s, Arc(RandInt(1, num_pdfs), 0, 0.5 * RandUniform(), s));
+    int32 num_arcs = RandInt(1, 4);
+    for (int32 i = 0; i < num_arcs; i++) {
+      int32 olabel = (WithProb(0.1) ? RandInt(1, 10000) : 0);
+      fst->AddArc(s, Arc(RandInt(1, num_pdfs), olabel, 5.0 * RandUniform(),
+                         RandInt(0, num_states - 1)));
+    }
+    if (s + 1 < num_states && WithProb(0.2))
+      fst->AddArc(s, Arc(0, 0, 3.0 * RandUniform(),
+                         RandInt(s + 1, std::min(s + 100, num_states - 1))));
+    if (WithProb(0.05))
+      fst->SetFinal(s, 2.0 * RandUniform());
+  }
+}
+
+// Prints the time per frame of each phase; the times in 'times' are in
+// nanoseconds.
+void PrintPhaseTimes(const LatticeFasterDecoderConfig &config,
+                     const DecoderPhaseTimes &times) {
+  double frames = times.num_frames;
+  int64 total = times.emitting + times.nonemitting + times.prune +
+      times.finalize + times.raw_lattice;
+  KALDI_LOG << "For beam=" << config.beam << " max-active="
+            << config.max_active << " lattice-beam=" << config.lattice_beam
+            << " frame-budget-arcs=" << config.frame_budget_arcs
+            << ": " << (frames * 1.0e+09 / total) << " frames per second; "
+            << "microseconds per frame: ProcessEmitting "
+            << (times.emitting * 1.0e-03 / frames) << ", ProcessNonemitting "
+            << (times.nonemitting * 1.0e-03 / frames)
+            << ", PruneActiveTokens " << (times.prune * 1.0e-03 / frames)
+            << ", FinalizeDecoding " << (times.finalize * 1.0e-03 / frames)
+            << ", GetRawLattice " << (times.raw_lattice * 1.0e-03 / frames)
+            << "; " << (times.num_lattice_arcs / frames)
+            << " lattice arcs per frame.";
+}
+
+}  // namespace kaldi
+
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    typedef kaldi::int32 int32;
+
+    const char *usage =
+        "Speed test for LatticeFasterDecoder, which times ProcessEmitting(),\n"
+        "ProcessNonemitting(), PruneActiveTokens(), FinalizeDecoding() and\n"
+        "GetRawLattice() separately, for each combination of the values of\n"
+        "--beams, --max-actives and --lattice-beams.  With no arguments it\n"
+        "uses a random graph and random log-likelihoods; otherwise it replays\n"
+        "log-likelihoods (e.g. from nnet3-compute) against a real graph.\n"
+        "\n"
+        "Usage: lattice-faster-decoder-speed-test [options] "
+        "[<model-in> <fst-in> <loglikes-rspecifier>]\n"
+        " e.g.: lattice-faster-decoder-speed-test final.mdl HCLG.fst "
+        "ark:loglikes.ark\n";
+    ParseOptions po(usage);
+    std::string beams = "11,13,15", max_actives = "2000,7000",
+        lattice_beams = "6,8";
+    BaseFloat acoustic_scale = 0.1;
+    int32 num_utts = 20, frame_budget_arcs = 0;
+    po.Register("beams", &beams, "Comma-separated list of values of --beam");
+    po.Register("max-actives", &max_actives,
+                "Comma-separated list of values of --max-active");
+    po.Register("lattice-beams", &lattice_beams,
+                "Comma-separated list of values of --lattice-beam");
+    po.Register("acoustic-scale", &acoustic_scale,
+                "Scaling factor for acoustic likelihoods");
+    po.Register("num-utts", &num_utts,
+                "Number of utterances to decode (they are read into memory)");
+    po.Register("frame-budget-arcs", &frame_budget_arcs,
+                "If >0, the --frame-budget-arcs option of the decoder, to "
+                "see its effect on the time per frame");
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 0 && po.NumArgs() != 3) {
+      po.PrintUsage();
+      exit(1);
+    }
+    std::vector<BaseFloat> beam_values, lattice_beam_values;
+    std::vector<int32> max_active_values;
+    if (!SplitStringToFloats(beams, ",", false, &beam_values) ||
+        !SplitStringToIntegers(max_actives, ",", false, &max_active_values) ||
+        !SplitStringToFloats(lattice_beams, ",", false, &lattice_beam_values))
+      KALDI_ERR << "Invalid --beams, --max-actives or --lattice-beams option.";
+
+    TransitionModel trans_model;
+    fst::StdFst *decode_fst = NULL;
+    std::vector<Matrix<BaseFloat> > loglikes;
+    if (po.NumArgs() == 3) {
+      ReadKaldiObject(po.GetArg(1), &trans_model);
+      decode_fst = fst::ReadFstKaldiGeneric(po.GetArg(2));
+      SequentialBaseFloatMatrixReader loglike_reader(po.GetArg(3));
+      for (; !loglike_reader.Done() && loglikes.size() < num_utts;
+           loglike_reader.Next())
+        loglikes.push_back(loglike_reader.Value());
+    } else {
+      int32 num_states = 20000, num_pdfs = 2000, num_frames = 300;
+      fst::StdVectorFst *fst = new fst::StdVectorFst();
+      CreateRandomGraph(num_states, num_pdfs, fst);
+      decode_fst = fst;
+      loglikes.resize(std::min(num_utts, 5));
+      for (size_t i = 0; i < loglikes.size(); i++) {
+        loglikes[i].Resize(num_frames, num_pdfs);
+        loglikes[i].SetRandn();
+        loglikes[i].Scale(20.0);
+      }
+    }
+    if (loglikes.empty())
+      KALDI_ERR << "No log-likelihoods were read.";
+
+    for (size_t b = 0; b < beam_values.size(); b++) {
+      for (size_t m = 0; m < max_active_values.size(); m++) {
+        for (size_t l = 0; l < lattice_beam_values.size(); l++) {
+          LatticeFasterDecoderConfig config;
+          config.beam = beam_values[b];
+          config.max_active = max_active_values[m];
+          config.lattice_beam = lattice_beam_values[l];
+          config.frame_budget_arcs = frame_budget_arcs;
+          TimedLatticeFasterDecoder decoder(*decode_fst, config);
+          DecoderPhaseTimes times;
+          for (size_t i = 0; i < loglikes.size(); i++) {
+            if (po.NumArgs() == 3) {
+              DecodableMatrixScaledMapped decodable(trans_model, loglikes[i],
+                                                    acoustic_scale);
+              decoder.DecodeTimed(&decodable, &times);
+            } else {
+              DecodableMatrixScaled decodable(loglikes[i], acoustic_scale);
+              decoder.DecodeTimed(&decodable, &times);
+            }
+          }
+          PrintPhaseTimes(config, times);
+        }
+      }
+    }
+    delete decode_fst;
+    return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
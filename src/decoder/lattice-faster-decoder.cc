@@ -22,50 +22,84 @@
 
 #include "decoder/lattice-faster-decoder.h"
 #include "lat/lattice-functions.h"
+#include "util/kaldi-metrics.h"
 
 namespace kaldi {
 
+// Returns the histogram of the number of active tokens on each frame (see
+// util/kaldi-metrics.h).
+static MetricsHistogram *ActiveTokensHistogram() {
+  static MetricsHistogram *ans = MetricsRegistry::Global().GetHistogram(
+      "kaldi_decoder_active_tokens", "Number of active tokens on each frame "
+      "decoded by LatticeFasterDecoder, before pruning.",
+      ExponentialBuckets(16.0, 2.0, 14));
+  return ans;
+}
+
 // instantiate this class once for each thing you have to decode.
-template <typename FST, typename Token>
-LatticeFasterDecoderTpl<FST, Token>::LatticeFasterDecoderTpl(
+template <typename FST, typename Token,
+          template <class, class> class HashListType>
+LatticeFasterDecoderTpl<FST, Token, HashListType>::LatticeFasterDecoderTpl(
     const FST &fst,
     const LatticeFasterDecoderConfig &config):
-    fst_(&fst), delete_fst_(false), config_(config), num_toks_(0) {
+    pool_(new fst::MemoryPool<PoolElem>(config.memory_pool_block_size)),
+    fst_(&fst), delete_fst_(false), config_(config), num_toks_(0),
+    num_links_(0), lattice_beam_(config.lattice_beam), beam_(config.beam),
+    max_active_(config.max_active), budget_integral_(0.0),
+    arcs_per_token_(0.0), seconds_per_arc_(0.0), observer_(NULL) {
   config.Check();
   toks_.SetSize(1000);  // just so on the first frame we do something reasonable.
 }
 
 
-template <typename FST, typename Token>
-LatticeFasterDecoderTpl<FST, Token>::LatticeFasterDecoderTpl(
+template <typename FST, typename Token,
+          template <class, class> class HashListType>
+LatticeFasterDecoderTpl<FST, Token, HashListType>::LatticeFasterDecoderTpl(
     const LatticeFasterDecoderConfig &config, FST *fst):
-    fst_(fst), delete_fst_(true), config_(config), num_toks_(0) {
+    pool_(new fst::MemoryPool<PoolElem>(config.memory_pool_block_size)),
+    fst_(fst), delete_fst_(true), config_(config), num_toks_(0),
+    num_links_(0), lattice_beam_(config.lattice_beam), beam_(config.beam),
+    max_active_(config.max_active), budget_integral_(0.0),
+    arcs_per_token_(0.0), seconds_per_arc_(0.0), observer_(NULL) {
   config.Check();
   toks_.SetSize(1000);  // just so on the first frame we do something reasonable.
 }
 
 
-template <typename FST, typename Token>
-LatticeFasterDecoderTpl<FST, Token>::~LatticeFasterDecoderTpl() {
+template <typename FST, typename Token,
+          template <class, class> class HashListType>
+LatticeFasterDecoderTpl<FST, Token, HashListType>::~LatticeFasterDecoderTpl() {
   DeleteElems(toks_.Clear());
   ClearActiveTokens();
   if (delete_fst_) delete fst_;
 }
 
-template <typename FST, typename Token>
-void LatticeFasterDecoderTpl<FST, Token>::InitDecoding() {
+template <typename FST, typename Token,
+          template <class, class> class HashListType>
+void LatticeFasterDecoderTpl<FST, Token, HashListType>::InitDecoding() {
   // clean up from last time:
   DeleteElems(toks_.Clear());
   cost_offsets_.clear();
   ClearActiveTokens();
   warned_ = false;
   num_toks_ = 0;
+  num_links_ = 0;
+  lattice_beam_ = config_.lattice_beam;
+  // The averages of the work per token and per arc are kept from the previous
+  // utterance, as they depend mostly on the graph and the machine.
+  beam_ = config_.beam;
+  max_active_ = config_.max_active;
+  budget_integral_ = 0.0;
   decoding_finalized_ = false;
   final_costs_.clear();
+  traceback_fixed_tok_ = NULL;
+  num_frames_traceback_fixed_ = 0;
+  partial_result_tok_ = NULL;
   StateId start_state = fst_->Start();
   KALDI_ASSERT(start_state != fst::kNoStateId);
   active_toks_.resize(1);
-  Token *start_tok = new Token(0.0, 0.0, NULL, NULL, NULL);
+  Token *start_tok = new (pool_->Allocate())
+      Token(0.0, 0.0, NULL, NULL, NULL);
   active_toks_[0].toks = start_tok;
   toks_.Insert(start_state, start_tok);
   num_toks_++;
@@ -75,20 +109,17 @@ void LatticeFasterDecoderTpl<FST, Token>::InitDecoding() {
 // Returns true if any kind of traceback is available (not necessarily from
 // a final state).  It should only very rarely return false; this indicates
 // an unusual search error.
-template <typename FST, typename Token>
-bool LatticeFasterDecoderTpl<FST, Token>::Decode(DecodableInterface *decodable) {
+template <typename FST, typename Token,
+          template <class, class> class HashListType>
+bool LatticeFasterDecoderTpl<FST, Token, HashListType>::Decode(DecodableInterface *decodable) {
   InitDecoding();
 
   // We use 1-based indexing for frames in this decoder (if you view it in
   // terms of features), but note that the decodable object uses zero-based
   // numbering, which we have to correct for when we call it.
 
-  while (!decodable->IsLastFrame(NumFramesDecoded() - 1)) {
-    if (NumFramesDecoded() % config_.prune_interval == 0)
-      PruneActiveTokens(config_.lattice_beam * config_.prune_scale);
-    BaseFloat cost_cutoff = ProcessEmitting(decodable);
-    ProcessNonemitting(cost_cutoff);
-  }
+  while (!decodable->IsLastFrame(NumFramesDecoded() - 1))
+    DecodeFrame(decodable);
   FinalizeDecoding();
 
   // Returns true if we have any kind of traceback available (not necessarily
@@ -98,8 +129,9 @@ bool LatticeFasterDecoderTpl<FST, Token>::Decode(DecodableInterface *decodable)
 
 
 // Outputs an FST corresponding to the single best path through the lattice.
-template <typename FST, typename Token>
-bool LatticeFasterDecoderTpl<FST, Token>::GetBestPath(Lattice *olat,
+template <typename FST, typename Token,
+          template <class, class> class HashListType>
+bool LatticeFasterDecoderTpl<FST, Token, HashListType>::GetBestPath(Lattice *olat,
                                        bool use_final_probs) const {
   Lattice raw_lat;
   GetRawLattice(&raw_lat, use_final_probs);
@@ -109,8 +141,9 @@ bool LatticeFasterDecoderTpl<FST, Token>::GetBestPath(Lattice *olat,
 
 
 // Outputs an FST corresponding to the raw, state-level lattice
-template <typename FST, typename Token>
-bool LatticeFasterDecoderTpl<FST, Token>::GetRawLattice(
+template <typename FST, typename Token,
+          template <class, class> class HashListType>
+bool LatticeFasterDecoderTpl<FST, Token, HashListType>::GetRawLattice(
     Lattice *ofst,
     bool use_final_probs) const {
   typedef LatticeArc Arc;
@@ -196,11 +229,112 @@ bool LatticeFasterDecoderTpl<FST, Token>::GetRawLattice(
 }
 
 
+template <typename FST, typename Token,
+          template <class, class> class HashListType>
+bool LatticeFasterDecoderTpl<FST, Token, HashListType>::GetRawLatticeChunk(
+    int32 begin_frame, int32 end_frame, bool use_final_probs,
+    const unordered_map<Token*, LatticeArc::StateId> &begin_states,
+    Lattice *ofst,
+    std::vector<std::pair<Token*, LatticeArc::StateId> > *end_states) const {
+  typedef LatticeArc Arc;
+  typedef Arc::StateId StateId;
+  typedef Arc::Weight Weight;
+
+  int32 num_frames = active_toks_.size() - 1;
+  KALDI_ASSERT(begin_frame >= 0 && begin_frame < end_frame &&
+               end_frame <= num_frames);
+  KALDI_ASSERT(begin_frame != 0 || ofst->NumStates() == 0);
+  if (end_states == NULL) {
+    KALDI_ASSERT(end_frame == num_frames);
+    if (decoding_finalized_ && !use_final_probs)
+      KALDI_ERR << "You cannot call FinalizeDecoding() and then call "
+                << "GetRawLatticeChunk() with use_final_probs == false";
+  } else {
+    end_states->clear();
+  }
+
+  unordered_map<Token*, BaseFloat> final_costs_local;
+  const unordered_map<Token*, BaseFloat> &final_costs =
+      (decoding_finalized_ ? final_costs_ : final_costs_local);
+  if (end_states == NULL && !decoding_finalized_ && use_final_probs)
+    ComputeFinalCosts(&final_costs_local, NULL, NULL);
+
+  // The tokens on begin_frame already have states, unless it is zero.
+  int32 first_frame = (begin_frame == 0 ? 0 : begin_frame + 1);
+  unordered_map<Token*, StateId> tok_map;
+  std::vector<Token*> token_list;
+  for (int32 f = first_frame; f <= end_frame; f++) {
+    if (active_toks_[f].toks == NULL) {
+      KALDI_WARN << "GetRawLatticeChunk: no tokens active on frame " << f
+                 << ": not producing lattice.\n";
+      return false;
+    }
+    TopSortTokens(active_toks_[f].toks, &token_list);
+    for (size_t i = 0; i < token_list.size(); i++) {
+      if (token_list[i] != NULL) {
+        StateId s = ofst->AddState();
+        tok_map[token_list[i]] = s;
+        if (f == end_frame && end_states != NULL)
+          end_states->push_back(std::make_pair(token_list[i], s));
+      }
+    }
+  }
+  if (begin_frame == 0)
+    ofst->SetStart(0);
+
+  for (int32 f = begin_frame; f <= end_frame; f++) {
+    for (Token *tok = active_toks_[f].toks; tok != NULL; tok = tok->next) {
+      StateId cur_state;
+      if (f < first_frame) {
+        typename unordered_map<Token*, StateId>::const_iterator
+            iter = begin_states.find(tok);
+        if (iter == begin_states.end())
+          continue;
+        cur_state = iter->second;
+      } else {
+        cur_state = tok_map[tok];
+      }
+      for (ForwardLinkT *l = tok->links; l != NULL; l = l->next) {
+        // Epsilon links from begin_frame are in the previous chunk, and
+        // emitting links from end_frame will be in the next one.
+        bool emitting = (l->ilabel != 0);
+        if ((f < first_frame && !emitting) || (f == end_frame && emitting))
+          continue;
+        typename unordered_map<Token*, StateId>::const_iterator
+            iter = tok_map.find(l->next_tok);
+        KALDI_ASSERT(iter != tok_map.end());
+        BaseFloat cost_offset = 0.0;
+        if (emitting) {
+          KALDI_ASSERT(f >= 0 && f < cost_offsets_.size());
+          cost_offset = cost_offsets_[f];
+        }
+        Arc arc(l->ilabel, l->olabel,
+                Weight(l->graph_cost, l->acoustic_cost - cost_offset),
+                iter->second);
+        ofst->AddArc(cur_state, arc);
+      }
+      if (f == end_frame && end_states == NULL) {
+        if (use_final_probs && !final_costs.empty()) {
+          typename unordered_map<Token*, BaseFloat>::const_iterator
+              iter = final_costs.find(tok);
+          if (iter != final_costs.end())
+            ofst->SetFinal(cur_state, LatticeWeight(iter->second, 0));
+        } else {
+          ofst->SetFinal(cur_state, LatticeWeight::One());
+        }
+      }
+    }
+  }
+  return (ofst->NumStates() > 0);
+}
+
+
 // This function is now deprecated, since now we do determinization from outside
 // the LatticeFasterDecoder class.  Outputs an FST corresponding to the
 // lattice-determinized lattice (one path per word sequence).
-template <typename FST, typename Token>
-bool LatticeFasterDecoderTpl<FST, Token>::GetLattice(CompactLattice *ofst,
+template <typename FST, typename Token,
+          template <class, class> class HashListType>
+bool LatticeFasterDecoderTpl<FST, Token, HashListType>::GetLattice(CompactLattice *ofst,
                                            bool use_final_probs) const {
   Lattice raw_fst;
   GetRawLattice(&raw_fst, use_final_probs);
@@ -222,8 +356,9 @@ bool LatticeFasterDecoderTpl<FST, Token>::GetLattice(CompactLattice *ofst,
   return (ofst->NumStates() != 0);
 }
 
-template <typename FST, typename Token>
-void LatticeFasterDecoderTpl<FST, Token>::PossiblyResizeHash(size_t num_toks) {
+template <typename FST, typename Token,
+          template <class, class> class HashListType>
+void LatticeFasterDecoderTpl<FST, Token, HashListType>::PossiblyResizeHash(size_t num_toks) {
   size_t new_sz = static_cast<size_t>(static_cast<BaseFloat>(num_toks)
                                       * config_.hash_ratio);
   if (new_sz > toks_.Size()) {
@@ -262,9 +397,10 @@ void LatticeFasterDecoderTpl<FST, Token>::PossiblyResizeHash(size_t num_toks) {
 // for the current frame.  [note: it's inserted if necessary into hash toks_
 // and also into the singly linked list of tokens active on this frame
 // (whose head is at active_toks_[frame]).
-template <typename FST, typename Token>
-inline typename LatticeFasterDecoderTpl<FST, Token>::Elem*
-LatticeFasterDecoderTpl<FST, Token>::FindOrAddToken(
+template <typename FST, typename Token,
+          template <class, class> class HashListType>
+inline typename LatticeFasterDecoderTpl<FST, Token, HashListType>::Elem*
+LatticeFasterDecoderTpl<FST, Token, HashListType>::FindOrAddToken(
       StateId state, int32 frame_plus_one, BaseFloat tot_cost,
       Token *backpointer, bool *changed) {
   // Returns the Token pointer.  Sets "changed" (if non-NULL) to true
@@ -277,7 +413,8 @@ LatticeFasterDecoderTpl<FST, Token>::FindOrAddToken(
     // tokens on the currently final frame have zero extra_cost
     // as any of them could end up
     // on the winning path.
-    Token *new_tok = new Token (tot_cost, extra_cost, NULL, toks, backpointer);
+    Token *new_tok = new (pool_->Allocate())
+        Token(tot_cost, extra_cost, NULL, toks, backpointer);
     // NULL: no forward links yet
     toks = new_tok;
     num_toks_++;
@@ -309,8 +446,9 @@ LatticeFasterDecoderTpl<FST, Token>::FindOrAddToken(
 // prunes outgoing links for all tokens in active_toks_[frame]
 // it's called by PruneActiveTokens
 // all links, that have link_extra_cost > lattice_beam are pruned
-template <typename FST, typename Token>
-void LatticeFasterDecoderTpl<FST, Token>::PruneForwardLinks(
+template <typename FST, typename Token,
+          template <class, class> class HashListType>
+void LatticeFasterDecoderTpl<FST, Token, HashListType>::PruneForwardLinks(
     int32 frame_plus_one, bool *extra_costs_changed,
     bool *links_pruned, BaseFloat delta) {
   // delta is the amount by which the extra_costs must change
@@ -350,11 +488,12 @@ void LatticeFasterDecoderTpl<FST, Token>::PruneForwardLinks(
         // link_exta_cost is the difference in score between the best paths
         // through link source state and through link destination state
         KALDI_ASSERT(link_extra_cost == link_extra_cost);  // check for NaN
-        if (link_extra_cost > config_.lattice_beam) {  // excise link
+        if (link_extra_cost > lattice_beam_) {  // excise link
           ForwardLinkT *next_link = link->next;
           if (prev_link != NULL) prev_link->next = next_link;
           else tok->links = next_link;
-          delete link;
+          pool_->Free(link);
+          num_links_--;
           link = next_link;  // advance link but leave prev_link the same.
           *links_pruned = true;
         } else {   // keep the link and update the tok_extra_cost if needed.
@@ -386,8 +525,9 @@ void LatticeFasterDecoderTpl<FST, Token>::PruneForwardLinks(
 // PruneForwardLinksFinal is a version of PruneForwardLinks that we call
 // on the final frame.  If there are final tokens active, it uses
 // the final-probs for pruning, otherwise it treats all tokens as final.
-template <typename FST, typename Token>
-void LatticeFasterDecoderTpl<FST, Token>::PruneForwardLinksFinal() {
+template <typename FST, typename Token,
+          template <class, class> class HashListType>
+void LatticeFasterDecoderTpl<FST, Token, HashListType>::PruneForwardLinksFinal() {
   KALDI_ASSERT(!active_toks_.empty());
   int32 frame_plus_one = active_toks_.size() - 1;
 
@@ -438,11 +578,12 @@ void LatticeFasterDecoderTpl<FST, Token>::PruneForwardLinksFinal() {
         BaseFloat link_extra_cost = next_tok->extra_cost +
             ((tok->tot_cost + link->acoustic_cost + link->graph_cost)
              - next_tok->tot_cost);
-        if (link_extra_cost > config_.lattice_beam) {  // excise link
+        if (link_extra_cost > lattice_beam_) {  // excise link
           ForwardLinkT *next_link = link->next;
           if (prev_link != NULL) prev_link->next = next_link;
           else tok->links = next_link;
-          delete link;
+          pool_->Free(link);
+          num_links_--;
           link = next_link; // advance link but leave prev_link the same.
         } else { // keep the link and update the tok_extra_cost if needed.
           if (link_extra_cost < 0.0) { // this is just a precaution.
@@ -460,7 +601,7 @@ void LatticeFasterDecoderTpl<FST, Token>::PruneForwardLinksFinal() {
       // was not necessary in the non-final case because then, this case
       // showed up as having no forward links.  Here, the tok_extra_cost has
       // an extra component relating to the final-prob.
-      if (tok_extra_cost > config_.lattice_beam)
+      if (tok_extra_cost > lattice_beam_)
         tok_extra_cost = std::numeric_limits<BaseFloat>::infinity();
       // to be pruned in PruneTokensForFrame
 
@@ -471,8 +612,9 @@ void LatticeFasterDecoderTpl<FST, Token>::PruneForwardLinksFinal() {
   } // while changed
 }
 
-template <typename FST, typename Token>
-BaseFloat LatticeFasterDecoderTpl<FST, Token>::FinalRelativeCost() const {
+template <typename FST, typename Token,
+          template <class, class> class HashListType>
+BaseFloat LatticeFasterDecoderTpl<FST, Token, HashListType>::FinalRelativeCost() const {
   if (!decoding_finalized_) {
     BaseFloat relative_cost;
     ComputeFinalCosts(NULL, &relative_cost, NULL);
@@ -489,8 +631,9 @@ BaseFloat LatticeFasterDecoderTpl<FST, Token>::FinalRelativeCost() const {
 // [we don't do this in PruneForwardLinks because it would give us
 // a problem with dangling pointers].
 // It's called by PruneActiveTokens if any forward links have been pruned
-template <typename FST, typename Token>
-void LatticeFasterDecoderTpl<FST, Token>::PruneTokensForFrame(int32 frame_plus_one) {
+template <typename FST, typename Token,
+          template <class, class> class HashListType>
+void LatticeFasterDecoderTpl<FST, Token, HashListType>::PruneTokensForFrame(int32 frame_plus_one) {
   KALDI_ASSERT(frame_plus_one >= 0 && frame_plus_one < active_toks_.size());
   Token *&toks = active_toks_[frame_plus_one].toks;
   if (toks == NULL)
@@ -503,7 +646,7 @@ void LatticeFasterDecoderTpl<FST, Token>::PruneTokensForFrame(int32 frame_plus_o
       // excise tok from list and delete tok.
       if (prev_tok != NULL) prev_tok->next = tok->next;
       else toks = tok->next;
-      delete tok;
+      pool_->Free(tok);
       num_toks_--;
     } else {  // fetch next Token
       prev_tok = tok;
@@ -516,8 +659,9 @@ void LatticeFasterDecoderTpl<FST, Token>::PruneTokensForFrame(int32 frame_plus_o
 // that.  We go backwards through the frames and stop when we reach a point
 // where the delta-costs are not changing (and the delta controls when we consider
 // a cost to have "not changed").
-template <typename FST, typename Token>
-void LatticeFasterDecoderTpl<FST, Token>::PruneActiveTokens(BaseFloat delta) {
+template <typename FST, typename Token,
+          template <class, class> class HashListType>
+void LatticeFasterDecoderTpl<FST, Token, HashListType>::PruneActiveTokens(BaseFloat delta) {
   int32 cur_frame_plus_one = NumFramesDecoded();
   int32 num_toks_begin = num_toks_;
   // The index "f" below represents a "frame plus one", i.e. you'd have to subtract
@@ -546,8 +690,9 @@ void LatticeFasterDecoderTpl<FST, Token>::PruneActiveTokens(BaseFloat delta) {
                 << " to " << num_toks_;
 }
 
-template <typename FST, typename Token>
-void LatticeFasterDecoderTpl<FST, Token>::ComputeFinalCosts(
+template <typename FST, typename Token,
+          template <class, class> class HashListType>
+void LatticeFasterDecoderTpl<FST, Token, HashListType>::ComputeFinalCosts(
     unordered_map<Token*, BaseFloat> *final_costs,
     BaseFloat *final_relative_cost,
     BaseFloat *final_best_cost) const {
@@ -590,21 +735,24 @@ void LatticeFasterDecoderTpl<FST, Token>::ComputeFinalCosts(
   }
 }
 
-template <typename FST, typename Token>
-void LatticeFasterDecoderTpl<FST, Token>::AdvanceDecoding(DecodableInterface *decodable,
+template <typename FST, typename Token,
+          template <class, class> class HashListType>
+void LatticeFasterDecoderTpl<FST, Token, HashListType>::AdvanceDecoding(DecodableInterface *decodable,
                                                 int32 max_num_frames) {
   if (std::is_same<FST, fst::Fst<fst::StdArc> >::value) {
     // if the type 'FST' is the FST base-class, then see if the FST type of fst_
     // is actually VectorFst or ConstFst.  If so, call the AdvanceDecoding()
     // function after casting *this to the more specific type.
     if (fst_->Type() == "const") {
-      LatticeFasterDecoderTpl<fst::ConstFst<fst::StdArc>, Token> *this_cast =
-          reinterpret_cast<LatticeFasterDecoderTpl<fst::ConstFst<fst::StdArc>, Token>* >(this);
+      LatticeFasterDecoderTpl<fst::ConstFst<fst::StdArc>, Token, HashListType>
+          *this_cast = reinterpret_cast<LatticeFasterDecoderTpl<
+            fst::ConstFst<fst::StdArc>, Token, HashListType>* >(this);
       this_cast->AdvanceDecoding(decodable, max_num_frames);
       return;
     } else if (fst_->Type() == "vector") {
-      LatticeFasterDecoderTpl<fst::VectorFst<fst::StdArc>, Token> *this_cast =
-          reinterpret_cast<LatticeFasterDecoderTpl<fst::VectorFst<fst::StdArc>, Token>* >(this);
+      LatticeFasterDecoderTpl<fst::VectorFst<fst::StdArc>, Token, HashListType>
+          *this_cast = reinterpret_cast<LatticeFasterDecoderTpl<
+            fst::VectorFst<fst::StdArc>, Token, HashListType>* >(this);
       this_cast->AdvanceDecoding(decodable, max_num_frames);
       return;
     }
@@ -623,20 +771,141 @@ void LatticeFasterDecoderTpl<FST, Token>::AdvanceDecoding(DecodableInterface *de
   if (max_num_frames >= 0)
     target_frames_decoded = std::min(target_frames_decoded,
                                      NumFramesDecoded() + max_num_frames);
-  while (NumFramesDecoded() < target_frames_decoded) {
-    if (NumFramesDecoded() % config_.prune_interval == 0) {
+  while (NumFramesDecoded() < target_frames_decoded)
+    DecodeFrame(decodable);
+}
+
+template <typename FST, typename Token,
+          template <class, class> class HashListType>
+void LatticeFasterDecoderTpl<FST, Token, HashListType>::DecodeFrame(
+    DecodableInterface *decodable) {
+  KALDI_TRACE_SCOPE("LatticeFasterDecoder: decode frame");
+  if (observer_ == NULL && config_.frame_budget_ms <= 0.0) {
+    if (NumFramesDecoded() % config_.prune_interval == 0)
       PruneActiveTokens(config_.lattice_beam * config_.prune_scale);
-    }
     BaseFloat cost_cutoff = ProcessEmitting(decodable);
     ProcessNonemitting(cost_cutoff);
+    if (config_.frame_budget_arcs > 0)
+      UpdateBudgetBeam(0.0);
+    if (config_.max_lattice_mem_mb > 0.0 &&
+        NumFramesDecoded() % config_.prune_interval == 0 &&
+        MemoryUsage() > config_.max_lattice_mem_mb * 1048576.0)
+      PruneForMemory();
+    return;
   }
+  int64 start_time = Tracer::Now();
+  if (NumFramesDecoded() % config_.prune_interval == 0)
+    PruneActiveTokens(config_.lattice_beam * config_.prune_scale);
+  int64 prune_end_time = Tracer::Now();
+  BaseFloat cost_cutoff = ProcessEmitting(decodable);
+  int64 emitting_end_time = Tracer::Now();
+  ProcessNonemitting(cost_cutoff);
+  int64 nonemitting_end_time = Tracer::Now();
+  if (config_.max_lattice_mem_mb > 0.0 &&
+      NumFramesDecoded() % config_.prune_interval == 0 &&
+      MemoryUsage() > config_.max_lattice_mem_mb * 1048576.0)
+    PruneForMemory();
+  int64 end_time = Tracer::Now();
+  frame_stats_.frame = NumFramesDecoded() - 1;
+  frame_stats_.prune_seconds = (prune_end_time - start_time) * 1.0e-09;
+  frame_stats_.emitting_seconds =
+      (emitting_end_time - prune_end_time) * 1.0e-09;
+  frame_stats_.nonemitting_seconds =
+      (nonemitting_end_time - emitting_end_time) * 1.0e-09;
+  frame_stats_.prune_seconds += (end_time - nonemitting_end_time) * 1.0e-09;
+  frame_stats_.seconds = (end_time - start_time) * 1.0e-09;
+  if (config_.HasFrameBudget())
+    UpdateBudgetBeam(frame_stats_.emitting_seconds +
+                     frame_stats_.nonemitting_seconds);
+  if (observer_ != NULL)
+    observer_->FrameDecoded(frame_stats_);
+}
+
+template <typename FST, typename Token,
+          template <class, class> class HashListType>
+void LatticeFasterDecoderTpl<FST, Token, HashListType>::PruneForMemory() {
+  double max_bytes = config_.max_lattice_mem_mb * 1048576.0;
+  BaseFloat min_lattice_beam = config_.lattice_beam / 16.0;
+  int64 bytes_begin = MemoryUsage();
+  while (true) {
+    // PruneActiveTokens() only revisits frames whose tokens may have changed;
+    // we want it to go over all of them.
+    for (size_t f = 0; f < active_toks_.size(); f++)
+      active_toks_[f].must_prune_forward_links = true;
+    PruneActiveTokens(lattice_beam_ * config_.prune_scale);
+    if (MemoryUsage() <= max_bytes || lattice_beam_ <= min_lattice_beam)
+      break;
+    lattice_beam_ = std::max(lattice_beam_ / 2, min_lattice_beam);
+  }
+  KALDI_VLOG(2) << "Pruned the lattice from " << bytes_begin << " to "
+                << MemoryUsage() << " bytes on frame " << NumFramesDecoded()
+                << ", lattice beam is " << lattice_beam_;
+  if (MemoryUsage() > max_bytes && !warned_) {
+    KALDI_WARN << "The lattice uses " << MemoryUsage() << " bytes, more than "
+               << "--max-lattice-mem-mb, even with lattice beam "
+               << lattice_beam_ << " (warning first time only for each "
+               << "utterance).";
+    warned_ = true;
+  }
+}
+
+template <typename FST, typename Token,
+          template <class, class> class HashListType>
+void LatticeFasterDecoderTpl<FST, Token, HashListType>::UpdateBudgetBeam(
+    double frame_seconds) {
+  // The weight of the latest frame in the moving averages.
+  const double average_weight = 0.1;
+  double num_arcs = frame_stats_.num_emitting_arcs +
+      frame_stats_.num_nonemitting_arcs;
+  if (num_arcs <= 0.0 || frame_stats_.num_tokens_expanded <= 0)
+    return;
+  double target_arcs = std::numeric_limits<double>::infinity();
+  if (config_.frame_budget_arcs > 0)
+    target_arcs = config_.frame_budget_arcs;
+  if (config_.frame_budget_ms > 0.0 && frame_seconds > 0.0) {
+    double seconds_per_arc = frame_seconds / num_arcs;
+    seconds_per_arc_ = (seconds_per_arc_ == 0.0 ? seconds_per_arc :
+                        (1.0 - average_weight) * seconds_per_arc_ +
+                        average_weight * seconds_per_arc);
+    target_arcs = std::min(target_arcs,
+                           config_.frame_budget_ms * 1.0e-03 / seconds_per_arc_);
+  }
+  if (target_arcs == std::numeric_limits<double>::infinity())
+    return;  // frame_budget_ms with no time measured yet.
+  target_arcs = std::max(target_arcs, 1.0);
+
+  // The error is positive when the frame took more work than the budget.
+  double error = Log(num_arcs / target_arcs),
+      beam_range = config_.beam - config_.budget_min_beam;
+  budget_integral_ += error;
+  if (config_.budget_ki > 0.0)
+    budget_integral_ = std::min(std::max(budget_integral_, 0.0),
+                                beam_range / config_.budget_ki);
+  else
+    budget_integral_ = 0.0;
+  double beam = config_.beam - config_.budget_kp * error -
+      config_.budget_ki * budget_integral_;
+  beam_ = std::min(std::max(beam, static_cast<double>(config_.budget_min_beam)),
+                   static_cast<double>(config_.beam));
+
+  double arcs_per_token = num_arcs / frame_stats_.num_tokens_expanded;
+  arcs_per_token_ = (arcs_per_token_ == 0.0 ? arcs_per_token :
+                     (1.0 - average_weight) * arcs_per_token_ +
+                     average_weight * arcs_per_token);
+  double max_active = 2.0 * target_arcs / arcs_per_token_;
+  // max_active_ must stay above min_active for GetCutoff().
+  max_active_ = static_cast<int32>(std::max(
+      std::min(max_active, static_cast<double>(config_.max_active)),
+      static_cast<double>(config_.min_active + 1)));
 }
 
 // FinalizeDecoding() is a version of PruneActiveTokens that we call
 // (optionally) on the final frame.  Takes into account the final-prob of
 // tokens.  This function used to be called PruneActiveTokensFinal().
-template <typename FST, typename Token>
-void LatticeFasterDecoderTpl<FST, Token>::FinalizeDecoding() {
+template <typename FST, typename Token,
+          template <class, class> class HashListType>
+void LatticeFasterDecoderTpl<FST, Token, HashListType>::FinalizeDecoding() {
+  KALDI_TRACE_SCOPE("LatticeFasterDecoder::FinalizeDecoding");
   int32 final_frame_plus_one = NumFramesDecoded();
   int32 num_toks_begin = num_toks_;
   // PruneForwardLinksFinal() prunes final frame (with final-probs), and
@@ -653,14 +922,204 @@ void LatticeFasterDecoderTpl<FST, Token>::FinalizeDecoding() {
                 << " to " << num_toks_;
 }
 
+// The tokens are written with an index for each, numbered frame by frame in
+// the order of the lists in active_toks_, so that the backpointers and links
+// can refer to them.  We write all the tokens' costs before any links, since
+// links may point to tokens that come later.
+template <typename FST, typename Token,
+          template <class, class> class HashListType>
+void LatticeFasterDecoderTpl<FST, Token, HashListType>::WriteState(
+    std::ostream &os, bool binary) const {
+  if (decoding_finalized_)
+    KALDI_ERR << "You cannot write the decoder state after FinalizeDecoding().";
+  std::vector<Token*> toks;
+  unordered_map<const Token*, int32> tok_index;
+  tok_index[NULL] = -1;
+  WriteToken(os, binary, "<LatticeFasterDecoderState>");
+  WriteToken(os, binary, "<NumFrames>");
+  WriteBasicType(os, binary, static_cast<int32>(active_toks_.size()));
+  for (size_t f = 0; f < active_toks_.size(); f++) {
+    int32 num_toks = 0;
+    for (Token *tok = active_toks_[f].toks; tok != NULL; tok = tok->next)
+      num_toks++;
+    WriteToken(os, binary, "<Frame>");
+    WriteBasicType(os, binary, active_toks_[f].must_prune_forward_links);
+    WriteBasicType(os, binary, active_toks_[f].must_prune_tokens);
+    WriteBasicType(os, binary, num_toks);
+    for (Token *tok = active_toks_[f].toks; tok != NULL; tok = tok->next) {
+      tok_index[tok] = toks.size();
+      toks.push_back(tok);
+      WriteBasicType(os, binary, tok->tot_cost);
+      WriteBasicType(os, binary, tok->extra_cost);
+    }
+  }
+  WriteToken(os, binary, "<Links>");
+  for (size_t i = 0; i < toks.size(); i++) {
+    Token *tok = toks[i];
+    int32 num_links = 0;
+    for (ForwardLinkT *link = tok->links; link != NULL; link = link->next)
+      num_links++;
+    WriteBasicType(os, binary, tok_index[tok->Backpointer()]);
+    WriteBasicType(os, binary, num_links);
+    for (ForwardLinkT *link = tok->links; link != NULL; link = link->next) {
+      WriteBasicType(os, binary, tok_index[link->next_tok]);
+      WriteBasicType(os, binary, link->ilabel);
+      WriteBasicType(os, binary, link->olabel);
+      WriteBasicType(os, binary, link->graph_cost);
+      WriteBasicType(os, binary, link->acoustic_cost);
+    }
+  }
+  // The state-ids of the tokens on the most recent frame.
+  WriteToken(os, binary, "<States>");
+  int32 num_states = 0;
+  for (const Elem *e = toks_.GetList(); e != NULL; e = e->tail)
+    num_states++;
+  WriteBasicType(os, binary, num_states);
+  for (const Elem *e = toks_.GetList(); e != NULL; e = e->tail) {
+    WriteBasicType(os, binary, e->key);
+    WriteBasicType(os, binary, tok_index[e->val]);
+  }
+  WriteToken(os, binary, "<CostOffsets>");
+  WriteBasicType(os, binary, static_cast<int32>(cost_offsets_.size()));
+  for (size_t f = 0; f < cost_offsets_.size(); f++)
+    WriteBasicType(os, binary, cost_offsets_[f]);
+  WriteToken(os, binary, "<TracebackFixed>");
+  WriteBasicType(os, binary, tok_index[traceback_fixed_tok_]);
+  WriteBasicType(os, binary, num_frames_traceback_fixed_);
+  WriteBasicType(os, binary, tok_index[partial_result_tok_]);
+  WriteToken(os, binary, "<Warned>");
+  WriteBasicType(os, binary, warned_);
+  WriteToken(os, binary, "</LatticeFasterDecoderState>");
+}
+
+template <typename FST, typename Token,
+          template <class, class> class HashListType>
+void LatticeFasterDecoderTpl<FST, Token, HashListType>::ReadState(
+    std::istream &is, bool binary) {
+  DeleteElems(toks_.Clear());
+  ClearActiveTokens();
+  cost_offsets_.clear();
+  decoding_finalized_ = false;
+  final_costs_.clear();
+
+  ExpectToken(is, binary, "<LatticeFasterDecoderState>");
+  ExpectToken(is, binary, "<NumFrames>");
+  int32 num_frames;
+  ReadBasicType(is, binary, &num_frames);
+  if (num_frames < 1)
+    KALDI_ERR << "Bad number of frames " << num_frames << " in decoder state.";
+  active_toks_.resize(num_frames);
+  std::vector<Token*> toks;
+  for (int32 f = 0; f < num_frames; f++) {
+    ExpectToken(is, binary, "<Frame>");
+    ReadBasicType(is, binary, &(active_toks_[f].must_prune_forward_links));
+    ReadBasicType(is, binary, &(active_toks_[f].must_prune_tokens));
+    int32 num_toks;
+    ReadBasicType(is, binary, &num_toks);
+    Token **next = &(active_toks_[f].toks);
+    for (int32 i = 0; i < num_toks; i++) {
+      BaseFloat tot_cost, extra_cost;
+      ReadBasicType(is, binary, &tot_cost);
+      ReadBasicType(is, binary, &extra_cost);
+      Token *tok = new (pool_->Allocate())
+          Token(tot_cost, extra_cost, NULL, NULL, NULL);
+      num_toks_++;
+      *next = tok;
+      next = &(tok->next);
+      toks.push_back(tok);
+    }
+  }
+  int32 num_toks = toks.size();
+  // Returns the token with index i (NULL for -1).
+  auto get_tok = [&toks, num_toks] (int32 i) -> Token* {
+    if (i < -1 || i >= num_toks)
+      KALDI_ERR << "Bad token index " << i << " in decoder state.";
+    return (i == -1 ? NULL : toks[i]);
+  };
+  ExpectToken(is, binary, "<Links>");
+  std::vector<ForwardLinkT> links;
+  for (int32 i = 0; i < num_toks; i++) {
+    Token *tok = toks[i];
+    int32 backpointer, num_links;
+    ReadBasicType(is, binary, &backpointer);
+    tok->SetBackpointer(get_tok(backpointer));
+    ReadBasicType(is, binary, &num_links);
+    links.clear();
+    for (int32 j = 0; j < num_links; j++) {
+      int32 next_tok;
+      Label ilabel, olabel;
+      BaseFloat graph_cost, acoustic_cost;
+      ReadBasicType(is, binary, &next_tok);
+      ReadBasicType(is, binary, &ilabel);
+      ReadBasicType(is, binary, &olabel);
+      ReadBasicType(is, binary, &graph_cost);
+      ReadBasicType(is, binary, &acoustic_cost);
+      links.push_back(ForwardLinkT(get_tok(next_tok), ilabel, olabel,
+                                   graph_cost, acoustic_cost, NULL));
+    }
+    // Add them to the front of the list in reverse order, to keep the order.
+    for (int32 j = num_links - 1; j >= 0; j--) {
+      links[j].next = tok->links;
+      tok->links = new (pool_->Allocate()) ForwardLinkT(links[j]);
+      num_links_++;
+    }
+  }
+  ExpectToken(is, binary, "<States>");
+  int32 num_states;
+  ReadBasicType(is, binary, &num_states);
+  PossiblyResizeHash(num_states);
+  for (int32 i = 0; i < num_states; i++) {
+    StateId state;
+    int32 tok;
+    ReadBasicType(is, binary, &state);
+    ReadBasicType(is, binary, &tok);
+    toks_.Insert(state, get_tok(tok));
+  }
+  ExpectToken(is, binary, "<CostOffsets>");
+  int32 num_cost_offsets;
+  ReadBasicType(is, binary, &num_cost_offsets);
+  cost_offsets_.resize(num_cost_offsets);
+  for (int32 f = 0; f < num_cost_offsets; f++)
+    ReadBasicType(is, binary, &(cost_offsets_[f]));
+  ExpectToken(is, binary, "<TracebackFixed>");
+  int32 traceback_fixed_tok, partial_result_tok;
+  ReadBasicType(is, binary, &traceback_fixed_tok);
+  traceback_fixed_tok_ = get_tok(traceback_fixed_tok);
+  ReadBasicType(is, binary, &num_frames_traceback_fixed_);
+  ReadBasicType(is, binary, &partial_result_tok);
+  partial_result_tok_ = get_tok(partial_result_tok);
+  ExpectToken(is, binary, "<Warned>");
+  ReadBasicType(is, binary, &warned_);
+  ExpectToken(is, binary, "</LatticeFasterDecoderState>");
+}
+
+template <typename FST, typename Token,
+          template <class, class> class HashListType>
+inline int32
+LatticeFasterDecoderTpl<FST, Token, HashListType>::GetEmittingLogLikes(
+    StateId state, int32 frame, DecodableInterface *decodable) {
+  arc_ilabels_.clear();
+  for (fst::EmittingArcIterator<FST> aiter(*fst_, state);
+       !aiter.Done();
+       aiter.Next())
+    arc_ilabels_.push_back(aiter.Value().ilabel);
+  int32 num_arcs = arc_ilabels_.size();
+  arc_log_likes_.resize(num_arcs);
+  if (num_arcs > 0)
+    decodable->LogLikelihoods(frame, &(arc_ilabels_[0]), &(arc_log_likes_[0]),
+                              num_arcs);
+  return num_arcs;
+}
+
 /// Gets the weight cutoff.  Also counts the active tokens.
-template <typename FST, typename Token>
-BaseFloat LatticeFasterDecoderTpl<FST, Token>::GetCutoff(Elem *list_head, size_t *tok_count,
+template <typename FST, typename Token,
+          template <class, class> class HashListType>
+BaseFloat LatticeFasterDecoderTpl<FST, Token, HashListType>::GetCutoff(Elem *list_head, size_t *tok_count,
                                           BaseFloat *adaptive_beam, Elem **best_elem) {
   BaseFloat best_weight = std::numeric_limits<BaseFloat>::infinity();
   // positive == high cost == bad.
   size_t count = 0;
-  if (config_.max_active == std::numeric_limits<int32>::max() &&
+  if (max_active_ == std::numeric_limits<int32>::max() &&
       config_.min_active == 0) {
     for (Elem *e = list_head; e != NULL; e = e->tail, count++) {
       BaseFloat w = static_cast<BaseFloat>(e->val->tot_cost);
@@ -670,8 +1129,8 @@ BaseFloat LatticeFasterDecoderTpl<FST, Token>::GetCutoff(Elem *list_head, size_t
       }
     }
     if (tok_count != NULL) *tok_count = count;
-    if (adaptive_beam != NULL) *adaptive_beam = config_.beam;
-    return best_weight + config_.beam;
+    if (adaptive_beam != NULL) *adaptive_beam = beam_;
+    return best_weight + beam_;
   } else {
     tmp_array_.clear();
     for (Elem *e = list_head; e != NULL; e = e->tail, count++) {
@@ -684,18 +1143,18 @@ BaseFloat LatticeFasterDecoderTpl<FST, Token>::GetCutoff(Elem *list_head, size_t
     }
     if (tok_count != NULL) *tok_count = count;
 
-    BaseFloat beam_cutoff = best_weight + config_.beam,
+    BaseFloat beam_cutoff = best_weight + beam_,
         min_active_cutoff = std::numeric_limits<BaseFloat>::infinity(),
         max_active_cutoff = std::numeric_limits<BaseFloat>::infinity();
 
     KALDI_VLOG(6) << "Number of tokens active on frame " << NumFramesDecoded()
                   << " is " << tmp_array_.size();
 
-    if (tmp_array_.size() > static_cast<size_t>(config_.max_active)) {
+    if (tmp_array_.size() > static_cast<size_t>(max_active_)) {
       std::nth_element(tmp_array_.begin(),
-                       tmp_array_.begin() + config_.max_active,
+                       tmp_array_.begin() + max_active_,
                        tmp_array_.end());
-      max_active_cutoff = tmp_array_[config_.max_active];
+      max_active_cutoff = tmp_array_[max_active_];
     }
     if (max_active_cutoff < beam_cutoff) { // max_active is tighter than beam.
       if (adaptive_beam)
@@ -707,8 +1166,8 @@ BaseFloat LatticeFasterDecoderTpl<FST, Token>::GetCutoff(Elem *list_head, size_t
       else {
         std::nth_element(tmp_array_.begin(),
                          tmp_array_.begin() + config_.min_active,
-                         tmp_array_.size() > static_cast<size_t>(config_.max_active) ?
-                         tmp_array_.begin() + config_.max_active :
+                         tmp_array_.size() > static_cast<size_t>(max_active_) ?
+                         tmp_array_.begin() + max_active_ :
                          tmp_array_.end());
         min_active_cutoff = tmp_array_[config_.min_active];
       }
@@ -718,14 +1177,15 @@ BaseFloat LatticeFasterDecoderTpl<FST, Token>::GetCutoff(Elem *list_head, size_t
         *adaptive_beam = min_active_cutoff - best_weight + config_.beam_delta;
       return min_active_cutoff;
     } else {
-      *adaptive_beam = config_.beam;
+      *adaptive_beam = beam_;
       return beam_cutoff;
     }
   }
 }
 
-template <typename FST, typename Token>
-BaseFloat LatticeFasterDecoderTpl<FST, Token>::ProcessEmitting(
+template <typename FST, typename Token,
+          template <class, class> class HashListType>
+BaseFloat LatticeFasterDecoderTpl<FST, Token, HashListType>::ProcessEmitting(
     DecodableInterface *decodable) {
   KALDI_ASSERT(active_toks_.size() > 0);
   int32 frame = active_toks_.size() - 1; // frame is the frame-index
@@ -742,6 +1202,11 @@ BaseFloat LatticeFasterDecoderTpl<FST, Token>::ProcessEmitting(
   BaseFloat cur_cutoff = GetCutoff(final_toks, &tok_cnt, &adaptive_beam, &best_elem);
   KALDI_VLOG(6) << "Adaptive beam on frame " << NumFramesDecoded() << " is "
                 << adaptive_beam;
+  if (MetricsRegistry::Global().Enabled())
+    ActiveTokensHistogram()->Observe(tok_cnt);
+  frame_stats_.num_tokens = tok_cnt;
+  frame_stats_.adaptive_beam = adaptive_beam;
+  frame_stats_.cutoff = cur_cutoff;
 
   PossiblyResizeHash(tok_cnt);  // This makes sure the hash is always big enough.
 
@@ -759,16 +1224,16 @@ BaseFloat LatticeFasterDecoderTpl<FST, Token>::ProcessEmitting(
     StateId state = best_elem->key;
     Token *tok = best_elem->val;
     cost_offset = - tok->tot_cost;
-    for (fst::ArcIterator<FST> aiter(*fst_, state);
+    GetEmittingLogLikes(state, frame, decodable);
+    int32 j = 0;
+    for (fst::EmittingArcIterator<FST> aiter(*fst_, state);
          !aiter.Done();
-         aiter.Next()) {
+         aiter.Next(), j++) {
       const Arc &arc = aiter.Value();
-      if (arc.ilabel != 0) {  // propagate..
-        BaseFloat new_weight = arc.weight.Value() + cost_offset -
-            decodable->LogLikelihood(frame, arc.ilabel) + tok->tot_cost;
-        if (new_weight + adaptive_beam < next_cutoff)
-          next_cutoff = new_weight + adaptive_beam;
-      }
+      BaseFloat new_weight = arc.weight.Value() + cost_offset -
+          arc_log_likes_[j] + tok->tot_cost;
+      if (new_weight + adaptive_beam < next_cutoff)
+        next_cutoff = new_weight + adaptive_beam;
     }
   }
 
@@ -780,58 +1245,81 @@ BaseFloat LatticeFasterDecoderTpl<FST, Token>::ProcessEmitting(
 
   // the tokens are now owned here, in final_toks, and the hash is empty.
   // 'owned' is a complex thing here; the point is we need to call DeleteElem
-  // on each elem 'e' to let toks_ know we're done with them.
+  // on each elem 'e' to let toks_ know we're done with them.  We first copy
+  // the states, costs and Token pointers of the tokens that are within the
+  // cutoff into contiguous arrays (giving back the Elems as we go), so that
+  // the arc loop below does not have to chase the linked list of Elems or
+  // dereference the tokens except when it adds a link.  The order of the
+  // tokens is preserved, so the search (and hence the lattice) is exactly the
+  // same as if we iterated over the list directly.
+  emitting_states_.clear();
+  emitting_costs_.clear();
+  emitting_toks_.clear();
   for (Elem *e = final_toks, *e_tail; e != NULL; e = e_tail) {
     // loop this way because we delete "e" as we go.
-    StateId state = e->key;
     Token *tok = e->val;
     if (tok->tot_cost <= cur_cutoff) {
-      for (fst::ArcIterator<FST> aiter(*fst_, state);
-           !aiter.Done();
-           aiter.Next()) {
-        const Arc &arc = aiter.Value();
-        if (arc.ilabel != 0) {  // propagate..
-          BaseFloat ac_cost = cost_offset -
-              decodable->LogLikelihood(frame, arc.ilabel),
-              graph_cost = arc.weight.Value(),
-              cur_cost = tok->tot_cost,
-              tot_cost = cur_cost + ac_cost + graph_cost;
-          if (tot_cost > next_cutoff) continue;
-          else if (tot_cost + adaptive_beam < next_cutoff)
-            next_cutoff = tot_cost + adaptive_beam; // prune by best current token
-          // Note: the frame indexes into active_toks_ are one-based,
-          // hence the + 1.
-          Elem *e_next = FindOrAddToken(arc.nextstate,
-                                        frame + 1, tot_cost, tok, NULL);
-          // NULL: no change indicator needed
-
-          // Add ForwardLink from tok to next_tok (put on head of list tok->links)
-          tok->links = new ForwardLinkT(e_next->val, arc.ilabel, arc.olabel,
-                                        graph_cost, ac_cost, tok->links);
-        }
-      } // for all arcs
+      emitting_states_.push_back(e->key);
+      emitting_costs_.push_back(tok->tot_cost);
+      emitting_toks_.push_back(tok);
     }
     e_tail = e->tail;
     toks_.Delete(e); // delete Elem
   }
+
+  size_t num_emitting = emitting_states_.size();
+  int64 num_emitting_arcs = 0;
+  for (size_t i = 0; i < num_emitting; i++) {
+    StateId state = emitting_states_[i];
+    BaseFloat cur_cost = emitting_costs_[i];
+    Token *tok = emitting_toks_[i];
+    num_emitting_arcs += GetEmittingLogLikes(state, frame, decodable);
+    int32 j = 0;
+    for (fst::EmittingArcIterator<FST> aiter(*fst_, state);
+         !aiter.Done();
+         aiter.Next(), j++) {
+      const Arc &arc = aiter.Value();
+      BaseFloat ac_cost = cost_offset - arc_log_likes_[j],
+          graph_cost = arc.weight.Value(),
+          tot_cost = cur_cost + ac_cost + graph_cost;
+      if (tot_cost > next_cutoff) continue;
+      else if (tot_cost + adaptive_beam < next_cutoff)
+        next_cutoff = tot_cost + adaptive_beam; // prune by best current token
+      // Note: the frame indexes into active_toks_ are one-based,
+      // hence the + 1.
+      Elem *e_next = FindOrAddToken(arc.nextstate,
+                                    frame + 1, tot_cost, tok, NULL);
+      // NULL: no change indicator needed
+
+      // Add ForwardLink from tok to next_tok (put on head of list tok->links)
+      tok->links = new (pool_->Allocate())
+          ForwardLinkT(e_next->val, arc.ilabel, arc.olabel,
+                       graph_cost, ac_cost, tok->links);
+      num_links_++;
+    } // for all emitting arcs
+  }
+  frame_stats_.num_tokens_expanded = num_emitting;
+  frame_stats_.num_emitting_arcs = num_emitting_arcs;
   return next_cutoff;
 }
 
-// static inline
-template <typename FST, typename Token>
-void LatticeFasterDecoderTpl<FST, Token>::DeleteForwardLinks(Token *tok) {
+template <typename FST, typename Token,
+          template <class, class> class HashListType>
+void LatticeFasterDecoderTpl<FST, Token, HashListType>::DeleteForwardLinks(Token *tok) {
   ForwardLinkT *l = tok->links, *m;
   while (l != NULL) {
     m = l->next;
-    delete l;
+    pool_->Free(l);
+    num_links_--;
     l = m;
   }
   tok->links = NULL;
 }
 
 
-template <typename FST, typename Token>
-void LatticeFasterDecoderTpl<FST, Token>::ProcessNonemitting(BaseFloat cutoff) {
+template <typename FST, typename Token,
+          template <class, class> class HashListType>
+void LatticeFasterDecoderTpl<FST, Token, HashListType>::ProcessNonemitting(BaseFloat cutoff) {
   KALDI_ASSERT(!active_toks_.empty());
   int32 frame = static_cast<int32>(active_toks_.size()) - 2;
   // Note: "frame" is the time-index we just processed, or -1 if
@@ -853,8 +1341,13 @@ void LatticeFasterDecoderTpl<FST, Token>::ProcessNonemitting(BaseFloat cutoff) {
     }
   }
 
+  // For frame_stats_: the number of tokens on the frame is the number in
+  // toks_ now plus the number that FindOrAddToken() adds below.
+  int32 num_tokens = 0, num_toks_begin = num_toks_;
+  int64 num_arcs = 0;
   for (const Elem *e = toks_.GetList(); e != NULL;  e = e->tail) {
     StateId state = e->key;
+    num_tokens++;
     if (fst_->NumInputEpsilons(state) != 0)
       queue_.push_back(e);
   }
@@ -874,61 +1367,70 @@ void LatticeFasterDecoderTpl<FST, Token>::ProcessNonemitting(BaseFloat cutoff) {
     // but since most states are emitting it's not a huge issue.
     DeleteForwardLinks(tok); // necessary when re-visiting
     tok->links = NULL;
-    for (fst::ArcIterator<FST> aiter(*fst_, state);
+    for (fst::EpsilonArcIterator<FST> aiter(*fst_, state);
          !aiter.Done();
          aiter.Next()) {
-      const Arc &arc = aiter.Value();
-      if (arc.ilabel == 0) {  // propagate nonemitting only...
-        BaseFloat graph_cost = arc.weight.Value(),
-            tot_cost = cur_cost + graph_cost;
-        if (tot_cost < cutoff) {
-          bool changed;
-
-          Elem *e_new = FindOrAddToken(arc.nextstate, frame + 1, tot_cost,
-                                          tok, &changed);
-
-          tok->links = new ForwardLinkT(e_new->val, 0, arc.olabel,
-                                        graph_cost, 0, tok->links);
-
-          // "changed" tells us whether the new token has a different
-          // cost from before, or is new [if so, add into queue].
-          if (changed && fst_->NumInputEpsilons(arc.nextstate) != 0)
-            queue_.push_back(e_new);
-        }
+      const Arc &arc = aiter.Value();  // nonemitting arcs only...
+      BaseFloat graph_cost = arc.weight.Value(),
+          tot_cost = cur_cost + graph_cost;
+      num_arcs++;
+      if (tot_cost < cutoff) {
+        bool changed;
+
+        Elem *e_new = FindOrAddToken(arc.nextstate, frame + 1, tot_cost,
+                                        tok, &changed);
+
+        tok->links = new (pool_->Allocate())
+            ForwardLinkT(e_new->val, 0, arc.olabel, graph_cost, 0, tok->links);
+        num_links_++;
+
+        // "changed" tells us whether the new token has a different
+        // cost from before, or is new [if so, add into queue].
+        if (changed && fst_->NumInputEpsilons(arc.nextstate) != 0)
+          queue_.push_back(e_new);
       }
-    } // for all arcs
+    } // for all epsilon arcs
   } // while queue not empty
+  frame_stats_.num_tokens_out = num_tokens + (num_toks_ - num_toks_begin);
+  frame_stats_.num_nonemitting_arcs = num_arcs;
 }
 
 
-template <typename FST, typename Token>
-void LatticeFasterDecoderTpl<FST, Token>::DeleteElems(Elem *list) {
+template <typename FST, typename Token,
+          template <class, class> class HashListType>
+void LatticeFasterDecoderTpl<FST, Token, HashListType>::DeleteElems(Elem *list) {
   for (Elem *e = list, *e_tail; e != NULL; e = e_tail) {
     e_tail = e->tail;
     toks_.Delete(e);
   }
 }
 
-template <typename FST, typename Token>
-void LatticeFasterDecoderTpl<FST, Token>::ClearActiveTokens() { // a cleanup routine, at utt end/begin
+template <typename FST, typename Token,
+          template <class, class> class HashListType>
+void LatticeFasterDecoderTpl<FST, Token, HashListType>::ClearActiveTokens() { // a cleanup routine, at utt end/begin
   for (size_t i = 0; i < active_toks_.size(); i++) {
     // Delete all tokens alive on this frame, and any forward
     // links they may have.
     for (Token *tok = active_toks_[i].toks; tok != NULL; ) {
       DeleteForwardLinks(tok);
       Token *next_tok = tok->next;
-      delete tok;
+      pool_->Free(tok);
       num_toks_--;
       tok = next_tok;
     }
   }
   active_toks_.clear();
   KALDI_ASSERT(num_toks_ == 0);
+  // Nothing is allocated from the pool now, so we replace it to return its
+  // blocks to the heap; otherwise one long utterance would keep its peak
+  // memory for the life of the decoder.
+  pool_.reset(new fst::MemoryPool<PoolElem>(config_.memory_pool_block_size));
 }
 
 // static
-template <typename FST, typename Token>
-void LatticeFasterDecoderTpl<FST, Token>::TopSortTokens(
+template <typename FST, typename Token,
+          template <class, class> class HashListType>
+void LatticeFasterDecoderTpl<FST, Token, HashListType>::TopSortTokens(
     Token *tok_list, std::vector<Token*> *topsorted_list) {
   unordered_map<Token*, int32> token2pos;
   typedef typename unordered_map<Token*, int32>::iterator IterType;
@@ -1011,11 +1513,24 @@ template class LatticeFasterDecoderTpl<fst::Fst<fst::StdArc>, decoder::StdToken>
 template class LatticeFasterDecoderTpl<fst::VectorFst<fst::StdArc>, decoder::StdToken >;
 template class LatticeFasterDecoderTpl<fst::ConstFst<fst::StdArc>, decoder::StdToken >;
 template class LatticeFasterDecoderTpl<fst::GrammarFst, decoder::StdToken>;
+template class LatticeFasterDecoderTpl<fst::FlatFst, decoder::StdToken>;
+template class LatticeFasterDecoderTpl<fst::LmComposeFst, decoder::StdToken>;
+template class LatticeFasterDecoderTpl<fst::LazyTrainingGraph, decoder::StdToken>;
 
 template class LatticeFasterDecoderTpl<fst::Fst<fst::StdArc> , decoder::BackpointerToken>;
 template class LatticeFasterDecoderTpl<fst::VectorFst<fst::StdArc>, decoder::BackpointerToken >;
 template class LatticeFasterDecoderTpl<fst::ConstFst<fst::StdArc>, decoder::BackpointerToken >;
 template class LatticeFasterDecoderTpl<fst::GrammarFst, decoder::BackpointerToken>;
+template class LatticeFasterDecoderTpl<fst::FlatFst, decoder::BackpointerToken>;
+template class LatticeFasterDecoderTpl<fst::LmComposeFst, decoder::BackpointerToken>;
+template class LatticeFasterDecoderTpl<fst::LazyTrainingGraph, decoder::BackpointerToken>;
+
+// Versions that use OpenHashList instead of HashList (for the Fst<StdArc>
+// version we also need the VectorFst and ConstFst versions, because
+// AdvanceDecoding() casts to those).
+template class LatticeFasterDecoderTpl<fst::Fst<fst::StdArc>, decoder::StdToken, OpenHashList>;
+template class LatticeFasterDecoderTpl<fst::VectorFst<fst::StdArc>, decoder::StdToken, OpenHashList>;
+template class LatticeFasterDecoderTpl<fst::ConstFst<fst::StdArc>, decoder::StdToken, OpenHashList>;
 
 
 } // end namespace kaldi.
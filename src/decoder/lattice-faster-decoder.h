@@ -26,12 +26,18 @@
 
 #include "util/stl-utils.h"
 #include "util/hash-list.h"
+#include "util/open-hash-list.h"
 #include "fst/fstlib.h"
+#include "fst/memory.h"
 #include "itf/decodable-itf.h"
+#include "itf/decoder-observer-itf.h"
 #include "fstext/fstext-lib.h"
 #include "lat/determinize-lattice-pruned.h"
 #include "lat/kaldi-lattice.h"
 #include "decoder/grammar-fst.h"
+#include "decoder/flat-fst.h"
+#include "decoder/lazy-training-graph.h"
+#include "decoder/lm-compose-fst.h"
 
 namespace kaldi {
 
@@ -43,11 +49,29 @@ struct LatticeFasterDecoderConfig {
   int32 prune_interval;
   bool determinize_lattice; // not inspected by this class... used in
                             // command-line program.
+  int32 determinize_delay;  // not inspected by this class... used in online
+                            // decoding (see online2/online-nnet3-decoding.h).
   BaseFloat beam_delta; // has nothing to do with beam_ratio
   BaseFloat hash_ratio;
   BaseFloat prune_scale;   // Note: we don't make this configurable on the command line,
                            // it's not a very important parameter.  It affects the
                            // algorithm that prunes the tokens as we go.
+  // Number of elements per block in the memory pool from which tokens and
+  // forward-links are allocated (see pool_ in the decoder); allocating from a
+  // pool avoids malloc contention when many decoders run in parallel threads.
+  int32 memory_pool_block_size;
+  // If frame_budget_arcs or frame_budget_ms is >0, the beam is adjusted on
+  // each frame to keep the work per frame near that budget; see
+  // LatticeFasterDecoderTpl::UpdateBudgetBeam().
+  int32 frame_budget_arcs;
+  BaseFloat frame_budget_ms;
+  BaseFloat budget_min_beam;
+  BaseFloat budget_kp;
+  BaseFloat budget_ki;
+  // If >0, the memory in megabytes that the tokens and links of the lattice
+  // may use before the decoder prunes it harder; see
+  // LatticeFasterDecoderTpl::PruneForMemory().
+  BaseFloat max_lattice_mem_mb;
   // Most of the options inside det_opts are not actually queried by the
   // LatticeFasterDecoder class itself, but by the code that calls it, for
   // example in the function DecodeUtteranceLatticeFaster.
@@ -59,9 +83,17 @@ struct LatticeFasterDecoderConfig {
                                 lattice_beam(10.0),
                                 prune_interval(25),
                                 determinize_lattice(true),
+                                determinize_delay(0),
                                 beam_delta(0.5),
                                 hash_ratio(2.0),
-                                prune_scale(0.1) { }
+                                prune_scale(0.1),
+                                memory_pool_block_size(1 << 9),
+                                frame_budget_arcs(0),
+                                frame_budget_ms(0.0),
+                                budget_min_beam(6.0),
+                                budget_kp(1.0),
+                                budget_ki(0.3),
+                                max_lattice_mem_mb(0.0) { }
   void Register(OptionsItf *opts) {
     det_opts.Register(opts);
     opts->Register("beam", &beam, "Decoding beam.  Larger->slower, more accurate.");
@@ -75,17 +107,65 @@ struct LatticeFasterDecoderConfig {
     opts->Register("determinize-lattice", &determinize_lattice, "If true, "
                    "determinize the lattice (lattice-determinization, keeping only "
                    "best pdf-sequence for each word-sequence).");
+    opts->Register("determinize-delay", &determinize_delay, "In online "
+                   "decoding, if >0, the lattice is determinized incrementally: "
+                   "frames more than this many frames behind the most recently "
+                   "decoded frame are determinized once, in chunks of at least "
+                   "this many frames, rather than each time the lattice is "
+                   "obtained.  This makes getting partial lattices of long "
+                   "utterances faster.  Should be at least --prune-interval.");
     opts->Register("beam-delta", &beam_delta, "Increment used in decoding-- this "
                    "parameter is obscure and relates to a speedup in the way the "
                    "max-active constraint is applied.  Larger is more accurate.");
     opts->Register("hash-ratio", &hash_ratio, "Setting used in decoder to "
                    "control hash behavior");
+    opts->Register("memory-pool-block-size", &memory_pool_block_size,
+                   "Memory pool block size suggestion for storing tokens and "
+                   "links (in elements).  Smaller uses less memory but "
+                   "increases cache misses.");
+    opts->Register("frame-budget-arcs", &frame_budget_arcs, "If >0, the "
+                   "number of arcs to expand per frame: the beam is lowered "
+                   "(down to --budget-min-beam) on frames that would exceed "
+                   "it, and max-active is lowered so that the number of arcs "
+                   "rarely exceeds twice this.  Bounds the time per frame at "
+                   "some cost in accuracy.");
+    opts->Register("frame-budget-ms", &frame_budget_ms, "If >0, the time "
+                   "budget per frame in milliseconds, which is converted to a "
+                   "number of arcs using the measured time per arc and used "
+                   "as for --frame-budget-arcs (the smaller applies if both "
+                   "are set).");
+    opts->Register("budget-min-beam", &budget_min_beam, "The smallest beam "
+                   "used when --frame-budget-arcs or --frame-budget-ms is "
+                   "set.");
+    opts->Register("budget-kp", &budget_kp, "Proportional gain of the beam "
+                   "controller for --frame-budget-arcs and --frame-budget-ms: "
+                   "the beam is lowered by this times the log of the ratio of "
+                   "the work on a frame to the budget.");
+    opts->Register("budget-ki", &budget_ki, "Integral gain of the beam "
+                   "controller for --frame-budget-arcs and --frame-budget-ms, "
+                   "which applies to the sum of the log-ratios over frames.");
+    opts->Register("max-lattice-mem-mb", &max_lattice_mem_mb, "If >0, the "
+                   "memory in MB that the tokens and links of the lattice may "
+                   "use (checked every --prune-interval frames): when it is "
+                   "exceeded the whole lattice is pruned, with a lattice beam "
+                   "halved as many times as needed (down to 1/16 of "
+                   "--lattice-beam), rather than running out of memory on "
+                   "long utterances.");
+  }
+  bool HasFrameBudget() const {
+    return frame_budget_arcs > 0 || frame_budget_ms > 0.0;
   }
   void Check() const {
     KALDI_ASSERT(beam > 0.0 && max_active > 1 && lattice_beam > 0.0
-                 && min_active <= max_active
+                 && min_active <= max_active && determinize_delay >= 0
                  && prune_interval > 0 && beam_delta > 0.0 && hash_ratio >= 1.0
-                 && prune_scale > 0.0 && prune_scale < 1.0);
+                 && prune_scale > 0.0 && prune_scale < 1.0
+                 && memory_pool_block_size > 0);
+    KALDI_ASSERT(frame_budget_arcs >= 0 && frame_budget_ms >= 0.0 &&
+                 budget_kp >= 0.0 && budget_ki >= 0.0 &&
+                 max_lattice_mem_mb >= 0.0);
+    if (HasFrameBudget())
+      KALDI_ASSERT(budget_min_beam > 0.0 && budget_min_beam <= beam);
   }
 };
 
@@ -151,6 +231,9 @@ struct StdToken {
   // for LatticeFasterOnlineDecoder that supports fast traceback.
   inline void SetBackpointer (Token *backpointer) { }
 
+  // Likewise, this always returns NULL.
+  inline Token *Backpointer() const { return NULL; }
+
   // This constructor just ignores the 'backpointer' argument.  That argument is
   // needed so that we can use the same decoder code for LatticeFasterDecoderTpl
   // and LatticeFasterOnlineDecoderTpl (which needs backpointers to support a
@@ -199,6 +282,8 @@ struct BackpointerToken {
     this->backpointer = backpointer;
   }
 
+  inline Token *Backpointer() const { return backpointer; }
+
   inline BackpointerToken(BaseFloat tot_cost, BaseFloat extra_cost, ForwardLinkT *links,
                           Token *next, Token *backpointer):
       tot_cost(tot_cost), extra_cost(extra_cost), links(links), next(next),
@@ -217,13 +302,25 @@ struct BackpointerToken {
    quick lookup of the current best path (see lattice-faster-online-decoder.h)
 
    The FST you invoke this decoder which is expected to equal
-   Fst::Fst<fst::StdArc>, a.k.a. StdFst, or GrammarFst.  If you invoke it with
+   Fst::Fst<fst::StdArc>, a.k.a. StdFst, or GrammarFst, or FlatFst (see
+   flat-fst.h; it stores the epsilon and emitting arcs of each state
+   separately, which saves testing each arc's ilabel), or LmComposeFst (see
+   lm-compose-fst.h; it composes an HCL graph with the language model as the
+   decoder goes).  If you invoke it with
    FST == StdFst and it notices that the actual FST type is
    fst::VectorFst<fst::StdArc> or fst::ConstFst<fst::StdArc>, the decoder object
    will internally cast itself to one that is templated on those more specific
    types; this is an optimization for speed.
+
+   The last template argument is the type of the hash that maps state-ids to
+   tokens on the current frame; it may be HashList (see ../util/hash-list.h) or
+   OpenHashList (see ../util/open-hash-list.h), which have the same interface.
+   OpenHashList is generally faster when there are many active states, but it
+   visits the states in a different order, so the pruning (and hence the
+   lattices) may differ very slightly between the two.
  */
-template <typename FST, typename Token = decoder::StdToken>
+template <typename FST, typename Token = decoder::StdToken,
+          template <class, class> class HashListType = HashList>
 class LatticeFasterDecoderTpl {
  public:
   using Arc = typename FST::Arc;
@@ -251,8 +348,23 @@ class LatticeFasterDecoderTpl {
     return config_;
   }
 
+  /// Sets an object to be given the statistics of the search after each
+  /// frame is decoded (see DecoderObserverInterface), or NULL for none.  This
+  /// object does not take ownership of it.
+  void SetObserver(DecoderObserverInterface *observer) {
+    observer_ = observer;
+  }
+
   ~LatticeFasterDecoderTpl();
 
+  /// Returns the approximate memory in bytes used by the tokens and forward
+  /// links of the lattice so far, which is most of the memory used by the
+  /// decoder on long utterances.  It does not count the free space in the
+  /// memory pool.
+  int64 MemoryUsage() const {
+    return static_cast<int64>(num_toks_ + num_links_) * sizeof(PoolElem);
+  }
+
   /// Decodes until there are no more frames left in the "decodable" object..
   /// note, this may block waiting for input if the "decodable" object blocks.
   /// Returns true if any kind of traceback is available (not necessarily from a
@@ -288,6 +400,27 @@ class LatticeFasterDecoderTpl {
   /// We could put that here in future needed.
   bool GetRawLattice(Lattice *ofst, bool use_final_probs = true) const;
 
+  /// This is as GetRawLattice() but it outputs only the part of the raw
+  /// lattice from frame 'begin_frame' to 'end_frame' (these are numbers of
+  /// frames decoded, so 0 <= begin_frame < end_frame <= NumFramesDecoded()),
+  /// adding it to 'ofst'; it is for determinizing the lattice in chunks (see
+  /// LatticeIncrementalDeterminizer in lat/determinize-lattice-incremental.h).
+  /// If begin_frame == 0, 'ofst' must be empty on entry and the chunk starts
+  /// at the start state as usual.  Otherwise the chunk starts at the states of
+  /// 'ofst' that 'begin_states' gives for tokens on frame 'begin_frame' (those
+  /// not in it are left out), and includes only their emitting links, as the
+  /// links between tokens on the same frame belong to the previous chunk.
+  /// If 'end_states' is NULL, end_frame must equal NumFramesDecoded(), and the
+  /// final-probs are set as in GetRawLattice(); otherwise the tokens on frame
+  /// 'end_frame' and their states are output to 'end_states', in topological
+  /// order, and no final-probs are set.
+  /// Returns true if result is nonempty.
+  bool GetRawLatticeChunk(
+      int32 begin_frame, int32 end_frame, bool use_final_probs,
+      const unordered_map<Token*, LatticeArc::StateId> &begin_states,
+      Lattice *ofst,
+      std::vector<std::pair<Token*, LatticeArc::StateId> > *end_states) const;
+
 
 
   /// [Deprecated, users should now use GetRawLattice and determinize it
@@ -342,13 +475,29 @@ class LatticeFasterDecoderTpl {
   // whenever we call ProcessEmitting().
   inline int32 NumFramesDecoded() const { return active_toks_.size() - 1; }
 
+  /// Writes the state of the decoding of the current utterance (the tokens
+  /// and links of all frames decoded so far), so that it can be carried on
+  /// from the same point after ReadState(), e.g. by a decoder in another
+  /// process.  The tokens of the most recent frame are written with their
+  /// state-ids, so the decoder that reads it must use the same graph, whose
+  /// state-ids must not depend on the order in which states were visited
+  /// (this rules out LmComposeFst).  Must not be called after
+  /// FinalizeDecoding().
+  void WriteState(std::ostream &os, bool binary) const;
+
+  /// Reads the state written by WriteState(), replacing the current state;
+  /// you can then call AdvanceDecoding() as if you had called it on the
+  /// decoder that wrote it.
+  void ReadState(std::istream &is, bool binary);
+
  protected:
   // we make things protected instead of private, as code in
   // LatticeFasterOnlineDecoderTpl, which inherits from this, also uses the
   // internals.
 
-  // Deletes the elements of the singly linked list tok->links.
-  inline static void DeleteForwardLinks(Token *tok);
+  // Deletes the elements of the singly linked list tok->links, returning
+  // them to pool_.
+  inline void DeleteForwardLinks(Token *tok);
 
   // head of per-frame list of Tokens (list is in topological order),
   // and something saying whether we ever pruned it using PruneForwardLinks.
@@ -360,7 +509,7 @@ class LatticeFasterDecoderTpl {
                  must_prune_tokens(true) { }
   };
 
-  using Elem = typename HashList<StateId, Token*>::Elem;
+  using Elem = typename HashListType<StateId, Token*>::Elem;
   // Equivalent to:
   //  struct Elem {
   //    StateId key;
@@ -442,6 +591,14 @@ class LatticeFasterDecoderTpl {
   BaseFloat GetCutoff(Elem *list_head, size_t *tok_count,
                       BaseFloat *adaptive_beam, Elem **best_elem);
 
+  /// Puts the acoustic log-likelihoods on frame 'frame' of the emitting arcs
+  /// leaving 'state' in arc_log_likes_, in the order of
+  /// fst::EmittingArcIterator, using a single call to
+  /// decodable->LogLikelihoods().  Only the input labels are copied (to
+  /// arc_ilabels_), not the arcs.  Returns the number of emitting arcs.
+  inline int32 GetEmittingLogLikes(StateId state, int32 frame,
+                                   DecodableInterface *decodable);
+
   /// Processes emitting arcs for one frame.  Propagates from prev_toks_ to
   /// cur_toks_.  Returns the cost cutoff for subsequent ProcessNonemitting() to
   /// use.
@@ -452,14 +609,41 @@ class LatticeFasterDecoderTpl {
   /// preceding ProcessEmitting().
   void ProcessNonemitting(BaseFloat cost_cutoff);
 
-  // HashList defined in ../util/hash-list.h.  It actually allows us to maintain
+  /// Decodes one frame: prunes the lattice if it is time to, and calls
+  /// ProcessEmitting() and ProcessNonemitting().  If observer_ is set, times
+  /// these and gives it the statistics of the frame.
+  void DecodeFrame(DecodableInterface *decodable);
+
+  /// Called after each frame if config_.HasFrameBudget(): sets beam_ and
+  /// max_active_ for the next frame from the number of arcs expanded on this
+  /// frame (in frame_stats_) and, for frame_budget_ms, the time it took.
+  /// This is a PI controller on the log of the ratio of the work to the
+  /// budget, like a thermostat: the proportional term reacts to bursts of
+  /// work, and the integral term to the beam being too wide for the budget
+  /// over many frames.  The integral is clamped so that it does not wind up
+  /// while the beam is at its limits.  As the beam only takes effect on the
+  /// next frame, max_active_ is also lowered to about twice the budget
+  /// divided by the average number of arcs per token, which bounds the work
+  /// on a frame where the search suddenly gets much wider.
+  void UpdateBudgetBeam(double frame_seconds);
+
+  /// Called every config_.prune_interval frames if MemoryUsage() exceeds
+  /// config_.max_lattice_mem_mb: prunes the whole lattice (not just the frames
+  /// that PruneActiveTokens() would normally revisit) and, while that is not
+  /// enough, halves lattice_beam_ and prunes again, down to 1/16 of the
+  /// configured lattice beam.  The lattice gets thinner but decoding carries
+  /// on; lattice_beam_ is restored by InitDecoding().
+  void PruneForMemory();
+
+  // HashList defined in ../util/hash-list.h (or OpenHashList, see
+  // HashListType above).  It actually allows us to maintain
   // more than one list (e.g. for current and previous frames), but only one of
   // them at a time can be indexed by StateId.  It is indexed by frame-index
   // plus one, where the frame-index is zero-based, as used in decodable object.
   // That is, the emitting probs of frame t are accounted for in tokens at
   // toks_[t+1].  The zeroth frame is for nonemitting transition at the start of
   // the graph.
-  HashList<StateId, Token*> toks_;
+  HashListType<StateId, Token*> toks_;
 
   std::vector<TokenList> active_toks_; // Lists of tokens, indexed by
   // frame (members of TokenList are toks, must_prune_forward_links,
@@ -467,6 +651,33 @@ class LatticeFasterDecoderTpl {
   std::vector<const Elem* > queue_;  // temp variable used in ProcessNonemitting,
   std::vector<BaseFloat> tmp_array_;  // used in GetCutoff.
 
+  // The states, costs and Tokens of the previous frame's tokens that are within
+  // the cutoff, in the order they were in toks_.  These are temporaries used in
+  // ProcessEmitting(), kept as members to avoid reallocating them every frame.
+  std::vector<StateId> emitting_states_;
+  std::vector<BaseFloat> emitting_costs_;
+  std::vector<Token*> emitting_toks_;
+
+  // The input labels of the emitting arcs out of a single state and the
+  // corresponding acoustic log-likelihoods; temporaries used in
+  // GetEmittingLogLikes().
+  std::vector<int32> arc_ilabels_;
+  std::vector<BaseFloat> arc_log_likes_;
+
+  // Memory pool for tokens and forward links.  Tokens and links are
+  // allocated from it with placement new and returned to it (rather than to
+  // the heap) when they are pruned, so decoding only calls malloc once per
+  // block of config_.memory_pool_block_size elements, and only while the
+  // lattice is growing.  The pool never gives memory back while it exists, so
+  // ClearActiveTokens() replaces it once everything has been freed; thus the
+  // memory held between utterances is not that of the longest utterance so
+  // far.  Both types are trivially destructible, so we never call their
+  // destructors.  The two types share one pool, whose elements are big
+  // enough for either, so that a token and the links created when it is
+  // expanded are close together in memory.
+  typedef typename std::aligned_union<0, Token, ForwardLinkT>::type PoolElem;
+  std::unique_ptr<fst::MemoryPool<PoolElem> > pool_;
+
   // fst_ is a pointer to the FST we are decoding from.
   const FST *fst_;
   // delete_fst_ is true if the pointer fst_ needs to be deleted when this
@@ -479,7 +690,29 @@ class LatticeFasterDecoderTpl {
   // zero, to reduce roundoff errors.
   LatticeFasterDecoderConfig config_;
   int32 num_toks_; // current total #toks allocated...
+  int64 num_links_; // current total #links allocated.
   bool warned_;
+  // The lattice beam used in pruning: config_.lattice_beam, unless
+  // PruneForMemory() has reduced it.
+  BaseFloat lattice_beam_;
+
+  // The beam and max-active used by GetCutoff(): those in config_, unless
+  // they are being adjusted by UpdateBudgetBeam().
+  BaseFloat beam_;
+  int32 max_active_;
+  // The state of UpdateBudgetBeam(): the integral of the error, and moving
+  // averages of the arcs expanded per token and of the seconds per arc (0
+  // until measured).
+  double budget_integral_;
+  double arcs_per_token_;
+  double seconds_per_arc_;
+
+  // See SetObserver(); may be NULL.
+  DecoderObserverInterface *observer_;
+  // The statistics of the frame being decoded, some of which are set by
+  // ProcessEmitting() and ProcessNonemitting() (the counts are cheap to keep,
+  // so they are kept whether or not observer_ is set).
+  DecoderFrameStats frame_stats_;
 
   /// decoding_finalized_ is true if someone called FinalizeDecoding().  [note,
   /// calling this is optional].  If true, it's forbidden to decode more.  Also,
@@ -495,6 +728,15 @@ class LatticeFasterDecoderTpl {
   BaseFloat final_relative_cost_;
   BaseFloat final_best_cost_;
 
+  /// These are only used by LatticeFasterOnlineDecoderTpl, in
+  /// NumFramesTracebackFixed(), to remember the last token that it found all
+  /// the active tokens to be descended from, and the frame that token is on,
+  /// and in GetPartialResult(), to remember how far back the words have
+  /// already been output as stable.  They are reset by InitDecoding().
+  mutable Token *traceback_fixed_tok_;
+  mutable int32 num_frames_traceback_fixed_;
+  Token *partial_result_tok_;
+
   // There are various cleanup tasks... the toks_ structure contains
   // singly linked lists of Token pointers, where Elem is the list type.
   // It also indexes them in a hash, indexed by state (this hash is only
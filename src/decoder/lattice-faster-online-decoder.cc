@@ -164,6 +164,99 @@ typename LatticeFasterOnlineDecoderTpl<FST>::BestPathIterator LatticeFasterOnlin
   return BestPathIterator(tok->backpointer, ret_t);
 }
 
+template <typename FST>
+const typename LatticeFasterOnlineDecoderTpl<FST>::ForwardLinkT*
+LatticeFasterOnlineDecoderTpl<FST>::BackpointerLink(Token *tok) const {
+  for (ForwardLinkT *link = tok->backpointer->links; link != NULL;
+       link = link->next)
+    if (link->next_tok == tok)
+      return link;
+  KALDI_ERR << "Error tracing best-path back (likely "
+            << "bug in token-pruning algorithm)";
+  return NULL;
+}
+
+template <typename FST>
+int32 LatticeFasterOnlineDecoderTpl<FST>::NumFramesTracebackFixed() const {
+  Token *first_tok = this->active_toks_.back().toks;
+  if (first_tok == NULL)
+    return this->num_frames_traceback_fixed_;
+  // 'chain' is the traceback from the first token on the most recent frame to
+  // the token found last time (or to the start token).  All the active tokens
+  // are descended from that token, so tracing back from each of them reaches
+  // 'chain'; the common ancestor we want is the element of 'chain' furthest
+  // back that is reached.
+  std::vector<Token*> chain;
+  unordered_map<Token*, int32> chain_pos;
+  for (Token *tok = first_tok; tok != NULL; tok = tok->backpointer) {
+    chain_pos[tok] = chain.size();
+    chain.push_back(tok);
+    if (tok == this->traceback_fixed_tok_)
+      break;
+  }
+  int32 ancestor_pos = 0;
+  // 'visited' is the tokens not in 'chain' that we already traced back from.
+  unordered_set<Token*> visited;
+  for (Token *tok = first_tok->next; tok != NULL; tok = tok->next) {
+    for (Token *t = tok; ; t = t->backpointer) {
+      KALDI_ASSERT(t != NULL);
+      typename unordered_map<Token*, int32>::const_iterator iter =
+          chain_pos.find(t);
+      if (iter != chain_pos.end()) {
+        ancestor_pos = std::max(ancestor_pos, iter->second);
+        break;
+      }
+      if (!visited.insert(t).second)
+        break;
+    }
+    if (ancestor_pos + 1 == static_cast<int32>(chain.size()))
+      break;  // It can't go back any further.
+  }
+  // Work out which frame chain[ancestor_pos] is on.
+  int32 frame = this->NumFramesDecoded();
+  for (int32 i = 0; i < ancestor_pos; i++)
+    if (BackpointerLink(chain[i])->ilabel != 0)
+      frame--;
+  this->traceback_fixed_tok_ = chain[ancestor_pos];
+  this->num_frames_traceback_fixed_ = frame;
+  return frame;
+}
+
+template <typename FST>
+void LatticeFasterOnlineDecoderTpl<FST>::GetPartialResult(
+    std::vector<int32> *new_stable_words,
+    std::vector<int32> *unstable_words) {
+  new_stable_words->clear();
+  unstable_words->clear();
+  if (this->NumFramesDecoded() == 0)
+    return;
+  NumFramesTracebackFixed();
+  Token *fixed_tok = this->traceback_fixed_tok_;
+  // The words between the token we got to last time and 'fixed_tok'.  The
+  // start token is the only one with no backpointer.
+  for (Token *tok = fixed_tok;
+       tok != this->partial_result_tok_ && tok->backpointer != NULL;
+       tok = tok->backpointer) {
+    Label olabel = BackpointerLink(tok)->olabel;
+    if (olabel != 0)
+      new_stable_words->push_back(olabel);
+  }
+  std::reverse(new_stable_words->begin(), new_stable_words->end());
+  this->partial_result_tok_ = fixed_tok;
+
+  // The words between 'fixed_tok' and the current best token, which every
+  // active token is descended from.
+  BestPathIterator iter = BestPathEnd(this->decoding_finalized_);
+  for (Token *tok = static_cast<Token*>(iter.tok); tok != fixed_tok;
+       tok = tok->backpointer) {
+    KALDI_ASSERT(tok != NULL);
+    Label olabel = BackpointerLink(tok)->olabel;
+    if (olabel != 0)
+      unstable_words->push_back(olabel);
+  }
+  std::reverse(unstable_words->begin(), unstable_words->end());
+}
+
 template <typename FST>
 bool LatticeFasterOnlineDecoderTpl<FST>::GetRawLatticePruned(
     Lattice *ofst,
@@ -271,6 +364,8 @@ template class LatticeFasterOnlineDecoderTpl<fst::Fst<fst::StdArc> >;
 template class LatticeFasterOnlineDecoderTpl<fst::VectorFst<fst::StdArc> >;
 template class LatticeFasterOnlineDecoderTpl<fst::ConstFst<fst::StdArc> >;
 template class LatticeFasterOnlineDecoderTpl<fst::GrammarFst>;
+template class LatticeFasterOnlineDecoderTpl<fst::FlatFst>;
+template class LatticeFasterOnlineDecoderTpl<fst::LmComposeFst>;
 
 
 } // end namespace kaldi.
@@ -126,6 +126,30 @@ class LatticeFasterOnlineDecoderTpl:
   BestPathIterator TraceBackBestPath(
       BestPathIterator iter, LatticeArc *arc) const;
 
+  /// Returns the number of frames, from the start of the utterance, on which
+  /// the traceback is fixed: all the tokens active on the most recent frame
+  /// trace back to the same token on that frame, so whichever of them the
+  /// best path ends up going through, the best path on those frames (its
+  /// transition-ids and words) can no longer change.  The value never
+  /// decreases as decoding goes on.  This is useful for emitting partial
+  /// results that will not be revised.  The work done is incremental: it only
+  /// traces back as far as the token found by the previous call.
+  int32 NumFramesTracebackFixed() const;
+
+  /// This is for programs that display partial results while decoding.  It
+  /// outputs to *new_stable_words the words of the best path that became fixed
+  /// (see NumFramesTracebackFixed()) since the last call to this function
+  /// (or since InitDecoding()), and to *unstable_words the words of the current
+  /// best path after those, which may still change.  So the concatenation of
+  /// the new_stable_words from all the calls, followed by the unstable_words
+  /// from the latest call, is the current best path.  It doesn't build a
+  /// lattice, and the work done is proportional to the number of frames since
+  /// the traceback was last fixed, not to the length of the utterance.  If
+  /// FinalizeDecoding() has been called, final-probs are used in choosing the
+  /// best path.
+  void GetPartialResult(std::vector<int32> *new_stable_words,
+                        std::vector<int32> *unstable_words);
+
 
   /// Behaves the same as GetRawLattice but only processes tokens whose
   /// extra_cost is smaller than the best-cost plus the specified beam.
@@ -137,6 +161,12 @@ class LatticeFasterOnlineDecoderTpl:
                            BaseFloat beam) const;
 
   KALDI_DISALLOW_COPY_AND_ASSIGN(LatticeFasterOnlineDecoderTpl);
+
+ private:
+  // Returns the link from tok->backpointer to tok; tok must not be the start
+  // token.  Its ilabel is nonzero if tok is on the frame after its
+  // backpointer's.
+  const ForwardLinkT *BackpointerLink(Token *tok) const;
 };
 
 typedef LatticeFasterOnlineDecoderTpl<fst::StdFst> LatticeFasterOnlineDecoder;
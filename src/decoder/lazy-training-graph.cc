@@ -0,0 +1,160 @@
+// decoder/lazy-training-graph.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "decoder/lazy-training-graph.h"
+#include "hmm/hmm-utils.h"
+
+namespace fst {
+
+LazyTrainingGraphHmms::~LazyTrainingGraphHmms() {
+  std::map<std::vector<int32>, VectorFst<StdArc>*>::iterator iter;
+  for (iter = hmms_.begin(); iter != hmms_.end(); ++iter)
+    delete iter->second;
+}
+
+const VectorFst<StdArc> *LazyTrainingGraphHmms::GetHmm(
+    const std::vector<int32> &phone_window) {
+  VectorFst<StdArc> *&hmm = hmms_[phone_window];
+  if (hmm == NULL) {
+    // Create it without probabilities, then add them as they would be added
+    // to a compiled graph.
+    hmm = kaldi::GetHmmAsFsaSimple(phone_window, ctx_dep_, trans_model_, 0.0);
+    std::vector<int32> disambig_syms;
+    kaldi::AddTransitionProbs(trans_model_, disambig_syms, transition_scale_,
+                              self_loop_scale_, hmm);
+  }
+  return hmm;
+}
+
+
+LazyTrainingGraph::LazyTrainingGraph(
+    const VectorFst<StdArc> &clg,
+    const std::vector<std::vector<int32> > &ilabel_info,
+    LazyTrainingGraphHmms *hmms):
+    clg_(clg), ilabel_info_(ilabel_info), hmms_(hmms), start_(kNoStateId) {
+  if (clg_.Start() != kNoStateId)
+    start_ = FindOrAddState(clg_.Start(), -1, kNoStateId);
+}
+
+LazyTrainingGraph::~LazyTrainingGraph() {
+  for (size_t i = 0; i < expanded_states_.size(); i++)
+    delete expanded_states_[i];
+}
+
+LazyTrainingGraph::Weight LazyTrainingGraph::Final(StateId s) const {
+  const StateInfo &info = states_[s];
+  if (info.arc_index == -1)
+    return clg_.Final(info.clg_state);
+  else
+    return Weight::Zero();  // The HMMs are left through the clg_ states.
+}
+
+LazyTrainingGraph::StateId LazyTrainingGraph::FindOrAddState(
+    StateId clg_state, int32 arc_index, StateId hmm_state) const {
+  StateKey key(std::make_pair(clg_state, arc_index + 1), hmm_state);
+  StateId new_state = states_.size();
+  std::pair<std::unordered_map<StateKey, StateId, StateKeyHasher>::iterator,
+            bool> ret = state_map_.insert(std::make_pair(key, new_state));
+  if (ret.second) {
+    StateInfo info;
+    info.clg_state = clg_state;
+    info.arc_index = arc_index;
+    info.hmm_state = hmm_state;
+    states_.push_back(info);
+    expanded_states_.push_back(NULL);
+  }
+  return ret.first->second;
+}
+
+const VectorFst<StdArc> *LazyTrainingGraph::GetHmm(Label ilabel) const {
+  KALDI_ASSERT(ilabel >= 0 &&
+               static_cast<size_t>(ilabel) < ilabel_info_.size());
+  if (ilabel_hmms_.size() <= static_cast<size_t>(ilabel))
+    ilabel_hmms_.resize(ilabel_info_.size(), NULL);
+  const VectorFst<StdArc> *&hmm = ilabel_hmms_[ilabel];
+  if (hmm == NULL) {
+    const std::vector<int32> &phone_window = ilabel_info_[ilabel];
+    // Epsilon has an empty window, and disambiguation symbols have a window
+    // of one, non-positive, symbol; they don't have HMMs.
+    if (phone_window.empty() ||
+        (phone_window.size() == 1 && phone_window[0] <= 0))
+      return NULL;
+    hmm = hmms_->GetHmm(phone_window);
+  }
+  return hmm;
+}
+
+const LazyTrainingGraph::ExpandedState *LazyTrainingGraph::ExpandState(
+    StateId s) const {
+  ExpandedState *state = new ExpandedState();
+  StateInfo info = states_[s];
+  std::vector<Arc> emitting_arcs;
+  if (info.arc_index == -1) {
+    // A state of clg_: each arc goes to the start of its HMM, or straight to
+    // its destination if it has no HMM.
+    int32 arc_index = 0;
+    for (ArcIterator<VectorFst<StdArc> > aiter(clg_, info.clg_state);
+         !aiter.Done(); aiter.Next(), arc_index++) {
+      Arc arc = aiter.Value();
+      const VectorFst<StdArc> *hmm = GetHmm(arc.ilabel);
+      arc.ilabel = 0;
+      if (hmm == NULL)
+        arc.nextstate = FindOrAddState(arc.nextstate, -1, kNoStateId);
+      else
+        arc.nextstate = FindOrAddState(info.clg_state, arc_index,
+                                       hmm->Start());
+      state->arcs.push_back(arc);
+    }
+  } else {
+    // A state of an HMM.  Arcs into a final state of the HMM that has no
+    // arcs of its own go straight to the destination of the clg_ arc.
+    ArcIterator<VectorFst<StdArc> > clg_aiter(clg_, info.clg_state);
+    clg_aiter.Seek(info.arc_index);
+    const Arc &clg_arc = clg_aiter.Value();
+    const VectorFst<StdArc> *hmm = GetHmm(clg_arc.ilabel);
+    StateId clg_nextstate = FindOrAddState(clg_arc.nextstate, -1, kNoStateId);
+    Weight final = hmm->Final(info.hmm_state);
+    if (final != Weight::Zero())
+      state->arcs.push_back(Arc(0, 0, final, clg_nextstate));
+    for (ArcIterator<VectorFst<StdArc> > aiter(*hmm, info.hmm_state);
+         !aiter.Done(); aiter.Next()) {
+      Arc arc = aiter.Value();
+      arc.olabel = 0;
+      Weight next_final = hmm->Final(arc.nextstate);
+      if (next_final != Weight::Zero() && hmm->NumArcs(arc.nextstate) == 0) {
+        arc.weight = Times(arc.weight, next_final);
+        arc.nextstate = clg_nextstate;
+      } else {
+        arc.nextstate = FindOrAddState(info.clg_state, info.arc_index,
+                                       arc.nextstate);
+      }
+      if (arc.ilabel == 0)
+        state->arcs.push_back(arc);
+      else
+        emitting_arcs.push_back(arc);
+    }
+  }
+  state->num_input_epsilons = state->arcs.size();
+  state->arcs.insert(state->arcs.end(), emitting_arcs.begin(),
+                     emitting_arcs.end());
+  expanded_states_[s] = state;
+  return state;
+}
+
+}  // namespace fst
@@ -0,0 +1,269 @@
+// decoder/lazy-training-graph.h
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_DECODER_LAZY_TRAINING_GRAPH_H_
+#define KALDI_DECODER_LAZY_TRAINING_GRAPH_H_
+
+/**
+   This header implements LazyTrainingGraph, an FST type for forced alignment
+   that expands the HMMs of a training graph on demand, as the decoder visits
+   its states, instead of composing with H, determinizing, minimizing and
+   adding self-loops as TrainingGraphCompiler does.  The input is the
+   composition of the context FST with the lexicon and the transcript (see
+   TrainingGraphCompiler::CompileContextGraph()), which is small and cheap to
+   build, and the HMMs come from a LazyTrainingGraphHmms object, which is
+   shared between utterances.
+
+   Like LmComposeFst, it does not inherit from fst::Fst; it has just enough of
+   the same interface for the decoders to be templated on it.
+ */
+
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "decoder/flat-fst.h"
+#include "fst/fstlib.h"
+#include "hmm/transition-model.h"
+#include "tree/context-dep.h"
+
+namespace fst {
+
+/**
+   LazyTrainingGraphHmms creates and stores the HMMs (as acceptors of
+   transition-ids, with self-loops and transition probabilities) of the phones
+   in context that the training graphs need, so that each is only created
+   once per program.  The transition probabilities are scaled as
+   AddTransitionProbs() would scale them.
+*/
+class LazyTrainingGraphHmms {
+ public:
+  LazyTrainingGraphHmms(const kaldi::ContextDependency &ctx_dep,
+                        const kaldi::TransitionModel &trans_model,
+                        kaldi::BaseFloat transition_scale,
+                        kaldi::BaseFloat self_loop_scale):
+      ctx_dep_(ctx_dep), trans_model_(trans_model),
+      transition_scale_(transition_scale), self_loop_scale_(self_loop_scale) { }
+
+  ~LazyTrainingGraphHmms();
+
+  /// Returns the HMM for this phone in context (see \ref tree_window); the
+  /// pointer is owned here.
+  const VectorFst<StdArc> *GetHmm(const std::vector<int32> &phone_window);
+
+ private:
+  const kaldi::ContextDependency &ctx_dep_;
+  const kaldi::TransitionModel &trans_model_;
+  kaldi::BaseFloat transition_scale_;
+  kaldi::BaseFloat self_loop_scale_;
+  std::map<std::vector<int32>, VectorFst<StdArc>*> hmms_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(LazyTrainingGraphHmms);
+};
+
+
+class LazyTrainingGraph;
+
+// Declare that we'll be overriding class ArcIterator for class
+// LazyTrainingGraph.
+template<> class ArcIterator<LazyTrainingGraph>;
+
+/**
+   LazyTrainingGraph is the training graph H o C o L o G of an utterance, whose
+   states are expanded the first time they are visited.  A state is either a
+   state of "clg" (C o L o G), or a state of the HMM on one of its arcs.  An
+   arc of "clg" whose input label is a phone in context becomes an epsilon arc
+   (with the word, if any) to the start state of that HMM, and the arcs that
+   enter the final state of the HMM go to the destination state of the "clg"
+   arc instead.
+
+   The graph is not determinized or minimized, so if different pronunciations
+   give the same sequence of transition-ids, the Viterbi alignment takes the
+   best of them where the compiled graph would have summed their
+   probabilities.  This rarely makes a difference.
+
+   THREAD SAFETY: you can't use this object, or the LazyTrainingGraphHmms
+   object, from multiple threads.
+*/
+class LazyTrainingGraph {
+ public:
+  typedef StdArc Arc;
+  typedef Arc::StateId StateId;
+  typedef Arc::Label Label;
+  typedef Arc::Weight Weight;
+
+  /// Constructor.  "clg" is C o L o G with input symbols that index
+  /// "ilabel_info" (as output by TrainingGraphCompiler::CompileContextGraph()).
+  /// None of the arguments is owned here; they must outlive this object.
+  LazyTrainingGraph(const VectorFst<StdArc> &clg,
+                    const std::vector<std::vector<int32> > &ilabel_info,
+                    LazyTrainingGraphHmms *hmms);
+
+  ~LazyTrainingGraph();
+
+  StateId Start() const { return start_; }
+
+  Weight Final(StateId s) const;
+
+  /// Returns the number of input-epsilon arcs leaving state s (which expands
+  /// the state if it was not already expanded).
+  inline size_t NumInputEpsilons(StateId s) const {
+    const ExpandedState *state = GetExpandedState(s);
+    return state->num_input_epsilons;
+  }
+
+  /// Returns the arcs leaving state s: the input-epsilon arcs are in
+  /// [*begin, *mid) and the emitting arcs are in [*mid, *end).
+  inline void GetArcs(StateId s, const Arc **begin, const Arc **mid,
+                      const Arc **end) const {
+    const ExpandedState *state = GetExpandedState(s);
+    *begin = state->arcs.data();
+    *mid = *begin + state->num_input_epsilons;
+    *end = *begin + state->arcs.size();
+  }
+
+  /// Returns the number of states created so far (not all of which will have
+  /// been expanded).
+  StateId NumStates() const { return states_.size(); }
+
+  inline std::string Type() const { return "lazy-training-graph"; }
+
+ private:
+  struct ExpandedState {
+    // The arcs leaving the state, with the input-epsilon arcs first.
+    std::vector<Arc> arcs;
+    size_t num_input_epsilons;
+  };
+
+  // A state is a state of clg_ (if arc_index == -1), or a state of the HMM of
+  // the arc with index "arc_index" among the arcs leaving clg_state.
+  struct StateInfo {
+    StateId clg_state;
+    int32 arc_index;
+    StateId hmm_state;
+  };
+
+  // Returns the state-id for this StateInfo, creating it if needed.
+  StateId FindOrAddState(StateId clg_state, int32 arc_index,
+                         StateId hmm_state) const;
+
+  // Returns the HMM for the phone in context "ilabel", or NULL if it is
+  // epsilon or a disambiguation symbol.
+  const VectorFst<StdArc> *GetHmm(Label ilabel) const;
+
+  // Returns the expanded state s, expanding it if needed.
+  inline const ExpandedState *GetExpandedState(StateId s) const {
+    const ExpandedState *state = expanded_states_[s];
+    return (state != NULL ? state : ExpandState(s));
+  }
+
+  const ExpandedState *ExpandState(StateId s) const;
+
+  const VectorFst<StdArc> &clg_;
+  const std::vector<std::vector<int32> > &ilabel_info_;
+  LazyTrainingGraphHmms *hmms_;
+  StateId start_;
+
+  // The remaining members are changed as states are created and expanded,
+  // which is done from const functions, as the decoder only has a const
+  // reference to the FST.
+  mutable std::vector<StateInfo> states_;
+  // Maps (clg_state, arc_index + 1) and hmm_state to the state-id.
+  typedef std::pair<std::pair<StateId, int32>, StateId> StateKey;
+  struct StateKeyHasher {
+    size_t operator()(const StateKey &key) const noexcept {
+      return key.first.first + 7853 * key.first.second +
+          7867 * key.second;
+    }
+  };
+  mutable std::unordered_map<StateKey, StateId, StateKeyHasher> state_map_;
+  // The expansion of each state, or NULL if it has not been expanded yet.
+  mutable std::vector<ExpandedState*> expanded_states_;
+  // The HMM for each input label of clg_, once it has been looked up.
+  mutable std::vector<const VectorFst<StdArc>*> ilabel_hmms_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(LazyTrainingGraph);
+};
+
+
+/**
+   The overridden template for class ArcIterator for LazyTrainingGraph.  It
+   iterates over all the arcs of a state (input-epsilon arcs first).  The
+   decoders mostly use EmittingArcIterator and EpsilonArcIterator instead.
+ */
+template <>
+class ArcIterator<LazyTrainingGraph> {
+ public:
+  typedef LazyTrainingGraph::Arc Arc;
+  typedef LazyTrainingGraph::StateId StateId;
+
+  inline ArcIterator(const LazyTrainingGraph &fst, StateId s) {
+    const Arc *mid;
+    fst.GetArcs(s, &arc_, &mid, &end_);
+  }
+  inline bool Done() const { return arc_ == end_; }
+  inline void Next() { ++arc_; }
+  inline const Arc &Value() const { return *arc_; }
+ private:
+  const Arc *arc_;
+  const Arc *end_;
+};
+
+template <>
+class EmittingArcIterator<LazyTrainingGraph> {
+ public:
+  typedef LazyTrainingGraph::Arc Arc;
+  typedef LazyTrainingGraph::StateId StateId;
+
+  inline EmittingArcIterator(const LazyTrainingGraph &fst, StateId s) {
+    const Arc *begin;
+    fst.GetArcs(s, &begin, &arc_, &end_);
+  }
+  inline bool Done() const { return arc_ == end_; }
+  inline void Next() { ++arc_; }
+  inline const Arc &Value() const { return *arc_; }
+ private:
+  const Arc *arc_;
+  const Arc *end_;
+};
+
+template <>
+class EpsilonArcIterator<LazyTrainingGraph> {
+ public:
+  typedef LazyTrainingGraph::Arc Arc;
+  typedef LazyTrainingGraph::StateId StateId;
+
+  inline EpsilonArcIterator(const LazyTrainingGraph &fst, StateId s) {
+    const Arc *end;
+    fst.GetArcs(s, &arc_, &end_, &end);
+  }
+  inline bool Done() const { return arc_ == end_; }
+  inline void Next() { ++arc_; }
+  inline const Arc &Value() const { return *arc_; }
+ private:
+  const Arc *arc_;
+  const Arc *end_;
+};
+
+
+}  // namespace fst
+
+#endif  // KALDI_DECODER_LAZY_TRAINING_GRAPH_H_
@@ -0,0 +1,98 @@
+// decoder/lm-compose-fst.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "decoder/lm-compose-fst.h"
+
+namespace fst {
+
+LmComposeFst::LmComposeFst(const Fst<StdArc> &hcl,
+                           DeterministicOnDemandFst<StdArc> *lm):
+    hcl_(hcl), lm_(lm) {
+  if (hcl_.Start() == kNoStateId)
+    KALDI_ERR << "The HCL graph is empty.";
+  FindOrAddState(hcl_.Start(), lm_->Start());
+}
+
+LmComposeFst::~LmComposeFst() {
+  for (size_t i = 0; i < expanded_states_.size(); i++)
+    delete expanded_states_[i];
+}
+
+void LmComposeFst::Clear() {
+  StatePair start_pair = state_pairs_[0];
+  for (size_t i = 0; i < expanded_states_.size(); i++)
+    delete expanded_states_[i];
+  expanded_states_.clear();
+  state_pairs_.clear();
+  pair_to_state_.clear();
+  FindOrAddState(start_pair.first, start_pair.second);
+}
+
+LmComposeFst::Weight LmComposeFst::Final(StateId s) const {
+  const StatePair &pair = state_pairs_[s];
+  Weight hcl_final = hcl_.Final(pair.first);
+  if (hcl_final == Weight::Zero())
+    return hcl_final;
+  return Times(hcl_final, lm_->Final(pair.second));
+}
+
+LmComposeFst::StateId LmComposeFst::FindOrAddState(StateId hcl_state,
+                                                   StateId lm_state) const {
+  StatePair pair(hcl_state, lm_state);
+  StateId new_state = state_pairs_.size();
+  std::pair<std::unordered_map<StatePair, StateId,
+                               kaldi::PairHasher<StateId> >::iterator,
+            bool> ret = pair_to_state_.insert(std::make_pair(pair, new_state));
+  if (ret.second) {
+    state_pairs_.push_back(pair);
+    expanded_states_.push_back(NULL);
+  }
+  return ret.first->second;
+}
+
+const LmComposeFst::ExpandedState *LmComposeFst::ExpandState(
+    StateId s) const {
+  ExpandedState *state = new ExpandedState();
+  StatePair pair = state_pairs_[s];
+  std::vector<Arc> emitting_arcs;
+  for (ArcIterator<Fst<StdArc> > aiter(hcl_, pair.first); !aiter.Done();
+       aiter.Next()) {
+    Arc arc = aiter.Value();
+    if (arc.olabel == 0) {
+      arc.nextstate = FindOrAddState(arc.nextstate, pair.second);
+    } else {
+      Arc lm_arc;
+      if (!lm_->GetArc(pair.second, arc.olabel, &lm_arc))
+        continue;  // The language model does not allow this word here.
+      arc.weight = Times(arc.weight, lm_arc.weight);
+      arc.nextstate = FindOrAddState(arc.nextstate, lm_arc.nextstate);
+    }
+    if (arc.ilabel == 0)
+      state->arcs.push_back(arc);
+    else
+      emitting_arcs.push_back(arc);
+  }
+  state->num_input_epsilons = state->arcs.size();
+  state->arcs.insert(state->arcs.end(), emitting_arcs.begin(),
+                     emitting_arcs.end());
+  expanded_states_[s] = state;
+  return state;
+}
+
+}  // namespace fst
@@ -0,0 +1,219 @@
+// decoder/lm-compose-fst.h
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_DECODER_LM_COMPOSE_FST_H_
+#define KALDI_DECODER_LM_COMPOSE_FST_H_
+
+/**
+   This header implements LmComposeFst, an FST type that composes a decoding
+   graph without the language model (an "HCL" graph, whose output labels are
+   words) with a language model given as a DeterministicOnDemandFst (for
+   instance a ConstArpaLmDeterministicFst or a BackoffDeterministicOnDemandFst
+   wrapping G.fst), on demand, as the decoder visits its states.  This avoids
+   building HCLG, which for large language models takes a great deal of time
+   and memory.
+
+   Like GrammarFst and FlatFst, it does not inherit from fst::Fst; it has just
+   enough of the same interface for the decoders to be templated on it.
+ */
+
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "decoder/flat-fst.h"
+#include "fst/fstlib.h"
+#include "fstext/deterministic-fst.h"
+#include "util/stl-utils.h"
+
+namespace fst {
+
+class LmComposeFst;
+
+// Declare that we'll be overriding class ArcIterator for class LmComposeFst.
+template<> class ArcIterator<LmComposeFst>;
+
+/**
+   LmComposeFst is the composition of an HCL graph with a language model, whose
+   states are expanded the first time they are visited.  A state of the
+   composition is a pair (state of HCL, state of the LM); an arc of HCL with
+   epsilon output label leaves the LM state unchanged, and an arc with a word
+   as its output label takes the LM arc for that word, adding its weight.
+   Because the lexicon puts each word label on the first arc of its
+   pronunciation, the LM weight is applied as soon as a word is entered, so no
+   weight-pushing or lookahead is needed for the decoder's beam to work well.
+
+   The HCL graph must have no disambiguation symbols on its output side, and
+   the language model must be over the same word symbols, without
+   disambiguation symbols either (e.g. for G.fst, replace #0 with epsilon
+   before wrapping it in a BackoffDeterministicOnDemandFst).
+
+   The expanded states are cached, and the cache can grow without limit, so
+   long-running programs should call Clear() between utterances now and then.
+
+   THREAD SAFETY: you can't use this object from multiple threads, as the
+   language model is not thread-safe either.
+*/
+class LmComposeFst {
+ public:
+  typedef StdArc Arc;
+  typedef Arc::StateId StateId;
+  typedef Arc::Label Label;
+  typedef Arc::Weight Weight;
+
+  /// Constructor.  Neither 'hcl' nor 'lm' is owned here; both must outlive
+  /// this object.
+  LmComposeFst(const Fst<StdArc> &hcl, DeterministicOnDemandFst<StdArc> *lm);
+
+  ~LmComposeFst();
+
+  StateId Start() const { return 0; }
+
+  Weight Final(StateId s) const;
+
+  /// Returns the number of input-epsilon arcs leaving state s (which expands
+  /// the state if it was not already expanded).
+  inline size_t NumInputEpsilons(StateId s) const {
+    const ExpandedState *state = GetExpandedState(s);
+    return state->num_input_epsilons;
+  }
+
+  /// Returns the arcs leaving state s: the input-epsilon arcs are in
+  /// [*begin, *mid) and the emitting arcs are in [*mid, *end).  The pointers
+  /// stay valid until Clear() is called.
+  inline void GetArcs(StateId s, const Arc **begin, const Arc **mid,
+                      const Arc **end) const {
+    const ExpandedState *state = GetExpandedState(s);
+    *begin = state->arcs.data();
+    *mid = *begin + state->num_input_epsilons;
+    *end = *begin + state->arcs.size();
+  }
+
+  /// Returns the number of states created so far (not all of which will have
+  /// been expanded).
+  StateId NumStates() const { return state_pairs_.size(); }
+
+  /// Forgets all states but the start state, to free memory.  It must not be
+  /// called while decoding an utterance, as the state-ids change.
+  void Clear();
+
+  inline std::string Type() const { return "lm-compose"; }
+
+ private:
+  struct ExpandedState {
+    // The arcs leaving the state, with the input-epsilon arcs first.
+    std::vector<Arc> arcs;
+    size_t num_input_epsilons;
+  };
+
+  // Returns the state-id of the pair (hcl_state, lm_state), creating it if
+  // needed.
+  StateId FindOrAddState(StateId hcl_state, StateId lm_state) const;
+
+  // Returns the expanded state s, expanding it if needed.
+  inline const ExpandedState *GetExpandedState(StateId s) const {
+    const ExpandedState *state = expanded_states_[s];
+    return (state != NULL ? state : ExpandState(s));
+  }
+
+  const ExpandedState *ExpandState(StateId s) const;
+
+  const Fst<StdArc> &hcl_;
+  DeterministicOnDemandFst<StdArc> *lm_;
+
+  // The remaining members are changed as states are created and expanded,
+  // which is done from const functions, as the decoder only has a const
+  // reference to the FST.
+  typedef std::pair<StateId, StateId> StatePair;
+  // The (HCL state, LM state) pair for each state.
+  mutable std::vector<StatePair> state_pairs_;
+  mutable std::unordered_map<StatePair, StateId,
+                             kaldi::PairHasher<StateId> > pair_to_state_;
+  // The expansion of each state, or NULL if it has not been expanded yet.
+  // They are pointers so that the arcs don't move as more states are added.
+  mutable std::vector<ExpandedState*> expanded_states_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(LmComposeFst);
+};
+
+
+/**
+   The overridden template for class ArcIterator for LmComposeFst.  It iterates
+   over all the arcs of a state (input-epsilon arcs first).  The decoders
+   mostly use EmittingArcIterator and EpsilonArcIterator instead.
+ */
+template <>
+class ArcIterator<LmComposeFst> {
+ public:
+  typedef LmComposeFst::Arc Arc;
+  typedef LmComposeFst::StateId StateId;
+
+  inline ArcIterator(const LmComposeFst &fst, StateId s) {
+    const Arc *mid;
+    fst.GetArcs(s, &arc_, &mid, &end_);
+  }
+  inline bool Done() const { return arc_ == end_; }
+  inline void Next() { ++arc_; }
+  inline const Arc &Value() const { return *arc_; }
+ private:
+  const Arc *arc_;
+  const Arc *end_;
+};
+
+template <>
+class EmittingArcIterator<LmComposeFst> {
+ public:
+  typedef LmComposeFst::Arc Arc;
+  typedef LmComposeFst::StateId StateId;
+
+  inline EmittingArcIterator(const LmComposeFst &fst, StateId s) {
+    const Arc *begin;
+    fst.GetArcs(s, &begin, &arc_, &end_);
+  }
+  inline bool Done() const { return arc_ == end_; }
+  inline void Next() { ++arc_; }
+  inline const Arc &Value() const { return *arc_; }
+ private:
+  const Arc *arc_;
+  const Arc *end_;
+};
+
+template <>
+class EpsilonArcIterator<LmComposeFst> {
+ public:
+  typedef LmComposeFst::Arc Arc;
+  typedef LmComposeFst::StateId StateId;
+
+  inline EpsilonArcIterator(const LmComposeFst &fst, StateId s) {
+    const Arc *end;
+    fst.GetArcs(s, &arc_, &end_, &end);
+  }
+  inline bool Done() const { return arc_ == end_; }
+  inline void Next() { ++arc_; }
+  inline const Arc &Value() const { return *arc_; }
+ private:
+  const Arc *arc_;
+  const Arc *end_;
+};
+
+
+}  // namespace fst
+
+#endif  // KALDI_DECODER_LM_COMPOSE_FST_H_
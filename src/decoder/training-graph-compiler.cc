@@ -17,8 +17,16 @@
 // MERCHANTABLITY OR NON-INFRINGEMENT.
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
+#include <unistd.h>
+#include <atomic>
+#include <cstdio>
+#include <sstream>
+
 #include "decoder/training-graph-compiler.h"
 #include "hmm/hmm-utils.h" // for GetHTransducer
+#include "util/kaldi-io.h"
+#include "util/kaldi-thread.h"
+#include "util/stl-utils.h"
 
 namespace kaldi {
 
@@ -70,6 +78,28 @@ bool TrainingGraphCompiler::CompileGraphFromText(
   return CompileGraph(word_fst, out_fst);
 }
 
+bool TrainingGraphCompiler::CompileContextGraph(
+    const std::vector<int32> &transcript,
+    fst::VectorFst<fst::StdArc> *clg,
+    std::vector<std::vector<int32> > *ilabel_info) {
+  using namespace fst;
+  KALDI_ASSERT(clg != NULL && ilabel_info != NULL);
+  VectorFst<StdArc> word_fst;
+  MakeLinearAcceptor(transcript, &word_fst);
+
+  VectorFst<StdArc> phone2word_fst;
+  TableCompose(*lex_fst_, word_fst, &phone2word_fst, &lex_cache_);
+
+  InverseContextFst inv_cfst(subsequential_symbol_,
+                             trans_model_.GetPhones(),
+                             disambig_syms_,
+                             ctx_dep_.ContextWidth(),
+                             ctx_dep_.CentralPosition());
+  ComposeDeterministicOnDemandInverse(phone2word_fst, &inv_cfst, clg);
+  *ilabel_info = inv_cfst.IlabelInfo();
+  return clg->Start() != kNoStateId;
+}
+
 bool TrainingGraphCompiler::CompileGraph(const fst::VectorFst<fst::StdArc> &word_fst,
                                          fst::VectorFst<fst::StdArc> *out_fst) {
   using namespace fst;
@@ -144,7 +174,8 @@ bool TrainingGraphCompiler::CompileGraph(const fst::VectorFst<fst::StdArc> &word
 
 bool TrainingGraphCompiler::CompileGraphsFromText(
     const std::vector<std::vector<int32> > &transcripts,
-    std::vector<fst::VectorFst<fst::StdArc>*> *out_fsts) {
+    std::vector<fst::VectorFst<fst::StdArc>*> *out_fsts,
+    int32 num_threads) {
   using namespace fst;
   std::vector<const VectorFst<StdArc>* > word_fsts(transcripts.size());
   for (size_t i = 0; i < transcripts.size(); i++) {
@@ -152,15 +183,79 @@ bool TrainingGraphCompiler::CompileGraphsFromText(
     MakeLinearAcceptor(transcripts[i], word_fst);
     word_fsts[i] = word_fst;
   }
-  bool ans = CompileGraphs(word_fsts, out_fsts);
+  bool ans = CompileGraphs(word_fsts, out_fsts, num_threads);
   for (size_t i = 0; i < transcripts.size(); i++)
     delete word_fsts[i];
   return ans;
 }
 
+void TrainingGraphCompiler::CompileGraphWithH(
+    const fst::VectorFst<fst::StdArc> &H,
+    const std::vector<int32> &disambig_syms_h,
+    fst::VectorFst<fst::StdArc> *fst) const {
+  using namespace fst;
+  VectorFst<StdArc> trans2word_fst;
+  TableCompose(H, *fst, &trans2word_fst);
+
+  DeterminizeStarInLog(&trans2word_fst);
+
+  if (!disambig_syms_h.empty()) {
+    RemoveSomeInputSymbols(disambig_syms_h, &trans2word_fst);
+    if (opts_.rm_eps)
+      RemoveEpsLocal(&trans2word_fst);
+  }
+
+  // Encoded minimization.
+  MinimizeEncoded(&trans2word_fst);
+
+  std::vector<int32> disambig;
+  bool check_no_self_loops = true;
+  AddSelfLoops(trans_model_,
+               disambig,
+               opts_.self_loop_scale,
+               opts_.reorder,
+               check_no_self_loops,
+               &trans2word_fst);
+
+  KALDI_ASSERT(trans2word_fst.Start() != kNoStateId);
+
+  *fst = trans2word_fst;
+}
+
+// Does the last stages of compilation of a subset of the graphs (relates to
+// multi-threading).  The graphs take different amounts of time, so the
+// threads take the next graph from a shared counter.
+class CompileGraphWithHClass: public MultiThreadable {
+ public:
+  CompileGraphWithHClass(const TrainingGraphCompiler &compiler,
+                         const fst::VectorFst<fst::StdArc> &H,
+                         const std::vector<int32> &disambig_syms_h,
+                         std::vector<fst::VectorFst<fst::StdArc>*> *fsts,
+                         std::atomic<size_t> *next_fst):
+      compiler_(compiler), H_(H), disambig_syms_h_(disambig_syms_h),
+      fsts_(fsts), next_fst_(next_fst) { }
+  void operator () () {
+    // Each thread uses its own copy of H (not one sharing its
+    // implementation), as OpenFst may update the cached properties of an FST
+    // that it is only reading.
+    fst::VectorFst<fst::StdArc> H(
+        static_cast<const fst::Fst<fst::StdArc>&>(H_));
+    size_t i;
+    while ((i = (*next_fst_)++) < fsts_->size())
+      compiler_.CompileGraphWithH(H, disambig_syms_h_, (*fsts_)[i]);
+  }
+ private:
+  const TrainingGraphCompiler &compiler_;
+  const fst::VectorFst<fst::StdArc> &H_;
+  const std::vector<int32> &disambig_syms_h_;
+  std::vector<fst::VectorFst<fst::StdArc>*> *fsts_;
+  std::atomic<size_t> *next_fst_;
+};
+
 bool TrainingGraphCompiler::CompileGraphs(
     const std::vector<const fst::VectorFst<fst::StdArc>* > &word_fsts,
-    std::vector<fst::VectorFst<fst::StdArc>* > *out_fsts) {
+    std::vector<fst::VectorFst<fst::StdArc>* > *out_fsts,
+    int32 num_threads) {
 
   using namespace fst;
   KALDI_ASSERT(lex_fst_ !=NULL);
@@ -177,6 +272,8 @@ bool TrainingGraphCompiler::CompileGraphs(
                              ctx_dep_.ContextWidth(),
                              ctx_dep_.CentralPosition());
 
+  // This part is done in this thread, as lex_cache_ and inv_cfst are
+  // changed as they are used.
   for (size_t i = 0; i < word_fsts.size(); i++) {
     VectorFst<StdArc> phone2word_fst;
     // TableCompose more efficient than compose.
@@ -204,38 +301,106 @@ bool TrainingGraphCompiler::CompileGraphs(
                                         h_cfg,
                                         &disambig_syms_h);
 
-  for (size_t i = 0; i < out_fsts->size(); i++) {
-    VectorFst<StdArc> &ctx2word_fst = *((*out_fsts)[i]);
-    VectorFst<StdArc> trans2word_fst;
-    TableCompose(*H, ctx2word_fst, &trans2word_fst);
+  {
+    std::atomic<size_t> next_fst(0);
+    CompileGraphWithHClass c(*this, *H, disambig_syms_h, out_fsts, &next_fst);
+    // With num_threads == 0, MultiThreader runs it in this thread.
+    MultiThreader<CompileGraphWithHClass> m(
+        num_threads > 1 && out_fsts->size() > 1 ?
+        std::min<int32>(num_threads, out_fsts->size()) : 0, c);
+  }
 
-    DeterminizeStarInLog(&trans2word_fst);
+  delete H;
+  return true;
+}
 
-    if (!disambig_syms_h.empty()) {
-      RemoveSomeInputSymbols(disambig_syms_h, &trans2word_fst);
-      if (opts_.rm_eps)
-        RemoveEpsLocal(&trans2word_fst);
+std::string TrainingGraphCompiler::ModelId() const {
+  std::ostringstream os;
+  bool binary = true;
+  ctx_dep_.Write(os, binary);
+  if (opts_.transition_scale == 0.0 && opts_.self_loop_scale == 0.0) {
+    // The transition probabilities are not used, so only the structure of the
+    // model matters.
+    trans_model_.GetTopo().Write(os, binary);
+    for (int32 s = 1; s <= trans_model_.NumTransitionStates(); s++) {
+      WriteBasicType(os, binary, trans_model_.TransitionStateToPhone(s));
+      WriteBasicType(os, binary, trans_model_.TransitionStateToHmmState(s));
+      WriteBasicType(os, binary, trans_model_.TransitionStateToForwardPdf(s));
+      WriteBasicType(os, binary, trans_model_.TransitionStateToSelfLoopPdf(s));
     }
+  } else {
+    trans_model_.Write(os, binary);
+  }
+  fst::WriteFstKaldi(os, binary, *lex_fst_);
+  WriteIntegerVector(os, binary, disambig_syms_);
+  WriteBasicType(os, binary, opts_.transition_scale);
+  WriteBasicType(os, binary, opts_.self_loop_scale);
+  WriteBasicType(os, binary, opts_.rm_eps);
+  WriteBasicType(os, binary, opts_.reorder);
+  StringHasher hasher;
+  std::ostringstream id;
+  id << std::hex << hasher(os.str());
+  return id.str();
+}
 
-    // Encoded minimization.
-    MinimizeEncoded(&trans2word_fst);
 
-    std::vector<int32> disambig;
-    bool check_no_self_loops = true;
-    AddSelfLoops(trans_model_,
-                 disambig,
-                 opts_.self_loop_scale,
-                 opts_.reorder,
-                 check_no_self_loops,
-                 &trans2word_fst);
+std::string TrainingGraphCache::Filename(
+    const std::vector<int32> &transcript) const {
+  VectorHasher<int32> hasher;
+  std::ostringstream filename;
+  filename << dir_ << '/' << model_id_ << '-' << std::hex
+           << hasher(transcript) << ".fst";
+  return filename.str();
+}
 
-    KALDI_ASSERT(trans2word_fst.Start() != kNoStateId);
+bool TrainingGraphCache::Lookup(const std::vector<int32> &transcript,
+                                fst::VectorFst<fst::StdArc> *fst) {
+  num_lookups_++;
+  std::string filename = Filename(transcript);
+  if (access(filename.c_str(), R_OK) != 0)
+    return false;  // Not in the cache.
+  try {
+    bool binary;
+    Input ki(filename, &binary);
+    std::vector<int32> cached_transcript;
+    ReadIntegerVector(ki.Stream(), binary, &cached_transcript);
+    if (cached_transcript != transcript)
+      return false;  // A hash collision.
+    fst::ReadFstKaldi(ki.Stream(), binary, fst);
+  } catch (const std::exception &e) {
+    KALDI_WARN << "Error reading cached graph from " << filename
+               << ", will compile it again.";
+    return false;
+  }
+  num_hits_++;
+  return true;
+}
 
-    *((*out_fsts)[i]) = trans2word_fst;
+void TrainingGraphCache::Insert(const std::vector<int32> &transcript,
+                                const fst::VectorFst<fst::StdArc> &fst) {
+  std::string filename = Filename(transcript);
+  // The temporary file is in the same directory, so rename() can't fail
+  // because of crossing file systems.
+  std::ostringstream tmp_filename;
+  tmp_filename << filename << ".tmp." << getpid();
+  bool binary = true;
+  Output ko;
+  if (!ko.Open(tmp_filename.str(), binary, true)) {
+    KALDI_WARN << "Could not write cached graph to " << tmp_filename.str();
+    return;
+  }
+  WriteIntegerVector(ko.Stream(), binary, transcript);
+  fst::WriteFstKaldi(ko.Stream(), binary, fst);
+  if (!ko.Close() ||
+      std::rename(tmp_filename.str().c_str(), filename.c_str()) != 0) {
+    KALDI_WARN << "Could not write cached graph to " << filename;
+    unlink(tmp_filename.str().c_str());
   }
+}
 
-  delete H;
-  return true;
+void TrainingGraphCache::PrintStats() const {
+  KALDI_LOG << "Training graph cache: " << num_hits_ << " hits out of "
+            << num_lookups_ << " lookups.";
 }
 
 
@@ -76,10 +76,14 @@ class TrainingGraphCompiler {
                     fst::VectorFst<fst::StdArc> *out_fst);
 
   // CompileGraphs allows you to compile a number of graphs at the same
-  // time.  This consumes more memory but is faster.
+  // time.  This consumes more memory but is faster.  The later stages of
+  // compilation (composition with H, determinization, minimization and
+  // adding self-loops), which are most of the work, are done for
+  // "num_threads" graphs at a time.
   bool CompileGraphs(
       const std::vector<const fst::VectorFst<fst::StdArc> *> &word_fsts,
-      std::vector<fst::VectorFst<fst::StdArc> *> *out_fsts);
+      std::vector<fst::VectorFst<fst::StdArc> *> *out_fsts,
+      int32 num_threads = 1);
 
   // This version creates an FST from the text and calls CompileGraph.
   bool CompileGraphFromText(const std::vector<int32> &transcript,
@@ -88,11 +92,36 @@ class TrainingGraphCompiler {
   // This function creates FSTs from the text and calls CompileGraphs.
   bool CompileGraphsFromText(
       const std::vector<std::vector<int32> >  &word_grammar,
-      std::vector<fst::VectorFst<fst::StdArc> *> *out_fsts);
-
+      std::vector<fst::VectorFst<fst::StdArc> *> *out_fsts,
+      int32 num_threads = 1);
+
+  // Does only the first stages of CompileGraphFromText(): outputs C o L o G,
+  // whose input labels index "ilabel_info" (see InverseContextFst), for use
+  // in a LazyTrainingGraph.  Returns false if the result is empty.
+  bool CompileContextGraph(const std::vector<int32> &transcript,
+                           fst::VectorFst<fst::StdArc> *clg,
+                           std::vector<std::vector<int32> > *ilabel_info);
+
+  // Returns a string (a hash, in hex) that identifies everything other than
+  // the transcript that the compiled graphs depend on: the tree, the
+  // topology and transition-states of the model (and its transition
+  // probabilities, unless both scales are zero), the lexicon, the
+  // disambiguation symbols and the options.  It is used as part of the key of
+  // a TrainingGraphCache; it stays the same across training iterations that
+  // only change the GMMs.
+  std::string ModelId() const;
 
   ~TrainingGraphCompiler() { delete lex_fst_; }
  private:
+  friend class CompileGraphWithHClass;
+
+  // Does the stages of compilation that follow the composition with the
+  // context FST (see CompileGraphs()); "fst" is C o L o G on input and the
+  // training graph on output.
+  void CompileGraphWithH(const fst::VectorFst<fst::StdArc> &H,
+                         const std::vector<int32> &disambig_syms_h,
+                         fst::VectorFst<fst::StdArc> *fst) const;
+
   const TransitionModel &trans_model_;
   const ContextDependency &ctx_dep_;
   fst::VectorFst<fst::StdArc> *lex_fst_; // lexicon FST (an input; we take
@@ -107,6 +136,42 @@ class TrainingGraphCompiler {
 };
 
 
+/// TrainingGraphCache stores compiled training graphs on disk, so that they
+/// can be reused by later runs of compile-train-graphs with the same tree,
+/// model topology and lexicon (e.g. when re-aligning after the GMMs have been
+/// re-estimated).  Each graph is in its own file in the cache directory, whose
+/// name is made from the model-id (see TrainingGraphCompiler::ModelId()) and a
+/// hash of the transcript; the file also contains the transcript, so a hash
+/// collision just gives a cache miss.  Several programs may use the same
+/// directory at once, as the files are written under temporary names and then
+/// renamed.
+class TrainingGraphCache {
+ public:
+  /// The directory "dir" must exist.
+  TrainingGraphCache(const std::string &dir, const std::string &model_id):
+      dir_(dir), model_id_(model_id), num_lookups_(0), num_hits_(0) { }
+
+  /// Returns true and outputs the graph if there is one in the cache for this
+  /// transcript.
+  bool Lookup(const std::vector<int32> &transcript,
+              fst::VectorFst<fst::StdArc> *fst);
+
+  /// Adds the graph for this transcript to the cache.  Failure to write it is
+  /// not an error (it just gives a warning).
+  void Insert(const std::vector<int32> &transcript,
+              const fst::VectorFst<fst::StdArc> &fst);
+
+  void PrintStats() const;
+ private:
+  std::string Filename(const std::vector<int32> &transcript) const;
+
+  std::string dir_;
+  std::string model_id_;
+  int64 num_lookups_;
+  int64 num_hits_;
+};
+
+
 
 }  // end namespace kaldi.
 
@@ -61,6 +61,7 @@ void OfflineFeatureTpl<F>::Compute(
     const VectorBase<BaseFloat> &wave,
     BaseFloat vtln_warp,
     Matrix<BaseFloat> *output) {
+  KALDI_TRACE_SCOPE("OfflineFeatureTpl::Compute");
   KALDI_ASSERT(output != NULL);
   int32 rows_out = NumFrames(wave.Dim(), computer_.GetFrameOptions()),
       cols_out = computer_.Dim();
@@ -69,16 +70,29 @@ void OfflineFeatureTpl<F>::Compute(
     return;
   }
   output->Resize(rows_out, cols_out);
-  Vector<BaseFloat> window;  // windowed waveform.
   bool use_raw_log_energy = computer_.NeedRawLogEnergy();
-  for (int32 r = 0; r < rows_out; r++) {  // r is frame index.
-    BaseFloat raw_log_energy = 0.0;
-    ExtractWindow(0, wave, r, computer_.GetFrameOptions(),
-                  feature_window_function_, &window,
-                  (use_raw_log_energy ? &raw_log_energy : NULL));
-
-    SubVector<BaseFloat> output_row(*output, r);
-    computer_.Compute(raw_log_energy, vtln_warp, &window, &output_row);
+  // We process the frames in batches: the windows of a batch are extracted
+  // together, and the computer does the FFTs and the matrix operations for
+  // all of them at once.  The batches are limited in size so that the
+  // windowed frames don't take up too much memory for long utterances.
+  const int32 max_batch_size = 128;
+  int32 batch_size = std::min(rows_out, max_batch_size);
+  Matrix<BaseFloat> windows(batch_size,
+                            computer_.GetFrameOptions().PaddedWindowSize(),
+                            kUndefined);
+  Vector<BaseFloat> raw_log_energies(batch_size);
+  for (int32 r0 = 0; r0 < rows_out; r0 += batch_size) {
+    int32 this_batch_size = std::min(batch_size, rows_out - r0);
+    SubMatrix<BaseFloat> these_windows(windows, 0, this_batch_size,
+                                       0, windows.NumCols()),
+        these_outputs(*output, r0, this_batch_size, 0, cols_out);
+    SubVector<BaseFloat> these_log_energies(raw_log_energies, 0,
+                                            this_batch_size);
+    ExtractWindows(0, wave, r0, computer_.GetFrameOptions(),
+                   feature_window_function_, &these_windows,
+                   (use_raw_log_energy ? &these_log_energies : NULL));
+    computer_.Compute(these_log_energies, vtln_warp,
+                      &these_windows, &these_outputs);
   }
 }
 
@@ -94,6 +94,19 @@ class ExampleFeatureComputer {
                VectorBase<BaseFloat> *signal_frame,
                VectorBase<BaseFloat> *feature);
 
+  /**
+     Computes the features of several frames at once; OfflineFeatureTpl uses
+     this.  It must be equivalent to calling the other Compute() on each row
+     of 'signal_frames', with the corresponding element of
+     'signal_raw_log_energy', and writing the features to the corresponding
+     row of 'features'; but it can be faster, e.g. by doing the FFTs of all the
+     frames together.
+  */
+  void Compute(const VectorBase<BaseFloat> &signal_raw_log_energy,
+               BaseFloat vtln_warp,
+               MatrixBase<BaseFloat> *signal_frames,
+               MatrixBase<BaseFloat> *features);
+
  private:
   // disallow assignment.
   ExampleFeatureComputer &operator = (const ExampleFeatureComputer &in);
@@ -74,8 +74,6 @@ void FbankComputer::Compute(BaseFloat signal_raw_log_energy,
                             VectorBase<BaseFloat> *signal_frame,
                             VectorBase<BaseFloat> *feature) {
 
-  const MelBanks &mel_banks = *(GetMelBanks(vtln_warp));
-
   KALDI_ASSERT(signal_frame->Dim() == opts_.frame_opts.PaddedWindowSize() &&
                feature->Dim() == this->Dim());
 
@@ -90,6 +88,76 @@ void FbankComputer::Compute(BaseFloat signal_raw_log_energy,
   else  // An alternative algorithm that works for non-powers-of-two.
     RealFft(signal_frame, true);
 
+  ComputeFromFft(signal_raw_log_energy, vtln_warp, signal_frame, feature);
+}
+
+void FbankComputer::Compute(const VectorBase<BaseFloat> &signal_raw_log_energy,
+                            BaseFloat vtln_warp,
+                            MatrixBase<BaseFloat> *signal_frames,
+                            MatrixBase<BaseFloat> *features) {
+  MatrixIndexT num_frames = signal_frames->NumRows();
+  KALDI_ASSERT(features->NumRows() == num_frames &&
+               signal_raw_log_energy.Dim() == num_frames);
+  if (srfft_ == NULL) {  // RealFft() has no batched version.
+    for (MatrixIndexT r = 0; r < num_frames; r++) {
+      SubVector<BaseFloat> signal_frame(*signal_frames, r),
+          feature(*features, r);
+      Compute(signal_raw_log_energy(r), vtln_warp, &signal_frame, &feature);
+    }
+    return;
+  }
+  KALDI_ASSERT(signal_frames->NumCols() ==
+               opts_.frame_opts.PaddedWindowSize() &&
+               features->NumCols() == this->Dim());
+
+  Vector<BaseFloat> log_energy(signal_raw_log_energy);
+  if (opts_.use_energy && !opts_.raw_energy)
+    for (MatrixIndexT r = 0; r < num_frames; r++)
+      log_energy(r) = Log(std::max<BaseFloat>(
+          VecVec(signal_frames->Row(r), signal_frames->Row(r)),
+          std::numeric_limits<float>::epsilon()));
+
+  srfft_->Compute(signal_frames, true);
+
+  // The rest is as ComputeFromFft(), but with the Mel banks done as a matrix
+  // multiplication over all the frames.
+  const MelBanks &mel_banks = *(GetMelBanks(vtln_warp));
+  for (MatrixIndexT r = 0; r < num_frames; r++) {
+    SubVector<BaseFloat> signal_frame(*signal_frames, r);
+    ComputePowerSpectrum(&signal_frame);
+  }
+  SubMatrix<BaseFloat> power_spectra(*signal_frames, 0, num_frames, 0,
+                                     signal_frames->NumCols() / 2 + 1);
+
+  if (!opts_.use_power)
+    power_spectra.ApplyPow(0.5);
+
+  int32 mel_offset = ((opts_.use_energy && !opts_.htk_compat) ? 1 : 0);
+  SubMatrix<BaseFloat> mel_energies(*features, 0, num_frames, mel_offset,
+                                    opts_.mel_opts.num_bins);
+  mel_banks.Compute(power_spectra, &mel_energies);
+  if (opts_.use_log_fbank) {
+    mel_energies.ApplyFloor(std::numeric_limits<float>::epsilon());
+    mel_energies.ApplyLog();
+  }
+
+  if (opts_.use_energy) {
+    int32 energy_index = opts_.htk_compat ? opts_.mel_opts.num_bins : 0;
+    for (MatrixIndexT r = 0; r < num_frames; r++) {
+      BaseFloat signal_log_energy = log_energy(r);
+      if (opts_.energy_floor > 0.0 && signal_log_energy < log_energy_floor_)
+        signal_log_energy = log_energy_floor_;
+      (*features)(r, energy_index) = signal_log_energy;
+    }
+  }
+}
+
+void FbankComputer::ComputeFromFft(BaseFloat signal_log_energy,
+                                   BaseFloat vtln_warp,
+                                   VectorBase<BaseFloat> *signal_frame,
+                                   VectorBase<BaseFloat> *feature) {
+  const MelBanks &mel_banks = *(GetMelBanks(vtln_warp));
+
   // Convert the FFT into a power spectrum.
   ComputePowerSpectrum(signal_frame);
   SubVector<BaseFloat> power_spectrum(*signal_frame, 0,
@@ -114,11 +182,11 @@ void FbankComputer::Compute(BaseFloat signal_raw_log_energy,
 
   // Copy energy as first value (or the last, if htk_compat == true).
   if (opts_.use_energy) {
-    if (opts_.energy_floor > 0.0 && signal_raw_log_energy < log_energy_floor_) {
-      signal_raw_log_energy = log_energy_floor_;
+    if (opts_.energy_floor > 0.0 && signal_log_energy < log_energy_floor_) {
+      signal_log_energy = log_energy_floor_;
     }
     int32 energy_index = opts_.htk_compat ? opts_.mel_opts.num_bins : 0;
-    (*feature)(energy_index) = signal_raw_log_energy;
+    (*feature)(energy_index) = signal_log_energy;
   }
 }
 
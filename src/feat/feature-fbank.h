@@ -126,6 +126,15 @@ class FbankComputer {
                VectorBase<BaseFloat> *signal_frame,
                VectorBase<BaseFloat> *feature);
 
+  /// Computes the features of several frames at once.  This is equivalent to
+  /// calling Compute() on each row of 'signal_frames' (with the corresponding
+  /// element of 'signal_raw_log_energy'), writing to the rows of 'features',
+  /// but it is faster because it does the FFTs of all the frames together.
+  void Compute(const VectorBase<BaseFloat> &signal_raw_log_energy,
+               BaseFloat vtln_warp,
+               MatrixBase<BaseFloat> *signal_frames,
+               MatrixBase<BaseFloat> *features);
+
   ~FbankComputer();
 
  private:
@@ -138,6 +147,14 @@ class FbankComputer {
   SplitRadixRealFft<BaseFloat> *srfft_;
   // Disallow assignment.
   FbankComputer &operator =(const FbankComputer &other);
+
+  // The part of Compute() that comes after the FFT: 'signal_frame' contains
+  // the FFT of the frame, and 'signal_log_energy' is the log-energy that we
+  // output if opts_.use_energy (before applying the floor).
+  void ComputeFromFft(BaseFloat signal_log_energy,
+                      BaseFloat vtln_warp,
+                      VectorBase<BaseFloat> *signal_frame,
+                      VectorBase<BaseFloat> *feature);
 };
 
 typedef OfflineFeatureTpl<FbankComputer> Fbank;
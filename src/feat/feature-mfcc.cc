@@ -32,8 +32,6 @@ void MfccComputer::Compute(BaseFloat signal_raw_log_energy,
   KALDI_ASSERT(signal_frame->Dim() == opts_.frame_opts.PaddedWindowSize() &&
                feature->Dim() == this->Dim());
 
-  const MelBanks &mel_banks = *(GetMelBanks(vtln_warp));
-
   if (opts_.use_energy && !opts_.raw_energy)
     signal_raw_log_energy = Log(std::max<BaseFloat>(VecVec(*signal_frame, *signal_frame),
                                      std::numeric_limits<float>::epsilon()));
@@ -43,6 +41,70 @@ void MfccComputer::Compute(BaseFloat signal_raw_log_energy,
   else  // An alternative algorithm that works for non-powers-of-two.
     RealFft(signal_frame, true);
 
+  ComputeFromFft(signal_raw_log_energy, vtln_warp, signal_frame, feature);
+}
+
+void MfccComputer::Compute(const VectorBase<BaseFloat> &signal_raw_log_energy,
+                           BaseFloat vtln_warp,
+                           MatrixBase<BaseFloat> *signal_frames,
+                           MatrixBase<BaseFloat> *features) {
+  MatrixIndexT num_frames = signal_frames->NumRows();
+  KALDI_ASSERT(features->NumRows() == num_frames &&
+               signal_raw_log_energy.Dim() == num_frames);
+  if (srfft_ == NULL) {  // RealFft() has no batched version.
+    for (MatrixIndexT r = 0; r < num_frames; r++) {
+      SubVector<BaseFloat> signal_frame(*signal_frames, r),
+          feature(*features, r);
+      Compute(signal_raw_log_energy(r), vtln_warp, &signal_frame, &feature);
+    }
+    return;
+  }
+  KALDI_ASSERT(signal_frames->NumCols() ==
+               opts_.frame_opts.PaddedWindowSize() &&
+               features->NumCols() == this->Dim());
+
+  Vector<BaseFloat> log_energy(signal_raw_log_energy);
+  if (opts_.use_energy && !opts_.raw_energy)
+    for (MatrixIndexT r = 0; r < num_frames; r++)
+      log_energy(r) = Log(std::max<BaseFloat>(
+          VecVec(signal_frames->Row(r), signal_frames->Row(r)),
+          std::numeric_limits<float>::epsilon()));
+
+  srfft_->Compute(signal_frames, true);
+
+  // The rest is as ComputeFromFft(), but with the Mel banks and the DCT done
+  // as matrix multiplications over all the frames.
+  const MelBanks &mel_banks = *(GetMelBanks(vtln_warp));
+  for (MatrixIndexT r = 0; r < num_frames; r++) {
+    SubVector<BaseFloat> signal_frame(*signal_frames, r);
+    ComputePowerSpectrum(&signal_frame);
+  }
+  SubMatrix<BaseFloat> power_spectra(*signal_frames, 0, num_frames, 0,
+                                     signal_frames->NumCols() / 2 + 1);
+
+  Matrix<BaseFloat> mel_energies(num_frames, opts_.mel_opts.num_bins,
+                                 kUndefined);
+  mel_banks.Compute(power_spectra, &mel_energies);
+  mel_energies.ApplyFloor(std::numeric_limits<float>::epsilon());
+  mel_energies.ApplyLog();
+
+  features->AddMatMat(1.0, mel_energies, kNoTrans, dct_matrix_, kTrans, 0.0);
+
+  if (opts_.cepstral_lifter != 0.0)
+    features->MulColsVec(lifter_coeffs_);
+
+  for (MatrixIndexT r = 0; r < num_frames; r++) {
+    SubVector<BaseFloat> feature(*features, r);
+    SetEnergyAndReorder(log_energy(r), &feature);
+  }
+}
+
+void MfccComputer::ComputeFromFft(BaseFloat signal_log_energy,
+                                  BaseFloat vtln_warp,
+                                  VectorBase<BaseFloat> *signal_frame,
+                                  VectorBase<BaseFloat> *feature) {
+  const MelBanks &mel_banks = *(GetMelBanks(vtln_warp));
+
   // Convert the FFT into a power spectrum.
   ComputePowerSpectrum(signal_frame);
   SubVector<BaseFloat> power_spectrum(*signal_frame, 0,
@@ -61,10 +123,15 @@ void MfccComputer::Compute(BaseFloat signal_raw_log_energy,
   if (opts_.cepstral_lifter != 0.0)
     feature->MulElements(lifter_coeffs_);
 
+  SetEnergyAndReorder(signal_log_energy, feature);
+}
+
+void MfccComputer::SetEnergyAndReorder(BaseFloat signal_log_energy,
+                                       VectorBase<BaseFloat> *feature) const {
   if (opts_.use_energy) {
-    if (opts_.energy_floor > 0.0 && signal_raw_log_energy < log_energy_floor_)
-      signal_raw_log_energy = log_energy_floor_;
-    (*feature)(0) = signal_raw_log_energy;
+    if (opts_.energy_floor > 0.0 && signal_log_energy < log_energy_floor_)
+      signal_log_energy = log_energy_floor_;
+    (*feature)(0) = signal_log_energy;
   }
 
   if (opts_.htk_compat) {
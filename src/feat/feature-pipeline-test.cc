@@ -0,0 +1,159 @@
+// feat/feature-pipeline-test.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <unistd.h>
+#include "feat/feature-pipeline.h"
+#include "transform/cmvn.h"
+
+namespace kaldi {
+
+// Applies the stages one by one, as the pipe of programs would.
+void ApplyStagesSeparately(const FeaturePipelineOptions &opts,
+                           const Matrix<double> &cmvn_stats,
+                           const Matrix<BaseFloat> &transform,
+                           const Matrix<BaseFloat> &fmllr,
+                           const Matrix<BaseFloat> &feats_in,
+                           Matrix<BaseFloat> *feats_out) {
+  Matrix<BaseFloat> feats(feats_in);
+  if (cmvn_stats.NumRows() != 0)
+    ApplyCmvn(cmvn_stats, opts.norm_vars, &feats);
+  if (opts.add_deltas) {
+    Matrix<BaseFloat> deltas;
+    ComputeDeltas(opts.delta_opts, feats, &deltas);
+    feats.Swap(&deltas);
+  }
+  Matrix<BaseFloat> spliced;
+  SpliceFrames(feats, opts.left_context, opts.right_context, &spliced);
+  feats.Swap(&spliced);
+  const Matrix<BaseFloat> *xforms[] = { &transform, &fmllr };
+  for (int32 i = 0; i < 2; i++) {
+    const Matrix<BaseFloat> &xform = *(xforms[i]);
+    if (xform.NumRows() == 0) continue;
+    Matrix<BaseFloat> transformed(feats.NumRows(), xform.NumRows());
+    if (xform.NumCols() == feats.NumCols()) {
+      transformed.AddMatMat(1.0, feats, kNoTrans, xform, kTrans, 0.0);
+    } else {
+      KALDI_ASSERT(xform.NumCols() == feats.NumCols() + 1);
+      SubMatrix<BaseFloat> linear(xform, 0, xform.NumRows(), 0,
+                                  feats.NumCols());
+      transformed.AddMatMat(1.0, feats, kNoTrans, linear, kTrans, 0.0);
+      Vector<BaseFloat> offset(xform.NumRows());
+      offset.CopyColFromMat(xform, feats.NumCols());
+      transformed.AddVecToRows(1.0, offset);
+    }
+    feats.Swap(&transformed);
+  }
+  int32 num_frames_out = 0;
+  for (int32 t = 0; t < feats.NumRows(); t += opts.subsample)
+    num_frames_out++;
+  feats_out->Resize(num_frames_out, feats.NumCols());
+  for (int32 i = 0; i < num_frames_out; i++)
+    feats_out->Row(i).CopyFromVec(feats.Row(i * opts.subsample));
+}
+
+void UnitTestFeaturePipeline() {
+  for (int32 i = 0; i < 20; i++) {
+    FeaturePipelineOptions opts;
+    int32 dim = RandInt(1, 13);
+    bool use_cmvn = (RandInt(0, 1) == 0),
+        per_utt_cmvn = (RandInt(0, 1) == 0),
+        use_transform = (RandInt(0, 1) == 0),
+        use_fmllr = (RandInt(0, 1) == 0);
+    opts.norm_vars = (RandInt(0, 1) == 0);
+    opts.add_deltas = (RandInt(0, 2) == 0);
+    opts.left_context = RandInt(0, 3);
+    opts.right_context = RandInt(0, 3);
+    opts.subsample = RandInt(1, 3);
+
+    int32 stage_dim = dim * (opts.add_deltas ? opts.delta_opts.order + 1 : 1),
+        spliced_dim = stage_dim * (1 + opts.left_context + opts.right_context),
+        transform_dim = RandInt(1, spliced_dim);
+    Matrix<BaseFloat> transform;
+    if (use_transform) {
+      transform.Resize(transform_dim,
+                       spliced_dim + (RandInt(0, 1) == 0 ? 1 : 0));
+      transform.SetRandn();
+      opts.transform = "tmp.transform";
+      WriteKaldiObject(transform, opts.transform, RandInt(0, 1) == 0);
+    }
+    int32 fmllr_dim = (use_transform ? transform_dim : spliced_dim);
+
+    int32 num_utts = 3;
+    std::vector<Matrix<BaseFloat> > feats(num_utts), fmllrs(num_utts);
+    std::vector<Matrix<double> > cmvn_stats(num_utts);
+    {
+      BaseFloatMatrixWriter fmllr_writer("ark:tmp.fmllr.ark");
+      DoubleMatrixWriter cmvn_writer("ark:tmp.cmvn.ark");
+      for (int32 u = 0; u < num_utts; u++) {
+        std::string utt = "utt" + std::to_string(u);
+        feats[u].Resize(RandInt(1, 20), dim);
+        feats[u].SetRandn();
+        InitCmvnStats(dim, &(cmvn_stats[u]));
+        Matrix<BaseFloat> stats_feats(10, dim);
+        stats_feats.SetRandn();
+        AccCmvnStats(stats_feats, NULL, &(cmvn_stats[u]));
+        if (!per_utt_cmvn && u > 0)
+          cmvn_stats[u] = cmvn_stats[0];
+        cmvn_writer.Write(utt, cmvn_stats[u]);
+        fmllrs[u].Resize(fmllr_dim, fmllr_dim + 1);
+        fmllrs[u].SetRandn();
+        fmllr_writer.Write(utt, fmllrs[u]);
+      }
+    }
+    if (use_cmvn) {
+      if (per_utt_cmvn) {
+        opts.cmvn = "ark:tmp.cmvn.ark";
+      } else {
+        opts.cmvn = "tmp.cmvn";
+        WriteKaldiObject(cmvn_stats[0], opts.cmvn, false);
+      }
+    }
+    if (use_fmllr)
+      opts.fmllr = "ark:tmp.fmllr.ark";
+
+    FeaturePipeline pipeline(opts);
+    for (int32 u = 0; u < num_utts; u++) {
+      std::string utt = "utt" + std::to_string(u);
+      Matrix<BaseFloat> feats_out, feats_ref;
+      KALDI_ASSERT(pipeline.Compute(utt, feats[u], &feats_out));
+      ApplyStagesSeparately(opts,
+                            (use_cmvn ? cmvn_stats[u] : Matrix<double>()),
+                            transform,
+                            (use_fmllr ? fmllrs[u] : Matrix<BaseFloat>()),
+                            feats[u], &feats_ref);
+      AssertEqual(feats_out, feats_ref, 0.001);
+    }
+    Matrix<BaseFloat> feats_out;
+    KALDI_ASSERT(!use_cmvn || !per_utt_cmvn ||
+                 !pipeline.Compute("no-such-utt", feats[0], &feats_out));
+  }
+  unlink("tmp.transform");
+  unlink("tmp.cmvn");
+  unlink("tmp.cmvn.ark");
+  unlink("tmp.fmllr.ark");
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  UnitTestFeaturePipeline();
+  std::cout << "Tests succeeded.\n";
+  return 0;
+}
@@ -0,0 +1,172 @@
+// feat/feature-pipeline.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "feat/feature-pipeline.h"
+#include "transform/cmvn.h"
+#include "transform/transform-common.h"
+
+namespace kaldi {
+
+FeaturePipeline::FeaturePipeline(const FeaturePipelineOptions &opts):
+    opts_(opts), have_cmvn_table_(false), have_fmllr_table_(false) {
+  if (opts_.left_context < 0 || opts_.right_context < 0 ||
+      opts_.subsample < 1)
+    KALDI_ERR << "Invalid --left-context, --right-context or --subsample "
+              << "option.";
+  bool have_utt2spk_users = false;
+  if (!opts_.cmvn.empty()) {
+    if (ClassifyRspecifier(opts_.cmvn, NULL, NULL) != kNoRspecifier) {
+      if (!cmvn_reader_.Open(opts_.cmvn, opts_.utt2spk))
+        KALDI_ERR << "Problem opening CMVN stats with rspecifier "
+                  << '"' << opts_.cmvn << '"' << " and utt2spk rspecifier "
+                  << '"' << opts_.utt2spk << '"';
+      have_cmvn_table_ = true;
+      have_utt2spk_users = true;
+    } else {
+      ReadKaldiObject(opts_.cmvn, &global_cmvn_stats_);
+    }
+  }
+  if (!opts_.transform.empty())
+    ReadKaldiObject(opts_.transform, &transform_);
+  if (!opts_.fmllr.empty()) {
+    if (ClassifyRspecifier(opts_.fmllr, NULL, NULL) != kNoRspecifier) {
+      if (!fmllr_reader_.Open(opts_.fmllr, opts_.utt2spk))
+        KALDI_ERR << "Problem opening fMLLR transforms with rspecifier "
+                  << '"' << opts_.fmllr << '"' << " and utt2spk rspecifier "
+                  << '"' << opts_.utt2spk << '"';
+      have_fmllr_table_ = true;
+      have_utt2spk_users = true;
+    } else {
+      ReadKaldiObject(opts_.fmllr, &global_fmllr_);
+    }
+  }
+  if (!opts_.utt2spk.empty() && !have_utt2spk_users)
+    KALDI_ERR << "--utt2spk option not compatible with rxfilenames for "
+              << "--cmvn and --fmllr (did you forget ark:?)";
+}
+
+bool FeaturePipeline::GetUtteranceInfo(const std::string &utt,
+                                       UtteranceInfo *info) {
+  if (have_cmvn_table_) {
+    if (!cmvn_reader_.HasKey(utt)) {
+      KALDI_WARN << "No normalization statistics available for key "
+                 << utt << ", producing no output for this utterance";
+      return false;
+    }
+    info->cmvn_stats = cmvn_reader_.Value(utt);
+  }
+  if (have_fmllr_table_) {
+    if (!fmllr_reader_.HasKey(utt)) {
+      KALDI_WARN << "No fMLLR transform available for utterance "
+                 << utt << ", producing no output for this utterance";
+      return false;
+    }
+    info->fmllr = fmllr_reader_.Value(utt);
+  }
+  return true;
+}
+
+bool FeaturePipeline::Apply(const std::string &utt, const UtteranceInfo &info,
+                            const MatrixBase<BaseFloat> &feats_in,
+                            Matrix<BaseFloat> *feats_out) const {
+  Matrix<BaseFloat> feats(feats_in);
+  if (!opts_.cmvn.empty()) {
+    const Matrix<double> &stats = (have_cmvn_table_ ? info.cmvn_stats :
+                                   global_cmvn_stats_);
+    if (stats.NumCols() != feats.NumCols() + 1) {
+      KALDI_WARN << "CMVN stats for utterance " << utt << " have dimension "
+                 << (stats.NumCols() - 1) << " versus feature dimension "
+                 << feats.NumCols();
+      return false;
+    }
+    ApplyCmvn(stats, opts_.norm_vars, &feats);
+  }
+  if (opts_.add_deltas) {
+    Matrix<BaseFloat> deltas;
+    ComputeDeltas(opts_.delta_opts, feats, &deltas);
+    feats.Swap(&deltas);
+  }
+
+  const Matrix<BaseFloat> &fmllr = (have_fmllr_table_ ? info.fmllr :
+                                    global_fmllr_);
+  int32 left_context = opts_.left_context,
+      right_context = opts_.right_context,
+      spliced_dim = feats.NumCols() * (1 + left_context + right_context);
+  if (transform_.NumRows() == 0 && fmllr.NumRows() == 0) {
+    if (left_context != 0 || right_context != 0)
+      SpliceFrames(feats, left_context, right_context, feats_out);
+    else
+      feats_out->Swap(&feats);
+  } else {
+    // The transform that is applied to the spliced features: the global
+    // transform, the fMLLR transform, or the two composed, so that the
+    // features are multiplied by a matrix only once.
+    const Matrix<BaseFloat> *xform = &fmllr;
+    Matrix<BaseFloat> composed;
+    int32 xform_in_dim = spliced_dim;
+    if (transform_.NumRows() != 0) {
+      if (transform_.NumCols() != spliced_dim &&
+          transform_.NumCols() != spliced_dim + 1) {
+        KALDI_WARN << "Transform has dimension " << transform_.NumRows()
+                   << "x" << transform_.NumCols() << " versus spliced feature "
+                   << "dimension " << spliced_dim << " for utterance " << utt;
+        return false;
+      }
+      xform = &transform_;
+      xform_in_dim = transform_.NumRows();
+    }
+    if (fmllr.NumRows() != 0) {
+      if (fmllr.NumCols() != xform_in_dim &&
+          fmllr.NumCols() != xform_in_dim + 1) {
+        KALDI_WARN << "fMLLR transform for utterance " << utt << " has "
+                   << "dimension " << fmllr.NumRows() << "x" << fmllr.NumCols()
+                   << " versus feature dimension " << xform_in_dim;
+        return false;
+      }
+      if (transform_.NumRows() != 0) {
+        ComposeTransforms(fmllr, transform_,
+                          transform_.NumCols() == spliced_dim + 1, &composed);
+        xform = &composed;
+      }
+    }
+    ApplySplicedTransform(*xform, left_context, right_context, feats,
+                          feats_out);
+  }
+
+  if (opts_.subsample > 1) {
+    int32 n = opts_.subsample,
+        num_frames_out = (feats_out->NumRows() + n - 1) / n;
+    Matrix<BaseFloat> subsampled(num_frames_out, feats_out->NumCols(),
+                                 kUndefined);
+    for (int32 t = 0; t < num_frames_out; t++)
+      subsampled.Row(t).CopyFromVec(feats_out->Row(t * n));
+    feats_out->Swap(&subsampled);
+  }
+  return true;
+}
+
+bool FeaturePipeline::Compute(const std::string &utt,
+                              const MatrixBase<BaseFloat> &feats_in,
+                              Matrix<BaseFloat> *feats_out) {
+  UtteranceInfo info;
+  return GetUtteranceInfo(utt, &info) &&
+      Apply(utt, info, feats_in, feats_out);
+}
+
+}  // namespace kaldi
@@ -0,0 +1,145 @@
+// feat/feature-pipeline.h
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_FEAT_FEATURE_PIPELINE_H_
+#define KALDI_FEAT_FEATURE_PIPELINE_H_
+
+#include <string>
+
+#include "matrix/matrix-lib.h"
+#include "util/common-utils.h"
+#include "feat/feature-functions.h"
+
+namespace kaldi {
+/// @addtogroup  feat FeatureExtraction
+/// @{
+
+/// Options for FeaturePipeline, which applies in memory what the recipes
+/// usually do with a pipe like
+///  "apply-cmvn --utt2spk=ark:utt2spk scp:cmvn.scp scp:feats.scp ark:- |
+///   splice-feats ark:- ark:- | transform-feats final.mat ark:- ark:- |
+///   transform-feats --utt2spk=ark:utt2spk ark:trans.1 ark:- ark:- |".
+/// The stages that are configured are applied in this order: CMVN, deltas,
+/// splicing, the global transform, the fMLLR transform, subsampling.
+struct FeaturePipelineOptions {
+  std::string cmvn;  // rspecifier or rxfilename of the CMVN stats.
+  bool norm_vars;
+  bool add_deltas;
+  DeltaFeaturesOptions delta_opts;
+  int32 left_context;
+  int32 right_context;
+  std::string transform;  // rxfilename of a global transform, e.g. LDA.
+  std::string fmllr;  // rspecifier or rxfilename of the fMLLR transforms.
+  std::string utt2spk;
+  int32 subsample;
+
+  FeaturePipelineOptions(): norm_vars(false), add_deltas(false),
+                            left_context(0), right_context(0), subsample(1) { }
+
+  void Register(OptionsItf *opts) {
+    opts->Register("cmvn", &cmvn, "If set, apply CMVN with the stats read "
+                   "from this rspecifier (per utterance, or per speaker with "
+                   "--utt2spk) or rxfilename (global), as apply-cmvn does.");
+    opts->Register("norm-vars", &norm_vars, "If true, normalize variances "
+                   "as well as means in CMVN.");
+    opts->Register("add-deltas", &add_deltas, "If true, append delta "
+                   "features after CMVN, as add-deltas does.");
+    delta_opts.Register(opts);
+    opts->Register("left-context", &left_context, "Number of frames of left "
+                   "context to splice the features with.");
+    opts->Register("right-context", &right_context, "Number of frames of "
+                   "right context to splice the features with.");
+    opts->Register("transform", &transform, "If set, rxfilename of a global "
+                   "linear or affine transform (e.g. LDA) to apply after "
+                   "splicing.");
+    opts->Register("fmllr", &fmllr, "If set, apply fMLLR transforms read "
+                   "from this rspecifier (per utterance, or per speaker with "
+                   "--utt2spk) or rxfilename (global), after --transform.");
+    opts->Register("utt2spk", &utt2spk, "rspecifier for utterance to speaker "
+                   "map, for --cmvn and --fmllr.");
+    opts->Register("subsample", &subsample, "If > 1, keep only every n'th "
+                   "frame of the output, as subsample-feats --n does.");
+  }
+};
+
+/// This class applies the stages configured in FeaturePipelineOptions to the
+/// features of an utterance, without writing out and reading back the
+/// features between stages as a pipe of separate programs does.  The
+/// splicing and the transforms are applied in one pass, by composing the
+/// transforms and using ApplySplicedTransform().  It can be used from any
+/// program that reads features, e.g. with
+///   FeaturePipeline pipeline(pipeline_opts);
+///   for (; !feature_reader.Done(); feature_reader.Next()) {
+///     Matrix<BaseFloat> feats;
+///     if (!pipeline.Compute(feature_reader.Key(), feature_reader.Value(),
+///                           &feats)) continue;
+///     ...
+/// To process utterances in parallel, call GetUtteranceInfo() in the main
+/// thread and Apply() in the worker threads.
+class FeaturePipeline {
+ public:
+  /// The per-utterance inputs of the pipeline.
+  struct UtteranceInfo {
+    Matrix<double> cmvn_stats;  // empty if there is no per-utterance CMVN.
+    Matrix<BaseFloat> fmllr;  // empty if there is no per-utterance fMLLR.
+  };
+
+  /// Reads the global CMVN stats and transforms, and opens the tables of
+  /// per-utterance or per-speaker ones.
+  explicit FeaturePipeline(const FeaturePipelineOptions &opts);
+
+  /// Looks up the CMVN stats and fMLLR transform of utterance "utt", if they
+  /// are read from tables.  Returns false, with a warning, if they are not
+  /// available.  It is not thread-safe.
+  bool GetUtteranceInfo(const std::string &utt, UtteranceInfo *info);
+
+  /// Applies the pipeline to the features "feats_in" of an utterance, using
+  /// "info" from GetUtteranceInfo(), and puts the result in "feats_out".
+  /// Returns false, with a warning, if the dimensions do not match.  It is
+  /// const and may be called from several threads at once.
+  bool Apply(const std::string &utt, const UtteranceInfo &info,
+             const MatrixBase<BaseFloat> &feats_in,
+             Matrix<BaseFloat> *feats_out) const;
+
+  /// GetUtteranceInfo() followed by Apply().
+  bool Compute(const std::string &utt, const MatrixBase<BaseFloat> &feats_in,
+               Matrix<BaseFloat> *feats_out);
+
+ private:
+  FeaturePipelineOptions opts_;
+
+  RandomAccessDoubleMatrixReaderMapped cmvn_reader_;
+  Matrix<double> global_cmvn_stats_;
+  bool have_cmvn_table_;
+
+  Matrix<BaseFloat> transform_;
+
+  RandomAccessBaseFloatMatrixReaderMapped fmllr_reader_;
+  Matrix<BaseFloat> global_fmllr_;
+  bool have_fmllr_table_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(FeaturePipeline);
+};
+
+/// @} End of "addtogroup feat"
+}  // namespace kaldi
+
+
+#endif  // KALDI_FEAT_FEATURE_PIPELINE_H_
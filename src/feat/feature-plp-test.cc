@@ -68,6 +68,45 @@ static void UnitTestSimple() {
 }
 
 
+// Checks that the batched computation in Plp::Compute() gives the same
+// features as computing them one frame at a time.
+static void UnitTestBatch() {
+  std::cout << "=== UnitTestBatch() ===\n";
+
+  Vector<BaseFloat> v(5000 + Rand() % 40000);
+  v.SetRandn();
+  v.Scale(1000.0);
+
+  PlpOptions op;
+  op.frame_opts.dither = 0.0;
+  op.frame_opts.snip_edges = (Rand() % 2 == 0);
+  op.frame_opts.remove_dc_offset = (Rand() % 2 == 0);
+  if (Rand() % 2 == 0)
+    op.frame_opts.preemph_coeff = 0.0;
+  op.use_energy = (Rand() % 2 == 0);
+  op.raw_energy = (Rand() % 2 == 0);
+  op.htk_compat = (Rand() % 2 == 0);
+
+  Plp plp(op);
+  Matrix<BaseFloat> m;
+  plp.Compute(v, 1.0, &m);
+  KALDI_ASSERT(m.NumRows() == NumFrames(v.Dim(), op.frame_opts));
+
+  PlpComputer computer(op);
+  FeatureWindowFunction window_function(op.frame_opts);
+  Vector<BaseFloat> window, feature(computer.Dim());
+  for (int32 r = 0; r < m.NumRows(); r++) {
+    BaseFloat raw_log_energy = 0.0;
+    ExtractWindow(0, v, r, op.frame_opts, window_function, &window,
+                  (computer.NeedRawLogEnergy() ? &raw_log_energy : NULL));
+    computer.Compute(raw_log_energy, 1.0, &window, &feature);
+    SubVector<BaseFloat> row(m, r);
+    KALDI_ASSERT(row.ApproxEqual(feature, 1.0e-04));
+  }
+  std::cout << "Test passed :)\n\n";
+}
+
+
 static void UnitTestHTKCompare1() {
   std::cout << "=== UnitTestHTKCompare1() ===\n";
 
@@ -156,6 +195,7 @@ static void UnitTestHTKCompare1() {
 
 static void UnitTestFeat() {
   UnitTestSimple();
+  UnitTestBatch();
   UnitTestHTKCompare1();
 }
 
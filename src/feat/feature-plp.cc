@@ -116,13 +116,6 @@ void PlpComputer::Compute(BaseFloat signal_raw_log_energy,
   KALDI_ASSERT(signal_frame->Dim() == opts_.frame_opts.PaddedWindowSize() &&
                feature->Dim() == this->Dim());
 
-  const MelBanks &mel_banks = *GetMelBanks(vtln_warp);
-  const Vector<BaseFloat> &equal_loudness = *GetEqualLoudness(vtln_warp);
-
-
-  KALDI_ASSERT(opts_.num_ceps <= opts_.lpc_order+1);  // our num-ceps includes C0.
-
-
   if (opts_.use_energy && !opts_.raw_energy)
     signal_raw_log_energy = Log(std::max<BaseFloat>(VecVec(*signal_frame, *signal_frame),
                                      std::numeric_limits<float>::min()));
@@ -132,6 +125,84 @@ void PlpComputer::Compute(BaseFloat signal_raw_log_energy,
   else  // An alternative algorithm that works for non-powers-of-two.
     RealFft(signal_frame, true);
 
+  ComputeFromFft(signal_raw_log_energy, vtln_warp, signal_frame, feature);
+}
+
+void PlpComputer::Compute(const VectorBase<BaseFloat> &signal_raw_log_energy,
+                          BaseFloat vtln_warp,
+                          MatrixBase<BaseFloat> *signal_frames,
+                          MatrixBase<BaseFloat> *features) {
+  MatrixIndexT num_frames = signal_frames->NumRows();
+  KALDI_ASSERT(features->NumRows() == num_frames &&
+               signal_raw_log_energy.Dim() == num_frames);
+  if (srfft_ == NULL) {  // RealFft() has no batched version.
+    for (MatrixIndexT r = 0; r < num_frames; r++) {
+      SubVector<BaseFloat> signal_frame(*signal_frames, r),
+          feature(*features, r);
+      Compute(signal_raw_log_energy(r), vtln_warp, &signal_frame, &feature);
+    }
+    return;
+  }
+  KALDI_ASSERT(signal_frames->NumCols() ==
+               opts_.frame_opts.PaddedWindowSize() &&
+               features->NumCols() == this->Dim());
+
+  Vector<BaseFloat> log_energy(signal_raw_log_energy);
+  if (opts_.use_energy && !opts_.raw_energy)
+    for (MatrixIndexT r = 0; r < num_frames; r++)
+      log_energy(r) = Log(std::max<BaseFloat>(
+          VecVec(signal_frames->Row(r), signal_frames->Row(r)),
+          std::numeric_limits<float>::min()));
+
+  srfft_->Compute(signal_frames, true);
+
+  // The rest is as ComputeFromFft(), but with the Mel banks and the inverse
+  // DFT done as matrix multiplications over all the frames.
+  const MelBanks &mel_banks = *GetMelBanks(vtln_warp);
+  const Vector<BaseFloat> &equal_loudness = *GetEqualLoudness(vtln_warp);
+  KALDI_ASSERT(opts_.num_ceps <= opts_.lpc_order+1);  // our num-ceps includes C0.
+  for (MatrixIndexT r = 0; r < num_frames; r++) {
+    SubVector<BaseFloat> signal_frame(*signal_frames, r);
+    ComputePowerSpectrum(&signal_frame);
+  }
+  SubMatrix<BaseFloat> power_spectra(*signal_frames, 0, num_frames, 0,
+                                     signal_frames->NumCols() / 2 + 1);
+
+  int32 num_mel_bins = opts_.mel_opts.num_bins;
+  Matrix<BaseFloat> mel_energies_duplicated(num_frames, num_mel_bins + 2,
+                                            kUndefined);
+  SubMatrix<BaseFloat> mel_energies(mel_energies_duplicated, 0, num_frames,
+                                    1, num_mel_bins);
+  mel_banks.Compute(power_spectra, &mel_energies);
+  mel_energies.MulColsVec(equal_loudness);
+  mel_energies.ApplyPow(opts_.compress_factor);
+  // duplicate first and last columns
+  for (MatrixIndexT r = 0; r < num_frames; r++) {
+    mel_energies_duplicated(r, 0) = mel_energies_duplicated(r, 1);
+    mel_energies_duplicated(r, num_mel_bins + 1) =
+        mel_energies_duplicated(r, num_mel_bins);
+  }
+
+  Matrix<BaseFloat> autocorr_coeffs(num_frames, opts_.lpc_order + 1,
+                                    kUndefined);
+  autocorr_coeffs.AddMatMat(1.0, mel_energies_duplicated, kNoTrans,
+                            idft_bases_, kTrans, 0.0);
+
+  for (MatrixIndexT r = 0; r < num_frames; r++) {
+    SubVector<BaseFloat> feature(*features, r);
+    ComputeFromAutocorr(log_energy(r), autocorr_coeffs.Row(r), &feature);
+  }
+}
+
+void PlpComputer::ComputeFromFft(BaseFloat signal_log_energy,
+                                 BaseFloat vtln_warp,
+                                 VectorBase<BaseFloat> *signal_frame,
+                                 VectorBase<BaseFloat> *feature) {
+  const MelBanks &mel_banks = *GetMelBanks(vtln_warp);
+  const Vector<BaseFloat> &equal_loudness = *GetEqualLoudness(vtln_warp);
+
+  KALDI_ASSERT(opts_.num_ceps <= opts_.lpc_order+1);  // our num-ceps includes C0.
+
   // Convert the FFT into a power spectrum.
   ComputePowerSpectrum(signal_frame);  // elements 0 ... signal_frame->Dim()/2
 
@@ -157,7 +228,14 @@ void PlpComputer::Compute(BaseFloat signal_raw_log_energy,
   autocorr_coeffs_.AddMatVec(1.0, idft_bases_, kNoTrans,
                              mel_energies_duplicated_,  0.0);
 
-  BaseFloat residual_log_energy = ComputeLpc(autocorr_coeffs_, &lpc_coeffs_);
+  ComputeFromAutocorr(signal_log_energy, autocorr_coeffs_, feature);
+}
+
+void PlpComputer::ComputeFromAutocorr(
+    BaseFloat signal_log_energy,
+    const VectorBase<BaseFloat> &autocorr_coeffs,
+    VectorBase<BaseFloat> *feature) {
+  BaseFloat residual_log_energy = ComputeLpc(autocorr_coeffs, &lpc_coeffs_);
 
   residual_log_energy = std::max<BaseFloat>(residual_log_energy,
                                  std::numeric_limits<float>::min());
@@ -174,9 +252,9 @@ void PlpComputer::Compute(BaseFloat signal_raw_log_energy,
     feature->Scale(opts_.cepstral_scale);
 
   if (opts_.use_energy) {
-    if (opts_.energy_floor > 0.0 && signal_raw_log_energy < log_energy_floor_)
-      signal_raw_log_energy = log_energy_floor_;
-    (*feature)(0) = signal_raw_log_energy;
+    if (opts_.energy_floor > 0.0 && signal_log_energy < log_energy_floor_)
+      signal_log_energy = log_energy_floor_;
+    (*feature)(0) = signal_log_energy;
   }
 
   if (opts_.htk_compat) {  // reorder the features.
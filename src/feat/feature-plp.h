@@ -138,6 +138,15 @@ class PlpComputer {
                VectorBase<BaseFloat> *signal_frame,
                VectorBase<BaseFloat> *feature);
 
+  /// Computes the features of several frames at once.  This is equivalent to
+  /// calling Compute() on each row of 'signal_frames' (with the corresponding
+  /// element of 'signal_raw_log_energy'), writing to the rows of 'features',
+  /// but it is faster because it does the FFTs of all the frames together.
+  void Compute(const VectorBase<BaseFloat> &signal_raw_log_energy,
+               BaseFloat vtln_warp,
+               MatrixBase<BaseFloat> *signal_frames,
+               MatrixBase<BaseFloat> *features);
+
   ~PlpComputer();
  private:
 
@@ -164,6 +173,20 @@ class PlpComputer {
 
   // Disallow assignment.
   PlpComputer &operator =(const PlpComputer &other);
+
+  // The part of Compute() that comes after the FFT: 'signal_frame' contains
+  // the FFT of the frame, and 'signal_log_energy' is the log-energy that we
+  // output if opts_.use_energy (before applying the floor).
+  void ComputeFromFft(BaseFloat signal_log_energy,
+                      BaseFloat vtln_warp,
+                      VectorBase<BaseFloat> *signal_frame,
+                      VectorBase<BaseFloat> *feature);
+
+  // The last part of ComputeFromFft(), from the autocorrelation coefficients
+  // (of dimension opts_.lpc_order + 1) onwards.
+  void ComputeFromAutocorr(BaseFloat signal_log_energy,
+                           const VectorBase<BaseFloat> &autocorr_coeffs,
+                           VectorBase<BaseFloat> *feature);
 };
 
 typedef OfflineFeatureTpl<PlpComputer> Plp;
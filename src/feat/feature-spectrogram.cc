@@ -62,6 +62,49 @@ void SpectrogramComputer::Compute(BaseFloat signal_raw_log_energy,
   else  // An alternative algorithm that works for non-powers-of-two
     RealFft(signal_frame, true);
 
+  ComputeFromFft(signal_raw_log_energy, vtln_warp, signal_frame, feature);
+}
+
+void SpectrogramComputer::Compute(
+    const VectorBase<BaseFloat> &signal_raw_log_energy,
+    BaseFloat vtln_warp,
+    MatrixBase<BaseFloat> *signal_frames,
+    MatrixBase<BaseFloat> *features) {
+  MatrixIndexT num_frames = signal_frames->NumRows();
+  KALDI_ASSERT(features->NumRows() == num_frames &&
+               signal_raw_log_energy.Dim() == num_frames);
+  if (srfft_ == NULL) {  // RealFft() has no batched version.
+    for (MatrixIndexT r = 0; r < num_frames; r++) {
+      SubVector<BaseFloat> signal_frame(*signal_frames, r),
+          feature(*features, r);
+      Compute(signal_raw_log_energy(r), vtln_warp, &signal_frame, &feature);
+    }
+    return;
+  }
+  KALDI_ASSERT(signal_frames->NumCols() ==
+               opts_.frame_opts.PaddedWindowSize() &&
+               features->NumCols() == this->Dim());
+
+  Vector<BaseFloat> log_energy(signal_raw_log_energy);
+  if (!opts_.raw_energy)
+    for (MatrixIndexT r = 0; r < num_frames; r++)
+      log_energy(r) = Log(std::max<BaseFloat>(
+          VecVec(signal_frames->Row(r), signal_frames->Row(r)),
+          std::numeric_limits<float>::epsilon()));
+
+  srfft_->Compute(signal_frames, true);
+
+  for (MatrixIndexT r = 0; r < num_frames; r++) {
+    SubVector<BaseFloat> signal_frame(*signal_frames, r),
+        feature(*features, r);
+    ComputeFromFft(log_energy(r), vtln_warp, &signal_frame, &feature);
+  }
+}
+
+void SpectrogramComputer::ComputeFromFft(BaseFloat signal_log_energy,
+                                         BaseFloat vtln_warp,
+                                         VectorBase<BaseFloat> *signal_frame,
+                                         VectorBase<BaseFloat> *feature) {
   // Convert the FFT into a power spectrum.
   ComputePowerSpectrum(signal_frame);
   SubVector<BaseFloat> power_spectrum(*signal_frame,
@@ -72,11 +115,11 @@ void SpectrogramComputer::Compute(BaseFloat signal_raw_log_energy,
 
   feature->CopyFromVec(power_spectrum);
 
-  if (opts_.energy_floor > 0.0 && signal_raw_log_energy < log_energy_floor_)
-    signal_raw_log_energy = log_energy_floor_;
+  if (opts_.energy_floor > 0.0 && signal_log_energy < log_energy_floor_)
+    signal_log_energy = log_energy_floor_;
   // The zeroth spectrogram component is always set to the signal energy,
   // instead of the square of the constant component of the signal.
-  (*feature)(0) = signal_raw_log_energy;
+  (*feature)(0) = signal_log_energy;
 }
 
 }  // namespace kaldi
@@ -96,6 +96,15 @@ class SpectrogramComputer {
                VectorBase<BaseFloat> *signal_frame,
                VectorBase<BaseFloat> *feature);
 
+  /// Computes the features of several frames at once.  This is equivalent to
+  /// calling Compute() on each row of 'signal_frames' (with the corresponding
+  /// element of 'signal_raw_log_energy'), writing to the rows of 'features',
+  /// but it is faster because it does the FFTs of all the frames together.
+  void Compute(const VectorBase<BaseFloat> &signal_raw_log_energy,
+               BaseFloat vtln_warp,
+               MatrixBase<BaseFloat> *signal_frames,
+               MatrixBase<BaseFloat> *features);
+
   ~SpectrogramComputer();
 
  private:
@@ -105,6 +114,14 @@ class SpectrogramComputer {
 
   // Disallow assignment.
   SpectrogramComputer &operator=(const SpectrogramComputer &other);
+
+  // The part of Compute() that comes after the FFT: 'signal_frame' contains
+  // the FFT of the frame, and 'signal_log_energy' is the log-energy that we
+  // output as the zeroth element (before applying the floor).
+  void ComputeFromFft(BaseFloat signal_log_energy,
+                      BaseFloat vtln_warp,
+                      VectorBase<BaseFloat> *signal_frame,
+                      VectorBase<BaseFloat> *feature);
 };
 
 typedef OfflineFeatureTpl<SpectrogramComputer> Spectrogram;
@@ -156,19 +156,58 @@ void ProcessWindow(const FrameExtractionOptions &opts,
 }
 
 
-// ExtractWindow extracts a windowed frame of waveform with a power-of-two,
-// padded size.  It does mean subtraction, pre-emphasis and dithering as
-// requested.
-void ExtractWindow(int64 sample_offset,
-                   const VectorBase<BaseFloat> &wave,
-                   int32 f,  // with 0 <= f < NumFrames(feats, opts)
-                   const FrameExtractionOptions &opts,
-                   const FeatureWindowFunction &window_function,
-                   Vector<BaseFloat> *window,
-                   BaseFloat *log_energy_pre_window) {
+void ProcessWindows(const FrameExtractionOptions &opts,
+                    const FeatureWindowFunction &window_function,
+                    MatrixBase<BaseFloat> *windows,
+                    VectorBase<BaseFloat> *log_energy_pre_window) {
+  int32 frame_length = opts.WindowSize(), num_frames = windows->NumRows();
+  KALDI_ASSERT(windows->NumCols() == frame_length);
+
+  // The steps are the same as in ProcessWindow(), and done in the same way for
+  // each frame, so the results are the same.
+  if (opts.dither != 0.0) {
+    for (int32 r = 0; r < num_frames; r++) {
+      SubVector<BaseFloat> window(*windows, r);
+      Dither(&window, opts.dither);
+    }
+  }
+
+  if (opts.remove_dc_offset) {
+    Vector<BaseFloat> offsets(num_frames, kUndefined);
+    for (int32 r = 0; r < num_frames; r++)
+      offsets(r) = -windows->Row(r).Sum() / frame_length;
+    windows->AddVecToCols(1.0, offsets);
+  }
+
+  if (log_energy_pre_window != NULL) {
+    KALDI_ASSERT(log_energy_pre_window->Dim() == num_frames);
+    log_energy_pre_window->AddDiagMat2(1.0, *windows, kNoTrans, 0.0);
+    for (int32 r = 0; r < num_frames; r++)
+      (*log_energy_pre_window)(r) = Log(std::max<BaseFloat>(
+          (*log_energy_pre_window)(r), std::numeric_limits<float>::epsilon()));
+  }
+
+  if (opts.preemph_coeff != 0.0) {
+    for (int32 r = 0; r < num_frames; r++) {
+      SubVector<BaseFloat> window(*windows, r);
+      Preemphasize(&window, opts.preemph_coeff);
+    }
+  }
+
+  windows->MulColsVec(window_function.window);
+}
+
+
+// Copies the samples of frame f (with reflection at the edges of the wave,
+// but no other processing) to 'frame', of dimension opts.WindowSize().
+static void ExtractFrameSamples(int64 sample_offset,
+                                const VectorBase<BaseFloat> &wave,
+                                int32 f,
+                                const FrameExtractionOptions &opts,
+                                VectorBase<BaseFloat> *frame) {
   KALDI_ASSERT(sample_offset >= 0 && wave.Dim() != 0);
-  int32 frame_length = opts.WindowSize(),
-      frame_length_padded = opts.PaddedWindowSize();
+  int32 frame_length = opts.WindowSize();
+  KALDI_ASSERT(frame->Dim() == frame_length);
   int64 num_samples = sample_offset + wave.Dim(),
       start_sample = FirstSampleOfFrame(f, opts),
       end_sample = start_sample + frame_length;
@@ -180,17 +219,13 @@ void ExtractWindow(int64 sample_offset,
     KALDI_ASSERT(sample_offset == 0 || start_sample >= sample_offset);
   }
 
-  if (window->Dim() != frame_length_padded)
-    window->Resize(frame_length_padded, kUndefined);
-
   // wave_start and wave_end are start and end indexes into 'wave', for the
   // piece of wave that we're trying to extract.
   int32 wave_start = int32(start_sample - sample_offset),
       wave_end = wave_start + frame_length;
   if (wave_start >= 0 && wave_end <= wave.Dim()) {
     // the normal case-- no edge effects to consider.
-    window->Range(0, frame_length).CopyFromVec(
-        wave.Range(wave_start, frame_length));
+    frame->CopyFromVec(wave.Range(wave_start, frame_length));
   } else {
     // Deal with any end effects by reflection, if needed.  This code will only
     // be reached for about two frames per utterance, so we don't concern
@@ -207,16 +242,61 @@ void ExtractWindow(int64 sample_offset,
         if (s_in_wave < 0) s_in_wave = - s_in_wave - 1;
         else s_in_wave = 2 * wave_dim - 1 - s_in_wave;
       }
-      (*window)(s) = wave(s_in_wave);
+      (*frame)(s) = wave(s_in_wave);
     }
   }
+}
 
-  if (frame_length_padded > frame_length)
-    window->Range(frame_length, frame_length_padded - frame_length).SetZero();
+
+// ExtractWindow extracts a windowed frame of waveform with a power-of-two,
+// padded size.  It does mean subtraction, pre-emphasis and dithering as
+// requested.
+void ExtractWindow(int64 sample_offset,
+                   const VectorBase<BaseFloat> &wave,
+                   int32 f,  // with 0 <= f < NumFrames(feats, opts)
+                   const FrameExtractionOptions &opts,
+                   const FeatureWindowFunction &window_function,
+                   Vector<BaseFloat> *window,
+                   BaseFloat *log_energy_pre_window) {
+  int32 frame_length = opts.WindowSize(),
+      frame_length_padded = opts.PaddedWindowSize();
+
+  if (window->Dim() != frame_length_padded)
+    window->Resize(frame_length_padded, kUndefined);
 
   SubVector<BaseFloat> frame(*window, 0, frame_length);
+  ExtractFrameSamples(sample_offset, wave, f, opts, &frame);
+
+  if (frame_length_padded > frame_length)
+    window->Range(frame_length, frame_length_padded - frame_length).SetZero();
 
   ProcessWindow(opts, window_function, &frame, log_energy_pre_window);
 }
 
+
+void ExtractWindows(int64 sample_offset,
+                    const VectorBase<BaseFloat> &wave,
+                    int32 first_frame,
+                    const FrameExtractionOptions &opts,
+                    const FeatureWindowFunction &window_function,
+                    MatrixBase<BaseFloat> *windows,
+                    VectorBase<BaseFloat> *log_energy_pre_window) {
+  int32 frame_length = opts.WindowSize(),
+      frame_length_padded = opts.PaddedWindowSize(),
+      num_frames = windows->NumRows();
+  KALDI_ASSERT(windows->NumCols() == frame_length_padded);
+
+  SubMatrix<BaseFloat> frames(*windows, 0, num_frames, 0, frame_length);
+  for (int32 r = 0; r < num_frames; r++) {
+    SubVector<BaseFloat> frame(frames, r);
+    ExtractFrameSamples(sample_offset, wave, first_frame + r, opts, &frame);
+  }
+
+  if (frame_length_padded > frame_length)
+    windows->ColRange(frame_length,
+                      frame_length_padded - frame_length).SetZero();
+
+  ProcessWindows(opts, window_function, &frames, log_energy_pre_window);
+}
+
 }  // namespace kaldi
@@ -182,6 +182,20 @@ void ProcessWindow(const FrameExtractionOptions &opts,
                    VectorBase<BaseFloat> *window,
                    BaseFloat *log_energy_pre_window = NULL);
 
+/**
+  This is as ProcessWindow(), but for several frames at once, which are the
+  rows of 'windows' (of dimension opts.WindowSize()).  The results are the
+  same as calling ProcessWindow() on each row in turn (including the dither,
+  which uses the random-number generator in the same order).
+   @param [out] log_energy_pre_window  If non-NULL, a vector of dimension
+      windows->NumRows(), to which the log-energies of the frames (see
+      ProcessWindow()) are written.
+ */
+void ProcessWindows(const FrameExtractionOptions &opts,
+                    const FeatureWindowFunction &window_function,
+                    MatrixBase<BaseFloat> *windows,
+                    VectorBase<BaseFloat> *log_energy_pre_window = NULL);
+
 
 /*
   ExtractWindow() extracts a windowed frame of waveform (possibly with a
@@ -215,6 +229,21 @@ void ExtractWindow(int64 sample_offset,
                    Vector<BaseFloat> *window,
                    BaseFloat *log_energy_pre_window = NULL);
 
+/*
+  ExtractWindows() is as ExtractWindow(), but it extracts the frames
+  first_frame, first_frame + 1, ... to the rows of 'windows', which must have
+  opts.PaddedWindowSize() columns; the processing is done by
+  ProcessWindows().  If 'log_energy_pre_window' is non-NULL it must have
+  dimension windows->NumRows().
+*/
+void ExtractWindows(int64 sample_offset,
+                    const VectorBase<BaseFloat> &wave,
+                    int32 first_frame,
+                    const FrameExtractionOptions &opts,
+                    const FeatureWindowFunction &window_function,
+                    MatrixBase<BaseFloat> *windows,
+                    VectorBase<BaseFloat> *log_energy_pre_window = NULL);
+
 
 /// @} End of "addtogroup feat"
 }  // namespace kaldi
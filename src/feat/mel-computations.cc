@@ -133,6 +133,13 @@ MelBanks::MelBanks(const MelBanksOptions &opts,
       bins_[bin].second(0) = 0.0;
 
   }
+  // The power spectrum has num_fft_bins + 1 elements, the last of which (at
+  // the Nyquist frequency) is never used.
+  weights_.Resize(num_bins, num_fft_bins + 1);
+  for (int32 bin = 0; bin < num_bins; bin++)
+    weights_.Row(bin).Range(bins_[bin].first,
+                            bins_[bin].second.Dim()).CopyFromVec(
+                                bins_[bin].second);
   if (debug_) {
     for (size_t i = 0; i < bins_.size(); i++) {
       KALDI_LOG << "bin " << i << ", offset = " << bins_[i].first
@@ -144,6 +151,7 @@ MelBanks::MelBanks(const MelBanksOptions &opts,
 MelBanks::MelBanks(const MelBanks &other):
     center_freqs_(other.center_freqs_),
     bins_(other.bins_),
+    weights_(other.weights_),
     debug_(other.debug_),
     htk_mode_(other.htk_mode_) { }
 
@@ -250,6 +258,32 @@ void MelBanks::Compute(const VectorBase<BaseFloat> &power_spectrum,
   }
 }
 
+void MelBanks::Compute(const MatrixBase<BaseFloat> &power_spectra,
+                       MatrixBase<BaseFloat> *mel_energies_out) const {
+  int32 num_bins = bins_.size(), num_frames = power_spectra.NumRows();
+  KALDI_ASSERT(power_spectra.NumCols() == weights_.NumCols() &&
+               mel_energies_out->NumRows() == num_frames &&
+               mel_energies_out->NumCols() == num_bins);
+
+  mel_energies_out->AddMatMat(1.0, power_spectra, kNoTrans,
+                              weights_, kTrans, 0.0);
+  // HTK-like flooring- for testing purposes (we prefer dither)
+  if (htk_mode_)
+    mel_energies_out->ApplyFloor(1.0);
+
+  // See the comment in the vector version of Compute().
+  KALDI_ASSERT(!KALDI_ISNAN(mel_energies_out->Sum()));
+
+  if (debug_) {
+    fprintf(stderr, "MEL BANKS:\n");
+    for (int32 r = 0; r < num_frames; r++) {
+      for (int32 i = 0; i < num_bins; i++)
+        fprintf(stderr, " %f", (*mel_energies_out)(r, i));
+      fprintf(stderr, "\n");
+    }
+  }
+}
+
 void ComputeLifterCoeffs(BaseFloat Q, VectorBase<BaseFloat> *coeffs) {
   // Compute liftering coefficients (scaling on cepstral coeffs)
   // coeffs are numbered slightly differently from HTK: the zeroth
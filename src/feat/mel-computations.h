@@ -111,6 +111,14 @@ class MelBanks {
   void Compute(const VectorBase<BaseFloat> &fft_energies,
                VectorBase<BaseFloat> *mel_energies_out) const;
 
+  /// This is as the other version of Compute(), but for several frames: the
+  /// rows of "power_spectra" (of dimension PaddedWindowSize() / 2 + 1) are
+  /// the FFT energies, and the rows of "mel_energies_out" (of dimension
+  /// NumBins()) are set to their Mel energies.  It does a single matrix
+  /// multiplication.
+  void Compute(const MatrixBase<BaseFloat> &power_spectra,
+               MatrixBase<BaseFloat> *mel_energies_out) const;
+
   int32 NumBins() const { return bins_.size(); }
 
   // returns vector of central freq of each bin; needed by plp code.
@@ -134,6 +142,10 @@ class MelBanks {
   // (the first nonzero fft-bin), (the vector of weights).
   std::vector<std::pair<int32, Vector<BaseFloat> > > bins_;
 
+  // The same weights as in bins_, as a matrix of dimension NumBins() by
+  // (num-fft-bins + 1), for the matrix version of Compute().
+  Matrix<BaseFloat> weights_;
+
   bool debug_;
   bool htk_mode_;
 };
@@ -53,6 +53,33 @@ void GetOutput(OnlineFeatureInterface *a,
   cache.ClearCache();
 }
 
+// Checks that GetFrames() gives the same output as GetFrame(), both for
+// chunks of consecutive frames (as in online decoding) and for frames in
+// random order.
+void CheckGetFrames(OnlineFeatureInterface *a) {
+  int32 num_frames = a->NumFramesReady(), dim = a->Dim();
+  KALDI_ASSERT(num_frames > 0);
+  std::vector<int32> frames;
+  int32 chunk_size = 1 + rand() % 30;
+  for (int32 start = 0; start < num_frames; start += chunk_size) {
+    frames.clear();
+    for (int32 t = start; t < std::min(start + chunk_size, num_frames); t++)
+      frames.push_back(t);
+    if (rand() % 2 == 0) std::reverse(frames.begin(), frames.end());
+    if (start > 0 && rand() % 2 == 0)
+      frames.push_back(start - 1);  // a repeat.
+    if (rand() % 5 == 0)
+      frames.push_back(rand() % num_frames);  // an outlier.
+    Matrix<BaseFloat> feats(frames.size(), dim);
+    a->GetFrames(frames, &feats);
+    Vector<BaseFloat> feat(dim);
+    for (size_t i = 0; i < frames.size(); i++) {
+      a->GetFrame(frames[i], &feat);
+      KALDI_ASSERT(feat.ApproxEqual(feats.Row(i)));
+    }
+  }
+}
+
 // Only generate random length for each piece
 bool RandomSplit(int32 wav_dim,
                  std::vector<int32> *piece_dim,
@@ -92,6 +119,22 @@ void TestOnlineMatrixCacheFeature() {
   Matrix<BaseFloat> output_feats;
   GetOutput(&matrix_feats, &output_feats);
   AssertEqual(input_feats, output_feats);
+
+  // A cache that only holds the most recent frames must give the same output
+  // whatever order we ask for the frames in.
+  OnlineCacheFeature bounded_cache(&matrix_feats, 1 + rand() % 20);
+  std::vector<int32> frames;
+  for (int32 i = 0; i < 2 * num_frames; i++)
+    frames.push_back(rand() % num_frames);
+  Vector<BaseFloat> feat(dim);
+  for (size_t i = 0; i < frames.size(); i++) {
+    bounded_cache.GetFrame(frames[i], &feat);
+    KALDI_ASSERT(feat.ApproxEqual(input_feats.Row(frames[i])));
+  }
+  Matrix<BaseFloat> some_feats(frames.size(), dim);
+  bounded_cache.GetFrames(frames, &some_feats);
+  for (size_t i = 0; i < frames.size(); i++)
+    KALDI_ASSERT(some_feats.Row(i).ApproxEqual(input_feats.Row(frames[i])));
 }
 
 void TestOnlineDeltaFeature() {
@@ -116,6 +159,41 @@ void TestOnlineDeltaFeature() {
   ComputeDeltas(opts, input_feats, &output_feats2);
 
   KALDI_ASSERT(output_feats1.ApproxEqual(output_feats2));
+  CheckGetFrames(&delta_feats);
+}
+
+void TestOnlineCmvn() {
+  int32 dim = 2 + rand() % 5;  // dimension of features.
+  int32 num_frames = 100 + rand() % 500;
+  OnlineCmvnOptions opts;
+  opts.cmn_window = 10 + rand() % 100;
+  opts.normalize_variance = (rand() % 2 == 0);
+  opts.modulus = 1 + rand() % 20;
+
+  Matrix<BaseFloat> input_feats(num_frames, dim);
+  input_feats.SetRandn();
+  OnlineMatrixFeature matrix_feats(input_feats);
+
+  OnlineCmvnState cmvn_state;
+  cmvn_state.global_cmvn_stats.Resize(2, dim + 1);
+  cmvn_state.global_cmvn_stats.Row(1).Set(10.0);
+  cmvn_state.global_cmvn_stats(0, dim) = 10.0;
+  OnlineCmvn cmvn(opts, cmvn_state, &matrix_feats);
+  Matrix<BaseFloat> output_feats;
+  GetOutput(&cmvn, &output_feats);  // accesses frames in order.
+
+  // Accessing frames in random order must give the same output.
+  OnlineCmvn cmvn2(opts, cmvn_state, &matrix_feats);
+  Vector<BaseFloat> feat(dim);
+  for (int32 i = 0; i < num_frames; i++) {
+    int32 t = rand() % num_frames;
+    cmvn2.GetFrame(t, &feat);
+    KALDI_ASSERT(feat.ApproxEqual(output_feats.Row(t)));
+  }
+
+  CheckGetFrames(&cmvn);
+  cmvn.Freeze(rand() % num_frames);
+  CheckGetFrames(&cmvn);
 }
 
 void TestOnlineSpliceFrames() {
@@ -141,6 +219,7 @@ void TestOnlineSpliceFrames() {
     &output_feats2);
 
   KALDI_ASSERT(output_feats1.ApproxEqual(output_feats2));
+  CheckGetFrames(&splice_frame);
 }
 
 void TestOnlineMfcc() {
@@ -195,6 +274,45 @@ void TestOnlineMfcc() {
   }
 }
 
+// Tests that the state of OnlineMfcc can be written part of the way through
+// the waveform and read into a new object, which carries on from there.
+void TestOnlineMfccState() {
+  std::ifstream is("../feat/test_data/test.wav", std::ios_base::binary);
+  WaveData wave;
+  wave.Read(is);
+  KALDI_ASSERT(wave.Data().NumRows() == 1);
+  SubVector<BaseFloat> waveform(wave.Data(), 0);
+
+  MfccOptions op;
+  op.frame_opts.dither = 0.0;
+  op.frame_opts.samp_freq = wave.SampFreq();
+  if (RandInt(0, 1) == 0)
+    op.frame_opts.snip_edges = false;
+  Mfcc mfcc(op);
+  Matrix<BaseFloat> mfcc_feats;
+  mfcc.Compute(waveform, 1.0, &mfcc_feats);
+
+  int32 split = RandInt(1, waveform.Dim() - 1);
+  OnlineMfcc online_mfcc(op);
+  online_mfcc.AcceptWaveform(wave.SampFreq(), waveform.Range(0, split));
+  bool binary = (RandInt(0, 1) == 0);
+  std::ostringstream os;
+  online_mfcc.WriteState(os, binary);
+
+  OnlineMfcc online_mfcc2(op);
+  std::istringstream is2(os.str());
+  online_mfcc2.ReadState(is2, binary);
+  KALDI_ASSERT(online_mfcc2.NumFramesReady() ==
+               online_mfcc.NumFramesReady());
+  online_mfcc2.AcceptWaveform(wave.SampFreq(),
+                              waveform.Range(split, waveform.Dim() - split));
+  online_mfcc2.InputFinished();
+
+  Matrix<BaseFloat> online_mfcc_feats;
+  GetOutput(&online_mfcc2, &online_mfcc_feats);
+  AssertEqual(mfcc_feats, online_mfcc_feats);
+}
+
 void TestOnlinePlp() {
   std::ifstream is("../feat/test_data/test.wav", std::ios_base::binary);
   WaveData wave;
@@ -285,6 +403,7 @@ void TestOnlineTransform() {
   }
 
   AssertEqual(trans_feats, output_feats);
+  CheckGetFrames(&online_trans);
 }
 
 void TestOnlineAppendFeature() {
@@ -372,6 +491,7 @@ void TestOnlineAppendFeature() {
             +std::abs(online_mfcc_plp_feats(i, mfcc_feats.NumCols() + k)))));
       }
     }
+    CheckGetFrames(&online_mfcc_plp);
   }
 }
 
@@ -414,6 +534,35 @@ void TestRecyclingVector() {
   }
 }
 
+void TestFrameRingBuffer() {
+  int32 dim = 1 + rand() % 3, frames_to_hold = 1 + rand() % 10;
+  FrameRingBuffer<BaseFloat> all_frames(dim),
+      recent_frames(dim, frames_to_hold);
+  for (int32 t = 0; t < 100; t++) {
+    all_frames.AddFrame(t).Set(t);
+    recent_frames.AddFrame(t).Set(t);
+  }
+  KALDI_ASSERT(all_frames.Size() == 100 && recent_frames.Size() == 100);
+  for (int32 t = 0; t < 100; t++) {
+    KALDI_ASSERT(all_frames.HasFrame(t) && all_frames.Frame(t)(0) == t);
+    // only the last frames_to_hold frames are held.
+    KALDI_ASSERT(recent_frames.HasFrame(t) == (t >= 100 - frames_to_hold));
+    if (recent_frames.HasFrame(t))
+      KALDI_ASSERT(recent_frames.Frame(t)(dim - 1) == t);
+  }
+  KALDI_ASSERT(!all_frames.HasFrame(100) && !all_frames.HasFrame(-1));
+
+  // Frames can be added out of order.
+  recent_frames.AddFrame(150).Set(150);
+  KALDI_ASSERT(recent_frames.Size() == 151 && recent_frames.HasFrame(150) &&
+               recent_frames.Frame(150)(0) == 150);
+  all_frames.AddFrame(3).Set(-3);
+  KALDI_ASSERT(all_frames.Frame(3)(0) == -3);
+
+  recent_frames.Clear();
+  KALDI_ASSERT(recent_frames.Size() == 0 && !recent_frames.HasFrame(150));
+}
+
 }  // end namespace kaldi
 
 int main() {
@@ -421,12 +570,15 @@ int main() {
   for (int i = 0; i < 10; i++) {
     TestOnlineMatrixCacheFeature();
     TestOnlineDeltaFeature();
+    TestOnlineCmvn();
     TestOnlineSpliceFrames();
     TestOnlineMfcc();
+    TestOnlineMfccState();
     TestOnlinePlp();
     TestOnlineTransform();
     TestOnlineAppendFeature();
     TestRecyclingVector();
+    TestFrameRingBuffer();
   }
   std::cout << "Test OK.\n";
 }
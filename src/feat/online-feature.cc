@@ -60,12 +60,80 @@ int RecyclingVector::Size() const {
   return first_available_index_ + items_.size();
 }
 
+void RecyclingVector::Write(std::ostream &os, bool binary) const {
+  WriteToken(os, binary, "<RecyclingVector>");
+  WriteBasicType(os, binary, static_cast<int32>(first_available_index_));
+  WriteBasicType(os, binary, static_cast<int32>(items_.size()));
+  for (size_t i = 0; i < items_.size(); i++)
+    items_[i]->Write(os, binary);
+  WriteToken(os, binary, "</RecyclingVector>");
+}
+
+void RecyclingVector::Read(std::istream &is, bool binary) {
+  for (auto *item : items_)
+    delete item;
+  items_.clear();
+  ExpectToken(is, binary, "<RecyclingVector>");
+  int32 first_available_index, num_items;
+  ReadBasicType(is, binary, &first_available_index);
+  ReadBasicType(is, binary, &num_items);
+  first_available_index_ = first_available_index;
+  for (int32 i = 0; i < num_items; i++) {
+    Vector<BaseFloat> *item = new Vector<BaseFloat>();
+    item->Read(is, binary);
+    PushBack(item);
+  }
+  ExpectToken(is, binary, "</RecyclingVector>");
+}
+
+template<typename Real>
+FrameRingBuffer<Real>::FrameRingBuffer(int32 dim, int32 frames_to_hold):
+    dim_(dim), frames_to_hold_(frames_to_hold > 0 ? frames_to_hold : -1),
+    size_(0) {
+  KALDI_ASSERT(dim >= 0);
+}
+
+template<typename Real>
+SubVector<Real> FrameRingBuffer<Real>::AddFrame(int32 frame) {
+  KALDI_ASSERT(frame >= 0);
+  int32 row = RowFor(frame);
+  if (row >= data_.NumRows()) {
+    // The storage is allocated on first use if we are a ring buffer, and
+    // otherwise grows geometrically so that adding frames in order takes
+    // amortized constant time.
+    int32 new_num_rows = (frames_to_hold_ > 0 ? frames_to_hold_ :
+                          std::max(row + 1, std::max(2 * data_.NumRows(), 16)));
+    data_.Resize(new_num_rows, dim_, kCopyData);
+    frame_index_.resize(new_num_rows, -1);
+  }
+  frame_index_[row] = frame;
+  size_ = std::max(size_, frame + 1);
+  return data_.Row(row);
+}
+
+template<typename Real>
+void FrameRingBuffer<Real>::Clear() {
+  std::fill(frame_index_.begin(), frame_index_.end(), -1);
+  size_ = 0;
+}
+
+template class FrameRingBuffer<float>;
+template class FrameRingBuffer<double>;
+
 template <class C>
 void OnlineGenericBaseFeature<C>::GetFrame(int32 frame,
                                            VectorBase<BaseFloat> *feat) {
   feat->CopyFromVec(*(features_.At(frame)));
 };
 
+template <class C>
+void OnlineGenericBaseFeature<C>::GetFrames(const std::vector<int32> &frames,
+                                            MatrixBase<BaseFloat> *feats) {
+  KALDI_ASSERT(static_cast<int32>(frames.size()) == feats->NumRows());
+  for (size_t i = 0; i < frames.size(); i++)
+    feats->Row(i).CopyFromVec(*(features_.At(frames[i])));
+}
+
 template <class C>
 OnlineGenericBaseFeature<C>::OnlineGenericBaseFeature(
     const typename C::Options &opts):
@@ -152,8 +220,45 @@ void OnlineGenericBaseFeature<C>::AcceptWaveform(
   ComputeFeatures();
 }
 
+template <class C>
+void OnlineGenericBaseFeature<C>::WriteState(std::ostream &os,
+                                            bool binary) const {
+  if (resampler_ != nullptr)
+    KALDI_ERR << "Writing the state of online feature extraction is not "
+              << "supported when the input is being resampled.";
+  WriteToken(os, binary, "<OnlineBaseFeatureState>");
+  WriteToken(os, binary, "<InputFinished>");
+  WriteBasicType(os, binary, input_finished_);
+  WriteToken(os, binary, "<WaveformOffset>");
+  WriteBasicType(os, binary, waveform_offset_);
+  WriteToken(os, binary, "<WaveformRemainder>");
+  waveform_remainder_.Write(os, binary);
+  WriteToken(os, binary, "<Features>");
+  features_.Write(os, binary);
+  WriteToken(os, binary, "</OnlineBaseFeatureState>");
+}
+
+template <class C>
+void OnlineGenericBaseFeature<C>::ReadState(std::istream &is, bool binary) {
+  resampler_.reset();
+  ExpectToken(is, binary, "<OnlineBaseFeatureState>");
+  ExpectToken(is, binary, "<InputFinished>");
+  ReadBasicType(is, binary, &input_finished_);
+  ExpectToken(is, binary, "<WaveformOffset>");
+  ReadBasicType(is, binary, &waveform_offset_);
+  ExpectToken(is, binary, "<WaveformRemainder>");
+  waveform_remainder_.Read(is, binary);
+  ExpectToken(is, binary, "<Features>");
+  features_.Read(is, binary);
+  ExpectToken(is, binary, "</OnlineBaseFeatureState>");
+  if (features_.Size() > 0 && features_.At(features_.Size() - 1)->Dim() !=
+      Dim())
+    KALDI_ERR << "Feature dimension mismatch reading online feature state.";
+}
+
 template <class C>
 void OnlineGenericBaseFeature<C>::ComputeFeatures() {
+  KALDI_TRACE_SCOPE("OnlineGenericBaseFeature::ComputeFeatures");
   const FrameExtractionOptions &frame_opts = computer_.GetFrameOptions();
   int64 num_samples_total = waveform_offset_ + waveform_remainder_.Dim();
   int32 num_frames_old = features_.Size(),
@@ -232,7 +337,11 @@ void OnlineCmvnState::Read(std::istream &is, bool binary) {
 OnlineCmvn::OnlineCmvn(const OnlineCmvnOptions &opts,
                        const OnlineCmvnState &cmvn_state,
                        OnlineFeatureInterface *src):
-    opts_(opts), temp_stats_(2, src->Dim() + 1),
+    opts_(opts), cached_stats_modulo_(2 * (src->Dim() + 1)),
+    cached_stats_ring_(2 * (src->Dim() + 1), opts.ring_buffer_size),
+    running_frame_(-1), running_stats_(2, src->Dim() + 1),
+    recent_feats_(src->Dim(), opts.cmn_window + 1),
+    temp_stats_(2, src->Dim() + 1),
     temp_feats_(src->Dim()), temp_feats_dbl_(src->Dim()),
     src_(src) {
   SetState(cmvn_state);
@@ -243,7 +352,11 @@ OnlineCmvn::OnlineCmvn(const OnlineCmvnOptions &opts,
 
 OnlineCmvn::OnlineCmvn(const OnlineCmvnOptions &opts,
                        OnlineFeatureInterface *src):
-    opts_(opts), temp_stats_(2, src->Dim() + 1),
+    opts_(opts), cached_stats_modulo_(2 * (src->Dim() + 1)),
+    cached_stats_ring_(2 * (src->Dim() + 1), opts.ring_buffer_size),
+    running_frame_(-1), running_stats_(2, src->Dim() + 1),
+    recent_feats_(src->Dim(), opts.cmn_window + 1),
+    temp_stats_(2, src->Dim() + 1),
     temp_feats_(src->Dim()), temp_feats_dbl_(src->Dim()),
     src_(src) {
   if (!SplitStringToIntegers(opts.skip_dims, ":", false, &skip_dims_))
@@ -256,109 +369,108 @@ void OnlineCmvn::GetMostRecentCachedFrame(int32 frame,
                                           int32 *cached_frame,
                                           MatrixBase<double> *stats) {
   KALDI_ASSERT(frame >= 0);
-  InitRingBufferIfNeeded();
   // look for a cached frame on a previous frame as close as possible in time
   // to "frame".  Return if we get one.
-  for (int32 t = frame; t >= 0 && t >= frame - opts_.ring_buffer_size; t--) {
-    if (t % opts_.modulus == 0) {
-      // if this frame should be cached in cached_stats_modulo_, then
-      // we'll look there, and we won't go back any further in time.
-      break;
-    }
-    int32 index = t % opts_.ring_buffer_size;
-    if (cached_stats_ring_[index].first == t) {
-      *cached_frame = t;
-      stats->CopyFromMat(cached_stats_ring_[index].second);
-      return;
+  if (opts_.ring_buffer_size > 0) {
+    for (int32 t = frame; t >= 0 && t >= frame - opts_.ring_buffer_size;
+         t--) {
+      if (t % opts_.modulus == 0) {
+        // if this frame should be cached in cached_stats_modulo_, then
+        // we'll look there, and we won't go back any further in time.
+        break;
+      }
+      if (cached_stats_ring_.HasFrame(t)) {
+        *cached_frame = t;
+        stats->CopyRowsFromVec(cached_stats_ring_.Frame(t));
+        return;
+      }
     }
   }
   int32 n = frame / opts_.modulus;
-  if (n >= cached_stats_modulo_.size()) {
-    if (cached_stats_modulo_.size() == 0) {
+  if (n >= cached_stats_modulo_.Size()) {
+    if (cached_stats_modulo_.Size() == 0) {
       *cached_frame = -1;
       stats->SetZero();
       return;
     } else {
-      n = static_cast<int32>(cached_stats_modulo_.size() - 1);
+      n = cached_stats_modulo_.Size() - 1;
     }
   }
   *cached_frame = n * opts_.modulus;
-  KALDI_ASSERT(cached_stats_modulo_[n] != NULL);
-  stats->CopyFromMat(*(cached_stats_modulo_[n]));
-}
-
-// Initialize ring buffer for caching stats.
-void OnlineCmvn::InitRingBufferIfNeeded() {
-  if (cached_stats_ring_.empty() && opts_.ring_buffer_size > 0) {
-    Matrix<double> temp(2, this->Dim() + 1);
-    cached_stats_ring_.resize(opts_.ring_buffer_size,
-                              std::pair<int32, Matrix<double> >(-1, temp));
-  }
+  stats->CopyRowsFromVec(cached_stats_modulo_.Frame(n));
 }
 
 void OnlineCmvn::CacheFrame(int32 frame, const MatrixBase<double> &stats) {
   KALDI_ASSERT(frame >= 0);
   if (frame % opts_.modulus == 0) {  // store in cached_stats_modulo_.
     int32 n = frame / opts_.modulus;
-    if (n >= cached_stats_modulo_.size()) {
+    if (n >= cached_stats_modulo_.Size()) {
       // The following assert is a limitation on in what order you can call
       // CacheFrame.  Fortunately the calling code always calls it in sequence,
       // which it has to because you need a previous frame to compute the
       // current one.
-      KALDI_ASSERT(n == cached_stats_modulo_.size());
-      cached_stats_modulo_.push_back(new Matrix<double>(stats));
+      KALDI_ASSERT(n == cached_stats_modulo_.Size());
     } else {
       KALDI_WARN << "Did not expect to reach this part of code.";
       // do what seems right, but we shouldn't get here.
-      cached_stats_modulo_[n]->CopyFromMat(stats);
-    }
-  } else {  // store in the ring buffer.
-    InitRingBufferIfNeeded();
-    if (!cached_stats_ring_.empty()) {
-      int32 index = frame % cached_stats_ring_.size();
-      cached_stats_ring_[index].first = frame;
-      cached_stats_ring_[index].second.CopyFromMat(stats);
     }
+    cached_stats_modulo_.AddFrame(n).CopyRowsFromMat(stats);
+  } else if (opts_.ring_buffer_size > 0) {  // store in the ring buffer.
+    cached_stats_ring_.AddFrame(frame).CopyRowsFromMat(stats);
   }
 }
 
-OnlineCmvn::~OnlineCmvn() {
-  for (size_t i = 0; i < cached_stats_modulo_.size(); i++)
-    delete cached_stats_modulo_[i];
-  cached_stats_modulo_.clear();
+void OnlineCmvn::AccStats(const VectorBase<BaseFloat> &feat, double weight,
+                          MatrixBase<double> *stats) {
+  int32 dim = this->Dim();
+  Vector<double> &feat_dbl(temp_feats_dbl_);
+  feat_dbl.CopyFromVec(feat);
+  stats->Row(0).Range(0, dim).AddVec(weight, feat_dbl);
+  if (opts_.normalize_variance)
+    stats->Row(1).Range(0, dim).AddVec2(weight, feat_dbl);
+  (*stats)(0, dim) += weight;
 }
 
 void OnlineCmvn::ComputeStatsForFrame(int32 frame,
-                                      MatrixBase<double> *stats_out) {
+                                      MatrixBase<double> *stats_out,
+                                      const VectorBase<BaseFloat> *frame_feat) {
   KALDI_ASSERT(frame >= 0 && frame < src_->NumFramesReady());
 
-  int32 dim = this->Dim(), cur_frame;
-  GetMostRecentCachedFrame(frame, &cur_frame, stats_out);
+  int32 cur_frame;
+  if (frame == running_frame_ || frame == running_frame_ + 1) {
+    // The usual case, where frames are requested in order.
+    cur_frame = running_frame_;
+    stats_out->CopyFromMat(running_stats_);
+  } else {
+    GetMostRecentCachedFrame(frame, &cur_frame, stats_out);
+  }
 
-  Vector<BaseFloat> &feats(temp_feats_);
-  Vector<double> &feats_dbl(temp_feats_dbl_);
   while (cur_frame < frame) {
     cur_frame++;
-    src_->GetFrame(cur_frame, &feats);
-    feats_dbl.CopyFromVec(feats);
-    stats_out->Row(0).Range(0, dim).AddVec(1.0, feats_dbl);
-    if (opts_.normalize_variance)
-      stats_out->Row(1).Range(0, dim).AddVec2(1.0, feats_dbl);
-    (*stats_out)(0, dim) += 1.0;
+    if (!recent_feats_.HasFrame(cur_frame)) {
+      SubVector<BaseFloat> feat(recent_feats_.AddFrame(cur_frame));
+      if (cur_frame == frame && frame_feat != NULL)
+        feat.CopyFromVec(*frame_feat);
+      else
+        src_->GetFrame(cur_frame, &feat);
+    }
+    AccStats(recent_feats_.Frame(cur_frame), 1.0, stats_out);
     // it's a sliding buffer; a frame at the back may be
     // leaving the buffer so we have to subtract that.
     int32 prev_frame = cur_frame - opts_.cmn_window;
     if (prev_frame >= 0) {
       // we need to subtract frame prev_f from the stats.
-      src_->GetFrame(prev_frame, &feats);
-      feats_dbl.CopyFromVec(feats);
-      stats_out->Row(0).Range(0, dim).AddVec(-1.0, feats_dbl);
-      if (opts_.normalize_variance)
-        stats_out->Row(1).Range(0, dim).AddVec2(-1.0, feats_dbl);
-      (*stats_out)(0, dim) -= 1.0;
+      if (recent_feats_.HasFrame(prev_frame)) {
+        AccStats(recent_feats_.Frame(prev_frame), -1.0, stats_out);
+      } else {
+        src_->GetFrame(prev_frame, &temp_feats_);
+        AccStats(temp_feats_, -1.0, stats_out);
+      }
     }
     CacheFrame(cur_frame, (*stats_out));
   }
+  running_frame_ = frame;
+  running_stats_.CopyFromMat(*stats_out);
 }
 
 
@@ -412,39 +524,72 @@ void OnlineCmvn::SmoothOnlineCmvnStats(const MatrixBase<double> &speaker_stats,
   }
 }
 
-void OnlineCmvn::GetFrame(int32 frame,
-                          VectorBase<BaseFloat> *feat) {
-  src_->GetFrame(frame, feat);
-  KALDI_ASSERT(feat->Dim() == this->Dim());
-  int32 dim = feat->Dim();
-  Matrix<double> &stats(temp_stats_);
-  stats.Resize(2, dim + 1, kUndefined);  // Will do nothing if size was correct.
+void OnlineCmvn::GetNormalizationStats(
+    int32 frame, MatrixBase<double> *stats,
+    const VectorBase<BaseFloat> *frame_feat) {
   if (frozen_state_.NumRows() != 0) {  // the CMVN state has been frozen.
-    stats.CopyFromMat(frozen_state_);
+    stats->CopyFromMat(frozen_state_);
   } else {
     // first get the raw CMVN stats (this involves caching..)
-    this->ComputeStatsForFrame(frame, &stats);
+    this->ComputeStatsForFrame(frame, stats, frame_feat);
     // now smooth them.
     SmoothOnlineCmvnStats(orig_state_.speaker_cmvn_stats,
                           orig_state_.global_cmvn_stats,
                           opts_,
-                          &stats);
+                          stats);
   }
 
   if (!skip_dims_.empty())
-    FakeStatsForSomeDims(skip_dims_, &stats);
+    FakeStatsForSomeDims(skip_dims_, stats);
+}
 
-  // call the function ApplyCmvn declared in ../transform/cmvn.h, which
-  // requires a matrix.
-  // 1 row; num-cols == dim; stride  == dim.
-  SubMatrix<BaseFloat> feat_mat(feat->Data(), 1, dim, dim);
-  // the function ApplyCmvn takes a matrix, so form a one-row matrix to give it.
+void OnlineCmvn::ApplyNormalization(const MatrixBase<double> &stats,
+                                    MatrixBase<BaseFloat> *feats) const {
+  // call the function ApplyCmvn declared in ../transform/cmvn.h.
   if (opts_.normalize_mean)
-    ApplyCmvn(stats, opts_.normalize_variance, &feat_mat);
+    ApplyCmvn(stats, opts_.normalize_variance, feats);
   else
     KALDI_ASSERT(!opts_.normalize_variance);
 }
 
+void OnlineCmvn::GetFrame(int32 frame,
+                          VectorBase<BaseFloat> *feat) {
+  src_->GetFrame(frame, feat);
+  KALDI_ASSERT(feat->Dim() == this->Dim());
+  int32 dim = feat->Dim();
+  Matrix<double> &stats(temp_stats_);
+  stats.Resize(2, dim + 1, kUndefined);  // Will do nothing if size was correct.
+  GetNormalizationStats(frame, &stats, feat);
+  // ApplyCmvn requires a matrix, so form a one-row matrix to give it.
+  // 1 row; num-cols == dim; stride  == dim.
+  SubMatrix<BaseFloat> feat_mat(feat->Data(), 1, dim, dim);
+  ApplyNormalization(stats, &feat_mat);
+}
+
+void OnlineCmvn::GetFrames(const std::vector<int32> &frames,
+                           MatrixBase<BaseFloat> *feats) {
+  int32 num_frames = frames.size(), dim = this->Dim();
+  KALDI_ASSERT(num_frames == feats->NumRows() && feats->NumCols() == dim);
+  if (num_frames == 0)
+    return;
+  src_->GetFrames(frames, feats);
+  Matrix<double> &stats(temp_stats_);
+  stats.Resize(2, dim + 1, kUndefined);  // Will do nothing if size was correct.
+  if (frozen_state_.NumRows() != 0) {
+    // All frames are normalized with the frozen state.
+    GetNormalizationStats(frames[0], &stats);
+    ApplyNormalization(stats, feats);
+  } else {
+    for (int32 i = 0; i < num_frames; i++) {
+      // Row i is still the input frame at this point.
+      SubVector<BaseFloat> feat(*feats, i);
+      GetNormalizationStats(frames[i], &stats, &feat);
+      SubMatrix<BaseFloat> feat_mat(*feats, i, 1, 0, dim);
+      ApplyNormalization(stats, &feat_mat);
+    }
+  }
+}
+
 void OnlineCmvn::Freeze(int32 cur_frame) {
   int32 dim = this->Dim();
   Matrix<double> stats(2, dim + 1);
@@ -481,7 +626,7 @@ void OnlineCmvn::GetState(int32 cur_frame,
 }
 
 void OnlineCmvn::SetState(const OnlineCmvnState &cmvn_state) {
-  KALDI_ASSERT(cached_stats_modulo_.empty() &&
+  KALDI_ASSERT(cached_stats_modulo_.Size() == 0 &&
                "You cannot call SetState() after processing data.");
   orig_state_ = cmvn_state;
   frozen_state_ = cmvn_state.frozen_state;
@@ -512,6 +657,42 @@ void OnlineSpliceFrames::GetFrame(int32 frame, VectorBase<BaseFloat> *feat) {
   }
 }
 
+void OnlineSpliceFrames::GetFrames(
+    const std::vector<int32> &frames, MatrixBase<BaseFloat> *feats) {
+  KALDI_ASSERT(left_context_ >= 0 && right_context_ >= 0);
+  KALDI_ASSERT(static_cast<int32>(frames.size()) == feats->NumRows() &&
+               feats->NumCols() == Dim());
+  int32 num_frames = frames.size(), dim_in = src_->Dim(),
+      num_frames_ready = NumFramesReady(), T = src_->NumFramesReady(),
+      context = 1 + left_context_ + right_context_;
+  if (num_frames == 0)
+    return;
+  // 'input_frames' is the sorted list of distinct input frames we need.
+  std::vector<int32> input_frames;
+  input_frames.reserve(num_frames + context - 1);
+  for (int32 i = 0; i < num_frames; i++) {
+    int32 frame = frames[i];
+    KALDI_ASSERT(frame >= 0 && frame < num_frames_ready);
+    for (int32 t2 = frame - left_context_; t2 <= frame + right_context_; t2++)
+      input_frames.push_back(std::max(0, std::min(t2, T - 1)));
+  }
+  SortAndUniq(&input_frames);
+  Matrix<BaseFloat> input_feats(input_frames.size(), dim_in, kUndefined);
+  src_->GetFrames(input_frames, &input_feats);
+
+  std::vector<MatrixIndexT> indexes(num_frames);
+  for (int32 n = 0; n < context; n++) {
+    for (int32 i = 0; i < num_frames; i++) {
+      int32 t2 = frames[i] - left_context_ + n,
+          t2_limited = std::max(0, std::min(t2, T - 1));
+      indexes[i] = std::lower_bound(input_frames.begin(), input_frames.end(),
+                                    t2_limited) - input_frames.begin();
+    }
+    SubMatrix<BaseFloat> part(*feats, 0, num_frames, n * dim_in, dim_in);
+    part.CopyRows(input_feats, &(indexes[0]));
+  }
+}
+
 OnlineTransform::OnlineTransform(const MatrixBase<BaseFloat> &transform,
                                  OnlineFeatureInterface *src):
     src_(src) {
@@ -591,23 +772,53 @@ void OnlineDeltaFeature::GetFrame(int32 frame,
 }
 
 
+void OnlineDeltaFeature::GetFrames(
+    const std::vector<int32> &frames, MatrixBase<BaseFloat> *feats) {
+  int32 num_frames = frames.size();
+  KALDI_ASSERT(num_frames == feats->NumRows() && feats->NumCols() == Dim());
+  if (num_frames == 0)
+    return;
+  int32 context = opts_.order * opts_.window,
+      src_frames_ready = src_->NumFramesReady(),
+      min_frame = *std::min_element(frames.begin(), frames.end()),
+      max_frame = *std::max_element(frames.begin(), frames.end()),
+      left_frame = std::max(0, min_frame - context),
+      right_frame = std::min(src_frames_ready - 1, max_frame + context),
+      temp_num_frames = right_frame + 1 - left_frame;
+  if (temp_num_frames > 2 * (num_frames + 2 * context)) {
+    // The frames are too spread out for it to be worth getting all the input
+    // frames in between.
+    OnlineFeatureInterface::GetFrames(frames, feats);
+    return;
+  }
+  KALDI_ASSERT(min_frame >= 0 && max_frame < NumFramesReady());
+  // The input frames that all of 'frames' need.  DeltaFeatures::Process()
+  // treats the edges of this matrix as the edges of the input; that is
+  // correct because, for each frame, the context is either all inside it or
+  // is truncated by the real edges of the input.
+  std::vector<int32> input_frames(temp_num_frames);
+  for (int32 t = left_frame; t <= right_frame; t++)
+    input_frames[t - left_frame] = t;
+  Matrix<BaseFloat> temp_src(temp_num_frames, src_->Dim(), kUndefined);
+  src_->GetFrames(input_frames, &temp_src);
+  for (int32 i = 0; i < num_frames; i++) {
+    SubVector<BaseFloat> feat(*feats, i);
+    delta_features_.Process(temp_src, frames[i] - left_frame, &feat);
+  }
+}
+
 OnlineDeltaFeature::OnlineDeltaFeature(const DeltaFeaturesOptions &opts,
                                        OnlineFeatureInterface *src):
     src_(src), opts_(opts), delta_features_(opts) { }
 
 void OnlineCacheFeature::GetFrame(int32 frame, VectorBase<BaseFloat> *feat) {
   KALDI_ASSERT(frame >= 0);
-  if (static_cast<size_t>(frame) < cache_.size() && cache_[frame] != NULL) {
-    feat->CopyFromVec(*(cache_[frame]));
-  } else {
-    if (static_cast<size_t>(frame) >= cache_.size())
-      cache_.resize(frame + 1, NULL);
-    int32 dim = this->Dim();
-    cache_[frame] = new Vector<BaseFloat>(dim);
+  if (!cache_.HasFrame(frame)) {
+    SubVector<BaseFloat> cached_feat(cache_.AddFrame(frame));
     // The following call will crash if frame "frame" is not ready.
-    src_->GetFrame(frame, cache_[frame]);
-    feat->CopyFromVec(*(cache_[frame]));
+    src_->GetFrame(frame, &cached_feat);
   }
+  feat->CopyFromVec(cache_.Frame(frame));
 }
 
 void OnlineCacheFeature::GetFrames(
@@ -623,8 +834,8 @@ void OnlineCacheFeature::GetFrames(
   non_cached_indexes.reserve(frames.size());
   for (int32 i = 0; i < num_frames; i++) {
     int32 t = frames[i];
-    if (static_cast<size_t>(t) < cache_.size() && cache_[t] != NULL) {
-      feats->Row(i).CopyFromVec(*(cache_[t]));
+    if (cache_.HasFrame(t)) {
+      feats->Row(i).CopyFromVec(cache_.Frame(t));
     } else {
       non_cached_frames.push_back(t);
       non_cached_indexes.push_back(i);
@@ -639,24 +850,16 @@ void OnlineCacheFeature::GetFrames(
   src_->GetFrames(non_cached_frames, &non_cached_feats);
   for (int32 i = 0; i < num_non_cached_frames; i++) {
     int32 t = non_cached_frames[i];
-    if (static_cast<size_t>(t) < cache_.size() && cache_[t] != NULL) {
-      // We can reach this point due to repeat indexes in 'non_cached_frames'.
-      feats->Row(non_cached_indexes[i]).CopyFromVec(*(cache_[t]));
-    } else {
-      SubVector<BaseFloat> this_feat(non_cached_feats, i);
-      feats->Row(non_cached_indexes[i]).CopyFromVec(this_feat);
-      if (static_cast<size_t>(t) >= cache_.size())
-        cache_.resize(t + 1, NULL);
-      cache_[t] = new Vector<BaseFloat>(this_feat);
-    }
+    SubVector<BaseFloat> this_feat(non_cached_feats, i);
+    feats->Row(non_cached_indexes[i]).CopyFromVec(this_feat);
+    // If 't' is repeated in 'non_cached_frames' this just caches it again.
+    cache_.AddFrame(t).CopyFromVec(this_feat);
   }
 }
 
 
 void OnlineCacheFeature::ClearCache() {
-  for (size_t i = 0; i < cache_.size(); i++)
-    delete cache_[i];
-  cache_.resize(0);
+  cache_.Clear();
 }
 
 
@@ -669,5 +872,15 @@ void OnlineAppendFeature::GetFrame(int32 frame, VectorBase<BaseFloat> *feat) {
   src2_->GetFrame(frame, &feat2);
 };
 
+void OnlineAppendFeature::GetFrames(const std::vector<int32> &frames,
+                                    MatrixBase<BaseFloat> *feats) {
+  KALDI_ASSERT(static_cast<int32>(frames.size()) == feats->NumRows() &&
+               feats->NumCols() == Dim());
+  SubMatrix<BaseFloat> feats1(feats->ColRange(0, src1_->Dim())),
+      feats2(feats->ColRange(src1_->Dim(), src2_->Dim()));
+  src1_->GetFrames(frames, &feats1);
+  src2_->GetFrames(frames, &feats2);
+}
+
 
 }  // namespace kaldi
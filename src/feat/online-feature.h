@@ -62,6 +62,13 @@ public:
   /// i.e. equivalent to the number of times the PushBack method has been called.
   int Size() const;
 
+  /// Writes the items currently held, and the index of the first of them.
+  void Write(std::ostream &os, bool binary) const;
+
+  /// Reads what Write() wrote, replacing the current contents; the
+  /// items_to_hold setting is not changed.
+  void Read(std::istream &is, bool binary);
+
   ~RecyclingVector();
 
 private:
@@ -71,6 +78,61 @@ private:
 };
 
 
+/// This class stores frames (fixed-dimension vectors such as feature vectors
+/// or flattened statistics) indexed by frame number, in one contiguous matrix
+/// so that there is no per-frame allocation.  If frames_to_hold > 0 it is a
+/// ring buffer: frame t is stored in row t % frames_to_hold, replacing
+/// whichever frame was there before, so memory is bounded and the most recent
+/// frames_to_hold frames are always available.  Otherwise it grows so as to
+/// hold every frame that was added.  Frames may be added in any order.
+template<typename Real>
+class FrameRingBuffer {
+ public:
+  /// By default it holds all frames.
+  explicit FrameRingBuffer(int32 dim, int32 frames_to_hold = -1);
+
+  /// Returns true if frame 'frame' is currently held.
+  bool HasFrame(int32 frame) const {
+    int32 row = RowFor(frame);
+    return frame >= 0 && row < static_cast<int32>(frame_index_.size()) &&
+        frame_index_[row] == frame;
+  }
+
+  /// Returns frame 'frame', which must currently be held.  The returned
+  /// vector is only valid until the next call to AddFrame() or Clear().
+  const SubVector<Real> Frame(int32 frame) const {
+    KALDI_ASSERT(HasFrame(frame));
+    return data_.Row(RowFor(frame));
+  }
+
+  /// Returns storage for frame 'frame', which the caller should fill in;
+  /// any frame previously held in the same row is forgotten.  The returned
+  /// vector is only valid until the next call to AddFrame() or Clear().
+  SubVector<Real> AddFrame(int32 frame);
+
+  /// Returns one plus the largest frame index that was added since
+  /// construction or the last Clear(), as if nothing had been forgotten.
+  int32 Size() const { return size_; }
+
+  int32 Dim() const { return dim_; }
+
+  /// Forgets all frames (but keeps the memory).
+  void Clear();
+
+ private:
+  int32 RowFor(int32 frame) const {
+    return frames_to_hold_ > 0 ? frame % frames_to_hold_ : frame;
+  }
+
+  int32 dim_;
+  int32 frames_to_hold_;
+  int32 size_;
+  Matrix<Real> data_;
+  std::vector<int32> frame_index_;  // The frame held in each row of data_,
+                                    // or -1.
+};
+
+
 /// This is a templated class for online feature extraction;
 /// it's templated on a class like MfccComputer or PlpComputer
 /// that does the basic feature extraction.
@@ -95,6 +157,9 @@ class OnlineGenericBaseFeature: public OnlineBaseFeature {
 
   virtual void GetFrame(int32 frame, VectorBase<BaseFloat> *feat);
 
+  virtual void GetFrames(const std::vector<int32> &frames,
+                         MatrixBase<BaseFloat> *feats);
+
   // Next, functions that are not in the interface.
 
 
@@ -115,6 +180,17 @@ class OnlineGenericBaseFeature: public OnlineBaseFeature {
   // affects the return value of IsLastFrame().
   virtual void InputFinished();
 
+  // Writes the state of the feature extraction: the features computed so far
+  // (those still held, if --max-feature-vectors is set) and the part of the
+  // waveform not yet consumed.  A new object with the same options can then
+  // carry on from that point after ReadState(), e.g. in another process, with
+  // the same output as this one would give.  Not supported if the input is
+  // being resampled.
+  void WriteState(std::ostream &os, bool binary) const;
+
+  // Reads the state written by WriteState(), replacing the current state.
+  void ReadState(std::istream &is, bool binary);
+
  private:
   // This function computes any additional feature frames that it is possible to
   // compute from 'waveform_remainder_', which at this point may contain more
@@ -182,6 +258,12 @@ class OnlineMatrixFeature: public OnlineFeatureInterface {
     feat->CopyFromVec(mat_.Row(frame));
   }
 
+  virtual void GetFrames(const std::vector<int32> &frames,
+                         MatrixBase<BaseFloat> *feats) {
+    KALDI_ASSERT(static_cast<int32>(frames.size()) == feats->NumRows());
+    feats->CopyRows(mat_, frames.data());
+  }
+
   virtual bool IsLastFrame(int32 frame) const {
     return (frame + 1 == mat_.NumRows());
   }
@@ -338,6 +420,12 @@ class OnlineCmvn: public OnlineFeatureInterface {
 
   virtual void GetFrame(int32 frame, VectorBase<BaseFloat> *feat);
 
+  /// Gets the input frames from the source in one block; if the CMVN state
+  /// has been frozen, the normalization is applied to the whole block at
+  /// once.
+  virtual void GetFrames(const std::vector<int32> &frames,
+                         MatrixBase<BaseFloat> *feats);
+
   //
   // Next, functions that are not in the interface.
   //
@@ -385,7 +473,7 @@ class OnlineCmvn: public OnlineFeatureInterface {
   // utterance's CMVN object.
   void Freeze(int32 cur_frame);
 
-  virtual ~OnlineCmvn();
+  virtual ~OnlineCmvn() { }
  private:
 
   /// Smooth the CMVN stats "stats" (which are stored in the normal format as a
@@ -406,14 +494,31 @@ class OnlineCmvn: public OnlineFeatureInterface {
   /// Cache this frame of stats.
   void CacheFrame(int32 frame, const MatrixBase<double> &stats);
 
-  /// Initialize ring buffer for caching stats.
-  inline void InitRingBufferIfNeeded();
-
   /// Computes the raw CMVN stats for this frame, making use of (and updating if
   /// necessary) the cached statistics in raw_stats_.  This means the (x,
-  /// x^2, count) stats for the last up to opts_.cmn_window frames.
+  /// x^2, count) stats for the last up to opts_.cmn_window frames.  When
+  /// frames are requested in order this just updates the running stats,
+  /// which takes constant time and reads no input other than frame 'frame'
+  /// itself; the caller may supply that as 'frame_feat' if it has it.
   void ComputeStatsForFrame(int32 frame,
-                            MatrixBase<double> *stats);
+                            MatrixBase<double> *stats,
+                            const VectorBase<BaseFloat> *frame_feat = NULL);
+
+  /// Adds the (x, x^2, count) stats of input frame 'feat' to 'stats', times
+  /// 'weight' (1 or -1).
+  void AccStats(const VectorBase<BaseFloat> &feat, double weight,
+                MatrixBase<double> *stats);
+
+  /// Sets 'stats' to the stats that GetFrame(frame) normalizes with, i.e. the
+  /// frozen state, or else the smoothed stats for this frame; dimensions in
+  /// skip_dims_ are given stats that leave them unchanged.  'frame_feat' is
+  /// as for ComputeStatsForFrame().
+  void GetNormalizationStats(int32 frame, MatrixBase<double> *stats,
+                             const VectorBase<BaseFloat> *frame_feat = NULL);
+
+  /// Applies the normalization with 'stats' to 'feats' (any number of rows).
+  void ApplyNormalization(const MatrixBase<double> &stats,
+                          MatrixBase<BaseFloat> *feats) const;
 
 
   OnlineCmvnOptions opts_;
@@ -425,13 +530,24 @@ class OnlineCmvn: public OnlineFeatureInterface {
                                  // at.
 
   // The variable below reflects the raw (count, x, x^2) statistics of the
-  // input, computed every opts_.modulus frames.  raw_stats_[n / opts_.modulus]
+  // input, computed every opts_.modulus frames.  Its frame n / opts_.modulus
   // contains the (count, x, x^2) statistics for the frames from
-  // std::max(0, n - opts_.cmn_window) through n.
-  std::vector<Matrix<double>*> cached_stats_modulo_;
-  // the variable below is a ring-buffer of cached stats.  the int32 is the
-  // frame index.
-  std::vector<std::pair<int32, Matrix<double> > > cached_stats_ring_;
+  // std::max(0, n - opts_.cmn_window) through n, as a 2 x (dim+1) matrix
+  // flattened row by row.
+  FrameRingBuffer<double> cached_stats_modulo_;
+  // the variable below is a ring-buffer of cached stats for the other frames,
+  // flattened in the same way; it holds opts_.ring_buffer_size frames.
+  FrameRingBuffer<double> cached_stats_ring_;
+
+  // The raw stats for frame running_frame_ (initially -1, with zero stats),
+  // which are what ComputeStatsForFrame() carries on from when frames are
+  // requested in order.
+  int32 running_frame_;
+  Matrix<double> running_stats_;
+  // The most recent input frames: the cmn_window + 1 frames up to and
+  // including running_frame_ in the sequential case, so that the frame that
+  // leaves the window does not have to be obtained from src_ again.
+  FrameRingBuffer<BaseFloat> recent_feats_;
 
   // Some temporary variables used inside functions of this class, which
   // put here to avoid reallocation.
@@ -475,6 +591,11 @@ class OnlineSpliceFrames: public OnlineFeatureInterface {
 
   virtual void GetFrame(int32 frame, VectorBase<BaseFloat> *feat);
 
+  /// Gets each input frame that is needed from 'src' once, in one block,
+  /// and then builds the output with one row-copy per context position.
+  virtual void GetFrames(const std::vector<int32> &frames,
+                         MatrixBase<BaseFloat> *feats);
+
   //
   // Next, functions that are not in the interface.
   //
@@ -545,6 +666,11 @@ class OnlineDeltaFeature: public OnlineFeatureInterface {
 
   virtual void GetFrame(int32 frame, VectorBase<BaseFloat> *feat);
 
+  /// If 'frames' are close together (the usual case), gets the input frames
+  /// they need from 'src' in one block.
+  virtual void GetFrames(const std::vector<int32> &frames,
+                         MatrixBase<BaseFloat> *feats);
+
   //
   // Next, functions that are not in the interface.
   //
@@ -579,18 +705,22 @@ class OnlineCacheFeature: public OnlineFeatureInterface {
   virtual void GetFrames(const std::vector<int32> &frames,
                          MatrixBase<BaseFloat> *feats);
 
-  virtual ~OnlineCacheFeature() { ClearCache(); }
-
   // Things that are not in the shared interface:
 
   void ClearCache();  // this should be called if you change the underlying
                       // features in some way.
 
-  explicit OnlineCacheFeature(OnlineFeatureInterface *src): src_(src) { }
+  /// If frames_to_cache > 0, only the most recent frames are cached (frame t
+  /// replaces frame t - frames_to_cache), which bounds the memory used for
+  /// long inputs; frames that were dropped are recomputed from 'src' if they
+  /// are requested again.  By default all frames are cached.
+  explicit OnlineCacheFeature(OnlineFeatureInterface *src,
+                              int32 frames_to_cache = -1):
+      src_(src), cache_(src->Dim(), frames_to_cache) { }
  private:
 
   OnlineFeatureInterface *src_;  // Not owned here
-  std::vector<Vector<BaseFloat>* > cache_;
+  FrameRingBuffer<BaseFloat> cache_;
 };
 
 
@@ -616,6 +746,9 @@ class OnlineAppendFeature: public OnlineFeatureInterface {
 
   virtual void GetFrame(int32 frame, VectorBase<BaseFloat> *feat);
 
+  virtual void GetFrames(const std::vector<int32> &frames,
+                         MatrixBase<BaseFloat> *feats);
+
   virtual ~OnlineAppendFeature() {  }
 
   OnlineAppendFeature(OnlineFeatureInterface *src1,
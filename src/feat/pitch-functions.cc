@@ -98,26 +98,44 @@ BaseFloat NccfToPov(BaseFloat n) {
    e1 is the dot-product of the un-shifted window with itself,
    and d2 is the dot-product of the window shifted by "lag"
    with itself.
+   The dot-products for all the lags are done as one matrix-vector product
+   with the shifted windows as the rows of "shifted_windows", which is a
+   workspace (resized as needed) so that we don't reallocate it for each
+   frame; and the e2 values come from running sums of squares.
  */
 void ComputeCorrelation(const VectorBase<BaseFloat> &wave,
                         int32 first_lag, int32 last_lag,
                         int32 nccf_window_size,
                         VectorBase<BaseFloat> *inner_prod,
-                        VectorBase<BaseFloat> *norm_prod) {
+                        VectorBase<BaseFloat> *norm_prod,
+                        Matrix<BaseFloat> *shifted_windows) {
   Vector<BaseFloat> zero_mean_wave(wave);
   // TODO: possibly fix this, the mean normalization is done in a strange way.
   SubVector<BaseFloat> wave_part(wave, 0, nccf_window_size);
   // subtract mean-frame from wave
   zero_mean_wave.Add(-wave_part.Sum() / nccf_window_size);
-  BaseFloat e1, e2, sum;
+  int32 num_lags = last_lag - first_lag + 1;
+  if (shifted_windows->NumRows() != num_lags ||
+      shifted_windows->NumCols() != nccf_window_size)
+    shifted_windows->Resize(num_lags, nccf_window_size, kUndefined);
+  for (int32 lag = first_lag; lag <= last_lag; lag++)
+    shifted_windows->Row(lag - first_lag).CopyFromVec(
+        SubVector<BaseFloat>(zero_mean_wave, lag, nccf_window_size));
   SubVector<BaseFloat> sub_vec1(zero_mean_wave, 0, nccf_window_size);
-  e1 = VecVec(sub_vec1, sub_vec1);
+  inner_prod->AddMatVec(1.0, *shifted_windows, kNoTrans, sub_vec1, 0.0);
+
+  const BaseFloat *data = zero_mean_wave.Data();
+  BaseFloat e1 = VecVec(sub_vec1, sub_vec1);
+  double e2 = 0.0;  // Double, as it accumulates over the lags.
+  for (int32 i = first_lag; i < first_lag + nccf_window_size; i++)
+    e2 += static_cast<double>(data[i]) * data[i];
   for (int32 lag = first_lag; lag <= last_lag; lag++) {
-    SubVector<BaseFloat> sub_vec2(zero_mean_wave, lag, nccf_window_size);
-    e2 = VecVec(sub_vec2, sub_vec2);
-    sum = VecVec(sub_vec1, sub_vec2);
-    (*inner_prod)(lag - first_lag) = sum;
-    (*norm_prod)(lag - first_lag) = e1 * e2;
+    if (lag > first_lag) {
+      double removed = data[lag - 1],
+          added = data[lag + nccf_window_size - 1];
+      e2 += added * added - removed * removed;
+    }
+    (*norm_prod)(lag - first_lag) = e1 * static_cast<BaseFloat>(e2);
   }
 }
 
@@ -135,8 +153,9 @@ void ComputeNccf(const VectorBase<BaseFloat> &inner_prod,
   KALDI_ASSERT(inner_prod.Dim() == norm_prod.Dim() &&
                inner_prod.Dim() == nccf_vec->Dim());
   for (int32 lag = 0; lag < inner_prod.Dim(); lag++) {
+    // Note: std::sqrt() gives the same result as pow(.., 0.5), faster.
     BaseFloat numerator = inner_prod(lag),
-        denominator = pow(norm_prod(lag) + nccf_ballast, 0.5),
+        denominator = std::sqrt(norm_prod(lag) + nccf_ballast),
         nccf;
     if (denominator != 0.0) {
       nccf = numerator / denominator;
@@ -1089,6 +1108,7 @@ void OnlinePitchFeatureImpl::AcceptWaveform(
   Vector<BaseFloat> window(full_frame_length),
       inner_prod(num_measured_lags),
       norm_prod(num_measured_lags);
+  Matrix<BaseFloat> shifted_windows;  // Workspace for ComputeCorrelation().
   Matrix<BaseFloat> nccf_pitch(num_new_frames, num_measured_lags),
       nccf_pov(num_new_frames, num_measured_lags);
 
@@ -1137,7 +1157,8 @@ void OnlinePitchFeatureImpl::AcceptWaveform(
         pow(cur_sum / cur_num_samp, 2.0);
 
     ComputeCorrelation(window, nccf_first_lag_, nccf_last_lag_,
-                       basic_frame_length, &inner_prod, &norm_prod);
+                       basic_frame_length, &inner_prod, &norm_prod,
+                       &shifted_windows);
     double nccf_ballast_pov = 0.0,
         nccf_ballast_pitch = pow(mean_square * basic_frame_length, 2) *
              opts_.nccf_ballast,
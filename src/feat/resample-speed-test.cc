@@ -0,0 +1,81 @@
+// feat/resample-speed-test.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "feat/resample.h"
+#include "base/timer.h"
+#include <iostream>
+
+namespace kaldi {
+
+// Resamples 'num_seconds' of noise from samp_rate_in to samp_rate_out with
+// the filter of ResampleWaveform(), in pieces of 'chunk_ms' milliseconds (or
+// all at once if chunk_ms <= 0), and returns the time taken.
+static double TimeLinearResample(int32 samp_rate_in, int32 samp_rate_out,
+                                 BaseFloat chunk_ms, BaseFloat num_seconds,
+                                 double *checksum) {
+  BaseFloat cutoff = 0.99 * 0.5 * std::min(samp_rate_in, samp_rate_out);
+  LinearResample resampler(samp_rate_in, samp_rate_out, cutoff, 6);
+  Vector<BaseFloat> wave(static_cast<int32>(num_seconds * samp_rate_in));
+  wave.SetRandn();
+  int32 chunk_size = (chunk_ms <= 0.0 ? wave.Dim() :
+                      static_cast<int32>(chunk_ms * samp_rate_in / 1000.0));
+  Vector<BaseFloat> output;
+  double sum = 0.0;
+  Timer timer;
+  for (int32 offset = 0; offset < wave.Dim(); offset += chunk_size) {
+    int32 this_size = std::min(chunk_size, wave.Dim() - offset);
+    bool flush = (offset + this_size == wave.Dim());
+    resampler.Resample(wave.Range(offset, this_size), flush, &output);
+    sum += output.Sum();
+  }
+  *checksum = sum;
+  return timer.Elapsed();
+}
+
+static void TestLinearResampleSpeed() {
+  int32 rates[][2] = { { 8000, 16000 }, { 16000, 8000 }, { 44100, 16000 },
+                       { 48000, 16000 }, { 22050, 16000 } };
+  BaseFloat chunk_sizes[] = { 10.0, 100.0, 0.0 };
+  BaseFloat num_seconds = 60.0;
+  for (size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+    for (size_t j = 0; j < sizeof(chunk_sizes) / sizeof(BaseFloat); j++) {
+      double checksum;
+      double time = TimeLinearResample(rates[i][0], rates[i][1],
+                                       chunk_sizes[j], num_seconds, &checksum);
+      KALDI_LOG << "Resampling " << num_seconds << " seconds from "
+                << rates[i][0] << " to " << rates[i][1] << " Hz in "
+                << (chunk_sizes[j] > 0.0 ? "pieces of " : "one piece")
+                << (chunk_sizes[j] > 0.0 ?
+                    std::to_string(static_cast<int32>(chunk_sizes[j])) +
+                    " ms" : "")
+                << " took " << time << " seconds (real-time factor "
+                << time / num_seconds << ")";
+      // We print the checksum so that the computation can't be optimized
+      // away.
+      KALDI_VLOG(2) << "Checksum is " << checksum;
+    }
+  }
+}
+
+}  // end namespace kaldi
+
+int main() {
+  kaldi::TestLinearResampleSpeed();
+  std::cout << "Test OK.\n";
+}
@@ -275,6 +275,50 @@ void UnitTestLinearResample2() {
   AssertEqual(self1, cross, 0.001);
 }
 
+// Checks that resampling the whole signal at once, which for these sample
+// rates uses the polyphase code, gives the same result as resampling it in
+// small pieces, which uses the per-sample code, and in random larger pieces.
+void UnitTestLinearResamplePolyphase() {
+  int32 rates[] = { 8000, 11025, 16000, 22050, 44100, 48000 };
+  int32 num_rates = sizeof(rates) / sizeof(int32),
+      samp_freq = rates[RandInt(0, num_rates - 1)],
+      resamp_freq = rates[RandInt(0, num_rates - 1)];
+  BaseFloat lowpass_freq = 0.99 * 0.5 * std::min(samp_freq, resamp_freq);
+  int32 num_zeros = RandInt(1, 10);
+  Vector<BaseFloat> test_signal(RandInt(0, 20000));
+  test_signal.SetRandn();
+
+  LinearResample linear_resampler(samp_freq, resamp_freq,
+                                  lowpass_freq, num_zeros);
+  Vector<BaseFloat> resampled_vec;
+  linear_resampler.Resample(test_signal, true, &resampled_vec);
+
+  for (int32 max_piece_size = 10; max_piece_size <= 10000;
+       max_piece_size *= 1000) {
+    Vector<BaseFloat> resampled_vec2;
+    int32 input_dim_seen = 0;
+    while (input_dim_seen < test_signal.Dim()) {
+      int32 dim_remaining = test_signal.Dim() - input_dim_seen;
+      int32 piece_size = RandInt(0, std::min(dim_remaining, max_piece_size));
+      SubVector<BaseFloat> in_piece(test_signal, input_dim_seen, piece_size);
+      Vector<BaseFloat> out_piece;
+      bool flush = (piece_size == dim_remaining);
+      linear_resampler.Resample(in_piece, flush, &out_piece);
+      int32 old_output_dim = resampled_vec2.Dim();
+      resampled_vec2.Resize(old_output_dim + out_piece.Dim(), kCopyData);
+      resampled_vec2.Range(old_output_dim, out_piece.Dim())
+                    .CopyFromVec(out_piece);
+      input_dim_seen += piece_size;
+    }
+    KALDI_ASSERT(resampled_vec2.Dim() == resampled_vec.Dim());
+    if (!ApproxEqual(resampled_vec, resampled_vec2)) {
+      KALDI_LOG << "LinearResample: " << resampled_vec;
+      KALDI_LOG << "LinearResample[broken-up]: " << resampled_vec2;
+      KALDI_ERR << "Signals differ.";
+    }
+  }
+}
+
 int main() {
   try {
     for (int32 x = 0; x < 50; x++)
@@ -283,6 +327,8 @@ int main() {
       UnitTestLinearResample2();    
     for (int32 x = 0; x < 50; x++)
       UnitTestArbitraryResample();
+    for (int32 x = 0; x < 20; x++)
+      UnitTestLinearResamplePolyphase();
 
     KALDI_LOG << "Tests succeeded.\n";
     return 0;
@@ -104,6 +104,7 @@ int64 LinearResample::GetNumOutputSamples(int64 input_num_samp,
 void LinearResample::SetIndexesAndWeights() {
   first_index_.resize(output_samples_in_unit_);
   weights_.resize(output_samples_in_unit_);
+  max_num_weights_ = 0;
 
   double window_width = num_zeros_ / (2.0 * filter_cutoff_);
 
@@ -122,6 +123,7 @@ void LinearResample::SetIndexesAndWeights() {
         num_indices = max_input_index - min_input_index + 1;
     first_index_[i] = min_input_index;
     weights_[i].Resize(num_indices);
+    max_num_weights_ = std::max(max_num_weights_, num_indices);
     for (int32 j = 0; j < num_indices; j++) {
       int32 input_index = min_input_index + j;
       double input_t = input_index / static_cast<double>(samp_rate_in_),
@@ -160,44 +162,52 @@ void LinearResample::Resample(const VectorBase<BaseFloat> &input,
 
   output->Resize(tot_output_samp - output_sample_offset_);
 
-  // samp_out is the index into the total output signal, not just the part
-  // of it we are producing here.
-  for (int64 samp_out = output_sample_offset_;
-       samp_out < tot_output_samp;
-       samp_out++) {
-    int64 first_samp_in;
-    int32 samp_out_wrapped;
-    GetIndexes(samp_out, &first_samp_in, &samp_out_wrapped);
-    const Vector<BaseFloat> &weights = weights_[samp_out_wrapped];
-    // first_input_index is the first index into "input" that we have a weight
-    // for.
-    int32 first_input_index = static_cast<int32>(first_samp_in -
-                                                 input_sample_offset_);
-    BaseFloat this_output;
-    if (first_input_index >= 0 &&
-        first_input_index + weights.Dim() <= input_dim) {
-      SubVector<BaseFloat> input_part(input, first_input_index, weights.Dim());
-      this_output = VecVec(input_part, weights);
-    } else {  // Handle edge cases.
-      this_output = 0.0;
-      for (int32 i = 0; i < weights.Dim(); i++) {
-        BaseFloat weight = weights(i);
-        int32 input_index = first_input_index + i;
-        if (input_index < 0 && input_remainder_.Dim() + input_index >= 0) {
-          this_output += weight *
-              input_remainder_(input_remainder_.Dim() + input_index);
-        } else if (input_index >= 0 && input_index < input_dim) {
-          this_output += weight * input(input_index);
-        } else if (input_index >= input_dim) {
-          // We're past the end of the input and are adding zero; should only
-          // happen if the user specified flush == true, or else we would not
-          // be trying to output this sample.
-          KALDI_ASSERT(flush);
+  // The polyphase computation does one AXPY of length about
+  // (output->Dim() / output_samples_in_unit_) per weight, and it is worth it
+  // if those are longer than the dot products of the loop below.
+  if (output->Dim() >= 2 * max_num_weights_ * output_samples_in_unit_) {
+    ResamplePolyphase(input, output);
+  } else {
+    // samp_out is the index into the total output signal, not just the part
+    // of it we are producing here.
+    for (int64 samp_out = output_sample_offset_;
+         samp_out < tot_output_samp;
+         samp_out++) {
+      int64 first_samp_in;
+      int32 samp_out_wrapped;
+      GetIndexes(samp_out, &first_samp_in, &samp_out_wrapped);
+      const Vector<BaseFloat> &weights = weights_[samp_out_wrapped];
+      // first_input_index is the first index into "input" that we have a weight
+      // for.
+      int32 first_input_index = static_cast<int32>(first_samp_in -
+                                                   input_sample_offset_);
+      BaseFloat this_output;
+      if (first_input_index >= 0 &&
+          first_input_index + weights.Dim() <= input_dim) {
+        SubVector<BaseFloat> input_part(input, first_input_index,
+                                        weights.Dim());
+        this_output = VecVec(input_part, weights);
+      } else {  // Handle edge cases.
+        this_output = 0.0;
+        for (int32 i = 0; i < weights.Dim(); i++) {
+          BaseFloat weight = weights(i);
+          int32 input_index = first_input_index + i;
+          if (input_index < 0 && input_remainder_.Dim() + input_index >= 0) {
+            this_output += weight *
+                input_remainder_(input_remainder_.Dim() + input_index);
+          } else if (input_index >= 0 && input_index < input_dim) {
+            this_output += weight * input(input_index);
+          } else if (input_index >= input_dim) {
+            // We're past the end of the input and are adding zero; should only
+            // happen if the user specified flush == true, or else we would not
+            // be trying to output this sample.
+            KALDI_ASSERT(flush);
+          }
         }
       }
+      int32 output_index = static_cast<int32>(samp_out - output_sample_offset_);
+      (*output)(output_index) = this_output;
     }
-    int32 output_index = static_cast<int32>(samp_out - output_sample_offset_);
-    (*output)(output_index) = this_output;
   }
 
   if (flush) {
@@ -209,6 +219,91 @@ void LinearResample::Resample(const VectorBase<BaseFloat> &input,
   }
 }
 
+void LinearResample::ResamplePolyphase(const VectorBase<BaseFloat> &input,
+                                       VectorBase<BaseFloat> *output) const {
+  int32 in_unit = input_samples_in_unit_, out_unit = output_samples_in_unit_;
+  // The range of the input samples that the weights of a unit cover, relative
+  // to the first input sample of the unit.
+  int32 min_index = first_index_[0], end_index = 0;
+  for (int32 i = 0; i < out_unit; i++) {
+    min_index = std::min(min_index, first_index_[i]);
+    end_index = std::max(end_index, first_index_[i] + weights_[i].Dim());
+  }
+  // Round min_index down to a multiple of in_unit, so that the first input
+  // sample we need for a unit is the first sample of a unit.
+  if (min_index >= 0)
+    min_index = (min_index / in_unit) * in_unit;
+  else
+    min_index = -((in_unit - 1 - min_index) / in_unit) * in_unit;
+
+  // We compute the output samples of whole units, from unit 'begin_unit' to
+  // 'end_unit' - 1, and keep the ones that were asked for.  We do it in blocks
+  // of units whose input is a few tens of kilobytes, so that it stays in the
+  // cache while we go over it once for each weight.
+  int64 output_end = output_sample_offset_ + output->Dim(),
+      begin_unit = output_sample_offset_ / out_unit,
+      end_unit = (output_end + out_unit - 1) / out_unit;
+  int32 block_size = std::max(64, 8192 / in_unit);
+  int64 remainder_begin = input_sample_offset_ - input_remainder_.Dim(),
+      input_end = input_sample_offset_ + input.Dim();
+  Vector<BaseFloat> padded, output_units;
+  Matrix<BaseFloat> streams, phases;
+  for (int64 block_begin = begin_unit; block_begin < end_unit;
+       block_begin += block_size) {
+    int32 num_units = std::min<int64>(block_size, end_unit - block_begin);
+    // 'base' is the index of the first input sample we need.
+    int64 base = block_begin * in_unit + min_index,
+        end = (block_begin + num_units - 1) * in_unit + end_index;
+    int32 num_rows = (end - base + in_unit - 1) / in_unit;
+
+    // 'padded' is the input from sample 'base' on, including the part in
+    // input_remainder_, with zeros before the start and after the end of the
+    // signal.
+    padded.Resize(num_rows * in_unit);
+    int64 padded_end = base + padded.Dim();
+    int64 begin = std::max(base, remainder_begin),
+        stop = std::min(padded_end, input_sample_offset_);
+    if (begin < stop)
+      padded.Range(begin - base, stop - begin).CopyFromVec(
+          input_remainder_.Range(begin - remainder_begin, stop - begin));
+    begin = std::max(base, input_sample_offset_);
+    stop = std::min(padded_end, input_end);
+    if (begin < stop)
+      padded.Range(begin - base, stop - begin).CopyFromVec(
+          input.Range(begin - input_sample_offset_, stop - begin));
+
+    // Row q of 'streams' has the samples base + q, base + q + in_unit, ...
+    streams.Resize(in_unit, num_rows, kUndefined);
+    streams.CopyFromMat(SubMatrix<BaseFloat>(padded.Data(), num_rows, in_unit,
+                                             in_unit), kTrans);
+    // Row i of 'phases' has the output samples with index i within their
+    // unit.
+    phases.Resize(out_unit, num_units);
+    for (int32 i = 0; i < out_unit; i++) {
+      SubVector<BaseFloat> phase(phases, i);
+      const Vector<BaseFloat> &weights = weights_[i];
+      for (int32 j = 0; j < weights.Dim(); j++) {
+        // 'offset' is the index into 'padded' of the input sample that weight
+        // j applies to for the first unit; for the next unit it is in the
+        // next column of the same stream.
+        int32 offset = first_index_[i] + j + block_begin * in_unit - base;
+        SubVector<BaseFloat> input_part(streams.Row(offset % in_unit),
+                                        offset / in_unit, num_units);
+        phase.AddVec(weights(j), input_part);
+      }
+    }
+    output_units.Resize(num_units * out_unit, kUndefined);
+    SubMatrix<BaseFloat>(output_units.Data(), num_units, out_unit,
+                         out_unit).CopyFromMat(phases, kTrans);
+    // Copy the samples in this block that were asked for.
+    int64 block_output_begin = block_begin * out_unit;
+    begin = std::max(block_output_begin, output_sample_offset_);
+    stop = std::min(block_output_begin + output_units.Dim(), output_end);
+    output->Range(begin - output_sample_offset_, stop - begin).CopyFromVec(
+        output_units.Range(begin - block_output_begin, stop - begin));
+  }
+}
+
 void LinearResample::SetRemainder(const VectorBase<BaseFloat> &input) {
   Vector<BaseFloat> old_remainder(input_remainder_);
   // max_remainder_needed is the width of the filter from side to side,
@@ -286,16 +381,7 @@ void ArbitraryResample::Resample(const MatrixBase<BaseFloat> &input,
                input.NumCols() == num_samples_in_ &&
                output->NumCols() == weights_.size());
 
-  Vector<BaseFloat> output_col(output->NumRows());
-  for (int32 i = 0; i < NumSamplesOut(); i++) {
-    SubMatrix<BaseFloat> input_part(input, 0, input.NumRows(),
-                                    first_index_[i],
-                                    weights_[i].Dim());
-    const Vector<BaseFloat> &weight_vec(weights_[i]);
-    output_col.AddMatVec(1.0, input_part,
-                         kNoTrans, weight_vec, 0.0);
-    output->CopyColFromVec(output_col, i);
-  }
+  output->AddMatMat(1.0, input, kNoTrans, weight_mat_, kNoTrans, 0.0);
 }
 
 void ArbitraryResample::Resample(const VectorBase<BaseFloat> &input,
@@ -334,6 +420,7 @@ void ArbitraryResample::SetIndexes(const Vector<BaseFloat> &sample_points) {
 
 void ArbitraryResample::SetWeights(const Vector<BaseFloat> &sample_points) {
   int32 num_samples_out = NumSamplesOut();
+  weight_mat_.Resize(num_samples_in_, num_samples_out);
   for (int32 i = 0; i < num_samples_out; i++) {
     for (int32 j = 0 ; j < weights_[i].Dim(); j++) {
       BaseFloat delta_t = sample_points(i) -
@@ -341,6 +428,7 @@ void ArbitraryResample::SetWeights(const Vector<BaseFloat> &sample_points) {
       // Include at this point the factor of 1.0 / samp_rate_in_ which
       // appears in the math.
       weights_[i](j) = FilterFunc(delta_t) / samp_rate_in_;
+      weight_mat_(first_index_[i] + j, i) = weights_[i](j);
     }
   }
 }
@@ -109,6 +109,10 @@ class ArbitraryResample {
   /// and nonzero.
   /// input.NumCols() should equal NumSamplesIn()
   /// and output.NumCols() should equal NumSamplesOut().
+  /// It is done as one matrix multiplication by a dense version of the
+  /// filter weights, which is much faster than going through the output
+  /// samples one by one for the small sizes we use it for (the NCCF in the
+  /// pitch extractor).
   void Resample(const MatrixBase<BaseFloat> &input,
                 MatrixBase<BaseFloat> *output) const;
 
@@ -131,6 +135,10 @@ class ArbitraryResample {
   std::vector<int32> first_index_;  // The first input-sample index that we sum
                                     // over, for this output-sample index.
   std::vector<Vector<BaseFloat> > weights_;
+  // The same weights as a dense matrix of dimension NumSamplesIn() by
+  // NumSamplesOut(), whose column i has weights_[i] starting at row
+  // first_index_[i] and zeros elsewhere.
+  Matrix<BaseFloat> weight_mat_;
 };
 
 
@@ -174,6 +182,9 @@ class LinearResample {
   /// If your most recent call to the object was with flush == false, it will
   /// have internal state; you can remove this by calling Reset().
   /// Empty input is acceptable.
+  /// When there are enough output samples (see ResamplePolyphase()) the
+  /// computation is done per filter phase instead of per output sample; the
+  /// results are the same up to roundoff.
   void Resample(const VectorBase<BaseFloat> &input,
                 bool flush,
                 Vector<BaseFloat> *output);
@@ -211,6 +222,19 @@ class LinearResample {
 
   void SetRemainder(const VectorBase<BaseFloat> &input);
 
+  /// Called from Resample() (before it updates the offsets) to compute all
+  /// the output samples of this call, i.e. those with indexes from
+  /// output_sample_offset_ to output_sample_offset_ + output->Dim() - 1, as a
+  /// polyphase filter bank: the input is split into input_samples_in_unit_
+  /// streams (sample n goes to stream n % input_samples_in_unit_), and the
+  /// outputs of each of the output_samples_in_unit_ phases, which all use the
+  /// same weights, are computed together as a sum of scaled, shifted copies of
+  /// those streams, one for each weight.  This replaces one short dot product
+  /// per output sample with one long vectorized AXPY per weight, so it is
+  /// faster unless there are only a few output samples per phase.
+  void ResamplePolyphase(const VectorBase<BaseFloat> &input,
+                         VectorBase<BaseFloat> *output) const;
+
   void SetIndexesAndWeights();
 
   BaseFloat FilterFunc(BaseFloat) const;
@@ -240,6 +264,9 @@ class LinearResample {
   /// Weights on the input samples, for this output-sample index.
   std::vector<Vector<BaseFloat> > weights_;
 
+  /// The largest dimension of weights_[i], i.e. the number of filter taps.
+  int32 max_num_weights_;
+
   // the following variables keep track of where we are in a particular signal,
   // if it is being provided over multiple calls to Resample().
 
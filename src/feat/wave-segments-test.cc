@@ -0,0 +1,185 @@
+// matrix/serialized-matrix.h
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <fstream>
+
+#include "feat/wave-segments.h"
+#include "util/kaldi-table.h"
+
+namespace kaldi {
+
+// Writes recordings, some read through pipes and one of them with a header
+// that does not give its length, then reads segments of them sequentially and
+// in random order, and checks them against the recordings.
+void UnitTestWaveSegments() {
+  int32 num_rec = RandInt(1, 4);
+  BaseFloat samp_freq = 8000.0;
+  std::vector<Matrix<BaseFloat> > recordings(num_rec);
+  {
+    Output scp("tmp.wav.scp", false);
+    TableWriter<WaveHolder> ark_writer("ark:tmp.wav.ark");
+    for (int32 r = 0; r < num_rec; r++) {
+      std::string name = "tmp" + std::to_string(r) + ".wav";
+      Matrix<BaseFloat> &rec = recordings[r];
+      rec.Resize(RandInt(1, 2), RandInt(1000, 20000));
+      for (MatrixIndexT c = 0; c < rec.NumRows(); c++)
+        for (MatrixIndexT i = 0; i < rec.NumCols(); i++)
+          rec(c, i) = RandInt(-32768, 32767);
+      WaveData wave(samp_freq, rec);
+      {
+        Output output(name, true, false);
+        wave.Write(output.Stream());
+      }
+      if (r == 0) {
+        // Pretend that the length is not known (as written by sox to pipes).
+        std::fstream fs(name.c_str(), std::ios::in | std::ios::out |
+                        std::ios::binary);
+        fs.seekp(40);
+        fs.write("\xff\xff\xff\xff", 4);
+      }
+      ark_writer.Write("rec" + std::to_string(r), wave);
+      scp.Stream() << "rec" << r << ' '
+                   << (RandInt(0, 1) == 0 ? name : "cat " + name + " |")
+                   << '\n';
+    }
+  }
+  std::vector<WaveSegment> segments;
+  {
+    Output output("tmp.segments", false);
+    for (int32 s = 0; s < 20; s++) {
+      WaveSegment segment;
+      segment.segment = "seg" + std::to_string(s);
+      int32 r = RandInt(0, num_rec - 1);
+      segment.recording = "rec" + std::to_string(r);
+      // Times in whole milliseconds, which are written exactly.
+      int32 length_ms = recordings[r].NumCols() / 8;
+      segment.start = RandInt(0, length_ms) / 1000.0;
+      segment.end = (RandInt(0, 3) == 0 ? -1 :
+                     segment.start + RandInt(1, length_ms) / 1000.0);
+      segment.channel = (recordings[r].NumRows() > 1 ? RandInt(0, 1) :
+                         RandInt(-1, 0));
+      segments.push_back(segment);
+      output.Stream() << segment.segment << ' ' << segment.recording << ' '
+                      << segment.start << ' ' << segment.end;
+      if (segment.channel >= 0)
+        output.Stream() << ' ' << segment.channel;
+      output.Stream() << '\n';
+    }
+  }
+  WaveSegmentOptions opts;
+  opts.min_segment_length = 0.0;
+  opts.max_overshoot = 0.0;
+  // Reading the archive reads the whole recordings, as before.
+  const char *rspecifiers[] = { "scp:tmp.wav.scp", "ark:tmp.wav.ark" };
+  for (int32 n = 0; n < 2; n++) {
+    SequentialWaveSegmentReader reader(rspecifiers[n], "tmp.segments", opts);
+    RandomAccessWaveSegmentReader random_reader(rspecifiers[n],
+                                                "tmp.segments", opts);
+    for (size_t s = 0; s < segments.size(); s++) {
+      const WaveSegment &segment = segments[s];
+      const Matrix<BaseFloat> &rec =
+          recordings[segment.recording[3] - '0'];
+      int32 start_samp = static_cast<int32>(segment.start * samp_freq + 0.5f),
+          end_samp = (segment.end < 0 ? rec.NumCols() :
+                      std::min<int32>(rec.NumCols(), static_cast<int32>(
+                          segment.end * samp_freq + 0.5f)));
+      bool ok = (start_samp < end_samp &&
+                 segment.start <= rec.NumCols() / samp_freq &&
+                 segment.end <= rec.NumCols() / samp_freq);
+      KALDI_ASSERT(ok == (!reader.Done() && reader.Key() == segment.segment));
+      if (!ok)
+        continue;
+      int32 first_chan = 0, num_chan = rec.NumRows();
+      if (segment.channel >= 0 && num_chan > 1) {
+        first_chan = segment.channel;
+        num_chan = 1;
+      }
+      SubMatrix<BaseFloat> ref(rec, first_chan, num_chan,
+                               start_samp, end_samp - start_samp);
+      KALDI_ASSERT(reader.Value().Data().ApproxEqual(ref, 0.0) &&
+                   reader.Value().SampFreq() == samp_freq);
+      reader.Next();
+    }
+    KALDI_ASSERT(reader.Done() && reader.NumLines() == segments.size() &&
+                 reader.Close());
+    // Random order, which needs seeking back or reopening pipes.
+    for (int32 i = 0; i < 10; i++) {
+      const WaveSegment &segment = segments[RandInt(0, segments.size() - 1)];
+      if (random_reader.HasKey(segment.segment))
+        KALDI_ASSERT(random_reader.Value(segment.segment).Data().NumCols() > 0);
+    }
+    KALDI_ASSERT(!random_reader.HasKey("foo"));
+  }
+
+  // Resampling.
+  opts.resample_freq = 16000.0;
+  SequentialWaveSegmentReader reader("scp:tmp.wav.scp", "tmp.segments", opts);
+  for (; !reader.Done(); reader.Next())
+    KALDI_ASSERT(reader.Value().SampFreq() == 16000.0);
+
+  for (int32 r = 0; r < num_rec; r++)
+    unlink(("tmp" + std::to_string(r) + ".wav").c_str());
+  unlink("tmp.wav.scp");
+  unlink("tmp.wav.ark");
+  unlink("tmp.segments");
+}
+
+// Reads ranges of a wave file in random order.
+void UnitTestStreamingWaveReader() {
+  Matrix<BaseFloat> rec(2, RandInt(1, 5000));
+  for (MatrixIndexT c = 0; c < rec.NumRows(); c++)
+    for (MatrixIndexT i = 0; i < rec.NumCols(); i++)
+      rec(c, i) = RandInt(-32768, 32767);
+  {
+    Output output("tmp.wav", true, false);
+    WaveData(16000.0, rec).Write(output.Stream());
+  }
+  const char *rxfilenames[] = { "tmp.wav", "cat tmp.wav |" };
+  for (int32 n = 0; n < 2; n++) {
+    StreamingWaveReader reader;
+    reader.Open(rxfilenames[n]);
+    KALDI_ASSERT(reader.Info().SampleCount() == rec.NumCols() &&
+                 reader.Info().NumChannels() == 2);
+    for (int32 i = 0; i < 10; i++) {
+      int32 start = RandInt(0, rec.NumCols()),
+          num_samples = RandInt(-1, rec.NumCols());
+      Matrix<BaseFloat> data;
+      reader.Read(start, num_samples, &data);
+      int32 expected = rec.NumCols() - start;
+      if (num_samples >= 0)
+        expected = std::min(expected, num_samples);
+      KALDI_ASSERT(data.NumCols() == expected);
+      if (expected > 0)
+        KALDI_ASSERT(data.ApproxEqual(rec.ColRange(start, expected), 0.0));
+    }
+  }
+  unlink("tmp.wav");
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 5; i++) {
+    UnitTestStreamingWaveReader();
+    UnitTestWaveSegments();
+  }
+  std::cout << "Test OK.\n";
+  return 0;
+}
@@ -0,0 +1,399 @@
+// matrix/serialized-matrix.h
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <limits>
+
+#include "feat/wave-segments.h"
+#include "feat/resample.h"
+#include "util/text-utils.h"
+
+namespace kaldi {
+
+void StreamingWaveReader::Open(const std::string &rxfilename) {
+  Close();
+  if (!input_.Open(rxfilename))
+    KALDI_ERR << "Could not open wave file " << PrintableRxfilename(rxfilename);
+  rxfilename_ = rxfilename;
+  std::istream &is = input_.Stream();
+  info_.Read(is);
+  // tellg() fails for streams that cannot seek, such as pipes.
+  data_start_ = is.tellg();
+  if (data_start_ < 0) {
+    is.clear();
+    data_start_ = -1;
+  }
+  pos_ = 0;
+}
+
+void StreamingWaveReader::SkipTo(int64 sample) {
+  std::istream &is = input_.Stream();
+  if (data_start_ >= 0) {
+    is.seekg(data_start_ + sample * info_.BlockAlign());
+    if (is.fail())
+      KALDI_ERR << "Failed to seek in wave file "
+                << PrintableRxfilename(rxfilename_);
+  } else {
+    int64 num_bytes = (sample - pos_) * info_.BlockAlign();
+    is.ignore(num_bytes);
+    if (is.gcount() != num_bytes)
+      is.clear();  // The data ended first; reading from here will fail.
+  }
+  pos_ = sample;
+}
+
+void StreamingWaveReader::Read(int64 start, int64 num_samples,
+                               Matrix<BaseFloat> *data) {
+  KALDI_ASSERT(input_.IsOpen() && start >= 0);
+  if (start < pos_ && data_start_ < 0)
+    Open(rxfilename_);  // We can't go back in this stream.
+  if (start != pos_)
+    SkipTo(start);
+  // The sample count in the header is not used if it is not known, or if the
+  // file is shorter.
+  int64 end = (num_samples < 0 ? std::numeric_limits<int64>::max() :
+               start + num_samples);
+  if (!info_.IsStreamed())
+    end = std::min<int64>(end, info_.SampleCount());
+  std::istream &is = input_.Stream();
+  const int64 kBlockSize = 1024 * 1024;
+  size_t block_align = info_.BlockAlign();
+  std::vector<char> buffer;
+  while (pos_ < end && is.good()) {
+    int64 block_bytes = std::min<int64>(end - pos_,
+                                        kBlockSize / block_align) * block_align,
+        offset = buffer.size();
+    buffer.resize(offset + block_bytes);
+    is.read(&buffer[offset], block_bytes);
+    int64 bytes_read = is.gcount();
+    buffer.resize(offset + bytes_read);
+    pos_ += bytes_read / block_align;
+    if (bytes_read % block_align != 0) {
+      buffer.resize(buffer.size() - bytes_read % block_align);
+      break;  // A partial sample at the end of the file.
+    }
+  }
+  if (is.bad())
+    KALDI_ERR << "Error reading wave file " << PrintableRxfilename(rxfilename_);
+
+  // The matrix is arranged row per channel, column per sample, as in
+  // WaveData::Read().
+  const int16 *data_ptr = reinterpret_cast<const int16*>(buffer.data());
+  data->Resize(info_.NumChannels(), buffer.size() / block_align, kUndefined);
+  for (MatrixIndexT i = 0; i < data->NumCols(); i++) {
+    for (MatrixIndexT j = 0; j < data->NumRows(); j++) {
+      int16 k = *data_ptr++;
+      if (info_.ReverseBytes())
+        KALDI_SWAP2(k);
+      (*data)(j, i) = k;
+    }
+  }
+}
+
+void StreamingWaveReader::Close() {
+  if (!input_.IsOpen())
+    return;
+  if (data_start_ < 0)
+    input_.Stream().ignore(std::numeric_limits<std::streamsize>::max());
+  input_.Close();
+}
+
+
+bool ParseWaveSegment(const std::string &line, WaveSegment *segment) {
+  std::vector<std::string> split_line;
+  // Split the line into whitespace-separated fields and verify their
+  // number. There must be 4 or 5 fields: segment name, recording ID, start
+  // time, end time, and the optional channel number.
+  SplitStringToVector(line, " \t\r", true, &split_line);
+  if (split_line.size() != 4 && split_line.size() != 5) {
+    KALDI_WARN << "Invalid line in segments file: " << line;
+    return false;
+  }
+  segment->segment = split_line[0];
+  segment->recording = split_line[1];
+  double &start = segment->start, &end = segment->end;
+  // Parse the start and end times as float values. Segment is ignored if
+  // any of end times is malformed.
+  if (!ConvertStringToReal(split_line[2], &start)) {
+    KALDI_WARN << "Invalid line in segments file [bad start]: " << line;
+    return false;
+  }
+  if (!ConvertStringToReal(split_line[3], &end)) {
+    KALDI_WARN << "Invalid line in segments file [bad end]: " << line;
+    return false;
+  }
+  // Start time must be non-negative and not greater than the end time,
+  // except if the end time is -1.
+  if (start < 0 || (end != -1.0 && end <= 0) ||
+      ((start >= end) && (end > 0))) {
+    KALDI_WARN << ("Invalid line in segments file "
+                   "[empty or invalid segment]: ") << line;
+    return false;
+  }
+  segment->channel = -1;  // -1 means channel is unspecified.
+  // If the line has 5 elements, then the 5th element is the channel number.
+  if (split_line.size() == 5) {
+    if (!ConvertStringToInteger(split_line[4], &segment->channel) ||
+        segment->channel < 0) {
+      KALDI_WARN << "Invalid line in segments file [bad channel]: " << line;
+      return false;
+    }
+  }
+  return true;
+}
+
+
+WaveRecordingReader::WaveRecordingReader(const std::string &wav_rspecifier):
+    have_whole_(false) {
+  std::string scp_rxfilename;
+  streaming_ = (ClassifyRspecifier(wav_rspecifier, &scp_rxfilename, NULL) ==
+                kScriptRspecifier);
+  if (streaming_) {
+    std::vector<std::pair<std::string, std::string> > script;
+    if (!ReadScriptFile(scp_rxfilename, true, &script))
+      KALDI_ERR << "Error reading script file "
+                << PrintableRxfilename(scp_rxfilename);
+    rxfilenames_.insert(script.begin(), script.end());
+  } else if (!table_reader_.Open(wav_rspecifier)) {
+    KALDI_ERR << "Error opening wave table " << wav_rspecifier;
+  }
+}
+
+bool WaveRecordingReader::Read(const WaveSegment &segment,
+                               const WaveSegmentOptions &opts,
+                               WaveData *wave) {
+  const std::string &recording = segment.recording;
+  // Either the whole recording is in memory (in 'whole'), or we know its
+  // length from the header and read just the segment from stream_.
+  const Matrix<BaseFloat> *whole = NULL;
+  BaseFloat samp_freq;
+  int64 num_samp;
+  int32 num_chan;
+  if (!streaming_) {
+    if (!table_reader_.HasKey(recording)) {
+      KALDI_WARN << "Could not find recording " << recording
+                 << ", skipping segment " << segment.segment;
+      return false;
+    }
+    const WaveData &wave_data = table_reader_.Value(recording);
+    whole = &(wave_data.Data());
+    samp_freq = wave_data.SampFreq();
+  } else {
+    if (recording != recording_ || !stream_.IsOpen()) {
+      std::unordered_map<std::string, std::string>::const_iterator iter =
+          rxfilenames_.find(recording);
+      if (iter == rxfilenames_.end()) {
+        KALDI_WARN << "Could not find recording " << recording
+                   << ", skipping segment " << segment.segment;
+        return false;
+      }
+      recording_ = "";
+      stream_.Open(iter->second);
+      recording_ = recording;
+      have_whole_ = false;
+    }
+    if (stream_.Info().IsStreamed()) {
+      if (!have_whole_)
+        stream_.Read(0, -1, &whole_);
+      have_whole_ = true;
+      whole = &whole_;
+    }
+    samp_freq = stream_.Info().SampFreq();
+  }
+  if (whole != NULL) {
+    num_samp = whole->NumCols();
+    num_chan = whole->NumRows();
+  } else {
+    num_samp = stream_.Info().SampleCount();
+    num_chan = stream_.Info().NumChannels();
+  }
+
+  double start = segment.start, end = segment.end;
+  BaseFloat file_length = num_samp / samp_freq;  // In seconds.
+  // Start must be within the wave data, otherwise skip the segment.
+  if (start < 0 || start > file_length) {
+    KALDI_WARN << "Segment start is out of file data range [0, "
+               << file_length << "s]; skipping segment " << segment.segment;
+    return false;
+  }
+  // End must be less than the file length adjusted for possible overshoot;
+  // otherwise skip the segment. end == -1 passes the check.
+  if (end > file_length + opts.max_overshoot) {
+    KALDI_WARN << "Segment end is too far out of file data range [0,"
+               << file_length << "s]; skipping segment " << segment.segment;
+    return false;
+  }
+  // Otherwise ensure the end is not beyond the end of data, and default
+  // end == -1 to the end of file data.
+  if (end < 0 || end > file_length) end = file_length;
+  // Skip if segment size is less than the minimum allowed.
+  if (end - start < opts.min_segment_length) {
+    KALDI_WARN << "Segment " << segment.segment << " too short, skipping it.";
+    return false;
+  }
+  if (segment.channel >= num_chan) {
+    KALDI_WARN << "Invalid channel " << segment.channel << " >= " << num_chan
+               << ". Skipping segment " << segment.segment;
+    return false;
+  }
+
+  // Convert endpoints of the segment to sample numbers. Note that the
+  // conversion requires a proper rounding.
+  int64 start_samp = static_cast<int64>(start * samp_freq + 0.5f),
+      end_samp = static_cast<int64>(end * samp_freq + 0.5f);
+  if (end_samp > num_samp)
+    end_samp = num_samp;
+
+  Matrix<BaseFloat> data;
+  if (whole != NULL) {
+    data = whole->ColRange(start_samp, end_samp - start_samp);
+  } else {
+    stream_.Read(start_samp, end_samp - start_samp, &data);
+    if (data.NumCols() < end_samp - start_samp)
+      KALDI_WARN << "Recording " << recording << " is shorter than its header "
+                 << "says (truncated file?)";
+  }
+  if (segment.channel >= 0 && num_chan > 1) {
+    Matrix<BaseFloat> channel_data(data.RowRange(segment.channel, 1));
+    data.Swap(&channel_data);
+  }
+  if (opts.resample_freq > 0.0 && opts.resample_freq != samp_freq) {
+    Matrix<BaseFloat> resampled;
+    for (MatrixIndexT c = 0; c < data.NumRows(); c++) {
+      Vector<BaseFloat> channel;
+      ResampleWaveform(samp_freq, data.Row(c), opts.resample_freq, &channel);
+      if (c == 0)
+        resampled.Resize(data.NumRows(), channel.Dim());
+      resampled.Row(c).CopyFromVec(channel);
+    }
+    data.Swap(&resampled);
+    samp_freq = opts.resample_freq;
+  }
+  WaveData segment_wave(samp_freq, data);
+  wave->Swap(&segment_wave);
+  return true;
+}
+
+
+SequentialWaveSegmentReader::SequentialWaveSegmentReader(
+    const std::string &wav_rspecifier, const std::string &segments_rxfilename,
+    const WaveSegmentOptions &opts):
+    recording_reader_(NULL), opts_(opts), done_(false), num_lines_(0) {
+  if (segments_rxfilename.empty()) {
+    if (!table_reader_.Open(wav_rspecifier))
+      KALDI_ERR << "Error opening wave table " << wav_rspecifier;
+  } else {
+    recording_reader_ = new WaveRecordingReader(wav_rspecifier);
+    segments_input_.Open(segments_rxfilename);
+    ReadSegment();
+  }
+}
+
+void SequentialWaveSegmentReader::ReadSegment() {
+  std::string line;
+  while (std::getline(segments_input_.Stream(), line)) {
+    num_lines_++;
+    WaveSegment segment;
+    if (ParseWaveSegment(line, &segment) &&
+        recording_reader_->Read(segment, opts_, &wave_)) {
+      key_ = segment.segment;
+      return;
+    }
+  }
+  done_ = true;
+}
+
+bool SequentialWaveSegmentReader::Done() {
+  return (recording_reader_ == NULL ? table_reader_.Done() : done_);
+}
+
+std::string SequentialWaveSegmentReader::Key() {
+  if (recording_reader_ == NULL)
+    return table_reader_.Key();
+  KALDI_ASSERT(!done_);
+  return key_;
+}
+
+void SequentialWaveSegmentReader::Next() {
+  if (recording_reader_ == NULL) {
+    table_reader_.Next();
+  } else {
+    KALDI_ASSERT(!done_);
+    ReadSegment();
+  }
+}
+
+const WaveData &SequentialWaveSegmentReader::Value() {
+  if (recording_reader_ == NULL)
+    return table_reader_.Value();
+  KALDI_ASSERT(!done_);
+  return wave_;
+}
+
+bool SequentialWaveSegmentReader::Close() {
+  if (recording_reader_ == NULL)
+    return table_reader_.Close();
+  delete recording_reader_;
+  recording_reader_ = NULL;
+  segments_input_.Close();
+  return true;
+}
+
+
+RandomAccessWaveSegmentReader::RandomAccessWaveSegmentReader(
+    const std::string &wav_rspecifier, const std::string &segments_rxfilename,
+    const WaveSegmentOptions &opts):
+    recording_reader_(NULL), opts_(opts), key_ok_(false) {
+  if (segments_rxfilename.empty()) {
+    if (!table_reader_.Open(wav_rspecifier))
+      KALDI_ERR << "Error opening wave table " << wav_rspecifier;
+    return;
+  }
+  recording_reader_ = new WaveRecordingReader(wav_rspecifier);
+  Input input(segments_rxfilename);
+  std::string line;
+  while (std::getline(input.Stream(), line)) {
+    WaveSegment segment;
+    if (ParseWaveSegment(line, &segment))
+      segments_[segment.segment] = segment;
+  }
+}
+
+bool RandomAccessWaveSegmentReader::HasKey(const std::string &key) {
+  if (recording_reader_ == NULL)
+    return table_reader_.HasKey(key);
+  if (key != key_) {
+    std::unordered_map<std::string, WaveSegment>::const_iterator iter =
+        segments_.find(key);
+    key_ = key;
+    key_ok_ = (iter != segments_.end() &&
+               recording_reader_->Read(iter->second, opts_, &wave_));
+  }
+  return key_ok_;
+}
+
+const WaveData &RandomAccessWaveSegmentReader::Value(const std::string &key) {
+  if (recording_reader_ == NULL)
+    return table_reader_.Value(key);
+  if (!HasKey(key))
+    KALDI_ERR << "Could not read segment " << key;
+  return wave_;
+}
+
+}  // namespace kaldi
@@ -0,0 +1,215 @@
+// matrix/serialized-matrix.h
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_FEAT_WAVE_SEGMENTS_H_
+#define KALDI_FEAT_WAVE_SEGMENTS_H_
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "feat/wave-reader.h"
+#include "itf/options-itf.h"
+#include "util/kaldi-io.h"
+#include "util/kaldi-table.h"
+
+namespace kaldi {
+
+/// StreamingWaveReader reads ranges of samples of a wave file, without reading
+/// the rest of the file into memory.  Reading forward from one range to the
+/// next reads just the data in between (or seeks over it); going backward
+/// seeks if the stream is seekable (e.g. a file), and otherwise (e.g. a pipe)
+/// opens the file again.
+class StreamingWaveReader {
+ public:
+  StreamingWaveReader(): data_start_(-1), pos_(0) { }
+
+  /// Opens the wave file 'rxfilename' (a file, a pipe, a file with an offset,
+  /// etc.) and reads its header.  Throws on error.
+  void Open(const std::string &rxfilename);
+
+  bool IsOpen() { return input_.IsOpen(); }
+
+  /// The header of the file, which is valid once it is open.
+  const WaveInfo &Info() const { return info_; }
+
+  /// Outputs 'num_samples' samples from sample 'start' on (or all samples
+  /// from 'start' on, if num_samples < 0), with one row per channel.  If the
+  /// file ends first the output has fewer samples.  Throws on read error.
+  void Read(int64 start, int64 num_samples, Matrix<BaseFloat> *data);
+
+  /// Closes the file.  If it is a pipe, the rest of the data is read first,
+  /// so that the program writing it does not fail.
+  void Close();
+
+  ~StreamingWaveReader() { Close(); }
+
+ private:
+  // Moves to sample 'sample', or to the end of the data if it ends first.
+  void SkipTo(int64 sample);
+
+  std::string rxfilename_;
+  Input input_;
+  WaveInfo info_;
+  int64 data_start_;  // The stream position of the data, or -1 if the stream
+                      // is not seekable.
+  int64 pos_;  // The next sample in the stream.
+};
+
+
+struct WaveSegmentOptions {
+  BaseFloat min_segment_length;
+  BaseFloat max_overshoot;
+  BaseFloat resample_freq;
+  WaveSegmentOptions(): min_segment_length(0.1), max_overshoot(0.5),
+                        resample_freq(0.0) { }
+  void Register(OptionsItf *opts) {
+    opts->Register("min-segment-length", &min_segment_length,
+                   "Minimum segment length in seconds (reject shorter "
+                   "segments)");
+    opts->Register("max-overshoot", &max_overshoot,
+                   "End segments overshooting audio by less than this (in "
+                   "seconds) are truncated, else rejected.");
+    opts->Register("resample-freq", &resample_freq,
+                   "If > 0, resample each segment to this sampling frequency "
+                   "(in Hz), with LinearResample.");
+  }
+};
+
+/// One line of a segments file:
+/// <segment-id> <recording-id> <start-time> <end-time> [<channel>]
+/// where <end-time> is -1 for the end of the recording, and <channel> is -1 if
+/// not given.
+struct WaveSegment {
+  std::string segment;
+  std::string recording;
+  double start;
+  double end;
+  int32 channel;
+};
+
+/// Parses a line of a segments file; returns false (after printing a warning)
+/// if it is invalid.
+bool ParseWaveSegment(const std::string &line, WaveSegment *segment);
+
+/// This class reads segments of recordings for the segment readers below.
+/// If the wav rspecifier is a script file, the recordings are read with
+/// StreamingWaveReader, so only the segments are read; otherwise (e.g. for
+/// archives) each recording is read whole, as before.
+class WaveRecordingReader {
+ public:
+  explicit WaveRecordingReader(const std::string &wav_rspecifier);
+
+  /// Outputs the segment of its recording, resampled if requested.  If no
+  /// channel was given, all channels are output.  Returns false (after
+  /// printing a warning) if the recording is missing or the segment is
+  /// outside it or too short.
+  bool Read(const WaveSegment &segment, const WaveSegmentOptions &opts,
+            WaveData *wave);
+
+ private:
+  bool streaming_;
+  RandomAccessTableReader<WaveHolder> table_reader_;  // If !streaming_.
+  // If streaming_: the rxfilename of each recording, and the reader for the
+  // recording that was read last.
+  std::unordered_map<std::string, std::string> rxfilenames_;
+  std::string recording_;
+  StreamingWaveReader stream_;
+  // The whole of the current recording, for files whose header does not
+  // give their length (e.g. written to pipes by sox).
+  Matrix<BaseFloat> whole_;
+  bool have_whole_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(WaveRecordingReader);
+};
+
+/// This class has the same interface as SequentialTableReader<WaveHolder>, and
+/// reads the segments in a segments file, in order, from the recordings in the
+/// wav rspecifier; segments that cannot be read are skipped with a warning.
+/// If segments_rxfilename is empty it just reads the wav rspecifier.
+class SequentialWaveSegmentReader {
+ public:
+  SequentialWaveSegmentReader(const std::string &wav_rspecifier,
+                              const std::string &segments_rxfilename = "",
+                              const WaveSegmentOptions &opts =
+                              WaveSegmentOptions());
+
+  ~SequentialWaveSegmentReader() { delete recording_reader_; }
+
+  bool Done();
+  std::string Key();
+  void Next();
+  const WaveData &Value();
+  bool Close();
+
+  /// The number of lines read from the segments file so far.
+  int32 NumLines() const { return num_lines_; }
+
+ private:
+  // Reads segments until one can be read or the file ends.
+  void ReadSegment();
+
+  SequentialTableReader<WaveHolder> table_reader_;  // If no segments file.
+  WaveRecordingReader *recording_reader_;
+  WaveSegmentOptions opts_;
+  Input segments_input_;
+  bool done_;
+  std::string key_;
+  WaveData wave_;
+  int32 num_lines_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(SequentialWaveSegmentReader);
+};
+
+/// This class has the same interface as RandomAccessTableReader<WaveHolder>,
+/// and reads the segments in a segments file, by segment-id, from the
+/// recordings in the wav rspecifier.  If segments_rxfilename is empty it just
+/// reads the wav rspecifier.
+class RandomAccessWaveSegmentReader {
+ public:
+  RandomAccessWaveSegmentReader(const std::string &wav_rspecifier,
+                                const std::string &segments_rxfilename = "",
+                                const WaveSegmentOptions &opts =
+                                WaveSegmentOptions());
+
+  ~RandomAccessWaveSegmentReader() { delete recording_reader_; }
+
+  /// Returns true if the segment exists and could be read; it is read here.
+  bool HasKey(const std::string &key);
+
+  /// Throws if the segment does not exist or could not be read.  The
+  /// reference is valid until the next call.
+  const WaveData &Value(const std::string &key);
+
+ private:
+  RandomAccessTableReader<WaveHolder> table_reader_;  // If no segments file.
+  WaveRecordingReader *recording_reader_;
+  WaveSegmentOptions opts_;
+  std::unordered_map<std::string, WaveSegment> segments_;
+  std::string key_;  // The segment in wave_, if any.
+  bool key_ok_;  // True if it was read successfully.
+  WaveData wave_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(RandomAccessWaveSegmentReader);
+};
+
+}  // namespace kaldi
+
+#endif  // KALDI_FEAT_WAVE_SEGMENTS_H_
@@ -47,7 +47,112 @@ bool AccCmvnStatsWrapper(std::string utt,
     return true;
   }
 }
-                  
+
+// This version is used when there are no weights, so we only need the
+// statistics of the features, which are read from their header if they have
+// one (see matrix/matrix-stats.h).
+bool AccCmvnStatsWrapper(std::string utt,
+                         const MatrixStats &feat_stats,
+                         RandomAccessBaseFloatVectorReader *weights_reader,
+                         Matrix<double> *cmvn_stats) {
+  KALDI_ASSERT(!weights_reader->IsOpen());
+  AccCmvnStats(feat_stats, cmvn_stats);
+  return true;
+}
+
+// FeatHolder is KaldiObjectHolder<Matrix<BaseFloat> > if there are weights,
+// and KaldiObjectHolder<MatrixStats> otherwise.
+template<class FeatHolder>
+void ComputeCmvnStats(const std::string &rspecifier,
+                      const std::string &spk2utt_rspecifier,
+                      const std::string &wspecifier_or_wxfilename,
+                      bool binary,
+                      RandomAccessBaseFloatVectorReader *weights_reader,
+                      int32 *num_done, int32 *num_err) {
+  typedef typename FeatHolder::T FeatType;
+  if (ClassifyWspecifier(wspecifier_or_wxfilename, NULL, NULL, NULL)
+      != kNoWspecifier) { // writing to a Table: per-speaker or per-utt CMN/CVN.
+    std::string wspecifier = wspecifier_or_wxfilename;
+
+    DoubleMatrixWriter writer(wspecifier);
+
+    if (spk2utt_rspecifier != "") {
+      SequentialTokenVectorReader spk2utt_reader(spk2utt_rspecifier);
+      RandomAccessTableReader<FeatHolder> feat_reader(rspecifier);
+
+      for (; !spk2utt_reader.Done(); spk2utt_reader.Next()) {
+        std::string spk = spk2utt_reader.Key();
+        const std::vector<std::string> &uttlist = spk2utt_reader.Value();
+        bool is_init = false;
+        Matrix<double> stats;
+        for (size_t i = 0; i < uttlist.size(); i++) {
+          std::string utt = uttlist[i];
+          if (!feat_reader.HasKey(utt)) {
+            KALDI_WARN << "Did not find features for utterance " << utt;
+            (*num_err)++;
+            continue;
+          }
+          const FeatType &feats = feat_reader.Value(utt);
+          if (!is_init) {
+            InitCmvnStats(feats.NumCols(), &stats);
+            is_init = true;
+          }
+          if (!AccCmvnStatsWrapper(utt, feats, weights_reader, &stats)) {
+            (*num_err)++;
+          } else {
+            (*num_done)++;
+          }
+        }
+        if (stats.NumRows() == 0) {
+          KALDI_WARN << "No stats accumulated for speaker " << spk;
+        } else {
+          writer.Write(spk, stats);
+        }
+      }
+    } else {  // per-utterance normalization
+      SequentialTableReader<FeatHolder> feat_reader(rspecifier);
+
+      for (; !feat_reader.Done(); feat_reader.Next()) {
+        std::string utt = feat_reader.Key();
+        Matrix<double> stats;
+        const FeatType &feats = feat_reader.Value();
+        InitCmvnStats(feats.NumCols(), &stats);
+
+        if (!AccCmvnStatsWrapper(utt, feats, weights_reader, &stats)) {
+          (*num_err)++;
+          continue;
+        }
+        writer.Write(feat_reader.Key(), stats);
+        (*num_done)++;
+      }
+    }
+  } else { // accumulate global stats
+    if (spk2utt_rspecifier != "")
+      KALDI_ERR << "--spk2utt option not compatible with wxfilename as output "
+                 << "(did you forget ark:?)";
+    std::string wxfilename = wspecifier_or_wxfilename;
+    bool is_init = false;
+    Matrix<double> stats;
+    SequentialTableReader<FeatHolder> feat_reader(rspecifier);
+    for (; !feat_reader.Done(); feat_reader.Next()) {
+      std::string utt = feat_reader.Key();
+      const FeatType &feats = feat_reader.Value();
+      if (!is_init) {
+        InitCmvnStats(feats.NumCols(), &stats);
+        is_init = true;
+      }
+      if (!AccCmvnStatsWrapper(utt, feats, weights_reader, &stats)) {
+        (*num_err)++;
+      } else {
+        (*num_done)++;
+      }
+    }
+    Matrix<float> stats_float(stats);
+    WriteKaldiObject(stats_float, wxfilename, binary);
+    KALDI_LOG << "Wrote global CMVN stats to "
+              << PrintableWxfilename(wxfilename);
+  }
+}
 
 }
 
@@ -60,11 +165,12 @@ int main(int argc, char *argv[]) {
         "Compute cepstral mean and variance normalization statistics\n"
         "If wspecifier provided: per-utterance by default, or per-speaker if\n"
         "spk2utt option provided; if wxfilename: global\n"
+        "Without --weights, only the statistics headers of features written\n"
+        "with copy-feats --write-stats=true are read.\n"
         "Usage: compute-cmvn-stats  [options] <feats-rspecifier> (<stats-wspecifier>|<stats-wxfilename>)\n"
         "e.g.: compute-cmvn-stats --spk2utt=ark:data/train/spk2utt"
         " scp:data/train/feats.scp ark,scp:/foo/bar/cmvn.ark,data/train/cmvn.scp\n"
         "See also: apply-cmvn, modify-cmvn-stats\n";
-    
     ParseOptions po(usage);
     std::string spk2utt_rspecifier, weights_rspecifier;
     bool binary = true;
@@ -86,88 +192,14 @@ int main(int argc, char *argv[]) {
 
     RandomAccessBaseFloatVectorReader weights_reader(weights_rspecifier);
     
-    if (ClassifyWspecifier(wspecifier_or_wxfilename, NULL, NULL, NULL)
-        != kNoWspecifier) { // writing to a Table: per-speaker or per-utt CMN/CVN.
-      std::string wspecifier = wspecifier_or_wxfilename;
-
-      DoubleMatrixWriter writer(wspecifier);
-
-      if (spk2utt_rspecifier != "") {
-        SequentialTokenVectorReader spk2utt_reader(spk2utt_rspecifier);
-        RandomAccessBaseFloatMatrixReader feat_reader(rspecifier);
-        
-        for (; !spk2utt_reader.Done(); spk2utt_reader.Next()) {
-          std::string spk = spk2utt_reader.Key();
-          const std::vector<std::string> &uttlist = spk2utt_reader.Value();
-          bool is_init = false;
-          Matrix<double> stats;
-          for (size_t i = 0; i < uttlist.size(); i++) {
-            std::string utt = uttlist[i];
-            if (!feat_reader.HasKey(utt)) {
-              KALDI_WARN << "Did not find features for utterance " << utt;
-              num_err++;
-              continue;
-            }
-            const Matrix<BaseFloat> &feats = feat_reader.Value(utt);
-            if (!is_init) {
-              InitCmvnStats(feats.NumCols(), &stats);
-              is_init = true;
-            }
-            if (!AccCmvnStatsWrapper(utt, feats, &weights_reader, &stats)) {
-              num_err++;
-            } else {
-              num_done++;
-            }
-          }
-          if (stats.NumRows() == 0) {
-            KALDI_WARN << "No stats accumulated for speaker " << spk;
-          } else {
-            writer.Write(spk, stats);
-          }
-        }
-      } else {  // per-utterance normalization
-        SequentialBaseFloatMatrixReader feat_reader(rspecifier);
-        
-        for (; !feat_reader.Done(); feat_reader.Next()) {
-          std::string utt = feat_reader.Key();
-          Matrix<double> stats;
-          const Matrix<BaseFloat> &feats = feat_reader.Value();
-          InitCmvnStats(feats.NumCols(), &stats);
-
-          if (!AccCmvnStatsWrapper(utt, feats, &weights_reader, &stats)) {
-            num_err++;
-            continue;
-          }
-          writer.Write(feat_reader.Key(), stats);          
-          num_done++;
-        }
-      }
-    } else { // accumulate global stats
-      if (spk2utt_rspecifier != "")
-        KALDI_ERR << "--spk2utt option not compatible with wxfilename as output "
-                   << "(did you forget ark:?)";
-      std::string wxfilename = wspecifier_or_wxfilename;
-      bool is_init = false;
-      Matrix<double> stats;
-      SequentialBaseFloatMatrixReader feat_reader(rspecifier);
-      for (; !feat_reader.Done(); feat_reader.Next()) {
-        std::string utt = feat_reader.Key();
-        const Matrix<BaseFloat> &feats = feat_reader.Value();
-        if (!is_init) {
-          InitCmvnStats(feats.NumCols(), &stats);
-          is_init = true;
-        }
-        if (!AccCmvnStatsWrapper(utt, feats, &weights_reader, &stats)) {
-          num_err++;
-        } else {
-          num_done++;
-        }
-      }
-      Matrix<float> stats_float(stats);
-      WriteKaldiObject(stats_float, wxfilename, binary);
-      KALDI_LOG << "Wrote global CMVN stats to "
-                << PrintableWxfilename(wxfilename);
-    }
+    if (weights_reader.IsOpen())
+      ComputeCmvnStats<KaldiObjectHolder<Matrix<BaseFloat> > >(
+          rspecifier, spk2utt_rspecifier, wspecifier_or_wxfilename, binary,
+          &weights_reader, &num_done, &num_err);
+    else
+      ComputeCmvnStats<KaldiObjectHolder<MatrixStats> >(
+          rspecifier, spk2utt_rspecifier, wspecifier_or_wxfilename, binary,
+          &weights_reader, &num_done, &num_err);
     KALDI_LOG << "Done accumulating CMVN stats for " << num_done
               << " utterances; " << num_err << " had errors.";
     return (num_done != 0 ? 0 : 1);    
@@ -176,5 +208,3 @@ int main(int argc, char *argv[]) {
     return -1;
   }
 }
-
-
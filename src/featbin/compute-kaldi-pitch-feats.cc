@@ -23,6 +23,54 @@
 #include "feat/pitch-functions.h"
 #include "feat/wave-reader.h"
 
+namespace kaldi {
+
+// Computes the pitch of one utterance (in operator ()), and writes it out in
+// the destructor, so that utterances can be processed in parallel by a
+// TaskSequencer while the output stays in the same order.
+class PitchComputationTask {
+ public:
+  PitchComputationTask(const PitchExtractionOptions &opts,
+                       const std::string &utt,
+                       const VectorBase<BaseFloat> &waveform,
+                       BaseFloatMatrixWriter *feat_writer,
+                       int32 *num_done, int32 *num_err):
+      opts_(opts), utt_(utt), waveform_(waveform), feat_writer_(feat_writer),
+      num_done_(num_done), num_err_(num_err), ok_(true) { }
+
+  void operator () () {
+    try {
+      ComputeKaldiPitch(opts_, waveform_, &features_);
+    } catch (...) {
+      ok_ = false;
+    }
+  }
+
+  ~PitchComputationTask() {
+    if (!ok_) {
+      KALDI_WARN << "Failed to compute pitch for utterance "
+                 << utt_;
+      (*num_err_)++;
+      return;
+    }
+    feat_writer_->Write(utt_, features_);
+    if (*num_done_ % 50 == 0 && *num_done_ != 0)
+      KALDI_VLOG(2) << "Processed " << *num_done_ << " utterances";
+    (*num_done_)++;
+  }
+ private:
+  const PitchExtractionOptions &opts_;
+  std::string utt_;
+  Vector<BaseFloat> waveform_;
+  Matrix<BaseFloat> features_;
+  BaseFloatMatrixWriter *feat_writer_;
+  int32 *num_done_;
+  int32 *num_err_;
+  bool ok_;
+};
+
+}  // namespace kaldi
+
 
 int main(int argc, char *argv[]) {
   try {
@@ -35,6 +83,8 @@ int main(int argc, char *argv[]) {
         "Usage: compute-kaldi-pitch-feats [options...] <wav-rspecifier> <feats-wspecifier>\n"
         "e.g.\n"
         "compute-kaldi-pitch-feats --sample-frequency=8000 scp:wav.scp ark:- \n"
+        "Utterances are processed in parallel with --num-threads > 1 (the\n"
+        "output is the same for any number of threads).\n"
         "\n"
         "See also: process-kaldi-pitch-feats, compute-and-process-kaldi-pitch-feats\n";
 
@@ -46,6 +96,9 @@ int main(int argc, char *argv[]) {
                         // similar.
 
     pitch_opts.Register(&po);
+    TaskSequencerConfig sequencer_config;  // has --num-threads and
+                                           // --num-threads-total options.
+    sequencer_config.Register(&po);
 
     po.Read(argc, argv);
 
@@ -61,6 +114,7 @@ int main(int argc, char *argv[]) {
     BaseFloatMatrixWriter feat_writer(feat_wspecifier);
 
     int32 num_done = 0, num_err = 0;
+    TaskSequencer<PitchComputationTask> sequencer(sequencer_config);
     for (; !wav_reader.Done(); wav_reader.Next()) {
       std::string utt = wav_reader.Key();
       const WaveData &wave_data = wav_reader.Value();
@@ -92,21 +146,11 @@ int main(int argc, char *argv[]) {
 
 
       SubVector<BaseFloat> waveform(wave_data.Data(), this_chan);
-      Matrix<BaseFloat> features;
-      try {
-        ComputeKaldiPitch(pitch_opts, waveform, &features);
-      } catch (...) {
-        KALDI_WARN << "Failed to compute pitch for utterance "
-                   << utt;
-        num_err++;
-        continue;
-      }
-
-      feat_writer.Write(utt, features);
-      if (num_done % 50 == 0 && num_done != 0)
-        KALDI_VLOG(2) << "Processed " << num_done << " utterances";
-      num_done++;
+      sequencer.Run(new PitchComputationTask(pitch_opts, utt, waveform,
+                                             &feat_writer, &num_done,
+                                             &num_err));
     }
+    sequencer.Wait();
     KALDI_LOG << "Done " << num_done << " utterances, " << num_err
               << " with errors.";
     return (num_done != 0 ? 0 : 1);
@@ -20,6 +20,7 @@
 #include "base/kaldi-common.h"
 #include "feat/feature-spectrogram.h"
 #include "feat/wave-reader.h"
+#include "feat/wave-segments.h"
 #include "util/common-utils.h"
 
 
@@ -38,6 +39,7 @@ int main(int argc, char *argv[]) {
     bool subtract_mean = false;
     int32 channel = -1;
     BaseFloat min_duration = 0.0;
+    std::string segments_rxfilename;
     std::string output_format = "kaldi";
     std::string utt2dur_wspecifier;
 
@@ -52,6 +54,11 @@ int main(int argc, char *argv[]) {
                 "0 -> left, 1 -> right)");
     po.Register("min-duration", &min_duration, "Minimum duration of segments "
                 "to process (in seconds).");
+    po.Register("segments", &segments_rxfilename, "Segments file, with lines "
+                "<segment-id> <recording-id> <start-time> <end-time> "
+                "[<channel>]; if given, features are computed for these "
+                "segments of the recordings, reading just the segments if "
+                "<wav-rspecifier> is a script file (see extract-segments).");
     po.Register("write-utt2dur", &utt2dur_wspecifier, "Wspecifier to write "
                 "duration of each utterance in seconds, e.g. 'ark,t:utt2dur'.");
 
@@ -68,7 +75,7 @@ int main(int argc, char *argv[]) {
 
     Spectrogram spec(spec_opts);
 
-    SequentialTableReader<WaveHolder> reader(wav_rspecifier);
+    SequentialWaveSegmentReader reader(wav_rspecifier, segments_rxfilename);
     BaseFloatMatrixWriter kaldi_writer;  // typedef to TableWriter<something>.
     TableWriter<HtkMatrixHolder> htk_writer;
 
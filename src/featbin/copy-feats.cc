@@ -42,6 +42,7 @@ int main(int argc, char *argv[]) {
     bool htk_in = false;
     bool sphinx_in = false;
     bool compress = false;
+    bool write_stats = false;
     int32 compression_method_in = 1;
     std::string num_frames_wspecifier;
     po.Register("htk-in", &htk_in, "Read input as HTK features");
@@ -55,6 +56,12 @@ int main(int argc, char *argv[]) {
                 "Only relevant if --compress=true; the method (1 through 7) to "
                 "compress the matrix.  Search for CompressionMethod in "
                 "src/matrix/compressed-matrix.h.");
+    po.Register("write-stats", &write_stats, "If true, write each matrix with "
+                "a header of its statistics (number of frames, and sums of the "
+                "features and their squares), from which feat-to-len, "
+                "feat-to-dim and compute-cmvn-stats can get them without "
+                "reading the features.  Only for tables in binary mode; "
+                "compatible with --compress.");
     po.Register("write-num-frames", &num_frames_wspecifier,
                 "Wspecifier to write length in frames of each utterance. "
                 "e.g. 'ark,t:utt2num_frames'.  Only applicable if writing tables, "
@@ -79,7 +86,32 @@ int main(int argc, char *argv[]) {
       std::string wspecifier = po.GetArg(2);
       Int32Writer num_frames_writer(num_frames_wspecifier);
 
-      if (!compress) {
+      if (write_stats) {
+        if (htk_in || sphinx_in)
+          KALDI_ERR << "--write-stats is not supported with --htk-in or "
+                    << "--sphinx-in.";
+        MatrixWithStatsWriter kaldi_writer(wspecifier);
+        SequentialBaseFloatMatrixReader kaldi_reader(rspecifier);
+        for (; !kaldi_reader.Done(); kaldi_reader.Next(), num_done++) {
+          kaldi_writer.Write(kaldi_reader.Key(),
+                             MatrixWithStats(kaldi_reader.Value(), compress,
+                                             compression_method));
+          if (!num_frames_wspecifier.empty())
+            num_frames_writer.Write(kaldi_reader.Key(),
+                                    kaldi_reader.Value().NumRows());
+        }
+      } else if (!compress && !htk_in && !sphinx_in) {
+        // Matrices that are already in the output format are copied without
+        // being parsed.
+        SerializedMatrixWriter kaldi_writer(wspecifier);
+        SequentialSerializedMatrixReader kaldi_reader(rspecifier);
+        for (; !kaldi_reader.Done(); kaldi_reader.Next(), num_done++) {
+          kaldi_writer.Write(kaldi_reader.Key(), kaldi_reader.Value());
+          if (!num_frames_wspecifier.empty())
+            num_frames_writer.Write(kaldi_reader.Key(),
+                                    kaldi_reader.Value().NumRows());
+        }
+      } else if (!compress) {
         BaseFloatMatrixWriter kaldi_writer(wspecifier);
         if (htk_in) {
           SequentialTableReader<HtkMatrixHolder> htk_reader(rspecifier);
@@ -89,7 +121,7 @@ int main(int argc, char *argv[]) {
               num_frames_writer.Write(htk_reader.Key(),
                                       htk_reader.Value().first.NumRows());
           }
-        } else if (sphinx_in) {
+        } else {
           SequentialTableReader<SphinxMatrixHolder<> > sphinx_reader(rspecifier);
           for (; !sphinx_reader.Done(); sphinx_reader.Next(), num_done++) {
             kaldi_writer.Write(sphinx_reader.Key(), sphinx_reader.Value());
@@ -97,14 +129,6 @@ int main(int argc, char *argv[]) {
               num_frames_writer.Write(sphinx_reader.Key(),
                                       sphinx_reader.Value().NumRows());
           }
-        } else {
-          SequentialBaseFloatMatrixReader kaldi_reader(rspecifier);
-          for (; !kaldi_reader.Done(); kaldi_reader.Next(), num_done++) {
-            kaldi_writer.Write(kaldi_reader.Key(), kaldi_reader.Value());
-            if (!num_frames_wspecifier.empty())
-              num_frames_writer.Write(kaldi_reader.Key(),
-                                      kaldi_reader.Value().NumRows());
-          }
         }
       } else {
         CompressedMatrixWriter kaldi_writer(wspecifier);
@@ -144,6 +168,9 @@ int main(int argc, char *argv[]) {
       return (num_done != 0 ? 0 : 1);
     } else {
       KALDI_ASSERT(!compress && "Compression not yet supported for single files");
+      if (write_stats)
+        KALDI_ERR << "--write-stats option not supported when writing single "
+                  << "files.";
       if (!num_frames_wspecifier.empty())
         KALDI_ERR << "--write-num-frames option not supported when writing/reading "
                   << "single files.";
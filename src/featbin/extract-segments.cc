@@ -21,6 +21,7 @@
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
 #include "feat/wave-reader.h"
+#include "feat/wave-segments.h"
 
 /*! @brief This is the main program for extracting segments from a wav file
  - usage :
@@ -47,16 +48,13 @@ int main(int argc, char *argv[]) {
         "where <channel> will normally be 0 (left) or 1 (right)\n"
         "e.g. call-861225-A-0050-0065 call-861225 5.0 6.5 1\n"
         "And <end-time> of -1 means the segment runs till the end of the WAV file\n"
+        "If <wav-rspecifier> is a script file, only the segments are read from\n"
+        "the recordings (see --resample-freq to resample them).\n"
         "See also: extract-feature-segments, wav-copy, wav-to-duration\n";
 
     ParseOptions po(usage);
-    BaseFloat min_segment_length = 0.1, // Minimum segment length in seconds.
-        max_overshoot = 0.5;  // max time by which last segment can overshoot
-    po.Register("min-segment-length", &min_segment_length,
-                "Minimum segment length in seconds (reject shorter segments)");
-    po.Register("max-overshoot", &max_overshoot,
-                "End segments overshooting audio by less than this (in seconds) "
-                "are truncated, else rejected.");
+    WaveSegmentOptions opts;
+    opts.Register(&po);
 
     po.Read(argc, argv);
     if (po.NumArgs() != 3) {
@@ -68,129 +66,24 @@ int main(int argc, char *argv[]) {
     std::string segments_rxfilename = po.GetArg(2);
     std::string wav_wspecifier = po.GetArg(3);
 
-    RandomAccessTableReader<WaveHolder> reader(wav_rspecifier);
+    // If wav_rspecifier is a script file, only the segments are read from the
+    // recordings.
+    SequentialWaveSegmentReader reader(wav_rspecifier, segments_rxfilename,
+                                       opts);
     TableWriter<WaveHolder> writer(wav_wspecifier);
-    Input ki(segments_rxfilename);  // No binary argment: never binary.
-
-    int32 num_lines = 0, num_success = 0;
-
-    std::string line;
-    // Read each line from the segments file.
-    while (std::getline(ki.Stream(), line)) {
-      num_lines++;
-      std::vector<std::string> split_line;
-      // Split the line into whitespace-separated fields and verify their
-      // number. There must be 4 or 5 fields: segment name, reacording ID, start
-      // time, end time, and the optional channel number.
-      SplitStringToVector(line, " \t\r", true, &split_line);
-      if (split_line.size() != 4 && split_line.size() != 5) {
-        KALDI_WARN << "Invalid line in segments file: " << line;
-        continue;
-      }
-      std::string segment = split_line[0],
-          recording = split_line[1],
-          start_str = split_line[2],
-          end_str = split_line[3];
-
-      // Parse the start and end times as float values. Segment is ignored if
-      // any of end times is malformed.
-      double start, end;
-      if (!ConvertStringToReal(start_str, &start)) {
-        KALDI_WARN << "Invalid line in segments file [bad start]: " << line;
-        continue;
-      }
-      if (!ConvertStringToReal(end_str, &end)) {
-        KALDI_WARN << "Invalid line in segments file [bad end]: " << line;
-        continue;
-      }
-      // Start time must be non-negative and not greater than the end time,
-      // except if the end time is -1.
-      if (start < 0 || (end != -1.0 && end <= 0) ||
-          ((start >= end) && (end > 0))) {
-        KALDI_WARN << ("Invalid line in segments file "
-                       "[empty or invalid segment]: ") << line;
-        continue;
-      }
-      int32 channel = -1;  // -1 means channel is unspecified.
-      // If the line has 5 elements, then the 5th element is the channel number.
-      if (split_line.size() == 5) {
-        if (!ConvertStringToInteger(split_line[4], &channel) || channel < 0) {
-          KALDI_WARN << "Invalid line in segments file [bad channel]: " << line;
-          continue;
-        }
-      }
-
-      // Check whether the recording ID is in wav.scp; if not, skip the segment.
-      if (!reader.HasKey(recording)) {
-        KALDI_WARN << "Could not find recording " << recording
-                   << ", skipping segment " << segment;
-        continue;
-      }
-
-      const WaveData &wave = reader.Value(recording);
-      const Matrix<BaseFloat> &wave_data = wave.Data();
-      BaseFloat samp_freq = wave.SampFreq();  // Sampling fequency.
-      int32 num_samp = wave_data.NumCols(),  // Number of samples in recording.
-        num_chan = wave_data.NumRows();  // Number of channels in recording.
-      BaseFloat file_length = num_samp / samp_freq;  // In seconds.
-
-      // Start must be within the wave data, otherwise skip the segment.
-      if (start < 0 || start > file_length) {
-        KALDI_WARN << "Segment start is out of file data range [0, "
-                   << file_length << "s]; skipping segment '" << line << "'";
-        continue;
-      }
-
-      // End must be less than the file length adjusted for possible overshoot;
-      // otherwise skip the segment. end == -1 passes the check.
-      if (end > file_length + max_overshoot) {
-        KALDI_WARN << "Segment end is too far out of file data range [0,"
-                   << file_length << "s]; skipping segment '" << line << "'";
-        continue;
-      }
-
-      // Otherwise ensure the end is not beyond the end of data, and default
-      // end == -1 to the end of file data.
-      if (end < 0 || end > file_length) end = file_length;
-
-      // Skip if segment size is less than the minimum allowed.
-      if (end - start < min_segment_length) {
-        KALDI_WARN << "Segment " << segment << " too short, skipping it.";
-        continue;
-      }
 
+    int32 num_success = 0;
+    for (; !reader.Done(); reader.Next()) {
       // Check that the channel is specified in the segments file for a multi-
-      // channel file, and that the channel actually exists in the wave data.
-      if (channel == -1) {
-        if (num_chan == 1) channel = 0;
-        else {
-          KALDI_ERR << ("Your data has multiple channels. You must "
-                        "specify the channel in the segments file. "
-                        "Skipping segment ") << segment;
-        }
-      } else {
-        if (channel >= num_chan) {
-          KALDI_WARN << "Invalid channel " << channel << " >= " << num_chan
-                     << ". Skipping segment " << segment;
-          continue;
-        }
-      }
-
-      // Convert endpoints of the segment to sample numbers. Note that the
-      // conversion requires a proper rounding.
-      int32 start_samp = static_cast<int32>(start * samp_freq + 0.5f),
-          end_samp = static_cast<int32>(end * samp_freq + 0.5f);
-    
-      if (end_samp > num_samp) 
-        end_samp = num_samp;
-     
-      // Get the range of data from the orignial wave_data matrix.
-      SubMatrix<BaseFloat> segment_matrix(wave_data, channel, 1,
-                                          start_samp, end_samp - start_samp);
-      WaveData segment_wave(samp_freq, segment_matrix);
-      writer.Write(segment, segment_wave);  // Write the range in wave format.
+      // channel file.
+      if (reader.Value().Data().NumRows() > 1)
+        KALDI_ERR << ("Your data has multiple channels. You must "
+                      "specify the channel in the segments file. "
+                      "Skipping segment ") << reader.Key();
+      writer.Write(reader.Key(), reader.Value());
       num_success++;
     }
+    int32 num_lines = reader.NumLines();
     KALDI_LOG << "Successfully processed " << num_success << " lines out of "
               << num_lines << " in the segments file. ";
     return 0;
@@ -46,7 +46,7 @@ int main(int argc, char *argv[]) {
     std::string rspecifier = po.GetArg(1);
     std::string wspecifier_or_wxfilename = po.GetArg(2);
 
-    SequentialBaseFloatMatrixReader kaldi_reader(rspecifier);
+    SequentialMatrixStatsReader kaldi_reader(rspecifier);
       
     if (ClassifyWspecifier(wspecifier_or_wxfilename, NULL, NULL, NULL)
         != kNoWspecifier) {
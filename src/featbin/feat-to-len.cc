@@ -50,13 +50,13 @@ int main(int argc, char *argv[]) {
 
       Int32Writer length_writer(wspecifier);
 
-      SequentialBaseFloatMatrixReader matrix_reader(rspecifier);
+      SequentialMatrixStatsReader matrix_reader(rspecifier);
       for (; !matrix_reader.Done(); matrix_reader.Next())
         length_writer.Write(matrix_reader.Key(), matrix_reader.Value().NumRows());
     } else {
       int64 tot = 0;
       std::string rspecifier = po.GetArg(1);
-      SequentialBaseFloatMatrixReader matrix_reader(rspecifier);
+      SequentialMatrixStatsReader matrix_reader(rspecifier);
       for (; !matrix_reader.Done(); matrix_reader.Next())
         tot += matrix_reader.Value().NumRows();
       std::cout << tot << std::endl;
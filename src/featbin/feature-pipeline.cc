@@ -0,0 +1,149 @@
+// featbin/feature-pipeline.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "feat/feature-pipeline.h"
+
+namespace kaldi {
+
+// Applies the pipeline to one utterance (in operator ()), and writes it out
+// in the destructor, so that utterances can be processed in parallel by a
+// TaskSequencer while the output stays in the same order.
+class FeaturePipelineTask {
+ public:
+  FeaturePipelineTask(const FeaturePipeline &pipeline,
+                      const std::string &utt,
+                      FeaturePipeline::UtteranceInfo *info,
+                      const Matrix<BaseFloat> &feats,
+                      BaseFloatMatrixWriter *feat_writer,
+                      int32 *num_done, int32 *num_err):
+      pipeline_(pipeline), utt_(utt), feats_(feats), feat_writer_(feat_writer),
+      num_done_(num_done), num_err_(num_err), ok_(false) {
+    info_.cmvn_stats.Swap(&(info->cmvn_stats));
+    info_.fmllr.Swap(&(info->fmllr));
+  }
+
+  void operator () () {
+    try {
+      ok_ = pipeline_.Apply(utt_, info_, feats_, &feats_out_);
+    } catch (const std::exception &e) {
+      KALDI_WARN << e.what();
+      ok_ = false;
+    }
+  }
+
+  ~FeaturePipelineTask() {
+    if (!ok_) {
+      (*num_err_)++;
+      return;
+    }
+    feat_writer_->Write(utt_, feats_out_);
+    (*num_done_)++;
+  }
+ private:
+  const FeaturePipeline &pipeline_;
+  std::string utt_;
+  FeaturePipeline::UtteranceInfo info_;
+  Matrix<BaseFloat> feats_;
+  Matrix<BaseFloat> feats_out_;
+  BaseFloatMatrixWriter *feat_writer_;
+  int32 *num_done_;
+  int32 *num_err_;
+  bool ok_;
+};
+
+}  // namespace kaldi
+
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+
+    const char *usage =
+        "Apply, in one program, the feature processing that recipes do with\n"
+        "pipes of apply-cmvn, add-deltas, splice-feats, transform-feats and\n"
+        "subsample-feats, without writing out and parsing the features\n"
+        "between the stages.  The configured stages are applied in the order\n"
+        "CMVN, deltas, splicing, --transform, --fmllr, subsampling; splicing\n"
+        "and the transforms are done together in one matrix multiplication.\n"
+        "Utterances are processed in parallel with --num-threads > 1 (the\n"
+        "output is the same for any number of threads).\n"
+        "\n"
+        "Usage: feature-pipeline [options] <feats-rspecifier> "
+        "<feats-wspecifier>\n"
+        "e.g.: feature-pipeline --cmvn=scp:cmvn.scp --utt2spk=ark:utt2spk \\\n"
+        "  --left-context=3 --right-context=3 --transform=final.mat \\\n"
+        "  --fmllr=ark:trans.1 scp:feats.scp ark:-\n"
+        "is the same as\n"
+        " apply-cmvn --utt2spk=ark:utt2spk scp:cmvn.scp scp:feats.scp ark:- |\\\n"
+        "  splice-feats --left-context=3 --right-context=3 ark:- ark:- |\\\n"
+        "  transform-feats final.mat ark:- ark:- |\\\n"
+        "  transform-feats --utt2spk=ark:utt2spk ark:trans.1 ark:- ark:-\n"
+        "See also: apply-cmvn, add-deltas, splice-feats, transform-feats,\n"
+        "subsample-feats\n";
+
+    ParseOptions po(usage);
+    FeaturePipelineOptions pipeline_opts;
+    TaskSequencerConfig sequencer_config;  // has --num-threads and
+                                           // --num-threads-total options.
+    pipeline_opts.Register(&po);
+    sequencer_config.Register(&po);
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 2) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string feat_rspecifier = po.GetArg(1),
+        feat_wspecifier = po.GetArg(2);
+
+    FeaturePipeline pipeline(pipeline_opts);
+    SequentialBaseFloatMatrixReader feat_reader(feat_rspecifier);
+    BaseFloatMatrixWriter feat_writer(feat_wspecifier);
+
+    // num_err is incremented by the tasks, and num_missing (the utterances
+    // without CMVN stats or fMLLR transforms) by this thread.
+    int32 num_done = 0, num_err = 0, num_missing = 0;
+    {
+      TaskSequencer<FeaturePipelineTask> sequencer(sequencer_config);
+      for (; !feat_reader.Done(); feat_reader.Next()) {
+        std::string utt = feat_reader.Key();
+        FeaturePipeline::UtteranceInfo info;
+        if (!pipeline.GetUtteranceInfo(utt, &info)) {
+          num_missing++;
+          continue;
+        }
+        sequencer.Run(new FeaturePipelineTask(pipeline, utt, &info,
+                                              feat_reader.Value(),
+                                              &feat_writer, &num_done,
+                                              &num_err));
+      }
+      sequencer.Wait();
+    }
+    KALDI_LOG << "Processed " << num_done << " utterances; "
+              << (num_err + num_missing) << " had errors.";
+    return (num_done != 0 ? 0 : 1);
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
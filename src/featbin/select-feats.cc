@@ -53,7 +53,7 @@ int main(int argc, char *argv[]) {
     string wspecifier = po.GetArg(3);
 
     // set up input (we'll need that to validate the selected indices)
-    SequentialBaseFloatMatrixReader kaldi_reader(rspecifier);
+    SequentialSerializedMatrixReader kaldi_reader(rspecifier);
 
     if (kaldi_reader.Done()) {
       KALDI_WARN << "Empty archive provided.";
@@ -115,12 +115,24 @@ int main(int argc, char *argv[]) {
       return 1;
     }
 
+    // if all dimensions are selected in order, the features are just copied,
+    // without being parsed.
+    bool select_all = (ranges.size() == 1 && ranges[0].first == 0 &&
+                       ranges[0].second == dim_in - 1);
+
     // set up output
-    BaseFloatMatrixWriter kaldi_writer(wspecifier);
+    SerializedMatrixWriter kaldi_writer(wspecifier);
 
     // process all keys
     for (; !kaldi_reader.Done(); kaldi_reader.Next()) {
-      Matrix<BaseFloat> feats(kaldi_reader.Value().NumRows(), dim_out);
+      if (select_all && kaldi_reader.Value().NumCols() == dim_in) {
+        kaldi_writer.Write(kaldi_reader.Key(), kaldi_reader.Value());
+        continue;
+      }
+      const Matrix<BaseFloat> &input = kaldi_reader.Value().Value();
+      SerializedMatrix output;
+      Matrix<BaseFloat> &feats = output.MutableValue();
+      feats.Resize(input.NumRows(), dim_out);
 
       // extract the desired ranges
       for (int32 i = 0; i < ranges.size(); ++i) {
@@ -128,10 +140,10 @@ int main(int argc, char *argv[]) {
         int32 ncol = ranges[i].second - f + 1;
 
         feats.Range(0, feats.NumRows(), offsets[i], ncol)
-          .CopyFromMat(kaldi_reader.Value().Range(0, feats.NumRows(), f, ncol));
+          .CopyFromMat(input.Range(0, feats.NumRows(), f, ncol));
       }
 
-      kaldi_writer.Write(kaldi_reader.Key(), feats);
+      kaldi_writer.Write(kaldi_reader.Key(), output);
     }
 
     return 0;
@@ -25,8 +25,8 @@
 using namespace kaldi;
 
 int32 CopyIncludedFeats(std::string filename,
-                        SequentialBaseFloatMatrixReader *kaldi_reader,
-                        BaseFloatMatrixWriter *kaldi_writer) {
+                        SequentialSerializedMatrixReader *kaldi_reader,
+                        SerializedMatrixWriter *kaldi_writer) {
   unordered_set<std::string, StringHasher> include_set;
   bool binary;
   Input ki(filename, &binary);
@@ -55,8 +55,8 @@ int32 CopyIncludedFeats(std::string filename,
 }
 
 int32 CopyExcludedFeats(std::string filename,
-                        SequentialBaseFloatMatrixReader *kaldi_reader,
-                        BaseFloatMatrixWriter *kaldi_writer) {
+                        SequentialSerializedMatrixReader *kaldi_reader,
+                        SerializedMatrixWriter *kaldi_writer) {
   unordered_set<std::string, StringHasher> exclude_set;
   bool binary;
   Input ki(filename, &binary);
@@ -130,8 +130,9 @@ int main(int argc, char *argv[]) {
 
     KALDI_ASSERT(n >= 0);
 
-    BaseFloatMatrixWriter kaldi_writer(wspecifier);
-    SequentialBaseFloatMatrixReader kaldi_reader(rspecifier);
+    // The matrices are copied without being parsed.
+    SerializedMatrixWriter kaldi_writer(wspecifier);
+    SequentialSerializedMatrixReader kaldi_reader(rspecifier);
 
     if (include_rxfilename != "") {
       if (n != 10) {
@@ -21,6 +21,7 @@
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
 #include "matrix/kaldi-matrix.h"
+#include "transform/transform-common.h"
 
 
 int main(int argc, char *argv[]) {
@@ -33,12 +34,27 @@ int main(int argc, char *argv[]) {
         "transform-num-cols == feature-dim+1 (->append 1.0 to features)\n"
         "Per-utterance by default, or per-speaker if utt2spk option provided\n"
         "Global if transform-rxfilename provided.\n"
+        "With --left-context/--right-context, the input features are spliced\n"
+        "first (as splice-feats does, but without creating the spliced features)\n"
+        "and with --pre-transform, a global transform (e.g. LDA) is composed with\n"
+        "the transform, so e.g. \"splice-feats | transform-feats lda.mat |\n"
+        "transform-feats ark:trans\" becomes a single, faster, transform-feats.\n"
         "Usage: transform-feats [options] (<transform-rspecifier>|<transform-rxfilename>) <feats-rspecifier> <feats-wspecifier>\n"
+        "e.g.: transform-feats --left-context=3 --right-context=3 --pre-transform=final.mat \\\n"
+        "  --utt2spk=ark:utt2spk ark:trans.1 scp:feats.scp ark:-\n"
         "See also: transform-vec, copy-feats, compose-transforms\n";
         
     ParseOptions po(usage);
-    std::string utt2spk_rspecifier;
+    std::string utt2spk_rspecifier, pre_transform_rxfilename;
+    int32 left_context = 0, right_context = 0;
     po.Register("utt2spk", &utt2spk_rspecifier, "rspecifier for utterance to speaker map");
+    po.Register("left-context", &left_context, "Number of frames of left "
+                "context to splice the input features with.");
+    po.Register("right-context", &right_context, "Number of frames of right "
+                "context to splice the input features with.");
+    po.Register("pre-transform", &pre_transform_rxfilename, "Global transform "
+                "to apply (to the spliced features) before the transform; it "
+                "is composed with the transform, so that only one is applied.");
 
     po.Read(argc, argv);
 
@@ -73,6 +89,12 @@ int main(int argc, char *argv[]) {
       }
     }
 
+    Matrix<BaseFloat> pre_transform;
+    if (!pre_transform_rxfilename.empty())
+      ReadKaldiObject(pre_transform_rxfilename, &pre_transform);
+    // The composition of the global transform with pre_transform.
+    Matrix<BaseFloat> global_composed_transform;
+
     enum { Unknown, Logdet, PseudoLogdet, DimIncrease };
     int32 logdet_type = Unknown;
     double tot_t = 0.0, tot_logdet = 0.0;  // to compute average logdet weighted by time...
@@ -93,20 +115,10 @@ int main(int argc, char *argv[]) {
           (use_global_transform ? global_transform : transform_reader.Value(utt));
       int32 transform_rows = trans.NumRows(),
           transform_cols = trans.NumCols(),
-          feat_dim = feat.NumCols();
-
-      Matrix<BaseFloat> feat_out(feat.NumRows(), transform_rows);
-
-      if (transform_cols == feat_dim) {
-        feat_out.AddMatMat(1.0, feat, kNoTrans, trans, kTrans, 0.0);
-      } else if (transform_cols == feat_dim + 1) {
-        // append the implicit 1.0 to the input features.
-        SubMatrix<BaseFloat> linear_part(trans, 0, transform_rows, 0, feat_dim);
-        feat_out.AddMatMat(1.0, feat, kNoTrans, linear_part, kTrans, 0.0);
-        Vector<BaseFloat> offset(transform_rows);
-        offset.CopyColFromMat(trans, feat_dim);
-        feat_out.AddVecToRows(1.0, offset);
-      } else {
+          feat_dim = (pre_transform.NumRows() != 0 ? pre_transform.NumRows() :
+                      feat.NumCols() * (1 + left_context + right_context));
+
+      if (transform_cols != feat_dim && transform_cols != feat_dim + 1) {
         KALDI_WARN << "Transform matrix for utterance " << utt << " has bad dimension "
                    << transform_rows << "x" << transform_cols << " versus feat dim "
                    << feat_dim;
@@ -116,6 +128,28 @@ int main(int argc, char *argv[]) {
         num_error++;
         continue;
       }
+
+      Matrix<BaseFloat> feat_out;
+      if (pre_transform.NumRows() == 0) {
+        ApplySplicedTransform(trans, left_context, right_context, feat,
+                              &feat_out);
+      } else {
+        bool pre_transform_is_affine = (pre_transform.NumCols() ==
+            feat.NumCols() * (1 + left_context + right_context) + 1);
+        if (use_global_transform) {
+          if (global_composed_transform.NumRows() == 0)
+            ComposeTransforms(trans, pre_transform, pre_transform_is_affine,
+                              &global_composed_transform);
+          ApplySplicedTransform(global_composed_transform, left_context,
+                                right_context, feat, &feat_out);
+        } else {
+          Matrix<BaseFloat> composed_transform;
+          ComposeTransforms(trans, pre_transform, pre_transform_is_affine,
+                            &composed_transform);
+          ApplySplicedTransform(composed_transform, left_context,
+                                right_context, feat, &feat_out);
+        }
+      }
       num_done++;
 
       if (logdet_type == Unknown) {
@@ -96,7 +96,8 @@ int main(int argc, char *argv[]) {
     ParseOptions po(usage);
     bool binary = true;
     std::string disambig_rxfilename,
-        disambig_wxfilename;
+        disambig_wxfilename,
+        ilabels_rxfilename;
     int32 context_width = 3, central_position = 1;
     int32 nonterm_phones_offset = -1;
     po.Register("binary", &binary,
@@ -108,6 +109,11 @@ int main(int argc, char *argv[]) {
     po.Register("context-size", &context_width, "Size of phone context window");
     po.Register("central-position", &central_position,
                 "Designated central position in context window");
+    po.Register("read-ilabels", &ilabels_rxfilename,
+                "If supplied, the ilabels-output-file of a previous run with "
+                "the same context (e.g. before G changed); the ilabels it "
+                "contains keep their numbering in the output, so that e.g. "
+                "Ha.fst can be reused if no new ilabels are needed.");
     po.Register("nonterm-phones-offset",  &nonterm_phones_offset,
                 "The integer id of #nonterm_bos in your phones.txt, if present "
                 "(only relevant for grammar-FST construction, see "
@@ -141,14 +147,32 @@ int main(int argc, char *argv[]) {
                  << "indicates an error in data preparation.";
     }
 
-    std::vector<std::vector<int32> > ilabels;
+    std::vector<std::vector<int32> > ilabels, ilabels_in;
+    if (ilabels_rxfilename != "") {
+      if (nonterm_phones_offset >= 0)
+        KALDI_ERR << "--read-ilabels is not supported with "
+                  << "--nonterm-phones-offset";
+      bool binary_in;
+      Input ki(ilabels_rxfilename, &binary_in);
+      ReadILabelInfo(ki.Stream(), binary_in, &ilabels_in);
+    }
     VectorFst<StdArc> composed_fst;
 
     // Work gets done here (see context-fst.h)
     if (nonterm_phones_offset < 0) {
       // The normal case.
       ComposeContext(disambig_in, context_width, central_position,
-                     fst, &composed_fst, &ilabels);
+                     fst, &composed_fst, &ilabels, false,
+                     (ilabels_rxfilename != "" ? &ilabels_in : NULL));
+      if (ilabels_rxfilename != "") {
+        if (ilabels.size() == ilabels_in.size())
+          KALDI_LOG << "No new ilabels were needed; the ilabels are the same "
+                    << "as in " << ilabels_rxfilename;
+        else
+          KALDI_LOG << (ilabels.size() - ilabels_in.size())
+                    << " ilabels were added to the " << ilabels_in.size()
+                    << " in " << ilabels_rxfilename;
+      }
     } else {
       // The grammar-FST case. See ../doc/grammar.dox for an intro.
       if (context_width != 2 || central_position != 1) {
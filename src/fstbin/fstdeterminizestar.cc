@@ -77,11 +77,22 @@ int main(int argc, char *argv[]) {
     float delta = kDelta;
     int max_states = -1;
     bool use_log = false;
+    DeterminizeStarOptions opts;
     ParseOptions po(usage);
     po.Register("use-log", &use_log, "Determinize in log semiring.");
     po.Register("delta", &delta, "Delta value used to determine equivalence of weights.");
     po.Register("max-states", &max_states, "Maximum number of states in determinized FST before it will abort.");
+    po.Register("num-threads", &opts.num_threads, "Number of threads used to "
+                "expand determinized states (not with --use-log).");
+    po.Register("spill-dir", &opts.spill_dir, "If set, a directory in which "
+                "to keep the arcs of finished states in a temporary file "
+                "rather than in memory (not with --use-log).");
+    po.Register("progress-interval", &opts.progress_interval, "If >0, log "
+                "progress every this many determinized states (not with "
+                "--use-log).");
     po.Read(argc, argv);
+    opts.delta = delta;
+    opts.max_states = max_states;
 
     if (po.NumArgs() > 2) {
       po.PrintUsage();
@@ -105,7 +116,7 @@ int main(int argc, char *argv[]) {
         DeterminizeStarInLog(fst, delta, &debug_location, max_states);
       } else {
         VectorFst<StdArc> det_fst;
-        DeterminizeStar(*fst, &det_fst, delta, &debug_location, max_states);
+        DeterminizeStar(*fst, &det_fst, opts, &debug_location);
         *fst = det_fst;  // will do shallow copy and then det_fst goes
         // out of scope anyway.
       }
@@ -124,7 +135,7 @@ int main(int argc, char *argv[]) {
             DeterminizeStarInLog(&fst, delta, &debug_location, max_states);
           } else {
             VectorFst<StdArc> det_fst;
-            DeterminizeStar(fst, &det_fst, delta, &debug_location, max_states);
+            DeterminizeStar(fst, &det_fst, opts, &debug_location);
             fst = det_fst;  // will do shallow copy and then det_fst goes out
             // of scope anyway.
           }
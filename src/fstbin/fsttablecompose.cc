@@ -74,6 +74,8 @@ int main(int argc, char *argv[]) {
                 "match, one of: \"left\" or \"right\".");
     po.Register("compose-filter", &compose_filter, "Composition filter to use, "
                 "one of: \"alt_sequence\", \"auto\", \"match\", \"sequence\"");
+    po.Register("num-threads", &opts.num_threads, "Number of threads used to "
+                "compose (ignored when an FST is composed with an archive).");
     
     po.Read(argc, argv);
 
@@ -72,7 +72,20 @@ int main(int argc, char *argv[]) {
         "   will then become the arguments <top-level-fst>, <fst1>, ... for usage\n"
         "   pattern (1).\n"
         "\n"
-        "The --nonterm-phones-offset option is required for both usage patterns.\n";
+        "Usage (3): make-grammar-fst --update=<grammar-fst-in> <symbol1> <fst1> \\\n"
+        "                            [<symbol2> <fst2> ...]] <fst-out>\n"
+        "  Update a GrammarFst written by usage pattern (1), replacing (or\n"
+        "  adding) the FSTs of the nonterminals given; the top-level FST and\n"
+        "  the FSTs of the other nonterminals are kept as they are.  This is\n"
+        "  for when a grammar is refreshed often: if the parts that change\n"
+        "  (e.g. lists of names, or new words) are in nonterminals, only\n"
+        "  their (small) HCLG's need to be rebuilt and prepared with usage\n"
+        "  pattern (2), not the whole graph.\n"
+        "  e.g.: make-grammar-fst --update=HCLG_grammar.fst 320 HCLG1_new.fst \\\n"
+        "            HCLG_grammar_new.fst\n"
+        "\n"
+        "The --nonterm-phones-offset option is required for usage patterns (1)\n"
+        "and (2); for (3) it is read from <grammar-fst-in>.\n";
 
 
     ParseOptions po(usage);
@@ -80,6 +93,7 @@ int main(int argc, char *argv[]) {
 
     int32 nonterm_phones_offset = -1;
     bool write_as_grammar = true;
+    std::string update_rxfilename;
 
     po.Register("nonterm-phones-offset", &nonterm_phones_offset,
                 "Integer id of #nonterm_bos in phones.txt");
@@ -87,16 +101,20 @@ int main(int argc, char *argv[]) {
                 "write as GrammarFst object; if false, convert to "
                 "ConstFst<StdArc> (readable by standard decoders) "
                 "and write that.");
+    po.Register("update", &update_rxfilename, "If supplied, a GrammarFst "
+                "in which to replace the FSTs of the nonterminals given "
+                "(usage pattern (3)).");
 
     po.Read(argc, argv);
 
-
-    if (po.NumArgs() < 2 || po.NumArgs() % 2 != 0) {
+    bool update = (update_rxfilename != "");
+    if (po.NumArgs() < 2 ||
+        po.NumArgs() % 2 != (update ? 1 : 0)) {
       po.PrintUsage();
       exit(1);
     }
 
-    if (nonterm_phones_offset < 0)
+    if (!update && nonterm_phones_offset < 0)
       KALDI_ERR << "The --nonterm-phones-offset option must be supplied "
           "and positive.";
 
@@ -111,30 +129,45 @@ int main(int argc, char *argv[]) {
       exit(0);
     }
 
-    std::string top_fst_str = po.GetArg(1),
-        fst_out_str = po.GetArg(po.NumArgs());
+    std::string fst_out_str = po.GetArg(po.NumArgs());
 
-    std::shared_ptr<const ConstFst<StdArc> > top_fst(
-        ReadAsConstFst(top_fst_str));
     std::vector<std::pair<int32, std::shared_ptr<const ConstFst<StdArc> > > > pairs;
 
-    int32 num_pairs = (po.NumArgs() - 2) / 2;
-    for (int32 i = 1; i <= num_pairs; i++) {
+    // In usage pattern (3) the pairs start at the first argument, otherwise
+    // after the top-level FST.
+    int32 first_pair_arg = (update ? 1 : 2),
+        num_pairs = (po.NumArgs() - first_pair_arg) / 2;
+    for (int32 i = 0; i < num_pairs; i++) {
       int32 nonterminal;
-      std::string nonterm_str = po.GetArg(2*i);
+      std::string nonterm_str = po.GetArg(first_pair_arg + 2*i);
       if (!ConvertStringToInteger(nonterm_str, &nonterminal) ||
           nonterminal <= 0)
         KALDI_ERR << "Expected positive integer as nonterminal, got: "
                   << nonterm_str;
-      std::string fst_str = po.GetArg(2*i + 1);
+      std::string fst_str = po.GetArg(first_pair_arg + 2*i + 1);
       std::shared_ptr<const ConstFst<StdArc> > this_fst(ReadAsConstFst(fst_str));
       pairs.push_back(std::pair<int32, std::shared_ptr<const ConstFst<StdArc> > >(
           nonterminal, this_fst));
     }
 
-    GrammarFst *grammar_fst = new GrammarFst(nonterm_phones_offset,
-                                             top_fst,
-                                             pairs);
+    GrammarFst *grammar_fst;
+    if (update) {
+      GrammarFst base_fst;
+      ReadKaldiObject(update_rxfilename, &base_fst);
+      if (nonterm_phones_offset >= 0 &&
+          nonterm_phones_offset != base_fst.NontermPhonesOffset())
+        KALDI_ERR << "--nonterm-phones-offset=" << nonterm_phones_offset
+                  << " does not match the value "
+                  << base_fst.NontermPhonesOffset() << " in "
+                  << update_rxfilename;
+      grammar_fst = new GrammarFst(base_fst, pairs);
+    } else {
+      std::shared_ptr<const ConstFst<StdArc> > top_fst(
+          ReadAsConstFst(po.GetArg(1)));
+      grammar_fst = new GrammarFst(nonterm_phones_offset,
+                                   top_fst,
+                                   pairs);
+    }
 
     if (write_as_grammar) {
       bool binary = true;  // GrammarFst does not support non-binary write.
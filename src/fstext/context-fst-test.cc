@@ -236,6 +236,19 @@ static void TestContextFst(bool verbose, bool use_matcher) {
                                             N, P);
     kaldi::AssertEqual(tot_cost, tot_cost_check);
 
+    // A context FST started from the ilabel-info of 'inv_cfst' should give
+    // the same labels, without adding any.
+    {
+      vector<vector<int32> > ilabel_info(inv_cfst.IlabelInfo());
+      InverseContextFst inv_cfst2(subsequential_symbol,
+                                  phones, disambig_syms,
+                                  N, P, &ilabel_info);
+      VectorFst<Arc> fst_composed2;
+      ComposeDeterministicOnDemandInverse(*f, &inv_cfst2, &fst_composed2);
+      KALDI_ASSERT(inv_cfst2.IlabelInfo() == ilabel_info);
+      KALDI_ASSERT(Equal(fst_composed, fst_composed2));
+    }
+
     delete f;
   }
 
@@ -28,7 +28,8 @@ InverseContextFst::InverseContextFst(
     const vector<int32>& phones,
     const vector<int32>& disambig_syms,
     int32 context_width,
-    int32 central_position):
+    int32 central_position,
+    const vector<vector<int32> > *ilabel_info):
     context_width_(context_width),
     central_position_(central_position),
     phone_syms_(phones),
@@ -49,6 +50,21 @@ InverseContextFst::InverseContextFst(
     }
   }
 
+  if (ilabel_info != NULL) {
+    // Start from the labels of the table we were given, so they keep their
+    // ids.
+    for (size_t i = 0; i < ilabel_info->size(); i++) {
+      const vector<int32> &info = (*ilabel_info)[i];
+      bool ok = (i == 0 ? info.empty() :
+                 (info.size() == 1 && info[0] <= 0) ||
+                 static_cast<int32>(info.size()) == context_width_);
+      if (!ok || !ilabel_map_.insert(std::make_pair(info, i)).second)
+        KALDI_ERR << "Invalid ilabel-info supplied for context width "
+                  << context_width_ << " (entry " << i << ")";
+    }
+    ilabel_info_ = *ilabel_info;
+  }
+
   // empty vector, will be the ilabel_info vector that corresponds to epsilon,
   // in case our FST needs to output epsilons.
   vector<int32> empty_vec;
@@ -74,7 +90,9 @@ InverseContextFst::InverseContextFst(
     vector<int32> pseudo_eps_vec;
     pseudo_eps_vec.push_back(0);
     pseudo_eps_symbol_= FindLabel(pseudo_eps_vec);
-    KALDI_ASSERT(pseudo_eps_symbol_ == 1);
+    if (pseudo_eps_symbol_ != 1)
+      KALDI_ERR << "The ilabel-info supplied has no #-1 symbol; it was "
+                << "probably created without disambiguation symbols.";
   } else {
     pseudo_eps_symbol_ = 0;  // use actual epsilon.
   }
@@ -247,7 +265,8 @@ void ComposeContext(const vector<int32> &disambig_syms_in,
                     VectorFst<StdArc> *ifst,
                     VectorFst<StdArc> *ofst,
                     vector<vector<int32> > *ilabels_out,
-                    bool project_ifst) {
+                    bool project_ifst,
+                    const vector<vector<int32> > *ilabels_in) {
   KALDI_ASSERT(ifst != NULL && ofst != NULL);
   KALDI_ASSERT(context_width > 0);
   KALDI_ASSERT(central_position >= 0);
@@ -283,7 +302,7 @@ void ComposeContext(const vector<int32> &disambig_syms_in,
   }
 
   InverseContextFst inv_c(subseq_sym, phones, disambig_syms,
-                          context_width, central_position);
+                          context_width, central_position, ilabels_in);
 
   // The following statement is equivalent to the following
   // (if FSTs had the '*' operator for composition):
@@ -105,13 +105,22 @@ SymbolTable *CreateILabelInfoSymbolTable(const vector<vector<int32> > &ilabel_in
                   project on the input after adding the subsequential loop
                   to 'ifst', which allows us to reconstruct the context
                   fst C.fst.
+    @param [in] ilabels_in  If non-NULL, the ilabel-info of a previous
+                  composition with the same context width and central
+                  position (e.g. the ilabels file of the previous build of a
+                  graph whose G has since changed).  Its labels keep their
+                  numbering, and new phones-in-context are appended to it to
+                  make 'ilabels_out'; so if 'ilabels_out' comes out the same
+                  size as 'ilabels_in', things that only depend on the
+                  ilabels, such as Ha.fst, can be reused.
  */
 void ComposeContext(const vector<int32> &disambig_syms,
                     int32 context_width, int32 central_position,
                     VectorFst<StdArc> *ifst,
                     VectorFst<StdArc> *ofst,
                     vector<vector<int32> > *ilabels_out,
-                    bool project_ifst = false);
+                    bool project_ifst = false,
+                    const vector<vector<int32> > *ilabels_in = NULL);
 
 
 /**
@@ -169,13 +178,20 @@ public:
         @param [in] context_width  Size of context window, e.g. 3 for triphone.
         @param [in] central_position  Central position in context window (zero-based),
                                    e.g. 1 for triphone.
+        @param [in] ilabel_info  If non-NULL, an ilabel-info table as returned by
+                                   IlabelInfo() for an InverseContextFst with the
+                                   same context_width and central_position (it
+                                   may come from a previous graph build).  The
+                                   labels it contains are output with the same
+                                   ids, and any new ones are appended.
      See \ref graph_context for more details.
   */
   InverseContextFst(Label subsequential_symbol,
                     const vector<int32>& phones,
                     const vector<int32>& disambig_syms,
                     int32 context_width,
-                    int32 central_position);
+                    int32 central_position,
+                    const vector<vector<int32> > *ilabel_info = NULL);
 
 
   virtual StateId Start() { return 0; }
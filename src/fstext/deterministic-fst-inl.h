@@ -206,6 +206,28 @@ bool ComposeDeterministicOnDemandFst<Arc>::GetArc(StateId s, Label ilabel,
   return true;
 }
 
+template<class Arc>
+void ComposeDeterministicOnDemandFst<Arc>::PrefetchArcs(
+    const std::vector<std::pair<StateId, Label> > &queries) {
+  std::vector<std::pair<StateId, Label> > queries1, queries2;
+  queries1.reserve(queries.size());
+  for (size_t i = 0; i < queries.size(); i++) {
+    KALDI_ASSERT(queries[i].first < static_cast<StateId>(state_vec_.size()));
+    queries1.push_back(std::pair<StateId, Label>(
+        state_vec_[queries[i].first].first, queries[i].second));
+  }
+  fst1_->PrefetchArcs(queries1);
+  // The labels that fst2_ will be asked for are the olabels of fst1_'s arcs.
+  for (size_t i = 0; i < queries.size(); i++) {
+    Arc arc1;
+    if (fst1_->GetArc(queries1[i].first, queries1[i].second, &arc1) &&
+        arc1.olabel != 0)
+      queries2.push_back(std::pair<StateId, Label>(
+          state_vec_[queries[i].first].second, arc1.olabel));
+  }
+  fst2_->PrefetchArcs(queries2);
+}
+
 template<class Arc>
 inline size_t CacheDeterministicOnDemandFst<Arc>::GetIndex(
     StateId src_state, Label ilabel) {
@@ -255,6 +277,84 @@ bool CacheDeterministicOnDemandFst<Arc>::GetArc(StateId s, Label ilabel,
   }
 }
 
+template<class Arc>
+ConcurrentCacheDeterministicOnDemandFst<Arc>::
+ConcurrentCacheDeterministicOnDemandFst(DeterministicOnDemandFst<Arc> *fst,
+                                        size_t cache_bytes): fst_(fst) {
+  // The number of buckets is the largest power of 2 that fits in the budget.
+  size_t bucket_bytes = kBucketSize * sizeof(Slot), num_buckets = 1;
+  while (num_buckets * 2 * bucket_bytes <= cache_bytes)
+    num_buckets *= 2;
+  bucket_mask_ = num_buckets - 1;
+  slots_.resize(num_buckets * kBucketSize);
+}
+
+template<class Arc>
+typename Arc::StateId ConcurrentCacheDeterministicOnDemandFst<Arc>::Start() {
+  std::lock_guard<std::mutex> lock(fst_mutex_);
+  return fst_->Start();
+}
+
+template<class Arc>
+typename Arc::Weight ConcurrentCacheDeterministicOnDemandFst<Arc>::Final(
+    StateId s) {
+  std::lock_guard<std::mutex> lock(fst_mutex_);
+  return fst_->Final(s);
+}
+
+template<class Arc>
+bool ConcurrentCacheDeterministicOnDemandFst<Arc>::GetArc(StateId s,
+                                                          Label ilabel,
+                                                          Arc *oarc) {
+  // As in CacheDeterministicOnDemandFst, we don't cache the arcs that do not
+  // exist.
+  KALDI_ASSERT(s >= 0 && ilabel != 0);
+  kaldi::uint64 key = PackKey(s, ilabel), hash = HashKey(key);
+  size_t bucket = static_cast<size_t>(hash >> 32) & bucket_mask_;
+  Slot *slots = &(slots_[bucket * kBucketSize]);
+  std::mutex &bucket_mutex = bucket_mutexes_[bucket & (kNumLocks - 1)];
+  {
+    std::lock_guard<std::mutex> lock(bucket_mutex);
+    for (size_t i = 0; i < kBucketSize; i++) {
+      if (slots[i].key == key) {
+        *oarc = slots[i].arc;
+        return true;
+      }
+    }
+  }
+  Arc arc;
+  {
+    // We don't hold the bucket's lock here, so other threads can use the
+    // cache while the (possibly slow) wrapped FST works.
+    std::lock_guard<std::mutex> lock(fst_mutex_);
+    if (!fst_->GetArc(s, ilabel, &arc))
+      return false;
+  }
+  {
+    std::lock_guard<std::mutex> lock(bucket_mutex);
+    // Use the first free slot (or the one another thread just filled with
+    // the same arc); if there is none, overwrite one chosen by the hash.
+    size_t victim = static_cast<size_t>(hash) % kBucketSize;
+    for (size_t i = 0; i < kBucketSize; i++) {
+      if (slots[i].key == kEmptyKey || slots[i].key == key) {
+        victim = i;
+        break;
+      }
+    }
+    slots[victim].key = key;
+    slots[victim].arc = arc;
+  }
+  *oarc = arc;
+  return true;
+}
+
+template<class Arc>
+void ConcurrentCacheDeterministicOnDemandFst<Arc>::PrefetchArcs(
+    const std::vector<std::pair<StateId, Label> > &queries) {
+  std::lock_guard<std::mutex> lock(fst_mutex_);
+  fst_->PrefetchArcs(queries);
+}
+
 template<class Arc>
 LmExampleDeterministicOnDemandFst<Arc>::LmExampleDeterministicOnDemandFst(
     void *lm, Label bos_symbol, Label eos_symbol):
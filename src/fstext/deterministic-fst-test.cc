@@ -22,6 +22,8 @@
 #include "util/kaldi-io.h"
 
 #include <sys/stat.h> 
+#include <mutex>
+#include <thread>
 
 namespace fst {
 
@@ -177,6 +179,58 @@ void TestBackoffAndCache() {
   delete rfst;
 }
 
+// Checks that ConcurrentCacheDeterministicOnDemandFst, used by several threads
+// at once and with a cache too small for all the arcs, gives the same arcs as
+// the FST it wraps.
+void TestConcurrentCache() {
+  StdVectorFst *nfst = CreateBackoffFst();
+  ArcSort(nfst, StdILabelCompare());
+  BackoffDeterministicOnDemandFst<StdArc> dfst1a(*nfst), dfst1b(*nfst);
+  ConcurrentCacheDeterministicOnDemandFst<StdArc> dfst1(&dfst1a, 128);
+  KALDI_ASSERT(dfst1.Start() == dfst1b.Start());
+
+  // Work out the expected arcs (and non-arcs) with the uncached FST.
+  std::vector<std::pair<StateId, Label> > queries;
+  std::vector<bool> expected_found;
+  std::vector<StdArc> expected_arcs;
+  for (StateId s = 0; s < nfst->NumStates(); s++) {
+    KALDI_ASSERT(ApproxEqual(dfst1.Final(s), dfst1b.Final(s)));
+    for (Label ilabel = 9; ilabel <= 16; ilabel++) {
+      StdArc arc;
+      queries.push_back(std::pair<StateId, Label>(s, ilabel));
+      expected_found.push_back(dfst1b.GetArc(s, ilabel, &arc));
+      expected_arcs.push_back(arc);
+    }
+  }
+
+  int32 num_threads = 4, num_errors = 0;
+  std::mutex errors_mutex;
+  std::vector<std::thread> threads;
+  for (int32 t = 0; t < num_threads; t++) {
+    threads.push_back(std::thread([&, t]() {
+      for (int32 n = 0; n < 100; n++) {
+        for (size_t i = 0; i < queries.size(); i++) {
+          size_t q = (i * (t + 1) + n) % queries.size();
+          StdArc arc;
+          bool found = dfst1.GetArc(queries[q].first, queries[q].second, &arc);
+          if (found != expected_found[q] ||
+              (found && (arc.ilabel != expected_arcs[q].ilabel ||
+                         arc.olabel != expected_arcs[q].olabel ||
+                         arc.nextstate != expected_arcs[q].nextstate ||
+                         !ApproxEqual(arc.weight, expected_arcs[q].weight)))) {
+            std::lock_guard<std::mutex> lock(errors_mutex);
+            num_errors++;
+          }
+        }
+      }
+    }));
+  }
+  for (int32 t = 0; t < num_threads; t++)
+    threads[t].join();
+  KALDI_ASSERT(num_errors == 0);
+  delete nfst;
+}
+
 void TestCompose() {
   cout << "Test with single generated backoff FST" << endl;
   StdVectorFst *nfst = CreateBackoffFst();
@@ -224,6 +278,7 @@ void TestCompose() {
 int main() {
   using namespace fst;
   TestBackoffAndCache();
+  TestConcurrentCache();
   TestCompose();
 }
   
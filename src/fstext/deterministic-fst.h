@@ -49,6 +49,7 @@
 */
 
 #include <algorithm>
+#include <mutex>
 #include <string>
 #include <utility>
 #include <vector>
@@ -85,6 +86,13 @@ class DeterministicOnDemandFst {
   /// Note: ilabel must not be epsilon.
   virtual bool GetArc(StateId s, Label ilabel, Arc *oarc) = 0;
 
+  /// Tells the FST that GetArc() will soon be called for each of these (state,
+  /// ilabel) pairs, so that it can work out their arcs together (e.g. as one
+  /// matrix multiplication, for a neural-net language model).  It must not
+  /// change what GetArc() returns.  The default does nothing.
+  virtual void PrefetchArcs(
+      const std::vector<std::pair<StateId, Label> > &queries) { }
+
   virtual ~DeterministicOnDemandFst() { }
 };
 
@@ -155,6 +163,10 @@ class ScaleDeterministicOnDemandFst:  public DeterministicOnDemandFst<StdArc> {
     }
   }
 
+  void PrefetchArcs(const std::vector<std::pair<StateId, Label> > &queries) {
+    det_fst_.PrefetchArcs(queries);
+  }
+
  private:
   float scale_;
   DeterministicOnDemandFst<StdArc> &det_fst_;
@@ -215,6 +227,9 @@ class ComposeDeterministicOnDemandFst: public DeterministicOnDemandFst<Arc> {
 
   virtual bool GetArc(StateId s, Label ilabel, Arc *oarc);
 
+  virtual void PrefetchArcs(
+      const std::vector<std::pair<StateId, Label> > &queries);
+
  private:
   DeterministicOnDemandFst<Arc> *fst1_;
   DeterministicOnDemandFst<Arc> *fst2_;
@@ -244,6 +259,11 @@ class CacheDeterministicOnDemandFst: public DeterministicOnDemandFst<Arc> {
 
   virtual bool GetArc(StateId s, Label ilabel, Arc *oarc);
 
+  virtual void PrefetchArcs(
+      const std::vector<std::pair<StateId, Label> > &queries) {
+    fst_->PrefetchArcs(queries);
+  }
+
  private:
   // Get index for cached arc.
   inline size_t GetIndex(StateId src_state, Label ilabel);
@@ -253,6 +273,78 @@ class CacheDeterministicOnDemandFst: public DeterministicOnDemandFst<Arc> {
   std::vector<std::pair<StateId, Arc> > cached_arcs_;
 };
 
+/**
+   ConcurrentCacheDeterministicOnDemandFst is like CacheDeterministicOnDemandFst,
+   but it may be shared by several threads, and it is sized by a memory budget
+   rather than a number of arcs.  It is meant for the expensive "difference"
+   LMs of the biglm decoders (e.g. ComposeDeterministicOnDemandFst of a
+   BackoffDeterministicOnDemandFst and a ConstArpaLmDeterministicFst), in which
+   the same (lm-state, word) pairs are looked up over and over.
+
+   The cache is an open-addressing hash table keyed by (state, ilabel) packed
+   into 64 bits.  It is divided into buckets of a few slots; a key is only
+   looked for in its own bucket, and when the bucket is full a slot of it is
+   overwritten, so the table never grows.  Each bucket is protected by one of a
+   fixed set of mutexes, and all calls to the wrapped FST, which need not be
+   thread-safe, are serialized by another mutex.
+*/
+template<class Arc>
+class ConcurrentCacheDeterministicOnDemandFst final:
+      public DeterministicOnDemandFst<Arc> {
+ public:
+  typedef typename Arc::StateId StateId;
+  typedef typename Arc::Weight Weight;
+  typedef typename Arc::Label Label;
+
+  /// We don't take ownership of this pointer.  The argument is "really" const.
+  /// 'cache_bytes' is the approximate amount of memory the cache may use.
+  explicit ConcurrentCacheDeterministicOnDemandFst(
+      DeterministicOnDemandFst<Arc> *fst,
+      size_t cache_bytes = 64 << 20);
+
+  virtual StateId Start();
+
+  /// We don't bother caching the final-probs, just the arcs.
+  virtual Weight Final(StateId s);
+
+  virtual bool GetArc(StateId s, Label ilabel, Arc *oarc);
+
+  virtual void PrefetchArcs(
+      const std::vector<std::pair<StateId, Label> > &queries);
+
+  /// Returns the number of slots in the cache.
+  size_t NumSlots() const { return slots_.size(); }
+
+ private:
+  static const size_t kBucketSize = 4;  // slots per bucket
+  static const size_t kNumLocks = 64;   // must be a power of 2
+  static const kaldi::uint64 kEmptyKey = ~static_cast<kaldi::uint64>(0);
+
+  struct Slot {
+    kaldi::uint64 key;
+    Arc arc;
+    Slot(): key(kEmptyKey) { }
+  };
+
+  static inline kaldi::uint64 PackKey(StateId s, Label ilabel) {
+    return (static_cast<kaldi::uint64>(static_cast<kaldi::uint32>(s)) << 32) |
+        static_cast<kaldi::uint32>(ilabel);
+  }
+  // Returns a well-mixed hash of the key.
+  static inline kaldi::uint64 HashKey(kaldi::uint64 key) {
+    key *= 0x9E3779B97F4A7C15ULL;
+    return key ^ (key >> 29);
+  }
+
+  DeterministicOnDemandFst<Arc> *fst_;
+  std::mutex fst_mutex_;  // serializes all calls to fst_.
+  size_t bucket_mask_;    // the number of buckets, minus one.
+  std::vector<Slot> slots_;
+  std::mutex bucket_mutexes_[kNumLocks];
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(ConcurrentCacheDeterministicOnDemandFst);
+};
+
 
 /// This class is for didactic purposes, it does not really do anything.
 /// It shows how you would wrap a language model.  Note: you should probably
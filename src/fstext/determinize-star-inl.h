@@ -23,12 +23,22 @@
 // Do not include this file directly.  It is included by determinize-star.h
 
 #include "base/kaldi-error.h"
+#include "base/timer.h"
 
 #include <unordered_map>
 using std::unordered_map;
 
-#include <vector>
 #include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
 
 namespace fst {
 
@@ -91,6 +101,8 @@ template<class Label, class StringId> class StringRepository {
     else if (id>=single_symbol_start) {
       v->resize(1); (*v)[0] = id - single_symbol_start;
     } else {
+      std::unique_lock<std::mutex> lock(mutex_, std::defer_lock);
+      if (thread_safe_) lock.lock();
       assert(static_cast<size_t>(id) < vec_.size());
       *v = *(vec_[id]);
     }
@@ -108,7 +120,11 @@ template<class Label, class StringId> class StringRepository {
     }
   }
 
-  StringRepository() {
+  // If true, the repository may be used from several threads at once; this
+  // costs a lock per lookup of a sequence of more than one label.
+  void SetThreadSafe(bool thread_safe) { thread_safe_ = thread_safe; }
+
+  StringRepository(): thread_safe_(false) {
     // The following are really just constants but don't want to complicate compilation so make them
     // class variables.  Due to the brokenness of <limits>, they can't be accessed as constants.
     string_end = (numeric_limits<StringId>::max() / 2) - 1;  // all hash values must be <= this.
@@ -132,6 +148,8 @@ template<class Label, class StringId> class StringRepository {
   KALDI_DISALLOW_COPY_AND_ASSIGN(StringRepository);
 
   StringId IdOfSeqInternal(const vector<Label> &v) {
+    std::unique_lock<std::mutex> lock(mutex_, std::defer_lock);
+    if (thread_safe_) lock.lock();
     typename MapType::iterator iter = map_.find(&v);
     if (iter != map_.end()) {
       return iter->second;
@@ -147,6 +165,8 @@ template<class Label, class StringId> class StringRepository {
 
   vector<vector<Label>* > vec_;
   MapType map_;
+  bool thread_safe_;
+  std::mutex mutex_;  // guards vec_ and map_ if thread_safe_.
 
   static const StringId string_start = (StringId) 0;  // This must not change.  It's assumed.
   StringId string_end;  // = (numeric_limits<StringId>::max() / 2) - 1; // all hash values must be <= this.
@@ -175,14 +195,26 @@ template<class F> class DeterminizerStar {
   // Determinize() and then one of the Output functions.
   DeterminizerStar(const Fst<Arc> &ifst, float delta = kDelta,
                    int max_states = -1, bool allow_partial = false):
-      ifst_(ifst.Copy()), delta_(delta), max_states_(max_states),
-      determinized_(false), allow_partial_(allow_partial),
-      is_partial_(false), equal_(delta),
-      hash_(ifst.Properties(kExpanded, false) ?
-              down_cast<const ExpandedFst<Arc>*,
-              const Fst<Arc> >(&ifst)->NumStates()/2 + 3 : 20,
-            hasher_, equal_),
-      epsilon_closure_(ifst_, max_states, &repository_, delta) { }
+      DeterminizerStar(ifst, DeterminizeStarOptions(delta, max_states,
+                                                    allow_partial)) { }
+
+  DeterminizerStar(const Fst<Arc> &ifst, const DeterminizeStarOptions &opts):
+      ifst_(ifst.Copy()), delta_(opts.delta), max_states_(opts.max_states),
+      determinized_(false), allow_partial_(opts.allow_partial),
+      is_partial_(false), num_threads_(opts.num_threads),
+      batch_size_(opts.batch_size),
+      progress_interval_(opts.progress_interval), num_processed_(0),
+      num_arcs_(0),
+      epsilon_closure_(ifst_, opts.max_states, &repository_, opts.delta) {
+    KALDI_ASSERT(num_threads_ >= 1 && batch_size_ >= 1);
+    size_t expected_states = ifst.Properties(kExpanded, false) ?
+        down_cast<const ExpandedFst<Arc>*, const Fst<Arc> >(&ifst)->NumStates()
+        / 2 + 3 : 20, table_size = 64;
+    while (table_size < 2 * expected_states) table_size *= 2;
+    ResizeHashTable(table_size);
+    if (!opts.spill_dir.empty())
+      OpenSpillFile(opts.spill_dir);
+  }
 
   void Determinize(bool *debug_ptr) {
     assert(!determinized_);
@@ -200,23 +232,21 @@ template<class F> class DeterminizerStar {
       OutputStateId cur_id = SubsetToStateId(vec);
       assert(cur_id == 0 && "Do not call Determinize twice.");
     }
-    while (!Q_.empty()) {
-      pair<vector<Element>*, OutputStateId> cur_pair = Q_.front();
-      Q_.pop_front();
-      ProcessSubset(cur_pair);
-      if (debug_ptr && *debug_ptr) Debug();  // will exit.
-      if (max_states_ > 0 && output_arcs_.size() > max_states_) {
-        if (allow_partial_ == false) {
-          KALDI_ERR << "Determinization aborted since passed " << max_states_
-                    << " states";
-        } else {
-          KALDI_WARN << "Determinization terminated since passed " << max_states_
-                     << " states, partial results will be generated";
-          is_partial_ = true;
+    timer_.Reset();
+    if (num_threads_ > 1) {
+      DeterminizeMultiThreaded(debug_ptr);
+    } else {
+      while (!Q_.empty()) {
+        OutputStateId state = Q_.front();
+        Q_.pop_front();
+        ProcessSubset(state);
+        if (debug_ptr && *debug_ptr) Debug();  // will exit.
+        if (ReachedMaxStates())
           break;
-        }
       }
     }
+    if (progress_interval_ > 0)
+      ReportProgress();
     determinized_ = true;
   }
 
@@ -224,22 +254,31 @@ template<class F> class DeterminizerStar {
     return is_partial_;
   }
 
-  // frees all except output_arcs_, which contains the important info
-  // we need to output.
+  // frees all except output_arcs_ (and the spill file, if any), which contain
+  // the important info we need to output.
   void FreeMostMemory() {
     if (ifst_) {
       delete ifst_;
       ifst_ = NULL;
     }
-    for (typename SubsetHash::iterator iter = hash_.begin();
-        iter != hash_.end(); ++iter)
-      delete iter->first;
-    SubsetHash tmp;
-    tmp.swap(hash_);
+    FreeThreadFsts();
+    for (size_t i = 0; i < subset_blocks_.size(); i++)
+      delete subset_blocks_[i];
+    vector<vector<Element>*> tmp_blocks;
+    tmp_blocks.swap(subset_blocks_);
+    vector<SubsetInfo> tmp_subsets;
+    tmp_subsets.swap(subsets_);
+    vector<OutputStateId> tmp_table;
+    tmp_table.swap(hash_table_);
   }
 
   ~DeterminizerStar() {
     FreeMostMemory();
+    if (spill_stream_.is_open()) {
+      spill_stream_.close();
+      if (!spill_filename_.empty())
+        std::remove(spill_filename_.c_str());
+    }
   }
  private:
   typedef typename Arc::Label Label;
@@ -272,11 +311,14 @@ template<class F> class DeterminizerStar {
   };
 
 
-  // Hashing function used in hash of subsets.
-  // A subset is a pointer to vector<Element>.
+  // Subsets are stored compactly: the Elements of all of them are packed into
+  // large blocks (so there is no allocation per subset, and no pointers to
+  // them), and for each output state we keep where its subset is and a 64-bit
+  // fingerprint of its states and strings, which is all the hash table needs.
+  // A subset is never split between blocks, and blocks never reallocate.
   // The Elements are in sorted order on state id, and without repeated states.
-  // Because the order of Elements is fixed, we can use a hashing function that is
-  // order-dependent.  However the weights are not included in the hashing function--
+  // Because the order of Elements is fixed, we can use a fingerprint that is
+  // order-dependent.  However the weights are not included in the fingerprint--
   // we hash subsets that differ only in weight to the same key.  This is not optimal
   // in terms of the O(N) performance but typically if we have a lot of determinized
   // states that differ only in weight then the input probably was pathological in some way,
@@ -284,44 +326,94 @@ template<class F> class DeterminizerStar {
   //   We don't quantize the weights, in order to avoid inexactness in simple cases.
   // Instead we apply the delta when comparing subsets for equality, and allow a small
   // difference.
+  struct SubsetInfo {
+    uint64_t fingerprint;
+    int32 block;  // index into subset_blocks_.
+    int32 offset;  // index of the first Element in the block.
+    int32 size;  // number of Elements.
+  };
 
-  class SubsetKey {
-   public:
-    size_t operator ()(const vector<Element> * subset) const {  // hashes only the state and string.
-      size_t hash = 0, factor = 1;
-      for (typename vector<Element>::const_iterator iter = subset->begin();
-           iter != subset->end(); ++iter) {
-        hash *= factor;
-        hash += iter->state + 103333 * iter->string;
-        factor *= 23531;  // these numbers are primes.
-      }
-      return hash;
+  static const size_t kSubsetBlockSize = 1 << 16;  // in Elements.
+
+  static uint64_t SubsetFingerprint(const vector<Element> &subset) {
+    // FNV-1a over the state-ids and strings.
+    uint64_t ans = 14695981039346656037ULL;
+    for (typename vector<Element>::const_iterator iter = subset.begin();
+         iter != subset.end(); ++iter) {
+      ans = (ans ^ static_cast<uint64_t>(iter->state)) * 1099511628211ULL;
+      ans = (ans ^ static_cast<uint64_t>(iter->string)) * 1099511628211ULL;
     }
-  };
+    return ans;
+  }
 
-  // This is the equality operator on subsets.  It checks for exact match on state-id
-  // and string, and approximate match on weights.
-  class SubsetEqual {
-   public:
-    bool operator ()(const vector<Element> *s1,
-                     const vector<Element> *s2) const {
-      size_t sz = s1->size();
-      assert(sz >= 0);
-      if (sz != s2->size()) return false;
-      typename vector<Element>::const_iterator iter1 = s1->begin(),
-          iter1_end = s1->end(), iter2 = s2->begin();
-      for (; iter1 < iter1_end; ++iter1, ++iter2) {
-        if (iter1->state != iter2->state ||
-           iter1->string != iter2->string ||
-           ! ApproxEqual(iter1->weight, iter2->weight, delta_))
-          return false;
-      }
-      return true;
+  // The slot at which to start looking for a fingerprint in hash_table_.  The
+  // low bits of FNV are poorly mixed, so we mix them first.
+  size_t HashSlot(uint64_t fingerprint) const {
+    fingerprint ^= fingerprint >> 33;
+    fingerprint *= 0xff51afd7ed558ccdULL;
+    fingerprint ^= fingerprint >> 33;
+    return static_cast<size_t>(fingerprint) & (hash_table_.size() - 1);
+  }
+
+  const Element *SubsetBegin(OutputStateId state) const {
+    const SubsetInfo &info = subsets_[state];
+    return &((*subset_blocks_[info.block])[info.offset]);
+  }
+
+  // Copies the subset of output state 'state' (before epsilon closure) to
+  // 'subset'.
+  void GetSubset(OutputStateId state, vector<Element> *subset) const {
+    const Element *begin = SubsetBegin(state);
+    subset->assign(begin, begin + subsets_[state].size);
+  }
+
+  // This is the equality operator on subsets.  It checks for exact match on
+  // state-id and string, and approximate match on weights.
+  bool SubsetEqual(OutputStateId state, const vector<Element> &subset) const {
+    size_t sz = subset.size();
+    if (sz != static_cast<size_t>(subsets_[state].size)) return false;
+    const Element *stored = SubsetBegin(state);
+    for (size_t i = 0; i < sz; i++) {
+      if (stored[i].state != subset[i].state ||
+          stored[i].string != subset[i].string ||
+          ! ApproxEqual(stored[i].weight, subset[i].weight, delta_))
+        return false;
     }
-    float delta_;
-    SubsetEqual(float delta): delta_(delta) {}
-    SubsetEqual(): delta_(kDelta) {}
-  };
+    return true;
+  }
+
+  // Stores 'subset' as the subset of the next output state.
+  void AddSubset(const vector<Element> &subset, uint64_t fingerprint) {
+    size_t sz = subset.size();
+    if (subset_blocks_.empty() ||
+        subset_blocks_.back()->size() + sz > subset_blocks_.back()->capacity()) {
+      subset_blocks_.push_back(new vector<Element>());
+      // Small FSTs are common, so the first blocks are smaller.
+      size_t block_size = kSubsetBlockSize;
+      if (subset_blocks_.size() < 8)
+        block_size >>= 2 * (8 - subset_blocks_.size());
+      subset_blocks_.back()->reserve(std::max(sz, block_size));
+    }
+    vector<Element> *block = subset_blocks_.back();
+    SubsetInfo info;
+    info.fingerprint = fingerprint;
+    info.block = static_cast<int32>(subset_blocks_.size() - 1);
+    info.offset = static_cast<int32>(block->size());
+    info.size = static_cast<int32>(sz);
+    block->insert(block->end(), subset.begin(), subset.end());
+    subsets_.push_back(info);
+  }
+
+  // Rebuilds hash_table_ with 'size' slots (a power of two) from subsets_.
+  void ResizeHashTable(size_t size) {
+    hash_table_.assign(size, kNoStateId);
+    size_t mask = size - 1;
+    for (size_t s = 0; s < subsets_.size(); s++) {
+      size_t slot = HashSlot(subsets_[s].fingerprint);
+      while (hash_table_[slot] != kNoStateId) slot = (slot + 1) & mask;
+      hash_table_[slot] = static_cast<OutputStateId>(s);
+    }
+  }
 
   // Operator that says whether two Elements have the same states.
   // Used only for debug.
@@ -340,9 +432,6 @@ template<class F> class DeterminizerStar {
     }
   };
 
-  // Define the hash type we use to store subsets.
-  typedef unordered_map<const vector<Element>*, OutputStateId, SubsetKey, SubsetEqual> SubsetHash;
-
   class EpsilonClosure {
    public:
     EpsilonClosure(const Fst<Arc> *ifst, int max_states,
@@ -428,11 +517,13 @@ template<class F> class DeterminizerStar {
   };
 
 
-  // This function works out the final-weight of the determinized state.
-  // called by ProcessSubset.
-  // Has no side effects except on the variable repository_, and output_arcs_.
+  // This function works out the final-weight of the determinized state, and
+  // if it is final appends it to 'arcs'.
+  // called by ExpandSubset.
+  // Has no side effects except on 'arcs'.
 
-  void ProcessFinal(const vector<Element> &closed_subset, OutputStateId state) {
+  void ProcessFinal(const Fst<Arc> &ifst, const vector<Element> &closed_subset,
+                    vector<TempArc> *arcs) {
     // processes final-weights for this subset.
     bool is_final = false;
     StringId final_string = 0;  // = 0 to keep compiler happy.
@@ -444,7 +535,7 @@ template<class F> class DeterminizerStar {
         end = closed_subset.end();
     for (; iter != end; ++iter) {
       const Element &elem = *iter;
-      Weight this_final_weight = ifst_->Final(elem.state);
+      Weight this_final_weight = ifst.Final(elem.state);
       if (this_final_weight != Weight::Zero()) {
         if (!is_final) {  // first final-weight
           final_string = elem.string;
@@ -465,14 +556,16 @@ template<class F> class DeterminizerStar {
       temp_arc.nextstate = kNoStateId;  // special marker meaning "final weight".
       temp_arc.ostring = final_string;
       temp_arc.weight = final_weight;
-      output_arcs_[state].push_back(temp_arc);
+      arcs->push_back(temp_arc);
     }
   }
 
   // ProcessTransition is called from "ProcessTransitions".  Broken out for
-  // clarity.  Has side effects on output_arcs_, and (via SubsetToStateId), Q_
-  // and hash_.
-  void ProcessTransition(OutputStateId state, Label ilabel, vector<Element> *subset);
+  // clarity.  It normalizes 'subset' and appends the arc to it to 'arcs';
+  // see ExpandSubset() for what the arc's nextstate means.  Has side effects
+  // only on 'arcs' and the repository.
+  void ProcessTransition(Label ilabel, vector<Element> *subset,
+                         OutputStateId subset_index, vector<TempArc> *arcs);
 
   // "less than" operator for pair<Label, Element>.   Used in ProcessTransitions.
   // Lexicographical order, with comparing the state only for "Element".
@@ -496,9 +589,11 @@ template<class F> class DeterminizerStar {
   // Does this by creating a big vector of pairs <Label, Element> and then sorting them
   // using a lexicographical ordering, and calling ProcessTransition for each range
   // with the same ilabel.
-  // Side effects on repository, and (via ProcessTransition) on Q_, hash_,
-  // and output_arcs_.
-  void ProcessTransitions(const vector<Element> &closed_subset, OutputStateId state) {
+  // Side effects on repository, 'arcs' and 'dest_subsets'.
+  void ProcessTransitions(const Fst<Arc> &ifst,
+                          const vector<Element> &closed_subset,
+                          vector<TempArc> *arcs,
+                          vector<vector<Element> > *dest_subsets) {
     vector<pair<Label, Element> > all_elems;
     {  // Push back into "all_elems", elements corresponding to all non-epsilon-input transitions
       // out of all states in "closed_subset".
@@ -506,7 +601,7 @@ template<class F> class DeterminizerStar {
           end = closed_subset.end();
       for (; iter != end; ++iter) {
         const Element &elem = *iter;
-        for (ArcIterator<Fst<Arc> > aiter(*ifst_, elem.state);
+        for (ArcIterator<Fst<Arc> > aiter(ifst, elem.state);
              !aiter.Done(); aiter.Next()) {
           const Arc &arc = aiter.Value();
           if (arc.ilabel != 0) {  // Non-epsilon transition -- ignore epsilons here.
@@ -534,50 +629,95 @@ template<class F> class DeterminizerStar {
     // now sorted first on input label, then on state.
     typedef typename vector<pair<Label, Element> >::const_iterator PairIter;
     PairIter cur = all_elems.begin(), end = all_elems.end();
-    vector<Element> this_subset;
     while (cur != end) {
       // Process ranges that share the same input symbol.
       Label ilabel = cur->first;
-      this_subset.clear();
+      dest_subsets->resize(dest_subsets->size() + 1);
+      vector<Element> &this_subset = dest_subsets->back();
       while (cur != end && cur->first == ilabel) {
         this_subset.push_back(cur->second);
         cur++;
       }
       // We now have a subset for this ilabel.
-      ProcessTransition(state, ilabel, &this_subset);
+      ProcessTransition(ilabel, &this_subset,
+                        static_cast<OutputStateId>(dest_subsets->size() - 1),
+                        arcs);
     }
   }
 
+  // ExpandSubset works out the arcs leaving a determinized state, given its
+  // subset (before epsilon closure): it does the epsilon closure, appends the
+  // final-weight (if any) to 'arcs' as an arc with nextstate == kNoStateId,
+  // and appends an arc for each input label, with the normalized subset it
+  // leads to appended to 'dest_subsets' and its index there as its nextstate;
+  // the caller then maps these to states with SubsetToStateId().  It does not
+  // touch the hash or the queue, so several threads can call it at once, each
+  // with its own copy of the FST and its own EpsilonClosure object.
+  void ExpandSubset(const Fst<Arc> &ifst, EpsilonClosure *epsilon_closure,
+                    const vector<Element> &subset, vector<TempArc> *arcs,
+                    vector<vector<Element> > *dest_subsets) {
+    vector<Element> closed_subset;  // subset after epsilon closure.
+    epsilon_closure->GetEpsilonClosure(subset, &closed_subset);
+
+    // Now follow non-epsilon arcs [and also process final states]
+    ProcessFinal(ifst, closed_subset, arcs);
+
+    // Now handle transitions out of these states.
+    ProcessTransitions(ifst, closed_subset, arcs, dest_subsets);
+  }
+
   // SubsetToStateId converts a subset (vector of Elements) to a StateId in the output
   // fst.  This is a hash lookup; if no such state exists, it adds a new state to the hash
-  // and adds a new pair to the queue.
-  // Side effects on hash_ and Q_, and on output_arcs_ [just affects the size].
+  // and adds it to the queue.
+  // Side effects on the hash and Q_, and on output_arcs_ [just affects the size].
   OutputStateId SubsetToStateId(const vector<Element> &subset) {  // may add the subset to the queue.
-    typedef typename SubsetHash::iterator IterType;
-    IterType iter = hash_.find(&subset);
-    if (iter == hash_.end()) {  // was not there.
-      vector<Element> *new_subset = new vector<Element>(subset);
-      OutputStateId new_state_id = (OutputStateId) output_arcs_.size();
-      bool ans = hash_.insert(std::pair<const vector<Element>*,
-                                        OutputStateId>(new_subset,
-                                                       new_state_id)).second;
-      assert(ans);
-      output_arcs_.push_back(vector<TempArc>());
-      if (allow_partial_ == false) {
-        // If --allow-partial is not requested, we do the old way.
-        Q_.push_front(pair<vector<Element>*, OutputStateId>(new_subset,  new_state_id));
-      } else {
-        // If --allow-partial is requested, we do breadth first search. This
-        // ensures that when we return partial results, we return the states
-        // that are reachable by the fewest steps from the start state.
-        Q_.push_back(pair<vector<Element>*, OutputStateId>(new_subset,  new_state_id));
-      }
-      return new_state_id;
+    uint64_t fingerprint = SubsetFingerprint(subset);
+    size_t mask = hash_table_.size() - 1,
+        slot = HashSlot(fingerprint);
+    for (; hash_table_[slot] != kNoStateId; slot = (slot + 1) & mask) {
+      OutputStateId state = hash_table_[slot];
+      if (subsets_[state].fingerprint == fingerprint &&
+          SubsetEqual(state, subset))
+        return state;  // the OutputStateId.
+    }
+    // was not there.
+    OutputStateId new_state_id = (OutputStateId) output_arcs_.size();
+    hash_table_[slot] = new_state_id;
+    AddSubset(subset, fingerprint);
+    output_arcs_.push_back(vector<TempArc>());
+    if (allow_partial_ == false) {
+      // If --allow-partial is not requested, we do the old way.
+      Q_.push_front(new_state_id);
     } else {
-      return iter->second;  // the OutputStateId.
+      // If --allow-partial is requested, we do breadth first search. This
+      // ensures that when we return partial results, we return the states
+      // that are reachable by the fewest steps from the start state.
+      Q_.push_back(new_state_id);
     }
+    // Keep the load factor at most 1/2, so probe sequences stay short.
+    if (2 * output_arcs_.size() > hash_table_.size())
+      ResizeHashTable(2 * hash_table_.size());
+    return new_state_id;
   }
 
+  // FinishState is called once the arcs out of 'state' have been worked out
+  // by ExpandSubset(): it maps their destination subsets to states (which may
+  // add states to the queue), stores the arcs (in the spill file, if we
+  // have one), and reports progress.
+  void FinishState(OutputStateId state, vector<TempArc> *arcs,
+                   const vector<vector<Element> > &dest_subsets) {
+    for (typename vector<TempArc>::iterator iter = arcs->begin();
+         iter != arcs->end(); ++iter)
+      if (iter->nextstate != kNoStateId)
+        iter->nextstate = SubsetToStateId(dest_subsets[iter->nextstate]);
+    num_arcs_ += arcs->size();
+    output_arcs_[state].swap(*arcs);
+    if (spill_stream_.is_open())
+      SpillArcs(state);
+    num_processed_++;
+    if (progress_interval_ > 0 && num_processed_ % progress_interval_ == 0)
+      ReportProgress();
+  }
 
   // ProcessSubset does the processing of a determinized state, i.e. it creates
   // transitions out of it and adds new determinized states to the queue if necessary.
@@ -585,24 +725,191 @@ template<class F> class DeterminizerStar {
   // of (states, weights)).  After that we ignore epsilons.  We process the final-weight
   // of the state, and then handle transitions out (this may add more determinized states
   // to the queue).
-  void ProcessSubset(const pair<vector<Element>*, OutputStateId> & pair) {
-    const vector<Element> *subset = pair.first;
-    OutputStateId state = pair.second;
+  void ProcessSubset(OutputStateId state) {
+    vector<Element> subset;
+    GetSubset(state, &subset);
+    vector<TempArc> arcs;
+    dest_subsets_.clear();
+    ExpandSubset(*ifst_, &epsilon_closure_, subset, &arcs, &dest_subsets_);
+    FinishState(state, &arcs, dest_subsets_);
+  }
 
-    vector<Element> closed_subset;  // subset after epsilon closure.
-    epsilon_closure_.GetEpsilonClosure(*subset, &closed_subset);
+  // The main loop of Determinize() for num_threads_ > 1.  We take batches of
+  // states from the queue and expand them in parallel, then finish them in
+  // order in this thread, so the result depends only on batch_size_.
+  void DeterminizeMultiThreaded(bool *debug_ptr) {
+    for (int t = 0; t < num_threads_; t++) {
+      // A copy per thread, as copies are safe to use from different threads.
+      thread_fsts_.push_back(ifst_->Copy(true));
+      thread_closures_.push_back(new EpsilonClosure(thread_fsts_.back(),
+                                                    max_states_, &repository_,
+                                                    delta_));
+    }
+    repository_.SetThreadSafe(true);
+    vector<OutputStateId> batch;
+    vector<vector<TempArc> > batch_arcs;
+    vector<vector<vector<Element> > > batch_dest_subsets;
+    vector<std::exception_ptr> errors(num_threads_);
+    bool stop = false;
+    while (!Q_.empty() && !stop) {
+      batch.clear();
+      while (!Q_.empty() && batch.size() < static_cast<size_t>(batch_size_)) {
+        batch.push_back(Q_.front());
+        Q_.pop_front();
+      }
+      size_t n = batch.size();
+      batch_arcs.resize(n);
+      batch_dest_subsets.resize(n);
+      auto expand = [&](int t) {
+        try {
+          vector<Element> subset;
+          for (size_t i = t; i < n; i += num_threads_) {
+            GetSubset(batch[i], &subset);
+            batch_arcs[i].clear();
+            batch_dest_subsets[i].clear();
+            ExpandSubset(*thread_fsts_[t], thread_closures_[t], subset,
+                         &batch_arcs[i], &batch_dest_subsets[i]);
+          }
+        } catch (...) {
+          errors[t] = std::current_exception();
+        }
+      };
+      vector<std::thread> threads;
+      for (int t = 1; t < num_threads_; t++)
+        threads.push_back(std::thread(expand, t));
+      expand(0);
+      for (size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+      for (int t = 0; t < num_threads_; t++)
+        if (errors[t]) std::rethrow_exception(errors[t]);
+      for (size_t i = 0; i < n && !stop; i++) {
+        FinishState(batch[i], &batch_arcs[i], batch_dest_subsets[i]);
+        stop = ReachedMaxStates();
+      }
+      if (debug_ptr && *debug_ptr) Debug();  // will exit.
+    }
+    repository_.SetThreadSafe(false);
+    FreeThreadFsts();
+  }
 
-    // Now follow non-epsilon arcs [and also process final states]
-    ProcessFinal(closed_subset, state);
+  // Returns true if we should stop because max_states_ was exceeded and
+  // allow_partial_ is true; throws if it was exceeded and allow_partial_ is
+  // false.
+  bool ReachedMaxStates() {
+    if (max_states_ > 0 && output_arcs_.size() > max_states_) {
+      if (allow_partial_ == false) {
+        KALDI_ERR << "Determinization aborted since passed " << max_states_
+                  << " states";
+      } else {
+        KALDI_WARN << "Determinization terminated since passed " << max_states_
+                   << " states, partial results will be generated";
+        is_partial_ = true;
+        return true;
+      }
+    }
+    return false;
+  }
 
-    // Now handle transitions out of these states.
-    ProcessTransitions(closed_subset, state);
+  void FreeThreadFsts() {
+    for (size_t t = 0; t < thread_closures_.size(); t++)
+      delete thread_closures_[t];
+    thread_closures_.clear();
+    for (size_t t = 0; t < thread_fsts_.size(); t++)
+      delete thread_fsts_[t];
+    thread_fsts_.clear();
+  }
+
+  void ReportProgress() {
+    size_t subset_bytes = subsets_.capacity() * sizeof(SubsetInfo) +
+        hash_table_.capacity() * sizeof(OutputStateId);
+    for (size_t i = 0; i < subset_blocks_.size(); i++)
+      subset_bytes += subset_blocks_[i]->capacity() * sizeof(Element);
+    size_t arc_bytes = output_arcs_.capacity() * sizeof(vector<TempArc>);
+    if (!spill_stream_.is_open())
+      arc_bytes += num_arcs_ * sizeof(TempArc);
+    KALDI_LOG << "Determinized " << num_processed_ << " states with "
+              << num_arcs_ << " arcs in " << timer_.Elapsed() << " seconds; "
+              << Q_.size() << " states queued; memory used by subsets is "
+              << (subset_bytes >> 20) << " MB, by arcs "
+              << (arc_bytes >> 20) << " MB"
+              << (spill_stream_.is_open() ? " (the rest are on disk)" : "");
+  }
+
+  void OpenSpillFile(const std::string &spill_dir) {
+    std::random_device random;
+    std::ostringstream filename;
+    filename << spill_dir << "/determinize-star-" << std::hex << random()
+             << random() << ".tmp";
+    spill_filename_ = filename.str();
+    spill_stream_.open(spill_filename_.c_str(), std::ios::in | std::ios::out |
+                       std::ios::binary | std::ios::trunc);
+    if (!spill_stream_.is_open())
+      KALDI_ERR << "Could not open " << spill_filename_ << " to spill "
+                << "determinized states to (does the directory exist?)";
+    // On POSIX systems the file goes away when we close it; elsewhere the
+    // destructor removes it.
+    if (std::remove(spill_filename_.c_str()) == 0)
+      spill_filename_.clear();
+  }
+
+  // Moves the arcs of 'state' from output_arcs_ to the spill file.
+  void SpillArcs(OutputStateId state) {
+    if (spill_offsets_.size() < output_arcs_.size())
+      spill_offsets_.resize(output_arcs_.size(), -1);
+    spill_offsets_[state] = spill_stream_.tellp();
+    vector<TempArc> &arcs = output_arcs_[state];
+    int32 num_arcs = arcs.size();
+    spill_stream_.write(reinterpret_cast<const char*>(&num_arcs),
+                        sizeof(num_arcs));
+    for (size_t i = 0; i < arcs.size(); i++) {
+      const TempArc &arc = arcs[i];
+      spill_stream_.write(reinterpret_cast<const char*>(&arc.ilabel),
+                          sizeof(arc.ilabel));
+      spill_stream_.write(reinterpret_cast<const char*>(&arc.ostring),
+                          sizeof(arc.ostring));
+      spill_stream_.write(reinterpret_cast<const char*>(&arc.nextstate),
+                          sizeof(arc.nextstate));
+      arc.weight.Write(spill_stream_);
+    }
+    if (!spill_stream_)
+      KALDI_ERR << "Error writing determinized states to disk (disk full?)";
+    vector<TempArc> tmp;
+    tmp.swap(arcs);
+  }
+
+  // Returns the arcs of 'state', reading them into 'buffer' if they were
+  // spilled to disk.
+  const vector<TempArc> &GetOutputArcs(OutputStateId state,
+                                       vector<TempArc> *buffer) {
+    if (!spill_stream_.is_open())
+      return output_arcs_[state];
+    buffer->clear();
+    if (static_cast<size_t>(state) >= spill_offsets_.size() ||
+        spill_offsets_[state] < 0)
+      return *buffer;  // Not processed, as we stopped early.
+    spill_stream_.seekg(spill_offsets_[state]);
+    int32 num_arcs = 0;
+    spill_stream_.read(reinterpret_cast<char*>(&num_arcs), sizeof(num_arcs));
+    buffer->resize(num_arcs);
+    for (int32 i = 0; i < num_arcs; i++) {
+      TempArc &arc = (*buffer)[i];
+      spill_stream_.read(reinterpret_cast<char*>(&arc.ilabel),
+                         sizeof(arc.ilabel));
+      spill_stream_.read(reinterpret_cast<char*>(&arc.ostring),
+                         sizeof(arc.ostring));
+      spill_stream_.read(reinterpret_cast<char*>(&arc.nextstate),
+                         sizeof(arc.nextstate));
+      arc.weight.Read(spill_stream_);
+    }
+    if (!spill_stream_)
+      KALDI_ERR << "Error reading determinized states back from disk";
+    return *buffer;
   }
 
   void Debug();
 
   KALDI_DISALLOW_COPY_AND_ASSIGN(DeterminizerStar);
-  deque<pair<vector<Element>*, OutputStateId> > Q_;  // queue of subsets to be processed.
+  deque<OutputStateId> Q_;  // queue of states whose subsets are to be processed.
 
   vector<vector<TempArc> > output_arcs_;  // essentially an FST in our format.
 
@@ -612,9 +919,35 @@ template<class F> class DeterminizerStar {
   bool determinized_; // used to check usage.
   bool allow_partial_;  // output paritial results or not
   bool is_partial_;     // if we get partial results or not
-  SubsetKey hasher_;  // object that computes keys-- has no data members.
-  SubsetEqual equal_;  // object that compares subsets-- only data member is delta_.
-  SubsetHash hash_;  // hash from Subset to StateId in final Fst.
+  int num_threads_;
+  int batch_size_;
+  int progress_interval_;
+  size_t num_processed_;  // number of states whose arcs we have worked out.
+  size_t num_arcs_;  // total number of arcs of those states.
+  kaldi::Timer timer_;
+
+  // The subsets (before epsilon closure) of the output states; see
+  // SubsetInfo.
+  vector<vector<Element>*> subset_blocks_;
+  vector<SubsetInfo> subsets_;  // indexed by OutputStateId.
+  // Hash from subset to OutputStateId in final Fst: an open-addressing table
+  // of states keyed on the fingerprints of their subsets, whose size is a
+  // power of two; kNoStateId marks an empty slot.
+  vector<OutputStateId> hash_table_;
+
+  // Temporary in ProcessSubset(), kept here to avoid reallocation.
+  vector<vector<Element> > dest_subsets_;
+
+  // Used for num_threads_ > 1: a copy of the input FST and an EpsilonClosure
+  // object for each thread.
+  vector<const Fst<Arc>*> thread_fsts_;
+  vector<EpsilonClosure*> thread_closures_;
+
+  // If spilling to disk: the file, its name if it still has to be removed,
+  // and the offset in it of the arcs of each processed state (else -1).
+  std::fstream spill_stream_;
+  std::string spill_filename_;
+  vector<std::streamoff> spill_offsets_;
 
   StringRepository<Label, StringId> repository_;  // associate integer id's with sequences of labels.
   EpsilonClosure epsilon_closure_;
@@ -625,9 +958,29 @@ template<class F>
 bool DeterminizeStar(F &ifst, MutableFst<typename F::Arc> *ofst,
                      float delta, bool *debug_ptr, int max_states,
                      bool allow_partial) {
+  return DeterminizeStar(ifst, ofst, DeterminizeStarOptions(delta, max_states,
+                                                            allow_partial),
+                         debug_ptr);
+}
+
+
+template<class F>
+bool DeterminizeStar(F &ifst,
+                     MutableFst<GallicArc<typename F::Arc> > *ofst, float delta,
+                     bool *debug_ptr, int max_states,
+                     bool allow_partial) {
+  return DeterminizeStar(ifst, ofst, DeterminizeStarOptions(delta, max_states,
+                                                            allow_partial),
+                         debug_ptr);
+}
+
+
+template<class F>
+bool DeterminizeStar(F &ifst, MutableFst<typename F::Arc> *ofst,
+                     const DeterminizeStarOptions &opts, bool *debug_ptr) {
   ofst->SetOutputSymbols(ifst.OutputSymbols());
   ofst->SetInputSymbols(ifst.InputSymbols());
-  DeterminizerStar<F> det(ifst, delta, max_states, allow_partial);
+  DeterminizerStar<F> det(ifst, opts);
   det.Determinize(debug_ptr);
   det.Output(ofst);
   return det.IsPartial();
@@ -635,13 +988,11 @@ bool DeterminizeStar(F &ifst, MutableFst<typename F::Arc> *ofst,
 
 
 template<class F>
-bool DeterminizeStar(F &ifst,
-                     MutableFst<GallicArc<typename F::Arc> > *ofst, float delta,
-                     bool *debug_ptr, int max_states,
-                     bool allow_partial) {
+bool DeterminizeStar(F &ifst, MutableFst<GallicArc<typename F::Arc> > *ofst,
+                     const DeterminizeStarOptions &opts, bool *debug_ptr) {
   ofst->SetOutputSymbols(ifst.InputSymbols());
   ofst->SetInputSymbols(ifst.InputSymbols());
-  DeterminizerStar<F> det(ifst, delta, max_states, allow_partial);
+  DeterminizerStar<F> det(ifst, opts);
   det.Determinize(debug_ptr);
   det.Output(ofst);
   return det.IsPartial();
@@ -879,8 +1230,9 @@ void DeterminizerStar<F>::Output(MutableFst<GallicArc<Arc> > *ofst,
   }
   ofst->SetStart(0);
   // now process transitions.
+  vector<TempArc> buffer;
   for (StateId this_state = 0; this_state < nStates; this_state++) {
-    vector<TempArc> &this_vec(output_arcs_[this_state]);
+    const vector<TempArc> &this_vec(GetOutputArcs(this_state, &buffer));
     typename vector<TempArc>::const_iterator iter = this_vec.begin(),
         end = this_vec.end();
     for (; iter != end; ++iter) {
@@ -903,7 +1255,7 @@ void DeterminizerStar<F>::Output(MutableFst<GallicArc<Arc> > *ofst,
       }
     }
     // Free up memory.  Do this inside the loop as ofst is also allocating memory
-    if (destroy) { vector<TempArc> temp; temp.swap(this_vec); }
+    if (destroy) { vector<TempArc> temp; temp.swap(output_arcs_[this_state]); }
   }
   if (destroy) { vector<vector<TempArc> > temp; temp.swap(output_arcs_); }
 }
@@ -927,8 +1279,9 @@ void DeterminizerStar<F>::Output(MutableFst<Arc> *ofst, bool destroy) {
     assert(news == s);
   }
   ofst->SetStart(0);
+  vector<TempArc> buffer;
   for (OutputStateId this_state = 0; this_state < num_states; this_state++) {
-    vector<TempArc> &this_vec(output_arcs_[this_state]);
+    const vector<TempArc> &this_vec(GetOutputArcs(this_state, &buffer));
 
     typename vector<TempArc>::const_iterator iter = this_vec.begin(),
         end = this_vec.end();
@@ -976,7 +1329,7 @@ void DeterminizerStar<F>::Output(MutableFst<Arc> *ofst, bool destroy) {
       }
     }
     // Free up memory.  Do this inside the loop as ofst is also allocating memory
-    if (destroy) { vector<TempArc> temp; temp.swap(this_vec); }
+    if (destroy) { vector<TempArc> temp; temp.swap(output_arcs_[this_state]); }
   }
   if (destroy) {
     vector<vector<TempArc> > temp;
@@ -986,11 +1339,12 @@ void DeterminizerStar<F>::Output(MutableFst<Arc> *ofst, bool destroy) {
 }
 
 template<class F> void DeterminizerStar<F>::
-ProcessTransition(OutputStateId state, Label ilabel, vector<Element> *subset) {
+ProcessTransition(Label ilabel, vector<Element> *subset,
+                  OutputStateId subset_index, vector<TempArc> *arcs) {
   // At input, "subset" may contain duplicates for a given dest state (but in sorted
   // order).  This function removes duplicates from "subset", normalizes it, and adds
-  // a transition to the dest. state (possibly affecting Q_ and hash_, if state did not
-  // exist).
+  // a transition to it, whose nextstate is for now 'subset_index' (see
+  // ExpandSubset()).
 
   typedef typename vector<Element>::iterator IterType;
   {  // This block makes the subset have one unique Element per state, adding the weights.
@@ -1054,14 +1408,14 @@ ProcessTransition(OutputStateId state, Label ilabel, vector<Element> *subset) {
     }
   }
 
-  // Now add an arc to the state that the subset represents.
-  // We may create a new state id for this (in SubsetToStateId).
+  // Now add an arc to the state that the subset represents; the caller will
+  // look the state up (and may create it) in SubsetToStateId.
   TempArc temp_arc;
   temp_arc.ilabel = ilabel;
-  temp_arc.nextstate = SubsetToStateId(*subset);  // may or may not really add the subset.
+  temp_arc.nextstate = subset_index;
   temp_arc.ostring = common_str;
   temp_arc.weight = tot_weight;
-  output_arcs_[state].push_back(temp_arc);  // record the arc.
+  arcs->push_back(temp_arc);  // record the arc.
 }
 
 template<class F>
@@ -1072,8 +1426,10 @@ void DeterminizerStar<F>::Debug() {
   // info and exits.
 
   KALDI_WARN << "Debug function called (probably SIGUSR1 caught)";
+  if (spill_stream_.is_open())
+    KALDI_ERR << "No traceback is available when spilling states to disk";
   // free up memory from the hash as we need a little memory
-  { SubsetHash hash_tmp; std::swap(hash_tmp, hash_); }
+  { vector<OutputStateId> table_tmp; std::swap(table_tmp, hash_table_); }
 
   if (output_arcs_.size() <= 2) {
     KALDI_ERR << "Nothing to trace back";
@@ -57,6 +57,36 @@ template<class Arc> void TestDeterminizeGeneral() {
 }
 
 
+// test that the multi-threaded and spilling versions give the same result as
+// the normal one.
+template<class Arc> void TestDeterminizeStarOptions() {
+  for(int i = 0; i < 20; i++) {
+    RandFstOptions rand_opts;
+    rand_opts.acyclic = true;
+    VectorFst<Arc> *fst = RandFst<Arc>(rand_opts);
+    VectorFst<Arc> ofst;
+    try {
+      DeterminizeStar<Fst<Arc> >(*fst, &ofst);
+    } catch (...) {
+      std::cout << "Failed to determinize *this FST (probably not determinizable)\n";
+      delete fst;
+      continue;
+    }
+    DeterminizeStarOptions opts;
+    opts.num_threads = 1 + kaldi::Rand() % 4;
+    opts.batch_size = 1 + kaldi::Rand() % 10;
+    if (kaldi::Rand() % 2 == 0)
+      opts.spill_dir = ".";
+    VectorFst<Arc> ofst2;
+    DeterminizeStar<Fst<Arc> >(*fst, &ofst2, opts);
+    assert(RandEquivalent(ofst, ofst2, 5/*paths*/, 0.01/*delta*/, kaldi::Rand()/*seed*/, 100/*path length, max*/));
+    if (opts.num_threads == 1 || opts.batch_size == 1)  // same state numbering.
+      assert(ofst.NumStates() == ofst2.NumStates());
+    delete fst;
+  }
+}
+
+
 // Don't instantiate with log semiring, as RandEquivalent may fail.
 template<class Arc>  void TestDeterminize() {
   typedef typename Arc::Label Label;
@@ -500,6 +530,7 @@ int main() {
     fst::TestStringRepository<fst::StdArc, unsigned char>();
     fst::TestStringRepository<fst::StdArc, char>();
     fst::TestDeterminizeGeneral<fst::StdArc>();
+    fst::TestDeterminizeStarOptions<fst::StdArc>();
     fst::TestDeterminize<fst::StdArc>();
     // fst::TestDeterminize2<fst::StdArc>();
     fst::TestPush<fst::StdArc>();
@@ -26,6 +26,7 @@
 #include <algorithm>
 #include <map>
 #include <set>
+#include <string>
 #include <vector>
 #include <stdexcept> // this algorithm uses exceptions
 
@@ -68,6 +69,30 @@ namespace fst {
 
 // This algorithm will be slightly faster if you sort the input fst on input label.
 
+/// Options for DeterminizeStar.  The first three are as for the versions that
+/// take them as arguments; the others are for determinizing very large FSTs
+/// such as LG and CLG graphs.
+struct DeterminizeStarOptions {
+  float delta;  // A small offset used to measure equality of weights.
+  int max_states;  // If >0, stop (see below) once this many states are found.
+  bool allow_partial;  // If true, output a partial result at max_states
+                       // rather than throwing an error.
+  int num_threads;  // If >1, expand the determinized states in parallel, in
+                    // batches of batch_size states taken from the queue.
+                    // The result does not depend on num_threads, but its
+                    // state numbering differs from num_threads == 1.
+  int batch_size;
+  std::string spill_dir;  // If nonempty, a directory in which the arcs of
+                          // finished states are kept in a temporary file
+                          // until output, rather than in memory.
+  int progress_interval;  // If >0, log progress (states, queue size and
+                          // memory) every this many states.
+  explicit DeterminizeStarOptions(float delta = kDelta, int max_states = -1,
+                                  bool allow_partial = false):
+      delta(delta), max_states(max_states), allow_partial(allow_partial),
+      num_threads(1), batch_size(4096), progress_interval(0) { }
+};
+
 /**
     This function implements the normal version of DeterminizeStar, in which the
     output strings are represented using sequences of arcs, where all but the
@@ -114,6 +139,20 @@ bool DeterminizeStar(F &ifst, MutableFst<GallicArc<typename F::Arc> > *ofst,
                      bool allow_partial = false);
 
 
+/// Versions of the above that take a DeterminizeStarOptions, for the options
+/// that help with very large inputs (threads, spilling to disk and progress
+/// reports).
+template<class F>
+bool DeterminizeStar(F &ifst, MutableFst<typename F::Arc> *ofst,
+                     const DeterminizeStarOptions &opts,
+                     bool *debug_ptr = NULL);
+
+template<class F>
+bool DeterminizeStar(F &ifst, MutableFst<GallicArc<typename F::Arc> > *ofst,
+                     const DeterminizeStarOptions &opts,
+                     bool *debug_ptr = NULL);
+
+
 /// @} end "addtogroup fst_extensions"
 
 } // end namespace fst
@@ -32,6 +32,7 @@
 #include <sstream>
 #include <algorithm>
 #include <string>
+#include <unordered_map>
 
 namespace fst {
 
@@ -535,74 +536,85 @@ void MakePrecedingInputSymbolsSameClass(bool start_is_epsilon, MutableFst<Arc> *
   typedef typename F::Result ClassType;
   typedef typename Arc::StateId StateId;
   typedef typename Arc::Weight Weight;
-  vector<ClassType> classes;
   ClassType noClass = f(kNoLabel);
   ClassType epsClass = f(0);
+  StateId num_states = fst->NumStates();
+  vector<ClassType> classes(num_states, noClass);
   if (start_is_epsilon) {  // treat having-start-state as epsilon in-transition.
     StateId start_state = fst->Start();
     if (start_state < 0 || start_state == kNoStateId) // empty FST.
       return;
-    classes.resize(start_state+1, noClass);
     classes[start_state] = epsClass;
   }
 
   // Find bad states (states with multiple input-symbols into them).
-  std::set<StateId> bad_states;  // states that we need to change.
-  for (StateIterator<Fst<Arc> > siter(*fst); !siter.Done(); siter.Next()) {
-    StateId s = siter.Value();
-    for (ArcIterator<Fst<Arc> > aiter(*fst, s); !aiter.Done(); aiter.Next()) {
+  vector<bool> is_bad(num_states, false);  // states that we need to change.
+  bool have_bad_state = false;
+  for (StateId s = 0; s < num_states; s++) {
+    for (ArcIterator<MutableFst<Arc> > aiter(*fst, s); !aiter.Done();
+         aiter.Next()) {
       const Arc &arc = aiter.Value();
-      if (classes.size() <= static_cast<size_t>(arc.nextstate))
-        classes.resize(arc.nextstate+1, noClass);
+      ClassType c = f(arc.ilabel);
       if (classes[arc.nextstate] == noClass)
-        classes[arc.nextstate] = f(arc.ilabel);
-      else
-        if (classes[arc.nextstate] != f(arc.ilabel))
-          bad_states.insert(arc.nextstate);
+        classes[arc.nextstate] = c;
+      else if (classes[arc.nextstate] != c)
+        have_bad_state = is_bad[arc.nextstate] = true;
     }
   }
-  if (bad_states.empty()) return;  // Nothing to do.
-  kaldi::ConstIntegerSet<StateId> bad_states_ciset(bad_states);  // faster lookup.
+  if (!have_bad_state) return;  // Nothing to do.
+  classes.clear();
 
-  // Work out list of arcs we have to change as (state, arc-offset).
-  // Can't do the actual changes in this pass, since we have to add new
-  // states which invalidates the iterators.
+  // Work out the list of arcs we have to change, as (state, arc-offset), and
+  // the new state each one goes to; the new states are numbered from
+  // num_states, in the order they are first needed.  We don't change anything
+  // in this pass, since adding states may invalidate the iterators.
   vector<pair<StateId, size_t> > arcs_to_change;
-  for (StateIterator<Fst<Arc> > siter(*fst); !siter.Done(); siter.Next()) {
-    StateId s = siter.Value();
-    for (ArcIterator<Fst<Arc> > aiter(*fst, s); !aiter.Done(); aiter.Next()) {
+  vector<StateId> arc_new_states;  // indexed like arcs_to_change.
+  // new_state_dests[i] is the (bad) state that new state num_states + i goes
+  // to.
+  vector<StateId> new_state_dests;
+  // a map from (bad-state, input-symbol-class) to new state.
+  std::unordered_map<pair<StateId, ClassType>, StateId,
+                     kaldi::PairHasher<StateId, ClassType> > state_map;
+  for (StateId s = 0; s < num_states; s++) {
+    for (ArcIterator<MutableFst<Arc> > aiter(*fst, s); !aiter.Done();
+         aiter.Next()) {
       const Arc &arc = aiter.Value();
-      if (arc.ilabel != 0 &&
-         bad_states_ciset.count(arc.nextstate) != 0)
+      if (arc.ilabel != 0 && is_bad[arc.nextstate]) {
+        // Transition is non-eps transition to "bad" state.  Introduce new
+        // state (or find existing one).
+        pair<StateId, ClassType> p(arc.nextstate, f(arc.ilabel));
+        StateId new_state = num_states + new_state_dests.size();
+        typename std::unordered_map<pair<StateId, ClassType>, StateId,
+            kaldi::PairHasher<StateId, ClassType> >::iterator iter =
+            state_map.insert(std::make_pair(p, new_state)).first;
+        if (iter->second == new_state)
+          new_state_dests.push_back(arc.nextstate);
         arcs_to_change.push_back(std::make_pair(s, aiter.Position()));
+        arc_new_states.push_back(iter->second);
+      }
     }
   }
-  KALDI_ASSERT(!arcs_to_change.empty());  // since !bad_states.empty().
+  KALDI_ASSERT(!arcs_to_change.empty());  // since there were bad states.
 
-  std::map<pair<StateId, ClassType>, StateId> state_map;
-  // state_map is a map from (bad-state, input-symbol-class) to dummy-state.
+  fst->ReserveStates(num_states + new_state_dests.size());
+  for (size_t i = 0; i < new_state_dests.size(); i++) {
+    StateId new_state = fst->AddState();
+    KALDI_ASSERT(new_state == num_states + static_cast<StateId>(i));
+    fst->AddArc(new_state, Arc(0, 0, Weight::One(), new_state_dests[i]));
+  }
 
-  for (size_t i = 0; i < arcs_to_change.size(); i++) {
+  // Redirect the arcs; arcs_to_change is sorted by state, so we need only one
+  // arc iterator per state.
+  for (size_t i = 0; i < arcs_to_change.size(); ) {
     StateId s = arcs_to_change[i].first;
-    ArcIterator<MutableFst<Arc> > aiter(*fst, s);
-    aiter.Seek(arcs_to_change[i].second);
-    Arc arc = aiter.Value();
-
-    // Transition is non-eps transition to "bad" state.  Introduce new state (or find
-    // existing one).
-    pair<StateId, ClassType> p(arc.nextstate, f(arc.ilabel));
-    if (state_map.count(p) == 0) {
-      StateId newstate = state_map[p] = fst->AddState();
-      fst->AddArc(newstate, Arc(0, 0, Weight::One(), arc.nextstate));
-    }
-    StateId dst_state = state_map[p];
-    arc.nextstate = dst_state;
-
-    // Initialize the MutableArcIterator only now, as the call to NewState()
-    // may have invalidated the first arc iterator.
     MutableArcIterator<MutableFst<Arc> > maiter(fst, s);
-    maiter.Seek(arcs_to_change[i].second);
-    maiter.SetValue(arc);
+    for (; i < arcs_to_change.size() && arcs_to_change[i].first == s; i++) {
+      maiter.Seek(arcs_to_change[i].second);
+      Arc arc = maiter.Value();
+      arc.nextstate = arc_new_states[i];
+      maiter.SetValue(arc);
+    }
   }
 }
 
@@ -641,26 +653,34 @@ void MakeFollowingInputSymbolsSameClass(bool end_is_epsilon, MutableFst<Arc> *fs
       bad_states.push_back(s);
   }
   vector<Arc> my_arcs;
+  vector<size_t> changed_arcs;
   for (size_t i = 0; i < bad_states.size(); i++) {
     StateId s = bad_states[i];
     my_arcs.clear();
+    changed_arcs.clear();
     for (ArcIterator<MutableFst<Arc> > aiter(*fst, s); !aiter.Done(); aiter.Next())
       my_arcs.push_back(aiter.Value());
 
+    // Create a new state for each non-eps arc in original FST, out of each bad
+    // state.  Not as optimal as it could be, but does avoid some complicated
+    // weight-pushing issues in which, to maintain stochasticity, we would have
+    // to know which semiring we want to maintain stochasticity in.  We add all
+    // the new states of 's' first, so that only one arc iterator is needed to
+    // change its arcs.
     for (size_t j = 0; j < my_arcs.size(); j++) {
       Arc &arc = my_arcs[j];
       if (arc.ilabel != 0) {
         StateId newstate = fst->AddState();
-        // Create a new state for each non-eps arc in original FST, out of each bad state.
-        // Not as optimal as it could be, but does avoid some complicated weight-pushing
-        // issues in which, to maintain stochasticity, we would have to know which semiring
-        // we want to maintain stochasticity in.
         fst->AddArc(newstate, Arc(arc.ilabel, 0, Weight::One(), arc.nextstate));
-        MutableArcIterator<MutableFst<Arc> > maiter(fst, s);
-        maiter.Seek(j);
-        maiter.SetValue(Arc(0, arc.olabel, arc.weight, newstate));
+        arc = Arc(0, arc.olabel, arc.weight, newstate);
+        changed_arcs.push_back(j);
       }
     }
+    MutableArcIterator<MutableFst<Arc> > maiter(fst, s);
+    for (size_t k = 0; k < changed_arcs.size(); k++) {
+      maiter.Seek(changed_arcs[k]);
+      maiter.SetValue(my_arcs[changed_arcs[k]]);
+    }
   }
 }
 
@@ -240,6 +240,40 @@ template<class Arc>  void TestTableMatcherCacheRight(bool connect) {
 }
 
 
+// Checks that composing with several threads gives the same result as the
+// single-threaded TableCompose (the states may be numbered differently).
+template<class Arc>  void TestParallelTableCompose(bool left) {
+  VectorFst<Arc> *fst1 = RandFst<Arc>();
+  VectorFst<Arc> *fst2 = RandFst<Arc>();
+
+  TableComposeOptions opts;
+  if (left) opts.table_match_type = MATCH_OUTPUT;
+  else opts.table_match_type = MATCH_INPUT;
+  opts.min_table_size = 1 + kaldi::Rand() % 5;
+  opts.table_ratio = 0.25 * (kaldi::Rand() % 5);
+  opts.connect = true;
+
+  ArcSort(fst1, OLabelCompare<Arc>());
+  ArcSort(fst2, ILabelCompare<Arc>());
+
+  VectorFst<Arc> composed_serial, composed_parallel;
+  TableCompose(*fst1, *fst2, &composed_serial, opts);
+  opts.num_threads = 2 + kaldi::Rand() % 3;
+  TableCompose(*fst1, *fst2, &composed_parallel, opts);
+
+  std::cout << "Parallel TableCompose with " << opts.num_threads
+            << " threads: " << composed_serial.NumStates() << " vs. "
+            << composed_parallel.NumStates() << " states.\n";
+  assert(composed_serial.NumStates() == composed_parallel.NumStates());
+  assert(RandEquivalent(composed_serial, composed_parallel, 5/*paths*/,
+                        0.01/*delta*/, kaldi::Rand()/*seed*/,
+                        20/*path length-- max?*/));
+
+  delete fst1;
+  delete fst2;
+}
+
+
 } // namespace fst
 
 int main() {
@@ -253,5 +287,7 @@ int main() {
     TestTableMatcherCacheLeft<fst::StdArc>(false);
     TestTableMatcherCacheRight<fst::StdArc>(true);
     TestTableMatcherCacheRight<fst::StdArc>(false);
+    TestParallelTableCompose<fst::StdArc>(true);
+    TestParallelTableCompose<fst::StdArc>(false);
   }
 }
@@ -22,6 +22,14 @@
 #include <fst/fstlib.h>
 #include <fst/fst-decl.h>
 
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
 
 
 namespace fst {
@@ -301,13 +309,296 @@ struct TableComposeOptions: public TableMatcherOptions {
   bool connect;  // Connect output
   ComposeFilter filter_type;  // Which pre-defined filter to use
   MatchType table_match_type;
+  int num_threads;  // If >1, use ParallelTableComposer (see below).
 
   explicit TableComposeOptions(const TableMatcherOptions &mo,
                                bool c = true, ComposeFilter ft = SEQUENCE_FILTER,
                                MatchType tms = MATCH_OUTPUT)
-      : TableMatcherOptions(mo), connect(c), filter_type(ft), table_match_type(tms) { }
+      : TableMatcherOptions(mo), connect(c), filter_type(ft), table_match_type(tms),
+        num_threads(1) { }
   TableComposeOptions() : connect(true), filter_type(SEQUENCE_FILTER),
-                          table_match_type(MATCH_OUTPUT) { }
+                          table_match_type(MATCH_OUTPUT), num_threads(1) { }
+};
+
+
+/// ParallelTableComposer does the same composition as TableCompose, but
+/// expands the composed states with several threads, for building large
+/// graphs.  It works breadth-first: the states found on one level (the
+/// "frontier") are shared out between the threads, each of which has its own
+/// TableMatcher (on the left FST if table_match_type == MATCH_OUTPUT, else on
+/// the right one) and iterates over the arcs of the other FST.  The state
+/// pairs are deduplicated in a hash that is split into shards with a lock
+/// each, which assigns them provisional ids in whatever order the threads
+/// find them; at the end the states are renumbered breadth-first from the
+/// start state, so the output does not depend on the number of threads or on
+/// timing.  It implements the sequence filter (which TableCompose always
+/// uses, whatever filter_type says), so its output is equivalent to
+/// TableCompose's, but the states may be numbered differently.
+template<class Arc>
+class ParallelTableComposer {
+ public:
+  typedef typename Arc::Label Label;
+  typedef typename Arc::StateId StateId;
+  typedef typename Arc::Weight Weight;
+
+  ParallelTableComposer(const Fst<Arc> &ifst1, const Fst<Arc> &ifst2,
+                        const TableComposeOptions &opts):
+      ifst1_(ifst1), ifst2_(ifst2), opts_(opts), num_ids_(0) {
+    assert(opts_.num_threads >= 1);
+  }
+
+  void Compose(MutableFst<Arc> *ofst) {
+    ofst->DeleteStates();
+    ofst->SetInputSymbols(ifst1_.InputSymbols());
+    ofst->SetOutputSymbols(ifst2_.OutputSymbols());
+    if (ifst1_.Start() == kNoStateId || ifst2_.Start() == kNoStateId)
+      return;
+    int num_threads = opts_.num_threads;
+    for (int t = 0; t < num_threads; t++)
+      workers_.push_back(new Worker(ifst1_, ifst2_, opts_));
+
+    vector<std::pair<StateId, Tuple> > frontier;
+    bool is_new;
+    Tuple start(ifst1_.Start(), ifst2_.Start(), 0);
+    StateId start_id = FindOrAdd(start, &is_new);
+    frontier.push_back(std::make_pair(start_id, start));
+    while (!frontier.empty()) {
+      // Small levels are not worth starting threads for.
+      int this_num_threads = std::min<size_t>(num_threads,
+                                              frontier.size() / 16 + 1);
+      std::atomic<size_t> next(0);
+      vector<std::thread> threads;
+      for (int t = 1; t < this_num_threads; t++)
+        threads.push_back(std::thread(&ParallelTableComposer::ExpandFrontier,
+                                      this, workers_[t], &frontier, &next));
+      ExpandFrontier(workers_[0], &frontier, &next);
+      for (size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+      frontier.clear();
+      for (int t = 0; t < num_threads; t++) {
+        vector<std::pair<StateId, Tuple> > &new_states =
+            workers_[t]->new_states;
+        frontier.insert(frontier.end(), new_states.begin(), new_states.end());
+        new_states.clear();
+      }
+    }
+    Output(start_id, ofst);
+    for (int t = 0; t < num_threads; t++)
+      delete workers_[t];
+    workers_.clear();
+    if (opts_.connect) Connect(ofst);
+  }
+
+ private:
+  // A state of the composed FST: a pair of states and the state of the
+  // sequence filter (0 if we may take an output-epsilon arc of ifst1 next,
+  // 1 if we have just taken an input-epsilon arc of ifst2 while ifst1 has
+  // output-epsilon arcs, so we may not).
+  struct Tuple {
+    StateId s1, s2;
+    char fs;
+    Tuple(StateId s1, StateId s2, char fs): s1(s1), s2(s2), fs(fs) { }
+    bool operator == (const Tuple &other) const {
+      return s1 == other.s1 && s2 == other.s2 && fs == other.fs;
+    }
+  };
+  struct TupleHash {
+    size_t operator () (const Tuple &t) const {
+      return static_cast<size_t>(t.s1) * 7853 + static_cast<size_t>(t.s2) * 2
+          + t.fs;
+    }
+  };
+  typedef std::unordered_map<Tuple, StateId, TupleHash> TupleMap;
+
+  // The states expanded by one thread: their provisional ids, final weights
+  // and arcs (whose nextstates are provisional ids).
+  struct ExpandedStates {
+    vector<StateId> ids;
+    vector<Weight> finals;
+    vector<vector<Arc> > arcs;
+  };
+
+  struct Worker {
+    const Fst<Arc> *fst1, *fst2;
+    TableMatcher<Fst<Arc> > matcher;
+    ExpandedStates expanded;
+    vector<std::pair<StateId, Tuple> > new_states;  // for the next frontier.
+    Worker(const Fst<Arc> &ifst1, const Fst<Arc> &ifst2,
+           const TableComposeOptions &opts):
+        fst1(ifst1.Copy(true)), fst2(ifst2.Copy(true)),
+        matcher(opts.table_match_type == MATCH_OUTPUT ? *fst1 : *fst2,
+                opts.table_match_type, opts) { }
+    ~Worker() { delete fst1; delete fst2; }
+  };
+
+  static const int kNumShards = 256;
+
+  StateId FindOrAdd(const Tuple &tuple, bool *is_new) {
+    size_t hash = TupleHash()(tuple);
+    int shard = (hash ^ (hash >> 16)) % kNumShards;
+    std::lock_guard<std::mutex> lock(shard_mutexes_[shard]);
+    std::pair<typename TupleMap::iterator, bool> ans =
+        shards_[shard].insert(std::make_pair(tuple, kNoStateId));
+    *is_new = ans.second;
+    if (ans.second)
+      ans.first->second = num_ids_++;
+    return ans.first->second;
+  }
+
+  void ExpandFrontier(Worker *worker,
+                      const vector<std::pair<StateId, Tuple> > *frontier,
+                      std::atomic<size_t> *next) {
+    const size_t chunk = 64;
+    size_t n = frontier->size();
+    while (true) {
+      size_t begin = next->fetch_add(chunk);
+      if (begin >= n) break;
+      for (size_t i = begin; i < std::min(n, begin + chunk); i++)
+        Expand(worker, (*frontier)[i].first, (*frontier)[i].second);
+    }
+  }
+
+  void AddArc(Worker *worker, Label ilabel, Label olabel, Weight weight,
+              const Tuple &dest, vector<Arc> *arcs) {
+    bool is_new;
+    StateId id = FindOrAdd(dest, &is_new);
+    if (is_new)
+      worker->new_states.push_back(std::make_pair(id, dest));
+    arcs->push_back(Arc(ilabel, olabel, weight, id));
+  }
+
+  // Works out the final weight and arcs of a composed state.  The arcs are
+  // those ComposeFst produces with the sequence filter, in the same order as
+  // it does when it matches on the FST that the TableMatcher is on.
+  void Expand(Worker *worker, StateId id, const Tuple &tuple) {
+    const Fst<Arc> &fst1 = *worker->fst1, &fst2 = *worker->fst2;
+    TableMatcher<Fst<Arc> > &matcher = worker->matcher;
+    StateId s1 = tuple.s1, s2 = tuple.s2;
+    ExpandedStates &expanded = worker->expanded;
+    expanded.ids.push_back(id);
+    Weight final1 = fst1.Final(s1), final2 = fst2.Final(s2);
+    expanded.finals.push_back(final1 != Weight::Zero() &&
+                              final2 != Weight::Zero() ?
+                              Times(final1, final2) : Weight::Zero());
+    expanded.arcs.resize(expanded.arcs.size() + 1);
+    vector<Arc> &arcs = expanded.arcs.back();
+
+    // The sequence filter: if all arcs of s1 are output-epsilons (and it is
+    // not final), ifst2's input-epsilon arcs must wait until ifst1 has moved
+    // on, and after one of those we take no output-epsilon arc of ifst1.
+    size_t num_eps1 = fst1.NumOutputEpsilons(s1);
+    bool all_eps1 = (num_eps1 == fst1.NumArcs(s1) && final1 == Weight::Zero()),
+        no_eps1 = (num_eps1 == 0);
+    char eps2_fs = (no_eps1 ? 0 : 1);
+    if (opts_.table_match_type == MATCH_OUTPUT) {
+      matcher.SetState(s1);
+      // Output-epsilon arcs of ifst1, staying at s2.  (kNoLabel matches the
+      // real epsilons but not the implicit self-loop.)
+      if (tuple.fs == 0 && matcher.Find(kNoLabel)) {
+        for (; !matcher.Done(); matcher.Next()) {
+          const Arc &arc1 = matcher.Value();
+          AddArc(worker, arc1.ilabel, 0, arc1.weight,
+                 Tuple(arc1.nextstate, s2, 0), &arcs);
+        }
+      }
+      for (ArcIterator<Fst<Arc> > aiter(fst2, s2); !aiter.Done();
+           aiter.Next()) {
+        const Arc &arc2 = aiter.Value();
+        if (arc2.ilabel == 0) {  // Input-epsilon of ifst2, staying at s1.
+          if (!all_eps1)
+            AddArc(worker, 0, arc2.olabel, arc2.weight,
+                   Tuple(s1, arc2.nextstate, eps2_fs), &arcs);
+        } else if (matcher.Find(arc2.ilabel)) {
+          for (; !matcher.Done(); matcher.Next()) {
+            const Arc &arc1 = matcher.Value();
+            AddArc(worker, arc1.ilabel, arc2.olabel,
+                   Times(arc1.weight, arc2.weight),
+                   Tuple(arc1.nextstate, arc2.nextstate, 0), &arcs);
+          }
+        }
+      }
+    } else {
+      matcher.SetState(s2);
+      // Input-epsilon arcs of ifst2, staying at s1.
+      if (!all_eps1 && matcher.Find(kNoLabel)) {
+        for (; !matcher.Done(); matcher.Next()) {
+          const Arc &arc2 = matcher.Value();
+          AddArc(worker, 0, arc2.olabel, arc2.weight,
+                 Tuple(s1, arc2.nextstate, eps2_fs), &arcs);
+        }
+      }
+      for (ArcIterator<Fst<Arc> > aiter(fst1, s1); !aiter.Done();
+           aiter.Next()) {
+        const Arc &arc1 = aiter.Value();
+        if (arc1.olabel == 0) {  // Output-epsilon of ifst1, staying at s2.
+          if (tuple.fs == 0)
+            AddArc(worker, arc1.ilabel, 0, arc1.weight,
+                   Tuple(arc1.nextstate, s2, 0), &arcs);
+        } else if (matcher.Find(arc1.olabel)) {
+          for (; !matcher.Done(); matcher.Next()) {
+            const Arc &arc2 = matcher.Value();
+            AddArc(worker, arc1.ilabel, arc2.olabel,
+                   Times(arc1.weight, arc2.weight),
+                   Tuple(arc1.nextstate, arc2.nextstate, 0), &arcs);
+          }
+        }
+      }
+    }
+  }
+
+  // Renumbers the states breadth-first from the start state and writes them to 'ofst', freeing memory as it goes.
+  void Output(StateId start_id, MutableFst<Arc> *ofst) {
+    StateId num_states = num_ids_;
+    // Where the expanded state with each provisional id is: (worker, index).
+    vector<std::pair<int, size_t> > location(num_states);
+    for (size_t t = 0; t < workers_.size(); t++) {
+      const vector<StateId> &ids = workers_[t]->expanded.ids;
+      for (size_t i = 0; i < ids.size(); i++)
+        location[ids[i]] = std::make_pair(static_cast<int>(t), i);
+    }
+    vector<StateId> new_id(num_states, kNoStateId);
+    vector<StateId> order;  // provisional ids in the new order.
+    order.reserve(num_states);
+    new_id[start_id] = 0;
+    order.push_back(start_id);
+    for (size_t i = 0; i < order.size(); i++) {
+      const std::pair<int, size_t> &loc = location[order[i]];
+      const vector<Arc> &arcs = workers_[loc.first]->expanded.arcs[loc.second];
+      for (size_t j = 0; j < arcs.size(); j++) {
+        if (new_id[arcs[j].nextstate] == kNoStateId) {
+          new_id[arcs[j].nextstate] = order.size();
+          order.push_back(arcs[j].nextstate);
+        }
+      }
+    }
+    assert(order.size() == static_cast<size_t>(num_states));
+    ofst->ReserveStates(num_states);
+    for (StateId s = 0; s < num_states; s++)
+      ofst->AddState();
+    ofst->SetStart(0);
+    for (StateId s = 0; s < num_states; s++) {
+      const std::pair<int, size_t> &loc = location[order[s]];
+      ExpandedStates &expanded = workers_[loc.first]->expanded;
+      vector<Arc> &arcs = expanded.arcs[loc.second];
+      ofst->SetFinal(s, expanded.finals[loc.second]);
+      ofst->ReserveArcs(s, arcs.size());
+      for (size_t j = 0; j < arcs.size(); j++) {
+        Arc arc = arcs[j];
+        arc.nextstate = new_id[arc.nextstate];
+        ofst->AddArc(s, arc);
+      }
+      vector<Arc> tmp;
+      tmp.swap(arcs);
+    }
+  }
+
+  const Fst<Arc> &ifst1_;
+  const Fst<Arc> &ifst2_;
+  TableComposeOptions opts_;
+  vector<Worker*> workers_;
+  TupleMap shards_[kNumShards];
+  std::mutex shard_mutexes_[kNumShards];
+  std::atomic<StateId> num_ids_;
 };
 
 
@@ -316,6 +607,11 @@ void TableCompose(const Fst<Arc> &ifst1, const Fst<Arc> &ifst2,
                   MutableFst<Arc> *ofst,
                   const TableComposeOptions &opts = TableComposeOptions()) {
   typedef Fst<Arc> F;
+  if (opts.num_threads > 1) {
+    ParallelTableComposer<Arc> composer(ifst1, ifst2, opts);
+    composer.Compose(ofst);
+    return;
+  }
   CacheOptions nopts;
   nopts.gc_limit = 0;  // Cache only the last state for fastest copy.
   if (opts.table_match_type == MATCH_OUTPUT) {
@@ -335,7 +631,8 @@ void TableCompose(const Fst<Arc> &ifst1, const Fst<Arc> &ifst2,
 
 
 /// TableComposeCache lets us do multiple compositions while caching the same
-/// matcher.
+/// matcher.  (opts.num_threads is ignored here, as the matcher cannot be
+/// shared between threads.)
 template<class F>
 struct TableComposeCache {
   TableMatcher<F> *matcher;
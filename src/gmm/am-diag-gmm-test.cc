@@ -20,6 +20,7 @@
 
 #include "gmm/model-test-common.h"
 #include "gmm/am-diag-gmm.h"
+#include "gmm/decodable-am-diag-gmm.h"
 #include "util/kaldi-io.h"
 
 using kaldi::AmDiagGmm;
@@ -104,6 +105,24 @@ void TestClustering(const AmDiagGmm &am_gmm) {
   ClusterGaussiansToUbm(am_gmm, occs, ubm_opts, &ubm);
 }
 
+// Checks that the likelihoods from DecodableAmDiagGmmUnmapped, which computes
+// them for several frames at a time, match those of the model, whatever order
+// the frames and pdfs are visited in.
+void TestDecodable(const AmDiagGmm &am_gmm) {
+  int32 num_frames = kaldi::RandInt(1, 30);
+  kaldi::Matrix<BaseFloat> feats(num_frames, am_gmm.Dim());
+  feats.SetRandn();
+  kaldi::DecodableAmDiagGmmUnmapped decodable(am_gmm, feats);
+  KALDI_ASSERT(decodable.NumFramesReady() == num_frames);
+  for (int32 i = 0; i < 200; i++) {
+    int32 frame = (i < num_frames ? i : kaldi::RandInt(0, num_frames - 1)),
+        pdf = kaldi::RandInt(0, am_gmm.NumPdfs() - 1);
+    BaseFloat loglike = am_gmm.LogLikelihood(pdf, feats.Row(frame));
+    // LogLikelihood() takes one-based indices.
+    kaldi::AssertEqual(decodable.LogLikelihood(frame, pdf + 1), loglike, 1e-4);
+  }
+}
+
 void UnitTestAmDiagGmm() {
   int32 dim = 1 + kaldi::RandInt(0, 9),  // random dimension of the gmm
       num_pdfs = 5 + kaldi::RandInt(0, 9);  // random number of states
@@ -119,6 +138,7 @@ void UnitTestAmDiagGmm() {
   TestAmDiagGmmIO(am_gmm);
   TestSplitStates(am_gmm);
   TestClustering(am_gmm);
+  TestDecodable(am_gmm);
 }
 
 int main() {
@@ -18,6 +18,7 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <vector>
 using std::vector;
 
@@ -32,43 +33,119 @@ BaseFloat DecodableAmDiagGmmUnmapped::LogLikelihoodZeroBased(
   KALDI_ASSERT(static_cast<size_t>(state) < static_cast<size_t>(NumIndices()) &&
                "Likely graph/model mismatch, e.g. using wrong HCLG.fst");
 
-  if (log_like_cache_[state].hit_time == frame) {
-    return log_like_cache_[state].log_like;  // return cached value, if found
-  }
-
-  if (frame != previous_frame_) {  // cache the squared stats.
-    data_squared_.CopyFromVec(feature_matrix_.Row(frame));
-    data_squared_.ApplyPow(2.0);
-    previous_frame_ = frame;
+  int32 window_start = frame - frame % kFrameWindow;
+  if (window_start != window_start_)
+    StartWindow(window_start);
+  if (pdf_last_frame_[state] < window_start)
+    used_pdfs_.push_back(state);
+  pdf_last_frame_[state] = frame;
+
+  BaseFloat log_sum;
+  if (pdf_window_start_[state] == window_start) {
+    log_sum = window_log_likes_(state, frame - window_start);
+  } else {
+    if (log_like_cache_[state].hit_time == frame) {
+      return log_like_cache_[state].log_like;  // return cached value, if found
+    }
+    // This pdf was not prefetched for the window; it is evaluated on just this
+    // frame, as it may not be needed on the others.
+    const DiagGmm &pdf = GetCheckedPdf(state);
+    const VectorBase<BaseFloat> &data = feature_matrix_.Row(frame);
+    SubVector<BaseFloat> data_squared(data_squared_, frame - window_start);
+
+    Vector<BaseFloat> loglikes(pdf.gconsts());  // need to recreate for each pdf
+    // loglikes +=  means * inv(vars) * data.
+    loglikes.AddMatVec(1.0, pdf.means_invvars(), kNoTrans, data, 1.0);
+    // loglikes += -0.5 * inv(vars) * data_sq.
+    loglikes.AddMatVec(-0.5, pdf.inv_vars(), kNoTrans, data_squared, 1.0);
+    log_sum = loglikes.LogSumExp(log_sum_exp_prune_);
+
+    log_like_cache_[state].log_like = log_sum;
+    log_like_cache_[state].hit_time = frame;
   }
+  if (KALDI_ISNAN(log_sum) || KALDI_ISINF(log_sum))
+    KALDI_ERR << "Invalid answer (overflow or invalid variances/features?)";
+  return log_sum;
+}
 
+const DiagGmm &DecodableAmDiagGmmUnmapped::GetCheckedPdf(int32 state) const {
   const DiagGmm &pdf = acoustic_model_.GetPdf(state);
-  const VectorBase<BaseFloat> &data = feature_matrix_.Row(frame);
-
   // check if everything is in order
-  if (pdf.Dim() != data.Dim()) {
-    KALDI_ERR << "Dim mismatch: data dim = "  << data.Dim()
+  if (pdf.Dim() != feature_matrix_.NumCols()) {
+    KALDI_ERR << "Dim mismatch: data dim = "  << feature_matrix_.NumCols()
         << " vs. model dim = " << pdf.Dim();
   }
   if (!pdf.valid_gconsts()) {
     KALDI_ERR << "State "  << (state)  << ": Must call ComputeGconsts() "
         "before computing likelihood.";
   }
+  return pdf;
+}
 
-  Vector<BaseFloat> loglikes(pdf.gconsts());  // need to recreate for each pdf
-  // loglikes +=  means * inv(vars) * data.
-  loglikes.AddMatVec(1.0, pdf.means_invvars(), kNoTrans, data, 1.0);
-  // loglikes += -0.5 * inv(vars) * data_sq.
-  loglikes.AddMatVec(-0.5, pdf.inv_vars(), kNoTrans, data_squared_, 1.0);
-
-  BaseFloat log_sum = loglikes.LogSumExp(log_sum_exp_prune_);
-  if (KALDI_ISNAN(log_sum) || KALDI_ISINF(log_sum))
-    KALDI_ERR << "Invalid answer (overflow or invalid variances/features?)";
-
-  log_like_cache_[state].log_like = log_sum;
-  log_like_cache_[state].hit_time = frame;
+void DecodableAmDiagGmmUnmapped::StartWindow(int32 window_start) {
+  int32 num_frames = NumFramesReady() - window_start;
+  if (num_frames > kFrameWindow)
+    num_frames = kFrameWindow;
+  SubMatrix<BaseFloat> data(feature_matrix_, window_start, num_frames,
+                            0, feature_matrix_.NumCols());
+  data_squared_.Resize(num_frames, data.NumCols(), kUndefined);
+  data_squared_.CopyFromMat(data);
+  data_squared_.ApplyPow(2.0);
+  window_start_ = window_start;
+
+  // Prefetch the pdfs that were used on the last frame of the previous
+  // window, as they are likely to be used on this one.
+  pdf_to_compute_.clear();
+  for (size_t i = 0; i < used_pdfs_.size(); i++)
+    if (pdf_last_frame_[used_pdfs_[i]] == window_start - 1)
+      pdf_to_compute_.push_back(used_pdfs_[i]);
+  used_pdfs_.clear();
+  if (!pdf_to_compute_.empty())
+    ComputeWindow(pdf_to_compute_);
+}
 
-  return log_sum;
+void DecodableAmDiagGmmUnmapped::ComputeWindow(
+    const std::vector<int32> &pdfs) {
+  int32 num_frames = data_squared_.NumRows(), dim = data_squared_.NumCols(),
+      num_gauss = 0;
+  SubMatrix<BaseFloat> data(feature_matrix_, window_start_, num_frames,
+                            0, dim);
+  for (size_t i = 0; i < pdfs.size(); i++)
+    num_gauss += GetCheckedPdf(pdfs[i]).NumGauss();
+
+  gauss_log_likes_.Resize(num_frames, num_gauss, kUndefined);
+  gconsts_.Resize(num_gauss, kUndefined);
+  means_invvars_.Resize(num_gauss, dim, kUndefined);
+  inv_vars_.Resize(num_gauss, dim, kUndefined);
+  int32 offset = 0;
+  for (size_t i = 0; i < pdfs.size(); i++) {
+    const DiagGmm &pdf = acoustic_model_.GetPdf(pdfs[i]);
+    int32 this_num_gauss = pdf.NumGauss();
+    gconsts_.Range(offset, this_num_gauss).CopyFromVec(pdf.gconsts());
+    means_invvars_.RowRange(offset, this_num_gauss).CopyFromMat(
+        pdf.means_invvars());
+    inv_vars_.RowRange(offset, this_num_gauss).CopyFromMat(pdf.inv_vars());
+    offset += this_num_gauss;
+  }
+  gauss_log_likes_.CopyRowsFromVec(gconsts_);
+  // loglikes +=  data * (means * inv(vars))^T.
+  gauss_log_likes_.AddMatMat(1.0, data, kNoTrans, means_invvars_, kTrans, 1.0);
+  // loglikes += -0.5 * data_sq * inv(vars)^T.
+  gauss_log_likes_.AddMatMat(-0.5, data_squared_, kNoTrans, inv_vars_, kTrans,
+                             1.0);
+
+  offset = 0;
+  for (size_t i = 0; i < pdfs.size(); i++) {
+    int32 pdf_id = pdfs[i],
+        this_num_gauss = acoustic_model_.GetPdf(pdf_id).NumGauss();
+    for (int32 t = 0; t < num_frames; t++) {
+      SubVector<BaseFloat> loglikes(gauss_log_likes_.RowData(t) + offset,
+                                    this_num_gauss);
+      window_log_likes_(pdf_id, t) = loglikes.LogSumExp(log_sum_exp_prune_);
+    }
+    pdf_window_start_[pdf_id] = window_start_;
+    offset += this_num_gauss;
+  }
 }
 
 void DecodableAmDiagGmmUnmapped::ResetLogLikeCache() {
@@ -78,6 +155,13 @@ void DecodableAmDiagGmmUnmapped::ResetLogLikeCache() {
   vector<LikelihoodCacheRecord>::iterator it = log_like_cache_.begin(),
       end = log_like_cache_.end();
   for (; it != end; ++it) { it->hit_time = -1; }
+
+  int32 num_pdfs = acoustic_model_.NumPdfs();
+  pdf_window_start_.assign(num_pdfs, -1);
+  pdf_last_frame_.assign(num_pdfs, -1);
+  used_pdfs_.clear();
+  window_log_likes_.Resize(num_pdfs, kFrameWindow, kUndefined);
+  window_start_ = -1;
 }
 
 
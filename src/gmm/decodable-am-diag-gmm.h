@@ -52,8 +52,8 @@ class DecodableAmDiagGmmUnmapped : public DecodableInterface {
                              const Matrix<BaseFloat> &feats,
                              BaseFloat log_sum_exp_prune = -1.0):
     acoustic_model_(am), feature_matrix_(feats),
-    previous_frame_(-1), log_sum_exp_prune_(log_sum_exp_prune), 
-    data_squared_(feats.NumCols()) {
+    previous_frame_(-1), log_sum_exp_prune_(log_sum_exp_prune),
+    window_start_(-1) {
     ResetLogLikeCache();
   }
 
@@ -88,8 +88,46 @@ class DecodableAmDiagGmmUnmapped : public DecodableInterface {
   };
   std::vector<LikelihoodCacheRecord> log_like_cache_;
  private:
-  Vector<BaseFloat> data_squared_;  ///< Cache for fast likelihood calculation
-
+  /// The frames are divided into windows of kFrameWindow frames.  When a
+  /// window is started, the pdfs that were used on the last frame of the
+  /// previous one are evaluated on all its frames, with one matrix
+  /// multiplication over their stacked Gaussians, as the pdfs active on one
+  /// frame are mostly still active on the next few.  Any other pdf is
+  /// evaluated a frame at a time, and cached in log_like_cache_.
+  static const int32 kFrameWindow = 8;
+
+  /// Makes "window_start" the current window, and computes the likelihoods of
+  /// the pdfs used on the last frame of the previous one.
+  void StartWindow(int32 window_start);
+
+  /// Computes the log-likelihoods of "pdfs" on the frames of the current
+  /// window, into window_log_likes_.
+  void ComputeWindow(const std::vector<int32> &pdfs);
+
+  /// Returns pdf "state", checking that it can be evaluated on the features.
+  const DiagGmm &GetCheckedPdf(int32 state) const;
+
+  /// The first frame of the current window, or -1.
+  int32 window_start_;
+  /// The squared features of the frames of the current window.
+  Matrix<BaseFloat> data_squared_;
+  /// For each pdf, the window whose log-likelihoods are in its row of
+  /// window_log_likes_, or -1.
+  std::vector<int32> pdf_window_start_;
+  /// Row i holds the log-likelihoods of pdf i on the frames of window
+  /// pdf_window_start_[i].
+  Matrix<BaseFloat> window_log_likes_;
+  /// For each pdf, the last frame it was asked for on, or -1.
+  std::vector<int32> pdf_last_frame_;
+  /// The pdfs asked for in the current window.
+  std::vector<int32> used_pdfs_;
+  /// The pdfs to prefetch (temporary).
+  std::vector<int32> pdf_to_compute_;
+
+  /// Temporaries for ComputeWindow(): the stacked parameters of the Gaussians
+  /// of the pdfs, and their per-Gaussian log-likelihoods on the window.
+  Vector<BaseFloat> gconsts_;
+  Matrix<BaseFloat> means_invvars_, inv_vars_, gauss_log_likes_;
 
   KALDI_DISALLOW_COPY_AND_ASSIGN(DecodableAmDiagGmmUnmapped);
 };
@@ -83,6 +83,36 @@ void UnitTestDiagGmmGenerate() {
   // *necessarily* mean that something is wrong.
 }
 
+// Checks the multi-frame LogLikelihoodsPreselect against the one-frame version,
+// on Gaussian selections that are shared by nearby frames (which use the
+// matrix-multiplication path) or random (which mostly don't).
+void UnitTestLogLikelihoodsPreselectBatch() {
+  DiagGmm gmm;
+  InitRandomGmm(&gmm);
+  int32 num_frames = RandInt(1, 50), num_gauss = gmm.NumGauss();
+  Matrix<BaseFloat> feats(num_frames, gmm.Dim());
+  feats.SetRandn();
+  bool shared = (RandInt(0, 1) == 0);
+  std::vector<std::vector<int32> > gselect(num_frames);
+  for (int32 t = 0; t < num_frames; t++) {
+    int32 num_gselect = RandInt(1, num_gauss);
+    for (int32 g = 0; g < num_gauss; g++)
+      if ((shared ? g % 4 != t % 3 : RandInt(0, 2) == 0) &&
+          static_cast<int32>(gselect[t].size()) < num_gselect)
+        gselect[t].push_back(g);
+    if (gselect[t].empty())
+      gselect[t].push_back(RandInt(0, num_gauss - 1));
+  }
+  std::vector<Vector<BaseFloat> > loglikes;
+  gmm.LogLikelihoodsPreselect(feats, gselect, &loglikes);
+  KALDI_ASSERT(static_cast<int32>(loglikes.size()) == num_frames);
+  for (int32 t = 0; t < num_frames; t++) {
+    Vector<BaseFloat> ref_loglikes;
+    gmm.LogLikelihoodsPreselect(feats.Row(t), gselect[t], &ref_loglikes);
+    KALDI_ASSERT(ref_loglikes.ApproxEqual(loglikes[t], 1.0e-04));
+  }
+}
+
 void UnitTestDiagGmm() {
   // random dimension of the gmm
   size_t dim = 1 + kaldi::RandInt(0, 5);
@@ -304,6 +334,8 @@ int main() {
     kaldi::UnitTestDiagGmm();
     kaldi::UnitTestDiagGmmGenerate();
   }
+  for (int i = 0; i < 10; i++)
+    kaldi::UnitTestLogLikelihoodsPreselectBatch();
   std::cout << "Test OK.\n";
 }
 
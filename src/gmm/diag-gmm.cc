@@ -597,6 +597,84 @@ void DiagGmm::LogLikelihoodsPreselect(const VectorBase<BaseFloat> &data,
 
 
 
+void DiagGmm::LogLikelihoodsPreselect(
+    const MatrixBase<BaseFloat> &data,
+    const std::vector<std::vector<int32> > &gselect,
+    std::vector<Vector<BaseFloat> > *loglikes) const {
+  int32 num_frames = data.NumRows(), num_gauss = NumGauss(), dim = Dim();
+  KALDI_ASSERT(data.NumCols() == dim &&
+               static_cast<int32>(gselect.size()) == num_frames);
+  loglikes->resize(num_frames);
+
+  // The frames are processed in blocks.  A block is evaluated with matrix
+  // multiplications on the union of its Gaussians, unless that would cost
+  // more than a few times the (frame, Gaussian) pairs it actually needs, in
+  // which case it is done a frame at a time.
+  const int32 block_size = 16, max_expansion = 4;
+  std::vector<int32> gauss_to_pos(num_gauss, -1), union_indices;
+  Matrix<BaseFloat> data_sq, means_invvars, inv_vars, block_loglikes;
+  Vector<BaseFloat> gconsts;
+  for (int32 start = 0; start < num_frames; start += block_size) {
+    int32 this_num_frames = std::min(block_size, num_frames - start);
+    int64 num_pairs = 0;
+    union_indices.clear();
+    for (int32 t = start; t < start + this_num_frames; t++) {
+      const std::vector<int32> &indices = gselect[t];
+      num_pairs += indices.size();
+      for (size_t i = 0; i < indices.size(); i++) {
+        int32 gauss = indices[i];
+        KALDI_ASSERT(gauss >= 0 && gauss < num_gauss);
+        if (gauss_to_pos[gauss] == -1) {
+          gauss_to_pos[gauss] = union_indices.size();
+          union_indices.push_back(gauss);
+        }
+      }
+    }
+    int32 num_union = union_indices.size();
+
+    if (static_cast<int64>(num_union) * this_num_frames >
+        max_expansion * num_pairs) {
+      for (int32 t = start; t < start + this_num_frames; t++) {
+        if (gselect[t].empty())
+          (*loglikes)[t].Resize(0);
+        else
+          LogLikelihoodsPreselect(data.Row(t), gselect[t], &((*loglikes)[t]));
+      }
+    } else if (num_union > 0) {
+      SubMatrix<BaseFloat> block_data(data, start, this_num_frames, 0, dim);
+      data_sq = block_data;
+      data_sq.ApplyPow(2.0);
+      means_invvars.Resize(num_union, dim, kUndefined);
+      means_invvars.CopyRows(means_invvars_, &(union_indices[0]));
+      inv_vars.Resize(num_union, dim, kUndefined);
+      inv_vars.CopyRows(inv_vars_, &(union_indices[0]));
+      gconsts.Resize(num_union, kUndefined);
+      for (int32 i = 0; i < num_union; i++)
+        gconsts(i) = gconsts_(union_indices[i]);
+
+      block_loglikes.Resize(this_num_frames, num_union, kUndefined);
+      block_loglikes.CopyRowsFromVec(gconsts);
+      // block_loglikes += data * means_invvars^T - 0.5 * data_sq * inv_vars^T.
+      block_loglikes.AddMatMat(1.0, block_data, kNoTrans,
+                               means_invvars, kTrans, 1.0);
+      block_loglikes.AddMatMat(-0.5, data_sq, kNoTrans, inv_vars, kTrans, 1.0);
+      for (int32 t = start; t < start + this_num_frames; t++) {
+        const std::vector<int32> &indices = gselect[t];
+        Vector<BaseFloat> &this_loglikes = (*loglikes)[t];
+        this_loglikes.Resize(indices.size(), kUndefined);
+        for (size_t i = 0; i < indices.size(); i++)
+          this_loglikes(i) = block_loglikes(t - start, gauss_to_pos[indices[i]]);
+      }
+    } else {
+      for (int32 t = start; t < start + this_num_frames; t++)
+        (*loglikes)[t].Resize(0);
+    }
+    for (int32 i = 0; i < num_union; i++)
+      gauss_to_pos[union_indices[i]] = -1;
+  }
+}
+
+
 // Gets likelihood of data given this. Also provides per-Gaussian posteriors.
 BaseFloat DiagGmm::ComponentPosteriors(const VectorBase<BaseFloat> &data,
                                        Vector<BaseFloat> *posterior) const {
@@ -100,6 +100,16 @@ class DiagGmm {
                                const std::vector<int32> &indices,
                                Vector<BaseFloat> *loglikes) const;
 
+  /// This version of LogLikelihoodsPreselect operates on a sequence of frames,
+  /// with gselect[t] the indices for frame t (the row index of "data").  At
+  /// output, (*loglikes)[t](i) is the log-likelihood of the Gaussian
+  /// gselect[t][i].  Where the frames in a block share most of their
+  /// Gaussians, it evaluates the union of them on the whole block with matrix
+  /// multiplications, which is much faster than doing it a frame at a time.
+  void LogLikelihoodsPreselect(const MatrixBase<BaseFloat> &data,
+                               const std::vector<std::vector<int32> > &gselect,
+                               std::vector<Vector<BaseFloat> > *loglikes) const;
+
   /// Get gaussian selection information for one frame.  Returns log-like
   /// this frame.  Output is the best "num_gselect" indices, sorted from best to
   /// worst likelihood.  If "num_gselect" > NumGauss(), sets it to NumGauss().
@@ -17,6 +17,8 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <thread>
+
 #include "gmm/model-test-common.h"
 #include "gmm/am-diag-gmm.h"
 #include "gmm/mle-am-diag-gmm.h"
@@ -91,6 +93,62 @@ void TestAmDiagGmmAccsIO(const AmDiagGmm &am_gmm,
   unlink("tmpfb");
 }
 
+// Accumulates stats from several threads through AccumAmDiagGmmPool, and
+// checks that their sum, and the multi-threaded update, match doing it in one
+// thread.
+void TestAmDiagGmmMultiThreaded(const AmDiagGmm &am_gmm,
+                                const Matrix<BaseFloat> &feats) {
+  kaldi::GmmFlagsType flags = kaldi::kGmmAll;
+  int32 num_frames = feats.NumRows(), num_threads = RandInt(1, 4);
+  std::vector<int32> states(num_frames);
+  for (int32 i = 0; i < num_frames; i++)
+    states[i] = RandInt(0, am_gmm.NumPdfs()-1);
+
+  AccumAmDiagGmm accs;
+  accs.Init(am_gmm, flags);
+  for (int32 i = 0; i < num_frames; i++)
+    accs.AccumulateForGmm(am_gmm, feats.Row(i), states[i], 1.0);
+
+  AccumAmDiagGmmPool pool(am_gmm, flags, num_threads);
+  {
+    std::vector<std::thread> threads;
+    for (int32 t = 0; t < num_threads; t++) {
+      threads.push_back(std::thread([&, t]() {
+        AccumAmDiagGmm *thread_accs = pool.Acquire();
+        for (int32 i = t; i < num_frames; i += num_threads)
+          thread_accs->AccumulateForGmm(am_gmm, feats.Row(i), states[i], 1.0);
+        pool.Release(thread_accs);
+      }));
+    }
+    for (int32 t = 0; t < num_threads; t++)
+      threads[t].join();
+  }
+  const AccumAmDiagGmm &sum_accs = *(pool.Sum(num_threads));
+  AssertEqual(sum_accs.TotCount(), accs.TotCount(), 1e-5);
+  AssertEqual(sum_accs.TotLogLike(), accs.TotLogLike(), 1e-5);
+  for (int32 j = 0; j < am_gmm.NumPdfs(); j++) {
+    KALDI_ASSERT(sum_accs.GetAcc(j).occupancy().ApproxEqual(
+        accs.GetAcc(j).occupancy(), 1e-5));
+    KALDI_ASSERT(sum_accs.GetAcc(j).mean_accumulator().ApproxEqual(
+        accs.GetAcc(j).mean_accumulator(), 1e-5));
+  }
+
+  // The update of the pdfs is independent, so it should give exactly the same
+  // result with any number of threads.
+  MleDiagGmmOptions config;
+  AmDiagGmm am_gmm1, am_gmm2;
+  am_gmm1.CopyFromAmDiagGmm(am_gmm);
+  am_gmm2.CopyFromAmDiagGmm(am_gmm);
+  BaseFloat objf_impr1, count1, objf_impr2, count2;
+  MleAmDiagGmmUpdate(config, accs, flags, &am_gmm1, &objf_impr1, &count1);
+  MleAmDiagGmmUpdate(config, accs, flags, &am_gmm2, &objf_impr2, &count2,
+                     num_threads);
+  KALDI_ASSERT(objf_impr1 == objf_impr2 && count1 == count2);
+  for (int32 i = 0; i < num_frames; i += 10)
+    KALDI_ASSERT(am_gmm1.LogLikelihood(states[i], feats.Row(i)) ==
+                 am_gmm2.LogLikelihood(states[i], feats.Row(i)));
+}
+
 void UnitTestMleAmDiagGmm() {
   int32 dim = 1 + kaldi::RandInt(0, 9),  // random dimension of the gmm
       num_pdfs = 5 + kaldi::RandInt(0, 9);  // random number of states
@@ -126,6 +184,7 @@ void UnitTestMleAmDiagGmm() {
     }
   }
   TestAmDiagGmmAccsIO(am_gmm, feats);
+  TestAmDiagGmmMultiThreaded(am_gmm, feats);
 }
 
 
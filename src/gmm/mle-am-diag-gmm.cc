@@ -20,6 +20,7 @@
 
 #include "gmm/am-diag-gmm.h"
 #include "gmm/mle-am-diag-gmm.h"
+#include "util/kaldi-thread.h"
 #include "util/stl-utils.h"
 
 namespace kaldi {
@@ -184,12 +185,49 @@ void ResizeModel (int32 dim, AmDiagGmm *am_gmm) {
   }
 }
 
+// The result of updating one pdf in MleAmDiagGmmUpdate().
+struct MleDiagGmmUpdateResult {
+  BaseFloat obj_change, count;
+  int32 elems_floored, gauss_floored, gauss_removed;
+};
+
+// Updates a subset of the pdfs (relates to multi-threading).
+class MleAmDiagGmmUpdateClass: public MultiThreadable {
+ public:
+  MleAmDiagGmmUpdateClass(const MleDiagGmmOptions &config,
+                          const AccumAmDiagGmm &am_diag_gmm_acc,
+                          GmmFlagsType flags,
+                          AmDiagGmm *am_gmm,
+                          std::vector<MleDiagGmmUpdateResult> *results):
+      config_(config), am_diag_gmm_acc_(am_diag_gmm_acc), flags_(flags),
+      am_gmm_(am_gmm), results_(results) { }
+  void operator () () {
+    // The pdfs are interleaved, so that the threads get similar mixes of big
+    // and small ones.
+    for (int32 i = thread_id_; i < am_diag_gmm_acc_.NumAccs();
+         i += num_threads_) {
+      MleDiagGmmUpdateResult &r = (*results_)[i];
+      MleDiagGmmUpdate(config_, am_diag_gmm_acc_.GetAcc(i), flags_,
+                       &(am_gmm_->GetPdf(i)),
+                       &r.obj_change, &r.count, &r.elems_floored,
+                       &r.gauss_floored, &r.gauss_removed);
+    }
+  }
+ private:
+  const MleDiagGmmOptions &config_;
+  const AccumAmDiagGmm &am_diag_gmm_acc_;
+  GmmFlagsType flags_;
+  AmDiagGmm *am_gmm_;
+  std::vector<MleDiagGmmUpdateResult> *results_;
+};
+
 void MleAmDiagGmmUpdate (const MleDiagGmmOptions &config,
                          const AccumAmDiagGmm &am_diag_gmm_acc,
                          GmmFlagsType flags,
                          AmDiagGmm *am_gmm,
                          BaseFloat *obj_change_out,
-                         BaseFloat *count_out) {
+                         BaseFloat *count_out,
+                         int32 num_threads) {
   if (am_diag_gmm_acc.Dim() != am_gmm->Dim()) {
     KALDI_ASSERT(am_diag_gmm_acc.Dim() != 0);
     KALDI_WARN << "Dimensions of accumulator " << am_diag_gmm_acc.Dim()
@@ -203,22 +241,26 @@ void MleAmDiagGmmUpdate (const MleDiagGmmOptions &config,
   if (obj_change_out != NULL) *obj_change_out = 0.0;
   if (count_out != NULL) *count_out = 0.0;
 
+  std::vector<MleDiagGmmUpdateResult> results(am_diag_gmm_acc.NumAccs());
+  {
+    MleAmDiagGmmUpdateClass c(config, am_diag_gmm_acc, flags, am_gmm,
+                              &results);
+    // With num_threads == 0, MultiThreader runs it in this thread.
+    MultiThreader<MleAmDiagGmmUpdateClass> m(num_threads > 1 ? num_threads : 0,
+                                             c);
+  }
+
+  // The totals are summed in order of pdf, so that they don't depend on the
+  // number of threads.
   BaseFloat tot_obj_change = 0.0, tot_count = 0.0;
   int32 tot_elems_floored = 0, tot_gauss_floored = 0,
       tot_gauss_removed = 0;
-  for (int32 i = 0; i < am_diag_gmm_acc.NumAccs(); i++) {
-    BaseFloat obj_change, count;
-    int32 elems_floored, gauss_floored, gauss_removed;
-    
-    MleDiagGmmUpdate(config, am_diag_gmm_acc.GetAcc(i), flags,
-                     &(am_gmm->GetPdf(i)),
-                     &obj_change, &count, &elems_floored,
-                     &gauss_floored, &gauss_removed);
-    tot_obj_change += obj_change;
-    tot_count += count;
-    tot_elems_floored += elems_floored;
-    tot_gauss_floored += gauss_floored;
-    tot_gauss_removed += gauss_removed;
+  for (size_t i = 0; i < results.size(); i++) {
+    tot_obj_change += results[i].obj_change;
+    tot_count += results[i].count;
+    tot_elems_floored += results[i].elems_floored;
+    tot_gauss_floored += results[i].gauss_floored;
+    tot_gauss_removed += results[i].gauss_removed;
   }
   if (obj_change_out != NULL) *obj_change_out = tot_obj_change;
   if (count_out != NULL) *count_out = tot_count;
@@ -286,4 +328,76 @@ void AccumAmDiagGmm::Add(BaseFloat scale, const AccumAmDiagGmm &other) {
     gmm_accumulators_[i]->Add(scale, *(other.gmm_accumulators_[i]));
 }
 
+// Adds the stats of a subset of the pdfs (relates to multi-threading).
+class AccumAmDiagGmmAddClass: public MultiThreadable {
+ public:
+  AccumAmDiagGmmAddClass(const std::vector<const AccumAmDiagGmm*> &others,
+                         AccumAmDiagGmm *acc): others_(others), acc_(acc) { }
+  void operator () () {
+    for (int32 i = thread_id_; i < acc_->NumAccs(); i += num_threads_)
+      for (size_t j = 0; j < others_.size(); j++)
+        acc_->GetAcc(i).Add(1.0, others_[j]->GetAcc(i));
+  }
+ private:
+  const std::vector<const AccumAmDiagGmm*> &others_;
+  AccumAmDiagGmm *acc_;
+};
+
+void AccumAmDiagGmm::AddMultiThreaded(
+    const std::vector<const AccumAmDiagGmm*> &others, int32 num_threads) {
+  for (size_t j = 0; j < others.size(); j++) {
+    KALDI_ASSERT(others[j]->NumAccs() == NumAccs());
+    total_frames_ += others[j]->total_frames_;
+    total_log_like_ += others[j]->total_log_like_;
+  }
+  AccumAmDiagGmmAddClass c(others, this);
+  MultiThreader<AccumAmDiagGmmAddClass> m(num_threads > 1 ? num_threads : 0,
+                                          c);
+}
+
+
+AccumAmDiagGmmPool::AccumAmDiagGmmPool(const AmDiagGmm &model,
+                                       GmmFlagsType flags, int32 num_accs) {
+  KALDI_ASSERT(num_accs > 0);
+  for (int32 i = 0; i < num_accs; i++) {
+    accs_.push_back(new AccumAmDiagGmm());
+    accs_.back()->Init(model, flags);
+  }
+  free_accs_ = accs_;
+}
+
+AccumAmDiagGmm *AccumAmDiagGmmPool::Acquire() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (free_accs_.empty())
+    acc_released_.wait(lock);
+  AccumAmDiagGmm *acc = free_accs_.back();
+  free_accs_.pop_back();
+  return acc;
+}
+
+void AccumAmDiagGmmPool::Release(AccumAmDiagGmm *acc) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_accs_.push_back(acc);
+  }
+  acc_released_.notify_one();
+}
+
+AccumAmDiagGmm *AccumAmDiagGmmPool::Sum(int32 num_threads) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  KALDI_ASSERT(free_accs_.size() == accs_.size() &&
+               "Sum() called while accumulators are in use");
+  std::vector<const AccumAmDiagGmm*> others(accs_.begin() + 1, accs_.end());
+  accs_[0]->AddMultiThreaded(others, num_threads);
+  for (size_t i = 1; i < accs_.size(); i++)
+    delete accs_[i];
+  accs_.resize(1);
+  free_accs_ = accs_;
+  return accs_[0];
+}
+
+AccumAmDiagGmmPool::~AccumAmDiagGmmPool() {
+  DeletePointers(&accs_);
+}
+
 }  // namespace kaldi
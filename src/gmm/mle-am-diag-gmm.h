@@ -23,6 +23,8 @@
 #ifndef KALDI_GMM_MLE_AM_DIAG_GMM_H_
 #define KALDI_GMM_MLE_AM_DIAG_GMM_H_ 1
 
+#include <condition_variable>
+#include <mutex>
 #include <vector>
 
 #include "gmm/am-diag-gmm.h"
@@ -89,6 +91,11 @@ class AccumAmDiagGmm {
 
   void Add(BaseFloat scale, const AccumAmDiagGmm &other);
 
+  /// Adds all of "others" to this, with the pdfs divided among "num_threads"
+  /// threads.
+  void AddMultiThreaded(const std::vector<const AccumAmDiagGmm*> &others,
+                        int32 num_threads);
+
   void Scale(BaseFloat scale);
 
   int32 Dim() const {
@@ -107,14 +114,47 @@ class AccumAmDiagGmm {
   KALDI_DISALLOW_COPY_AND_ASSIGN(AccumAmDiagGmm);
 };
 
+/// A set of accumulators for accumulating stats from several threads at once,
+/// as AccumAmDiagGmm is not thread-safe: a thread takes one for its exclusive
+/// use with Acquire(), accumulates into it and gives it back with Release().
+/// Once all the threads are done, Sum() adds them up.  Each accumulator is as
+/// big as the model's stats, so there should be no more of them than threads.
+class AccumAmDiagGmmPool {
+ public:
+  AccumAmDiagGmmPool(const AmDiagGmm &model, GmmFlagsType flags,
+                     int32 num_accs);
+
+  /// Returns an accumulator that no other thread is using, waiting for one to
+  /// be released if necessary.
+  AccumAmDiagGmm *Acquire();
+
+  void Release(AccumAmDiagGmm *acc);
+
+  /// Sums all the accumulators into one, using "num_threads" threads, frees
+  /// the others and returns the sum (which is owned by this object).  It
+  /// should only be called once all of them have been released.
+  AccumAmDiagGmm *Sum(int32 num_threads);
+
+  ~AccumAmDiagGmmPool();
+ private:
+  std::mutex mutex_;
+  std::condition_variable acc_released_;
+  std::vector<AccumAmDiagGmm*> accs_;
+  std::vector<AccumAmDiagGmm*> free_accs_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(AccumAmDiagGmmPool);
+};
+
 /// for computing the maximum-likelihood estimates of the parameters of
 /// an acoustic model that uses diagonal Gaussian mixture models as emission densities.
+/// If num_threads > 1, the pdfs are divided among that many threads, as they
+/// are updated independently.
 void MleAmDiagGmmUpdate(const MleDiagGmmOptions &config,
                         const AccumAmDiagGmm &amdiaggmm_acc,
                         GmmFlagsType flags,
                         AmDiagGmm *am_gmm,
                         BaseFloat *obj_change_out,
-                        BaseFloat *count_out);
+                        BaseFloat *count_out,
+                        int32 num_threads = 1);
 
 /// Maximum A Posteriori update.
 void MapAmDiagGmmUpdate(const MapDiagGmmOptions &config,
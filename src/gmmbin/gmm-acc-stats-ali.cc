@@ -23,8 +23,68 @@
 #include "gmm/am-diag-gmm.h"
 #include "hmm/transition-model.h"
 #include "gmm/mle-am-diag-gmm.h"
+#include "util/kaldi-thread.h"
+
+namespace kaldi {
+
+// This class accumulates the GMM stats for one utterance, in parallel with
+// the others.  The GMM stats go to an accumulator of the pool; the transition
+// stats and the likelihoods are added in the destructor, which the
+// TaskSequencer calls in order, one at a time.
+class GmmAccStatsAliTask {
+ public:
+  GmmAccStatsAliTask(const AmDiagGmm &am_gmm,
+                     const TransitionModel &trans_model,
+                     const std::string &utt,
+                     const Matrix<BaseFloat> &features,
+                     const std::vector<int32> &alignment,
+                     AccumAmDiagGmmPool *pool,
+                     Vector<double> *transition_accs,
+                     double *tot_like, int64 *tot_t, int32 *num_done):
+      am_gmm_(am_gmm), trans_model_(trans_model), utt_(utt),
+      features_(features), alignment_(alignment), pool_(pool),
+      tot_like_this_file_(0.0), transition_accs_(transition_accs),
+      tot_like_(tot_like), tot_t_(tot_t), num_done_(num_done) { }
+
+  void operator () () {
+    AccumAmDiagGmm *gmm_accs = pool_->Acquire();
+    for (size_t i = 0; i < alignment_.size(); i++) {
+      int32 pdf_id = trans_model_.TransitionIdToPdf(alignment_[i]);
+      tot_like_this_file_ += gmm_accs->AccumulateForGmm(
+          am_gmm_, features_.Row(i), pdf_id, 1.0);
+    }
+    pool_->Release(gmm_accs);
+  }
 
+  ~GmmAccStatsAliTask() {
+    for (size_t i = 0; i < alignment_.size(); i++)
+      trans_model_.Accumulate(1.0, alignment_[i], transition_accs_);
+    *tot_like_ += tot_like_this_file_;
+    *tot_t_ += alignment_.size();
+    (*num_done_)++;
+    if (*num_done_ % 50 == 0) {
+      KALDI_LOG << "Processed " << *num_done_ << " utterances; for utterance "
+                << utt_ << " avg. like is "
+                << (tot_like_this_file_/alignment_.size())
+                << " over " << alignment_.size() <<" frames.";
+    }
+  }
 
+ private:
+  const AmDiagGmm &am_gmm_;
+  const TransitionModel &trans_model_;
+  std::string utt_;
+  Matrix<BaseFloat> features_;  // not a reference, as the reader moves on.
+  std::vector<int32> alignment_;
+  AccumAmDiagGmmPool *pool_;
+  BaseFloat tot_like_this_file_;
+  Vector<double> *transition_accs_;
+  double *tot_like_;
+  int64 *tot_t_;
+  int32 *num_done_;
+};
+
+}  // namespace kaldi
 
 
 int main(int argc, char *argv[]) {
@@ -35,11 +95,15 @@ int main(int argc, char *argv[]) {
         "Accumulate stats for GMM training.\n"
         "Usage:  gmm-acc-stats-ali [options] <model-in> <feature-rspecifier> "
         "<alignments-rspecifier> <stats-out>\n"
-        "e.g.:\n gmm-acc-stats-ali 1.mdl scp:train.scp ark:1.ali 1.acc\n";
+        "e.g.:\n gmm-acc-stats-ali 1.mdl scp:train.scp ark:1.ali 1.acc\n"
+        "With --num-threads=N, the stats are accumulated in N copies (each as\n"
+        "big as the stats), which are summed at the end.\n";
 
     ParseOptions po(usage);
     bool binary = true;
+    TaskSequencerConfig sequencer_config;
     po.Register("binary", &binary, "Write output in binary mode");
+    sequencer_config.Register(&po);
     po.Read(argc, argv);
 
     if (po.NumArgs() != 4) {
@@ -63,8 +127,8 @@ int main(int argc, char *argv[]) {
 
     Vector<double> transition_accs;
     trans_model.InitStats(&transition_accs);
-    AccumAmDiagGmm gmm_accs;
-    gmm_accs.Init(am_gmm, kGmmAll);
+    int32 num_threads = std::max<int32>(1, sequencer_config.num_threads);
+    AccumAmDiagGmmPool pool(am_gmm, kGmmAll, num_threads);
 
     double tot_like = 0.0;
     kaldi::int64 tot_t = 0;
@@ -73,52 +137,42 @@ int main(int argc, char *argv[]) {
     RandomAccessInt32VectorReader alignments_reader(alignments_rspecifier);
 
     int32 num_done = 0, num_err = 0;
-    for (; !feature_reader.Done(); feature_reader.Next()) {
-      std::string key = feature_reader.Key();
-      if (!alignments_reader.HasKey(key)) {
-        KALDI_WARN << "No alignment for utterance " << key;
-        num_err++;
-      } else {
-        const Matrix<BaseFloat> &mat = feature_reader.Value();
-        const std::vector<int32> &alignment = alignments_reader.Value(key);
-
-        if (alignment.size() != mat.NumRows()) {
-          KALDI_WARN << "Alignments has wrong size " << (alignment.size())
-                     << " vs. " << (mat.NumRows());
+    {
+      TaskSequencer<GmmAccStatsAliTask> sequencer(sequencer_config);
+      for (; !feature_reader.Done(); feature_reader.Next()) {
+        std::string key = feature_reader.Key();
+        if (!alignments_reader.HasKey(key)) {
+          KALDI_WARN << "No alignment for utterance " << key;
           num_err++;
-          continue;
-        }
-
-        num_done++;
-        BaseFloat tot_like_this_file = 0.0;
-
-        for (size_t i = 0; i < alignment.size(); i++) {
-          int32 tid = alignment[i],  // transition identifier.
-              pdf_id = trans_model.TransitionIdToPdf(tid);
-          trans_model.Accumulate(1.0, tid, &transition_accs);
-          tot_like_this_file += gmm_accs.AccumulateForGmm(am_gmm, mat.Row(i),
-                                                          pdf_id, 1.0);
-        }
-        tot_like += tot_like_this_file;
-        tot_t += alignment.size();
-        if (num_done % 50 == 0) {
-          KALDI_LOG << "Processed " << num_done << " utterances; for utterance "
-                    << key << " avg. like is "
-                    << (tot_like_this_file/alignment.size())
-                    << " over " << alignment.size() <<" frames.";
+        } else {
+          const Matrix<BaseFloat> &mat = feature_reader.Value();
+          const std::vector<int32> &alignment = alignments_reader.Value(key);
+
+          if (alignment.size() != mat.NumRows()) {
+            KALDI_WARN << "Alignments has wrong size " << (alignment.size())
+                       << " vs. " << (mat.NumRows());
+            num_err++;
+            continue;
+          }
+
+          sequencer.Run(new GmmAccStatsAliTask(am_gmm, trans_model, key, mat,
+                                               alignment, &pool,
+                                               &transition_accs, &tot_like,
+                                               &tot_t, &num_done));
         }
       }
-    }
+    }  // the sequencer waits for the tasks to finish here.
     KALDI_LOG << "Done " << num_done << " files, " << num_err
               << " with errors.";
 
     KALDI_LOG << "Overall avg like per frame (Gaussian only) = "
               << (tot_like/tot_t) << " over " << tot_t << " frames.";
 
+    AccumAmDiagGmm *gmm_accs = pool.Sum(num_threads);
     {
       Output ko(accs_wxfilename, binary);
       transition_accs.Write(ko.Stream(), binary);
-      gmm_accs.Write(ko.Stream(), binary);
+      gmm_accs->Write(ko.Stream(), binary);
     }
     KALDI_LOG << "Written accs.";
     if (num_done != 0)
@@ -130,5 +184,3 @@ int main(int argc, char *argv[]) {
     return -1;
   }
 }
-
-
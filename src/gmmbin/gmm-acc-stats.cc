@@ -25,6 +25,81 @@
 #include "hmm/transition-model.h"
 #include "gmm/mle-am-diag-gmm.h"
 #include "hmm/posterior.h"
+#include "util/kaldi-thread.h"
+
+namespace kaldi {
+
+// This class accumulates the GMM stats for one utterance, in parallel with
+// the others.  The GMM stats go to an accumulator of the pool; the transition
+// stats and the likelihoods are added in the destructor, which the
+// TaskSequencer calls in order, one at a time.
+class GmmAccStatsTask {
+ public:
+  GmmAccStatsTask(const AmDiagGmm &am_gmm,
+                  const TransitionModel &trans_model,
+                  const std::string &utt,
+                  const Matrix<BaseFloat> &features,
+                  const Posterior &posterior,
+                  AccumAmDiagGmmPool *pool,
+                  Vector<double> *transition_accs,
+                  double *tot_like, double *tot_t, int32 *num_done):
+      am_gmm_(am_gmm), trans_model_(trans_model), utt_(utt),
+      features_(features), posterior_(posterior), pool_(pool),
+      tot_like_this_file_(0.0), tot_weight_(0.0),
+      transition_accs_(transition_accs), tot_like_(tot_like), tot_t_(tot_t),
+      num_done_(num_done) { }
+
+  void operator () () {
+    Posterior pdf_posterior;
+    ConvertPosteriorToPdfs(trans_model_, posterior_, &pdf_posterior);
+    AccumAmDiagGmm *gmm_accs = pool_->Acquire();
+    for (size_t i = 0; i < pdf_posterior.size(); i++) {
+      for (size_t j = 0; j < pdf_posterior[i].size(); j++) {
+        int32 pdf_id = pdf_posterior[i][j].first;
+        BaseFloat weight = pdf_posterior[i][j].second;
+        tot_like_this_file_ += gmm_accs->AccumulateForGmm(
+            am_gmm_, features_.Row(i), pdf_id, weight) * weight;
+        tot_weight_ += weight;
+      }
+    }
+    pool_->Release(gmm_accs);
+  }
+
+  ~GmmAccStatsTask() {
+    // Accumulates for transitions.
+    for (size_t i = 0; i < posterior_.size(); i++) {
+      for (size_t j = 0; j < posterior_[i].size(); j++) {
+        int32 tid = posterior_[i][j].first;
+        BaseFloat weight = posterior_[i][j].second;
+        trans_model_.Accumulate(weight, tid, transition_accs_);
+      }
+    }
+    (*num_done_)++;
+    if (*num_done_ % 50 == 0) {
+      KALDI_LOG << "Processed " << *num_done_ << " utterances; for utterance "
+                << utt_ << " avg. like is "
+                << (tot_like_this_file_/tot_weight_)
+                << " over " << tot_weight_ <<" frames.";
+    }
+    *tot_like_ += tot_like_this_file_;
+    *tot_t_ += tot_weight_;
+  }
+
+ private:
+  const AmDiagGmm &am_gmm_;
+  const TransitionModel &trans_model_;
+  std::string utt_;
+  Matrix<BaseFloat> features_;  // not a reference, as the reader moves on.
+  Posterior posterior_;
+  AccumAmDiagGmmPool *pool_;
+  BaseFloat tot_like_this_file_, tot_weight_;
+  Vector<double> *transition_accs_;
+  double *tot_like_;
+  double *tot_t_;
+  int32 *num_done_;
+};
+
+}  // namespace kaldi
 
 
 int main(int argc, char *argv[]) {
@@ -36,15 +111,19 @@ int main(int argc, char *argv[]) {
         "Usage:  gmm-acc-stats [options] <model-in> <feature-rspecifier>"
         "<posteriors-rspecifier> <stats-out>\n"
         "e.g.: \n"
-        " gmm-acc-stats 1.mdl scp:train.scp ark:1.post 1.acc\n";
+        " gmm-acc-stats 1.mdl scp:train.scp ark:1.post 1.acc\n"
+        "With --num-threads=N, the stats are accumulated in N copies (each as\n"
+        "big as the stats), which are summed at the end.\n";
 
     ParseOptions po(usage);
     bool binary = true;
     std::string update_flags_str = "mvwt"; // note: t is ignored, we acc
     // transition stats regardless.
+    TaskSequencerConfig sequencer_config;
     po.Register("binary", &binary, "Write output in binary mode");
     po.Register("update-flags", &update_flags_str, "Which GMM parameters will be "
                 "updated: subset of mvwt.");
+    sequencer_config.Register(&po);
     po.Read(argc, argv);
 
     if (po.NumArgs() != 4) {
@@ -69,8 +148,9 @@ int main(int argc, char *argv[]) {
 
     Vector<double> transition_accs;
     trans_model.InitStats(&transition_accs);
-    AccumAmDiagGmm gmm_accs;
-    gmm_accs.Init(am_gmm, StringToGmmFlags(update_flags_str));
+    int32 num_threads = std::max<int32>(1, sequencer_config.num_threads);
+    AccumAmDiagGmmPool pool(am_gmm, StringToGmmFlags(update_flags_str),
+                            num_threads);
 
     double tot_like = 0.0;
     double tot_t = 0.0;
@@ -79,54 +159,31 @@ int main(int argc, char *argv[]) {
     RandomAccessPosteriorReader posteriors_reader(posteriors_rspecifier);
 
     int32 num_done = 0, num_err = 0;
-    for (; !feature_reader.Done(); feature_reader.Next()) {
-      std::string key = feature_reader.Key();
-      if (!posteriors_reader.HasKey(key)) {
-        KALDI_WARN << "Could not find posteriors for utterance " << key;
-        num_err++;
-      } else {
-        const Matrix<BaseFloat> &mat = feature_reader.Value();
-        const Posterior &posterior = posteriors_reader.Value(key);
-
-        if (static_cast<int32>(posterior.size()) != mat.NumRows()) {
-          KALDI_WARN << "Posterior vector has wrong size " 
-                     << (posterior.size()) << " vs. "
-                     << (mat.NumRows());
+    {
+      TaskSequencer<GmmAccStatsTask> sequencer(sequencer_config);
+      for (; !feature_reader.Done(); feature_reader.Next()) {
+        std::string key = feature_reader.Key();
+        if (!posteriors_reader.HasKey(key)) {
+          KALDI_WARN << "Could not find posteriors for utterance " << key;
           num_err++;
-          continue;
-        }
-
-        num_done++;
-        BaseFloat tot_like_this_file = 0.0, tot_weight = 0.0;
-
-        Posterior pdf_posterior;
-        ConvertPosteriorToPdfs(trans_model, posterior, &pdf_posterior);
-        for (size_t i = 0; i < posterior.size(); i++) {
-          // Accumulates for GMM.
-          for (size_t j = 0; j < pdf_posterior[i].size(); j++) {
-            int32 pdf_id = pdf_posterior[i][j].first;
-            BaseFloat weight = pdf_posterior[i][j].second;
-            tot_like_this_file += gmm_accs.AccumulateForGmm(am_gmm, mat.Row(i), pdf_id, weight)
-                * weight;
-            tot_weight += weight;
+        } else {
+          const Matrix<BaseFloat> &mat = feature_reader.Value();
+          const Posterior &posterior = posteriors_reader.Value(key);
+
+          if (static_cast<int32>(posterior.size()) != mat.NumRows()) {
+            KALDI_WARN << "Posterior vector has wrong size "
+                       << (posterior.size()) << " vs. "
+                       << (mat.NumRows());
+            num_err++;
+            continue;
           }
 
-          // Accumulates for transitions.
-          for (size_t j = 0; j < posterior[i].size(); j++) {
-            int32 tid = posterior[i][j].first;
-            BaseFloat weight = posterior[i][j].second;
-            trans_model.Accumulate(weight, tid, &transition_accs);
-          }
+          sequencer.Run(new GmmAccStatsTask(am_gmm, trans_model, key, mat,
+                                            posterior, &pool, &transition_accs,
+                                            &tot_like, &tot_t, &num_done));
         }
-        if (num_done % 50 == 0) {
-          KALDI_LOG << "Processed " << num_done << " utterances; for utterance "
-                    << key << " avg. like is " << (tot_like_this_file/tot_weight)
-                    << " over " << tot_weight <<" frames.";
-        }
-        tot_like += tot_like_this_file;
-        tot_t += tot_weight;
       }
-    }
+    }  // the sequencer waits for the tasks to finish here.
 
     KALDI_LOG << "Done " << num_done << " files, " << num_err
               << " with errors.";
@@ -134,10 +191,11 @@ int main(int argc, char *argv[]) {
     KALDI_LOG << "Overall avg like per frame (Gaussian only) = "
               << (tot_like/tot_t) << " over " << tot_t << " frames.";
 
+    AccumAmDiagGmm *gmm_accs = pool.Sum(num_threads);
     {
       Output ko(accs_wxfilename, binary);
       transition_accs.Write(ko.Stream(), binary);
-      gmm_accs.Write(ko.Stream(), binary);
+      gmm_accs->Write(ko.Stream(), binary);
     }
     KALDI_LOG << "Written accs.";
     return (num_done != 0 ? 0 : 1);
@@ -146,5 +204,3 @@ int main(int argc, char *argv[]) {
     return -1;
   }
 }
-
-
@@ -25,6 +25,7 @@
 #include "fstext/fstext-utils.h"
 #include "decoder/decoder-wrappers.h"
 #include "decoder/training-graph-compiler.h"
+#include "decoder/lazy-training-graph.h"
 #include "gmm/decodable-am-diag-gmm.h"
 #include "lat/kaldi-lattice.h" // for {Compact}LatticeArc
 
@@ -49,11 +50,16 @@ int main(int argc, char *argv[]) {
     BaseFloat acoustic_scale = 1.0;
     std::string disambig_rxfilename;
     TrainingGraphCompilerOptions gopts;
+    bool lazy_graph = false;
 
     align_config.Register(&po);
     po.Register("acoustic-scale", &acoustic_scale, "Scaling factor for acoustic likelihoods");
     po.Register("read-disambig-syms", &disambig_rxfilename, "File containing "
                 "list of disambiguation symbols in phone symbol table");
+    po.Register("lazy-graph", &lazy_graph, "If true, don't compile the "
+                "training graphs but expand their HMMs as the decoder needs "
+                "them, which is faster for long utterances.  Not compatible "
+                "with --careful.");
 
     gopts.Register(&po);
     po.Read(argc, argv);
@@ -95,6 +101,11 @@ int main(int argc, char *argv[]) {
                              gopts);
 
     lex_fst = NULL;  // we gave ownership to gc.
+
+    // Only used if --lazy-graph=true; it's shared by all the utterances.
+    fst::LazyTrainingGraphHmms lazy_hmms(ctx_dep, trans_model,
+                                         gopts.transition_scale,
+                                         gopts.self_loop_scale);
     
     SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
     RandomAccessInt32VectorReader transcript_reader(transcript_rspecifier);
@@ -114,6 +125,31 @@ int main(int argc, char *argv[]) {
       const Matrix<BaseFloat> &features = feature_reader.Value();
       const std::vector<int32> &transcript = transcript_reader.Value(utt);
 
+      if (lazy_graph) {
+        VectorFst<StdArc> clg;
+        std::vector<std::vector<int32> > ilabel_info;
+        if (!gc.CompileContextGraph(transcript, &clg, &ilabel_info)) {
+          KALDI_WARN << "Problem creating decoding graph for utterance "
+                     << utt <<" [serious error]";
+          num_err++;
+          continue;
+        }
+        if (features.NumRows() == 0) {
+          KALDI_WARN << "Zero-length features for utterance: " << utt;
+          num_err++;
+          continue;
+        }
+        fst::LazyTrainingGraph decode_fst(clg, ilabel_info, &lazy_hmms);
+        DecodableAmDiagGmmScaled gmm_decodable(am_gmm, trans_model, features,
+                                               acoustic_scale);
+        AlignUtteranceWrapper(align_config, utt,
+                              acoustic_scale, decode_fst, &gmm_decodable,
+                              &alignment_writer, NULL,
+                              &num_done, &num_err, &num_retry,
+                              &tot_like, &frame_count);
+        continue;
+      }
+
       VectorFst<StdArc> decode_fst;
       if (!gc.CompileGraphFromText(transcript, &decode_fst)) {
         KALDI_WARN << "Problem creating decoding graph for utterance "
@@ -96,13 +96,13 @@ int main(int argc, char *argv[]) {
 
       double this_tot_loglike = 0;
       bool utt_ok = true;
-      
+      std::vector<Vector<BaseFloat> > all_loglikes;
+      gmm.LogLikelihoodsPreselect(mat, gselect, &all_loglikes);
+
       for (int32 t = 0; t < num_frames; t++) {
-        SubVector<BaseFloat> frame(mat, t);
         const std::vector<int32> &this_gselect = gselect[t];
         KALDI_ASSERT(!gselect[t].empty());
-        Vector<BaseFloat> loglikes;
-        gmm.LogLikelihoodsPreselect(frame, this_gselect, &loglikes);
+        Vector<BaseFloat> &loglikes = all_loglikes[t];
         this_tot_loglike += loglikes.ApplySoftMax();
         // now "loglikes" contains posteriors.
         if (fabs(loglikes.Sum() - 1.0) > 0.01) {
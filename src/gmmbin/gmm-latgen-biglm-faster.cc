@@ -32,8 +32,14 @@
 
 
 namespace kaldi {
+
+// The decoder, specialized for the cached difference LM so that the LM
+// look-ups are not virtual calls.
+typedef LatticeBiglmFasterDecoderTpl<
+  fst::ConcurrentCacheDeterministicOnDemandFst<fst::StdArc> > CachedLmBiglmDecoder;
+
 // Takes care of output.  Returns true on success.
-bool DecodeUtterance(LatticeBiglmFasterDecoder &decoder, // not const but is really an input.
+bool DecodeUtterance(CachedLmBiglmDecoder &decoder, // not const but is really an input.
                      DecodableInterface &decodable, // not const but is really an input.
                      const TransitionModel &trans_model,
                      const fst::SymbolTable *word_syms,
@@ -161,6 +167,7 @@ int main(int argc, char *argv[]) {
     Timer timer;
     bool allow_partial = false;
     BaseFloat acoustic_scale = 0.1;
+    int32 lm_cache_mb = 64;
     LatticeBiglmFasterDecoderConfig config;
     
     std::string word_syms_filename;
@@ -169,6 +176,8 @@ int main(int argc, char *argv[]) {
 
     po.Register("word-symbol-table", &word_syms_filename, "Symbol table for words [for debug output]");
     po.Register("allow-partial", &allow_partial, "If true, produce output even if end state was not reached.");
+    po.Register("lm-cache-mb", &lm_cache_mb, "Memory, in megabytes, for the "
+                "cache of arcs of the difference LM.");
     
     po.Read(argc, argv);
 
@@ -176,6 +185,8 @@ int main(int argc, char *argv[]) {
       po.PrintUsage();
       exit(1);
     }
+    if (lm_cache_mb < 0)
+      KALDI_ERR << "Invalid --lm-cache-mb=" << lm_cache_mb;
     
     std::string model_in_filename = po.GetArg(1),
         fst_in_str = po.GetArg(2),
@@ -206,7 +217,8 @@ int main(int argc, char *argv[]) {
     fst::BackoffDeterministicOnDemandFst<StdArc> new_lm_dfst(*new_lm_fst);
     fst::ComposeDeterministicOnDemandFst<StdArc> compose_dfst(&old_lm_dfst,
                                                               &new_lm_dfst);
-    fst::CacheDeterministicOnDemandFst<StdArc> cache_dfst(&compose_dfst);
+    fst::ConcurrentCacheDeterministicOnDemandFst<StdArc> cache_dfst(
+        &compose_dfst, static_cast<size_t>(lm_cache_mb) << 20);
 
     bool determinize = config.determinize_lattice;
     CompactLatticeWriter compact_lattice_writer;
@@ -237,7 +249,7 @@ int main(int argc, char *argv[]) {
       Fst<StdArc> *decode_fst = fst::ReadFstKaldiGeneric(fst_in_str);
 
       {
-        LatticeBiglmFasterDecoder decoder(*decode_fst, config, &cache_dfst);
+        CachedLmBiglmDecoder decoder(*decode_fst, config, &cache_dfst);
     
         for (; !feature_reader.Done(); feature_reader.Next()) {
           std::string utt = feature_reader.Key();
@@ -283,8 +295,7 @@ int main(int argc, char *argv[]) {
           num_fail++;
           continue;
         }
-        LatticeBiglmFasterDecoder decoder(fst_reader.Value(), config,
-                                          &cache_dfst);
+        CachedLmBiglmDecoder decoder(fst_reader.Value(), config, &cache_dfst);
         DecodableAmDiagGmmScaled gmm_decodable(am_gmm, trans_model, features,
                                                acoustic_scale);
         double like;
@@ -58,6 +58,7 @@ int main(int argc, char *argv[]) {
     std::string word_syms_filename;
     latgen_config.Register(&po);
     sequencer_config.Register(&po);
+    RegisterGlobalThreadPoolOptions(&po);
     po.Register("acoustic-scale", &acoustic_scale,
                 "Scaling factor for acoustic likelihoods");
     po.Register("log-sum-exp-prune", &log_sum_exp_prune,
@@ -115,7 +116,8 @@ int main(int argc, char *argv[]) {
     Fst<StdArc> *decode_fst = NULL; // only used if there is a single
                                           // decoding graph.
 
-    TaskSequencer<DecodeUtteranceLatticeFasterClass> sequencer(sequencer_config);
+    TaskSequencer<DecodeUtteranceLatticeFasterClass> sequencer(
+        sequencer_config, &GlobalThreadPool());
 
     if (ClassifyRspecifier(fst_in_str, NULL, NULL) == kNoRspecifier) {
       SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
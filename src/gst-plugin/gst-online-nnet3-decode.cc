@@ -0,0 +1,868 @@
+// gst-plugin/gst-online-nnet3-decode.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+/**
+ * GStreamer plugin for automatic speech recognition with nnet3 models,
+ * based on Kaldi's SingleUtteranceNnet3Decoder and
+ * OnlineNnet2FeaturePipeline.
+ *
+ * The audio is decoded in the streaming thread as the buffers arrive, without
+ * queueing them.  Partial and final results are posted on the bus as element
+ * messages named "kaldi-result", with the fields "text" (string), "final"
+ * (boolean) and "utterance" (int); final results are also pushed out of the
+ * src pad as text.  Elements that use the same model, graph, word symbols
+ * and feature and nnet-computation options share one copy of them.
+ *
+ * <refsect2>
+ * <title>Example launch line</title>
+ * |[
+ * gst-launch-1.0 -m filesrc location=test.wav \
+ *     ! decodebin ! audioconvert ! audioresample \
+ *     ! onlinennet3decode model=$dir/final.mdl fst=$dir/HCLG.fst \
+ *                         word-syms=$dir/words.txt \
+ *                         mfcc-config=$dir/conf/mfcc.conf \
+ *                         ivector-extraction-config=$dir/conf/ivector_extractor.conf \
+ *                         frame-subsampling-factor=3 acoustic-scale=1.0 \
+ *                         do-endpointing=true \
+ *     ! filesink location=$resultfile
+ * ]|
+ * </refsect2>
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#else
+#  define VERSION "1.0"
+#endif
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gst-plugin/gst-online-nnet3-decode.h"
+
+#include "fstext/fstext-lib.h"
+#include "lat/lattice-functions.h"
+#include "nnet3/nnet-utils.h"
+
+namespace kaldi {
+
+GST_DEBUG_CATEGORY_STATIC(gst_online_nnet3_decode_debug);
+#define GST_CAT_DEFAULT gst_online_nnet3_decode_debug
+
+enum {
+  PROP_0,
+  PROP_SILENT,
+  PROP_MODEL,
+  PROP_FST,
+  PROP_WORD_SYMS,
+  PROP_LAST
+};
+
+#define DEFAULT_MODEL           "final.mdl"
+#define DEFAULT_FST             "HCLG.fst"
+#define DEFAULT_WORD_SYMS       "words.txt"
+
+
+static GstStaticPadTemplate sink_factory =
+    GST_STATIC_PAD_TEMPLATE("sink",
+                            GST_PAD_SINK,
+                            GST_PAD_ALWAYS,
+                            GST_STATIC_CAPS(
+                                "audio/x-raw, "
+                                "format = (string) S16LE, "
+                                "channels = (int) 1, "
+                                "rate = (int) [ 8000, 48000 ] "));
+
+
+static GstStaticPadTemplate src_factory =
+    GST_STATIC_PAD_TEMPLATE("src",
+                            GST_PAD_SRC,
+                            GST_PAD_ALWAYS,
+                            GST_STATIC_CAPS("text/x-raw, format= { utf8 }"));
+
+#define gst_online_nnet3_decode_parent_class parent_class
+G_DEFINE_TYPE(GstOnlineNnet3Decode, gst_online_nnet3_decode, GST_TYPE_ELEMENT);
+
+
+// The names of the options in GstOnlineNnet3DecodeOptions::options; the
+// property with id PROP_LAST + i corresponds to option_names[i].  (The
+// property names are the same except that '.', which GObject does not allow,
+// is replaced by '-').
+static std::vector<std::string> option_names;
+
+// The models shared between element instances, indexed by
+// GstOnlineNnet3DecodeModel::key.
+static std::map<std::string, GstOnlineNnet3DecodeModel*> shared_models;
+static std::mutex shared_models_mutex;
+
+
+GstOnlineNnet3DecodeOptions::GstOnlineNnet3DecodeOptions():
+    do_endpointing(false), partial_result_period(0.25) {
+  feature_config.Register(&options);
+  decodable_opts.Register(&options);
+  decoder_opts.Register(&options);
+  endpoint_opts.Register(&options);
+  options.Register("do-endpointing", &do_endpointing, "If true, apply "
+                   "endpoint detection, and start a new utterance at each "
+                   "endpoint");
+  options.Register("partial-result-period", &partial_result_period,
+                   "Interval in seconds (of audio) at which partial results "
+                   "are posted, if they changed");
+}
+
+GstOnlineNnet3DecodeModel::~GstOnlineNnet3DecodeModel() {
+  delete decodable_info;
+  delete feature_info;
+  delete decode_fst;
+  delete word_syms;
+}
+
+
+static void
+gst_online_nnet3_decode_set_property(GObject * object, guint prop_id,
+                                     const GValue * value,
+                                     GParamSpec * pspec);
+static void
+gst_online_nnet3_decode_get_property(GObject * object, guint prop_id,
+                                     GValue * value, GParamSpec * pspec);
+static GstStateChangeReturn
+gst_online_nnet3_decode_change_state(GstElement *element,
+                                     GstStateChange transition);
+static void
+gst_online_nnet3_decode_finalize(GObject * object);
+
+static gboolean
+gst_online_nnet3_decode_sink_event(GstPad * pad, GstObject * parent,
+                                   GstEvent * event);
+
+static GstFlowReturn gst_online_nnet3_decode_chain(GstPad * pad,
+                                                   GstObject * parent,
+                                                   GstBuffer * buf);
+
+
+/* GObject vmethod implementations */
+
+/* initialize the onlinennet3decode's class */
+static void gst_online_nnet3_decode_class_init(GstOnlineNnet3DecodeClass * klass) {
+  GObjectClass *gobject_class;
+  GstElementClass *gstelement_class;
+
+  gobject_class = (GObjectClass *) klass;
+  gstelement_class = (GstElementClass *) klass;
+
+  gobject_class->set_property = gst_online_nnet3_decode_set_property;
+  gobject_class->get_property = gst_online_nnet3_decode_get_property;
+  gobject_class->finalize = gst_online_nnet3_decode_finalize;
+
+  gstelement_class->change_state = gst_online_nnet3_decode_change_state;
+
+  g_object_class_install_property(G_OBJECT_CLASS(klass),
+                                  PROP_SILENT,
+                                  g_param_spec_boolean("silent",
+                                                       "Silence the decoder",
+                                                       "Determines whether incoming audio is sent to the decoder or not",
+                                                       false,
+                                                       (GParamFlags) G_PARAM_READWRITE));
+  g_object_class_install_property(G_OBJECT_CLASS(klass),
+                                  PROP_MODEL,
+                                  g_param_spec_string("model",
+                                                      "Acoustic model",
+                                                      "Filename of the nnet3 acoustic model",
+                                                      DEFAULT_MODEL,
+                                                      (GParamFlags) G_PARAM_READWRITE));
+  g_object_class_install_property(G_OBJECT_CLASS(klass),
+                                  PROP_FST,
+                                  g_param_spec_string("fst",
+                                                      "Decoding FST",
+                                                      "Filename of the HCLG FST",
+                                                      DEFAULT_FST,
+                                                      (GParamFlags) G_PARAM_READWRITE));
+  g_object_class_install_property(G_OBJECT_CLASS(klass),
+                                  PROP_WORD_SYMS,
+                                  g_param_spec_string("word-syms",
+                                                      "Word symbols",
+                                                      "Name of word symbols file (typically words.txt)",
+                                                      DEFAULT_WORD_SYMS,
+                                                      (GParamFlags) G_PARAM_READWRITE));
+
+  // Install a property for each of the Kaldi options, with the default values
+  // taken from a temporary options object.
+  GstOnlineNnet3DecodeOptions default_opts;
+  SimpleOptions *simple_options = &(default_opts.options);
+  std::vector<std::pair<std::string, SimpleOptions::OptionInfo> >
+      option_info_list = simple_options->GetOptionInfoList();
+  option_names.clear();
+  for (size_t i = 0; i < option_info_list.size(); i++) {
+    const std::string &name = option_info_list[i].first;
+    const SimpleOptions::OptionInfo &option_info = option_info_list[i].second;
+    std::string property_name(name);
+    std::replace(property_name.begin(), property_name.end(), '.', '-');
+    const gchar *prop_name = property_name.c_str(),
+        *doc = option_info.doc.c_str();
+    GParamFlags flags = (GParamFlags) G_PARAM_READWRITE;
+    GParamSpec *pspec = NULL;
+    bool tmp_bool;
+    int32 tmp_int;
+    uint32 tmp_uint;
+    float tmp_float;
+    double tmp_double;
+    std::string tmp_string;
+    switch (option_info.type) {
+      case SimpleOptions::kBool:
+        simple_options->GetOption(name, &tmp_bool);
+        pspec = g_param_spec_boolean(prop_name, doc, doc, tmp_bool, flags);
+        break;
+      case SimpleOptions::kInt32:
+        simple_options->GetOption(name, &tmp_int);
+        pspec = g_param_spec_int(prop_name, doc, doc, G_MININT, G_MAXINT,
+                                 tmp_int, flags);
+        break;
+      case SimpleOptions::kUint32:
+        simple_options->GetOption(name, &tmp_uint);
+        pspec = g_param_spec_uint(prop_name, doc, doc, 0, G_MAXUINT,
+                                  tmp_uint, flags);
+        break;
+      case SimpleOptions::kFloat:
+        simple_options->GetOption(name, &tmp_float);
+        pspec = g_param_spec_float(prop_name, doc, doc, -G_MAXFLOAT,
+                                   G_MAXFLOAT, tmp_float, flags);
+        break;
+      case SimpleOptions::kDouble:
+        simple_options->GetOption(name, &tmp_double);
+        pspec = g_param_spec_double(prop_name, doc, doc, -G_MAXDOUBLE,
+                                    G_MAXDOUBLE, tmp_double, flags);
+        break;
+      case SimpleOptions::kString:
+        simple_options->GetOption(name, &tmp_string);
+        pspec = g_param_spec_string(prop_name, doc, doc, tmp_string.c_str(),
+                                    flags);
+        break;
+    }
+    g_object_class_install_property(G_OBJECT_CLASS(klass),
+                                    PROP_LAST + option_names.size(), pspec);
+    option_names.push_back(name);
+  }
+
+  gst_element_class_set_details_simple(gstelement_class,
+                                       "OnlineNnet3Decode",
+                                       "Speech/Audio",
+                                       "Convert speech to text with nnet3 models",
+                                       "Kaldi contributors");
+
+  gst_element_class_add_pad_template(gstelement_class,
+                                     gst_static_pad_template_get(&src_factory));
+  gst_element_class_add_pad_template(gstelement_class,
+                                     gst_static_pad_template_get(&sink_factory));
+}
+
+
+/* initialize the new element
+ * instantiate pads and add them to element
+ * set pad calback functions
+ * initialize instance structure
+ */
+static void
+gst_online_nnet3_decode_init(GstOnlineNnet3Decode * filter) {
+  filter->silent_ = false;
+  filter->model_rspecifier_ = g_strdup(DEFAULT_MODEL);
+  filter->fst_rspecifier_ = g_strdup(DEFAULT_FST);
+  filter->word_syms_filename_ = g_strdup(DEFAULT_WORD_SYMS);
+  filter->opts_ = new GstOnlineNnet3DecodeOptions();
+  filter->model_ = NULL;
+  filter->adaptation_state_ = NULL;
+  filter->feature_pipeline_ = NULL;
+  filter->decoder_ = NULL;
+  filter->wave_ = new Vector<BaseFloat>();
+  filter->sample_rate_ = 0;
+  filter->num_utterances_ = 0;
+  filter->last_partial_frame_ = 0;
+  filter->last_partial_result_ = new std::string();
+
+  filter->sinkpad_ = gst_pad_new_from_static_template(&sink_factory, "sink");
+  gst_pad_set_event_function(filter->sinkpad_,
+                             GST_DEBUG_FUNCPTR(gst_online_nnet3_decode_sink_event));
+  gst_pad_set_chain_function(filter->sinkpad_,
+                             GST_DEBUG_FUNCPTR(gst_online_nnet3_decode_chain));
+  gst_element_add_pad(GST_ELEMENT(filter), filter->sinkpad_);
+
+  filter->srcpad_ = gst_pad_new_from_static_template(&src_factory, "src");
+  gst_pad_use_fixed_caps(filter->srcpad_);
+  gst_element_add_pad(GST_ELEMENT(filter), filter->srcpad_);
+}
+
+
+// Returns a string that identifies the model files and the options that the
+// shared model depends on, i.e. the feature and nnet-computation options.
+static std::string
+gst_online_nnet3_decode_model_key(GstOnlineNnet3Decode * filter) {
+  GstOnlineNnet3DecodeOptions *opts = filter->opts_;
+  SimpleOptions key_options;
+  opts->feature_config.Register(&key_options);
+  opts->decodable_opts.Register(&key_options);
+  std::vector<std::pair<std::string, SimpleOptions::OptionInfo> >
+      option_info_list = key_options.GetOptionInfoList();
+  std::ostringstream os;
+  os << filter->model_rspecifier_ << '\n' << filter->fst_rspecifier_ << '\n'
+     << filter->word_syms_filename_;
+  for (size_t i = 0; i < option_info_list.size(); i++) {
+    const std::string &name = option_info_list[i].first;
+    os << '\n' << name << '=';
+    bool tmp_bool;
+    int32 tmp_int;
+    uint32 tmp_uint;
+    float tmp_float;
+    double tmp_double;
+    std::string tmp_string;
+    switch (option_info_list[i].second.type) {
+      case SimpleOptions::kBool:
+        key_options.GetOption(name, &tmp_bool);
+        os << tmp_bool;
+        break;
+      case SimpleOptions::kInt32:
+        key_options.GetOption(name, &tmp_int);
+        os << tmp_int;
+        break;
+      case SimpleOptions::kUint32:
+        key_options.GetOption(name, &tmp_uint);
+        os << tmp_uint;
+        break;
+      case SimpleOptions::kFloat:
+        key_options.GetOption(name, &tmp_float);
+        os << tmp_float;
+        break;
+      case SimpleOptions::kDouble:
+        key_options.GetOption(name, &tmp_double);
+        os << tmp_double;
+        break;
+      case SimpleOptions::kString:
+        key_options.GetOption(name, &tmp_string);
+        os << tmp_string;
+        break;
+    }
+  }
+  return os.str();
+}
+
+
+static GstOnlineNnet3DecodeModel*
+gst_online_nnet3_decode_load_model(GstOnlineNnet3Decode * filter) {
+  GstOnlineNnet3DecodeModel *model = new GstOnlineNnet3DecodeModel();
+  try {
+    model->feature_info =
+        new OnlineNnet2FeaturePipelineInfo(filter->opts_->feature_config);
+    {
+      bool binary;
+      Input ki(filter->model_rspecifier_, &binary);
+      model->trans_model.Read(ki.Stream(), binary);
+      model->am_nnet.Read(ki.Stream(), binary);
+    }
+    nnet3::Nnet &nnet = model->am_nnet.GetNnet();
+    nnet3::SetBatchnormTestMode(true, &nnet);
+    nnet3::SetDropoutTestMode(true, &nnet);
+    nnet3::CollapseModel(nnet3::CollapseModelConfig(), &nnet);
+    model->decodable_opts = filter->opts_->decodable_opts;
+    model->decodable_info = new nnet3::DecodableNnetSimpleLoopedInfo(
+        model->decodable_opts, &(model->am_nnet));
+    model->decode_fst = fst::ReadFstKaldiGeneric(filter->fst_rspecifier_);
+  } catch (const std::exception &e) {
+    GST_ERROR_OBJECT(filter, "Error loading the model: %s", e.what());
+    delete model;
+    return NULL;
+  }
+  if (!(model->word_syms =
+        fst::SymbolTable::ReadText(filter->word_syms_filename_))) {
+    GST_ERROR_OBJECT(filter, "Could not read symbol table from file %s",
+                     filter->word_syms_filename_);
+    delete model;
+    return NULL;
+  }
+  return model;
+}
+
+
+// Gets the shared model for this element's files and options, loading it if
+// no other element has.
+static bool
+gst_online_nnet3_decode_allocate(GstOnlineNnet3Decode * filter) {
+  if (filter->model_)
+    return true;
+  std::string key = gst_online_nnet3_decode_model_key(filter);
+  std::lock_guard<std::mutex> lock(shared_models_mutex);
+  std::map<std::string, GstOnlineNnet3DecodeModel*>::iterator iter =
+      shared_models.find(key);
+  if (iter != shared_models.end()) {
+    GST_INFO_OBJECT(filter, "Sharing an already loaded Kaldi model");
+    filter->model_ = iter->second;
+  } else {
+    GST_INFO_OBJECT(filter, "Loading Kaldi model");
+    filter->model_ = gst_online_nnet3_decode_load_model(filter);
+    if (!filter->model_)
+      return false;
+    filter->model_->key = key;
+    shared_models[key] = filter->model_;
+    GST_INFO_OBJECT(filter, "Finished loading Kaldi model");
+  }
+  filter->model_->refcount++;
+  return true;
+}
+
+
+static void
+gst_online_nnet3_decode_release(GstOnlineNnet3Decode * filter) {
+  if (!filter->model_)
+    return;
+  std::lock_guard<std::mutex> lock(shared_models_mutex);
+  if (--(filter->model_->refcount) == 0) {
+    shared_models.erase(filter->model_->key);
+    delete filter->model_;
+  }
+  filter->model_ = NULL;
+}
+
+
+// Deletes the decoder and feature pipeline of the current utterance, if any.
+static void
+gst_online_nnet3_decode_reset(GstOnlineNnet3Decode * filter) {
+  delete filter->decoder_;
+  filter->decoder_ = NULL;
+  delete filter->feature_pipeline_;
+  filter->feature_pipeline_ = NULL;
+}
+
+
+static void
+gst_online_nnet3_decode_finalize(GObject * object) {
+  GstOnlineNnet3Decode *filter = GST_ONLINENNET3DECODE(object);
+
+  gst_online_nnet3_decode_reset(filter);
+  gst_online_nnet3_decode_release(filter);
+  g_free(filter->model_rspecifier_);
+  g_free(filter->fst_rspecifier_);
+  g_free(filter->word_syms_filename_);
+  delete filter->adaptation_state_;
+  delete filter->opts_;
+  delete filter->wave_;
+  delete filter->last_partial_result_;
+
+  G_OBJECT_CLASS(parent_class)->finalize(object);
+}
+
+
+static void
+gst_online_nnet3_decode_set_property(GObject * object, guint prop_id,
+                                     const GValue * value, GParamSpec * pspec) {
+  GstOnlineNnet3Decode *filter = GST_ONLINENNET3DECODE(object);
+
+  if (prop_id == PROP_SILENT) {
+    filter->silent_ = g_value_get_boolean(value);
+    return;
+  }
+  // All other props cannot be changed after initialization
+  if (filter->model_) {
+    GST_WARNING_OBJECT(filter, "Decoder already initialized, cannot change its properties");
+    return;
+  }
+  switch (prop_id) {
+    case PROP_MODEL:
+      g_free(filter->model_rspecifier_);
+      filter->model_rspecifier_ = g_value_dup_string(value);
+      break;
+    case PROP_FST:
+      g_free(filter->fst_rspecifier_);
+      filter->fst_rspecifier_ = g_value_dup_string(value);
+      break;
+    case PROP_WORD_SYMS:
+      g_free(filter->word_syms_filename_);
+      filter->word_syms_filename_ = g_value_dup_string(value);
+      break;
+    default:
+      if (prop_id >= PROP_LAST && prop_id < PROP_LAST + option_names.size()) {
+        const std::string &name = option_names[prop_id - PROP_LAST];
+        SimpleOptions *simple_options = &(filter->opts_->options);
+        SimpleOptions::OptionType option_type;
+        if (simple_options->GetOptionType(name, &option_type)) {
+          switch (option_type) {
+            case SimpleOptions::kBool:
+              simple_options->SetOption(
+                  name, static_cast<bool>(g_value_get_boolean(value)));
+              break;
+            case SimpleOptions::kInt32:
+              simple_options->SetOption(name, g_value_get_int(value));
+              break;
+            case SimpleOptions::kUint32:
+              simple_options->SetOption(name, g_value_get_uint(value));
+              break;
+            case SimpleOptions::kFloat:
+              simple_options->SetOption(name, g_value_get_float(value));
+              break;
+            case SimpleOptions::kDouble:
+              simple_options->SetOption(name, g_value_get_double(value));
+              break;
+            case SimpleOptions::kString:
+              simple_options->SetOption(name, g_value_get_string(value));
+              break;
+          }
+          break;
+        }
+      }
+      G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_online_nnet3_decode_get_property(GObject * object, guint prop_id,
+                                     GValue * value, GParamSpec * pspec) {
+  bool tmp_bool;
+  int32 tmp_int;
+  uint32 tmp_uint;
+  float tmp_float;
+  double tmp_double;
+  std::string tmp_string;
+
+  GstOnlineNnet3Decode *filter = GST_ONLINENNET3DECODE(object);
+
+  switch (prop_id) {
+    case PROP_SILENT:
+      g_value_set_boolean(value, filter->silent_);
+      break;
+    case PROP_MODEL:
+      g_value_set_string(value, filter->model_rspecifier_);
+      break;
+    case PROP_FST:
+      g_value_set_string(value, filter->fst_rspecifier_);
+      break;
+    case PROP_WORD_SYMS:
+      g_value_set_string(value, filter->word_syms_filename_);
+      break;
+    default:
+      if (prop_id >= PROP_LAST && prop_id < PROP_LAST + option_names.size()) {
+        const std::string &name = option_names[prop_id - PROP_LAST];
+        SimpleOptions *simple_options = &(filter->opts_->options);
+        SimpleOptions::OptionType option_type;
+        if (simple_options->GetOptionType(name, &option_type)) {
+          switch (option_type) {
+            case SimpleOptions::kBool:
+              simple_options->GetOption(name, &tmp_bool);
+              g_value_set_boolean(value, tmp_bool);
+              break;
+            case SimpleOptions::kInt32:
+              simple_options->GetOption(name, &tmp_int);
+              g_value_set_int(value, tmp_int);
+              break;
+            case SimpleOptions::kUint32:
+              simple_options->GetOption(name, &tmp_uint);
+              g_value_set_uint(value, tmp_uint);
+              break;
+            case SimpleOptions::kFloat:
+              simple_options->GetOption(name, &tmp_float);
+              g_value_set_float(value, tmp_float);
+              break;
+            case SimpleOptions::kDouble:
+              simple_options->GetOption(name, &tmp_double);
+              g_value_set_double(value, tmp_double);
+              break;
+            case SimpleOptions::kString:
+              simple_options->GetOption(name, &tmp_string);
+              g_value_set_string(value, tmp_string.c_str());
+              break;
+          }
+          break;
+        }
+      }
+      G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+      break;
+  }
+}
+
+
+static GstStateChangeReturn
+gst_online_nnet3_decode_change_state(GstElement *element, GstStateChange transition) {
+  GstStateChangeReturn ret = GST_STATE_CHANGE_SUCCESS;
+  GstOnlineNnet3Decode *filter = GST_ONLINENNET3DECODE(element);
+
+  switch (transition) {
+    case GST_STATE_CHANGE_NULL_TO_READY:
+      if (!gst_online_nnet3_decode_allocate(filter))
+        return GST_STATE_CHANGE_FAILURE;
+      break;
+    default:
+      break;
+  }
+
+  ret = GST_ELEMENT_CLASS(parent_class)->change_state(element, transition);
+  if (ret == GST_STATE_CHANGE_FAILURE)
+    return ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      // Discard any unfinished utterance; the streaming thread has stopped.
+      gst_online_nnet3_decode_reset(filter);
+      break;
+    case GST_STATE_CHANGE_READY_TO_NULL:
+      // The model stays loaded while other elements use it.
+      gst_online_nnet3_decode_release(filter);
+      break;
+    default:
+      break;
+  }
+
+  return ret;
+}
+
+
+// Returns the words of the best path of the current utterance.
+static std::string
+gst_online_nnet3_decode_get_result(GstOnlineNnet3Decode * filter,
+                                   bool end_of_utterance) {
+  if (filter->decoder_->NumFramesDecoded() == 0)
+    return "";
+  Lattice best_path;
+  filter->decoder_->GetBestPath(end_of_utterance, &best_path);
+  std::vector<int32> alignment, words;
+  LatticeWeight weight;
+  fst::GetLinearSymbolSequence(best_path, &alignment, &words, &weight);
+  std::ostringstream os;
+  for (size_t i = 0; i < words.size(); i++) {
+    std::string word = filter->model_->word_syms->Find(words[i]);
+    if (word == "")
+      GST_ERROR_OBJECT(filter, "Word-id %d not in symbol table!", words[i]);
+    if (i > 0)
+      os << ' ';
+    os << word;
+  }
+  return os.str();
+}
+
+
+/*
+ * Post a result on the bus as a "kaldi-result" element message and, if it is
+ * final, push it out of the src pad.
+ */
+static void
+gst_online_nnet3_decode_post_result(GstOnlineNnet3Decode * filter,
+                                    const std::string &text, bool final) {
+  GST_DEBUG_OBJECT(filter, "%s result: %s", final ? "Final" : "Partial",
+                   text.c_str());
+  GstStructure *structure =
+      gst_structure_new("kaldi-result",
+                        "text", G_TYPE_STRING, text.c_str(),
+                        "final", G_TYPE_BOOLEAN, (gboolean) final,
+                        "utterance", G_TYPE_INT, filter->num_utterances_,
+                        NULL);
+  gst_element_post_message(GST_ELEMENT(filter),
+                           gst_message_new_element(GST_OBJECT(filter),
+                                                   structure));
+  if (final) {
+    std::string line = text + "\n";
+    GstBuffer *buffer = gst_buffer_new_and_alloc(line.size());
+    gst_buffer_fill(buffer, 0, line.c_str(), line.size());
+    gst_pad_push(filter->srcpad_, buffer);
+  }
+}
+
+
+static void
+gst_online_nnet3_decode_start_utterance(GstOnlineNnet3Decode * filter) {
+  GstOnlineNnet3DecodeModel *model = filter->model_;
+  if (!filter->adaptation_state_)
+    filter->adaptation_state_ = new OnlineIvectorExtractorAdaptationState(
+        model->feature_info->ivector_extractor_info);
+  filter->feature_pipeline_ =
+      new OnlineNnet2FeaturePipeline(*(model->feature_info));
+  filter->feature_pipeline_->SetAdaptationState(*(filter->adaptation_state_));
+  filter->decoder_ = new SingleUtteranceNnet3Decoder(
+      filter->opts_->decoder_opts, model->trans_model,
+      *(model->decodable_info), *(model->decode_fst),
+      filter->feature_pipeline_);
+  filter->last_partial_frame_ = 0;
+  filter->last_partial_result_->clear();
+}
+
+
+// Finishes the current utterance: posts the final result and keeps the
+// speaker-adaptation state for the next utterance.
+static void
+gst_online_nnet3_decode_finish_utterance(GstOnlineNnet3Decode * filter) {
+  filter->decoder_->FinalizeDecoding();
+  std::string text = gst_online_nnet3_decode_get_result(filter, true);
+  gst_online_nnet3_decode_post_result(filter, text, true);
+  filter->feature_pipeline_->GetAdaptationState(filter->adaptation_state_);
+  gst_online_nnet3_decode_reset(filter);
+  filter->num_utterances_++;
+}
+
+
+/* this function handles sink events */
+static gboolean
+gst_online_nnet3_decode_sink_event(GstPad * pad, GstObject * parent, GstEvent * event) {
+  GstOnlineNnet3Decode *filter = GST_ONLINENNET3DECODE(parent);
+  GST_DEBUG_OBJECT(filter, "Handling %s event", GST_EVENT_TYPE_NAME(event));
+
+  switch (GST_EVENT_TYPE(event)) {
+    case GST_EVENT_CAPS:
+    {
+      GstCaps *caps;
+      gst_event_parse_caps(event, &caps);
+      GstStructure *structure = gst_caps_get_structure(caps, 0);
+      gst_structure_get_int(structure, "rate", &filter->sample_rate_);
+      gst_event_unref(event);
+      GstCaps *src_caps = gst_caps_new_simple("text/x-raw",
+                                              "format", G_TYPE_STRING, "utf8",
+                                              NULL);
+      gboolean ret = gst_pad_push_event(filter->srcpad_,
+                                        gst_event_new_caps(src_caps));
+      gst_caps_unref(src_caps);
+      return ret;
+    }
+    case GST_EVENT_EOS:
+    {
+      GST_DEBUG_OBJECT(filter, "EOS received");
+      if (filter->decoder_) {
+        try {
+          filter->feature_pipeline_->InputFinished();
+          filter->decoder_->AdvanceDecoding();
+          gst_online_nnet3_decode_finish_utterance(filter);
+        } catch (const std::exception &e) {
+          GST_ELEMENT_ERROR(filter, STREAM, DECODE, (NULL),
+                            ("Decoding failed: %s", e.what()));
+          gst_online_nnet3_decode_reset(filter);
+        }
+      }
+      return gst_pad_event_default(pad, parent, event);
+    }
+    default:
+      return gst_pad_event_default(pad, parent, event);
+  }
+}
+
+/* chain function
+ * this function does the actual processing
+ */
+static GstFlowReturn gst_online_nnet3_decode_chain(GstPad * pad,
+                                                   GstObject * parent,
+                                                   GstBuffer * buf) {
+  GstOnlineNnet3Decode *filter = GST_ONLINENNET3DECODE(parent);
+
+  if (G_UNLIKELY(!filter->model_)) {
+    GST_ELEMENT_ERROR(filter, CORE, NEGOTIATION, (NULL),
+                      ("decoder wasn't allocated before chain function"));
+    gst_buffer_unref(buf);
+    return GST_FLOW_NOT_NEGOTIATED;
+  }
+  if (filter->silent_) {
+    gst_buffer_unref(buf);
+    return GST_FLOW_OK;
+  }
+
+  // We read the samples straight from the buffer's memory; the only pass
+  // over them is the conversion to BaseFloat, into a scratch vector that is
+  // reused from buffer to buffer.
+  GstMapInfo map;
+  if (!gst_buffer_map(buf, &map, GST_MAP_READ)) {
+    GST_ELEMENT_ERROR(filter, STREAM, FAILED, (NULL),
+                      ("could not map the input buffer"));
+    gst_buffer_unref(buf);
+    return GST_FLOW_ERROR;
+  }
+  int32 num_samples = map.size / sizeof(int16);
+  if (filter->wave_->Dim() < num_samples)
+    filter->wave_->Resize(num_samples, kUndefined);
+  SubVector<BaseFloat> wave(*(filter->wave_), 0, num_samples);
+  const int16 *samples = reinterpret_cast<const int16*>(map.data);
+  BaseFloat *wave_data = wave.Data();
+  for (int32 i = 0; i < num_samples; i++)
+    wave_data[i] = samples[i];
+  gst_buffer_unmap(buf, &map);
+  gst_buffer_unref(buf);
+
+  try {
+    if (!filter->decoder_)
+      gst_online_nnet3_decode_start_utterance(filter);
+    filter->feature_pipeline_->AcceptWaveform(filter->sample_rate_, wave);
+    filter->decoder_->AdvanceDecoding();
+
+    const GstOnlineNnet3DecodeOptions &opts = *(filter->opts_);
+    if (opts.do_endpointing &&
+        filter->decoder_->EndpointDetected(opts.endpoint_opts)) {
+      gst_online_nnet3_decode_finish_utterance(filter);
+      return GST_FLOW_OK;
+    }
+    BaseFloat frame_shift = filter->feature_pipeline_->FrameShiftInSeconds() *
+        opts.decodable_opts.frame_subsampling_factor;
+    int32 num_frames_decoded = filter->decoder_->NumFramesDecoded();
+    if ((num_frames_decoded - filter->last_partial_frame_) * frame_shift >=
+        opts.partial_result_period) {
+      filter->last_partial_frame_ = num_frames_decoded;
+      std::string text = gst_online_nnet3_decode_get_result(filter, false);
+      if (text != *(filter->last_partial_result_)) {
+        *(filter->last_partial_result_) = text;
+        gst_online_nnet3_decode_post_result(filter, text, false);
+      }
+    }
+  } catch (const std::exception &e) {
+    GST_ELEMENT_ERROR(filter, STREAM, DECODE, (NULL),
+                      ("Decoding failed: %s", e.what()));
+    gst_online_nnet3_decode_reset(filter);
+    return GST_FLOW_ERROR;
+  }
+  return GST_FLOW_OK;
+}
+
+
+/* entry point to initialize the plug-in
+ * initialize the plug-in itself
+ * register the element factories and other features
+ */
+static gboolean
+onlinennet3decode_init(GstPlugin * onlinennet3decode) {
+  /* debug category for fltering log messages
+   */
+  GST_DEBUG_CATEGORY_INIT(gst_online_nnet3_decode_debug, "onlinennet3decode",
+                          0, "Automatic Speech Recognition with nnet3 models");
+
+  return gst_element_register(onlinennet3decode, "onlinennet3decode", GST_RANK_NONE,
+                              GST_TYPE_ONLINENNET3DECODE);
+}
+
+/* PACKAGE: this is usually set by autotools depending on some _INIT macro
+ * in configure.ac and then written into and defined in config.h, but we can
+ * just set it ourselves here in case someone doesn't use autotools to
+ * compile this code. GST_PLUGIN_DEFINE needs PACKAGE to be defined.
+ */
+#ifndef PACKAGE
+#define PACKAGE "onlinennet3decode"
+#endif
+
+GST_PLUGIN_DEFINE(
+    GST_VERSION_MAJOR,
+    GST_VERSION_MINOR,
+    onlinennet3decode,
+    "Online nnet3 speech recognizer based on the Kaldi toolkit",
+    onlinennet3decode_init,
+    VERSION,
+    "LGPL",  // Changing it into Apache prevents the plugin from loading, see gst/gstplugin.c in GStreamer source
+    "Kaldi",
+    "http://kaldi-asr.org/"
+)
+}
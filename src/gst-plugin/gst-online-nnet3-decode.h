@@ -0,0 +1,130 @@
+// gst-plugin/gst-online-nnet3-decode.h
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_GST_PLUGIN_GST_ONLINE_NNET3_DECODE_H_
+#define KALDI_GST_PLUGIN_GST_ONLINE_NNET3_DECODE_H_
+
+#include <string>
+#include <gst/gst.h>
+
+#include "online2/online-nnet2-feature-pipeline.h"
+#include "online2/online-nnet3-decoding.h"
+#include "online2/online-endpoint.h"
+#include "nnet3/decodable-simple-looped.h"
+#include "util/simple-options.h"
+
+namespace kaldi {
+
+// The options of one element instance, other than the filenames.  They are
+// all registered with 'options', through which they are exposed as GObject
+// properties.
+struct GstOnlineNnet3DecodeOptions {
+  OnlineNnet2FeaturePipelineConfig feature_config;
+  nnet3::NnetSimpleLoopedComputationOptions decodable_opts;
+  LatticeFasterDecoderConfig decoder_opts;
+  OnlineEndpointConfig endpoint_opts;
+  bool do_endpointing;
+  BaseFloat partial_result_period;
+  SimpleOptions options;
+
+  GstOnlineNnet3DecodeOptions();
+ private:
+  KALDI_DISALLOW_COPY_AND_ASSIGN(GstOnlineNnet3DecodeOptions);
+};
+
+// The model, graph, word symbols and the things precomputed from them, which
+// are shared by all element instances that use the same files and the same
+// feature and nnet-computation options.  See gst_online_nnet3_decode_allocate().
+struct GstOnlineNnet3DecodeModel {
+  std::string key;
+  int32 refcount;
+  TransitionModel trans_model;
+  nnet3::AmNnetSimple am_nnet;
+  // decodable_info keeps a reference to decodable_opts.
+  nnet3::NnetSimpleLoopedComputationOptions decodable_opts;
+  nnet3::DecodableNnetSimpleLoopedInfo *decodable_info;
+  OnlineNnet2FeaturePipelineInfo *feature_info;
+  fst::Fst<fst::StdArc> *decode_fst;
+  fst::SymbolTable *word_syms;
+
+  GstOnlineNnet3DecodeModel(): refcount(0), decodable_info(NULL),
+                               feature_info(NULL), decode_fst(NULL),
+                               word_syms(NULL) { }
+  ~GstOnlineNnet3DecodeModel();
+ private:
+  KALDI_DISALLOW_COPY_AND_ASSIGN(GstOnlineNnet3DecodeModel);
+};
+
+G_BEGIN_DECLS
+
+/* #defines don't like whitespacey bits */
+#define GST_TYPE_ONLINENNET3DECODE \
+    (gst_online_nnet3_decode_get_type())
+#define GST_ONLINENNET3DECODE(obj) \
+    (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_ONLINENNET3DECODE,GstOnlineNnet3Decode))
+#define GST_ONLINENNET3DECODE_CLASS(klass) \
+    (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_ONLINENNET3DECODE,GstOnlineNnet3DecodeClass))
+#define GST_IS_ONLINENNET3DECODE(obj) \
+    (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_ONLINENNET3DECODE))
+#define GST_IS_ONLINENNET3DECODE_CLASS(klass) \
+    (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_ONLINENNET3DECODE))
+
+typedef struct _GstOnlineNnet3Decode      GstOnlineNnet3Decode;
+typedef struct _GstOnlineNnet3DecodeClass GstOnlineNnet3DecodeClass;
+
+struct _GstOnlineNnet3Decode {
+  GstElement element;
+
+  GstPad *sinkpad_, *srcpad_;
+
+  bool silent_;
+
+  gchar* model_rspecifier_;
+  gchar* fst_rspecifier_;
+  gchar* word_syms_filename_;
+
+  GstOnlineNnet3DecodeOptions *opts_;
+
+  // Shared with other instances; NULL until the element goes to READY.
+  GstOnlineNnet3DecodeModel *model_;
+
+  // The state of the current utterance; NULL between utterances.
+  OnlineIvectorExtractorAdaptationState *adaptation_state_;
+  OnlineNnet2FeaturePipeline *feature_pipeline_;
+  SingleUtteranceNnet3Decoder *decoder_;
+
+  // Scratch space the samples of each buffer are converted into; it only
+  // grows, so there is no allocation per buffer.
+  Vector<BaseFloat> *wave_;
+  gint sample_rate_;
+
+  int32 num_utterances_;
+  int32 last_partial_frame_;
+  std::string *last_partial_result_;
+};
+
+struct _GstOnlineNnet3DecodeClass {
+  GstElementClass parent_class;
+};
+
+GType gst_online_nnet3_decode_get_type(void);
+
+G_END_DECLS
+}
+#endif  // KALDI_GST_PLUGIN_GST_ONLINE_NNET3_DECODE_H_
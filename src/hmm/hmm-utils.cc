@@ -501,10 +501,10 @@ static void AddSelfLoopsReorder(const TransitionModel &trans_model,
        !siter.Done();
        siter.Next()) {
     StateId s = siter.Value();
-    for (MutableArcIterator<VectorFst<Arc> > aiter(fst, s);
+    for (ArcIterator<VectorFst<Arc> > aiter(*fst, s);
          !aiter.Done();
          aiter.Next()) {
-      Arc arc = aiter.Value();
+      const Arc &arc = aiter.Value();
       int32 trans_state = f(arc.ilabel);
       if (state_in[arc.nextstate] == kNoTransState)
         state_in[arc.nextstate] = trans_state;
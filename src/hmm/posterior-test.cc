@@ -81,6 +81,70 @@ void TestPosteriorIo() {
     }
   }
 }
+
+void TestCompactPosterior() {
+  int32 post_size = RandInt(0, 10), dim = 20;
+  Posterior post(post_size);
+  for (int32 i = 0; i < post.size(); i++) {
+    int32 s = RandInt(0, 3);
+    for (int32 j = 0; j < s; j++)
+      post[i].push_back(std::pair<int32,BaseFloat>(
+          RandInt(0, dim - 1), RandUniform()));
+  }
+  CompactPosterior cpost(post);
+  KALDI_ASSERT(cpost.NumFrames() == post_size);
+  Posterior post2;
+  cpost.CopyToPosterior(&post2);
+  KALDI_ASSERT(post == post2);
+  KALDI_ASSERT(fabs(TotalPosterior(cpost) - TotalPosterior(post)) < 0.01);
+
+  // The on-disk format is the same as that of Posterior, in both directions.
+  bool binary = true;
+  std::ostringstream os, os2;
+  cpost.Write(os, binary);
+  WritePosterior(os2, binary, post);
+  KALDI_ASSERT(os.str() == os2.str());
+  CompactPosterior cpost2;
+  std::istringstream is(os2.str());
+  cpost2.Read(is, binary);
+  KALDI_ASSERT(cpost == cpost2);
+
+  binary = false;
+  std::ostringstream os3;
+  cpost.Write(os3, binary);
+  std::istringstream is2(os3.str());
+  ReadPosterior(is2, binary, &post2);
+  KALDI_ASSERT(post2.size() == post.size());
+
+  SparseMatrix<BaseFloat> smat(dim, post), smat2;
+  CompactPosteriorToSparseMatrix(cpost, dim, 0, post_size, NULL, &smat2);
+  KALDI_ASSERT(smat.NumRows() == smat2.NumRows());
+  for (int32 i = 0; i < smat.NumRows(); i++) {
+    KALDI_ASSERT(smat.Row(i).NumElements() == smat2.Row(i).NumElements());
+    for (int32 j = 0; j < smat.Row(i).NumElements(); j++)
+      KALDI_ASSERT(smat.Row(i).GetElement(j) == smat2.Row(i).GetElement(j));
+  }
+
+  // A range running past the end, with weights.
+  int32 first_frame = RandInt(0, post_size), num_frames = RandInt(0, 5);
+  std::vector<BaseFloat> weights(num_frames);
+  for (int32 i = 0; i < num_frames; i++)
+    weights[i] = RandInt(0, 2) * 0.5;
+  CompactPosteriorToSparseMatrix(cpost, dim, first_frame, num_frames,
+                                 &weights, &smat2);
+  KALDI_ASSERT(smat2.NumRows() == num_frames);
+  for (int32 i = 0; i < num_frames; i++) {
+    int32 t = first_frame + i;
+    BaseFloat expected = 0.0;
+    if (t < post_size)
+      for (size_t j = 0; j < post[t].size(); j++)
+        expected += post[t][j].second * weights[i];
+    KALDI_ASSERT(fabs(smat2.Row(i).Sum() - expected) < 0.01);
+  }
+
+  ScalePosterior(0.0, &cpost);
+  KALDI_ASSERT(cpost.NumFrames() == post_size && cpost.NumEntries() == 0);
+}
 }
 
 int main() {
@@ -88,6 +152,7 @@ int main() {
   for (int i = 0; i < 10; i++) {
     kaldi::TestVectorToPosteriorEntry();
     kaldi::TestPosteriorIo();
+    kaldi::TestCompactPosterior();
   }
   std::cout << "Test OK.\n";
 }
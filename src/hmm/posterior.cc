@@ -20,6 +20,7 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <vector>
 #include "hmm/posterior.h"
 #include "util/kaldi-table.h"
@@ -123,6 +124,138 @@ void ReadPosterior(std::istream &is, bool binary, Posterior *post) {
 }
 
 
+void CompactPosterior::CopyFromPosterior(const Posterior &post) {
+  size_t num_entries = 0;
+  for (size_t t = 0; t < post.size(); t++)
+    num_entries += post[t].size();
+  offsets_.resize(post.size() + 1);
+  entries_.resize(num_entries);
+  offsets_[0] = 0;
+  std::vector<Entry>::iterator out = entries_.begin();
+  for (size_t t = 0; t < post.size(); t++) {
+    out = std::copy(post[t].begin(), post[t].end(), out);
+    offsets_[t + 1] = out - entries_.begin();
+  }
+}
+
+void CompactPosterior::CopyToPosterior(Posterior *post) const {
+  int32 num_frames = NumFrames();
+  post->resize(num_frames);
+  for (int32 t = 0; t < num_frames; t++)
+    (*post)[t].assign(FrameBegin(t), FrameEnd(t));
+}
+
+void CompactPosterior::Write(std::ostream &os, bool binary) const {
+  int32 num_frames = NumFrames();
+  if (binary) {
+    WriteBasicType(os, binary, num_frames);
+    for (int32 t = 0; t < num_frames; t++) {
+      int32 num_entries = NumEntries(t);
+      WriteBasicType(os, binary, num_entries);
+      for (const Entry *e = FrameBegin(t); e != FrameEnd(t); ++e) {
+        WriteBasicType(os, binary, e->first);
+        WriteBasicType(os, binary, e->second);
+      }
+    }
+  } else {  // The same format as WritePosterior().
+    for (int32 t = 0; t < num_frames; t++) {
+      os << "[ ";
+      for (const Entry *e = FrameBegin(t); e != FrameEnd(t); ++e)
+        os << e->first << ' ' << e->second << ' ';
+      os << "] ";
+    }
+    os << '\n';
+  }
+  if (!os.good())
+    KALDI_ERR << "Output stream error writing Posterior.";
+}
+
+void CompactPosterior::Read(std::istream &is, bool binary) {
+  Clear();
+  if (binary) {
+    int32 num_frames;
+    ReadBasicType(is, true, &num_frames);
+    if (num_frames < 0 || num_frames > 10000000)
+      KALDI_ERR << "Reading posterior: got negative or improbably large size"
+                << num_frames;
+    offsets_.reserve(num_frames + 1);
+    for (int32 t = 0; t < num_frames; t++) {
+      int32 num_entries;
+      ReadBasicType(is, true, &num_entries);
+      if (num_entries < 0)
+        KALDI_ERR << "Reading posteriors: got negative size";
+      size_t offset = entries_.size();
+      entries_.resize(offset + num_entries);
+      for (int32 i = 0; i < num_entries; i++) {
+        ReadBasicType(is, true, &(entries_[offset + i].first));
+        ReadBasicType(is, true, &(entries_[offset + i].second));
+      }
+      offsets_.push_back(entries_.size());
+    }
+  } else {
+    std::string line;
+    getline(is, line);  // The Posterior is terminated by a newline.
+    if (is.fail())
+      KALDI_ERR << "holder of Posterior: error reading line "
+                << (is.eof() ? "[eof]" : "");
+    std::istringstream line_is(line);
+    while (1) {
+      std::string str;
+      line_is >> std::ws;  // eat up whitespace.
+      if (line_is.eof()) break;
+      line_is >> str;
+      if (str != "[")
+        KALDI_ERR << "Reading Posterior object: expecting [, got '" << str
+                  << "'.";
+      AddFrame();
+      while (1) {
+        line_is >> std::ws;
+        if (line_is.peek() == ']') {
+          line_is.get();
+          break;
+        }
+        int32 i; BaseFloat p;
+        line_is >> i >> p;
+        if (line_is.fail())
+          KALDI_ERR << "Error reading Posterior object (could not get data "
+                    << "after \"[\");";
+        AddEntry(i, p);
+      }
+    }
+  }
+}
+
+// static
+bool CompactPosteriorHolder::Write(std::ostream &os, bool binary,
+                                   const T &t) {
+  InitKaldiOutputStream(os, binary);  // Puts binary header if binary mode.
+  try {
+    t.Write(os, binary);
+    return true;
+  } catch(const std::exception &e) {
+    KALDI_WARN << "Exception caught writing table of posteriors. " << e.what();
+    return false;  // Write failure.
+  }
+}
+
+bool CompactPosteriorHolder::Read(std::istream &is) {
+  t_.Clear();
+
+  bool is_binary;
+  if (!InitKaldiInputStream(is, &is_binary)) {
+    KALDI_WARN << "Reading Table object, failed reading binary header";
+    return false;
+  }
+  try {
+    t_.Read(is, is_binary);
+    return true;
+  } catch (std::exception &e) {
+    KALDI_WARN << "Exception caught reading table of posteriors. " << e.what();
+    t_.Clear();
+    return false;
+  }
+}
+
 // static
 bool PosteriorHolder::Write(std::ostream &os, bool binary, const T &t) {
   InitKaldiOutputStream(os, binary);  // Puts binary header if binary mode.
@@ -227,6 +360,33 @@ void ScalePosterior(BaseFloat scale, Posterior *post) {
   }
 }
 
+void ScalePosterior(BaseFloat scale, CompactPosterior *post) {
+  if (scale == 1.0) return;
+  if (scale == 0.0) {
+    // As for Posterior, we keep the frames but remove all their entries.
+    int32 num_frames = post->NumFrames();
+    CompactPosterior empty;
+    empty.Reserve(num_frames, 0);
+    for (int32 t = 0; t < num_frames; t++)
+      empty.AddFrame();
+    post->Swap(&empty);
+    return;
+  }
+  if (post->NumFrames() == 0) return;
+  for (CompactPosterior::Entry *e = post->FrameBegin(0),
+           *end = post->FrameEnd(post->NumFrames() - 1); e != end; ++e)
+    e->second *= scale;
+}
+
+BaseFloat TotalPosterior(const CompactPosterior &post) {
+  double sum = 0.0;
+  if (post.NumFrames() == 0) return sum;
+  for (const CompactPosterior::Entry *e = post.FrameBegin(0),
+           *end = post.FrameEnd(post.NumFrames() - 1); e != end; ++e)
+    sum += e->second;
+  return sum;
+}
+
 BaseFloat TotalPosterior(const Posterior &post) {
   double sum =  0.0;
   size_t T = post.size();
@@ -298,6 +458,16 @@ void AlignmentToPosterior(const std::vector<int32> &ali,
   }
 }
 
+void AlignmentToPosterior(const std::vector<int32> &ali,
+                          CompactPosterior *post) {
+  post->Clear();
+  post->Reserve(ali.size(), ali.size());
+  for (size_t i = 0; i < ali.size(); i++) {
+    post->AddFrame();
+    post->AddEntry(ali[i], 1.0);
+  }
+}
+
 struct ComparePosteriorByPdfs {
   const TransitionModel *tmodel_;
   ComparePosteriorByPdfs(const TransitionModel &tmodel): tmodel_(&tmodel) {}
@@ -535,6 +705,31 @@ template void PosteriorToMatrix<double>(const Posterior &post,
                                         Matrix<double> *mat);
 
 
+void CompactPosteriorToSparseMatrix(const CompactPosterior &post,
+                                    int32 dim,
+                                    int32 first_frame,
+                                    int32 num_frames,
+                                    const std::vector<BaseFloat> *frame_weights,
+                                    SparseMatrix<BaseFloat> *smat) {
+  KALDI_ASSERT(first_frame >= 0 && num_frames >= 0);
+  KALDI_ASSERT(frame_weights == NULL ||
+               static_cast<int32>(frame_weights->size()) == num_frames);
+  smat->Resize(num_frames, dim);
+  int32 end_frame = std::min(first_frame + num_frames, post.NumFrames());
+  std::vector<std::pair<MatrixIndexT, BaseFloat> > pairs;
+  for (int32 t = first_frame; t < end_frame; t++) {
+    int32 i = t - first_frame;
+    BaseFloat weight = (frame_weights == NULL ? 1.0 : (*frame_weights)[i]);
+    if (weight == 0.0 || post.NumEntries(t) == 0)
+      continue;
+    pairs.assign(post.FrameBegin(t), post.FrameEnd(t));
+    SparseVector<BaseFloat> row(dim, pairs);
+    if (weight != 1.0)
+      row.Scale(weight);
+    smat->Data()[i].Swap(&row);
+  }
+}
+
 template <typename Real>
 void PosteriorToPdfMatrix(const Posterior &post,
                           const TransitionModel &model,
@@ -28,6 +28,7 @@
 #include "util/kaldi-table.h"
 #include "hmm/transition-model.h"
 #include "matrix/kaldi-matrix.h"
+#include "matrix/sparse-matrix.h"
 
 
 namespace kaldi {
@@ -95,6 +96,132 @@ void WritePosterior(std::ostream &os, bool binary, const Posterior &post);
 void ReadPosterior(std::istream &os, bool binary, Posterior *post);
 
 
+/// CompactPosterior holds the same information as Posterior, but in
+/// compressed-sparse-row form: the (id, weight) entries of all the frames are
+/// in one array, and those of frame t are the ones from FrameBegin(t) to
+/// FrameEnd(t).  This needs two allocations per utterance instead of one per
+/// frame.  It is written and read in exactly the same format as Posterior, so
+/// archives written by either can be read as the other.
+class CompactPosterior {
+ public:
+  typedef std::pair<int32, BaseFloat> Entry;
+
+  CompactPosterior(): offsets_(1, 0) { }
+
+  explicit CompactPosterior(const Posterior &post) { CopyFromPosterior(post); }
+
+  int32 NumFrames() const { return static_cast<int32>(offsets_.size()) - 1; }
+
+  /// Returns the total number of entries over all frames.
+  int32 NumEntries() const { return entries_.size(); }
+
+  /// Returns the number of entries of frame t.
+  int32 NumEntries(int32 t) const {
+    KALDI_PARANOID_ASSERT(t >= 0 && t < NumFrames());
+    return offsets_[t + 1] - offsets_[t];
+  }
+
+  const Entry *FrameBegin(int32 t) const {
+    KALDI_PARANOID_ASSERT(t >= 0 && t < NumFrames());
+    return entries_.data() + offsets_[t];
+  }
+  const Entry *FrameEnd(int32 t) const {
+    KALDI_PARANOID_ASSERT(t >= 0 && t < NumFrames());
+    return entries_.data() + offsets_[t + 1];
+  }
+  Entry *FrameBegin(int32 t) {
+    KALDI_PARANOID_ASSERT(t >= 0 && t < NumFrames());
+    return entries_.data() + offsets_[t];
+  }
+  Entry *FrameEnd(int32 t) {
+    KALDI_PARANOID_ASSERT(t >= 0 && t < NumFrames());
+    return entries_.data() + offsets_[t + 1];
+  }
+
+  /// Appends a frame with no entries.
+  void AddFrame() { offsets_.push_back(entries_.size()); }
+
+  /// Appends an entry to the last frame; there must be at least one frame.
+  void AddEntry(int32 id, BaseFloat weight) {
+    KALDI_PARANOID_ASSERT(NumFrames() > 0);
+    entries_.push_back(Entry(id, weight));
+    offsets_.back()++;
+  }
+
+  /// Reserves space for this many frames and entries in total.
+  void Reserve(int32 num_frames, int32 num_entries) {
+    offsets_.reserve(num_frames + 1);
+    entries_.reserve(num_entries);
+  }
+
+  /// Removes all frames.
+  void Clear() {
+    offsets_.assign(1, 0);
+    entries_.clear();
+  }
+
+  void Swap(CompactPosterior *other) {
+    offsets_.swap(other->offsets_);
+    entries_.swap(other->entries_);
+  }
+
+  void CopyFromPosterior(const Posterior &post);
+
+  void CopyToPosterior(Posterior *post) const;
+
+  /// Writes in the same format as WritePosterior().
+  void Write(std::ostream &os, bool binary) const;
+
+  /// Reads the format written by Write() or WritePosterior().
+  void Read(std::istream &is, bool binary);
+
+  bool operator == (const CompactPosterior &other) const {
+    return offsets_ == other.offsets_ && entries_ == other.entries_;
+  }
+
+ private:
+  // offsets_[t] is the index in entries_ of the first entry of frame t; the
+  // last element is entries_.size().
+  std::vector<int32> offsets_;
+  std::vector<Entry> entries_;
+};
+
+// CompactPosteriorHolder is a holder for CompactPosterior, whose format is
+// the same as that of PosteriorHolder.
+class CompactPosteriorHolder {
+ public:
+  typedef CompactPosterior T;
+
+  CompactPosteriorHolder() { }
+
+  static bool Write(std::ostream &os, bool binary, const T &t);
+
+  void Clear() { CompactPosterior tmp; t_.Swap(&tmp); }
+
+  // Reads into the holder.
+  bool Read(std::istream &is);
+
+  // Kaldi objects always have the stream open in binary mode for
+  // reading.
+  static bool IsReadInBinary() { return true; }
+
+  T &Value() { return t_; }
+
+  void Swap(CompactPosteriorHolder *other) {
+    t_.Swap(&(other->t_));
+  }
+
+  bool ExtractRange(const CompactPosteriorHolder &other,
+                    const std::string &range) {
+    KALDI_ERR << "ExtractRange is not defined for this type of holder.";
+    return false;
+  }
+ private:
+  KALDI_DISALLOW_COPY_AND_ASSIGN(CompactPosteriorHolder);
+  T t_;
+};
+
+
 // GaussPostHolder is a holder for GaussPost, which is
 // std::vector<std::vector<std::pair<int32, Vector<BaseFloat> > > >
 // This is used for storing posteriors of transition id's for an
@@ -139,6 +266,12 @@ typedef TableWriter<PosteriorHolder> PosteriorWriter;
 typedef SequentialTableReader<PosteriorHolder> SequentialPosteriorReader;
 typedef RandomAccessTableReader<PosteriorHolder> RandomAccessPosteriorReader;
 
+typedef TableWriter<CompactPosteriorHolder> CompactPosteriorWriter;
+typedef SequentialTableReader<CompactPosteriorHolder>
+    SequentialCompactPosteriorReader;
+typedef RandomAccessTableReader<CompactPosteriorHolder>
+    RandomAccessCompactPosteriorReader;
+
 
 // typedef std::vector<std::vector<std::pair<int32, Vector<BaseFloat> > > > GaussPost;
 typedef TableWriter<GaussPostHolder> GaussPostWriter;
@@ -149,9 +282,15 @@ typedef RandomAccessTableReader<GaussPostHolder> RandomAccessGaussPostReader;
 /// Scales the BaseFloat (weight) element in the posterior entries.
 void ScalePosterior(BaseFloat scale, Posterior *post);
 
+/// CompactPosterior version of ScalePosterior().
+void ScalePosterior(BaseFloat scale, CompactPosterior *post);
+
 /// Returns the total of all the weights in "post".
 BaseFloat TotalPosterior(const Posterior &post);
 
+/// CompactPosterior version of TotalPosterior().
+BaseFloat TotalPosterior(const CompactPosterior &post);
+
 /// Returns true if the two lists of pairs have no common .first element.
 bool PosteriorEntriesAreDisjoint(
     const std::vector<std::pair<int32, BaseFloat> > &post_elem1,
@@ -203,6 +342,10 @@ BaseFloat VectorToPosteriorEntry(
 void AlignmentToPosterior(const std::vector<int32> &ali,
                           Posterior *post);
 
+/// CompactPosterior version of AlignmentToPosterior().
+void AlignmentToPosterior(const std::vector<int32> &ali,
+                          CompactPosterior *post);
+
 /// Sorts posterior entries so that transition-ids with same pdf-id are next to
 /// each other.
 void SortPosteriorByPdfs(const TransitionModel &tmodel,
@@ -257,6 +400,19 @@ void PosteriorToPdfMatrix(const Posterior &post,
                           const TransitionModel &model,
                           Matrix<Real> *mat);
 
+/// Converts frames first_frame ... first_frame + num_frames - 1 of 'post' to
+/// a SparseMatrix with 'dim' columns, in the same way as the SparseMatrix
+/// constructor that takes a Posterior, but constructing each row straight from
+/// the entries of 'post'.  Frames past the end of 'post' give empty rows.  If
+/// 'frame_weights' is not NULL, row i is scaled by (*frame_weights)[i] (which
+/// must have num_frames elements), and rows with weight zero are left empty.
+void CompactPosteriorToSparseMatrix(const CompactPosterior &post,
+                                    int32 dim,
+                                    int32 first_frame,
+                                    int32 num_frames,
+                                    const std::vector<BaseFloat> *frame_weights,
+                                    SparseMatrix<BaseFloat> *smat);
+
 /// @} end "addtogroup posterior_group"
 
 
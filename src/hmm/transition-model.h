@@ -161,6 +161,13 @@ class TransitionModel {
   // (unless we're in paranoid mode).
   inline int32 TransitionIdToPdfFast(int32 trans_id) const;
 
+  /// Returns the table that TransitionIdToPdf() looks up (indexed by
+  /// transition-id, with an unused element for index zero); this is for code
+  /// that maps transition-ids to pdfs in batches, e.g. with GatherVec().
+  const std::vector<int32> &TransitionIdToPdfArray() const {
+    return id2pdf_id_;
+  }
+
   int32 TransitionIdToPhone(int32 trans_id) const;
   int32 TransitionIdToPdfClass(int32 trans_id) const;
   int32 TransitionIdToHmmState(int32 trans_id) const;
@@ -86,6 +86,18 @@ class DecodableInterface {
   /// before calling this.
   virtual BaseFloat LogLikelihood(int32 frame, int32 index) = 0;
 
+  /// Sets log_likes[i] = LogLikelihood(frame, indexes[i]) for i = 0 ...
+  /// num_indexes - 1.  Decoders call this once per active state, with the input
+  /// labels of the state's emitting arcs, to avoid one virtual call per arc.
+  /// The default implementation just calls LogLikelihood(); classes that can do
+  /// the lookups more efficiently in a batch (e.g. ones backed by a matrix)
+  /// should override it.
+  virtual void LogLikelihoods(int32 frame, const int32 *indexes,
+                              BaseFloat *log_likes, int32 num_indexes) {
+    for (int32 i = 0; i < num_indexes; i++)
+      log_likes[i] = LogLikelihood(frame, indexes[i]);
+  }
+
   /// Returns true if this is the last frame.  Frames are zero-based, so the
   /// first frame is zero.  IsLastFrame(-1) will return false, unless the file
   /// is empty (which is a case that I'm not sure all the code will handle, so
@@ -0,0 +1,95 @@
+// itf/decoder-observer-itf.h
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_ITF_DECODER_OBSERVER_ITF_H_
+#define KALDI_ITF_DECODER_OBSERVER_ITF_H_ 1
+#include "base/kaldi-common.h"
+
+namespace kaldi {
+/// @ingroup Interfaces
+/// @{
+
+/**
+   Statistics of the search on one frame, as given to
+   DecoderObserverInterface::FrameDecoded().  These are what you need to tune
+   the beam, max-active and lattice-beam for a given latency: how many tokens
+   there were, how many survived the beam, how much work was done, and how
+   long it took.  A decoder sets the fields it can; the ones it cannot are -1.
+ */
+struct DecoderFrameStats {
+  /// The stream being decoded: 0 for decoders that decode one utterance at a
+  /// time, the channel for batched decoders such as CudaDecoder.
+  int32 channel;
+  /// The zero-based index of the frame, as for the decodable object.
+  int32 frame;
+  /// The number of tokens active at the start of the frame, before the
+  /// cutoff was applied.
+  int32 num_tokens;
+  /// The number of those tokens within the cutoff, whose emitting arcs were
+  /// expanded.
+  int32 num_tokens_expanded;
+  /// The number of tokens active at the end of the frame, after the emitting
+  /// and nonemitting arcs have been expanded.
+  int32 num_tokens_out;
+  /// The numbers of emitting and nonemitting arcs that were expanded.
+  int64 num_emitting_arcs;
+  int64 num_nonemitting_arcs;
+  /// The beam in effect on the frame; it is less than the configured beam if
+  /// max-active was reached.
+  BaseFloat adaptive_beam;
+  /// The cost cutoff applied to the tokens of the frame.  It is only
+  /// comparable within an utterance, as decoders subtract offsets from the
+  /// costs.
+  BaseFloat cutoff;
+  /// The times taken by the phases of the frame, in seconds: processing the
+  /// emitting arcs, the nonemitting arcs, and pruning the lattice so far (which
+  /// is only done every few frames, and is 0 otherwise).  'seconds' is the
+  /// total; for batched decoders, it is the time for the frame of the whole
+  /// batch.
+  double emitting_seconds;
+  double nonemitting_seconds;
+  double prune_seconds;
+  double seconds;
+
+  DecoderFrameStats(): channel(0), frame(-1), num_tokens(-1),
+                       num_tokens_expanded(-1), num_tokens_out(-1),
+                       num_emitting_arcs(-1), num_nonemitting_arcs(-1),
+                       adaptive_beam(-1), cutoff(-1), emitting_seconds(-1),
+                       nonemitting_seconds(-1), prune_seconds(-1),
+                       seconds(-1) { }
+};
+
+/**
+   An interface for objects that want statistics of the search on each frame
+   from a decoder (see e.g. LatticeFasterDecoderTpl::SetObserver() and
+   CudaDecoder::SetObserver()).  The decoder calls FrameDecoded() from its
+   decoding thread after each frame; it only gathers the timing statistics
+   when an observer is set, so a decoder without one runs as fast as before.
+   DecoderStatsCollector in decoder/decoder-stats.h is an implementation that
+   accumulates histograms of the statistics.
+ */
+class DecoderObserverInterface {
+ public:
+  virtual void FrameDecoded(const DecoderFrameStats &stats) = 0;
+  virtual ~DecoderObserverInterface() { }
+};
+/// @}
+}  // namespace Kaldi
+
+#endif  // KALDI_ITF_DECODER_OBSERVER_ITF_H_
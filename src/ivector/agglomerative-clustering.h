@@ -22,34 +22,14 @@
 #ifndef KALDI_IVECTOR_AGGLOMERATIVE_CLUSTERING_H_
 #define KALDI_IVECTOR_AGGLOMERATIVE_CLUSTERING_H_
 
+#include <utility>
 #include <vector>
-#include <queue>
-#include <set>
-#include <unordered_map>
-#include <functional>
 #include "base/kaldi-common.h"
 #include "matrix/matrix-lib.h"
 #include "util/stl-utils.h"
 
 namespace kaldi {
 
-/// AhcCluster is the cluster object for the agglomerative clustering. It
-/// contains three integer IDs: its own ID and the IDs of its "parents", i.e.
-/// the clusters that were merged to form it. It also contains the size (the
-/// number of points in the cluster) and a vector of the IDs of the utterances
-/// contained in the cluster.
-struct AhcCluster {
-  int32 id,
-    parent1,
-    parent2,
-    size;
-  std::vector<int32> utt_ids;
-  AhcCluster(int32 id, int32 p1, int32 p2, std::vector<int32> utts)
-      : id(id), parent1(p1), parent2(p2), utt_ids(utts) {
-    size = utts.size();
-  }
-};
-
 /// The AgglomerativeClusterer class contains the necessary mechanisms for the
 /// actual clustering algorithm.
 class AgglomerativeClusterer {
@@ -71,75 +51,63 @@ class AgglomerativeClusterer {
     // form their own clusters and force everything else to be clustered
     // together, e.g. when min-clusters is provided instead of a threshold.
     max_cluster_size_ = ceil(num_points_ * max_cluster_fraction);
-
-    // The count_, which is used for identifying clusters, is initialized to
-    // num_points_ because cluster IDs 1..num_points_ are reserved for input
-    // points, which are the initial set of clusters.
-    count_ = num_points_;
-
-    // The second_pass_count_, which is used for identifying the initial set of
-    // second pass clusters and initializing count_ before the second pass, is
-    // initialized to 0 and incremented whenever a new cluster is added to the
-    // initial set of second pass clusters.
-    second_pass_count_ = 0;
   }
 
-  // Clusters points. Chooses single pass or two pass algorithm.
+  // Clusters points.  If there are more than first_pass_max_points_ points,
+  // they are first clustered in windows, see AgglomerativeCluster().
   void Cluster();
 
-  // Clusters points using single pass algorithm.
-  void ClusterSinglePass();
-
-  // Clusters points using two pass algorithm.
-  void ClusterTwoPass();
-
  private:
-  // Encodes cluster pair into a 32bit unsigned integer.
-  uint32 EncodePair(int32 i, int32 j);
-  // Decodes cluster pair from a 32bit unsigned integer.
-  std::pair<int32, int32> DecodePair(uint32 key);
-  // Initializes the clustering queue with singleton clusters
-  void InitializeClusters(int32 first, int32 last);
-  // Does hierarchical agglomerative clustering
-  void ComputeClusters(int32 min_clusters);
-  // Adds clusters created in first pass to second pass clusters
-  void AddClustersToSecondPass();
+  // Does hierarchical agglomerative clustering of "clusters" (each a list of
+  // points), merging them until there are only "min_clusters" left or no
+  // more pairs can be merged.  On exit, "clusters" contains the resulting
+  // clusters.
+  void ComputeClusters(int32 min_clusters,
+                       std::vector<std::vector<int32> > *clusters);
+  // Clusters each window of at most first_pass_max_points_ consecutive
+  // clusters in "clusters" separately.
+  void ClusterWindows(std::vector<std::vector<int32> > *clusters);
   // Assigns points to clusters
-  void AssignClusters();
-  // Merges clusters with IDs i and j and updates cost map and queue
-  void MergeClusters(int32 i, int32 j);
+  void AssignClusters(const std::vector<std::vector<int32> > &clusters);
+
+  // The following are used by ComputeClusters(); the clusters are identified
+  // by their index in its input, and a merged cluster takes the lower index of
+  // the two.
+
+  // Returns the index into sums_ of the pair of clusters (i, j), i != j.
+  inline size_t PairIndex(int32 i, int32 j) const {
+    if (i > j) std::swap(i, j);
+    return static_cast<size_t>(i) * (2 * num_clusters_ - i - 1) / 2 +
+        (j - i - 1);
+  }
+  // Sets nearest_[i] and nearest_cost_[i].
+  void UpdateNearest(int32 i);
+  // Merges cluster j into cluster i.
+  void MergeClusters(int32 i, int32 j,
+                     std::vector<std::vector<int32> > *clusters);
 
   const Matrix<BaseFloat> &costs_;  // cost matrix
   BaseFloat threshold_;  // stopping criterion threshold
   int32 min_clusters_;  // minimum number of clusters
-  int32 first_pass_max_points_;  // maximum number of points in each subset
+  int32 first_pass_max_points_;  // maximum number of points in each window
   std::vector<int32> *assignments_;  // assignments out
 
   int32 num_points_;  // total number of points to cluster
   int32 max_cluster_size_;  // maximum number of points in a cluster
-  int32 count_;  // count of first pass clusters, used for identifying clusters
-  int32 second_pass_count_;  // count of second pass clusters
-
-  // Priority queue using greater (lowest costs are highest priority).
-  // Elements contain pairs of cluster IDs and their cost.
-  typedef std::pair<BaseFloat, uint32> QueueElement;
-  typedef std::priority_queue<QueueElement, std::vector<QueueElement>,
-    std::greater<QueueElement>  > QueueType;
-  QueueType queue_, second_pass_queue_;
-
-  // Map from cluster IDs to cost between them
-  std::unordered_map<uint32, BaseFloat> cluster_cost_map_;
-  // Map from cluster ID to cluster object address
-  std::unordered_map<int32, AhcCluster*> clusters_map_;
-  // Set of unmerged cluster IDs
-  std::set<int32> active_clusters_;
-
-  // Map from second pass cluster IDs to cost between them
-  std::unordered_map<uint32, BaseFloat> second_pass_cluster_cost_map_;
-  // Map from second pass cluster ID to cluster object address
-  std::unordered_map<int32, AhcCluster*> second_pass_clusters_map_;
-  // Set of unmerged second pass cluster IDs
-  std::set<int32> second_pass_active_clusters_;
+
+  int32 num_clusters_;  // number of clusters ComputeClusters() started with
+  // The sums of the costs between the points of each pair of clusters, as the
+  // upper triangle of a matrix stored by rows ("condensed"), indexed by
+  // PairIndex().
+  std::vector<BaseFloat> sums_;
+  std::vector<int32> sizes_;  // the number of points in each cluster
+  // The clusters that have not been merged into others, in no particular
+  // order, and the position of each cluster in active_ (or -1).
+  std::vector<int32> active_, active_pos_;
+  // For each active cluster, the active cluster it would cost least to merge
+  // it with (or -1 if it cannot be merged with any), and the average cost.
+  std::vector<int32> nearest_;
+  std::vector<BaseFloat> nearest_cost_;
 };
 
 /** This is the function that is called to perform the agglomerative
@@ -170,11 +138,19 @@ class AgglomerativeClusterer {
  *  costs between clusters I and M and clusters I and N, where
  *  cluster J was formed by merging clusters M and N.
  *
+ *  Each cluster keeps track of the cluster it would cost least to merge with
+ *  (its nearest neighbor), so each merge takes time linear in the number of
+ *  clusters, except where other clusters' nearest neighbors were the ones
+ *  merged; and the sums of costs are kept in a "condensed" matrix of floats,
+ *  i.e. only the upper triangle, so it takes 2N^2 bytes for N points.
+ *
  *  If the number of points to cluster is larger than first-pass-max-points,
- *  then clustering is done in two passes. In the first pass, input points are
- *  divided into contiguous subsets of size at most first-pass-max-points and
- *  each subset is clustered separately. In the second pass, the first pass
- *  clusters are merged into the final set of clusters.
+ *  which bounds that memory, then the input points are divided into contiguous
+ *  windows of at most first-pass-max-points points, and each window is
+ *  clustered separately (down to 10 * min-clusters clusters).  If there are
+ *  still more than first-pass-max-points clusters, the same is done with
+ *  windows of consecutive clusters, and so on, until they can be clustered all
+ *  together into the final set of clusters.
  *
  */
 void AgglomerativeCluster(
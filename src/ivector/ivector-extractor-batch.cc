@@ -0,0 +1,214 @@
+// ivector/ivector-extractor-batch.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "ivector/ivector-extractor-batch.h"
+#include "cudamatrix/cu-device.h"
+#include "cudamatrix/cu-sparse-matrix.h"
+
+namespace kaldi {
+
+IvectorExtractorBatchComputer::IvectorExtractorBatchComputer(
+    const IvectorExtractor &extractor):
+    feat_dim_(extractor.FeatDim()), ivector_dim_(extractor.IvectorDim()),
+    num_gauss_(extractor.NumGauss()),
+    prior_offset_(extractor.PriorOffset()) {
+  if (extractor.IvectorDependentWeights())
+    KALDI_ERR << "Batched iVector extraction does not support extractors "
+              << "with iVector-dependent weights.";
+  int32 D = feat_dim_, S = ivector_dim_, I = num_gauss_;
+  Matrix<BaseFloat> sigma_inv_m(I * (D + 1), S);
+  for (int32 i = 0; i < I; i++)
+    sigma_inv_m.RowRange(i * (D + 1), D).CopyFromMat(
+        extractor.Sigma_inv_M_[i]);
+  sigma_inv_m_.Swap(&sigma_inv_m);
+  u_.Resize(extractor.U_.NumRows(), extractor.U_.NumCols(), kUndefined);
+  u_.CopyFromMat(extractor.U_);
+
+  std::vector<int32> unpack_indexes(S * S);
+  Vector<BaseFloat> unit(S * S);
+  for (int32 j = 0; j < S; j++) {
+    for (int32 k = 0; k < S; k++) {
+      int32 r = std::max(j, k), c = std::min(j, k);
+      unpack_indexes[j * S + k] = r * (r + 1) / 2 + c;
+    }
+    unit(j * S + j) = 1.0;
+  }
+  unpack_indexes_.CopyFromVec(unpack_indexes);
+  unit_.Swap(&unit);
+}
+
+void IvectorExtractorBatchComputer::ComputeIvectors(
+    const std::vector<const MatrixBase<BaseFloat>*> &feats,
+    const std::vector<const Posterior*> &posteriors,
+    Matrix<BaseFloat> *ivectors) const {
+  KALDI_ASSERT(feats.size() == posteriors.size());
+  int32 num_utts = feats.size(), D = feat_dim_, S = ivector_dim_,
+      I = num_gauss_;
+  if (num_utts == 0) {
+    ivectors->Resize(0, S);
+    return;
+  }
+  int32 tot_frames = 0;
+  for (int32 u = 0; u < num_utts; u++) {
+    KALDI_ASSERT(feats[u]->NumCols() == D &&
+                 feats[u]->NumRows() ==
+                 static_cast<int32>(posteriors[u]->size()));
+    tot_frames += feats[u]->NumRows();
+  }
+
+  // We put the features of all the utterances one after the other, with a
+  // column of ones appended, and number the Gaussians of utterance u from
+  // u * I in the posteriors, so that one multiplication gives us all the
+  // stats.
+  Matrix<BaseFloat> feats_ext(tot_frames, D + 1, kUndefined);
+  std::vector<std::vector<std::pair<MatrixIndexT, BaseFloat> > > post_pairs(
+      tot_frames);
+  for (int32 u = 0, t = 0; u < num_utts; u++) {
+    const Posterior &post = *(posteriors[u]);
+    feats_ext.Range(t, feats[u]->NumRows(), 0, D).CopyFromMat(*(feats[u]));
+    for (size_t j = 0; j < post.size(); j++, t++) {
+      feats_ext(t, D) = 1.0;
+      post_pairs[t].reserve(post[j].size());
+      for (size_t k = 0; k < post[j].size(); k++) {
+        int32 i = post[j][k].first;
+        KALDI_ASSERT(i >= 0 && i < I);
+        post_pairs[t].push_back(std::make_pair(u * I + i, post[j][k].second));
+      }
+    }
+  }
+  CuSparseMatrix<BaseFloat> post_mat(
+      SparseMatrix<BaseFloat>(num_utts * I, post_pairs));
+  CuMatrix<BaseFloat> cu_feats_ext(feats_ext);
+
+  // Row u * I + i of 'stats' has the first-order stats of Gaussian i for
+  // utterance u, followed by its zeroth-order stats.  The stride equals the
+  // number of columns so that the stats of each utterance can be viewed as
+  // one row of 'utt_stats'.
+  CuMatrix<BaseFloat> stats(num_utts * I, D + 1, kUndefined,
+                            kStrideEqualNumCols);
+  stats.AddSmatMat(1.0, post_mat, kTrans, cu_feats_ext, 0.0);
+  CuSubMatrix<BaseFloat> utt_stats(stats.Data(), num_utts, I * (D + 1),
+                                   I * (D + 1));
+
+  // linear(u) = \sum_i M_i^T Sigma_i^{-1} x_{u,i}, plus the prior term; the
+  // zeroth-order stats meet the zero rows of sigma_inv_m_.
+  CuMatrix<BaseFloat> linear(num_utts, S, kUndefined);
+  linear.AddMatMat(1.0, utt_stats, kNoTrans, sigma_inv_m_, kNoTrans, 0.0);
+  linear.ColRange(0, 1).Add(prior_offset_);
+
+  // quadratic(u) = \sum_i gamma_{u,i} U_i, packed; the prior term is added
+  // later.
+  CuVector<BaseFloat> gamma_vec(num_utts * I, kUndefined);
+  gamma_vec.CopyColFromMat(stats, D);
+  CuSubMatrix<BaseFloat> gamma(gamma_vec.Data(), num_utts, I, I);
+  CuMatrix<BaseFloat> quadratic(num_utts, S * (S + 1) / 2, kUndefined);
+  quadratic.AddMatMat(1.0, gamma, kNoTrans, u_, kNoTrans, 0.0);
+
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled()) {
+    SolveCuda(quadratic, &linear);
+    ivectors->Resize(num_utts, S, kUndefined);
+    linear.CopyToMat(ivectors);
+    return;
+  }
+#endif
+  // On the CPU we solve each system as GetIvectorDistribution() does.
+  ivectors->Resize(num_utts, S, kUndefined);
+  Matrix<BaseFloat> cpu_quadratic(quadratic), cpu_linear(linear);
+  for (int32 u = 0; u < num_utts; u++) {
+    SpMatrix<double> this_quadratic(S);
+    SubVector<double>(this_quadratic.Data(), S * (S + 1) / 2).CopyFromVec(
+        cpu_quadratic.Row(u));
+    this_quadratic.AddToDiag(1.0);
+    this_quadratic.Invert();
+    Vector<double> this_linear(cpu_linear.Row(u)), mean(S);
+    mean.AddSpVec(1.0, this_quadratic, this_linear, 0.0);
+    ivectors->Row(u).CopyFromVec(mean);
+  }
+}
+
+#if HAVE_CUDA == 1
+#if CUDA_VERSION >= 9010
+// Overloads of the batched Cholesky functions of cusolver for float and double.
+static inline cusolverStatus_t PotrfBatched(int n, float *a[], int lda,
+                                            int *info, int batch_size) {
+  return cusolverDnSpotrfBatched(GetCusolverDnHandle(), CUBLAS_FILL_MODE_LOWER,
+                                 n, a, lda, info, batch_size);
+}
+static inline cusolverStatus_t PotrfBatched(int n, double *a[], int lda,
+                                            int *info, int batch_size) {
+  return cusolverDnDpotrfBatched(GetCusolverDnHandle(), CUBLAS_FILL_MODE_LOWER,
+                                 n, a, lda, info, batch_size);
+}
+static inline cusolverStatus_t PotrsBatched(int n, float *a[], int lda,
+                                            float *b[], int ldb, int *info,
+                                            int batch_size) {
+  return cusolverDnSpotrsBatched(GetCusolverDnHandle(), CUBLAS_FILL_MODE_LOWER,
+                                 n, 1, a, lda, b, ldb, info, batch_size);
+}
+static inline cusolverStatus_t PotrsBatched(int n, double *a[], int lda,
+                                            double *b[], int ldb, int *info,
+                                            int batch_size) {
+  return cusolverDnDpotrsBatched(GetCusolverDnHandle(), CUBLAS_FILL_MODE_LOWER,
+                                 n, 1, a, lda, b, ldb, info, batch_size);
+}
+#endif
+
+void IvectorExtractorBatchComputer::SolveCuda(
+    const CuMatrixBase<BaseFloat> &quadratic,
+    CuMatrixBase<BaseFloat> *linear) const {
+#if CUDA_VERSION >= 9010
+  int32 num_utts = quadratic.NumRows(), S = ivector_dim_;
+  // Unpack the quadratic terms into full matrices, one per row, and add the
+  // prior's inverse variance.  The matrices are symmetric, so it does not
+  // matter that cusolver takes them to be in column-major order.
+  CuMatrix<BaseFloat> full(num_utts, S * S, kUndefined);
+  full.CopyCols(quadratic, unpack_indexes_);
+  full.AddVecToRows(1.0, unit_);
+
+  std::vector<BaseFloat*> a(num_utts), b(num_utts);
+  for (int32 u = 0; u < num_utts; u++) {
+    a[u] = full.RowData(u);
+    b[u] = linear->RowData(u);
+  }
+  CuArray<BaseFloat*> a_array(a), b_array(b);
+  CuArray<int32> infos(num_utts);
+  CUSOLVER_SAFE_CALL(PotrfBatched(S, a_array.Data(), S, infos.Data(),
+                                  num_utts));
+  std::vector<int32> infos_cpu;
+  infos.CopyToVec(&infos_cpu);
+  for (int32 u = 0; u < num_utts; u++)
+    if (infos_cpu[u] != 0)
+      KALDI_ERR << "Cholesky factorization of the iVector precision matrix "
+                << "failed for utterance " << u << " of the batch (info = "
+                << infos_cpu[u] << ')';
+  CUSOLVER_SAFE_CALL(PotrsBatched(S, a_array.Data(), S, b_array.Data(), S,
+                                  infos.Data(), num_utts));
+#else
+  KALDI_ERR << "Batched iVector extraction on the GPU is not supported by "
+            << "your CUDA version.  Upgrade to CUDA 9.1 or later";
+#endif
+}
+#endif
+
+}  // namespace kaldi
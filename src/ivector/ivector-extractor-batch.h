@@ -0,0 +1,99 @@
+// ivector/ivector-extractor-batch.h
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_IVECTOR_IVECTOR_EXTRACTOR_BATCH_H_
+#define KALDI_IVECTOR_IVECTOR_EXTRACTOR_BATCH_H_
+
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "cudamatrix/cu-array.h"
+#include "cudamatrix/cu-matrix.h"
+#include "cudamatrix/cu-vector.h"
+#include "hmm/posterior.h"
+#include "ivector/ivector-extractor.h"
+
+namespace kaldi {
+
+/**
+   This class computes the iVectors of many utterances at once, with the same
+   result as IvectorExtractor::GetIvectorDistribution() gives for each of them,
+   but with the work arranged so that it runs well on a GPU (if one is in use;
+   otherwise it runs on the CPU).  The zeroth and first-order stats of all the
+   utterances in a batch are computed with one sparse matrix multiplication,
+   the linear and quadratic terms of their iVector distributions with one
+   matrix multiplication each, and on the GPU the linear systems are solved
+   with a batched Cholesky factorization.
+
+   It does not support extractors with iVector-dependent weights (see
+   IvectorExtractor::IvectorDependentWeights()).  Note that it computes in
+   BaseFloat, normally single precision, so the iVectors differ slightly from
+   those of the IvectorExtractor, which uses double.
+ */
+class IvectorExtractorBatchComputer {
+ public:
+  /// Copies what it needs from 'extractor', which need not outlive this
+  /// object.
+  explicit IvectorExtractorBatchComputer(const IvectorExtractor &extractor);
+
+  /// Computes the iVectors of a batch of utterances, given their features and
+  /// Gaussian-level posteriors (which should already be scaled by any acoustic
+  /// weight or --max-count scale).  The iVectors are put in the rows of
+  /// 'ivectors', which is resized.  As with GetIvectorDistribution(), their
+  /// first dimension includes the prior offset (see PriorOffset()).
+  void ComputeIvectors(const std::vector<const MatrixBase<BaseFloat>*> &feats,
+                       const std::vector<const Posterior*> &posteriors,
+                       Matrix<BaseFloat> *ivectors) const;
+
+  int32 IvectorDim() const { return ivector_dim_; }
+  BaseFloat PriorOffset() const { return prior_offset_; }
+
+ private:
+  // Solves the linear systems on the GPU: row u of 'quadratic' is the quadratic
+  // term of utterance u in packed form, without the prior; on exit row u of
+  // 'linear' is the iVector.
+  void SolveCuda(const CuMatrixBase<BaseFloat> &quadratic,
+                 CuMatrixBase<BaseFloat> *linear) const;
+
+  int32 feat_dim_;
+  int32 ivector_dim_;
+  int32 num_gauss_;
+  BaseFloat prior_offset_;
+
+  // The matrices Sigma_i^{-1} M_i of the extractor, stacked: rows
+  // i * (D+1) ... i * (D+1) + D - 1 are Sigma_inv_M_[i], and row i * (D+1) + D
+  // is zero.  The zero rows line up with the zeroth-order stats, which we keep
+  // next to the first-order stats of each Gaussian.
+  CuMatrix<BaseFloat> sigma_inv_m_;
+
+  // U_i = M_i^T Sigma_i^{-1} M_i, in packed form, one row per Gaussian.
+  CuMatrix<BaseFloat> u_;
+
+  // For unpacking the quadratic terms on the GPU: element j * S + k of a full
+  // S by S matrix is element unpack_indexes_[j * S + k] of the packed one.
+  CuArray<int32> unpack_indexes_;
+  // The unit matrix (the inverse variance of the prior), flattened.
+  CuVector<BaseFloat> unit_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(IvectorExtractorBatchComputer);
+};
+
+}  // namespace kaldi
+
+#endif  // KALDI_IVECTOR_IVECTOR_EXTRACTOR_BATCH_H_
@@ -20,6 +20,7 @@
 #include "gmm/model-test-common.h"
 #include "gmm/full-gmm-normal.h"
 #include "ivector/ivector-extractor.h"
+#include "ivector/ivector-extractor-batch.h"
 #include "util/kaldi-io.h"
 
 
@@ -141,6 +142,76 @@ void TestIvectorExtraction(const IvectorExtractor &extractor,
   KALDI_ASSERT(ivector1.ApproxEqual(ivector2));
 }
 
+// Checks that IvectorExtractorBatchComputer gives the same iVectors as
+// GetIvectorDistribution(), for a batch of all the utterances.
+void TestIvectorExtractionBatch(const IvectorExtractor &extractor,
+                                const std::vector<Matrix<BaseFloat> > &all_feats,
+                                const FullGmm &fgmm) {
+  if (extractor.IvectorDependentWeights())
+    return;  // Not supported by the batched computation.
+  int32 num_utts = all_feats.size(), ivector_dim = extractor.IvectorDim();
+  std::vector<Posterior> posts(num_utts);
+  std::vector<const MatrixBase<BaseFloat>*> feats_ptrs(num_utts);
+  std::vector<const Posterior*> post_ptrs(num_utts);
+  for (int32 utt = 0; utt < num_utts; utt++) {
+    const Matrix<BaseFloat> &feats = all_feats[utt];
+    Posterior &post = posts[utt];
+    post.resize(feats.NumRows());
+    for (int32 t = 0; t < feats.NumRows(); t++) {
+      Vector<BaseFloat> posterior(fgmm.NumGauss(), kUndefined);
+      fgmm.ComponentPosteriors(feats.Row(t), &posterior);
+      for (int32 i = 0; i < posterior.Dim(); i++)
+        if (posterior(i) > 0.01)  // make it sparse, like real posteriors.
+          post[t].push_back(std::make_pair(i, posterior(i)));
+    }
+    feats_ptrs[utt] = &feats;
+    post_ptrs[utt] = &post;
+  }
+  IvectorExtractorBatchComputer batch_computer(extractor);
+  Matrix<BaseFloat> ivectors;
+  batch_computer.ComputeIvectors(feats_ptrs, post_ptrs, &ivectors);
+  KALDI_ASSERT(ivectors.NumRows() == num_utts &&
+               ivectors.NumCols() == ivector_dim);
+  for (int32 utt = 0; utt < num_utts; utt++) {
+    IvectorExtractorUtteranceStats utt_stats(extractor.NumGauss(),
+                                             extractor.FeatDim(), false);
+    utt_stats.AccStats(all_feats[utt], posts[utt]);
+    Vector<double> ivector(ivector_dim);
+    extractor.GetIvectorDistribution(utt_stats, &ivector, NULL);
+    Vector<double> batch_ivector(ivectors.Row(utt));
+    KALDI_ASSERT(ivector.ApproxEqual(batch_ivector, 0.01));
+  }
+}
+
+
+void TestSumIvectorExtractorStats(const IvectorExtractor &extractor,
+                                  const IvectorExtractorStatsOptions &stats_opts,
+                                  const std::vector<Matrix<BaseFloat> > &all_feats,
+                                  const FullGmm &fgmm) {
+  // Accumulate each utterance into its own copy of the stats, and check that
+  // the sum is the same as the stats accumulated all together.
+  int32 num_utts = all_feats.size();
+  IvectorExtractorStats stats(extractor, stats_opts);
+  std::vector<IvectorExtractorStats*> copies(num_utts);
+  for (int32 utt = 0; utt < num_utts; utt++) {
+    stats.AccStatsForUtterance(extractor, all_feats[utt], fgmm);
+    copies[utt] = new IvectorExtractorStats(extractor, stats_opts);
+    copies[utt]->AccStatsForUtterance(extractor, all_feats[utt], fgmm);
+  }
+  SumIvectorExtractorStats(copies);
+  stats.Flush();
+  AssertEqual(stats.AuxfPerFrame(), copies[0]->AuxfPerFrame());
+  if (!extractor.IvectorDependentWeights()) {
+    // Without the weights, which are estimated from random samples, the update
+    // is a deterministic function of the stats.
+    IvectorExtractorEstimationOptions estimation_opts;
+    estimation_opts.gaussian_min_count = extractor.FeatDim() + 5;
+    IvectorExtractor extractor1(extractor), extractor2(extractor);
+    AssertEqual(stats.Update(estimation_opts, &extractor1),
+                copies[0]->Update(estimation_opts, &extractor2), 1.0e-03);
+  }
+  DeletePointers(&copies);
+}
 
 void UnitTestIvectorExtractor() {
   FullGmm fgmm;
@@ -185,7 +256,9 @@ void UnitTestIvectorExtractor() {
       TestIvectorExtraction(extractor, feats, fgmm);
     }
     TestIvectorExtractorStatsIO(stats);
-    
+    TestIvectorExtractionBatch(extractor, all_feats, fgmm);
+    TestSumIvectorExtractorStats(extractor, stats_opts, all_feats, fgmm);
+
     IvectorExtractorEstimationOptions estimation_opts;
     estimation_opts.gaussian_min_count = dim + 5;
     double auxf = stats.AuxfPerFrame(),
@@ -18,10 +18,13 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <functional>
+#include <thread>
 #include <vector>
 
 #include "ivector/ivector-extractor.h"
 #include "util/kaldi-thread.h"
+#include "cudamatrix/cu-device.h"
 
 namespace kaldi {
 
@@ -908,6 +911,17 @@ IvectorExtractorStats::IvectorExtractorStats(
   R_gamma_cache_.Resize(stats_opts.cache_size, I);
   R_ivec_scatter_cache_.Resize(stats_opts.cache_size, S*(S+1)/2);
 
+  use_gpu_ = false;
+#if HAVE_CUDA == 1
+  use_gpu_ = CuDevice::Instantiate().Enabled();
+#endif
+  if (use_gpu_) {
+    Y_X_cache_.Resize(stats_opts.cache_size, I * D);
+    Y_ivec_cache_.Resize(stats_opts.cache_size, S);
+    R_cuda_.Resize(I, S * (S + 1) / 2);
+    Y_cuda_.Resize(I * D, S);
+  }
+
   if (extractor.IvectorDependentWeights()) {
     Q_.Resize(I, S * (S + 1) / 2);
     G_.Resize(I, S);
@@ -934,10 +948,13 @@ void IvectorExtractorStats::CommitStatsForM(
   // We do the occupation stats here also.
   gamma_.AddVec(1.0, utt_stats.gamma_);
 
-  // Stats for the linear term in M:
-  for  (int32 i = 0; i < extractor.NumGauss(); i++) {
-    Y_[i].AddVecVec(1.0, utt_stats.X_.Row(i),
-                    Vector<double>(ivec_mean));
+  // Stats for the linear term in M (if we're using a GPU, they are cached
+  // along with the R stats, below).
+  if (!use_gpu_) {
+    for  (int32 i = 0; i < extractor.NumGauss(); i++) {
+      Y_[i].AddVecVec(1.0, utt_stats.X_.Row(i),
+                      Vector<double>(ivec_mean));
+    }
   }
   gamma_Y_lock_.unlock();
 
@@ -956,6 +973,10 @@ void IvectorExtractorStats::CommitStatsForM(
   SubVector<double> ivec_scatter_vec(ivec_scatter.Data(),
                                      ivector_dim * (ivector_dim + 1) / 2);
   R_ivec_scatter_cache_.Row(R_num_cached_).CopyFromVec(ivec_scatter_vec);
+  if (use_gpu_) {
+    Y_X_cache_.Row(R_num_cached_).CopyRowsFromMat(utt_stats.X_);
+    Y_ivec_cache_.Row(R_num_cached_).CopyFromVec(ivec_mean);
+  }
   R_num_cached_++;
   R_cache_lock_.unlock();
 }
@@ -972,18 +993,53 @@ void IvectorExtractorStats::FlushCache() {
     Matrix<double> R_ivec_scatter_cache(
         R_ivec_scatter_cache_.Range(0, R_num_cached_,
                                     0, R_ivec_scatter_cache_.NumCols()));
+    Matrix<double> Y_X_cache, Y_ivec_cache;
+    if (use_gpu_) {
+      Y_X_cache = Y_X_cache_.RowRange(0, R_num_cached_);
+      Y_ivec_cache = Y_ivec_cache_.RowRange(0, R_num_cached_);
+    }
     R_num_cached_ = 0; // As far as other threads are concerned, the cache is
                        // cleared and they may write to it.
     R_cache_lock_.unlock();
     R_lock_.lock();
-    R_.AddMatMat(1.0, R_gamma_cache, kTrans,
-                 R_ivec_scatter_cache, kNoTrans, 1.0);
+    if (use_gpu_) {
+      // Y_i += X_i^T ivec_mean summed over the cached utterances, for all i at
+      // once, as the rows of X_i for the n'th utterance are row n of Y_X_cache.
+      CuMatrix<double> R_gamma_cache_cuda(R_gamma_cache),
+          R_ivec_scatter_cache_cuda(R_ivec_scatter_cache),
+          Y_X_cache_cuda(Y_X_cache), Y_ivec_cache_cuda(Y_ivec_cache);
+      R_cuda_.AddMatMat(1.0, R_gamma_cache_cuda, kTrans,
+                        R_ivec_scatter_cache_cuda, kNoTrans, 1.0);
+      Y_cuda_.AddMatMat(1.0, Y_X_cache_cuda, kTrans,
+                        Y_ivec_cache_cuda, kNoTrans, 1.0);
+    } else {
+      R_.AddMatMat(1.0, R_gamma_cache, kTrans,
+                   R_ivec_scatter_cache, kNoTrans, 1.0);
+    }
     R_lock_.unlock();
   } else {
     R_cache_lock_.unlock();
   }
 }
 
+void IvectorExtractorStats::CopyStatsFromDevice() {
+  if (!use_gpu_)
+    return;
+  std::lock_guard<std::mutex> lock(R_lock_);
+  R_.AddMat(1.0, Matrix<double>(R_cuda_));
+  Matrix<double> Y(Y_cuda_);
+  int32 D = Y.NumRows() / Y_.size();
+  for (size_t i = 0; i < Y_.size(); i++)
+    Y_[i].AddMat(1.0, Y.RowRange(i * D, D));
+  R_cuda_.SetZero();
+  Y_cuda_.SetZero();
+}
+
+void IvectorExtractorStats::Flush() {
+  FlushCache();
+  CopyStatsFromDevice();
+}
+
 
 void IvectorExtractorStats::CommitStatsForSigma(
     const IvectorExtractor &extractor,
@@ -1197,7 +1253,7 @@ void IvectorExtractorStats::Add(const IvectorExtractorStats &other) {
 
 
 void IvectorExtractorStats::Write(std::ostream &os, bool binary) {
-  FlushCache(); // for R stats.
+  Flush(); // for R stats, and Y stats if we used a GPU.
   ((const IvectorExtractorStats&)(*this)).Write(os, binary); // call const version.
 }
 
@@ -1769,11 +1825,31 @@ IvectorExtractorStats::IvectorExtractorStats (
     Y_(other.Y_), R_(other.R_), R_num_cached_(other.R_num_cached_),
     R_gamma_cache_(other.R_gamma_cache_),
     R_ivec_scatter_cache_(other.R_ivec_scatter_cache_),
-    Q_(other.Q_), G_(other.G_), S_(other.S_), num_ivectors_(other.num_ivectors_),
+    use_gpu_(other.use_gpu_), Y_X_cache_(other.Y_X_cache_),
+    Y_ivec_cache_(other.Y_ivec_cache_), R_cuda_(other.R_cuda_),
+    Y_cuda_(other.Y_cuda_), Q_(other.Q_), G_(other.G_), S_(other.S_), num_ivectors_(other.num_ivectors_),
     ivector_sum_(other.ivector_sum_), ivector_scatter_(other.ivector_scatter_) {
 }
 
 
+void SumIvectorExtractorStats(
+    const std::vector<IvectorExtractorStats*> &stats) {
+  KALDI_ASSERT(!stats.empty());
+  for (size_t i = 0; i < stats.size(); i++)
+    stats[i]->Flush();
+  // At the level with this "step", stats[i] += stats[i + step] for each i that
+  // is a multiple of 2 * step; these additions touch disjoint pairs of stats,
+  // so they can run at the same time.
+  for (size_t step = 1; step < stats.size(); step *= 2) {
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i + step < stats.size(); i += 2 * step)
+      threads.push_back(std::thread(&IvectorExtractorStats::Add, stats[i],
+                                    std::cref(*(stats[i + step]))));
+    for (size_t i = 0; i < threads.size(); i++)
+      threads[i].join();
+  }
+}
+
 
 double EstimateIvectorsOnline(
     const Matrix<BaseFloat> &feats,
@@ -32,6 +32,7 @@
 #include "itf/options-itf.h"
 #include "util/common-utils.h"
 #include "hmm/posterior.h"
+#include "cudamatrix/cu-matrix.h"
 
 namespace kaldi {
 
@@ -137,6 +138,7 @@ class IvectorExtractor {
  public:
   friend class IvectorExtractorStats;
   friend class OnlineIvectorEstimationStats;
+  friend class IvectorExtractorBatchComputer;
 
   IvectorExtractor(): prior_offset_(0.0) { }
 
@@ -482,7 +484,8 @@ class IvectorExtractorStats {
  public:
   friend class IvectorExtractor;
 
-  IvectorExtractorStats(): tot_auxf_(0.0), R_num_cached_(0), num_ivectors_(0) { }
+  IvectorExtractorStats(): tot_auxf_(0.0), R_num_cached_(0), use_gpu_(false),
+                           num_ivectors_(0) { }
 
   IvectorExtractorStats(const IvectorExtractor &extractor,
                         const IvectorExtractorStatsOptions &stats_opts);
@@ -503,6 +506,12 @@ class IvectorExtractorStats {
 
   void Read(std::istream &is, bool binary, bool add = false);
 
+  /// Flushes the cache of R_ stats, and if we are using a GPU, adds the stats
+  /// accumulated on the device to R_ and Y_.  This must be called before the
+  /// stats are read by the const Write(), Add() or Update(); the non-const
+  /// Write() calls it itself.
+  void Flush();
+
   void Write(std::ostream &os, bool binary); // non-const version; relates to cache.
 
   // const version of Write; may use extra memory if we have stuff cached
@@ -537,9 +546,13 @@ class IvectorExtractorStats {
                        const VectorBase<double> &ivec_mean,
                        const SpMatrix<double> &ivec_var);
 
-  /// Flushes the cache for the R_ stats.
+  /// Flushes the cache for the R_ stats (and, if we are using a GPU, for the
+  /// Y_ stats) into R_, or into R_cuda_ and Y_cuda_ on the device.
   void FlushCache();
 
+  /// Adds R_cuda_ and Y_cuda_ to R_ and Y_, and zeroes them.
+  void CopyStatsFromDevice();
+
   /// Commit the stats used to update the variance.
   void CommitStatsForSigma(const IvectorExtractor &extractor,
                            const IvectorExtractorUtteranceStats &utt_stats);
@@ -641,6 +654,23 @@ class IvectorExtractorStats {
   /// dimension: [num-to-cache][S*(S+1)/2]
   Matrix<double> R_ivec_scatter_cache_;
 
+  /// True if a GPU was in use when we were constructed; then the Y_ stats are
+  /// cached as well as the R_ stats, and the cache is flushed into R_cuda_ and
+  /// Y_cuda_ on the device with matrix multiplications, instead of into R_ and
+  /// Y_.  Only Flush() copies them back.
+  bool use_gpu_;
+  /// dimension: [num-to-cache][I*D]; row n is utt_stats.X_ for the n'th cached
+  /// utterance, as a vector.  Only used if use_gpu_.
+  Matrix<double> Y_X_cache_;
+  /// dimension: [num-to-cache][S]; the iVector means.  Only used if use_gpu_.
+  Matrix<double> Y_ivec_cache_;
+  /// The R_ stats accumulated on the device, of the same dimension as R_.
+  /// Guarded by R_lock_.
+  CuMatrix<double> R_cuda_;
+  /// The Y_ stats accumulated on the device; dimension is [I*D][S], i.e. the
+  /// Y_i stacked vertically.  Guarded by R_lock_.
+  CuMatrix<double> Y_cuda_;
+
   /// This mutex guards Q_ and G_ (for multi-threaded update)
   std::mutex weight_stats_lock_;
 
@@ -690,6 +720,15 @@ class IvectorExtractorStats {
 };
 
 
+/// Adds together the stats in "stats", leaving the sum in *(stats[0]).  They
+/// are added in pairs as a binary tree, with the additions at each level of the
+/// tree done in parallel threads, so N sets of stats are summed in about
+/// log2(N) times the time of one Add().  This is for when several threads have
+/// each accumulated stats into their own copy.  Calls Flush() on each of them
+/// first.
+void SumIvectorExtractorStats(const std::vector<IvectorExtractorStats*> &stats);
+
+
 
 }  // namespace kaldi
 
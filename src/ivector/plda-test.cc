@@ -22,6 +22,46 @@
 
 namespace kaldi {
 
+void UnitTestPldaBatchScorer(const Plda &plda) {
+  int32 dim = plda.Dim(), num_train = 1 + Rand() % 10,
+      num_test = 1 + Rand() % 10;
+  PldaConfig config;
+  Matrix<BaseFloat> train(num_train, dim), test(num_test, dim);
+  std::vector<int32> num_train_utts(num_train);
+  for (int32 i = 0; i < num_train; i++) {
+    Vector<BaseFloat> ivector(dim);
+    ivector.SetRandn();
+    num_train_utts[i] = 1 + Rand() % 5;
+    SubVector<BaseFloat> row(train, i);
+    plda.TransformIvector(config, ivector, num_train_utts[i], &row);
+  }
+  for (int32 j = 0; j < num_test; j++) {
+    Vector<BaseFloat> ivector(dim);
+    ivector.SetRandn();
+    SubVector<BaseFloat> row(test, j);
+    plda.TransformIvector(config, ivector, 1, &row);
+  }
+  PldaBatchScorer scorer(plda, train, num_train_utts, test);
+  Matrix<BaseFloat> scores(num_train, num_test);
+  scorer.ScoreAll(&scores);
+  std::vector<std::pair<int32, int32> > pairs;
+  for (int32 k = 0; k < 5; k++)
+    pairs.push_back(std::make_pair(Rand() % num_train, Rand() % num_test));
+  Vector<BaseFloat> pair_scores(pairs.size());
+  scorer.ScorePairs(pairs, &pair_scores);
+
+  for (int32 i = 0; i < num_train; i++) {
+    for (int32 j = 0; j < num_test; j++) {
+      double score = plda.LogLikelihoodRatio(Vector<double>(train.Row(i)),
+                                             num_train_utts[i],
+                                             Vector<double>(test.Row(j)));
+      KALDI_ASSERT(fabs(scores(i, j) - score) < 1.0e-03 * (1.0 + fabs(score)));
+    }
+  }
+  for (size_t k = 0; k < pairs.size(); k++)
+    AssertEqual(pair_scores(k), scores(pairs[k].first, pairs[k].second), 1.0e-04);
+}
+
 void UnitTestPldaEstimation(int32 dim) {
   int32 num_classes = 1000 + Rand() % 10;
   Matrix<double> between_proj(dim, dim);
@@ -87,6 +127,7 @@ void UnitTestPldaEstimation(int32 dim) {
               << "should be: " << s;
   }
 
+  UnitTestPldaBatchScorer(plda);
 }
 
 }
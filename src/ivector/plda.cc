@@ -20,6 +20,7 @@
 
 #include <vector>
 #include "ivector/plda.h"
+#include "cudamatrix/cu-array.h"
 
 namespace kaldi {
 
@@ -192,6 +193,77 @@ double Plda::LogLikelihoodRatio(
 }
 
 
+PldaBatchScorer::PldaBatchScorer(
+    const Plda &plda,
+    const MatrixBase<BaseFloat> &transformed_train_ivectors,
+    const std::vector<int32> &num_train_utts,
+    const MatrixBase<BaseFloat> &transformed_test_ivectors) {
+  int32 dim = plda.Dim(), num_train = transformed_train_ivectors.NumRows(),
+      num_test = transformed_test_ivectors.NumRows();
+  KALDI_ASSERT(transformed_train_ivectors.NumCols() == dim &&
+               transformed_test_ivectors.NumCols() == dim &&
+               num_train_utts.size() == static_cast<size_t>(num_train));
+  const Vector<double> &psi = plda.psi_;
+
+  Matrix<BaseFloat> train_rows(num_train, 2 * dim + 1, kUndefined);
+  for (int32 r = 0; r < num_train; r++) {
+    int32 n = num_train_utts[r];
+    KALDI_ASSERT(n > 0);
+    double c = 0.0;
+    for (int32 i = 0; i < dim; i++) {
+      double m = n * psi(i) / (n * psi(i) + 1.0),
+          s = 1.0 + psi(i) / (n * psi(i) + 1.0),
+          v = transformed_train_ivectors(r, i);
+      c += Log(1.0 + psi(i)) - Log(s) - m * m * v * v / s;
+      train_rows(r, 1 + i) = m * v / s;
+      train_rows(r, 1 + dim + i) = 0.5 / (1.0 + psi(i)) - 0.5 / s;
+    }
+    train_rows(r, 0) = 0.5 * c;
+  }
+  train_rows_.Swap(&train_rows);
+
+  Matrix<BaseFloat> test_rows(num_test, 2 * dim + 1, kUndefined);
+  test_rows.ColRange(0, 1).Set(1.0);
+  test_rows.ColRange(1, dim).CopyFromMat(transformed_test_ivectors);
+  test_rows.ColRange(1 + dim, dim).CopyFromMat(transformed_test_ivectors);
+  test_rows.ColRange(1 + dim, dim).ApplyPow(2.0);
+  test_rows_.Swap(&test_rows);
+}
+
+void PldaBatchScorer::ScoreAll(MatrixBase<BaseFloat> *scores) const {
+  KALDI_ASSERT(scores->NumRows() == NumTrain() &&
+               scores->NumCols() == NumTest());
+  CuMatrix<BaseFloat> scores_cuda(NumTrain(), NumTest(), kUndefined);
+  scores_cuda.AddMatMat(1.0, train_rows_, kNoTrans, test_rows_, kTrans, 0.0);
+  scores->CopyFromMat(scores_cuda);
+}
+
+void PldaBatchScorer::ScorePairs(
+    const std::vector<std::pair<int32, int32> > &pairs,
+    VectorBase<BaseFloat> *scores) const {
+  int32 num_pairs = pairs.size();
+  KALDI_ASSERT(scores->Dim() == num_pairs);
+  if (num_pairs == 0)
+    return;
+  std::vector<int32> train_indexes(num_pairs), test_indexes(num_pairs);
+  for (int32 k = 0; k < num_pairs; k++) {
+    KALDI_ASSERT(pairs[k].first >= 0 && pairs[k].first < NumTrain() &&
+                 pairs[k].second >= 0 && pairs[k].second < NumTest());
+    train_indexes[k] = pairs[k].first;
+    test_indexes[k] = pairs[k].second;
+  }
+  CuArray<int32> train_indexes_cuda(train_indexes),
+      test_indexes_cuda(test_indexes);
+  CuMatrix<BaseFloat> train(num_pairs, train_rows_.NumCols(), kUndefined),
+      test(num_pairs, test_rows_.NumCols(), kUndefined);
+  train.CopyRows(train_rows_, train_indexes_cuda);
+  test.CopyRows(test_rows_, test_indexes_cuda);
+  CuVector<BaseFloat> scores_cuda(num_pairs, kUndefined);
+  scores_cuda.AddDiagMatMat(1.0, train, kNoTrans, test, kTrans, 0.0);
+  scores->CopyFromVec(scores_cuda);
+}
+
+
 void Plda::SmoothWithinClassCovariance(double smoothing_factor) {
   KALDI_ASSERT(smoothing_factor >= 0.0 && smoothing_factor <= 1.0);
   // smoothing_factor > 1.0 is possible but wouldn't really make sense.
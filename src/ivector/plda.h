@@ -24,6 +24,7 @@
 
 #include <vector>
 #include <algorithm>
+#include <utility>
 #include "base/kaldi-common.h"
 #include "matrix/matrix-lib.h"
 #include "gmm/model-common.h"
@@ -31,6 +32,8 @@
 #include "gmm/full-gmm.h"
 #include "itf/options-itf.h"
 #include "util/common-utils.h"
+#include "cudamatrix/cu-matrix.h"
+#include "cudamatrix/cu-vector.h"
 
 namespace kaldi {
 
@@ -144,6 +147,7 @@ class Plda {
   void ComputeDerivedVars(); // computes offset_.
   friend class PldaEstimator;
   friend class PldaUnsupervisedAdaptor;
+  friend class PldaBatchScorer;
 
   Vector<double> mean_;  // mean of samples in original space.
   Matrix<double> transform_; // of dimension Dim() by Dim();
@@ -169,6 +173,56 @@ class Plda {
 };
 
 
+
+/**
+   PldaBatchScorer computes the same log-likelihood ratios as
+   Plda::LogLikelihoodRatio(), but for many pairs of train and test iVectors at
+   once, using matrix operations (on a GPU, if one is in use).  Expanding the
+   expression for the log-likelihood ratio (see the comment in plda.cc), for a
+   test iVector u and a train iVector v that is an average over n utterances
+   (both transformed by Plda::TransformIvector()), it equals
+     c(v, n) + \sum_i a_i(v, n) u_i + \sum_i b_i(n) u_i^2,
+   where, with m_i = n \Psi_i / (n \Psi_i + 1) and s_i = 1 + \Psi_i / (n \Psi_i + 1),
+     a_i = m_i v_i / s_i,    b_i = 0.5 / (1 + \Psi_i) - 0.5 / s_i,
+     c = 0.5 \sum_i [ log(1 + \Psi_i) - log(s_i) - m_i^2 v_i^2 / s_i ].
+   So we turn each train iVector into a row [ c a b ] and each test iVector into
+   a row [ 1 u u^2 ], once; then each log-likelihood ratio is a dot product of
+   two rows, and all of them together are a matrix multiplication.
+*/
+class PldaBatchScorer {
+ public:
+  /// "transformed_train_ivectors" and "transformed_test_ivectors" have the
+  /// iVectors (transformed by plda.TransformIvector()) as their rows, and
+  /// num_train_utts[i] is the number of utterances that the i'th train iVector
+  /// is an average over.  The same matrix may be given for both.
+  PldaBatchScorer(const Plda &plda,
+                  const MatrixBase<BaseFloat> &transformed_train_ivectors,
+                  const std::vector<int32> &num_train_utts,
+                  const MatrixBase<BaseFloat> &transformed_test_ivectors);
+
+  int32 NumTrain() const { return train_rows_.NumRows(); }
+  int32 NumTest() const { return test_rows_.NumRows(); }
+
+  /// Computes the log-likelihood ratios for all pairs: (*scores)(i, j) is the
+  /// log-likelihood ratio of test iVector j against train iVector i.  "scores"
+  /// must be NumTrain() by NumTest().
+  void ScoreAll(MatrixBase<BaseFloat> *scores) const;
+
+  /// Computes the log-likelihood ratios for the given pairs only: (*scores)(k)
+  /// is that of test iVector pairs[k].second against train iVector
+  /// pairs[k].first.  This is for trials lists, which normally have only a
+  /// small part of all the pairs.
+  void ScorePairs(const std::vector<std::pair<int32, int32> > &pairs,
+                  VectorBase<BaseFloat> *scores) const;
+
+ private:
+  CuMatrix<BaseFloat> train_rows_;  // Rows [ c a b ], see above.
+  CuMatrix<BaseFloat> test_rows_;  // Rows [ 1 u u^2 ].
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(PldaBatchScorer);
+};
+
+
 class PldaStats {
  public:
   PldaStats(): dim_(0) { } /// The dimension is set up the first time you add samples.
@@ -62,10 +62,12 @@ int main(int argc, char *argv[]) {
       " similarity matrix.");
     po.Register("first-pass-max-utterances", &first_pass_max_utterances,
       "If the number of utterances is larger than first-pass-max-utterances,"
-      " then clustering is done in two passes. In the first pass, input points"
-      " are divided into contiguous subsets of size first-pass-max-utterances"
-      " and each subset is clustered separately. In the second pass, the first"
-      " pass clusters are merged into the final set of clusters.");
+      " then input points are first divided into contiguous windows of size"
+      " first-pass-max-utterances and each window is clustered separately;"
+      " this is repeated on windows of the resulting clusters until there are"
+      " at most first-pass-max-utterances, which are merged into the final set"
+      " of clusters.  Memory use is about 2 * first-pass-max-utterances^2"
+      " bytes, on top of the score matrix.");
     po.Register("max-spk-fraction", &max_spk_fraction, "Merge clusters if the"
       " total fraction of utterances in them is less than this threshold."
       " This is active only when reco2num-spk-rspecifier is supplied and"
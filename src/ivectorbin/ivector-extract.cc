@@ -22,7 +22,9 @@
 #include "util/common-utils.h"
 #include "gmm/am-diag-gmm.h"
 #include "ivector/ivector-extractor.h"
+#include "ivector/ivector-extractor-batch.h"
 #include "util/kaldi-thread.h"
+#include "cudamatrix/cu-device.h"
 
 namespace kaldi {
 
@@ -89,6 +91,38 @@ class IvectorExtractTask {
   double auxf_change_;
 };
 
+// Computes and writes out the iVectors of the utterances in a batch, and
+// clears the batch; this is used instead of IvectorExtractTask when we are
+// using a GPU.
+void FlushIvectorBatch(const IvectorExtractorBatchComputer &batch_computer,
+                       std::vector<std::string> *utts,
+                       std::vector<Matrix<BaseFloat> > *feats,
+                       std::vector<Posterior> *posteriors,
+                       BaseFloatVectorWriter *writer) {
+  int32 num_utts = utts->size();
+  if (num_utts == 0)
+    return;
+  std::vector<const MatrixBase<BaseFloat>*> feats_ptrs(num_utts);
+  std::vector<const Posterior*> posterior_ptrs(num_utts);
+  for (int32 i = 0; i < num_utts; i++) {
+    feats_ptrs[i] = &((*feats)[i]);
+    posterior_ptrs[i] = &((*posteriors)[i]);
+  }
+  Matrix<BaseFloat> ivectors;
+  batch_computer.ComputeIvectors(feats_ptrs, posterior_ptrs, &ivectors);
+  // As in IvectorExtractTask, we write out the offset of the iVectors from
+  // the mean of the prior distribution.
+  ivectors.ColRange(0, 1).Add(-batch_computer.PriorOffset());
+  for (int32 i = 0; i < num_utts; i++) {
+    KALDI_VLOG(2) << "Ivector norm for utterance " << (*utts)[i]
+                  << " was " << ivectors.Row(i).Norm(2.0);
+    writer->Write((*utts)[i], Vector<BaseFloat>(ivectors.Row(i)));
+  }
+  utts->clear();
+  feats->clear();
+  posteriors->clear();
+}
+
 int32 RunPerSpeaker(const std::string &ivector_extractor_rxfilename,
                    const IvectorEstimationOptions &opts,
                    bool compute_objf_change,
@@ -226,6 +260,8 @@ int main(int argc, char *argv[]) {
     IvectorEstimationOptions opts;
     std::string spk2utt_rspecifier;
     TaskSequencerConfig sequencer_config;
+    std::string use_gpu = "no";
+    int32 batch_size = 128;
     po.Register("compute-objf-change", &compute_objf_change,
                 "If true, compute the change in objective function from using "
                 "nonzero iVector (a potentially useful diagnostic).  Combine "
@@ -237,6 +273,16 @@ int main(int argc, char *argv[]) {
                 "This option will cause the program to ignore the --num-threads "
                 "option.");
 
+    po.Register("use-gpu", &use_gpu,
+                "yes|no|optional|wait, only has effect if compiled with CUDA.  "
+                "If a GPU is used, the iVectors are computed in batches of "
+                "--batch-size utterances (not supported with --spk2utt, or "
+                "with extractors that have iVector-dependent weights), and "
+                "--compute-objf-change is ignored.");
+    po.Register("batch-size", &batch_size,
+                "Number of utterances whose iVectors are computed together "
+                "when using a GPU.");
+
     opts.Register(&po);
     sequencer_config.Register(&po);
 
@@ -253,6 +299,10 @@ int main(int argc, char *argv[]) {
         ivectors_wspecifier = po.GetArg(4);
 
 
+#if HAVE_CUDA==1
+    CuDevice::Instantiate().SelectGpuId(use_gpu);
+#endif
+
     if (spk2utt_rspecifier.empty()) {
       // g_num_threads affects how ComputeDerivedVars is called when we read the
       // extractor.
@@ -260,6 +310,27 @@ int main(int argc, char *argv[]) {
       IvectorExtractor extractor;
       ReadKaldiObject(ivector_extractor_rxfilename, &extractor);
 
+      // If we are using a GPU, we compute the iVectors in batches.
+      bool use_batches = false;
+#if HAVE_CUDA==1
+      use_batches = CuDevice::Instantiate().Enabled();
+#endif
+      if (use_batches && extractor.IvectorDependentWeights()) {
+        KALDI_WARN << "Not computing iVectors on the GPU, as the extractor "
+                   << "has iVector-dependent weights.";
+        use_batches = false;
+      }
+      if (use_batches) {
+        if (batch_size <= 0)
+          KALDI_ERR << "--batch-size must be positive.";
+        compute_objf_change = false;
+      }
+      IvectorExtractorBatchComputer *batch_computer = (use_batches ?
+          new IvectorExtractorBatchComputer(extractor) : NULL);
+      std::vector<std::string> batch_utts;
+      std::vector<Matrix<BaseFloat> > batch_feats;
+      std::vector<Posterior> batch_posteriors;
+
       double tot_auxf_change = 0.0, tot_t = 0.0;
       int32 num_done = 0, num_err = 0;
 
@@ -302,14 +373,31 @@ int main(int argc, char *argv[]) {
                          &posterior);
           // note: now, this_t == sum of posteriors.
 
-          sequencer.Run(new IvectorExtractTask(extractor, utt, mat, posterior,
-                                               &ivector_writer, auxf_ptr));
+          if (use_batches) {
+            batch_utts.push_back(utt);
+            batch_feats.push_back(mat);
+            batch_posteriors.push_back(posterior);
+            if (static_cast<int32>(batch_utts.size()) == batch_size)
+              FlushIvectorBatch(*batch_computer, &batch_utts, &batch_feats,
+                                &batch_posteriors, &ivector_writer);
+          } else {
+            sequencer.Run(new IvectorExtractTask(extractor, utt, mat,
+                                                 posterior, &ivector_writer,
+                                                 auxf_ptr));
+          }
 
           tot_t += this_t;
           num_done++;
         }
+        if (use_batches)
+          FlushIvectorBatch(*batch_computer, &batch_utts, &batch_feats,
+                            &batch_posteriors, &ivector_writer);
         // Destructor of "sequencer" will wait for any remaining tasks.
       }
+      delete batch_computer;
+#if HAVE_CUDA==1
+      CuDevice::Instantiate().PrintProfile();
+#endif
 
       KALDI_LOG << "Done " << num_done << " files, " << num_err
                 << " with errors.  Total (weighted) frames " << tot_t;
@@ -17,16 +17,63 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <mutex>
+#include <vector>
 
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
 #include "gmm/am-diag-gmm.h"
 #include "ivector/ivector-extractor.h"
 #include "util/kaldi-thread.h"
+#include "cudamatrix/cu-device.h"
 
 
 namespace kaldi {
 
+// This class holds the copies of the stats that the threads accumulate into.
+// Each task takes the copy that fewest other tasks are using, so if there are
+// at least as many copies as threads, no two threads ever accumulate into the
+// same copy at once and they never wait for each other's locks.
+class IvectorStatsPool {
+ public:
+  IvectorStatsPool(const IvectorExtractor &extractor,
+                   const IvectorExtractorStatsOptions &stats_opts,
+                   int32 num_copies): num_users_(num_copies, 0) {
+    KALDI_ASSERT(num_copies > 0);
+    for (int32 i = 0; i < num_copies; i++)
+      stats_.push_back(new IvectorExtractorStats(extractor, stats_opts));
+  }
+
+  IvectorExtractorStats *Acquire() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t best = std::min_element(num_users_.begin(), num_users_.end()) -
+        num_users_.begin();
+    num_users_[best]++;
+    return stats_[best];
+  }
+
+  void Release(IvectorExtractorStats *stats) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t i = std::find(stats_.begin(), stats_.end(), stats) - stats_.begin();
+    KALDI_ASSERT(i < stats_.size() && num_users_[i] > 0);
+    num_users_[i]--;
+  }
+
+  // Sums all the copies (this should only be called once all the tasks are
+  // done), and returns the sum.
+  IvectorExtractorStats *Sum() {
+    SumIvectorExtractorStats(stats_);
+    return stats_[0];
+  }
+
+  ~IvectorStatsPool() { DeletePointers(&stats_); }
+ private:
+  std::mutex mutex_;
+  std::vector<IvectorExtractorStats*> stats_;
+  std::vector<int32> num_users_;
+};
+
 // this class is used to run the command
 //  stats.AccStatsForUtterance(extractor, mat, posterior);
 // in parallel.
@@ -35,13 +82,15 @@ class IvectorTask {
   IvectorTask(const IvectorExtractor &extractor,
               const Matrix<BaseFloat> &features,
               const Posterior &posterior,
-              IvectorExtractorStats *stats): extractor_(extractor),
-                                    features_(features),
-                                    posterior_(posterior),
-                                    stats_(stats) { }
+              IvectorStatsPool *pool): extractor_(extractor),
+                                       features_(features),
+                                       posterior_(posterior),
+                                       pool_(pool) { }
 
   void operator () () {
-    stats_->AccStatsForUtterance(extractor_, features_, posterior_);
+    IvectorExtractorStats *stats = pool_->Acquire();
+    stats->AccStatsForUtterance(extractor_, features_, posterior_);
+    pool_->Release(stats);
   }
   ~IvectorTask() { }  // the destructor doesn't have to do anything.
  private:
@@ -50,7 +99,7 @@ class IvectorTask {
                                // Table and the reference we get from that is
                                // not valid long-term.
   Posterior posterior_;  // as above.
-  IvectorExtractorStats *stats_;
+  IvectorStatsPool *pool_;
 };
 
 
@@ -67,8 +116,10 @@ int main(int argc, char *argv[]) {
     const char *usage =
         "Accumulate stats for iVector extractor training\n"
         "Reads in features and Gaussian-level posteriors (typically from a full GMM)\n"
-        "Supports multiple threads, but won't be able to make use of too many at a time\n"
-        "(e.g. more than about 4)\n"
+        "Supports multiple threads; to make use of more than a few, set\n"
+        "--num-stats-copies to the number of threads, so that each thread accumulates\n"
+        "into its own copy of the stats (this takes that many times the memory).\n"
+        "With --use-gpu=yes, the stats for the projections are accumulated on the GPU.\n"
         "Usage:  ivector-extractor-acc-stats [options] <model-in> <feature-rspecifier>"
         "<posteriors-rspecifier> <stats-out>\n"
         "e.g.: \n"
@@ -79,7 +130,15 @@ int main(int argc, char *argv[]) {
     bool binary = true;
     IvectorExtractorStatsOptions stats_opts;
     TaskSequencerConfig sequencer_opts;
+    int32 num_stats_copies = 1;
+    std::string use_gpu = "no";
     po.Register("binary", &binary, "Write output in binary mode");
+    po.Register("num-stats-copies", &num_stats_copies, "Number of copies of "
+                "the stats that the threads accumulate into, which are added "
+                "together at the end; if it is at least --num-threads, the "
+                "threads don't have to wait for each other.");
+    po.Register("use-gpu", &use_gpu,
+                "yes|no|optional|wait, only has effect if compiled with CUDA");
     stats_opts.Register(&po);
     sequencer_opts.Register(&po);
 
@@ -109,10 +168,15 @@ int main(int argc, char *argv[]) {
     // goes to sequencer_opts in this case, copy it to g_num_threads.
     g_num_threads = sequencer_opts.num_threads;
 
+#if HAVE_CUDA==1
+    CuDevice::Instantiate().SelectGpuId(use_gpu);
+    CuDevice::Instantiate().AllowMultithreading();
+#endif
+
     IvectorExtractor extractor;
     ReadKaldiObject(ivector_extractor_rxfilename, &extractor);
 
-    IvectorExtractorStats stats(extractor, stats_opts);
+    IvectorStatsPool pool(extractor, stats_opts, num_stats_copies);
 
 
     int64 tot_t = 0;
@@ -139,7 +203,7 @@ int main(int argc, char *argv[]) {
           continue;
         }
 
-        sequencer.Run(new IvectorTask(extractor, mat, posterior, &stats));
+        sequencer.Run(new IvectorTask(extractor, mat, posterior, &pool));
 
         tot_t += posterior.size();
         num_done++;
@@ -153,8 +217,11 @@ int main(int argc, char *argv[]) {
 
     {
       Output ko(accs_wxfilename, binary);
-      stats.Write(ko.Stream(), binary);
+      pool.Sum()->Write(ko.Stream(), binary);
     }
+#if HAVE_CUDA==1
+    CuDevice::Instantiate().PrintProfile();
+#endif
 
     KALDI_LOG << "Wrote stats to " << accs_wxfilename;
 
@@ -23,6 +23,7 @@
 #include "util/common-utils.h"
 #include "util/stl-utils.h"
 #include "ivector/plda.h"
+#include "cudamatrix/cu-device.h"
 
 namespace kaldi {
 
@@ -131,6 +132,7 @@ int main(int argc, char *argv[]) {
 
     ParseOptions po(usage);
     BaseFloat target_energy = 0.5;
+    std::string use_gpu = "no";
     PldaConfig plda_config;
     plda_config.Register(&po);
 
@@ -138,6 +140,8 @@ int main(int argc, char *argv[]) {
       "Reduce dimensionality of i-vectors using a recording-dependent"
       " PCA such that this fraction of the total energy remains.");
     KALDI_ASSERT(target_energy <= 1.0);
+    po.Register("use-gpu", &use_gpu,
+                "yes|no|optional|wait, only has effect if compiled with CUDA");
 
     po.Read(argc, argv);
 
@@ -151,6 +155,10 @@ int main(int argc, char *argv[]) {
       ivector_rspecifier = po.GetArg(3),
       scores_wspecifier = po.GetArg(4);
 
+#if HAVE_CUDA==1
+    CuDevice::Instantiate().SelectGpuId(use_gpu);
+#endif
+
     Plda plda;
     ReadKaldiObject(plda_rxfilename, &plda);
 
@@ -205,13 +213,10 @@ int main(int argc, char *argv[]) {
           TransformIvectors(ivector_mat, plda_config, this_plda,
           &ivector_mat_plda);
         }
-        for (int32 i = 0; i < ivector_mat_plda.NumRows(); i++) {
-          for (int32 j = 0; j < ivector_mat_plda.NumRows(); j++) {
-            scores(i, j) = this_plda.LogLikelihoodRatio(Vector<double>(
-              ivector_mat_plda.Row(i)), 1.0,
-              Vector<double>(ivector_mat_plda.Row(j)));
-          }
-        }
+        std::vector<int32> num_utts(ivector_mat_plda.NumRows(), 1);
+        PldaBatchScorer scorer(this_plda, ivector_mat_plda, num_utts,
+                               ivector_mat_plda);
+        scorer.ScoreAll(&scores);
         scores_writer.Write(reco, scores);
         num_reco_done++;
       }
@@ -17,11 +17,36 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <utility>
+#include <vector>
 
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
 #include "ivector/plda.h"
+#include "cudamatrix/cu-device.h"
+
+namespace kaldi {
+
+// Scores the trials in "pairs" (pairs of indexes into the train and test
+// iVectors) with "scorer", writes them with their keys, and clears them.
+void ScoreTrials(const PldaBatchScorer &scorer,
+                 const std::vector<std::string> &train_keys,
+                 const std::vector<std::string> &test_keys,
+                 std::vector<std::pair<int32, int32> > *pairs,
+                 double *sum, double *sumsq, std::ostream &os) {
+  Vector<BaseFloat> scores(pairs->size());
+  scorer.ScorePairs(*pairs, &scores);
+  for (size_t k = 0; k < pairs->size(); k++) {
+    BaseFloat score = scores(k);
+    *sum += score;
+    *sumsq += score * score;
+    os << train_keys[(*pairs)[k].first] << ' '
+       << test_keys[(*pairs)[k].second] << ' ' << score << std::endl;
+  }
+  pairs->clear();
+}
 
+}  // namespace kaldi
 
 int main(int argc, char *argv[]) {
   using namespace kaldi;
@@ -46,16 +71,24 @@ int main(int argc, char *argv[]) {
         "\n"
         "e.g.: ivector-plda-scoring --num-utts=ark:exp/train/num_utts.ark plda "
         "ark:exp/train/spk_ivectors.ark ark:exp/test/ivectors.ark trials scores\n"
+        "The trials are scored in batches (see --batch-size), with matrix\n"
+        "operations that run on a GPU if --use-gpu=yes.\n"
         "See also: ivector-compute-dot-products, ivector-compute-plda\n";
 
     ParseOptions po(usage);
 
     std::string num_utts_rspecifier;
+    int32 batch_size = 10000;
+    std::string use_gpu = "no";
 
     PldaConfig plda_config;
     plda_config.Register(&po);
     po.Register("num-utts", &num_utts_rspecifier, "Table to read the number of "
                 "utterances per speaker, e.g. ark:num_utts.ark\n");
+    po.Register("batch-size", &batch_size, "Number of trials to score at a "
+                "time.");
+    po.Register("use-gpu", &use_gpu,
+                "yes|no|optional|wait, only has effect if compiled with CUDA");
 
     po.Read(argc, argv);
 
@@ -76,6 +109,11 @@ int main(int argc, char *argv[]) {
 
     int64 num_trials_done = 0, num_trials_err = 0;
 
+    KALDI_ASSERT(batch_size > 0);
+#if HAVE_CUDA==1
+    CuDevice::Instantiate().SelectGpuId(use_gpu);
+#endif
+
     Plda plda;
     ReadKaldiObject(plda_rxfilename, &plda);
 
@@ -85,18 +123,21 @@ int main(int argc, char *argv[]) {
     SequentialBaseFloatVectorReader test_ivector_reader(test_ivector_rspecifier);
     RandomAccessInt32Reader num_utts_reader(num_utts_rspecifier);
 
-    typedef unordered_map<string, Vector<BaseFloat>*, StringHasher> HashType;
+    typedef unordered_map<string, int32, StringHasher> HashType;
 
-    // These hashes will contain the iVectors in the PLDA subspace
-    // (that makes the within-class variance unit and diagonalizes the
-    // between-class covariance).  They will also possibly be length-normalized,
-    // depending on the config.
-    HashType train_ivectors, test_ivectors;
+    // These will contain the iVectors in the PLDA subspace (that makes the
+    // within-class variance unit and diagonalizes the between-class
+    // covariance).  They will also possibly be length-normalized, depending on
+    // the config.  The hashes map the keys to their indexes.
+    std::vector<Vector<BaseFloat>*> train_ivectors, test_ivectors;
+    std::vector<string> train_keys, test_keys;
+    std::vector<int32> num_train_utts;
+    HashType train_index, test_index;
 
     KALDI_LOG << "Reading train iVectors";
     for (; !train_ivector_reader.Done(); train_ivector_reader.Next()) {
       std::string spk = train_ivector_reader.Key();
-      if (train_ivectors.count(spk) != 0) {
+      if (train_index.count(spk) != 0) {
         KALDI_ERR << "Duplicate training iVector found for speaker " << spk;
       }
       const Vector<BaseFloat> &ivector = train_ivector_reader.Value();
@@ -116,7 +157,10 @@ int main(int argc, char *argv[]) {
       tot_train_renorm_scale += plda.TransformIvector(plda_config, ivector,
                                                       num_examples,
                                                       transformed_ivector);
-      train_ivectors[spk] = transformed_ivector;
+      train_index[spk] = train_ivectors.size();
+      train_ivectors.push_back(transformed_ivector);
+      train_keys.push_back(spk);
+      num_train_utts.push_back(num_examples);
       num_train_ivectors++;
     }
     KALDI_LOG << "Read " << num_train_ivectors << " training iVectors, "
@@ -129,7 +173,7 @@ int main(int argc, char *argv[]) {
     KALDI_LOG << "Reading test iVectors";
     for (; !test_ivector_reader.Done(); test_ivector_reader.Next()) {
       std::string utt = test_ivector_reader.Key();
-      if (test_ivectors.count(utt) != 0) {
+      if (test_index.count(utt) != 0) {
         KALDI_ERR << "Duplicate test iVector found for utterance " << utt;
       }
       const Vector<BaseFloat> &ivector = test_ivector_reader.Value();
@@ -141,7 +185,9 @@ int main(int argc, char *argv[]) {
       tot_test_renorm_scale += plda.TransformIvector(plda_config, ivector,
                                                      num_examples,
                                                      transformed_ivector);
-      test_ivectors[utt] = transformed_ivector;
+      test_index[utt] = test_ivectors.size();
+      test_ivectors.push_back(transformed_ivector);
+      test_keys.push_back(utt);
       num_test_ivectors++;
     }
     KALDI_LOG << "Read " << num_test_ivectors << " test iVectors.";
@@ -151,12 +197,26 @@ int main(int argc, char *argv[]) {
               << (tot_test_renorm_scale / num_test_ivectors);
 
 
+    PldaBatchScorer *scorer;
+    {
+      Matrix<BaseFloat> train_mat(train_ivectors.size(), dim, kUndefined),
+          test_mat(test_ivectors.size(), dim, kUndefined);
+      for (size_t i = 0; i < train_ivectors.size(); i++)
+        train_mat.Row(i).CopyFromVec(*(train_ivectors[i]));
+      for (size_t i = 0; i < test_ivectors.size(); i++)
+        test_mat.Row(i).CopyFromVec(*(test_ivectors[i]));
+      DeletePointers(&train_ivectors);
+      DeletePointers(&test_ivectors);
+      scorer = new PldaBatchScorer(plda, train_mat, num_train_utts, test_mat);
+    }
+
     Input ki(trials_rxfilename);
     bool binary = false;
     Output ko(scores_wxfilename, binary);
 
     double sum = 0.0, sumsq = 0.0;
     std::string line;
+    std::vector<std::pair<int32, int32> > pairs;
 
     while (std::getline(ki.Stream(), line)) {
       std::vector<std::string> fields;
@@ -166,47 +226,27 @@ int main(int argc, char *argv[]) {
                   << "in input (expected two fields: key1 key2): " << line;
       }
       std::string key1 = fields[0], key2 = fields[1];
-      if (train_ivectors.count(key1) == 0) {
+      HashType::const_iterator train_iter = train_index.find(key1),
+          test_iter = test_index.find(key2);
+      if (train_iter == train_index.end()) {
         KALDI_WARN << "Key " << key1 << " not present in training iVectors.";
         num_trials_err++;
         continue;
       }
-      if (test_ivectors.count(key2) == 0) {
+      if (test_iter == test_index.end()) {
         KALDI_WARN << "Key " << key2 << " not present in test iVectors.";
         num_trials_err++;
         continue;
       }
-      const Vector<BaseFloat> *train_ivector = train_ivectors[key1],
-          *test_ivector = test_ivectors[key2];
-
-      Vector<double> train_ivector_dbl(*train_ivector),
-          test_ivector_dbl(*test_ivector);
-
-      int32 num_train_examples;
-      if (!num_utts_rspecifier.empty()) {
-        // we already checked that it has this key.
-        num_train_examples = num_utts_reader.Value(key1);
-      } else {
-        num_train_examples = 1;
-      }
-
-
-      BaseFloat score = plda.LogLikelihoodRatio(train_ivector_dbl,
-                                                num_train_examples,
-                                                test_ivector_dbl);
-      sum += score;
-      sumsq += score * score;
+      pairs.push_back(std::make_pair(train_iter->second, test_iter->second));
       num_trials_done++;
-      ko.Stream() << key1 << ' ' << key2 << ' ' << score << std::endl;
+      if (static_cast<int32>(pairs.size()) == batch_size)
+        ScoreTrials(*scorer, train_keys, test_keys, &pairs, &sum, &sumsq,
+                    ko.Stream());
     }
-
-    for (HashType::iterator iter = train_ivectors.begin();
-         iter != train_ivectors.end(); ++iter)
-      delete iter->second;
-    for (HashType::iterator iter = test_ivectors.begin();
-         iter != test_ivectors.end(); ++iter)
-      delete iter->second;
-
+    ScoreTrials(*scorer, train_keys, test_keys, &pairs, &sum, &sumsq,
+                ko.Stream());
+    delete scorer;
 
     if (num_trials_done != 0) {
       BaseFloat mean = sum / num_trials_done, scatter = sumsq / num_trials_done,
@@ -216,6 +256,9 @@ int main(int argc, char *argv[]) {
     }
     KALDI_LOG << "Processed " << num_trials_done << " trials, " << num_trials_err
               << " had errors.";
+#if HAVE_CUDA==1
+    CuDevice::Instantiate().PrintProfile();
+#endif
     return (num_trials_done != 0 ? 0 : 1);
   } catch(const std::exception &e) {
     std::cerr << e.what();
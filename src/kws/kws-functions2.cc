@@ -18,6 +18,8 @@
 // limitations under the License.
 
 
+#include <algorithm>
+
 #include "lat/lattice-functions.h"
 #include "kws/kws-functions.h"
 #include "fstext/determinize-star.h"
@@ -50,6 +52,30 @@ static void ReplaceSymbolWithEpsilon(typename Arc::Label symbol,
   }
 }
 
+// Returns true if 'fst' (an encoded acceptor) has no epsilon arcs and no
+// state with two arcs with the same label, in which case determinizing it
+// would not change it other than renumbering its states.
+template<class Arc>
+static bool IsDeterministicAcceptor(const fst::VectorFst<Arc> &fst) {
+  typedef typename Arc::StateId StateId;
+  typedef typename Arc::Label Label;
+  std::vector<Label> labels;
+  for (StateId s = 0; s < fst.NumStates(); s++) {
+    labels.clear();
+    for (fst::ArcIterator<fst::VectorFst<Arc> > aiter(fst, s);
+         !aiter.Done(); aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      if (arc.ilabel == 0)
+        return false;
+      labels.push_back(arc.ilabel);
+    }
+    std::sort(labels.begin(), labels.end());
+    if (std::adjacent_find(labels.begin(), labels.end()) != labels.end())
+      return false;
+  }
+  return true;
+}
+
 void DoFactorMerging(KwsProductFst *factor_transducer,
                      KwsLexicographicFst *index_transducer) {
   using namespace fst;
@@ -72,9 +98,14 @@ void DoFactorMerging(KwsProductFst *factor_transducer,
   MaybeDoSanityCheck(*factor_transducer);
 
   // Use DeterminizeStar
-  KALDI_VLOG(2) << "DoFactorMerging: determinization...";
   KwsProductFst dest_transducer;
-  DeterminizeStar(*factor_transducer, &dest_transducer);
+  if (IsDeterministicAcceptor(*factor_transducer)) {
+    KALDI_VLOG(2) << "DoFactorMerging: already deterministic.";
+    dest_transducer = *factor_transducer;
+  } else {
+    KALDI_VLOG(2) << "DoFactorMerging: determinization...";
+    DeterminizeStar(*factor_transducer, &dest_transducer);
+  }
 
   MaybeDoSanityCheck(dest_transducer);
 
@@ -120,10 +151,18 @@ void OptimizeFactorTransducer(KwsLexicographicFst *index_transducer,
   KwsLexicographicFst ifst = *index_transducer;
   EncodeMapper<KwsLexicographicArc> encoder(kEncodeLabels, ENCODE);
   Encode(&ifst, &encoder);
-  KALDI_VLOG(2) << "OptimizeFactorTransducer: determinization...";
-  if (allow_partial) {
+  if (IsDeterministicAcceptor(ifst)) {
+    // This is the usual case when no state of the lattice had two arcs with
+    // the same word in different clusters (e.g. for word-deterministic
+    // lattices whose arcs with the same word don't overlap in time), since
+    // DoFactorMerging() left the index deterministic on (word, cluster).
+    KALDI_VLOG(2) << "OptimizeFactorTransducer: already deterministic.";
+    *index_transducer = ifst;
+  } else if (allow_partial) {
+    KALDI_VLOG(2) << "OptimizeFactorTransducer: determinization...";
     DeterminizeStar(ifst, index_transducer, kDelta, NULL, max_states, true);
   } else {
+      KALDI_VLOG(2) << "OptimizeFactorTransducer: determinization...";
       try {
         DeterminizeStar(ifst, index_transducer, kDelta, NULL, max_states,
                         false);
@@ -0,0 +1,354 @@
+// kws/kws-index-search.cc
+
+// Copyright 2012-2015  Johns Hopkins University (Authors: Guoguo Chen,
+//                                                         Daniel Povey.
+//                                                         Yenda Trmal)
+//           2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+
+#ifndef _MSC_VER
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+#include "kws/kws-index-search.h"
+#include "util/kaldi-io.h"
+#include "util/text-utils.h"
+
+namespace kaldi {
+
+typedef KwsLexicographicArc Arc;
+typedef Arc::Weight Weight;
+typedef Arc::StateId StateId;
+
+void PrepareKwsIndexShard(KwsLexicographicFst *index, KwsIndexShard *shard) {
+  using namespace fst;
+  int32 label_count = 1;
+  std::unordered_map<uint64, int32> label_encoder;
+  shard->label_decoder.assign(1, 0);
+  for (StateIterator<KwsLexicographicFst> siter(*index);
+       !siter.Done(); siter.Next()) {
+    StateId state_id = siter.Value();
+    for (MutableArcIterator<KwsLexicographicFst>
+             aiter(index, state_id); !aiter.Done(); aiter.Next()) {
+      Arc arc = aiter.Value();
+      // Skip the non-final arcs
+      if (index->Final(arc.nextstate) == Weight::Zero())
+        continue;
+      // Encode the input and output label of the final arc, and this is the
+      // new output label for this arc; set the input label to <epsilon>
+      uint64 osymbol = EncodeKwsLabel(arc.ilabel, arc.olabel);
+      arc.ilabel = 0;
+      std::unordered_map<uint64, int32>::iterator iter =
+          label_encoder.find(osymbol);
+      if (iter == label_encoder.end()) {
+        arc.olabel = label_count;
+        label_encoder[osymbol] = label_count;
+        shard->label_decoder.push_back(osymbol);
+        label_count++;
+      } else {
+        arc.olabel = iter->second;
+      }
+      aiter.SetValue(arc);
+    }
+  }
+  ArcSort(index, ILabelCompare<Arc>());
+  delete shard->index;
+  shard->index = index;
+}
+
+void WriteKwsIndexShard(const KwsIndexShard &shard,
+                        const std::string &prefix) {
+  KALDI_ASSERT(shard.index != NULL);
+  std::string fst_filename = prefix + ".fst";
+  fst::ConstFst<Arc> const_fst(*shard.index);
+  std::ofstream os(fst_filename.c_str(),
+                   std::ios_base::out | std::ios_base::binary);
+  fst::FstWriteOptions opts(fst_filename);
+  opts.align = true;  // Needed for memory-mapping.
+  if (!os || !const_fst.Write(os, opts) || !os.flush())
+    KALDI_ERR << "Error writing index shard to " << fst_filename;
+  Output ko(prefix + ".labels", true);
+  WriteIntegerVector(ko.Stream(), true, shard.label_decoder);
+  ko.Close();
+}
+
+void ReadKwsIndexShard(const std::string &prefix, bool mmap,
+                       KwsIndexShard *shard) {
+  std::string fst_filename = prefix + ".fst";
+  std::ifstream is(fst_filename.c_str(),
+                   std::ios_base::in | std::ios_base::binary);
+  if (!is)
+    KALDI_ERR << "Could not open index shard " << fst_filename;
+  fst::FstReadOptions opts(fst_filename);
+  opts.mode = (mmap ? fst::FstReadOptions::MAP : fst::FstReadOptions::READ);
+  fst::ConstFst<Arc> *index = fst::ConstFst<Arc>::Read(is, opts);
+  if (index == NULL)
+    KALDI_ERR << "Error reading index shard from " << fst_filename;
+  delete shard->index;
+  shard->index = index;
+  bool binary;
+  Input ki(prefix + ".labels", &binary);
+  ReadIntegerVector(ki.Stream(), binary, &(shard->label_decoder));
+}
+
+void WriteKwsIndexShardList(const std::string &wxfilename,
+                            const std::vector<std::string> &prefixes) {
+  Output ko(wxfilename, false);
+  for (size_t i = 0; i < prefixes.size(); i++)
+    ko.Stream() << prefixes[i] << '\n';
+  ko.Close();
+}
+
+void ReadKwsIndexShardList(const std::string &rxfilename,
+                           std::vector<std::string> *prefixes) {
+  prefixes->clear();
+  Input ki(rxfilename);
+  std::string line;
+  while (std::getline(ki.Stream(), line)) {
+    Trim(&line);
+    if (!line.empty())
+      prefixes->push_back(line);
+  }
+  if (prefixes->empty())
+    KALDI_ERR << "No index shards listed in " << rxfilename;
+}
+
+std::string NextKwsIndexShardPrefix(const std::string &shard_prefix) {
+  for (int32 n = 0; ; n++) {
+    std::ostringstream os;
+    os << shard_prefix << '.' << n;
+    std::ifstream is((os.str() + ".fst").c_str());
+    if (!is.is_open())
+      return os.str();
+  }
+}
+
+namespace {
+
+// Holds an exclusive lock on a file while it exists.
+class KwsShardListLock {
+ public:
+  explicit KwsShardListLock(const std::string &filename): fd_(-1) {
+#ifndef _MSC_VER
+    fd_ = open(filename.c_str(), O_RDWR | O_CREAT, 0666);
+    if (fd_ < 0 || flock(fd_, LOCK_EX) != 0)
+      KALDI_ERR << "Could not lock " << filename << ": " << strerror(errno);
+#endif
+  }
+  ~KwsShardListLock() {
+#ifndef _MSC_VER
+    if (fd_ >= 0)
+      close(fd_);  // This releases the lock.
+#endif
+  }
+ private:
+  int fd_;
+};
+
+}  // namespace
+
+void UpdateKwsIndexShardList(const std::string &list_filename,
+                             const std::vector<std::string> &remove,
+                             const std::vector<std::string> &add) {
+  KwsShardListLock lock(list_filename + ".lock");
+  std::vector<std::string> prefixes;
+  {
+    std::ifstream is(list_filename.c_str());
+    std::string line;
+    while (std::getline(is, line)) {
+      Trim(&line);
+      if (!line.empty())
+        prefixes.push_back(line);
+    }
+  }
+  std::vector<std::string> new_prefixes;
+  bool added = false;
+  for (size_t i = 0; i < prefixes.size(); i++) {
+    if (std::find(remove.begin(), remove.end(), prefixes[i]) == remove.end()) {
+      new_prefixes.push_back(prefixes[i]);
+    } else if (!added) {
+      new_prefixes.insert(new_prefixes.end(), add.begin(), add.end());
+      added = true;
+    }
+  }
+  if (new_prefixes.size() + remove.size() != prefixes.size() +
+      (added ? add.size() : 0))
+    KALDI_ERR << "Some of the shards to be removed are not in "
+              << list_filename;
+  if (!added)
+    new_prefixes.insert(new_prefixes.end(), add.begin(), add.end());
+
+  // The temporary file is in the same directory, so rename() can't fail
+  // because of crossing file systems.
+  std::ostringstream tmp_filename;
+  tmp_filename << list_filename << ".tmp." << getpid();
+  WriteKwsIndexShardList(tmp_filename.str(), new_prefixes);
+  if (std::rename(tmp_filename.str().c_str(), list_filename.c_str()) != 0) {
+    std::remove(tmp_filename.str().c_str());
+    KALDI_ERR << "Could not rename " << tmp_filename.str() << " to "
+              << list_filename << ": " << strerror(errno);
+  }
+}
+
+void UnprepareKwsIndexShard(const KwsIndexShard &shard,
+                            KwsLexicographicFst *index) {
+  using namespace fst;
+  KALDI_ASSERT(shard.index != NULL);
+  *index = KwsLexicographicFst(*shard.index);
+  for (StateIterator<KwsLexicographicFst> siter(*index);
+       !siter.Done(); siter.Next()) {
+    StateId state_id = siter.Value();
+    for (MutableArcIterator<KwsLexicographicFst>
+             aiter(index, state_id); !aiter.Done(); aiter.Next()) {
+      Arc arc = aiter.Value();
+      // PrepareKwsIndexShard() relabeled exactly the arcs to final states.
+      if (index->Final(arc.nextstate) == Weight::Zero())
+        continue;
+      KALDI_ASSERT(arc.ilabel == 0 && arc.olabel > 0 &&
+                   arc.olabel < shard.label_decoder.size());
+      uint64 osymbol = shard.label_decoder[arc.olabel];
+      arc.ilabel = static_cast<int32>(osymbol & 0xFFFFFFFF);
+      arc.olabel = DecodeKwsLabelUid(osymbol);
+      aiter.SetValue(arc);
+    }
+  }
+}
+
+
+namespace {
+
+struct ActivePath {
+  std::vector<Arc::Label> path;
+  Weight weight;
+  Arc::Label last;
+};
+
+void GenerateActivePaths(const KwsLexicographicFst &proxy,
+                         std::vector<ActivePath> *paths,
+                         StateId cur_state,
+                         std::vector<Arc::Label> cur_path,
+                         Weight cur_weight) {
+  for (fst::ArcIterator<KwsLexicographicFst> aiter(proxy, cur_state);
+       !aiter.Done(); aiter.Next()) {
+    const Arc &arc = aiter.Value();
+    Weight temp_weight = Times(arc.weight, cur_weight);
+
+    cur_path.push_back(arc.ilabel);
+
+    if (arc.olabel != 0) {
+      ActivePath path;
+      path.path = cur_path;
+      path.weight = temp_weight;
+      path.last = arc.olabel;
+      paths->push_back(path);
+    } else {
+      GenerateActivePaths(proxy, paths,
+                          arc.nextstate, cur_path, temp_weight);
+    }
+    cur_path.pop_back();
+  }
+}
+
+void GetDetailedStatistics(const KwsLexicographicFst &keyword,
+                           const std::vector<uint64> &label_decoder,
+                           std::vector<std::vector<double> > *stats) {
+  if (keyword.Start() == fst::kNoStateId)
+    return;
+
+  std::vector<ActivePath> paths;
+  GenerateActivePaths(keyword, &paths, keyword.Start(),
+                      std::vector<Arc::Label>(), Weight::One());
+
+  for (size_t i = 0; i < paths.size(); ++i) {
+    std::vector<double> out;
+    uint64 osymbol = label_decoder[paths[i].last];
+    out.push_back(DecodeKwsLabelUid(osymbol));
+    out.push_back(paths[i].weight.Value2().Value1().Value());
+    out.push_back(paths[i].weight.Value2().Value2().Value());
+    out.push_back(paths[i].weight.Value1().Value());
+    for (size_t j = 0; j < paths[i].path.size(); ++j)
+      out.push_back(paths[i].path[j]);
+    stats->push_back(out);
+  }
+}
+
+}  // namespace
+
+
+int32 SearchKwsIndexShard(const KwsLexicographicFst &keyword,
+                          const KwsIndexShard &shard,
+                          int32 n_best,
+                          std::vector<KwsHit> *hits,
+                          std::vector<std::vector<double> > *stats) {
+  using namespace fst;
+  KALDI_ASSERT(shard.index != NULL);
+  KwsLexicographicFst result_fst;
+  Compose(keyword, *shard.index, &result_fst);
+
+  if (stats != NULL)
+    GetDetailedStatistics(result_fst, shard.label_decoder, stats);
+
+  Project(&result_fst, PROJECT_OUTPUT);
+  Minimize(&result_fst, (KwsLexicographicFst *) nullptr, kDelta, true);
+  ShortestPath(result_fst, &result_fst, n_best);
+  RmEpsilon(&result_fst);
+
+  // No result found
+  if (result_fst.Start() == kNoStateId)
+    return 0;
+
+  int32 num_bad = 0;
+  for (ArcIterator<KwsLexicographicFst>
+           aiter(result_fst, result_fst.Start()); !aiter.Done(); aiter.Next()) {
+    const Arc &arc = aiter.Value();
+    // We're expecting a two-state FST
+    if (result_fst.Final(arc.nextstate) != Weight::One()) {
+      num_bad++;
+      continue;
+    }
+    uint64 osymbol = shard.label_decoder[arc.olabel];
+    hits->push_back(KwsHit(DecodeKwsLabelUid(osymbol),
+                           arc.weight.Value2().Value1().Value(),
+                           arc.weight.Value2().Value2().Value(),
+                           arc.weight.Value1().Value()));
+  }
+  return num_bad;
+}
+
+static bool CompareKwsHitScores(const KwsHit &a, const KwsHit &b) {
+  return a.score < b.score;
+}
+
+void MergeKwsHits(int32 n_best, std::vector<KwsHit> *hits) {
+  if (n_best == -1)
+    return;
+  std::stable_sort(hits->begin(), hits->end(), CompareKwsHitScores);
+  if (hits->size() > static_cast<size_t>(n_best))
+    hits->resize(n_best);
+}
+
+}  // namespace kaldi
@@ -0,0 +1,194 @@
+// kws/kws-index-search.h
+
+// Copyright 2012-2015  Johns Hopkins University (Authors: Guoguo Chen,
+//                                                         Daniel Povey.
+//                                                         Yenda Trmal)
+//           2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_KWS_KWS_INDEX_SEARCH_H_
+#define KALDI_KWS_KWS_INDEX_SEARCH_H_
+
+#include <string>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "kws/kaldi-kws.h"
+
+namespace kaldi {
+
+// The search code used to be part of kws-search.cc; it is here so that an
+// index can be split into shards (e.g. by ranges of utterances, see
+// kws-index-union --shard-size), which are searched independently and whose
+// results are merged.
+
+// Encodes the (ilabel, olabel) pair of a final arc of the index as a single
+// 64-bit symbol; the olabel is the utterance id, and the ilabel is typically
+// 0 or a disambiguation symbol.
+inline uint64 EncodeKwsLabel(int32 ilabel, int32 olabel) {
+  return (static_cast<uint64>(static_cast<uint32>(olabel)) << 32) +
+      static_cast<uint32>(ilabel);
+}
+
+// Extracts the utterance id from a symbol created by EncodeKwsLabel().
+inline int32 DecodeKwsLabelUid(uint64 osymbol) {
+  return static_cast<int32>(osymbol >> 32);
+}
+
+// This is a mapper that converts a StdArc FST (e.g. a keyword) to a
+// KwsLexicographicArc FST.  The structure is kept, and the weights are
+// converted.
+class VectorFstToKwsLexicographicFstMapper {
+ public:
+  typedef fst::StdArc FromArc;
+  typedef FromArc::Weight FromWeight;
+  typedef KwsLexicographicArc ToArc;
+  typedef KwsLexicographicWeight ToWeight;
+
+  VectorFstToKwsLexicographicFstMapper() {}
+
+  ToArc operator()(const FromArc &arc) const {
+    return ToArc(arc.ilabel,
+                 arc.olabel,
+                 (arc.weight == FromWeight::Zero() ?
+                  ToWeight::Zero() :
+                  ToWeight(arc.weight.Value(),
+                           StdLStdWeight::One())),
+                 arc.nextstate);
+  }
+
+  fst::MapFinalAction FinalAction() const {
+    return fst::MAP_NO_SUPERFINAL;
+  }
+
+  fst::MapSymbolsAction InputSymbolsAction() const {
+    return fst::MAP_COPY_SYMBOLS;
+  }
+
+  fst::MapSymbolsAction OutputSymbolsAction() const {
+    return fst::MAP_COPY_SYMBOLS;
+  }
+
+  uint64 Properties(uint64 props) const { return props; }
+};
+
+/// A keyword-search index (or one shard of it) prepared for searching by
+/// PrepareKwsIndexShard().  'index' is either a VectorFst or, for shards read
+/// by ReadKwsIndexShard() with mmap == true, a memory-mapped ConstFst.
+struct KwsIndexShard {
+  fst::Fst<KwsLexicographicArc> *index;
+  /// Maps the output labels of the final arcs of 'index' to the symbols
+  /// created by EncodeKwsLabel(); element 0 is unused.
+  std::vector<uint64> label_decoder;
+
+  KwsIndexShard(): index(NULL) { }
+  ~KwsIndexShard() { delete index; }
+ private:
+  KALDI_DISALLOW_COPY_AND_ASSIGN(KwsIndexShard);
+};
+
+/// Prepares an index, as written by kws-index-union, for searching, and
+/// takes ownership of it.  Rather than removing the disambiguation symbols,
+/// this moves them from the input side to the output side of the final arcs,
+/// combined with the utterance ids, which are on the output side (so that
+/// epsilon removal can be done after composition with the keyword; in Dogan
+/// and Murat's original paper the disambiguation symbols are simply removed
+/// and they have to traverse the composed FST instead).  It then sorts the
+/// arcs on their input labels.
+void PrepareKwsIndexShard(KwsLexicographicFst *index, KwsIndexShard *shard);
+
+/// Writes a prepared shard as the files <prefix>.fst, a ConstFst with the
+/// alignment needed to memory-map it, and <prefix>.labels, the label
+/// decoder.  The shard's index must have been prepared by
+/// PrepareKwsIndexShard().
+void WriteKwsIndexShard(const KwsIndexShard &shard, const std::string &prefix);
+
+/// Reads a shard written by WriteKwsIndexShard().  If mmap == true, the FST
+/// is memory-mapped instead of read, so that only the parts of the index
+/// that the keywords touch are paged in, and the index need not fit in
+/// memory.
+void ReadKwsIndexShard(const std::string &prefix, bool mmap,
+                       KwsIndexShard *shard);
+
+/// Writes and reads the list of the prefixes of the shards of an index
+/// (see WriteKwsIndexShard()), one per line.
+void WriteKwsIndexShardList(const std::string &wxfilename,
+                            const std::vector<std::string> &prefixes);
+void ReadKwsIndexShardList(const std::string &rxfilename,
+                           std::vector<std::string> *prefixes);
+
+/// Returns the first prefix <shard_prefix>.<n>, for n = 0, 1, 2..., for which
+/// the file <shard_prefix>.<n>.fst does not exist, i.e. a name for a new
+/// shard.
+std::string NextKwsIndexShardPrefix(const std::string &shard_prefix);
+
+/**
+   Updates the list of shards in the file 'list_filename' (which need not
+   exist yet) by removing the shards in 'remove' and adding the ones in 'add',
+   which go where the first removed shard was, or at the end.  This is how an
+   index is maintained incrementally, like the segments of an LSM tree: new
+   shards are added as their audio is indexed, and groups of shards are
+   merged into bigger ones from time to time (see kws-index-merge-shards).
+   The list is replaced atomically by renaming, so kws-search always reads a
+   complete list, and concurrent updates (e.g. adding a shard while others
+   are being merged) are serialized by a lock on <list_filename>.lock.  It is
+   an error if a shard in 'remove' is not in the list.
+*/
+void UpdateKwsIndexShardList(const std::string &list_filename,
+                             const std::vector<std::string> &remove,
+                             const std::vector<std::string> &add);
+
+/// Converts a shard back to an index as output by kws-index-union, undoing
+/// PrepareKwsIndexShard(); this is needed to merge shards.
+void UnprepareKwsIndexShard(const KwsIndexShard &shard,
+                            KwsLexicographicFst *index);
+
+/// A keyword instance found by the search.  The times are frame indexes
+/// (before any frame subsampling is undone) and 'score' is a negated log
+/// posterior.
+struct KwsHit {
+  int32 uid;
+  int32 tbeg;
+  int32 tend;
+  double score;
+  KwsHit(int32 uid, int32 tbeg, int32 tend, double score):
+      uid(uid), tbeg(tbeg), tend(tend), score(score) { }
+};
+
+/// Searches for 'keyword' (converted with
+/// VectorFstToKwsLexicographicFstMapper) in a shard of the index, and
+/// appends the instances found to 'hits'.  If n_best != -1, only the best
+/// 'n_best' instances in this shard are kept.  If 'stats' is not NULL, it
+/// appends the detailed statistics of every path that matches, each as the
+/// vector (uid, tbeg, tend, score, ilabels of the path...); see kws-search
+/// for more details.  Returns the number of arcs of the result that did not
+/// have the expected structure (normally zero).
+int32 SearchKwsIndexShard(const KwsLexicographicFst &keyword,
+                          const KwsIndexShard &shard,
+                          int32 n_best,
+                          std::vector<KwsHit> *hits,
+                          std::vector<std::vector<double> > *stats);
+
+/// Merges the instances of a keyword found in several shards.  If
+/// n_best != -1, it keeps the best n_best of them, sorted by score;
+/// otherwise it leaves them as they are.
+void MergeKwsHits(int32 n_best, std::vector<KwsHit> *hits);
+
+}  // namespace kaldi
+
+#endif  // KALDI_KWS_KWS_INDEX_SEARCH_H_
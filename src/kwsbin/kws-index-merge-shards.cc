@@ -0,0 +1,160 @@
+// kwsbin/kws-index-merge-shards.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cmath>
+#include <cstdio>
+#include <map>
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "fstext/fstext-utils.h"
+#include "kws/kaldi-kws.h"
+#include "kws/kws-functions.h"
+#include "kws/kws-index-search.h"
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    using namespace fst;
+    typedef kaldi::int32 int32;
+
+    const char *usage =
+        "Merge the shards of a keyword-search index (as written by\n"
+        "kws-index-union --shard-prefix, possibly with --append) in the way\n"
+        "the segments of an LSM tree are compacted: the shards are put in\n"
+        "tiers by their number of states, each tier holding shards about\n"
+        "--merge-factor times bigger than the one below, and whenever a tier\n"
+        "has --merge-factor shards they are merged (union, then encoded\n"
+        "determinization and minimization) into one shard of the next tier.\n"
+        "The list of shards is updated atomically after each merge, so\n"
+        "kws-search can run at any time, and new shards can be added\n"
+        "meanwhile; this is meant to be run periodically in the background.\n"
+        "Only one instance should run on an index at a time.\n"
+        "\n"
+        "Usage: kws-index-merge-shards [options] <shard-list>\n"
+        " e.g.: kws-index-merge-shards index/shard.list\n";
+
+    ParseOptions po(usage);
+
+    int32 merge_factor = 4;
+    int32 max_states = -1;
+    int32 max_merges = -1;
+    bool skip_opt = false;
+    bool delete_merged = false;
+    std::string shard_prefix;
+    po.Register("merge-factor", &merge_factor,
+        "Number of shards of a tier that are merged into one.");
+    po.Register("max-states", &max_states,
+        "Maximum states for DeterminizeStar.");
+    po.Register("max-merges", &max_merges,
+        "If >0, the maximum number of merges to do before exiting.");
+    po.Register("skip-optimization", &skip_opt,
+        "Skip optimization of the merged shards if it's set to true.");
+    po.Register("delete-merged", &delete_merged,
+        "If true, delete the files of the shards that were merged.  Only do "
+        "this if no kws-search may still be using an older list of shards.");
+    po.Register("shard-prefix", &shard_prefix,
+        "Prefix of the files of the merged shards; by default it is "
+        "<shard-list> without its \".list\" suffix.");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 1) {
+      po.PrintUsage();
+      exit(1);
+    }
+    if (merge_factor < 2)
+      KALDI_ERR << "--merge-factor must be at least 2.";
+
+    std::string list_filename = po.GetArg(1);
+    if (shard_prefix.empty()) {
+      const std::string suffix = ".list";
+      if (list_filename.size() <= suffix.size() ||
+          list_filename.compare(list_filename.size() - suffix.size(),
+                                suffix.size(), suffix) != 0)
+        KALDI_ERR << "--shard-prefix is required if the shard list is not "
+                  << "named <prefix>.list";
+      shard_prefix = list_filename.substr(0,
+                                          list_filename.size() - suffix.size());
+    }
+
+    int32 num_merges = 0;
+    while (max_merges <= 0 || num_merges < max_merges) {
+      std::vector<std::string> prefixes;
+      ReadKwsIndexShardList(list_filename, &prefixes);
+
+      // Put the shards in tiers; the shards of each tier are in the order of
+      // the list, i.e. roughly oldest first.
+      std::map<int32, std::vector<std::string> > tiers;
+      for (size_t i = 0; i < prefixes.size(); i++) {
+        KwsIndexShard shard;
+        ReadKwsIndexShard(prefixes[i], true, &shard);
+        int32 num_states = CountStates(*shard.index);
+        int32 tier = (num_states <= 1 ? 0 :
+                      static_cast<int32>(std::log(num_states) /
+                                         std::log(merge_factor)));
+        tiers[tier].push_back(prefixes[i]);
+      }
+      // Merge the lowest tier that is full.
+      std::vector<std::string> to_merge;
+      for (std::map<int32, std::vector<std::string> >::iterator
+               iter = tiers.begin(); iter != tiers.end(); ++iter) {
+        if (iter->second.size() >= merge_factor) {
+          to_merge.assign(iter->second.begin(),
+                          iter->second.begin() + merge_factor);
+          break;
+        }
+      }
+      if (to_merge.empty())
+        break;
+
+      KwsLexicographicFst merged;
+      for (size_t i = 0; i < to_merge.size(); i++) {
+        KwsIndexShard shard;
+        ReadKwsIndexShard(to_merge[i], true, &shard);
+        KwsLexicographicFst index;
+        UnprepareKwsIndexShard(shard, &index);
+        Union(&merged, index);
+      }
+      if (!skip_opt)
+        OptimizeFactorTransducer(&merged, max_states, false);
+      KwsIndexShard merged_shard;
+      PrepareKwsIndexShard(new KwsLexicographicFst(merged), &merged_shard);
+      std::string merged_prefix = NextKwsIndexShardPrefix(shard_prefix);
+      WriteKwsIndexShard(merged_shard, merged_prefix);
+      UpdateKwsIndexShardList(list_filename, to_merge,
+                              std::vector<std::string>(1, merged_prefix));
+      KALDI_LOG << "Merged " << to_merge.size() << " shards into "
+                << merged_prefix;
+      if (delete_merged) {
+        for (size_t i = 0; i < to_merge.size(); i++) {
+          std::remove((to_merge[i] + ".fst").c_str());
+          std::remove((to_merge[i] + ".labels").c_str());
+        }
+      }
+      num_merges++;
+    }
+
+    KALDI_LOG << "Did " << num_merges << " merges.";
+    return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
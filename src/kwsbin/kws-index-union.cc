@@ -18,11 +18,14 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <iomanip>
+
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
 #include "fstext/fstext-utils.h"
 #include "kws/kaldi-kws.h"
 #include "kws/kws-functions.h"
+#include "kws/kws-index-search.h"
 
 int main(int argc, char *argv[]) {
   try {
@@ -37,25 +40,52 @@ int main(int argc, char *argv[]) {
         "the output index is also in the T*T*T semiring. At the end of "
         "this program, encoded\n"
         "epsilon removal, determinization and minimization will be applied.\n"
+        "With --shard-size, the input indices (normally one per utterance)\n"
+        "are split into shards of that many consecutive ones, each of which\n"
+        "is a separate index in the output, for kws-search to search in\n"
+        "parallel.  With --shard-prefix, the shards are also prepared for\n"
+        "searching and written as files that kws-search can memory-map,\n"
+        "and the output archive is optional; with --append, they are added\n"
+        "to an existing index (see kws-index-merge-shards).\n"
         "\n"
-        "Usage: kws-index-union [options]  index-rspecifier index-wspecifier\n"
-        " e.g.: kws-index-union ark:input.idx ark:global.idx\n";
+        "Usage: kws-index-union [options]  index-rspecifier [index-wspecifier]\n"
+        " e.g.: kws-index-union ark:input.idx ark:global.idx\n"
+        " e.g.: kws-index-union --shard-size=10000 --shard-prefix=index/shard "
+        "ark:input.idx\n";
 
     ParseOptions po(usage);
 
     bool strict = true;
     bool skip_opt = false;
     int32 max_states = -1;
+    int32 shard_size = 0;
+    std::string shard_prefix;
+    bool append = false;
     po.Register("strict", &strict,
         "Will allow 0 lattice if it is set to false.");
     po.Register("skip-optimization", &skip_opt,
         "Skip optimization if it's set to true.");
     po.Register("max-states", &max_states,
         "Maximum states for DeterminizeStar.");
+    po.Register("shard-size", &shard_size,
+        "If >0, the number of input indices in each shard of the output; "
+        "the shards have keys shard-00000, shard-00001 and so on.  If 0, "
+        "the output is a single index with the key \"global\".");
+    po.Register("shard-prefix", &shard_prefix,
+        "If set, also write the shards, prepared for kws-search, to the "
+        "files <shard-prefix>.<n>.fst and <shard-prefix>.<n>.labels, and "
+        "the list of them to <shard-prefix>.list, which can be given to "
+        "kws-search instead of the index archive.");
+    po.Register("append", &append,
+        "If true (with --shard-prefix), add the new shards to those already "
+        "in <shard-prefix>.list instead of replacing the list.  This makes "
+        "newly indexed audio searchable straight away; see also "
+        "kws-index-merge-shards.");
 
     po.Read(argc, argv);
 
-    if (po.NumArgs() < 2 || po.NumArgs() > 3) {
+    if (po.NumArgs() < 1 || po.NumArgs() > 2 ||
+        (po.NumArgs() == 1 && shard_prefix.empty())) {
       po.PrintUsage();
       exit(1);
     }
@@ -65,12 +95,17 @@ int main(int argc, char *argv[]) {
 
     SequentialTableReader< VectorFstTplHolder<KwsLexicographicArc> >
                                                 index_reader(index_rspecifier);
-    TableWriter< VectorFstTplHolder<KwsLexicographicArc> >
-                                                index_writer(index_wspecifier);
+    TableWriter< VectorFstTplHolder<KwsLexicographicArc> > index_writer;
+    if (!index_wspecifier.empty() && !index_writer.Open(index_wspecifier))
+      KALDI_ERR << "Could not open table for writing: " << index_wspecifier;
+
+    if (skip_opt)
+      KALDI_LOG << "Skipping index optimization...";
 
-    int32 n_done = 0;
+    int32 n_done = 0, n_in_shard = 0, num_shards = 0;
+    std::vector<std::string> shard_prefixes;
     KwsLexicographicFst global_index;
-    for (; !index_reader.Done(); index_reader.Next()) {
+    for (; !index_reader.Done(); ) {
       std::string key = index_reader.Key();
       KwsLexicographicFst index = index_reader.Value();
       index_reader.FreeCurrent();
@@ -78,30 +113,57 @@ int main(int argc, char *argv[]) {
       Union(&global_index, index);
 
       n_done++;
-    }
-
-    if (skip_opt == false) {
-      // Do the encoded epsilon removal, determinization and minimization
-      KwsLexicographicFst ifst = global_index;
-      EncodeMapper<KwsLexicographicArc> encoder(kEncodeLabels, ENCODE);
-      Encode(&ifst, &encoder);
-      try {
-        DeterminizeStar(ifst, &global_index, kDelta, NULL, max_states);
-      } catch(const std::exception &e) {
-        KALDI_WARN << e.what()
-                   << " (should affect speed of search but not results)";
-        global_index = ifst;
+      n_in_shard++;
+      index_reader.Next();
+      if (!(index_reader.Done() ||
+            (shard_size > 0 && n_in_shard == shard_size)))
+        continue;
+
+      // We have the union of the indices of a shard (or of all of them).
+      if (skip_opt == false)
+        OptimizeFactorTransducer(&global_index, max_states, false);
+      std::string shard_key = "global";
+      if (shard_size > 0) {
+        std::ostringstream os;
+        os << "shard-" << std::setfill('0') << std::setw(5) << num_shards;
+        shard_key = os.str();
       }
-      Minimize(&global_index, static_cast<KwsLexicographicFst*>(NULL), kDelta, true);
-      Decode(&global_index, encoder);
-    } else {
-      KALDI_LOG << "Skipping index optimization...";
+      if (index_writer.IsOpen())
+        index_writer.Write(shard_key, global_index);
+      if (!shard_prefix.empty()) {
+        std::string prefix;
+        if (append) {
+          prefix = NextKwsIndexShardPrefix(shard_prefix);
+        } else {
+          std::ostringstream os;
+          os << shard_prefix << '.' << num_shards;
+          prefix = os.str();
+        }
+        KwsIndexShard shard;
+        PrepareKwsIndexShard(new KwsLexicographicFst(global_index), &shard);
+        WriteKwsIndexShard(shard, prefix);
+        shard_prefixes.push_back(prefix);
+      }
+      num_shards++;
+      global_index.DeleteStates();
+      n_in_shard = 0;
     }
 
-    // Write the result
-    index_writer.Write("global", global_index);
+    if (num_shards == 0) {
+      // There were no input indices; write the empty index, as before.
+      if (index_writer.IsOpen())
+        index_writer.Write("global", global_index);
+    }
+    if (!shard_prefix.empty()) {
+      if (append)
+        UpdateKwsIndexShardList(shard_prefix + ".list",
+                                std::vector<std::string>(), shard_prefixes);
+      else
+        WriteKwsIndexShardList(shard_prefix + ".list", shard_prefixes);
+    }
 
-    KALDI_LOG << "Done " << n_done << " indices";
+    KALDI_LOG << "Done " << n_done << " indices in "
+              << num_shards << " shards";
     if (strict == true)
       return (n_done != 0 ? 0 : 1);
     else
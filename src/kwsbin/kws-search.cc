@@ -22,152 +22,98 @@
 
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
+#include "util/kaldi-thread.h"
 #include "fstext/kaldi-fst-io.h"
 #include "kws/kaldi-kws.h"
+#include "kws/kws-index-search.h"
 
 namespace kaldi {
 
-typedef KwsLexicographicArc Arc;
-typedef Arc::Weight Weight;
-typedef Arc::StateId StateId;
-
-// encode ilabel, olabel pair as a single 64bit (output) symbol
-uint64 EncodeLabel(StateId ilabel, StateId olabel) {
-  return (static_cast<int64>(olabel) << 32) + static_cast<int64>(ilabel);
-}
-
-// extract the osymbol from the 64bit symbol. That represents the utterance id
-// in this setup -- we throw away the isymbol which is typically 0 or an
-// disambiguation symbol
-StateId DecodeLabelUid(uint64 osymbol) {
-  return static_cast<StateId>(osymbol >> 32);
-}
-
-// this is a mapper adapter that helps converting
-// between the StdArc FST (i.e. tropical semiring FST)
-// to the KwsLexicographic FST. Structure will be kept,
-// the weights converted/recomputed
-class VectorFstToKwsLexicographicFstMapper {
+// Searches all the keywords in one shard of the index.  The shard is either
+// given as an FST (from an archive), which is prepared for searching in the
+// thread that runs the search, or as the prefix of a shard written by
+// kws-index-union --shard-prefix, which is read (or memory-mapped) there.
+class KwsShardSearchTask {
  public:
-  typedef fst::StdArc FromArc;
-  typedef FromArc::Weight FromWeight;
-  typedef KwsLexicographicArc ToArc;
-  typedef KwsLexicographicWeight ToWeight;
-
-  VectorFstToKwsLexicographicFstMapper() {}
-
-  ToArc operator()(const FromArc &arc) const {
-    return ToArc(arc.ilabel,
-                 arc.olabel,
-                 (arc.weight == FromWeight::Zero() ?
-                  ToWeight::Zero() :
-                  ToWeight(arc.weight.Value(),
-                           StdLStdWeight::One())),
-                 arc.nextstate);
-  }
-
-  fst::MapFinalAction FinalAction() const {
-    return fst::MAP_NO_SUPERFINAL;
-  }
-
-  fst::MapSymbolsAction InputSymbolsAction() const {
-    return fst::MAP_COPY_SYMBOLS;
+  KwsShardSearchTask(
+      const std::vector<std::pair<std::string, KwsLexicographicFst> > &keywords,
+      int32 n_best, KwsLexicographicFst *index, const std::string &prefix,
+      bool mmap, std::vector<std::vector<KwsHit> > *all_hits,
+      std::vector<bool> *found, int32 *num_bad,
+      TableWriter<BasicVectorHolder<double> > *stats_writer):
+      keywords_(keywords), n_best_(n_best), index_(index), prefix_(prefix),
+      mmap_(mmap), all_hits_(all_hits), found_(found), num_bad_(num_bad),
+      stats_writer_(stats_writer), hits_(keywords.size()),
+      stats_(stats_writer->IsOpen() ? keywords.size() : 0),
+      bad_(keywords.size(), 0) { }
+
+  void operator () () {
+    KwsIndexShard shard;
+    if (index_ != NULL)
+      PrepareKwsIndexShard(index_, &shard);  // takes ownership of index_.
+    else
+      ReadKwsIndexShard(prefix_, mmap_, &shard);
+    index_ = NULL;
+    for (size_t k = 0; k < keywords_.size(); k++)
+      bad_[k] = SearchKwsIndexShard(keywords_[k].second, shard, n_best_,
+                                    &(hits_[k]),
+                                    stats_.empty() ? NULL : &(stats_[k]));
   }
 
-  fst::MapSymbolsAction OutputSymbolsAction() const {
-    return fst::MAP_COPY_SYMBOLS;
+  ~KwsShardSearchTask() {
+    delete index_;  // in case operator () was never called.
+    for (size_t k = 0; k < keywords_.size(); k++) {
+      const std::string &key = keywords_[k].first;
+      for (int32 i = 0; i < bad_[k]; i++)
+        KALDI_WARN << "The resulting FST does not have "
+                   << "the expected structure for key " << key;
+      *num_bad_ += bad_[k];
+      if (!hits_[k].empty() || bad_[k] > 0)
+        (*found_)[k] = true;
+      (*all_hits_)[k].insert((*all_hits_)[k].end(),
+                             hits_[k].begin(), hits_[k].end());
+      if (!stats_.empty())
+        for (size_t i = 0; i < stats_[k].size(); i++)
+          stats_writer_->Write(key, stats_[k][i]);
+    }
   }
 
-  uint64 Properties(uint64 props) const { return props; }
+ private:
+  const std::vector<std::pair<std::string, KwsLexicographicFst> > &keywords_;
+  int32 n_best_;
+  KwsLexicographicFst *index_;
+  std::string prefix_;
+  bool mmap_;
+  std::vector<std::vector<KwsHit> > *all_hits_;
+  std::vector<bool> *found_;
+  int32 *num_bad_;
+  TableWriter<BasicVectorHolder<double> > *stats_writer_;
+  std::vector<std::vector<KwsHit> > hits_;
+  std::vector<std::vector<std::vector<double> > > stats_;
+  std::vector<int32> bad_;
 };
 
-struct ActivePath {
-  std::vector<KwsLexicographicArc::Label> path;
-  KwsLexicographicArc::Weight weight;
-  KwsLexicographicArc::Label last;
-};
-
-bool GenerateActivePaths(const KwsLexicographicFst &proxy,
-                       std::vector<ActivePath> *paths,
-                       KwsLexicographicFst::StateId cur_state,
-                       std::vector<KwsLexicographicArc::Label> cur_path,
-                       KwsLexicographicArc::Weight cur_weight) {
-  for (fst::ArcIterator<KwsLexicographicFst> aiter(proxy, cur_state);
-       !aiter.Done(); aiter.Next()) {
-    const Arc &arc = aiter.Value();
-    Weight temp_weight = Times(arc.weight, cur_weight);
-
-    cur_path.push_back(arc.ilabel);
-
-    if ( arc.olabel != 0 ) {
-      ActivePath path;
-      path.path = cur_path;
-      path.weight = temp_weight;
-      path.last = arc.olabel;
-      paths->push_back(path);
-    } else {
-      GenerateActivePaths(proxy, paths,
-                        arc.nextstate, cur_path, temp_weight);
-    }
-    cur_path.pop_back();
-  }
-
-  return true;
-}
 }  // namespace kaldi
 
 typedef kaldi::TableWriter< kaldi::BasicVectorHolder<double> >
                                                         VectorOfDoublesWriter;
-void OutputDetailedStatistics(const std::string &kwid,
-                        const kaldi::KwsLexicographicFst &keyword,
-                        const unordered_map<uint32, uint64> &label_decoder,
-                        VectorOfDoublesWriter *output ) {
-  std::vector<kaldi::ActivePath> paths;
-
-  if (keyword.Start() == fst::kNoStateId)
-    return;
-
-  kaldi::GenerateActivePaths(keyword, &paths, keyword.Start(),
-                  std::vector<kaldi::KwsLexicographicArc::Label>(),
-                  kaldi::KwsLexicographicArc::Weight::One());
-
-  for (int i = 0; i < paths.size(); ++i) {
-    std::vector<double> out;
-    double score;
-    int32 tbeg, tend, uid;
-
-    uint64 osymbol = label_decoder.find(paths[i].last)->second;
-    uid = kaldi::DecodeLabelUid(osymbol);
-    tbeg = paths[i].weight.Value2().Value1().Value();
-    tend = paths[i].weight.Value2().Value2().Value();
-    score = paths[i].weight.Value1().Value();
-
-    out.push_back(uid);
-    out.push_back(tbeg);
-    out.push_back(tend);
-    out.push_back(score);
-
-    for (int j = 0; j < paths[i].path.size(); ++j) {
-      out.push_back(paths[i].path[j]);
-    }
-    output->Write(kwid, out);
-  }
-}
-
 
 int main(int argc, char *argv[]) {
   try {
     using namespace kaldi;
     using namespace fst;
     typedef kaldi::int32 int32;
-    typedef kaldi::uint32 uint32;
-    typedef kaldi::uint64 uint64;
 
     const char *usage =
         "Search the keywords over the index. This program can be executed\n"
         "in parallel, either on the index side or the keywords side; we use\n"
-        "a script to combine the final search results. Note that the index\n"
-        "archive has a single key \"global\".\n\n"
+        "a script to combine the final search results. The index archive\n"
+        "normally has a single key \"global\"; if it has several keys (e.g.\n"
+        "shards of the index written by kws-index-union --shard-size), each\n"
+        "is searched separately, on --num-threads threads, and the results\n"
+        "are merged.  Instead of an archive, the index may be given as the\n"
+        "list of shards written by kws-index-union --shard-prefix (see\n"
+        "--mmap).\n\n"
         "Search has one or two outputs. The first one is mandatory and will\n"
         "contain the seach output, i.e. list of all found keyword instances\n"
         "The file is in the following format:\n"
@@ -185,10 +131,12 @@ int main(int argc, char *argv[]) {
         " e.g.: \n"
         "KW105-0198 7 335 376 16.01254 0 5766 5659 0\n"
         "\n"
-        "Usage: kws-search [options] <index-rspecifier> <keywords-rspecifier> "
-        "<results-wspecifier> [<stats_wspecifier>]\n"
+        "Usage: kws-search [options] (<index-rspecifier>|<shard-list>) "
+        "<keywords-rspecifier> <results-wspecifier> [<stats_wspecifier>]\n"
         " e.g.: kws-search ark:index.idx ark:keywords.fsts "
-                           "ark:results ark:stats\n";
+                           "ark:results ark:stats\n"
+        " e.g.: kws-search --num-threads=8 --mmap=true index/shard.list "
+        "ark:keywords.fsts ark:results\n";
 
     ParseOptions po(usage);
 
@@ -198,6 +146,8 @@ int main(int argc, char *argv[]) {
     double negative_tolerance = -0.1;
     double keyword_beam = -1;
     int32 frame_subsampling_factor = 1;
+    bool mmap = true;
+    TaskSequencerConfig sequencer_config;
 
     po.Register("frame-subsampling-factor", &frame_subsampling_factor,
                 "Frame subsampling factor. (Default value 1)");
@@ -212,6 +162,10 @@ int main(int argc, char *argv[]) {
     po.Register("keyword-beam", &keyword_beam,
                 "Prune the FST with the given beam if the FST contains "
                 "multiple keywords.");
+    po.Register("mmap", &mmap, "If true, memory-map the shards of an index "
+                "given as a shard list rather than reading them, so the "
+                "index does not need to fit in memory.");
+    sequencer_config.Register(&po);
 
     if (n_best < 0 && n_best != -1) {
       KALDI_ERR << "Bad number for nbest";
@@ -233,60 +187,24 @@ int main(int argc, char *argv[]) {
       exit(1);
     }
 
-    std::string index_rspecifier = po.GetArg(1),
+    std::string index_in = po.GetArg(1),
         keyword_rspecifier = po.GetArg(2),
         result_wspecifier = po.GetArg(3),
         stats_wspecifier = po.GetOptArg(4);
 
-    RandomAccessTableReader< VectorFstTplHolder<KwsLexicographicArc> >
-                                                index_reader(index_rspecifier);
+    // Each shard being searched is in memory (unless it is memory-mapped)
+    // until its results have been merged, so by default we don't let the
+    // searches get far ahead of each other.
+    if (sequencer_config.num_threads_total <= 0)
+      sequencer_config.num_threads_total = sequencer_config.num_threads + 1;
+
     SequentialTableReader<VectorFstHolder> keyword_reader(keyword_rspecifier);
     VectorOfDoublesWriter result_writer(result_wspecifier);
     VectorOfDoublesWriter stats_writer(stats_wspecifier);
 
-
-    // Index has key "global"
-    KwsLexicographicFst index = index_reader.Value("global");
-
-    // First we have to remove the disambiguation symbols. But rather than
-    // removing them totally, we actually move them from input side to output
-    // side, making the output symbol a "combined" symbol of the disambiguation
-    // symbols and the utterance id's.
-    // Note that in Dogan and Murat's original paper, they simply remove the
-    // disambiguation symbol on the input symbol side, which will not allow us
-    // to do epsilon removal after composition with the keyword FST. They have
-    // to traverse the resulting FST.
-    int32 label_count = 1;
-    unordered_map<uint64, uint32> label_encoder;
-    unordered_map<uint32, uint64> label_decoder;
-    for (StateIterator<KwsLexicographicFst> siter(index);
-                                           !siter.Done(); siter.Next()) {
-      StateId state_id = siter.Value();
-      for (MutableArcIterator<KwsLexicographicFst>
-           aiter(&index, state_id); !aiter.Done(); aiter.Next()) {
-        KwsLexicographicArc arc = aiter.Value();
-        // Skip the non-final arcs
-        if (index.Final(arc.nextstate) == Weight::Zero())
-          continue;
-        // Encode the input and output label of the final arc, and this is the
-        // new output label for this arc; set the input label to <epsilon>
-        uint64 osymbol = EncodeLabel(arc.ilabel, arc.olabel);
-        arc.ilabel = 0;
-        if (label_encoder.find(osymbol) == label_encoder.end()) {
-          arc.olabel = label_count;
-          label_encoder[osymbol] = label_count;
-          label_decoder[label_count] = osymbol;
-          label_count++;
-        } else {
-          arc.olabel = label_encoder[osymbol];
-        }
-        aiter.SetValue(arc);
-      }
-    }
-    ArcSort(&index, fst::ILabelCompare<KwsLexicographicArc>());
-
-    int32 n_done = 0;
-    int32 n_fail = 0;
+    // The keywords are all read first, as each shard of the index is
+    // searched for all of them.
+    std::vector<std::pair<std::string, KwsLexicographicFst> > keywords;
     for (; !keyword_reader.Done(); keyword_reader.Next()) {
       std::string key = keyword_reader.Key();
       VectorFst<StdArc> keyword = keyword_reader.Value();
@@ -301,68 +219,67 @@ int main(int argc, char *argv[]) {
         ShortestPath(keyword, &tmp, keyword_nbest, true, true);
         keyword = tmp;
       }
+      keywords.push_back(std::make_pair(key, KwsLexicographicFst()));
+      Map(keyword, &(keywords.back().second),
+          VectorFstToKwsLexicographicFstMapper());
+    }
 
-      KwsLexicographicFst keyword_fst;
-      KwsLexicographicFst result_fst;
-      Map(keyword, &keyword_fst, VectorFstToKwsLexicographicFstMapper());
-      Compose(keyword_fst, index, &result_fst);
-
-      if (stats_wspecifier != "") {
-        KwsLexicographicFst matched_seq(result_fst);
-        OutputDetailedStatistics(key,
-                                 matched_seq,
-                                 label_decoder,
-                                 &stats_writer);
+    std::vector<std::vector<KwsHit> > all_hits(keywords.size());
+    std::vector<bool> found(keywords.size(), false);
+    int32 num_bad = 0, num_shards = 0;
+    {
+      TaskSequencer<KwsShardSearchTask> sequencer(sequencer_config);
+      if (ClassifyRspecifier(index_in, NULL, NULL) != kNoRspecifier) {
+        SequentialTableReader< VectorFstTplHolder<KwsLexicographicArc> >
+            index_reader(index_in);
+        for (; !index_reader.Done(); index_reader.Next(), num_shards++) {
+          KwsLexicographicFst *index =
+              new KwsLexicographicFst(index_reader.Value());
+          index_reader.FreeCurrent();
+          sequencer.Run(new KwsShardSearchTask(
+              keywords, n_best, index, "", false, &all_hits, &found,
+              &num_bad, &stats_writer));
+        }
+      } else {
+        std::vector<std::string> prefixes;
+        ReadKwsIndexShardList(index_in, &prefixes);
+        for (; num_shards < prefixes.size(); num_shards++)
+          sequencer.Run(new KwsShardSearchTask(
+              keywords, n_best, NULL, prefixes[num_shards], mmap, &all_hits,
+              &found, &num_bad, &stats_writer));
       }
+      sequencer.Wait();
+    }
+    if (num_shards == 0)
+      KALDI_ERR << "The index " << index_in << " is empty.";
 
-      Project(&result_fst, PROJECT_OUTPUT);
-      Minimize(&result_fst, (KwsLexicographicFst *) nullptr, kDelta, true);
-      ShortestPath(result_fst, &result_fst, n_best);
-      RmEpsilon(&result_fst);
-
-      // No result found
-      if (result_fst.Start() == kNoStateId)
+    int32 n_done = 0;
+    for (size_t k = 0; k < keywords.size(); k++) {
+      if (!found[k])
         continue;
-
-      // Got something here
-      double score;
-      int32 tbeg, tend, uid;
-      for (ArcIterator<KwsLexicographicFst>
-           aiter(result_fst, result_fst.Start()); !aiter.Done(); aiter.Next()) {
-        const KwsLexicographicArc &arc = aiter.Value();
-
-        // We're expecting a two-state FST
-        if (result_fst.Final(arc.nextstate) != Weight::One()) {
-          KALDI_WARN << "The resulting FST does not have "
-                     << "the expected structure for key " << key;
-          n_fail++;
-          continue;
-        }
-
-        uint64 osymbol = label_decoder[arc.olabel];
-        uid = static_cast<int32>(DecodeLabelUid(osymbol));
-        tbeg = arc.weight.Value2().Value1().Value();
-        tend = arc.weight.Value2().Value2().Value();
-        score = arc.weight.Value1().Value();
-
+      std::vector<KwsHit> &hits = all_hits[k];
+      if (num_shards > 1)
+        MergeKwsHits(n_best, &hits);
+      for (size_t i = 0; i < hits.size(); i++) {
+        double score = hits[i].score;
         if (score < 0) {
           if (score < negative_tolerance) {
             KALDI_WARN << "Score out of expected range: " << score;
           }
           score = 0.0;
         }
-        vector<double> result;
-        result.push_back(uid);
-        result.push_back(tbeg * frame_subsampling_factor);
-        result.push_back(tend * frame_subsampling_factor);
+        std::vector<double> result;
+        result.push_back(hits[i].uid);
+        result.push_back(hits[i].tbeg * frame_subsampling_factor);
+        result.push_back(hits[i].tend * frame_subsampling_factor);
         result.push_back(score);
-        result_writer.Write(key, result);
+        result_writer.Write(keywords[k].first, result);
       }
-
       n_done++;
     }
 
-    KALDI_LOG << "Done " << n_done << " keywords";
+    KALDI_LOG << "Done " << n_done << " keywords in " << num_shards
+              << " index shards";
     if (strict == true)
       return (n_done != 0 ? 0 : 1);
     else
@@ -77,6 +77,12 @@ class PrunedCompactLatticeComposer {
   // out of the composed state numbered 'composed_state_to_expand'.
   void ProcessQueueElement(int32 composed_state_to_expand);
 
+  // If opts_.lm_batch_size > 1, passes the next transitions of the first
+  // opts_.lm_batch_size elements of composed_state_queue_ to
+  // det_fst_->PrefetchArcs(), leaving the queue as it was.  Returns the number
+  // of queue elements looked at.
+  int32 PrefetchLmArcs();
+
   // This is a part of ProcessQueueElements() that has been broken out
   // for clarity. it process the arc_index'th arc out of this source state.
   void ProcessTransition(int32 composed_src_state,
@@ -751,6 +757,35 @@ void PrunedCompactLatticeComposer::ProcessQueueElement(
   }
 }
 
+int32 PrunedCompactLatticeComposer::PrefetchLmArcs() {
+  std::vector<std::pair<BaseFloat, int32> > elements;
+  std::vector<std::pair<int32, int32> > queries;
+  while (static_cast<int32>(elements.size()) < opts_.lm_batch_size &&
+         !composed_state_queue_.empty()) {
+    elements.push_back(composed_state_queue_.top());
+    composed_state_queue_.pop();
+    const ComposedStateInfo &info = composed_state_info_[
+        elements.back().second];
+    if (info.sorted_arc_index < 0)
+      continue;
+    int32 arc_index = lat_state_info_[info.lat_state].arc_delta_costs[
+        info.sorted_arc_index].second;
+    if (arc_index < 0)
+      continue;  // It is a final-prob.
+    fst::ArcIterator<CompactLattice> aiter(clat_in_, info.lat_state);
+    aiter.Seek(arc_index);
+    int32 olabel = aiter.Value().olabel;
+    if (olabel != 0)
+      queries.push_back(std::pair<int32, int32>(info.lm_state, olabel));
+  }
+  // Putting the elements back leaves the queue as it was, as they are ordered
+  // by both the cost and the state.
+  for (size_t i = 0; i < elements.size(); i++)
+    composed_state_queue_.push(elements[i]);
+  det_fst_->PrefetchArcs(queries);
+  return elements.size();
+}
+
 void PrunedCompactLatticeComposer::ProcessTransition(int32 src_composed_state,
                                                      int32 arc_index) {
   // Make src_composed_state a const pointer not a reference, as we may have to
@@ -896,9 +931,12 @@ void PrunedCompactLatticeComposer::Compose() {
   while (output_best_cost_ == std::numeric_limits<double>::infinity() ||
          num_arcs_out_ < opts_.max_arcs) {
     RecomputePruningInfo();
-    int32 this_iter_arc_limit = GetCurrentArcLimit();
+    int32 this_iter_arc_limit = GetCurrentArcLimit(),
+        num_until_prefetch = 0;
     while (num_arcs_out_ < this_iter_arc_limit &&
            !composed_state_queue_.empty()) {
+      if (opts_.lm_batch_size > 1 && num_until_prefetch-- <= 0)
+        num_until_prefetch = PrefetchLmArcs() - 1;
       int32 src_composed_state = composed_state_queue_.top().second;
       composed_state_queue_.pop();
       ProcessQueueElement(src_composed_state);
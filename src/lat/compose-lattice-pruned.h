@@ -121,10 +121,19 @@ struct ComposeLatticePrunedOptions {
   // heuristics will be less accurate).
   BaseFloat growth_ratio;
 
+  // If 'lm_batch_size' is more than 1, the next transitions of this many of
+  // the composed states at the front of the queue are passed together to the
+  // language model's PrefetchArcs() before they are expanded, so that a neural
+  // language model can score them as a minibatch.  The order in which LM states
+  // are created changes slightly, so with an RNNLM whose histories are
+  // truncated (--max-ngram-order) the scores may differ a little.
+  int32 lm_batch_size;
+
   ComposeLatticePrunedOptions(): lattice_compose_beam(6.0),
                                  max_arcs(100000),
                                  initial_num_arcs(100),
-                                 growth_ratio(1.5) { }
+                                 growth_ratio(1.5),
+                                 lm_batch_size(1) { }
   void Register(OptionsItf *po) {
     po->Register("lattice-compose-beam", &lattice_compose_beam,
                  "Beam used in pruned lattice composition, which determines how "
@@ -135,6 +144,10 @@ struct ComposeLatticePrunedOptions {
     po->Register("growth-ratio", &growth_ratio, "Factor used in the lattice "
                  "composition algorithm; must be >1.0.  Affects speed vs. "
                  "the optimality of the best-first composition.");
+    po->Register("lm-batch-size", &lm_batch_size, "Number of pending "
+                 "transitions whose language-model scores are requested "
+                 "together; values like 64 make RNNLM rescoring faster on "
+                 "GPU.");
   }
 };
 
@@ -0,0 +1,202 @@
+// lat/determinize-lattice-incremental-test.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lat/determinize-lattice-incremental.h"
+#include "lat/kaldi-lattice.h"
+
+namespace kaldi {
+
+typedef LatticeArc::StateId StateId;
+
+static LatticeWeight RandLatticeWeight() {
+  return LatticeWeight(RandUniform(), RandUniform());
+}
+
+static int32 RandWord() {
+  return (Rand() % 3 == 0 ? 1 + Rand() % 3 : 0);
+}
+
+// Makes a random lattice like the raw lattices that the decoders output:
+// (*frames)[f] are the states on frame f, which have emitting arcs (nonzero
+// ilabels) to states on frame f + 1 and epsilon arcs to later states on frame
+// f.
+static void RandLayeredLattice(int32 num_frames, Lattice *lat,
+                               std::vector<std::vector<StateId> > *frames) {
+  lat->DeleteStates();
+  frames->clear();
+  frames->resize(num_frames + 1);
+  for (int32 f = 0; f <= num_frames; f++) {
+    int32 num_states = (f == 0 ? 1 : 1 + Rand() % 4);
+    for (int32 i = 0; i < num_states; i++)
+      (*frames)[f].push_back(lat->AddState());
+  }
+  lat->SetStart((*frames)[0][0]);
+  for (int32 f = 0; f <= num_frames; f++) {
+    const std::vector<StateId> &cur = (*frames)[f];
+    for (size_t i = 0; i < cur.size(); i++)
+      for (size_t j = i + 1; j < cur.size(); j++)
+        if (Rand() % 4 == 0)
+          lat->AddArc(cur[i], LatticeArc(0, RandWord(), RandLatticeWeight(),
+                                         cur[j]));
+    if (f == num_frames) {
+      for (size_t i = 0; i < cur.size(); i++)
+        if (i == 0 || Rand() % 2 == 0)
+          lat->SetFinal(cur[i], RandLatticeWeight());
+      break;
+    }
+    const std::vector<StateId> &next = (*frames)[f + 1];
+    for (size_t j = 0; j < next.size(); j++) {
+      // Every state can be reached from the start state.
+      lat->AddArc(cur[Rand() % cur.size()],
+                  LatticeArc(1 + Rand() % 10, RandWord(), RandLatticeWeight(),
+                             next[j]));
+      for (size_t i = 0; i < cur.size(); i++)
+        if (Rand() % 3 == 0)
+          lat->AddArc(cur[i], LatticeArc(1 + Rand() % 10, RandWord(),
+                                         RandLatticeWeight(), next[j]));
+    }
+  }
+}
+
+// Does for a lattice made by RandLayeredLattice() what
+// LatticeFasterDecoderTpl::GetRawLatticeChunk() does for the decoder's
+// tokens.
+static void GetRawLatticeChunk(
+    const Lattice &lat, const std::vector<std::vector<StateId> > &frames,
+    int32 begin_frame, int32 end_frame,
+    const unordered_map<StateId, StateId> &begin_states,
+    Lattice *ofst, std::vector<std::pair<StateId, StateId> > *end_states) {
+  int32 first_frame = (begin_frame == 0 ? 0 : begin_frame + 1);
+  unordered_map<StateId, StateId> state_map;
+  for (int32 f = first_frame; f <= end_frame; f++) {
+    for (size_t i = 0; i < frames[f].size(); i++) {
+      StateId s = ofst->AddState();
+      state_map[frames[f][i]] = s;
+      if (f == end_frame && end_states != NULL)
+        end_states->push_back(std::make_pair(frames[f][i], s));
+    }
+  }
+  if (begin_frame == 0)
+    ofst->SetStart(0);
+  for (int32 f = begin_frame; f <= end_frame; f++) {
+    for (size_t i = 0; i < frames[f].size(); i++) {
+      StateId s = frames[f][i], cur_state;
+      if (f < first_frame) {
+        unordered_map<StateId, StateId>::const_iterator iter =
+            begin_states.find(s);
+        if (iter == begin_states.end())
+          continue;
+        cur_state = iter->second;
+      } else {
+        cur_state = state_map[s];
+      }
+      for (fst::ArcIterator<Lattice> aiter(lat, s); !aiter.Done();
+           aiter.Next()) {
+        const LatticeArc &arc = aiter.Value();
+        bool emitting = (arc.ilabel != 0);
+        if ((f < first_frame && !emitting) || (f == end_frame && emitting))
+          continue;
+        KALDI_ASSERT(state_map.count(arc.nextstate) != 0);
+        ofst->AddArc(cur_state, LatticeArc(arc.ilabel, arc.olabel, arc.weight,
+                                           state_map[arc.nextstate]));
+      }
+      if (f == end_frame && end_states == NULL &&
+          lat.Final(s) != LatticeWeight::Zero())
+        ofst->SetFinal(cur_state, lat.Final(s));
+    }
+  }
+}
+
+// Outputs the determinized lattice, given the frames that the determinizer
+// has determinized, whose last states are 'determinized_states'.
+static void GetIncrementalLattice(
+    const Lattice &lat, const std::vector<std::vector<StateId> > &frames,
+    const LatticeIncrementalDeterminizer &determinizer,
+    const std::vector<StateId> &determinized_states,
+    CompactLattice *clat) {
+  Lattice raw_chunk;
+  std::vector<StateId> token_states;
+  determinizer.InitializeRawLatticeChunk(&raw_chunk, &token_states);
+  unordered_map<StateId, StateId> begin_states;
+  for (size_t i = 0; i < token_states.size(); i++)
+    if (token_states[i] != fst::kNoStateId)
+      begin_states[determinized_states[i]] = token_states[i];
+  GetRawLatticeChunk(lat, frames, determinizer.NumFramesDeterminized(),
+                     frames.size() - 1, begin_states, &raw_chunk, NULL);
+  determinizer.GetLattice(&raw_chunk, clat);
+}
+
+static void TestIncrementalDeterminization() {
+  int32 num_frames = 1 + Rand() % 30;
+  Lattice lat;
+  std::vector<std::vector<StateId> > frames;
+  RandLayeredLattice(num_frames, &lat, &frames);
+
+  TransitionModel trans_model;  // Not used, as phone_determinize is false.
+  fst::DeterminizeLatticePhonePrunedOptions det_opts;
+  det_opts.phone_determinize = false;
+  BaseFloat beam = 1000.0;  // Large enough that nothing is pruned.
+
+  Lattice lat_copy(lat);
+  CompactLattice clat_ref;
+  DeterminizeLatticePhonePrunedWrapper(trans_model, &lat_copy, beam,
+                                       &clat_ref, det_opts);
+
+  LatticeIncrementalDeterminizer determinizer(trans_model, beam, det_opts);
+  std::vector<StateId> determinized_states;
+  while (true) {
+    CompactLattice clat;
+    GetIncrementalLattice(lat, frames, determinizer, determinized_states,
+                          &clat);
+    KALDI_ASSERT(fst::RandEquivalent(clat_ref, clat, 5, 0.01, Rand(), 100));
+
+    int32 begin_frame = determinizer.NumFramesDeterminized(),
+        end_frame = begin_frame + 1 + Rand() % 5;
+    if (end_frame >= num_frames)
+      break;
+    Lattice raw_chunk;
+    std::vector<StateId> token_states;
+    determinizer.InitializeRawLatticeChunk(&raw_chunk, &token_states);
+    unordered_map<StateId, StateId> begin_states;
+    for (size_t i = 0; i < token_states.size(); i++)
+      if (token_states[i] != fst::kNoStateId)
+        begin_states[determinized_states[i]] = token_states[i];
+    std::vector<std::pair<StateId, StateId> > end_toks;
+    GetRawLatticeChunk(lat, frames, begin_frame, end_frame, begin_states,
+                       &raw_chunk, &end_toks);
+    std::vector<std::pair<StateId, BaseFloat> > end_states;
+    determinized_states.clear();
+    for (size_t i = 0; i < end_toks.size(); i++) {
+      determinized_states.push_back(end_toks[i].first);
+      end_states.push_back(std::make_pair(end_toks[i].second, RandUniform()));
+    }
+    KALDI_ASSERT(determinizer.AcceptRawLatticeChunk(end_frame, end_states,
+                                                    &raw_chunk));
+    KALDI_ASSERT(determinizer.NumFramesDeterminized() == end_frame);
+  }
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 200; i++)
+    TestIncrementalDeterminization();
+  KALDI_LOG << "Success.";
+}
@@ -0,0 +1,376 @@
+// lat/determinize-lattice-incremental.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <limits>
+
+#include "lat/determinize-lattice-incremental.h"
+#include "util/stl-utils.h"
+
+namespace kaldi {
+
+const LatticeIncrementalDeterminizer::Label
+    LatticeIncrementalDeterminizer::kStateLabelOffset;
+const LatticeIncrementalDeterminizer::Label
+    LatticeIncrementalDeterminizer::kTokenLabelOffset;
+
+// Adds the arc 'arc' of a CompactLattice to 'lat', from state 'src' to state
+// 'dest', as a sequence of arcs with one transition-id each; the first one has
+// the weight and the output label 'olabel'.
+static void AddCompactLatticeArcToLattice(const CompactLatticeArc &arc,
+                                          LatticeArc::StateId src,
+                                          LatticeArc::StateId dest,
+                                          LatticeArc::Label olabel,
+                                          Lattice *lat) {
+  const std::vector<int32> &string = arc.weight.String();
+  size_t n = string.size();
+  if (n == 0) {
+    lat->AddArc(src, LatticeArc(0, olabel, arc.weight.Weight(), dest));
+    return;
+  }
+  LatticeArc::StateId cur_state = src;
+  for (size_t i = 0; i < n; i++) {
+    LatticeArc::StateId next_state = (i + 1 == n ? dest : lat->AddState());
+    lat->AddArc(cur_state,
+                LatticeArc(string[i], (i == 0 ? olabel : 0),
+                           (i == 0 ? arc.weight.Weight() : LatticeWeight::One()),
+                           next_state));
+    cur_state = next_state;
+  }
+}
+
+LatticeIncrementalDeterminizer::LatticeIncrementalDeterminizer(
+    const TransitionModel &trans_model, BaseFloat lattice_beam,
+    const fst::DeterminizeLatticePhonePrunedOptions &det_opts):
+    trans_model_(trans_model), lattice_beam_(lattice_beam),
+    det_opts_(det_opts) {
+  Init();
+}
+
+void LatticeIncrementalDeterminizer::Init() {
+  num_frames_ = 0;
+  num_tokens_ = 0;
+  clat_.DeleteStates();
+  final_arcs_.clear();
+  forward_costs_.clear();
+  arcs_in_.clear();
+}
+
+void LatticeIncrementalDeterminizer::GetRedeterminizedStates(
+    std::vector<StateId> *redet_states) const {
+  unordered_set<StateId> seen;
+  std::vector<StateId> queue;
+  for (size_t i = 0; i < final_arcs_.size(); i++) {
+    StateId s = final_arcs_[i].nextstate;  // The state it leaves from.
+    if (forward_costs_[s] != std::numeric_limits<BaseFloat>::infinity() &&
+        seen.insert(s).second)
+      queue.push_back(s);
+  }
+  while (!queue.empty()) {
+    StateId s = queue.back();
+    queue.pop_back();
+    for (fst::ArcIterator<CompactLattice> aiter(clat_, s); !aiter.Done();
+         aiter.Next()) {
+      StateId nextstate = aiter.Value().nextstate;
+      if (seen.insert(nextstate).second)
+        queue.push_back(nextstate);
+    }
+  }
+  redet_states->assign(seen.begin(), seen.end());
+  std::sort(redet_states->begin(), redet_states->end());
+}
+
+void LatticeIncrementalDeterminizer::InitializeRawLatticeChunk(
+    Lattice *olat, std::vector<LatticeArc::StateId> *token_states) const {
+  olat->DeleteStates();
+  token_states->clear();
+  if (num_frames_ == 0)
+    return;
+  token_states->resize(num_tokens_, fst::kNoStateId);
+  LatticeArc::StateId start_state = olat->AddState();
+  olat->SetStart(start_state);
+
+  std::vector<StateId> redet_states;
+  GetRedeterminizedStates(&redet_states);
+  unordered_map<StateId, LatticeArc::StateId> state_map;
+  for (size_t i = 0; i < redet_states.size(); i++)
+    state_map[redet_states[i]] = olat->AddState();
+
+  for (size_t i = 0; i < redet_states.size(); i++) {
+    StateId s = redet_states[i];
+    LatticeArc::StateId olat_state = state_map[s];
+    // The arc from the start state has the cost of reaching s, so that the
+    // pruning in determinization works as it would for the whole lattice;
+    // AppendChunk() subtracts it again.
+    if (forward_costs_[s] != std::numeric_limits<BaseFloat>::infinity())
+      olat->AddArc(start_state,
+                   LatticeArc(0, kStateLabelOffset + s,
+                              LatticeWeight(forward_costs_[s], 0.0),
+                              olat_state));
+    for (fst::ArcIterator<CompactLattice> aiter(clat_, s); !aiter.Done();
+         aiter.Next()) {
+      const CompactLatticeArc &arc = aiter.Value();
+      AddCompactLatticeArcToLattice(arc, olat_state, state_map[arc.nextstate],
+                                    arc.olabel, olat);
+    }
+  }
+  for (size_t i = 0; i < final_arcs_.size(); i++) {
+    const CompactLatticeArc &arc = final_arcs_[i];
+    unordered_map<StateId, LatticeArc::StateId>::const_iterator iter =
+        state_map.find(arc.nextstate);
+    if (iter == state_map.end())
+      continue;  // Its state was not reachable.
+    LatticeArc::StateId &token_state =
+        (*token_states)[arc.ilabel - kTokenLabelOffset];
+    if (token_state == fst::kNoStateId)
+      token_state = olat->AddState();
+    AddCompactLatticeArcToLattice(arc, iter->second, token_state, 0, olat);
+  }
+}
+
+void LatticeIncrementalDeterminizer::Determinize(
+    Lattice *raw_chunk, CompactLattice *chunk) const {
+  DeterminizeLatticePhonePrunedWrapper(trans_model_, raw_chunk, lattice_beam_,
+                                       chunk, det_opts_);
+  if (chunk->Start() != fst::kNoStateId && !fst::TopSort(chunk))
+    KALDI_ERR << "Determinized lattice has cycles.";
+}
+
+bool LatticeIncrementalDeterminizer::AcceptRawLatticeChunk(
+    int32 end_frame,
+    const std::vector<std::pair<LatticeArc::StateId, BaseFloat> > &end_states,
+    Lattice *raw_chunk) {
+  KALDI_ASSERT(end_frame > num_frames_);
+  LatticeArc::StateId final_state = raw_chunk->AddState();
+  raw_chunk->SetFinal(final_state, LatticeWeight::One());
+  std::vector<BaseFloat> token_costs(end_states.size());
+  for (size_t i = 0; i < end_states.size(); i++) {
+    token_costs[i] = end_states[i].second;
+    raw_chunk->AddArc(end_states[i].first,
+                      LatticeArc(0, kTokenLabelOffset + i,
+                                 LatticeWeight(token_costs[i], 0.0),
+                                 final_state));
+  }
+  CompactLattice chunk;
+  Determinize(raw_chunk, &chunk);
+  std::vector<CompactLatticeArc> final_arcs;
+  if (chunk.Start() != fst::kNoStateId)
+    AppendChunk(chunk, token_costs, &clat_, &final_arcs, &forward_costs_,
+                &arcs_in_);
+  if (chunk.Start() == fst::kNoStateId || clat_.Start() == fst::kNoStateId) {
+    KALDI_WARN << "Empty lattice for frames " << num_frames_ << " to "
+               << end_frame << "; starting again from the first frame.";
+    Init();
+    return false;
+  }
+  final_arcs_.swap(final_arcs);
+  num_frames_ = end_frame;
+  num_tokens_ = end_states.size();
+  KALDI_VLOG(3) << "Determinized " << num_frames_ << " frames; lattice has "
+                << clat_.NumStates() << " states, " << final_arcs_.size()
+                << " final arcs.";
+  return true;
+}
+
+void LatticeIncrementalDeterminizer::AppendChunk(
+    const CompactLattice &chunk,
+    const std::vector<BaseFloat> &token_costs,
+    CompactLattice *clat,
+    std::vector<CompactLatticeArc> *final_arcs,
+    std::vector<BaseFloat> *forward_costs,
+    std::vector<std::vector<std::pair<StateId, size_t> > > *arcs_in) const {
+  const bool first_chunk = (clat_.Start() == fst::kNoStateId);
+  std::vector<StateId> redet_states;
+  if (!first_chunk)
+    GetRedeterminizedStates(&redet_states);
+  const StateId chunk_start = chunk.Start(),
+      num_chunk_states = chunk.NumStates(),
+      old_start = clat->Start();
+  const bool start_redet = !first_chunk &&
+      std::binary_search(redet_states.begin(), redet_states.end(), old_start);
+
+  // All states of the chunk become states of 'clat', except its start state
+  // (unless this is the first chunk) and its final state, which is reached
+  // only by arcs with token labels.  Because the chunk is topologically
+  // sorted, the new states are too.
+  std::vector<bool> needed(num_chunk_states, false);
+  if (first_chunk)
+    needed[chunk_start] = true;
+  for (StateId c = 0; c < num_chunk_states; c++)
+    for (fst::ArcIterator<CompactLattice> aiter(chunk, c); !aiter.Done();
+         aiter.Next())
+      if (aiter.Value().ilabel < kTokenLabelOffset)
+        needed[aiter.Value().nextstate] = true;
+  const StateId first_new_state = clat->NumStates();
+  std::vector<StateId> state_map(num_chunk_states, fst::kNoStateId);
+  for (StateId c = 0; c < num_chunk_states; c++)
+    if (needed[c])
+      state_map[c] = clat->AddState();
+  const StateId num_states = clat->NumStates();
+  if (forward_costs != NULL) {
+    forward_costs->resize(num_states,
+                          std::numeric_limits<BaseFloat>::infinity());
+    arcs_in->resize(num_states);
+  }
+
+  // The arcs leaving the chunk's start state are labeled with the
+  // redeterminized states they replace; redirect the arcs entering those
+  // states from the other states to their destinations.
+  StateId new_start = (first_chunk ? state_map[chunk_start] : fst::kNoStateId);
+  CompactLatticeWeight start_weight = CompactLatticeWeight::One();
+  if (!first_chunk) {
+    for (fst::ArcIterator<CompactLattice> aiter(chunk, chunk_start);
+         !aiter.Done(); aiter.Next()) {
+      const CompactLatticeArc &arc = aiter.Value();
+      KALDI_ASSERT(arc.ilabel >= kStateLabelOffset &&
+                   arc.ilabel < kTokenLabelOffset);
+      StateId s = arc.ilabel - kStateLabelOffset,
+          dest = state_map[arc.nextstate];
+      const LatticeWeight &w = arc.weight.Weight();
+      CompactLatticeWeight weight(
+          LatticeWeight(w.Value1() - forward_costs_[s], w.Value2()),
+          arc.weight.String());
+      if (s == old_start) {
+        new_start = dest;
+        start_weight = weight;
+      }
+      const std::vector<std::pair<StateId, size_t> > &in = arcs_in_[s];
+      for (size_t i = 0; i < in.size(); i++) {
+        StateId src = in[i].first;
+        if (std::binary_search(redet_states.begin(), redet_states.end(), src))
+          continue;  // That arc is part of the chunk.
+        fst::MutableArcIterator<CompactLattice> in_aiter(clat, src);
+        in_aiter.Seek(in[i].second);
+        CompactLatticeArc in_arc = in_aiter.Value();
+        KALDI_ASSERT(in_arc.nextstate == s);
+        in_arc.weight = fst::Times(in_arc.weight, weight);
+        in_arc.nextstate = dest;
+        in_aiter.SetValue(in_arc);
+        if (arcs_in != NULL)
+          (*arcs_in)[dest].push_back(in[i]);
+      }
+    }
+    // The arcs entering redeterminized states that were pruned away are left
+    // as they are; they lead nowhere, so they are removed on output.
+    if (start_redet && new_start == fst::kNoStateId) {
+      clat->DeleteStates();
+      return;
+    }
+  }
+
+  for (StateId c = 0; c < num_chunk_states; c++) {
+    StateId s = state_map[c];
+    if (s == fst::kNoStateId)
+      continue;
+    for (fst::ArcIterator<CompactLattice> aiter(chunk, c); !aiter.Done();
+         aiter.Next()) {
+      const CompactLatticeArc &arc = aiter.Value();
+      if (arc.ilabel >= kTokenLabelOffset) {
+        KALDI_ASSERT(final_arcs != NULL);
+        CompactLatticeWeight weight =
+            fst::Times(arc.weight, chunk.Final(arc.nextstate));
+        BaseFloat token_cost = token_costs[arc.ilabel - kTokenLabelOffset];
+        weight.SetWeight(LatticeWeight(weight.Weight().Value1() - token_cost,
+                                       weight.Weight().Value2()));
+        // Note: 'nextstate' is the state the arc leaves from.
+        final_arcs->push_back(
+            CompactLatticeArc(arc.ilabel, arc.olabel, weight, s));
+      } else {
+        StateId nextstate = state_map[arc.nextstate];
+        KALDI_ASSERT(nextstate != fst::kNoStateId);
+        clat->AddArc(s, CompactLatticeArc(arc.ilabel, arc.olabel, arc.weight,
+                                          nextstate));
+        if (arcs_in != NULL)
+          (*arcs_in)[nextstate].push_back(
+              std::make_pair(s, clat->NumArcs(s) - 1));
+      }
+    }
+    CompactLatticeWeight final_weight = chunk.Final(c);
+    if (final_weight != CompactLatticeWeight::Zero()) {
+      KALDI_ASSERT(final_arcs == NULL);
+      clat->SetFinal(s, final_weight);
+    }
+  }
+
+  for (size_t i = 0; i < redet_states.size(); i++) {
+    clat->DeleteArcs(redet_states[i]);
+    if (arcs_in != NULL)
+      (*arcs_in)[redet_states[i]].clear();
+  }
+
+  if (first_chunk || start_redet) {
+    clat->SetStart(new_start);
+    if (start_redet) {
+      // Nothing enters the new start state, so the weight of the arc to it
+      // from the chunk's start state can go on the arcs that leave it.
+      for (fst::MutableArcIterator<CompactLattice> aiter(clat, new_start);
+           !aiter.Done(); aiter.Next()) {
+        CompactLatticeArc arc = aiter.Value();
+        arc.weight = fst::Times(start_weight, arc.weight);
+        aiter.SetValue(arc);
+      }
+      if (clat->Final(new_start) != CompactLatticeWeight::Zero())
+        clat->SetFinal(new_start,
+                       fst::Times(start_weight, clat->Final(new_start)));
+      if (final_arcs != NULL)
+        for (size_t i = 0; i < final_arcs->size(); i++)
+          if ((*final_arcs)[i].nextstate == new_start)
+            (*final_arcs)[i].weight =
+                fst::Times(start_weight, (*final_arcs)[i].weight);
+    }
+  }
+
+  if (forward_costs != NULL) {
+    // The states before first_new_state keep their forward costs; the arcs
+    // entering the new states are from those or from new states before them.
+    for (StateId s = first_new_state; s < num_states; s++) {
+      BaseFloat cost = (s == clat->Start() ? 0.0 :
+                        std::numeric_limits<BaseFloat>::infinity());
+      const std::vector<std::pair<StateId, size_t> > &in = (*arcs_in)[s];
+      for (size_t i = 0; i < in.size(); i++) {
+        fst::ArcIterator<CompactLattice> aiter(*clat, in[i].first);
+        aiter.Seek(in[i].second);
+        cost = std::min<BaseFloat>(
+            cost, (*forward_costs)[in[i].first] +
+                      ConvertToCost(aiter.Value().weight));
+      }
+      (*forward_costs)[s] = cost;
+    }
+  }
+}
+
+void LatticeIncrementalDeterminizer::GetLattice(Lattice *raw_chunk,
+                                                CompactLattice *clat) const {
+  if (num_frames_ == 0) {
+    DeterminizeLatticePhonePrunedWrapper(trans_model_, raw_chunk,
+                                         lattice_beam_, clat, det_opts_);
+    return;
+  }
+  CompactLattice chunk;
+  Determinize(raw_chunk, &chunk);
+  if (chunk.Start() == fst::kNoStateId) {
+    clat->DeleteStates();
+    return;
+  }
+  *clat = clat_;
+  AppendChunk(chunk, std::vector<BaseFloat>(), clat, NULL, NULL, NULL);
+  fst::Connect(clat);
+}
+
+}  // namespace kaldi
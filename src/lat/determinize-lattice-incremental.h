@@ -0,0 +1,180 @@
+// lat/determinize-lattice-incremental.h
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_LAT_DETERMINIZE_LATTICE_INCREMENTAL_H_
+#define KALDI_LAT_DETERMINIZE_LATTICE_INCREMENTAL_H_
+
+#include <utility>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "hmm/transition-model.h"
+#include "lat/kaldi-lattice.h"
+#include "lat/determinize-lattice-pruned.h"
+
+namespace kaldi {
+
+/**
+   LatticeIncrementalDeterminizer determinizes the raw lattice of an
+   utterance that is still being decoded in chunks of frames, so that when the
+   lattice is needed repeatedly (e.g. for partial results in online decoding)
+   the frames that were already determinized do not have to be determinized
+   again.  The result is the same as DeterminizeLatticePhonePrunedWrapper()
+   applied to the whole raw lattice, except for the effects of pruning.
+
+   The determinized lattice of the frames so far (up to NumFramesDeterminized())
+   is kept in the form of a CompactLattice whose paths end in "final arcs", one
+   for each way of reaching each of the decoder's tokens on the last of those
+   frames.  To add the next chunk of frames, the states of that lattice from
+   which a final arc can be reached (typically just the last few states) are
+   converted back into a raw lattice, with arcs labeled with their state-ids
+   leaving a new start state; the tokens that the final arcs lead to are
+   states in that raw lattice too, and the decoder adds the raw lattice of the
+   new frames to it (see LatticeFasterDecoderTpl::GetRawLatticeChunk()).  This
+   is determinized, and the result replaces the states that were converted.
+   The cost of this depends only on the size of the chunk and the part of the
+   lattice that is redeterminized, not on the length of the utterance.
+
+   The words in the lattice must be less than kStateLabelOffset.
+
+   Usage, where 'decoder' is the decoder and 'toks' is a vector of Token
+   pointers kept between calls:
+
+   \code
+     Lattice raw_chunk;
+     std::vector<LatticeArc::StateId> token_states;
+     determinizer.InitializeRawLatticeChunk(&raw_chunk, &token_states);
+     // ... map toks[i] to token_states[i], ask the decoder for the raw lattice
+     // from frame determinizer.NumFramesDeterminized() to end_frame, and set
+     // 'toks' and 'end_states' from its tokens on frame end_frame ...
+     determinizer.AcceptRawLatticeChunk(end_frame, end_states, &raw_chunk);
+   \endcode
+
+   and GetLattice() similarly, for the remaining frames.
+ */
+class LatticeIncrementalDeterminizer {
+ public:
+  typedef CompactLatticeArc::StateId StateId;
+  typedef CompactLatticeArc::Label Label;
+
+  // Labels in the raw lattice chunks, on the arcs leaving the start state
+  // (these are kStateLabelOffset plus a state-id in the determinized lattice)
+  // and on the arcs to the final state (kTokenLabelOffset plus the index of a
+  // token).
+  static const Label kStateLabelOffset = 100000000;
+  static const Label kTokenLabelOffset = 200000000;
+
+  LatticeIncrementalDeterminizer(
+      const TransitionModel &trans_model, BaseFloat lattice_beam,
+      const fst::DeterminizeLatticePhonePrunedOptions &det_opts);
+
+  /// Forgets the frames determinized so far, e.g. at the start of an
+  /// utterance.
+  void Init();
+
+  /// The number of frames that have been determinized (i.e. the end_frame
+  /// of the last successful call to AcceptRawLatticeChunk()), or 0.
+  int32 NumFramesDeterminized() const { return num_frames_; }
+
+  /// Starts the raw lattice of the next chunk.  If no frames have been
+  /// determinized, it just makes 'olat' and 'token_states' empty.  Otherwise
+  /// 'olat' gets a start state, the states of the determinized lattice that
+  /// will be redeterminized, and a state for each of the tokens on frame
+  /// NumFramesDeterminized(): token_states[i] is the state for the token that
+  /// was end_states[i] in the last call to AcceptRawLatticeChunk(), or
+  /// fst::kNoStateId if it was pruned away.  The raw lattice of the frames
+  /// after that must be added starting from those states.
+  void InitializeRawLatticeChunk(
+      Lattice *olat, std::vector<LatticeArc::StateId> *token_states) const;
+
+  /// Determinizes the raw lattice chunk 'raw_chunk' (which is destroyed),
+  /// which must contain the raw lattice up to frame 'end_frame' and no final
+  /// states, and appends it to the determinized lattice.  'end_states' are
+  /// the states in 'raw_chunk' of the tokens on frame 'end_frame', with a cost
+  /// for each that should approximate its backward cost (up to a constant), to
+  /// help the pruning; it does not become part of the lattice.  Returns false
+  /// (after printing a warning, and calling Init()) if the result was empty.
+  bool AcceptRawLatticeChunk(
+      int32 end_frame,
+      const std::vector<std::pair<LatticeArc::StateId, BaseFloat> > &end_states,
+      Lattice *raw_chunk);
+
+  /// Outputs the determinized lattice of the whole utterance so far, given
+  /// the raw lattice 'raw_chunk' (which is destroyed) of the frames not yet
+  /// determinized, started by InitializeRawLatticeChunk() and with its
+  /// final-probs set as in LatticeFasterDecoderTpl::GetRawLattice().  If no
+  /// frames have been determinized, 'raw_chunk' should be the whole raw
+  /// lattice, and the output is exactly what
+  /// DeterminizeLatticePhonePrunedWrapper() would output.
+  void GetLattice(Lattice *raw_chunk, CompactLattice *clat) const;
+
+ private:
+  // Determinizes 'raw_chunk' into 'chunk', which is topologically sorted.
+  void Determinize(Lattice *raw_chunk, CompactLattice *chunk) const;
+
+  // Outputs the states of clat_ that are redeterminized in the next chunk:
+  // those with final arcs, and those reachable from them; sorted.
+  void GetRedeterminizedStates(std::vector<StateId> *redet_states) const;
+
+  // Appends the determinized chunk 'chunk' to 'clat', which must be a copy of
+  // clat_ (or clat_ itself).  If 'final_arcs' is non-NULL, the chunk's paths
+  // end with arcs labeled with token labels, which are output to 'final_arcs'
+  // with the costs in 'token_costs' subtracted, and 'forward_costs' and
+  // 'arcs_in' are updated for the new states; these must then be the members
+  // of this class of the same names.  Otherwise the chunk's final-probs become
+  // final-probs of 'clat'.  The redeterminized states are left without arcs.
+  void AppendChunk(const CompactLattice &chunk,
+                   const std::vector<BaseFloat> &token_costs,
+                   CompactLattice *clat,
+                   std::vector<CompactLatticeArc> *final_arcs,
+                   std::vector<BaseFloat> *forward_costs,
+                   std::vector<std::vector<std::pair<StateId, size_t> > >
+                       *arcs_in) const;
+
+  const TransitionModel &trans_model_;
+  BaseFloat lattice_beam_;
+  fst::DeterminizeLatticePhonePrunedOptions det_opts_;
+
+  int32 num_frames_;
+  // The number of tokens on frame num_frames_ (i.e. the number of end_states
+  // in the last call to AcceptRawLatticeChunk()).
+  int32 num_tokens_;
+
+  // The determinized lattice up to frame num_frames_.  It has no final-probs;
+  // its paths end with the arcs in final_arcs_.  Its states are numbered in
+  // topological order.  Redeterminized states are not removed from it (that
+  // would renumber the states), but they are left without arcs, so they are
+  // removed when the lattice is output.
+  CompactLattice clat_;
+  // The arcs from states of clat_ to the tokens on frame num_frames_; the
+  // labels are token labels (kTokenLabelOffset plus the token index), and
+  // 'nextstate' is the state the arc leaves from, not the one it enters.
+  std::vector<CompactLatticeArc> final_arcs_;
+  // The best cost of reaching each state of clat_ from its start state.
+  std::vector<BaseFloat> forward_costs_;
+  // For each state of clat_, the arcs entering it, as pairs (state, arc
+  // index); these are needed to redirect them when it is redeterminized.
+  std::vector<std::vector<std::pair<StateId, size_t> > > arcs_in_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(LatticeIncrementalDeterminizer);
+};
+
+}  // namespace kaldi
+
+#endif  // KALDI_LAT_DETERMINIZE_LATTICE_INCREMENTAL_H_
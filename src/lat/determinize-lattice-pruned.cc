@@ -27,6 +27,7 @@
 #include "lat/minimize-lattice.h"   // for minimization
 #include "lat/push-lattice.h"       // for minimization
 #include "lat/determinize-lattice-pruned.h"
+#include "util/kaldi-metrics.h"
 
 namespace fst {
 
@@ -1502,6 +1503,24 @@ bool DeterminizeLatticePhonePrunedWrapper(
   ans = DeterminizeLatticePhonePruned<kaldi::LatticeWeight, kaldi::int32>(
       trans_model, ifst, beam, ofst, opts);
   Connect(ofst);
+
+  // Export the lattice sizes as metrics (see util/kaldi-metrics.h); this
+  // function is used by most of the decoding programs and pipelines.
+  kaldi::MetricsRegistry &registry = kaldi::MetricsRegistry::Global();
+  static kaldi::MetricsHistogram *num_states_histogram =
+      registry.GetHistogram("kaldi_lattice_states", "Number of states in "
+                            "each lattice after determinization.",
+                            kaldi::ExponentialBuckets(16.0, 2.0, 16)),
+      *num_arcs_histogram =
+      registry.GetHistogram("kaldi_lattice_arcs", "Number of arcs in each "
+                            "lattice after determinization.",
+                            kaldi::ExponentialBuckets(16.0, 2.0, 16));
+  kaldi::int32 num_states = ofst->NumStates();
+  size_t num_arcs = 0;
+  for (kaldi::int32 s = 0; s < num_states; s++)
+    num_arcs += ofst->NumArcs(s);
+  num_states_histogram->Observe(num_states);
+  num_arcs_histogram->Observe(num_arcs);
   return ans;
 }
 
@@ -0,0 +1,199 @@
+// lat/flat-lattice-test.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lat/flat-lattice.h"
+#include "lat/lattice-functions.h"
+
+namespace kaldi {
+
+// Makes a random acyclic CompactLattice, topologically sorted, with words
+// 0 to 5 and random transition-id strings.
+static void RandAcyclicCompactLattice(CompactLattice *clat) {
+  clat->DeleteStates();
+  int32 num_states = 1 + Rand() % 20;
+  for (int32 s = 0; s < num_states; s++)
+    clat->AddState();
+  clat->SetStart(0);
+  for (int32 s = 0; s < num_states; s++) {
+    int32 num_arcs = (s + 1 < num_states ? 1 + Rand() % 3 : 0);
+    for (int32 i = 0; i < num_arcs; i++) {
+      int32 word = Rand() % 6,
+          nextstate = s + 1 + Rand() % (num_states - s - 1);
+      std::vector<int32> str(Rand() % 4);
+      for (size_t j = 0; j < str.size(); j++)
+        str[j] = 1 + Rand() % 100;
+      CompactLatticeWeight weight(LatticeWeight(10.0 * RandUniform(),
+                                                10.0 * RandUniform()), str);
+      clat->AddArc(s, CompactLatticeArc(word, word, weight, nextstate));
+    }
+    if (s + 1 == num_states || Rand() % 4 == 0) {
+      std::vector<int32> str(Rand() % 2, 1 + Rand() % 100);
+      clat->SetFinal(s, CompactLatticeWeight(LatticeWeight(RandUniform(), 0.0),
+                                             str));
+    }
+  }
+}
+
+static void TestFlatLatticeConversion() {
+  CompactLattice clat, clat2;
+  RandAcyclicCompactLattice(&clat);
+  FlatCompactLattice flat;
+  ConvertCompactLatticeToFlat(clat, &flat);
+  KALDI_ASSERT(flat.IsTopSorted());
+  ConvertFlatToCompactLattice(flat, &clat2);
+  KALDI_ASSERT(fst::Equal(clat, clat2));
+}
+
+static void TestFlatLatticeIo(bool binary) {
+  CompactLattice clat;
+  RandAcyclicCompactLattice(&clat);
+  FlatCompactLattice flat;
+  ConvertCompactLatticeToFlat(clat, &flat);
+
+  // What FlatCompactLattice writes can be read as a CompactLattice ...
+  std::ostringstream os;
+  KALDI_ASSERT(flat.Write(os, binary));
+  std::istringstream is(os.str());
+  CompactLatticeHolder holder;
+  KALDI_ASSERT(holder.Read(is));
+  // (In text form the weights are rounded.)
+  KALDI_ASSERT(fst::Equal(clat, holder.Value(), 0.001));
+
+  // ... and vice versa.
+  std::ostringstream os2;
+  KALDI_ASSERT(CompactLatticeHolder::Write(os2, binary, clat));
+  std::istringstream is2(os2.str());
+  FlatCompactLatticeHolder flat_holder;
+  KALDI_ASSERT(flat_holder.Read(is2));
+  CompactLattice clat2;
+  ConvertFlatToCompactLattice(flat_holder.Value(), &clat2);
+  KALDI_ASSERT(fst::Equal(clat, clat2, 0.001));
+}
+
+static void TestFlatLatticeAlgorithms() {
+  CompactLattice clat;
+  RandAcyclicCompactLattice(&clat);
+  FlatCompactLattice flat;
+  ConvertCompactLatticeToFlat(clat, &flat);
+
+  std::vector<double> alpha, alpha2, beta, beta2;
+  KALDI_ASSERT(ComputeCompactLatticeAlphas(clat, &alpha) &&
+               ComputeCompactLatticeAlphas(flat, &alpha2) &&
+               ComputeCompactLatticeBetas(clat, &beta) &&
+               ComputeCompactLatticeBetas(flat, &beta2));
+  KALDI_ASSERT(alpha == alpha2 && beta == beta2);
+
+  BaseFloat beam = 5.0 * RandUniform() + 0.1;
+  CompactLattice pruned_clat(clat), pruned_clat2;
+  FlatCompactLattice pruned_flat(flat);
+  bool ans = PruneLattice(beam, &pruned_clat);
+  KALDI_ASSERT(PruneLattice(beam, &pruned_flat) == ans);
+  ConvertFlatToCompactLattice(pruned_flat, &pruned_clat2);
+  KALDI_ASSERT(fst::Equal(pruned_clat, pruned_clat2));
+
+  CompactLattice best_path, best_path2;
+  FlatCompactLattice best_path_flat;
+  CompactLatticeShortestPath(clat, &best_path);
+  CompactLatticeShortestPath(flat, &best_path_flat);
+  ConvertFlatToCompactLattice(best_path_flat, &best_path2);
+  KALDI_ASSERT(fst::Equal(best_path, best_path2));
+
+  // A language model with one state, which allows only some of the words.
+  fst::StdVectorFst lm;
+  lm.AddState();
+  lm.SetStart(0);
+  lm.SetFinal(0, RandUniform());
+  for (int32 word = 1; word < 6; word++)
+    if (Rand() % 4 != 0)
+      lm.AddArc(0, fst::StdArc(word, word, RandUniform(), 0));
+  fst::BackoffDeterministicOnDemandFst<fst::StdArc> det_lm(lm);
+  CompactLattice composed, composed2;
+  FlatCompactLattice composed_flat;
+  ComposeCompactLatticeDeterministic(clat, &det_lm, &composed);
+  ComposeCompactLatticeDeterministic(flat, &det_lm, &composed_flat);
+  ConvertFlatToCompactLattice(composed_flat, &composed2);
+  KALDI_ASSERT(fst::Equal(composed, composed2));
+
+  CompactLattice scaled(clat), scaled2;
+  FlatCompactLattice scaled_flat(flat);
+  fst::ScaleLattice(fst::LatticeScale(0.5, 0.1), &scaled);
+  ScaleLattice(fst::LatticeScale(0.5, 0.1), &scaled_flat);
+  ConvertFlatToCompactLattice(scaled_flat, &scaled2);
+  KALDI_ASSERT(fst::Equal(scaled, scaled2));
+
+  AddWordInsPenToCompactLattice(0.5, &scaled);
+  AddWordInsPenToCompactLattice(0.5, &scaled_flat);
+  ConvertFlatToCompactLattice(scaled_flat, &scaled2);
+  KALDI_ASSERT(fst::Equal(scaled, scaled2));
+}
+
+static void TestFlatLatticeTopSortAndConnect() {
+  CompactLattice clat;
+  RandAcyclicCompactLattice(&clat);
+  // Reverse the state order, so that it is not topologically sorted, and add
+  // a state that cannot be reached.
+  CompactLattice reversed;
+  int32 num_states = clat.NumStates();
+  for (int32 s = 0; s <= num_states; s++)
+    reversed.AddState();
+  reversed.SetStart(num_states - 1);
+  for (int32 s = 0; s < num_states; s++) {
+    reversed.SetFinal(num_states - 1 - s, clat.Final(s));
+    for (fst::ArcIterator<CompactLattice> aiter(clat, s); !aiter.Done();
+         aiter.Next()) {
+      CompactLatticeArc arc = aiter.Value();
+      arc.nextstate = num_states - 1 - arc.nextstate;
+      reversed.AddArc(num_states - 1 - s, arc);
+    }
+  }
+  reversed.AddArc(num_states, CompactLatticeArc(1, 1,
+                                                CompactLatticeWeight::One(),
+                                                0));
+  FlatCompactLattice flat;
+  ConvertCompactLatticeToFlat(reversed, &flat);
+  KALDI_ASSERT(!flat.IsTopSorted() || num_states == 1);
+  KALDI_ASSERT(TopSortLattice(&flat) && flat.IsTopSorted());
+  ConnectLattice(&flat);
+  KALDI_ASSERT(flat.Start() == 0);
+  CompactLattice clat2;
+  ConvertFlatToCompactLattice(flat, &clat2);
+  fst::Connect(&clat);
+  KALDI_ASSERT(fst::RandEquivalent(clat, clat2, 5, 0.01, Rand(), 100));
+
+  // A lattice with a cycle cannot be sorted.
+  flat.AddState();
+  FlatCompactLattice::Arc arc(1, 1, LatticeWeight::One(), flat.NumStates() - 1,
+                              0, 0);
+  flat.AddArc(flat.NumStates() - 1, arc);
+  KALDI_ASSERT(!TopSortLattice(&flat));
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 100; i++) {
+    TestFlatLatticeConversion();
+    TestFlatLatticeIo(true);
+    TestFlatLatticeIo(false);
+    TestFlatLatticeAlgorithms();
+    TestFlatLatticeTopSortAndConnect();
+  }
+  KALDI_LOG << "Success.";
+}
@@ -0,0 +1,786 @@
+// lat/flat-lattice.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "lat/flat-lattice.h"
+
+#include <algorithm>
+#include <cctype>
+#include <limits>
+#include <queue>
+#include <utility>
+
+#include "util/stl-utils.h"
+
+namespace kaldi {
+
+typedef FlatCompactLattice::StateId StateId;
+typedef FlatCompactLattice::Arc FlatArc;
+
+// The version of the binary format of VectorFst in OpenFst (not aligned).
+static const int32 kVectorFstFileVersion = 2;
+
+// The offsets are int32, which limits the sizes of the arrays.
+static const int64 kMaxSize = std::numeric_limits<int32>::max();
+
+void FlatCompactLattice::Clear() {
+  start_ = fst::kNoStateId;
+  last_arc_state_ = 0;
+  states_.clear();
+  arcs_.clear();
+  strings_.clear();
+}
+
+void FlatCompactLattice::Swap(FlatCompactLattice *other) {
+  std::swap(start_, other->start_);
+  std::swap(last_arc_state_, other->last_arc_state_);
+  states_.swap(other->states_);
+  arcs_.swap(other->arcs_);
+  strings_.swap(other->strings_);
+}
+
+CompactLatticeWeight FlatCompactLattice::ArcWeight(const Arc &arc) const {
+  const int32 *str = String(arc.string_offset);
+  return CompactLatticeWeight(
+      arc.weight, std::vector<int32>(str, str + arc.string_length));
+}
+
+CompactLatticeWeight FlatCompactLattice::FinalWeight(StateId s) const {
+  const State &state = states_[s];
+  if (state.final_weight == LatticeWeight::Zero())
+    return CompactLatticeWeight::Zero();
+  const int32 *str = String(state.final_string_offset);
+  return CompactLatticeWeight(
+      state.final_weight,
+      std::vector<int32>(str, str + state.final_string_length));
+}
+
+bool FlatCompactLattice::IsTopSorted() const {
+  StateId num_states = NumStates();
+  for (StateId s = 0; s < num_states; s++) {
+    const Arc *arcs = Arcs(s);
+    for (int32 i = 0; i < NumArcs(s); i++)
+      if (arcs[i].nextstate <= s)
+        return false;
+  }
+  return true;
+}
+
+StateId FlatCompactLattice::AddState() {
+  State state;
+  state.arc_offset = static_cast<int32>(arcs_.size());
+  state.num_arcs = 0;
+  state.final_weight = LatticeWeight::Zero();
+  state.final_string_offset = 0;
+  state.final_string_length = 0;
+  states_.push_back(state);
+  return static_cast<StateId>(states_.size()) - 1;
+}
+
+int32 FlatCompactLattice::AddString(const int32 *data, int32 length) {
+  int32 offset = static_cast<int32>(strings_.size());
+  strings_.insert(strings_.end(), data, data + length);
+  return offset;
+}
+
+void FlatCompactLattice::CopyStrings(const FlatCompactLattice &other) {
+  KALDI_ASSERT(strings_.empty());
+  strings_ = other.strings_;
+}
+
+void FlatCompactLattice::AddArc(StateId s, const Arc &arc) {
+  KALDI_ASSERT(s >= last_arc_state_ && s < NumStates() &&
+               "Arcs must be added in order of their source state");
+  KALDI_ASSERT(arc.string_length >= 0 && arc.string_offset >= 0 &&
+               static_cast<size_t>(arc.string_offset) + arc.string_length <=
+               strings_.size());
+  State &state = states_[s];
+  if (state.num_arcs == 0)
+    state.arc_offset = static_cast<int32>(arcs_.size());
+  arcs_.push_back(arc);
+  state.num_arcs++;
+  last_arc_state_ = s;
+}
+
+void FlatCompactLattice::SetFinal(StateId s, const LatticeWeight &weight,
+                                  int32 string_offset, int32 string_length) {
+  KALDI_ASSERT(string_length >= 0 && string_offset >= 0 &&
+               static_cast<size_t>(string_offset) + string_length <=
+               strings_.size());
+  State &state = states_[s];
+  state.final_weight = weight;
+  state.final_string_offset = string_offset;
+  state.final_string_length = string_length;
+}
+
+void FlatCompactLattice::Reserve(StateId num_states, int64 num_arcs,
+                                 int64 string_pool_size) {
+  states_.reserve(num_states);
+  arcs_.reserve(num_arcs);
+  strings_.reserve(string_pool_size);
+}
+
+bool FlatCompactLattice::Write(std::ostream &os, bool binary) const {
+  if (!binary) {
+    CompactLattice clat;
+    ConvertFlatToCompactLattice(*this, &clat);
+    return WriteCompactLattice(os, false, clat);
+  }
+  // This is what VectorFst<CompactLatticeArc>::Write() writes, except that
+  // the properties in the header are only those that every VectorFst has;
+  // the others are "unknown".
+  fst::FstHeader hdr;
+  hdr.SetFstType("vector");
+  hdr.SetArcType(CompactLatticeArc::Type());
+  hdr.SetVersion(kVectorFstFileVersion);
+  hdr.SetFlags(0);
+  hdr.SetProperties(fst::kExpanded | fst::kMutable);
+  hdr.SetStart(start_);
+  hdr.SetNumStates(NumStates());
+  hdr.SetNumArcs(NumArcs());
+  if (!hdr.Write(os, "<unspecified>"))
+    return false;
+  StateId num_states = NumStates();
+  for (StateId s = 0; s < num_states; s++) {
+    const State &state = states_[s];
+    state.final_weight.Write(os);
+    int32 length = (state.final_weight == LatticeWeight::Zero() ? 0 :
+                    state.final_string_length);
+    fst::WriteType(os, length);
+    os.write(reinterpret_cast<const char*>(String(state.final_string_offset)),
+             sizeof(int32) * length);
+    int64 num_arcs = state.num_arcs;
+    fst::WriteType(os, num_arcs);
+    const Arc *arcs = Arcs(s);
+    for (int32 i = 0; i < state.num_arcs; i++) {
+      const Arc &arc = arcs[i];
+      fst::WriteType(os, arc.ilabel);
+      fst::WriteType(os, arc.olabel);
+      arc.weight.Write(os);
+      fst::WriteType(os, arc.string_length);
+      os.write(reinterpret_cast<const char*>(String(arc.string_offset)),
+               sizeof(int32) * arc.string_length);
+      fst::WriteType(os, arc.nextstate);
+    }
+  }
+  return !os.fail();
+}
+
+// Reads a CompactLatticeWeight in the format of CompactLatticeWeight::Read()
+// into 'weight' and the end of 'strings', returning the length of the string.
+static bool ReadFlatWeight(std::istream &is, LatticeWeight *weight,
+                           std::vector<int32> *strings, int32 *length) {
+  weight->Read(is);
+  fst::ReadType(is, length);
+  if (is.fail() || *length < 0)
+    return false;
+  size_t offset = strings->size();
+  strings->resize(offset + *length);
+  is.read(reinterpret_cast<char*>(strings->data() + offset),
+          sizeof(int32) * (*length));
+  return !is.fail();
+}
+
+bool FlatCompactLattice::Read(std::istream &is, bool binary) {
+  Clear();
+  if (!binary) {
+    // The text form is not the one we are trying to make fast.
+    CompactLattice *clat = NULL;
+    if (!ReadCompactLattice(is, false, &clat))
+      return false;
+    ConvertCompactLatticeToFlat(*clat, this);
+    delete clat;
+    return true;
+  }
+  fst::FstHeader hdr;
+  if (!hdr.Read(is, "<unknown>")) {
+    KALDI_WARN << "Reading flat compact lattice: error reading FST header.";
+    return false;
+  }
+  if (hdr.FstType() != "vector" ||
+      hdr.ArcType() != CompactLatticeArc::Type() ||
+      hdr.Version() != kVectorFstFileVersion ||
+      (hdr.GetFlags() & (fst::FstHeader::HAS_ISYMBOLS |
+                         fst::FstHeader::HAS_OSYMBOLS)) != 0 ||
+      hdr.NumStates() < 0 || hdr.NumStates() >= kMaxSize) {
+    // Other types of lattice, and unusual forms of this one, are read the
+    // slow way.
+    CompactLattice *clat = ReadCompactLatticeAfterHeader(is, hdr);
+    if (clat == NULL)
+      return false;
+    ConvertCompactLatticeToFlat(*clat, this);
+    delete clat;
+    return true;
+  }
+  StateId num_states = static_cast<StateId>(hdr.NumStates());
+  if (hdr.NumArcs() > 0)
+    arcs_.reserve(hdr.NumArcs());
+  states_.resize(num_states);
+  start_ = static_cast<StateId>(hdr.Start());
+  if (start_ < fst::kNoStateId || start_ >= num_states) {
+    KALDI_WARN << "Reading flat compact lattice: bad start state " << start_;
+    Clear();
+    return false;
+  }
+  for (StateId s = 0; s < num_states; s++) {
+    State &state = states_[s];
+    state.final_string_offset = static_cast<int32>(strings_.size());
+    int64 num_arcs;
+    if (!ReadFlatWeight(is, &state.final_weight, &strings_,
+                        &state.final_string_length) ||
+        !fst::ReadType(is, &num_arcs) || num_arcs < 0 ||
+        static_cast<int64>(arcs_.size()) + num_arcs >= kMaxSize) {
+      KALDI_WARN << "Reading flat compact lattice: error reading state " << s;
+      Clear();
+      return false;
+    }
+    state.arc_offset = static_cast<int32>(arcs_.size());
+    state.num_arcs = static_cast<int32>(num_arcs);
+    for (int64 i = 0; i < num_arcs; i++) {
+      Arc arc;
+      fst::ReadType(is, &arc.ilabel);
+      fst::ReadType(is, &arc.olabel);
+      arc.string_offset = static_cast<int32>(strings_.size());
+      if (!ReadFlatWeight(is, &arc.weight, &strings_, &arc.string_length) ||
+          !fst::ReadType(is, &arc.nextstate) ||
+          arc.nextstate < 0 || arc.nextstate >= num_states) {
+        KALDI_WARN << "Reading flat compact lattice: error reading arcs of "
+                   << "state " << s;
+        Clear();
+        return false;
+      }
+      arcs_.push_back(arc);
+    }
+    if (static_cast<int64>(strings_.size()) >= kMaxSize) {
+      KALDI_WARN << "Reading flat compact lattice: too many transition-ids.";
+      Clear();
+      return false;
+    }
+  }
+  last_arc_state_ = (num_states > 0 ? num_states - 1 : 0);
+  return true;
+}
+
+
+void ConvertCompactLatticeToFlat(const CompactLattice &clat,
+                                 FlatCompactLattice *flat) {
+  typedef CompactLattice::Arc Arc;
+  flat->Clear();
+  StateId num_states = clat.NumStates();
+  int64 num_arcs = 0, string_pool_size = 0;
+  for (StateId s = 0; s < num_states; s++) {
+    string_pool_size += clat.Final(s).String().size();
+    for (fst::ArcIterator<CompactLattice> aiter(clat, s); !aiter.Done();
+         aiter.Next()) {
+      num_arcs++;
+      string_pool_size += aiter.Value().weight.String().size();
+    }
+  }
+  flat->Reserve(num_states, num_arcs, string_pool_size);
+  for (StateId s = 0; s < num_states; s++)
+    flat->AddState();
+  flat->SetStart(clat.Start());
+  for (StateId s = 0; s < num_states; s++) {
+    CompactLatticeWeight final_weight = clat.Final(s);
+    if (final_weight != CompactLatticeWeight::Zero()) {
+      const std::vector<int32> &str = final_weight.String();
+      flat->SetFinal(s, final_weight.Weight(),
+                     flat->AddString(str.data(), str.size()), str.size());
+    }
+    for (fst::ArcIterator<CompactLattice> aiter(clat, s); !aiter.Done();
+         aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      const std::vector<int32> &str = arc.weight.String();
+      int32 offset = flat->AddString(str.data(), str.size());
+      flat->AddArc(s, FlatArc(arc.ilabel, arc.olabel, arc.weight.Weight(),
+                              arc.nextstate, offset, str.size()));
+    }
+  }
+}
+
+void ConvertFlatToCompactLattice(const FlatCompactLattice &flat,
+                                 CompactLattice *clat) {
+  clat->DeleteStates();
+  StateId num_states = flat.NumStates();
+  clat->ReserveStates(num_states);
+  for (StateId s = 0; s < num_states; s++)
+    clat->AddState();
+  if (flat.Start() != fst::kNoStateId)
+    clat->SetStart(flat.Start());
+  for (StateId s = 0; s < num_states; s++) {
+    if (flat.Final(s) != LatticeWeight::Zero())
+      clat->SetFinal(s, flat.FinalWeight(s));
+    int32 num_arcs = flat.NumArcs(s);
+    const FlatArc *arcs = flat.Arcs(s);
+    clat->ReserveArcs(s, num_arcs);
+    for (int32 i = 0; i < num_arcs; i++)
+      clat->AddArc(s, CompactLatticeArc(arcs[i].ilabel, arcs[i].olabel,
+                                        flat.ArcWeight(arcs[i]),
+                                        arcs[i].nextstate));
+  }
+}
+
+// Outputs to 'out' the states of 'in' in the order given by 'order' (the
+// states that are not in it are removed), with the arcs between them.  If
+// 'keep_arc' is non-NULL, the i'th arc of 'in' in order is removed if
+// (*keep_arc)[i] is false; if 'keep_final' is non-NULL, the final-prob of
+// state s is removed if (*keep_final)[s] is false.
+static void ReorderStates(const FlatCompactLattice &in,
+                          const std::vector<StateId> &order,
+                          const std::vector<bool> *keep_arc,
+                          const std::vector<bool> *keep_final,
+                          FlatCompactLattice *out) {
+  out->Clear();
+  StateId num_states = in.NumStates();
+  std::vector<StateId> new_id(num_states, fst::kNoStateId);
+  for (size_t i = 0; i < order.size(); i++)
+    new_id[order[i]] = i;
+  std::vector<int64> arc_index;
+  if (keep_arc != NULL) {
+    arc_index.resize(num_states + 1, 0);
+    for (StateId s = 0; s < num_states; s++)
+      arc_index[s + 1] = arc_index[s] + in.NumArcs(s);
+  }
+  out->Reserve(order.size(), in.NumArcs(), 0);
+  out->CopyStrings(in);
+  for (size_t i = 0; i < order.size(); i++)
+    out->AddState();
+  if (in.Start() != fst::kNoStateId && new_id[in.Start()] != fst::kNoStateId)
+    out->SetStart(new_id[in.Start()]);
+  for (size_t i = 0; i < order.size(); i++) {
+    StateId s = order[i];
+    if (in.Final(s) != LatticeWeight::Zero() &&
+        (keep_final == NULL || (*keep_final)[s]))
+      out->SetFinal(i, in.Final(s), in.FinalStringOffset(s),
+                    in.FinalStringLength(s));
+    const FlatArc *arcs = in.Arcs(s);
+    for (int32 j = 0; j < in.NumArcs(s); j++) {
+      StateId nextstate = new_id[arcs[j].nextstate];
+      if (nextstate == fst::kNoStateId ||
+          (keep_arc != NULL && !(*keep_arc)[arc_index[s] + j]))
+        continue;
+      FlatArc arc(arcs[j]);
+      arc.nextstate = nextstate;
+      out->AddArc(i, arc);
+    }
+  }
+}
+
+bool TopSortLattice(FlatCompactLattice *clat) {
+  StateId num_states = clat->NumStates(), start = clat->Start();
+  std::vector<int32> num_arcs_in(num_states, 0);
+  for (StateId s = 0; s < num_states; s++) {
+    const FlatArc *arcs = clat->Arcs(s);
+    for (int32 i = 0; i < clat->NumArcs(s); i++)
+      num_arcs_in[arcs[i].nextstate]++;
+  }
+  std::vector<StateId> order;
+  order.reserve(num_states);
+  if (start != fst::kNoStateId && num_arcs_in[start] == 0)
+    order.push_back(start);
+  for (StateId s = 0; s < num_states; s++)
+    if (num_arcs_in[s] == 0 && s != start)
+      order.push_back(s);
+  // 'order' is the queue of Kahn's algorithm.
+  for (size_t i = 0; i < order.size(); i++) {
+    StateId s = order[i];
+    const FlatArc *arcs = clat->Arcs(s);
+    for (int32 j = 0; j < clat->NumArcs(s); j++)
+      if (--num_arcs_in[arcs[j].nextstate] == 0)
+        order.push_back(arcs[j].nextstate);
+  }
+  if (order.size() != static_cast<size_t>(num_states))
+    return false;  // There are cycles.
+  FlatCompactLattice sorted;
+  ReorderStates(*clat, order, NULL, NULL, &sorted);
+  clat->Swap(&sorted);
+  return true;
+}
+
+void ConnectLattice(FlatCompactLattice *clat) {
+  StateId num_states = clat->NumStates(), start = clat->Start();
+  if (start == fst::kNoStateId) {
+    clat->Clear();
+    return;
+  }
+  std::vector<bool> accessible(num_states, false),
+      coaccessible(num_states, false);
+  std::vector<StateId> queue;
+  accessible[start] = true;
+  queue.push_back(start);
+  while (!queue.empty()) {
+    StateId s = queue.back();
+    queue.pop_back();
+    const FlatArc *arcs = clat->Arcs(s);
+    for (int32 i = 0; i < clat->NumArcs(s); i++) {
+      if (!accessible[arcs[i].nextstate]) {
+        accessible[arcs[i].nextstate] = true;
+        queue.push_back(arcs[i].nextstate);
+      }
+    }
+  }
+  // The arcs entering each state, as the source states, stored by
+  // destination state in 'preds' (in the manner of FlatCompactLattice).
+  std::vector<int32> preds_offset(num_states + 1, 0);
+  for (StateId s = 0; s < num_states; s++) {
+    const FlatArc *arcs = clat->Arcs(s);
+    for (int32 i = 0; i < clat->NumArcs(s); i++)
+      preds_offset[arcs[i].nextstate + 1]++;
+  }
+  for (StateId s = 0; s < num_states; s++)
+    preds_offset[s + 1] += preds_offset[s];
+  std::vector<StateId> preds(preds_offset[num_states]);
+  {
+    std::vector<int32> pos(preds_offset.begin(), preds_offset.end() - 1);
+    for (StateId s = 0; s < num_states; s++) {
+      const FlatArc *arcs = clat->Arcs(s);
+      for (int32 i = 0; i < clat->NumArcs(s); i++)
+        preds[pos[arcs[i].nextstate]++] = s;
+    }
+  }
+  for (StateId s = 0; s < num_states; s++) {
+    if (clat->Final(s) != LatticeWeight::Zero()) {
+      coaccessible[s] = true;
+      queue.push_back(s);
+    }
+  }
+  while (!queue.empty()) {
+    StateId s = queue.back();
+    queue.pop_back();
+    for (int32 i = preds_offset[s]; i < preds_offset[s + 1]; i++) {
+      if (!coaccessible[preds[i]]) {
+        coaccessible[preds[i]] = true;
+        queue.push_back(preds[i]);
+      }
+    }
+  }
+  std::vector<StateId> order;
+  for (StateId s = 0; s < num_states; s++)
+    if (accessible[s] && coaccessible[s])
+      order.push_back(s);
+  if (order.size() == static_cast<size_t>(num_states))
+    return;
+  FlatCompactLattice connected;
+  if (coaccessible[start])
+    ReorderStates(*clat, order, NULL, NULL, &connected);
+  clat->Swap(&connected);
+}
+
+void ScaleLattice(const std::vector<std::vector<double> > &scale,
+                  FlatCompactLattice *clat) {
+  if (scale == fst::DefaultLatticeScale())
+    return;
+  StateId num_states = clat->NumStates();
+  for (StateId s = 0; s < num_states; s++) {
+    if (clat->Final(s) != LatticeWeight::Zero())
+      clat->SetFinal(s, fst::ScaleTupleWeight(clat->Final(s), scale),
+                     clat->FinalStringOffset(s), clat->FinalStringLength(s));
+    FlatArc *arcs = clat->MutableArcs(s);
+    for (int32 i = 0; i < clat->NumArcs(s); i++)
+      arcs[i].weight = fst::ScaleTupleWeight(arcs[i].weight, scale);
+  }
+}
+
+void AddWordInsPenToCompactLattice(BaseFloat word_ins_penalty,
+                                   FlatCompactLattice *clat) {
+  StateId num_states = clat->NumStates();
+  for (StateId s = 0; s < num_states; s++) {
+    FlatArc *arcs = clat->MutableArcs(s);
+    for (int32 i = 0; i < clat->NumArcs(s); i++)
+      if (arcs[i].ilabel != 0)  // if there is a word on this arc
+        arcs[i].weight.SetValue1(arcs[i].weight.Value1() + word_ins_penalty);
+  }
+}
+
+// Checks the requirements of ComputeCompactLatticeAlphas() and
+// ComputeCompactLatticeBetas().
+static bool CheckTopSortedFromZero(const FlatCompactLattice &clat) {
+  if (!clat.IsTopSorted()) {
+    KALDI_WARN << "Input lattice must be topologically sorted.";
+    return false;
+  }
+  if (clat.Start() != 0) {
+    KALDI_WARN << "Input lattice must start from state 0.";
+    return false;
+  }
+  return true;
+}
+
+bool ComputeCompactLatticeAlphas(const FlatCompactLattice &clat,
+                                 std::vector<double> *alpha) {
+  if (!CheckTopSortedFromZero(clat))
+    return false;
+  StateId num_states = clat.NumStates();
+  alpha->resize(0);
+  alpha->resize(num_states, kLogZeroDouble);
+  (*alpha)[0] = 0.0;
+  for (StateId s = 0; s < num_states; s++) {
+    double this_alpha = (*alpha)[s];
+    const FlatArc *arcs = clat.Arcs(s);
+    for (int32 i = 0; i < clat.NumArcs(s); i++) {
+      double arc_like = -(arcs[i].weight.Value1() + arcs[i].weight.Value2());
+      (*alpha)[arcs[i].nextstate] = LogAdd((*alpha)[arcs[i].nextstate],
+                                           this_alpha + arc_like);
+    }
+  }
+  return true;
+}
+
+bool ComputeCompactLatticeBetas(const FlatCompactLattice &clat,
+                                std::vector<double> *beta) {
+  if (!CheckTopSortedFromZero(clat))
+    return false;
+  StateId num_states = clat.NumStates();
+  beta->resize(0);
+  beta->resize(num_states, kLogZeroDouble);
+  for (StateId s = num_states - 1; s >= 0; s--) {
+    const LatticeWeight &f = clat.Final(s);
+    double this_beta = -(f.Value1() + f.Value2());
+    const FlatArc *arcs = clat.Arcs(s);
+    for (int32 i = 0; i < clat.NumArcs(s); i++) {
+      double arc_like = -(arcs[i].weight.Value1() + arcs[i].weight.Value2());
+      this_beta = LogAdd(this_beta, (*beta)[arcs[i].nextstate] + arc_like);
+    }
+    (*beta)[s] = this_beta;
+  }
+  return true;
+}
+
+bool PruneLattice(BaseFloat beam, FlatCompactLattice *clat) {
+  KALDI_ASSERT(beam > 0.0);
+  if (!clat->IsTopSorted() && !TopSortLattice(clat)) {
+    KALDI_WARN << "Cycles detected in lattice";
+    return false;
+  }
+  StateId start = clat->Start(), num_states = clat->NumStates();
+  if (num_states == 0 || start == fst::kNoStateId) return false;
+  const double inf = std::numeric_limits<double>::infinity();
+  std::vector<double> forward_cost(num_states, inf),
+      backward_cost(num_states, inf);
+  forward_cost[start] = 0.0;
+  double best_final_cost = inf;
+  for (StateId s = 0; s < num_states; s++) {
+    double this_forward_cost = forward_cost[s];
+    const FlatArc *arcs = clat->Arcs(s);
+    for (int32 i = 0; i < clat->NumArcs(s); i++) {
+      double next_forward_cost = this_forward_cost +
+          ConvertToCost(arcs[i].weight);
+      if (forward_cost[arcs[i].nextstate] > next_forward_cost)
+        forward_cost[arcs[i].nextstate] = next_forward_cost;
+    }
+    double this_final_cost = this_forward_cost + ConvertToCost(clat->Final(s));
+    if (this_final_cost < best_final_cost)
+      best_final_cost = this_final_cost;
+  }
+  if (best_final_cost == inf) {  // No final state can be reached.
+    clat->Clear();
+    return false;
+  }
+  double cutoff = best_final_cost + beam;
+
+  // Going backwards, work out the backward costs and which arcs and
+  // final-probs are within the beam.  A state is kept if the best path
+  // through it is, and then so is every arc on that path; the arcs of
+  // the other states are all pruned.
+  std::vector<bool> keep_arc(clat->NumArcs(), false),
+      keep_final(num_states, false);
+  int64 arc_index = clat->NumArcs();
+  for (StateId s = num_states - 1; s >= 0; s--) {
+    double this_forward_cost = forward_cost[s],
+        this_backward_cost = ConvertToCost(clat->Final(s));
+    keep_final[s] = (this_forward_cost + this_backward_cost <= cutoff);
+    const FlatArc *arcs = clat->Arcs(s);
+    int32 num_arcs = clat->NumArcs(s);
+    arc_index -= num_arcs;
+    for (int32 i = 0; i < num_arcs; i++) {
+      double arc_backward_cost = ConvertToCost(arcs[i].weight) +
+          backward_cost[arcs[i].nextstate];
+      if (arc_backward_cost < this_backward_cost)
+        this_backward_cost = arc_backward_cost;
+      keep_arc[arc_index + i] = (this_forward_cost + arc_backward_cost <=
+                                 cutoff);
+    }
+    backward_cost[s] = this_backward_cost;
+  }
+  std::vector<StateId> order;
+  for (StateId s = 0; s < num_states; s++)
+    if (forward_cost[s] + backward_cost[s] <= cutoff)
+      order.push_back(s);
+  FlatCompactLattice pruned;
+  if (!order.empty() && order[0] == start)
+    ReorderStates(*clat, order, &keep_arc, &keep_final, &pruned);
+  clat->Swap(&pruned);
+  return (clat->NumStates() > 0);
+}
+
+void CompactLatticeShortestPath(const FlatCompactLattice &clat,
+                                FlatCompactLattice *shortest_path) {
+  if (!clat.IsTopSorted()) {
+    FlatCompactLattice clat_copy(clat);
+    if (!TopSortLattice(&clat_copy))
+      KALDI_ERR << "Was not able to topologically sort lattice (cycles found?)";
+    CompactLatticeShortestPath(clat_copy, shortest_path);
+    return;
+  }
+  shortest_path->Clear();
+  if (clat.Start() == fst::kNoStateId) return;
+  KALDI_ASSERT(clat.Start() == 0);  // since top-sorted.
+  StateId num_states = clat.NumStates(), superfinal = num_states;
+  // For each state, the best cost of reaching it and the arc on the
+  // best path that enters it, as (source state, arc index).
+  std::vector<double> best_cost(num_states + 1,
+                                std::numeric_limits<double>::infinity());
+  std::vector<std::pair<StateId, int32> > best_pred(
+      num_states + 1, std::pair<StateId, int32>(fst::kNoStateId, -1));
+  best_cost[0] = 0.0;
+  for (StateId s = 0; s < num_states; s++) {
+    double my_cost = best_cost[s];
+    const FlatArc *arcs = clat.Arcs(s);
+    for (int32 i = 0; i < clat.NumArcs(s); i++) {
+      double next_cost = my_cost + ConvertToCost(arcs[i].weight);
+      if (next_cost < best_cost[arcs[i].nextstate]) {
+        best_cost[arcs[i].nextstate] = next_cost;
+        best_pred[arcs[i].nextstate] = std::make_pair(s, i);
+      }
+    }
+    double tot_final = my_cost + ConvertToCost(clat.Final(s));
+    if (tot_final < best_cost[superfinal]) {
+      best_cost[superfinal] = tot_final;
+      best_pred[superfinal] = std::make_pair(s, -1);
+    }
+  }
+  // The arcs on the best path, backwards, as (source state, arc index).
+  std::vector<std::pair<StateId, int32> > path;
+  StateId cur_state = superfinal;
+  while (cur_state != 0) {
+    std::pair<StateId, int32> pred = best_pred[cur_state];
+    if (pred.first == fst::kNoStateId) {
+      KALDI_WARN << "Failure in best-path algorithm for lattice (infinite "
+                 << "costs?)";
+      return;  // return empty best-path.
+    }
+    path.push_back(pred);
+    cur_state = pred.first;
+  }
+  std::reverse(path.begin(), path.end());
+  shortest_path->CopyStrings(clat);
+  for (size_t i = 0; i < path.size(); i++)
+    shortest_path->AddState();
+  shortest_path->SetStart(0);
+  for (size_t i = 0; i < path.size(); i++) {
+    StateId s = path[i].first;
+    if (path[i].second == -1) {  // final-prob.
+      shortest_path->SetFinal(i, clat.Final(s), clat.FinalStringOffset(s),
+                              clat.FinalStringLength(s));
+    } else {
+      FlatArc arc(clat.Arcs(s)[path[i].second]);
+      arc.nextstate = i + 1;
+      shortest_path->AddArc(i, arc);
+    }
+  }
+}
+
+void ComposeCompactLatticeDeterministic(
+    const FlatCompactLattice &clat,
+    fst::DeterministicOnDemandFst<fst::StdArc> *det_fst,
+    FlatCompactLattice *composed_clat) {
+  typedef std::pair<StateId, StateId> StatePair;
+  typedef unordered_map<StatePair, StateId, PairHasher<StateId> > MapType;
+
+  KALDI_ASSERT(composed_clat != NULL);
+  composed_clat->Clear();
+  if (clat.Start() == fst::kNoStateId) return;
+  composed_clat->CopyStrings(clat);
+
+  // The states of 'composed_clat' are numbered in the order they are
+  // created, and as 'queue' is first-in first-out they are processed in the
+  // same order, so the arcs are added in order of their source state, as
+  // FlatCompactLattice requires.
+  MapType state_map;
+  std::vector<StatePair> queue;
+  StatePair start_pair(clat.Start(), det_fst->Start());
+  composed_clat->SetStart(composed_clat->AddState());
+  state_map[start_pair] = 0;
+  queue.push_back(start_pair);
+
+  for (size_t q = 0; q < queue.size(); q++) {
+    StateId s1 = queue[q].first, s2 = queue[q].second,
+        composed_state = static_cast<StateId>(q);
+
+    const LatticeWeight &clat_final = clat.Final(s1);
+    if (clat_final != LatticeWeight::Zero()) {
+      fst::StdArc::Weight det_fst_final = det_fst->Final(s2);
+      if (det_fst_final != fst::StdArc::Weight::Zero()) {
+        composed_clat->SetFinal(
+            composed_state,
+            LatticeWeight(clat_final.Value1() + det_fst_final.Value(),
+                          clat_final.Value2()),
+            clat.FinalStringOffset(s1), clat.FinalStringLength(s1));
+      }
+    }
+
+    const FlatArc *arcs = clat.Arcs(s1);
+    for (int32 i = 0; i < clat.NumArcs(s1); i++) {
+      FlatArc arc(arcs[i]);
+      StateId next_state2;
+      if (arc.olabel == 0) {
+        // Epsilon: <det_fst> stays where it is.
+        next_state2 = s2;
+      } else {
+        fst::StdArc arc2;
+        if (!det_fst->GetArc(s2, arc.olabel, &arc2))
+          continue;
+        next_state2 = arc2.nextstate;
+        arc.olabel = arc2.olabel;
+        arc.weight = LatticeWeight(arc.weight.Value1() + arc2.weight.Value(),
+                                   arc.weight.Value2());
+      }
+      StatePair next_pair(arc.nextstate, next_state2);
+      std::pair<MapType::iterator, bool> result = state_map.insert(
+          std::make_pair(next_pair, static_cast<StateId>(queue.size())));
+      if (result.second) {
+        composed_clat->AddState();
+        queue.push_back(next_pair);
+      }
+      arc.nextstate = result.first->second;
+      composed_clat->AddArc(composed_state, arc);
+    }
+  }
+  ConnectLattice(composed_clat);
+}
+
+
+bool FlatCompactLatticeHolder::Read(std::istream &is) {
+  Clear();
+  int c = is.peek();
+  if (c == -1) {
+    KALDI_WARN << "End of stream detected reading CompactLattice.";
+    return false;
+  } else if (isspace(c)) {  // text form; see CompactLatticeHolder::Read().
+    return t_.Read(is, false);
+  } else if (c != 214) {  // 214 is the first char of the FST magic number.
+    KALDI_WARN << "Reading compact lattice: does not appear to be an FST "
+               << " [non-space but no magic number detected], file pos is "
+               << is.tellg();
+    return false;
+  } else {
+    return t_.Read(is, true);
+  }
+}
+
+}  // namespace kaldi
@@ -0,0 +1,251 @@
+// lat/flat-lattice.h
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_LAT_FLAT_LATTICE_H_
+#define KALDI_LAT_FLAT_LATTICE_H_
+
+#include <iostream>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "fstext/fstext-lib.h"
+#include "lat/kaldi-lattice.h"
+#include "util/common-utils.h"
+
+namespace kaldi {
+
+/**
+   FlatCompactLattice holds the same information as a CompactLattice, but in
+   three flat arrays instead of a std::vector of arcs per state and a
+   std::vector of transition-ids per weight: the states, the arcs (those
+   leaving each state are contiguous), and a pool of integers in which the
+   transition-ids of each arc and final-prob are a range.  So reading, copying
+   and freeing a lattice takes a few allocations regardless of its size, and
+   the algorithms below, which only look at the costs and the topology, go
+   through contiguous memory.  Those that output a lattice whose strings are a
+   subset of those of the input (pruning, composition, best path) copy the
+   pool as a whole and do not touch the strings.
+
+   The binary form written by Write() is that of a CompactLattice, so the
+   two types can be used in the same pipelines (see FlatCompactLatticeHolder).
+
+   Arcs must be added in order of their source state, i.e. all the arcs
+   leaving state s before any that leave a state after s; states may be added
+   at any time.
+ */
+class FlatCompactLattice {
+ public:
+  typedef int32 StateId;
+  typedef int32 Label;
+
+  struct Arc {
+    Label ilabel;
+    Label olabel;
+    LatticeWeight weight;
+    StateId nextstate;
+    // The transition-ids on the arc are the 'string_length' integers starting
+    // at 'string_offset' in the string pool.
+    int32 string_offset;
+    int32 string_length;
+    Arc() { }
+    Arc(Label ilabel, Label olabel, const LatticeWeight &weight,
+        StateId nextstate, int32 string_offset, int32 string_length):
+        ilabel(ilabel), olabel(olabel), weight(weight), nextstate(nextstate),
+        string_offset(string_offset), string_length(string_length) { }
+  };
+
+  FlatCompactLattice(): start_(fst::kNoStateId), last_arc_state_(0) { }
+
+  void Clear();
+
+  void Swap(FlatCompactLattice *other);
+
+  StateId Start() const { return start_; }
+
+  StateId NumStates() const { return static_cast<StateId>(states_.size()); }
+
+  int32 NumArcs(StateId s) const { return states_[s].num_arcs; }
+
+  /// The total number of arcs.
+  int64 NumArcs() const { return static_cast<int64>(arcs_.size()); }
+
+  /// The arcs leaving state s are Arcs(s)[0] ... Arcs(s)[NumArcs(s) - 1].
+  const Arc *Arcs(StateId s) const {
+    return arcs_.data() + states_[s].arc_offset;
+  }
+  Arc *MutableArcs(StateId s) { return arcs_.data() + states_[s].arc_offset; }
+
+  /// The final-prob of state s, without its transition-ids;
+  /// LatticeWeight::Zero() if it is not final.
+  const LatticeWeight &Final(StateId s) const {
+    return states_[s].final_weight;
+  }
+  int32 FinalStringOffset(StateId s) const {
+    return states_[s].final_string_offset;
+  }
+  int32 FinalStringLength(StateId s) const {
+    return states_[s].final_string_length;
+  }
+
+  /// Returns a pointer to the string pool at 'offset'.
+  const int32 *String(int32 offset) const { return strings_.data() + offset; }
+
+  /// The size of the string pool.
+  int64 StringPoolSize() const { return static_cast<int64>(strings_.size()); }
+
+  /// The weight of an arc, or the final-prob of a state, as a
+  /// CompactLatticeWeight.
+  CompactLatticeWeight ArcWeight(const Arc &arc) const;
+  CompactLatticeWeight FinalWeight(StateId s) const;
+
+  /// Returns true if every arc goes to a higher-numbered state (which is
+  /// what the kTopSorted property of an FST means).
+  bool IsTopSorted() const;
+
+  void SetStart(StateId s) { start_ = s; }
+
+  StateId AddState();
+
+  /// Appends 'length' integers to the string pool and returns their offset.
+  int32 AddString(const int32 *data, int32 length);
+
+  /// Makes the string pool a copy of that of 'other', so that the arcs and
+  /// final-probs of 'other' can be added to this lattice without changing
+  /// their string offsets.  The string pool must be empty.
+  void CopyStrings(const FlatCompactLattice &other);
+
+  /// Adds an arc leaving state s; its string must already be in the pool.
+  void AddArc(StateId s, const Arc &arc);
+
+  void SetFinal(StateId s, const LatticeWeight &weight,
+                int32 string_offset = 0, int32 string_length = 0);
+
+  void Reserve(StateId num_states, int64 num_arcs, int64 string_pool_size);
+
+  /// Writes in the format of WriteCompactLattice().  Returns false on stream
+  /// failure.
+  bool Write(std::ostream &os, bool binary) const;
+
+  /// Reads what WriteCompactLattice() (or Write()) wrote, or anything else
+  /// that ReadCompactLattice() accepts.  The binary form of a CompactLattice
+  /// as Kaldi writes it is read directly, without going through a
+  /// CompactLattice.  Returns false (after a warning) on error.
+  bool Read(std::istream &is, bool binary);
+
+ private:
+  struct State {
+    int32 arc_offset;
+    int32 num_arcs;
+    LatticeWeight final_weight;
+    int32 final_string_offset;
+    int32 final_string_length;
+  };
+
+  StateId start_;
+  // The highest state that any arc has been added to.
+  StateId last_arc_state_;
+  std::vector<State> states_;
+  std::vector<Arc> arcs_;
+  std::vector<int32> strings_;
+};
+
+
+void ConvertCompactLatticeToFlat(const CompactLattice &clat,
+                                 FlatCompactLattice *flat);
+
+void ConvertFlatToCompactLattice(const FlatCompactLattice &flat,
+                                 CompactLattice *clat);
+
+/// Topologically sorts the lattice (with the start state first, if nothing
+/// enters it).  Returns false if it has cycles, in which case it is not
+/// changed.
+bool TopSortLattice(FlatCompactLattice *clat);
+
+/// Removes the states that are not both accessible and coaccessible, like
+/// fst::Connect(); the order of the others is kept.
+void ConnectLattice(FlatCompactLattice *clat);
+
+/// As fst::ScaleLattice(); see fst::AcousticLatticeScale() and friends.
+void ScaleLattice(const std::vector<std::vector<double> > &scale,
+                  FlatCompactLattice *clat);
+
+/// Adds the word insertion penalty to the graph cost of each arc with a word,
+/// like AddWordInsPenToCompactLattice() does for CompactLattice.
+void AddWordInsPenToCompactLattice(BaseFloat word_ins_penalty,
+                                   FlatCompactLattice *clat);
+
+/// The versions of the functions in lattice-functions.h for
+/// FlatCompactLattice; they behave the same as those for CompactLattice.
+bool ComputeCompactLatticeAlphas(const FlatCompactLattice &clat,
+                                 std::vector<double> *alpha);
+
+bool ComputeCompactLatticeBetas(const FlatCompactLattice &clat,
+                                std::vector<double> *beta);
+
+bool PruneLattice(BaseFloat beam, FlatCompactLattice *clat);
+
+void CompactLatticeShortestPath(const FlatCompactLattice &clat,
+                                FlatCompactLattice *shortest_path);
+
+void ComposeCompactLatticeDeterministic(
+    const FlatCompactLattice &clat,
+    fst::DeterministicOnDemandFst<fst::StdArc> *det_fst,
+    FlatCompactLattice *composed_clat);
+
+
+class FlatCompactLatticeHolder {
+ public:
+  typedef FlatCompactLattice T;
+
+  FlatCompactLatticeHolder() { }
+
+  static bool Write(std::ostream &os, bool binary, const T &t) {
+    // As for CompactLatticeHolder, there is no binary-mode header.
+    return t.Write(os, binary);
+  }
+
+  bool Read(std::istream &is);
+
+  static bool IsReadInBinary() { return true; }
+
+  T &Value() { return t_; }
+
+  void Clear() { t_.Clear(); }
+
+  void Swap(FlatCompactLatticeHolder *other) { t_.Swap(&(other->t_)); }
+
+  bool ExtractRange(const FlatCompactLatticeHolder &other,
+                    const std::string &range) {
+    KALDI_ERR << "ExtractRange is not defined for this type of holder.";
+    return false;
+  }
+
+ private:
+  T t_;
+};
+
+typedef TableWriter<FlatCompactLatticeHolder> FlatCompactLatticeWriter;
+typedef SequentialTableReader<FlatCompactLatticeHolder>
+    SequentialFlatCompactLatticeReader;
+typedef RandomAccessTableReader<FlatCompactLatticeHolder>
+    RandomAccessFlatCompactLatticeReader;
+
+}  // namespace kaldi
+
+#endif  // KALDI_LAT_FLAT_LATTICE_H_
@@ -95,6 +95,33 @@ void TestCompactLatticeTableCross(bool binary) {
   }
 }
 
+// Write CompactLattice in the varint form, read as both CompactLattice and
+// Lattice.
+void TestCompactLatticeTableVarint() {
+  g_compact_lattice_write_opts.varint_encoding = true;
+  CompactLatticeWriter writer("ark:tmpf");
+  int N = 10;
+  std::vector<CompactLattice*> lat_vec(N);
+  for (int i = 0; i < N; i++) {
+    std::string key = "key" + std::to_string(i);
+    lat_vec[i] = RandCompactLattice();
+    writer.Write(key, *(lat_vec[i]));
+  }
+  writer.Close();
+  g_compact_lattice_write_opts.varint_encoding = false;
+
+  RandomAccessCompactLatticeReader reader("ark:tmpf");
+  RandomAccessLatticeReader lat_reader("ark:tmpf");
+  for (int i = 0; i < N; i++) {
+    std::string key = "key" + std::to_string(i);
+    KALDI_ASSERT(fst::Equal(reader.Value(key), *(lat_vec[i])));
+    CompactLattice clat;
+    ConvertLattice(lat_reader.Value(key), &clat);
+    KALDI_ASSERT(fst::Equal(clat, *(lat_vec[i])));
+    delete lat_vec[i];
+  }
+}
+
 // Lattice, binary.
 void TestLatticeTable(bool binary) {
   LatticeWriter writer(binary ? "ark:tmpf" : "ark,t:tmpf");
@@ -167,6 +194,7 @@ int main() {
     TestLatticeTable(binary);
     TestLatticeTableCross(binary);
   }
+  TestCompactLatticeTableVarint();
   std::cout << "Test OK\n";
   
   unlink("tmpf");
@@ -19,6 +19,9 @@
 // limitations under the License.
 
 
+#include <cstring>
+#include <limits>
+
 #include "lat/kaldi-lattice.h"
 #include "fst/script/print-impl.h"
 
@@ -301,52 +304,314 @@ Lattice *ReadLatticeText(std::istream &is) {
   }
 }
 
-bool ReadCompactLattice(std::istream &is, bool binary,
-                        CompactLattice **clat) {
-  KALDI_ASSERT(*clat == NULL);
-  if (binary) {
-    fst::FstHeader hdr;
-    if (!hdr.Read(is, "<unknown>")) {
-      KALDI_WARN << "Reading compact lattice: error reading FST header.";
-      return false;
+CompactLattice *ReadCompactLatticeAfterHeader(std::istream &is,
+                                              const fst::FstHeader &hdr) {
+  if (hdr.FstType() != "vector") {
+    KALDI_WARN << "Reading compact lattice: unsupported FST type: "
+               << hdr.FstType();
+    return NULL;
+  }
+  fst::FstReadOptions ropts("<unspecified>",
+                            &hdr);
+
+  typedef fst::CompactLatticeWeightTpl<fst::LatticeWeightTpl<float>, int32> T1;
+  typedef fst::CompactLatticeWeightTpl<fst::LatticeWeightTpl<double>, int32> T2;
+  typedef fst::LatticeWeightTpl<float> T3;
+  typedef fst::LatticeWeightTpl<double> T4;
+  typedef fst::VectorFst<fst::ArcTpl<T1> > F1;
+  typedef fst::VectorFst<fst::ArcTpl<T2> > F2;
+  typedef fst::VectorFst<fst::ArcTpl<T3> > F3;
+  typedef fst::VectorFst<fst::ArcTpl<T4> > F4;
+
+  CompactLattice *ans = NULL;
+  if (hdr.ArcType() == T1::Type()) {
+    ans = ConvertToCompactLattice(F1::Read(is, ropts));
+  } else if (hdr.ArcType() == T2::Type()) {
+    ans = ConvertToCompactLattice(F2::Read(is, ropts));
+  } else if (hdr.ArcType() == T3::Type()) {
+    ans = ConvertToCompactLattice(F3::Read(is, ropts));
+  } else if (hdr.ArcType() == T4::Type()) {
+    ans = ConvertToCompactLattice(F4::Read(is, ropts));
+  } else {
+    KALDI_WARN << "FST with arc type " << hdr.ArcType()
+               << " cannot be converted to CompactLattice.\n";
+    return NULL;
+  }
+  if (ans == NULL)
+    KALDI_WARN << "Error reading compact lattice (after reading header).";
+  return ans;
+}
+
+CompactLatticeWriteOptions g_compact_lattice_write_opts;
+
+void RegisterCompactLatticeWriteOptions(OptionsItf *opts) {
+  g_compact_lattice_write_opts.Register(opts);
+}
+
+// The varint form starts with this, which can't be confused with the start of
+// the text form (whitespace) or of the OpenFst form (\326).
+static const char kVarintLatticeMagic[] = "KCLV";
+static const int32 kVarintLatticeMagicLength = 4;
+// Bits of the flags word that follows the magic string.
+static const uint64 kVarintLatticeQuantized = 1;
+
+static inline void WriteVarint(uint64 value, std::string *buf) {
+  while (value >= 0x80) {
+    buf->push_back(static_cast<char>((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+  buf->push_back(static_cast<char>(value));
+}
+
+// Maps signed to unsigned values so that values of small magnitude get short
+// codes: 0, -1, 1, -2 ... -> 0, 1, 2, 3 ...
+static inline uint64 ZigZagEncode(int64 value) {
+  return (static_cast<uint64>(value) << 1) ^ static_cast<uint64>(value >> 63);
+}
+
+static inline int64 ZigZagDecode(uint64 value) {
+  return static_cast<int64>(value >> 1) ^ -static_cast<int64>(value & 1);
+}
+
+static inline void WriteRawFloat(float value, std::string *buf) {
+  buf->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// If quantum > 0, values that are representable as (multiple of quantum) are
+// written as the zigzag code of the multiple times 2, and others (e.g.
+// infinity) as 1 followed by the raw float.
+static inline void WriteWeightValue(BaseFloat value, BaseFloat quantum,
+                                    std::string *buf) {
+  if (quantum > 0.0) {
+    double q = std::floor(value / quantum + 0.5);
+    if (q - q == 0.0 && std::abs(q) < 1.0e15) {  // finite and not too large.
+      WriteVarint(ZigZagEncode(static_cast<int64>(q)) << 1, buf);
+      return;
     }
-    if (hdr.FstType() != "vector") {
-      KALDI_WARN << "Reading compact lattice: unsupported FST type: "
-                 << hdr.FstType();
+    WriteVarint(1, buf);
+  }
+  WriteRawFloat(value, buf);
+}
+
+static void WriteCompactLatticeWeightVarint(const CompactLatticeWeight &w,
+                                            BaseFloat quantum,
+                                            std::string *buf) {
+  WriteWeightValue(w.Weight().Value1(), quantum, buf);
+  WriteWeightValue(w.Weight().Value2(), quantum, buf);
+  // The string is written as runs of the same transition-id: the number of
+  // runs, then for each run the change in transition-id from the previous
+  // run and the run length minus one.
+  const std::vector<int32> &str = w.String();
+  size_t num_runs = 0;
+  for (size_t i = 0; i < str.size(); i++)
+    if (i == 0 || str[i] != str[i - 1])
+      num_runs++;
+  WriteVarint(num_runs, buf);
+  int64 prev_tid = 0;
+  for (size_t i = 0; i < str.size(); ) {
+    size_t j = i + 1;
+    while (j < str.size() && str[j] == str[i])
+      j++;
+    WriteVarint(ZigZagEncode(str[i] - prev_tid), buf);
+    WriteVarint(j - i - 1, buf);
+    prev_tid = str[i];
+    i = j;
+  }
+}
+
+bool WriteCompactLatticeVarint(std::ostream &os,
+                               const CompactLatticeWriteOptions &opts,
+                               const CompactLattice &clat) {
+  typedef CompactLatticeArc::StateId StateId;
+  BaseFloat quantum = opts.weight_quantum;
+  std::string buf;
+  buf.append(kVarintLatticeMagic, kVarintLatticeMagicLength);
+  WriteVarint(quantum > 0.0 ? kVarintLatticeQuantized : 0, &buf);
+  if (quantum > 0.0)
+    WriteRawFloat(quantum, &buf);
+  StateId num_states = clat.NumStates();
+  WriteVarint(num_states, &buf);
+  WriteVarint(clat.Start() + 1, &buf);  // kNoStateId is -1.
+  for (StateId s = 0; s < num_states; s++) {
+    CompactLatticeWeight final_weight = clat.Final(s);
+    if (final_weight == CompactLatticeWeight::Zero()) {
+      WriteVarint(0, &buf);
+    } else {
+      WriteVarint(1, &buf);
+      WriteCompactLatticeWeightVarint(final_weight, quantum, &buf);
+    }
+    WriteVarint(clat.NumArcs(s), &buf);
+    for (fst::ArcIterator<CompactLattice> aiter(clat, s); !aiter.Done();
+         aiter.Next()) {
+      const CompactLatticeArc &arc = aiter.Value();
+      // Lattices are normally topologically sorted, so this is usually a
+      // small positive number.
+      WriteVarint(ZigZagEncode(static_cast<int64>(arc.nextstate) - s), &buf);
+      // The labels are cast via uint32 so that any negative labels survive
+      // the round trip.
+      WriteVarint(static_cast<uint32>(arc.ilabel), &buf);
+      // Lattices are normally acceptors, so we write 0 for "same as ilabel".
+      WriteVarint(arc.olabel == arc.ilabel ? 0 :
+                  static_cast<uint64>(static_cast<uint32>(arc.olabel)) + 1,
+                  &buf);
+      WriteCompactLatticeWeightVarint(arc.weight, quantum, &buf);
+    }
+  }
+  os.write(buf.data(), buf.size());
+  if (os.fail())
+    KALDI_WARN << "Stream failure detected writing compact lattice.";
+  return os.good();
+}
+
+// Reads from the stream buffer directly, as the codes are mostly one byte.
+static inline bool ReadVarint(std::streambuf *sb, uint64 *value) {
+  uint64 ans = 0;
+  for (int32 shift = 0; shift < 64; shift += 7) {
+    int c = sb->sbumpc();
+    if (c == std::char_traits<char>::eof())
       return false;
+    ans |= static_cast<uint64>(c & 0x7F) << shift;
+    if ((c & 0x80) == 0) {
+      *value = ans;
+      return true;
     }
-    fst::FstReadOptions ropts("<unspecified>",
-                              &hdr);
+  }
+  return false;  // too many bytes: corrupted input.
+}
 
-    typedef fst::CompactLatticeWeightTpl<fst::LatticeWeightTpl<float>, int32> T1;
-    typedef fst::CompactLatticeWeightTpl<fst::LatticeWeightTpl<double>, int32> T2;
-    typedef fst::LatticeWeightTpl<float> T3;
-    typedef fst::LatticeWeightTpl<double> T4;
-    typedef fst::VectorFst<fst::ArcTpl<T1> > F1;
-    typedef fst::VectorFst<fst::ArcTpl<T2> > F2;
-    typedef fst::VectorFst<fst::ArcTpl<T3> > F3;
-    typedef fst::VectorFst<fst::ArcTpl<T4> > F4;
+static inline bool ReadRawFloat(std::streambuf *sb, float *value) {
+  return sb->sgetn(reinterpret_cast<char*>(value), sizeof(*value)) ==
+      static_cast<std::streamsize>(sizeof(*value));
+}
 
-    CompactLattice *ans = NULL;
-    if (hdr.ArcType() == T1::Type()) {
-      ans = ConvertToCompactLattice(F1::Read(is, ropts));
-    } else if (hdr.ArcType() == T2::Type()) {
-      ans = ConvertToCompactLattice(F2::Read(is, ropts));
-    } else if (hdr.ArcType() == T3::Type()) {
-      ans = ConvertToCompactLattice(F3::Read(is, ropts));
-    } else if (hdr.ArcType() == T4::Type()) {
-      ans = ConvertToCompactLattice(F4::Read(is, ropts));
-    } else {
-      KALDI_WARN << "FST with arc type " << hdr.ArcType()
-                 << " cannot be converted to CompactLattice.\n";
+static inline bool ReadWeightValue(std::streambuf *sb, BaseFloat quantum,
+                                   BaseFloat *value) {
+  if (quantum > 0.0) {
+    uint64 code;
+    if (!ReadVarint(sb, &code))
       return false;
+    if (code != 1) {
+      *value = quantum * ZigZagDecode(code >> 1);
+      return true;
     }
-    if (ans == NULL) {
-      KALDI_WARN << "Error reading compact lattice (after reading header).";
+  }
+  float f;
+  if (!ReadRawFloat(sb, &f))
+    return false;
+  *value = f;
+  return true;
+}
+
+static bool ReadCompactLatticeWeightVarint(std::streambuf *sb,
+                                           BaseFloat quantum,
+                                           std::vector<int32> *str,
+                                           CompactLatticeWeight *w) {
+  BaseFloat value1, value2;
+  uint64 num_runs;
+  if (!ReadWeightValue(sb, quantum, &value1) ||
+      !ReadWeightValue(sb, quantum, &value2) ||
+      !ReadVarint(sb, &num_runs))
+    return false;
+  str->clear();
+  int64 tid = 0;
+  for (uint64 r = 0; r < num_runs; r++) {
+    uint64 delta, extra;
+    if (!ReadVarint(sb, &delta) || !ReadVarint(sb, &extra) ||
+        extra >= 100000000)
       return false;
+    tid += ZigZagDecode(delta);
+    str->insert(str->end(), extra + 1, static_cast<int32>(tid));
+  }
+  *w = CompactLatticeWeight(LatticeWeight(value1, value2), *str);
+  return true;
+}
+
+CompactLattice *ReadCompactLatticeVarint(std::istream &is) {
+  typedef CompactLatticeArc::StateId StateId;
+  char magic[kVarintLatticeMagicLength];
+  is.read(magic, kVarintLatticeMagicLength);
+  if (!is.good() ||
+      std::memcmp(magic, kVarintLatticeMagic, kVarintLatticeMagicLength)) {
+    KALDI_WARN << "Reading compact lattice: bad magic string for varint form.";
+    return NULL;
+  }
+  std::streambuf *sb = is.rdbuf();
+  uint64 flags, num_states, start;
+  float quantum = 0.0;
+  if (!ReadVarint(sb, &flags) ||
+      ((flags & kVarintLatticeQuantized) && !ReadRawFloat(sb, &quantum)) ||
+      !ReadVarint(sb, &num_states) || !ReadVarint(sb, &start) ||
+      num_states > static_cast<uint64>(std::numeric_limits<int32>::max()) ||
+      start > num_states) {
+    KALDI_WARN << "Reading compact lattice: bad header in varint form.";
+    is.setstate(std::ios::failbit);
+    return NULL;
+  }
+  CompactLattice *clat = new CompactLattice();
+  clat->ReserveStates(num_states);
+  for (uint64 s = 0; s < num_states; s++)
+    clat->AddState();
+  clat->SetStart(static_cast<StateId>(start) - 1);
+  std::vector<int32> str;
+  bool ok = true;
+  for (StateId s = 0; ok && s < static_cast<StateId>(num_states); s++) {
+    uint64 has_final, num_arcs;
+    CompactLatticeWeight weight;
+    ok = ReadVarint(sb, &has_final) &&
+        (has_final == 0 ||
+         ReadCompactLatticeWeightVarint(sb, quantum, &str, &weight)) &&
+        ReadVarint(sb, &num_arcs);
+    if (!ok) break;
+    if (has_final != 0)
+      clat->SetFinal(s, weight);
+    clat->ReserveArcs(s, std::min<uint64>(num_arcs, 100000));
+    for (uint64 a = 0; a < num_arcs; a++) {
+      uint64 delta, ilabel, olabel;
+      if (!ReadVarint(sb, &delta) || !ReadVarint(sb, &ilabel) ||
+          !ReadVarint(sb, &olabel) ||
+          !ReadCompactLatticeWeightVarint(sb, quantum, &str, &weight)) {
+        ok = false;
+        break;
+      }
+      int64 nextstate = s + ZigZagDecode(delta);
+      if (nextstate < 0 || nextstate >= static_cast<int64>(num_states)) {
+        ok = false;
+        break;
+      }
+      CompactLatticeArc arc;
+      arc.ilabel = static_cast<int32>(static_cast<uint32>(ilabel));
+      arc.olabel = (olabel == 0 ? arc.ilabel :
+                    static_cast<int32>(static_cast<uint32>(olabel - 1)));
+      arc.weight = weight;
+      arc.nextstate = nextstate;
+      clat->AddArc(s, arc);
     }
-    *clat = ans;
-    return true;
+  }
+  if (!ok) {
+    KALDI_WARN << "Reading compact lattice: error or unexpected end of input "
+               << "in varint form.";
+    is.setstate(std::ios::failbit);
+    delete clat;
+    return NULL;
+  }
+  return clat;
+}
+
+bool ReadCompactLattice(std::istream &is, bool binary,
+                        CompactLattice **clat) {
+  KALDI_ASSERT(*clat == NULL);
+  if (binary) {
+    if (is.peek() == kVarintLatticeMagic[0]) {
+      *clat = ReadCompactLatticeVarint(is);
+      return (*clat != NULL);
+    }
+    fst::FstHeader hdr;
+    if (!hdr.Read(is, "<unknown>")) {
+      KALDI_WARN << "Reading compact lattice: error reading FST header.";
+      return false;
+    }
+    *clat = ReadCompactLatticeAfterHeader(is, hdr);
+    return (*clat != NULL);
   } else {
     // The next line would normally consume the \r on Windows, plus any
     // extra spaces that might have got in there somehow.
@@ -374,8 +639,9 @@ bool CompactLatticeHolder::Read(std::istream &is) {
     // cannot begin with space because it starts with the FST Type() which is not
     // space).
     return ReadCompactLattice(is, false, &t_);
-  } else if (c != 214) { // 214 is first char of FST magic number,
-    // on little-endian machines which is all we support (\326 octal)
+  } else if (c != 214 && c != kVarintLatticeMagic[0]) {
+    // 214 is first char of FST magic number, on little-endian machines which
+    // is all we support (\326 octal); the other is that of the varint form.
     KALDI_WARN << "Reading compact lattice: does not appear to be an FST "
                << " [non-space but no magic number detected], file pos is "
                << is.tellg();
@@ -418,6 +684,10 @@ bool ReadLattice(std::istream &is, bool binary,
                  Lattice **lat) {
   KALDI_ASSERT(*lat == NULL);
   if (binary) {
+    if (is.peek() == kVarintLatticeMagic[0]) {
+      *lat = ConvertToLattice(ReadCompactLatticeVarint(is));
+      return (*lat != NULL);
+    }
     fst::FstHeader hdr;
     if (!hdr.Read(is, "<unknown>")) {
       KALDI_WARN << "Reading lattice: error reading FST header.";
@@ -490,8 +760,9 @@ bool LatticeHolder::Read(std::istream &is) {
     // cannot begin with space because it starts with the FST Type() which is not
     // space).
     return ReadLattice(is, false, &t_);
-  } else if (c != 214) { // 214 is first char of FST magic number,
-    // on little-endian machines which is all we support (\326 octal)
+  } else if (c != 214 && c != kVarintLatticeMagic[0]) {
+    // 214 is first char of FST magic number, on little-endian machines which
+    // is all we support (\326 octal); the other is that of the varint form.
     KALDI_WARN << "Reading compact lattice: does not appear to be an FST "
                << " [non-space but no magic number detected], file pos is "
                << is.tellg();
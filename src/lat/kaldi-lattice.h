@@ -60,11 +60,59 @@ bool WriteLattice(std::ostream &os, bool binary,
 // NULL when called.
 bool ReadCompactLattice(std::istream &is, bool binary,
                         CompactLattice **clat);
+// Reads the rest of a CompactLattice (or any of the types of lattice that
+// ReadCompactLattice() accepts) in binary form, after its FST header 'hdr'
+// has been read.  Returns NULL (after a warning) on error.
+CompactLattice *ReadCompactLatticeAfterHeader(std::istream &is,
+                                              const fst::FstHeader &hdr);
 // the following function requires that *lat be
 // NULL when called.
 bool ReadLattice(std::istream &is, bool binary,
                  Lattice **lat);
 
+/// Options for the compact ("varint") binary form of CompactLattice.  In
+/// this form state-ids are coded as deltas from the source state, labels and
+/// deltas as variable-length integers, and the transition-id strings as runs
+/// of repeated transition-ids; weights are stored exactly, or quantized if
+/// weight_quantum > 0.  Lattices in this form can't be read by OpenFst, so
+/// writing it is opt-in (see RegisterCompactLatticeWriteOptions()), but
+/// CompactLatticeHolder and ReadCompactLattice() read it transparently.
+struct CompactLatticeWriteOptions {
+  bool varint_encoding;
+  BaseFloat weight_quantum;
+
+  CompactLatticeWriteOptions(): varint_encoding(false),
+                                weight_quantum(0.0) { }
+
+  void Register(OptionsItf *opts) {
+    opts->Register("write-varint-lattices", &varint_encoding, "If true, "
+                   "write binary CompactLattice archives in Kaldi's compact "
+                   "varint-coded form, which is typically several times "
+                   "smaller than the OpenFst form but can only be read by "
+                   "Kaldi.");
+    opts->Register("lattice-weight-quantum", &weight_quantum, "If > 0 and "
+                   "--write-varint-lattices=true, the lattice weights are "
+                   "rounded to multiples of this (e.g. 0.001) so that they "
+                   "can be coded more compactly.");
+  }
+};
+
+/// The options used by CompactLatticeHolder::Write().  Programs that write
+/// lattices may expose them by calling RegisterCompactLatticeWriteOptions().
+extern CompactLatticeWriteOptions g_compact_lattice_write_opts;
+
+void RegisterCompactLatticeWriteOptions(OptionsItf *opts);
+
+/// Writes 'clat' in the compact varint-coded binary form (see
+/// CompactLatticeWriteOptions).  Returns false on stream failure.
+bool WriteCompactLatticeVarint(std::ostream &os,
+                               const CompactLatticeWriteOptions &opts,
+                               const CompactLattice &clat);
+
+/// Reads a CompactLattice written by WriteCompactLatticeVarint(), including
+/// its magic string; returns NULL (after a warning) on error.
+CompactLattice *ReadCompactLatticeVarint(std::istream &is);
+
 
 class CompactLatticeHolder {
  public:
@@ -75,7 +123,10 @@ class CompactLatticeHolder {
   static bool Write(std::ostream &os, bool binary, const T &t) {
     // Note: we don't include the binary-mode header when writing
     // this object to disk; this ensures that if we write to single
-    // files, the result can be read by OpenFst.
+    // files, the result can be read by OpenFst (unless the varint form
+    // was requested).
+    if (binary && g_compact_lattice_write_opts.varint_encoding)
+      return WriteCompactLatticeVarint(os, g_compact_lattice_write_opts, t);
     return WriteCompactLattice(os, binary, t);
   }
 
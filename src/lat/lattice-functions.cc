@@ -1755,4 +1755,34 @@ void ReplaceAcousticScoresFromMap(
   }
 }
 
+// The number of bytes used by the string of a CompactLatticeWeight, or 0 for
+// a LatticeWeight.
+static inline size_t WeightStringBytes(const LatticeWeight &weight) {
+  return 0;
+}
+static inline size_t WeightStringBytes(const CompactLatticeWeight &weight) {
+  return weight.String().capacity() * sizeof(int32);
+}
+
+template <class Arc>
+static int64 LatticeMemoryUsageTpl(const fst::VectorFst<Arc> &lat) {
+  typedef typename Arc::StateId StateId;
+  int64 ans = sizeof(lat);
+  for (StateId s = 0; s < lat.NumStates(); s++) {
+    ans += sizeof(fst::VectorState<Arc>) + WeightStringBytes(lat.Final(s));
+    for (fst::ArcIterator<fst::VectorFst<Arc> > aiter(lat, s);
+         !aiter.Done(); aiter.Next())
+      ans += sizeof(Arc) + WeightStringBytes(aiter.Value().weight);
+  }
+  return ans;
+}
+
+int64 LatticeMemoryUsage(const Lattice &lat) {
+  return LatticeMemoryUsageTpl(lat);
+}
+
+int64 LatticeMemoryUsage(const CompactLattice &clat) {
+  return LatticeMemoryUsageTpl(clat);
+}
+
 }  // namespace kaldi
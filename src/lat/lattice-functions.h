@@ -421,6 +421,14 @@ void ReplaceAcousticScoresFromMap(
                                         PairHasher<int32> > &acoustic_scores,
     Lattice *lat);
 
+/// Returns the approximate memory in bytes used by the lattice: its states,
+/// arcs and final weights, and for a CompactLattice the strings of
+/// transition-ids in the weights.  This is for reporting where memory goes
+/// when decoding long utterances; it does not count the allocator's
+/// overhead.
+int64 LatticeMemoryUsage(const Lattice &lat);
+int64 LatticeMemoryUsage(const CompactLattice &clat);
+
 }  // namespace kaldi
 
 #endif  // KALDI_LAT_LATTICE_FUNCTIONS_H_
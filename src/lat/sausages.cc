@@ -130,11 +130,14 @@ void MinimumBayesRisk::NormalizeEps(std::vector<int32> *vec) {
 double MinimumBayesRisk::EditDistance(int32 N, int32 Q,
                                       Vector<double> &alpha,
                                       Matrix<double> &alpha_dash,
-                                      Vector<double> &alpha_dash_arc) {
+                                      Vector<double> &alpha_dash_arc,
+                                      std::vector<double> *arc_post) {
   alpha(1) = 0.0; // = log(1).  Line 5.
   alpha_dash(1, 0) = 0.0; // Line 5.
   for (int32 q = 1; q <= Q; q++)
     alpha_dash(1, q) = alpha_dash(1, q-1) + l(0, r(q)); // Line 7.
+  arc_post->resize(arcs_.size());
+  double *alpha_dash_arc_data = alpha_dash_arc.Data();
   for (int32 n = 2; n <= N; n++) {
     double alpha_n = kLogZeroDouble;
     for (size_t i = 0; i < pre_[n].size(); i++) {
@@ -143,23 +146,28 @@ double MinimumBayesRisk::EditDistance(int32 N, int32 Q,
     }
     alpha(n) = alpha_n; // Line 10.
     // Line 11 omitted: matrix was initialized to zero.
+    double *alpha_dash_n = alpha_dash.RowData(n);
     for (size_t i = 0; i < pre_[n].size(); i++) {
       const Arc &arc = arcs_[pre_[n][i]];
       int32 s_a = arc.start_node, w_a = arc.word;
       BaseFloat p_a = arc.loglike;
-      for (int32 q = 0; q <= Q; q++) {
-        if (q == 0) {
-          alpha_dash_arc(q) = // line 15.
-              alpha_dash(s_a, q) + l(w_a, 0, true);
-        } else {  // a1,a2,a3 are the 3 parts of min expression of line 17.
-          int32 r_q = r(q);
-          double a1 = alpha_dash(s_a, q-1) + l(w_a, r_q),
-              a2 = alpha_dash(s_a, q) + l(w_a, 0, true),
-              a3 = alpha_dash_arc(q-1) + l(0, r_q);
-          alpha_dash_arc(q) = std::min(a1, std::min(a2, a3));
-        }
+      // The posterior of the arc given that we reach node n; AccStats() needs
+      // it too.
+      double post = Exp(alpha(s_a) + p_a - alpha(n));
+      (*arc_post)[pre_[n][i]] = post;
+      const double *alpha_dash_s_a = alpha_dash.RowData(s_a);
+      double l_w_a_0 = l(w_a, 0, true);
+      alpha_dash_arc_data[0] = alpha_dash_s_a[0] + l_w_a_0; // line 15.
+      alpha_dash_n[0] += post * alpha_dash_arc_data[0];
+      for (int32 q = 1; q <= Q; q++) {
+        // a1,a2,a3 are the 3 parts of min expression of line 17.
+        int32 r_q = r(q);
+        double a1 = alpha_dash_s_a[q-1] + l(w_a, r_q),
+            a2 = alpha_dash_s_a[q] + l_w_a_0,
+            a3 = alpha_dash_arc_data[q-1] + l(0, r_q);
+        alpha_dash_arc_data[q] = std::min(a1, std::min(a2, a3));
         // line 19:
-        alpha_dash(n, q) += Exp(alpha(s_a) + p_a - alpha(n)) * alpha_dash_arc(q);
+        alpha_dash_n[q] += post * alpha_dash_arc_data[q];
       }
     }
   }
@@ -168,8 +176,6 @@ double MinimumBayesRisk::EditDistance(int32 N, int32 Q,
 
 // Figure 5 in the paper.
 void MinimumBayesRisk::AccStats() {
-  using std::map;
-
   int32 N = static_cast<int32>(pre_.size()) - 1,
       Q = static_cast<int32>(R_.size());
 
@@ -179,16 +185,16 @@ void MinimumBayesRisk::AccStats() {
   Matrix<double> beta_dash(N+1, Q+1); // index (1...N, 0...Q)
   Vector<double> beta_dash_arc(Q+1); // index 0...Q
   std::vector<char> b_arc(Q+1); // integer in {1,2,3}; index 1...Q
-  std::vector<map<int32, double> > gamma(Q+1); // temp. form of gamma.
-  // index 1...Q [word] -> occ.
-
-  // The tau maps below are the sums over arcs with the same word label
-  // of the tau_b and tau_e timing quantities mentioned in Appendix C of
-  // the paper... we are using these to get averaged times for both the
-  // the sausage bins and the 1-best output.
-  std::vector<map<int32, double> > tau_b(Q+1), tau_e(Q+1);
-
-  double Ltmp = EditDistance(N, Q, alpha, alpha_dash, alpha_dash_arc);
+  std::vector<double> arc_post; // indexed by arc, see EditDistance().
+  // The stats for each word in each bin, index 1...Q: a temporary form of
+  // gamma, plus the sums over arcs with the same word label of the tau_b and
+  // tau_e timing quantities mentioned in Appendix C of the paper... we are
+  // using these to get averaged times for both the the sausage bins and the
+  // 1-best output.
+  std::vector<std::vector<GammaStats> > stats(Q+1);
+
+  double Ltmp = EditDistance(N, Q, alpha, alpha_dash, alpha_dash_arc,
+                             &arc_post);
   if (L_ != 0 && Ltmp > L_) { // L_ != 0 is to rule out 1st iter.
     KALDI_WARN << "Edit distance increased: " << Ltmp << " > "
                << L_;
@@ -197,108 +203,105 @@ void MinimumBayesRisk::AccStats() {
   KALDI_VLOG(2) << "L = " << L_;
   // omit line 10: zero when initialized.
   beta_dash(N, Q) = 1.0; // Line 11.
+  double *alpha_dash_arc_data = alpha_dash_arc.Data(),
+      *beta_dash_arc_data = beta_dash_arc.Data();
   for (int32 n = N; n >= 2; n--) {
+    const double *beta_dash_n = beta_dash.RowData(n);
     for (size_t i = 0; i < pre_[n].size(); i++) {
       const Arc &arc = arcs_[pre_[n][i]];
       int32 s_a = arc.start_node, w_a = arc.word;
-      BaseFloat p_a = arc.loglike;
-      alpha_dash_arc(0) = alpha_dash(s_a, 0) + l(w_a, 0, true); // line 14.
+      double post = arc_post[pre_[n][i]];
+      const double *alpha_dash_s_a = alpha_dash.RowData(s_a);
+      double *beta_dash_s_a = beta_dash.RowData(s_a);
+      double l_w_a_0 = l(w_a, 0, true);
+      alpha_dash_arc_data[0] = alpha_dash_s_a[0] + l_w_a_0; // line 14.
       for (int32 q = 1; q <= Q; q++) { // this loop == lines 15-18.
         int32 r_q = r(q);
-        double a1 = alpha_dash(s_a, q-1) + l(w_a, r_q),
-            a2 = alpha_dash(s_a, q) + l(w_a, 0, true),
-            a3 = alpha_dash_arc(q-1) + l(0, r_q);
+        double a1 = alpha_dash_s_a[q-1] + l(w_a, r_q),
+            a2 = alpha_dash_s_a[q] + l_w_a_0,
+            a3 = alpha_dash_arc_data[q-1] + l(0, r_q);
         if (a1 <= a2) {
-          if (a1 <= a3) { b_arc[q] = 1; alpha_dash_arc(q) = a1; }
-          else { b_arc[q] = 3; alpha_dash_arc(q) = a3; }
+          if (a1 <= a3) { b_arc[q] = 1; alpha_dash_arc_data[q] = a1; }
+          else { b_arc[q] = 3; alpha_dash_arc_data[q] = a3; }
         } else {
-          if (a2 <= a3) { b_arc[q] = 2; alpha_dash_arc(q) = a2; }
-          else { b_arc[q] = 3; alpha_dash_arc(q) = a3; }
+          if (a2 <= a3) { b_arc[q] = 2; alpha_dash_arc_data[q] = a2; }
+          else { b_arc[q] = 3; alpha_dash_arc_data[q] = a3; }
         }
       }
       beta_dash_arc.SetZero(); // line 19.
       for (int32 q = Q; q >= 1; q--) {
         // line 21:
-        beta_dash_arc(q) += Exp(alpha(s_a) + p_a - alpha(n)) * beta_dash(n, q);
+        beta_dash_arc_data[q] += post * beta_dash_n[q];
         switch (static_cast<int>(b_arc[q])) { // lines 22 and 23:
           case 1:
-            beta_dash(s_a, q-1) += beta_dash_arc(q);
-            // next: gamma(q, w(a)) += beta_dash_arc(q)
-            AddToMap(w_a, beta_dash_arc(q), &(gamma[q]));
-            // next: accumulating times, see decl for tau_b,tau_e
-            AddToMap(w_a, state_times_[s_a] * beta_dash_arc(q), &(tau_b[q]));
-            AddToMap(w_a, state_times_[n] * beta_dash_arc(q), &(tau_e[q]));
+            beta_dash_s_a[q-1] += beta_dash_arc_data[q];
+            // next: gamma(q, w(a)) += beta_dash_arc(q), and accumulate the
+            // times, see GammaStats.
+            AddToStats(w_a, beta_dash_arc_data[q], state_times_[s_a],
+                       state_times_[n], &(stats[q]));
             break;
           case 2:
-            beta_dash(s_a, q) += beta_dash_arc(q);
+            beta_dash_s_a[q] += beta_dash_arc_data[q];
             break;
           case 3:
-            beta_dash_arc(q-1) += beta_dash_arc(q);
-            // next: gamma(q, epsilon) += beta_dash_arc(q)
-            AddToMap(0, beta_dash_arc(q), &(gamma[q]));
-            // next: accumulating times, see decl for tau_b,tau_e
+            beta_dash_arc_data[q-1] += beta_dash_arc_data[q];
+            // next: gamma(q, epsilon) += beta_dash_arc(q), and accumulate the
+            // times.
             // WARNING: there was an error in Appendix C.  If we followed
-            // the instructions there the next line would say state_times_[sa], but
-            // it would be wrong.  I will try to publish an erratum.
-            AddToMap(0, state_times_[n] * beta_dash_arc(q), &(tau_b[q]));
-            AddToMap(0, state_times_[n] * beta_dash_arc(q), &(tau_e[q]));
+            // the instructions there the begin time would be
+            // state_times_[sa], but it would be wrong.  I will try to publish
+            // an erratum.
+            AddToStats(0, beta_dash_arc_data[q], state_times_[n],
+                       state_times_[n], &(stats[q]));
             break;
           default:
             KALDI_ERR << "Invalid b_arc value"; // error in code.
         }
       }
-      beta_dash_arc(0) += Exp(alpha(s_a) + p_a - alpha(n)) * beta_dash(n, 0);
-      beta_dash(s_a, 0) += beta_dash_arc(0); // line 26.
+      beta_dash_arc_data[0] += post * beta_dash_n[0];
+      beta_dash_s_a[0] += beta_dash_arc_data[0]; // line 26.
     }
   }
   beta_dash_arc.SetZero(); // line 29.
   for (int32 q = Q; q >= 1; q--) {
     beta_dash_arc(q) += beta_dash(1, q);
     beta_dash_arc(q-1) += beta_dash_arc(q);
-    AddToMap(0, beta_dash_arc(q), &(gamma[q]));
-    // the statements below are actually redundant because
-    // state_times_[1] is zero.
-    AddToMap(0, state_times_[1] * beta_dash_arc(q), &(tau_b[q]));
-    AddToMap(0, state_times_[1] * beta_dash_arc(q), &(tau_e[q]));
+    // (the times are actually redundant here because state_times_[1] is
+    // zero.)
+    AddToStats(0, beta_dash_arc(q), state_times_[1], state_times_[1],
+               &(stats[q]));
   }
   for (int32 q = 1; q <= Q; q++) { // a check (line 35)
     double sum = 0.0;
-    for (map<int32, double>::iterator iter = gamma[q].begin();
-         iter != gamma[q].end(); ++iter) sum += iter->second;
+    for (size_t j = 0; j < stats[q].size(); j++)
+      sum += stats[q][j].gamma;
     if (fabs(sum - 1.0) > 0.1)
       KALDI_WARN << "sum of gamma[" << q << ",s] is " << sum;
   }
-  // The next part is where we take gamma, and convert
-  // to the class member gamma_, which is using a different
-  // data structure and indexed from zero, not one.
+  // The next part is where we take the stats, and convert them to the class
+  // members gamma_ and times_, which are using a different data structure and
+  // indexed from zero, not one.
   gamma_.clear();
   gamma_.resize(Q);
-  for (int32 q = 1; q <= Q; q++) {
-    for (map<int32, double>::iterator iter = gamma[q].begin();
-         iter != gamma[q].end(); ++iter)
-      gamma_[q-1].push_back(
-          std::make_pair(iter->first, static_cast<BaseFloat>(iter->second)));
-    // sort gamma_[q-1] from largest to smallest posterior.
-    GammaCompare comp;
-    std::sort(gamma_[q-1].begin(), gamma_[q-1].end(), comp);
-  }
-  // We do the same conversion for the state times tau_b and tau_e:
-  // they get turned into the times_ data member, which has zero-based
-  // indexing.
   times_.clear();
   times_.resize(Q);
   sausage_times_.clear();
   sausage_times_.resize(Q);
   for (int32 q = 1; q <= Q; q++) {
+    // sort from largest to smallest posterior.
+    GammaStatsCompare comp;
+    std::sort(stats[q].begin(), stats[q].end(), comp);
     double t_b = 0.0, t_e = 0.0;
-    for (std::vector<std::pair<int32, BaseFloat>>::iterator iter = gamma_[q-1].begin();
-         iter != gamma_[q-1].end(); ++iter) {
-      double w_b = tau_b[q][iter->first], w_e = tau_e[q][iter->first];
+    for (size_t j = 0; j < stats[q].size(); j++) {
+      const GammaStats &this_stats = stats[q][j];
+      BaseFloat gamma = static_cast<BaseFloat>(this_stats.gamma);
+      gamma_[q-1].push_back(std::make_pair(this_stats.word, gamma));
+      double w_b = this_stats.tau_b, w_e = this_stats.tau_e;
       if (w_b > w_e)
         KALDI_WARN << "Times out of order";  // this is quite bad.
       times_[q-1].push_back(
-          std::make_pair(static_cast<BaseFloat>(w_b / iter->second),
-                         static_cast<BaseFloat>(w_e / iter->second)));
+          std::make_pair(static_cast<BaseFloat>(w_b / gamma),
+                         static_cast<BaseFloat>(w_e / gamma)));
       t_b += w_b;
       t_e += w_e;
     }
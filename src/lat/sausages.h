@@ -163,11 +163,14 @@ class MinimumBayesRisk {
   inline int32 r(int32 q) { return R_[q-1]; }
 
 
-  /// Figure 4 of the paper; called from AccStats (Fig. 5)
+  /// Figure 4 of the paper; called from AccStats (Fig. 5).  Also outputs to
+  /// "arc_post", for each arc, Exp(alpha(start) + loglike - alpha(end)), which
+  /// AccStats needs too.
   double EditDistance(int32 N, int32 Q,
                       Vector<double> &alpha,
                       Matrix<double> &alpha_dash,
-                      Vector<double> &alpha_dash_arc);
+                      Vector<double> &alpha_dash_arc,
+                      std::vector<double> *arc_post);
 
   /// Figure 5 of the paper.  Outputs to gamma_ and L_.
   void AccStats();
@@ -188,13 +191,35 @@ class MinimumBayesRisk {
   static inline BaseFloat delta() { return 1.0e-05; }
 
 
-  /// Function used to increment map.
-  static inline void AddToMap(int32 i, double d, std::map<int32, double> *gamma) {
+  /// The statistics accumulated in AccStats() for a word in a bin: the
+  /// posterior of the word, and the posterior-weighted sums of its begin and
+  /// end times (tau_b and tau_e in Appendix C of the paper).
+  struct GammaStats {
+    int32 word;
+    double gamma;
+    double tau_b;
+    double tau_e;
+  };
+
+  /// Function used to increment the stats of bin "stats" for word "word", by
+  /// posterior "d" and times t_b and t_e.  Bins rarely have more than a few
+  /// words, so a vector is faster than a map here; the word is most likely to
+  /// be one added recently, so we search from the end.
+  static inline void AddToStats(int32 word, double d, int32 t_b, int32 t_e,
+                                std::vector<GammaStats> *stats) {
     if (d == 0) return;
-    std::pair<const int32, double> pr(i, d);
-    std::pair<std::map<int32, double>::iterator, bool> ret = gamma->insert(pr);
-    if (!ret.second) // not inserted, so add to contents.
-      ret.first->second += d;
+    std::vector<GammaStats>::reverse_iterator iter = stats->rbegin(),
+        end = stats->rend();
+    for (; iter != end; ++iter)
+      if (iter->word == word) break;
+    if (iter == end) {
+      GammaStats new_stats = { word, 0.0, 0.0, 0.0 };
+      stats->push_back(new_stats);
+      iter = stats->rbegin();
+    }
+    iter->gamma += d;
+    iter->tau_b += t_b * d;
+    iter->tau_e += t_e * d;
   }
 
   struct Arc {
@@ -263,6 +288,16 @@ class MinimumBayesRisk {
       else return a.first > b.first;
     }
   };
+
+  struct GammaStatsCompare {
+    // Orders GammaStats the same way GammaCompare orders the (word, posterior)
+    // pairs they are converted to.
+    bool operator () (const GammaStats &a, const GammaStats &b) const {
+      GammaCompare comp;
+      return comp(std::make_pair(a.word, static_cast<BaseFloat>(a.gamma)),
+                  std::make_pair(b.word, static_cast<BaseFloat>(b.gamma)));
+    }
+  };
 };
 
 }  // namespace kaldi
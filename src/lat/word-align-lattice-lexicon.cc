@@ -196,15 +196,15 @@ class LatticeLexiconWordAligner {
 
   // This function may alter queue_.
   StateId GetStateForTuple(const Tuple &tuple) {
-    MapType::iterator iter = map_.find(tuple);
-    if (iter == map_.end()) { // not in map.
+    // A single insert() hashes and compares the tuple's vectors once.
+    std::pair<MapType::iterator, bool> ret =
+        map_.insert(std::make_pair(tuple, fst::kNoStateId));
+    if (ret.second) { // not previously in map.
       StateId output_state = lat_out_->AddState();
-      map_[tuple] = output_state;
+      ret.first->second = output_state;
       queue_.push_back(std::make_pair(tuple, output_state));
-      return output_state;
-    } else {
-      return iter->second;
     }
+    return ret.first->second;
   }
 
   // This function may alter queue_, via GetStateForTuple.
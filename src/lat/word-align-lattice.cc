@@ -17,6 +17,7 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <deque>
 
 #include "lat/word-align-lattice.h"
 #include "hmm/transition-model.h"
@@ -57,27 +58,27 @@ class LatticeWordAligner {
     /// Note: the "next_state" of the arc will not be set, you have to do that
     /// yourself.
     bool OutputArc(const WordBoundaryInfo &info,
-                   const TransitionModel &tmodel,
+                   const WordAlignTransitionInfo &tinfo,
                    CompactLatticeArc *arc_out,
                    bool *error) {
       // order of this ||-expression doesn't matter for
       // function behavior, only for efficiency, since the
       // cases are disjoint.
-      return OutputNormalWordArc(info, tmodel, arc_out, error) ||
-          OutputSilenceArc(info, tmodel, arc_out, error) ||
-          OutputOnePhoneWordArc(info, tmodel, arc_out, error);
+      return OutputNormalWordArc(info, tinfo, arc_out, error) ||
+          OutputSilenceArc(info, tinfo, arc_out, error) ||
+          OutputOnePhoneWordArc(info, tinfo, arc_out, error);
     }
 
     bool OutputSilenceArc(const WordBoundaryInfo &info,
-                          const TransitionModel &tmodel,
+                          const WordAlignTransitionInfo &tinfo,
                           CompactLatticeArc *arc_out,
                           bool *error);
     bool OutputOnePhoneWordArc(const WordBoundaryInfo &info,
-                               const TransitionModel &tmodel,
+                               const WordAlignTransitionInfo &tinfo,
                                CompactLatticeArc *arc_out,
                                bool *error);
     bool OutputNormalWordArc(const WordBoundaryInfo &info,
-                             const TransitionModel &tmodel,
+                             const WordAlignTransitionInfo &tinfo,
                              CompactLatticeArc *arc_out,
                              bool *error);
 
@@ -101,7 +102,7 @@ class LatticeWordAligner {
     /// happen for lattices that were somehow broken, i.e.
     /// had not reached the final state.
     void OutputArcForce(const WordBoundaryInfo &info,
-                        const TransitionModel &tmodel,
+                        const WordAlignTransitionInfo &tinfo,
                         CompactLatticeArc *arc_out,
                         bool *error);
 
@@ -133,51 +134,65 @@ class LatticeWordAligner {
   };
 
 
-  struct Tuple {
-    Tuple(StateId input_state, ComputationState comp_state):
-        input_state(input_state), comp_state(comp_state) {}
-    StateId input_state;
-    ComputationState comp_state;
-  };
+  // Each distinct ComputationState is stored once, in comp_states_, and is
+  // referred to by its index; so the tuples that identify the output states,
+  // and the queue, contain just pairs of integers, and the transition-id and
+  // word vectors are hashed once per new computation state rather than for
+  // every lookup of a tuple.
+  typedef std::pair<StateId, int32> Tuple;  // (input-state, comp-state index).
 
-  struct TupleHash {
-    size_t operator() (const Tuple &state) const {
-      return state.input_state + 102763 * state.comp_state.Hash();
-      // 102763 is just an arbitrary prime number
+  struct ComputationStatePtrHash {
+    size_t operator() (const ComputationState *comp_state) const {
+      return comp_state->Hash();
     }
   };
-  struct TupleEqual {
-    bool operator () (const Tuple &state1, const Tuple &state2) const {
-      // treat this like operator ==
-      return (state1.input_state == state2.input_state
-              && state1.comp_state == state2.comp_state);
+  struct ComputationStatePtrEqual {
+    bool operator () (const ComputationState *comp_state1,
+                      const ComputationState *comp_state2) const {
+      return (*comp_state1 == *comp_state2);
     }
   };
 
-  typedef unordered_map<Tuple, StateId, TupleHash, TupleEqual> MapType;
+  typedef unordered_map<const ComputationState*, int32,
+                        ComputationStatePtrHash,
+                        ComputationStatePtrEqual> CompStateMapType;
+  typedef unordered_map<Tuple, StateId, PairHasher<int32> > MapType;
 
-  StateId GetStateForTuple(const Tuple &tuple, bool add_to_queue) {
-    MapType::iterator iter = map_.find(tuple);
-    if (iter == map_.end()) { // not in map.
+  int32 GetComputationStateIndex(const ComputationState &comp_state) {
+    CompStateMapType::iterator iter = comp_state_map_.find(&comp_state);
+    if (iter != comp_state_map_.end())
+      return iter->second;
+    int32 index = comp_states_.size();
+    comp_states_.push_back(comp_state);
+    comp_state_map_[&(comp_states_.back())] = index;
+    return index;
+  }
+
+  StateId GetStateForTuple(StateId input_state,
+                           const ComputationState &comp_state,
+                           bool add_to_queue) {
+    Tuple tuple(input_state, GetComputationStateIndex(comp_state));
+    std::pair<MapType::iterator, bool> ret =
+        map_.insert(std::make_pair(tuple, fst::kNoStateId));
+    if (ret.second) { // not previously in map.
       StateId output_state = lat_out_->AddState();
-      map_[tuple] = output_state;
+      ret.first->second = output_state;
       if (add_to_queue)
         queue_.push_back(std::make_pair(tuple, output_state));
-      return output_state;
-    } else {
-      return iter->second;
     }
+    return ret.first->second;
   }
 
-  void ProcessFinal(Tuple tuple, StateId output_state) {
+  void ProcessFinal(StateId input_state, ComputationState comp_state,
+                    StateId output_state) {
     // ProcessFinal is only called if the input_state has
     // final-prob of One().  [else it should be zero.  This
     // is because we called CreateSuperFinal().]
 
-    if (tuple.comp_state.IsEmpty()) { // computation state doesn't have
+    if (comp_state.IsEmpty()) { // computation state doesn't have
       // anything pending.
       std::vector<int32> empty_vec;
-      CompactLatticeWeight cw(tuple.comp_state.FinalWeight(), empty_vec);
+      CompactLatticeWeight cw(comp_state.FinalWeight(), empty_vec);
       lat_out_->SetFinal(output_state, Plus(lat_out_->Final(output_state), cw));
     } else {
       // computation state has something pending, i.e. input or
@@ -185,9 +200,9 @@ class LatticeWordAligner {
       // have returned false or we wouldn't have been called, so we have to
       // force it out.
       CompactLatticeArc lat_arc;
-      tuple.comp_state.OutputArcForce(info_, tmodel_, &lat_arc, &error_);
+      comp_state.OutputArcForce(info_, tinfo_, &lat_arc, &error_);
       // True in the next line means add it to the queue.
-      lat_arc.nextstate = GetStateForTuple(tuple, true);
+      lat_arc.nextstate = GetStateForTuple(input_state, comp_state, true);
       // The final-prob stuff will get called again from ProcessQueueElement().
       // Note: because we did CreateSuperFinal(), this final-state on the input
       // lattice will have no output arcs (and unit final-prob), so there will be
@@ -201,8 +216,11 @@ class LatticeWordAligner {
 
   void ProcessQueueElement() {
     KALDI_ASSERT(!queue_.empty());
-    Tuple tuple = queue_.back().first;
-    StateId output_state = queue_.back().second;
+    StateId input_state = queue_.back().first.first,
+        output_state = queue_.back().second;
+    // Note: elements of a deque are not moved when it grows.
+    const ComputationState &comp_state =
+        comp_states_[queue_.back().first.second];
     queue_.pop_back();
 
     // First thing is-- we see whether the computation-state has something
@@ -211,9 +229,12 @@ class LatticeWordAligner {
     // epsilon-sequencing rules encoded by the filters in
     // composition.
     CompactLatticeArc lat_arc;
-    if (tuple.comp_state.OutputArc(info_, tmodel_, &lat_arc, &error_)) {
-      // note: this function changes the tuple (when it returns true).
-      lat_arc.nextstate = GetStateForTuple(tuple, true); // true == add to queue,
+    ComputationState next_comp_state(comp_state);
+    if (next_comp_state.OutputArc(info_, tinfo_, &lat_arc, &error_)) {
+      // note: this function changes the computation state (when it returns
+      // true).
+      lat_arc.nextstate = GetStateForTuple(input_state, next_comp_state,
+                                           true); // true == add to queue,
       // if not already present.
       KALDI_ASSERT(output_state != lat_arc.nextstate);
       lat_out_->AddArc(output_state, lat_arc);
@@ -223,20 +244,21 @@ class LatticeWordAligner {
       // above, and also these), but this is a bit like the epsilon-sequencing
       // stuff in composition: we avoid duplicate arcs by doing it this way.
 
-      if (lat_.Final(tuple.input_state) != CompactLatticeWeight::Zero()) {
-        KALDI_ASSERT(lat_.Final(tuple.input_state) == CompactLatticeWeight::One());
+      if (lat_.Final(input_state) != CompactLatticeWeight::Zero()) {
+        KALDI_ASSERT(lat_.Final(input_state) == CompactLatticeWeight::One());
         // ... since we did CreateSuperFinal.
-        ProcessFinal(tuple, output_state);
+        ProcessFinal(input_state, comp_state, output_state);
       }
       // Now process the arcs.  Note: final-state shouldn't have any arcs.
-      for (fst::ArcIterator<CompactLattice> aiter(lat_, tuple.input_state);
+      for (fst::ArcIterator<CompactLattice> aiter(lat_, input_state);
           !aiter.Done(); aiter.Next()) {
         const CompactLatticeArc &arc = aiter.Value();
-        Tuple next_tuple(tuple);
+        ComputationState next_comp_state(comp_state);
         LatticeWeight weight;
-        next_tuple.comp_state.Advance(arc, &weight);
-        next_tuple.input_state = arc.nextstate;
-        StateId next_output_state = GetStateForTuple(next_tuple, true); // true == add to queue,
+        next_comp_state.Advance(arc, &weight);
+        StateId next_output_state = GetStateForTuple(arc.nextstate,
+                                                     next_comp_state,
+                                                     true); // true == add to queue,
         // if not already present.
         // We add an epsilon arc here (as the input and output happens
         // separately)... the epsilons will get removed later.
@@ -250,11 +272,11 @@ class LatticeWordAligner {
   }
 
   LatticeWordAligner(const CompactLattice &lat,
-                     const TransitionModel &tmodel,
+                     const WordAlignTransitionInfo &tinfo,
                      const WordBoundaryInfo &info,
                      int32 max_states,
                      CompactLattice *lat_out):
-      lat_(lat), tmodel_(tmodel), info_in_(info), info_(info),
+      lat_(lat), tinfo_(tinfo), info_in_(info), info_(info),
       max_states_(max_states), lat_out_(lat_out),
       error_(false) {
     bool test = true;
@@ -311,8 +333,8 @@ class LatticeWordAligner {
       return false;
     }
     ComputationState initial_comp_state;
-    Tuple initial_tuple(lat_.Start(), initial_comp_state);
-    StateId start_state = GetStateForTuple(initial_tuple, true); // True = add this to queue.
+    StateId start_state = GetStateForTuple(lat_.Start(), initial_comp_state,
+                                           true); // True = add this to queue.
     lat_out_->SetStart(start_state);
 
     while (!queue_.empty()) {
@@ -332,7 +354,7 @@ class LatticeWordAligner {
   }
 
   CompactLattice lat_;
-  const TransitionModel &tmodel_;
+  const WordAlignTransitionInfo &tinfo_;
   const WordBoundaryInfo &info_in_;
   WordBoundaryInfo info_;
   int32 max_states_;
@@ -340,7 +362,8 @@ class LatticeWordAligner {
 
   std::vector<std::pair<Tuple, StateId> > queue_;
 
-
+  std::deque<ComputationState> comp_states_;
+  CompStateMapType comp_state_map_; // map to indexes into comp_states_.
 
   MapType map_; // map from tuples to StateId.
   bool error_;
@@ -348,10 +371,10 @@ class LatticeWordAligner {
 };
 
 bool LatticeWordAligner::ComputationState::OutputSilenceArc(
-    const WordBoundaryInfo &info, const TransitionModel &tmodel,
+    const WordBoundaryInfo &info, const WordAlignTransitionInfo &tinfo,
     CompactLatticeArc *arc_out,  bool *error) {
   if (transition_ids_.empty()) return false;
-  int32 phone = tmodel.TransitionIdToPhone(transition_ids_[0]);
+  int32 phone = tinfo.TransitionIdToPhone(transition_ids_[0]);
   if (info.TypeOfPhone(phone) != WordBoundaryInfo::kNonWordPhone) return false;
 
   // we assume the start of transition_ids_ is the start of the phone [silence];
@@ -361,22 +384,22 @@ bool LatticeWordAligner::ComputationState::OutputSilenceArc(
   // reorder==true, we have to go a bit further after this.
   for (i = 0; i < len; i++) {
     int32 tid = transition_ids_[i];
-    int32 this_phone = tmodel.TransitionIdToPhone(tid);
+    int32 this_phone = tinfo.TransitionIdToPhone(tid);
     if (this_phone != phone && ! *error) { // error condition: should have reached final transition-id first.
       *error = true;
       KALDI_WARN << "Phone changed before final transition-id found "
           "[broken lattice or mismatched model or wrong --reorder option?]";
     }
-    if (tmodel.IsFinal(tid))
+    if (tinfo.IsFinal(tid))
       break;
   }
   if (i == len) return false; // fell off loop.
   i++; // go past the one for which IsFinal returned true.
   if (info.reorder) // we have to consume the following self-loop transition-ids.
-    while (i < len && tmodel.IsSelfLoop(transition_ids_[i])) i++;
+    while (i < len && tinfo.IsSelfLoop(transition_ids_[i])) i++;
   if (i == len) return false; // we don't know if it ends here... so can't output arc.
 
-  if (tmodel.TransitionIdToPhone(transition_ids_[i-1]) != phone
+  if (tinfo.TransitionIdToPhone(transition_ids_[i-1]) != phone
       && ! *error) { // another check.
     KALDI_WARN << "Phone changed unexpectedly in lattice "
         "[broken lattice or mismatched model?]";
@@ -394,11 +417,11 @@ bool LatticeWordAligner::ComputationState::OutputSilenceArc(
 
 
 bool LatticeWordAligner::ComputationState::OutputOnePhoneWordArc(
-    const WordBoundaryInfo &info, const TransitionModel &tmodel,
+    const WordBoundaryInfo &info, const WordAlignTransitionInfo &tinfo,
     CompactLatticeArc *arc_out,  bool *error) {
   if (transition_ids_.empty()) return false;
   if (word_labels_.empty()) return false;
-  int32 phone = tmodel.TransitionIdToPhone(transition_ids_[0]);
+  int32 phone = tinfo.TransitionIdToPhone(transition_ids_[0]);
   if (info.TypeOfPhone(phone) != WordBoundaryInfo::kWordBeginAndEndPhone)
     return false;
   // we assume the start of transition_ids_ is the start of the phone.
@@ -406,22 +429,22 @@ bool LatticeWordAligner::ComputationState::OutputOnePhoneWordArc(
   size_t len = transition_ids_.size(), i;
   for (i = 0; i < len; i++) {
     int32 tid = transition_ids_[i];
-    int32 this_phone = tmodel.TransitionIdToPhone(tid);
+    int32 this_phone = tinfo.TransitionIdToPhone(tid);
     if (this_phone != phone && ! *error) { // error condition: should have reached final transition-id first.
       KALDI_WARN << "Phone changed before final transition-id found "
           "[broken lattice or mismatched model or wrong --reorder option?]";
       // just continue, ignoring this-- we'll probably output something...
     }
-    if (tmodel.IsFinal(tid))
+    if (tinfo.IsFinal(tid))
       break;
   }
   if (i == len) return false; // fell off loop.
   i++; // go past the one for which IsFinal returned true.
   if (info.reorder) // we have to consume the following self-loop transition-ids.
-    while (i < len && tmodel.IsSelfLoop(transition_ids_[i])) i++;
+    while (i < len && tinfo.IsSelfLoop(transition_ids_[i])) i++;
   if (i == len) return false; // we don't know if it ends here... so can't output arc.
 
-  if (tmodel.TransitionIdToPhone(transition_ids_[i-1]) != phone
+  if (tinfo.TransitionIdToPhone(transition_ids_[i-1]) != phone
       && ! *error) { // another check.
     KALDI_WARN << "Phone changed unexpectedly in lattice "
         "[broken lattice or mismatched model?]";
@@ -448,11 +471,11 @@ bool LatticeWordAligner::ComputationState::OutputOnePhoneWordArc(
 /// This function tries to see if it can output a normal word arc--
 /// one with at least two phones in it.
 bool LatticeWordAligner::ComputationState::OutputNormalWordArc(
-    const WordBoundaryInfo &info, const TransitionModel &tmodel,
+    const WordBoundaryInfo &info, const WordAlignTransitionInfo &tinfo,
     CompactLatticeArc *arc_out,  bool *error) {
   if (transition_ids_.empty()) return false;
   if (word_labels_.empty()) return false;
-  int32 begin_phone = tmodel.TransitionIdToPhone(transition_ids_[0]);
+  int32 begin_phone = tinfo.TransitionIdToPhone(transition_ids_[0]);
   if (info.TypeOfPhone(begin_phone) != WordBoundaryInfo::kWordBeginPhone)
     return false;
   // we assume the start of transition_ids_ is the start of the phone.
@@ -462,13 +485,13 @@ bool LatticeWordAligner::ComputationState::OutputNormalWordArc(
   // Eat up the transition-ids of this word-begin phone until we get to the
   // "final" transition-id.  [there may be self-loops following this though,
   // if reorder==true]
-  for (i = 0; i < len && !tmodel.IsFinal(transition_ids_[i]); i++);
+  for (i = 0; i < len && !tinfo.IsFinal(transition_ids_[i]); i++);
   if (i == len) return false;
   i++; // Skip over this final-transition.
   if (info.reorder) // Skip over any reordered self-loops for this final-transition
-    for (; i < len && tmodel.IsSelfLoop(transition_ids_[i]); i++);
+    for (; i < len && tinfo.IsSelfLoop(transition_ids_[i]); i++);
   if (i == len) return false;
-  if (tmodel.TransitionIdToPhone(transition_ids_[i-1]) != begin_phone
+  if (tinfo.TransitionIdToPhone(transition_ids_[i-1]) != begin_phone
       && ! *error) { // another check.
     KALDI_WARN << "Phone changed unexpectedly in lattice "
         "[broken lattice or mismatched model?]";
@@ -479,7 +502,7 @@ bool LatticeWordAligner::ComputationState::OutputNormalWordArc(
   // here, but we'll just print a warning if we get something
   // else.
   for (; i < len; i++) {
-    int32 this_phone = tmodel.TransitionIdToPhone(transition_ids_[i]);
+    int32 this_phone = tinfo.TransitionIdToPhone(transition_ids_[i]);
     if (info.TypeOfPhone(this_phone) == WordBoundaryInfo::kWordEndPhone)
       break;
     if (info.TypeOfPhone(this_phone) != WordBoundaryInfo::kWordInternalPhone
@@ -495,24 +518,24 @@ bool LatticeWordAligner::ComputationState::OutputNormalWordArc(
   // a "final-transition".
 
   // this variable just used for checks.
-  int32 final_phone = tmodel.TransitionIdToPhone(transition_ids_[i]);
+  int32 final_phone = tinfo.TransitionIdToPhone(transition_ids_[i]);
   for (; i < len; i++) {
-    int32 this_phone = tmodel.TransitionIdToPhone(transition_ids_[i]);
+    int32 this_phone = tinfo.TransitionIdToPhone(transition_ids_[i]);
     if (this_phone != final_phone && ! *error) {
       *error = true;
       KALDI_WARN << "Phone changed before final transition-id found "
           "[broken lattice or mismatched model or wrong --reorder option?]";
     }
-    if (tmodel.IsFinal(transition_ids_[i])) break;
+    if (tinfo.IsFinal(transition_ids_[i])) break;
   }
   if (i == len) return false;
   i++;
   // We got to the final-transition of the final phone;
   // if reorder==true, continue eating up the self-loop.
   if (info.reorder == true)
-    while (i < len && tmodel.IsSelfLoop(transition_ids_[i])) i++;
+    while (i < len && tinfo.IsSelfLoop(transition_ids_[i])) i++;
   if (i == len) return false;
-  if (tmodel.TransitionIdToPhone(transition_ids_[i-1]) != final_phone
+  if (tinfo.TransitionIdToPhone(transition_ids_[i-1]) != final_phone
       && ! *error) {
     *error = true;
     KALDI_WARN << "Phone changed while following final self-loop "
@@ -541,29 +564,29 @@ bool LatticeWordAligner::ComputationState::OutputNormalWordArc(
 // Returns true if this vector of transition-ids could be a valid
 // word.  Note: the checks are not 100% exhaustive.
 static bool IsPlausibleWord(const WordBoundaryInfo &info,
-                            const TransitionModel &tmodel,
+                            const WordAlignTransitionInfo &tinfo,
                             const std::vector<int32> &transition_ids) {
   if (transition_ids.empty()) return false;
-  int32 first_phone = tmodel.TransitionIdToPhone(transition_ids.front()),
-      last_phone = tmodel.TransitionIdToPhone(transition_ids.back());
+  int32 first_phone = tinfo.TransitionIdToPhone(transition_ids.front()),
+      last_phone = tinfo.TransitionIdToPhone(transition_ids.back());
   if ( (info.TypeOfPhone(first_phone) == WordBoundaryInfo::kWordBeginAndEndPhone
         && first_phone == last_phone)
        ||
        (info.TypeOfPhone(first_phone) == WordBoundaryInfo::kWordBeginPhone &&
         info.TypeOfPhone(last_phone) == WordBoundaryInfo::kWordEndPhone) ) {
     if (! info.reorder) {
-      return (tmodel.IsFinal(transition_ids.back()));
+      return (tinfo.IsFinal(transition_ids.back()));
     } else {
       int32 i = transition_ids.size() - 1;
-      while (i > 0 && tmodel.IsSelfLoop(transition_ids[i])) i--;
-      return tmodel.IsFinal(transition_ids[i]);
+      while (i > 0 && tinfo.IsSelfLoop(transition_ids[i])) i--;
+      return tinfo.IsFinal(transition_ids[i]);
     }
   } else return false;
 }
 
 
 void LatticeWordAligner::ComputationState::OutputArcForce(
-    const WordBoundaryInfo &info, const TransitionModel &tmodel,
+    const WordBoundaryInfo &info, const WordAlignTransitionInfo &tinfo,
     CompactLatticeArc *arc_out,  bool *error) {
 
   KALDI_ASSERT(!IsEmpty());
@@ -573,7 +596,7 @@ void LatticeWordAligner::ComputationState::OutputArcForce(
     // and failed, so this means we didn't see the end of that
     // word.
     int32 word = word_labels_[0];
-    if (! *error && !IsPlausibleWord(info, tmodel, transition_ids_)) {
+    if (! *error && !IsPlausibleWord(info, tinfo, transition_ids_)) {
       *error = true;
       KALDI_WARN << "Invalid word at end of lattice [partial lattice, forced out?]";
     }
@@ -600,10 +623,10 @@ void LatticeWordAligner::ComputationState::OutputArcForce(
     word_labels_.clear();
   } else if (!transition_ids_.empty() && word_labels_.empty()) {
     // Transition-ids but no word label-- either silence or partial word.
-    int32 first_phone = tmodel.TransitionIdToPhone(transition_ids_[0]);
+    int32 first_phone = tinfo.TransitionIdToPhone(transition_ids_[0]);
     if (info.TypeOfPhone(first_phone) == WordBoundaryInfo::kNonWordPhone) {
       // first phone is silence...
-      if (first_phone != tmodel.TransitionIdToPhone(transition_ids_.back())
+      if (first_phone != tinfo.TransitionIdToPhone(transition_ids_.back())
           && ! *error) {
         *error = true;
         // Phone changed-- this is a code error, because the regular OutputArc
@@ -615,9 +638,9 @@ void LatticeWordAligner::ComputationState::OutputArcForce(
       if (!*error) { // Check that it ends at the end state of silence; error otherwise.
         int32 i = transition_ids_.size() - 1;
         if (info.reorder)
-          while (tmodel.IsSelfLoop(transition_ids_[i]) && i > 0)
+          while (tinfo.IsSelfLoop(transition_ids_[i]) && i > 0)
             i--;
-        if (!tmodel.IsFinal(transition_ids_[i])) {
+        if (!tinfo.IsFinal(transition_ids_[i])) {
           *error = true;
           KALDI_WARN << "Broken silence arc at end of utterance (does not "
               "reach end of silence)";
@@ -720,12 +743,34 @@ void WordBoundaryInfo::Init(std::istream &stream) {
     KALDI_ERR << "Empty word-boundary file";
 }
 
+WordAlignTransitionInfo::WordAlignTransitionInfo(
+    const TransitionModel &tmodel) {
+  int32 num_tids = tmodel.NumTransitionIds();
+  entries_.resize(num_tids + 1);
+  entries_[0].phone = 0;
+  entries_[0].is_final = entries_[0].is_self_loop = false;
+  for (int32 tid = 1; tid <= num_tids; tid++) {
+    entries_[tid].phone = tmodel.TransitionIdToPhone(tid);
+    entries_[tid].is_final = tmodel.IsFinal(tid);
+    entries_[tid].is_self_loop = tmodel.IsSelfLoop(tid);
+  }
+}
+
 bool WordAlignLattice(const CompactLattice &lat,
                       const TransitionModel &tmodel,
                       const WordBoundaryInfo &info,
                       int32 max_states,
                       CompactLattice *lat_out) {
-  LatticeWordAligner aligner(lat, tmodel, info, max_states, lat_out);
+  WordAlignTransitionInfo tinfo(tmodel);
+  return WordAlignLattice(lat, tinfo, info, max_states, lat_out);
+}
+
+bool WordAlignLattice(const CompactLattice &lat,
+                      const WordAlignTransitionInfo &tinfo,
+                      const WordBoundaryInfo &info,
+                      int32 max_states,
+                      CompactLattice *lat_out) {
+  LatticeWordAligner aligner(lat, tinfo, info, max_states, lat_out);
   return aligner.AlignLattice();
 }
 
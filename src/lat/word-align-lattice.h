@@ -168,6 +168,36 @@ struct WordBoundaryInfo {
   void SetOptions(const std::string int_list, PhoneType phone_type);
 };
 
+/// The properties of transition-ids that word alignment looks up for each
+/// transition-id on the lattice arcs, gathered into one array.  Getting them
+/// from the TransitionModel takes several indirections per call (IsFinal()
+/// consults the topology), so it is worth building this once per model when
+/// aligning many lattices.  The function names are those of TransitionModel.
+class WordAlignTransitionInfo {
+ public:
+  explicit WordAlignTransitionInfo(const TransitionModel &tmodel);
+
+  int32 TransitionIdToPhone(int32 trans_id) const {
+    return Lookup(trans_id).phone;
+  }
+  bool IsFinal(int32 trans_id) const { return Lookup(trans_id).is_final; }
+  bool IsSelfLoop(int32 trans_id) const {
+    return Lookup(trans_id).is_self_loop;
+  }
+ private:
+  struct Entry {
+    int32 phone;
+    bool is_final;
+    bool is_self_loop;
+  };
+  const Entry &Lookup(int32 trans_id) const {
+    KALDI_ASSERT(static_cast<size_t>(trans_id) < entries_.size() &&
+                 trans_id > 0);
+    return entries_[trans_id];
+  }
+  std::vector<Entry> entries_;  // indexed by transition-id.
+};
+
 /// Align lattice so that each arc has the transition-ids on it
 /// that correspond to the word that is on that arc.  [May also have
 /// epsilon arcs for optional silences.]
@@ -194,6 +224,15 @@ bool WordAlignLattice(const CompactLattice &lat,
                       int32 max_states,
                       CompactLattice *lat_out);
 
+/// As above, but with the transition-id properties already gathered.
+/// This is the version to call when aligning many lattices, and it may be
+/// called from several threads at once.
+bool WordAlignLattice(const CompactLattice &lat,
+                      const WordAlignTransitionInfo &tinfo,
+                      const WordBoundaryInfo &info,
+                      int32 max_states,
+                      CompactLattice *lat_out);
+
 
 
 /// This function is designed to crash if something went wrong with the
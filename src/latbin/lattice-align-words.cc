@@ -23,6 +23,84 @@
 #include "lat/kaldi-lattice.h"
 #include "lat/word-align-lattice.h"
 #include "lat/lattice-functions.h"
+#include "util/kaldi-thread.h"
+
+namespace kaldi {
+
+// Word-aligns one lattice in operator (), and writes the output and updates
+// the counts in its destructor, which TaskSequencer calls in order.
+class WordAlignLatticeTask {
+ public:
+  WordAlignLatticeTask(const WordAlignTransitionInfo &tinfo,
+                       const TransitionModel &tmodel,
+                       const WordBoundaryInfo &info,
+                       BaseFloat max_expand, bool output_if_error,
+                       bool do_test, const std::string &key,
+                       const CompactLattice &clat,
+                       CompactLatticeWriter *clat_writer,
+                       int32 *num_done, int32 *num_err):
+      tinfo_(tinfo), tmodel_(tmodel), info_(info), max_expand_(max_expand),
+      output_if_error_(output_if_error), do_test_(do_test), key_(key),
+      clat_(clat), clat_writer_(clat_writer), num_done_(num_done),
+      num_err_(num_err), ok_(false) { }
+
+  void operator () () {
+    int32 max_states;
+    if (max_expand_ > 0) max_states = 1000 + max_expand_ * clat_.NumStates();
+    else max_states = 0;
+
+    ok_ = WordAlignLattice(clat_, tinfo_, info_, max_states, &aligned_clat_);
+
+    if (do_test_ && ok_)
+      TestWordAlignedLattice(clat_, tmodel_, info_, aligned_clat_);
+
+    if (aligned_clat_.Start() != fst::kNoStateId)
+      TopSortCompactLatticeIfNeeded(&aligned_clat_);
+  }
+
+  ~WordAlignLatticeTask() {
+    if (!ok_) {
+      (*num_err_)++;
+      if (!output_if_error_)
+        KALDI_WARN << "Lattice for " << key_
+                   << " did not align correctly, producing no output.";
+      else {
+        if (aligned_clat_.Start() != fst::kNoStateId) {
+          KALDI_WARN << "Outputting partial lattice for " << key_;
+          clat_writer_->Write(key_, aligned_clat_);
+        } else {
+          KALDI_WARN << "Empty aligned lattice for " << key_
+                     << ", producing no output.";
+        }
+      }
+    } else {
+      if (aligned_clat_.Start() == fst::kNoStateId) {
+        (*num_err_)++;
+        KALDI_WARN << "Lattice was empty for key " << key_;
+      } else {
+        (*num_done_)++;
+        KALDI_VLOG(2) << "Aligned lattice for " << key_;
+        clat_writer_->Write(key_, aligned_clat_);
+      }
+    }
+  }
+ private:
+  const WordAlignTransitionInfo &tinfo_;
+  const TransitionModel &tmodel_;
+  const WordBoundaryInfo &info_;
+  BaseFloat max_expand_;
+  bool output_if_error_;
+  bool do_test_;
+  std::string key_;
+  CompactLattice clat_;
+  CompactLatticeWriter *clat_writer_;
+  int32 *num_done_;
+  int32 *num_err_;
+  CompactLattice aligned_clat_;
+  bool ok_;
+};
+
+}  // namespace kaldi
 
 int main(int argc, char *argv[]) {
   try {
@@ -58,6 +136,9 @@ int main(int argc, char *argv[]) {
     WordBoundaryInfoNewOpts opts;
     opts.Register(&po);
 
+    TaskSequencerConfig sequencer_config;  // has --num-threads option
+    sequencer_config.Register(&po);
+
     po.Read(argc, argv);
 
     if (po.NumArgs() != 4) {
@@ -79,49 +160,19 @@ int main(int argc, char *argv[]) {
 
     WordBoundaryInfo info(opts, word_boundary_rxfilename);
     
+    WordAlignTransitionInfo tinfo(tmodel);
+
     int32 num_done = 0, num_err = 0;
-    
-    for (; !clat_reader.Done(); clat_reader.Next()) {
-      std::string key = clat_reader.Key();
-      const CompactLattice &clat = clat_reader.Value();
-
-      CompactLattice aligned_clat;
-      int32 max_states;
-      if (max_expand > 0) max_states = 1000 + max_expand * clat.NumStates();
-      else max_states = 0;
-      
-      bool ok = WordAlignLattice(clat, tmodel, info, max_states, &aligned_clat);
-      
-      if (do_test && ok)
-        TestWordAlignedLattice(clat, tmodel, info, aligned_clat);
-
-      if (!ok) {
-        num_err++;
-        if (!output_if_error)
-          KALDI_WARN << "Lattice for " << key
-                     << " did not align correctly, producing no output.";
-        else {
-          if (aligned_clat.Start() != fst::kNoStateId) {
-            KALDI_WARN << "Outputting partial lattice for " << key;
-            TopSortCompactLatticeIfNeeded(&aligned_clat);
-            clat_writer.Write(key, aligned_clat);
-          } else {
-            KALDI_WARN << "Empty aligned lattice for " << key
-                       << ", producing no output.";
-          }
-        }
-      } else {
-        if (aligned_clat.Start() == fst::kNoStateId) {
-          num_err++;
-          KALDI_WARN << "Lattice was empty for key " << key;
-        } else {
-          num_done++;
-          KALDI_VLOG(2) << "Aligned lattice for " << key;
-          TopSortCompactLatticeIfNeeded(&aligned_clat);
-          clat_writer.Write(key, aligned_clat);
-        }
+
+    {
+      TaskSequencer<WordAlignLatticeTask> sequencer(sequencer_config);
+      for (; !clat_reader.Done(); clat_reader.Next()) {
+        sequencer.Run(new WordAlignLatticeTask(
+            tinfo, tmodel, info, max_expand, output_if_error, do_test,
+            clat_reader.Key(), clat_reader.Value(), &clat_writer,
+            &num_done, &num_err));
       }
-    }
+    }  // the destructor of 'sequencer' waits for the remaining tasks.
     KALDI_LOG << "Successfully aligned " << num_done << " lattices; "
               << num_err << " had errors.";
     return (num_done > num_err ? 0 : 1); // We changed the error condition slightly here,
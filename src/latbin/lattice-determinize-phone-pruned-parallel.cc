@@ -119,6 +119,7 @@ int main(int argc, char *argv[]) {
     po.Register("beam", &beam, "Pruning beam [applied after acoustic scaling].");
     determinize_opts.Register(&po);
     sequencer_opts.Register(&po);
+    RegisterGlobalThreadPoolOptions(&po);
     po.Read(argc, argv);
 
     if (po.NumArgs() != 3) {
@@ -140,7 +141,8 @@ int main(int argc, char *argv[]) {
     // Writes as compact lattice.
     CompactLatticeWriter compact_lat_writer(lats_wspecifier);
 
-    TaskSequencer<DeterminizeLatticeTask> sequencer(sequencer_opts);
+    TaskSequencer<DeterminizeLatticeTask> sequencer(sequencer_opts,
+                                                    &GlobalThreadPool());
 
     int32 n_done = 0, n_warn = 0;
 
@@ -158,7 +160,9 @@ int main(int argc, char *argv[]) {
       DeterminizeLatticeTask *task = new DeterminizeLatticeTask(
           trans_model, determinize_opts, key, acoustic_scale, beam,
           lat, &compact_lat_writer, &n_warn);
-      sequencer.Run(task);
+      // Start the largest lattices first, so that no large lattice is left
+      // running alone at the end.
+      sequencer.Run(task, lat->NumStates() + fst::NumArcs(*lat));
 
       n_done++;
     }
@@ -127,6 +127,7 @@ int main(int argc, char *argv[]) {
                 "If true, push and minimize after determinization");
     determinize_config.Register(&po);
     sequencer_config.Register(&po);
+    RegisterGlobalThreadPoolOptions(&po);
     po.Read(argc, argv);
 
     if (po.NumArgs() != 2) {
@@ -144,7 +145,8 @@ int main(int argc, char *argv[]) {
     
     // Write as compact lattice.
     CompactLatticeWriter compact_lat_writer(lats_wspecifier); 
-    TaskSequencer<DeterminizeLatticeTask> sequencer(sequencer_config);
+    TaskSequencer<DeterminizeLatticeTask> sequencer(
+        sequencer_config, &GlobalThreadPool());
     
     int32 n_done = 0, n_warn = 0;
 
@@ -162,7 +164,9 @@ int main(int argc, char *argv[]) {
       DeterminizeLatticeTask *task = new DeterminizeLatticeTask(
           determinize_config, key, acoustic_scale, beam, minimize,
           lat, &compact_lat_writer, &n_warn);
-      sequencer.Run(task);
+      // Start the largest lattices first, so that no large lattice is left
+      // running alone at the end.
+      sequencer.Run(task, lat->NumStates() + fst::NumArcs(*lat));
       n_done++;
     }
     sequencer.Wait();
@@ -45,9 +45,15 @@ int main(int argc, char *argv[]) {
 
     ParseOptions po(usage);
     BaseFloat lm_scale = 1.0;
+    bool use_mmap = false;
 
     po.Register("lm-scale", &lm_scale, "Scaling factor for language model "
                 "costs; frequently 1.0 or -1.0");
+    po.Register("mmap", &use_mmap, "If true, memory-map the language model "
+                "instead of reading it (const-arpa-in must be a file); this "
+                "is much faster for large models, and processes that map the "
+                "same file share the memory.");
+    RegisterHugePageOptions(&po);
 
     po.Read(argc, argv);
 
@@ -62,7 +68,10 @@ int main(int argc, char *argv[]) {
 
     // Reads the language model in ConstArpaLm format.
     ConstArpaLm const_arpa;
-    ReadKaldiObject(lm_rxfilename, &const_arpa);
+    if (use_mmap)
+      const_arpa.Map(lm_rxfilename);
+    else
+      ReadKaldiObject(lm_rxfilename, &const_arpa);
 
     // Reads and writes as compact lattice.
     SequentialCompactLatticeReader compact_lattice_reader(lats_rspecifier);
@@ -59,12 +59,14 @@ int main(int argc, char *argv[]) {
 
     ParseOptions po(usage);
     rnnlm::RnnlmComputeStateComputationOptions opts;
+    rnnlm::RnnlmStateCacheOptions cache_opts;
     ComposeLatticePrunedOptions compose_opts;
 
     int32 max_ngram_order = 3;
     BaseFloat lm_scale = 0.5;
     BaseFloat acoustic_scale = 0.1;
     bool use_carpa = false;
+    std::string use_gpu = "no";
 
     po.Register("lm-scale", &lm_scale, "Scaling factor for <lm-to-add>; its negative "
                 "will be applied to <lm-to-subtract>.");
@@ -77,8 +79,12 @@ int main(int argc, char *argv[]) {
         "saves time and reduces output lattice size).");
     po.Register("use-const-arpa", &use_carpa, "If true, read the old-LM file "
                 "as a const-arpa file as opposed to an FST file");
+    po.Register("use-gpu", &use_gpu,
+                "yes|no|optional|wait, only has effect if compiled with CUDA; "
+                "see also --lm-batch-size");
 
     opts.Register(&po);
+    cache_opts.Register(&po);
     compose_opts.Register(&po);
 
     po.Read(argc, argv);
@@ -128,6 +134,10 @@ int main(int argc, char *argv[]) {
                                                   lm_to_subtract_det_backoff);
     }
 
+#if HAVE_CUDA==1
+    CuDevice::Instantiate().SelectGpuId(use_gpu);
+#endif
+
     kaldi::nnet3::Nnet rnnlm;
     ReadKaldiObject(rnnlm_rxfilename, &rnnlm);
 
@@ -144,8 +154,12 @@ int main(int argc, char *argv[]) {
 
     int32 num_done = 0, num_err = 0;
 
+    // Shared by the utterances; NULL if --rnnlm-cache-size=0.
+    rnnlm::RnnlmStateCache *cache = (cache_opts.max_states > 0 ?
+                                     new rnnlm::RnnlmStateCache(cache_opts) :
+                                     NULL);
     rnnlm::KaldiRnnlmDeterministicFst* lm_to_add_orig = 
-         new rnnlm::KaldiRnnlmDeterministicFst(max_ngram_order, info);
+         new rnnlm::KaldiRnnlmDeterministicFst(max_ngram_order, info, cache);
 
     for (; !compact_lattice_reader.Done(); compact_lattice_reader.Next()) {
       fst::DeterministicOnDemandFst<StdArc> *lm_to_add =
@@ -199,6 +213,12 @@ int main(int argc, char *argv[]) {
     delete const_arpa;
     delete carpa_lm_to_subtract_fst;
 
+#if HAVE_CUDA==1
+    CuDevice::Instantiate().PrintProfile();
+#endif
+    if (cache != NULL)
+      cache->PrintStats();
+    delete cache;
     KALDI_LOG << "Overall, succeeded for " << num_done
               << " lattices, failed for " << num_err;
     return (num_done != 0 ? 0 : 1);
@@ -49,6 +49,7 @@ int main(int argc, char *argv[]) {
 
     ParseOptions po(usage);
     rnnlm::RnnlmComputeStateComputationOptions opts;
+    rnnlm::RnnlmStateCacheOptions cache_opts;
 
     int32 max_ngram_order = 3;
     BaseFloat lm_scale = 1.0;
@@ -60,6 +61,7 @@ int main(int argc, char *argv[]) {
         "with each other for rescoring purposes (an approximation that "
         "saves time and reduces output lattice size).");
     opts.Register(&po);
+    cache_opts.Register(&po);
 
     po.Read(argc, argv);
 
@@ -93,7 +95,11 @@ int main(int argc, char *argv[]) {
 
     int32 n_done = 0, n_fail = 0;
 
-    rnnlm::KaldiRnnlmDeterministicFst rnnlm_fst(max_ngram_order, info);
+    // Shared by the utterances; NULL if --rnnlm-cache-size=0.
+    rnnlm::RnnlmStateCache *cache = (cache_opts.max_states > 0 ?
+                                     new rnnlm::RnnlmStateCache(cache_opts) :
+                                     NULL);
+    rnnlm::KaldiRnnlmDeterministicFst rnnlm_fst(max_ngram_order, info, cache);
 
     for (; !compact_lattice_reader.Done(); compact_lattice_reader.Next()) {
       std::string key = compact_lattice_reader.Key();
@@ -138,6 +144,9 @@ int main(int argc, char *argv[]) {
       rnnlm_fst.Clear();
     }
 
+    if (cache != NULL)
+      cache->PrintStats();
+    delete cache;
     KALDI_LOG << "Done " << n_done << " lattices, failed for " << n_fail;
     return (n_done != 0 ? 0 : 1);
   } catch(const std::exception &e) {
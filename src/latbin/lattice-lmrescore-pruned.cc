@@ -69,7 +69,7 @@ int main(int argc, char *argv[]) {
     po.Register("add-const-arpa", &add_const_arpa, "If true, <lm-to-add> is expected"
                 "to be in const-arpa format; if false it's expected to be in FST"
                 "format.");
-
+    RegisterHugePageOptions(&po);
 
     po.Read(argc, argv);
 
@@ -0,0 +1,435 @@
+// latbin/lattice-pipeline.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "util/kaldi-thread.h"
+#include "fstext/fstext-lib.h"
+#include "lat/kaldi-lattice.h"
+#include "lat/lattice-functions.h"
+#include "lat/flat-lattice.h"
+#include "lm/const-arpa-lm.h"
+
+namespace kaldi {
+
+// One stage of the pipeline.
+class LatticeOperation {
+ public:
+  // Applies the operation to 'clat', the lattice for utterance 'key'.  Returns
+  // false (after a warning) if there is no output for this utterance.  This
+  // is called from several threads at once.
+  virtual bool Apply(const std::string &key,
+                     FlatCompactLattice *clat) const = 0;
+  virtual ~LatticeOperation() { }
+};
+
+// Parses the options and arguments of an operation; args[0] is its name.
+static void ReadOperationArgs(const std::vector<std::string> &args,
+                              ParseOptions *po) {
+  std::vector<const char*> argv(args.size());
+  for (size_t i = 0; i < args.size(); i++)
+    argv[i] = args[i].c_str();
+  po->Read(argv.size(), &(argv[0]));
+}
+
+// As lattice-scale.
+class ScaleOperation: public LatticeOperation {
+ public:
+  explicit ScaleOperation(const std::vector<std::string> &args) {
+    ParseOptions po("Usage: scale [options] (options as for lattice-scale)");
+    BaseFloat acoustic_scale = 1.0, inv_acoustic_scale = 1.0, lm_scale = 1.0,
+        acoustic2lm_scale = 0.0, lm2acoustic_scale = 0.0;
+    po.Register("acoustic-scale", &acoustic_scale,
+                "Scaling factor for acoustic likelihoods");
+    po.Register("inv-acoustic-scale", &inv_acoustic_scale, "An alternative "
+                "way of setting the acoustic scale: you can set its inverse.");
+    po.Register("lm-scale", &lm_scale, "Scaling factor for graph/lm costs");
+    po.Register("acoustic2lm-scale", &acoustic2lm_scale,
+                "Add this times original acoustic costs to LM costs");
+    po.Register("lm2acoustic-scale", &lm2acoustic_scale,
+                "Add this times original LM costs to acoustic costs");
+    ReadOperationArgs(args, &po);
+    if (po.NumArgs() != 0) {
+      po.PrintUsage();
+      exit(1);
+    }
+    KALDI_ASSERT(acoustic_scale == 1.0 || inv_acoustic_scale == 1.0);
+    if (inv_acoustic_scale != 1.0)
+      acoustic_scale = 1.0 / inv_acoustic_scale;
+    scale_.resize(2);
+    scale_[0].resize(2);
+    scale_[1].resize(2);
+    scale_[0][0] = lm_scale;
+    scale_[0][1] = acoustic2lm_scale;
+    scale_[1][0] = lm2acoustic_scale;
+    scale_[1][1] = acoustic_scale;
+  }
+  virtual bool Apply(const std::string &key, FlatCompactLattice *clat) const {
+    ScaleLattice(scale_, clat);
+    return true;
+  }
+ private:
+  std::vector<std::vector<double> > scale_;
+};
+
+// As lattice-add-penalty.
+class AddPenaltyOperation: public LatticeOperation {
+ public:
+  explicit AddPenaltyOperation(const std::vector<std::string> &args):
+      word_ins_penalty_(0.0) {
+    ParseOptions po("Usage: add-penalty [options] (options as for "
+                    "lattice-add-penalty)");
+    po.Register("word-ins-penalty", &word_ins_penalty_,
+                "Word insertion penalty");
+    ReadOperationArgs(args, &po);
+    if (po.NumArgs() != 0) {
+      po.PrintUsage();
+      exit(1);
+    }
+  }
+  virtual bool Apply(const std::string &key, FlatCompactLattice *clat) const {
+    AddWordInsPenToCompactLattice(word_ins_penalty_, clat);
+    return true;
+  }
+ private:
+  BaseFloat word_ins_penalty_;
+};
+
+// As lattice-lmrescore-const-arpa.
+class LmRescoreConstArpaOperation: public LatticeOperation {
+ public:
+  explicit LmRescoreConstArpaOperation(const std::vector<std::string> &args):
+      lm_scale_(1.0) {
+    ParseOptions po("Usage: lmrescore-const-arpa [options] <const-arpa-in> "
+                    "(options as for lattice-lmrescore-const-arpa)");
+    bool use_mmap = false;
+    po.Register("lm-scale", &lm_scale_, "Scaling factor for language model "
+                "costs; frequently 1.0 or -1.0");
+    po.Register("mmap", &use_mmap, "If true, memory-map the language model "
+                "instead of reading it (const-arpa-in must be a file).");
+    ReadOperationArgs(args, &po);
+    if (po.NumArgs() != 1) {
+      po.PrintUsage();
+      exit(1);
+    }
+    if (use_mmap)
+      const_arpa_.Map(po.GetArg(1));
+    else
+      ReadKaldiObject(po.GetArg(1), &const_arpa_);
+  }
+  virtual bool Apply(const std::string &key, FlatCompactLattice *clat) const {
+    if (lm_scale_ == 0.0)
+      return true;
+    // See lattice-lmrescore-const-arpa.cc for why we scale by the inverse of
+    // the LM scale first.
+    ScaleLattice(fst::GraphLatticeScale(1.0 / lm_scale_), clat);
+    ConstArpaLmDeterministicFst const_arpa_fst(const_arpa_);
+    FlatCompactLattice composed_flat;
+    ComposeCompactLatticeDeterministic(*clat, &const_arpa_fst, &composed_flat);
+    // Determinization needs the usual types.
+    CompactLattice composed_clat;
+    ConvertFlatToCompactLattice(composed_flat, &composed_clat);
+    composed_flat.Clear();
+    Lattice composed_lat;
+    ConvertLattice(composed_clat, &composed_lat);
+    Invert(&composed_lat);
+    CompactLattice determinized_clat;
+    DeterminizeLattice(composed_lat, &determinized_clat);
+    fst::ScaleLattice(fst::GraphLatticeScale(lm_scale_), &determinized_clat);
+    if (determinized_clat.Start() == fst::kNoStateId) {
+      KALDI_WARN << "Empty lattice for utterance " << key
+                 << " (incompatible LM?)";
+      return false;
+    }
+    ConvertCompactLatticeToFlat(determinized_clat, clat);
+    return true;
+  }
+ private:
+  BaseFloat lm_scale_;
+  ConstArpaLm const_arpa_;
+};
+
+// As lattice-prune.
+class PruneOperation: public LatticeOperation {
+ public:
+  explicit PruneOperation(const std::vector<std::string> &args):
+      acoustic_scale_(1.0), beam_(10.0) {
+    ParseOptions po("Usage: prune [options] (options as for lattice-prune)");
+    BaseFloat inv_acoustic_scale = 1.0;
+    po.Register("acoustic-scale", &acoustic_scale_,
+                "Scaling factor for acoustic likelihoods");
+    po.Register("inv-acoustic-scale", &inv_acoustic_scale, "An alternative "
+                "way of setting the acoustic scale: you can set its inverse.");
+    po.Register("beam", &beam_, "Pruning beam [applied after acoustic "
+                "scaling]");
+    ReadOperationArgs(args, &po);
+    if (po.NumArgs() != 0) {
+      po.PrintUsage();
+      exit(1);
+    }
+    KALDI_ASSERT(acoustic_scale_ == 1.0 || inv_acoustic_scale == 1.0);
+    if (inv_acoustic_scale != 1.0)
+      acoustic_scale_ = 1.0 / inv_acoustic_scale;
+    if (acoustic_scale_ == 0.0)
+      KALDI_ERR << "Do not use a zero acoustic scale (cannot be inverted)";
+  }
+  virtual bool Apply(const std::string &key, FlatCompactLattice *clat) const {
+    ScaleLattice(fst::AcousticLatticeScale(acoustic_scale_), clat);
+    if (!PruneLattice(beam_, clat))
+      KALDI_WARN << "Error pruning lattice for utterance " << key;
+    ScaleLattice(fst::AcousticLatticeScale(1.0 / acoustic_scale_), clat);
+    return true;
+  }
+ private:
+  BaseFloat acoustic_scale_;
+  BaseFloat beam_;
+};
+
+// As lattice-1best (if 'scale_back' is true) or the first part of
+// lattice-best-path (if false; then the output keeps the scaled weights).
+class OneBestOperation: public LatticeOperation {
+ public:
+  OneBestOperation(const std::vector<std::string> &args, bool scale_back):
+      acoustic_scale_(1.0), lm_scale_(1.0), word_ins_penalty_(0.0),
+      scale_back_(scale_back) {
+    ParseOptions po(scale_back ?
+                    "Usage: 1best [options] (options as for lattice-1best)" :
+                    "Usage: best-path [options] (options as for "
+                    "lattice-best-path)");
+    po.Register("acoustic-scale", &acoustic_scale_,
+                "Scaling factor for acoustic likelihoods");
+    po.Register("lm-scale", &lm_scale_, "Scaling factor for language model "
+                "scores.");
+    if (scale_back)
+      po.Register("word-ins-penalty", &word_ins_penalty_,
+                  "Word insertion penalty.");
+    ReadOperationArgs(args, &po);
+    if (po.NumArgs() != 0) {
+      po.PrintUsage();
+      exit(1);
+    }
+    if (scale_back && (acoustic_scale_ == 0.0 || lm_scale_ == 0.0))
+      KALDI_ERR << "Do not use exactly zero acoustic or LM scale (cannot be "
+                << "inverted)";
+  }
+  virtual bool Apply(const std::string &key, FlatCompactLattice *clat) const {
+    ScaleLattice(fst::LatticeScale(lm_scale_, acoustic_scale_), clat);
+    if (word_ins_penalty_ > 0.0)
+      AddWordInsPenToCompactLattice(word_ins_penalty_, clat);
+    FlatCompactLattice best_path;
+    CompactLatticeShortestPath(*clat, &best_path);
+    clat->Swap(&best_path);
+    if (clat->Start() == fst::kNoStateId) {
+      KALDI_WARN << "Best-path failed for key " << key;
+      return false;
+    }
+    if (scale_back_) {
+      if (word_ins_penalty_ > 0.0)
+        AddWordInsPenToCompactLattice(-word_ins_penalty_, clat);
+      ScaleLattice(fst::LatticeScale(1.0 / lm_scale_, 1.0 / acoustic_scale_),
+                   clat);
+    }
+    return true;
+  }
+ private:
+  BaseFloat acoustic_scale_;
+  BaseFloat lm_scale_;
+  BaseFloat word_ins_penalty_;
+  bool scale_back_;
+};
+
+// Creates the operation described by 'args': its name (a latbin program
+// without the "lattice-" prefix) followed by its options and arguments.
+static LatticeOperation *NewLatticeOperation(
+    const std::vector<std::string> &args) {
+  KALDI_ASSERT(!args.empty());
+  const std::string &name = args[0];
+  if (name == "scale")
+    return new ScaleOperation(args);
+  else if (name == "add-penalty")
+    return new AddPenaltyOperation(args);
+  else if (name == "lmrescore-const-arpa")
+    return new LmRescoreConstArpaOperation(args);
+  else if (name == "prune")
+    return new PruneOperation(args);
+  else if (name == "1best")
+    return new OneBestOperation(args, true);
+  else if (name == "best-path")
+    return new OneBestOperation(args, false);
+  KALDI_ERR << "Unknown lattice operation '" << name << "'";
+  return NULL;
+}
+
+// Runs the operations on the lattice of one utterance, and writes the result
+// in its destructor (see class TaskSequencer).
+class LatticePipelineTask {
+ public:
+  // Takes the contents of 'clat'.  If 'words_writer' is non-NULL, the last
+  // operation was "best-path" and the words are written, otherwise the
+  // lattice is.
+  LatticePipelineTask(const std::vector<LatticeOperation*> &ops,
+                      const std::string &key, FlatCompactLattice *clat,
+                      FlatCompactLatticeWriter *lattice_writer,
+                      Int32VectorWriter *words_writer,
+                      int32 *num_done, int32 *num_fail):
+      ops_(ops), key_(key), ok_(false), lattice_writer_(lattice_writer),
+      words_writer_(words_writer), num_done_(num_done), num_fail_(num_fail) {
+    clat_.Swap(clat);
+  }
+
+  void operator () () {
+    ok_ = true;
+    for (size_t i = 0; i < ops_.size() && ok_; i++)
+      ok_ = ops_[i]->Apply(key_, &clat_);
+  }
+
+  ~LatticePipelineTask() {
+    if (!ok_) {
+      (*num_fail_)++;
+      return;
+    }
+    if (words_writer_ != NULL) {
+      // clat_ is linear; follow it to get the words.
+      std::vector<int32> words;
+      LatticeWeight weight = LatticeWeight::One();
+      int32 num_frames = 0;
+      FlatCompactLattice::StateId s = clat_.Start();
+      while (clat_.NumArcs(s) != 0) {
+        const FlatCompactLattice::Arc &arc = clat_.Arcs(s)[0];
+        if (arc.ilabel != 0)
+          words.push_back(arc.ilabel);
+        weight = Times(weight, arc.weight);
+        num_frames += arc.string_length;
+        s = arc.nextstate;
+      }
+      weight = Times(weight, clat_.Final(s));
+      num_frames += clat_.FinalStringLength(s);
+      KALDI_LOG << "For utterance " << key_ << ", best cost "
+                << weight.Value1() << " + " << weight.Value2() << " = "
+                << (weight.Value1() + weight.Value2())
+                << " over " << num_frames << " frames.";
+      words_writer_->Write(key_, words);
+    } else {
+      lattice_writer_->Write(key_, clat_);
+    }
+    (*num_done_)++;
+  }
+
+ private:
+  const std::vector<LatticeOperation*> &ops_;
+  std::string key_;
+  FlatCompactLattice clat_;
+  bool ok_;
+  FlatCompactLatticeWriter *lattice_writer_;
+  Int32VectorWriter *words_writer_;
+  int32 *num_done_;
+  int32 *num_fail_;
+};
+
+}  // namespace kaldi
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    typedef kaldi::int32 int32;
+
+    const char *usage =
+        "Applies a sequence of lattice operations to lattices, in memory and\n"
+        "on several threads, instead of a pipe of latbin programs.  The\n"
+        "operations are separated by '|'; each is the name of a program\n"
+        "without the \"lattice-\" prefix, followed by the options of the\n"
+        "program and its arguments other than the lattice rspecifier and\n"
+        "wspecifier.  Operations: scale, add-penalty, lmrescore-const-arpa,\n"
+        "prune, 1best and best-path; best-path can only be the last, and then\n"
+        "the output is the words of the best path (as the transcriptions of\n"
+        "lattice-best-path), otherwise it is lattices.\n"
+        "\n"
+        "Usage: lattice-pipeline [options] <operations> <lattice-rspecifier> "
+        "<wspecifier>\n"
+        " e.g.: lattice-pipeline --num-threads=8 'lmrescore-const-arpa "
+        "--lm-scale=-1.0 old.carpa |\n"
+        "         lmrescore-const-arpa new.carpa | prune --beam=8 "
+        "--acoustic-scale=0.1 |\n"
+        "         best-path --acoustic-scale=0.1' ark:1.lats ark,t:1.tra\n";
+
+    ParseOptions po(usage);
+    TaskSequencerConfig sequencer_config;  // has --num-threads option
+    sequencer_config.Register(&po);
+    RegisterGlobalThreadPoolOptions(&po);
+    RegisterHugePageOptions(&po);
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 3) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string operations = po.GetArg(1),
+        lats_rspecifier = po.GetArg(2),
+        wspecifier = po.GetArg(3);
+
+    std::vector<std::string> stages;
+    SplitStringToVector(operations, "|", true, &stages);
+    std::vector<LatticeOperation*> ops;
+    bool output_words = false;
+    for (size_t i = 0; i < stages.size(); i++) {
+      std::vector<std::string> args;
+      SplitStringToVector(stages[i], " \t\n", true, &args);
+      if (args.empty())
+        continue;
+      if (output_words)
+        KALDI_ERR << "best-path must be the last operation.";
+      output_words = (args[0] == "best-path");
+      ops.push_back(NewLatticeOperation(args));
+    }
+    if (ops.empty())
+      KALDI_ERR << "No operations given.";
+
+    SequentialFlatCompactLatticeReader lattice_reader(lats_rspecifier);
+    FlatCompactLatticeWriter lattice_writer;
+    Int32VectorWriter words_writer;
+    if (!(output_words ? words_writer.Open(wspecifier) :
+          lattice_writer.Open(wspecifier)))
+      KALDI_ERR << "Could not open table for writing: " << wspecifier;
+
+    int32 n_done = 0, n_fail = 0;
+    {
+      TaskSequencer<LatticePipelineTask> sequencer(sequencer_config,
+                                                   &GlobalThreadPool());
+      for (; !lattice_reader.Done(); lattice_reader.Next()) {
+        FlatCompactLattice &clat = lattice_reader.Value();
+        double cost = clat.NumStates() + clat.NumArcs();
+        LatticePipelineTask *task = new LatticePipelineTask(
+            ops, lattice_reader.Key(), &clat, &lattice_writer,
+            (output_words ? &words_writer : NULL), &n_done, &n_fail);
+        // The largest lattices are started first.
+        sequencer.Run(task, cost);
+      }
+      sequencer.Wait();
+    }
+    DeletePointers(&ops);
+
+    KALDI_LOG << "Done " << n_done << " lattices, failed for " << n_fail;
+    return (n_done != 0 ? 0 : 1);
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
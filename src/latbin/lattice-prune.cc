@@ -24,6 +24,7 @@
 #include "fstext/fstext-lib.h"
 #include "lat/kaldi-lattice.h"
 #include "lat/lattice-functions.h"
+#include "lat/flat-lattice.h"
 
 int main(int argc, char *argv[]) {
   try {
@@ -65,8 +66,10 @@ int main(int argc, char *argv[]) {
 
 
     
-    SequentialCompactLatticeReader compact_lattice_reader(lats_rspecifier);
-    CompactLatticeWriter compact_lattice_writer(lats_wspecifier); 
+    // The lattices are read, pruned and written as FlatCompactLattice, which
+    // is much faster than CompactLattice for this; the format is the same.
+    SequentialFlatCompactLatticeReader compact_lattice_reader(lats_rspecifier);
+    FlatCompactLatticeWriter compact_lattice_writer(lats_wspecifier);
 
     int32 n_done = 0, n_err = 0;
     int64 n_arcs_in = 0, n_arcs_out = 0,
@@ -77,26 +80,25 @@ int main(int argc, char *argv[]) {
     
     for (; !compact_lattice_reader.Done(); compact_lattice_reader.Next()) {
       std::string key = compact_lattice_reader.Key();
-      CompactLattice clat = compact_lattice_reader.Value();
-      compact_lattice_reader.FreeCurrent();
-      fst::ScaleLattice(fst::AcousticLatticeScale(acoustic_scale), &clat);
-      int64 narcs = NumArcs(clat), nstates = clat.NumStates();
+      FlatCompactLattice clat;
+      clat.Swap(&(compact_lattice_reader.Value()));
+      ScaleLattice(fst::AcousticLatticeScale(acoustic_scale), &clat);
+      int64 narcs = clat.NumArcs(), nstates = clat.NumStates();
       n_arcs_in += narcs;
       n_states_in += nstates;
-      CompactLattice pruned_clat(clat);
-      if (!PruneLattice(beam, &pruned_clat)) {
+      if (!PruneLattice(beam, &clat)) {
         KALDI_WARN << "Error pruning lattice for utterance " << key;
         n_err++;
       }
-      int64 pruned_narcs = NumArcs(pruned_clat),          
-          pruned_nstates = pruned_clat.NumStates();
+      int64 pruned_narcs = clat.NumArcs(),
+          pruned_nstates = clat.NumStates();
       n_arcs_out += pruned_narcs;
       n_states_out += pruned_nstates;
       KALDI_LOG << "For utterance " << key << ", pruned #states from "
                 << nstates << " to " << pruned_nstates << " and #arcs from "
                 << narcs << " to " << pruned_narcs;
-      fst::ScaleLattice(fst::AcousticLatticeScale(1.0/acoustic_scale), &pruned_clat);
-      compact_lattice_writer.Write(key, pruned_clat);
+      ScaleLattice(fst::AcousticLatticeScale(1.0/acoustic_scale), &clat);
+      compact_lattice_writer.Write(key, clat);
       n_done++;
     }
 
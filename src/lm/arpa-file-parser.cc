@@ -20,7 +20,9 @@
 
 #include <fst/fstlib.h>
 
+#include <algorithm>
 #include <sstream>
+#include <thread>
 
 #include "base/kaldi-error.h"
 #include "base/kaldi-math.h"
@@ -42,6 +44,10 @@ void TrimTrailingWhitespace(std::string *str) {
   str->erase(str->find_last_not_of(" \n\r\t") + 1);
 }
 
+// The number of n-gram lines that are read before they are parsed and
+// consumed.
+static const size_t kNGramBlockSize = 65536;
+
 void ArpaFileParser::Read(std::istream &is) {
   // Argument sanity checks.
   if (options_.bos_symbol <= 0 || options_.eos_symbol <= 0 ||
@@ -129,9 +135,6 @@ void ArpaFileParser::Read(std::istream &is) {
   // Signal that grammar order and n-gram counts are known.
   HeaderAvailable();
 
-  NGram ngram;
-  ngram.words.reserve(ngram_counts_.size());
-
   // Processes "\N-grams:" section.
   for (int32 cur_order = 1; cur_order <= ngram_counts_.size(); ++cur_order) {
     // Skips n-grams with zero count.
@@ -148,100 +151,58 @@ void ArpaFileParser::Read(std::istream &is) {
     }
     KALDI_LOG << "Reading " << current_line_ << " section.";
 
+    // The data lines are read in blocks, which ProcessNGramLines() may parse
+    // on several threads.
     int32 ngram_count = 0;
-    while (++line_number_, getline(is, current_line_) && !is.eof()) {
-      if (current_line_.find_first_not_of(" \n\t\r") == std::string::npos) {
-        continue;
-      }
-      if (current_line_[0] == '\\') {
-        TrimTrailingWhitespace(&current_line_);
-        std::ostringstream next_keyword;
-        next_keyword << "\\" << cur_order + 1 << "-grams:";
-        if ((current_line_ != next_keyword.str()) &&
-            (current_line_ != "\\end\\")) {
-          if (ShouldWarn()) {
-            KALDI_WARN << "ignoring possible directive '" << current_line_
-                       << "' expecting '" << next_keyword.str() << "'";
-
-            if (warning_count_ > 0 &&
-                warning_count_ > static_cast<uint32>(options_.max_warnings)) {
-              KALDI_WARN << "Of " << warning_count_ << " parse warnings, "
-                         << options_.max_warnings << " were reported. "
-                         << "Run program with --max-arpa-warnings=-1 "
-                         << "to see all warnings";
-            }
-          }
-        } else {
-          break;
+    std::vector<std::string> lines;
+    std::vector<int32> line_numbers;
+    bool section_done = false;
+    while (!section_done) {
+      section_done = true;
+      lines.clear();
+      line_numbers.clear();
+      while (++line_number_, getline(is, current_line_) && !is.eof()) {
+        if (current_line_.find_first_not_of(" \n\t\r") == std::string::npos) {
+          continue;
         }
-      }
-
-      std::vector<std::string> col;
-      SplitStringToVector(current_line_, " \t", true, &col);
-
-      if (col.size() < 1 + cur_order ||
-          col.size() > 2 + cur_order ||
-          (cur_order == ngram_counts_.size() && col.size() != 1 + cur_order)) {
-        PARSE_ERR << "Invalid n-gram data line";
-      }
-      ++ngram_count;
-
-      // Parse out n-gram logprob and, if present, backoff weight.
-      if (!ConvertStringToReal(col[0], &ngram.logprob)) {
-        PARSE_ERR << "invalid n-gram logprob '" << col[0] << "'";
-      }
-      ngram.backoff = 0.0;
-      if (col.size() > cur_order + 1) {
-        if (!ConvertStringToReal(col[cur_order + 1], &ngram.backoff))
-          PARSE_ERR << "invalid backoff weight '" << col[cur_order + 1] << "'";
-      }
-      // Convert to natural log.
-      ngram.logprob *= M_LN10;
-      ngram.backoff *= M_LN10;
-
-      ngram.words.resize(cur_order);
-      bool skip_ngram = false;
-      for (int32 index = 0; !skip_ngram && index < cur_order; ++index) {
-        int32 word;
-        if (symbols_) {
-          // Symbol table provided, so symbol labels are expected.
-          if (options_.oov_handling == ArpaParseOptions::kAddToSymbols) {
-            word = symbols_->AddSymbol(col[1 + index]);
-          } else {
-            word = symbols_->Find(col[1 + index]);
-            if (word == -1) { // fst::kNoSymbol
-              switch (options_.oov_handling) {
-                case ArpaParseOptions::kReplaceWithUnk:
-                  word = options_.unk_symbol;
-                  break;
-                case ArpaParseOptions::kSkipNGram:
-                  if (ShouldWarn())
-                    KALDI_WARN << LineReference() << " skipped: word '"
-                               << col[1 + index] << "' not in symbol table";
-                  skip_ngram = true;
-                  break;
-                default:
-                  PARSE_ERR << "word '"  << col[1 + index]
-                            << "' not in symbol table";
+        if (current_line_[0] == '\\') {
+          TrimTrailingWhitespace(&current_line_);
+          std::ostringstream next_keyword;
+          next_keyword << "\\" << cur_order + 1 << "-grams:";
+          if ((current_line_ != next_keyword.str()) &&
+              (current_line_ != "\\end\\")) {
+            if (ShouldWarn()) {
+              KALDI_WARN << "ignoring possible directive '" << current_line_
+                         << "' expecting '" << next_keyword.str() << "'";
+
+              if (warning_count_ > 0 &&
+                  warning_count_ > static_cast<uint32>(options_.max_warnings)) {
+                KALDI_WARN << "Of " << warning_count_ << " parse warnings, "
+                           << options_.max_warnings << " were reported. "
+                           << "Run program with --max-arpa-warnings=-1 "
+                           << "to see all warnings";
               }
             }
-          }
-        } else {
-          // Symbols not provided, LM file should contain integers.
-          if (!ConvertStringToInteger(col[1 + index], &word) || word < 0) {
-            PARSE_ERR << "invalid symbol '" << col[1 + index] << "'";
+          } else {
+            break;
           }
         }
-        // Whichever way we got it, an epsilon is invalid.
-        if (word == 0) {
-          PARSE_ERR << "epsilon symbol '" << col[1 + index]
-                    << "' is illegal in ARPA LM";
+        ++ngram_count;
+        lines.push_back(current_line_);
+        line_numbers.push_back(line_number_);
+        if (lines.size() == kNGramBlockSize) {
+          section_done = false;
+          break;
         }
-        ngram.words[index] = word;
-      }
-      if (!skip_ngram) {
-        ConsumeNGram(ngram);
       }
+      // Keep the directive that ended the section, as current_line_ is used
+      // for the lines of the block.
+      std::string directive;
+      directive.swap(current_line_);
+      int32 directive_line_number = line_number_;
+      ProcessNGramLines(cur_order, &lines, line_numbers);
+      current_line_.swap(directive);
+      line_number_ = directive_line_number;
     }
     if (ngram_count > ngram_counts_[cur_order - 1]) {
       PARSE_ERR << "header said there would be " << ngram_counts_[cur_order - 1]
@@ -267,6 +228,125 @@ void ArpaFileParser::Read(std::istream &is) {
 #undef PARSE_ERR
 }
 
+ArpaFileParser::LineStatus ArpaFileParser::ParseNGramLine(
+    const std::string &line, int32 order, NGram *ngram,
+    std::string *message) {
+  std::vector<std::string> col;
+  SplitStringToVector(line, " \t", true, &col);
+
+  if (col.size() < 1 + order || col.size() > 2 + order ||
+      (order == ngram_counts_.size() && col.size() != 1 + order)) {
+    *message = "Invalid n-gram data line";
+    return kNGramError;
+  }
+
+  // Parse out n-gram logprob and, if present, backoff weight.
+  if (!ConvertStringToReal(col[0], &ngram->logprob)) {
+    *message = "invalid n-gram logprob '" + col[0] + "'";
+    return kNGramError;
+  }
+  ngram->backoff = 0.0;
+  if (col.size() > order + 1) {
+    if (!ConvertStringToReal(col[order + 1], &ngram->backoff)) {
+      *message = "invalid backoff weight '" + col[order + 1] + "'";
+      return kNGramError;
+    }
+  }
+  // Convert to natural log.
+  ngram->logprob *= M_LN10;
+  ngram->backoff *= M_LN10;
+
+  ngram->words.resize(order);
+  for (int32 index = 0; index < order; ++index) {
+    int32 word;
+    if (symbols_) {
+      // Symbol table provided, so symbol labels are expected.
+      if (options_.oov_handling == ArpaParseOptions::kAddToSymbols) {
+        word = symbols_->AddSymbol(col[1 + index]);
+      } else {
+        word = symbols_->Find(col[1 + index]);
+        if (word == -1) { // fst::kNoSymbol
+          switch (options_.oov_handling) {
+            case ArpaParseOptions::kReplaceWithUnk:
+              word = options_.unk_symbol;
+              break;
+            case ArpaParseOptions::kSkipNGram:
+              *message = col[1 + index];
+              return kNGramSkipped;
+            default:
+              *message = "word '" + col[1 + index] + "' not in symbol table";
+              return kNGramError;
+          }
+        }
+      }
+    } else {
+      // Symbols not provided, LM file should contain integers.
+      if (!ConvertStringToInteger(col[1 + index], &word) || word < 0) {
+        *message = "invalid symbol '" + col[1 + index] + "'";
+        return kNGramError;
+      }
+    }
+    // Whichever way we got it, an epsilon is invalid.
+    if (word == 0) {
+      *message = "epsilon symbol '" + col[1 + index] +
+          "' is illegal in ARPA LM";
+      return kNGramError;
+    }
+    ngram->words[index] = word;
+  }
+  return kNGramOk;
+}
+
+void ArpaFileParser::ProcessNGramLines(
+    int32 order, std::vector<std::string> *lines,
+    const std::vector<int32> &line_numbers) {
+  int32 num_lines = lines->size();
+  std::vector<NGram> ngrams(num_lines);
+  std::vector<LineStatus> status(num_lines);
+  std::vector<std::string> messages(num_lines);
+
+  // Adding words to the symbol table has to be done in file order.
+  int32 num_threads = std::min(options_.num_threads, num_lines);
+  if (symbols_ != NULL &&
+      options_.oov_handling == ArpaParseOptions::kAddToSymbols)
+    num_threads = 1;
+  if (num_threads <= 1) {
+    for (int32 i = 0; i < num_lines; i++)
+      status[i] = ParseNGramLine((*lines)[i], order, &(ngrams[i]),
+                                 &(messages[i]));
+  } else {
+    // ParseNGramLine() does not throw, so the threads need no error handling.
+    std::vector<std::thread> threads;
+    for (int32 t = 0; t < num_threads; t++) {
+      threads.push_back(std::thread([&, t]() {
+            for (int32 i = t; i < num_lines; i += num_threads)
+              status[i] = ParseNGramLine((*lines)[i], order, &(ngrams[i]),
+                                         &(messages[i]));
+          }));
+    }
+    for (int32 t = 0; t < num_threads; t++)
+      threads[t].join();
+  }
+
+  // Errors, warnings and the n-grams themselves go out in file order.
+  for (int32 i = 0; i < num_lines; i++) {
+    line_number_ = line_numbers[i];
+    current_line_.swap((*lines)[i]);
+    switch (status[i]) {
+      case kNGramError:
+        KALDI_ERR << LineReference() << ": " << messages[i];
+        break;
+      case kNGramSkipped:
+        if (ShouldWarn())
+          KALDI_WARN << LineReference() << " skipped: word '"
+                     << messages[i] << "' not in symbol table";
+        break;
+      default:
+        ConsumeNGram(ngrams[i]);
+    }
+  }
+}
+
 std::string ArpaFileParser::LineReference() const {
   std::stringstream ss;
   ss << "line " << line_number_ << " [" << current_line_ << "]";
@@ -44,15 +44,20 @@ struct ArpaParseOptions {
 
   ArpaParseOptions():
       bos_symbol(-1), eos_symbol(-1), unk_symbol(-1),
-      oov_handling(kRaiseError), max_warnings(30) { }
+      oov_handling(kRaiseError), max_warnings(30), num_threads(1) { }
 
   void Register(OptionsItf *opts) {
-    // Registering only the max_warnings count, since other options are
-    // treated differently by client programs: some want integer symbols,
-    // while other are passed words in their command line.
+    // Registering only the max_warnings count and the number of threads,
+    // since other options are treated differently by client programs: some
+    // want integer symbols, while other are passed words in their command
+    // line.
     opts->Register("max-arpa-warnings", &max_warnings,
                    "Maximum warnings to report on ARPA parsing, "
                    "0 to disable, -1 to show all");
+    opts->Register("arpa-parse-threads", &num_threads,
+                   "Number of threads used to parse the n-gram lines of the "
+                   "ARPA file.  The n-grams are still consumed in file "
+                   "order, so the output does not depend on it.");
   }
 
   int32 bos_symbol;  ///< Symbol for <s>, Required non-epsilon.
@@ -60,6 +65,8 @@ struct ArpaParseOptions {
   int32 unk_symbol;  ///< Symbol for <unk>, Required for kReplaceWithUnk.
   OovHandling oov_handling;  ///< How to handle OOV words in the file.
   int32 max_warnings;  ///< Maximum warnings to report, <0 unlimited.
+  int32 num_threads;  ///< Threads to parse n-gram lines with; not used
+                      ///< with kAddToSymbols.
 };
 
 /**
@@ -133,6 +140,23 @@ class ArpaFileParser {
   const std::vector<int32>& NgramCounts() const { return ngram_counts_; }
 
  private:
+  enum LineStatus { kNGramOk, kNGramSkipped, kNGramError };
+
+  // Parses 'line' from the section of 'order'-grams into *ngram.  If the
+  // n-gram is to be skipped because of an OOV word, sets *message to the word
+  // and returns kNGramSkipped; on error, sets *message to what is wrong and
+  // returns kNGramError.  Other than with kAddToSymbols, it changes nothing in
+  // the parser, so it may be called from several threads at once.
+  LineStatus ParseNGramLine(const std::string &line, int32 order,
+                            NGram *ngram, std::string *message);
+
+  // Parses the n-gram lines 'lines' of the section of 'order'-grams, which
+  // have line numbers 'line_numbers', on up to options_.num_threads threads,
+  // and then reports errors and calls ConsumeNGram() in file order.  Leaves
+  // 'lines' in an unspecified state.
+  void ProcessNGramLines(int32 order, std::vector<std::string> *lines,
+                         const std::vector<int32> &line_numbers);
+
   ArpaParseOptions options_;
   fst::SymbolTable* symbols_;  // the pointer is not owned here.
   int32 line_number_;
@@ -216,6 +216,30 @@ bool ThrowsExceptionTest(bool seps, const string &infile) {
 
 }  // namespace kaldi
 
+// Check that the n-gram lines parsed on several threads give the same FST.
+bool ThreadedParsingTest(bool seps, const string &infile) {
+  std::unique_ptr<ArpaLmCompiler> lm_compiler(Compile(seps, infile));
+  // Now that the symbol table holds all the words, compile it again without
+  // adding to it.
+  fst::SymbolTable symbols(*lm_compiler->Fst().InputSymbols());
+  ArpaParseOptions options;
+  options.bos_symbol = kBos;
+  options.eos_symbol = kEos;
+  options.oov_handling = ArpaParseOptions::kRaiseError;
+  options.num_threads = 3;
+  ArpaLmCompiler threaded_compiler(options, seps ? kDisambig : 0, &symbols);
+  {
+    Input ki(infile);
+    threaded_compiler.Read(ki.Stream());
+  }
+  if (!fst::Equal(lm_compiler->Fst(), threaded_compiler.Fst())) {
+    KALDI_WARN << "Compiling " << infile << " on several threads gave a "
+               << "different FST.";
+    return false;
+  }
+  return true;
+}
+
 bool RunAllTests(bool seps) {
   bool ok = true;
   ok &= kaldi::CoverageTest(seps, "test_data/missing_backoffs.arpa");
@@ -227,6 +251,9 @@ bool RunAllTests(bool seps) {
 
   ok &= kaldi::ThrowsExceptionTest(seps, "test_data/missing_bos.arpa");
 
+  ok &= kaldi::ThreadedParsingTest(seps, "test_data/input.arpa");
+  ok &= kaldi::ThreadedParsingTest(seps, "test_data/unused_backoffs.arpa");
+
   if (!ok) {
     KALDI_WARN << "Tests " << (seps ? "with" : "without")
                << " epsilon substitution FAILED";
@@ -510,9 +510,13 @@ void ConstArpaLm::Write(std::ostream &os, bool binary) const {
   WriteBasicType(os, binary, ngram_order_);
   WriteToken(os, binary, "</LmInfo>");
 
-  // LmStates section.
-  WriteToken(os, binary, "<LmStates>");
-  WriteBasicType(os, binary, lm_states_size_);
+  // LmStates section. We pad the stream so that the <lm_states_> array starts
+  // at a page-aligned offset, which lets Map() use it in place.
+  std::ostringstream lm_states_header;
+  WriteToken(lm_states_header, binary, "<LmStates>");
+  WriteBasicType(lm_states_header, binary, lm_states_size_);
+  WriteMmapPadding(os, lm_states_header.str().size());
+  os << lm_states_header.str();
   os.write(reinterpret_cast<char *>(lm_states_),
            sizeof(int32) * lm_states_size_);
   if (!os.good()) {
@@ -584,6 +588,27 @@ void ConstArpaLm::Read(std::istream &is, bool binary) {
   }
 }
 
+void ConstArpaLm::Map(const std::string &filename) {
+  KALDI_ASSERT(!initialized_);
+  mapped_file_.Open(filename);
+  bool binary;
+  Input ki(filename, &binary);
+  if (!binary) {
+    KALDI_ERR << "text-mode reading is not implemented for ConstArpaLm.";
+  }
+  std::istream &is = ki.Stream();
+  if (is.peek() == 4) {
+    // The old on-disk format stores <lm_states_> element by element, so it
+    // cannot be mapped.
+    KALDI_WARN << "ConstArpaLm in " << filename << " is in the old on-disk "
+               << "format and cannot be mapped; reading it instead.";
+    mapped_file_.Close();
+    ReadInternalOldFormat(is, binary);
+  } else {
+    ReadInternal(is, binary);
+  }
+}
+
 void ConstArpaLm::ReadInternal(std::istream &is, bool binary) {
   KALDI_ASSERT(!initialized_);
   if (!binary) {
@@ -600,12 +625,32 @@ void ConstArpaLm::ReadInternal(std::istream &is, bool binary) {
   ReadBasicType(is, binary, &ngram_order_);
   ExpectToken(is, binary, "</LmInfo>");
 
-  // LmStates section.
+  // LmStates section. Files written by older versions of the code have no
+  // padding.
+  ReadMmapPadding(is);
   ExpectToken(is, binary, "<LmStates>");
   ReadBasicType(is, binary, &lm_states_size_);
-  lm_states_ = new int32[lm_states_size_];
-  is.read(reinterpret_cast<char *>(lm_states_),
-          sizeof(int32) * lm_states_size_);
+  std::streamoff lm_states_offset = is.tellg();
+  if (mapped_file_.IsOpen() &&
+      (lm_states_offset < 0 || lm_states_offset % sizeof(int32) != 0)) {
+    KALDI_WARN << "ConstArpaLm <LmStates> section is not aligned, so it "
+               << "cannot be mapped; reading it instead. Re-write the "
+               << "language model with this version of the code to fix this.";
+    mapped_file_.Close();
+  }
+  if (mapped_file_.IsOpen()) {
+    // We're called from Map(): use the array in place, and skip over it.
+    KALDI_ASSERT(lm_states_offset + sizeof(int32) * lm_states_size_ <=
+                 mapped_file_.Size());
+    lm_states_ = reinterpret_cast<int32*>(
+        const_cast<char*>(mapped_file_.Data() + lm_states_offset));
+    is.seekg(sizeof(int32) * lm_states_size_, std::ios_base::cur);
+  } else {
+    lm_states_ = reinterpret_cast<int32*>(lm_states_buffer_.Allocate(
+        sizeof(int32) * lm_states_size_, GetHugePageMode()));
+    is.read(reinterpret_cast<char *>(lm_states_),
+            sizeof(int32) * lm_states_size_);
+  }
   if (!is.good()) {
     KALDI_ERR << "ConstArpaLm <LmStates> section reading failed.";
   }
@@ -680,7 +725,8 @@ void ConstArpaLm::ReadInternalOldFormat(std::istream &is, bool binary) {
   int32 lm_states_size_int32;
   ReadBasicType(is, binary, &lm_states_size_int32);
   lm_states_size_ = static_cast<int64>(lm_states_size_int32);
-  lm_states_ = new int32[lm_states_size_];
+  lm_states_ = reinterpret_cast<int32*>(lm_states_buffer_.Allocate(
+      sizeof(int32) * lm_states_size_, GetHugePageMode()));
   for (int64 i = 0; i < lm_states_size_; ++i) {
     ReadBasicType(is, binary, &lm_states_[i]);
   }
@@ -761,23 +807,75 @@ float ConstArpaLm::GetNgramLogprob(const int32 word,
   // Maps possible out-of-vocabulary words to <unk>. If a word does not have a
   // corresponding LmState, we treat it as <unk>. We map it to <unk> if <unk> is
   // specified.
-  int32 mapped_word = word;
-  if (unk_symbol_ != -1) {
-    KALDI_ASSERT(mapped_word >= 0);
+  int32 mapped_word = MapWord(word);
+  for (int32 i = 0; i < mapped_hist.size(); ++i)
+    mapped_hist[i] = MapWord(mapped_hist[i]);
+
+  // Loops up n-gram probability.
+  return GetNgramLogprobRecurse(mapped_word, mapped_hist);
+}
+
+int32 ConstArpaLm::MapWord(const int32 word) const {
+  if (unk_symbol_ == -1)
+    return word;
+  KALDI_ASSERT(word >= 0);
+  if (word >= num_words_ || unigram_states_[word] == NULL)
+    return unk_symbol_;
+  return word;
+}
+
+void ConstArpaLm::GetHistoryStates(const std::vector<int32>& hist,
+                                   std::vector<const int32*>* states) const {
+  KALDI_ASSERT(initialized_);
+  std::vector<int32> mapped_hist;
+  size_t begin = (hist.size() >= ngram_order_ ?
+                  hist.size() - ngram_order_ + 1 : 0);
+  for (size_t i = begin; i < hist.size(); ++i)
+    mapped_hist.push_back(MapWord(hist[i]));
+  states->resize(mapped_hist.size());
+  for (size_t i = 0; i < mapped_hist.size(); ++i) {
+    std::vector<int32> suffix(mapped_hist.begin() + i, mapped_hist.end());
+    (*states)[i] = GetLmState(suffix);
+  }
+}
+
+float ConstArpaLm::GetNgramLogprob(
+    const int32 word, const std::vector<const int32*>& history_states) const {
+  KALDI_ASSERT(initialized_);
+  KALDI_ASSERT(history_states.size() + 1 <= ngram_order_);
+  int32 mapped_word = MapWord(word);
+
+  // Finds the longest history that has <mapped_word> as a child.
+  size_t num_states = history_states.size(), i = 0;
+  float logprob = 0.0;
+  for (; i < num_states; ++i) {
+    int32* state = const_cast<int32*>(history_states[i]);
+    int32 child_info;
+    if (state != NULL && GetChildInfo(mapped_word, state, &child_info)) {
+      int32* child_lm_state = NULL;
+      DecodeChildInfo(child_info, state, &child_lm_state, &logprob);
+      break;
+    }
+  }
+  if (i == num_states) {
+    // Unigram case; see GetNgramLogprobRecurse().
     if (mapped_word >= num_words_ || unigram_states_[mapped_word] == NULL) {
-      mapped_word = unk_symbol_;
+      logprob = std::numeric_limits<float>::min();
+    } else {
+      Int32AndFloat logprob_i(*unigram_states_[mapped_word]);
+      logprob = logprob_i.f;
     }
-    for (int32 i = 0; i < mapped_hist.size(); ++i) {
-      KALDI_ASSERT(mapped_hist[i] >= 0);
-      if (mapped_hist[i] >= num_words_ ||
-          unigram_states_[mapped_hist[i]] == NULL) {
-        mapped_hist[i] = unk_symbol_;
-      }
+  }
+  // Adds the backoff logprobs of the histories we backed off from, in the same
+  // order as GetNgramLogprobRecurse() does, so that the result is identical.
+  while (i > 0) {
+    --i;
+    if (history_states[i] != NULL) {
+      Int32AndFloat backoff_logprob_i(*(history_states[i] + 1));
+      logprob = backoff_logprob_i.f + logprob;
     }
   }
-
-  // Loops up n-gram probability.
-  return GetNgramLogprobRecurse(mapped_word, mapped_hist);
+  return logprob;
 }
 
 float ConstArpaLm::GetNgramLogprobRecurse(
@@ -864,7 +962,7 @@ bool ConstArpaLm::GetChildInfo(const int32 word,
   int32 start_index = 1;
   int32 end_index = num_children;
   while (start_index <= end_index) {
-    int32 mid_index = round((start_index + end_index) / 2);
+    int32 mid_index = (start_index + end_index) / 2;
     int32 mid_word = *(parent + 1 + 2 * mid_index);
     if (mid_word == word) {
       *child_info = *(parent + 2 + 2 * mid_index);
@@ -1014,16 +1112,34 @@ ConstArpaLmDeterministicFst::ConstArpaLmDeterministicFst(
     const ConstArpaLm& lm) : lm_(lm) {
   // Creates a history state for <s>.
   std::vector<Label> bos_state(1, lm_.BosSymbol());
-  state_to_wseq_.push_back(bos_state);
-  wseq_to_state_[bos_state] = 0;
-  start_state_ = 0;
+  start_state_ = FindOrAddState(bos_state);
+}
+
+ConstArpaLmDeterministicFst::StateId
+ConstArpaLmDeterministicFst::FindOrAddState(const std::vector<Label>& wseq) {
+  std::pair<const std::vector<Label>, StateId> wseq_state_pair(
+      wseq, static_cast<Label>(state_to_wseq_.size()));
+
+  // Attemps to insert the current <wseq_state_pair>. If the pair already exists
+  // then it returns false.
+  typedef MapType::iterator IterType;
+  std::pair<IterType, bool> result = wseq_to_state_.insert(wseq_state_pair);
+
+  // If the pair was just inserted, then also add it to <state_to_wseq_> and
+  // <state_to_history_states_>.
+  if (result.second == true) {
+    state_to_wseq_.push_back(wseq);
+    state_to_history_states_.resize(state_to_history_states_.size() + 1);
+    lm_.GetHistoryStates(wseq, &(state_to_history_states_.back()));
+  }
+  return result.first->second;
 }
 
 fst::StdArc::Weight ConstArpaLmDeterministicFst::Final(StateId s) {
   // At this point, we should have created the state.
   KALDI_ASSERT(static_cast<size_t>(s) < state_to_wseq_.size());
-  const std::vector<Label>& wseq = state_to_wseq_[s];
-  float logprob = lm_.GetNgramLogprob(lm_.EosSymbol(), wseq);
+  float logprob = lm_.GetNgramLogprob(lm_.EosSymbol(),
+                                      state_to_history_states_[s]);
   return Weight(-logprob);
 }
 
@@ -1031,41 +1147,44 @@ bool ConstArpaLmDeterministicFst::GetArc(StateId s,
                                          Label ilabel, fst::StdArc *oarc) {
   // At this point, we should have created the state.
   KALDI_ASSERT(static_cast<size_t>(s) < state_to_wseq_.size());
-  std::vector<Label> wseq = state_to_wseq_[s];
 
-  float logprob = lm_.GetNgramLogprob(ilabel, wseq);
-  if (logprob == std::numeric_limits<float>::min()) {
-    return false;
-  }
+  std::pair<StateId, Label> key(s, ilabel);
+  ArcMapType::const_iterator iter = arcs_.find(key);
+  StateId nextstate;
+  float logprob;
+  if (iter != arcs_.end()) {
+    nextstate = iter->second.first;
+    logprob = iter->second.second;
+  } else {
+    logprob = lm_.GetNgramLogprob(ilabel, state_to_history_states_[s]);
+    if (logprob == std::numeric_limits<float>::min()) {
+      return false;
+    }
 
-  // Locates the next state in ConstArpaLm. Note that OOV and backoff have been
-  // taken care of in ConstArpaLm.
-  wseq.push_back(ilabel);
-  while (wseq.size() >= lm_.NgramOrder()) {
-    // History state has at most lm_.NgramOrder() -1 words in the state.
-    wseq.erase(wseq.begin(), wseq.begin() + 1);
-  }
-  while (!lm_.HistoryStateExists(wseq)) {
-    KALDI_ASSERT(wseq.size() > 0);
-    wseq.erase(wseq.begin(), wseq.begin() + 1);
+    // Locates the next state in ConstArpaLm. Note that OOV and backoff have
+    // been taken care of in ConstArpaLm.
+    std::vector<Label> wseq = state_to_wseq_[s];
+    wseq.push_back(ilabel);
+    while (wseq.size() >= lm_.NgramOrder()) {
+      // History state has at most lm_.NgramOrder() -1 words in the state.
+      wseq.erase(wseq.begin(), wseq.begin() + 1);
+    }
+    while (!lm_.HistoryStateExists(wseq)) {
+      KALDI_ASSERT(wseq.size() > 0);
+      wseq.erase(wseq.begin(), wseq.begin() + 1);
+    }
+    nextstate = FindOrAddState(wseq);
+    // The same object may be used for many lattices, so we limit the memory
+    // used by the cached arcs.
+    if (arcs_.size() >= (1 << 20))
+      arcs_.clear();
+    arcs_[key] = std::pair<StateId, float>(nextstate, logprob);
   }
 
-  std::pair<const std::vector<Label>, StateId> wseq_state_pair(
-      wseq, static_cast<Label>(state_to_wseq_.size()));
-
-  // Attemps to insert the current <wseq_state_pair>. If the pair already exists
-  // then it returns false.
-  typedef MapType::iterator IterType;
-  std::pair<IterType, bool> result = wseq_to_state_.insert(wseq_state_pair);
-
-  // If the pair was just inserted, then also add it to <state_to_wseq_>.
-  if (result.second == true)
-    state_to_wseq_.push_back(wseq);
-
   // Creates the arc.
   oarc->ilabel = ilabel;
   oarc->olabel = ilabel;
-  oarc->nextstate = result.first->second;
+  oarc->nextstate = nextstate;
   oarc->weight = Weight(-logprob);
 
   return true;
@@ -27,6 +27,7 @@
 #include "fstext/deterministic-fst.h"
 #include "lm/arpa-file-parser.h"
 #include "util/common-utils.h"
+#include "util/kaldi-mmap.h"
 
 namespace kaldi {
 
@@ -248,7 +249,7 @@ class ConstArpaLm {
 
   ~ConstArpaLm() {
     if (memory_assigned_) {
-      delete[] lm_states_;
+      // <lm_states_> points into <mapped_file_> or <lm_states_buffer_>.
       delete[] unigram_states_;
       delete[] overflow_buffer_;
     }
@@ -258,6 +259,15 @@ class ConstArpaLm {
   // ReadInternalOldFormat() to do the actual reading.
   void Read(std::istream &is, bool binary);
 
+  // Like reading the language model from the file <filename>, except that the
+  // <lm_states_> array, which is nearly all of the model, is memory-mapped and
+  // used in place instead of being read. This makes loading nearly
+  // instantaneous, and processes that map the same file share the memory.
+  // <filename> must be a plain file (not a pipe) that contains only the
+  // ConstArpaLm. If the file was written by an older version of the code, which
+  // did not align the array, it is read normally instead.
+  void Map(const std::string &filename);
+
   // Writes the language model in ConstArpaLm format.
   void Write(std::ostream &os, bool binary) const;
 
@@ -269,6 +279,20 @@ class ConstArpaLm {
   // words to <unk>, if <unk> is defined, and then calls GetNgramLogprobRecurse.
   float GetNgramLogprob(const int32 word, const std::vector<int32>& hist) const;
 
+  // Sets (*states)[i] to the LmState of the history hist[i], hist[i + 1], ...,
+  // or NULL if there is none, after the history has been truncated to
+  // <ngram_order_> - 1 words and OOVs have been mapped to <unk> as in
+  // GetNgramLogprob(). The states stay valid as long as the language model.
+  void GetHistoryStates(const std::vector<int32>& hist,
+                        std::vector<const int32*>* states) const;
+
+  // Returns the same as GetNgramLogprob(word, hist), given the output of
+  // GetHistoryStates(hist). This is much faster when many words are looked up
+  // after the same history, as the LmStates of the history and of the
+  // histories it backs off to are not looked up again for each word.
+  float GetNgramLogprob(const int32 word,
+                        const std::vector<const int32*>& history_states) const;
+
   // Returns true if the history word sequence <hist> has successor, which means
   // <hist> will be a state in the FST format language model.
   bool HistoryStateExists(const std::vector<int32>& hist) const;
@@ -278,6 +302,29 @@ class ConstArpaLm {
   int32 UnkSymbol() const { return unk_symbol_; }
   int32 NgramOrder() const { return ngram_order_; }
 
+  // The following give raw access to the model, for code that keeps its own
+  // copy of it (e.g. on the GPU; see cudadecoder/cuda-const-arpa-lm.h).
+  // LmStates are identified by their index in <lm_states_>.
+  const int32* LmStates() const { return lm_states_; }
+  int64 LmStatesSize() const { return lm_states_size_; }
+  int32 NumWords() const { return num_words_; }
+  int32 OverflowBufferSize() const { return overflow_buffer_size_; }
+
+  // Returns the index of the LmState of the unigram <word>, or -1 if <word> is
+  // not in the language model.
+  int64 UnigramStateIndex(const int32 word) const {
+    KALDI_ASSERT(word >= 0 && word < num_words_);
+    return (unigram_states_[word] == NULL ? -1 :
+            unigram_states_[word] - lm_states_);
+  }
+
+  // Returns the index of the LmState that entry <i> of the overflow buffer
+  // points to.
+  int64 OverflowStateIndex(const int32 i) const {
+    KALDI_ASSERT(i >= 0 && i < overflow_buffer_size_);
+    return overflow_buffer_[i] - lm_states_;
+  }
+
  private:
   // Function that loads data from stream to the class.
   void ReadInternal(std::istream &is, bool binary);
@@ -288,6 +335,10 @@ class ConstArpaLm {
   // format, ReadInternal() will be called.
   void ReadInternalOldFormat(std::istream &is, bool binary);
 
+  // Maps <word> to <unk> if it is not in the language model and <unk> is
+  // defined.
+  int32 MapWord(const int32 word) const;
+
   // Loops up n-gram probability for given word sequence. Backoff is handled by
   // recursively calling this function.
   float GetNgramLogprobRecurse(const int32 word,
@@ -328,6 +379,13 @@ class ConstArpaLm {
   // Makes sure that the language model has been loaded before using it.
   bool initialized_;
 
+  // If Map() was called, this holds the mapping of the file.
+  MappedFile mapped_file_;
+
+  // Otherwise, if Read() was called, this holds <lm_states_>, in huge pages if
+  // they were requested (see GetHugePageMode()).
+  HugePageBuffer lm_states_buffer_;
+
   // Integer corresponds to <s>.
   int32 bos_symbol_;
 
@@ -381,6 +439,8 @@ class ConstArpaLm {
   // bytes, therefore one LmState will occupy the following number of bytes:
   //
   // x = 1 + 1 + 1 + 2 * children.size() = 3 + 2 * children.size()
+  //
+  // If Map() was called, this points into the mapped file, which is read-only.
   int32* lm_states_;
 };
 
@@ -410,9 +470,21 @@ class ConstArpaLmDeterministicFst
  private:
   typedef unordered_map<std::vector<Label>,
                         StateId, VectorHasher<Label> > MapType;
+  typedef unordered_map<std::pair<StateId, Label>,
+                        std::pair<StateId, float>,
+                        PairHasher<int32> > ArcMapType;
+
+  // Adds a state for the history <wseq> if there is none, and returns it.
+  StateId FindOrAddState(const std::vector<Label>& wseq);
+
   StateId start_state_;
   MapType wseq_to_state_;
   std::vector<std::vector<Label> > state_to_wseq_;
+  // The output of lm_.GetHistoryStates() for each state.
+  std::vector<std::vector<const int32*> > state_to_history_states_;
+  // The arcs found so far: (state, word) -> (next state, logprob). Lattices
+  // ask for the same arc many times.
+  ArcMapType arcs_;
   const ConstArpaLm& lm_;
 };
 
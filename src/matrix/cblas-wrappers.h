@@ -253,6 +253,45 @@ inline void cblas_Xgemm(const double alpha,
 }
 
 
+#ifdef HAVE_MKL
+// Does 'batch_size' matrix multiplications of the same dimensions, as in
+// cblas_Xgemm(); m, n and k are the dimensions as in BLAS, i.e. the rows and
+// columns of the outputs and the inner dimension.
+inline void cblas_Xgemm_batch(MatrixTransposeType transA,
+                              MatrixTransposeType transB,
+                              MatrixIndexT m, MatrixIndexT n, MatrixIndexT k,
+                              const float alpha, const float **a_array,
+                              MatrixIndexT a_stride, const float **b_array,
+                              MatrixIndexT b_stride, const float beta,
+                              float **c_array, MatrixIndexT c_stride,
+                              MatrixIndexT batch_size) {
+  CBLAS_TRANSPOSE trans_a = static_cast<CBLAS_TRANSPOSE>(transA),
+      trans_b = static_cast<CBLAS_TRANSPOSE>(transB);
+  MKL_INT m_mkl = m, n_mkl = n, k_mkl = k, lda = a_stride, ldb = b_stride,
+      ldc = c_stride, group_size = batch_size;
+  cblas_sgemm_batch(CblasRowMajor, &trans_a, &trans_b, &m_mkl, &n_mkl, &k_mkl,
+                    &alpha, a_array, &lda, b_array, &ldb, &beta, c_array, &ldc,
+                    1, &group_size);
+}
+inline void cblas_Xgemm_batch(MatrixTransposeType transA,
+                              MatrixTransposeType transB,
+                              MatrixIndexT m, MatrixIndexT n, MatrixIndexT k,
+                              const double alpha, const double **a_array,
+                              MatrixIndexT a_stride, const double **b_array,
+                              MatrixIndexT b_stride, const double beta,
+                              double **c_array, MatrixIndexT c_stride,
+                              MatrixIndexT batch_size) {
+  CBLAS_TRANSPOSE trans_a = static_cast<CBLAS_TRANSPOSE>(transA),
+      trans_b = static_cast<CBLAS_TRANSPOSE>(transB);
+  MKL_INT m_mkl = m, n_mkl = n, k_mkl = k, lda = a_stride, ldb = b_stride,
+      ldc = c_stride, group_size = batch_size;
+  cblas_dgemm_batch(CblasRowMajor, &trans_a, &trans_b, &m_mkl, &n_mkl, &k_mkl,
+                    &alpha, a_array, &lda, b_array, &ldb, &beta, c_array, &ldc,
+                    1, &group_size);
+}
+#endif
+
+
 inline void cblas_Xsymm(const float alpha,
                         MatrixIndexT sz,
                         const float *Adata,MatrixIndexT a_stride,
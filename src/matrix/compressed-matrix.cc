@@ -20,10 +20,44 @@
 // limitations under the License.
 
 #include "matrix/compressed-matrix.h"
+#include "matrix/simd-math.h"
 #include <algorithm>
 
 namespace kaldi {
 
+// The SIMD functions that we use for the formats kOneByte and kTwoByte work
+// on float; these help to use them for double too.
+
+// Returns 'row' as float, converting it into 'buf' if needed.
+static inline const float *RowAsFloat(const float *row, int32 dim,
+                                      std::vector<float> *buf) {
+  return row;
+}
+static inline const float *RowAsFloat(const double *row, int32 dim,
+                                      std::vector<float> *buf) {
+  buf->resize(dim);
+  std::copy(row, row + dim, buf->begin());
+  return &((*buf)[0]);
+}
+
+// Returns where to write a float row that will end up in 'row'; call
+// FinishFloatRow() after writing it.
+static inline float *FloatRowFor(float *row, int32 dim,
+                                 std::vector<float> *buf) {
+  return row;
+}
+static inline float *FloatRowFor(double *row, int32 dim,
+                                 std::vector<float> *buf) {
+  buf->resize(dim);
+  return &((*buf)[0]);
+}
+static inline void FinishFloatRow(const std::vector<float> &buf, float *row) {
+}
+static inline void FinishFloatRow(const std::vector<float> &buf,
+                                  double *row) {
+  std::copy(buf.begin(), buf.end(), row);
+}
+
 //static
 MatrixIndexT CompressedMatrix::DataSize(const GlobalHeader &header) {
   // Returns size in bytes of the data.
@@ -41,6 +75,11 @@ MatrixIndexT CompressedMatrix::DataSize(const GlobalHeader &header) {
   }
 }
 
+MatrixIndexT CompressedMatrix::NumBytes() const {
+  return (data_ == NULL ? 0 :
+          DataSize(*reinterpret_cast<const GlobalHeader*>(data_)));
+}
+
 // scale all element of matrix by scaling floats
 // in GlobalHeader with alpha.
 void CompressedMatrix::Scale(float alpha) {
@@ -152,11 +191,16 @@ void CompressedMatrix::CopyFromMat(
     uint8 *byte_data =
         reinterpret_cast<uint8*>(header_data + global_header.num_cols);
 
-    const Real *matrix_data = mat.Data();
+    // We compress the transpose, whose rows are the columns of 'mat', so
+    // that we access them contiguously.  Converting double to float first
+    // doesn't change the result, as the values are converted to float anyway.
+    Matrix<float> mat_trans(global_header.num_cols, global_header.num_rows,
+                            kUndefined);
+    mat_trans.CopyFromMat(mat, kTrans);
 
     for (int32 col = 0; col < global_header.num_cols; col++) {
       CompressColumn(global_header,
-                     matrix_data + col, mat.Stride(),
+                     mat_trans.RowData(col), 1,
                      global_header.num_rows,
                      header_data, byte_data);
       header_data++;
@@ -166,10 +210,12 @@ void CompressedMatrix::CopyFromMat(
     uint16 *data = reinterpret_cast<uint16*>(static_cast<char*>(data_) +
                                              sizeof(GlobalHeader));
     int32 num_rows = mat.NumRows(), num_cols = mat.NumCols();
+    std::vector<float> buf;
     for (int32 r = 0; r < num_rows; r++) {
-      const Real *row_data = mat.RowData(r);
-      for (int32 c = 0; c < num_cols; c++)
-        data[c] = FloatToUint16(global_header, row_data[c]);
+      // Does the same as FloatToUint16().
+      FloatToUint16Vec(RowAsFloat(mat.RowData(r), num_cols, &buf),
+                       global_header.min_value, global_header.range,
+                       num_cols, data);
       data += num_cols;
     }
   } else {
@@ -177,10 +223,12 @@ void CompressedMatrix::CopyFromMat(
     uint8 *data = reinterpret_cast<uint8*>(static_cast<char*>(data_) +
                                            sizeof(GlobalHeader));
     int32 num_rows = mat.NumRows(), num_cols = mat.NumCols();
+    std::vector<float> buf;
     for (int32 r = 0; r < num_rows; r++) {
-      const Real *row_data = mat.RowData(r);
-      for (int32 c = 0; c < num_cols; c++)
-        data[c] = FloatToUint8(global_header, row_data[c]);
+      // Does the same as FloatToUint8().
+      FloatToUint8Vec(RowAsFloat(mat.RowData(r), num_cols, &buf),
+                      global_header.min_value, global_header.range,
+                      num_cols, data);
       data += num_cols;
     }
   }
@@ -635,24 +683,29 @@ void CompressedMatrix::CopyToMat(MatrixBase<Real> *mat,
     PerColHeader *per_col_header = reinterpret_cast<PerColHeader*>(h+1);
     uint8 *byte_data = reinterpret_cast<uint8*>(per_col_header +
                                                 h->num_cols);
+    // We decompress the columns into the rows of the transpose, and then
+    // transpose that, which is faster than writing the columns of 'mat'.
+    Matrix<float> mat_trans(num_cols, num_rows, kUndefined);
     for (int32 i = 0; i < num_cols; i++, per_col_header++) {
       float p0 = Uint16ToFloat(*h, per_col_header->percentile_0),
           p25 = Uint16ToFloat(*h, per_col_header->percentile_25),
           p75 = Uint16ToFloat(*h, per_col_header->percentile_75),
           p100 = Uint16ToFloat(*h, per_col_header->percentile_100);
-      for (int32 j = 0; j < num_rows; j++, byte_data++) {
-        float f = CharToFloat(p0, p25, p75, p100, *byte_data);
-        (*mat)(j, i) = f;
-      }
+      float *col_data = mat_trans.RowData(i);
+      for (int32 j = 0; j < num_rows; j++, byte_data++)
+        col_data[j] = CharToFloat(p0, p25, p75, p100, *byte_data);
     }
+    mat->CopyFromMat(mat_trans, kTrans);
   } else if (format == kTwoByte) {
     const uint16 *data = reinterpret_cast<const uint16*>(h + 1);
     float min_value = h->min_value,
         increment = h->range * (1.0 / 65535.0);
+    std::vector<float> buf;
     for (int32 i = 0; i < num_rows; i++) {
       Real *row_data = mat->RowData(i);
-      for (int32 j = 0; j < num_cols; j++)
-        row_data[j] = min_value + data[j] * increment;
+      Uint16ToFloatVec(data, min_value, increment, num_cols,
+                       FloatRowFor(row_data, num_cols, &buf));
+      FinishFloatRow(buf, row_data);
       data += num_cols;
     }
   } else {
@@ -660,10 +713,12 @@ void CompressedMatrix::CopyToMat(MatrixBase<Real> *mat,
     float min_value = h->min_value, increment = h->range * (1.0 / 255.0);
 
     const uint8 *data = reinterpret_cast<const uint8*>(h + 1);
+    std::vector<float> buf;
     for (int32 i = 0; i < num_rows; i++) {
       Real *row_data = mat->RowData(i);
-      for (int32 j = 0; j < num_cols; j++)
-        row_data[j] = min_value + data[j] * increment;
+      Uint8ToFloatVec(data, min_value, increment, num_cols,
+                      FloatRowFor(row_data, num_cols, &buf));
+      FinishFloatRow(buf, row_data);
       data += num_cols;
     }
   }
@@ -706,8 +761,10 @@ void CompressedMatrix::CopyRowToVec(MatrixIndexT row,
         increment = h->range * (1.0 / 65535.0);
     const uint16 *row_data = reinterpret_cast<uint16*>(h + 1) + (num_cols * row);
     Real *v_data = v->Data();
-    for (int32 c = 0; c < num_cols; c++)
-      v_data[c] = min_value + row_data[c] * increment;
+    std::vector<float> buf;
+    Uint16ToFloatVec(row_data, min_value, increment, num_cols,
+                     FloatRowFor(v_data, num_cols, &buf));
+    FinishFloatRow(buf, v_data);
   } else {
     KALDI_ASSERT(format == kOneByte);
     int32 num_cols = h->num_cols;
@@ -715,8 +772,10 @@ void CompressedMatrix::CopyRowToVec(MatrixIndexT row,
         increment = h->range * (1.0 / 255.0);
     const uint8 *row_data = reinterpret_cast<uint8*>(h + 1) + (num_cols * row);
     Real *v_data = v->Data();
-    for (int32 c = 0; c < num_cols; c++)
-      v_data[c] = min_value + row_data[c] * increment;
+    std::vector<float> buf;
+    Uint8ToFloatVec(row_data, min_value, increment, num_cols,
+                    FloatRowFor(v_data, num_cols, &buf));
+    FinishFloatRow(buf, v_data);
   }
 }
 
@@ -820,10 +879,12 @@ void CompressedMatrix::CopyToMat(int32 row_offset,
     float min_value = h->min_value,
         increment = h->range * (1.0 / 65535.0);
 
+    std::vector<float> buf;
     for (int32 row = 0; row < tgt_rows; row++) {
       Real *dest_row = dest->RowData(row);
-      for (int32 col = 0; col < tgt_cols; col++)
-        dest_row[col] = min_value + increment * data[col];
+      Uint16ToFloatVec(data, min_value, increment, tgt_cols,
+                       FloatRowFor(dest_row, tgt_cols, &buf));
+      FinishFloatRow(buf, dest_row);
       data += num_cols;
     }
   } else {
@@ -832,10 +893,12 @@ void CompressedMatrix::CopyToMat(int32 row_offset,
         (num_cols * row_offset);
     float min_value = h->min_value,
         increment = h->range * (1.0 / 255.0);
+    std::vector<float> buf;
     for (int32 row = 0; row < tgt_rows; row++) {
       Real *dest_row = dest->RowData(row);
-      for (int32 col = 0; col < tgt_cols; col++)
-        dest_row[col] = min_value + increment * data[col];
+      Uint8ToFloatVec(data, min_value, increment, tgt_cols,
+                      FloatRowFor(dest_row, tgt_cols, &buf));
+      FinishFloatRow(buf, dest_row);
       data += num_cols;
     }
   }
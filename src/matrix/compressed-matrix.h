@@ -120,6 +120,12 @@ class CompressedMatrix {
 
   void *Data() const { return this->data_; }
 
+  /// Returns the size in bytes of the data that Data() points to (zero for an
+  /// empty matrix).  The data is self-contained, so it can be copied as it is,
+  /// e.g. to a GPU to be decompressed there (see
+  /// CuMatrixBase::CopyFromGeneralMat()).
+  MatrixIndexT NumBytes() const;
+
   /// This will resize *this and copy the contents of mat to *this.
   template<typename Real>
   void CopyFromMat(const MatrixBase<Real> &mat,
@@ -28,6 +28,9 @@
 #include "matrix/jama-eig.h"
 #include "matrix/compressed-matrix.h"
 #include "matrix/sparse-matrix.h"
+#include "matrix/simd-math.h"
+#include "matrix/matrix-stats.h"
+#include "matrix/param-blob.h"
 
 static_assert(int(kaldi::kNoTrans) == int(CblasNoTrans) && int(kaldi::kTrans) == int(CblasTrans), 
     "kaldi::kNoTrans and kaldi::kTrans must be equal to the appropriate CBLAS library constants!");
@@ -185,6 +188,74 @@ void MatrixBase<Real>::AddMatMat(const Real alpha,
 
 }
 
+template<typename Real>
+void AddMatMatBatched(const Real alpha,
+                      const std::vector<MatrixBase<Real>* > &C,
+                      const std::vector<const MatrixBase<Real>* > &A,
+                      MatrixTransposeType transA,
+                      const std::vector<const MatrixBase<Real>* > &B,
+                      MatrixTransposeType transB,
+                      const Real beta) {
+  KALDI_ASSERT(A.size() == B.size() && B.size() == C.size());
+  int32 size = C.size();
+  if (size == 0)
+    return;
+  for (int32 i = 1; i < size; i++) {
+    KALDI_ASSERT(A[i]->NumRows() == A[0]->NumRows() &&
+                 A[i]->NumCols() == A[0]->NumCols() &&
+                 A[i]->Stride() == A[0]->Stride() &&
+                 B[i]->NumRows() == B[0]->NumRows() &&
+                 B[i]->NumCols() == B[0]->NumCols() &&
+                 B[i]->Stride() == B[0]->Stride() &&
+                 C[i]->NumRows() == C[0]->NumRows() &&
+                 C[i]->NumCols() == C[0]->NumCols() &&
+                 C[i]->Stride() == C[0]->Stride());
+  }
+#ifdef HAVE_MKL
+  if (size > 1 && C[0]->NumRows() != 0 && C[0]->NumCols() != 0) {
+    MatrixIndexT k = (transA == kNoTrans ? A[0]->NumCols() : A[0]->NumRows());
+    KALDI_ASSERT(k == (transB == kNoTrans ? B[0]->NumRows() :
+                       B[0]->NumCols()) &&
+                 C[0]->NumRows() == (transA == kNoTrans ? A[0]->NumRows() :
+                                     A[0]->NumCols()) &&
+                 C[0]->NumCols() == (transB == kNoTrans ? B[0]->NumCols() :
+                                     B[0]->NumRows()));
+    std::vector<const Real*> a_array(size), b_array(size);
+    std::vector<Real*> c_array(size);
+    for (int32 i = 0; i < size; i++) {
+      KALDI_ASSERT(A[i] != C[i] && B[i] != C[i]);
+      a_array[i] = A[i]->Data();
+      b_array[i] = B[i]->Data();
+      c_array[i] = C[i]->Data();
+    }
+    cblas_Xgemm_batch(transA, transB, C[0]->NumRows(), C[0]->NumCols(), k,
+                      alpha, &(a_array[0]), A[0]->Stride(), &(b_array[0]),
+                      B[0]->Stride(), beta, &(c_array[0]), C[0]->Stride(),
+                      size);
+    return;
+  }
+#endif
+  for (int32 i = 0; i < size; i++)
+    C[i]->AddMatMat(alpha, *(A[i]), transA, *(B[i]), transB, beta);
+}
+
+template
+void AddMatMatBatched(const float alpha,
+                      const std::vector<MatrixBase<float>* > &C,
+                      const std::vector<const MatrixBase<float>* > &A,
+                      MatrixTransposeType transA,
+                      const std::vector<const MatrixBase<float>* > &B,
+                      MatrixTransposeType transB,
+                      const float beta);
+template
+void AddMatMatBatched(const double alpha,
+                      const std::vector<MatrixBase<double>* > &C,
+                      const std::vector<const MatrixBase<double>* > &A,
+                      MatrixTransposeType transA,
+                      const std::vector<const MatrixBase<double>* > &B,
+                      MatrixTransposeType transB,
+                      const double beta);
+
 template<typename Real>
 void MatrixBase<Real>::SetMatMatDivMat(const MatrixBase<Real>& A,
                                        const MatrixBase<Real>& B,
@@ -857,6 +928,30 @@ void Matrix<Real>::Resize(const MatrixIndexT rows,
   if (resize_type == kSetZero) MatrixBase<Real>::SetZero();
 }
 
+// Helper for CopyFromMat() with kTrans: sets 'out' to the transpose of the
+// num_rows by num_cols matrix 'in'.  When the types are the same we use the
+// (SIMD, cache-blocked) TransposeMat().
+template<typename Real, typename OtherReal>
+static void CopyTransposed(const OtherReal *in, MatrixIndexT in_stride,
+                           MatrixIndexT num_rows, MatrixIndexT num_cols,
+                           Real *out, MatrixIndexT out_stride) {
+  for (MatrixIndexT i = 0; i < num_cols; i++)
+    for (MatrixIndexT j = 0; j < num_rows; j++)
+      out[i * out_stride + j] = in[j * in_stride + i];
+}
+
+static void CopyTransposed(const float *in, MatrixIndexT in_stride,
+                           MatrixIndexT num_rows, MatrixIndexT num_cols,
+                           float *out, MatrixIndexT out_stride) {
+  TransposeMat(in, in_stride, num_rows, num_cols, out, out_stride);
+}
+
+static void CopyTransposed(const double *in, MatrixIndexT in_stride,
+                           MatrixIndexT num_rows, MatrixIndexT num_cols,
+                           double *out, MatrixIndexT out_stride) {
+  TransposeMat(in, in_stride, num_rows, num_cols, out, out_stride);
+}
+
 template<typename Real>
 template<typename OtherReal>
 void MatrixBase<Real>::CopyFromMat(const MatrixBase<OtherReal> &M,
@@ -875,12 +970,8 @@ void MatrixBase<Real>::CopyFromMat(const MatrixBase<OtherReal> &M,
       (*this).Row(i).CopyFromVec(M.Row(i));
   } else {
     KALDI_ASSERT(num_cols_ == M.NumRows() && num_rows_ == M.NumCols());
-    int32 this_stride = stride_, other_stride = M.Stride();
-    Real *this_data = data_;
-    const OtherReal *other_data = M.Data();
-    for (MatrixIndexT i = 0; i < num_rows_; i++)
-      for (MatrixIndexT j = 0; j < num_cols_; j++)
-        this_data[i * this_stride + j] = other_data[j * other_stride + i];
+    CopyTransposed(M.Data(), M.Stride(), M.NumRows(), M.NumCols(),
+                   data_, stride_);
   }
 }
 
@@ -1141,12 +1232,12 @@ void MatrixBase<Real>::MulElements(const MatrixBase<Real> &a) {
   KALDI_ASSERT(a.NumRows() == num_rows_ && a.NumCols() == num_cols_);
 
   if (num_cols_ == stride_ && num_cols_ == a.stride_) {
-    mul_elements(num_rows_ * num_cols_, a.data_, data_);
+    MulElementsVec(a.data_, num_rows_ * num_cols_, data_);
   } else {
     MatrixIndexT a_stride = a.stride_, stride = stride_;
     Real *data = data_, *a_data = a.data_;
     for (MatrixIndexT i = 0; i < num_rows_; i++) {
-      mul_elements(num_cols_, a_data, data);
+      MulElementsVec(a_data, num_cols_, data);
       a_data += a_stride;
       data += stride;
     }
@@ -1318,12 +1409,8 @@ void MatrixBase<Real>::GroupMaxDeriv(const MatrixBase<Real> &input,
 template<typename Real>  // scales each column by scale[i].
 void MatrixBase<Real>::MulColsVec(const VectorBase<Real> &scale) {
   KALDI_ASSERT(scale.Dim() == num_cols_);
-  for (MatrixIndexT i = 0; i < num_rows_; i++) {
-    for (MatrixIndexT j = 0; j < num_cols_; j++) {
-      Real this_scale = scale(j);
-      (*this)(i, j) *= this_scale;
-    }
-  }
+  for (MatrixIndexT i = 0; i < num_rows_; i++)
+    MulElementsVec(scale.Data(), num_cols_, data_ + i * stride_);
 }
 
 template<typename Real>
@@ -1382,6 +1469,11 @@ void MatrixBase<Real>::Write(std::ostream &os, bool binary) const {
   }
   if (binary) {  // Use separate binary and text formats,
     // since in binary mode we need to know if it's float or double.
+    if (ParamBlob *blob = ParamBlob::CurrentWriteBlob()) {
+      // The data goes to the parameter blob; see matrix/param-blob.h.
+      blob->WriteMatrix(*this, os);
+      return;
+    }
     std::string my_token = (sizeof(Real) == 4 ? "FM" : "DM");
 
     WriteToken(os, binary, my_token);
@@ -1478,6 +1570,24 @@ void Matrix<Real>::Read(std::istream & is, bool binary, bool add) {
       compressed_mat.CopyToMat(this);
       return;
     }
+    if (peekval == 'B') {
+      // A reference to data in a parameter blob (see matrix/param-blob.h).
+      const ParamBlob *blob = ParamBlob::CurrentReadBlob();
+      if (blob == NULL)
+        KALDI_ERR << "Found a parameter-blob reference while reading a "
+                  << "matrix, but no parameter blob has been read";
+      blob->ReadMatrix(is, this);
+      return;
+    }
+    if (peekval == '<') {
+      // A matrix written with a header of its statistics (see
+      // matrix/matrix-stats.h), which we skip.
+      MatrixStats stats;
+      int64 data_size;
+      stats.ReadHeader(is, binary, &data_size);
+      this->Read(is, binary, false);
+      return;
+    }
     const char *my_token =  (sizeof(Real) == 4 ? "FM" : "DM");
     char other_token_start = (sizeof(Real) == 4 ? 'D' : 'F');
     if (peekval == other_token_start) {  // need to instantiate the other type to read it.
@@ -2119,8 +2229,7 @@ void MatrixBase<Real>::Exp(const MatrixBase<Real> &src) {
   const Real *src_row_data = src.Data();
   for (MatrixIndexT row = 0; row < num_rows;
        row++,row_data += stride_, src_row_data += src.stride_) {
-    for (MatrixIndexT col = 0; col < num_cols; col++)
-      row_data[col] = kaldi::Exp(src_row_data[col]);
+    ExpVec(src_row_data, 0.0, num_cols, row_data);
   }
 }
 
@@ -2163,10 +2272,8 @@ void MatrixBase<Real>::Floor(const MatrixBase<Real> &src, Real floor_val) {
   Real *row_data = data_;
   const Real *src_row_data = src.Data();
   for (MatrixIndexT row = 0; row < num_rows;
-       row++,row_data += stride_, src_row_data += src.stride_) {
-    for (MatrixIndexT col = 0; col < num_cols; col++)
-      row_data[col] = (src_row_data[col] < floor_val ? floor_val : src_row_data[col]);
-  }
+       row++,row_data += stride_, src_row_data += src.stride_)
+    FloorVec(src_row_data, floor_val, num_cols, row_data);
 }
 
 template<typename Real>
@@ -2190,8 +2297,7 @@ void MatrixBase<Real>::Log(const MatrixBase<Real> &src) {
   const Real *src_row_data = src.Data();
   for (MatrixIndexT row = 0; row < num_rows;
        row++,row_data += stride_, src_row_data += src.stride_) {
-    for (MatrixIndexT col = 0; col < num_cols; col++)
-      row_data[col] = kaldi::Log(src_row_data[col]);
+    LogVec(src_row_data, num_cols, row_data);
   }
 }
 
@@ -2737,13 +2843,8 @@ Real MatrixBase<Real>::LogSumExp(Real prune) const {
 
   double sum_relto_max_elem = 0.0;
 
-  for (MatrixIndexT i = 0; i < num_rows_; i++) {
-    for (MatrixIndexT j = 0; j < num_cols_; j++) {
-      BaseFloat f = (*this)(i, j);
-      if (f >= cutoff)
-        sum_relto_max_elem += kaldi::Exp(f - max_elem);
-    }
-  }
+  for (MatrixIndexT i = 0; i < num_rows_; i++)
+    sum_relto_max_elem += SumExpVec(RowData(i), -max_elem, cutoff, num_cols_);
   return max_elem + kaldi::Log(sum_relto_max_elem);
 }
 
@@ -2752,8 +2853,7 @@ Real MatrixBase<Real>::ApplySoftMax() {
   Real max = this->Max(), sum = 0.0;
   // the 'max' helps to get in good numeric range.
   for (MatrixIndexT i = 0; i < num_rows_; i++)
-    for (MatrixIndexT j = 0; j < num_cols_; j++)
-      sum += ((*this)(i, j) = kaldi::Exp((*this)(i, j) - max));
+    sum += ExpVec(RowData(i), -max, num_cols_, RowData(i));
   this->Scale(1.0 / sum);
   return max + kaldi::Log(sum);
 }
@@ -1068,6 +1068,20 @@ template<typename Real> void SortSvd(VectorBase<Real> *s, MatrixBase<Real> *U,
                                      MatrixBase<Real>* Vt = NULL,
                                      bool sort_on_absolute_value = true);
 
+/// Does multiple matrix multiplications: for each i, C[i] = alpha * A[i](^T) *
+/// B[i](^T) + beta * C[i].  All the A[i] must have the same dimensions and
+/// stride, and the same for the B[i] and the C[i].  If compiled with MKL this
+/// uses cblas_?gemm_batch(), which is faster than calling AddMatMat() for each
+/// i when the matrices are small; otherwise it just calls AddMatMat().
+template<typename Real>
+void AddMatMatBatched(const Real alpha,
+                      const std::vector<MatrixBase<Real>* > &C,
+                      const std::vector<const MatrixBase<Real>* > &A,
+                      MatrixTransposeType transA,
+                      const std::vector<const MatrixBase<Real>* > &B,
+                      MatrixTransposeType transB,
+                      const Real beta);
+
 /// Creates the eigenvalue matrix D that is part of the decomposition used Matrix::Eig.
 /// D will be block-diagonal with blocks of size 1 (for real eigenvalues) or 2x2
 /// for complex pairs.  If a complex pair is lambda +- i*mu, D will have a corresponding
@@ -29,7 +29,9 @@
 #include "matrix/kaldi-vector.h"
 #include "matrix/kaldi-matrix.h"
 #include "matrix/sp-matrix.h"
+#include "matrix/param-blob.h"
 #include "matrix/sparse-matrix.h"
+#include "matrix/simd-math.h"
 
 namespace kaldi {
 
@@ -679,11 +681,9 @@ void VectorBase<Real>::CopyDiagFromPacked(const PackedMatrix<Real> &M) {
 
 template<typename Real>
 Real VectorBase<Real>::Sum() const {
-  // Do a dot-product with a size-1 array with a stride of 0 to
-  // implement sum. This allows us to access SIMD operations in a
-  // cross-platform way via your BLAS library.
-  Real one(1);
-  return cblas_Xdot(dim_, data_, 1, &one, 0);
+  // This uses SIMD instructions if available; like the cblas_Xdot() trick it
+  // replaced, it accumulates in the precision of Real.
+  return SumVec(data_, dim_);
 }
 
 template<typename Real>
@@ -755,13 +755,7 @@ Real VectorBase<Real>::LogSumExp(Real prune) const {
   if (prune > 0.0 && max_elem - prune > cutoff) // explicit pruning...
     cutoff = max_elem - prune;
 
-  double sum_relto_max_elem = 0.0;
-
-  for (MatrixIndexT i = 0; i < dim_; i++) {
-    BaseFloat f = data_[i];
-    if (f >= cutoff)
-      sum_relto_max_elem += Exp(f - max_elem);
-  }
+  double sum_relto_max_elem = SumExpVec(data_, -max_elem, cutoff, dim_);
   return max_elem + Log(sum_relto_max_elem);
 }
 
@@ -777,23 +771,19 @@ void VectorBase<Real>::ApplyLog() {
   for (MatrixIndexT i = 0; i < dim_; i++) {
     if (data_[i] < 0.0)
       KALDI_ERR << "Trying to take log of a negative number.";
-    data_[i] = Log(data_[i]);
   }
+  LogVec(data_, dim_, data_);
 }
 
 template<typename Real>
 void VectorBase<Real>::ApplyLogAndCopy(const VectorBase<Real> &v) {
   KALDI_ASSERT(dim_ == v.Dim());
-  for (MatrixIndexT i = 0; i < dim_; i++) {
-    data_[i] = Log(v(i));
-  }
+  LogVec(v.data_, dim_, data_);
 }
 
 template<typename Real>
 void VectorBase<Real>::ApplyExp() {
-  for (MatrixIndexT i = 0; i < dim_; i++) {
-    data_[i] = Exp(data_[i]);
-  }
+  ExpVec(data_, 0.0, dim_, data_);
 }
 
 template<typename Real>
@@ -803,22 +793,10 @@ void VectorBase<Real>::ApplyAbs() {
 
 template<typename Real>
 void VectorBase<Real>::Floor(const VectorBase<Real> &v, Real floor_val, MatrixIndexT *floored_count) {
-  if (floored_count == nullptr) {
-    for (MatrixIndexT i = 0; i < dim_; i++) {
-      data_[i] = std::max(v.data_[i], floor_val);
-    }
-  } else {
-    MatrixIndexT num_floored = 0;
-    for (MatrixIndexT i = 0; i < dim_; i++) {
-      if (v.data_[i] < floor_val) {
-	data_[i] = floor_val;
-	num_floored++;
-      } else {
-	data_[i] = v.data_[i];
-      }
-    }
+  KALDI_ASSERT(dim_ == v.dim_);
+  MatrixIndexT num_floored = FloorVec(v.data_, floor_val, dim_, data_);
+  if (floored_count != nullptr)
     *floored_count = num_floored;
-  }
 }
 
 template<typename Real>
@@ -856,21 +834,17 @@ MatrixIndexT VectorBase<Real>::ApplyFloor(const VectorBase<Real> &floor_vec) {
 
 template<typename Real>
 Real VectorBase<Real>::ApplySoftMax() {
-  Real max = this->Max(), sum = 0.0;
-  for (MatrixIndexT i = 0; i < dim_; i++) {
-    sum += (data_[i] = Exp(data_[i] - max));
-  }
+  Real max = this->Max(), sum = ExpVec(data_, -max, dim_, data_);
   this->Scale(1.0 / sum);
   return max + Log(sum);
 }
 
 template<typename Real>
 Real VectorBase<Real>::ApplyLogSoftMax() {
-  Real max = this->Max(), sum = 0.0;
-  for (MatrixIndexT i = 0; i < dim_; i++) {
-    sum += Exp((data_[i] -= max));
-  }
-  sum = Log(sum);
+  Real max = this->Max();
+  this->Add(-max);
+  Real sum = Log(SumExpVec(data_, 0.0, -std::numeric_limits<Real>::infinity(),
+                           dim_));
   this->Add(-1.0 * sum);
   return max + sum;
 }
@@ -890,17 +864,7 @@ void VectorBase<double>::Tanh(const VectorBase<double> &src) {
 template<typename Real>
 void VectorBase<Real>::Tanh(const VectorBase<Real> &src) {
   KALDI_ASSERT(dim_ == src.dim_);
-  for (MatrixIndexT i = 0; i < dim_; i++) {
-    Real x = src.data_[i];
-    if (x > 0.0) {
-      Real inv_expx = Exp(-x);
-      x = -1.0 + 2.0 / (1.0 + inv_expx * inv_expx);
-    } else {
-      Real expx = Exp(x);
-      x = 1.0 - 2.0 / (1.0 + expx * expx);
-    }
-    data_[i] = x;
-  }
+  TanhVec(src.data_, dim_, data_);
 }
 #endif
 
@@ -928,17 +892,7 @@ void VectorBase<double>::Sigmoid(const VectorBase<double> &src) {
 template<typename Real>
 void VectorBase<Real>::Sigmoid(const VectorBase<Real> &src) {
   KALDI_ASSERT(dim_ == src.dim_);
-  for (MatrixIndexT i = 0; i < dim_; i++) {
-    Real x = src.data_[i];
-    // We aim to avoid floating-point overflow here.
-    if (x > 0.0) {
-      x = 1.0 / (1.0 + Exp(-x));
-    } else {
-      Real ex = Exp(x);
-      x = ex / (ex + 1.0);
-    }
-    data_[i] = x;
-  }
+  SigmoidVec(src.data_, dim_, data_);
 }
 #endif
 
@@ -958,9 +912,7 @@ void VectorBase<Real>::Scale(Real alpha) {
 template<typename Real>
 void VectorBase<Real>::MulElements(const VectorBase<Real> &v) {
   KALDI_ASSERT(dim_ == v.dim_);
-  for (MatrixIndexT i = 0; i < dim_; i++) {
-    data_[i] *= v.data_[i];
-  }
+  MulElementsVec(v.data_, dim_, data_);
 }
 
 template<typename Real>  // Set each element to y = (x == orig ? changed : x).
@@ -991,10 +943,8 @@ template<typename Real>
 void VectorBase<Real>::AddVecVec(Real alpha, const VectorBase<Real> &v,
                                  const VectorBase<Real> &r, Real beta) {
   KALDI_ASSERT(v.data_ != this->data_ && r.data_ != this->data_);
-  // We pretend that v is a band-diagonal matrix.
   KALDI_ASSERT(dim_ == v.dim_ && dim_ == r.dim_);
-  cblas_Xgbmv(kNoTrans, dim_, dim_, 0, 0, alpha, v.data_, 1,
-              r.data_, 1, beta, this->data_, 1);
+  AddVecVecVec(alpha, v.data_, r.data_, beta, dim_, data_);
 }
 
 
@@ -1115,6 +1065,15 @@ void Vector<Real>::Read(std::istream & is,  bool binary, bool add) {
 
   if (binary) {
     int peekval = Peek(is, binary);
+    if (peekval == 'B') {
+      // A reference to data in a parameter blob (see matrix/param-blob.h).
+      const ParamBlob *blob = ParamBlob::CurrentReadBlob();
+      if (blob == NULL)
+        KALDI_ERR << "Found a parameter-blob reference while reading a "
+                  << "vector, but no parameter blob has been read";
+      blob->ReadVector(is, this);
+      return;
+    }
     const char *my_token =  (sizeof(Real) == 4 ? "FV" : "DV");
     char other_token_start = (sizeof(Real) == 4 ? 'D' : 'F');
     if (peekval == other_token_start) {  // need to instantiate the other type to read it.
@@ -1224,6 +1183,11 @@ void VectorBase<Real>::Write(std::ostream & os, bool binary) const {
     KALDI_ERR << "Failed to write vector to stream: stream not good";
   }
   if (binary) {
+    if (ParamBlob *blob = ParamBlob::CurrentWriteBlob()) {
+      // The data goes to the parameter blob; see matrix/param-blob.h.
+      blob->WriteVector(*this, os);
+      return;
+    }
     std::string my_token = (sizeof(Real) == 4 ? "FV" : "DV");
     WriteToken(os, binary, my_token);
 
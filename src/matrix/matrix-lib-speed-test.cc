@@ -22,6 +22,7 @@
 // limitations under the License.
 
 #include "matrix/matrix-lib.h"
+#include "matrix/cblas-wrappers.h"
 #include "base/timer.h"
 #include <numeric>
 
@@ -60,6 +61,16 @@ template<typename Real> static void UnitTestSplitRadixRealFftSpeed() {
   CsvResult<Real>(__func__, 512, t.Elapsed(), "seconds");
 }
 
+template<typename Real> static void UnitTestSplitRadixRealFftBatchSpeed() {
+  Timer t;
+  MatrixIndexT sz = 512;
+  SplitRadixRealFft<Real> srfft(sz);
+  Matrix<Real> frames(100, sz);
+  for (MatrixIndexT i = 0; i < 60; i++)  // The same 6000 frames as above.
+    srfft.Compute(&frames, true);
+  CsvResult<Real>(__func__, 512, t.Elapsed(), "seconds");
+}
+
 template<typename Real>
 static void UnitTestSvdSpeed() {
   Timer t;
@@ -254,15 +265,105 @@ static void UnitTestAddVecToColsSpeed() {
   CsvResult<Real>(__func__, sizes.size(), t.Elapsed(), "seconds");
 }
 
+// The following two functions are the versions of SpMatrix::AddMat2Sp() (with
+// transM == kNoTrans) and TpMatrix::Cholesky() that work directly on packed
+// storage, which those functions still use for small dimensions; they are
+// here to compare the speed of the blocked versions with.
+template<typename Real>
+static void PackedAddMat2Sp(Real alpha, const MatrixBase<Real> &M,
+                            const SpMatrix<Real> &A, Real beta,
+                            SpMatrix<Real> *S) {
+  MatrixIndexT dim = S->NumRows();
+  Vector<Real> tmp_vec(A.NumRows());
+  Real *row_data = S->Data();
+  for (MatrixIndexT r = 0; r < dim; r++, row_data += r) {
+    cblas_Xspmv(A.NumRows(), 1.0, A.Data(), M.RowData(r), 1, 0.0,
+                tmp_vec.Data(), 1);
+    cblas_Xgemv(kNoTrans, r + 1, M.NumCols(), alpha, M.Data(), M.Stride(),
+                tmp_vec.Data(), 1, beta, row_data, 1);
+  }
+}
+
+template<typename Real>
+static void PackedCholesky(const SpMatrix<Real> &orig, TpMatrix<Real> *L) {
+  MatrixIndexT n = orig.NumRows();
+  L->SetZero();
+  Real *data = L->Data(), *jdata = data;
+  const Real *orig_jdata = orig.Data();
+  for (MatrixIndexT j = 0; j < n; j++, jdata += j, orig_jdata += j) {
+    Real *kdata = data, d = 0.0;
+    for (MatrixIndexT k = 0; k < j; k++, kdata += k) {
+      Real s = cblas_Xdot(k, kdata, 1, jdata, 1);
+      jdata[k] = s = (orig_jdata[k] - s) / kdata[k];
+      d += s * s;
+    }
+    d = orig_jdata[j] - d;
+    KALDI_ASSERT(d > 0.0);
+    jdata[j] = std::sqrt(d);
+  }
+}
+
+template<typename Real>
+static void UnitTestPackedMatrixSpeed() {
+  Timer t;
+  std::vector<MatrixIndexT> sizes;
+  sizes.push_back(40);
+  sizes.push_back(100);
+  sizes.push_back(200);
+  sizes.push_back(400);
+  sizes.push_back(600);
+  for (size_t i = 0; i < sizes.size(); i++) {
+    MatrixIndexT size = sizes[i];
+    int32 iters = std::max<int32>(1, 20000000 / (size * size * size));
+    Matrix<Real> M(size, size), N(size, 2 * size);
+    M.SetRandn();
+    N.SetRandn();
+    SpMatrix<Real> A(size), S(size), S2(size);
+    A.AddMat2(1.0, N, kNoTrans, 0.0);  // positive definite.
+    {
+      Timer t1;
+      for (int32 j = 0; j < iters; j++)
+        S.AddMat2Sp(1.0, M, kNoTrans, A, 0.0);
+      CsvResult<Real>("AddMat2Sp", size, t1.Elapsed() / iters, "seconds");
+    }
+    {
+      Timer t1;
+      for (int32 j = 0; j < iters; j++)
+        PackedAddMat2Sp<Real>(1.0, M, A, 0.0, &S2);
+      CsvResult<Real>("AddMat2Sp (packed)", size, t1.Elapsed() / iters,
+                      "seconds");
+    }
+    AssertEqual(S, S2);
+    TpMatrix<Real> L(size), L2(size);
+    {
+      Timer t1;
+      for (int32 j = 0; j < iters; j++)
+        L.Cholesky(A);
+      CsvResult<Real>("Cholesky", size, t1.Elapsed() / iters, "seconds");
+    }
+    {
+      Timer t1;
+      for (int32 j = 0; j < iters; j++)
+        PackedCholesky(A, &L2);
+      CsvResult<Real>("Cholesky (packed)", size, t1.Elapsed() / iters,
+                      "seconds");
+    }
+    KALDI_ASSERT(Matrix<Real>(L).ApproxEqual(Matrix<Real>(L2)));
+  }
+  CsvResult<Real>(__func__, sizes.size(), t.Elapsed(), "seconds");
+}
+
 template<typename Real> static void MatrixUnitSpeedTest() {
   UnitTestRealFftSpeed<Real>();
   UnitTestSplitRadixRealFftSpeed<Real>();
+  UnitTestSplitRadixRealFftBatchSpeed<Real>();
   UnitTestSvdSpeed<Real>();
   UnitTestAddMatMatSpeed<Real>();
   UnitTestAddRowSumMatSpeed<Real>();
   UnitTestAddColSumMatSpeed<Real>();
   UnitTestAddVecToRowsSpeed<Real>();
   UnitTestAddVecToColsSpeed<Real>();
+  UnitTestPackedMatrixSpeed<Real>();
 }
 
 } // namespace kaldi
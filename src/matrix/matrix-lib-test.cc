@@ -137,6 +137,24 @@ template<typename Real> static bool ApproxEqual(Vector<Real> &A, Vector<Real> &B
 }
 */
 
+// Tests Cholesky() at dimensions where it uses the blocked algorithm.
+template<typename Real> static void UnitTestCholeskyBlocked() {
+  for (MatrixIndexT i = 0; i < 2; i++) {
+    MatrixIndexT dimM = 256 + Rand() % 100;
+    Matrix<Real> M(dimM, dimM);
+    M.SetRandn();
+    SpMatrix<Real> S(dimM);
+    S.AddMat2(1.0, M, kNoTrans, 0.0);
+    S.AddToDiag(dimM);
+    TpMatrix<Real> C(dimM);
+    C.Cholesky(S);
+    Matrix<Real> CM(C);
+    SpMatrix<Real> S2(dimM);
+    S2.AddMat2(1.0, CM, kNoTrans, 0.0);
+    AssertEqual(S, S2);
+  }
+}
+
 template<typename Real> static void CholeskyUnitTestTr() {
   for (MatrixIndexT i = 0; i < 5; i++) {
     MatrixIndexT dimM = 2 + Rand() % 10;
@@ -2549,6 +2567,63 @@ template<typename Real> static void UnitTestIo() {
 }
 
 
+template<typename Real> static void UnitTestParamBlob() {
+  typedef typename OtherReal<Real>::Real Other;
+  for (int32 i = 0; i < 5; i++) {
+    MatrixIndexT dimM = Rand() % 10 + 1, dimN = Rand() % 10 + 1;
+    Matrix<Real> M(dimM + 2, dimN), E;
+    M.SetRandn();
+    SubMatrix<Real> M_part(M, 1, dimM, 0, dimN);  // stride != num-cols.
+    Vector<Real> v(dimN);
+    v.SetRandn();
+    Vector<Other> w(dimM);
+    w.SetRandn();
+
+    ParamBlob blob;
+    std::ostringstream os;
+    {
+      ParamBlobWriteScope scope(&blob);
+      M.Write(os, true);
+      E.Write(os, true);
+      v.Write(os, true);
+      M_part.Write(os, true);
+      w.Write(os, true);
+    }
+    // After the scope, the data is written as usual.
+    v.Write(os, true);
+    std::ostringstream blob_os;
+    blob.Write(blob_os, true);
+
+    std::istringstream blob_is(blob_os.str());
+    ParamBlob blob2;
+    blob2.Read(blob_is, true);
+    KALDI_ASSERT(blob2.Size() == blob.Size());
+
+    std::istringstream is(os.str());
+    Matrix<Real> M2, E2(2, 2);
+    Vector<Real> v2, v3;
+    Matrix<Other> M_part2;
+    Vector<Real> w2;
+    {
+      ParamBlobReadScope scope(&blob2);
+      M2.Read(is, true);
+      E2.Read(is, true);
+      v2.Read(is, true);
+      M_part2.Read(is, true);  // read as the other type.
+      w2.Read(is, true);
+    }
+    v3.Read(is, true);
+    Matrix<Real> M_part3(M_part2);
+    Vector<Real> w_real(w);
+    AssertEqual(M, M2);
+    KALDI_ASSERT(E2.NumRows() == 0);
+    AssertEqual(v, v2);
+    AssertEqual(v, v3);
+    AssertEqual(M_part, M_part3);
+    AssertEqual(w_real, w2);
+  }
+}
+
 template<typename Real> static void UnitTestIoCross() {  // across types.
 
   typedef typename OtherReal<Real>::Real Other;  // e.g. if Real == float, Other == double.
@@ -2901,9 +2976,10 @@ template<typename Real> static void UnitTestAddMatSmat() {
 
 // Also tests AddSmat2Sp
 template<typename Real> static void UnitTestAddMat2Sp() {
-  for (MatrixIndexT i = 0; i < 5; i++) {
-    MatrixIndexT dimM = (Rand()%10) + 1,
-        dimN = (Rand()%10 + 1);
+  for (MatrixIndexT i = 0; i < 7; i++) {
+    // The last two are large enough to use the blocked code.
+    MatrixIndexT dimM = (i < 5 ? (Rand()%10) + 1 : (Rand()%50) + 100),
+        dimN = (i < 5 ? (Rand()%10) + 1 : (Rand()%50) + 100);
     BaseFloat alpha = 0.8, beta = 0.9;
     SpMatrix<Real> S(dimM), T(dimN);
     S.SetRandn();
@@ -3672,6 +3748,28 @@ template<typename Real> static void UnitTestSplitRadixRealFft() {
 }
 
 
+template<typename Real> static void UnitTestSplitRadixRealFftBatch() {
+  for (MatrixIndexT p = 0; p < 20; p++) {
+    MatrixIndexT logn = 2 + Rand() % 9, N = 1 << logn,
+        num_frames = 1 + Rand() % 20;  // Often not a multiple of the SIMD width.
+    SplitRadixRealFft<Real> srfft(N);
+    std::vector<Real> temp_buffer;
+    Matrix<Real> M(num_frames, N), M2(num_frames, N);
+    M.SetRandn();
+    M2.CopyFromMat(M);
+    srfft.Compute(&M2, true);
+    for (MatrixIndexT r = 0; r < num_frames; r++) {
+      Vector<Real> v(M.Row(r)), w(M2.Row(r));
+      srfft.Compute(v.Data(), true, &temp_buffer);
+      AssertEqual(v, w, 1.0e-05 * N);
+    }
+    srfft.Compute(&M2, false, &temp_buffer);
+    M2.Scale(1.0 / N);
+    AssertEqual(M, M2, 1.0e-04);
+  }
+}
+
+
 
 template<typename Real> static void UnitTestRealFftSpeed() {
 
@@ -4514,6 +4612,46 @@ static void UnitTestAddMatMatNans() {
   }
 }
 
+template <class Real>
+static void UnitTestAddMatMatBatched() {
+  for (int32 i = 0; i < 10; i++) {
+    // The blocks are column ranges of larger matrices, as in
+    // BlockAffineComponent.
+    int32 num_blocks = RandInt(1, 10), num_rows = RandInt(1, 20),
+        mid = RandInt(1, 10), num_cols = RandInt(1, 10);
+    MatrixTransposeType transA = (RandInt(0, 1) == 0 ? kNoTrans : kTrans),
+        transB = (RandInt(0, 1) == 0 ? kNoTrans : kTrans);
+    Matrix<Real> A(transA == kNoTrans ? num_rows : mid,
+                   num_blocks * (transA == kNoTrans ? mid : num_rows)),
+        B(transB == kNoTrans ? mid : num_cols,
+          num_blocks * (transB == kNoTrans ? num_cols : mid)),
+        C(num_rows, num_blocks * num_cols);
+    A.SetRandn();
+    B.SetRandn();
+    C.SetRandn();
+    Matrix<Real> C2(C);
+    std::vector<SubMatrix<Real> > A_blocks, B_blocks, C_blocks;
+    int32 a_cols = A.NumCols() / num_blocks, b_cols = B.NumCols() / num_blocks;
+    for (int32 b = 0; b < num_blocks; b++) {
+      A_blocks.push_back(A.ColRange(b * a_cols, a_cols));
+      B_blocks.push_back(B.ColRange(b * b_cols, b_cols));
+      C_blocks.push_back(C.ColRange(b * num_cols, num_cols));
+      SubMatrix<Real> C2_block(C2.ColRange(b * num_cols, num_cols));
+      C2_block.AddMatMat(0.5, A_blocks.back(), transA,
+                         B_blocks.back(), transB, 2.0);
+    }
+    std::vector<MatrixBase<Real>* > C_batch;
+    std::vector<const MatrixBase<Real>* > A_batch, B_batch;
+    for (int32 b = 0; b < num_blocks; b++) {
+      A_batch.push_back(&(A_blocks[b]));
+      B_batch.push_back(&(B_blocks[b]));
+      C_batch.push_back(&(C_blocks[b]));
+    }
+    AddMatMatBatched<Real>(0.5, C_batch, A_batch, transA, B_batch, transB, 2.0);
+    AssertEqual(C, C2);
+  }
+}
+
 template<class Real>
 static void UnitTestTopEigs() {
   for (MatrixIndexT i = 0; i < 2; i++) {
@@ -4598,6 +4736,7 @@ template<typename Real> static void MatrixUnitTest(bool full_test) {
   UnitTestFloorChol<Real>();
   UnitTestFloorUnit<Real>();
   UnitTestAddMat2Sp<Real>();
+  UnitTestCholeskyBlocked<Real>();
   UnitTestLbfgs<Real>();
   // UnitTestSvdBad<Real>(); // test bug in Jama SVD code.
   UnitTestCompressedMatrix<Real>();
@@ -4624,6 +4763,7 @@ template<typename Real> static void MatrixUnitTest(bool full_test) {
   UnitTestRealFft<Real>();
   KALDI_LOG << " Point C";
   UnitTestSplitRadixRealFft<Real>();
+  UnitTestSplitRadixRealFftBatch<Real>();
   UnitTestSvd<Real>();
   UnitTestSvdNodestroy<Real>();
   UnitTestSvdJustvec<Real>();
@@ -4635,6 +4775,7 @@ template<typename Real> static void MatrixUnitTest(bool full_test) {
   UnitTestTpInvert<Real>();
   UnitTestIo<Real>();
   UnitTestIoCross<Real>();
+  UnitTestParamBlob<Real>();
   UnitTestHtkIo<Real>();
   UnitTestScale<Real>();
   UnitTestTrace<Real>();
@@ -4723,6 +4864,7 @@ template<typename Real> static void MatrixUnitTest(bool full_test) {
   UnitTestAddMatDiagVec<Real>();
   UnitTestAddMatMatElements<Real>();
   UnitTestAddMatMatNans<Real>();
+  UnitTestAddMatMatBatched<Real>();
   UnitTestAddToDiagMatrix<Real>();
   UnitTestAddToDiag<Real>();
   UnitTestMaxAbsEig<Real>();
@@ -32,6 +32,10 @@
 #include "matrix/compressed-matrix.h"
 #include "matrix/sparse-matrix.h"
 #include "matrix/optimization.h"
+#include "matrix/simd-math.h"
+#include "matrix/serialized-matrix.h"
+#include "matrix/matrix-stats.h"
+#include "matrix/param-blob.h"
 
 #endif
 
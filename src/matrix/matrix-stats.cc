@@ -0,0 +1,142 @@
+// matrix/serialized-matrix.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <sstream>
+
+#include "matrix/matrix-stats.h"
+
+namespace kaldi {
+
+static const char *kMatrixStatsToken = "<MatrixStats>";
+
+void MatrixStats::Compute(const MatrixBase<BaseFloat> &mat) {
+  num_rows_ = mat.NumRows();
+  num_cols_ = mat.NumCols();
+  sum_.Resize(num_cols_);
+  sumsq_.Resize(num_cols_);
+  double *sum = sum_.Data(), *sumsq = sumsq_.Data();
+  for (MatrixIndexT r = 0; r < num_rows_; r++) {
+    const BaseFloat *row = mat.RowData(r);
+    for (MatrixIndexT c = 0; c < num_cols_; c++) {
+      sum[c] += row[c];
+      sumsq[c] += row[c] * row[c];
+    }
+  }
+}
+
+const Matrix<BaseFloat> &MatrixStats::GetMatrix() const {
+  if (!have_mat_)
+    KALDI_ERR << "The matrix was read with a statistics header, so only its "
+              << "statistics are available.";
+  return mat_;
+}
+
+void MatrixStats::Read(std::istream &is, bool binary) {
+  if (binary && Peek(is, binary) == kMatrixStatsToken[0]) {
+    int64 data_size;
+    ReadHeader(is, binary, &data_size);
+    mat_.Resize(0, 0);
+    have_mat_ = false;
+    // Skip the data: seeking does not read it at all, which matters for
+    // script files, but it fails for pipes.
+    is.seekg(data_size, std::ios_base::cur);
+    if (is.fail()) {
+      is.clear();
+      is.ignore(data_size);
+      if (is.gcount() != data_size)
+        KALDI_ERR << "Failed to read matrix data from stream.";
+    }
+  } else {
+    mat_.Read(is, binary);
+    have_mat_ = true;
+    Compute(mat_);
+  }
+}
+
+void MatrixStats::ReadHeader(std::istream &is, bool binary,
+                             int64 *data_size) {
+  KALDI_ASSERT(binary);
+  ExpectToken(is, binary, kMatrixStatsToken);
+  int32 rows, cols;
+  ReadBasicType(is, binary, &rows);
+  ReadBasicType(is, binary, &cols);
+  ReadBasicType(is, binary, data_size);
+  sum_.Read(is, binary);
+  sumsq_.Read(is, binary);
+  if (rows < 0 || cols < 0 || *data_size < 0 || sum_.Dim() != cols ||
+      sumsq_.Dim() != cols)
+    KALDI_ERR << "Bad matrix statistics header.";
+  num_rows_ = rows;
+  num_cols_ = cols;
+}
+
+void MatrixStats::WriteHeader(std::ostream &os, bool binary,
+                              int64 data_size) const {
+  KALDI_ASSERT(binary);
+  WriteToken(os, binary, kMatrixStatsToken);
+  WriteBasicType(os, binary, static_cast<int32>(num_rows_));
+  WriteBasicType(os, binary, static_cast<int32>(num_cols_));
+  WriteBasicType(os, binary, data_size);
+  sum_.Write(os, binary);
+  sumsq_.Write(os, binary);
+}
+
+MatrixWithStats::MatrixWithStats(const MatrixBase<BaseFloat> &mat,
+                                 bool compress, CompressionMethod method) {
+  if (compress) {
+    CompressedMatrix cmat(mat, method);
+    Matrix<BaseFloat> uncompressed(cmat.NumRows(), cmat.NumCols(),
+                                   kUndefined);
+    cmat.CopyToMat(&uncompressed);
+    stats_.Compute(uncompressed);
+    mat_ = cmat;
+  } else {
+    stats_.Compute(mat);
+    mat_ = mat;
+  }
+}
+
+void MatrixWithStats::Read(std::istream &is, bool binary) {
+  if (binary && Peek(is, binary) == kMatrixStatsToken[0]) {
+    int64 data_size;
+    stats_.ReadHeader(is, binary, &data_size);
+    mat_.Read(is, binary);
+  } else {
+    mat_.Read(is, binary);
+    Matrix<BaseFloat> mat;
+    mat_.GetMatrix(&mat);
+    stats_.Compute(mat);
+  }
+}
+
+void MatrixWithStats::Write(std::ostream &os, bool binary) const {
+  if (!binary) {
+    mat_.Write(os, binary);
+    return;
+  }
+  std::ostringstream data;
+  mat_.Write(data, binary);
+  std::string bytes = data.str();
+  stats_.WriteHeader(os, binary, bytes.size());
+  os.write(bytes.data(), bytes.size());
+  if (os.fail())
+    KALDI_ERR << "Failed to write matrix to stream.";
+}
+
+}  // namespace kaldi
@@ -0,0 +1,133 @@
+// matrix/serialized-matrix.h
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_MATRIX_MATRIX_STATS_H_
+#define KALDI_MATRIX_MATRIX_STATS_H_
+
+#include <string>
+
+#include "matrix/matrix-common.h"
+#include "matrix/kaldi-matrix.h"
+#include "matrix/kaldi-vector.h"
+#include "matrix/compressed-matrix.h"
+#include "matrix/sparse-matrix.h"
+
+namespace kaldi {
+
+/// \addtogroup matrix_group
+/// @{
+
+/**
+   Feature matrices may be written with a small header of their statistics
+   (see MatrixWithStats below), so that programs that only need the number of
+   frames, the dimension or the sums of the features and of their squares
+   (e.g. feat-to-len, feat-to-dim, compute-cmvn-stats) can read the header and
+   skip the data.  In binary mode the format is
+
+     <MatrixStats> <num-rows> <num-cols> <data-size> <sum> <sum-of-squares>
+
+   (the last two as double-precision vectors) followed by the matrix in any of
+   the usual binary forms, of <data-size> bytes.  Matrix::Read() skips the
+   header, so such matrices can be read by any program.  In text mode the
+   header is not written.
+
+   MatrixStats holds the statistics of a matrix.  Its Read() function reads
+   just the header if there is one, skipping the data without parsing it (by
+   seeking, if the stream supports it); otherwise it reads the matrix and
+   computes them.  It has no Write() function, as the statistics are written
+   with the matrix by MatrixWithStats.
+ */
+class MatrixStats {
+ public:
+  MatrixStats(): num_rows_(0), num_cols_(0), have_mat_(false) { }
+
+  explicit MatrixStats(const MatrixBase<BaseFloat> &mat): have_mat_(false) {
+    Compute(mat);
+  }
+
+  /// Sets the statistics to those of 'mat'.  The squares are computed in
+  /// BaseFloat, as in AccCmvnStats(), so that the results are the same.
+  void Compute(const MatrixBase<BaseFloat> &mat);
+
+  MatrixIndexT NumRows() const { return num_rows_; }
+  MatrixIndexT NumCols() const { return num_cols_; }
+
+  /// The sum of the rows of the matrix.
+  const Vector<double> &Sum() const { return sum_; }
+  /// The sum of the squares of the elements of the rows of the matrix.
+  const Vector<double> &SumSq() const { return sumsq_; }
+
+  /// True if the statistics were computed from a matrix that had no header,
+  /// which is then kept, so that ranges of it can be taken (see
+  /// ExtractObjectRange() in util/kaldi-holder.h).
+  bool HasMatrix() const { return have_mat_; }
+  const Matrix<BaseFloat> &GetMatrix() const;
+
+  /// Reads the statistics of a matrix; see above.
+  void Read(std::istream &is, bool binary);
+
+  /// Reads the header, which must be next in the stream (binary mode only),
+  /// and outputs the size of the matrix data that follows it.
+  void ReadHeader(std::istream &is, bool binary, int64 *data_size);
+
+  /// Writes the header for matrix data of 'data_size' bytes (binary only).
+  void WriteHeader(std::ostream &os, bool binary, int64 data_size) const;
+
+ private:
+  MatrixIndexT num_rows_;
+  MatrixIndexT num_cols_;
+  Vector<double> sum_;
+  Vector<double> sumsq_;
+  Matrix<BaseFloat> mat_;  // Only set if have_mat_.
+  bool have_mat_;
+};
+
+/**
+   MatrixWithStats is a matrix (full or compressed) that is written together
+   with its statistics, as described above.  It is what copy-feats
+   --write-stats=true writes.
+ */
+class MatrixWithStats {
+ public:
+  MatrixWithStats() { }
+
+  /// Copies the matrix, compressing it with 'method' if 'compress' is true.
+  /// The statistics are those of the matrix as it will be read back.
+  explicit MatrixWithStats(const MatrixBase<BaseFloat> &mat,
+                           bool compress = false,
+                           CompressionMethod method = kAutomaticMethod);
+
+  const MatrixStats &Stats() const { return stats_; }
+
+  const GeneralMatrix &Value() const { return mat_; }
+
+  void Read(std::istream &is, bool binary);
+
+  void Write(std::ostream &os, bool binary) const;
+
+ private:
+  MatrixStats stats_;
+  GeneralMatrix mat_;
+};
+
+/// @} end of \addtogroup matrix_group
+
+}  // namespace kaldi
+
+#endif  // KALDI_MATRIX_MATRIX_STATS_H_
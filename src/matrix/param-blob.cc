@@ -0,0 +1,217 @@
+// matrix/param-blob.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstring>
+
+#include "matrix/param-blob.h"
+#include "base/io-funcs.h"
+
+namespace kaldi {
+
+static thread_local ParamBlob *tls_write_blob = NULL;
+static thread_local const ParamBlob *tls_read_blob = NULL;
+
+ParamBlob *ParamBlob::CurrentWriteBlob() { return tls_write_blob; }
+
+const ParamBlob *ParamBlob::CurrentReadBlob() { return tls_read_blob; }
+
+ParamBlob::~ParamBlob() {
+  if (data_ != NULL)
+    KALDI_MEMALIGN_FREE(data_);
+}
+
+void ParamBlob::Reserve(size_t capacity) {
+  if (capacity <= capacity_)
+    return;
+  void *temp;
+  char *new_data = static_cast<char*>(KALDI_MEMALIGN(kAlignment, capacity,
+                                                     &temp));
+  if (new_data == NULL)
+    KALDI_ERR << "Failed to allocate " << capacity
+              << " bytes for parameter blob";
+  if (data_ != NULL) {
+    memcpy(new_data, data_, size_);
+    KALDI_MEMALIGN_FREE(data_);
+  }
+  data_ = new_data;
+  capacity_ = capacity;
+}
+
+int64 ParamBlob::Append(const void *data, size_t num_bytes) {
+  size_t offset = (size_ + kAlignment - 1) / kAlignment * kAlignment;
+  if (offset + num_bytes > capacity_)
+    Reserve(std::max<size_t>(2 * capacity_, offset + num_bytes));
+  // Zero the padding so that the output does not depend on uninitialized
+  // memory.
+  memset(data_ + size_, 0, offset - size_);
+  if (num_bytes != 0)
+    memcpy(data_ + offset, data, num_bytes);
+  size_ = offset + num_bytes;
+  return offset;
+}
+
+template<typename Real>
+void ParamBlob::WriteMatrix(const MatrixBase<Real> &mat, std::ostream &os) {
+  int32 rows = mat.NumRows(), cols = mat.NumCols();
+  size_t row_bytes = sizeof(Real) * static_cast<size_t>(cols);
+  int64 offset;
+  if (mat.Stride() == mat.NumCols()) {
+    offset = Append(mat.Data(), row_bytes * rows);
+  } else {
+    offset = Append(NULL, 0);
+    Reserve(std::max<size_t>(2 * capacity_, offset + row_bytes * rows));
+    for (int32 r = 0; r < rows; r++)
+      memcpy(data_ + offset + r * row_bytes, mat.RowData(r), row_bytes);
+    size_ = offset + row_bytes * rows;
+  }
+  WriteToken(os, true, sizeof(Real) == 4 ? "BFM" : "BDM");
+  WriteBasicType(os, true, offset);
+  WriteBasicType(os, true, rows);
+  WriteBasicType(os, true, cols);
+}
+
+template<typename Real>
+void ParamBlob::WriteVector(const VectorBase<Real> &vec, std::ostream &os) {
+  int32 dim = vec.Dim();
+  int64 offset = Append(vec.Data(), sizeof(Real) * static_cast<size_t>(dim));
+  WriteToken(os, true, sizeof(Real) == 4 ? "BFV" : "BDV");
+  WriteBasicType(os, true, offset);
+  WriteBasicType(os, true, dim);
+}
+
+void ParamBlob::ReadRef(std::istream &is, ParamBlobRef *ref) const {
+  std::string token;
+  ReadToken(is, true, &token);
+  if (token.size() != 3 || token[0] != 'B' ||
+      (token[1] != 'F' && token[1] != 'D') ||
+      (token[2] != 'M' && token[2] != 'V'))
+    KALDI_ERR << "Expected a parameter-blob reference, got " << token;
+  ref->is_double = (token[1] == 'D');
+  ref->is_matrix = (token[2] == 'M');
+  ReadBasicType(is, true, &ref->offset);
+  if (ref->is_matrix) {
+    ReadBasicType(is, true, &ref->num_rows);
+  } else {
+    ref->num_rows = 1;
+  }
+  ReadBasicType(is, true, &ref->num_cols);
+  size_t num_bytes = (ref->is_double ? 8 : 4) *
+      static_cast<size_t>(ref->num_rows) * ref->num_cols;
+  if (ref->offset < 0 || ref->num_rows < 0 || ref->num_cols < 0 ||
+      static_cast<size_t>(ref->offset) + num_bytes > size_ ||
+      ref->offset % kAlignment != 0)
+    KALDI_ERR << "Invalid parameter-blob reference (offset " << ref->offset
+              << ", " << ref->num_rows << " x " << ref->num_cols
+              << ") for a blob of " << size_ << " bytes";
+}
+
+template<typename Real>
+void ParamBlob::ReadMatrix(std::istream &is, Matrix<Real> *mat) const {
+  ParamBlobRef ref;
+  ReadRef(is, &ref);
+  if (!ref.is_matrix)
+    KALDI_ERR << "Expected a matrix in the parameter blob, got a vector";
+  mat->Resize(ref.num_rows, ref.num_cols, kUndefined);
+  if (ref.num_rows == 0 || ref.num_cols == 0)
+    return;
+  if (ref.is_double)
+    mat->CopyFromMat(MatrixView<double>(ref));
+  else
+    mat->CopyFromMat(MatrixView<float>(ref));
+}
+
+template<typename Real>
+void ParamBlob::ReadVector(std::istream &is, Vector<Real> *vec) const {
+  ParamBlobRef ref;
+  ReadRef(is, &ref);
+  if (ref.is_matrix)
+    KALDI_ERR << "Expected a vector in the parameter blob, got a matrix";
+  vec->Resize(ref.num_cols, kUndefined);
+  if (ref.is_double)
+    vec->CopyFromVec(VectorView<double>(ref));
+  else
+    vec->CopyFromVec(VectorView<float>(ref));
+}
+
+void ParamBlob::Write(std::ostream &os, bool binary) const {
+  if (!binary)
+    KALDI_ERR << "Parameter blobs can only be written in binary mode";
+  WriteToken(os, binary, "<ParamBlob>");
+  int64 size = size_;
+  WriteBasicType(os, binary, size);
+  if (size_ != 0)
+    os.write(data_, size_);
+  if (!os.good())
+    KALDI_ERR << "Failed to write parameter blob";
+}
+
+void ParamBlob::Read(std::istream &is, bool binary) {
+  if (!binary)
+    KALDI_ERR << "Parameter blobs can only be read in binary mode";
+  ExpectToken(is, binary, "<ParamBlob>");
+  int64 size;
+  ReadBasicType(is, binary, &size);
+  if (size < 0)
+    KALDI_ERR << "Invalid parameter blob size " << size;
+  size_ = 0;
+  Reserve(size);
+  if (size != 0)
+    is.read(data_, size);
+  if (is.fail())
+    KALDI_ERR << "Failed to read parameter blob of " << size
+              << " bytes (truncated file?)";
+  size_ = size;
+}
+
+ParamBlobWriteScope::ParamBlobWriteScope(ParamBlob *blob):
+    prev_blob_(tls_write_blob) {
+  tls_write_blob = blob;
+}
+
+ParamBlobWriteScope::~ParamBlobWriteScope() {
+  tls_write_blob = prev_blob_;
+}
+
+ParamBlobReadScope::ParamBlobReadScope(const ParamBlob *blob):
+    prev_blob_(tls_read_blob) {
+  tls_read_blob = blob;
+}
+
+ParamBlobReadScope::~ParamBlobReadScope() {
+  tls_read_blob = prev_blob_;
+}
+
+template
+void ParamBlob::WriteMatrix(const MatrixBase<float> &mat, std::ostream &os);
+template
+void ParamBlob::WriteMatrix(const MatrixBase<double> &mat, std::ostream &os);
+template
+void ParamBlob::WriteVector(const VectorBase<float> &vec, std::ostream &os);
+template
+void ParamBlob::WriteVector(const VectorBase<double> &vec, std::ostream &os);
+template
+void ParamBlob::ReadMatrix(std::istream &is, Matrix<float> *mat) const;
+template
+void ParamBlob::ReadMatrix(std::istream &is, Matrix<double> *mat) const;
+template
+void ParamBlob::ReadVector(std::istream &is, Vector<float> *vec) const;
+template
+void ParamBlob::ReadVector(std::istream &is, Vector<double> *vec) const;
+
+}  // namespace kaldi
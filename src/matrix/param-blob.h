@@ -0,0 +1,171 @@
+// matrix/param-blob.h
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_MATRIX_PARAM_BLOB_H_
+#define KALDI_MATRIX_PARAM_BLOB_H_
+
+#include <iostream>
+
+#include "matrix/matrix-common.h"
+#include "matrix/kaldi-matrix.h"
+#include "matrix/kaldi-vector.h"
+
+namespace kaldi {
+
+/// \addtogroup matrix_group
+/// @{
+
+/// A reference to a matrix or vector in a ParamBlob, as read by
+/// ParamBlob::ReadRef().  For vectors, num_rows is 1.
+struct ParamBlobRef {
+  bool is_matrix;
+  bool is_double;
+  int64 offset;
+  int32 num_rows;
+  int32 num_cols;
+};
+
+/**
+   A ParamBlob holds the data of a set of matrices and vectors, stored one
+   after the other with each one starting on a kAlignment-byte boundary.  It
+   lets an object with many parameters (e.g. a neural net) be written so that
+   all of its parameters can be read with one large read, instead of one
+   small read per matrix.
+
+   While a ParamBlob is installed for writing on the current thread (see
+   ParamBlobWriteScope), binary writes of Matrix, Vector, CuMatrix and
+   CuVector append their data to it and write only a short reference to the
+   stream: the token "BFM", "BDM", "BFV" or "BDV", then the offset and the
+   dimensions.  The caller writes the blob itself before the object, and when
+   reading installs it with ParamBlobReadScope while the object is read; the
+   references are then resolved from it.  Matrices are copied straight from
+   the blob, so CuMatrix::Read() uploads to the GPU without another copy.
+
+   See Nnet::WriteWithParamBlob() for how it is used.
+ */
+class ParamBlob {
+ public:
+  ParamBlob(): data_(NULL), size_(0), capacity_(0) { }
+  ~ParamBlob();
+
+  static const size_t kAlignment = 64;
+
+  /// Returns the blob installed for writing on this thread, or NULL.
+  static ParamBlob *CurrentWriteBlob();
+  /// Returns the blob installed for reading on this thread, or NULL.
+  static const ParamBlob *CurrentReadBlob();
+
+  /// Appends the data of 'mat' and writes a reference to it to 'os'.
+  template<typename Real>
+  void WriteMatrix(const MatrixBase<Real> &mat, std::ostream &os);
+
+  /// Appends the data of 'vec' and writes a reference to it to 'os'.
+  template<typename Real>
+  void WriteVector(const VectorBase<Real> &vec, std::ostream &os);
+
+  /// Reads a reference written by WriteMatrix() or WriteVector() (binary
+  /// mode only), checking that it lies inside the blob.
+  void ReadRef(std::istream &is, ParamBlobRef *ref) const;
+
+  /// Returns the data of a matrix reference as a view into the blob.  Real
+  /// must match ref.is_double.
+  template<typename Real>
+  SubMatrix<Real> MatrixView(const ParamBlobRef &ref) const;
+
+  /// Returns the data of a vector reference as a view into the blob.  Real
+  /// must match ref.is_double.
+  template<typename Real>
+  SubVector<Real> VectorView(const ParamBlobRef &ref) const;
+
+  /// Reads a matrix reference and sets 'mat' to a copy of its data, which may
+  /// be of either floating-point type.
+  template<typename Real>
+  void ReadMatrix(std::istream &is, Matrix<Real> *mat) const;
+
+  /// Reads a vector reference and sets 'vec' to a copy of its data.
+  template<typename Real>
+  void ReadVector(std::istream &is, Vector<Real> *vec) const;
+
+  /// The size of the data in bytes.
+  size_t Size() const { return size_; }
+
+  /// Writes the token <ParamBlob>, the size and then the data in one piece.
+  /// Only binary mode is supported.
+  void Write(std::ostream &os, bool binary) const;
+
+  /// Reads what Write() wrote, replacing the current contents; the data is
+  /// read with a single read into a buffer aligned to kAlignment.
+  void Read(std::istream &is, bool binary);
+
+ private:
+  // Appends 'num_bytes' bytes from 'data', starting at a multiple of
+  // kAlignment, and returns the offset they were written at.
+  int64 Append(const void *data, size_t num_bytes);
+
+  void Reserve(size_t capacity);
+
+  char *data_;
+  size_t size_;
+  size_t capacity_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(ParamBlob);
+};
+
+/// While an object of this type exists, binary writes of matrices and vectors
+/// on this thread go to 'blob' (see ParamBlob).  Scopes may be nested.
+class ParamBlobWriteScope {
+ public:
+  explicit ParamBlobWriteScope(ParamBlob *blob);
+  ~ParamBlobWriteScope();
+ private:
+  ParamBlob *prev_blob_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(ParamBlobWriteScope);
+};
+
+/// While an object of this type exists, matrix and vector references read on
+/// this thread are resolved from 'blob' (see ParamBlob).
+class ParamBlobReadScope {
+ public:
+  explicit ParamBlobReadScope(const ParamBlob *blob);
+  ~ParamBlobReadScope();
+ private:
+  const ParamBlob *prev_blob_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(ParamBlobReadScope);
+};
+
+
+template<typename Real>
+SubMatrix<Real> ParamBlob::MatrixView(const ParamBlobRef &ref) const {
+  KALDI_ASSERT(ref.is_matrix && ref.is_double == (sizeof(Real) == 8));
+  Real *data = reinterpret_cast<Real*>(data_ + ref.offset);
+  return SubMatrix<Real>(data, ref.num_rows, ref.num_cols, ref.num_cols);
+}
+
+template<typename Real>
+SubVector<Real> ParamBlob::VectorView(const ParamBlobRef &ref) const {
+  KALDI_ASSERT(!ref.is_matrix && ref.is_double == (sizeof(Real) == 8));
+  const Real *data = reinterpret_cast<const Real*>(data_ + ref.offset);
+  return SubVector<Real>(data, ref.num_cols);
+}
+
+/// @} end of \addtogroup matrix_group
+
+}  // namespace kaldi
+
+#endif  // KALDI_MATRIX_PARAM_BLOB_H_
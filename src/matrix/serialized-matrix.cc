@@ -0,0 +1,122 @@
+// matrix/serialized-matrix.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstring>
+#include <sstream>
+
+#include "matrix/serialized-matrix.h"
+#include "matrix/matrix-stats.h"
+
+namespace kaldi {
+
+const Matrix<BaseFloat> &SerializedMatrix::Value() const {
+  if (!have_mat_) {
+    size_t num_bytes = sizeof(BaseFloat) * num_rows_ * num_cols_;
+    const char *data = bytes_.data() + bytes_.size() - num_bytes;
+    mat_.Resize(num_rows_, num_cols_, kUndefined);
+    for (MatrixIndexT r = 0; r < num_rows_; r++)
+      memcpy(mat_.RowData(r), data + sizeof(BaseFloat) * num_cols_ * r,
+             sizeof(BaseFloat) * num_cols_);
+    have_mat_ = true;
+  }
+  return mat_;
+}
+
+Matrix<BaseFloat> &SerializedMatrix::MutableValue() {
+  Value();
+  bytes_.clear();
+  return mat_;
+}
+
+void SerializedMatrix::Read(std::istream &is, bool binary) {
+  Clear();
+  std::string stats_header;
+  if (binary && Peek(is, binary) == '<') {
+    // The matrix has a header of its statistics (see matrix/matrix-stats.h);
+    // we keep it if we keep the matrix data, which it describes.
+    MatrixStats stats;
+    int64 data_size;
+    stats.ReadHeader(is, binary, &data_size);
+    std::ostringstream header;
+    stats.WriteHeader(header, binary, data_size);
+    stats_header = header.str();
+  }
+  const char *my_token = (sizeof(BaseFloat) == 4 ? "FM" : "DM");
+  if (!binary || Peek(is, binary) != my_token[0]) {
+    // Text, compressed or the other type: these are converted anyway.
+    mat_.Read(is, binary);
+    return;
+  }
+  std::string token;
+  ReadToken(is, binary, &token);
+  if (token != my_token)
+    KALDI_ERR << "Expected token " << my_token << ", got " << token;
+  int32 rows, cols;
+  ReadBasicType(is, binary, &rows);
+  ReadBasicType(is, binary, &cols);
+  if (rows < 0 || cols < 0 || (rows == 0) != (cols == 0))
+    KALDI_ERR << "Bad matrix size " << rows << " x " << cols;
+  // The header is written again rather than kept, as it is not worth the
+  // trouble of recording the stream position; it comes out the same.
+  std::ostringstream header;
+  WriteToken(header, binary, my_token);
+  WriteBasicType(header, binary, rows);
+  WriteBasicType(header, binary, cols);
+  bytes_ = stats_header + header.str();
+  size_t header_size = bytes_.size(),
+      num_bytes = sizeof(BaseFloat) * static_cast<size_t>(rows) * cols;
+  bytes_.resize(header_size + num_bytes);
+  if (num_bytes != 0)
+    is.read(&(bytes_[header_size]), num_bytes);
+  if (is.fail()) {
+    bytes_.clear();
+    KALDI_ERR << "Failed to read matrix data from stream.";
+  }
+  num_rows_ = rows;
+  num_cols_ = cols;
+  have_mat_ = false;
+}
+
+void SerializedMatrix::Write(std::ostream &os, bool binary) const {
+  if (binary && !bytes_.empty()) {
+    os.write(bytes_.data(), bytes_.size());
+    if (os.fail())
+      KALDI_ERR << "Failed to write matrix to stream.";
+  } else {
+    Value().Write(os, binary);
+  }
+}
+
+void SerializedMatrix::Swap(SerializedMatrix *other) {
+  std::swap(num_rows_, other->num_rows_);
+  std::swap(num_cols_, other->num_cols_);
+  bytes_.swap(other->bytes_);
+  mat_.Swap(&(other->mat_));
+  std::swap(have_mat_, other->have_mat_);
+}
+
+void SerializedMatrix::Clear() {
+  num_rows_ = 0;
+  num_cols_ = 0;
+  bytes_.clear();
+  mat_.Resize(0, 0);
+  have_mat_ = true;
+}
+
+}  // namespace kaldi
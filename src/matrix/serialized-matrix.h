@@ -0,0 +1,101 @@
+// matrix/serialized-matrix.h
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_MATRIX_SERIALIZED_MATRIX_H_
+#define KALDI_MATRIX_SERIALIZED_MATRIX_H_
+
+#include <string>
+
+#include "matrix/matrix-common.h"
+#include "matrix/kaldi-matrix.h"
+
+namespace kaldi {
+
+/// \addtogroup matrix_group
+/// @{
+
+/**
+   SerializedMatrix is a Matrix<BaseFloat> that is kept in the form it was
+   read in, for programs that mostly copy matrices from one table to another
+   (e.g. copy-feats, subset-feats).  If it was read in binary as a
+   Matrix<BaseFloat>, Read() just stores its bytes and Write() in binary just
+   writes them back, so the data is never parsed or re-serialized.  The matrix
+   itself is only created when Value() is called; once MutableValue() is
+   called the bytes are discarded and the matrix is written as usual.
+
+   Matrices in other forms (text, compressed, or of the other floating-point
+   type) are converted when they are read, as Matrix<BaseFloat>::Read() would,
+   so in all cases Write() writes exactly what writing Value() would, except
+   that a header of statistics (see matrix/matrix-stats.h) is kept along with
+   the bytes.
+
+   Because Value() fills in the matrix lazily, it is not safe to call it from
+   several threads at once for the same object.
+ */
+class SerializedMatrix {
+ public:
+  SerializedMatrix(): num_rows_(0), num_cols_(0), have_mat_(true) { }
+
+  /// Copies the matrix; writing this object will serialize it.
+  explicit SerializedMatrix(const MatrixBase<BaseFloat> &mat):
+      num_rows_(0), num_cols_(0), mat_(mat), have_mat_(true) { }
+
+  /// These do not need the matrix to be created.
+  MatrixIndexT NumRows() const {
+    return bytes_.empty() ? mat_.NumRows() : num_rows_;
+  }
+  MatrixIndexT NumCols() const {
+    return bytes_.empty() ? mat_.NumCols() : num_cols_;
+  }
+
+  /// Returns the matrix, creating it from the bytes if needed.
+  const Matrix<BaseFloat> &Value() const;
+
+  /// Returns the matrix for modification (it may be resized); from now on
+  /// Write() serializes it.
+  Matrix<BaseFloat> &MutableValue();
+
+  /// True if Write() in binary mode will just copy bytes.
+  bool IsSerialized() const { return !bytes_.empty(); }
+
+  void Read(std::istream &is, bool binary);
+
+  void Write(std::ostream &os, bool binary) const;
+
+  void Swap(SerializedMatrix *other);
+
+  void Clear();
+
+ private:
+  MatrixIndexT num_rows_;  // The size of the matrix in bytes_, if any.
+  MatrixIndexT num_cols_;
+  // If nonempty, the binary form of the matrix, from its token ("FM" or "DM")
+  // on, preceded by its statistics header if it had one (see
+  // matrix/matrix-stats.h); the data is the last
+  // num_rows_ * num_cols_ * sizeof(BaseFloat) bytes.
+  std::string bytes_;
+  mutable Matrix<BaseFloat> mat_;
+  mutable bool have_mat_;  // True if mat_ is up to date; if false, bytes_ is.
+};
+
+/// @} end of \addtogroup matrix_group
+
+}  // namespace kaldi
+
+#endif  // KALDI_MATRIX_SERIALIZED_MATRIX_H_
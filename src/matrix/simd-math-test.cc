@@ -0,0 +1,310 @@
+// matrix/simd-math-test.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cmath>
+#include <limits>
+
+#include "matrix/matrix-lib.h"
+#include "base/timer.h"
+
+namespace kaldi {
+
+// Checks that 'a' approximates the double-precision 'ref' to within 'rel_tol'
+// relative error, or 'abs_tol' absolute error.
+static void AssertClose(float a, double ref, double rel_tol,
+                        double abs_tol = 0.0) {
+  // Values that overflow in single precision should give infinity.
+  if (std::abs(ref) > std::numeric_limits<float>::max())
+    ref = (ref > 0 ? 1 : -1) * std::numeric_limits<double>::infinity();
+  if (KALDI_ISNAN(ref)) {
+    KALDI_ASSERT(KALDI_ISNAN(a));
+  } else if (KALDI_ISINF(ref)) {
+    KALDI_ASSERT(a == ref);
+  } else if (!(std::abs(a - ref) <= abs_tol ||
+               std::abs(a - ref) <= rel_tol * std::abs(ref))) {
+    KALDI_ERR << "Value " << a << " differs from " << ref << " by "
+              << (a - ref);
+  }
+}
+
+// Up to 4 ulp.
+static const double kRelTol = 4.0 * std::numeric_limits<float>::epsilon();
+
+static void UnitTestExpLogVec() {
+  for (int32 i = 0; i < 20; i++) {
+    // All the dimensions up to 40, to test the partial vectors.
+    MatrixIndexT dim = (i < 10 ? i : Rand() % 40);
+    Vector<float> x(dim), y(dim);
+    x.SetRandn();
+    x.Scale(30.0);
+    float offset = RandGauss();
+    float sum = ExpVec(x.Data(), offset, dim, y.Data());
+    double ref_sum = 0.0;
+    for (MatrixIndexT j = 0; j < dim; j++) {
+      // The argument is rounded to float, which is not part of the error.
+      double ref = std::exp(static_cast<double>(x(j) + offset));
+      AssertClose(y(j), ref, kRelTol);
+      ref_sum += ref;
+    }
+    AssertClose(sum, ref_sum, 1.0e-05);
+    float cutoff = RandGauss() * 10.0;
+    double ref_sum_cutoff = 0.0;
+    for (MatrixIndexT j = 0; j < dim; j++)
+      if (x(j) >= cutoff)
+        ref_sum_cutoff += std::exp(static_cast<double>(x(j) + offset));
+    AssertClose(SumExpVec(x.Data(), offset, cutoff, dim), ref_sum_cutoff,
+                1.0e-05);
+
+    x.ApplyAbs();
+    x.Scale(Exp(RandGauss() * 10.0));  // Spread over many orders of magnitude.
+    LogVec(x.Data(), dim, y.Data());
+    for (MatrixIndexT j = 0; j < dim; j++)
+      AssertClose(y(j), std::log(static_cast<double>(x(j))), kRelTol, 1.0e-07);
+    // In-place.
+    Vector<float> z(x);
+    ExpVec(z.Data(), 0.0, dim, z.Data());
+    for (MatrixIndexT j = 0; j < dim; j++)
+      AssertClose(z(j), std::exp(static_cast<double>(x(j))), kRelTol);
+  }
+}
+
+static void UnitTestExpLogSpecialValues() {
+  const float inf = std::numeric_limits<float>::infinity(),
+      nan = std::numeric_limits<float>::quiet_NaN(),
+      denorm_min = std::numeric_limits<float>::denorm_min(),
+      min_normal = std::numeric_limits<float>::min(),
+      flt_max = std::numeric_limits<float>::max();
+  float in[] = { 0.0, -0.0, 1.0, -1.0, inf, -inf, nan, 88.5, 88.8, 100.0,
+                 -87.0, -95.0, -103.0, -110.0, denorm_min, 1.0e-40,
+                 min_normal, flt_max, 1.0e-30, 1.0e+30 };
+  MatrixIndexT dim = sizeof(in) / sizeof(in[0]);
+  std::vector<float> out(dim);
+  ExpVec(in, 0.0, dim, &(out[0]));
+  for (MatrixIndexT i = 0; i < dim; i++) {
+    double ref = std::exp(static_cast<double>(in[i]));
+    // Results that are denormal are only accurate to the nearest denormal.
+    AssertClose(out[i], ref, kRelTol, 2.0 * denorm_min);
+  }
+  LogVec(in, dim, &(out[0]));
+  for (MatrixIndexT i = 0; i < dim; i++) {
+    double ref = (in[i] == 0.0 ? -inf : std::log(static_cast<double>(in[i])));
+    AssertClose(out[i], ref, kRelTol);
+  }
+  float x[] = { -inf, -1000.0, -50.0, -1.0e-10, 0.0, 1.0e-10, 20.0, 1000.0,
+                inf, nan };
+  dim = sizeof(x) / sizeof(x[0]);
+  SigmoidVec(x, dim, &(out[0]));
+  for (MatrixIndexT i = 0; i < dim; i++)
+    AssertClose(out[i], 1.0 / (1.0 + std::exp(-static_cast<double>(x[i]))),
+                kRelTol, 1.0e-07);
+  TanhVec(x, dim, &(out[0]));
+  for (MatrixIndexT i = 0; i < dim; i++)
+    AssertClose(out[i], std::tanh(static_cast<double>(x[i])), kRelTol,
+                2.0e-07);
+}
+
+template<typename Real>
+static void UnitTestSigmoidTanhVec() {
+  for (int32 i = 0; i < 10; i++) {
+    MatrixIndexT dim = Rand() % 50;
+    Vector<Real> x(dim), y(dim);
+    x.SetRandn();
+    x.Scale(10.0);
+    SigmoidVec(x.Data(), dim, y.Data());
+    for (MatrixIndexT j = 0; j < dim; j++)
+      AssertClose(y(j), 1.0 / (1.0 + std::exp(-static_cast<double>(x(j)))),
+                  kRelTol, 1.0e-07);
+    TanhVec(x.Data(), dim, y.Data());
+    for (MatrixIndexT j = 0; j < dim; j++)
+      AssertClose(y(j), std::tanh(static_cast<double>(x(j))), kRelTol,
+                  2.0e-07);
+  }
+}
+
+template<typename Real>
+static void UnitTestExactVecFuncs() {
+  for (int32 i = 0; i < 40; i++) {
+    MatrixIndexT dim = (i < 20 ? i : Rand() % 100);
+    Vector<Real> x(dim), y(dim), z(dim);
+    x.SetRandn();
+    y.SetRandn();
+    z.SetRandn();
+    double ref_sum = 0.0;
+    for (MatrixIndexT j = 0; j < dim; j++)
+      ref_sum += x(j);
+    // The sum is accumulated in the precision of Real.
+    double sum_tol = (sizeof(Real) == 4 ? 1.0e-06 : 1.0e-10) * dim;
+    KALDI_ASSERT(std::abs(SumVec(x.Data(), dim) - ref_sum) <= sum_tol);
+
+    Vector<Real> w(z);
+    MulElementsVec(x.Data(), dim, w.Data());
+    for (MatrixIndexT j = 0; j < dim; j++)
+      KALDI_ASSERT(w(j) == z(j) * x(j));
+
+    Real alpha = RandGauss(), beta = (i % 3 == 0 ? 0.0 : RandGauss());
+    w.CopyFromVec(z);
+    if (beta == 0.0 && dim > 0)
+      w(Rand() % dim) = std::numeric_limits<Real>::quiet_NaN();
+    AddVecVecVec(alpha, x.Data(), y.Data(), beta, dim, w.Data());
+    for (MatrixIndexT j = 0; j < dim; j++) {
+      double ref = alpha * x(j) * y(j) + (beta == 0.0 ? 0.0 : beta * z(j));
+      KALDI_ASSERT(std::abs(w(j) - ref) <= 1.0e-05 * (1.0 + std::abs(ref)));
+    }
+
+    Real floor_val = 0.5 * RandGauss();
+    if (dim > 0)
+      x(Rand() % dim) = std::numeric_limits<Real>::quiet_NaN();
+    MatrixIndexT num_floored = FloorVec(x.Data(), floor_val, dim, w.Data()),
+        ref_num_floored = 0;
+    for (MatrixIndexT j = 0; j < dim; j++) {
+      if (x(j) < floor_val) {
+        ref_num_floored++;
+        KALDI_ASSERT(w(j) == floor_val);
+      } else if (KALDI_ISNAN(x(j))) {
+        KALDI_ASSERT(KALDI_ISNAN(w(j)));
+      } else {
+        KALDI_ASSERT(w(j) == x(j));
+      }
+    }
+    KALDI_ASSERT(num_floored == ref_num_floored);
+    // In-place.
+    FloorVec(x.Data(), floor_val, dim, x.Data());
+    for (MatrixIndexT j = 0; j < dim; j++)
+      KALDI_ASSERT(KALDI_ISNAN(x(j)) || x(j) == w(j));
+  }
+}
+
+template<typename Real>
+static void UnitTestGatherVec() {
+  for (int32 i = 0; i < 40; i++) {
+    MatrixIndexT dim = (i < 20 ? i : Rand() % 100),
+        in_dim = 1 + Rand() % 50, map_dim = 1 + Rand() % 50;
+    Vector<Real> x(in_dim), y(dim);
+    x.SetRandn();
+    std::vector<int32> map(map_dim), indexes(dim + 1);
+    for (MatrixIndexT j = 0; j < map_dim; j++)
+      map[j] = Rand() % in_dim;
+    bool use_map = (i % 2 == 0);
+    for (MatrixIndexT j = 0; j < dim; j++)
+      indexes[j] = Rand() % (use_map ? map_dim : in_dim);
+    Real alpha = (i % 3 == 0 ? 1.0 : RandGauss());
+    GatherVec(alpha, x.Data(), (use_map ? &(map[0]) : NULL), &(indexes[0]),
+              dim, y.Data());
+    for (MatrixIndexT j = 0; j < dim; j++) {
+      Real ref = alpha * x(use_map ? map[indexes[j]] : indexes[j]);
+      KALDI_ASSERT(y(j) == ref);
+    }
+  }
+}
+
+template<typename Real>
+static void UnitTestTransposeMat() {
+  for (int32 i = 0; i < 20; i++) {
+    // Sizes that are not multiples of the blocks or the tiles.
+    MatrixIndexT num_rows = 1 + Rand() % 80, num_cols = 1 + Rand() % 80;
+    Matrix<Real> M(num_rows, num_cols), N(num_cols, num_rows);
+    M.SetRandn();
+    N.Set(-1.0);
+    TransposeMat(M.Data(), M.Stride(), num_rows, num_cols, N.Data(),
+                 N.Stride());
+    for (MatrixIndexT r = 0; r < num_rows; r++)
+      for (MatrixIndexT c = 0; c < num_cols; c++)
+        KALDI_ASSERT(N(c, r) == M(r, c));
+    // Through CopyFromMat(), from a matrix whose stride is not its width.
+    SubMatrix<Real> sub(M, 0, num_rows, 0, (num_cols + 1) / 2);
+    Matrix<Real> P((num_cols + 1) / 2, num_rows);
+    P.CopyFromMat(sub, kTrans);
+    for (MatrixIndexT r = 0; r < num_rows; r++)
+      for (MatrixIndexT c = 0; c < (num_cols + 1) / 2; c++)
+        KALDI_ASSERT(P(c, r) == M(r, c));
+  }
+}
+
+static void UnitTestQuantizeVec() {
+  for (int32 i = 0; i < 40; i++) {
+    MatrixIndexT dim = (i < 20 ? i : Rand() % 100);
+    Vector<float> x(dim), y(dim);
+    x.SetRandn();
+    float min_value = -2.0 + RandGauss() * 0.1, range = 4.0;
+    std::vector<uint8> bytes(dim + 1);
+    std::vector<uint16> shorts(dim + 1);
+    FloatToUint8Vec(x.Data(), min_value, range, dim, &(bytes[0]));
+    FloatToUint16Vec(x.Data(), min_value, range, dim, &(shorts[0]));
+    for (MatrixIndexT j = 0; j < dim; j++) {
+      float f = (x(j) - min_value) / range;
+      if (f > 1.0) f = 1.0;
+      if (f < 0.0) f = 0.0;
+      // The same rounding as in class CompressedMatrix.
+      KALDI_ASSERT(bytes[j] == static_cast<int>(f * 255 + 0.499));
+      KALDI_ASSERT(shorts[j] == static_cast<int>(f * 65535 + 0.499));
+    }
+    float increment = range / 255.0;
+    Uint8ToFloatVec(&(bytes[0]), min_value, increment, dim, y.Data());
+    for (MatrixIndexT j = 0; j < dim; j++)
+      AssertClose(y(j), min_value + bytes[j] * increment, kRelTol, 1.0e-06);
+    increment = range / 65535.0;
+    Uint16ToFloatVec(&(shorts[0]), min_value, increment, dim, y.Data());
+    for (MatrixIndexT j = 0; j < dim; j++)
+      AssertClose(y(j), min_value + shorts[j] * increment, kRelTol, 1.0e-06);
+  }
+}
+
+static void UnitTestSimdMathSpeed() {
+  MatrixIndexT dim = 1000;
+  int32 iters = 2000;
+  Vector<float> x(dim), y(dim);
+  x.SetRandn();
+  float sum = 0.0;
+  {
+    Timer timer;
+    for (int32 i = 0; i < iters; i++)
+      for (MatrixIndexT j = 0; j < dim; j++)
+        sum += (y(j) = Exp(x(j)));
+    KALDI_LOG << "Scalar Exp(): " << (timer.Elapsed() * 1.0e+09 / (iters * dim))
+              << " ns per element.";
+  }
+  {
+    Timer timer;
+    for (int32 i = 0; i < iters; i++)
+      sum += ExpVec(x.Data(), 0.0, dim, y.Data());
+    KALDI_LOG << "ExpVec(): " << (timer.Elapsed() * 1.0e+09 / (iters * dim))
+              << " ns per element.";
+  }
+  KALDI_VLOG(1) << sum;  // So the loops are not optimized away.
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  KALDI_LOG << "Using instruction set " << SimdMathInstructionSet();
+  UnitTestExpLogVec();
+  UnitTestExpLogSpecialValues();
+  UnitTestSigmoidTanhVec<float>();
+  UnitTestSigmoidTanhVec<double>();
+  UnitTestExactVecFuncs<float>();
+  UnitTestExactVecFuncs<double>();
+  UnitTestGatherVec<float>();
+  UnitTestGatherVec<double>();
+  UnitTestTransposeMat<float>();
+  UnitTestTransposeMat<double>();
+  UnitTestQuantizeVec();
+  UnitTestSimdMathSpeed();
+  KALDI_LOG << "Tests succeeded.";
+}
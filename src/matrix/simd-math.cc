@@ -0,0 +1,1563 @@
+// matrix/simd-math.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <limits>
+
+#include "matrix/simd-math.h"
+
+// The x86 code is compiled with the 'target' function attribute, so that it
+// does not need -mavx2 etc. for the whole file and we can choose at runtime
+// whether to call it; this needs gcc or clang.  NEON is always there on
+// 64-bit ARM.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KALDI_SIMD_MATH_X86 1
+#include <immintrin.h>
+#define KALDI_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define KALDI_TARGET_AVX512 __attribute__((target("avx512f")))
+#if !defined(__clang__)
+// Some versions of gcc warn about the _mm512_undefined_*() in the AVX-512
+// intrinsics.
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define KALDI_SIMD_MATH_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace kaldi {
+
+namespace {
+
+// The operations; the template argument of the kernels below.  'a' and 'b'
+// are the extra arguments of the operation.
+enum SimdMathOp {
+  kExpOp,      // out = exp(in + a), returning the sum.
+  kSumExpOp,   // returns the sum of exp(in + a) for in >= b.
+  kLogOp,      // out = log(in).
+  kSigmoidOp,  // out = sigmoid(in).
+  kTanhOp      // out = tanh(in).
+};
+
+enum SimdMathIsa {
+  kIsaNone,
+  kIsaAvx2,
+  kIsaAvx512,
+  kIsaNeon
+};
+
+SimdMathIsa DetectIsa() {
+#if defined(KALDI_SIMD_MATH_X86)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))
+    return kIsaAvx512;
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    return kIsaAvx2;
+  return kIsaNone;
+#elif defined(KALDI_SIMD_MATH_NEON)
+  return kIsaNeon;
+#else
+  return kIsaNone;
+#endif
+}
+
+const char *IsaName(SimdMathIsa isa) {
+  switch (isa) {
+    case kIsaAvx512: return "avx512f";
+    case kIsaAvx2: return "avx2";
+    case kIsaNeon: return "neon";
+    default: return "none";
+  }
+}
+
+SimdMathIsa DetectAndLogIsa() {
+  SimdMathIsa isa = DetectIsa();
+  if (isa == kIsaNone)
+    KALDI_LOG << "No supported SIMD instruction set found; the matrix library "
+              << "will use its scalar code.";
+  else
+    KALDI_LOG << "Using " << IsaName(isa) << " kernels in the matrix library.";
+  return isa;
+}
+
+SimdMathIsa GetIsa() {
+  static const SimdMathIsa isa = DetectAndLogIsa();
+  return isa;
+}
+
+// The value that we pad the last, partial vector with: one whose result is
+// finite and (for the sums) zero.
+template<int kOp> inline float PadValue() {
+  return (kOp == kExpOp || kOp == kSumExpOp ?
+          -std::numeric_limits<float>::infinity() :
+          (kOp == kLogOp ? 1.0f : 0.0f));
+}
+
+// The constants of the Cephes expf() and logf().  We clamp the input of exp()
+// to [kExpMin, kExpMax]: exp(kExpMin) rounds to zero and exp(kExpMax)
+// overflows.  2^n is applied in two factors so that the results that are
+// denormal or close to FLT_MAX come out right.
+const float kExpMin = -104.0f, kExpMax = 89.0f,
+    kLog2e = 1.44269504088896341f,
+    kLn2Hi = 0.693359375f, kLn2Lo = -2.12194440e-4f,
+    kExpP0 = 1.9875691500e-4f, kExpP1 = 1.3981999507e-3f,
+    kExpP2 = 8.3334519073e-3f, kExpP3 = 4.1665795894e-2f,
+    kExpP4 = 1.6666665459e-1f, kExpP5 = 5.0000001201e-1f;
+
+const float kSqrtHalf = 0.707106781186547524f,
+    kLogP0 = 7.0376836292e-2f, kLogP1 = -1.1514610310e-1f,
+    kLogP2 = 1.1676998740e-1f, kLogP3 = -1.2420140846e-1f,
+    kLogP4 = 1.4249322787e-1f, kLogP5 = -1.6668057665e-1f,
+    kLogP6 = 2.0000714765e-1f, kLogP7 = -2.4999993993e-1f,
+    kLogP8 = 3.3333331174e-1f,
+    kMinNormal = 1.17549435e-38f, kTwoTo23 = 8388608.0f;
+
+
+template<int kOp, typename Real>
+Real ApplyScalar(const Real *in, Real a, Real b, MatrixIndexT dim,
+                 Real *out) {
+  Real sum = 0.0;
+  for (MatrixIndexT i = 0; i < dim; i++) {
+    Real x = in[i];
+    switch (kOp) {
+      case kExpOp:
+        sum += (out[i] = Exp(x + a));
+        break;
+      case kSumExpOp:
+        if (x >= b)
+          sum += Exp(x + a);
+        break;
+      case kLogOp:
+        out[i] = Log(x);
+        break;
+      case kSigmoidOp:
+        // We aim to avoid floating-point overflow here.
+        if (x > 0.0) {
+          x = 1.0 / (1.0 + Exp(-x));
+        } else {
+          Real ex = Exp(x);
+          x = ex / (ex + 1.0);
+        }
+        out[i] = x;
+        break;
+      case kTanhOp:
+        if (x > 0.0) {
+          Real inv_expx = Exp(-x);
+          x = -1.0 + 2.0 / (1.0 + inv_expx * inv_expx);
+        } else {
+          Real expx = Exp(x);
+          x = 1.0 - 2.0 / (1.0 + expx * expx);
+        }
+        out[i] = x;
+        break;
+    }
+  }
+  return sum;
+}
+
+
+#if defined(KALDI_SIMD_MATH_X86)
+
+KALDI_TARGET_AVX2 inline __m256 Pow2Avx2(__m256i n) {
+  return _mm256_castsi256_ps(_mm256_slli_epi32(
+      _mm256_add_epi32(n, _mm256_set1_epi32(127)), 23));
+}
+
+KALDI_TARGET_AVX2 inline __m256 ExpAvx2(__m256 x) {
+  // The operand order of min and max makes a NaN input propagate.
+  x = _mm256_max_ps(_mm256_set1_ps(kExpMin),
+                    _mm256_min_ps(_mm256_set1_ps(kExpMax), x));
+  __m256 fx = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(kLog2e)),
+                              _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  __m256 r = _mm256_fnmadd_ps(fx, _mm256_set1_ps(kLn2Hi), x);
+  r = _mm256_fnmadd_ps(fx, _mm256_set1_ps(kLn2Lo), r);
+  __m256 y = _mm256_set1_ps(kExpP0);
+  y = _mm256_fmadd_ps(y, r, _mm256_set1_ps(kExpP1));
+  y = _mm256_fmadd_ps(y, r, _mm256_set1_ps(kExpP2));
+  y = _mm256_fmadd_ps(y, r, _mm256_set1_ps(kExpP3));
+  y = _mm256_fmadd_ps(y, r, _mm256_set1_ps(kExpP4));
+  y = _mm256_fmadd_ps(y, r, _mm256_set1_ps(kExpP5));
+  y = _mm256_fmadd_ps(y, _mm256_mul_ps(r, r), r);
+  y = _mm256_add_ps(y, _mm256_set1_ps(1.0f));
+  __m256i n = _mm256_cvtps_epi32(fx), n1 = _mm256_srai_epi32(n, 1),
+      n2 = _mm256_sub_epi32(n, n1);
+  return _mm256_mul_ps(_mm256_mul_ps(y, Pow2Avx2(n1)), Pow2Avx2(n2));
+}
+
+KALDI_TARGET_AVX2 inline __m256 LogAvx2(__m256 x) {
+  __m256 orig_x = x;
+  // Scale denormals up so they have the implicit leading 1.
+  __m256 denormal = _mm256_cmp_ps(x, _mm256_set1_ps(kMinNormal), _CMP_LT_OQ);
+  x = _mm256_blendv_ps(x, _mm256_mul_ps(x, _mm256_set1_ps(kTwoTo23)),
+                       denormal);
+  __m256i bits = _mm256_castps_si256(x);
+  __m256 e = _mm256_cvtepi32_ps(_mm256_sub_epi32(
+      _mm256_srli_epi32(bits, 23), _mm256_set1_epi32(126)));
+  e = _mm256_sub_ps(e, _mm256_and_ps(denormal, _mm256_set1_ps(23.0f)));
+  // The mantissa, in [0.5, 1).
+  __m256 m = _mm256_castsi256_ps(_mm256_or_si256(
+      _mm256_and_si256(bits, _mm256_set1_epi32(0x007FFFFF)),
+      _mm256_set1_epi32(0x3F000000)));
+  // If m < sqrt(0.5), use 2m - 1 and e - 1, else m - 1.
+  __m256 small = _mm256_cmp_ps(m, _mm256_set1_ps(kSqrtHalf), _CMP_LT_OQ);
+  e = _mm256_sub_ps(e, _mm256_and_ps(small, _mm256_set1_ps(1.0f)));
+  m = _mm256_add_ps(_mm256_sub_ps(m, _mm256_set1_ps(1.0f)),
+                    _mm256_and_ps(small, m));
+  __m256 z = _mm256_mul_ps(m, m);
+  __m256 y = _mm256_set1_ps(kLogP0);
+  y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(kLogP1));
+  y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(kLogP2));
+  y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(kLogP3));
+  y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(kLogP4));
+  y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(kLogP5));
+  y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(kLogP6));
+  y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(kLogP7));
+  y = _mm256_fmadd_ps(y, m, _mm256_set1_ps(kLogP8));
+  y = _mm256_mul_ps(_mm256_mul_ps(y, m), z);
+  y = _mm256_fmadd_ps(e, _mm256_set1_ps(kLn2Lo), y);
+  y = _mm256_fnmadd_ps(z, _mm256_set1_ps(0.5f), y);
+  __m256 ans = _mm256_add_ps(m, y);
+  ans = _mm256_fmadd_ps(e, _mm256_set1_ps(kLn2Hi), ans);
+  // Special cases: log(0) = -inf, log(inf) = inf, and NaN for x < 0 or NaN.
+  const float inf = std::numeric_limits<float>::infinity();
+  __m256 zero = _mm256_setzero_ps();
+  ans = _mm256_blendv_ps(ans, _mm256_set1_ps(-inf),
+                         _mm256_cmp_ps(orig_x, zero, _CMP_EQ_OQ));
+  ans = _mm256_blendv_ps(ans, orig_x,
+                         _mm256_cmp_ps(orig_x, _mm256_set1_ps(inf),
+                                       _CMP_EQ_OQ));
+  ans = _mm256_blendv_ps(ans,
+                         _mm256_set1_ps(std::numeric_limits<float>::quiet_NaN()),
+                         _mm256_cmp_ps(orig_x, zero, _CMP_NGE_UQ));
+  return ans;
+}
+
+// Does the operation on 8 elements; for the sums, adds to *acc.
+template<int kOp>
+KALDI_TARGET_AVX2 inline __m256 StepAvx2(__m256 x, float a, float b,
+                                         __m256 *acc) {
+  const __m256 sign_mask = _mm256_set1_ps(-0.0f), one = _mm256_set1_ps(1.0f);
+  switch (kOp) {
+    case kExpOp: {
+      __m256 y = ExpAvx2(_mm256_add_ps(x, _mm256_set1_ps(a)));
+      *acc = _mm256_add_ps(*acc, y);
+      return y;
+    }
+    case kSumExpOp: {
+      __m256 y = ExpAvx2(_mm256_add_ps(x, _mm256_set1_ps(a)));
+      *acc = _mm256_add_ps(*acc, _mm256_and_ps(
+          y, _mm256_cmp_ps(x, _mm256_set1_ps(b), _CMP_GE_OQ)));
+      return y;
+    }
+    case kLogOp:
+      return LogAvx2(x);
+    case kSigmoidOp: {
+      // e = exp(-|x|); sigmoid(x) is 1 / (1 + e) for x > 0, else e / (1 + e).
+      __m256 e = ExpAvx2(_mm256_or_ps(x, sign_mask)),
+          r = _mm256_div_ps(one, _mm256_add_ps(one, e));
+      return _mm256_blendv_ps(_mm256_mul_ps(e, r), r,
+                              _mm256_cmp_ps(x, _mm256_setzero_ps(),
+                                            _CMP_GT_OQ));
+    }
+    case kTanhOp: {
+      // e = exp(-2|x|); tanh(|x|) = -1 + 2 / (1 + e), and tanh is odd.
+      __m256 abs_x = _mm256_andnot_ps(sign_mask, x),
+          e = ExpAvx2(_mm256_mul_ps(abs_x, _mm256_set1_ps(-2.0f))),
+          t = _mm256_sub_ps(_mm256_div_ps(_mm256_set1_ps(2.0f),
+                                          _mm256_add_ps(one, e)), one);
+      return _mm256_or_ps(t, _mm256_and_ps(x, sign_mask));
+    }
+  }
+  return x;
+}
+
+template<int kOp>
+KALDI_TARGET_AVX2 float ApplyAvx2(const float *in, float a, float b,
+                                  MatrixIndexT dim, float *out) {
+  __m256 acc = _mm256_setzero_ps();
+  MatrixIndexT i = 0;
+  for (; i + 8 <= dim; i += 8) {
+    __m256 y = StepAvx2<kOp>(_mm256_loadu_ps(in + i), a, b, &acc);
+    if (kOp != kSumExpOp)
+      _mm256_storeu_ps(out + i, y);
+  }
+  if (i < dim) {
+    float buf[8];
+    MatrixIndexT n = dim - i;
+    for (MatrixIndexT j = 0; j < 8; j++)
+      buf[j] = (j < n ? in[i + j] : PadValue<kOp>());
+    _mm256_storeu_ps(buf, StepAvx2<kOp>(_mm256_loadu_ps(buf), a, b, &acc));
+    if (kOp != kSumExpOp)
+      for (MatrixIndexT j = 0; j < n; j++)
+        out[i + j] = buf[j];
+  }
+  float sums[8];
+  _mm256_storeu_ps(sums, acc);
+  float sum = 0.0;
+  for (int32 j = 0; j < 8; j++)
+    sum += sums[j];
+  return sum;
+}
+
+
+KALDI_TARGET_AVX512 inline __m512 Pow2Avx512(__m512i n) {
+  return _mm512_castsi512_ps(_mm512_slli_epi32(
+      _mm512_add_epi32(n, _mm512_set1_epi32(127)), 23));
+}
+
+KALDI_TARGET_AVX512 inline __m512 ExpAvx512(__m512 x) {
+  x = _mm512_max_ps(_mm512_set1_ps(kExpMin),
+                    _mm512_min_ps(_mm512_set1_ps(kExpMax), x));
+  __m512 fx = _mm512_roundscale_ps(_mm512_mul_ps(x, _mm512_set1_ps(kLog2e)),
+                                   _MM_FROUND_TO_NEAREST_INT |
+                                   _MM_FROUND_NO_EXC);
+  __m512 r = _mm512_fnmadd_ps(fx, _mm512_set1_ps(kLn2Hi), x);
+  r = _mm512_fnmadd_ps(fx, _mm512_set1_ps(kLn2Lo), r);
+  __m512 y = _mm512_set1_ps(kExpP0);
+  y = _mm512_fmadd_ps(y, r, _mm512_set1_ps(kExpP1));
+  y = _mm512_fmadd_ps(y, r, _mm512_set1_ps(kExpP2));
+  y = _mm512_fmadd_ps(y, r, _mm512_set1_ps(kExpP3));
+  y = _mm512_fmadd_ps(y, r, _mm512_set1_ps(kExpP4));
+  y = _mm512_fmadd_ps(y, r, _mm512_set1_ps(kExpP5));
+  y = _mm512_fmadd_ps(y, _mm512_mul_ps(r, r), r);
+  y = _mm512_add_ps(y, _mm512_set1_ps(1.0f));
+  __m512i n = _mm512_cvtps_epi32(fx), n1 = _mm512_srai_epi32(n, 1),
+      n2 = _mm512_sub_epi32(n, n1);
+  return _mm512_mul_ps(_mm512_mul_ps(y, Pow2Avx512(n1)), Pow2Avx512(n2));
+}
+
+KALDI_TARGET_AVX512 inline __m512 LogAvx512(__m512 x) {
+  __m512 orig_x = x;
+  __mmask16 denormal = _mm512_cmp_ps_mask(x, _mm512_set1_ps(kMinNormal),
+                                          _CMP_LT_OQ);
+  x = _mm512_mask_mul_ps(x, denormal, x, _mm512_set1_ps(kTwoTo23));
+  __m512i bits = _mm512_castps_si512(x);
+  __m512 e = _mm512_cvtepi32_ps(_mm512_sub_epi32(
+      _mm512_srli_epi32(bits, 23), _mm512_set1_epi32(126)));
+  e = _mm512_mask_sub_ps(e, denormal, e, _mm512_set1_ps(23.0f));
+  __m512 m = _mm512_castsi512_ps(_mm512_or_epi32(
+      _mm512_and_epi32(bits, _mm512_set1_epi32(0x007FFFFF)),
+      _mm512_set1_epi32(0x3F000000)));
+  __mmask16 small = _mm512_cmp_ps_mask(m, _mm512_set1_ps(kSqrtHalf),
+                                       _CMP_LT_OQ);
+  e = _mm512_mask_sub_ps(e, small, e, _mm512_set1_ps(1.0f));
+  __m512 m1 = _mm512_sub_ps(m, _mm512_set1_ps(1.0f));
+  m = _mm512_mask_add_ps(m1, small, m1, m);
+  __m512 z = _mm512_mul_ps(m, m);
+  __m512 y = _mm512_set1_ps(kLogP0);
+  y = _mm512_fmadd_ps(y, m, _mm512_set1_ps(kLogP1));
+  y = _mm512_fmadd_ps(y, m, _mm512_set1_ps(kLogP2));
+  y = _mm512_fmadd_ps(y, m, _mm512_set1_ps(kLogP3));
+  y = _mm512_fmadd_ps(y, m, _mm512_set1_ps(kLogP4));
+  y = _mm512_fmadd_ps(y, m, _mm512_set1_ps(kLogP5));
+  y = _mm512_fmadd_ps(y, m, _mm512_set1_ps(kLogP6));
+  y = _mm512_fmadd_ps(y, m, _mm512_set1_ps(kLogP7));
+  y = _mm512_fmadd_ps(y, m, _mm512_set1_ps(kLogP8));
+  y = _mm512_mul_ps(_mm512_mul_ps(y, m), z);
+  y = _mm512_fmadd_ps(e, _mm512_set1_ps(kLn2Lo), y);
+  y = _mm512_fnmadd_ps(z, _mm512_set1_ps(0.5f), y);
+  __m512 ans = _mm512_add_ps(m, y);
+  ans = _mm512_fmadd_ps(e, _mm512_set1_ps(kLn2Hi), ans);
+  const float inf = std::numeric_limits<float>::infinity();
+  __m512 zero = _mm512_setzero_ps();
+  ans = _mm512_mask_mov_ps(ans, _mm512_cmp_ps_mask(orig_x, zero, _CMP_EQ_OQ),
+                           _mm512_set1_ps(-inf));
+  ans = _mm512_mask_mov_ps(ans, _mm512_cmp_ps_mask(orig_x,
+                                                   _mm512_set1_ps(inf),
+                                                   _CMP_EQ_OQ),
+                           orig_x);
+  ans = _mm512_mask_mov_ps(ans, _mm512_cmp_ps_mask(orig_x, zero, _CMP_NGE_UQ),
+                           _mm512_set1_ps(
+                               std::numeric_limits<float>::quiet_NaN()));
+  return ans;
+}
+
+template<int kOp>
+KALDI_TARGET_AVX512 inline __m512 StepAvx512(__m512 x, float a, float b,
+                                             __m512 *acc) {
+  const __m512i sign_mask = _mm512_set1_epi32(0x80000000);
+  const __m512 one = _mm512_set1_ps(1.0f);
+  switch (kOp) {
+    case kExpOp: {
+      __m512 y = ExpAvx512(_mm512_add_ps(x, _mm512_set1_ps(a)));
+      *acc = _mm512_add_ps(*acc, y);
+      return y;
+    }
+    case kSumExpOp: {
+      __m512 y = ExpAvx512(_mm512_add_ps(x, _mm512_set1_ps(a)));
+      *acc = _mm512_mask_add_ps(*acc, _mm512_cmp_ps_mask(
+          x, _mm512_set1_ps(b), _CMP_GE_OQ), *acc, y);
+      return y;
+    }
+    case kLogOp:
+      return LogAvx512(x);
+    case kSigmoidOp: {
+      __m512 e = ExpAvx512(_mm512_castsi512_ps(_mm512_or_epi32(
+          _mm512_castps_si512(x), sign_mask))),
+          r = _mm512_div_ps(one, _mm512_add_ps(one, e));
+      return _mm512_mask_mov_ps(_mm512_mul_ps(e, r),
+                                _mm512_cmp_ps_mask(x, _mm512_setzero_ps(),
+                                                   _CMP_GT_OQ), r);
+    }
+    case kTanhOp: {
+      __m512i x_bits = _mm512_castps_si512(x);
+      __m512 abs_x = _mm512_castsi512_ps(_mm512_andnot_epi32(sign_mask,
+                                                             x_bits)),
+          e = ExpAvx512(_mm512_mul_ps(abs_x, _mm512_set1_ps(-2.0f))),
+          t = _mm512_sub_ps(_mm512_div_ps(_mm512_set1_ps(2.0f),
+                                          _mm512_add_ps(one, e)), one);
+      return _mm512_castsi512_ps(_mm512_or_epi32(
+          _mm512_castps_si512(t), _mm512_and_epi32(x_bits, sign_mask)));
+    }
+  }
+  return x;
+}
+
+template<int kOp>
+KALDI_TARGET_AVX512 float ApplyAvx512(const float *in, float a, float b,
+                                      MatrixIndexT dim, float *out) {
+  __m512 acc = _mm512_setzero_ps();
+  MatrixIndexT i = 0;
+  for (; i + 16 <= dim; i += 16) {
+    __m512 y = StepAvx512<kOp>(_mm512_loadu_ps(in + i), a, b, &acc);
+    if (kOp != kSumExpOp)
+      _mm512_storeu_ps(out + i, y);
+  }
+  if (i < dim) {
+    float buf[16];
+    MatrixIndexT n = dim - i;
+    for (MatrixIndexT j = 0; j < 16; j++)
+      buf[j] = (j < n ? in[i + j] : PadValue<kOp>());
+    _mm512_storeu_ps(buf, StepAvx512<kOp>(_mm512_loadu_ps(buf), a, b, &acc));
+    if (kOp != kSumExpOp)
+      for (MatrixIndexT j = 0; j < n; j++)
+        out[i + j] = buf[j];
+  }
+  float sums[16];
+  _mm512_storeu_ps(sums, acc);
+  float sum = 0.0;
+  for (int32 j = 0; j < 16; j++)
+    sum += sums[j];
+  return sum;
+}
+
+#endif  // KALDI_SIMD_MATH_X86
+
+
+#if defined(KALDI_SIMD_MATH_NEON)
+
+inline float32x4_t Pow2Neon(int32x4_t n) {
+  return vreinterpretq_f32_s32(vshlq_n_s32(vaddq_s32(n, vdupq_n_s32(127)),
+                                           23));
+}
+
+inline float32x4_t ExpNeon(float32x4_t x) {
+  // vmaxq_f32 and vminq_f32 propagate NaNs.
+  x = vmaxq_f32(vdupq_n_f32(kExpMin), vminq_f32(vdupq_n_f32(kExpMax), x));
+  float32x4_t fx = vrndnq_f32(vmulq_f32(x, vdupq_n_f32(kLog2e)));
+  float32x4_t r = vfmsq_f32(x, fx, vdupq_n_f32(kLn2Hi));
+  r = vfmsq_f32(r, fx, vdupq_n_f32(kLn2Lo));
+  float32x4_t y = vdupq_n_f32(kExpP0);
+  y = vfmaq_f32(vdupq_n_f32(kExpP1), y, r);
+  y = vfmaq_f32(vdupq_n_f32(kExpP2), y, r);
+  y = vfmaq_f32(vdupq_n_f32(kExpP3), y, r);
+  y = vfmaq_f32(vdupq_n_f32(kExpP4), y, r);
+  y = vfmaq_f32(vdupq_n_f32(kExpP5), y, r);
+  y = vfmaq_f32(r, y, vmulq_f32(r, r));
+  y = vaddq_f32(y, vdupq_n_f32(1.0f));
+  int32x4_t n = vcvtq_s32_f32(fx), n1 = vshrq_n_s32(n, 1),
+      n2 = vsubq_s32(n, n1);
+  return vmulq_f32(vmulq_f32(y, Pow2Neon(n1)), Pow2Neon(n2));
+}
+
+inline float32x4_t LogNeon(float32x4_t x) {
+  float32x4_t orig_x = x;
+  uint32x4_t denormal = vcltq_f32(x, vdupq_n_f32(kMinNormal));
+  x = vbslq_f32(denormal, vmulq_f32(x, vdupq_n_f32(kTwoTo23)), x);
+  int32x4_t bits = vreinterpretq_s32_f32(x);
+  float32x4_t e = vcvtq_f32_s32(vsubq_s32(
+      vreinterpretq_s32_u32(vshrq_n_u32(vreinterpretq_u32_s32(bits), 23)),
+      vdupq_n_s32(126)));
+  e = vbslq_f32(denormal, vsubq_f32(e, vdupq_n_f32(23.0f)), e);
+  float32x4_t m = vreinterpretq_f32_s32(vorrq_s32(
+      vandq_s32(bits, vdupq_n_s32(0x007FFFFF)), vdupq_n_s32(0x3F000000)));
+  uint32x4_t small = vcltq_f32(m, vdupq_n_f32(kSqrtHalf));
+  e = vbslq_f32(small, vsubq_f32(e, vdupq_n_f32(1.0f)), e);
+  float32x4_t m1 = vsubq_f32(m, vdupq_n_f32(1.0f));
+  m = vbslq_f32(small, vaddq_f32(m1, m), m1);
+  float32x4_t z = vmulq_f32(m, m);
+  float32x4_t y = vdupq_n_f32(kLogP0);
+  y = vfmaq_f32(vdupq_n_f32(kLogP1), y, m);
+  y = vfmaq_f32(vdupq_n_f32(kLogP2), y, m);
+  y = vfmaq_f32(vdupq_n_f32(kLogP3), y, m);
+  y = vfmaq_f32(vdupq_n_f32(kLogP4), y, m);
+  y = vfmaq_f32(vdupq_n_f32(kLogP5), y, m);
+  y = vfmaq_f32(vdupq_n_f32(kLogP6), y, m);
+  y = vfmaq_f32(vdupq_n_f32(kLogP7), y, m);
+  y = vfmaq_f32(vdupq_n_f32(kLogP8), y, m);
+  y = vmulq_f32(vmulq_f32(y, m), z);
+  y = vfmaq_f32(y, e, vdupq_n_f32(kLn2Lo));
+  y = vfmsq_f32(y, z, vdupq_n_f32(0.5f));
+  float32x4_t ans = vaddq_f32(m, y);
+  ans = vfmaq_f32(ans, e, vdupq_n_f32(kLn2Hi));
+  const float inf = std::numeric_limits<float>::infinity();
+  ans = vbslq_f32(vceqq_f32(orig_x, vdupq_n_f32(0.0f)), vdupq_n_f32(-inf),
+                  ans);
+  ans = vbslq_f32(vceqq_f32(orig_x, vdupq_n_f32(inf)), orig_x, ans);
+  // Not (x >= 0) is true for x < 0 and for NaN.
+  ans = vbslq_f32(vmvnq_u32(vcgeq_f32(orig_x, vdupq_n_f32(0.0f))),
+                  vdupq_n_f32(std::numeric_limits<float>::quiet_NaN()), ans);
+  return ans;
+}
+
+template<int kOp>
+inline float32x4_t StepNeon(float32x4_t x, float a, float b,
+                            float32x4_t *acc) {
+  const uint32x4_t sign_mask = vdupq_n_u32(0x80000000);
+  const float32x4_t one = vdupq_n_f32(1.0f);
+  switch (kOp) {
+    case kExpOp: {
+      float32x4_t y = ExpNeon(vaddq_f32(x, vdupq_n_f32(a)));
+      *acc = vaddq_f32(*acc, y);
+      return y;
+    }
+    case kSumExpOp: {
+      float32x4_t y = ExpNeon(vaddq_f32(x, vdupq_n_f32(a)));
+      *acc = vaddq_f32(*acc, vreinterpretq_f32_u32(vandq_u32(
+          vreinterpretq_u32_f32(y), vcgeq_f32(x, vdupq_n_f32(b)))));
+      return y;
+    }
+    case kLogOp:
+      return LogNeon(x);
+    case kSigmoidOp: {
+      float32x4_t e = ExpNeon(vnegq_f32(vabsq_f32(x))),
+          r = vdivq_f32(one, vaddq_f32(one, e));
+      return vbslq_f32(vcgtq_f32(x, vdupq_n_f32(0.0f)), r, vmulq_f32(e, r));
+    }
+    case kTanhOp: {
+      float32x4_t e = ExpNeon(vmulq_f32(vabsq_f32(x), vdupq_n_f32(-2.0f))),
+          t = vsubq_f32(vdivq_f32(vdupq_n_f32(2.0f), vaddq_f32(one, e)), one);
+      return vbslq_f32(sign_mask, x, t);
+    }
+  }
+  return x;
+}
+
+template<int kOp>
+float ApplyNeon(const float *in, float a, float b, MatrixIndexT dim,
+                float *out) {
+  float32x4_t acc = vdupq_n_f32(0.0f);
+  MatrixIndexT i = 0;
+  for (; i + 4 <= dim; i += 4) {
+    float32x4_t y = StepNeon<kOp>(vld1q_f32(in + i), a, b, &acc);
+    if (kOp != kSumExpOp)
+      vst1q_f32(out + i, y);
+  }
+  if (i < dim) {
+    float buf[4];
+    MatrixIndexT n = dim - i;
+    for (MatrixIndexT j = 0; j < 4; j++)
+      buf[j] = (j < n ? in[i + j] : PadValue<kOp>());
+    vst1q_f32(buf, StepNeon<kOp>(vld1q_f32(buf), a, b, &acc));
+    if (kOp != kSumExpOp)
+      for (MatrixIndexT j = 0; j < n; j++)
+        out[i + j] = buf[j];
+  }
+  return vaddvq_f32(acc);
+}
+
+#endif  // KALDI_SIMD_MATH_NEON
+
+
+// The kernels for the exact functions: SumVec(), MulElementsVec(),
+// AddVecVecVec(), FloorVec(), GatherVec() and the blocks of TransposeMat().  The scalar
+// versions deal with the elements that are left over after the SIMD loops.
+
+template<typename Real>
+Real SumScalar(const Real *in, MatrixIndexT dim) {
+  Real sum = 0.0;
+  for (MatrixIndexT i = 0; i < dim; i++)
+    sum += in[i];
+  return sum;
+}
+
+template<typename Real>
+void MulElementsScalar(const Real *in, MatrixIndexT dim, Real *out) {
+  for (MatrixIndexT i = 0; i < dim; i++)
+    out[i] *= in[i];
+}
+
+template<typename Real>
+void AddVecVecVecScalar(Real alpha, const Real *v, const Real *r, Real beta,
+                        MatrixIndexT dim, Real *out) {
+  if (beta == 0.0) {
+    for (MatrixIndexT i = 0; i < dim; i++)
+      out[i] = alpha * v[i] * r[i];
+  } else {
+    for (MatrixIndexT i = 0; i < dim; i++)
+      out[i] = beta * out[i] + alpha * v[i] * r[i];
+  }
+}
+
+template<typename Real>
+MatrixIndexT FloorScalar(const Real *in, Real floor_val, MatrixIndexT dim,
+                         Real *out) {
+  MatrixIndexT num_floored = 0;
+  for (MatrixIndexT i = 0; i < dim; i++) {
+    if (in[i] < floor_val) {
+      out[i] = floor_val;
+      num_floored++;
+    } else {
+      out[i] = in[i];
+    }
+  }
+  return num_floored;
+}
+
+template<typename Real>
+void GatherScalar(Real alpha, const Real *in, const int32 *map,
+                  const int32 *indexes, MatrixIndexT dim, Real *out) {
+  if (map == NULL) {
+    for (MatrixIndexT i = 0; i < dim; i++)
+      out[i] = alpha * in[indexes[i]];
+  } else {
+    for (MatrixIndexT i = 0; i < dim; i++)
+      out[i] = alpha * in[map[indexes[i]]];
+  }
+}
+
+// Transposes the square blocks of size 'block_size'; see TransposeTiled().
+typedef void (*TransposeBlockFunc)(const void *in, MatrixIndexT in_stride,
+                                   void *out, MatrixIndexT out_stride);
+
+// Transposes the matrix in tiles small enough that the rows of the input and
+// output tiles stay in the L1 cache, and within each tile in blocks of
+// block_size by block_size, using 'block_func' if it is not NULL.
+template<typename Real>
+void TransposeTiled(const Real *in, MatrixIndexT in_stride,
+                    MatrixIndexT num_rows, MatrixIndexT num_cols,
+                    Real *out, MatrixIndexT out_stride,
+                    MatrixIndexT block_size, TransposeBlockFunc block_func) {
+  const MatrixIndexT kTileSize = 32;
+  for (MatrixIndexT r0 = 0; r0 < num_rows; r0 += kTileSize) {
+    MatrixIndexT r_end = std::min(r0 + kTileSize, num_rows);
+    for (MatrixIndexT c0 = 0; c0 < num_cols; c0 += kTileSize) {
+      MatrixIndexT c_end = std::min(c0 + kTileSize, num_cols), r = r0;
+      if (block_func != NULL) {
+        for (; r + block_size <= r_end; r += block_size) {
+          MatrixIndexT c = c0;
+          for (; c + block_size <= c_end; c += block_size)
+            block_func(in + r * in_stride + c, in_stride,
+                       out + c * out_stride + r, out_stride);
+          for (MatrixIndexT i = r; i < r + block_size; i++)
+            for (MatrixIndexT j = c; j < c_end; j++)
+              out[j * out_stride + i] = in[i * in_stride + j];
+        }
+      }
+      for (; r < r_end; r++)
+        for (MatrixIndexT j = c0; j < c_end; j++)
+          out[j * out_stride + r] = in[r * in_stride + j];
+    }
+  }
+}
+
+
+// The kernels for the quantization of CompressedMatrix: IntToFloat sets
+// out[i] = min_value + in[i] * increment, and FloatToInt sets out[i] to
+// f * kMax rounded to the closest integer, where f = (in[i] - min_value) /
+// range limited to [0, 1].  The arithmetic is the same as in
+// CompressedMatrix::FloatToUint16() etc., including the addition of 0.499 in
+// double precision.
+template<typename Int>
+void IntToFloatScalar(const Int *in, float min_value, float increment,
+                      MatrixIndexT dim, float *out) {
+  for (MatrixIndexT i = 0; i < dim; i++)
+    out[i] = min_value + in[i] * increment;
+}
+
+template<int kMax, typename Int>
+void FloatToIntScalar(const float *in, float min_value, float range,
+                      MatrixIndexT dim, Int *out) {
+  for (MatrixIndexT i = 0; i < dim; i++) {
+    float f = (in[i] - min_value) / range;
+    if (f > 1.0) f = 1.0;
+    if (f < 0.0) f = 0.0;
+    out[i] = static_cast<int>(f * kMax + 0.499);
+  }
+}
+
+
+#if defined(KALDI_SIMD_MATH_X86)
+
+KALDI_TARGET_AVX2 inline double HorizontalSumAvx2(__m256d x) {
+  double sums[4];
+  _mm256_storeu_pd(sums, x);
+  return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+}
+
+KALDI_TARGET_AVX2 inline float HorizontalSumAvx2(__m256 x) {
+  float sums[8];
+  _mm256_storeu_ps(sums, x);
+  return ((sums[0] + sums[1]) + (sums[2] + sums[3])) +
+      ((sums[4] + sums[5]) + (sums[6] + sums[7]));
+}
+
+KALDI_TARGET_AVX2 float SumAvx2(const float *in, MatrixIndexT dim) {
+  __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+  MatrixIndexT i = 0;
+  for (; i + 16 <= dim; i += 16) {
+    acc0 = _mm256_add_ps(acc0, _mm256_loadu_ps(in + i));
+    acc1 = _mm256_add_ps(acc1, _mm256_loadu_ps(in + i + 8));
+  }
+  return HorizontalSumAvx2(_mm256_add_ps(acc0, acc1)) +
+      SumScalar(in + i, dim - i);
+}
+
+KALDI_TARGET_AVX2 double SumAvx2(const double *in, MatrixIndexT dim) {
+  __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+  MatrixIndexT i = 0;
+  for (; i + 8 <= dim; i += 8) {
+    acc0 = _mm256_add_pd(acc0, _mm256_loadu_pd(in + i));
+    acc1 = _mm256_add_pd(acc1, _mm256_loadu_pd(in + i + 4));
+  }
+  return HorizontalSumAvx2(_mm256_add_pd(acc0, acc1)) +
+      SumScalar(in + i, dim - i);
+}
+
+KALDI_TARGET_AVX2 void MulElementsAvx2(const float *in, MatrixIndexT dim,
+                                       float *out) {
+  MatrixIndexT i = 0;
+  for (; i + 8 <= dim; i += 8)
+    _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_loadu_ps(out + i),
+                                            _mm256_loadu_ps(in + i)));
+  MulElementsScalar(in + i, dim - i, out + i);
+}
+
+KALDI_TARGET_AVX2 void MulElementsAvx2(const double *in, MatrixIndexT dim,
+                                       double *out) {
+  MatrixIndexT i = 0;
+  for (; i + 4 <= dim; i += 4)
+    _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_loadu_pd(out + i),
+                                            _mm256_loadu_pd(in + i)));
+  MulElementsScalar(in + i, dim - i, out + i);
+}
+
+KALDI_TARGET_AVX2 void AddVecVecVecAvx2(float alpha, const float *v,
+                                        const float *r, float beta,
+                                        MatrixIndexT dim, float *out) {
+  __m256 a = _mm256_set1_ps(alpha), b = _mm256_set1_ps(beta);
+  MatrixIndexT i = 0;
+  if (beta == 0.0) {
+    for (; i + 8 <= dim; i += 8)
+      _mm256_storeu_ps(out + i, _mm256_mul_ps(
+          _mm256_mul_ps(a, _mm256_loadu_ps(v + i)), _mm256_loadu_ps(r + i)));
+  } else {
+    for (; i + 8 <= dim; i += 8)
+      _mm256_storeu_ps(out + i, _mm256_fmadd_ps(
+          _mm256_mul_ps(a, _mm256_loadu_ps(v + i)), _mm256_loadu_ps(r + i),
+          _mm256_mul_ps(b, _mm256_loadu_ps(out + i))));
+  }
+  AddVecVecVecScalar(alpha, v + i, r + i, beta, dim - i, out + i);
+}
+
+KALDI_TARGET_AVX2 void AddVecVecVecAvx2(double alpha, const double *v,
+                                        const double *r, double beta,
+                                        MatrixIndexT dim, double *out) {
+  __m256d a = _mm256_set1_pd(alpha), b = _mm256_set1_pd(beta);
+  MatrixIndexT i = 0;
+  if (beta == 0.0) {
+    for (; i + 4 <= dim; i += 4)
+      _mm256_storeu_pd(out + i, _mm256_mul_pd(
+          _mm256_mul_pd(a, _mm256_loadu_pd(v + i)), _mm256_loadu_pd(r + i)));
+  } else {
+    for (; i + 4 <= dim; i += 4)
+      _mm256_storeu_pd(out + i, _mm256_fmadd_pd(
+          _mm256_mul_pd(a, _mm256_loadu_pd(v + i)), _mm256_loadu_pd(r + i),
+          _mm256_mul_pd(b, _mm256_loadu_pd(out + i))));
+  }
+  AddVecVecVecScalar(alpha, v + i, r + i, beta, dim - i, out + i);
+}
+
+KALDI_TARGET_AVX2 MatrixIndexT FloorAvx2(const float *in, float floor_val,
+                                         MatrixIndexT dim, float *out) {
+  __m256 f = _mm256_set1_ps(floor_val);
+  MatrixIndexT i = 0, num_floored = 0;
+  for (; i + 8 <= dim; i += 8) {
+    __m256 x = _mm256_loadu_ps(in + i);
+    num_floored += __builtin_popcount(_mm256_movemask_ps(
+        _mm256_cmp_ps(x, f, _CMP_LT_OQ)));
+    // With this operand order, NaNs are passed through.
+    _mm256_storeu_ps(out + i, _mm256_max_ps(f, x));
+  }
+  return num_floored + FloorScalar(in + i, floor_val, dim - i, out + i);
+}
+
+KALDI_TARGET_AVX2 MatrixIndexT FloorAvx2(const double *in, double floor_val,
+                                         MatrixIndexT dim, double *out) {
+  __m256d f = _mm256_set1_pd(floor_val);
+  MatrixIndexT i = 0, num_floored = 0;
+  for (; i + 4 <= dim; i += 4) {
+    __m256d x = _mm256_loadu_pd(in + i);
+    num_floored += __builtin_popcount(_mm256_movemask_pd(
+        _mm256_cmp_pd(x, f, _CMP_LT_OQ)));
+    _mm256_storeu_pd(out + i, _mm256_max_pd(f, x));
+  }
+  return num_floored + FloorScalar(in + i, floor_val, dim - i, out + i);
+}
+
+KALDI_TARGET_AVX2 void GatherAvx2(float alpha, const float *in,
+                                  const int32 *map, const int32 *indexes,
+                                  MatrixIndexT dim, float *out) {
+  __m256 a = _mm256_set1_ps(alpha);
+  MatrixIndexT i = 0;
+  for (; i + 8 <= dim; i += 8) {
+    __m256i idx = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(indexes + i));
+    if (map != NULL)
+      idx = _mm256_i32gather_epi32(map, idx, 4);
+    _mm256_storeu_ps(out + i, _mm256_mul_ps(a, _mm256_i32gather_ps(in, idx,
+                                                                   4)));
+  }
+  GatherScalar(alpha, in, map, indexes + i, dim - i, out + i);
+}
+
+KALDI_TARGET_AVX2 void GatherAvx2(double alpha, const double *in,
+                                  const int32 *map, const int32 *indexes,
+                                  MatrixIndexT dim, double *out) {
+  __m256d a = _mm256_set1_pd(alpha);
+  MatrixIndexT i = 0;
+  for (; i + 4 <= dim; i += 4) {
+    __m128i idx = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(indexes + i));
+    if (map != NULL)
+      idx = _mm_i32gather_epi32(map, idx, 4);
+    _mm256_storeu_pd(out + i, _mm256_mul_pd(a, _mm256_i32gather_pd(in, idx,
+                                                                   8)));
+  }
+  GatherScalar(alpha, in, map, indexes + i, dim - i, out + i);
+}
+
+KALDI_TARGET_AVX2 void TransposeBlockAvx2Float(const void *in_void,
+                                               MatrixIndexT in_stride,
+                                               void *out_void,
+                                               MatrixIndexT out_stride) {
+  const float *in = static_cast<const float*>(in_void);
+  float *out = static_cast<float*>(out_void);
+  __m256 r0 = _mm256_loadu_ps(in), r1 = _mm256_loadu_ps(in + in_stride),
+      r2 = _mm256_loadu_ps(in + 2 * in_stride),
+      r3 = _mm256_loadu_ps(in + 3 * in_stride),
+      r4 = _mm256_loadu_ps(in + 4 * in_stride),
+      r5 = _mm256_loadu_ps(in + 5 * in_stride),
+      r6 = _mm256_loadu_ps(in + 6 * in_stride),
+      r7 = _mm256_loadu_ps(in + 7 * in_stride);
+  __m256 t0 = _mm256_unpacklo_ps(r0, r1), t1 = _mm256_unpackhi_ps(r0, r1),
+      t2 = _mm256_unpacklo_ps(r2, r3), t3 = _mm256_unpackhi_ps(r2, r3),
+      t4 = _mm256_unpacklo_ps(r4, r5), t5 = _mm256_unpackhi_ps(r4, r5),
+      t6 = _mm256_unpacklo_ps(r6, r7), t7 = _mm256_unpackhi_ps(r6, r7);
+  __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0)),
+      s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2)),
+      s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0)),
+      s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2)),
+      s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0)),
+      s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2)),
+      s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0)),
+      s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+  _mm256_storeu_ps(out, _mm256_permute2f128_ps(s0, s4, 0x20));
+  _mm256_storeu_ps(out + out_stride, _mm256_permute2f128_ps(s1, s5, 0x20));
+  _mm256_storeu_ps(out + 2 * out_stride,
+                   _mm256_permute2f128_ps(s2, s6, 0x20));
+  _mm256_storeu_ps(out + 3 * out_stride,
+                   _mm256_permute2f128_ps(s3, s7, 0x20));
+  _mm256_storeu_ps(out + 4 * out_stride,
+                   _mm256_permute2f128_ps(s0, s4, 0x31));
+  _mm256_storeu_ps(out + 5 * out_stride,
+                   _mm256_permute2f128_ps(s1, s5, 0x31));
+  _mm256_storeu_ps(out + 6 * out_stride,
+                   _mm256_permute2f128_ps(s2, s6, 0x31));
+  _mm256_storeu_ps(out + 7 * out_stride,
+                   _mm256_permute2f128_ps(s3, s7, 0x31));
+}
+
+KALDI_TARGET_AVX2 void TransposeBlockAvx2Double(const void *in_void,
+                                                MatrixIndexT in_stride,
+                                                void *out_void,
+                                                MatrixIndexT out_stride) {
+  const double *in = static_cast<const double*>(in_void);
+  double *out = static_cast<double*>(out_void);
+  __m256d r0 = _mm256_loadu_pd(in), r1 = _mm256_loadu_pd(in + in_stride),
+      r2 = _mm256_loadu_pd(in + 2 * in_stride),
+      r3 = _mm256_loadu_pd(in + 3 * in_stride);
+  __m256d t0 = _mm256_unpacklo_pd(r0, r1), t1 = _mm256_unpackhi_pd(r0, r1),
+      t2 = _mm256_unpacklo_pd(r2, r3), t3 = _mm256_unpackhi_pd(r2, r3);
+  _mm256_storeu_pd(out, _mm256_permute2f128_pd(t0, t2, 0x20));
+  _mm256_storeu_pd(out + out_stride, _mm256_permute2f128_pd(t1, t3, 0x20));
+  _mm256_storeu_pd(out + 2 * out_stride,
+                   _mm256_permute2f128_pd(t0, t2, 0x31));
+  _mm256_storeu_pd(out + 3 * out_stride,
+                   _mm256_permute2f128_pd(t1, t3, 0x31));
+}
+
+
+// For AVX-512 we only have the loops; the transposes use the AVX2 blocks.
+
+KALDI_TARGET_AVX512 inline double HorizontalSumAvx512(__m512d x) {
+  double sums[8];
+  _mm512_storeu_pd(sums, x);
+  return ((sums[0] + sums[1]) + (sums[2] + sums[3])) +
+      ((sums[4] + sums[5]) + (sums[6] + sums[7]));
+}
+
+KALDI_TARGET_AVX512 inline float HorizontalSumAvx512(__m512 x) {
+  float sums[16];
+  _mm512_storeu_ps(sums, x);
+  float sum = 0.0;
+  for (int32 j = 0; j < 16; j++)
+    sum += sums[j];
+  return sum;
+}
+
+KALDI_TARGET_AVX512 float SumAvx512(const float *in, MatrixIndexT dim) {
+  __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+  MatrixIndexT i = 0;
+  for (; i + 32 <= dim; i += 32) {
+    acc0 = _mm512_add_ps(acc0, _mm512_loadu_ps(in + i));
+    acc1 = _mm512_add_ps(acc1, _mm512_loadu_ps(in + i + 16));
+  }
+  return HorizontalSumAvx512(_mm512_add_ps(acc0, acc1)) +
+      SumScalar(in + i, dim - i);
+}
+
+KALDI_TARGET_AVX512 double SumAvx512(const double *in, MatrixIndexT dim) {
+  __m512d acc0 = _mm512_setzero_pd(), acc1 = _mm512_setzero_pd();
+  MatrixIndexT i = 0;
+  for (; i + 16 <= dim; i += 16) {
+    acc0 = _mm512_add_pd(acc0, _mm512_loadu_pd(in + i));
+    acc1 = _mm512_add_pd(acc1, _mm512_loadu_pd(in + i + 8));
+  }
+  return HorizontalSumAvx512(_mm512_add_pd(acc0, acc1)) +
+      SumScalar(in + i, dim - i);
+}
+
+KALDI_TARGET_AVX512 void MulElementsAvx512(const float *in, MatrixIndexT dim,
+                                           float *out) {
+  MatrixIndexT i = 0;
+  for (; i + 16 <= dim; i += 16)
+    _mm512_storeu_ps(out + i, _mm512_mul_ps(_mm512_loadu_ps(out + i),
+                                            _mm512_loadu_ps(in + i)));
+  MulElementsScalar(in + i, dim - i, out + i);
+}
+
+KALDI_TARGET_AVX512 void MulElementsAvx512(const double *in, MatrixIndexT dim,
+                                           double *out) {
+  MatrixIndexT i = 0;
+  for (; i + 8 <= dim; i += 8)
+    _mm512_storeu_pd(out + i, _mm512_mul_pd(_mm512_loadu_pd(out + i),
+                                            _mm512_loadu_pd(in + i)));
+  MulElementsScalar(in + i, dim - i, out + i);
+}
+
+KALDI_TARGET_AVX512 void AddVecVecVecAvx512(float alpha, const float *v,
+                                            const float *r, float beta,
+                                            MatrixIndexT dim, float *out) {
+  __m512 a = _mm512_set1_ps(alpha), b = _mm512_set1_ps(beta);
+  MatrixIndexT i = 0;
+  if (beta == 0.0) {
+    for (; i + 16 <= dim; i += 16)
+      _mm512_storeu_ps(out + i, _mm512_mul_ps(
+          _mm512_mul_ps(a, _mm512_loadu_ps(v + i)), _mm512_loadu_ps(r + i)));
+  } else {
+    for (; i + 16 <= dim; i += 16)
+      _mm512_storeu_ps(out + i, _mm512_fmadd_ps(
+          _mm512_mul_ps(a, _mm512_loadu_ps(v + i)), _mm512_loadu_ps(r + i),
+          _mm512_mul_ps(b, _mm512_loadu_ps(out + i))));
+  }
+  AddVecVecVecScalar(alpha, v + i, r + i, beta, dim - i, out + i);
+}
+
+KALDI_TARGET_AVX512 void AddVecVecVecAvx512(double alpha, const double *v,
+                                            const double *r, double beta,
+                                            MatrixIndexT dim, double *out) {
+  __m512d a = _mm512_set1_pd(alpha), b = _mm512_set1_pd(beta);
+  MatrixIndexT i = 0;
+  if (beta == 0.0) {
+    for (; i + 8 <= dim; i += 8)
+      _mm512_storeu_pd(out + i, _mm512_mul_pd(
+          _mm512_mul_pd(a, _mm512_loadu_pd(v + i)), _mm512_loadu_pd(r + i)));
+  } else {
+    for (; i + 8 <= dim; i += 8)
+      _mm512_storeu_pd(out + i, _mm512_fmadd_pd(
+          _mm512_mul_pd(a, _mm512_loadu_pd(v + i)), _mm512_loadu_pd(r + i),
+          _mm512_mul_pd(b, _mm512_loadu_pd(out + i))));
+  }
+  AddVecVecVecScalar(alpha, v + i, r + i, beta, dim - i, out + i);
+}
+
+KALDI_TARGET_AVX512 MatrixIndexT FloorAvx512(const float *in, float floor_val,
+                                             MatrixIndexT dim, float *out) {
+  __m512 f = _mm512_set1_ps(floor_val);
+  MatrixIndexT i = 0, num_floored = 0;
+  for (; i + 16 <= dim; i += 16) {
+    __m512 x = _mm512_loadu_ps(in + i);
+    num_floored += __builtin_popcount(_mm512_cmp_ps_mask(x, f, _CMP_LT_OQ));
+    _mm512_storeu_ps(out + i, _mm512_max_ps(f, x));
+  }
+  return num_floored + FloorScalar(in + i, floor_val, dim - i, out + i);
+}
+
+KALDI_TARGET_AVX512 MatrixIndexT FloorAvx512(const double *in,
+                                             double floor_val,
+                                             MatrixIndexT dim, double *out) {
+  __m512d f = _mm512_set1_pd(floor_val);
+  MatrixIndexT i = 0, num_floored = 0;
+  for (; i + 8 <= dim; i += 8) {
+    __m512d x = _mm512_loadu_pd(in + i);
+    num_floored += __builtin_popcount(_mm512_cmp_pd_mask(x, f, _CMP_LT_OQ));
+    _mm512_storeu_pd(out + i, _mm512_max_pd(f, x));
+  }
+  return num_floored + FloorScalar(in + i, floor_val, dim - i, out + i);
+}
+
+KALDI_TARGET_AVX512 void GatherAvx512(float alpha, const float *in,
+                                      const int32 *map, const int32 *indexes,
+                                      MatrixIndexT dim, float *out) {
+  __m512 a = _mm512_set1_ps(alpha);
+  MatrixIndexT i = 0;
+  for (; i + 16 <= dim; i += 16) {
+    __m512i idx = _mm512_loadu_si512(indexes + i);
+    if (map != NULL)
+      idx = _mm512_i32gather_epi32(idx, map, 4);
+    _mm512_storeu_ps(out + i, _mm512_mul_ps(a, _mm512_i32gather_ps(idx, in,
+                                                                   4)));
+  }
+  GatherScalar(alpha, in, map, indexes + i, dim - i, out + i);
+}
+
+KALDI_TARGET_AVX512 void GatherAvx512(double alpha, const double *in,
+                                      const int32 *map, const int32 *indexes,
+                                      MatrixIndexT dim, double *out) {
+  __m512d a = _mm512_set1_pd(alpha);
+  MatrixIndexT i = 0;
+  for (; i + 8 <= dim; i += 8) {
+    __m256i idx = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(indexes + i));
+    if (map != NULL)
+      idx = _mm256_i32gather_epi32(map, idx, 4);
+    _mm512_storeu_pd(out + i, _mm512_mul_pd(a, _mm512_i32gather_pd(idx, in,
+                                                                   8)));
+  }
+  GatherScalar(alpha, in, map, indexes + i, dim - i, out + i);
+}
+
+KALDI_TARGET_AVX2 void IntToFloatAvx2(const uint8 *in, float min_value,
+                                      float increment, MatrixIndexT dim,
+                                      float *out) {
+  __m256 m = _mm256_set1_ps(min_value), inc = _mm256_set1_ps(increment);
+  MatrixIndexT i = 0;
+  for (; i + 8 <= dim; i += 8) {
+    __m256i x = _mm256_cvtepu8_epi32(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(in + i)));
+    _mm256_storeu_ps(out + i, _mm256_add_ps(
+        m, _mm256_mul_ps(_mm256_cvtepi32_ps(x), inc)));
+  }
+  IntToFloatScalar(in + i, min_value, increment, dim - i, out + i);
+}
+
+KALDI_TARGET_AVX2 void IntToFloatAvx2(const uint16 *in, float min_value,
+                                      float increment, MatrixIndexT dim,
+                                      float *out) {
+  __m256 m = _mm256_set1_ps(min_value), inc = _mm256_set1_ps(increment);
+  MatrixIndexT i = 0;
+  for (; i + 8 <= dim; i += 8) {
+    __m256i x = _mm256_cvtepu16_epi32(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)));
+    _mm256_storeu_ps(out + i, _mm256_add_ps(
+        m, _mm256_mul_ps(_mm256_cvtepi32_ps(x), inc)));
+  }
+  IntToFloatScalar(in + i, min_value, increment, dim - i, out + i);
+}
+
+// Computes the integers of FloatToIntScalar() for 8 elements, as int32 in
+// two halves.
+template<int kMax>
+KALDI_TARGET_AVX2 inline void FloatToIntAvx2Block(const float *in, __m256 m,
+                                                  __m256 range, __m128i *lo,
+                                                  __m128i *hi) {
+  __m256 f = _mm256_div_ps(_mm256_sub_ps(_mm256_loadu_ps(in), m), range);
+  f = _mm256_max_ps(_mm256_min_ps(f, _mm256_set1_ps(1.0)),
+                    _mm256_setzero_ps());
+  f = _mm256_mul_ps(f, _mm256_set1_ps(kMax));
+  __m256d half = _mm256_set1_pd(0.499);
+  *lo = _mm256_cvttpd_epi32(_mm256_add_pd(
+      _mm256_cvtps_pd(_mm256_castps256_ps128(f)), half));
+  *hi = _mm256_cvttpd_epi32(_mm256_add_pd(
+      _mm256_cvtps_pd(_mm256_extractf128_ps(f, 1)), half));
+}
+
+KALDI_TARGET_AVX2 void FloatToIntAvx2(const float *in, float min_value,
+                                      float range, MatrixIndexT dim,
+                                      uint8 *out) {
+  __m256 m = _mm256_set1_ps(min_value), r = _mm256_set1_ps(range);
+  MatrixIndexT i = 0;
+  for (; i + 8 <= dim; i += 8) {
+    __m128i lo, hi;
+    FloatToIntAvx2Block<255>(in + i, m, r, &lo, &hi);
+    __m128i x = _mm_packus_epi32(lo, hi);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(out + i),
+                     _mm_packus_epi16(x, x));
+  }
+  FloatToIntScalar<255>(in + i, min_value, range, dim - i, out + i);
+}
+
+KALDI_TARGET_AVX2 void FloatToIntAvx2(const float *in, float min_value,
+                                      float range, MatrixIndexT dim,
+                                      uint16 *out) {
+  __m256 m = _mm256_set1_ps(min_value), r = _mm256_set1_ps(range);
+  MatrixIndexT i = 0;
+  for (; i + 8 <= dim; i += 8) {
+    __m128i lo, hi;
+    FloatToIntAvx2Block<65535>(in + i, m, r, &lo, &hi);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                     _mm_packus_epi32(lo, hi));
+  }
+  FloatToIntScalar<65535>(in + i, min_value, range, dim - i, out + i);
+}
+
+#endif  // KALDI_SIMD_MATH_X86
+
+
+#if defined(KALDI_SIMD_MATH_NEON)
+
+float SumNeon(const float *in, MatrixIndexT dim) {
+  float32x4_t acc0 = vdupq_n_f32(0.0f), acc1 = vdupq_n_f32(0.0f);
+  MatrixIndexT i = 0;
+  for (; i + 8 <= dim; i += 8) {
+    acc0 = vaddq_f32(acc0, vld1q_f32(in + i));
+    acc1 = vaddq_f32(acc1, vld1q_f32(in + i + 4));
+  }
+  return vaddvq_f32(vaddq_f32(acc0, acc1)) + SumScalar(in + i, dim - i);
+}
+
+double SumNeon(const double *in, MatrixIndexT dim) {
+  float64x2_t acc0 = vdupq_n_f64(0.0), acc1 = vdupq_n_f64(0.0);
+  MatrixIndexT i = 0;
+  for (; i + 4 <= dim; i += 4) {
+    acc0 = vaddq_f64(acc0, vld1q_f64(in + i));
+    acc1 = vaddq_f64(acc1, vld1q_f64(in + i + 2));
+  }
+  return vaddvq_f64(vaddq_f64(acc0, acc1)) + SumScalar(in + i, dim - i);
+}
+
+void MulElementsNeon(const float *in, MatrixIndexT dim, float *out) {
+  MatrixIndexT i = 0;
+  for (; i + 4 <= dim; i += 4)
+    vst1q_f32(out + i, vmulq_f32(vld1q_f32(out + i), vld1q_f32(in + i)));
+  MulElementsScalar(in + i, dim - i, out + i);
+}
+
+void MulElementsNeon(const double *in, MatrixIndexT dim, double *out) {
+  MatrixIndexT i = 0;
+  for (; i + 2 <= dim; i += 2)
+    vst1q_f64(out + i, vmulq_f64(vld1q_f64(out + i), vld1q_f64(in + i)));
+  MulElementsScalar(in + i, dim - i, out + i);
+}
+
+void AddVecVecVecNeon(float alpha, const float *v, const float *r,
+                      float beta, MatrixIndexT dim, float *out) {
+  MatrixIndexT i = 0;
+  if (beta == 0.0) {
+    for (; i + 4 <= dim; i += 4)
+      vst1q_f32(out + i, vmulq_f32(vmulq_n_f32(vld1q_f32(v + i), alpha),
+                                   vld1q_f32(r + i)));
+  } else {
+    for (; i + 4 <= dim; i += 4)
+      vst1q_f32(out + i, vfmaq_f32(vmulq_n_f32(vld1q_f32(out + i), beta),
+                                   vmulq_n_f32(vld1q_f32(v + i), alpha),
+                                   vld1q_f32(r + i)));
+  }
+  AddVecVecVecScalar(alpha, v + i, r + i, beta, dim - i, out + i);
+}
+
+void AddVecVecVecNeon(double alpha, const double *v, const double *r,
+                      double beta, MatrixIndexT dim, double *out) {
+  MatrixIndexT i = 0;
+  if (beta == 0.0) {
+    for (; i + 2 <= dim; i += 2)
+      vst1q_f64(out + i, vmulq_f64(vmulq_n_f64(vld1q_f64(v + i), alpha),
+                                   vld1q_f64(r + i)));
+  } else {
+    for (; i + 2 <= dim; i += 2)
+      vst1q_f64(out + i, vfmaq_f64(vmulq_n_f64(vld1q_f64(out + i), beta),
+                                   vmulq_n_f64(vld1q_f64(v + i), alpha),
+                                   vld1q_f64(r + i)));
+  }
+  AddVecVecVecScalar(alpha, v + i, r + i, beta, dim - i, out + i);
+}
+
+MatrixIndexT FloorNeon(const float *in, float floor_val, MatrixIndexT dim,
+                       float *out) {
+  float32x4_t f = vdupq_n_f32(floor_val);
+  uint32x4_t count = vdupq_n_u32(0);
+  MatrixIndexT i = 0;
+  for (; i + 4 <= dim; i += 4) {
+    float32x4_t x = vld1q_f32(in + i);
+    uint32x4_t floored = vcltq_f32(x, f);
+    // The mask is all ones (-1) where x < f.
+    count = vsubq_u32(count, floored);
+    // vbslq rather than vmaxq, which would turn NaNs into floor_val.
+    vst1q_f32(out + i, vbslq_f32(floored, f, x));
+  }
+  return vaddvq_u32(count) + FloorScalar(in + i, floor_val, dim - i, out + i);
+}
+
+MatrixIndexT FloorNeon(const double *in, double floor_val, MatrixIndexT dim,
+                       double *out) {
+  float64x2_t f = vdupq_n_f64(floor_val);
+  uint64x2_t count = vdupq_n_u64(0);
+  MatrixIndexT i = 0;
+  for (; i + 2 <= dim; i += 2) {
+    float64x2_t x = vld1q_f64(in + i);
+    uint64x2_t floored = vcltq_f64(x, f);
+    count = vsubq_u64(count, floored);
+    vst1q_f64(out + i, vbslq_f64(floored, f, x));
+  }
+  return vaddvq_u64(count) + FloorScalar(in + i, floor_val, dim - i, out + i);
+}
+
+void TransposeBlockNeonFloat(const void *in_void, MatrixIndexT in_stride,
+                             void *out_void, MatrixIndexT out_stride) {
+  const float *in = static_cast<const float*>(in_void);
+  float *out = static_cast<float*>(out_void);
+  float32x4x2_t t01 = vtrnq_f32(vld1q_f32(in), vld1q_f32(in + in_stride)),
+      t23 = vtrnq_f32(vld1q_f32(in + 2 * in_stride),
+                      vld1q_f32(in + 3 * in_stride));
+  vst1q_f32(out, vcombine_f32(vget_low_f32(t01.val[0]),
+                              vget_low_f32(t23.val[0])));
+  vst1q_f32(out + out_stride, vcombine_f32(vget_low_f32(t01.val[1]),
+                                           vget_low_f32(t23.val[1])));
+  vst1q_f32(out + 2 * out_stride, vcombine_f32(vget_high_f32(t01.val[0]),
+                                               vget_high_f32(t23.val[0])));
+  vst1q_f32(out + 3 * out_stride, vcombine_f32(vget_high_f32(t01.val[1]),
+                                               vget_high_f32(t23.val[1])));
+}
+
+void TransposeBlockNeonDouble(const void *in_void, MatrixIndexT in_stride,
+                              void *out_void, MatrixIndexT out_stride) {
+  const double *in = static_cast<const double*>(in_void);
+  double *out = static_cast<double*>(out_void);
+  float64x2_t r0 = vld1q_f64(in), r1 = vld1q_f64(in + in_stride);
+  vst1q_f64(out, vzip1q_f64(r0, r1));
+  vst1q_f64(out + out_stride, vzip2q_f64(r0, r1));
+}
+
+void IntToFloatNeon(const uint8 *in, float min_value, float increment,
+                    MatrixIndexT dim, float *out) {
+  float32x4_t m = vdupq_n_f32(min_value), inc = vdupq_n_f32(increment);
+  MatrixIndexT i = 0;
+  for (; i + 8 <= dim; i += 8) {
+    uint16x8_t x = vmovl_u8(vld1_u8(in + i));
+    vst1q_f32(out + i, vaddq_f32(m, vmulq_f32(
+        vcvtq_f32_u32(vmovl_u16(vget_low_u16(x))), inc)));
+    vst1q_f32(out + i + 4, vaddq_f32(m, vmulq_f32(
+        vcvtq_f32_u32(vmovl_u16(vget_high_u16(x))), inc)));
+  }
+  IntToFloatScalar(in + i, min_value, increment, dim - i, out + i);
+}
+
+void IntToFloatNeon(const uint16 *in, float min_value, float increment,
+                    MatrixIndexT dim, float *out) {
+  float32x4_t m = vdupq_n_f32(min_value), inc = vdupq_n_f32(increment);
+  MatrixIndexT i = 0;
+  for (; i + 4 <= dim; i += 4)
+    vst1q_f32(out + i, vaddq_f32(m, vmulq_f32(
+        vcvtq_f32_u32(vmovl_u16(vld1_u16(in + i))), inc)));
+  IntToFloatScalar(in + i, min_value, increment, dim - i, out + i);
+}
+
+// Computes the integers of FloatToIntScalar() for 4 elements.
+template<int kMax>
+inline uint32x4_t FloatToIntNeonBlock(const float *in, float32x4_t m,
+                                      float32x4_t range) {
+  float32x4_t f = vdivq_f32(vsubq_f32(vld1q_f32(in), m), range);
+  f = vmaxq_f32(vminq_f32(f, vdupq_n_f32(1.0)), vdupq_n_f32(0.0));
+  f = vmulq_f32(f, vdupq_n_f32(kMax));
+  float64x2_t half = vdupq_n_f64(0.499);
+  uint64x2_t lo = vcvtq_u64_f64(vaddq_f64(vcvt_f64_f32(vget_low_f32(f)),
+                                          half)),
+      hi = vcvtq_u64_f64(vaddq_f64(vcvt_high_f64_f32(f), half));
+  return vcombine_u32(vmovn_u64(lo), vmovn_u64(hi));
+}
+
+void FloatToIntNeon(const float *in, float min_value, float range,
+                    MatrixIndexT dim, uint8 *out) {
+  float32x4_t m = vdupq_n_f32(min_value), r = vdupq_n_f32(range);
+  MatrixIndexT i = 0;
+  for (; i + 8 <= dim; i += 8) {
+    uint16x8_t x = vcombine_u16(
+        vmovn_u32(FloatToIntNeonBlock<255>(in + i, m, r)),
+        vmovn_u32(FloatToIntNeonBlock<255>(in + i + 4, m, r)));
+    vst1_u8(out + i, vmovn_u16(x));
+  }
+  FloatToIntScalar<255>(in + i, min_value, range, dim - i, out + i);
+}
+
+void FloatToIntNeon(const float *in, float min_value, float range,
+                    MatrixIndexT dim, uint16 *out) {
+  float32x4_t m = vdupq_n_f32(min_value), r = vdupq_n_f32(range);
+  MatrixIndexT i = 0;
+  for (; i + 4 <= dim; i += 4)
+    vst1_u16(out + i, vmovn_u32(FloatToIntNeonBlock<65535>(in + i, m, r)));
+  FloatToIntScalar<65535>(in + i, min_value, range, dim - i, out + i);
+}
+
+#endif  // KALDI_SIMD_MATH_NEON
+
+
+template<int kOp>
+float Apply(const float *in, float a, float b, MatrixIndexT dim,
+            float *out) {
+  switch (GetIsa()) {
+#if defined(KALDI_SIMD_MATH_X86)
+    case kIsaAvx512:
+      return ApplyAvx512<kOp>(in, a, b, dim, out);
+    case kIsaAvx2:
+      return ApplyAvx2<kOp>(in, a, b, dim, out);
+#endif
+#if defined(KALDI_SIMD_MATH_NEON)
+    case kIsaNeon:
+      return ApplyNeon<kOp>(in, a, b, dim, out);
+#endif
+    default:
+      return ApplyScalar<kOp>(in, a, b, dim, out);
+  }
+}
+
+}  // namespace
+
+
+float ExpVec(const float *in, float offset, MatrixIndexT dim, float *out) {
+  return Apply<kExpOp>(in, offset, 0.0f, dim, out);
+}
+
+double ExpVec(const double *in, double offset, MatrixIndexT dim,
+              double *out) {
+  return ApplyScalar<kExpOp>(in, offset, 0.0, dim, out);
+}
+
+float SumExpVec(const float *in, float offset, float cutoff,
+                MatrixIndexT dim) {
+  return Apply<kSumExpOp>(in, offset, cutoff, dim, NULL);
+}
+
+double SumExpVec(const double *in, double offset, double cutoff,
+                 MatrixIndexT dim) {
+  return ApplyScalar<kSumExpOp>(in, offset, cutoff, dim,
+                                static_cast<double*>(NULL));
+}
+
+void LogVec(const float *in, MatrixIndexT dim, float *out) {
+  Apply<kLogOp>(in, 0.0f, 0.0f, dim, out);
+}
+
+void LogVec(const double *in, MatrixIndexT dim, double *out) {
+  ApplyScalar<kLogOp>(in, 0.0, 0.0, dim, out);
+}
+
+void SigmoidVec(const float *in, MatrixIndexT dim, float *out) {
+  Apply<kSigmoidOp>(in, 0.0f, 0.0f, dim, out);
+}
+
+void SigmoidVec(const double *in, MatrixIndexT dim, double *out) {
+  ApplyScalar<kSigmoidOp>(in, 0.0, 0.0, dim, out);
+}
+
+void TanhVec(const float *in, MatrixIndexT dim, float *out) {
+  Apply<kTanhOp>(in, 0.0f, 0.0f, dim, out);
+}
+
+void TanhVec(const double *in, MatrixIndexT dim, double *out) {
+  ApplyScalar<kTanhOp>(in, 0.0, 0.0, dim, out);
+}
+
+// The dispatch of the exact functions, for float and double.
+#if defined(KALDI_SIMD_MATH_X86)
+#define KALDI_SIMD_MATH_DISPATCH_X86(name, ...)     \
+    case kIsaAvx512: return name##Avx512(__VA_ARGS__); \
+    case kIsaAvx2: return name##Avx2(__VA_ARGS__);
+#else
+#define KALDI_SIMD_MATH_DISPATCH_X86(name, ...)
+#endif
+#if defined(KALDI_SIMD_MATH_NEON)
+#define KALDI_SIMD_MATH_DISPATCH_NEON(name, ...) \
+    case kIsaNeon: return name##Neon(__VA_ARGS__);
+#else
+#define KALDI_SIMD_MATH_DISPATCH_NEON(name, ...)
+#endif
+#define KALDI_SIMD_MATH_DISPATCH(name, ...)            \
+  switch (GetIsa()) {                                  \
+    KALDI_SIMD_MATH_DISPATCH_X86(name, __VA_ARGS__)    \
+    KALDI_SIMD_MATH_DISPATCH_NEON(name, __VA_ARGS__)   \
+    default: return name##Scalar(__VA_ARGS__);         \
+  }
+
+float SumVec(const float *in, MatrixIndexT dim) {
+  KALDI_SIMD_MATH_DISPATCH(Sum, in, dim);
+}
+
+double SumVec(const double *in, MatrixIndexT dim) {
+  KALDI_SIMD_MATH_DISPATCH(Sum, in, dim);
+}
+
+void MulElementsVec(const float *in, MatrixIndexT dim, float *out) {
+  KALDI_SIMD_MATH_DISPATCH(MulElements, in, dim, out);
+}
+
+void MulElementsVec(const double *in, MatrixIndexT dim, double *out) {
+  KALDI_SIMD_MATH_DISPATCH(MulElements, in, dim, out);
+}
+
+void AddVecVecVec(float alpha, const float *v, const float *r, float beta,
+                  MatrixIndexT dim, float *out) {
+  KALDI_SIMD_MATH_DISPATCH(AddVecVecVec, alpha, v, r, beta, dim, out);
+}
+
+void AddVecVecVec(double alpha, const double *v, const double *r, double beta,
+                  MatrixIndexT dim, double *out) {
+  KALDI_SIMD_MATH_DISPATCH(AddVecVecVec, alpha, v, r, beta, dim, out);
+}
+
+MatrixIndexT FloorVec(const float *in, float floor_val, MatrixIndexT dim,
+                      float *out) {
+  KALDI_SIMD_MATH_DISPATCH(Floor, in, floor_val, dim, out);
+}
+
+MatrixIndexT FloorVec(const double *in, double floor_val, MatrixIndexT dim,
+                      double *out) {
+  KALDI_SIMD_MATH_DISPATCH(Floor, in, floor_val, dim, out);
+}
+
+// NEON has no gather instructions, so there we use the scalar code.
+#define KALDI_SIMD_MATH_DISPATCH_GATHER(...)            \
+  switch (GetIsa()) {                                   \
+    KALDI_SIMD_MATH_DISPATCH_X86(Gather, __VA_ARGS__)   \
+    default: return GatherScalar(__VA_ARGS__);          \
+  }
+
+void GatherVec(float alpha, const float *in, const int32 *map,
+               const int32 *indexes, MatrixIndexT dim, float *out) {
+  KALDI_SIMD_MATH_DISPATCH_GATHER(alpha, in, map, indexes, dim, out);
+}
+
+void GatherVec(double alpha, const double *in, const int32 *map,
+               const int32 *indexes, MatrixIndexT dim, double *out) {
+  KALDI_SIMD_MATH_DISPATCH_GATHER(alpha, in, map, indexes, dim, out);
+}
+
+void TransposeMat(const float *in, MatrixIndexT in_stride,
+                  MatrixIndexT num_rows, MatrixIndexT num_cols,
+                  float *out, MatrixIndexT out_stride) {
+  MatrixIndexT block_size = 0;
+  TransposeBlockFunc block_func = NULL;
+  switch (GetIsa()) {
+#if defined(KALDI_SIMD_MATH_X86)
+    case kIsaAvx512: case kIsaAvx2:
+      block_size = 8;
+      block_func = TransposeBlockAvx2Float;
+      break;
+#endif
+#if defined(KALDI_SIMD_MATH_NEON)
+    case kIsaNeon:
+      block_size = 4;
+      block_func = TransposeBlockNeonFloat;
+      break;
+#endif
+    default:
+      break;
+  }
+  TransposeTiled(in, in_stride, num_rows, num_cols, out, out_stride,
+                 block_size, block_func);
+}
+
+void TransposeMat(const double *in, MatrixIndexT in_stride,
+                  MatrixIndexT num_rows, MatrixIndexT num_cols,
+                  double *out, MatrixIndexT out_stride) {
+  MatrixIndexT block_size = 0;
+  TransposeBlockFunc block_func = NULL;
+  switch (GetIsa()) {
+#if defined(KALDI_SIMD_MATH_X86)
+    case kIsaAvx512: case kIsaAvx2:
+      block_size = 4;
+      block_func = TransposeBlockAvx2Double;
+      break;
+#endif
+#if defined(KALDI_SIMD_MATH_NEON)
+    case kIsaNeon:
+      block_size = 2;
+      block_func = TransposeBlockNeonDouble;
+      break;
+#endif
+    default:
+      break;
+  }
+  TransposeTiled(in, in_stride, num_rows, num_cols, out, out_stride,
+                 block_size, block_func);
+}
+
+// The x86 versions of the quantization kernels only need AVX2.
+#if defined(KALDI_SIMD_MATH_X86)
+#define KALDI_SIMD_MATH_DISPATCH_QUANTIZE_X86(name, ...)  \
+    case kIsaAvx512: case kIsaAvx2: return name##Avx2(__VA_ARGS__);
+#else
+#define KALDI_SIMD_MATH_DISPATCH_QUANTIZE_X86(name, ...)
+#endif
+#define KALDI_SIMD_MATH_DISPATCH_QUANTIZE(name, scalar_func, ...)  \
+  switch (GetIsa()) {                                           \
+    KALDI_SIMD_MATH_DISPATCH_QUANTIZE_X86(name, __VA_ARGS__)    \
+    KALDI_SIMD_MATH_DISPATCH_NEON(name, __VA_ARGS__)            \
+    default: return scalar_func(__VA_ARGS__);                   \
+  }
+
+void Uint8ToFloatVec(const uint8 *in, float min_value, float increment,
+                     MatrixIndexT dim, float *out) {
+  KALDI_SIMD_MATH_DISPATCH_QUANTIZE(IntToFloat, IntToFloatScalar, in,
+                                    min_value, increment, dim, out);
+}
+
+void Uint16ToFloatVec(const uint16 *in, float min_value, float increment,
+                      MatrixIndexT dim, float *out) {
+  KALDI_SIMD_MATH_DISPATCH_QUANTIZE(IntToFloat, IntToFloatScalar, in,
+                                    min_value, increment, dim, out);
+}
+
+void FloatToUint8Vec(const float *in, float min_value, float range,
+                     MatrixIndexT dim, uint8 *out) {
+  KALDI_SIMD_MATH_DISPATCH_QUANTIZE(FloatToInt, FloatToIntScalar<255>, in,
+                                    min_value, range, dim, out);
+}
+
+void FloatToUint16Vec(const float *in, float min_value, float range,
+                      MatrixIndexT dim, uint16 *out) {
+  KALDI_SIMD_MATH_DISPATCH_QUANTIZE(FloatToInt, FloatToIntScalar<65535>, in,
+                                    min_value, range, dim, out);
+}
+
+const char *SimdMathInstructionSet() {
+  return IsaName(GetIsa());
+}
+
+}  // namespace kaldi
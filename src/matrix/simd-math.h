@@ -0,0 +1,156 @@
+// matrix/simd-math.h
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_MATRIX_SIMD_MATH_H_
+#define KALDI_MATRIX_SIMD_MATH_H_
+
+#include "matrix/matrix-common.h"
+
+namespace kaldi {
+
+/// @addtogroup matrix_funcs_misc
+/// @{
+
+/**
+   This file contains the SIMD kernels that the CPU code of VectorBase and
+   MatrixBase uses for its hot loops.  The instruction set is chosen at runtime
+   according to what the CPU supports, so a binary compiled for a generic
+   architecture still uses AVX2 or AVX-512 where they are available.
+
+   The first group of functions computes exp(), log(), the sigmoid and tanh on
+   arrays; they are used by functions like ApplyExp(), ApplySoftMax(),
+   LogSumExp(), Sigmoid() and Tanh().
+
+   In single precision they use polynomial approximations (those of the Cephes
+   library) evaluated with SIMD instructions: AVX-512F, AVX2 with FMA, or NEON
+   on 64-bit ARM.  The relative error of exp() and log() is at most a few ulp; exp()
+   gives +inf above about 88.72 and flushes results below about 1e-45 to zero,
+   and log() gives -inf for 0 and NaN for negative inputs.  The sigmoid and
+   tanh are computed from exp() in the same way as the scalar code, so their
+   absolute error is about 1e-7.
+
+   In double precision, or if none of those instruction sets is available,
+   they just call Exp() and Log() from base/kaldi-math.h on each element.
+
+   In all of them, 'in' and 'out' may be the same array.
+*/
+
+/// Sets out[i] = exp(in[i] + offset) for 0 <= i < dim, and returns the sum of
+/// the out[i].
+float ExpVec(const float *in, float offset, MatrixIndexT dim, float *out);
+double ExpVec(const double *in, double offset, MatrixIndexT dim, double *out);
+
+/// Returns the sum of exp(in[i] + offset) over the 0 <= i < dim for which
+/// in[i] >= cutoff.
+float SumExpVec(const float *in, float offset, float cutoff,
+                MatrixIndexT dim);
+double SumExpVec(const double *in, double offset, double cutoff,
+                 MatrixIndexT dim);
+
+/// Sets out[i] = log(in[i]) for 0 <= i < dim.
+void LogVec(const float *in, MatrixIndexT dim, float *out);
+void LogVec(const double *in, MatrixIndexT dim, double *out);
+
+/// Sets out[i] = 1 / (1 + exp(-in[i])) for 0 <= i < dim.
+void SigmoidVec(const float *in, MatrixIndexT dim, float *out);
+void SigmoidVec(const double *in, MatrixIndexT dim, double *out);
+
+/// Sets out[i] = tanh(in[i]) for 0 <= i < dim.
+void TanhVec(const float *in, MatrixIndexT dim, float *out);
+void TanhVec(const double *in, MatrixIndexT dim, double *out);
+
+/**
+   The following are SIMD versions of some of the loops of VectorBase and
+   MatrixBase.  Unlike the functions above they are not approximations (the
+   results may differ from the scalar code's in the last bit, because of the
+   order of the additions and fused multiply-adds), and they have SIMD
+   versions for double precision too.
+*/
+
+/// Returns the sum of in[i] for 0 <= i < dim.  Like the sums returned by
+/// ExpVec() and SumExpVec(), it is accumulated in the precision of 'in'.
+float SumVec(const float *in, MatrixIndexT dim);
+double SumVec(const double *in, MatrixIndexT dim);
+
+/// Sets out[i] *= in[i] for 0 <= i < dim.
+void MulElementsVec(const float *in, MatrixIndexT dim, float *out);
+void MulElementsVec(const double *in, MatrixIndexT dim, double *out);
+
+/// Sets out[i] = beta * out[i] + alpha * v[i] * r[i] for 0 <= i < dim; if
+/// beta == 0, the previous values of out[] are not read.
+void AddVecVecVec(float alpha, const float *v, const float *r, float beta,
+                  MatrixIndexT dim, float *out);
+void AddVecVecVec(double alpha, const double *v, const double *r, double beta,
+                  MatrixIndexT dim, double *out);
+
+/// Sets out[i] = max(in[i], floor_val) for 0 <= i < dim (NaNs are left as they
+/// are), and returns the number of elements that were floored.
+MatrixIndexT FloorVec(const float *in, float floor_val, MatrixIndexT dim,
+                      float *out);
+MatrixIndexT FloorVec(const double *in, double floor_val, MatrixIndexT dim,
+                      double *out);
+
+/// Sets out[i] = alpha * in[map[indexes[i]]] for 0 <= i < dim, or out[i] =
+/// alpha * in[indexes[i]] if map == NULL; 'out' must not overlap the inputs.
+/// The decodables use this to look up the log-likelihoods of a batch of
+/// transition-ids, with 'map' being the transition-id to pdf-id table.
+void GatherVec(float alpha, const float *in, const int32 *map,
+               const int32 *indexes, MatrixIndexT dim, float *out);
+void GatherVec(double alpha, const double *in, const int32 *map,
+               const int32 *indexes, MatrixIndexT dim, double *out);
+
+/// Sets the num_cols by num_rows matrix 'out' to the transpose of the num_rows
+/// by num_cols matrix 'in'; they must not overlap.
+void TransposeMat(const float *in, MatrixIndexT in_stride,
+                  MatrixIndexT num_rows, MatrixIndexT num_cols,
+                  float *out, MatrixIndexT out_stride);
+void TransposeMat(const double *in, MatrixIndexT in_stride,
+                  MatrixIndexT num_rows, MatrixIndexT num_cols,
+                  double *out, MatrixIndexT out_stride);
+
+/**
+   The following are used by class CompressedMatrix for its formats with one or
+   two bytes per element; the arithmetic is the same as in the scalar code of
+   that class (up to the last bit, as above).
+*/
+
+/// Sets out[i] = min_value + in[i] * increment for 0 <= i < dim.
+void Uint8ToFloatVec(const uint8 *in, float min_value, float increment,
+                     MatrixIndexT dim, float *out);
+void Uint16ToFloatVec(const uint16 *in, float min_value, float increment,
+                      MatrixIndexT dim, float *out);
+
+/// Sets out[i] to f * 255 (FloatToUint8Vec()) or f * 65535
+/// (FloatToUint16Vec()) rounded to the nearest integer, for 0 <= i < dim,
+/// where f = (in[i] - min_value) / range, limited to the range [0, 1].
+void FloatToUint8Vec(const float *in, float min_value, float range,
+                     MatrixIndexT dim, uint8 *out);
+void FloatToUint16Vec(const float *in, float min_value, float range,
+                      MatrixIndexT dim, uint16 *out);
+
+/// Returns the instruction set that the functions above use: "avx512f",
+/// "avx2", "neon" or "none".  It is chosen the first time any of them are
+/// called, and written to the log.
+const char *SimdMathInstructionSet();
+
+/// @} end of "addtogroup matrix_funcs_misc"
+
+}  // namespace kaldi
+
+#endif  // KALDI_MATRIX_SIMD_MATH_H_
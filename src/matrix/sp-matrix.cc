@@ -978,6 +978,11 @@ double VecSpVec(const VectorBase<double> &v1, const SpMatrix<double> &M,
                 const VectorBase<double> &v2);
 
 
+// Above this dimension AddMat2Sp() unpacks A and uses matrix-matrix products;
+// the packed version uses matrix-vector products, which are limited by the
+// memory bandwidth once the matrices don't fit in the cache.
+static const MatrixIndexT kAddMat2SpBlockedMinDim = 96;
+
 template<typename Real>
 void SpMatrix<Real>::AddMat2Sp(
     const Real alpha, const MatrixBase<Real> &M,
@@ -997,6 +1002,29 @@ void SpMatrix<Real>::AddMat2Sp(
       M_stride = M.Stride(), dim = this->NumRows();
   KALDI_ASSERT(M_same_dim == dim);
 
+  if (dim >= kAddMat2SpBlockedMinDim &&
+      M_other_dim >= kAddMat2SpBlockedMinDim) {
+    // Unpack A and do it as two matrix multiplies, which is faster for
+    // large matrices even though the second one computes both triangles.
+    // Copying A first also takes care of any overlap with *this.
+    Matrix<Real> A_full(A), MA(dim, M_other_dim, kUndefined),
+        MAM(dim, dim, kUndefined);
+    MA.AddMatMat(1.0, M, transM, A_full, kNoTrans, 0.0);
+    MAM.AddMatMat(alpha, MA, kNoTrans, M, (transM == kNoTrans ? kTrans :
+                                           kNoTrans), 0.0);
+    for (MatrixIndexT r = 0; r < dim; r++, p_row_data += r) {
+      const Real *MAM_row = MAM.RowData(r);
+      if (beta == 0.0) {
+        for (MatrixIndexT c = 0; c <= r; c++)
+          p_row_data[c] = MAM_row[c];
+      } else {
+        for (MatrixIndexT c = 0; c <= r; c++)
+          p_row_data[c] = beta * p_row_data[c] + MAM_row[c];
+      }
+    }
+    return;
+  }
+
   const Real *M_data = M.Data();
 
   if (this->Data() <= A.Data() + A.SizeInBytes() &&
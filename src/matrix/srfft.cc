@@ -25,8 +25,20 @@
 // License v2.0.
 
 
+#include <algorithm>
+#include <cstring>
+
 #include "matrix/srfft.h"
 #include "matrix/matrix-functions.h"
+#include "matrix/simd-math.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KALDI_SRFFT_AVX2 1
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define KALDI_SRFFT_NEON 1
+#include <arm_neon.h>
+#endif
 
 namespace kaldi {
 
@@ -352,21 +364,348 @@ void SplitRadixComplexFft<Real>::ComputeRecursive(Real *xr, Real *xi, MatrixInde
 }
 
 
+// The rest of this file is the SIMD version of ComputeRecursive() and
+// BitReversePermute(), which transform NumLanes() signals at once; each Real
+// of the original code becomes a vector of the same element of all the
+// signals.  The vectors of the real and imaginary parts alternate, so the
+// stride between points is S = 2 * V::kNumLanes.  The struct V wraps the SIMD
+// operations.  On x86 all of this code
+// is compiled for AVX2, and it is only called if the CPU supports it.
+#if defined(KALDI_SRFFT_AVX2)
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx2"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+
+namespace {
+
+struct FftLanes {
+  typedef __m256 Vec;
+  static const MatrixIndexT kNumLanes = 8;
+  static inline Vec Load(const float *p) { return _mm256_loadu_ps(p); }
+  static inline void Store(float *p, Vec v) { _mm256_storeu_ps(p, v); }
+  static inline Vec Set1(float f) { return _mm256_set1_ps(f); }
+  static inline Vec Add(Vec a, Vec b) { return _mm256_add_ps(a, b); }
+  static inline Vec Sub(Vec a, Vec b) { return _mm256_sub_ps(a, b); }
+  static inline Vec Mul(Vec a, Vec b) { return _mm256_mul_ps(a, b); }
+  static inline Vec Neg(Vec a) {
+    return _mm256_xor_ps(a, _mm256_set1_ps(-0.0f));
+  }
+};
+
+#elif defined(KALDI_SRFFT_NEON)
+
+namespace {
+
+struct FftLanes {
+  typedef float32x4_t Vec;
+  static const MatrixIndexT kNumLanes = 4;
+  static inline Vec Load(const float *p) { return vld1q_f32(p); }
+  static inline void Store(float *p, Vec v) { vst1q_f32(p, v); }
+  static inline Vec Set1(float f) { return vdupq_n_f32(f); }
+  static inline Vec Add(Vec a, Vec b) { return vaddq_f32(a, b); }
+  static inline Vec Sub(Vec a, Vec b) { return vsubq_f32(a, b); }
+  static inline Vec Mul(Vec a, Vec b) { return vmulq_f32(a, b); }
+  static inline Vec Neg(Vec a) { return vnegq_f32(a); }
+};
+
+#endif
+
+#if defined(KALDI_SRFFT_AVX2) || defined(KALDI_SRFFT_NEON)
+
+// Sets (a, b) to (a + b, a - b), for vectors at a and b.
+template<class V>
+inline void LanesAddSub(float *a, float *b) {
+  typename V::Vec x = V::Load(a), y = V::Load(b);
+  V::Store(a, V::Add(x, y));
+  V::Store(b, V::Sub(x, y));
+}
+
+template<class V>
+inline void LanesSwap(float *a, float *b) {
+  typename V::Vec x = V::Load(a), y = V::Load(b);
+  V::Store(a, y);
+  V::Store(b, x);
+}
+
+// See SplitRadixComplexFft::BitReversePermute().
+template<class V>
+void LanesBitReversePermute(const MatrixIndexT *brseed, MatrixIndexT logn,
+                            float *x) {
+  const MatrixIndexT S = 2 * V::kNumLanes;
+  MatrixIndexT lg2 = logn >> 1, n = 1 << lg2;
+  for (MatrixIndexT off = 1; off < n; off++) {
+    MatrixIndexT fj = n * brseed[off], i = off;
+    LanesSwap<V>(x + i * S, x + fj * S);
+    const MatrixIndexT *brp = brseed + 1;
+    for (MatrixIndexT gno = 1; gno < brseed[off]; gno++) {
+      i += n;
+      LanesSwap<V>(x + i * S, x + (fj + *brp++) * S);
+    }
+  }
+}
+
+// See SplitRadixComplexFft::ComputeRecursive(); the loops and the operations
+// are in the same order, so the results are the same.
+template<class V>
+void LanesComputeRecursive(float *const *tab, float *xr, float *xi,
+                           MatrixIndexT logn) {
+  typedef typename V::Vec Vec;
+  const MatrixIndexT S = 2 * V::kNumLanes;
+
+  if (logn < 3) {
+    if (logn == 2) {  // length m = 4
+      LanesAddSub<V>(xr, xr + 2 * S);
+      LanesAddSub<V>(xi, xi + 2 * S);
+      LanesAddSub<V>(xr + S, xr + 3 * S);
+      LanesAddSub<V>(xi + S, xi + 3 * S);
+      LanesAddSub<V>(xr, xr + S);
+      LanesAddSub<V>(xi, xi + S);
+      Vec xr2 = V::Load(xr + 2 * S), xi2 = V::Load(xi + 2 * S),
+          xr3 = V::Load(xr + 3 * S), xi3 = V::Load(xi + 3 * S);
+      V::Store(xr + 2 * S, V::Add(xr2, xi3));
+      V::Store(xi + 3 * S, V::Add(xi2, xr3));
+      V::Store(xi + 2 * S, V::Sub(xi2, xr3));
+      V::Store(xr + 3 * S, V::Sub(xr2, xi3));
+    } else if (logn == 1) {  // length m = 2
+      LanesAddSub<V>(xr, xr + S);
+      LanesAddSub<V>(xi, xi + S);
+    }
+    return;
+  }
+
+  MatrixIndexT m = 1 << logn, m2 = m / 2, m4 = m2 / 2, m8 = m4 / 2;
+
+  // Step 1
+  for (MatrixIndexT k = 0; k < m2 * S; k += S) {
+    LanesAddSub<V>(xr + k, xr + m2 * S + k);
+    LanesAddSub<V>(xi + k, xi + m2 * S + k);
+  }
+
+  // Step 2
+  float *xr1 = xr + m2 * S, *xr2 = xr1 + m4 * S,
+      *xi1 = xi + m2 * S, *xi2 = xi1 + m4 * S;
+  for (MatrixIndexT k = 0; k < m4 * S; k += S) {
+    Vec r1 = V::Load(xr1 + k), r2 = V::Load(xr2 + k),
+        i1 = V::Load(xi1 + k), i2 = V::Load(xi2 + k);
+    V::Store(xr1 + k, V::Add(r1, i2));
+    V::Store(xi2 + k, V::Add(i1, r2));
+    V::Store(xi1 + k, V::Sub(i1, r2));
+    V::Store(xr2 + k, V::Sub(r1, i2));
+  }
+
+  // Steps 3 & 4
+  const float *cn = NULL, *spcn = NULL, *smcn = NULL, *c3n = NULL,
+      *spc3n = NULL, *smc3n = NULL;
+  if (logn >= 4) {
+    MatrixIndexT nel = m4 - 2;
+    cn = tab[logn - 4]; spcn = cn + nel; smcn = spcn + nel;
+    c3n = smcn + nel; spc3n = c3n + nel; smc3n = spc3n + nel;
+  }
+  Vec sqhalf = V::Set1(M_SQRT1_2), minus_sqhalf = V::Set1(-M_SQRT1_2);
+  for (MatrixIndexT n = 1; n < m4; n++) {
+    float *pr1 = xr1 + n * S, *pr2 = xr2 + n * S,
+        *pi1 = xi1 + n * S, *pi2 = xi2 + n * S;
+    Vec r1 = V::Load(pr1), r2 = V::Load(pr2),
+        i1 = V::Load(pi1), i2 = V::Load(pi2);
+    if (n == m8) {
+      V::Store(pr1, V::Mul(sqhalf, V::Add(r1, i1)));
+      V::Store(pi1, V::Mul(sqhalf, V::Sub(i1, r1)));
+      V::Store(pr2, V::Mul(sqhalf, V::Sub(i2, r2)));
+      V::Store(pi2, V::Mul(minus_sqhalf, V::Add(r2, i2)));
+    } else {
+      Vec tmp = V::Mul(V::Set1(*cn++), V::Add(r1, i1));
+      V::Store(pi1, V::Add(V::Mul(V::Set1(*spcn++), r1), tmp));
+      V::Store(pr1, V::Add(V::Mul(V::Set1(*smcn++), i1), tmp));
+      tmp = V::Mul(V::Set1(*c3n++), V::Add(r2, i2));
+      V::Store(pi2, V::Add(V::Mul(V::Set1(*spc3n++), r2), tmp));
+      V::Store(pr2, V::Add(V::Mul(V::Set1(*smc3n++), i2), tmp));
+    }
+  }
+
+  LanesComputeRecursive<V>(tab, xr, xi, logn - 1);
+  LanesComputeRecursive<V>(tab, xr + m2 * S, xi + m2 * S, logn - 2);
+  LanesComputeRecursive<V>(tab, xr + 3 * m4 * S, xi + 3 * m4 * S, logn - 2);
+}
+
+// See SplitRadixRealFft::Recombine(); N is the number of real points.
+template<class V>
+void LanesRecombine(MatrixIndexT N, bool forward, float *x) {
+  typedef typename V::Vec Vec;
+  const MatrixIndexT L = V::kNumLanes, N2 = N / 2;
+  float rootN_re, rootN_im;
+  int forward_sign = forward ? -1 : 1;
+  ComplexImExp(static_cast<float>(M_2PI / N * forward_sign),
+               &rootN_re, &rootN_im);
+  float kN_re = -forward_sign, kN_im = 0.0;
+  Vec half = V::Set1(0.5), minus_half = V::Set1(-0.5);
+  for (MatrixIndexT k = 1; 2 * k <= N2; k++) {
+    ComplexMul(rootN_re, rootN_im, &kN_re, &kN_im);
+    // Points k and k' = N/2 - k.
+    float *pk = x + 2 * k * L, *pkdash = x + 2 * (N2 - k) * L;
+    Vec re_k = V::Load(pk), im_k = V::Load(pk + L),
+        re_kdash = V::Load(pkdash), im_kdash = V::Load(pkdash + L);
+    Vec Ck_re = V::Mul(half, V::Add(re_k, re_kdash)),
+        Ck_im = V::Mul(half, V::Sub(im_k, im_kdash)),
+        Dk_re = V::Mul(half, V::Add(im_k, im_kdash)),
+        Dk_im = V::Mul(minus_half, V::Sub(re_k, re_kdash));
+    Vec b_re = V::Set1(kN_re), b_im = V::Set1(kN_im);
+    V::Store(pk, V::Add(Ck_re, V::Sub(V::Mul(b_re, Dk_re),
+                                      V::Mul(b_im, Dk_im))));
+    V::Store(pk + L, V::Add(Ck_im, V::Add(V::Mul(b_re, Dk_im),
+                                          V::Mul(b_im, Dk_re))));
+    if (N2 - k != k) {
+      Vec minus_b_re = V::Set1(-kN_re), minus_Dk_im = V::Neg(Dk_im);
+      V::Store(pkdash, V::Add(Ck_re, V::Sub(V::Mul(minus_b_re, Dk_re),
+                                            V::Mul(b_im, minus_Dk_im))));
+      V::Store(pkdash + L, V::Add(V::Neg(Ck_im),
+                                  V::Add(V::Mul(minus_b_re, minus_Dk_im),
+                                         V::Mul(b_im, Dk_re))));
+    }
+  }
+  Vec zeroth = V::Add(V::Load(x), V::Load(x + L)),
+      n2th = V::Sub(V::Load(x), V::Load(x + L));
+  if (!forward) {
+    zeroth = V::Mul(half, zeroth);
+    n2th = V::Mul(half, n2th);
+  }
+  V::Store(x, zeroth);
+  V::Store(x + L, n2th);
+}
+
+}  // namespace
+
+#endif  // defined(KALDI_SRFFT_AVX2) || defined(KALDI_SRFFT_NEON)
+
+#if defined(KALDI_SRFFT_AVX2)
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+#endif
+
+template<typename Real>
+MatrixIndexT SplitRadixComplexFft<Real>::NumLanes() const {
+  return 1;
+}
+
+template<>
+MatrixIndexT SplitRadixComplexFft<float>::NumLanes() const {
+#if defined(KALDI_SRFFT_AVX2)
+  // The matrix library's SIMD code requires at least AVX2.
+  static const bool have_avx2 =
+      (std::strcmp(SimdMathInstructionSet(), "none") != 0);
+  return have_avx2 ? FftLanes::kNumLanes : 1;
+#elif defined(KALDI_SRFFT_NEON)
+  return FftLanes::kNumLanes;
+#else
+  return 1;
+#endif
+}
+
+template<typename Real>
+void SplitRadixComplexFft<Real>::ComputeLanes(Real *x, bool forward) const {
+  KALDI_ERR << "ComputeLanes() called but NumLanes() == 1";
+}
+
+template<>
+void SplitRadixComplexFft<float>::ComputeLanes(float *x, bool forward) const {
+  KALDI_ASSERT(NumLanes() > 1);
+#if defined(KALDI_SRFFT_AVX2) || defined(KALDI_SRFFT_NEON)
+  float *xr = x, *xi = x + FftLanes::kNumLanes;
+  if (!forward)  // reverse real and imaginary parts for complex FFT.
+    std::swap(xr, xi);
+  LanesComputeRecursive<FftLanes>(tab_, xr, xi, logn_);
+  if (logn_ > 1) {
+    LanesBitReversePermute<FftLanes>(brseed_, logn_, xr);
+    LanesBitReversePermute<FftLanes>(brseed_, logn_, xi);
+  }
+#endif
+}
+
+template<typename Real>
+void SplitRadixRealFft<Real>::RecombineLanes(Real *x, bool forward) const {
+  KALDI_ERR << "RecombineLanes() called but NumLanes() == 1";
+}
+
+template<>
+void SplitRadixRealFft<float>::RecombineLanes(float *x, bool forward) const {
+#if defined(KALDI_SRFFT_AVX2) || defined(KALDI_SRFFT_NEON)
+  LanesRecombine<FftLanes>(N_, forward, x);
+#endif
+}
+
+
 template<typename Real>
 void SplitRadixRealFft<Real>::Compute(Real *data, bool forward) {
   Compute(data, forward, &this->temp_buffer_);
 }
 
 
-// This code is mostly the same as the RealFft function.  It would be
-// possible to replace it with more efficient code from Rico's book.
 template<typename Real>
 void SplitRadixRealFft<Real>::Compute(Real *data, bool forward,
                                       std::vector<Real> *temp_buffer) const {
-  MatrixIndexT N = N_, N2 = N/2;
-  KALDI_ASSERT(N%2 == 0);
   if (forward) // call to base class
     SplitRadixComplexFft<Real>::Compute(data, true, temp_buffer);
+  Recombine(data, forward);
+  if (!forward) {  // call to base class
+    SplitRadixComplexFft<Real>::Compute(data, false, temp_buffer);
+    for (MatrixIndexT i = 0; i < N_; i++)
+      data[i] *= 2.0;
+    // This is so we get a factor of N increase, rather than N/2 which we would
+    // otherwise get from [ComplexFft, forward] + [ComplexFft, backward] in dimension N/2.
+    // It's for consistency with our normal FFT convensions.
+  }
+}
+
+template<typename Real>
+void SplitRadixRealFft<Real>::Compute(MatrixBase<Real> *frames, bool forward) {
+  Compute(frames, forward, &this->temp_buffer_);
+}
+
+template<typename Real>
+void SplitRadixRealFft<Real>::Compute(MatrixBase<Real> *frames, bool forward,
+                                      std::vector<Real> *temp_buffer) const {
+  KALDI_ASSERT(frames->NumCols() == N_ && temp_buffer != NULL);
+  MatrixIndexT num_frames = frames->NumRows(), lanes = this->NumLanes();
+  if (lanes == 1) {
+    for (MatrixIndexT r = 0; r < num_frames; r++)
+      Compute(frames->RowData(r), forward, temp_buffer);
+    return;
+  }
+  if (temp_buffer->size() != static_cast<size_t>(N_ * lanes))
+    temp_buffer->resize(N_ * lanes);
+  // The transpose of 'lanes' frames, i.e. points of the complex FFT, with the
+  // frames interleaved; see ComputeLanes().
+  Real *data = &((*temp_buffer)[0]);
+  for (MatrixIndexT r0 = 0; r0 < num_frames; r0 += lanes) {
+    MatrixIndexT this_lanes = std::min(lanes, num_frames - r0);
+    SubMatrix<Real> these_frames(*frames, r0, this_lanes, 0, N_);
+    if (this_lanes < lanes)  // The unused lanes would otherwise be garbage.
+      std::fill(data, data + N_ * lanes, 0.0);
+    TransposeMat(these_frames.Data(), these_frames.Stride(), this_lanes, N_,
+                 data, lanes);
+    if (!forward)
+      RecombineLanes(data, false);
+    this->ComputeLanes(data, forward);
+    if (forward)
+      RecombineLanes(data, true);
+    TransposeMat(data, lanes, N_, this_lanes, these_frames.Data(),
+                 these_frames.Stride());
+    if (!forward)
+      these_frames.Scale(2.0);  // See the other Compute().
+  }
+}
+
+// This code is mostly the same as the RealFft function.  It would be
+// possible to replace it with more efficient code from Rico's book.
+template<typename Real>
+void SplitRadixRealFft<Real>::Recombine(Real *data, bool forward) const {
+  MatrixIndexT N = N_, N2 = N/2;
+  KALDI_ASSERT(N%2 == 0);
 
   Real rootN_re, rootN_im;  // exp(-2pi/N), forward; exp(2pi/N), backward
   int forward_sign = forward ? -1 : 1;
@@ -421,14 +760,6 @@ void SplitRadixRealFft<Real>::Compute(Real *data, bool forward,
       data[1] /= 2;
     }
   }
-  if (!forward) {  // call to base class
-    SplitRadixComplexFft<Real>::Compute(data, false, temp_buffer);
-    for (MatrixIndexT i = 0; i < N; i++)
-      data[i] *= 2.0;
-    // This is so we get a factor of N increase, rather than N/2 which we would
-    // otherwise get from [ComplexFft, forward] + [ComplexFft, backward] in dimension N/2.
-    // It's for consistency with our normal FFT convensions.
-  }
 }
 
 template class SplitRadixComplexFft<float>;
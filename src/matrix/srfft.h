@@ -80,6 +80,18 @@ class SplitRadixComplexFft {
   ~SplitRadixComplexFft();
 
  protected:
+  // Returns the number of signals that ComputeLanes() transforms at once, one
+  // in each lane of a SIMD register: 8 with AVX2, 4 with NEON.  If we have no
+  // SIMD code for this CPU or this type (we only have it for float) it returns
+  // 1, and ComputeLanes() must not be called.
+  Integer NumLanes() const;
+
+  // Does the FFT of NumLanes() signals at once.  'x' is the transpose of the
+  // NumLanes() by N*2 matrix whose rows are the signals in the format [ r0 im0
+  // r1 im1 ... ]; so x[(2 * n) * NumLanes() + l] is the real part of point n
+  // of signal l.
+  void ComputeLanes(Real *x, bool forward) const;
+
   // temp_buffer_ is allocated only if someone calls Compute with only one Real*
   // argument and we need a temporary buffer while creating interleaved data.
   std::vector<Real> temp_buffer_;
@@ -125,7 +137,28 @@ class SplitRadixRealFft: private SplitRadixComplexFft<Real> {
   /// uses a user-supplied buffer.
   void Compute(Real *x, bool forward, std::vector<Real> *temp_buffer) const;
 
+  /// Does the FFT of each row of 'frames' (which must have N columns) in
+  /// place.  The result is the same as calling Compute() on each row, but for
+  /// float, on CPUs with AVX2 or NEON, it transforms several rows at once, one
+  /// in each SIMD lane, which is a lot faster.
+  void Compute(MatrixBase<Real> *frames, bool forward);
+
+  /// This is as the other Compute() function that takes a matrix, but it is a
+  /// const version that uses a user-supplied buffer.
+  void Compute(MatrixBase<Real> *frames, bool forward,
+               std::vector<Real> *temp_buffer) const;
+
  private:
+  // This is the part of the real FFT that converts the complex FFT of the N/2
+  // points (the even and odd elements of the input) into the FFT of the N real
+  // points, if forward == true; and the reverse, before the complex FFT, if
+  // forward == false.
+  void Recombine(Real *data, bool forward) const;
+
+  // As Recombine(), for the NumLanes() signals in 'x' at once, which is in the
+  // format described for ComputeLanes().
+  void RecombineLanes(Real *x, bool forward) const;
+
   // Disallow assignment.
   SplitRadixRealFft &operator =(const SplitRadixRealFft<Real> &other);
   int N_;
@@ -84,10 +84,55 @@ void TpMatrix<Real>::Swap(TpMatrix<Real> *other) {
 }
 
 
+// Cholesky() uses the blocked algorithm for dimensions of at least
+// kCholeskyBlockedMinDim, with blocks of kCholeskyBlockSize rows.
+static const MatrixIndexT kCholeskyBlockedMinDim = 256,
+    kCholeskyBlockSize = 64;
+
+// This is a blocked, right-looking Cholesky decomposition, done on a full
+// copy of the matrix so that almost all the work is in matrix-matrix
+// products (the unblocked version is in dot products on packed storage, which
+// is slow once the matrix no longer fits in the cache).  For each block of
+// rows we factor the diagonal block with the unblocked code, solve for the
+// part of the block's columns below it by multiplying by the inverse of the
+// diagonal block's factor, and subtract the product of that panel with its
+// transpose from the rest of the matrix.
+template<typename Real>
+static void CholeskyBlocked(const SpMatrix<Real> &orig, TpMatrix<Real> *L) {
+  MatrixIndexT n = orig.NumRows();
+  Matrix<Real> A(orig);  // Only the lower triangle is used.
+  for (MatrixIndexT k = 0; k < n; k += kCholeskyBlockSize) {
+    MatrixIndexT b = std::min(kCholeskyBlockSize, n - k), rest = n - k - b;
+    SubMatrix<Real> A_kk(A, k, b, k, b);
+    SpMatrix<Real> S_kk(b);
+    S_kk.CopyFromMat(A_kk, kTakeLower);
+    TpMatrix<Real> L_kk(b);
+    L_kk.Cholesky(S_kk);
+    A_kk.CopyFromTp(L_kk);
+    if (rest == 0)
+      break;
+    // The panel below the diagonal block is A_ik L_kk^{-T}.
+    L_kk.Invert();
+    Matrix<Real> L_kk_inv(L_kk);
+    SubMatrix<Real> A_ik(A, k + b, rest, k, b);
+    Matrix<Real> panel(rest, b, kUndefined);
+    panel.AddMatMat(1.0, A_ik, kNoTrans, L_kk_inv, kTrans, 0.0);
+    A_ik.CopyFromMat(panel);
+    // Only the lower triangle of the trailing matrix is updated.
+    SubMatrix<Real> A_ii(A, k + b, rest, k + b, rest);
+    A_ii.SymAddMat2(-1.0, panel, kNoTrans, 1.0);
+  }
+  L->CopyFromMat(A);
+}
+
 template<typename Real>
 void TpMatrix<Real>::Cholesky(const SpMatrix<Real> &orig) {
   KALDI_ASSERT(orig.NumRows() == this->NumRows());
   MatrixIndexT n = this->NumRows();
+  if (n >= kCholeskyBlockedMinDim) {
+    CholeskyBlocked(orig, this);
+    return;
+  }
   this->SetZero();
   Real *data = this->data_, *jdata = data;  // start of j'th row of matrix.
   const Real *orig_jdata = orig.Data(); // start of j'th row of matrix.
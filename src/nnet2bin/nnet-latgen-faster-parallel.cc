@@ -52,6 +52,7 @@ int main(int argc, char *argv[]) {
 
     std::string word_syms_filename;
     sequencer_config.Register(&po);
+    RegisterGlobalThreadPoolOptions(&po);
     config.Register(&po);
     po.Register("acoustic-scale", &acoustic_scale, "Scaling factor for acoustic likelihoods");
     po.Register("word-symbol-table", &word_syms_filename, "Symbol table for words [for debug output]");
@@ -88,7 +89,8 @@ int main(int argc, char *argv[]) {
       KALDI_ERR << "Could not open table for writing lattices: "
                  << lattice_wspecifier;
 
-    TaskSequencer<DecodeUtteranceLatticeFasterClass> sequencer(sequencer_config);
+    TaskSequencer<DecodeUtteranceLatticeFasterClass> sequencer(
+        sequencer_config, &GlobalThreadPool());
 
     Int32VectorWriter words_writer(words_wspecifier);
 
@@ -36,6 +36,15 @@ void AmNnetSimple::Write(std::ostream &os, bool binary) const {
   // write the neural net and then the priors.  Who knows, there might be some
   // situation where we want to just read the neural net.
   nnet_.Write(os, binary);
+  WriteContextAndPriors(os, binary);
+}
+
+void AmNnetSimple::WriteWithParamBlob(std::ostream &os) const {
+  nnet_.WriteWithParamBlob(os);
+  WriteContextAndPriors(os, true);
+}
+
+void AmNnetSimple::WriteContextAndPriors(std::ostream &os, bool binary) const {
   WriteToken(os, binary, "<LeftContext>");
   WriteBasicType(os, binary, left_context_);
   WriteToken(os, binary, "<RightContext>");
@@ -63,6 +63,11 @@ class AmNnetSimple {
 
   void Write(std::ostream &os, bool binary) const;
 
+  /// Writes in binary form like Write(), but with the nnet written by
+  /// Nnet::WriteWithParamBlob(), which is faster to read.  Read() reads
+  /// either form.
+  void WriteWithParamBlob(std::ostream &os) const;
+
   void Read(std::istream &is, bool binary);
 
   const Nnet &GetNnet() const { return nnet_; }
@@ -99,6 +104,10 @@ class AmNnetSimple {
  private:
 
   const AmNnetSimple &operator = (const AmNnetSimple &other); // Disallow.
+
+  // Writes what follows the nnet in Write().
+  void WriteContextAndPriors(std::ostream &os, bool binary) const;
+
   Nnet nnet_;
   Vector<BaseFloat> priors_;
 
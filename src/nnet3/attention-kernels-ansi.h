@@ -0,0 +1,101 @@
+// nnet3/attention-kernels-ansi.h
+
+// Copyright      2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_NNET3_ATTENTION_KERNELS_ANSI_H_
+#define KALDI_NNET3_ATTENTION_KERNELS_ANSI_H_
+#include "cudamatrix/cu-kernels-ansi.h"  // for BaseFloat and cuda_current_stream()
+
+#if HAVE_CUDA == 1
+extern "C" {
+
+  // The kernels below each do one of the passes of AttentionForward() and
+  // AttentionBackward() (see attention.h for the notation), for all the
+  // context offsets at once.  They expect one block of CU1DBLOCK threads per
+  // row, i.e. Gr.x == num_output_rows for the first two and Gr.x ==
+  // num_output_rows + (context_dim - 1) * row_shift for the last one.
+
+  // Computes the softmax-ed attention weights 'c' and adds the weighted sum
+  // of the values to the first value_dim columns of 'output'; if
+  // output_context is true, also copies 'c' to the next context_dim columns
+  // of 'output'.
+  void cuda_attention_forward(dim3 Gr, dim3 Bl,
+                              int32_cuda row_shift, int32_cuda context_dim,
+                              int32_cuda key_dim, int32_cuda value_dim,
+                              BaseFloat key_scale,
+                              const BaseFloat *keys, int32_cuda keys_stride,
+                              const BaseFloat *queries,
+                              int32_cuda queries_stride,
+                              const BaseFloat *values,
+                              int32_cuda values_stride,
+                              BaseFloat *c, int32_cuda c_stride,
+                              BaseFloat *output, int32_cuda output_stride,
+                              bool output_context);
+
+  // Computes the derivative w.r.t. the input of the softmax (to 'b_deriv'),
+  // and adds the derivatives w.r.t. the queries (both the key and the
+  // context parts) to 'queries_deriv'.  If output_context is true,
+  // 'output_deriv' has value_dim + context_dim columns.
+  void cuda_attention_backward_queries(dim3 Gr, dim3 Bl,
+                                       int32_cuda row_shift,
+                                       int32_cuda context_dim,
+                                       int32_cuda key_dim,
+                                       int32_cuda value_dim,
+                                       BaseFloat key_scale,
+                                       const BaseFloat *keys,
+                                       int32_cuda keys_stride,
+                                       const BaseFloat *values,
+                                       int32_cuda values_stride,
+                                       const BaseFloat *c, int32_cuda c_stride,
+                                       const BaseFloat *output_deriv,
+                                       int32_cuda output_deriv_stride,
+                                       bool output_context,
+                                       BaseFloat *b_deriv,
+                                       int32_cuda b_deriv_stride,
+                                       BaseFloat *queries_deriv,
+                                       int32_cuda queries_deriv_stride);
+
+  // Adds the derivatives w.r.t. the keys and the values to 'keys_deriv' and
+  // 'values_deriv'; each input row gathers the contributions of the (up to
+  // context_dim) output rows that it was visible to.
+  void cuda_attention_backward_inputs(dim3 Gr, dim3 Bl,
+                                      int32_cuda num_output_rows,
+                                      int32_cuda row_shift,
+                                      int32_cuda context_dim,
+                                      int32_cuda key_dim,
+                                      int32_cuda value_dim,
+                                      BaseFloat key_scale,
+                                      const BaseFloat *queries,
+                                      int32_cuda queries_stride,
+                                      const BaseFloat *c, int32_cuda c_stride,
+                                      const BaseFloat *b_deriv,
+                                      int32_cuda b_deriv_stride,
+                                      const BaseFloat *output_deriv,
+                                      int32_cuda output_deriv_stride,
+                                      BaseFloat *keys_deriv,
+                                      int32_cuda keys_deriv_stride,
+                                      BaseFloat *values_deriv,
+                                      int32_cuda values_deriv_stride);
+
+} // extern "C"
+
+#endif  // HAVE_CUDA
+
+
+#endif  // KALDI_NNET3_ATTENTION_KERNELS_ANSI_H_
@@ -0,0 +1,266 @@
+// nnet3/attention-kernels.cu
+
+// Copyright      2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <cfloat>
+#include <math_constants.h>
+#include "nnet3/attention-kernels-ansi.h"
+
+
+// In all these kernels there is one block per row.  The dot products between
+// a row and the rows it attends to (there are context_dim of them, shifted by
+// row_shift each time) are done one per warp; the results, which are only
+// context_dim numbers per row, are kept in shared memory, where the first warp
+// does the softmax (or its backprop) on them.  The remaining work, which is
+// over the columns of the keys or values, is spread over all the threads of
+// the block so that the memory accesses are coalesced.
+
+__device__ static inline BaseFloat _warp_sum(BaseFloat x) {
+  for (int offset = warpSize / 2; offset > 0; offset >>= 1)
+    x += __shfl_xor_sync(0xffffffff, x, offset);
+  return x;
+}
+
+__device__ static inline BaseFloat _warp_max(BaseFloat x) {
+  for (int offset = warpSize / 2; offset > 0; offset >>= 1)
+    x = fmax(x, __shfl_xor_sync(0xffffffff, x, offset));
+  return x;
+}
+
+// Sets scores[o] = alpha * (dot product of a[0:dim] with row i + o * row_shift
+// of b) + (extra == NULL ? 0 : extra[o]), for 0 <= o < context_dim.
+__device__ static inline void _shifted_dot_products(
+    int i, int row_shift, int context_dim, int dim, BaseFloat alpha,
+    const BaseFloat *a, const BaseFloat *b, int b_stride,
+    const BaseFloat *extra, BaseFloat *scores) {
+  int lane = threadIdx.x % warpSize, warp = threadIdx.x / warpSize,
+      num_warps = blockDim.x / warpSize;
+  for (int o = warp; o < context_dim; o += num_warps) {
+    const BaseFloat *b_row = b + (i + o * row_shift) * b_stride;
+    BaseFloat sum = 0.0;
+    for (int d = lane; d < dim; d += warpSize)
+      sum += a[d] * b_row[d];
+    sum = _warp_sum(sum);
+    if (lane == 0)
+      scores[o] = alpha * sum + (extra == NULL ? 0.0 : extra[o]);
+  }
+}
+
+__global__
+static void _attention_forward(int row_shift, int context_dim,
+                               int key_dim, int value_dim,
+                               BaseFloat key_scale,
+                               const BaseFloat *keys, int keys_stride,
+                               const BaseFloat *queries, int queries_stride,
+                               const BaseFloat *values, int values_stride,
+                               BaseFloat *c, int c_stride,
+                               BaseFloat *output, int output_stride,
+                               bool output_context) {
+  extern __shared__ BaseFloat c_row[];
+  int i = blockIdx.x;
+  const BaseFloat *query = queries + i * queries_stride;
+  // The query's context part is a position-dependent bias on the scores.
+  _shifted_dot_products(i, row_shift, context_dim, key_dim, key_scale,
+                        query, keys, keys_stride, query + key_dim, c_row);
+  __syncthreads();
+  if (threadIdx.x < warpSize) {
+    BaseFloat max = -CUDART_INF_F;
+    for (int o = threadIdx.x; o < context_dim; o += warpSize)
+      max = fmax(max, c_row[o]);
+    max = _warp_max(max);
+    BaseFloat sum = 0.0;
+    for (int o = threadIdx.x; o < context_dim; o += warpSize) {
+      BaseFloat e = exp(c_row[o] - max);
+      c_row[o] = e;
+      sum += e;
+    }
+    BaseFloat inv_sum = 1.0 / _warp_sum(sum);
+    for (int o = threadIdx.x; o < context_dim; o += warpSize) {
+      BaseFloat p = c_row[o] * inv_sum;
+      c_row[o] = p;
+      c[i * c_stride + o] = p;
+      if (output_context)
+        output[i * output_stride + value_dim + o] = p;
+    }
+  }
+  __syncthreads();
+  for (int d = threadIdx.x; d < value_dim; d += blockDim.x) {
+    BaseFloat sum = 0.0;
+    for (int o = 0; o < context_dim; o++)
+      sum += c_row[o] * values[(i + o * row_shift) * values_stride + d];
+    output[i * output_stride + d] += sum;
+  }
+}
+
+__global__
+static void _attention_backward_queries(int row_shift, int context_dim,
+                                        int key_dim, int value_dim,
+                                        BaseFloat key_scale,
+                                        const BaseFloat *keys, int keys_stride,
+                                        const BaseFloat *values,
+                                        int values_stride,
+                                        const BaseFloat *c, int c_stride,
+                                        const BaseFloat *output_deriv,
+                                        int output_deriv_stride,
+                                        bool output_context,
+                                        BaseFloat *b_deriv, int b_deriv_stride,
+                                        BaseFloat *queries_deriv,
+                                        int queries_deriv_stride) {
+  extern __shared__ BaseFloat deriv_row[];
+  int i = blockIdx.x;
+  const BaseFloat *this_output_deriv = output_deriv + i * output_deriv_stride,
+      *c_row = c + i * c_stride;
+  BaseFloat *query_deriv = queries_deriv + i * queries_deriv_stride;
+  // The derivative w.r.t. c.
+  _shifted_dot_products(i, row_shift, context_dim, value_dim, 1.0,
+                        this_output_deriv, values, values_stride,
+                        (output_context ? this_output_deriv + value_dim : NULL),
+                        deriv_row);
+  __syncthreads();
+  if (threadIdx.x < warpSize) {
+    // Backprop through the softmax, as in DiffSoftmaxPerRow().
+    BaseFloat sum = 0.0;
+    for (int o = threadIdx.x; o < context_dim; o += warpSize)
+      sum += c_row[o] * deriv_row[o];
+    sum = _warp_sum(sum);
+    for (int o = threadIdx.x; o < context_dim; o += warpSize) {
+      BaseFloat d = c_row[o] * (deriv_row[o] - sum);
+      deriv_row[o] = d;
+      b_deriv[i * b_deriv_stride + o] = d;
+      query_deriv[key_dim + o] += d;
+    }
+  }
+  __syncthreads();
+  for (int d = threadIdx.x; d < key_dim; d += blockDim.x) {
+    BaseFloat sum = 0.0;
+    for (int o = 0; o < context_dim; o++)
+      sum += deriv_row[o] * keys[(i + o * row_shift) * keys_stride + d];
+    query_deriv[d] += key_scale * sum;
+  }
+}
+
+__global__
+static void _attention_backward_inputs(int num_output_rows, int row_shift,
+                                       int context_dim, int key_dim,
+                                       int value_dim, BaseFloat key_scale,
+                                       const BaseFloat *queries,
+                                       int queries_stride,
+                                       const BaseFloat *c, int c_stride,
+                                       const BaseFloat *b_deriv,
+                                       int b_deriv_stride,
+                                       const BaseFloat *output_deriv,
+                                       int output_deriv_stride,
+                                       BaseFloat *keys_deriv,
+                                       int keys_deriv_stride,
+                                       BaseFloat *values_deriv,
+                                       int values_deriv_stride) {
+  int j = blockIdx.x;
+  // Input row j is seen by output rows j - o * row_shift with 0 <= o <
+  // context_dim, as long as they exist; o_begin <= o < o_end is that range.
+  int o_begin = max(0, (j - num_output_rows + row_shift) / row_shift),
+      o_end = min(context_dim, j / row_shift + 1);
+  for (int d = threadIdx.x; d < key_dim; d += blockDim.x) {
+    BaseFloat sum = 0.0;
+    for (int o = o_begin; o < o_end; o++) {
+      int i = j - o * row_shift;
+      sum += b_deriv[i * b_deriv_stride + o] * queries[i * queries_stride + d];
+    }
+    keys_deriv[j * keys_deriv_stride + d] += key_scale * sum;
+  }
+  for (int d = threadIdx.x; d < value_dim; d += blockDim.x) {
+    BaseFloat sum = 0.0;
+    for (int o = o_begin; o < o_end; o++) {
+      int i = j - o * row_shift;
+      sum += c[i * c_stride + o] * output_deriv[i * output_deriv_stride + d];
+    }
+    values_deriv[j * values_deriv_stride + d] += sum;
+  }
+}
+
+
+void cuda_attention_forward(dim3 Gr, dim3 Bl,
+                            int32_cuda row_shift, int32_cuda context_dim,
+                            int32_cuda key_dim, int32_cuda value_dim,
+                            BaseFloat key_scale,
+                            const BaseFloat *keys, int32_cuda keys_stride,
+                            const BaseFloat *queries,
+                            int32_cuda queries_stride,
+                            const BaseFloat *values, int32_cuda values_stride,
+                            BaseFloat *c, int32_cuda c_stride,
+                            BaseFloat *output, int32_cuda output_stride,
+                            bool output_context) {
+  _attention_forward<<<Gr, Bl, context_dim * sizeof(BaseFloat),
+      cuda_current_stream()>>>(row_shift, context_dim, key_dim, value_dim,
+                               key_scale, keys, keys_stride, queries,
+                               queries_stride, values, values_stride,
+                               c, c_stride, output, output_stride,
+                               output_context);
+}
+
+void cuda_attention_backward_queries(dim3 Gr, dim3 Bl,
+                                     int32_cuda row_shift,
+                                     int32_cuda context_dim,
+                                     int32_cuda key_dim,
+                                     int32_cuda value_dim,
+                                     BaseFloat key_scale,
+                                     const BaseFloat *keys,
+                                     int32_cuda keys_stride,
+                                     const BaseFloat *values,
+                                     int32_cuda values_stride,
+                                     const BaseFloat *c, int32_cuda c_stride,
+                                     const BaseFloat *output_deriv,
+                                     int32_cuda output_deriv_stride,
+                                     bool output_context,
+                                     BaseFloat *b_deriv,
+                                     int32_cuda b_deriv_stride,
+                                     BaseFloat *queries_deriv,
+                                     int32_cuda queries_deriv_stride) {
+  _attention_backward_queries<<<Gr, Bl, context_dim * sizeof(BaseFloat),
+      cuda_current_stream()>>>(row_shift, context_dim, key_dim, value_dim,
+                               key_scale, keys, keys_stride, values,
+                               values_stride, c, c_stride, output_deriv,
+                               output_deriv_stride, output_context,
+                               b_deriv, b_deriv_stride, queries_deriv,
+                               queries_deriv_stride);
+}
+
+void cuda_attention_backward_inputs(dim3 Gr, dim3 Bl,
+                                    int32_cuda num_output_rows,
+                                    int32_cuda row_shift,
+                                    int32_cuda context_dim,
+                                    int32_cuda key_dim,
+                                    int32_cuda value_dim,
+                                    BaseFloat key_scale,
+                                    const BaseFloat *queries,
+                                    int32_cuda queries_stride,
+                                    const BaseFloat *c, int32_cuda c_stride,
+                                    const BaseFloat *b_deriv,
+                                    int32_cuda b_deriv_stride,
+                                    const BaseFloat *output_deriv,
+                                    int32_cuda output_deriv_stride,
+                                    BaseFloat *keys_deriv,
+                                    int32_cuda keys_deriv_stride,
+                                    BaseFloat *values_deriv,
+                                    int32_cuda values_deriv_stride) {
+  _attention_backward_inputs<<<Gr, Bl, 0, cuda_current_stream()>>>(
+      num_output_rows, row_shift, context_dim, key_dim, value_dim, key_scale,
+      queries, queries_stride, c, c_stride, b_deriv, b_deriv_stride,
+      output_deriv, output_deriv_stride, keys_deriv, keys_deriv_stride,
+      values_deriv, values_deriv_stride);
+}
@@ -226,8 +226,84 @@ void TestAttentionForwardBackward() {
   }
 }
 
+// Checks AttentionForward() and AttentionBackward(), which on GPU are done by
+// fused kernels, against versions built from the "Simple" functions above.
+void UnitTestAttentionForwardBackwardSimple() {
+  BaseFloat key_scale = 0.5 * RandInt(1, 3);
+  bool output_context = (RandInt(0, 1) == 0);
+  int32 output_num_rows = RandInt(1, 50),
+      value_dim = RandInt(1, 100), key_dim = RandInt(1, 100),
+      row_shift = RandInt(1, 5), context_dim = RandInt(2, 40),
+      num_extra_rows = (context_dim - 1) * row_shift,
+      input_num_rows = output_num_rows + num_extra_rows,
+      query_dim = key_dim + context_dim,
+      output_dim = value_dim + (output_context ? context_dim : 0);
+  CuMatrix<BaseFloat> keys(input_num_rows, key_dim),
+      queries(output_num_rows, query_dim),
+      values(input_num_rows, value_dim),
+      C(output_num_rows, context_dim),
+      output(output_num_rows, output_dim);
+  keys.SetRandn();
+  queries.SetRandn();
+  values.SetRandn();
+  output.SetRandn();
+  CuMatrix<BaseFloat> C2(output_num_rows, context_dim), output2(output);
+
+  AttentionForward(key_scale, keys, queries, values, &C, &output);
+
+  CuSubMatrix<BaseFloat> queries_key_part(queries, 0, output_num_rows,
+                                          0, key_dim),
+      queries_context_part(queries, 0, output_num_rows, key_dim, context_dim);
+  GetAttentionDotProductsSimple(key_scale, queries_key_part, keys, &C2);
+  C2.AddMat(1.0, queries_context_part);
+  C2.SoftMaxPerRow(C2);
+  CuSubMatrix<BaseFloat> output2_values_part(output2, 0, output_num_rows,
+                                             0, value_dim);
+  ApplyScalesToOutputSimple(1.0, values, C2, &output2_values_part);
+  if (output_context)
+    output2.ColRange(value_dim, context_dim).CopyFromMat(C2);
+  AssertEqual(C, C2);
+  AssertEqual(output, output2);
+
+  CuMatrix<BaseFloat> output_deriv(output_num_rows, output_dim),
+      keys_deriv(input_num_rows, key_dim),
+      queries_deriv(output_num_rows, query_dim),
+      values_deriv(input_num_rows, value_dim);
+  output_deriv.SetRandn();
+  keys_deriv.SetRandn();
+  queries_deriv.SetRandn();
+  values_deriv.SetRandn();
+  CuMatrix<BaseFloat> keys_deriv2(keys_deriv), queries_deriv2(queries_deriv),
+      values_deriv2(values_deriv);
+
+  AttentionBackward(key_scale, keys, queries, values, C, output_deriv,
+                    &keys_deriv, &queries_deriv, &values_deriv);
+
+  CuMatrix<BaseFloat> c_deriv(output_num_rows, context_dim);
+  CuSubMatrix<BaseFloat> output_deriv_values_part(
+      output_deriv, 0, output_num_rows, 0, value_dim);
+  GetAttentionDotProductsSimple(1.0, output_deriv_values_part, values,
+                                &c_deriv);
+  if (output_context)
+    c_deriv.AddMat(1.0, output_deriv.ColRange(value_dim, context_dim));
+  c_deriv.DiffSoftmaxPerRow(C, c_deriv);
+  queries_deriv2.ColRange(key_dim, context_dim).AddMat(1.0, c_deriv);
+  CuSubMatrix<BaseFloat> queries_deriv2_key_part(
+      queries_deriv2, 0, output_num_rows, 0, key_dim);
+  ApplyScalesToOutputSimple(key_scale, keys, c_deriv,
+                            &queries_deriv2_key_part);
+  ApplyScalesToInputSimple(key_scale, queries_key_part, c_deriv,
+                           &keys_deriv2);
+  ApplyScalesToInputSimple(1.0, output_deriv_values_part, C,
+                           &values_deriv2);
+  AssertEqual(keys_deriv, keys_deriv2);
+  AssertEqual(queries_deriv, queries_deriv2);
+  AssertEqual(values_deriv, values_deriv2);
+}
+
 void UnitTestAttention() {
   UnitTestAttentionDotProductAndAddScales();
+  UnitTestAttentionForwardBackwardSimple();
   TestAttentionForwardBackward();
 }
 
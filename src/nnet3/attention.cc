@@ -22,6 +22,7 @@
 #include <sstream>
 #include <iomanip>
 #include "nnet3/attention.h"
+#include "nnet3/attention-kernels-ansi.h"
 #include "nnet3/nnet-parse.h"
 
 namespace kaldi {
@@ -118,6 +119,27 @@ void AttentionForward(BaseFloat key_scale,
                (output->NumCols() == value_dim ||
                 output->NumCols() == value_dim + context_dim));
 
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled()) {
+    // On GPU, all of the below is done by one kernel, without the loops over
+    // the context offsets.
+    CuTimer tim;
+    int32 row_shift = (num_input_rows - num_output_rows) / (context_dim - 1);
+    dim3 dimBlock(CU1DBLOCK), dimGrid(num_output_rows);
+    cuda_attention_forward(dimGrid, dimBlock, row_shift, context_dim,
+                           key_dim, value_dim, key_scale,
+                           keys.Data(), keys.Stride(),
+                           queries.Data(), queries.Stride(),
+                           values.Data(), values.Stride(),
+                           c->Data(), c->Stride(),
+                           output->Data(), output->Stride(),
+                           output->NumCols() == value_dim + context_dim);
+    CU_SAFE_CALL(cudaGetLastError());
+    CuDevice::Instantiate().AccuProfile(__func__, tim);
+    return;
+  }
+#endif
+
   CuSubMatrix<BaseFloat> queries_key_part(
       queries, 0, num_output_rows,
       0, key_dim),
@@ -186,6 +208,38 @@ void AttentionBackward(BaseFloat key_scale,
   CuMatrix<BaseFloat> c_deriv(num_output_rows, context_dim,
                               kUndefined);
 
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled()) {
+    // On GPU this is done by two kernels: the first one, over output rows,
+    // does the backprop through the softmax (putting the derivative w.r.t. its
+    // input in c_deriv) and to the queries; the second one, over input rows,
+    // does the backprop to the keys and values.
+    CuTimer tim;
+    int32 row_shift = (num_input_rows - num_output_rows) / (context_dim - 1);
+    dim3 dimBlock(CU1DBLOCK);
+    cuda_attention_backward_queries(
+        dim3(num_output_rows), dimBlock, row_shift, context_dim, key_dim,
+        value_dim, key_scale, keys.Data(), keys.Stride(),
+        values.Data(), values.Stride(), c.Data(), c.Stride(),
+        output_deriv.Data(), output_deriv.Stride(),
+        output_deriv.NumCols() == value_dim + context_dim,
+        c_deriv.Data(), c_deriv.Stride(),
+        queries_deriv->Data(), queries_deriv->Stride());
+    CU_SAFE_CALL(cudaGetLastError());
+    cuda_attention_backward_inputs(
+        dim3(num_input_rows), dimBlock, num_output_rows, row_shift,
+        context_dim, key_dim, value_dim, key_scale,
+        queries.Data(), queries.Stride(), c.Data(), c.Stride(),
+        c_deriv.Data(), c_deriv.Stride(),
+        output_deriv.Data(), output_deriv.Stride(),
+        keys_deriv->Data(), keys_deriv->Stride(),
+        values_deriv->Data(), values_deriv->Stride());
+    CU_SAFE_CALL(cudaGetLastError());
+    CuDevice::Instantiate().AccuProfile(__func__, tim);
+    return;
+  }
+#endif
+
   CuSubMatrix<BaseFloat> output_values_part_deriv(
       output_deriv, 0, num_output_rows, 0, value_dim);
   // This is the backprop w.r.t. the forward-pass statement:
@@ -401,6 +401,7 @@ void UnitTestTimeHeightConvolutionCompile() {
     GetRandomConvolutionIndexes(conv_model, &input_indexes, &output_indexes);
 
     ConvolutionComputationOptions opts;
+    opts.use_im2col = (RandInt(0, 1) == 0);
     ConvolutionComputation computation;
     std::vector<Index> input_indexes_modified, output_indexes_modified;
     CompileConvolutionComputation(conv_model, input_indexes, output_indexes,
@@ -434,9 +435,134 @@ void UnitTestTimeHeightConvolutionCompile() {
 }
 
 
+// Checks that the im2col version of the computation (see
+// ConvolutionComputation::im2col_rows) gives the same results as doing it step
+// by step, with and without splitting it into pieces to save memory.
+void UnitTestTimeHeightConvolutionIm2col() {
+  for (int32 i = 0; i < 10; i++) {
+    ConvolutionModel conv_model;
+    GetRandomConvolutionModel(&conv_model);
+    std::vector<Index> input_indexes, output_indexes;
+    GetRandomConvolutionIndexes(conv_model, &input_indexes, &output_indexes);
+
+    ConvolutionComputationOptions opts, im2col_opts;
+    opts.use_im2col = false;
+    if (RandInt(0, 1) == 0)
+      im2col_opts.max_memory_mb = 1.0e-05;  // so it does one t at a time.
+    ConvolutionComputation computation, im2col_computation;
+    std::vector<Index> input_indexes_modified, output_indexes_modified;
+    CompileConvolutionComputation(conv_model, input_indexes, output_indexes,
+                                  opts, &computation,
+                                  &input_indexes_modified,
+                                  &output_indexes_modified);
+    CompileConvolutionComputation(conv_model, input_indexes, output_indexes,
+                                  im2col_opts, &im2col_computation,
+                                  &input_indexes_modified,
+                                  &output_indexes_modified);
+    KALDI_ASSERT(computation.im2col_rows == 0 &&
+                 (im2col_computation.im2col_rows > 0) ==
+                 (im2col_computation.steps.size() > 1));
+
+    int32 num_input_rows = input_indexes_modified.size(),
+        num_output_rows = output_indexes_modified.size();
+    CuMatrix<BaseFloat> input(num_input_rows, conv_model.InputDim(),
+                              kSetZero, kStrideEqualNumCols),
+        output_deriv(num_output_rows, conv_model.OutputDim(),
+                     kSetZero, kStrideEqualNumCols),
+        params(conv_model.ParamRows(), conv_model.ParamCols());
+    input.SetRandn();
+    output_deriv.SetRandn();
+    params.SetRandn();
+    CuMatrix<BaseFloat> output(num_output_rows, conv_model.OutputDim(),
+                               kSetZero, kStrideEqualNumCols),
+        output2(num_output_rows, conv_model.OutputDim(),
+                kSetZero, kStrideEqualNumCols),
+        input_deriv(num_input_rows, conv_model.InputDim(),
+                    kSetZero, kStrideEqualNumCols),
+        input_deriv2(num_input_rows, conv_model.InputDim(),
+                     kSetZero, kStrideEqualNumCols),
+        params_deriv(conv_model.ParamRows(), conv_model.ParamCols()),
+        params_deriv2(conv_model.ParamRows(), conv_model.ParamCols());
+
+    ConvolveForward(computation, input, params, &output);
+    ConvolveForward(im2col_computation, input, params, &output2);
+    ConvolveBackwardData(computation, params, output_deriv, &input_deriv);
+    ConvolveBackwardData(im2col_computation, params, output_deriv,
+                         &input_deriv2);
+    ConvolveBackwardParams(computation, input, output_deriv, 0.5,
+                           &params_deriv);
+    ConvolveBackwardParams(im2col_computation, input, output_deriv, 0.5,
+                           &params_deriv2);
+    KALDI_ASSERT(output.ApproxEqual(output2, 0.001) &&
+                 input_deriv.ApproxEqual(input_deriv2, 0.001) &&
+                 params_deriv.ApproxEqual(params_deriv2, 0.001));
+  }
+}
+
+// Compares the speed of the im2col and step-by-step versions of the
+// computation for a 3x3 convolution of the size used in CNN-TDNN setups.
+void UnitTestTimeHeightConvolutionSpeed() {
+  ConvolutionModel conv_model;
+  conv_model.num_filters_in = 32;
+  conv_model.num_filters_out = 32;
+  conv_model.height_in = 20;
+  conv_model.height_out = 20;
+  conv_model.height_subsample_out = 1;
+  for (int32 t = -1; t <= 1; t++) {
+    for (int32 h = -1; h <= 1; h++) {
+      ConvolutionModel::Offset o;
+      o.time_offset = t;
+      o.height_offset = h;
+      conv_model.offsets.push_back(o);
+    }
+    conv_model.required_time_offsets.insert(t);
+  }
+  conv_model.ComputeDerived();
+  KALDI_ASSERT(conv_model.Check());
+
+  std::vector<Index> input_indexes, output_indexes;
+  for (int32 n = 0; n < 16; n++) {
+    for (int32 t = -1; t <= 50; t++) {
+      input_indexes.push_back(Index(n, t));
+      if (t >= 0 && t < 50)
+        output_indexes.push_back(Index(n, t));
+    }
+  }
+
+  for (int32 use_im2col = 0; use_im2col <= 1; use_im2col++) {
+    ConvolutionComputationOptions opts;
+    opts.use_im2col = (use_im2col != 0);
+    ConvolutionComputation computation;
+    std::vector<Index> input_indexes_modified, output_indexes_modified;
+    CompileConvolutionComputation(conv_model, input_indexes, output_indexes,
+                                  opts, &computation,
+                                  &input_indexes_modified,
+                                  &output_indexes_modified);
+    CuMatrix<BaseFloat> input(input_indexes_modified.size(),
+                              conv_model.InputDim(),
+                              kSetZero, kStrideEqualNumCols),
+        output(output_indexes_modified.size(), conv_model.OutputDim(),
+               kSetZero, kStrideEqualNumCols),
+        params(conv_model.ParamRows(), conv_model.ParamCols());
+    input.SetRandn();
+    params.SetRandn();
+    int32 num_iters = 10;
+    Timer timer;
+    for (int32 i = 0; i < num_iters; i++) {
+      ConvolveForward(computation, input, params, &output);
+      ConvolveBackwardData(computation, params, output, &input);
+    }
+    KALDI_LOG << "For " << conv_model.Info() << ", with use-im2col="
+              << (use_im2col != 0 ? "true" : "false") << ", forward+backward "
+              << "took " << (timer.Elapsed() / num_iters) << " seconds.";
+  }
+}
+
+
 void UnitTestTimeHeightConvolution() {
   UnitTestTimeHeightConvolutionIo();
   UnitTestTimeHeightConvolutionCompile();
+  UnitTestTimeHeightConvolutionIm2col();
 }
 
 
@@ -461,5 +587,6 @@ int main() {
     for (int32 i = 0; i < 5; i++) {
       UnitTestTimeHeightConvolution();
     }
+    UnitTestTimeHeightConvolutionSpeed();
   }
 }
@@ -308,6 +308,8 @@ void ConvolutionComputation::Write(std::ostream &os, bool binary) const {
     WriteToken(os, binary, "<HeightMap>");
     WriteIntegerVector(os, binary, step.height_map);
   }
+  WriteToken(os, binary, "<Im2colRows>");
+  WriteBasicType(os, binary, im2col_rows);
   WriteToken(os, binary, "</ConvComputation>");
 }
 
@@ -340,7 +342,16 @@ void ConvolutionComputation::Read(std::istream &is, bool binary) {
     ExpectToken(is, binary, "<HeightMap>");
     ReadIntegerVector(is, binary, &step.height_map);
   }
-  ExpectToken(is, binary, "</ConvComputation>");
+  std::string tok;
+  ReadToken(is, binary, &tok);
+  if (tok == "<Im2colRows>") {
+    ReadBasicType(is, binary, &im2col_rows);
+    ReadToken(is, binary, &tok);
+  } else {
+    im2col_rows = 0;  // Older computations don't use im2col.
+  }
+  if (tok != "</ConvComputation>")
+    KALDI_ERR << "Expected </ConvComputation>, got " << tok;
   ComputeDerived();
   Check();
 }
@@ -355,6 +366,9 @@ void ConvolutionComputation::Check() const {
                (temp_rows <= num_t_out * num_images &&
                 temp_cols > 0));
   KALDI_ASSERT(temp_rows % num_images == 0);
+  KALDI_ASSERT(im2col_rows >= 0 && im2col_rows <= num_t_out * num_images &&
+               im2col_rows % num_images == 0);
+  KALDI_ASSERT((im2col_rows == 0) == (im2col_columns.Dim() == 0));
   bool temp_mat_required = false;
   int32 num_steps = steps.size();
   int32 num_extra_input_times = num_t_in - num_t_out,
@@ -440,6 +454,151 @@ void ConvolutionComputation::Check() const {
 }
 
 
+// Copies the input of all the steps to the im2col temporary matrix
+// 'temp_mat' (see ConvolutionComputation::im2col_columns).  'input' is the
+// part of the input matrix that corresponds to the rows of 'temp_mat' (it has
+// the extra input time steps at the end).
+static void CopyToIm2colMatrix(const ConvolutionComputation &cc,
+                               const CuMatrixBase<BaseFloat> &input,
+                               CuMatrixBase<BaseFloat> *temp_mat) {
+  int32 input_cols = input.NumCols(),
+      output_rows = temp_mat->NumRows();
+  KALDI_ASSERT(input.Stride() == input_cols &&
+               input_cols == cc.height_in * cc.num_filters_in &&
+               input.NumRows() >= output_rows);
+  // Row r of 'input_overlapped' starts at row r of 'input' and extends to the
+  // end of row r + (input.NumRows() - output_rows) of 'input'; its stride is
+  // less than its num-cols, which CopyCols() is OK with.
+  CuSubMatrix<BaseFloat> input_overlapped(
+      input.Data(), output_rows,
+      (input.NumRows() - output_rows + 1) * input_cols, input_cols);
+  temp_mat->CopyCols(input_overlapped, cc.im2col_columns);
+}
+
+// This is the version of ConvolveForward() that's used if cc.im2col_rows > 0.
+// It does one matrix multiplication per block of cc.im2col_rows output rows.
+static void ConvolveForwardIm2col(
+    const ConvolutionComputation &cc,
+    const CuMatrixBase<BaseFloat> &input,
+    const CuMatrixBase<BaseFloat> &params,
+    CuMatrixBase<BaseFloat> *output) {
+  int32 im2col_cols = cc.im2col_columns.Dim(),
+      params_cols = params.NumCols(),
+      num_extra_in = cc.num_t_in - cc.num_t_out,
+      num_time_steps_per_chunk = cc.im2col_rows / cc.num_images;
+  KALDI_ASSERT(im2col_cols == cc.height_out * params_cols);
+  CuMatrix<BaseFloat> temp_mat(cc.im2col_rows, im2col_cols,
+                               kUndefined, kStrideEqualNumCols);
+  for (int32 t_start = 0; t_start < cc.num_t_out;
+       t_start += num_time_steps_per_chunk) {
+    int32 this_num_t_out = std::min<int32>(cc.num_t_out - t_start,
+                                           num_time_steps_per_chunk),
+        this_num_t_in = this_num_t_out + num_extra_in,
+        this_num_rows = this_num_t_out * cc.num_images;
+    CuSubMatrix<BaseFloat> input_part(input, t_start * cc.num_images,
+                                      this_num_t_in * cc.num_images,
+                                      0, input.NumCols()),
+        output_part(*output, t_start * cc.num_images, this_num_rows,
+                    0, output->NumCols()),
+        temp_part(temp_mat, 0, this_num_rows, 0, im2col_cols);
+    CopyToIm2colMatrix(cc, input_part, &temp_part);
+    CuSubMatrix<BaseFloat> temp_reshaped(
+        temp_part.Data(), this_num_rows * cc.height_out,
+        params_cols, params_cols),
+        output_reshaped(output_part.Data(), this_num_rows * cc.height_out,
+                        cc.num_filters_out, cc.num_filters_out);
+    output_reshaped.AddMatMat(1.0, temp_reshaped, kNoTrans,
+                              params, kTrans, 1.0);
+  }
+}
+
+// This is the version of ConvolveBackwardData() that's used if
+// cc.im2col_rows > 0.
+static void ConvolveBackwardDataIm2col(
+    const ConvolutionComputation &cc,
+    const CuMatrixBase<BaseFloat> &params,
+    const CuMatrixBase<BaseFloat> &output_deriv,
+    CuMatrixBase<BaseFloat> *input_deriv) {
+  int32 im2col_cols = cc.im2col_columns.Dim(),
+      params_cols = params.NumCols(),
+      num_extra_in = cc.num_t_in - cc.num_t_out,
+      num_time_steps_per_chunk = cc.im2col_rows / cc.num_images;
+  KALDI_ASSERT(im2col_cols == cc.height_out * params_cols);
+  CuMatrix<BaseFloat> temp_mat(cc.im2col_rows, im2col_cols,
+                               kSetZero, kStrideEqualNumCols);
+  for (int32 t_start = 0; t_start < cc.num_t_out;
+       t_start += num_time_steps_per_chunk) {
+    int32 this_num_t_out = std::min<int32>(cc.num_t_out - t_start,
+                                           num_time_steps_per_chunk),
+        this_num_t_in = this_num_t_out + num_extra_in,
+        this_num_rows = this_num_t_out * cc.num_images;
+    CuSubMatrix<BaseFloat> input_deriv_part(
+        *input_deriv, t_start * cc.num_images,
+        this_num_t_in * cc.num_images, 0, input_deriv->NumCols()),
+        output_deriv_part(output_deriv, t_start * cc.num_images,
+                          this_num_rows, 0, output_deriv.NumCols()),
+        temp_part(temp_mat, 0, this_num_rows, 0, im2col_cols);
+    CuSubMatrix<BaseFloat> temp_reshaped(
+        temp_part.Data(), this_num_rows * cc.height_out,
+        params_cols, params_cols),
+        output_deriv_reshaped(
+            output_deriv_part.Data(), this_num_rows * cc.height_out,
+            cc.num_filters_out, cc.num_filters_out);
+    temp_reshaped.AddMatMat(1.0, output_deriv_reshaped, kNoTrans,
+                            params, kNoTrans, 0.0);
+    // The steps' input rows overlap, so their derivatives have to be added
+    // one step at a time.
+    for (size_t s = 0; s < cc.steps.size(); s++) {
+      const ConvolutionComputation::ConvolutionStep &step = cc.steps[s];
+      CuSubMatrix<BaseFloat> input_deriv_step(
+          input_deriv_part, step.input_time_shift * cc.num_images,
+          this_num_rows, 0, input_deriv_part.NumCols());
+      for (size_t i = 0; i < step.im2col_backward_columns.size(); i++)
+        input_deriv_step.AddCols(temp_part, step.im2col_backward_columns[i]);
+    }
+  }
+}
+
+// This is the version of ConvolveBackwardParams() that's used if
+// cc.im2col_rows > 0.
+static void ConvolveBackwardParamsIm2col(
+    const ConvolutionComputation &cc,
+    const CuMatrixBase<BaseFloat> &input,
+    const CuMatrixBase<BaseFloat> &output_deriv,
+    BaseFloat alpha,
+    CuMatrixBase<BaseFloat> *params_deriv) {
+  int32 im2col_cols = cc.im2col_columns.Dim(),
+      params_cols = params_deriv->NumCols(),
+      num_extra_in = cc.num_t_in - cc.num_t_out,
+      num_time_steps_per_chunk = cc.im2col_rows / cc.num_images;
+  KALDI_ASSERT(im2col_cols == cc.height_out * params_cols);
+  CuMatrix<BaseFloat> temp_mat(cc.im2col_rows, im2col_cols,
+                               kUndefined, kStrideEqualNumCols);
+  for (int32 t_start = 0; t_start < cc.num_t_out;
+       t_start += num_time_steps_per_chunk) {
+    int32 this_num_t_out = std::min<int32>(cc.num_t_out - t_start,
+                                           num_time_steps_per_chunk),
+        this_num_t_in = this_num_t_out + num_extra_in,
+        this_num_rows = this_num_t_out * cc.num_images;
+    CuSubMatrix<BaseFloat> input_part(input, t_start * cc.num_images,
+                                      this_num_t_in * cc.num_images,
+                                      0, input.NumCols()),
+        output_deriv_part(output_deriv, t_start * cc.num_images,
+                          this_num_rows, 0, output_deriv.NumCols()),
+        temp_part(temp_mat, 0, this_num_rows, 0, im2col_cols);
+    CopyToIm2colMatrix(cc, input_part, &temp_part);
+    CuSubMatrix<BaseFloat> temp_reshaped(
+        temp_part.Data(), this_num_rows * cc.height_out,
+        params_cols, params_cols),
+        output_deriv_reshaped(
+            output_deriv_part.Data(), this_num_rows * cc.height_out,
+            cc.num_filters_out, cc.num_filters_out);
+    params_deriv->AddMatMat(alpha, output_deriv_reshaped, kTrans,
+                            temp_reshaped, kNoTrans, 1.0);
+  }
+}
+
+
 // Internal function called inside ConvolveForward.
 // Note: the number of time steps covered may be different
 // from that implied by cc.num_t_in and cc.num_t_out
@@ -555,6 +714,11 @@ void ConvolveForward(
     return;
   }
 
+  if (cc.im2col_rows > 0) {
+    ConvolveForwardIm2col(cc, input, params, output);
+    return;
+  }
+
   CuMatrix<BaseFloat> temp_mat(cc.temp_rows, cc.temp_cols,
                                kUndefined, kStrideEqualNumCols);
 
@@ -714,6 +878,11 @@ void ConvolveBackwardData(
     return;
   }
 
+  if (cc.im2col_rows > 0) {
+    ConvolveBackwardDataIm2col(cc, params, output_deriv, input_deriv);
+    return;
+  }
+
   CuMatrix<BaseFloat> temp_mat(cc.temp_rows, cc.temp_cols,
                                kSetZero, kStrideEqualNumCols);
 
@@ -873,6 +1042,12 @@ void ConvolveBackwardParams(
     return;
   }
 
+  if (cc.im2col_rows > 0) {
+    ConvolveBackwardParamsIm2col(cc, input, output_deriv, alpha,
+                                 params_deriv);
+    return;
+  }
+
   CuMatrix<BaseFloat> temp_mat(cc.temp_rows, cc.temp_cols,
                                kUndefined, kStrideEqualNumCols);
 
@@ -951,7 +1126,8 @@ void PadModelHeight(const ConvolutionModel &model,
 }
 
 
-/** This function sets 'temp_rows' and 'temp_cols' in 'computation'.
+/** This function sets 'temp_rows', 'temp_cols' and 'im2col_rows' in
+    'computation'.
  */
 static void ComputeTempMatrixSize(const ConvolutionComputationOptions &opts,
                                   ConvolutionComputation *computation) {
@@ -996,6 +1172,31 @@ static void ComputeTempMatrixSize(const ConvolutionComputationOptions &opts,
   computation->temp_rows = temp_rows;
   computation->temp_cols = temp_cols;
 
+  // Work out im2col_rows.  We can only do the computation with one matrix
+  // multiplication if the parameter column ranges of the steps are
+  // consecutive, which they always are as created by MakeComputation().
+  int32 im2col_rows = 0, num_steps = computation->steps.size();
+  if (opts.use_im2col && num_steps > 1) {
+    int32 im2col_cols = 0;
+    bool consecutive = true;
+    for (int32 s = 0; s < num_steps; s++) {
+      const ConvolutionComputation::ConvolutionStep &step =
+          computation->steps[s];
+      if (step.params_start_col * computation->height_out != im2col_cols)
+        consecutive = false;
+      im2col_cols += step.height_map.size() * computation->num_filters_in;
+    }
+    if (consecutive) {
+      // As for the temporary matrix above, respect the memory limit.
+      im2col_rows = computation->num_t_out * computation->num_images;
+      BaseFloat num_megabytes =
+          (4 * (im2col_rows / 1000.0) * (im2col_cols / 1000.0));
+      int32 ratio = 1.0 + num_megabytes / opts.max_memory_mb;
+      int32 new_num_t_out = (computation->num_t_out + ratio - 1) / ratio;
+      im2col_rows = new_num_t_out * computation->num_images;
+    }
+  }
+  computation->im2col_rows = im2col_rows;
 }
 
 void UnPadModelHeight(const ConvolutionComputationOptions &opts,
@@ -1313,6 +1514,46 @@ void ConvolutionComputation::ComputeDerived() {
     }
   }
   KALDI_ASSERT(temp_cols == largest_required_temp_cols);
+
+  if (im2col_rows == 0) {
+    im2col_columns.Resize(0);
+    for (size_t s = 0; s < steps.size(); s++)
+      steps[s].im2col_backward_columns.clear();
+    return;
+  }
+  // Set up im2col_columns and the steps' im2col_backward_columns.  In each
+  // row of the im2col matrix reshaped to have height_out times as many rows,
+  // step s has the column range starting at params_start_col, so it is
+  // multiplied by the same parameters as in the step-by-step computation.
+  int32 num_steps = steps.size(), params_cols = 0;
+  for (int32 s = 0; s < num_steps; s++) {
+    KALDI_ASSERT(steps[s].params_start_col == params_cols);
+    params_cols += steps[s].columns.Dim() / height_out;
+  }
+  int32 im2col_cols = height_out * params_cols,
+      shift_stride = num_images * input_dim;
+  std::vector<int32> all_columns(im2col_cols, -1);
+  for (int32 s = 0; s < num_steps; s++) {
+    ConvolutionStep &step = steps[s];
+    std::vector<int32> columns, step_columns(im2col_cols, -1);
+    step.columns.CopyToVec(&columns);
+    int32 step_params_cols = columns.size() / height_out;
+    for (int32 h = 0; h < height_out; h++) {
+      for (int32 j = 0; j < step_params_cols; j++) {
+        int32 c = columns[h * step_params_cols + j],
+            i = h * params_cols + step.params_start_col + j;
+        step_columns[i] = c;
+        if (c != -1)
+          all_columns[i] = step.input_time_shift * shift_stride + c;
+      }
+    }
+    std::vector<std::vector<int32> > backward_columns;
+    ReverseColumnMapping(step_columns, input_dim, &backward_columns);
+    step.im2col_backward_columns.resize(backward_columns.size());
+    for (size_t i = 0; i < backward_columns.size(); i++)
+      step.im2col_backward_columns[i].CopyFromVec(backward_columns[i]);
+  }
+  im2col_columns.CopyFromVec(all_columns);
 }
 
 
@@ -339,15 +339,44 @@ struct ConvolutionComputation {
     // only of interest if 'columns_are_contiguous' is true (it enables an
     // optimization).
     int32 first_column;
+
+    // 'im2col_backward_columns' is derived from 'columns'; it is only set up
+    // if im2col_rows > 0.  It is like 'backward_columns', but its elements
+    // index the columns of the "im2col" temporary matrix (see
+    // 'im2col_columns') rather than those of this step's temporary matrix.
+    std::vector<CuArray<int32> > im2col_backward_columns;
   };
   std::vector<ConvolutionStep> steps;
 
+  // If im2col_rows > 0, the computation is done "im2col" style: for each
+  // block of im2col_rows output rows (a multiple of num_images), the input of
+  // all the steps is copied into a single temporary matrix, which is then
+  // multiplied by the whole of the parameter matrix, instead of doing one
+  // matrix multiplication per step.  This launches fewer, larger matrix
+  // multiplications, which is a lot faster on GPU.  It's zero if there is
+  // only one step, if the parameter column ranges of the steps are not
+  // consecutive, or if the option use_im2col was false.
+  int32 im2col_rows;
+
+  // 'im2col_columns' is derived from 'steps'; it is only set up if
+  // im2col_rows > 0.  Its dimension is the num-cols of the im2col temporary
+  // matrix, which is height_out times the num-cols of the parameter matrix;
+  // when reshaped to have height_out times as many rows, each row of that
+  // matrix is the concatenation of the reshaped temporary matrices of all the
+  // steps.  It indexes a view of the input matrix with overlapping rows (its
+  // stride is the num-cols of the input), so that the element
+  // input(r + step.input_time_shift * num_images, c) is at column
+  // step.input_time_shift * num_images * height_in * num_filters_in + c of
+  // row r.  As for 'columns', -1 means write a zero.
+  CuArray<int32> im2col_columns;
+
 
   void Write(std::ostream &os, bool binary) const;
   void Read(std::istream &is, bool binary);
 
   // Computes derived variables in 'steps', i.e. 'columns', 'backward_columns',
-  // columns_are_contiguous, and 'first_column'.
+  // columns_are_contiguous, 'first_column' and 'im2col_backward_columns', and
+  // 'im2col_columns'.
   void ComputeDerived();
 
   // check that this computation makes sense; crash if not.
@@ -364,7 +393,14 @@ struct ConvolutionComputationOptions {
   // for the temporary matrix.  If it would exceed this amount, we do the
   // computation in batches.
   BaseFloat max_memory_mb;
-  ConvolutionComputationOptions(): max_memory_mb(200.0) { }
+  // If true (and there is more than one step), do the computation with a
+  // single matrix multiplication per block of rows ("im2col"); see
+  // ConvolutionComputation::im2col_rows.  This uses more temporary memory
+  // (but no more than max_memory_mb).  It is much faster on GPU, where the
+  // many small matrix multiplications are dominated by the kernel launches,
+  // but a little slower on CPU because of the extra copying.
+  bool use_im2col;
+  ConvolutionComputationOptions(): max_memory_mb(200.0), use_im2col(false) { }
 };
 
 
@@ -0,0 +1,308 @@
+// nnet3/decodable-online-batched.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include "nnet3/decodable-online-batched.h"
+#include "base/timer.h"
+#include "matrix/simd-math.h"
+
+namespace kaldi {
+namespace nnet3 {
+
+NnetBatchOnlineTaskCreator::NnetBatchOnlineTaskCreator(
+    NnetBatchComputer *computer,
+    OnlineFeatureInterface *input_features,
+    OnlineFeatureInterface *ivector_features):
+    computer_(computer),
+    opts_(computer->GetOptions()),
+    input_features_(input_features),
+    ivector_features_(ivector_features),
+    subsampled_frames_per_chunk_(opts_.frames_per_chunk /
+                                 opts_.frame_subsampling_factor),
+    num_subsampled_frames_created_(0) {
+  KALDI_ASSERT(input_features_ != NULL && subsampled_frames_per_chunk_ > 0);
+  int32 feat_ivector_dim = (ivector_features_ != NULL ?
+                            ivector_features_->Dim() : 0);
+  if (computer_->InputDim() != input_features_->Dim()) {
+    KALDI_ERR << "Input feature dimension mismatch: got "
+              << input_features_->Dim() << " but network expects "
+              << computer_->InputDim();
+  }
+  if (computer_->IvectorDim() != feat_ivector_dim) {
+    KALDI_ERR << "Ivector feature dimension mismatch: got " << feat_ivector_dim
+              << " but network expects " << computer_->IvectorDim();
+  }
+}
+
+int32 NnetBatchOnlineTaskCreator::NumSubsampledFramesComputable(
+    bool *input_finished) const {
+  int32 features_ready = input_features_->NumFramesReady(),
+      sf = opts_.frame_subsampling_factor;
+  *input_finished = (features_ready > 0 &&
+                     input_features_->IsLastFrame(features_ready - 1));
+  if (features_ready == 0)
+    return 0;
+  if (*input_finished) {
+    // We'll pad with duplicates of the last frame as needed to get the
+    // required right context.
+    return (features_ready + sf - 1) / sf;
+  }
+  // A chunk whose output ends at (subsampled) frame 'end' can be computed once
+  // the input frames up to end * sf + right_context - 1 are ready.  All the
+  // chunks that were created before the input finished are full chunks, so
+  // 'created' is a multiple of the chunk size.
+  int32 right_context = computer_->NnetRightContext() +
+      opts_.extra_right_context,
+      max_end = std::max<int32>(0, features_ready - right_context) / sf,
+      created = num_subsampled_frames_created_;
+  if (max_end <= created)
+    return created;
+  int32 num_chunks = (max_end - created) / subsampled_frames_per_chunk_;
+  return created + num_chunks * subsampled_frames_per_chunk_;
+}
+
+void NnetBatchOnlineTaskCreator::SetUpTaskInput(
+    int32 begin_output_t, int32 num_features_ready, bool input_finished,
+    int32 num_subsampled_frames, NnetInferenceTask *task) const {
+  // This follows SplitInputToTasks() in nnet-batch-compute.cc.
+  int32 f = opts_.frame_subsampling_factor,
+      nnet_left_context = computer_->NnetLeftContext(),
+      nnet_right_context = computer_->NnetRightContext(),
+      extra_left_context_initial = (opts_.extra_left_context_initial < 0 ?
+                                    opts_.extra_left_context :
+                                    opts_.extra_left_context_initial),
+      extra_right_context_final = (opts_.extra_right_context_final < 0 ?
+                                   opts_.extra_right_context :
+                                   opts_.extra_right_context_final),
+      end_output_t = begin_output_t + task->num_output_frames,
+      begin_input_t = begin_output_t * f,
+      end_input_t = end_output_t * f;
+  bool left_edge = (begin_output_t <= 0),
+      right_edge = (input_finished && end_output_t >= num_subsampled_frames);
+  int32 tot_left_context = nnet_left_context +
+      (left_edge ? extra_left_context_initial : opts_.extra_left_context),
+      tot_right_context = nnet_right_context +
+      (right_edge ? extra_right_context_final : opts_.extra_right_context);
+  task->is_edge =
+      (tot_left_context != nnet_left_context + opts_.extra_left_context ||
+       tot_right_context != nnet_right_context + opts_.extra_right_context);
+
+  int32 begin_input_t_padded = begin_input_t - tot_left_context,
+      end_input_t_padded = end_input_t + tot_right_context;
+  task->first_input_t = begin_input_t_padded - begin_input_t;
+
+  // Get the input frames, padding with copies of the first and last frames as
+  // needed.
+  std::vector<int32> frames;
+  frames.reserve(end_input_t_padded - begin_input_t_padded);
+  for (int32 t = begin_input_t_padded; t < end_input_t_padded; t++)
+    frames.push_back(std::max<int32>(0, std::min<int32>(
+        t, num_features_ready - 1)));
+  Matrix<BaseFloat> input(frames.size(), input_features_->Dim(), kUndefined);
+  input_features_->GetFrames(frames, &input);
+  task->input.Swap(&input);
+
+  if (ivector_features_ != NULL) {
+    // As in AddOnlineIvectorsToTasks(), we use the i-vector from the middle of
+    // the chunk, or the most recent one if that is not ready.
+    Vector<BaseFloat> ivector(ivector_features_->Dim());
+    int32 mid_input_t = (begin_output_t + task->num_output_frames / 2) * f,
+        num_ivector_frames_ready = ivector_features_->NumFramesReady();
+    if (num_ivector_frames_ready > 0)
+      ivector_features_->GetFrame(
+          std::min<int32>(mid_input_t, num_ivector_frames_ready - 1), &ivector);
+    // else just leave the iVector zero (would only happen at the very start
+    // of the input, with small chunk sizes).
+    task->ivector.Resize(ivector.Dim(), kUndefined);
+    task->ivector.CopyFromVec(ivector);
+  }
+}
+
+void NnetBatchOnlineTaskCreator::CreateTasks(
+    bool output_to_cpu, double priority,
+    std::vector<NnetInferenceTask> *tasks) {
+  bool input_finished;
+  int32 num_features_ready = input_features_->NumFramesReady(),
+      begin = num_subsampled_frames_created_,
+      end = NumSubsampledFramesComputable(&input_finished),
+      fpc = subsampled_frames_per_chunk_;
+  tasks->clear();
+  if (end <= begin)
+    return;
+  // When the input has finished, 'end' is the total number of output frames.
+  int32 num_subsampled_frames = end;
+
+  int32 num_tasks = (end - begin + fpc - 1) / fpc;
+  tasks->resize(num_tasks);
+  for (int32 i = 0; i < num_tasks; i++) {
+    NnetInferenceTask &task = (*tasks)[i];
+    int32 first_used = begin + i * fpc,
+        num_used = std::min<int32>(fpc, end - first_used),
+        begin_output_t;
+    task.output_t_stride = opts_.frame_subsampling_factor;
+    task.first_used_output_frame_index = first_used;
+    task.num_used_output_frames = num_used;
+    task.is_irregular = false;
+    task.num_output_frames = fpc;
+    if (num_used == fpc) {
+      begin_output_t = first_used;
+      task.num_initial_unused_output_frames = 0;
+    } else if (end >= fpc) {
+      // This is the last chunk after the input finished.  It will end on the
+      // last frame, but we won't use the part of its output that overlaps with
+      // the preceding chunk.
+      begin_output_t = end - fpc;
+      task.num_initial_unused_output_frames = first_used - begin_output_t;
+    } else {
+      // The whole utterance is shorter than a chunk.
+      begin_output_t = 0;
+      task.num_initial_unused_output_frames = 0;
+      if (opts_.ensure_exact_final_context) {
+        task.num_output_frames = num_used;
+        task.is_irregular = true;
+      }
+    }
+    SetUpTaskInput(begin_output_t, num_features_ready, input_finished,
+                   num_subsampled_frames, &task);
+    task.priority = priority;
+    task.output_to_cpu = output_to_cpu;
+  }
+  num_subsampled_frames_created_ = end;
+}
+
+
+DecodableAmNnetBatchedOnline::DecodableAmNnetBatchedOnline(
+    const TransitionModel &trans_model,
+    NnetBatchComputer *computer,
+    OnlineFeatureInterface *input_features,
+    OnlineFeatureInterface *ivector_features):
+    trans_model_(trans_model),
+    computer_(computer),
+    task_creator_(computer, input_features, ivector_features),
+    current_log_post_subsampled_offset_(0),
+    frame_offset_(0) { }
+
+int32 DecodableAmNnetBatchedOnline::NumFramesReady() const {
+  bool input_finished;
+  return task_creator_.NumSubsampledFramesComputable(&input_finished) -
+      frame_offset_;
+}
+
+bool DecodableAmNnetBatchedOnline::IsLastFrame(int32 subsampled_frame) const {
+  bool input_finished;
+  int32 num_frames =
+      task_creator_.NumSubsampledFramesComputable(&input_finished);
+  if (!input_finished)
+    return false;
+  return (subsampled_frame + frame_offset_ == num_frames - 1);
+}
+
+void DecodableAmNnetBatchedOnline::SetFrameOffset(int32 frame_offset) {
+  KALDI_ASSERT(0 <= frame_offset &&
+               frame_offset <= frame_offset_ + NumFramesReady());
+  frame_offset_ = frame_offset;
+}
+
+BaseFloat DecodableAmNnetBatchedOnline::LogLikelihood(int32 subsampled_frame,
+                                                      int32 transition_id) {
+  subsampled_frame += frame_offset_;
+  EnsureFrameIsComputed(subsampled_frame);
+  return current_log_post_(
+      subsampled_frame - current_log_post_subsampled_offset_,
+      trans_model_.TransitionIdToPdfFast(transition_id));
+}
+
+void DecodableAmNnetBatchedOnline::LogLikelihoods(int32 subsampled_frame,
+                                                  const int32 *transition_ids,
+                                                  BaseFloat *log_likes,
+                                                  int32 num_indexes) {
+  subsampled_frame += frame_offset_;
+  EnsureFrameIsComputed(subsampled_frame);
+  const BaseFloat *row = current_log_post_.RowData(
+      subsampled_frame - current_log_post_subsampled_offset_);
+  GatherVec(BaseFloat(1.0), row, &(trans_model_.TransitionIdToPdfArray()[0]),
+            transition_ids, num_indexes, log_likes);
+}
+
+void DecodableAmNnetBatchedOnline::ComputeReadyChunks() {
+  int32 begin = task_creator_.NumSubsampledFramesCreated();
+  KALDI_ASSERT(begin == current_log_post_subsampled_offset_ +
+               current_log_post_.NumRows());
+
+  // Tasks are more urgent the earlier they were created; this is so that when
+  // NnetBatchComputer does partial minibatches, it does the oldest tasks first.
+  double priority = -std::chrono::duration<double>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+
+  std::vector<NnetInferenceTask> tasks;
+  task_creator_.CreateTasks(true, priority, &tasks);
+  if (tasks.empty())
+    KALDI_ERR << "Attempt to access frame past the end of the available input";
+  int32 num_tasks = tasks.size(),
+      end = task_creator_.NumSubsampledFramesCreated();
+  for (int32 i = 0; i < num_tasks; i++)
+    computer_->AcceptTask(&tasks[i]);
+
+  current_log_post_.Resize(end - begin, computer_->OutputDim(), kUndefined);
+  current_log_post_subsampled_offset_ = begin;
+  for (int32 i = 0; i < num_tasks; i++) {
+    NnetInferenceTask &task = tasks[i];
+    task.semaphore.Wait();
+    current_log_post_.RowRange(task.first_used_output_frame_index - begin,
+                               task.num_used_output_frames).CopyFromMat(
+        task.output_cpu.RowRange(task.num_initial_unused_output_frames,
+                                 task.num_used_output_frames));
+  }
+}
+
+
+NnetBatchOnlineComputeThread::NnetBatchOnlineComputeThread(
+    NnetBatchComputer *computer, BaseFloat max_wait_seconds):
+    computer_(computer), max_wait_seconds_(max_wait_seconds),
+    stop_(false), thread_(ComputeFunc, this) {
+  KALDI_ASSERT(max_wait_seconds >= 0.0);
+}
+
+NnetBatchOnlineComputeThread::~NnetBatchOnlineComputeThread() {
+  stop_ = true;
+  thread_.join();
+}
+
+void NnetBatchOnlineComputeThread::Compute() {
+  // 'timer' measures how long we have gone without doing any computation.
+  Timer timer;
+  while (!stop_) {
+    if (computer_->Compute(false)) {
+      timer.Reset();
+      continue;
+    }
+    if (timer.Elapsed() >= max_wait_seconds_) {
+      // Waited long enough for a full minibatch; do what we have.
+      computer_->Compute(true);
+      timer.Reset();
+    } else {
+      Sleep(std::min<BaseFloat>(max_wait_seconds_, 0.001));
+    }
+  }
+  // Make sure nobody is left waiting.
+  while (computer_->Compute(true));
+}
+
+} // namespace nnet3
+} // namespace kaldi
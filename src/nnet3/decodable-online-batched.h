@@ -0,0 +1,228 @@
+// nnet3/decodable-online-batched.h
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_NNET3_DECODABLE_ONLINE_BATCHED_H_
+#define KALDI_NNET3_DECODABLE_ONLINE_BATCHED_H_
+
+#include <atomic>
+#include <thread>
+#include "itf/online-feature-itf.h"
+#include "itf/decodable-itf.h"
+#include "nnet3/nnet-batch-compute.h"
+#include "hmm/transition-model.h"
+
+namespace kaldi {
+namespace nnet3 {
+
+
+// The Decodable object that we define in this header does the neural net
+// computation in a way that's compatible with online feature extraction, like
+// the ones in decodable-online-looped.h, but instead of doing the computation
+// itself it gives chunks of input to a class NnetBatchComputer, which is
+// shared between many such objects (e.g. one per active stream in a server)
+// and does the computation for all of them in minibatches.  This is much more
+// efficient than computing each stream separately, whether on CPU or GPU.
+//
+// The chunks are computed in the same way as by NnetBatchComputer::
+// SplitUtteranceIntoTasks(), i.e. by the 'simple' (not looped) computation,
+// with the --frames-per-chunk, --extra-left-context etc. options from class
+// NnetBatchComputerOptions; the only difference is that a chunk is computed as
+// soon as enough input (including the right context) is available, and that
+// 'extra_right_context_final' only applies to chunks computed after the input
+// has finished.
+//
+// Because the user's thread waits while the chunks are computed, the
+// NnetBatchComputer must be serviced by another thread; see class
+// NnetBatchOnlineComputeThread below.
+
+
+/**
+   This class creates the tasks (chunks) for the neural net computation of one
+   online stream, to be given to class NnetBatchComputer, as soon as the input
+   features for them are ready; see the comment above, which describes how the
+   chunks are computed.  It is used by class DecodableAmNnetBatchedOnline, and
+   can also be used directly by code that wants to supply the tasks to the
+   NnetBatchComputer itself, e.g. to keep the output on the GPU.
+ */
+class NnetBatchOnlineTaskCreator {
+ public:
+  // 'input_features' is for the feature that will be given as 'input' to the
+  // neural network; 'ivector_features' is for the iVector feature, or NULL if
+  // iVectors are not being used.  None of the pointers are owned here.
+  NnetBatchOnlineTaskCreator(NnetBatchComputer *computer,
+                             OnlineFeatureInterface *input_features,
+                             OnlineFeatureInterface *ivector_features);
+
+  // Returns the number of (subsampled) output frames from the start of the
+  // input, for which we can compute the output given the input that is
+  // available now.  Sets '*input_finished' to true if the input has finished,
+  // in which case this is the total number of output frames.
+  int32 NumSubsampledFramesComputable(bool *input_finished) const;
+
+  // Returns the number of (subsampled) output frames from the start of the
+  // input that are covered by the tasks created so far.
+  int32 NumSubsampledFramesCreated() const {
+    return num_subsampled_frames_created_;
+  }
+
+  // Creates the tasks for all the chunks that are computable and not yet
+  // created, and outputs them to 'tasks' (which is resized; it will be empty
+  // if there was nothing to create).  Their used output frames are
+  // NumSubsampledFramesCreated() (before the call) onwards, in order.  The
+  // tasks are not given to the NnetBatchComputer; the user should do that,
+  // without resizing 'tasks' until they are done.
+  void CreateTasks(bool output_to_cpu, double priority,
+                   std::vector<NnetInferenceTask> *tasks);
+
+ private:
+  // Sets up the input and i-vector of 'task', whose output frames start
+  // from (subsampled) frame 'begin_output_t' of the input.  The other members
+  // that describe the output frames must already be set up.
+  void SetUpTaskInput(int32 begin_output_t, int32 num_features_ready,
+                      bool input_finished, int32 num_subsampled_frames,
+                      NnetInferenceTask *task) const;
+
+  NnetBatchComputer *computer_;
+  const NnetBatchComputerOptions &opts_;
+  OnlineFeatureInterface *input_features_;
+  OnlineFeatureInterface *ivector_features_;
+
+  // The number of output frames per chunk, after subsampling.
+  int32 subsampled_frames_per_chunk_;
+
+  int32 num_subsampled_frames_created_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(NnetBatchOnlineTaskCreator);
+};
+
+
+// This decodable object is for traditional decoding where the graph has
+// transition-ids on the arcs, and you need the TransitionModel to map those to
+// pdf-ids.  Whether or not division by the prior takes place depends on
+// whether you supplied the priors to the constructor of the NnetBatchComputer.
+class DecodableAmNnetBatchedOnline: public DecodableInterface {
+ public:
+  // Constructor.  'input_features' is for the feature that will be given as
+  // 'input' to the neural network; 'ivector_features' is for the iVector
+  // feature, or NULL if iVectors are not being used.  'computer' is not owned
+  // here; it may be shared with other objects of this type, and used from
+  // multiple threads.
+  DecodableAmNnetBatchedOnline(const TransitionModel &trans_model,
+                               NnetBatchComputer *computer,
+                               OnlineFeatureInterface *input_features,
+                               OnlineFeatureInterface *ivector_features);
+
+  // 'subsampled_frame' is a frame, but if frame-subsampling-factor != 1, it's a
+  // reduced-rate output frame (e.g. a 't' index divided by 3).
+  virtual BaseFloat LogLikelihood(int32 subsampled_frame,
+                                  int32 transition_id);
+
+  virtual void LogLikelihoods(int32 subsampled_frame,
+                              const int32 *transition_ids,
+                              BaseFloat *log_likes,
+                              int32 num_indexes);
+
+  virtual bool IsLastFrame(int32 subsampled_frame) const;
+
+  virtual int32 NumFramesReady() const;
+
+  virtual int32 NumIndices() const { return trans_model_.NumTransitionIds(); }
+
+  int32 FrameSubsamplingFactor() const {
+    return computer_->GetOptions().frame_subsampling_factor;
+  }
+
+  /// Sets the frame offset value; see the same-named function in class
+  /// DecodableNnetLoopedOnlineBase (decodable-online-looped.h).
+  void SetFrameOffset(int32 frame_offset);
+
+  /// Returns the frame offset value.
+  int32 GetFrameOffset() const { return frame_offset_; }
+
+ private:
+  /// If the neural-network outputs for this frame (not including the frame
+  /// offset) are not cached, this function computes them, together with all
+  /// the other frames that are ready.
+  inline void EnsureFrameIsComputed(int32 subsampled_frame) {
+    KALDI_ASSERT(subsampled_frame >= current_log_post_subsampled_offset_ &&
+                 "Frames must be accessed in order.");
+    if (subsampled_frame >= current_log_post_subsampled_offset_ +
+        current_log_post_.NumRows())
+      ComputeReadyChunks();
+  }
+
+  // Gives all the chunks that are computable and not yet computed to the
+  // NnetBatchComputer, waits for them to be computed and puts their output in
+  // current_log_post_.
+  void ComputeReadyChunks();
+
+  const TransitionModel &trans_model_;
+  NnetBatchComputer *computer_;
+  NnetBatchOnlineTaskCreator task_creator_;
+
+  // The log-likelihoods of the most recently computed chunks, for the
+  // (subsampled) output frames starting from
+  // current_log_post_subsampled_offset_.
+  Matrix<BaseFloat> current_log_post_;
+  int32 current_log_post_subsampled_offset_;
+
+  // IsLastFrame(), NumFramesReady() and LogLikelihood() methods take into
+  // account this offset value. We initialize frame_offset_ as 0 and it stays as
+  // 0 unless SetFrameOffset() method is called.
+  int32 frame_offset_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(DecodableAmNnetBatchedOnline);
+};
+
+
+/**
+   This class services a NnetBatchComputer which is used by objects of type
+   DecodableAmNnetBatchedOnline: it starts a thread that computes minibatches
+   as long as full ones are available.  When no full minibatch is available it
+   does partial minibatches, but only after waiting 'max_wait_seconds', to give
+   other streams the chance to contribute tasks to the minibatch.  So
+   'max_wait_seconds' is the maximum latency that batching adds to each chunk
+   (apart from the time taken by the computation itself); it trades off latency
+   against efficiency.  The thread is stopped by the destructor.
+ */
+class NnetBatchOnlineComputeThread {
+ public:
+  NnetBatchOnlineComputeThread(NnetBatchComputer *computer,
+                               BaseFloat max_wait_seconds);
+
+  ~NnetBatchOnlineComputeThread();
+ private:
+  void Compute();
+  static void ComputeFunc(NnetBatchOnlineComputeThread *object) {
+    object->Compute();
+  }
+
+  NnetBatchComputer *computer_;
+  BaseFloat max_wait_seconds_;
+  std::atomic<bool> stop_;
+  std::thread thread_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(NnetBatchOnlineComputeThread);
+};
+
+
+} // namespace nnet3
+} // namespace kaldi
+
+#endif // KALDI_NNET3_DECODABLE_ONLINE_BATCHED_H_
@@ -36,7 +36,7 @@ DecodableNnetLoopedOnlineBase::DecodableNnetLoopedOnlineBase(
     computer_(info_.opts.compute_config, info_.computation,
               info_.nnet, NULL) {   // NULL is 'nnet_to_update'
   // Check that feature dimensions match.
-  KALDI_ASSERT(input_features_ != NULL);
+  KALDI_ASSERT(input_features_ != NULL && info_.num_sequences == 1);
   int32 nnet_input_dim = info_.nnet.InputDim("input"),
       nnet_ivector_dim = info_.nnet.InputDim("ivector"),
         feat_input_dim = input_features_->Dim(),
@@ -115,6 +115,36 @@ void DecodableNnetLoopedOnlineBase::SetFrameOffset(int32 frame_offset) {
   frame_offset_ = frame_offset;
 }
 
+void DecodableNnetLoopedOnlineBase::WriteState(std::ostream &os,
+                                               bool binary) const {
+  WriteToken(os, binary, "<DecodableNnetLoopedOnlineState>");
+  WriteToken(os, binary, "<NumChunksComputed>");
+  WriteBasicType(os, binary, num_chunks_computed_);
+  WriteToken(os, binary, "<CurrentLogPostOffset>");
+  WriteBasicType(os, binary, current_log_post_subsampled_offset_);
+  WriteToken(os, binary, "<FrameOffset>");
+  WriteBasicType(os, binary, frame_offset_);
+  WriteToken(os, binary, "<CurrentLogPost>");
+  current_log_post_.Write(os, binary);
+  computer_.WriteState(os, binary);
+  WriteToken(os, binary, "</DecodableNnetLoopedOnlineState>");
+}
+
+void DecodableNnetLoopedOnlineBase::ReadState(std::istream &is,
+                                              bool binary) {
+  ExpectToken(is, binary, "<DecodableNnetLoopedOnlineState>");
+  ExpectToken(is, binary, "<NumChunksComputed>");
+  ReadBasicType(is, binary, &num_chunks_computed_);
+  ExpectToken(is, binary, "<CurrentLogPostOffset>");
+  ReadBasicType(is, binary, &current_log_post_subsampled_offset_);
+  ExpectToken(is, binary, "<FrameOffset>");
+  ReadBasicType(is, binary, &frame_offset_);
+  ExpectToken(is, binary, "<CurrentLogPost>");
+  current_log_post_.Read(is, binary);
+  computer_.ReadState(is, binary);
+  ExpectToken(is, binary, "</DecodableNnetLoopedOnlineState>");
+}
+
 void DecodableNnetLoopedOnlineBase::AdvanceChunk() {
   // Prepare the input data for the next chunk of features.
   // note: 'end' means one past the last.
@@ -152,16 +182,20 @@ void DecodableNnetLoopedOnlineBase::AdvanceChunk() {
 
   CuMatrix<BaseFloat> feats_chunk;
   { // this block sets 'feats_chunk'.
-    Matrix<BaseFloat> this_feats(end_input_frame - begin_input_frame,
-                                 input_features_->Dim());
+    std::vector<int32> input_frames;
+    input_frames.reserve(end_input_frame - begin_input_frame);
     for (int32 i = begin_input_frame; i < end_input_frame; i++) {
-      SubVector<BaseFloat> this_row(this_feats, i - begin_input_frame);
       int32 input_frame = i;
       if (input_frame < 0) input_frame = 0;
       if (input_frame >= num_feature_frames_ready)
         input_frame = num_feature_frames_ready - 1;
-      input_features_->GetFrame(input_frame, &this_row);
+      input_frames.push_back(input_frame);
     }
+    Matrix<BaseFloat> this_feats(input_frames.size(),
+                                 input_features_->Dim(), kUndefined);
+    // Getting the whole chunk at once lets the feature pipeline work on
+    // blocks of frames.
+    input_features_->GetFrames(input_frames, &this_feats);
     feats_chunk.Swap(&this_feats);
   }
   computer_.AcceptInput("input", &feats_chunk);
@@ -235,6 +269,14 @@ void DecodableNnetLoopedOnlineBase::AdvanceChunk() {
       (info_.frames_per_chunk / info_.opts.frame_subsampling_factor);
 }
 
+void DecodableNnetLoopedOnlineBase::GetOutputForFrame(
+    int32 subsampled_frame, VectorBase<BaseFloat> *output) {
+  subsampled_frame += frame_offset_;
+  EnsureFrameIsComputed(subsampled_frame);
+  output->CopyFromVec(current_log_post_.Row(
+      subsampled_frame - current_log_post_subsampled_offset_));
+}
+
 BaseFloat DecodableNnetLoopedOnline::LogLikelihood(int32 subsampled_frame,
                                                     int32 index) {
   subsampled_frame += frame_offset_;
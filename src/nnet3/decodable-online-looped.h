@@ -81,6 +81,12 @@ class DecodableNnetLoopedOnlineBase: public DecodableInterface {
     return info_.opts.frame_subsampling_factor;
   }
 
+  /// Outputs the (scaled, and divided by the prior if applicable) output of
+  /// the network for this frame, which must not be before frames already
+  /// accessed; its dimension must be info.output_dim.  This is for copying the
+  /// output elsewhere, e.g. to decode it in another thread.
+  void GetOutputForFrame(int32 subsampled_frame, VectorBase<BaseFloat> *output);
+
   /// Sets the frame offset value. Frame offset is initialized to 0 when the
   /// decodable object is constructed and stays as 0 unless this method is
   /// called. This method is useful when we want to reset the decoder state,
@@ -93,6 +99,16 @@ class DecodableNnetLoopedOnlineBase: public DecodableInterface {
   /// Returns the frame offset value.
   int32 GetFrameOffset() const { return frame_offset_; }
 
+  /// Writes the state of the computation: the recurrent state of the network,
+  /// the cached outputs, and how far it has got.  This, together with the
+  /// state of the features (see OnlineNnet2FeaturePipeline::WriteState()),
+  /// lets another object constructed with the same 'info' carry on from the
+  /// same point after ReadState(), e.g. in another process.
+  void WriteState(std::ostream &os, bool binary) const;
+
+  /// Reads the state written by WriteState(), replacing the current state.
+  void ReadState(std::istream &is, bool binary);
+
  protected:
 
   /// If the neural-network outputs for this frame are not cached, this function
@@ -0,0 +1,419 @@
+// nnet3/decodable-online-multi-stream.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nnet3/decodable-online-multi-stream.h"
+#include "matrix/simd-math.h"
+
+namespace kaldi {
+namespace nnet3 {
+
+// Note on the time axis: all the slots share the 't' values of the looped
+// computation.  As in DecodableNnetLoopedOnlineBase::AdvanceChunk(), chunk
+// number k (starting from 0) has output 't' values from k * frames_per_chunk
+// to (k + 1) * frames_per_chunk - 1, and its input 't' values end at
+// (k + 1) * frames_per_chunk + frames_right_context; they start at
+// -frames_left_context for the first chunk, and where the previous chunk's
+// input ended otherwise.  Input 't' value t of a slot is input frame
+// t - t_offset of its stream, limited to the range of frames available.
+
+NnetLoopedMultiStreamComputer::NnetLoopedMultiStreamComputer(
+    const DecodableNnetSimpleLoopedInfo &info):
+    info_(info),
+    computer_(info_.opts.compute_config, info_.computation,
+              info_.nnet, NULL),  // NULL is 'nnet_to_update'
+    slots_(info.num_sequences),
+    num_chunks_started_(0),
+    computing_(false) {
+  KALDI_ASSERT(info_.request1.inputs[0].indexes.size() ==
+               info_.num_sequences * (info_.frames_left_context +
+                                      info_.frames_per_chunk +
+                                      info_.frames_right_context));
+}
+
+int32 NnetLoopedMultiStreamComputer::PrimingFrames() const {
+  int32 context = info_.frames_left_context + info_.frames_right_context,
+      chunk = info_.frames_per_chunk;
+  return chunk * ((context + chunk - 1) / chunk);
+}
+
+int32 NnetLoopedMultiStreamComputer::AddStream() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (size_t i = 0; i < slots_.size(); i++) {
+    StreamSlot &slot = slots_[i];
+    if (!slot.in_use) {
+      slot = StreamSlot();
+      slot.in_use = true;
+      // If no chunk has been started, the stream starts at the beginning just
+      // as for a single stream; otherwise it starts after the priming.
+      if (num_chunks_started_ > 0)
+        slot.t_offset = num_chunks_started_ * info_.frames_per_chunk +
+            PrimingFrames();
+      return i;
+    }
+  }
+  KALDI_ERR << "No free slot for a new stream: there are already "
+            << slots_.size() << " streams.";
+  return -1;  // Suppress compiler warning.
+}
+
+void NnetLoopedMultiStreamComputer::RemoveStream(int32 slot) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  KALDI_ASSERT(static_cast<size_t>(slot) < slots_.size() &&
+               slots_[slot].in_use);
+  slots_[slot] = StreamSlot();
+  // The other streams may have been waiting for this one.
+  cond_.notify_all();
+}
+
+void NnetLoopedMultiStreamComputer::AcceptInput(
+    int32 slot, const MatrixBase<BaseFloat> &frames,
+    const VectorBase<BaseFloat> *ivector) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  KALDI_ASSERT(static_cast<size_t>(slot) < slots_.size());
+  StreamSlot &s = slots_[slot];
+  KALDI_ASSERT(s.in_use && !s.input_finished &&
+               frames.NumCols() == info_.nnet.InputDim("input"));
+  for (int32 r = 0; r < frames.NumRows(); r++)
+    s.features.push_back(Vector<BaseFloat>(frames.Row(r)));
+  s.num_frames += frames.NumRows();
+  if (ivector != NULL) {
+    KALDI_ASSERT(ivector->Dim() == info_.nnet.InputDim("ivector"));
+    s.ivector = *ivector;
+  }
+  cond_.notify_all();
+}
+
+void NnetLoopedMultiStreamComputer::InputFinished(int32 slot) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  KALDI_ASSERT(static_cast<size_t>(slot) < slots_.size() &&
+               slots_[slot].in_use);
+  slots_[slot].input_finished = true;
+  cond_.notify_all();
+}
+
+int32 NnetLoopedMultiStreamComputer::NumFramesComputable(int32 slot) const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  KALDI_ASSERT(static_cast<size_t>(slot) < slots_.size() &&
+               slots_[slot].in_use);
+  return NumFramesComputable(slots_[slot]);
+}
+
+int32 NnetLoopedMultiStreamComputer::NumFramesComputable(
+    const StreamSlot &s) const {
+  // This mirrors DecodableNnetLoopedOnlineBase::NumFramesReady().
+  int32 sf = info_.opts.frame_subsampling_factor;
+  if (s.input_finished)
+    return (s.num_frames + sf - 1) / sf;
+  int32 num_chunks_ready = std::max<int32>(
+      0, s.num_frames - info_.frames_right_context) / info_.frames_per_chunk;
+  return num_chunks_ready * info_.frames_per_chunk / sf;
+}
+
+bool NnetLoopedMultiStreamComputer::AllSlotsReady() {
+  int32 chunk = info_.frames_per_chunk,
+      k = num_chunks_started_,
+      end_output_t = (k + 1) * chunk,
+      end_input_t = end_output_t + info_.frames_right_context;
+  bool ans = true;
+  for (size_t i = 0; i < slots_.size(); i++) {
+    StreamSlot &s = slots_[i];
+    if (!s.in_use || s.input_finished)
+      continue;
+    if (s.num_frames >= std::max<int32>(1, end_input_t - s.t_offset))
+      continue;
+    if (end_output_t <= s.t_offset) {
+      // The slot is priming and we don't have the input for it, but we don't
+      // need its output; start the priming again after this chunk.
+      s.t_offset = end_output_t + PrimingFrames();
+    } else {
+      ans = false;
+    }
+  }
+  return ans;
+}
+
+void NnetLoopedMultiStreamComputer::GetSlotInput(
+    int32 slot, int32 begin_t, int32 end_t, SubMatrix<BaseFloat> *input) {
+  KALDI_ASSERT(input->NumRows() == end_t - begin_t);
+  const StreamSlot &s = slots_[slot];
+  if (!s.in_use || s.num_frames == 0) {
+    input->SetZero();
+    return;
+  }
+  for (int32 t = begin_t; t < end_t; t++) {
+    int32 frame = std::max<int32>(0, std::min<int32>(t - s.t_offset,
+                                                     s.num_frames - 1));
+    KALDI_ASSERT(frame >= s.features_offset);
+    input->Row(t - begin_t).CopyFromVec(s.features[frame - s.features_offset]);
+  }
+}
+
+void NnetLoopedMultiStreamComputer::ComputeChunk(
+    std::unique_lock<std::mutex> *lock) {
+  KALDI_ASSERT(!computing_);
+  computing_ = true;
+  int32 k = num_chunks_started_++,
+      num_slots = slots_.size(),
+      chunk = info_.frames_per_chunk,
+      begin_output_t = k * chunk,
+      begin_input_t = (k == 0 ? -info_.frames_left_context :
+                       begin_output_t + info_.frames_right_context),
+      end_input_t = begin_output_t + chunk + info_.frames_right_context,
+      num_input_rows = end_input_t - begin_input_t;
+  const ComputationRequest &request = (k == 0 ? info_.request1 :
+                                       info_.request2);
+  KALDI_ASSERT(request.inputs[0].indexes.size() == num_slots * num_input_rows);
+
+  // The computation requests have the 'n' index with the larger stride, so
+  // each slot has a contiguous block of rows.
+  Matrix<BaseFloat> input(num_slots * num_input_rows,
+                          info_.nnet.InputDim("input"), kUndefined);
+  for (int32 i = 0; i < num_slots; i++) {
+    SubMatrix<BaseFloat> slot_input(input, i * num_input_rows, num_input_rows,
+                                    0, input.NumCols());
+    GetSlotInput(i, begin_input_t, end_input_t, &slot_input);
+  }
+  Matrix<BaseFloat> ivectors;
+  if (info_.has_ivectors) {
+    KALDI_ASSERT(request.inputs.size() == 2);
+    int32 num_ivectors = request.inputs[1].indexes.size() / num_slots;
+    KALDI_ASSERT(num_ivectors > 0);
+    ivectors.Resize(num_slots * num_ivectors, info_.nnet.InputDim("ivector"));
+    for (int32 i = 0; i < num_slots; i++) {
+      if (slots_[i].in_use && slots_[i].ivector.Dim() != 0)
+        ivectors.RowRange(i * num_ivectors,
+                          num_ivectors).CopyRowsFromVec(slots_[i].ivector);
+    }
+  }
+
+  // Discard the input frames that we won't need again.  We keep all of them
+  // while a slot is priming, in case its priming is started again.
+  for (int32 i = 0; i < num_slots; i++) {
+    StreamSlot &s = slots_[i];
+    if (!s.in_use || begin_output_t < s.t_offset)
+      continue;
+    int32 keep_from = std::min<int32>(end_input_t - s.t_offset,
+                                      s.num_frames - 1);
+    while (s.features_offset < keep_from) {
+      s.features.pop_front();
+      s.features_offset++;
+    }
+  }
+
+  lock->unlock();
+
+  CuMatrix<BaseFloat> cu_input;
+  cu_input.Swap(&input);
+  computer_.AcceptInput("input", &cu_input);
+  if (info_.has_ivectors) {
+    CuMatrix<BaseFloat> cu_ivectors;
+    cu_ivectors.Swap(&ivectors);
+    computer_.AcceptInput("ivector", &cu_ivectors);
+  }
+  computer_.Run();
+  Matrix<BaseFloat> output;
+  {
+    // See the note in DecodableNnetLoopedOnlineBase::AdvanceChunk() about
+    // GetOutputDestructive().
+    CuMatrix<BaseFloat> cu_output;
+    computer_.GetOutputDestructive("output", &cu_output);
+    if (info_.log_priors.Dim() != 0) {
+      // subtract log-prior (divide by prior)
+      cu_output.AddVecToRows(-1.0, info_.log_priors);
+    }
+    // apply the acoustic scale
+    cu_output.Scale(info_.opts.acoustic_scale);
+    cu_output.Swap(&output);
+  }
+
+  lock->lock();
+  int32 sf = info_.opts.frame_subsampling_factor,
+      num_output_rows = chunk / sf;
+  KALDI_ASSERT(output.NumRows() == num_slots * num_output_rows);
+  for (int32 i = 0; i < num_slots; i++) {
+    StreamSlot &s = slots_[i];
+    // Streams added while we were computing have t_offset past this chunk.
+    if (!s.in_use || begin_output_t < s.t_offset)
+      continue;
+    int32 num_pending = 0;
+    for (size_t j = 0; j < s.output.size(); j++)
+      num_pending += s.output[j].NumRows();
+    KALDI_ASSERT((begin_output_t - s.t_offset) / sf ==
+                 s.output_offset + num_pending);
+    s.output.push_back(Matrix<BaseFloat>(
+        output.RowRange(i * num_output_rows, num_output_rows)));
+  }
+  computing_ = false;
+  cond_.notify_all();
+}
+
+void NnetLoopedMultiStreamComputer::GetOutput(int32 slot, int32 *first_frame,
+                                              Matrix<BaseFloat> *output) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  KALDI_ASSERT(static_cast<size_t>(slot) < slots_.size());
+  StreamSlot &s = slots_[slot];
+  KALDI_ASSERT(s.in_use);
+  if (s.output.empty() && NumFramesComputable(s) <= s.output_offset) {
+    // If we waited, we would wait forever.
+    KALDI_ERR << "Attempt to access frame past the end of the available input";
+  }
+  while (s.output.empty()) {
+    if (!computing_ && AllSlotsReady())
+      ComputeChunk(&lock);
+    else
+      cond_.wait(lock);
+  }
+  int32 num_rows = 0;
+  for (size_t j = 0; j < s.output.size(); j++)
+    num_rows += s.output[j].NumRows();
+  output->Resize(num_rows, s.output[0].NumCols(), kUndefined);
+  int32 row = 0;
+  for (size_t j = 0; j < s.output.size(); j++) {
+    output->RowRange(row, s.output[j].NumRows()).CopyFromMat(s.output[j]);
+    row += s.output[j].NumRows();
+  }
+  s.output.clear();
+  *first_frame = s.output_offset;
+  s.output_offset += num_rows;
+}
+
+
+DecodableAmNnetLoopedOnlineMultiStream::DecodableAmNnetLoopedOnlineMultiStream(
+    const TransitionModel &trans_model,
+    NnetLoopedMultiStreamComputer *computer,
+    OnlineFeatureInterface *input_features,
+    OnlineFeatureInterface *ivector_features):
+    trans_model_(trans_model),
+    computer_(computer),
+    input_features_(input_features),
+    ivector_features_(ivector_features),
+    slot_(-1),
+    num_frames_accepted_(0),
+    input_finished_(false),
+    current_log_post_subsampled_offset_(0),
+    frame_offset_(0) {
+  // Check that feature dimensions match.
+  KALDI_ASSERT(input_features_ != NULL);
+  const Nnet &nnet = computer_->Info().nnet;
+  int32 nnet_input_dim = nnet.InputDim("input"),
+      nnet_ivector_dim = nnet.InputDim("ivector"),
+      feat_input_dim = input_features_->Dim(),
+      feat_ivector_dim = (ivector_features_ != NULL ?
+                          ivector_features_->Dim() : -1);
+  if (nnet_input_dim != feat_input_dim) {
+    KALDI_ERR << "Input feature dimension mismatch: got " << feat_input_dim
+              << " but network expects " << nnet_input_dim;
+  }
+  if (nnet_ivector_dim != feat_ivector_dim) {
+    KALDI_ERR << "Ivector feature dimension mismatch: got " << feat_ivector_dim
+              << " but network expects " << nnet_ivector_dim;
+  }
+  slot_ = computer_->AddStream();
+}
+
+DecodableAmNnetLoopedOnlineMultiStream::
+~DecodableAmNnetLoopedOnlineMultiStream() {
+  computer_->RemoveStream(slot_);
+}
+
+void DecodableAmNnetLoopedOnlineMultiStream::UpdateInput() const {
+  int32 features_ready = input_features_->NumFramesReady();
+  if (features_ready > num_frames_accepted_) {
+    std::vector<int32> frames;
+    for (int32 t = num_frames_accepted_; t < features_ready; t++)
+      frames.push_back(t);
+    Matrix<BaseFloat> feats(frames.size(), input_features_->Dim(),
+                            kUndefined);
+    input_features_->GetFrames(frames, &feats);
+    // As in DecodableNnetLoopedOnlineBase, we don't wait for the iVectors; we
+    // just use the most recent one we can.
+    Vector<BaseFloat> ivector;
+    if (ivector_features_ != NULL &&
+        ivector_features_->NumFramesReady() > 0) {
+      ivector.Resize(ivector_features_->Dim(), kUndefined);
+      ivector_features_->GetFrame(
+          std::min<int32>(features_ready,
+                          ivector_features_->NumFramesReady()) - 1, &ivector);
+    }
+    computer_->AcceptInput(slot_, feats,
+                           ivector.Dim() != 0 ? &ivector : NULL);
+    num_frames_accepted_ = features_ready;
+  }
+  if (!input_finished_ && features_ready > 0 &&
+      input_features_->IsLastFrame(features_ready - 1)) {
+    computer_->InputFinished(slot_);
+    input_finished_ = true;
+  }
+}
+
+int32 DecodableAmNnetLoopedOnlineMultiStream::NumFramesReady() const {
+  UpdateInput();
+  return computer_->NumFramesComputable(slot_) - frame_offset_;
+}
+
+bool DecodableAmNnetLoopedOnlineMultiStream::IsLastFrame(
+    int32 subsampled_frame) const {
+  UpdateInput();
+  if (!input_finished_)
+    return false;
+  int32 sf = FrameSubsamplingFactor(),
+      num_subsampled_frames = (num_frames_accepted_ + sf - 1) / sf;
+  return (subsampled_frame + frame_offset_ == num_subsampled_frames - 1);
+}
+
+void DecodableAmNnetLoopedOnlineMultiStream::SetFrameOffset(
+    int32 frame_offset) {
+  KALDI_ASSERT(0 <= frame_offset &&
+               frame_offset <= frame_offset_ + NumFramesReady());
+  frame_offset_ = frame_offset;
+}
+
+void DecodableAmNnetLoopedOnlineMultiStream::GetMoreOutput() {
+  UpdateInput();
+  int32 first_frame,
+      expected_first_frame = current_log_post_subsampled_offset_ +
+      current_log_post_.NumRows();
+  current_log_post_.Resize(0, 0);
+  computer_->GetOutput(slot_, &first_frame, &current_log_post_);
+  KALDI_ASSERT(first_frame == expected_first_frame);
+  current_log_post_subsampled_offset_ = first_frame;
+}
+
+BaseFloat DecodableAmNnetLoopedOnlineMultiStream::LogLikelihood(
+    int32 subsampled_frame, int32 transition_id) {
+  subsampled_frame += frame_offset_;
+  EnsureFrameIsComputed(subsampled_frame);
+  return current_log_post_(
+      subsampled_frame - current_log_post_subsampled_offset_,
+      trans_model_.TransitionIdToPdfFast(transition_id));
+}
+
+void DecodableAmNnetLoopedOnlineMultiStream::LogLikelihoods(
+    int32 subsampled_frame, const int32 *transition_ids,
+    BaseFloat *log_likes, int32 num_indexes) {
+  subsampled_frame += frame_offset_;
+  EnsureFrameIsComputed(subsampled_frame);
+  const BaseFloat *row = current_log_post_.RowData(
+      subsampled_frame - current_log_post_subsampled_offset_);
+  GatherVec(BaseFloat(1.0), row, &(trans_model_.TransitionIdToPdfArray()[0]),
+            transition_ids, num_indexes, log_likes);
+}
+
+} // namespace nnet3
+} // namespace kaldi
@@ -0,0 +1,287 @@
+// nnet3/decodable-online-multi-stream.h
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_NNET3_DECODABLE_ONLINE_MULTI_STREAM_H_
+#define KALDI_NNET3_DECODABLE_ONLINE_MULTI_STREAM_H_
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include "itf/online-feature-itf.h"
+#include "itf/decodable-itf.h"
+#include "nnet3/nnet-compute.h"
+#include "nnet3/decodable-simple-looped.h"
+#include "hmm/transition-model.h"
+
+namespace kaldi {
+namespace nnet3 {
+
+
+/**
+   This class does the 'looped' neural net computation (see
+   decodable-online-looped.h) for many online streams at once: it compiles the
+   looped computation for 'num_sequences' sequences (see the 'num_sequences'
+   argument of the constructors of class DecodableNnetSimpleLoopedInfo), and
+   each stream occupies one of those sequences (we call them 'slots').  Each
+   chunk of the computation advances all the slots together, so each stream's
+   recurrent state lives in its own row slice of the computation's matrices,
+   and the matrix multiplications are done with num_sequences times as many
+   rows as for a single stream.  This is much more efficient, especially on
+   GPU.
+
+   The streams are accessed through class DecodableAmNnetLoopedOnlineMultiStream,
+   normally one per thread.  A chunk is computed when one of the streams needs
+   its output, but only once all the streams whose output the chunk would
+   contain have supplied the input for it; so the streams should get their input
+   at about the same rate (as in real-time streaming), and the latency is that
+   of the slowest stream.  Streams that have finished, and free slots, never
+   delay the computation.
+
+   A stream that is added while the computation is in progress starts with the
+   state left by the previous occupant of its slot.  To get rid of it we
+   'prime' the slot by giving it copies of the stream's first frame for enough
+   chunks to cover the left and right context of the model, and we discard the
+   output of those chunks; until the stream's real output starts, a stream that
+   has no input never delays the computation (its priming is just started
+   again).  For models with finite context (TDNNs, CNNs) this gives exactly the
+   same output as class DecodableAmNnetLoopedOnline; for recurrent models such
+   as LSTMs the state does not completely forget the previous occupant, and the
+   output is only approximately the same.
+
+   The i-vector for each chunk is the most recent one supplied for the stream,
+   as in class DecodableNnetLoopedOnlineBase.
+
+   If you use a GPU, be aware that the computation may be done by any of the
+   threads that use this object.
+ */
+class NnetLoopedMultiStreamComputer {
+ public:
+  /// The 'info' object must have been initialized with the number of
+  /// sequences equal to the maximum number of streams you want to process at
+  /// once.  It is not owned here and must outlive this object.
+  explicit NnetLoopedMultiStreamComputer(
+      const DecodableNnetSimpleLoopedInfo &info);
+
+  const DecodableNnetSimpleLoopedInfo &Info() const { return info_; }
+
+  /// Returns the maximum number of streams, i.e. the number of slots.
+  int32 NumSlots() const { return info_.num_sequences; }
+
+  /// Assigns a free slot to a new stream and returns its index; dies if there
+  /// is no free slot, so the user should make sure there are never more than
+  /// NumSlots() streams at a time.
+  int32 AddStream();
+
+  /// Frees the slot of a stream that is no longer needed (even if it has not
+  /// finished); its output will be discarded.
+  void RemoveStream(int32 slot);
+
+  /// Gives more input frames to the stream in 'slot'; 'ivector', if non-NULL,
+  /// is the most recent i-vector of the stream.  If the network takes
+  /// i-vectors and none has been supplied yet, a zero i-vector is used.
+  void AcceptInput(int32 slot, const MatrixBase<BaseFloat> &frames,
+                   const VectorBase<BaseFloat> *ivector);
+
+  /// Announces that there is no more input for the stream in 'slot'.
+  void InputFinished(int32 slot);
+
+  /// Returns the number of (subsampled) output frames of the stream in 'slot'
+  /// that can be computed from the input it has been given so far.
+  int32 NumFramesComputable(int32 slot) const;
+
+  /// Waits until some output of the stream in 'slot' that has not been
+  /// returned before is available (computing it if necessary), and outputs it
+  /// to 'output', with '*first_frame' set to the (subsampled) output frame
+  /// that its first row corresponds to.  The output has already been divided
+  /// by the priors and scaled by the acoustic scale, if applicable.  The user
+  /// should only call this if NumFramesComputable() is greater than the number
+  /// of frames already returned.
+  void GetOutput(int32 slot, int32 *first_frame, Matrix<BaseFloat> *output);
+
+ private:
+  struct StreamSlot {
+    bool in_use;
+    // The input 't' value (in the time axis shared by all the slots) that the
+    // stream's first input frame corresponds to, i.e. the 't' value at which
+    // its real (not priming) output starts.  This is always a multiple of
+    // info_.frames_per_chunk.
+    int32 t_offset;
+    // The input frames accepted but not yet discarded; features.front() is
+    // input frame number 'features_offset' of the stream.
+    std::deque<Vector<BaseFloat> > features;
+    int32 features_offset;
+    // The total number of input frames accepted.
+    int32 num_frames;
+    bool input_finished;
+    // The most recent i-vector.
+    Vector<BaseFloat> ivector;
+    // The output that has been computed but not yet collected by GetOutput();
+    // its first row is (subsampled) output frame 'output_offset', which is
+    // also the number of output frames that have been collected.
+    std::vector<Matrix<BaseFloat> > output;
+    int32 output_offset;
+
+    StreamSlot(): in_use(false), t_offset(0), features_offset(0),
+                  num_frames(0), input_finished(false), output_offset(0) { }
+  };
+
+  // Implements NumFramesComputable(); requires mutex_ to be locked.
+  int32 NumFramesComputable(const StreamSlot &s) const;
+
+  // Returns the number of 't' values before the start of a stream's real
+  // output that its priming covers; it's a multiple of info_.frames_per_chunk
+  // that is at least the sum of the left and right context.
+  int32 PrimingFrames() const;
+
+  // Returns true if all the slots are ready for the computation of the next
+  // chunk; as a side effect, it restarts the priming of any slot that is
+  // priming and lacks input.  Requires mutex_ to be locked.
+  bool AllSlotsReady();
+
+  // Computes the next chunk.  Requires 'lock' to be locked on entry; it is
+  // unlocked while the neural net computation is done.
+  void ComputeChunk(std::unique_lock<std::mutex> *lock);
+
+  // Gets the input of slot 'slot' for the current chunk, whose input 't'
+  // values are begin_t ... end_t - 1, and puts it in 'input'.
+  void GetSlotInput(int32 slot, int32 begin_t, int32 end_t,
+                    SubMatrix<BaseFloat> *input);
+
+  const DecodableNnetSimpleLoopedInfo &info_;
+
+  NnetComputer computer_;
+
+  std::vector<StreamSlot> slots_;
+
+  // The number of chunks whose computation has been started.
+  int32 num_chunks_started_;
+
+  // True while a chunk is being computed.
+  bool computing_;
+
+  // mutex_ protects all the members except computer_, which is only used by
+  // the thread that set computing_ to true.
+  mutable std::mutex mutex_;
+  // Notified when a chunk has been computed or the input of a stream changed.
+  std::condition_variable cond_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(NnetLoopedMultiStreamComputer);
+};
+
+
+/**
+   This decodable object is like class DecodableAmNnetLoopedOnline (see
+   decodable-online-looped.h), and gives the same output (see the note about
+   recurrent models in the documentation of class
+   NnetLoopedMultiStreamComputer), but the neural net computation is done by a
+   NnetLoopedMultiStreamComputer that is shared with other streams.
+   It occupies a slot of the NnetLoopedMultiStreamComputer from construction
+   until it is destroyed.  Each object of this type should only be accessed
+   from one thread at a time.
+ */
+class DecodableAmNnetLoopedOnlineMultiStream: public DecodableInterface {
+ public:
+  // Constructor.  'input_features' is for the feature that will be given as
+  // 'input' to the neural network; 'ivector_features' is for the iVector
+  // feature, or NULL if iVectors are not being used.
+  DecodableAmNnetLoopedOnlineMultiStream(
+      const TransitionModel &trans_model,
+      NnetLoopedMultiStreamComputer *computer,
+      OnlineFeatureInterface *input_features,
+      OnlineFeatureInterface *ivector_features);
+
+  // 'subsampled_frame' is a frame, but if frame-subsampling-factor != 1, it's a
+  // reduced-rate output frame (e.g. a 't' index divided by 3).
+  virtual BaseFloat LogLikelihood(int32 subsampled_frame,
+                                  int32 transition_id);
+
+  virtual void LogLikelihoods(int32 subsampled_frame,
+                              const int32 *transition_ids,
+                              BaseFloat *log_likes,
+                              int32 num_indexes);
+
+  virtual bool IsLastFrame(int32 subsampled_frame) const;
+
+  virtual int32 NumFramesReady() const;
+
+  virtual int32 NumIndices() const { return trans_model_.NumTransitionIds(); }
+
+  int32 FrameSubsamplingFactor() const {
+    return computer_->Info().opts.frame_subsampling_factor;
+  }
+
+  /// Sets the frame offset value; see the same-named function in class
+  /// DecodableNnetLoopedOnlineBase (decodable-online-looped.h).
+  void SetFrameOffset(int32 frame_offset);
+
+  /// Returns the frame offset value.
+  int32 GetFrameOffset() const { return frame_offset_; }
+
+  ~DecodableAmNnetLoopedOnlineMultiStream();
+
+ private:
+  // Gives any input frames that have become ready since the last call to the
+  // NnetLoopedMultiStreamComputer.  It is const because it is called from
+  // NumFramesReady(); the members it changes are mutable.
+  void UpdateInput() const;
+
+  /// If the neural-network outputs for this frame (not including the frame
+  /// offset) are not cached, this function gets them, together with all the
+  /// other frames that are available.
+  inline void EnsureFrameIsComputed(int32 subsampled_frame) {
+    KALDI_ASSERT(subsampled_frame >= current_log_post_subsampled_offset_ &&
+                 "Frames must be accessed in order.");
+    while (subsampled_frame >= current_log_post_subsampled_offset_ +
+           current_log_post_.NumRows())
+      GetMoreOutput();
+  }
+
+  void GetMoreOutput();
+
+  const TransitionModel &trans_model_;
+  NnetLoopedMultiStreamComputer *computer_;
+  OnlineFeatureInterface *input_features_;
+  OnlineFeatureInterface *ivector_features_;
+  // The slot of computer_ that this stream occupies.
+  int32 slot_;
+
+  // The number of input frames given to computer_ so far, and whether we have
+  // told it that the input has finished.
+  mutable int32 num_frames_accepted_;
+  mutable bool input_finished_;
+
+  // The log-likelihoods of the most recently computed chunks, for the
+  // (subsampled) output frames starting from
+  // current_log_post_subsampled_offset_.
+  Matrix<BaseFloat> current_log_post_;
+  int32 current_log_post_subsampled_offset_;
+
+  // IsLastFrame(), NumFramesReady() and LogLikelihood() methods take into
+  // account this offset value. We initialize frame_offset_ as 0 and it stays as
+  // 0 unless SetFrameOffset() method is called.
+  int32 frame_offset_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(DecodableAmNnetLoopedOnlineMultiStream);
+};
+
+
+} // namespace nnet3
+} // namespace kaldi
+
+#endif // KALDI_NNET3_DECODABLE_ONLINE_MULTI_STREAM_H_
@@ -17,6 +17,11 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <random>
+
 #include "nnet3/decodable-simple-looped.h"
 #include "nnet3/nnet-utils.h"
 #include "nnet3/nnet-compile-looped.h"
@@ -24,12 +29,117 @@
 namespace kaldi {
 namespace nnet3 {
 
+// Returns the name of the file in 'cache_dir' for the looped computation of
+// 'nnet' compiled from these requests.  It is the name that
+// CachingOptimizingCompiler would use for the nnet (see
+// GetComputationCacheFilename()), with a hash of the requests added, as a
+// looped computation depends on the chunk size, contexts and number of
+// sequences in its requests.
+static std::string GetLoopedComputationCacheFilename(
+    const std::string &cache_dir, const Nnet &nnet,
+    const NnetOptimizeOptions &opt_config,
+    const ComputationRequest &request1, const ComputationRequest &request2,
+    const ComputationRequest &request3) {
+  std::string filename = GetComputationCacheFilename(cache_dir, nnet,
+                                                     opt_config, false);
+  const std::string suffix = ".cache";
+  KALDI_ASSERT(filename.size() > suffix.size());
+  std::ostringstream os;
+  request1.Write(os, true);
+  request2.Write(os, true);
+  request3.Write(os, true);
+  std::ostringstream ans;
+  ans << filename.substr(0, filename.size() - suffix.size()) << "-looped-"
+      << std::hex << std::setfill('0') << std::setw(16)
+      << StringHasher()(os.str()) << suffix;
+  return ans.str();
+}
+
+// Reads the computation from 'filename' if it exists and was written by
+// WriteLoopedComputationCache() for the same requests; returns true if it
+// did.
+static bool ReadLoopedComputationCache(const std::string &filename,
+                                       const ComputationRequest &request1,
+                                       const ComputationRequest &request2,
+                                       const ComputationRequest &request3,
+                                       NnetComputation *computation) {
+  std::ifstream is(filename.c_str(), std::ios::binary);
+  if (!is.is_open()) {
+    KALDI_VLOG(1) << "No cached looped computation in " << filename;
+    return false;
+  }
+  try {
+    bool binary;
+    if (!InitKaldiInputStream(is, &binary))
+      KALDI_ERR << "Could not initialize stream";
+    ExpectToken(is, binary, "<LoopedComputation>");
+    ComputationRequest request1_cached, request2_cached, request3_cached;
+    request1_cached.Read(is, binary);
+    request2_cached.Read(is, binary);
+    request3_cached.Read(is, binary);
+    // This can only fail if the hash in the filename collides.
+    if (!(request1 == request1_cached && request2 == request2_cached &&
+          request3 == request3_cached)) {
+      KALDI_WARN << "Cached looped computation in " << filename
+                 << " is for different requests; not using it.";
+      return false;
+    }
+    computation->Read(is, binary);
+    ExpectToken(is, binary, "</LoopedComputation>");
+    KALDI_VLOG(1) << "Read cached looped computation from " << filename;
+    return true;
+  } catch (const std::exception &e) {
+    KALDI_WARN << "Error reading cached looped computation from " << filename
+               << ": " << e.what();
+    return false;
+  }
+}
+
+// Writes the computation to 'filename', via a temporary file so that other
+// processes see either the whole file or none of it.  Failure is not an
+// error, as the cache is only an optimization.
+static void WriteLoopedComputationCache(const std::string &filename,
+                                        const ComputationRequest &request1,
+                                        const ComputationRequest &request2,
+                                        const ComputationRequest &request3,
+                                        const NnetComputation &computation) {
+  std::random_device random;
+  std::ostringstream tmp_filename;
+  tmp_filename << filename << ".tmp." << std::hex << random() << random();
+  try {
+    {
+      std::ofstream os(tmp_filename.str().c_str(), std::ios::binary);
+      if (!os.is_open())
+        KALDI_ERR << "Could not open " << tmp_filename.str()
+                  << " for writing (does the directory exist?)";
+      InitKaldiOutputStream(os, true);
+      WriteToken(os, true, "<LoopedComputation>");
+      request1.Write(os, true);
+      request2.Write(os, true);
+      request3.Write(os, true);
+      computation.Write(os, true);
+      WriteToken(os, true, "</LoopedComputation>");
+      os.close();
+      if (os.fail())
+        KALDI_ERR << "Error writing " << tmp_filename.str();
+    }
+    if (std::rename(tmp_filename.str().c_str(), filename.c_str()) != 0)
+      KALDI_ERR << "Could not rename " << tmp_filename.str() << " to "
+                << filename;
+    KALDI_VLOG(1) << "Wrote cached looped computation to " << filename;
+  } catch (const std::exception &e) {
+    KALDI_WARN << "Failed to write cached looped computation to " << filename
+               << ": " << e.what();
+    std::remove(tmp_filename.str().c_str());
+  }
+}
+
 
 DecodableNnetSimpleLoopedInfo::DecodableNnetSimpleLoopedInfo(
     const NnetSimpleLoopedComputationOptions &opts,
-    Nnet *nnet):
+    Nnet *nnet, int32 num_sequences):
     opts(opts), nnet(*nnet) {
-  Init(opts, nnet);
+  Init(opts, nnet, num_sequences);
 }
 
 DecodableNnetSimpleLoopedInfo::DecodableNnetSimpleLoopedInfo(
@@ -45,17 +155,19 @@ DecodableNnetSimpleLoopedInfo::DecodableNnetSimpleLoopedInfo(
 
 DecodableNnetSimpleLoopedInfo::DecodableNnetSimpleLoopedInfo(
     const NnetSimpleLoopedComputationOptions &opts,
-    AmNnetSimple *am_nnet):
+    AmNnetSimple *am_nnet, int32 num_sequences):
     opts(opts), nnet(am_nnet->GetNnet()), log_priors(am_nnet->Priors()) {
   if (log_priors.Dim() != 0)
     log_priors.ApplyLog();
-  Init(opts, &(am_nnet->GetNnet()));
+  Init(opts, &(am_nnet->GetNnet()), num_sequences);
 }
 
 void DecodableNnetSimpleLoopedInfo::Init(
     const NnetSimpleLoopedComputationOptions &opts,
-    Nnet *nnet) {
+    Nnet *nnet, int32 num_sequences) {
   opts.Check();
+  KALDI_ASSERT(num_sequences > 0);
+  this->num_sequences = num_sequences;
   KALDI_ASSERT(IsSimpleNnet(*nnet));
   has_ivectors = (nnet->InputDim("ivector") > 0);
   int32 left_context, right_context;
@@ -72,8 +184,6 @@ void DecodableNnetSimpleLoopedInfo::Init(
   if (has_ivectors)
     ModifyNnetIvectorPeriod(ivector_period, nnet);
 
-  int32 num_sequences = 1;  // we're processing one utterance at a time.
-
   CreateLoopedComputationRequest(*nnet, frames_per_chunk,
                                  opts.frame_subsampling_factor,
                                  ivector_period,
@@ -82,9 +192,22 @@ void DecodableNnetSimpleLoopedInfo::Init(
                                  num_sequences,
                                  &request1, &request2, &request3);
 
-  CompileLooped(*nnet, opts.optimize_config, request1, request2, request3,
-                &computation);
-  computation.ComputeCudaIndexes();
+  std::string cache_filename;
+  if (!opts.cache_dir.empty())
+    cache_filename = GetLoopedComputationCacheFilename(
+        opts.cache_dir, *nnet, opts.optimize_config,
+        request1, request2, request3);
+  // NnetComputation::Read() calls ComputeCudaIndexes().
+  if (cache_filename.empty() ||
+      !ReadLoopedComputationCache(cache_filename, request1, request2,
+                                  request3, &computation)) {
+    CompileLooped(*nnet, opts.optimize_config, request1, request2, request3,
+                  &computation);
+    computation.ComputeCudaIndexes();
+    if (!cache_filename.empty())
+      WriteLoopedComputationCache(cache_filename, request1, request2,
+                                  request3, computation);
+  }
   KALDI_VLOG(3) << "Computation is:\n"
                 << NnetComputationPrintInserter{computation, *nnet};
 }
@@ -104,6 +227,7 @@ DecodableNnetSimpleLooped::DecodableNnetSimpleLooped(
     online_ivector_period_(online_ivector_period),
     num_chunks_computed_(0),
     current_log_post_subsampled_offset_(-1) {
+  KALDI_ASSERT(info_.num_sequences == 1);
   num_subsampled_frames_ =
       (feats_.NumRows() + info_.opts.frame_subsampling_factor - 1) /
       info_.opts.frame_subsampling_factor;
@@ -49,6 +49,10 @@ struct NnetSimpleLoopedComputationOptions {
   int32 frames_per_chunk;
   BaseFloat acoustic_scale;
   bool debug_computation;
+  // If set, a directory in which the compiled looped computation is cached,
+  // so that a program started again with the same model and options does not
+  // have to compile it again (see DecodableNnetSimpleLoopedInfo::Init()).
+  std::string cache_dir;
   NnetOptimizeOptions optimize_config;
   NnetComputeOptions compute_config;
   NnetSimpleLoopedComputationOptions():
@@ -83,6 +87,10 @@ struct NnetSimpleLoopedComputationOptions {
                    "if needed.");
     opts->Register("debug-computation", &debug_computation, "If true, turn on "
                    "debug for the actual computation (very verbose!)");
+    opts->Register("computation-cache-dir", &cache_dir, "If set, a directory "
+                   "in which to cache the compiled looped computation, which "
+                   "is read from there if the model and options match, to "
+                   "save time at startup.  The directory must exist.");
 
     // register the optimization options with the prefix "optimization".
     ParseOptions optimization_opts("optimization", opts);
@@ -102,14 +110,17 @@ struct NnetSimpleLoopedComputationOptions {
 class DecodableNnetSimpleLoopedInfo  {
  public:
   // The constructor takes a non-const pointer to 'nnet' because it may have to
-  // modify it to be able to take multiple iVectors.
+  // modify it to be able to take multiple iVectors.  'num_sequences' is the
+  // number of sequences (streams) that the compiled computation processes
+  // together; it should be 1 unless you are using class
+  // NnetLoopedMultiStreamComputer (see decodable-online-multi-stream.h).
   DecodableNnetSimpleLoopedInfo(const NnetSimpleLoopedComputationOptions &opts,
-                                Nnet *nnet);
+                                Nnet *nnet, int32 num_sequences = 1);
 
   // This constructor takes the priors from class AmNnetSimple (so it can divide by
   // them).
   DecodableNnetSimpleLoopedInfo(const NnetSimpleLoopedComputationOptions &opts,
-                                AmNnetSimple *nnet);
+                                AmNnetSimple *nnet, int32 num_sequences = 1);
 
   // this constructor is for use in testing.
   DecodableNnetSimpleLoopedInfo(const NnetSimpleLoopedComputationOptions &opts,
@@ -117,7 +128,7 @@ class DecodableNnetSimpleLoopedInfo  {
                                 Nnet *nnet);
 
   void Init(const NnetSimpleLoopedComputationOptions &opts,
-            Nnet *nnet);
+            Nnet *nnet, int32 num_sequences = 1);
 
   const NnetSimpleLoopedComputationOptions &opts;
 
@@ -140,6 +151,11 @@ class DecodableNnetSimpleLoopedInfo  {
   // The output dimension of the neural network.
   int32 output_dim;
 
+  // The number of sequences that the computation processes together; in the
+  // computation requests, the 'n' index of the Indexes ranges from 0 to
+  // num_sequences - 1, and it has a larger stride than the 't' index.
+  int32 num_sequences;
+
   // True if the neural net accepts iVectors.  If so, the neural net will have been modified
   // to accept the iVectors
   bool has_ivectors;
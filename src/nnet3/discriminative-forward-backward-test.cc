@@ -0,0 +1,245 @@
+// nnet3/discriminative-forward-backward-test.cc
+
+// Copyright      2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nnet3/discriminative-forward-backward.h"
+#include "hmm/hmm-test-utils.h"
+#include "lat/lattice-functions.h"
+
+namespace kaldi {
+namespace discriminative {
+
+
+// Makes a random denominator lattice for the frames of 'num_ali', in the form
+// it has in the merged supervision of 'num_sequences' sequences: the lattices
+// of the sequences are concatenated, with epsilon arcs from the last states
+// of one to the start of the next.  There are also some epsilon arcs within
+// frames, and some states that do not reach the end.
+void GenerateDenLattice(const TransitionModel &tmodel,
+                        const std::vector<int32> &num_ali,
+                        int32 num_sequences,
+                        Lattice *lat) {
+  int32 num_frames = num_ali.size(),
+      frames_per_sequence = num_frames / num_sequences,
+      num_tids = tmodel.NumTransitionIds();
+  lat->DeleteStates();
+  std::vector<int32> cur_states(1, lat->AddState());
+  lat->SetStart(cur_states[0]);
+  for (int32 t = 0; t < num_frames; t++) {
+    int32 num_next = RandInt(1, 3);
+    std::vector<int32> next_states;
+    for (int32 i = 0; i < num_next; i++)
+      next_states.push_back(lat->AddState());
+    if (RandInt(0, 4) == 0)  // a state with no arcs leaving it.
+      next_states.push_back(lat->AddState());
+    for (size_t i = 0; i < next_states.size(); i++) {
+      int32 num_arcs = (i == 0 ? 1 : RandInt(1, 2));
+      for (int32 j = 0; j < num_arcs; j++) {
+        int32 tid = (RandInt(0, 1) == 0 ? num_ali[t] : RandInt(1, num_tids));
+        LatticeWeight weight(RandUniform(), RandUniform());
+        lat->AddArc(cur_states[RandInt(0, cur_states.size() - 1)],
+                    LatticeArc(tid, 0, weight, next_states[i]));
+      }
+    }
+    for (int32 i = 0; i + 1 < num_next; i++)
+      if (RandInt(0, 2) == 0)
+        lat->AddArc(next_states[i],
+                    LatticeArc(0, 0, LatticeWeight(RandUniform(), 0.0),
+                               next_states[RandInt(i + 1, num_next - 1)]));
+    next_states.resize(num_next);
+    cur_states.swap(next_states);
+    if ((t + 1) % frames_per_sequence == 0 && t + 1 < num_frames) {
+      int32 next_start = lat->AddState();
+      for (size_t i = 0; i < cur_states.size(); i++)
+        lat->AddArc(cur_states[i],
+                    LatticeArc(0, 0, LatticeWeight(RandUniform(), 0.0),
+                               next_start));
+      cur_states.assign(1, next_start);
+    }
+  }
+  for (size_t i = 0; i < cur_states.size(); i++)
+    lat->SetFinal(cur_states[i], LatticeWeight(RandUniform(), RandUniform()));
+}
+
+// Computes the objective function and derivative as
+// DiscriminativeComputation does on the CPU.
+double ComputeReference(const DiscriminativeOptions &opts,
+                        const TransitionModel &tmodel,
+                        const std::vector<int32> &silence_phones,
+                        const DiscriminativeSupervision &supervision,
+                        const Vector<BaseFloat> &log_priors,
+                        const Matrix<BaseFloat> &nnet_output,
+                        double *num_logprob,
+                        Matrix<BaseFloat> *nnet_output_deriv) {
+  int32 num_sequences = supervision.num_sequences,
+      frames_per_sequence = supervision.frames_per_sequence;
+  BaseFloat floor_val = -20 * kaldi::Log(10.0);
+  std::vector<int32> rows;
+  int32 num_frames = supervision.num_ali.size();
+  for (int32 t = 0; t < num_frames; t++) {
+    int32 seq = t / frames_per_sequence, idx = t % frames_per_sequence;
+    rows.push_back(idx * num_sequences + seq);
+  }
+  std::vector<int32> state_times;
+  const Lattice &den_lat = supervision.den_lat;
+  LatticeStateTimes(den_lat, &state_times);
+
+  // Put the acoustic costs in a copy of the lattice.
+  Lattice lat;
+  for (int32 s = 0; s < den_lat.NumStates(); s++)
+    lat.AddState();
+  lat.SetStart(den_lat.Start());
+  for (int32 s = 0; s < den_lat.NumStates(); s++) {
+    for (fst::ArcIterator<Lattice> aiter(den_lat, s); !aiter.Done();
+         aiter.Next()) {
+      LatticeArc arc = aiter.Value();
+      if (arc.ilabel != 0) {
+        int32 pdf = tmodel.TransitionIdToPdf(arc.ilabel);
+        BaseFloat log_post = std::max(
+            nnet_output(rows[state_times[s]], pdf), floor_val);
+        if (log_priors.Dim() != 0)
+          log_post -= log_priors(pdf);
+        arc.weight = LatticeWeight(arc.weight.Value1(),
+                                   -log_post * opts.acoustic_scale);
+      }
+      lat.AddArc(s, arc);
+    }
+    LatticeWeight final = den_lat.Final(s);
+    if (final != LatticeWeight::Zero())
+      lat.SetFinal(s, LatticeWeight(final.Value1(), 0.0));
+  }
+
+  Posterior post;
+  double objf;
+  *num_logprob = 0.0;
+  if (opts.criterion == "mmi") {
+    objf = LatticeForwardBackwardMmi(tmodel, lat, supervision.num_ali,
+                                     opts.drop_frames, true, true, &post);
+    for (int32 t = 0; t < num_frames; t++) {
+      int32 pdf = tmodel.TransitionIdToPdf(supervision.num_ali[t]);
+      BaseFloat log_post = std::max(nnet_output(rows[t], pdf), floor_val);
+      if (log_priors.Dim() != 0)
+        log_post -= log_priors(pdf);
+      *num_logprob += log_post * opts.acoustic_scale;
+    }
+  } else {
+    Posterior tid_post;
+    objf = LatticeForwardBackwardMpeVariants(tmodel, silence_phones, lat,
+                                             supervision.num_ali,
+                                             opts.criterion,
+                                             opts.one_silence_class,
+                                             &tid_post);
+    ConvertPosteriorToPdfs(tmodel, tid_post, &post);
+  }
+  nnet_output_deriv->Resize(nnet_output.NumRows(), nnet_output.NumCols());
+  for (int32 t = 0; t < num_frames; t++)
+    for (size_t i = 0; i < post[t].size(); i++)
+      (*nnet_output_deriv)(rows[t], post[t][i].first) += post[t][i].second;
+  return objf;
+}
+
+void UnitTestDenominatorForwardBackward() {
+  ContextDependency *ctx_dep;
+  TransitionModel *tmodel = GenRandTransitionModel(&ctx_dep);
+  const std::vector<int32> &phones = tmodel->GetPhones();
+  std::vector<int32> silence_phones;
+  for (size_t i = 0; i < phones.size(); i++)
+    if (RandInt(0, 2) == 0)
+      silence_phones.push_back(phones[i]);
+
+  DiscriminativeOptions opts;
+  const char *criteria[] = { "mmi", "mpfe", "smbr" };
+  opts.criterion = criteria[RandInt(0, 2)];
+  opts.drop_frames = (RandInt(0, 1) == 0);
+  opts.one_silence_class = (RandInt(0, 1) == 0);
+
+  DiscriminativeSupervision supervision;
+  supervision.weight = 1.0;
+  supervision.num_sequences = RandInt(1, 4);
+  supervision.frames_per_sequence = RandInt(1, 10);
+  int32 num_frames = supervision.num_sequences *
+      supervision.frames_per_sequence;
+  for (int32 t = 0; t < num_frames; t++)
+    supervision.num_ali.push_back(RandInt(1, tmodel->NumTransitionIds()));
+  GenerateDenLattice(*tmodel, supervision.num_ali, supervision.num_sequences,
+                     &(supervision.den_lat));
+
+  int32 num_pdfs = tmodel->NumPdfs();
+  CuMatrix<BaseFloat> nnet_output(num_frames, num_pdfs);
+  nnet_output.SetRandn();
+  nnet_output.ApplyLogSoftMaxPerRow();
+  Vector<BaseFloat> log_priors;
+  if (RandInt(0, 1) == 0) {
+    log_priors.Resize(num_pdfs);
+    log_priors.SetRandUniform();
+    log_priors.Add(0.1);
+    log_priors.Scale(1.0 / log_priors.Sum());
+    log_priors.ApplyLog();
+  }
+  CuVector<BaseFloat> cu_log_priors(log_priors);
+
+  DenominatorForwardBackward forward_backward(opts, *tmodel, silence_phones,
+                                              supervision,
+                                              supervision.den_lat);
+  CuMatrix<BaseFloat> deriv(num_frames, num_pdfs);
+  double num_logprob;
+  double objf = forward_backward.Compute(cu_log_priors, nnet_output,
+                                         &num_logprob, &deriv);
+
+  Matrix<BaseFloat> ref_deriv;
+  double ref_num_logprob;
+  double ref_objf = ComputeReference(opts, *tmodel, silence_phones,
+                                     supervision, log_priors,
+                                     Matrix<BaseFloat>(nnet_output),
+                                     &ref_num_logprob, &ref_deriv);
+  KALDI_LOG << "Criterion is " << opts.criterion << ", objf is " << objf
+            << " versus " << ref_objf;
+  AssertEqual(objf, ref_objf, 0.0001);
+  AssertEqual(num_logprob, ref_num_logprob, 0.0001);
+  // The derivative may be zero (e.g. for sMBR when all the paths have the
+  // same accuracy), so the tolerance is partly absolute.
+  Matrix<BaseFloat> diff(deriv);
+  diff.AddMat(-1.0, ref_deriv);
+  KALDI_ASSERT(diff.FrobeniusNorm() <=
+               0.001 * ref_deriv.FrobeniusNorm() + 1.0e-05);
+
+  delete tmodel;
+  delete ctx_dep;
+}
+
+
+}  // namespace discriminative
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  using namespace kaldi::discriminative;
+  for (int32 loop = 0; loop < 2; loop++) {
+#if HAVE_CUDA == 1
+    CuDevice::Instantiate().SetDebugStrideMode(true);
+    if (loop == 0)
+      CuDevice::Instantiate().SelectGpuId("no"); // -1 means no GPU
+    else
+      CuDevice::Instantiate().SelectGpuId("optional"); // -2 .. automatic selection
+#endif
+    for (int32 i = 0; i < 20; i++)
+      UnitTestDenominatorForwardBackward();
+  }
+  KALDI_LOG << "Tests succeeded.";
+  return 0;
+}
@@ -0,0 +1,590 @@
+// nnet3/discriminative-forward-backward.cc
+
+// Copyright      2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <limits>
+
+#include "nnet3/discriminative-forward-backward.h"
+#include "nnet3/discriminative-kernels-ansi.h"
+#include "lat/lattice-functions.h"
+
+namespace kaldi {
+namespace discriminative {
+
+// The floor on the log-posteriors from the nnet, as in
+// DiscriminativeComputation::ConvertAnswersToLogLike().
+static const BaseFloat kLogPosteriorFloor = -20 * M_LN10;
+
+static inline BaseFloat AcousticLogLike(BaseFloat log_post,
+                                        const BaseFloat *log_prior,
+                                        BaseFloat acoustic_scale) {
+  log_post = std::max(log_post, kLogPosteriorFloor);
+  if (log_prior != NULL)
+    log_post -= *log_prior;
+  return log_post * acoustic_scale;
+}
+
+// Puts in (*states) the indexes i with 0 < levels[i] <= num_levels, in order
+// of level, and in (*level_begin) the start of each level, so that level l is
+// (*states)[j] for (*level_begin)[l] <= j < (*level_begin)[l+1].
+static void GroupStatesByLevel(const std::vector<int32> &levels,
+                               int32 num_levels,
+                               std::vector<int32> *states,
+                               std::vector<int32> *level_begin) {
+  level_begin->assign(num_levels + 2, 0);
+  for (size_t i = 0; i < levels.size(); i++)
+    if (levels[i] > 0)
+      (*level_begin)[levels[i] + 1]++;
+  for (int32 l = 1; l <= num_levels + 1; l++)
+    (*level_begin)[l] += (*level_begin)[l - 1];
+  states->resize(level_begin->back());
+  std::vector<int32> pos(*level_begin);
+  for (size_t i = 0; i < levels.size(); i++)
+    if (levels[i] > 0)
+      (*states)[pos[levels[i]]++] = i;
+}
+
+DenominatorForwardBackward::DenominatorForwardBackward(
+    const DiscriminativeOptions &opts,
+    const TransitionModel &tmodel,
+    const std::vector<int32> &silence_phones,
+    const DiscriminativeSupervision &supervision,
+    const Lattice &den_lat):
+    opts_(opts), tmodel_(tmodel), silence_phones_(silence_phones),
+    supervision_(supervision), is_mmi_(opts.criterion == "mmi") {
+  if (!is_mmi_ && opts_.criterion != "mpfe" && opts_.criterion != "smbr")
+    KALDI_ERR << "Unknown criterion " << opts_.criterion;
+  Init(den_lat);
+}
+
+BaseFloat DenominatorForwardBackward::FrameAccuracy(int32 tid,
+                                                    int32 ref_tid) const {
+  int32 phone = tmodel_.TransitionIdToPhone(tid),
+      ref_phone = tmodel_.TransitionIdToPhone(ref_tid);
+  bool phone_is_sil = std::binary_search(silence_phones_.begin(),
+                                         silence_phones_.end(), phone),
+      ref_phone_is_sil = std::binary_search(silence_phones_.begin(),
+                                            silence_phones_.end(), ref_phone),
+      both_sil = phone_is_sil && ref_phone_is_sil;
+  if (opts_.criterion == "smbr") {
+    int32 pdf = tmodel_.TransitionIdToPdf(tid),
+        ref_pdf = tmodel_.TransitionIdToPdf(ref_tid);
+    if (!opts_.one_silence_class)  // old behavior
+      return (pdf == ref_pdf && !phone_is_sil) ? 1.0 : 0.0;
+    else
+      return (pdf == ref_pdf || both_sil) ? 1.0 : 0.0;
+  } else {
+    if (!opts_.one_silence_class)  // old behavior
+      return (phone == ref_phone && !phone_is_sil) ? 1.0 : 0.0;
+    else
+      return (phone == ref_phone || both_sil) ? 1.0 : 0.0;
+  }
+}
+
+void DenominatorForwardBackward::Init(const Lattice &den_lat) {
+  typedef Lattice::Arc Arc;
+  typedef Arc::StateId StateId;
+
+  if (den_lat.Properties(fst::kTopSorted, true) == 0)
+    KALDI_ERR << "Denominator lattice must be topologically sorted.";
+  KALDI_ASSERT(den_lat.Start() == 0);
+  int32 num_sequences = supervision_.num_sequences,
+      frames_per_sequence = supervision_.frames_per_sequence,
+      num_frames = num_sequences * frames_per_sequence;
+  const std::vector<int32> &num_ali = supervision_.num_ali;
+  KALDI_ASSERT(static_cast<int32>(num_ali.size()) == num_frames);
+  std::vector<int32> state_times;
+  int32 max_time = LatticeStateTimes(den_lat, &state_times);
+  KALDI_ASSERT(max_time == num_frames);
+
+  // The arcs, in order of source state, with the final-probs as arcs to the
+  // super-final state.
+  int32 num_lat_states = den_lat.NumStates(),
+      super_final = num_lat_states;
+  num_states_ = num_lat_states + 1;
+  out_begin_.resize(num_states_ + 1);
+  for (StateId s = 0; s < num_lat_states; s++) {
+    out_begin_[s] = arc_src_.size();
+    int32 t = state_times[s];
+    for (fst::ArcIterator<Lattice> aiter(den_lat, s); !aiter.Done();
+         aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      KALDI_ASSERT(arc.nextstate > s);
+      arc_src_.push_back(s);
+      arc_dst_.push_back(arc.nextstate);
+      if (arc.ilabel != 0) {
+        // Same ordering of the rows as for 'chain' models.
+        int32 seq = t / frames_per_sequence, idx = t % frames_per_sequence;
+        arc_row_.push_back(idx * num_sequences + seq);
+        arc_pdf_.push_back(tmodel_.TransitionIdToPdf(arc.ilabel));
+        arc_graph_like_.push_back(-arc.weight.Value1());
+        if (!is_mmi_)
+          arc_acc_.push_back(FrameAccuracy(arc.ilabel, num_ali[t]));
+      } else {
+        arc_row_.push_back(-1);
+        arc_pdf_.push_back(-1);
+        arc_graph_like_.push_back(-ConvertToCost(arc.weight));
+        if (!is_mmi_)
+          arc_acc_.push_back(0.0);
+      }
+    }
+    LatticeWeight final = den_lat.Final(s);
+    if (final != LatticeWeight::Zero()) {
+      if (t != num_frames)
+        KALDI_ERR << "Lattice is inconsistent (final-prob not at max_time)";
+      arc_src_.push_back(s);
+      arc_dst_.push_back(super_final);
+      arc_row_.push_back(-1);
+      arc_pdf_.push_back(-1);
+      // The acoustic part of the final-prob is ignored.
+      arc_graph_like_.push_back(-final.Value1());
+      if (!is_mmi_)
+        arc_acc_.push_back(0.0);
+    }
+  }
+  num_arcs_ = arc_src_.size();
+  out_begin_[super_final] = num_arcs_;
+  out_begin_[num_states_] = num_arcs_;
+
+  in_begin_.assign(num_states_ + 1, 0);
+  for (int32 a = 0; a < num_arcs_; a++)
+    in_begin_[arc_dst_[a] + 1]++;
+  for (int32 s = 0; s < num_states_; s++)
+    in_begin_[s + 1] += in_begin_[s];
+  in_arcs_.resize(num_arcs_);
+  {
+    std::vector<int32> pos(in_begin_);
+    for (int32 a = 0; a < num_arcs_; a++)
+      in_arcs_[pos[arc_dst_[a]]++] = a;
+  }
+
+  // The levels.  States that cannot reach the super-final state may have a
+  // level beyond it; they are not computed.
+  std::vector<int32> level(num_states_, 0);
+  for (int32 a = 0; a < num_arcs_; a++)
+    level[arc_dst_[a]] = std::max(level[arc_dst_[a]], level[arc_src_[a]] + 1);
+  int32 final_level = level[super_final];
+
+  // A level is a cut if there is only one state in it and no arc goes past
+  // it.  The start and super-final states are always cuts; other states at
+  // their levels cannot be on a successful path.
+  std::vector<int32> level_count(final_level + 1, 0),
+      num_crossing(final_level + 2, 0);
+  for (int32 s = 0; s < num_states_; s++)
+    if (level[s] <= final_level)
+      level_count[level[s]]++;
+  for (int32 a = 0; a < num_arcs_; a++) {
+    int32 begin = level[arc_src_[a]] + 1,
+        end = std::min(level[arc_dst_[a]], final_level + 1);
+    if (begin < end) {
+      num_crossing[begin]++;
+      num_crossing[end]--;
+    }
+  }
+  std::vector<int32> level_state(final_level + 1, -1);
+  for (int32 s = 0; s < num_states_; s++)
+    if (level[s] <= final_level)
+      level_state[level[s]] = s;
+  level_state[0] = 0;
+  level_state[final_level] = super_final;
+
+  std::vector<int32> cut_levels;
+  // segment_of_level[l] is the segment k with cut_levels[k] <= l <
+  // cut_levels[k+1].
+  std::vector<int32> segment_of_level(final_level + 1);
+  int32 crossing = 0;
+  for (int32 l = 0; l <= final_level; l++) {
+    crossing += num_crossing[l];
+    if (l == 0 || l == final_level ||
+        (level_count[l] == 1 && crossing == 0))
+      cut_levels.push_back(l);
+    segment_of_level[l] = cut_levels.size() - 1;
+  }
+  num_segments_ = cut_levels.size() - 1;
+  KALDI_ASSERT(num_segments_ >= 1);
+
+  state_segment_.resize(num_states_);
+  is_cut_.assign(num_states_, 0);
+  std::vector<int32> fwd_level(num_states_, 0), bwd_level(num_states_, 0);
+  int32 num_levels = 0;
+  for (int32 k = 0; k < num_segments_; k++)
+    num_levels = std::max(num_levels, cut_levels[k + 1] - cut_levels[k]);
+  for (int32 s = 0; s < num_states_; s++) {
+    int32 l = level[s];
+    if (l <= final_level && level_state[l] == s &&
+        cut_levels[segment_of_level[l]] == l) {
+      int32 k = segment_of_level[l];
+      is_cut_[s] = 1;
+      state_segment_[s] = k;
+      if (k > 0)
+        fwd_level[s] = l - cut_levels[k - 1];
+      if (k < num_segments_)
+        bwd_level[s] = cut_levels[k + 1] - l;
+    } else if (l >= final_level) {
+      state_segment_[s] = num_segments_ - 1;
+    } else {
+      int32 k = segment_of_level[l];
+      state_segment_[s] = k;
+      if (l > 0)
+        fwd_level[s] = l - cut_levels[k];
+      bwd_level[s] = cut_levels[k + 1] - l;
+    }
+  }
+  GroupStatesByLevel(fwd_level, num_levels, &fwd_states_, &fwd_level_begin_);
+  GroupStatesByLevel(bwd_level, num_levels, &bwd_states_, &bwd_level_begin_);
+
+  if (is_mmi_) {
+    num_pdfs_.resize(num_frames);
+    for (int32 t = 0; t < num_frames; t++) {
+      int32 seq = t / frames_per_sequence, idx = t % frames_per_sequence,
+          pdf = tmodel_.TransitionIdToPdf(num_ali[t]);
+      num_pdfs_[idx * num_sequences + seq] = pdf;
+    }
+  }
+  KALDI_VLOG(3) << "Denominator lattice has " << num_states_ << " states, "
+                << num_arcs_ << " arcs, " << num_segments_ << " segments and "
+                << num_levels << " levels per segment.";
+}
+
+void DenominatorForwardBackward::ForwardState(int32 d) {
+  const double kLogZero = -std::numeric_limits<double>::infinity();
+  int32 begin = in_begin_[d], end = in_begin_[d + 1];
+  double max_like = kLogZero;
+  for (int32 j = begin; j < end; j++) {
+    int32 a = in_arcs_[j], s = arc_src_[a];
+    max_like = std::max(max_like,
+                        (is_cut_[s] ? 0.0 : alpha_[s]) + arc_like_[a]);
+  }
+  double sum = 0.0, smbr_sum = 0.0;
+  if (max_like != kLogZero) {
+    for (int32 j = begin; j < end; j++) {
+      int32 a = in_arcs_[j], s = arc_src_[a];
+      bool cut = is_cut_[s];
+      double scale = Exp((cut ? 0.0 : alpha_[s]) + arc_like_[a] - max_like);
+      sum += scale;
+      if (!is_mmi_)
+        smbr_sum += scale * ((cut ? 0.0 : alpha_smbr_[s]) + arc_acc_[a]);
+    }
+  }
+  double alpha = (sum > 0.0 ? max_like + Log(sum) : kLogZero),
+      alpha_smbr = (sum > 0.0 ? smbr_sum / sum : 0.0);
+  alpha_[d] = alpha;
+  if (!is_mmi_)
+    alpha_smbr_[d] = alpha_smbr;
+  if (is_cut_[d]) {
+    // d ends the segment before the one it starts.
+    int32 seg = state_segment_[d] - 1;
+    seg_like_fwd_[seg] = alpha;
+    if (!is_mmi_)
+      seg_acc_fwd_[seg] = alpha_smbr;
+  }
+}
+
+void DenominatorForwardBackward::BackwardState(int32 s) {
+  const double kLogZero = -std::numeric_limits<double>::infinity();
+  int32 begin = out_begin_[s], end = out_begin_[s + 1];
+  double max_like = kLogZero;
+  for (int32 a = begin; a < end; a++) {
+    int32 d = arc_dst_[a];
+    max_like = std::max(max_like,
+                        (is_cut_[d] ? 0.0 : beta_[d]) + arc_like_[a]);
+  }
+  double sum = 0.0, smbr_sum = 0.0;
+  if (max_like != kLogZero) {
+    for (int32 a = begin; a < end; a++) {
+      int32 d = arc_dst_[a];
+      bool cut = is_cut_[d];
+      double scale = Exp((cut ? 0.0 : beta_[d]) + arc_like_[a] - max_like);
+      sum += scale;
+      if (!is_mmi_)
+        smbr_sum += scale * ((cut ? 0.0 : beta_smbr_[d]) + arc_acc_[a]);
+    }
+  }
+  double beta = (sum > 0.0 ? max_like + Log(sum) : kLogZero),
+      beta_smbr = (sum > 0.0 ? smbr_sum / sum : 0.0);
+  beta_[s] = beta;
+  if (!is_mmi_)
+    beta_smbr_[s] = beta_smbr;
+  if (is_cut_[s]) {
+    int32 seg = state_segment_[s];
+    seg_like_bwd_[seg] = beta;
+    if (!is_mmi_)
+      seg_acc_bwd_[seg] = beta_smbr;
+  }
+}
+
+double DenominatorForwardBackward::TotalObjf(const double *seg_like_fwd,
+                                             const double *seg_like_bwd,
+                                             const double *seg_acc_fwd,
+                                             const double *seg_acc_bwd) const {
+  double tot_forward_prob = 0.0, tot_backward_prob = 0.0,
+      tot_forward_score = 0.0, tot_backward_score = 0.0;
+  for (int32 k = 0; k < num_segments_; k++) {
+    tot_forward_prob += seg_like_fwd[k];
+    tot_backward_prob += seg_like_bwd[k];
+    if (!is_mmi_) {
+      tot_forward_score += seg_acc_fwd[k];
+      tot_backward_score += seg_acc_bwd[k];
+    }
+  }
+  if (is_mmi_) {
+    if (!ApproxEqual(tot_forward_prob, tot_backward_prob, 1e-8))
+      KALDI_WARN << "Total forward probability over lattice = "
+                 << tot_forward_prob << ", while total backward probability = "
+                 << tot_backward_prob;
+    return tot_forward_prob;
+  }
+  if (!ApproxEqual(tot_forward_prob, tot_backward_prob, 1e-6))
+    KALDI_ERR << "Total forward probability over lattice = " << tot_forward_prob
+              << ", while total backward probability = " << tot_backward_prob;
+  if (!ApproxEqual(tot_forward_score, tot_backward_score, 1e-4))
+    KALDI_ERR << "Total forward score over lattice = " << tot_forward_score
+              << ", while total backward score = " << tot_backward_score;
+  return tot_forward_score;
+}
+
+double DenominatorForwardBackward::Compute(
+    const CuVectorBase<BaseFloat> &log_priors,
+    const CuMatrixBase<BaseFloat> &nnet_output,
+    double *num_logprob,
+    CuMatrixBase<BaseFloat> *nnet_output_deriv) {
+  KALDI_ASSERT(nnet_output.NumRows() ==
+               supervision_.num_sequences * supervision_.frames_per_sequence &&
+               nnet_output.NumCols() == tmodel_.NumPdfs() &&
+               (log_priors.Dim() == 0 ||
+                log_priors.Dim() == nnet_output.NumCols()));
+  KALDI_ASSERT(SameDim(nnet_output, *nnet_output_deriv));
+  *num_logprob = 0.0;
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled())
+    return ComputeGpu(log_priors, nnet_output, num_logprob, nnet_output_deriv);
+#endif
+  return ComputeCpu(log_priors, nnet_output, num_logprob, nnet_output_deriv);
+}
+
+double DenominatorForwardBackward::ComputeCpu(
+    const CuVectorBase<BaseFloat> &log_priors,
+    const CuMatrixBase<BaseFloat> &nnet_output,
+    double *num_logprob,
+    CuMatrixBase<BaseFloat> *nnet_output_deriv) {
+  const MatrixBase<BaseFloat> &output = nnet_output.Mat();
+  MatrixBase<BaseFloat> &deriv = nnet_output_deriv->Mat();
+  const BaseFloat *priors = (log_priors.Dim() > 0 ? log_priors.Data() : NULL);
+  BaseFloat acoustic_scale = opts_.acoustic_scale;
+
+  arc_like_.resize(num_arcs_);
+  for (int32 a = 0; a < num_arcs_; a++) {
+    arc_like_[a] = arc_graph_like_[a];
+    int32 pdf = arc_pdf_[a];
+    if (pdf >= 0)
+      arc_like_[a] += AcousticLogLike(output(arc_row_[a], pdf),
+                                      (priors ? priors + pdf : NULL),
+                                      acoustic_scale);
+  }
+
+  const double kLogZero = -std::numeric_limits<double>::infinity();
+  alpha_.assign(num_states_, kLogZero);
+  beta_.assign(num_states_, kLogZero);
+  seg_like_fwd_.assign(num_segments_, 0.0);
+  seg_like_bwd_.assign(num_segments_, 0.0);
+  if (!is_mmi_) {
+    alpha_smbr_.assign(num_states_, 0.0);
+    beta_smbr_.assign(num_states_, 0.0);
+    seg_acc_fwd_.assign(num_segments_, 0.0);
+    seg_acc_bwd_.assign(num_segments_, 0.0);
+  }
+  int32 num_levels = fwd_level_begin_.size() - 2;
+  for (int32 l = 1; l <= num_levels; l++)
+    for (int32 i = fwd_level_begin_[l]; i < fwd_level_begin_[l + 1]; i++)
+      ForwardState(fwd_states_[i]);
+  for (int32 l = 1; l <= num_levels; l++)
+    for (int32 i = bwd_level_begin_[l]; i < bwd_level_begin_[l + 1]; i++)
+      BackwardState(bwd_states_[i]);
+
+  std::vector<bool> num_pdf_present;
+  if (is_mmi_ && opts_.drop_frames)
+    num_pdf_present.resize(output.NumRows(), false);
+  for (int32 a = 0; a < num_arcs_; a++) {
+    int32 pdf = arc_pdf_[a];
+    if (pdf < 0)
+      continue;
+    int32 s = arc_src_[a], d = arc_dst_[a], row = arc_row_[a],
+        seg = state_segment_[s];
+    bool s_cut = is_cut_[s], d_cut = is_cut_[d];
+    double post = Exp((s_cut ? 0.0 : alpha_[s]) + arc_like_[a] +
+                      (d_cut ? 0.0 : beta_[d]) - seg_like_fwd_[seg]);
+    if (is_mmi_) {
+      deriv(row, pdf) -= post;
+      // As in MergePosteriors(), a pdf with zero posterior (e.g. on an arc
+      // that does not reach the end) does not count as present.
+      if (!num_pdf_present.empty() && num_pdfs_[row] == pdf && post > 0.0)
+        num_pdf_present[row] = true;
+    } else {
+      deriv(row, pdf) += post * ((s_cut ? 0.0 : alpha_smbr_[s]) +
+                                 arc_acc_[a] +
+                                 (d_cut ? 0.0 : beta_smbr_[d]) -
+                                 seg_acc_fwd_[seg]);
+    }
+  }
+
+  if (is_mmi_) {
+    for (int32 row = 0; row < output.NumRows(); row++) {
+      int32 pdf = num_pdfs_[row];
+      *num_logprob += AcousticLogLike(output(row, pdf),
+                                      (priors ? priors + pdf : NULL),
+                                      acoustic_scale);
+      if (!num_pdf_present.empty() && !num_pdf_present[row])
+        deriv.Row(row).SetZero();
+      else
+        deriv(row, pdf) += 1.0;
+    }
+  }
+  return TotalObjf(&(seg_like_fwd_[0]), &(seg_like_bwd_[0]),
+                   (is_mmi_ ? NULL : &(seg_acc_fwd_[0])),
+                   (is_mmi_ ? NULL : &(seg_acc_bwd_[0])));
+}
+
+#if HAVE_CUDA == 1
+double DenominatorForwardBackward::ComputeGpu(
+    const CuVectorBase<BaseFloat> &log_priors,
+    const CuMatrixBase<BaseFloat> &nnet_output,
+    double *num_logprob,
+    CuMatrixBase<BaseFloat> *nnet_output_deriv) {
+  CuTimer tim;
+  // Copy all the integer arrays to the device in one transfer, and likewise
+  // the floating-point ones.
+  const std::vector<int32> *int_arrays[] = {
+    &out_begin_, &in_begin_, &in_arcs_, &arc_src_, &arc_dst_, &arc_row_,
+    &arc_pdf_, &state_segment_, &is_cut_, &fwd_states_, &bwd_states_,
+    &num_pdfs_ };
+  const int32 num_int_arrays = sizeof(int_arrays) / sizeof(int_arrays[0]);
+  std::vector<int32> int_data, int_offsets(num_int_arrays);
+  for (int32 i = 0; i < num_int_arrays; i++) {
+    int_offsets[i] = int_data.size();
+    int_data.insert(int_data.end(), int_arrays[i]->begin(),
+                    int_arrays[i]->end());
+  }
+  CuArray<int32> cu_int_data(int_data);
+  const int32 *int_ptr = cu_int_data.Data();
+
+  // The graph log-likelihoods, the frame accuracies (not for MMI), and space
+  // for the arc log-likelihoods.
+  int32 num_float_arrays = (is_mmi_ ? 2 : 3);
+  Vector<BaseFloat> float_data(num_float_arrays * num_arcs_, kUndefined);
+  std::copy(arc_graph_like_.begin(), arc_graph_like_.end(), float_data.Data());
+  if (!is_mmi_)
+    std::copy(arc_acc_.begin(), arc_acc_.end(), float_data.Data() + num_arcs_);
+  CuVector<BaseFloat> cu_float_data(float_data);
+  BaseFloat *float_ptr = cu_float_data.Data();
+
+  // alpha, beta, alpha_smbr and beta_smbr for the states, then seg_like_fwd,
+  // seg_like_bwd, seg_acc_fwd and seg_acc_bwd for the segments.
+  int32 num_states = num_states_, num_segments = num_segments_;
+  CuVector<double> double_data(4 * num_states + 4 * num_segments);
+  CuSubVector<double>(double_data, 0, 2 * num_states).Set(
+      -std::numeric_limits<double>::infinity());
+  double *double_ptr = double_data.Data();
+
+  DenLatticeArrays lat;
+  lat.out_begin = int_ptr + int_offsets[0];
+  lat.in_begin = int_ptr + int_offsets[1];
+  lat.in_arcs = int_ptr + int_offsets[2];
+  lat.arc_src = int_ptr + int_offsets[3];
+  lat.arc_dst = int_ptr + int_offsets[4];
+  lat.arc_row = int_ptr + int_offsets[5];
+  lat.arc_pdf = int_ptr + int_offsets[6];
+  lat.state_segment = int_ptr + int_offsets[7];
+  lat.is_cut = int_ptr + int_offsets[8];
+  const int32 *fwd_states = int_ptr + int_offsets[9],
+      *bwd_states = int_ptr + int_offsets[10],
+      *num_pdfs = int_ptr + int_offsets[11];
+  lat.arc_graph_like = float_ptr;
+  lat.arc_acc = (is_mmi_ ? NULL : float_ptr + num_arcs_);
+  lat.arc_like = float_ptr + (num_float_arrays - 1) * num_arcs_;
+  lat.alpha = double_ptr;
+  lat.beta = double_ptr + num_states;
+  lat.alpha_smbr = (is_mmi_ ? NULL : double_ptr + 2 * num_states);
+  lat.beta_smbr = (is_mmi_ ? NULL : double_ptr + 3 * num_states);
+  double *seg_ptr = double_ptr + 4 * num_states;
+  lat.seg_like_fwd = seg_ptr;
+  lat.seg_like_bwd = seg_ptr + num_segments;
+  lat.seg_acc_fwd = (is_mmi_ ? NULL : seg_ptr + 2 * num_segments);
+  lat.seg_acc_bwd = (is_mmi_ ? NULL : seg_ptr + 3 * num_segments);
+
+  const BaseFloat *priors = (log_priors.Dim() > 0 ? log_priors.Data() : NULL);
+  dim3 dimBlock(CU1DBLOCK);
+  dim3 dimGrid(n_blocks(num_arcs_, CU1DBLOCK));
+  cuda_den_lattice_arc_likes(dimGrid, dimBlock, num_arcs_, lat,
+                             nnet_output.Data(), nnet_output.Stride(), priors,
+                             opts_.acoustic_scale, kLogPosteriorFloor);
+  CU_SAFE_CALL(cudaGetLastError());
+
+  int32 num_levels = fwd_level_begin_.size() - 2;
+  for (int32 l = 1; l <= num_levels; l++) {
+    int32 begin = fwd_level_begin_[l], size = fwd_level_begin_[l + 1] - begin;
+    if (size == 0) continue;
+    dim3 dimGrid(n_blocks(size, CU1DBLOCK));
+    cuda_den_lattice_forward(dimGrid, dimBlock, size, fwd_states + begin, lat);
+    CU_SAFE_CALL(cudaGetLastError());
+  }
+  for (int32 l = 1; l <= num_levels; l++) {
+    int32 begin = bwd_level_begin_[l], size = bwd_level_begin_[l + 1] - begin;
+    if (size == 0) continue;
+    dim3 dimGrid(n_blocks(size, CU1DBLOCK));
+    cuda_den_lattice_backward(dimGrid, dimBlock, size, bwd_states + begin,
+                              lat);
+    CU_SAFE_CALL(cudaGetLastError());
+  }
+
+  int32 num_rows = nnet_output.NumRows();
+  CuArray<int32> num_pdf_present;
+  if (is_mmi_ && opts_.drop_frames)
+    num_pdf_present.Resize(num_rows, kSetZero);
+  int32 *present_ptr = (num_pdf_present.Dim() > 0 ?
+                        num_pdf_present.Data() : NULL);
+  cuda_den_lattice_arc_derivs(dimGrid, dimBlock, num_arcs_, lat, num_pdfs,
+                              present_ptr, nnet_output_deriv->Data(),
+                              nnet_output_deriv->Stride());
+  CU_SAFE_CALL(cudaGetLastError());
+
+  if (is_mmi_) {
+    CuVector<double> num_like(num_rows, kUndefined);
+    dim3 dimGrid(n_blocks(num_rows, CU1DBLOCK));
+    cuda_den_lattice_mmi_num(dimGrid, dimBlock, num_rows,
+                             nnet_output.NumCols(), num_pdfs, present_ptr,
+                             nnet_output.Data(), nnet_output.Stride(), priors,
+                             opts_.acoustic_scale, kLogPosteriorFloor,
+                             num_like.Data(), nnet_output_deriv->Data(),
+                             nnet_output_deriv->Stride());
+    CU_SAFE_CALL(cudaGetLastError());
+    *num_logprob = num_like.Sum();
+  }
+
+  Vector<double> seg_data(CuSubVector<double>(double_data, 4 * num_states,
+                                              4 * num_segments));
+  CuDevice::Instantiate().AccuProfile(__func__, tim);
+  const double *seg_host = seg_data.Data();
+  return TotalObjf(seg_host, seg_host + num_segments,
+                   seg_host + 2 * num_segments, seg_host + 3 * num_segments);
+}
+#endif
+
+
+}  // namespace discriminative
+}  // namespace kaldi
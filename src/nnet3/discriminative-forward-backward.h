@@ -0,0 +1,182 @@
+// nnet3/discriminative-forward-backward.h
+
+// Copyright      2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_NNET3_DISCRIMINATIVE_FORWARD_BACKWARD_H_
+#define KALDI_NNET3_DISCRIMINATIVE_FORWARD_BACKWARD_H_
+
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "lat/kaldi-lattice.h"
+#include "hmm/transition-model.h"
+#include "cudamatrix/cu-matrix-lib.h"
+#include "nnet3/discriminative-supervision.h"
+#include "nnet3/discriminative-training.h"
+
+namespace kaldi {
+namespace discriminative {
+
+
+/**
+   This class does the forward-backward over the denominator lattice of a
+   DiscriminativeSupervision object in a form that can run on the GPU.  It
+   computes the same thing as LatticeForwardBackwardMmi() (with cancellation
+   and conversion to pdf-ids) or LatticeForwardBackwardMpeVariants() followed
+   by the conversion to pdf-ids, but the acoustic log-likelihoods are read
+   from the nnet output, and the derivatives written to a matrix, on the
+   device, with no Posterior objects in between.  Without a GPU the same
+   algorithm runs on the CPU.
+
+   The lattice is converted in the constructor to arrays of arcs, indexed
+   from their source and from their destination states (a CSR layout).  The
+   "level" of a state is the number of arcs on the longest path to it from
+   the start state; all the states of a level can be computed at once, the
+   levels in increasing order for the forward pass and in decreasing order
+   for the backward pass.  The lattice of a minibatch is the concatenation of
+   the lattices of its sequences, whose paths differ in the number of
+   epsilon arcs, so we also split it at "cut" states that every path goes
+   through (e.g. the initial state of each sequence): the cut states are the
+   only state of their level, with no arc going past it.  The forward-backward
+   of each segment between two cuts is normalized separately (the alpha of
+   the cut starting it and the beta of the cut ending it are taken to be
+   zero), and the levels are counted from the start of each segment, so the
+   segments, i.e. the sequences, are computed in parallel.  The total
+   log-likelihood, and for MPFE and sMBR the expected accuracy, of the
+   lattice is the sum over the segments.  Final-probs are represented as
+   arcs to an extra "super-final" state, which is the last cut.
+ */
+class DenominatorForwardBackward {
+ public:
+  /// 'den_lat' must be topologically sorted, and have the (possibly boosted)
+  /// graph costs of the supervision's denominator lattice; the acoustic costs
+  /// of its arcs with transition-ids and of its final-probs are ignored.
+  DenominatorForwardBackward(const DiscriminativeOptions &opts,
+                             const TransitionModel &tmodel,
+                             const std::vector<int32> &silence_phones,
+                             const DiscriminativeSupervision &supervision,
+                             const Lattice &den_lat);
+
+  /// Does the forward-backward with the acoustic log-likelihoods computed
+  /// from 'nnet_output' and 'log_priors' (which may be empty) as
+  /// DiscriminativeComputation does, and adds the derivative of the objective
+  /// function w.r.t. 'nnet_output', not scaled by the supervision weight, to
+  /// 'nnet_output_deriv'.  The rows of both are in the order described in
+  /// DiscriminativeComputation.  For MMI, the derivative is the numerator
+  /// minus the denominator posterior of the pdfs, and the return value is the
+  /// denominator log-likelihood; the numerator log-likelihood is output to
+  /// 'num_logprob'.  For MPFE and sMBR the return value is the expected frame
+  /// accuracy and 'num_logprob' is set to zero.
+  double Compute(const CuVectorBase<BaseFloat> &log_priors,
+                 const CuMatrixBase<BaseFloat> &nnet_output,
+                 double *num_logprob,
+                 CuMatrixBase<BaseFloat> *nnet_output_deriv);
+
+ private:
+  // Converts den_lat to the arrays below, and works out the levels and the
+  // segments.
+  void Init(const Lattice &den_lat);
+
+  // Returns the frame accuracy of transition-id 'tid' versus the reference
+  // transition-id 'ref_tid', as in LatticeForwardBackwardMpeVariants().
+  BaseFloat FrameAccuracy(int32 tid, int32 ref_tid) const;
+
+  // The CPU versions of the kernels in discriminative-kernels.cu.
+  void ForwardState(int32 d);
+  void BackwardState(int32 s);
+  double ComputeCpu(const CuVectorBase<BaseFloat> &log_priors,
+                    const CuMatrixBase<BaseFloat> &nnet_output,
+                    double *num_logprob,
+                    CuMatrixBase<BaseFloat> *nnet_output_deriv);
+#if HAVE_CUDA == 1
+  double ComputeGpu(const CuVectorBase<BaseFloat> &log_priors,
+                    const CuMatrixBase<BaseFloat> &nnet_output,
+                    double *num_logprob,
+                    CuMatrixBase<BaseFloat> *nnet_output_deriv);
+#endif
+
+  // Works out the total objective function from the per-segment quantities
+  // (checking that the forward and backward passes agree).
+  double TotalObjf(const double *seg_like_fwd, const double *seg_like_bwd,
+                   const double *seg_acc_fwd, const double *seg_acc_bwd) const;
+
+  const DiscriminativeOptions &opts_;
+  const TransitionModel &tmodel_;
+  const std::vector<int32> &silence_phones_;
+  const DiscriminativeSupervision &supervision_;
+  bool is_mmi_;
+
+  // The number of states, including the super-final state (which is the
+  // last one), and of arcs, including those to the super-final state.
+  int32 num_states_;
+  int32 num_arcs_;
+  // The number of segments, i.e. the number of cuts minus one.
+  int32 num_segments_;
+
+  // The arcs leaving state s are out_begin_[s] <= a < out_begin_[s+1].
+  std::vector<int32> out_begin_;
+  // The arcs entering state s are in_arcs_[i] for in_begin_[s] <= i <
+  // in_begin_[s+1].
+  std::vector<int32> in_begin_;
+  std::vector<int32> in_arcs_;
+  // The source and destination states of the arcs.
+  std::vector<int32> arc_src_;
+  std::vector<int32> arc_dst_;
+  // The row of the nnet output and the pdf-id of the arcs; both -1 for
+  // epsilon arcs and arcs to the super-final state.
+  std::vector<int32> arc_row_;
+  std::vector<int32> arc_pdf_;
+  // The graph part of the log-likelihood of the arcs (for epsilon arcs, which
+  // have no acoustic part looked up, the whole log-likelihood).
+  std::vector<BaseFloat> arc_graph_like_;
+  // For MPFE and sMBR, the frame accuracy of the arcs.
+  std::vector<BaseFloat> arc_acc_;
+
+  // The segment that state s is in; for a cut, the segment that it starts
+  // (so the super-final state's is num_segments_).
+  std::vector<int32> state_segment_;
+  // 1 for the cut states, 0 for the others.
+  std::vector<int32> is_cut_;
+
+  // The states to compute at level l of the forward pass are
+  // fwd_states_[i] for fwd_level_begin_[l] <= i < fwd_level_begin_[l+1], and
+  // likewise for the backward pass.  Level 0 is empty in both.
+  std::vector<int32> fwd_states_;
+  std::vector<int32> fwd_level_begin_;
+  std::vector<int32> bwd_states_;
+  std::vector<int32> bwd_level_begin_;
+
+  // For MMI, the pdf-id of the numerator alignment for each row of the nnet
+  // output.
+  std::vector<int32> num_pdfs_;
+
+  // Used by the CPU version: the arc log-likelihoods, and the forward and
+  // backward quantities of the states and the segments.
+  std::vector<BaseFloat> arc_like_;
+  std::vector<double> alpha_, beta_, alpha_smbr_, beta_smbr_;
+  std::vector<double> seg_like_fwd_, seg_like_bwd_, seg_acc_fwd_, seg_acc_bwd_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(DenominatorForwardBackward);
+};
+
+
+}  // namespace discriminative
+}  // namespace kaldi
+
+#endif  // KALDI_NNET3_DISCRIMINATIVE_FORWARD_BACKWARD_H_
@@ -0,0 +1,117 @@
+// nnet3/discriminative-kernels-ansi.h
+
+// Copyright      2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_NNET3_DISCRIMINATIVE_KERNELS_ANSI_H_
+#define KALDI_NNET3_DISCRIMINATIVE_KERNELS_ANSI_H_
+#include "cudamatrix/cu-kernels-ansi.h"  // for BaseFloat and cuda_current_stream()
+
+#if HAVE_CUDA == 1
+extern "C" {
+
+  // The denominator lattice as it is laid out on the device by class
+  // DenominatorForwardBackward (see discriminative-forward-backward.h for
+  // the meaning of the arrays).  The arcs are numbered in order of their
+  // source state, so the arcs leaving state s are out_begin[s] <= a <
+  // out_begin[s+1]; the arcs entering it are in_arcs[i] for in_begin[s] <= i
+  // < in_begin[s+1].  arc_acc, alpha_smbr, beta_smbr, seg_acc_fwd and
+  // seg_acc_bwd are NULL for MMI.
+  struct DenLatticeArrays {
+    const int32_cuda *out_begin;
+    const int32_cuda *in_begin;
+    const int32_cuda *in_arcs;
+    const int32_cuda *arc_src;
+    const int32_cuda *arc_dst;
+    const int32_cuda *arc_row;
+    const int32_cuda *arc_pdf;
+    const int32_cuda *state_segment;
+    const int32_cuda *is_cut;
+    const BaseFloat *arc_graph_like;
+    const BaseFloat *arc_acc;
+    BaseFloat *arc_like;
+    double *alpha;
+    double *beta;
+    double *alpha_smbr;
+    double *beta_smbr;
+    double *seg_like_fwd;
+    double *seg_like_bwd;
+    double *seg_acc_fwd;
+    double *seg_acc_bwd;
+  };
+
+  // Sets lat.arc_like to the graph log-likelihood plus, for arcs with a pdf,
+  // the scaled acoustic pseudo-log-likelihood acoustic_scale *
+  // (max(log_floor, nnet_output(row, pdf)) - log_priors(pdf)); log_priors
+  // may be NULL.  One thread per arc.
+  void cuda_den_lattice_arc_likes(dim3 Gr, dim3 Bl, int32_cuda num_arcs,
+                                  DenLatticeArrays lat,
+                                  const BaseFloat *nnet_output,
+                                  int32_cuda nnet_output_stride,
+                                  const BaseFloat *log_priors,
+                                  BaseFloat acoustic_scale,
+                                  BaseFloat log_floor);
+
+  // Computes alpha (and alpha_smbr) for the 'num_states' states in 'states',
+  // which are all at the same level, from their predecessors.  One thread per
+  // state.
+  void cuda_den_lattice_forward(dim3 Gr, dim3 Bl, int32_cuda num_states,
+                                const int32_cuda *states,
+                                DenLatticeArrays lat);
+
+  // Computes beta (and beta_smbr) for the 'num_states' states in 'states',
+  // from their successors.  One thread per state.
+  void cuda_den_lattice_backward(dim3 Gr, dim3 Bl, int32_cuda num_states,
+                                 const int32_cuda *states,
+                                 DenLatticeArrays lat);
+
+  // Adds the derivative of the objective w.r.t. the nnet output that comes
+  // from each arc to 'deriv' (for MMI, minus the arc posterior; for MPFE and
+  // sMBR, the posterior times the difference in expected accuracy).  For MMI,
+  // if num_pdf_present is not NULL, also sets num_pdf_present[row] to 1 if
+  // there is an arc with nonzero posterior on that row whose pdf is
+  // num_pdfs[row].  One thread per arc.
+  void cuda_den_lattice_arc_derivs(dim3 Gr, dim3 Bl, int32_cuda num_arcs,
+                                   DenLatticeArrays lat,
+                                   const int32_cuda *num_pdfs,
+                                   int32_cuda *num_pdf_present,
+                                   BaseFloat *deriv, int32_cuda deriv_stride);
+
+  // The MMI numerator: sets num_like[row] to the scaled log-likelihood of
+  // num_pdfs[row] (computed as in cuda_den_lattice_arc_likes()) and adds 1 to
+  // deriv(row, num_pdfs[row]); then, if num_pdf_present is not NULL and
+  // num_pdf_present[row] is 0, zeroes that row of 'deriv' (this is the
+  // --drop-frames option).  One thread per row.
+  void cuda_den_lattice_mmi_num(dim3 Gr, dim3 Bl, int32_cuda num_rows,
+                                int32_cuda num_cols,
+                                const int32_cuda *num_pdfs,
+                                const int32_cuda *num_pdf_present,
+                                const BaseFloat *nnet_output,
+                                int32_cuda nnet_output_stride,
+                                const BaseFloat *log_priors,
+                                BaseFloat acoustic_scale,
+                                BaseFloat log_floor,
+                                double *num_like,
+                                BaseFloat *deriv, int32_cuda deriv_stride);
+
+} // extern "C"
+
+#endif  // HAVE_CUDA
+
+
+#endif  // KALDI_NNET3_DISCRIMINATIVE_KERNELS_ANSI_H_
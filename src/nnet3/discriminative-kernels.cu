@@ -0,0 +1,247 @@
+// nnet3/discriminative-kernels.cu
+
+// Copyright      2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <cfloat>
+#include <math_constants.h>
+#include "nnet3/discriminative-kernels-ansi.h"
+
+
+// These kernels do the same computation as the CPU code in
+// DenominatorForwardBackward (discriminative-forward-backward.cc); see there,
+// and the header, for the notation.  The forward and backward kernels are
+// called once per level, with one thread per state of that level; a state
+// sums over its arcs itself, so no atomic operations are needed there and
+// the result does not depend on the scheduling.  The alpha (or beta) of a
+// "cut" state, where the lattice is split into segments, is read as zero (and
+// its alpha_smbr or beta_smbr as zero) by the states of the segment that it
+// starts (or ends), since each segment is normalized separately.
+
+__device__ static inline BaseFloat _acoustic_like(
+    const BaseFloat *nnet_output, int nnet_output_stride,
+    const BaseFloat *log_priors, BaseFloat acoustic_scale,
+    BaseFloat log_floor, int row, int pdf) {
+  BaseFloat log_post = fmax(nnet_output[row * nnet_output_stride + pdf],
+                            log_floor);
+  if (log_priors != NULL)
+    log_post -= log_priors[pdf];
+  return log_post * acoustic_scale;
+}
+
+__global__
+static void _den_lattice_arc_likes(int num_arcs, DenLatticeArrays lat,
+                                   const BaseFloat *nnet_output,
+                                   int nnet_output_stride,
+                                   const BaseFloat *log_priors,
+                                   BaseFloat acoustic_scale,
+                                   BaseFloat log_floor) {
+  int a = blockIdx.x * blockDim.x + threadIdx.x;
+  if (a >= num_arcs)
+    return;
+  BaseFloat like = lat.arc_graph_like[a];
+  int pdf = lat.arc_pdf[a];
+  if (pdf >= 0)
+    like += _acoustic_like(nnet_output, nnet_output_stride, log_priors,
+                           acoustic_scale, log_floor, lat.arc_row[a], pdf);
+  lat.arc_like[a] = like;
+}
+
+__global__
+static void _den_lattice_forward(int num_states, const int *states,
+                                 DenLatticeArrays lat) {
+  int i = blockIdx.x * blockDim.x + threadIdx.x;
+  if (i >= num_states)
+    return;
+  int d = states[i], begin = lat.in_begin[d], end = lat.in_begin[d + 1];
+  double max_like = -CUDART_INF;
+  for (int j = begin; j < end; j++) {
+    int a = lat.in_arcs[j], s = lat.arc_src[a];
+    double like = (lat.is_cut[s] ? 0.0 : lat.alpha[s]) + lat.arc_like[a];
+    max_like = fmax(max_like, like);
+  }
+  double sum = 0.0, smbr_sum = 0.0;
+  if (max_like != -CUDART_INF) {
+    for (int j = begin; j < end; j++) {
+      int a = lat.in_arcs[j], s = lat.arc_src[a];
+      bool cut = lat.is_cut[s];
+      double scale = exp((cut ? 0.0 : lat.alpha[s]) + lat.arc_like[a] -
+                         max_like);
+      sum += scale;
+      if (lat.alpha_smbr != NULL)
+        smbr_sum += scale * ((cut ? 0.0 : lat.alpha_smbr[s]) + lat.arc_acc[a]);
+    }
+  }
+  double alpha = (sum > 0.0 ? max_like + log(sum) : -CUDART_INF),
+      alpha_smbr = (sum > 0.0 ? smbr_sum / sum : 0.0);
+  lat.alpha[d] = alpha;
+  if (lat.alpha_smbr != NULL)
+    lat.alpha_smbr[d] = alpha_smbr;
+  if (lat.is_cut[d]) {
+    // d ends the segment before the one it starts.
+    int seg = lat.state_segment[d] - 1;
+    lat.seg_like_fwd[seg] = alpha;
+    if (lat.seg_acc_fwd != NULL)
+      lat.seg_acc_fwd[seg] = alpha_smbr;
+  }
+}
+
+__global__
+static void _den_lattice_backward(int num_states, const int *states,
+                                  DenLatticeArrays lat) {
+  int i = blockIdx.x * blockDim.x + threadIdx.x;
+  if (i >= num_states)
+    return;
+  int s = states[i], begin = lat.out_begin[s], end = lat.out_begin[s + 1];
+  double max_like = -CUDART_INF;
+  for (int a = begin; a < end; a++) {
+    int d = lat.arc_dst[a];
+    double like = (lat.is_cut[d] ? 0.0 : lat.beta[d]) + lat.arc_like[a];
+    max_like = fmax(max_like, like);
+  }
+  double sum = 0.0, smbr_sum = 0.0;
+  if (max_like != -CUDART_INF) {
+    for (int a = begin; a < end; a++) {
+      int d = lat.arc_dst[a];
+      bool cut = lat.is_cut[d];
+      double scale = exp((cut ? 0.0 : lat.beta[d]) + lat.arc_like[a] -
+                         max_like);
+      sum += scale;
+      if (lat.beta_smbr != NULL)
+        smbr_sum += scale * ((cut ? 0.0 : lat.beta_smbr[d]) + lat.arc_acc[a]);
+    }
+  }
+  double beta = (sum > 0.0 ? max_like + log(sum) : -CUDART_INF),
+      beta_smbr = (sum > 0.0 ? smbr_sum / sum : 0.0);
+  lat.beta[s] = beta;
+  if (lat.beta_smbr != NULL)
+    lat.beta_smbr[s] = beta_smbr;
+  if (lat.is_cut[s]) {
+    int seg = lat.state_segment[s];
+    lat.seg_like_bwd[seg] = beta;
+    if (lat.seg_acc_bwd != NULL)
+      lat.seg_acc_bwd[seg] = beta_smbr;
+  }
+}
+
+__global__
+static void _den_lattice_arc_derivs(int num_arcs, DenLatticeArrays lat,
+                                    const int *num_pdfs,
+                                    int *num_pdf_present,
+                                    BaseFloat *deriv, int deriv_stride) {
+  int a = blockIdx.x * blockDim.x + threadIdx.x;
+  if (a >= num_arcs)
+    return;
+  int pdf = lat.arc_pdf[a];
+  if (pdf < 0)
+    return;
+  int s = lat.arc_src[a], d = lat.arc_dst[a], row = lat.arc_row[a],
+      seg = lat.state_segment[s];
+  bool s_cut = lat.is_cut[s], d_cut = lat.is_cut[d];
+  double post = exp((s_cut ? 0.0 : lat.alpha[s]) + lat.arc_like[a] +
+                    (d_cut ? 0.0 : lat.beta[d]) - lat.seg_like_fwd[seg]);
+  BaseFloat value;
+  if (lat.alpha_smbr == NULL) {
+    value = -post;
+    if (num_pdf_present != NULL && num_pdfs[row] == pdf && post > 0.0)
+      num_pdf_present[row] = 1;
+  } else {
+    value = post * ((s_cut ? 0.0 : lat.alpha_smbr[s]) + lat.arc_acc[a] +
+                    (d_cut ? 0.0 : lat.beta_smbr[d]) - lat.seg_acc_fwd[seg]);
+  }
+  atomicAdd(deriv + row * deriv_stride + pdf, value);
+}
+
+__global__
+static void _den_lattice_mmi_num(int num_rows, int num_cols,
+                                 const int *num_pdfs,
+                                 const int *num_pdf_present,
+                                 const BaseFloat *nnet_output,
+                                 int nnet_output_stride,
+                                 const BaseFloat *log_priors,
+                                 BaseFloat acoustic_scale,
+                                 BaseFloat log_floor,
+                                 double *num_like,
+                                 BaseFloat *deriv, int deriv_stride) {
+  int row = blockIdx.x * blockDim.x + threadIdx.x;
+  if (row >= num_rows)
+    return;
+  int pdf = num_pdfs[row];
+  num_like[row] = _acoustic_like(nnet_output, nnet_output_stride, log_priors,
+                                 acoustic_scale, log_floor, row, pdf);
+  BaseFloat *deriv_row = deriv + row * deriv_stride;
+  if (num_pdf_present != NULL && !num_pdf_present[row]) {
+    for (int j = 0; j < num_cols; j++)
+      deriv_row[j] = 0.0;
+  } else {
+    deriv_row[pdf] += 1.0;
+  }
+}
+
+
+void cuda_den_lattice_arc_likes(dim3 Gr, dim3 Bl, int32_cuda num_arcs,
+                                DenLatticeArrays lat,
+                                const BaseFloat *nnet_output,
+                                int32_cuda nnet_output_stride,
+                                const BaseFloat *log_priors,
+                                BaseFloat acoustic_scale,
+                                BaseFloat log_floor) {
+  _den_lattice_arc_likes<<<Gr, Bl, 0, cuda_current_stream()>>>(
+      num_arcs, lat, nnet_output, nnet_output_stride, log_priors,
+      acoustic_scale, log_floor);
+}
+
+void cuda_den_lattice_forward(dim3 Gr, dim3 Bl, int32_cuda num_states,
+                              const int32_cuda *states,
+                              DenLatticeArrays lat) {
+  _den_lattice_forward<<<Gr, Bl, 0, cuda_current_stream()>>>(
+      num_states, states, lat);
+}
+
+void cuda_den_lattice_backward(dim3 Gr, dim3 Bl, int32_cuda num_states,
+                               const int32_cuda *states,
+                               DenLatticeArrays lat) {
+  _den_lattice_backward<<<Gr, Bl, 0, cuda_current_stream()>>>(
+      num_states, states, lat);
+}
+
+void cuda_den_lattice_arc_derivs(dim3 Gr, dim3 Bl, int32_cuda num_arcs,
+                                 DenLatticeArrays lat,
+                                 const int32_cuda *num_pdfs,
+                                 int32_cuda *num_pdf_present,
+                                 BaseFloat *deriv, int32_cuda deriv_stride) {
+  _den_lattice_arc_derivs<<<Gr, Bl, 0, cuda_current_stream()>>>(
+      num_arcs, lat, num_pdfs, num_pdf_present, deriv, deriv_stride);
+}
+
+void cuda_den_lattice_mmi_num(dim3 Gr, dim3 Bl, int32_cuda num_rows,
+                              int32_cuda num_cols,
+                              const int32_cuda *num_pdfs,
+                              const int32_cuda *num_pdf_present,
+                              const BaseFloat *nnet_output,
+                              int32_cuda nnet_output_stride,
+                              const BaseFloat *log_priors,
+                              BaseFloat acoustic_scale,
+                              BaseFloat log_floor,
+                              double *num_like,
+                              BaseFloat *deriv, int32_cuda deriv_stride) {
+  _den_lattice_mmi_num<<<Gr, Bl, 0, cuda_current_stream()>>>(
+      num_rows, num_cols, num_pdfs, num_pdf_present, nnet_output,
+      nnet_output_stride, log_priors, acoustic_scale, log_floor, num_like,
+      deriv, deriv_stride);
+}
@@ -19,6 +19,7 @@
 // limitations under the License.
 
 #include "nnet3/discriminative-training.h"
+#include "nnet3/discriminative-forward-backward.h"
 #include "lat/lattice-functions.h"
 #include "cudamatrix/cu-matrix.h"
 
@@ -144,6 +145,18 @@ class DiscriminativeComputation {
   // The function that actually computes the objective and gradients
   double ComputeObjfAndDeriv(Posterior *post, Posterior *xent_post);
 
+  // Used instead of the lookups, the lattice rescoring, ComputeObjfAndDeriv()
+  // and ProcessPosteriors() when we are using a GPU: does the
+  // forward-backward on the device with class DenominatorForwardBackward and
+  // adds the derivative times supervision_.weight to 'output_deriv', which
+  // must be zero on entry.  For "mmi", outputs the numerator log-likelihood
+  // to 'tot_num_like'.  Returns the objective function (as
+  // ComputeObjfAndDeriv()).
+  double ComputeObjfAndDerivOnDevice(CuMatrixBase<BaseFloat> *output_deriv,
+                                     double *tot_num_like,
+                                     double *tot_num_post,
+                                     double *tot_den_post);
+
   // This function looks up the nnet output the pdf-ids in the
   // denominator lattice and the alignment in the case of "mmi" objective
   // using the CuMatrix::Lookup() and stores them in "answers"
@@ -362,26 +375,6 @@ void DiscriminativeComputation::Compute() {
   int32 num_pdfs = nnet_output_.NumCols();
   KALDI_ASSERT(log_priors_.Dim() == 0 || num_pdfs == log_priors_.Dim());
 
-  // We need to look up the nnet output for some pdf-ids.
-  // Rather than looking them all up using operator (), which is
-  // very slow because each lookup involves a separate CUDA call with
-  // communication over PciExpress, we look them up all at once using
-  // CuMatrix::Lookup().
-  std::vector<BaseFloat> answers;
-  std::vector<Int32Pair> requested_indexes;
-
-  LookupNnetOutput(&requested_indexes, &answers);
-
-  ConvertAnswersToLogLike(requested_indexes, &answers);
-
-  size_t index = 0;
-
-  // Now put the negative (scaled) acoustic log-likelihoods in the lattice.
-  index = LatticeAcousticRescore(answers, index, &den_lat_);
-  // index is now the number of indexes of log-likes used to rescore lattice.
-  // This is required to further lookup answers for computing "mmi"
-  // numerator score.
-
   // Get statistics for this minibatch
   DiscriminativeObjectiveInfo this_stats;
   if (stats_) {
@@ -389,19 +382,6 @@ void DiscriminativeComputation::Compute() {
     this_stats.Reset();
   }
 
-  // Look up numerator probabilities corresponding to alignment
-  if (opts_.criterion == "mmi") {
-    double tot_num_like = 0.0;
-    KALDI_ASSERT(index + supervision_.num_ali.size() == answers.size());
-    for (size_t this_index = 0; this_index < supervision_.num_ali.size(); this_index++) {
-      tot_num_like += answers[index + this_index];
-    }
-    this_stats.tot_num_objf += supervision_.weight * tot_num_like;
-    index += supervision_.num_ali.size();
-  }
-
-  KALDI_ASSERT(index == answers.size());
-
   if (nnet_output_deriv_) {
     nnet_output_deriv_->SetZero();
     KALDI_ASSERT(nnet_output_deriv_->NumRows() == nnet_output_.NumRows() &&
@@ -414,15 +394,6 @@ void DiscriminativeComputation::Compute() {
         xent_output_deriv_->NumCols() == nnet_output_.NumCols());
   }
 
-  Posterior post;
-  Posterior xent_post;
-  double objf = ComputeObjfAndDeriv(&post,
-                (xent_output_deriv_ ? &xent_post : NULL));
-
-  this_stats.tot_objf += supervision_.weight * objf;
-
-  KALDI_ASSERT(nnet_output_.NumRows() == post.size());
-
   CuMatrix<BaseFloat> output_deriv;
 
   CuMatrixBase<BaseFloat> *output_deriv_temp;
@@ -435,12 +406,68 @@ void DiscriminativeComputation::Compute() {
     output_deriv_temp = &output_deriv;
   }
 
-  double tot_num_post = 0.0, tot_den_post = 0.0;
-  {
+  double objf, tot_num_post = 0.0, tot_den_post = 0.0;
+  Posterior xent_post;
+  bool use_gpu = false;
+#if HAVE_CUDA == 1
+  use_gpu = CuDevice::Instantiate().Enabled();
+#endif
+  if (use_gpu) {
+    double tot_num_like = 0.0;
+    objf = ComputeObjfAndDerivOnDevice(output_deriv_temp, &tot_num_like,
+                                       &tot_num_post, &tot_den_post);
+    this_stats.tot_num_objf += supervision_.weight * tot_num_like;
+    if (xent_output_deriv_) {
+      Posterior tid_post;
+      AlignmentToPosterior(supervision_.num_ali, &tid_post);
+      ConvertPosteriorToPdfs(tmodel_, tid_post, &xent_post);
+    }
+  } else {
+    // We need to look up the nnet output for some pdf-ids.
+    // Rather than looking them all up using operator (), which is
+    // very slow because each lookup involves a separate CUDA call with
+    // communication over PciExpress, we look them up all at once using
+    // CuMatrix::Lookup().
+    std::vector<BaseFloat> answers;
+    std::vector<Int32Pair> requested_indexes;
+
+    LookupNnetOutput(&requested_indexes, &answers);
+
+    ConvertAnswersToLogLike(requested_indexes, &answers);
+
+    size_t index = 0;
+
+    // Now put the negative (scaled) acoustic log-likelihoods in the lattice.
+    index = LatticeAcousticRescore(answers, index, &den_lat_);
+    // index is now the number of indexes of log-likes used to rescore lattice.
+    // This is required to further lookup answers for computing "mmi"
+    // numerator score.
+
+    // Look up numerator probabilities corresponding to alignment
+    if (opts_.criterion == "mmi") {
+      double tot_num_like = 0.0;
+      KALDI_ASSERT(index + supervision_.num_ali.size() == answers.size());
+      for (size_t this_index = 0; this_index < supervision_.num_ali.size(); this_index++) {
+        tot_num_like += answers[index + this_index];
+      }
+      this_stats.tot_num_objf += supervision_.weight * tot_num_like;
+      index += supervision_.num_ali.size();
+    }
+
+    KALDI_ASSERT(index == answers.size());
+
+    Posterior post;
+    objf = ComputeObjfAndDeriv(&post,
+                               (xent_output_deriv_ ? &xent_post : NULL));
+
+    KALDI_ASSERT(nnet_output_.NumRows() == post.size());
+
     ProcessPosteriors(post, output_deriv_temp,
-                             &tot_num_post, &tot_den_post);
+                      &tot_num_post, &tot_den_post);
   }
 
+  this_stats.tot_objf += supervision_.weight * objf;
+
   if (xent_output_deriv_) {
     ProcessPosteriors(xent_post, xent_output_deriv_, NULL, NULL);
   }
@@ -542,6 +569,25 @@ double DiscriminativeComputation::ComputeObjfAndDeriv(Posterior *post,
   return 0;
 }
 
+double DiscriminativeComputation::ComputeObjfAndDerivOnDevice(
+    CuMatrixBase<BaseFloat> *output_deriv,
+    double *tot_num_like,
+    double *tot_num_post,
+    double *tot_den_post) {
+  DenominatorForwardBackward forward_backward(opts_, tmodel_, silence_phones_,
+                                              supervision_, den_lat_);
+  double objf = forward_backward.Compute(log_priors_, nnet_output_,
+                                         tot_num_like, output_deriv);
+  // The counts are those of the posteriors after merging the ones with the
+  // same pdf-id, as in ProcessPosteriors(), i.e. of the positive and
+  // negative elements of the derivative.
+  CuMatrix<BaseFloat> positive_part(*output_deriv);
+  positive_part.ApplyFloor(0.0);
+  *tot_num_post = positive_part.Sum();
+  *tot_den_post = *tot_num_post - output_deriv->Sum();
+  output_deriv->Scale(supervision_.weight);
+  return objf;
+}
 
 void ComputeDiscriminativeObjfAndDeriv(const DiscriminativeOptions &opts,
                                        const TransitionModel &tmodel,
@@ -319,6 +319,84 @@ void UnitTestPreconditionDirectionsOnline() {
 }
 
 
+void UnitTestAssignmentOperator() {
+  // Checks that operator = copies all the configuration and state, by
+  // comparing the outputs of the original and the copy.
+  MatrixIndexT R = RandInt(1, 10), N = 2 * R + RandInt(10, 30),
+      D = R + RandInt(5, 20);
+
+  OnlineNaturalGradient preconditioner1;
+  preconditioner1.SetRank(R);
+  preconditioner1.SetNumMinibatchesHistory(RandInt(2, 10));
+  for (int32 iter = 0; iter < 20; iter++) {
+    CuMatrix<BaseFloat> M(N, D);
+    M.SetRandn();
+    BaseFloat gamma;
+    preconditioner1.PreconditionDirections(&M, &gamma);
+  }
+  if (RandInt(0, 1) == 0)
+    preconditioner1.Freeze(true);
+
+  OnlineNaturalGradient preconditioner2;
+  preconditioner2 = preconditioner1;
+  KALDI_ASSERT(preconditioner2.GetNumMinibatchesHistory() ==
+               preconditioner1.GetNumMinibatchesHistory());
+
+  for (int32 iter = 0; iter < 20; iter++) {
+    CuMatrix<BaseFloat> M(N, D);
+    M.SetRandn();
+    CuMatrix<BaseFloat> Mcopy1(M), Mcopy2(M);
+    BaseFloat gamma1, gamma2;
+    preconditioner1.PreconditionDirections(&Mcopy1, &gamma1);
+    preconditioner2.PreconditionDirections(&Mcopy2, &gamma2);
+    AssertEqual(Mcopy1, Mcopy2);
+    AssertEqual(gamma1, gamma2);
+  }
+}
+
+
+void UnitTestAdaptiveUpdatePeriod() {
+  // With data from a fixed distribution, the preconditioner with an adaptive
+  // update period should give nearly the same result as one that updates
+  // every time.
+  MatrixIndexT R = RandInt(1, 10), N = 2 * R + RandInt(10, 30),
+      D = R + RandInt(5, 20);
+  Vector<BaseFloat> big_eig_vector(D);
+  big_eig_vector.SetRandn();
+  big_eig_vector.Scale(5.0);
+
+  OnlineNaturalGradient preconditioner1, preconditioner2;
+  preconditioner1.SetRank(R);
+  preconditioner2.SetRank(R);
+  preconditioner2.SetMaxUpdatePeriod(8);
+  KALDI_ASSERT(preconditioner2.GetMaxUpdatePeriod() == 8);
+
+  int32 num_iters = 200;
+  for (int32 iter = 0; iter < num_iters; iter++) {
+    Matrix<BaseFloat> M_cpu(N, D);
+    M_cpu.SetRandn();
+    Vector<BaseFloat> rand_vec(N);
+    rand_vec.SetRandn();
+    M_cpu.AddVecVec(1.0, rand_vec, big_eig_vector);
+    CuMatrix<BaseFloat> M(M_cpu), Mcopy1(M), Mcopy2(M);
+    BaseFloat gamma1, gamma2;
+    preconditioner1.PreconditionDirections(&Mcopy1, &gamma1);
+    preconditioner2.PreconditionDirections(&Mcopy2, &gamma2);
+    CuVector<BaseFloat> inner_prods(N);
+    inner_prods.AddDiagMatMat(1.0, M, kNoTrans, Mcopy2, kTrans, 0.0);
+    KALDI_ASSERT(inner_prods.Min() >= 0.0);
+    if (iter == num_iters - 1) {
+      BaseFloat cosine = TraceMatMat(Mcopy1, Mcopy2, kTrans) /
+          std::sqrt(TraceMatMat(Mcopy1, Mcopy1, kTrans) *
+                    TraceMatMat(Mcopy2, Mcopy2, kTrans));
+      KALDI_LOG << "Cosine between fixed and adaptive update period is "
+                << cosine;
+      KALDI_ASSERT(cosine > 0.95);
+    }
+  }
+}
+
+
 } // namespace nnet3
 } // namespace kaldi
 
@@ -336,6 +414,8 @@ int main() {
 #endif
     for (int32 i = 0; i < 5; i++) {
       UnitTestPreconditionDirectionsOnline();
+      UnitTestAssignmentOperator();
+      UnitTestAdaptiveUpdatePeriod();
     }
   }
 }
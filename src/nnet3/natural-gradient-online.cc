@@ -25,7 +25,9 @@ namespace nnet3 {
 
 
 OnlineNaturalGradient::OnlineNaturalGradient():
-    rank_(40), update_period_(1), num_samples_history_(2000.0),
+    rank_(40), update_period_(1), max_update_period_(0),
+    cur_update_period_(1), avg_change_(-1.0), last_update_t_(0),
+    num_samples_history_(2000.0),
     num_minibatches_history_(0.0), alpha_(4.0),
     epsilon_(1.0e-10), delta_(5.0e-04), frozen_(false), t_(0),
     self_debug_(false), rho_t_(-1.0e+10) { }
@@ -168,6 +170,18 @@ void OnlineNaturalGradient::PreconditionDirections(
     return;
   }
 
+  BaseFloat initial_product;
+  initial_product = TraceMatMat(*X_t, *X_t, kTrans);
+  if (initial_product - initial_product != 0.0) {
+    // X_t contains infinities or NaN's, e.g. after an overflow in training
+    // with loss scaling (see class LossScaler in nnet-training.h).  The
+    // parameter change will be rejected anyway, so leave X_t as it is and
+    // don't let it affect the Fisher-matrix estimate.
+    if (scale)
+      *scale = 1.0;
+    return;
+  }
+
   if (t_ == 0) // not initialized
     Init(*X_t);
 
@@ -180,11 +194,10 @@ void OnlineNaturalGradient::PreconditionDirections(
 
   bool updating = Updating();
 
-  BaseFloat initial_product;
-  initial_product = TraceMatMat(*X_t, *X_t, kTrans);
-
   PreconditionDirectionsInternal(rho_t, initial_product,
                                  updating, d_t, &WJKL_t, X_t);
+  if (updating)
+    last_update_t_ = t_;
 
   if (scale) {
     if (initial_product <= 0.0) {
@@ -446,6 +459,17 @@ void OnlineNaturalGradient::PreconditionDirectionsInternal(
                        &L_t);
   }
 
+  if (max_update_period_ > update_period_) {
+    // The relative change in the eigenvalues of F_t, which are d_t + rho_t
+    // (R of them) and rho_t (D - R of them).
+    Vector<BaseFloat> diff(d_t1);
+    diff.Add(rho_t1 - rho_t);
+    diff.AddVec(-1.0, d_t);
+    BaseFloat change = (diff.Norm(1.0) + (D - R) * std::abs(rho_t1 - rho_t)) /
+        (D * rho_t + d_t.Sum());
+    AdaptUpdatePeriod(change);
+  }
+
   W_t_.Swap(&W_t1);
   d_t_.CopyFromVec(d_t1);
   rho_t_ = rho_t1;
@@ -459,9 +483,28 @@ bool OnlineNaturalGradient::Updating() const {
   // This must be > 'num_init_iters = 3' from Init().
   const int num_initial_updates = 10;
 
-  return (!frozen_ &&
-          (t_ <= num_initial_updates ||
-           (t_ - num_initial_updates) % update_period_ == 0));
+  if (frozen_)
+    return false;
+  if (t_ <= num_initial_updates)
+    return true;
+  if (max_update_period_ > update_period_)
+    return (t_ - last_update_t_ >= cur_update_period_);
+  return ((t_ - num_initial_updates) % update_period_ == 0);
+}
+
+void OnlineNaturalGradient::AdaptUpdatePeriod(BaseFloat change) {
+  // The running average has a time constant of 10 updates.
+  const BaseFloat avg_constant = 0.1;
+  if (avg_change_ < 0.0) {
+    avg_change_ = change;
+    cur_update_period_ = update_period_;
+    return;
+  }
+  if (change <= avg_change_)
+    cur_update_period_ = std::min(cur_update_period_ + 1, max_update_period_);
+  else if (change > 2.0 * avg_change_)
+    cur_update_period_ = update_period_;
+  avg_change_ += avg_constant * (change - avg_change_);
 }
 
 
@@ -575,6 +618,9 @@ void OnlineNaturalGradient::ComputeEt(const VectorBase<BaseFloat> &d_t,
 
 OnlineNaturalGradient::OnlineNaturalGradient(const OnlineNaturalGradient &other):
     rank_(other.rank_), update_period_(other.update_period_),
+    max_update_period_(other.max_update_period_),
+    cur_update_period_(other.cur_update_period_),
+    avg_change_(other.avg_change_), last_update_t_(other.last_update_t_),
     num_samples_history_(other.num_samples_history_),
     num_minibatches_history_(other.num_minibatches_history_),
     alpha_(other.alpha_), epsilon_(other.epsilon_), delta_(other.delta_),
@@ -587,10 +633,16 @@ OnlineNaturalGradient& OnlineNaturalGradient::operator = (
     const OnlineNaturalGradient &other) {
   rank_ = other.rank_;
   update_period_ = other.update_period_;
+  max_update_period_ = other.max_update_period_;
+  cur_update_period_ = other.cur_update_period_;
+  avg_change_ = other.avg_change_;
+  last_update_t_ = other.last_update_t_;
   num_samples_history_ = other.num_samples_history_;
+  num_minibatches_history_ = other.num_minibatches_history_;
   alpha_ = other.alpha_;
   epsilon_ = other.epsilon_;
   delta_ = other.delta_;
+  frozen_ = other.frozen_;
   t_ = other.t_;
   self_debug_ = other.self_debug_;
   W_t_ = other.W_t_;
@@ -606,6 +658,11 @@ void OnlineNaturalGradient::SetRank(int32 rank) {
 void OnlineNaturalGradient::SetUpdatePeriod(int32 update_period) {
   KALDI_ASSERT(update_period > 0);
   update_period_ = update_period;
+  cur_update_period_ = update_period;
+}
+void OnlineNaturalGradient::SetMaxUpdatePeriod(int32 max_update_period) {
+  KALDI_ASSERT(max_update_period >= 0);
+  max_update_period_ = max_update_period;
 }
 void OnlineNaturalGradient::SetNumSamplesHistory(BaseFloat num_samples_history) {
   KALDI_ASSERT(num_samples_history > 0.0 &&
@@ -626,6 +683,10 @@ void OnlineNaturalGradient::SetAlpha(BaseFloat alpha) {
 void OnlineNaturalGradient::Swap(OnlineNaturalGradient *other) {
   std::swap(rank_, other->rank_);
   std::swap(update_period_, other->update_period_);
+  std::swap(max_update_period_, other->max_update_period_);
+  std::swap(cur_update_period_, other->cur_update_period_);
+  std::swap(avg_change_, other->avg_change_);
+  std::swap(last_update_t_, other->last_update_t_);
   std::swap(num_samples_history_, other->num_samples_history_);
   std::swap(num_minibatches_history_, other->num_minibatches_history_);
   std::swap(alpha_, other->alpha_);
@@ -426,12 +426,18 @@ class OnlineNaturalGradient {
   void SetNumMinibatchesHistory(BaseFloat num_minibatches_history);
 
   void SetAlpha(BaseFloat alpha);
+  // If max_update_period is greater than the update period, the update period
+  // adapts between the two: it is lengthened while the estimate of the Fisher
+  // matrix is changing slowly, and reset when it changes fast.  See the
+  // comment where max_update_period_ is declared.
+  void SetMaxUpdatePeriod(int32 max_update_period);
   void TurnOnDebug() { self_debug_ = true; }
   BaseFloat GetNumSamplesHistory() const { return num_samples_history_; }
   BaseFloat GetNumMinibatchesHistory() const { return num_minibatches_history_; }
   BaseFloat GetAlpha() const { return alpha_; }
   int32 GetRank() const { return rank_; }
   int32 GetUpdatePeriod() const { return update_period_; }
+  int32 GetMaxUpdatePeriod() const { return max_update_period_; }
 
   // see comment where 'frozen_' is declared.
   inline void Freeze(bool frozen) { frozen_ = frozen; }
@@ -486,6 +492,11 @@ class OnlineNaturalGradient {
   // the parameters on this iteration (returns true if so).
   bool Updating() const;
 
+  // Called after each update of the parameters if max_update_period_ >
+  // update_period_; adjusts cur_update_period_ given the relative change
+  // 'change' in the eigenvalues of the Fisher matrix that the update made.
+  void AdaptUpdatePeriod(BaseFloat change);
+
   void ComputeEt(const VectorBase<BaseFloat> &d_t,
                  BaseFloat beta_t,
                  VectorBase<BaseFloat> *e_t,
@@ -557,6 +568,23 @@ class OnlineNaturalGradient {
   // this saves time.
   int32 update_period_;
 
+  // If max_update_period_ > update_period_, we update the parameters every
+  // cur_update_period_ minibatches, where update_period_ <= cur_update_period_
+  // <= max_update_period_.  After each update we compare the relative change
+  // in the eigenvalues of the Fisher matrix (i.e. in D_t and \rho_t) with its
+  // running average, avg_change_: if it's no more than the average we increase
+  // cur_update_period_ by one, and if it's more than twice the average (e.g.
+  // because the learning rate or the data changed) we reset it to
+  // update_period_.  This saves time in the later stages of training, where
+  // the Fisher matrix changes slowly.  max_update_period_ defaults to 0, which
+  // means the update period is fixed.  These variables are not written to
+  // disk.
+  int32 max_update_period_;
+  int32 cur_update_period_;
+  BaseFloat avg_change_;
+  // The value of t_ when we last updated the parameters.
+  int32 last_update_t_;
+
 
   // num_samples_history_ determines the value of eta, which in turn affects how
   // fast we update our estimate of the covariance matrix.  We've done it this
@@ -19,6 +19,9 @@
 
 #include "nnet3/nnet-am-decodable-simple.h"
 #include "nnet3/nnet-utils.h"
+#include "cudamatrix/cu-device.h"
+#include "decoder/decodable-matrix.h"
+#include "matrix/simd-math.h"
 
 namespace kaldi {
 namespace nnet3 {
@@ -81,6 +84,43 @@ BaseFloat DecodableAmNnetSimple::LogLikelihood(int32 frame,
   return decodable_nnet_.GetOutput(frame, pdf_id);
 }
 
+void DecodableAmNnetSimple::LogLikelihoods(int32 frame,
+                                           const int32 *transition_ids,
+                                           BaseFloat *log_likes,
+                                           int32 num_ids) {
+  GatherVec(BaseFloat(1.0), decodable_nnet_.GetOutputRow(frame),
+            &(trans_model_.TransitionIdToPdfArray()[0]), transition_ids,
+            num_ids, log_likes);
+}
+
+void DecodableAmNnetSimple::GetAllLogLikelihoods(
+    Matrix<BaseFloat> *log_likes) {
+  int32 num_frames = decodable_nnet_.NumFrames();
+  Matrix<BaseFloat> output(num_frames, decodable_nnet_.OutputDim(),
+                           kUndefined);
+  for (int32 t = 0; t < num_frames; t++) {
+    SubVector<BaseFloat> row(output, t);
+    decodable_nnet_.GetOutputForFrame(t, &row);
+  }
+  log_likes->Swap(&output);
+}
+
+DecodableInterface *WriteLogLikelihoods(const std::string &utt,
+                                        const TransitionModel &trans_model,
+                                        BaseFloat acoustic_scale,
+                                        DecodableAmNnetSimple *nnet_decodable,
+                                        CompressedMatrixWriter *writer) {
+  KALDI_ASSERT(acoustic_scale > 0.0);
+  Matrix<BaseFloat> *log_likes = new Matrix<BaseFloat>();
+  nnet_decodable->GetAllLogLikelihoods(log_likes);
+  Matrix<BaseFloat> unscaled_log_likes(*log_likes);
+  unscaled_log_likes.Scale(1.0 / acoustic_scale);
+  writer->Write(utt, CompressedMatrix(unscaled_log_likes, kTwoByteAuto));
+  // The acoustic scale is already included in 'log_likes'.  The decodable
+  // object takes ownership of 'log_likes'.
+  return new DecodableMatrixScaledMapped(trans_model, 1.0, log_likes);
+}
+
 int32 DecodableNnetSimple::GetIvectorDim() const {
   if (ivector_ != NULL)
     return ivector_->Dim();
@@ -261,7 +301,10 @@ void DecodableNnetSimple::DoNnetComputation(
     ivector_feats_cu.Row(0).CopyFromVec(ivector);
     computer.AcceptInput("ivector", &ivector_feats_cu);
   }
-  computer.Run();
+  {
+    CuTensorOpMathScope tensor_op_math(opts_.use_tensor_cores);
+    computer.Run();
+  }
   CuMatrix<BaseFloat> cu_output;
   computer.GetOutputDestructive("output", &cu_output);
   // subtract log-prior (divide by prior)
@@ -361,6 +404,15 @@ BaseFloat DecodableAmNnetSimpleParallel::LogLikelihood(int32 frame,
   return decodable_nnet_->GetOutput(frame, pdf_id);
 }
 
+void DecodableAmNnetSimpleParallel::LogLikelihoods(int32 frame,
+                                                   const int32 *transition_ids,
+                                                   BaseFloat *log_likes,
+                                                   int32 num_ids) {
+  GatherVec(BaseFloat(1.0), decodable_nnet_->GetOutputRow(frame),
+            &(trans_model_.TransitionIdToPdfArray()[0]), transition_ids,
+            num_ids, log_likes);
+}
+
 
 } // namespace nnet3
 } // namespace kaldi
@@ -25,6 +25,7 @@
 #include "gmm/am-diag-gmm.h"
 #include "hmm/transition-model.h"
 #include "itf/decodable-itf.h"
+#include "util/table-types.h"
 #include "nnet3/nnet-optimize.h"
 #include "nnet3/nnet-compute.h"
 #include "nnet3/am-nnet-simple.h"
@@ -49,6 +50,7 @@ struct NnetSimpleComputationOptions {
   int32 frames_per_chunk;
   BaseFloat acoustic_scale;
   bool debug_computation;
+  bool use_tensor_cores;
   NnetOptimizeOptions optimize_config;
   NnetComputeOptions compute_config;
   CachingOptimizingCompilerOptions compiler_config;
@@ -61,7 +63,8 @@ struct NnetSimpleComputationOptions {
       frame_subsampling_factor(1),
       frames_per_chunk(50),
       acoustic_scale(0.1),
-      debug_computation(false) {
+      debug_computation(false),
+      use_tensor_cores(false) {
     compiler_config.cache_capacity += frames_per_chunk;
   }
 
@@ -94,6 +97,18 @@ struct NnetSimpleComputationOptions {
                    "input frames");
     opts->Register("debug-computation", &debug_computation, "If true, turn on "
                    "debug for the actual computation (very verbose!)");
+    opts->Register("use-tensor-cores", &use_tensor_cores, "If true and we are "
+                   "using a GPU, the matrix multiplications of the neural net "
+                   "(e.g. in affine, linear, TDNN and convolution components) "
+                   "use the tensor cores, i.e. FP16 math with FP32 "
+                   "accumulation.  Faster but less precise; for inference "
+                   "only, and you should check the WER against the default.");
+
+    opts->Register("compilation-cache-dir", &compiler_config.cache_dir,
+                   "If set, a directory in which the compiled computations "
+                   "are cached, so that other jobs using the same model "
+                   "don't have to compile them again.  Can be shared by "
+                   "concurrent jobs.");
 
     // register the optimization options with the prefix "optimization".
     ParseOptions optimization_opts("optimization", opts);
@@ -178,6 +193,18 @@ class DecodableNnetSimple {
                              current_log_post_subsampled_offset_,
                              pdf_id);
   }
+
+  // Returns a pointer to the outputs for a particular frame (OutputDim() of
+  // them), with 0 <= subsampled_frame < NumFrames().  It is only valid until
+  // the next call to GetOutput(), GetOutputForFrame() or GetOutputRow().
+  inline const BaseFloat *GetOutputRow(int32 subsampled_frame) {
+    if (subsampled_frame < current_log_post_subsampled_offset_ ||
+        subsampled_frame >= current_log_post_subsampled_offset_ +
+                            current_log_post_.NumRows())
+      EnsureFrameIsComputed(subsampled_frame);
+    return current_log_post_.RowData(subsampled_frame -
+                                     current_log_post_subsampled_offset_);
+  }
  private:
   KALDI_DISALLOW_COPY_AND_ASSIGN(DecodableNnetSimple);
 
@@ -294,10 +321,21 @@ class DecodableAmNnetSimple: public DecodableInterface {
 
   virtual BaseFloat LogLikelihood(int32 frame, int32 transition_id);
 
+  virtual void LogLikelihoods(int32 frame, const int32 *transition_ids,
+                              BaseFloat *log_likes, int32 num_ids);
+
   virtual inline int32 NumFramesReady() const {
     return decodable_nnet_.NumFrames();
   }
 
+  /// Outputs the pdf-level log-likelihoods for all frames, including the
+  /// acoustic scale, as a matrix with NumFramesReady() rows and one column per
+  /// pdf, which is what DecodableMatrixScaledMapped takes.  Each chunk is only
+  /// computed once if you call this before decoding; so to keep the
+  /// log-likelihoods for a later pass, call this and then decode with a
+  /// DecodableMatrixScaledMapped (with scale 1.0) on its output.
+  void GetAllLogLikelihoods(Matrix<BaseFloat> *log_likes);
+
   virtual int32 NumIndices() const { return trans_model_.NumTransitionIds(); }
 
   virtual bool IsLastFrame(int32 frame) const {
@@ -314,6 +352,20 @@ class DecodableAmNnetSimple: public DecodableInterface {
   const TransitionModel &trans_model_;
 };
 
+/// Computes all the log-likelihoods of 'nnet_decodable' and writes them for
+/// utterance 'utt' to 'writer', compressed and with the acoustic scale
+/// 'acoustic_scale' divided out, which is what programs such as
+/// latgen-faster-mapped, align-compiled-mapped and lattice-rescore-mapped
+/// expect; later passes can then use them instead of running the network
+/// again.  Returns a DecodableMatrixScaledMapped that gives the same
+/// log-likelihoods as 'nnet_decodable' without recomputing them; the caller
+/// should decode with that and then delete it.
+DecodableInterface *WriteLogLikelihoods(const std::string &utt,
+                                        const TransitionModel &trans_model,
+                                        BaseFloat acoustic_scale,
+                                        DecodableAmNnetSimple *nnet_decodable,
+                                        CompressedMatrixWriter *writer);
+
 
 class DecodableAmNnetSimpleParallel: public DecodableInterface {
  public:
@@ -365,6 +417,9 @@ class DecodableAmNnetSimpleParallel: public DecodableInterface {
 
   virtual BaseFloat LogLikelihood(int32 frame, int32 transition_id);
 
+  virtual void LogLikelihoods(int32 frame, const int32 *transition_ids,
+                              BaseFloat *log_likes, int32 num_ids);
+
   virtual inline int32 NumFramesReady() const {
     return decodable_nnet_->NumFrames();
   }
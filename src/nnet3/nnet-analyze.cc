@@ -857,6 +857,20 @@ void ComputationChecker::CheckComputationIndexes() const {
           memo_to_command[c.arg5] = command_index;
         }
         KALDI_ASSERT(c.arg6 == 0 || c.arg6 == 1);
+        if (c.arg7 >= 0) {  // a fused component, see FusePropagateCommands().
+          if (c.arg7 >= nnet_.NumComponents())
+            KALDI_ERR << "Fused component index out of range";
+          const Component *fused_component = nnet_.GetComponent(c.arg7);
+          int32 fused_properties = fused_component->Properties();
+          if (!(fused_properties & kSimpleComponent) ||
+              !(fused_properties & kPropagateInPlace) ||
+              (fused_properties & (kUsesMemo | kPropagateAdds)))
+            KALDI_ERR << "Fused component " << nnet_.GetComponentName(c.arg7)
+                      << " does not have the required properties.";
+          if (fused_component->InputDim() != submatrices[c.arg4].num_cols ||
+              fused_component->OutputDim() != submatrices[c.arg4].num_cols)
+            KALDI_ERR << "Dimension mismatch for fused component";
+        }
         break;
       }
       case kBackprop:
@@ -1436,6 +1450,147 @@ void GetCommandsOfType(const NnetComputation &computation,
       command_indexes->push_back(c);
 }
 
+// Returns true if commands of type t are barriers for
+// ComputeCommandDependencies(): commands that do I/O, change the flow of
+// control or mark positions in the computation.
+static bool IsBarrierCommand(CommandType t) {
+  return (t == kAcceptInput || t == kProvideOutput ||
+          t == kNoOperationMarker || t == kNoOperationLabel ||
+          t == kGotoLabel || t == kNoOperationPermanent);
+}
+
+void ComputeCommandDependencies(
+    const Nnet &nnet,
+    const NnetComputation &computation,
+    std::vector<std::vector<int32> > *dependencies) {
+  ComputationVariables variables;
+  variables.Init(computation);
+  std::vector<CommandAttributes> attributes;
+  ComputeCommandAttributes(nnet, computation, variables, &attributes);
+
+  int32 num_commands = computation.commands.size(),
+      num_variables = variables.NumVariables();
+  dependencies->clear();
+  dependencies->resize(num_commands);
+
+  // For each variable, the last command that wrote it, and the commands that
+  // read it since then.
+  std::vector<int32> last_writer(num_variables, -1);
+  std::vector<std::vector<int32> > readers(num_variables);
+  // For each component, the last command that used it.
+  std::vector<int32> last_component_command(nnet.NumComponents(), -1);
+  int32 last_random_command = -1, last_barrier = -1;
+  std::vector<int32> commands_since_barrier;
+  // The deallocation commands so far of matrices in the workspace of a static
+  // memory plan, as pairs (matrix-index, command-index).
+  std::vector<std::pair<int32, int32> > workspace_deallocs;
+  bool have_plan = !computation.workspace_offsets.empty();
+
+  std::vector<int32> variables_read, variables_written;
+  for (int32 command_index = 0; command_index < num_commands;
+       command_index++) {
+    const NnetComputation::Command &c = computation.commands[command_index];
+    std::vector<int32> &deps = (*dependencies)[command_index];
+    if (IsBarrierCommand(c.command_type)) {
+      deps = commands_since_barrier;
+      if (last_barrier >= 0)
+        deps.push_back(last_barrier);
+      SortAndUniq(&deps);
+      commands_since_barrier.clear();
+      last_barrier = command_index;
+      continue;
+    }
+    if (last_barrier >= 0)
+      deps.push_back(last_barrier);
+
+    variables_read = attributes[command_index].variables_read;
+    variables_written = attributes[command_index].variables_written;
+    // The commands that change the size of matrices, or what memory they
+    // use, count as writing all of them.
+    switch (c.command_type) {
+      case kSwapMatrix:
+        variables.AppendVariablesForMatrix(
+            computation.submatrices[c.arg2].matrix_index, &variables_written);
+        // fall through
+      case kAllocMatrix: case kDeallocMatrix:
+      case kCompressMatrix: case kDecompressMatrix:
+        variables.AppendVariablesForMatrix(
+            computation.submatrices[c.arg1].matrix_index, &variables_written);
+        break;
+      default:
+        break;
+    }
+    for (size_t i = 0; i < variables_read.size(); i++) {
+      int32 v = variables_read[i];
+      if (last_writer[v] >= 0)
+        deps.push_back(last_writer[v]);
+    }
+    for (size_t i = 0; i < variables_written.size(); i++) {
+      int32 v = variables_written[i];
+      if (last_writer[v] >= 0)
+        deps.push_back(last_writer[v]);
+      deps.insert(deps.end(), readers[v].begin(), readers[v].end());
+    }
+    for (size_t i = 0; i < variables_read.size(); i++)
+      readers[variables_read[i]].push_back(command_index);
+    for (size_t i = 0; i < variables_written.size(); i++) {
+      last_writer[variables_written[i]] = command_index;
+      readers[variables_written[i]].clear();
+    }
+
+    // Commands that use the same component are kept in order, since they may
+    // update it or its stats; and commands that use random components are
+    // kept in order so the random numbers are drawn in the same order.
+    if (c.command_type == kPropagate || c.command_type == kBackprop ||
+        c.command_type == kBackpropNoModelUpdate) {
+      int32 components[2] = { c.arg1,
+                              (c.command_type == kPropagate ? c.arg7 : -1) };
+      for (int32 i = 0; i < 2; i++) {
+        int32 component_index = components[i];
+        if (component_index < 0)
+          continue;
+        if (last_component_command[component_index] >= 0)
+          deps.push_back(last_component_command[component_index]);
+        last_component_command[component_index] = command_index;
+        if (nnet.GetComponent(component_index)->Properties() &
+            kRandomComponent) {
+          if (last_random_command >= 0)
+            deps.push_back(last_random_command);
+          last_random_command = command_index;
+        }
+      }
+    }
+
+    // With a static memory plan, a matrix may only be allocated once the
+    // matrices that used the same part of the workspace before it are gone.
+    if (have_plan && (c.command_type == kAllocMatrix ||
+                      c.command_type == kDeallocMatrix)) {
+      int32 m = computation.submatrices[c.arg1].matrix_index;
+      int32 offset = computation.workspace_offsets[m];
+      if (offset >= 0) {
+        if (c.command_type == kDeallocMatrix) {
+          workspace_deallocs.push_back(std::pair<int32, int32>(m,
+                                                               command_index));
+        } else {
+          int64 end = offset + static_cast<int64>(
+              computation.matrices[m].num_rows) * computation.WorkspaceStride(m);
+          for (size_t i = 0; i < workspace_deallocs.size(); i++) {
+            int32 other = workspace_deallocs[i].first;
+            int64 other_offset = computation.workspace_offsets[other],
+                other_end = other_offset + static_cast<int64>(
+                    computation.matrices[other].num_rows) *
+                computation.WorkspaceStride(other);
+            if (other_offset < end && offset < other_end)
+              deps.push_back(workspace_deallocs[i].second);
+          }
+        }
+      }
+    }
+    SortAndUniq(&deps);
+    commands_since_barrier.push_back(command_index);
+  }
+}
+
 int64 GetMaxMemoryUse(const NnetComputation &computation) {
   int64 cur_memory_use = 0,
       max_memory_use = 0;
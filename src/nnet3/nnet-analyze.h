@@ -449,6 +449,26 @@ void CheckComputation(const Nnet &nnet,
                       const NnetComputation &computation,
                       bool check_rewrite = false);
 
+/// This function works out, for each command in the computation, the
+/// earlier commands that must have finished before it can start, for
+/// executing commands in parallel (see NnetComputeOptions::num_threads).
+/// (*dependencies)[c] is a sorted list of command indexes less than c.  A
+/// command depends on the earlier commands that write variables it reads or
+/// writes, or read variables it writes; commands that allocate, deallocate,
+/// swap or (de)compress matrices count as writing the whole matrix.
+/// Commands using the same component are kept in order, as are all commands
+/// using random components, and with a static memory plan (see
+/// NnetComputation::workspace_offsets) the allocation of a matrix depends on
+/// the deallocation of the earlier matrices whose memory it shares.  Commands
+/// that do input or output, kGotoLabel and the marker and label
+/// no-operations act as barriers: they depend on all commands since the
+/// previous barrier, and all later commands depend on them.
+void ComputeCommandDependencies(
+    const Nnet &nnet,
+    const NnetComputation &computation,
+    std::vector<std::vector<int32> > *dependencies);
+
+
 // This function returns the maximum amount of memory (in bytes) that the
 // computation uses at any point (this would be GPU memory if the computation
 // were using a GPU).  This is based on allocations and deallocations of
@@ -22,6 +22,8 @@
 #include <iomanip>
 #include "nnet3/nnet-batch-compute.h"
 #include "nnet3/nnet-utils.h"
+#include "cudamatrix/cu-device.h"
+#include "cudamatrix/cu-pinned-matrix.h"
 #include "decoder/decodable-matrix.h"
 
 namespace kaldi {
@@ -36,7 +38,11 @@ NnetBatchComputer::NnetBatchComputer(
     nnet_(nnet),
     compiler_(nnet_, opts.optimize_config),
     log_priors_(priors),
-    num_full_minibatches_(0) {
+    num_full_minibatches_(0),
+    pending_(NULL) {
+#if HAVE_CUDA == 1
+  copy_stream_ = NULL;
+#endif
   log_priors_.ApplyLog();
   CheckAndFixConfigs();
   ComputeSimpleNnetContext(nnet, &nnet_left_context_,
@@ -107,6 +113,13 @@ void NnetBatchComputer::PrintMinibatchStats() {
 }
 
 NnetBatchComputer::~NnetBatchComputer() {
+  // The callers keep calling Compute() until it returns false, which leaves
+  // nothing pending, but be safe.
+  FinishPendingMinibatch();
+#if HAVE_CUDA == 1
+  if (copy_stream_ != NULL)
+    cudaStreamDestroy(copy_stream_);
+#endif
   PrintMinibatchStats();
   // the destructor shouldn't be called while the mutex is locked; if it is, it
   // likely means the program has already crashed, or it's a programming error.
@@ -138,23 +151,42 @@ NnetBatchComputer::GetHighestPriorityComputation(
   std::unique_lock<std::mutex> lock(mutex_);
   MapType::iterator iter = tasks_.begin(), end = tasks_.end(),
       best_iter = tasks_.end();
-  double highest_priority = -std::numeric_limits<double>::infinity();
 
+  // Tasks with deadlines come first: earliest deadline first.
+  double earliest_deadline = std::numeric_limits<double>::infinity();
+  int32 num_deadline_tasks = 0;
   for (; iter != end; ++iter) {
-    ComputationGroupInfo &info = iter->second;
-    double this_priority = GetPriority(allow_partial_minibatch, info);
-    if (this_priority > highest_priority) {
-      highest_priority = this_priority;
+    int32 this_num_deadline_tasks;
+    double deadline = GetEarliestDeadline(iter->second,
+                                          &this_num_deadline_tasks);
+    if (deadline < earliest_deadline) {
+      earliest_deadline = deadline;
+      num_deadline_tasks = this_num_deadline_tasks;
       best_iter = iter;
     }
   }
+
+  if (best_iter == tasks_.end()) {
+    double highest_priority = -std::numeric_limits<double>::infinity();
+    for (iter = tasks_.begin(); iter != end; ++iter) {
+      ComputationGroupInfo &info = iter->second;
+      double this_priority = GetPriority(allow_partial_minibatch, info);
+      if (this_priority > highest_priority) {
+        highest_priority = this_priority;
+        best_iter = iter;
+      }
+    }
+  }
   if (best_iter == tasks_.end()) {
     // either allow_partial_minibatch == false and there were no full
     // minibatches, or there were no pending tasks at all.
     return NULL;
   }
   ComputationGroupInfo &info = best_iter->second;
-  int32 actual_minibatch_size = GetActualMinibatchSize(info);
+  int32 actual_minibatch_size = (num_deadline_tasks > 0 ?
+      GetDeadlineMinibatchSize(info, earliest_deadline - timer_.Elapsed(),
+                               num_deadline_tasks) :
+      GetActualMinibatchSize(info));
   *minibatch_size_out = actual_minibatch_size;
   MinibatchSizeInfo *minfo = &(info.minibatch_info[actual_minibatch_size]);
   if (minfo->computation == NULL)
@@ -178,10 +210,13 @@ void NnetBatchComputer::GetHighestPriorityTasks(
     // We don't sort the tasks with a comparator that dereferences the pointers,
     // because the priorities can change asynchronously, and we're concerned that
     // something weird might happen in the sorting if the things it's comparing
-    // are changing.
-    std::vector<std::pair<double, NnetInferenceTask*> > pairs(num_tasks_present);
+    // are changing.  The sort key is (-deadline, priority), so tasks with
+    // earlier deadlines count as higher priority than all others.
+    std::vector<std::pair<std::pair<double, double>, NnetInferenceTask*> >
+        pairs(num_tasks_present);
     for (int32 i = 0; i < num_tasks_present; i++) {
-      pairs[i].first = info->tasks[i]->priority;
+      pairs[i].first.first = -info->tasks[i]->deadline;
+      pairs[i].first.second = info->tasks[i]->priority;
       pairs[i].second = info->tasks[i];
     }
     std::nth_element(pairs.begin(), pairs.begin() + num_tasks_not_needed,
@@ -262,6 +297,45 @@ std::shared_ptr<const NnetComputation> NnetBatchComputer::GetComputation(
 }
 
 
+double NnetBatchComputer::GetEarliestDeadline(
+    const ComputationGroupInfo &info,
+    int32 *num_deadline_tasks) const {
+  double earliest_deadline = std::numeric_limits<double>::infinity();
+  int32 num_tasks = info.tasks.size();
+  *num_deadline_tasks = 0;
+  for (int32 i = 0; i < num_tasks; i++) {
+    double deadline = info.tasks[i]->deadline;
+    if (deadline != std::numeric_limits<double>::infinity()) {
+      (*num_deadline_tasks)++;
+      earliest_deadline = std::min(earliest_deadline, deadline);
+    }
+  }
+  return earliest_deadline;
+}
+
+
+int32 NnetBatchComputer::GetDeadlineMinibatchSize(
+    const ComputationGroupInfo &info,
+    double slack,
+    int32 num_deadline_tasks) const {
+  int32 minibatch_size = GetActualMinibatchSize(info);
+  while (true) {
+    int32 smaller_size = int32(minibatch_size * opts_.partial_minibatch_factor);
+    if (smaller_size < std::max<int32>(num_deadline_tasks, 1) ||
+        smaller_size >= minibatch_size)
+      break;
+    std::map<int32, MinibatchSizeInfo>::const_iterator iter =
+        info.minibatch_info.find(minibatch_size);
+    if (iter == info.minibatch_info.end() || iter->second.num_done == 0)
+      break;  // We have no estimate of the time this size takes.
+    if (iter->second.seconds_taken / iter->second.num_done <= slack)
+      break;
+    minibatch_size = smaller_size;
+  }
+  return minibatch_size;
+}
+
+
 double NnetBatchComputer::GetPriority(bool allow_partial_minibatch,
                                       const ComputationGroupInfo &info) const {
   if (info.tasks.empty())
@@ -376,6 +450,12 @@ void NnetBatchComputer::CheckAndFixConfigs() {
     }
     opts_.frames_per_chunk = frames_per_chunk;
   }
+  if (opts_.bucket_frames > 0) {
+    // round up to the nearest multiple of n, but no more than
+    // frames_per_chunk.
+    opts_.bucket_frames = std::min(opts_.frames_per_chunk,
+                                   n * ((opts_.bucket_frames + n - 1) / n));
+  }
   KALDI_ASSERT(opts_.minibatch_size >= 1 &&
                opts_.edge_minibatch_size >= 1 &&
                opts_.partial_minibatch_factor < 1.0 &&
@@ -496,9 +576,9 @@ void NnetBatchComputer::FormatInputs(
   }
 }
 
-void NnetBatchComputer::FormatOutputs(
-    const CuMatrix<BaseFloat> &output,
-    const std::vector<NnetInferenceTask*> &tasks) {
+void NnetBatchComputer::FormatOutputs(PendingMinibatch *pending) {
+  const CuMatrix<BaseFloat> &output = pending->output;
+  const std::vector<NnetInferenceTask*> &tasks = pending->tasks;
   KALDI_ASSERT(!tasks.empty());
   int32 num_output_frames = tasks[0]->num_output_frames,
       output_dim = output.NumCols(),
@@ -517,6 +597,27 @@ void NnetBatchComputer::FormatOutputs(
     std::vector<int32_t> ldi(num_tasks), ldo(num_tasks);
     std::vector<int32_t> num_rows(num_tasks), num_cols(num_tasks);
 
+    // The outputs that go to the CPU are copied from the GPU in one
+    // asynchronous copy of the whole minibatch to pinned memory, rather than
+    // a synchronous copy for each task.  The copy is done on copy_stream_
+    // once the computation has finished, so it can overlap the computation of
+    // the next minibatch; FinishPendingMinibatch() waits for it.
+    for (int32 n = 0; n < num_tasks; n++)
+      if (tasks[n]->output_to_cpu)
+        pending->output_to_cpu = true;
+    if (pending->output_to_cpu) {
+      if (copy_stream_ == NULL)
+        CU_SAFE_CALL(cudaStreamCreateWithFlags(&copy_stream_,
+                                               cudaStreamNonBlocking));
+      CuEvent output_computed;
+      output_computed.Record();
+      CuStreamScope copy_scope(copy_stream_);
+      output_computed.StreamWait();
+      pending->output_host.Resize(output.NumRows(), output_dim);
+      output.CopyToMatAsync(&pending->output_host);
+      pending->output_host_ready.Record();
+    }
+
     int b=0;  // batch counter
     for (int32 n = 0; n < num_tasks; n++) {
       NnetInferenceTask *task = tasks[n];
@@ -529,16 +630,9 @@ void NnetBatchComputer::FormatOutputs(
       // This adds a bit of code complexity.  Perhaps output_to_cpu should 
       // be a property of the batch computer and not the tasks
       if (task->output_to_cpu) {
+        // This is copied from output_host by FinishPendingMinibatch().
         task->output_cpu.Resize(num_output_frames, output_dim,
             kUndefined);
-        // if (left_unused > 0)
-        //   task->output_cpu.RowRange(0, left_unused).SetZero();
-        task->output_cpu.RowRange(left_unused, used).CopyFromMat(
-            output.RowRange(n * num_output_frames + left_unused, used));
-        // if (right_unused > 0)
-        //   task->output_cpu.RowRange(
-        //   0, left_unused + used, right_unused).SetZero();
-
       } else {
         did_output_to_gpu = true;
         task->output.Resize(num_output_frames, output_dim,
@@ -563,7 +657,6 @@ void NnetBatchComputer::FormatOutputs(
     // execute batched copy
     cuda_batched_copy_mats(b, &num_rows[0], &num_cols[0], &inputs[0], &ldi[0], 
         &outputs[0], &ldo[0]);
-  
   } else
 #endif
   {
@@ -609,6 +702,13 @@ void NnetBatchComputer::AcceptTask(NnetInferenceTask *task,
                                    int32 max_minibatches_full) {
   std::unique_lock<std::mutex> lock(mutex_);
 
+  if (task->max_latency >= 0.0) {
+    task->deadline = timer_.Elapsed() + task->max_latency;
+    max_minibatches_full = -1;  // Never make tasks with deadlines wait.
+  } else {
+    task->deadline = std::numeric_limits<double>::infinity();
+  }
+
   if (max_minibatches_full > 0 && num_full_minibatches_ > max_minibatches_full) {
     std::unordered_map<int32, std::condition_variable*>::iterator
         iter = no_more_than_n_minibatches_full_.find(max_minibatches_full);
@@ -637,8 +737,11 @@ bool NnetBatchComputer::Compute(bool allow_partial_minibatch) {
       GetHighestPriorityComputation(allow_partial_minibatch,
                                     &minibatch_size,
                                     &tasks);
-  if (minfo == NULL)
-    return false;
+  if (minfo == NULL) {
+    // Nothing new to compute, but we may still have to finish the minibatch
+    // queued by the previous call.
+    return FinishPendingMinibatch();
+  }
 
   Timer tim;
   Nnet *nnet_to_update = NULL;  // we're not doing any update
@@ -652,16 +755,57 @@ bool NnetBatchComputer::Compute(bool allow_partial_minibatch) {
   computer.AcceptInput("input", &input);
   if (ivector.NumRows() != 0)
     computer.AcceptInput("ivector", &ivector);
-  computer.Run();
-  CuMatrix<BaseFloat> output;
+  {
+    CuTensorOpMathScope tensor_op_math(opts_.use_tensor_cores);
+    computer.Run();
+  }
+  PendingMinibatch *pending = new PendingMinibatch();
+  pending->tasks.swap(tasks);
+  pending->minfo = minfo;
+  CuMatrix<BaseFloat> &output = pending->output;
   computer.GetOutputDestructive("output", &output);
+  // Subtracting the log-priors and applying the acoustic scale in a single
+  // pass over the output: output = acoustic_scale * (output - log_priors).
   if (log_priors_.Dim() != 0) {
-    output.AddVecToRows(-1.0, log_priors_);
+    output.AddVecToRows(-opts_.acoustic_scale, log_priors_,
+                        opts_.acoustic_scale);
+  } else if (opts_.acoustic_scale != 1.0) {
+    output.Scale(opts_.acoustic_scale);
+  }
+  FormatOutputs(pending);
+  minfo->seconds_taken += tim.Elapsed();
+
+  // While the GPU works on this minibatch, finish the previous one.
+  FinishPendingMinibatch();
+  pending_ = pending;
+  return true;
+}
+
+
+bool NnetBatchComputer::FinishPendingMinibatch() {
+  if (pending_ == NULL)
+    return false;
+  Timer tim;
+  PendingMinibatch *pending = pending_;
+  pending_ = NULL;
+  const std::vector<NnetInferenceTask*> &tasks = pending->tasks;
+  if (pending->output_to_cpu) {
+    pending->output_host_ready.Synchronize();
+    int32 num_output_frames = tasks[0]->num_output_frames;
+    for (size_t n = 0; n < tasks.size(); n++) {
+      NnetInferenceTask *task = tasks[n];
+      if (!task->output_to_cpu)
+        continue;
+      int32 left_unused = task->num_initial_unused_output_frames,
+          used = task->num_used_output_frames;
+      task->output_cpu.RowRange(left_unused, used).CopyFromMat(
+          pending->output_host.RowRange(n * num_output_frames + left_unused,
+                                        used));
+    }
   }
-  output.Scale(opts_.acoustic_scale);
-  FormatOutputs(output, tasks);
 
   // Update the stats, for diagnostics.
+  MinibatchSizeInfo *minfo = pending->minfo;
   minfo->num_done++;
   minfo->tot_num_tasks += static_cast<int64>(tasks.size());
   minfo->seconds_taken += tim.Elapsed();
@@ -670,7 +814,7 @@ bool NnetBatchComputer::Compute(bool allow_partial_minibatch) {
 
   for (size_t i = 0; i < tasks.size(); i++)
     tasks[i]->semaphore.Signal();
-
+  delete pending;
   return true;
 }
 
@@ -720,7 +864,16 @@ void GetOutputFrameInfoForTasks(
       task.num_used_output_frames = num_subsampled_frames;
       task.is_irregular = true;
     } else {
-      task.num_output_frames = fpc;
+      // We pad the output to the chunk size or, if --bucket-frames was given,
+      // to the next multiple of the bucket size, so that short utterances of
+      // similar lengths share a computation.
+      int32 padded_frames = fpc;
+      if (opts.bucket_frames > 0) {
+        int32 bucket = opts.bucket_frames / opts.frame_subsampling_factor;
+        padded_frames = std::min(
+            fpc, bucket * ((num_subsampled_frames + bucket - 1) / bucket));
+      }
+      task.num_output_frames = padded_frames;
       task.num_initial_unused_output_frames = 0;
       task.num_used_output_frames = num_subsampled_frames;
       task.is_irregular = false;
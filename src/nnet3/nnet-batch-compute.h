@@ -23,6 +23,7 @@
 
 #include <vector>
 #include <string>
+#include <limits>
 #include <list>
 #include <utility>
 #include <condition_variable>
@@ -35,6 +36,8 @@
 #include "nnet3/am-nnet-simple.h"
 #include "nnet3/nnet-am-decodable-simple.h"
 #include "decoder/lattice-faster-decoder.h"
+#include "cudamatrix/cu-device.h"
+#include "cudamatrix/cu-pinned-matrix.h"
 #include "util/stl-utils.h"
 
 
@@ -53,7 +56,8 @@ struct NnetInferenceTask {
   NnetInferenceTask(const NnetInferenceTask &other) {
     KALDI_ERR << "NnetInferenceTask was not designed to be copied.";
   }
-  NnetInferenceTask() { }
+  NnetInferenceTask(): max_latency(-1.0),
+                       deadline(std::numeric_limits<double>::infinity()) { }
 
 
   // The input frames, which are treated as being numbered t=0, t=1, etc.  (If
@@ -119,6 +123,17 @@ struct NnetInferenceTask {
   // after this object is provided to class NnetBatchComputer.
   double priority;
 
+  // If >= 0, the latency in seconds, counted from when the task is given to
+  // NnetBatchComputer::AcceptTask(), by which the caller would like the task
+  // to be done (e.g. for interactive traffic).  Tasks with a latency
+  // requirement are scheduled before all tasks without one, earliest
+  // deadline first; 'priority' only orders tasks with equal deadlines.
+  double max_latency;
+
+  // Set by NnetBatchComputer::AcceptTask() from 'max_latency': the deadline on
+  // that object's clock, or infinity if max_latency < 0.
+  double deadline;
+
   // This semaphore will be incremented by class NnetBatchComputer when this
   // chunk is done.  After this semaphore is incremented, class
   // NnetBatchComputer will no longer hold any pointers to this class.
@@ -146,11 +161,13 @@ struct NnetBatchComputerOptions: public NnetSimpleComputationOptions {
   int32 edge_minibatch_size;
   bool ensure_exact_final_context;
   BaseFloat partial_minibatch_factor;
+  int32 bucket_frames;
 
   NnetBatchComputerOptions(): minibatch_size(128),
                               edge_minibatch_size(32),
                               ensure_exact_final_context(false),
-                              partial_minibatch_factor(0.5) {
+                              partial_minibatch_factor(0.5),
+                              bucket_frames(0) {
   }
 
   void Register(OptionsItf *po) {
@@ -174,6 +191,15 @@ struct NnetBatchComputerOptions: public NnetSimpleComputationOptions {
                  "for sizes: int(partial_minibatch_factor^n * minibatch_size "
                  ", for n = 0, 1, 2....  Set it to 0.0 if you want to use "
                  "only the specified minibatch sizes.");
+    po->Register("bucket-frames", &bucket_frames, "If >0 (and "
+                 "--ensure-exact-final-context=false), utterances shorter "
+                 "than --frames-per-chunk are padded only up to a multiple "
+                 "of this many frames instead of to --frames-per-chunk, so "
+                 "less computation is wasted on padding; utterances in the "
+                 "same bucket share minibatches, and there are at most "
+                 "frames-per-chunk / bucket-frames extra chunk shapes to "
+                 "compile.  Rounded up to a multiple of "
+                 "--frame-subsampling-factor if needed.");
   }
 };
 
@@ -226,6 +252,8 @@ class NnetBatchComputer {
   /// If the max_minibatches_full >= 0, then the calling thread will block until
   /// no more than that many full minibatches are waiting to be computed.  This
   /// is a mechanism to prevent too many requests from piling up in memory.
+  /// (Tasks with task->max_latency >= 0 never block, so interactive traffic
+  /// is not held up by a backlog of batch work).
   void AcceptTask(NnetInferenceTask *task,
                   int32 max_minibatches_full = -1);
 
@@ -238,6 +266,24 @@ class NnetBatchComputer {
       compute.  It returns true if it did some kind of computation, and false
       otherwise.  This function locks the class, but not for the entire time
       it's being called: only at the beginning and at the end.
+
+      If any queued task has a deadline (see NnetInferenceTask::max_latency),
+      we compute the group of tasks with the earliest deadline, even if its
+      minibatch is not full and allow_partial_minibatch is false; this means
+      that batch work is preempted at the next minibatch boundary.  If our
+      estimate of the time a full minibatch takes would miss that deadline,
+      we use a smaller minibatch size, as long as it still fits all the tasks
+      with deadlines in the group.
+
+      The minibatches are double-buffered: this call queues the computation
+      of a new minibatch (and, on GPU, the asynchronous copy of its output to
+      pinned host memory on a separate stream) and only then finishes the
+      minibatch queued by the previous call, so the GPU is busy with one
+      minibatch while we wait for and distribute the output of the other.
+      The tasks of a minibatch are therefore signaled one call late.  If there
+      is no new minibatch to compute, it finishes the pending one (if any)
+      and returns true; so calling this until it returns false, as the
+      callers do, leaves no minibatch pending.
         @param [in] allow_partial_minibatch  If false, then this will only
               do the computation if a full minibatch is ready; if true, it
               is allowed to do computation on partial (not-full) minibatches.
@@ -279,6 +325,17 @@ class NnetBatchComputer {
 
   const NnetBatchComputerOptions &GetOptions() { return opts_; }
 
+  /// The inherent left and right context of the network, and its input,
+  /// i-vector and output dimensions (the i-vector dimension is zero if it takes
+  /// no i-vectors).  These are for users, such as DecodableAmNnetBatchedOnline,
+  /// that set up the tasks themselves rather than by calling
+  /// SplitUtteranceIntoTasks().
+  int32 NnetLeftContext() const { return nnet_left_context_; }
+  int32 NnetRightContext() const { return nnet_right_context_; }
+  int32 InputDim() const { return input_dim_; }
+  int32 IvectorDim() const { return ivector_dim_; }
+  int32 OutputDim() const { return output_dim_; }
+
   ~NnetBatchComputer();
 
  private:
@@ -343,6 +400,38 @@ class NnetBatchComputer {
   typedef unordered_map<ComputationGroupKey, ComputationGroupInfo,
                         ComputationGroupKeyHasher> MapType;
 
+  // A minibatch whose computation has been queued by Compute() but whose
+  // tasks have not yet been given their output and signaled.
+  struct PendingMinibatch {
+    std::vector<NnetInferenceTask*> tasks;
+    MinibatchSizeInfo *minfo;
+    // The output of the computation; we keep it until the copy to
+    // 'output_host' is done, because that copy is on another stream.
+    CuMatrix<BaseFloat> output;
+    // If any task has output_to_cpu == true: the output copied to pinned
+    // memory, and an event that is complete when that copy is done.
+    CuPinnedMatrix<BaseFloat> output_host;
+    CuEvent output_host_ready;
+    bool output_to_cpu;
+    PendingMinibatch(): minfo(NULL), output_to_cpu(false) { }
+  };
+
+  // Returns the earliest deadline of the tasks in this group (infinity if
+  // none has a deadline), and sets *num_deadline_tasks to the number of tasks
+  // in it that have a deadline.
+  double GetEarliestDeadline(const ComputationGroupInfo &info,
+                             int32 *num_deadline_tasks) const;
+
+  // Returns the minibatch size to use for a group whose earliest deadline is
+  // 'slack' seconds from now and which has 'num_deadline_tasks' tasks with
+  // deadlines: GetActualMinibatchSize(info), reduced (by factors of
+  // opts_.partial_minibatch_factor) while the average time taken by past
+  // minibatches of that size exceeds 'slack' and the smaller size would
+  // still hold all of the tasks with deadlines.
+  int32 GetDeadlineMinibatchSize(const ComputationGroupInfo &info,
+                                 double slack,
+                                 int32 num_deadline_tasks) const;
+
   // Gets the priority for a group, higher means higher priority.  (A group is a
   // list of tasks that may be computed in the same minibatch).  What this
   // function does is a kind of heuristic.
@@ -437,10 +526,16 @@ class NnetBatchComputer {
                     CuMatrix<BaseFloat> *ivector);
 
 
-  // Copies 'output', piece by piece, to the 'output_cpu' or 'output'
-  // members of 'tasks', depending on their 'output_to_cpu' value.
-  void FormatOutputs(const CuMatrix<BaseFloat> &output,
-                     const std::vector<NnetInferenceTask*> &tasks);
+  // Copies pending->output, piece by piece, to the 'output' members of those
+  // of pending->tasks that have output_to_cpu == false, and starts the copy
+  // of the output to the 'output_cpu' members of the others, which is
+  // completed by FinishPendingMinibatch().
+  void FormatOutputs(PendingMinibatch *pending);
+
+  // Waits for the output of pending_ (if non-NULL) to be copied, gives it to
+  // the tasks, signals them, and deletes pending_.  Returns true if there was
+  // a pending minibatch.
+  bool FinishPendingMinibatch();
 
 
   // Changes opts_.frames_per_chunk to be a multiple of
@@ -490,6 +585,18 @@ class NnetBatchComputer {
   int32 input_dim_;
   int32 ivector_dim_;
   int32 output_dim_;
+
+  // The clock on which the 'deadline' members of tasks are measured.
+  Timer timer_;
+
+  // The minibatch queued by the previous call to Compute(), if it has not yet
+  // been finished; owned here.
+  PendingMinibatch *pending_;
+#if HAVE_CUDA == 1
+  // The stream on which we copy outputs to the CPU, so that the copy of one
+  // minibatch can overlap the computation of the next.
+  cudaStream_t copy_stream_;
+#endif
 };
 
 
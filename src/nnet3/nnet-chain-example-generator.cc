@@ -0,0 +1,381 @@
+// nnet3/nnet-chain-example-generator.cc
+
+// Copyright      2015  Johns Hopkins University (author:  Daniel Povey)
+//                2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <sstream>
+
+#include "nnet3/nnet-chain-example-generator.h"
+#include "fstext/fstext-utils.h"
+
+namespace kaldi {
+namespace nnet3 {
+
+ChainExampleTask::ChainExampleTask(const TransitionModel *trans_mdl,
+                                   const fst::StdVectorFst &normalization_fst,
+                                   const GeneralMatrix &feats,
+                                   const MatrixBase<BaseFloat> *ivector_feats,
+                                   int32 ivector_period,
+                                   const chain::Supervision &supervision,
+                                   const VectorBase<BaseFloat> *deriv_weights,
+                                   int32 supervision_length_tolerance,
+                                   const std::string &utt_id,
+                                   bool compress,
+                                   UtteranceSplitter *utt_splitter,
+                                   ChainExampleConsumer *consumer,
+                                   int32 *num_err):
+    trans_mdl_(trans_mdl), normalization_fst_(normalization_fst),
+    feats_(feats), supervision_(supervision), utt_id_(utt_id),
+    compress_(compress),
+    frame_subsampling_factor_(utt_splitter->Config().frame_subsampling_factor),
+    consumer_(consumer), num_err_(num_err), ok_(false) {
+  KALDI_ASSERT(supervision.num_sequences == 1);
+  int32 num_input_frames = feats.NumRows(),
+      num_output_frames = supervision.frames_per_sequence;
+
+  if (deriv_weights && (std::abs(deriv_weights->Dim() - num_output_frames)
+                        > supervision_length_tolerance)) {
+    KALDI_WARN << "For utterance " << utt_id
+               << ", mismatch between deriv-weights dim and num-output-frames"
+               << "; " << deriv_weights->Dim() << " vs " << num_output_frames;
+    return;
+  }
+
+  if (!utt_splitter->LengthsMatch(utt_id, num_input_frames, num_output_frames,
+                                  supervision_length_tolerance))
+    return;  // LengthsMatch() will have printed a warning.
+
+  // It can happen if people mess with the feature frame-width options, that
+  // there can be small mismatches in length between the supervisions (derived
+  // from lattices) and the features; if this happens, and
+  // supervision_length_tolerance is nonzero, and the num-input-frames is larger
+  // than plausible for this num_output_frames, then it could lead us to try to
+  // access frames in the supervision that don't exist.  The following
+  // if-statement is to prevent that happening.
+  if (num_input_frames > num_output_frames * frame_subsampling_factor_)
+    num_input_frames = num_output_frames * frame_subsampling_factor_;
+
+  utt_splitter->GetChunksForUtterance(num_input_frames, &chunks_);
+
+  if (chunks_.empty()) {
+    KALDI_WARN << "Not producing egs for utterance " << utt_id
+               << " because it is too short: "
+               << num_input_frames << " frames.";
+    return;
+  }
+
+  if (deriv_weights)
+    deriv_weights_ = *deriv_weights;
+
+  if (ivector_feats != NULL) {
+    // if applicable, we add the iVector feature.
+    // choose iVector from a random frame in the chunk
+    ivectors_.Resize(chunks_.size(), ivector_feats->NumCols(), kUndefined);
+    for (size_t c = 0; c < chunks_.size(); c++) {
+      const ChunkTimeInfo &chunk = chunks_[c];
+      int32 start_frame = chunk.first_frame - chunk.left_context;
+      int32 ivector_frame = RandInt(start_frame,
+                                    start_frame + num_input_frames - 1),
+          ivector_frame_subsampled = ivector_frame / ivector_period;
+      if (ivector_frame_subsampled < 0)
+        ivector_frame_subsampled = 0;
+      if (ivector_frame_subsampled >= ivector_feats->NumRows())
+        ivector_frame_subsampled = ivector_feats->NumRows() - 1;
+      ivectors_.Row(c).CopyFromVec(
+          ivector_feats->Row(ivector_frame_subsampled));
+    }
+  }
+  ok_ = true;
+}
+
+void ChainExampleTask::operator () () {
+  if (!ok_)
+    return;
+  chain::SupervisionSplitter sup_splitter(supervision_);
+  egs_.resize(chunks_.size(), NULL);
+
+  for (size_t c = 0; c < chunks_.size(); c++) {
+    ChunkTimeInfo &chunk = chunks_[c];
+
+    int32 start_frame_subsampled = chunk.first_frame / frame_subsampling_factor_,
+        num_frames_subsampled = chunk.num_frames / frame_subsampling_factor_;
+
+    chain::Supervision supervision_part;
+    sup_splitter.GetFrameRange(start_frame_subsampled,
+                               num_frames_subsampled,
+                               &supervision_part);
+
+    if (trans_mdl_ != NULL)
+      ConvertSupervisionToUnconstrained(*trans_mdl_, &supervision_part);
+
+    if (normalization_fst_.NumStates() > 0 &&
+        !AddWeightToSupervisionFst(normalization_fst_,
+                                   &supervision_part)) {
+      KALDI_WARN << "For utterance " << utt_id_ << ", feature frames "
+                 << chunk.first_frame << " to "
+                 << (chunk.first_frame + chunk.num_frames)
+                 << ", FST was empty after composing with normalization FST. "
+                 << "This should be extremely rare (a few per corpus, at most)";
+    }
+
+    int32 first_frame = 0;  // we shift the time-indexes of all these parts so
+                            // that the supervised part starts from frame 0.
+
+    egs_[c] = new NnetChainExample();
+    NnetChainExample &nnet_chain_eg = *(egs_[c]);
+    nnet_chain_eg.outputs.resize(1);
+
+    SubVector<BaseFloat> output_weights(
+        &(chunk.output_weights[0]),
+        static_cast<int32>(chunk.output_weights.size()));
+
+    if (deriv_weights_.Dim() == 0) {
+      NnetChainSupervision nnet_supervision("output", supervision_part,
+                                            output_weights,
+                                            first_frame,
+                                            frame_subsampling_factor_);
+      nnet_chain_eg.outputs[0].Swap(&nnet_supervision);
+    } else {
+      Vector<BaseFloat> this_deriv_weights(num_frames_subsampled);
+      for (int32 i = 0; i < num_frames_subsampled; i++) {
+        int32 t = i + start_frame_subsampled;
+        if (t < deriv_weights_.Dim())
+          this_deriv_weights(i) = deriv_weights_(t);
+      }
+      KALDI_ASSERT(output_weights.Dim() == num_frames_subsampled);
+      this_deriv_weights.MulElements(output_weights);
+      NnetChainSupervision nnet_supervision("output", supervision_part,
+                                            this_deriv_weights,
+                                            first_frame,
+                                            frame_subsampling_factor_);
+      nnet_chain_eg.outputs[0].Swap(&nnet_supervision);
+    }
+
+    nnet_chain_eg.inputs.resize(ivectors_.NumRows() != 0 ? 2 : 1);
+
+    int32 tot_input_frames = chunk.left_context + chunk.num_frames +
+        chunk.right_context,
+        start_frame = chunk.first_frame - chunk.left_context;
+
+    GeneralMatrix input_frames;
+    ExtractRowRangeWithPadding(feats_, start_frame, tot_input_frames,
+                               &input_frames);
+
+    NnetIo input_io("input", -chunk.left_context, input_frames);
+    nnet_chain_eg.inputs[0].Swap(&input_io);
+
+    if (ivectors_.NumRows() != 0) {
+      Matrix<BaseFloat> ivector(ivectors_.RowRange(c, 1));
+      NnetIo ivector_io("ivector", 0, ivector);
+      nnet_chain_eg.inputs[1].Swap(&ivector_io);
+    }
+
+    if (compress_)
+      nnet_chain_eg.Compress();
+  }
+}
+
+ChainExampleTask::~ChainExampleTask() {
+  if (!ok_) {
+    (*num_err_)++;
+    return;
+  }
+  for (size_t c = 0; c < egs_.size(); c++) {
+    std::ostringstream os;
+    os << utt_id_ << "-" << chunks_[c].first_frame;
+
+    std::string key = os.str(); // key is <utt_id>-<frame_id>
+
+    consumer_->Accept(key, egs_[c]);  // takes ownership.
+  }
+}
+
+
+void NnetChainExampleGenerator::Shuffler::Accept(const std::string &key,
+                                                 NnetChainExample *eg) {
+  // This is the randomization of nnet3-chain-shuffle-egs --buffer-size.
+  if (static_cast<int32>(buffer_.size()) < buffer_size_) {
+    buffer_.push_back(eg);
+  } else {
+    int32 index = RandInt(0, buffer_size_ - 1, &rand_state_);
+    merger_->AcceptExample(buffer_[index]);
+    buffer_[index] = eg;
+  }
+}
+
+void NnetChainExampleGenerator::Shuffler::Flush() {
+  for (size_t i = 0; i < buffer_.size(); i++)
+    merger_->AcceptExample(buffer_[i]);
+  buffer_.clear();
+}
+
+
+NnetChainExampleGenerator::NnetChainExampleGenerator(
+    const NnetChainExampleGeneratorOptions &opts,
+    const std::string &feature_rspecifier,
+    const std::string &supervision_rspecifier):
+    opts_(opts),
+    feature_rspecifier_(feature_rspecifier),
+    supervision_rspecifier_(supervision_rspecifier),
+    sink_(this),
+    merger_(opts_.merging_config, &sink_),
+    shuffler_(std::max<int32>(opts.buffer_size, 1), &merger_),
+    finished_(false), stop_(false) {
+  KALDI_ASSERT(opts.num_minibatches > 0);
+  opts_.eg_config.ComputeDerived();
+  opts_.merging_config.ComputeDerived();
+  if (!opts_.normalization_fst_rxfilename.empty()) {
+    ReadFstKaldi(opts_.normalization_fst_rxfilename, &normalization_fst_);
+    KALDI_ASSERT(normalization_fst_.NumStates() > 0);
+    if (opts_.normalization_fst_scale <= 0.0)
+      KALDI_ERR << "Invalid scale on normalization FST; must be > 0.0";
+    if (opts_.normalization_fst_scale != 1.0)
+      ApplyProbabilityScale(opts_.normalization_fst_scale,
+                            &normalization_fst_);
+  }
+  thread_ = std::thread(&NnetChainExampleGenerator::GenerateExamples, this);
+}
+
+bool NnetChainExampleGenerator::Stopped() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return stop_;
+}
+
+void NnetChainExampleGenerator::GenerateExamples() {
+  try {
+    // Read as GeneralMatrix so we don't need to un-compress and re-compress
+    // when selecting parts of matrices.
+    SequentialGeneralMatrixReader feat_reader(feature_rspecifier_);
+    chain::RandomAccessSupervisionReader supervision_reader(
+        supervision_rspecifier_);
+    RandomAccessBaseFloatMatrixReader online_ivector_reader(
+        opts_.online_ivector_rspecifier);
+    RandomAccessBaseFloatVectorReader deriv_weights_reader(
+        opts_.deriv_weights_rspecifier);
+    UtteranceSplitter utt_splitter(opts_.eg_config);
+    int32 num_err = 0;
+    {
+      TaskSequencer<ChainExampleTask> sequencer(opts_.sequencer_config);
+      for (; !feat_reader.Done() && !Stopped(); feat_reader.Next()) {
+        std::string key = feat_reader.Key();
+        const GeneralMatrix &feats = feat_reader.Value();
+        if (!supervision_reader.HasKey(key)) {
+          KALDI_WARN << "No pdf-level posterior for key " << key;
+          num_err++;
+          continue;
+        }
+        const chain::Supervision &supervision = supervision_reader.Value(key);
+        const Matrix<BaseFloat> *online_ivector_feats = NULL;
+        if (!opts_.online_ivector_rspecifier.empty()) {
+          if (!online_ivector_reader.HasKey(key)) {
+            KALDI_WARN << "No iVectors for utterance " << key;
+            num_err++;
+            continue;
+          }
+          online_ivector_feats = &(online_ivector_reader.Value(key));
+          if (abs(feats.NumRows() - (online_ivector_feats->NumRows() *
+                                     opts_.online_ivector_period)) >
+              opts_.length_tolerance ||
+              online_ivector_feats->NumRows() == 0) {
+            KALDI_WARN << "Length difference between feats " << feats.NumRows()
+                       << " and iVectors " << online_ivector_feats->NumRows()
+                       << "exceeds tolerance " << opts_.length_tolerance;
+            num_err++;
+            continue;
+          }
+        }
+        const Vector<BaseFloat> *deriv_weights = NULL;
+        if (!opts_.deriv_weights_rspecifier.empty()) {
+          if (!deriv_weights_reader.HasKey(key)) {
+            KALDI_WARN << "No deriv weights for utterance " << key;
+            num_err++;
+            continue;
+          }
+          deriv_weights = &(deriv_weights_reader.Value(key));
+        }
+        sequencer.Run(new ChainExampleTask(
+            NULL, normalization_fst_, feats,
+            online_ivector_feats, opts_.online_ivector_period,
+            supervision, deriv_weights, opts_.supervision_length_tolerance,
+            key, false, &utt_splitter, &shuffler_, &num_err));
+      }
+    }
+    shuffler_.Flush();
+    merger_.Finish();
+    if (num_err > 0)
+      KALDI_WARN << num_err << " utterances had errors and could "
+          "not be processed.";
+  } catch (const std::exception &e) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    error_ = e.what();
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  finished_ = true;
+  cond_.notify_all();
+}
+
+void NnetChainExampleGenerator::AddMinibatch(NnetChainExample *eg) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (static_cast<int32>(minibatches_.size()) >= opts_.num_minibatches &&
+         !stop_)
+    cond_.wait(lock);
+  if (stop_) {
+    delete eg;
+    return;
+  }
+  minibatches_.push_back(eg);
+  cond_.notify_all();
+}
+
+bool NnetChainExampleGenerator::Done() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (minibatches_.empty() && !finished_)
+    cond_.wait(lock);
+  if (!error_.empty())
+    KALDI_ERR << "Error generating the examples: " << error_;
+  return minibatches_.empty();
+}
+
+const NnetChainExample &NnetChainExampleGenerator::Value() {
+  KALDI_ASSERT(!Done());
+  std::unique_lock<std::mutex> lock(mutex_);
+  return *(minibatches_.front());
+}
+
+void NnetChainExampleGenerator::Next() {
+  KALDI_ASSERT(!Done());
+  std::unique_lock<std::mutex> lock(mutex_);
+  delete minibatches_.front();
+  minibatches_.pop_front();
+  cond_.notify_all();
+}
+
+NnetChainExampleGenerator::~NnetChainExampleGenerator() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stop_ = true;
+    cond_.notify_all();
+  }
+  thread_.join();
+  for (size_t i = 0; i < minibatches_.size(); i++)
+    delete minibatches_[i];
+}
+
+
+} // namespace nnet3
+} // namespace kaldi
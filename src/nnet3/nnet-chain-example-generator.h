@@ -0,0 +1,310 @@
+// nnet3/nnet-chain-example-generator.h
+
+// Copyright      2015  Johns Hopkins University (author:  Daniel Povey)
+//                2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_NNET3_NNET_CHAIN_EXAMPLE_GENERATOR_H_
+#define KALDI_NNET3_NNET_CHAIN_EXAMPLE_GENERATOR_H_
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "util/kaldi-thread.h"
+#include "hmm/transition-model.h"
+#include "chain/chain-supervision.h"
+#include "nnet3/nnet-example-utils.h"
+#include "nnet3/nnet-chain-example.h"
+
+namespace kaldi {
+namespace nnet3 {
+
+/**
+   This class does all the processing for one utterance when creating 'chain'
+   examples (as nnet3-chain-get-egs does), and gives the examples to
+   'consumer'.  The constructor, which is called from the thread that reads
+   the input, checks the lengths and works out how the utterance is split
+   into chunks (this uses the UtteranceSplitter, which is not thread-safe, and
+   the random number generator, so the egs do not depend on the number of
+   threads).  operator () splits the supervision and creates and compresses
+   the egs; it is meant to be run on a TaskSequencer, in parallel for several
+   utterances.  The destructor gives the egs to the consumer; the
+   TaskSequencer calls the destructors in the order the utterances were read.
+
+     @param [in]  trans_mdl           The transition-model for the tree for which we
+                                      are dumping egs.  This is expected to be
+                                      NULL if the input examples already contain
+                                      pdfs-ids+1 in their FSTs, and non-NULL if the
+                                      input examples contain transition-ids in
+                                      their FSTs and need to be converted to
+                                      unconstrained 'e2e' (end-to-end) style FSTs
+                                      which contain pdf-ids+1 but which won't enforce any
+                                      alignment constraints interior to the
+                                      utterance.
+     @param [in]  normalization_fst   A version of denominator FST used to add weights
+                                      to the created supervision. It is
+                                      actually an FST expected to have the
+                                      labels as (pdf-id+1).  If this has no states,
+                                      we skip the final stage of egs preparation
+                                      in which we compose with the normalization
+                                      FST, and you should do it later with
+                                      nnet3-chain-normalize-egs.
+     @param [in]  feats               Input feature matrix
+     @param [in]  ivector_feats       Online iVector matrix sub-sampled at a
+                                      rate of "ivector_period".
+                                      If NULL, iVector will not be added
+                                      as in input to the egs.
+     @param [in]  ivector_period      Number of frames between iVectors in
+                                      "ivector_feats" matrix.
+     @param [in]  supervision         Supervision for 'chain' training created
+                                      from the binary chain-get-supervision.
+                                      This is expected to be at a
+                                      sub-sampled rate if
+                                      --frame-subsampling-factor > 1.
+     @param [in]  deriv_weights       Vector of per-frame weights that scale
+                                      a frame's gradient during backpropagation.
+                                      If NULL, this is equivalent to specifying
+                                      a vector of all 1s.
+                                      The dimension of the vector is expected
+                                      to be the supervision size, which is
+                                      at a sub-sampled rate if
+                                      --frame-subsampling-factor > 1.
+     @param [in]  supervision_length_tolerance
+                                      Tolerance for difference in num-frames-subsampled between
+                                      supervision and deriv weights, and also between supervision
+                                      and input frames.
+     @param [in]  utt_id              Utterance-id
+     @param [in]  compress            If true, compresses the feature matrices.
+     @param [out]  utt_splitter       Pointer to UtteranceSplitter object,
+                                      which helps to split an utterance into
+                                      chunks. This also stores some stats.
+     @param [out]  consumer           The object the egs are given to; their
+                                      keys are <utt_id>-<first-frame>.
+     @param [out]  num_err            Incremented (by the destructor) if the
+                                      utterance could not be processed.
+
+   The inputs are copied, so they need not outlive the constructor call,
+   except for trans_mdl, normalization_fst, utt_splitter and consumer.
+**/
+class ChainExampleTask {
+ public:
+  ChainExampleTask(const TransitionModel *trans_mdl,
+                   const fst::StdVectorFst &normalization_fst,
+                   const GeneralMatrix &feats,
+                   const MatrixBase<BaseFloat> *ivector_feats,
+                   int32 ivector_period,
+                   const chain::Supervision &supervision,
+                   const VectorBase<BaseFloat> *deriv_weights,
+                   int32 supervision_length_tolerance,
+                   const std::string &utt_id,
+                   bool compress,
+                   UtteranceSplitter *utt_splitter,
+                   ChainExampleConsumer *consumer,
+                   int32 *num_err);
+
+  void operator () ();
+
+  ~ChainExampleTask();
+
+ private:
+  const TransitionModel *trans_mdl_;
+  const fst::StdVectorFst &normalization_fst_;
+  GeneralMatrix feats_;
+  chain::Supervision supervision_;
+  Vector<BaseFloat> deriv_weights_;  // Empty if there are no deriv-weights.
+  // The iVector of each chunk; empty if there are no iVectors.
+  Matrix<BaseFloat> ivectors_;
+  std::string utt_id_;
+  bool compress_;
+  int32 frame_subsampling_factor_;
+  ChainExampleConsumer *consumer_;
+  int32 *num_err_;
+  // False if the utterance could not be processed.
+  bool ok_;
+  std::vector<ChunkTimeInfo> chunks_;
+  std::vector<NnetChainExample*> egs_;
+};
+
+
+struct NnetChainExampleGeneratorOptions {
+  ExampleGenerationConfig eg_config;  // controls num-frames,
+                                      // left/right-context, etc.
+  ExampleMergingConfig merging_config;  // controls minibatch-size.
+  TaskSequencerConfig sequencer_config;  // controls num-threads.
+  int32 buffer_size;
+  int32 num_minibatches;
+  std::string online_ivector_rspecifier;
+  int32 online_ivector_period;
+  int32 length_tolerance;
+  int32 supervision_length_tolerance;
+  std::string deriv_weights_rspecifier;
+  std::string normalization_fst_rxfilename;
+  BaseFloat normalization_fst_scale;
+
+  NnetChainExampleGeneratorOptions():
+      merging_config("64"), buffer_size(5000), num_minibatches(8),
+      online_ivector_period(1), length_tolerance(100),
+      supervision_length_tolerance(1), normalization_fst_scale(1.0) { }
+
+  void Register(OptionsItf *opts) {
+    eg_config.Register(opts);
+    merging_config.Register(opts);
+    sequencer_config.Register(opts);
+    opts->Register("buffer-size", &buffer_size, "Size of the buffer in which "
+                   "the examples are shuffled before they are merged into "
+                   "minibatches (as in nnet3-chain-shuffle-egs).");
+    opts->Register("num-minibatches", &num_minibatches, "Maximum number of "
+                   "minibatches that are generated ahead of the training.");
+    opts->Register("online-ivectors", &online_ivector_rspecifier,
+                   "Rspecifier of ivector features, as a matrix.");
+    opts->Register("online-ivector-period", &online_ivector_period, "Number "
+                   "of frames between iVectors in matrices supplied to the "
+                   "--online-ivectors option");
+    opts->Register("length-tolerance", &length_tolerance, "Tolerance for "
+                   "difference in num-frames between feat and ivector "
+                   "matrices");
+    opts->Register("supervision-length-tolerance",
+                   &supervision_length_tolerance, "Tolerance for difference "
+                   "in num-frames-subsampled between supervision and deriv "
+                   "weights, and also between supervision and input frames.");
+    opts->Register("deriv-weights-rspecifier", &deriv_weights_rspecifier,
+                   "Per-frame weights that scales a frame's gradient during "
+                   "backpropagation.");
+    opts->Register("normalization-fst", &normalization_fst_rxfilename,
+                   "The normalization FST (normally normalization.fst in the "
+                   "chain directory), which is composed with the supervision "
+                   "as in nnet3-chain-get-egs.");
+    opts->Register("normalization-fst-scale", &normalization_fst_scale,
+                   "Scale the weights from the 'normalization' FST before "
+                   "applying them to the examples.");
+  }
+};
+
+
+/**
+   This class generates the minibatches for 'chain' training on the fly from
+   the features and supervision (as output by chain-get-supervision), instead
+   of reading egs dumped by nnet3-chain-get-egs.  It does the work of the
+   pipeline
+     nnet3-chain-get-egs | nnet3-chain-shuffle-egs --buffer-size=N |
+        nnet3-chain-merge-egs
+   on background threads: a thread reads the input and splits the utterances
+   with an UtteranceSplitter, the egs of each utterance are created in
+   parallel by ChainExampleTask on a TaskSequencer, and they are shuffled in a
+   buffer and merged into minibatches by a ChainExampleMerger.  Up to
+   opts.num_minibatches minibatches are kept ahead of the caller.  As the
+   utterances are split afresh each time, with the random number generator,
+   each epoch of training can see differently split (or, with different
+   features, differently augmented) data without dumping it to disk.
+
+   The interface is like that of SequentialTableReader; errors in the
+   background thread are rethrown by Done().  Utterances are processed in
+   the order of the features, so the input should be shuffled at the
+   utterance level for training.
+*/
+class NnetChainExampleGenerator {
+ public:
+  NnetChainExampleGenerator(const NnetChainExampleGeneratorOptions &opts,
+                            const std::string &feature_rspecifier,
+                            const std::string &supervision_rspecifier);
+
+  /// Returns true if there are no more minibatches; waits for the background
+  /// threads if necessary.
+  bool Done();
+
+  /// The current minibatch; only valid if !Done().
+  const NnetChainExample &Value();
+
+  void Next();
+
+  ~NnetChainExampleGenerator();
+
+ private:
+  // Receives the egs of the utterances, in order, from the ChainExampleTasks
+  // and gives them to the merger in a random order.
+  class Shuffler: public ChainExampleConsumer {
+   public:
+    Shuffler(int32 buffer_size, ChainExampleMerger *merger):
+        buffer_size_(buffer_size), merger_(merger) { }
+    virtual void Accept(const std::string &key, NnetChainExample *eg);
+    // Gives the egs left in the buffer to the merger.
+    void Flush();
+   private:
+    int32 buffer_size_;
+    ChainExampleMerger *merger_;
+    std::vector<NnetChainExample*> buffer_;
+    // We use our own random state, because Accept() is called from the
+    // TaskSequencer's threads while the reading thread uses the global one.
+    RandomState rand_state_;
+  };
+
+  // Receives the minibatches from the merger and puts them in the queue.
+  class MinibatchSink: public ChainExampleConsumer {
+   public:
+    explicit MinibatchSink(NnetChainExampleGenerator *generator):
+        generator_(generator) { }
+    virtual void Accept(const std::string &key, NnetChainExample *eg) {
+      generator_->AddMinibatch(eg);
+    }
+   private:
+    NnetChainExampleGenerator *generator_;
+  };
+
+  // The function run by the background thread.
+  void GenerateExamples();
+
+  // Adds a minibatch to the queue, waiting while the queue is full.  Takes
+  // ownership of 'eg'.
+  void AddMinibatch(NnetChainExample *eg);
+
+  // Returns true if the destructor has asked the background thread to stop.
+  bool Stopped();
+
+  // A copy of the options, since we call ComputeDerived() on the configs.
+  NnetChainExampleGeneratorOptions opts_;
+  std::string feature_rspecifier_;
+  std::string supervision_rspecifier_;
+  fst::StdVectorFst normalization_fst_;
+
+  MinibatchSink sink_;
+  ChainExampleMerger merger_;
+  Shuffler shuffler_;
+
+  // The variables below are guarded by mutex_.
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::deque<NnetChainExample*> minibatches_;
+  bool finished_;  // true when the background thread has finished.
+  bool stop_;  // set by the destructor to tell the background thread to stop.
+  std::string error_;  // error message from the background thread, if any.
+
+  std::thread thread_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(NnetChainExampleGenerator);
+};
+
+
+} // namespace nnet3
+} // namespace kaldi
+
+#endif // KALDI_NNET3_NNET_CHAIN_EXAMPLE_GENERATOR_H_
@@ -248,6 +248,8 @@ static void MergeSupervision(
         output->deriv_weights(t * num_inputs + n) = src_deriv_weights(t);
       }
     }
+  } else {
+    output->deriv_weights.Resize(0);
   }
   output->CheckDim();
 }
@@ -256,6 +258,15 @@ static void MergeSupervision(
 void MergeChainExamples(bool compress,
                         std::vector<NnetChainExample> *input,
                         NnetChainExample *output) {
+  std::vector<Matrix<BaseFloat> > buffers;
+  output->inputs.clear();
+  MergeChainExamples(compress, input, &buffers, output);
+}
+
+void MergeChainExamples(bool compress,
+                        std::vector<NnetChainExample> *input,
+                        std::vector<Matrix<BaseFloat> > *buffers,
+                        NnetChainExample *output) {
   int32 num_examples = input->size();
   KALDI_ASSERT(num_examples > 0);
   // we temporarily make the input-features in 'input' look like regular NnetExamples,
@@ -263,8 +274,10 @@ void MergeChainExamples(bool compress,
   std::vector<NnetExample> eg_inputs(num_examples);
   for (int32 i = 0; i < num_examples; i++)
     eg_inputs[i].io.swap((*input)[i].inputs);
+  // start from the previous inputs of 'output', so their memory is reused.
   NnetExample eg_output;
-  MergeExamples(eg_inputs, compress, &eg_output);
+  eg_output.io.swap(output->inputs);
+  MergeExamples(eg_inputs, compress, buffers, &eg_output);
   // swap the inputs back so that they are not really changed.
   for (int32 i = 0; i < num_examples; i++)
     eg_inputs[i].io.swap((*input)[i].inputs);
@@ -453,7 +466,14 @@ int32 GetNnetChainExampleSize(const NnetChainExample &a) {
 ChainExampleMerger::ChainExampleMerger(const ExampleMergingConfig &config,
                                        NnetChainExampleWriter *writer):
     finished_(false), num_egs_written_(0),
-    config_(config), writer_(writer) { }
+    config_(config), writer_(writer), consumer_(NULL) { }
+
+ChainExampleMerger::ChainExampleMerger(const ExampleMergingConfig &config,
+                                       ChainExampleConsumer *consumer):
+    finished_(false), num_egs_written_(0),
+    config_(config), writer_(NULL), consumer_(consumer) {
+  KALDI_ASSERT(consumer != NULL);
+}
 
 
 void ChainExampleMerger::AcceptExample(NnetChainExample *eg) {
@@ -495,11 +515,19 @@ void ChainExampleMerger::WriteMinibatch(
   size_t structure_hash = eg_hasher((*egs)[0]);
   int32 minibatch_size = egs->size();
   stats_.WroteExample(eg_size, structure_hash, minibatch_size);
-  NnetChainExample merged_eg;
-  MergeChainExamples(config_.compress, egs, &merged_eg);
+  MergingBuffer &buffer =
+      buffers_[std::make_pair(structure_hash, minibatch_size)];
   std::ostringstream key;
   key << "merged-" << (num_egs_written_++) << "-" << minibatch_size;
-  writer_->Write(key.str(), merged_eg);
+  if (writer_ != NULL) {
+    MergeChainExamples(config_.compress, egs, &(buffer.features),
+                       &(buffer.eg));
+    writer_->Write(key.str(), buffer.eg);
+  } else {
+    NnetChainExample *eg = new NnetChainExample();
+    MergeChainExamples(config_.compress, egs, &(buffer.features), eg);
+    consumer_->Accept(key.str(), eg);
+  }
 }
 
 void ChainExampleMerger::Finish() {
@@ -173,6 +173,15 @@ void MergeChainExamples(bool compress,
                         std::vector<NnetChainExample> *input,
                         NnetChainExample *output);
 
+/// This version reuses the memory of the input features of 'output' (which
+/// would normally be the result of a previous call for examples of the same
+/// structure) and of 'buffers'; see the 2nd version of MergeExamples().  The
+/// supervision is merged as in the version above.
+void MergeChainExamples(bool compress,
+                        std::vector<NnetChainExample> *input,
+                        std::vector<Matrix<BaseFloat> > *buffers,
+                        NnetChainExample *output);
+
 
 
 /** Shifts the time-index t of everything in the input of "eg" by adding
@@ -228,6 +237,17 @@ typedef RandomAccessTableReader<KaldiObjectHolder<NnetChainExample > > RandomAcc
 int32 GetChainNnetExampleSize(const NnetChainExample &a);
 
 
+/// An interface for objects that take chain examples that are output in a
+/// sequence, e.g. by ChainExampleMerger, when they are not simply written to a
+/// table.
+class ChainExampleConsumer {
+ public:
+  /// Takes ownership of 'eg'.
+  virtual void Accept(const std::string &key, NnetChainExample *eg) = 0;
+  virtual ~ChainExampleConsumer() { }
+};
+
+
 /// This class is responsible for arranging examples in groups that have the
 /// same strucure (i.e. the same input and output indexes), and outputting them
 /// in suitable minibatches as defined by ExampleMergingConfig.
@@ -236,6 +256,12 @@ class ChainExampleMerger {
   ChainExampleMerger(const ExampleMergingConfig &config,
                      NnetChainExampleWriter *writer);
 
+  /// This version gives the merged examples to 'consumer' instead of writing
+  /// them to a table; it is used when the examples are generated during
+  /// training (see class NnetChainExampleGenerator).
+  ChainExampleMerger(const ExampleMergingConfig &config,
+                     ChainExampleConsumer *consumer);
+
   // This function accepts an example, and if possible, writes a merged example
   // out.  The ownership of the pointer 'a' is transferred to this class when
   // you call this function.
@@ -263,8 +289,20 @@ class ChainExampleMerger {
   int32 num_egs_written_;
   const ExampleMergingConfig &config_;
   NnetChainExampleWriter *writer_;
+  ChainExampleConsumer *consumer_;  // Used if writer_ is NULL.
   ExampleMergingStats stats_;
 
+  // The merged example and feature buffers for each (structure-hash,
+  // minibatch-size), which are reused as in class ExampleMerger.  When
+  // writing to a consumer, the merged examples are given away, so only the
+  // buffers are reused.
+  struct MergingBuffer {
+    NnetChainExample eg;
+    std::vector<Matrix<BaseFloat> > features;
+  };
+  unordered_map<std::pair<size_t, int32>, MergingBuffer,
+                PairHasher<size_t, int32> > buffers_;
+
   // Note: the "key" into the egs is the first element of the vector.
   typedef unordered_map<NnetChainExample*,
                         std::vector<NnetChainExample*>,
@@ -26,22 +26,31 @@ namespace nnet3 {
 
 NnetChainTrainer::NnetChainTrainer(const NnetChainTrainingOptions &opts,
                                    const fst::StdVectorFst &den_fst,
-                                   Nnet *nnet):
+                                   Nnet *nnet,
+                                   NnetDataParallel *parallel):
     opts_(opts),
     den_graph_(den_fst, nnet->OutputDim("output")),
     nnet_(nnet),
+    parallel_(parallel),
     compiler_(*nnet, opts_.nnet_config.optimize_config,
               opts_.nnet_config.compiler_config),
     num_minibatches_processed_(0),
     max_change_stats_(*nnet),
+    loss_scaler_(opts.nnet_config.loss_scale),
     srand_seed_(RandInt(0, 100000)) {
   if (opts.nnet_config.zero_component_stats)
     ZeroComponentStats(nnet);
   KALDI_ASSERT(opts.nnet_config.momentum >= 0.0 &&
                opts.nnet_config.max_param_change >= 0.0 &&
-               opts.nnet_config.backstitch_training_interval > 0);
+               opts.nnet_config.backstitch_training_interval > 0 &&
+               opts.nnet_config.loss_scale > 0.0);
   delta_nnet_ = nnet_->Copy();
   ScaleNnet(0.0, delta_nnet_);
+  // The natural-gradient preconditioners that are used are those in
+  // delta_nnet_.
+  if (opts.nnet_config.natural_gradient_max_update_period > 0)
+    SetNaturalGradientMaxUpdatePeriod(
+        opts.nnet_config.natural_gradient_max_update_period, delta_nnet_);
 
   if (opts.nnet_config.read_cache != "") {
     bool binary;
@@ -58,6 +67,16 @@ NnetChainTrainer::NnetChainTrainer(const NnetChainTrainingOptions &opts,
 
 
 void NnetChainTrainer::Train(const NnetChainExample &chain_eg) {
+  TrainMinibatch(chain_eg, NULL);
+}
+
+void NnetChainTrainer::Train(const NnetChainExample &chain_eg,
+                             const PrefetchedInputs &inputs) {
+  TrainMinibatch(chain_eg, &inputs);
+}
+
+void NnetChainTrainer::TrainMinibatch(const NnetChainExample &chain_eg,
+                                      const PrefetchedInputs *inputs) {
   bool need_model_derivative = true;
   const NnetTrainerOptions &nnet_config = opts_.nnet_config;
   bool use_xent_regularization = (opts_.chain_config.xent_regularize != 0.0);
@@ -77,15 +96,19 @@ void NnetChainTrainer::Train(const NnetChainExample &chain_eg) {
     bool is_backstitch_step1 = true;
     srand(srand_seed_ + num_minibatches_processed_);
     ResetGenerators(nnet_);
-    TrainInternalBackstitch(chain_eg, *computation, is_backstitch_step1);
+    TrainInternalBackstitch(chain_eg, inputs, *computation,
+                            is_backstitch_step1);
     FreezeNaturalGradient(false, delta_nnet_); // un-freeze natural gradient
     is_backstitch_step1 = false;
     srand(srand_seed_ + num_minibatches_processed_);
     ResetGenerators(nnet_);
-    TrainInternalBackstitch(chain_eg, *computation, is_backstitch_step1);
+    TrainInternalBackstitch(chain_eg, inputs, *computation,
+                            is_backstitch_step1);
   } else { // conventional training
-    TrainInternal(chain_eg, *computation);
+    TrainInternal(chain_eg, inputs, *computation);
   }
+  if (parallel_ != NULL)
+    parallel_->MinibatchDone(nnet_);
   if (num_minibatches_processed_ == 0) {
     ConsolidateMemory(nnet_);
     ConsolidateMemory(delta_nnet_);
@@ -94,6 +117,7 @@ void NnetChainTrainer::Train(const NnetChainExample &chain_eg) {
 }
 
 void NnetChainTrainer::TrainInternal(const NnetChainExample &eg,
+                                     const PrefetchedInputs *inputs,
                                      const NnetComputation &computation) {
   const NnetTrainerOptions &nnet_config = opts_.nnet_config;
   // note: because we give the 1st arg (nnet_) as a pointer to the
@@ -103,16 +127,36 @@ void NnetChainTrainer::TrainInternal(const NnetChainExample &eg,
                         nnet_, delta_nnet_);
 
   // give the inputs to the computer object.
-  computer.AcceptInputs(*nnet_, eg.inputs);
-  computer.Run();
+  if (inputs != NULL)
+    inputs->CopyToComputer(&computer);
+  else
+    computer.AcceptInputs(*nnet_, eg.inputs);
+  {
+    // Only the forward and backward passes use the tensor cores, if
+    // --use-tensor-cores=true; the chain computation is done in FP32.
+    CuTensorOpMathScope tensor_op_math(nnet_config.use_tensor_cores);
+    computer.Run();
+  }
 
   this->ProcessOutputs(false, eg, &computer);
-  computer.Run();
+  if (parallel_ != NULL)
+    parallel_->StartUpdate(delta_nnet_, &computer);
+  {
+    CuTensorOpMathScope tensor_op_math(nnet_config.use_tensor_cores);
+    computer.Run();
+  }
+
+  // If doing data-parallel training, average the parameter change over the
+  // workers; this was started during the backprop.
+  if (parallel_ != NULL)
+    parallel_->AverageUpdate(delta_nnet_);
 
   // If relevant, add in the part of the gradient that comes from
-  // parameter-level L2 regularization.
+  // parameter-level L2 regularization.  delta_nnet_ is multiplied by the loss
+  // scale, so this is too.
+  BaseFloat loss_scale = loss_scaler_.Scale();
   ApplyL2Regularization(*nnet_,
-                        GetNumNvalues(eg.inputs, false) *
+                        loss_scale * GetNumNvalues(eg.inputs, false) *
                         nnet_config.l2_regularize_factor,
                         delta_nnet_);
 
@@ -120,8 +164,9 @@ void NnetChainTrainer::TrainInternal(const NnetChainExample &eg,
   bool success = UpdateNnetWithMaxChange(
       *delta_nnet_,
       nnet_config.max_param_change,
-      1.0, 1.0 - nnet_config.momentum, nnet_,
+      1.0, (1.0 - nnet_config.momentum) / loss_scale, nnet_,
       &max_change_stats_);
+  BaseFloat loss_scale_change = loss_scaler_.UpdateDone(success);
 
   // Scale down the batchnorm stats (keeps them fresh... this affects what
   // happens when we use the model with batchnorm test-mode set).
@@ -133,12 +178,13 @@ void NnetChainTrainer::TrainInternal(const NnetChainExample &eg,
 
   // Scale delta_nnet
   if (success)
-    ScaleNnet(nnet_config.momentum, delta_nnet_);
+    ScaleNnet(nnet_config.momentum * loss_scale_change, delta_nnet_);
   else
     ScaleNnet(0.0, delta_nnet_);
 }
 
 void NnetChainTrainer::TrainInternalBackstitch(const NnetChainExample &eg,
+                                               const PrefetchedInputs *inputs,
                                                const NnetComputation &computation,
                                                bool is_backstitch_step1) {
   const NnetTrainerOptions &nnet_config = opts_.nnet_config;
@@ -148,13 +194,29 @@ void NnetChainTrainer::TrainInternalBackstitch(const NnetChainExample &eg,
   NnetComputer computer(nnet_config.compute_config, computation,
                         nnet_, delta_nnet_);
   // give the inputs to the computer object.
-  computer.AcceptInputs(*nnet_, eg.inputs);
-  computer.Run();
+  if (inputs != NULL)
+    inputs->CopyToComputer(&computer);
+  else
+    computer.AcceptInputs(*nnet_, eg.inputs);
+  {
+    CuTensorOpMathScope tensor_op_math(nnet_config.use_tensor_cores);
+    computer.Run();
+  }
 
   bool is_backstitch_step2 = !is_backstitch_step1;
   this->ProcessOutputs(is_backstitch_step2, eg, &computer);
-  computer.Run();
+  if (parallel_ != NULL)
+    parallel_->StartUpdate(delta_nnet_, &computer);
+  {
+    CuTensorOpMathScope tensor_op_math(nnet_config.use_tensor_cores);
+    computer.Run();
+  }
+
+  if (parallel_ != NULL)
+    parallel_->AverageUpdate(delta_nnet_);
 
+  // delta_nnet_ is multiplied by the loss scale.
+  BaseFloat loss_scale = loss_scaler_.Scale();
   BaseFloat max_change_scale, scale_adding;
   if (is_backstitch_step1) {
     // max-change is scaled by backstitch_training_scale;
@@ -171,15 +233,16 @@ void NnetChainTrainer::TrainInternalBackstitch(const NnetChainExample &eg,
     // passes of the backstitch, like we do here, but it probably minimizes
     // any harmful interactions with the max-change.
     ApplyL2Regularization(*nnet_,
-        1.0 / scale_adding * GetNumNvalues(eg.inputs, false) *
+        loss_scale / scale_adding * GetNumNvalues(eg.inputs, false) *
         nnet_config.l2_regularize_factor, delta_nnet_);
   }
 
   // Updates the parameters of nnet
-  UpdateNnetWithMaxChange(
+  bool success = UpdateNnetWithMaxChange(
       *delta_nnet_, nnet_config.max_param_change,
-      max_change_scale, scale_adding, nnet_,
+      max_change_scale, scale_adding / loss_scale, nnet_,
       &max_change_stats_);
+  loss_scaler_.UpdateDone(success);
 
   if (is_backstitch_step1) {
     // The following will only do something if we have a LinearComponent or
@@ -252,6 +315,9 @@ void NnetChainTrainer::ProcessOutputs(bool is_backstitch_step2,
       if (use_xent)
         xent_deriv.MulRowsVec(cu_deriv_weights);
     }
+    BaseFloat loss_scale = loss_scaler_.Scale();
+    if (loss_scale != 1.0)
+      nnet_output_deriv.Scale(loss_scale);
 
     computer->AcceptInput(sup.name, &nnet_output_deriv);
 
@@ -261,7 +327,7 @@ void NnetChainTrainer::ProcessOutputs(bool is_backstitch_step2,
                                      tot_weight, tot_objf, tot_l2_term);
 
     if (use_xent) {
-      xent_deriv.Scale(opts_.chain_config.xent_regularize);
+      xent_deriv.Scale(opts_.chain_config.xent_regularize * loss_scale);
       computer->AcceptInput(xent_name, &xent_deriv);
     }
   }
@@ -54,26 +54,41 @@ struct NnetChainTrainingOptions {
 */
 class NnetChainTrainer {
  public:
+  // If 'parallel' is non-NULL, it is used to average the parameter changes
+  // or the parameters with the other workers of data-parallel training (see
+  // class NnetDataParallel).
   NnetChainTrainer(const NnetChainTrainingOptions &config,
                    const fst::StdVectorFst &den_fst,
-                   Nnet *nnet);
+                   Nnet *nnet,
+                   NnetDataParallel *parallel = NULL);
 
   // train on one minibatch.
   void Train(const NnetChainExample &eg);
 
+  // train on one minibatch whose input features have already been copied to
+  // CuMatrix form, by class ExamplePrefetcher; 'inputs' are used instead of
+  // the input features of 'eg'.
+  void Train(const NnetChainExample &eg, const PrefetchedInputs &inputs);
+
   // Prints out the final stats, and return true if there was a nonzero count.
   bool PrintTotalStats() const;
 
   ~NnetChainTrainer();
  private:
+  // Called by the Train() functions; 'inputs' is NULL or as for Train().
+  void TrainMinibatch(const NnetChainExample &eg, const PrefetchedInputs *inputs);
+
   // The internal function for doing one step of conventional SGD training.
+  // 'inputs' is NULL or as for Train().
   void TrainInternal(const NnetChainExample &eg,
+                     const PrefetchedInputs *inputs,
                      const NnetComputation &computation);
 
   // The internal function for doing one step of backstitch training. Depending
   // on whether is_backstitch_step1 is true, It could be either the first
   // (backward) step, or the second (forward) step of backstitch.
   void TrainInternalBackstitch(const NnetChainExample &eg,
+                               const PrefetchedInputs *inputs,
                                const NnetComputation &computation,
                                bool is_backstitch_step1);
 
@@ -86,6 +101,7 @@ class NnetChainTrainer {
   Nnet *nnet_;
   Nnet *delta_nnet_;  // stores the change to the parameters on each training
                       // iteration.
+  NnetDataParallel *parallel_;  // not owned; may be NULL.
   CachingOptimizingCompiler compiler_;
 
   // This code supports multiple output layers, even though in the
@@ -96,6 +112,10 @@ class NnetChainTrainer {
   // stats for max-change.
   MaxChangeStats max_change_stats_;
 
+  // The scale on the derivatives in the backward pass; delta_nnet_ is
+  // multiplied by loss_scaler_.Scale().
+  LossScaler loss_scaler_;
+
   unordered_map<std::string, ObjectiveFunctionInfo, StringHasher> objf_info_;
 
   // This value is used in backstitch training when we need to ensure
@@ -24,6 +24,7 @@
 #include <algorithm>
 #include <iomanip>
 #include "nnet3/nnet-combined-component.h"
+#include "nnet3/nnet-simple-component.h"
 #include "nnet3/nnet-parse.h"
 #include "cudamatrix/cu-math.h"
 
@@ -1284,6 +1285,11 @@ void LstmNonlinearityComponent::FreezeNaturalGradient(bool freeze) {
   preconditioner_.Freeze(freeze);
 }
 
+void LstmNonlinearityComponent::SetNaturalGradientMaxUpdatePeriod(
+    int32 max_update_period) {
+  preconditioner_.SetMaxUpdatePeriod(max_update_period);
+}
+
 void LstmNonlinearityComponent::InitFromConfig(ConfigLine *cfl) {
   InitLearningRatesFromConfig(cfl);
   bool ok = true;
@@ -1843,6 +1849,12 @@ void GruNonlinearityComponent::FreezeNaturalGradient(bool freeze) {
   preconditioner_out_.Freeze(freeze);
 }
 
+void GruNonlinearityComponent::SetNaturalGradientMaxUpdatePeriod(
+    int32 max_update_period) {
+  preconditioner_in_.SetMaxUpdatePeriod(max_update_period);
+  preconditioner_out_.SetMaxUpdatePeriod(max_update_period);
+}
+
 GruNonlinearityComponent::GruNonlinearityComponent(
     const GruNonlinearityComponent &other):
     UpdatableComponent(other),
@@ -2313,6 +2325,11 @@ void OutputGruNonlinearityComponent::FreezeNaturalGradient(bool freeze) {
   preconditioner_.Freeze(freeze);
 }
 
+void OutputGruNonlinearityComponent::SetNaturalGradientMaxUpdatePeriod(
+    int32 max_update_period) {
+  preconditioner_.SetMaxUpdatePeriod(max_update_period);
+}
+
 OutputGruNonlinearityComponent::OutputGruNonlinearityComponent(
     const OutputGruNonlinearityComponent &other):
     UpdatableComponent(other),
@@ -2328,5 +2345,292 @@ OutputGruNonlinearityComponent::OutputGruNonlinearityComponent(
   Check();
 }
 
+
+LstmCellComponent::LstmCellComponent(const AffineComponent &affine,
+                                     const LstmNonlinearityComponent &lstm):
+    UpdatableComponent(affine),
+    affine_(dynamic_cast<AffineComponent*>(affine.Copy())),
+    lstm_(new LstmNonlinearityComponent(lstm)) {
+  Init();
+}
+
+LstmCellComponent::LstmCellComponent(const LstmCellComponent &other):
+    UpdatableComponent(other),
+    affine_(dynamic_cast<AffineComponent*>(other.affine_->Copy())),
+    lstm_(new LstmNonlinearityComponent(*other.lstm_)) { }
+
+LstmCellComponent::~LstmCellComponent() {
+  delete affine_;
+  delete lstm_;
+}
+
+void LstmCellComponent::Init() {
+  KALDI_ASSERT(affine_ != NULL && lstm_ != NULL);
+  int32 cell_dim = lstm_->OutputDim() / 2;
+  if (affine_->OutputDim() != 4 * cell_dim)
+    KALDI_ERR << "Output dim of the affine part of LstmCellComponent is "
+              << affine_->OutputDim() << ", expected " << (4 * cell_dim);
+  // The parts use our learning rate, like the components inside a
+  // CompositeComponent.
+  affine_->SetActualLearningRate(learning_rate_);
+  lstm_->SetActualLearningRate(learning_rate_);
+  if (is_gradient_) {
+    affine_->SetAsGradient();
+    lstm_->SetAsGradient();
+  }
+}
+
+int32 LstmCellComponent::InputDim() const {
+  return affine_->InputDim() + lstm_->InputDim() - affine_->OutputDim();
+}
+
+int32 LstmCellComponent::OutputDim() const {
+  return lstm_->OutputDim();
+}
+
+std::string LstmCellComponent::Info() const {
+  std::ostringstream stream;
+  stream << UpdatableComponent::Info()
+         << ", affine = { " << affine_->Info() << " }"
+         << ", lstm = { " << lstm_->Info() << " }";
+  return stream.str();
+}
+
+void LstmCellComponent::InitFromConfig(ConfigLine *cfl) {
+  InitLearningRatesFromConfig(cfl);
+  int32 input_dim = -1, cell_dim = -1;
+  bool use_natural_gradient = true, use_dropout = false;
+  bool ok = cfl->GetValue("input-dim", &input_dim) &&
+      cfl->GetValue("cell-dim", &cell_dim);
+  cfl->GetValue("use-natural-gradient", &use_natural_gradient);
+  cfl->GetValue("use-dropout", &use_dropout);
+  int32 affine_input_dim = input_dim - cell_dim - (use_dropout ? 3 : 0);
+  if (!ok || cell_dim <= 0 || affine_input_dim <= 0)
+    KALDI_ERR << "Invalid initializer for layer of type "
+              << Type() << ": \"" << cfl->WholeLine() << "\"";
+
+  std::ostringstream affine_config, lstm_config;
+  affine_config << "input-dim=" << affine_input_dim
+                << " output-dim=" << (4 * cell_dim);
+  lstm_config << "cell-dim=" << cell_dim
+              << " use-dropout=" << (use_dropout ? "true" : "false");
+  const char *affine_options[] = { "param-stddev", "bias-stddev", NULL },
+      *lstm_options[] = { "tanh-self-repair-threshold",
+                          "sigmoid-self-repair-threshold",
+                          "self-repair-scale", NULL };
+  std::string value;
+  for (const char **option = affine_options; *option != NULL; option++)
+    if (cfl->GetValue(*option, &value))
+      affine_config << ' ' << *option << '=' << value;
+  for (const char **option = lstm_options; *option != NULL; option++)
+    if (cfl->GetValue(*option, &value))
+      lstm_config << ' ' << *option << '=' << value;
+  if (cfl->HasUnusedValues())
+    KALDI_ERR << "Could not process these elements in initializer: "
+              << cfl->UnusedValues();
+
+  ConfigLine affine_line, lstm_line;
+  if (!affine_line.ParseLine(affine_config.str()) ||
+      !lstm_line.ParseLine(lstm_config.str()))
+    KALDI_ERR << "Invalid initializer for layer of type "
+              << Type() << ": \"" << cfl->WholeLine() << "\"";
+  delete affine_;
+  delete lstm_;
+  if (use_natural_gradient)
+    affine_ = new NaturalGradientAffineComponent();
+  else
+    affine_ = new AffineComponent();
+  affine_->InitFromConfig(&affine_line);
+  lstm_ = new LstmNonlinearityComponent();
+  lstm_->InitFromConfig(&lstm_line);
+  Init();
+}
+
+void* LstmCellComponent::Propagate(const ComponentPrecomputedIndexes *indexes,
+                                   const CuMatrixBase<BaseFloat> &in,
+                                   CuMatrixBase<BaseFloat> *out) const {
+  int32 num_rows = in.NumRows(),
+      affine_input_dim = affine_->InputDim(),
+      affine_output_dim = affine_->OutputDim(),
+      extra_dim = InputDim() - affine_input_dim;
+  // 'lstm_in' is the input of the nonlinearity: the output of the affine
+  // part, then c_{t-1} (and any dropout masks).
+  CuMatrix<BaseFloat> *lstm_in = new CuMatrix<BaseFloat>(
+      num_rows, lstm_->InputDim(), kUndefined);
+  CuSubMatrix<BaseFloat> affine_out(*lstm_in, 0, num_rows,
+                                    0, affine_output_dim);
+  affine_->Propagate(NULL, in.ColRange(0, affine_input_dim), &affine_out);
+  lstm_in->ColRange(affine_output_dim, extra_dim).CopyFromMat(
+      in.ColRange(affine_input_dim, extra_dim));
+  lstm_->Propagate(NULL, *lstm_in, out);
+  return lstm_in;
+}
+
+void LstmCellComponent::Backprop(const std::string &debug_info,
+                                 const ComponentPrecomputedIndexes *indexes,
+                                 const CuMatrixBase<BaseFloat> &in_value,
+                                 const CuMatrixBase<BaseFloat> &, // out_value
+                                 const CuMatrixBase<BaseFloat> &out_deriv,
+                                 void *memo,
+                                 Component *to_update_in,
+                                 CuMatrixBase<BaseFloat> *in_deriv) const {
+  KALDI_ASSERT(memo != NULL);
+  const CuMatrix<BaseFloat> &lstm_in =
+      *static_cast<const CuMatrix<BaseFloat>*>(memo);
+  LstmCellComponent *to_update = NULL;
+  if (to_update_in != NULL) {
+    to_update = dynamic_cast<LstmCellComponent*>(to_update_in);
+    KALDI_ASSERT(to_update != NULL);
+  }
+  int32 num_rows = in_value.NumRows(),
+      affine_input_dim = affine_->InputDim(),
+      affine_output_dim = affine_->OutputDim(),
+      extra_dim = InputDim() - affine_input_dim;
+  // The derivative w.r.t. the affine part's output is needed for its update
+  // even if in_deriv is NULL.
+  CuMatrix<BaseFloat> lstm_in_deriv(num_rows, lstm_->InputDim(), kUndefined);
+  lstm_->Backprop(debug_info, NULL, lstm_in, CuMatrix<BaseFloat>(), out_deriv,
+                  NULL, (to_update != NULL ? to_update->lstm_ : NULL),
+                  &lstm_in_deriv);
+  CuSubMatrix<BaseFloat> affine_out_deriv(lstm_in_deriv, 0, num_rows,
+                                          0, affine_output_dim);
+  if (in_deriv != NULL) {
+    CuSubMatrix<BaseFloat> affine_in_deriv(*in_deriv, 0, num_rows,
+                                           0, affine_input_dim);
+    // AffineComponent's backprop adds to in_deriv, like ours.
+    affine_->Backprop(debug_info, NULL, in_value.ColRange(0, affine_input_dim),
+                      CuMatrix<BaseFloat>(), affine_out_deriv, NULL,
+                      (to_update != NULL ? to_update->affine_ : NULL),
+                      &affine_in_deriv);
+    in_deriv->ColRange(affine_input_dim, extra_dim).AddMat(
+        1.0, lstm_in_deriv.ColRange(affine_output_dim, extra_dim));
+  } else if (to_update != NULL) {
+    affine_->Backprop(debug_info, NULL, in_value.ColRange(0, affine_input_dim),
+                      CuMatrix<BaseFloat>(), affine_out_deriv, NULL,
+                      to_update->affine_, NULL);
+  }
+}
+
+void LstmCellComponent::Read(std::istream &is, bool binary) {
+  ReadUpdatableCommon(is, binary);  // Read opening tag and learning rate.
+  ExpectToken(is, binary, "<Affine>");
+  delete affine_;
+  delete lstm_;
+  affine_ = NULL;
+  lstm_ = NULL;
+  Component *affine = ReadNew(is, binary);
+  affine_ = dynamic_cast<AffineComponent*>(affine);
+  if (affine_ == NULL) {
+    delete affine;
+    KALDI_ERR << "Expected an affine component in LstmCellComponent";
+  }
+  ExpectToken(is, binary, "<Lstm>");
+  Component *lstm = ReadNew(is, binary);
+  lstm_ = dynamic_cast<LstmNonlinearityComponent*>(lstm);
+  if (lstm_ == NULL) {
+    delete lstm;
+    KALDI_ERR << "Expected LstmNonlinearityComponent in LstmCellComponent";
+  }
+  ExpectToken(is, binary, "</LstmCellComponent>");
+  Init();
+}
+
+void LstmCellComponent::Write(std::ostream &os, bool binary) const {
+  WriteUpdatableCommon(os, binary);  // Write opening tag and learning rate.
+  WriteToken(os, binary, "<Affine>");
+  affine_->Write(os, binary);
+  WriteToken(os, binary, "<Lstm>");
+  lstm_->Write(os, binary);
+  WriteToken(os, binary, "</LstmCellComponent>");
+}
+
+Component* LstmCellComponent::Copy() const {
+  return new LstmCellComponent(*this);
+}
+
+void LstmCellComponent::SetUnderlyingLearningRate(BaseFloat lrate) {
+  UpdatableComponent::SetUnderlyingLearningRate(lrate);
+  affine_->SetActualLearningRate(learning_rate_);
+  lstm_->SetActualLearningRate(learning_rate_);
+}
+
+void LstmCellComponent::SetActualLearningRate(BaseFloat lrate) {
+  UpdatableComponent::SetActualLearningRate(lrate);
+  affine_->SetActualLearningRate(lrate);
+  lstm_->SetActualLearningRate(lrate);
+}
+
+void LstmCellComponent::SetAsGradient() {
+  UpdatableComponent::SetAsGradient();
+  affine_->SetAsGradient();
+  lstm_->SetAsGradient();
+}
+
+void LstmCellComponent::Scale(BaseFloat scale) {
+  affine_->Scale(scale);
+  lstm_->Scale(scale);
+}
+
+void LstmCellComponent::Add(BaseFloat alpha, const Component &other_in) {
+  const LstmCellComponent *other =
+      dynamic_cast<const LstmCellComponent*>(&other_in);
+  KALDI_ASSERT(other != NULL);
+  affine_->Add(alpha, *other->affine_);
+  lstm_->Add(alpha, *other->lstm_);
+}
+
+void LstmCellComponent::PerturbParams(BaseFloat stddev) {
+  affine_->PerturbParams(stddev);
+  lstm_->PerturbParams(stddev);
+}
+
+BaseFloat LstmCellComponent::DotProduct(
+    const UpdatableComponent &other_in) const {
+  const LstmCellComponent *other =
+      dynamic_cast<const LstmCellComponent*>(&other_in);
+  KALDI_ASSERT(other != NULL);
+  return affine_->DotProduct(*other->affine_) +
+      lstm_->DotProduct(*other->lstm_);
+}
+
+int32 LstmCellComponent::NumParameters() const {
+  return affine_->NumParameters() + lstm_->NumParameters();
+}
+
+void LstmCellComponent::Vectorize(VectorBase<BaseFloat> *params) const {
+  int32 affine_size = affine_->NumParameters();
+  SubVector<BaseFloat> affine_part(*params, 0, affine_size),
+      lstm_part(*params, affine_size, params->Dim() - affine_size);
+  affine_->Vectorize(&affine_part);
+  lstm_->Vectorize(&lstm_part);
+}
+
+void LstmCellComponent::UnVectorize(const VectorBase<BaseFloat> &params) {
+  int32 affine_size = affine_->NumParameters();
+  affine_->UnVectorize(params.Range(0, affine_size));
+  lstm_->UnVectorize(params.Range(affine_size, params.Dim() - affine_size));
+}
+
+void LstmCellComponent::ZeroStats() {
+  affine_->ZeroStats();
+  lstm_->ZeroStats();
+}
+
+void LstmCellComponent::FreezeNaturalGradient(bool freeze) {
+  affine_->FreezeNaturalGradient(freeze);
+  lstm_->FreezeNaturalGradient(freeze);
+}
+
+void LstmCellComponent::SetNaturalGradientMaxUpdatePeriod(
+    int32 max_update_period) {
+  affine_->SetNaturalGradientMaxUpdatePeriod(max_update_period);
+  lstm_->SetNaturalGradientMaxUpdatePeriod(max_update_period);
+}
+
+void LstmCellComponent::ConsolidateMemory() {
+  affine_->ConsolidateMemory();
+  lstm_->ConsolidateMemory();
+}
+
 } // namespace nnet3
 } // namespace kaldi
@@ -372,6 +372,7 @@ class LstmNonlinearityComponent: public UpdatableComponent {
   virtual void UnVectorize(const VectorBase<BaseFloat> &params);
   virtual void ZeroStats();
   virtual void FreezeNaturalGradient(bool freeze);
+  virtual void SetNaturalGradientMaxUpdatePeriod(int32 max_update_period);
 
   // Some functions that are specific to this class:
   explicit LstmNonlinearityComponent(
@@ -443,6 +444,119 @@ class LstmNonlinearityComponent: public UpdatableComponent {
 };
 
 
+class AffineComponent;
+
+/**
+  LstmCellComponent is the recurrent affine transform of an LSTM layer (the
+  "W_all" component of the "lstmp" and "fast-lstmp" xconfig layers) together
+  with the LstmNonlinearityComponent that follows it.  Its input is the input
+  of the affine part (i.e. the layer input and the recurrent input r_{t-1}),
+  followed by what the LstmNonlinearityComponent takes in addition to the
+  output of the affine part, i.e. c_{t-1} and, if use-dropout=true, the three
+  dropout masks; its output is that of the LstmNonlinearityComponent, i.e.
+  (c_t, m_t).
+
+  Having one component instead of two means that, per time step, the
+  computation has one command instead of two, and that the output of the
+  affine part (of dimension 4C) is a temporary inside the component instead of
+  a matrix of the computation; this matters most in looped decoding, where each
+  step works on only a few frames.  The affine output is kept as the memo for
+  the backprop.
+
+  You would not normally create this component from a config file; the edit
+  directive 'fuse-lstm-cells' (see ReadEditConfig() and FuseLstmCells() in
+  nnet-utils.h) converts existing LSTM layers to it.
+
+  Configuration values accepted:
+     input-dim            The total input dimension.  The affine part has
+                          input dimension input-dim - cell-dim (minus 3 more if
+                          use-dropout=true).
+     cell-dim             The cell dimension C.  The output dimension is 2C.
+     use-natural-gradient If true (the default), the affine part is a
+                          NaturalGradientAffineComponent, else an
+                          AffineComponent.
+     param-stddev, bias-stddev   Passed to the affine part.
+     use-dropout, tanh-self-repair-threshold, sigmoid-self-repair-threshold,
+     self-repair-scale    Passed to the LstmNonlinearityComponent part.
+*/
+class LstmCellComponent: public UpdatableComponent {
+ public:
+  virtual int32 InputDim() const;
+  virtual int32 OutputDim() const;
+  virtual std::string Info() const;
+  virtual void InitFromConfig(ConfigLine *cfl);
+  LstmCellComponent(): affine_(NULL), lstm_(NULL) { }
+  virtual std::string Type() const { return "LstmCellComponent"; }
+  virtual int32 Properties() const {
+    return kSimpleComponent|kUpdatableComponent|kBackpropNeedsInput|
+        kBackpropAdds|kUsesMemo;
+  }
+
+  virtual void* Propagate(const ComponentPrecomputedIndexes *indexes,
+                         const CuMatrixBase<BaseFloat> &in,
+                         CuMatrixBase<BaseFloat> *out) const;
+  virtual void Backprop(const std::string &debug_info,
+                        const ComponentPrecomputedIndexes *indexes,
+                        const CuMatrixBase<BaseFloat> &in_value,
+                        const CuMatrixBase<BaseFloat> &, // out_value,
+                        const CuMatrixBase<BaseFloat> &out_deriv,
+                        void *memo,
+                        Component *to_update_in,
+                        CuMatrixBase<BaseFloat> *in_deriv) const;
+  virtual void DeleteMemo(void *memo) const {
+    delete static_cast<CuMatrix<BaseFloat>*>(memo);
+  }
+
+  virtual void Read(std::istream &is, bool binary);
+  virtual void Write(std::ostream &os, bool binary) const;
+
+  virtual Component* Copy() const;
+
+  // Some functions from base-class UpdatableComponent.
+  virtual void SetUnderlyingLearningRate(BaseFloat lrate);
+  virtual void SetActualLearningRate(BaseFloat lrate);
+  virtual void SetAsGradient();
+  virtual void Scale(BaseFloat scale);
+  virtual void Add(BaseFloat alpha, const Component &other);
+  virtual void PerturbParams(BaseFloat stddev);
+  virtual BaseFloat DotProduct(const UpdatableComponent &other) const;
+  virtual int32 NumParameters() const;
+  virtual void Vectorize(VectorBase<BaseFloat> *params) const;
+  virtual void UnVectorize(const VectorBase<BaseFloat> &params);
+  virtual void ZeroStats();
+  virtual void FreezeNaturalGradient(bool freeze);
+  virtual void SetNaturalGradientMaxUpdatePeriod(int32 max_update_period);
+  virtual void ConsolidateMemory();
+
+  // Some functions that are specific to this class:
+
+  /// Makes the component from copies of these two; the learning-rate and
+  /// related values are taken from 'affine'.  The output dimension of
+  /// 'affine' must be 4 times the cell dimension of 'lstm'.
+  LstmCellComponent(const AffineComponent &affine,
+                    const LstmNonlinearityComponent &lstm);
+
+  explicit LstmCellComponent(const LstmCellComponent &other);
+
+  const AffineComponent &Affine() const { return *affine_; }
+  const LstmNonlinearityComponent &Lstm() const { return *lstm_; }
+
+  virtual ~LstmCellComponent();
+
+ private:
+  // Checks the dimensions and sets the learning rates of the parts to ours.
+  void Init();
+
+  // The affine part; an AffineComponent or a NaturalGradientAffineComponent.
+  AffineComponent *affine_;
+  // The nonlinearity part.
+  LstmNonlinearityComponent *lstm_;
+
+  const LstmCellComponent &operator
+      = (const LstmCellComponent &other); // Disallow.
+};
+
+
 
 
 /*
@@ -751,6 +865,7 @@ class GruNonlinearityComponent: public UpdatableComponent {
   virtual void UnVectorize(const VectorBase<BaseFloat> &params);
   virtual void ZeroStats();
   virtual void FreezeNaturalGradient(bool freeze);
+  virtual void SetNaturalGradientMaxUpdatePeriod(int32 max_update_period);
 
   // Some functions that are specific to this class:
   explicit GruNonlinearityComponent(
@@ -1017,6 +1132,7 @@ class OutputGruNonlinearityComponent: public UpdatableComponent {
   virtual void UnVectorize(const VectorBase<BaseFloat> &params);
   virtual void ZeroStats();
   virtual void FreezeNaturalGradient(bool freeze);
+  virtual void SetNaturalGradientMaxUpdatePeriod(int32 max_update_period);
 
   // Some functions that are specific to this class:
   explicit OutputGruNonlinearityComponent(
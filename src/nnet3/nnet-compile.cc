@@ -96,7 +96,7 @@ void Compiler::CreateComputation(const CompilerOptions &opts,
   std::vector<bool> deriv_needed;
   ComputeDerivNeeded(steps, step_to_segment, &deriv_needed);
   CreateStepInfo(deriv_needed, step_to_segment, &steps, computation);
-  AddCommands(deriv_needed, step_to_segment, computation);
+  AddCommands(opts, deriv_needed, step_to_segment, computation);
   // the following command reorders commands so kAcceptInput and kProvideOutput
   // appear in the desired places.
   ConsolidateIoOperations(nnet_, computation);
@@ -104,7 +104,8 @@ void Compiler::CreateComputation(const CompilerOptions &opts,
     OutputDebugInfo(computation);
 }
 
-void Compiler::AddCommands(const std::vector<bool> &deriv_needed,
+void Compiler::AddCommands(const CompilerOptions &opts,
+                           const std::vector<bool> &deriv_needed,
                            const std::vector<int32> &step_to_segment,
                            NnetComputation *computation) {
   computation->need_model_derivative = requests_[0]->need_model_derivative;
@@ -115,7 +116,8 @@ void Compiler::AddCommands(const std::vector<bool> &deriv_needed,
   std::vector<int32> whole_submatrices;
   computation->GetWholeSubmatrices(&whole_submatrices);
   AllocateMatrices(whole_submatrices, computation);
-  SetUpPrecomputedIndexes(step_to_segment, computation);
+  SetUpPrecomputedIndexes(step_to_segment,
+                          opts.store_precomputed_indexes_info, computation);
   int32 num_steps = steps_.size();
   for (int32 step = 0; step < num_steps; step++) {
     CompileForward(step, computation);
@@ -1238,6 +1240,7 @@ void Compiler::AllocateMatrices(const std::vector<int32> &whole_submatrices,
 
 void Compiler::SetUpPrecomputedIndexes(
     const std::vector<int32> &step_to_segment,
+    bool store_indexes_info,
     NnetComputation *computation) {
   int32 num_steps = steps_.size();
   KALDI_ASSERT(computation->component_precomputed_indexes.empty());
@@ -1276,12 +1279,14 @@ void Compiler::SetUpPrecomputedIndexes(
       NnetComputation::PrecomputedIndexesInfo info;
       info.data = precomputed_indexes;
 
-      if (!input_indexes.empty() && input_indexes.back().n == 1 &&
-          !output_indexes.empty() && output_indexes.back().n == 1) {
+      if (store_indexes_info ||
+          (!input_indexes.empty() && input_indexes.back().n == 1 &&
+           !output_indexes.empty() && output_indexes.back().n == 1)) {
         // If these conditions are true, it's *possible* that we are doing
         // 'shortcut' compilation.  So just in case that's what's going on, we
         // store 'input_indexes' and 'output_indexes, which are needed by
-        // the ExpandComputation() function that is used in that process.
+        // the ExpandComputation() function that is used in that process
+        // (and by ExtrapolateComputation()).
         info.input_indexes = input_indexes;
         info.output_indexes = output_indexes;
       }
@@ -33,8 +33,14 @@ namespace nnet3 {
 
 struct CompilerOptions {
   bool output_debug_info;
-
-  CompilerOptions(): output_debug_info(true) { }
+  // If true, the 'input_indexes' and 'output_indexes' of each
+  // PrecomputedIndexesInfo in the computation are always stored, not just when
+  // the computation might be expanded by ExpandComputation(); this is needed
+  // for 'time shortcut' compilation (see ExtrapolateComputation()).
+  bool store_precomputed_indexes_info;
+
+  CompilerOptions(): output_debug_info(true),
+                     store_precomputed_indexes_info(false) { }
 };
 
 /// This class creates an initial version of the NnetComputation, without any
@@ -176,8 +182,11 @@ class Compiler {
                         NnetComputation *computation) const;
 
   // Sets up the precomputed indexes for each component, and sets the
-  // precomputed_indexes_index value for each step.
+  // precomputed_indexes_index value for each step.  If 'store_indexes_info' is
+  // true, the input and output Indexes are always stored with them (see
+  // CompilerOptions::store_precomputed_indexes_info).
   void SetUpPrecomputedIndexes(const std::vector<int32> &step_to_segment,
+                               bool store_indexes_info,
                                NnetComputation *computation);
 
   // Adds to "computation" the command(s) for the forward computation
@@ -419,7 +428,8 @@ class Compiler {
   // sets up the debug_info member of "computation".
   void OutputDebugInfo(NnetComputation *computation) const;
 
-  void AddCommands(const std::vector<bool> &deriv_needed,
+  void AddCommands(const CompilerOptions &opts,
+                   const std::vector<bool> &deriv_needed,
                    const std::vector<int32> &step_to_segment,
                    NnetComputation *computation);
 
@@ -28,6 +28,8 @@
 #include "nnet3/nnet-general-component.h"
 #include "nnet3/nnet-convolutional-component.h"
 #include "nnet3/nnet-attention-component.h"
+#include "nnet3/nnet-quantized-component.h"
+#include "nnet3/nnet-sparse-component.h"
 #include "nnet3/nnet-parse.h"
 #include "nnet3/nnet-computation-graph.h"
 
@@ -141,6 +143,12 @@ Component* Component::NewComponentOfType(const std::string &component_type) {
     ans = new ConvolutionComponent();
   } else if (component_type == "TdnnComponent") {
     ans = new TdnnComponent();
+  } else if (component_type == "QuantizedAffineComponent") {
+    ans = new QuantizedAffineComponent();
+  } else if (component_type == "QuantizedTdnnComponent") {
+    ans = new QuantizedTdnnComponent();
+  } else if (component_type == "SparseAffineComponent") {
+    ans = new SparseAffineComponent();
   } else if (component_type == "MaxpoolingComponent") {
     ans = new MaxpoolingComponent();
   } else if (component_type == "PermuteComponent") {
@@ -175,6 +183,8 @@ Component* Component::NewComponentOfType(const std::string &component_type) {
     ans = new BackpropTruncationComponent();
   } else if (component_type == "LstmNonlinearityComponent") {
     ans = new LstmNonlinearityComponent();
+  } else if (component_type == "LstmCellComponent") {
+    ans = new LstmCellComponent();
   } else if (component_type == "BatchNormComponent") {
     ans = new BatchNormComponent();
   } else if (component_type == "TimeHeightConvolutionComponent") {
@@ -330,6 +340,17 @@ void UpdatableComponent::WriteUpdatableCommon(std::ostream &os,
 }
 
 
+void UpdatableComponent::CuVectorize(CuVectorBase<BaseFloat> *params) const {
+  Vector<BaseFloat> temp(params->Dim(), kUndefined);
+  Vectorize(&temp);
+  params->CopyFromVec(temp);
+}
+
+void UpdatableComponent::CuUnVectorize(const CuVectorBase<BaseFloat> &params) {
+  Vector<BaseFloat> temp(params);
+  UnVectorize(temp);
+}
+
 std::string UpdatableComponent::Info() const {
   std::stringstream stream;
   stream << Type() << ", input-dim=" << InputDim()
@@ -501,6 +501,11 @@ class UpdatableComponent: public Component {
   /// by components that use Natural Gradient).
   virtual void FreezeNaturalGradient(bool freeze) { }
 
+  /// Sets the maximum update period of the natural-gradient preconditioners,
+  /// if applicable (see OnlineNaturalGradient::SetMaxUpdatePeriod(); to be
+  /// overridden by components that use Natural Gradient).
+  virtual void SetNaturalGradientMaxUpdatePeriod(int32 max_update_period) { }
+
   /// Gets the learning rate to be used in gradient descent.
   BaseFloat LearningRate() const { return learning_rate_; }
 
@@ -538,6 +543,14 @@ class UpdatableComponent: public Component {
     KALDI_ASSERT(0);
   }
 
+  /// Versions of Vectorize() and UnVectorize() for a vector on the GPU (if
+  /// we are using one), used to average the parameters or their derivatives
+  /// over GPUs in multi-GPU training.  The default implementations go via a
+  /// vector on the CPU; components with a lot of parameters override them to
+  /// avoid that copy.
+  virtual void CuVectorize(CuVectorBase<BaseFloat> *params) const;
+  virtual void CuUnVectorize(const CuVectorBase<BaseFloat> &params);
+
  protected:
   // to be called from child classes, extracts any learning rate information
   // from the config line and sets them appropriately.
@@ -101,6 +101,18 @@ void TestNnetComponentVectorizeUnVectorize(Component *c) {
   KALDI_ASSERT(ApproxEqual(x, y) && ApproxEqual(y, z));
   Vector<BaseFloat> params2(uc2->NumParameters());
   uc2->Vectorize(&params2);
+  for(int i = 0; i < params.Dim(); i++)
+    KALDI_ASSERT(params(i) == params2(i));
+
+  // The versions for a CuVector should give the same vector form.
+  CuVector<BaseFloat> cu_params(uc2->NumParameters());
+  uc->CuVectorize(&cu_params);
+  Vector<BaseFloat> params3(cu_params);
+  for(int i = 0; i < params.Dim(); i++)
+    KALDI_ASSERT(params(i) == params3(i));
+  uc2->Scale(0.0);
+  uc2->CuUnVectorize(cu_params);
+  uc2->Vectorize(&params2);
   for(int i = 0; i < params.Dim(); i++)
     KALDI_ASSERT(params(i) == params2(i));
   delete uc2;
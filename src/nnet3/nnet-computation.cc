@@ -549,7 +549,12 @@ static void PrintCommand(std::ostream &os_out,
       if (c.arg2 == 0) os << "NULL, ";
       else os << "precomputed_indexes[" << c.arg2 << "], ";
       os << submatrix_strings[c.arg3] << ", &" << submatrix_strings[c.arg4]
-         << ")\n";
+         << ")";
+      if (c.arg7 >= 0)
+        os << "; " << nnet.GetComponentName(c.arg7) << ".Propagate(NULL, "
+           << submatrix_strings[c.arg4] << ", &" << submatrix_strings[c.arg4]
+           << ")";
+      os << "\n";
       break;
     case kBackprop:
     case kBackpropNoModelUpdate: {
@@ -859,8 +864,16 @@ void NnetComputation::Read(std::istream &is, bool binary) {
   ExpectToken(is, binary, "<NeedModelDerivative>");
   ReadBasicType(is, binary, &need_model_derivative);
 
+  ReadToken(is, binary, &token);
+  if (token == "<WorkspaceOffsets>") {
+    ReadIntegerVector(is, binary, &workspace_offsets);
+    ReadToken(is, binary, &token);
+  } else {
+    workspace_offsets.clear();
+  }
+  if (token != "</NnetComputation>")
+    KALDI_ERR << "Expected token </NnetComputation>, got " << token;
   ComputeCudaIndexes();
-  ExpectToken(is, binary, "</NnetComputation>");
 }
 
 void NnetComputation::Write(std::ostream &os, bool binary) const {
@@ -937,6 +950,10 @@ void NnetComputation::Write(std::ostream &os, bool binary) const {
   if (!binary) os << std::endl;
   WriteToken(os, binary, "<NeedModelDerivative>");
   WriteBasicType(os, binary, need_model_derivative);
+  if (!workspace_offsets.empty()) {
+    WriteToken(os, binary, "<WorkspaceOffsets>");
+    WriteIntegerVector(os, binary, workspace_offsets);
+  }
   WriteToken(os, binary, "</NnetComputation>");
   if (!binary) os << std::endl;
 }
@@ -981,6 +998,29 @@ bool NnetComputation::IsWholeMatrix(int32 submatrix_index) const {
       submat_info.num_cols == mat_info.num_cols;
 }
 
+int32 NnetComputation::WorkspaceStride(int32 matrix_index) const {
+  KALDI_ASSERT(static_cast<size_t>(matrix_index) < matrices.size());
+  const MatrixInfo &info = matrices[matrix_index];
+  if (info.stride_type == kStrideEqualNumCols)
+    return info.num_cols;
+  // Round up to a multiple of 16 floats (64 bytes) so that rows start at a
+  // cache-line boundary.
+  return (info.num_cols + 15) & ~15;
+}
+
+int32 NnetComputation::WorkspaceSize() const {
+  int64 ans = 0;
+  for (size_t m = 0; m < workspace_offsets.size(); m++) {
+    if (workspace_offsets[m] >= 0) {
+      int64 end = workspace_offsets[m] + static_cast<int64>(
+          matrices[m].num_rows) * WorkspaceStride(m);
+      ans = std::max(ans, end);
+    }
+  }
+  KALDI_ASSERT(ans <= std::numeric_limits<int32>::max());
+  return static_cast<int32>(ans);
+}
+
 bool NnetComputation::SubMatrixInfo::operator== (
     const NnetComputation::SubMatrixInfo &other) const {
   return matrix_index == other.matrix_index &&
@@ -1142,7 +1182,8 @@ NnetComputation::NnetComputation(const NnetComputation &other):
     commands(other.commands),
     need_model_derivative(other.need_model_derivative),
     indexes_cuda(other.indexes_cuda),
-    indexes_ranges_cuda(other.indexes_ranges_cuda) {
+    indexes_ranges_cuda(other.indexes_ranges_cuda),
+    workspace_offsets(other.workspace_offsets) {
   for (size_t i = 1; i < component_precomputed_indexes.size(); i++)
     component_precomputed_indexes[i].data =
         component_precomputed_indexes[i].data->Copy();
@@ -1159,6 +1200,7 @@ NnetComputation& NnetComputation::operator = (const NnetComputation &other) {
   need_model_derivative = other.need_model_derivative;
   indexes_cuda = other.indexes_cuda;
   indexes_ranges_cuda = other.indexes_ranges_cuda;
+  workspace_offsets = other.workspace_offsets;
 
   for (size_t i = 1; i < component_precomputed_indexes.size(); i++)
     delete component_precomputed_indexes[i].data;
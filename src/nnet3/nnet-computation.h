@@ -205,6 +205,9 @@ struct ComputationRequestPtrEqual {
      - arg6 is 1 if we need to call StoreStats() after the Propagate, or 0
        if we don't.  We used to have a separate command for storing the
        stats, but that has been removed.
+     - arg7 is the index of a simple component that must be propagated in place
+       on the output after the main component (see FusePropagateCommands() in
+       nnet-optimize-utils.h), or -1 if there is none.
    - kBackprop: Do the back-propagation operation, see Component::Backprop()
      - arg1 is index of component in neural net
      - arg2 is index into ComponentPrecomputedIndexes (0 if NULL; always 0
@@ -447,6 +450,16 @@ struct NnetComputation {
   // computed from "indexes_ranges" by ComputeCudaIndexes().
   std::vector<CuArray<Int32Pair> > indexes_ranges_cuda;
 
+  // The static memory plan, set by ComputeMemoryPlan() (see
+  // nnet-optimize-utils.h); empty if there is no plan.  If nonempty it has the
+  // same size as 'matrices', and workspace_offsets[m] >= 0 means that matrix m
+  // is stored at that offset (in BaseFloats) in a single workspace of size
+  // WorkspaceSize() that NnetComputer allocates once, with row stride
+  // WorkspaceStride(m); the kAllocMatrix and kDeallocMatrix commands for such
+  // matrices then do nothing.  workspace_offsets[m] == -1 means that matrix m
+  // is allocated in the normal way.
+  std::vector<int32> workspace_offsets;
+
 
   /// Convenience function used when adding new matrices.  Writes to
   /// 'this->matrices' and 'this->submatrices'; and if 'this->matrix_debug_info'
@@ -468,6 +481,14 @@ struct NnetComputation {
   // submatrix_index must be > 0.
   bool IsWholeMatrix(int32 submatrix_index) const;
 
+  // Returns the row stride with which matrix 'matrix_index' would be stored in
+  // the workspace (see workspace_offsets).
+  int32 WorkspaceStride(int32 matrix_index) const;
+
+  // Returns the size in BaseFloats of the workspace required by the static
+  // memory plan, or 0 if there is no plan (see workspace_offsets).
+  int32 WorkspaceSize() const;
+
   // This must be called after setting up the computation but prior to actually
   // using the Computation object in a computation, to compute CUDA versions of
   // the indexes.
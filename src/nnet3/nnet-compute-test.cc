@@ -144,6 +144,36 @@ void TestNnetDecodable(Nnet *nnet) {
   }
 }
 
+// Records the calls of DerivativeComplete().
+class TestDerivObserver: public ComponentDerivObserver {
+ public:
+  virtual void DerivativeComplete(int32 component_index) {
+    components.push_back(component_index);
+  }
+  std::vector<int32> components;
+};
+
+// Returns the components that a TestDerivObserver should have been told
+// about after the backward computation.
+static void GetExpectedDerivComponents(const Nnet &nnet,
+                                       const NnetComputation &computation,
+                                       std::vector<int32> *components) {
+  components->clear();
+  if (!computation.need_model_derivative)
+    return;
+  for (size_t i = 0; i < computation.commands.size(); i++) {
+    const NnetComputation::Command &c = computation.commands[i];
+    if (c.command_type == kGotoLabel) {
+      components->clear();
+      return;
+    }
+    if (c.command_type == kBackprop &&
+        (nnet.GetComponent(c.arg1)->Properties() & kUpdatableComponent))
+      components->push_back(c.arg1);
+  }
+  SortAndUniq(components);
+}
+
 void UnitTestNnetCompute() {
   for (int32 n = 0; n < 20; n++) {
     struct NnetGenerationOptions gen_config;
@@ -218,6 +248,8 @@ void UnitTestNnetCompute() {
     NnetComputeOptions compute_opts;
     if (RandInt(0, 1) == 0)
       compute_opts.debug = true;
+    if (RandInt(0, 1) == 0)
+      compute_opts.profile = true;
 
     computation.ComputeCudaIndexes();
     NnetComputer computer(compute_opts,
@@ -232,6 +264,22 @@ void UnitTestNnetCompute() {
 
     }
     computer.Run();
+    if (compute_opts.profile) {
+      // Each propagate command should have been recorded under the type of
+      // its component (followed by that of a fused component, if any).
+      std::map<std::string, NnetComputeProfile::Entry> entries =
+          NnetComputeProfile::Global().Entries();
+      for (size_t i = 0; i < computation.commands.size(); i++) {
+        const NnetComputation::Command &c = computation.commands[i];
+        if (c.command_type != kPropagate)
+          continue;
+        std::string name = "Propagate " + nnet.GetComponent(c.arg1)->Type();
+        std::map<std::string, NnetComputeProfile::Entry>::iterator iter =
+            entries.lower_bound(name);
+        KALDI_ASSERT(iter != entries.end() &&
+                     iter->first.compare(0, name.size(), name) == 0);
+      }
+    }
 
 
     const CuMatrixBase<BaseFloat> &output(computer.GetOutput("output"));
@@ -257,12 +305,42 @@ void UnitTestNnetCompute() {
       }
     }
 
+    bool has_random_component = false;
+    for (int32 c = 0; c < nnet.NumComponents(); c++)
+      if (nnet.GetComponent(c)->Properties() & kRandomComponent)
+        has_random_component = true;
+    if (!has_random_component) {
+      // Executing the commands on several threads should give the same
+      // output.
+      NnetComputeOptions parallel_compute_opts;
+      parallel_compute_opts.num_threads = RandInt(2, 4);
+      NnetComputer computer_parallel(parallel_compute_opts,
+                                     computation, nnet, &nnet);
+      for (size_t i = 0; i < request.inputs.size(); i++) {
+        CuMatrix<BaseFloat> temp(inputs[i]);
+        computer_parallel.AcceptInput(request.inputs[i].name, &temp);
+      }
+      computer_parallel.Run();
+      const CuMatrixBase<BaseFloat> &output_parallel(
+          computer_parallel.GetOutput("output"));
+      KALDI_LOG << "Output sum [parallel] is " << output_parallel.Sum();
+      if (!output.ApproxEqual(output_parallel, 0.0))
+        KALDI_ERR << "Sequential and parallel computations' outputs differ";
+    }
+
     CuMatrix<BaseFloat> output_deriv(output.NumRows(), output.NumCols());
     output_deriv.SetRandn();
     // output_deriv sum won't be informative so don't print it.
     if (request.outputs[0].has_deriv) {
+      TestDerivObserver observer;
+      computer.SetDerivObserver(&observer);
       computer.AcceptInput("output", &output_deriv);
       computer.Run();
+      std::vector<int32> expected_components, observed_components =
+          observer.components;
+      GetExpectedDerivComponents(nnet, computation, &expected_components);
+      std::sort(observed_components.begin(), observed_components.end());
+      KALDI_ASSERT(observed_components == expected_components);
       for (size_t i = 0; i < request.inputs.size(); i++) {
         if (request.inputs[i].has_deriv) {
           const CuMatrixBase<BaseFloat> &in_deriv =
@@ -276,6 +354,33 @@ void UnitTestNnetCompute() {
   }
 }
 
+void UnitTestNnetComputeProfile() {
+  NnetComputeProfile profile;
+  profile.Add("Propagate AffineComponent", 0.5, 2.0e+09, 1.0e+08);
+  profile.Add("Propagate AffineComponent", 0.5, 2.0e+09, 1.0e+08);
+  profile.Add("AddRows", 0.25, 1.0e+06, 3.0e+06);
+  std::map<std::string, NnetComputeProfile::Entry> entries =
+      profile.Entries();
+  KALDI_ASSERT(entries.size() == 2);
+  const NnetComputeProfile::Entry &affine =
+      entries["Propagate AffineComponent"];
+  KALDI_ASSERT(affine.count == 2 && affine.seconds == 1.0 &&
+               affine.flops == 4.0e+09 && affine.bytes == 2.0e+08);
+
+  std::ostringstream table, json;
+  profile.Print(table);
+  profile.WriteJson(json);
+  KALDI_LOG << "Profile is:\n" << table.str() << json.str();
+  // The table is sorted by decreasing time.
+  KALDI_ASSERT(table.str().find("Propagate AffineComponent") <
+               table.str().find("AddRows"));
+  KALDI_ASSERT(json.str().find("\"AddRows\": {\"count\": 1, "
+                               "\"seconds\": 0.25, \"flops\": 1000000, "
+                               "\"bytes\": 3000000}") != std::string::npos);
+  profile.Clear();
+  KALDI_ASSERT(profile.Empty());
+}
+
 } // namespace nnet3
 } // namespace kaldi
 
@@ -297,6 +402,7 @@ int main() {
 #endif
     UnitTestNnetCompute();
   }
+  UnitTestNnetComputeProfile();
 
   KALDI_LOG << "Nnet tests succeeded.";
 
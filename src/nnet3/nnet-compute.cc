@@ -17,9 +17,16 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iomanip>
 #include <iterator>
+#include <mutex>
 #include <sstream>
 #include "nnet3/nnet-compute.h"
+#include "util/kaldi-thread.h"
 
 namespace kaldi {
 namespace nnet3 {
@@ -31,7 +38,7 @@ NnetComputer::NnetComputer(const NnetComputeOptions &options,
                            Nnet *nnet_to_update):
     options_(options), computation_(computation), nnet_(nnet),
     program_counter_(0), nnet_to_store_stats_(nnet_to_update),
-    nnet_to_update_(nnet_to_update) {
+    nnet_to_update_(nnet_to_update), deriv_observer_(NULL) {
   Init();
 }
 
@@ -41,7 +48,7 @@ NnetComputer::NnetComputer(const NnetComputeOptions &options,
                            Nnet *nnet_to_update):
     options_(options), computation_(computation), nnet_(*nnet),
     program_counter_(0), nnet_to_store_stats_(nnet),
-    nnet_to_update_(nnet_to_update) {
+    nnet_to_update_(nnet_to_update), deriv_observer_(NULL) {
   Init();
 }
 
@@ -51,6 +58,11 @@ void NnetComputer::Init() {
                "You must call NnetComputation::ComputeCudaIndexes() before "
                "executing the computation.");
   matrices_.resize(computation_.matrices.size());
+  if (!computation_.workspace_offsets.empty()) {
+    KALDI_ASSERT(computation_.workspace_offsets.size() ==
+                 computation_.matrices.size());
+    workspace_.Resize(computation_.WorkspaceSize(), kUndefined);
+  }
   debug_ = (options_.debug || GetVerboseLevel() >= 5);
   if (debug_) {
     ComputationVariables variables;
@@ -61,6 +73,23 @@ void NnetComputer::Init() {
     computation_.GetCommandStrings(nnet_, &preamble, &command_strings_);
     KALDI_LOG << preamble;
     computation_.GetSubmatrixStrings(nnet_, &submatrix_strings_);
+  } else if (options_.num_threads > 1 && !options_.profile) {
+    ComputeCommandDependencies(nnet_, computation_, &command_dependencies_);
+    int32 num_commands = computation_.commands.size();
+    random_commands_.resize(num_commands, false);
+    for (int32 i = 0; i < num_commands; i++) {
+      const NnetComputation::Command &c = computation_.commands[i];
+      if (c.command_type == kPropagate || c.command_type == kBackprop ||
+          c.command_type == kBackpropNoModelUpdate)
+        random_commands_[i] =
+            ((nnet_.GetComponent(c.arg1)->Properties() & kRandomComponent) ||
+             (c.command_type == kPropagate && c.arg7 >= 0 &&
+              (nnet_.GetComponent(c.arg7)->Properties() & kRandomComponent)));
+    }
+#if HAVE_CUDA == 1
+    if (CuDevice::Instantiate().Enabled())
+      CuDevice::Instantiate().AllowMultithreading();
+#endif
   }
 }
 
@@ -88,7 +117,7 @@ void NnetComputer::DebugBeforeExecute(int32 command,
     info->matrices_written_stddevs.resize(size);
     for (size_t i = 0; i < size; i++) {
       int32 m = matrices_written[i];
-      info->matrices_written_stddevs[i] = MatrixStddev(matrices_[m]);
+      info->matrices_written_stddevs[i] = MatrixStddev(GetWholeMatrix(m));
     }
   }
   {
@@ -126,7 +155,7 @@ void NnetComputer::DebugAfterExecute(int32 command,
     for (size_t i = 0; i < size; i++) {
       int32 m = matrices_written[i];
       BaseFloat old_stddev = info.matrices_written_stddevs[i],
-          stddev = MatrixStddev(matrices_[m]);
+          stddev = MatrixStddev(GetWholeMatrix(m));
       os << 'm' << m << ": " << old_stddev << "->" << stddev << " ";
     }
   }
@@ -199,29 +228,39 @@ NnetComputer::NnetComputer(const NnetComputer &other):
     submatrix_strings_(other.submatrix_strings_),
     command_strings_(other.command_strings_),
     matrices_(other.matrices_),
-    memos_(other.memos_) {
-  // Note: this is the same as the default copy constructor, except for the check below.
-  if (!memos_.empty()) {
-    KALDI_ERR << "You cannot use the copy constructor of NnetComputer if "
-        "memos are used.";
+    workspace_(other.workspace_),
+    memos_(other.memos_),
+    command_dependencies_(other.command_dependencies_),
+    random_commands_(other.random_commands_),
+    deriv_observer_(other.deriv_observer_),
+    deriv_complete_components_(other.deriv_complete_components_) {
+  // Note: this is the same as the default copy constructor, except for the
+  // check below (memos_ may have been resized by ExecuteCommandsParallel()
+  // without any memos being stored), and that the CUDA events are not copied.
+  for (size_t i = 0; i < memos_.size(); i++) {
+    if (memos_[i] != NULL)
+      KALDI_ERR << "You cannot use the copy constructor of NnetComputer if "
+          "memos are used.";
   }
 }
 
-void NnetComputer::ExecuteCommand() {
-  const NnetComputation::Command &c = computation_.commands[program_counter_];
+void NnetComputer::ExecuteCommand(int32 command_index) {
+  const NnetComputation::Command &c = computation_.commands[command_index];
   int32 m1, m2;
   try {
     switch (c.command_type) {
       case kAllocMatrix:
         m1 = computation_.submatrices[c.arg1].matrix_index;
-        matrices_[m1].Resize(computation_.matrices[m1].num_rows,
-                             computation_.matrices[m1].num_cols,
-                             kUndefined,
-                             computation_.matrices[m1].stride_type);
+        if (!InWorkspace(m1))
+          matrices_[m1].Resize(computation_.matrices[m1].num_rows,
+                               computation_.matrices[m1].num_cols,
+                               kUndefined,
+                               computation_.matrices[m1].stride_type);
         break;
       case kDeallocMatrix:
         m1 = computation_.submatrices[c.arg1].matrix_index;
-        matrices_[m1].Resize(0, 0);
+        if (!InWorkspace(m1))
+          matrices_[m1].Resize(0, 0);
         break;
       case kSwapMatrix:
         m1 = computation_.submatrices[c.arg1].matrix_index;
@@ -252,6 +291,9 @@ void NnetComputer::ExecuteCommand() {
           stats_component->StoreStats(maybe_input, output, memo);
         }
         SaveMemo(c.arg5, *component, memo);
+        if (c.arg7 >= 0)  // a fused in-place component; see
+                          // FusePropagateCommands().
+          nnet_.GetComponent(c.arg7)->Propagate(NULL, output, &output);
         break;
       }
       case kBackprop:
@@ -430,18 +472,191 @@ void NnetComputer::ExecuteCommand() {
         KALDI_ERR << "Invalid command in computation";
     }
   } catch (...) {
-    if (!debug_) {
+    // the lock is in case commands fail on several threads at a time.
+    static std::mutex error_mutex;
+    std::lock_guard<std::mutex> lock(error_mutex);
+    if (!debug_ && command_strings_.empty()) {
       std::string preamble;
       computation_.GetCommandStrings(nnet_, &preamble, &command_strings_);
       KALDI_WARN << "Printing some background info since error was detected";
       KALDI_LOG << preamble;
-      for (int32 prev_c = 0; prev_c < program_counter_; prev_c++)
+      for (int32 prev_c = 0; prev_c < command_index; prev_c++)
         KALDI_LOG << command_strings_[prev_c];
     }
     // the following will re-throw the error, but now we've printed more info
     // about what went wrong.
-    KALDI_ERR << "Error running command " << command_strings_[program_counter_];
+    KALDI_ERR << "Error running command " << command_strings_[command_index];
+  }
+}
+
+
+struct NnetComputer::ParallelState {
+  NnetComputer *computer;
+  int32 begin, end;
+  std::mutex mutex;
+  std::condition_variable cond;
+  // Indexed by command index minus 'begin': the number of dependencies of
+  // the command in this range that have not finished yet, and the commands
+  // in this range that depend on it.
+  std::vector<int32> num_pending;
+  std::vector<std::vector<int32> > dependents;
+  // The commands whose dependencies have all finished.
+  std::deque<int32> ready;
+  int32 num_done, num_running, num_helpers;
+  bool error;
+#if HAVE_CUDA == 1
+  // Recorded on the stream of the calling thread before any of the commands,
+  // for the other threads to wait for.
+  cudaEvent_t start_event;
+#endif
+};
+
+
+// static
+void NnetComputer::ParallelWorker(std::shared_ptr<ParallelState> state,
+                                  bool is_caller) {
+  ParallelState &s = *state;
+  int32 num_commands = s.end - s.begin;
+  std::unique_lock<std::mutex> lock(s.mutex);
+#if HAVE_CUDA == 1
+  if (!is_caller && !s.error && s.num_done < num_commands &&
+      !s.computer->command_events_.empty())
+    CU_SAFE_CALL(cudaStreamWaitEvent(GetCudaStream(), s.start_event, 0));
+#endif
+  // Note: s.computer may only be used before all the commands are done, as
+  // the calling thread may return after that.
+  while (!s.error && s.num_done < num_commands) {
+    NnetComputer *computer = s.computer;
+    std::deque<int32>::iterator iter = s.ready.begin();
+    if (!is_caller)  // Random commands are run by the calling thread.
+      while (iter != s.ready.end() && computer->random_commands_[*iter])
+        ++iter;
+    if (iter == s.ready.end()) {
+      if (!is_caller)
+        break;  // The other threads never wait, so they can't block the pool.
+      s.cond.wait(lock);
+      continue;
+    }
+    int32 command_index = *iter;
+    s.ready.erase(iter);
+    s.num_running++;
+    if (!s.ready.empty() &&
+        s.num_helpers + 1 < computer->options_.num_threads) {
+      s.num_helpers++;
+      GlobalThreadPool().Submit(std::bind(&NnetComputer::ParallelWorker,
+                                          state, false),
+                                ThreadPool::kHighPriority);
+    }
+    lock.unlock();
+    bool ok = true;
+    try {
+#if HAVE_CUDA == 1
+      if (!computer->command_events_.empty()) {
+        const std::vector<int32> &deps =
+            computer->command_dependencies_[command_index];
+        for (size_t i = 0; i < deps.size(); i++)
+          if (deps[i] >= s.begin)
+            CU_SAFE_CALL(cudaStreamWaitEvent(
+                GetCudaStream(), computer->command_events_[deps[i]], 0));
+      }
+#endif
+      computer->ExecuteCommand(command_index);
+#if HAVE_CUDA == 1
+      if (!computer->command_events_.empty())
+        CU_SAFE_CALL(cudaEventRecord(computer->command_events_[command_index],
+                                     GetCudaStream()));
+#endif
+    } catch (...) {
+      ok = false;  // ExecuteCommand() has printed the error.
+    }
+    lock.lock();
+    s.num_running--;
+    if (ok) {
+      s.num_done++;
+      const std::vector<int32> &dependents =
+          s.dependents[command_index - s.begin];
+      for (size_t i = 0; i < dependents.size(); i++)
+        if (--s.num_pending[dependents[i] - s.begin] == 0)
+          s.ready.push_back(dependents[i]);
+    } else {
+      s.error = true;
+    }
+    s.cond.notify_all();
+  }
+  if (!is_caller)
+    s.num_helpers--;
+}
+
+
+void NnetComputer::ExecuteCommandsParallel(int32 begin, int32 end) {
+  const std::vector<NnetComputation::Command> &c = computation_.commands;
+  // The memos and compressed matrices are stored in vectors which may not be
+  // resized while the commands run.
+  int32 max_memo_index = 0;
+  for (int32 i = begin; i < end; i++)
+    if (c[i].command_type == kPropagate)
+      max_memo_index = std::max(max_memo_index, c[i].arg5);
+  if (memos_.size() <= static_cast<size_t>(max_memo_index))
+    memos_.resize(max_memo_index + 1, NULL);
+  if (compressed_matrices_.empty())
+    compressed_matrices_.resize(matrices_.size(), NULL);
+
+  std::shared_ptr<ParallelState> state(new ParallelState());
+  ParallelState &s = *state;
+  s.computer = this;
+  s.begin = begin;
+  s.end = end;
+  s.num_pending.resize(end - begin, 0);
+  s.dependents.resize(end - begin);
+  for (int32 i = begin; i < end; i++) {
+    const std::vector<int32> &deps = command_dependencies_[i];
+    for (size_t j = 0; j < deps.size(); j++) {
+      if (deps[j] >= begin) {
+        s.num_pending[i - begin]++;
+        s.dependents[deps[j] - begin].push_back(i);
+      }
+    }
+    if (s.num_pending[i - begin] == 0)
+      s.ready.push_back(i);
+  }
+  s.num_done = 0;
+  s.num_running = 0;
+  s.num_helpers = 0;
+  s.error = false;
+
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled()) {
+    if (command_events_.empty()) {
+      command_events_.resize(c.size());
+      for (size_t i = 0; i < command_events_.size(); i++)
+        CU_SAFE_CALL(cudaEventCreateWithFlags(&(command_events_[i]),
+                                              cudaEventDisableTiming));
+    }
+    CU_SAFE_CALL(cudaEventCreateWithFlags(&s.start_event,
+                                          cudaEventDisableTiming));
+    CU_SAFE_CALL(cudaEventRecord(s.start_event, GetCudaStream()));
   }
+#endif
+
+  ParallelWorker(state, true);
+
+  std::unique_lock<std::mutex> lock(s.mutex);
+  while (s.num_running > 0)
+    s.cond.wait(lock);
+#if HAVE_CUDA == 1
+  if (!command_events_.empty()) {
+    // Make the stream of this thread wait for the work of the other threads;
+    // it's enough to wait for the commands that no other command depends on.
+    for (int32 i = begin; i < end; i++)
+      if (s.dependents[i - begin].empty())
+        CU_SAFE_CALL(cudaStreamWaitEvent(GetCudaStream(),
+                                         command_events_[i], 0));
+    // The other threads have all waited for it (or will never do so).
+    CU_SAFE_CALL(cudaEventDestroy(s.start_event));
+  }
+#endif
+  if (s.error)
+    KALDI_ERR << "Error executing the computation on multiple threads.";
 }
 
 CuSubMatrix<BaseFloat> NnetComputer::GetSubMatrix(int32 submatrix_index) {
@@ -449,11 +664,32 @@ CuSubMatrix<BaseFloat> NnetComputer::GetSubMatrix(int32 submatrix_index) {
                         computation_.submatrices.size());
   const NnetComputation::SubMatrixInfo &info =
       computation_.submatrices[submatrix_index];
+  if (InWorkspace(info.matrix_index)) {
+    int32 stride = computation_.WorkspaceStride(info.matrix_index);
+    const BaseFloat *data = workspace_.Data() +
+        computation_.workspace_offsets[info.matrix_index] +
+        static_cast<size_t>(info.row_offset) * stride + info.col_offset;
+    return CuSubMatrix<BaseFloat>(data, info.num_rows, info.num_cols, stride);
+  }
   const CuMatrix<BaseFloat> &mat = matrices_[info.matrix_index];
   return CuSubMatrix<BaseFloat>(
       mat, info.row_offset, info.num_rows, info.col_offset, info.num_cols);
 }
 
+CuSubMatrix<BaseFloat> NnetComputer::GetWholeMatrix(int32 matrix_index) {
+  if (InWorkspace(matrix_index)) {
+    const NnetComputation::MatrixInfo &info =
+        computation_.matrices[matrix_index];
+    return CuSubMatrix<BaseFloat>(
+        workspace_.Data() + computation_.workspace_offsets[matrix_index],
+        info.num_rows, info.num_cols,
+        computation_.WorkspaceStride(matrix_index));
+  }
+  return CuSubMatrix<BaseFloat>(matrices_[matrix_index], 0,
+                                matrices_[matrix_index].NumRows(), 0,
+                                matrices_[matrix_index].NumCols());
+}
+
 void NnetComputer::GetPointers(int32 indexes_multi_index,
                                int32 num_cols,
                                CuArray<BaseFloat*> *pointers) {
@@ -508,6 +744,7 @@ void NnetComputer::GetPointers(int32 indexes_multi_index,
 }
 
 void NnetComputer::Run() {
+  KALDI_TRACE_SCOPE("NnetComputer::Run");
   const std::vector<NnetComputation::Command> &c = computation_.commands;
   int32 num_commands = c.size();
 
@@ -529,9 +766,30 @@ void NnetComputer::Run() {
       // interaction, e.g. the end of the forward or backward phase.
       break;
     }
+    if (!command_dependencies_.empty() &&
+        c[program_counter_].command_type != kGotoLabel) {
+      // Execute the commands up to the next I/O or kGotoLabel command in
+      // parallel.
+      int32 end = program_counter_ + 1;
+      while (end < num_commands && c[end].command_type != kAcceptInput &&
+             c[end].command_type != kProvideOutput &&
+             c[end].command_type != kGotoLabel)
+        end++;
+      if (end - program_counter_ > 1) {
+        ExecuteCommandsParallel(program_counter_, end);
+        for (; program_counter_ < end - 1; program_counter_++)
+          NotifyDerivObserver(program_counter_);
+        NotifyDerivObserver(program_counter_);
+        continue;
+      }
+    }
     if (debug_)
       DebugBeforeExecute(program_counter_, &info);
-    ExecuteCommand();
+    if (options_.profile)
+      ExecuteCommandProfiled(program_counter_);
+    else
+      ExecuteCommand(program_counter_);
+    NotifyDerivObserver(program_counter_);
     if (debug_) {
       double total_elapsed_now = timer.Elapsed();
       DebugAfterExecute(program_counter_, info,
@@ -541,6 +799,37 @@ void NnetComputer::Run() {
   }
 }
 
+void NnetComputer::SetDerivObserver(ComponentDerivObserver *observer) {
+  deriv_observer_ = NULL;
+  deriv_complete_components_.clear();
+  if (observer == NULL || nnet_to_update_ == NULL ||
+      !computation_.need_model_derivative)
+    return;
+  const std::vector<NnetComputation::Command> &c = computation_.commands;
+  int32 num_commands = c.size();
+  // last_backprop[component] is the index of the last kBackprop command for
+  // that component, or -1.
+  std::vector<int32> last_backprop(nnet_.NumComponents(), -1);
+  for (int32 i = 0; i < num_commands; i++) {
+    if (c[i].command_type == kGotoLabel)
+      return;
+    if (c[i].command_type == kBackprop &&
+        (nnet_.GetComponent(c[i].arg1)->Properties() & kUpdatableComponent))
+      last_backprop[c[i].arg1] = i;
+  }
+  KALDI_ASSERT(program_counter_ <= num_commands);
+  deriv_complete_components_.resize(num_commands);
+  for (int32 component = 0; component < nnet_.NumComponents(); component++) {
+    int32 command = last_backprop[component];
+    if (command >= 0) {
+      KALDI_ASSERT(command >= program_counter_ &&
+                   "SetDerivObserver() called too late");
+      deriv_complete_components_[command].push_back(component);
+    }
+  }
+  deriv_observer_ = observer;
+}
+
 void NnetComputer::AcceptInput(const std::string &node_name,
                                CuMatrix<BaseFloat> *input) {
   bool is_output = false;
@@ -674,6 +963,310 @@ void NnetComputer::AcceptInputs(const Nnet &nnet,
   }
 }
 
+void NnetComputer::WriteState(std::ostream &os, bool binary) const {
+  for (size_t i = 0; i < memos_.size(); i++)
+    if (memos_[i] != NULL)
+      KALDI_ERR << "Cannot write the state of NnetComputer while memos are "
+                << "held.";
+  for (size_t i = 0; i < compressed_matrices_.size(); i++)
+    if (compressed_matrices_[i] != NULL)
+      KALDI_ERR << "Cannot write the state of NnetComputer while matrices "
+                << "are compressed.";
+  WriteToken(os, binary, "<NnetComputerState>");
+  WriteToken(os, binary, "<ProgramCounter>");
+  WriteBasicType(os, binary, program_counter_);
+  WriteToken(os, binary, "<PendingCommands>");
+  WriteIntegerVector(os, binary, pending_commands_);
+  WriteToken(os, binary, "<Matrices>");
+  WriteBasicType(os, binary, static_cast<int32>(matrices_.size()));
+  for (size_t i = 0; i < matrices_.size(); i++)
+    matrices_[i].Write(os, binary);
+  WriteToken(os, binary, "<Workspace>");
+  workspace_.Write(os, binary);
+  WriteToken(os, binary, "</NnetComputerState>");
+}
+
+void NnetComputer::ReadState(std::istream &is, bool binary) {
+  ExpectToken(is, binary, "<NnetComputerState>");
+  ExpectToken(is, binary, "<ProgramCounter>");
+  ReadBasicType(is, binary, &program_counter_);
+  ExpectToken(is, binary, "<PendingCommands>");
+  ReadIntegerVector(is, binary, &pending_commands_);
+  ExpectToken(is, binary, "<Matrices>");
+  int32 num_matrices;
+  ReadBasicType(is, binary, &num_matrices);
+  if (num_matrices != static_cast<int32>(matrices_.size()) ||
+      program_counter_ < 0 ||
+      program_counter_ > static_cast<int32>(computation_.commands.size()))
+    KALDI_ERR << "The state read does not match the computation.";
+  for (int32 m = 0; m < num_matrices; m++) {
+    CuMatrix<BaseFloat> mat;
+    mat.Read(is, binary);
+    if (mat.NumRows() != 0 &&
+        computation_.matrices[m].stride_type == kStrideEqualNumCols) {
+      // Read() does not give us the stride that the computation relies on.
+      matrices_[m].Resize(mat.NumRows(), mat.NumCols(), kUndefined,
+                          kStrideEqualNumCols);
+      matrices_[m].CopyFromMat(mat);
+    } else {
+      matrices_[m].Swap(&mat);
+    }
+  }
+  ExpectToken(is, binary, "<Workspace>");
+  CuVector<BaseFloat> workspace;
+  workspace.Read(is, binary);
+  if (workspace.Dim() != workspace_.Dim())
+    KALDI_ERR << "The state read does not match the computation.";
+  workspace_.Swap(&workspace);
+  ExpectToken(is, binary, "</NnetComputerState>");
+}
+
+int64 NnetComputer::MemoryUsage() const {
+  int64 ans = static_cast<int64>(workspace_.Dim()) * sizeof(BaseFloat);
+  for (size_t m = 0; m < matrices_.size(); m++)
+    ans += static_cast<int64>(matrices_[m].NumRows()) *
+        matrices_[m].Stride() * sizeof(BaseFloat);
+  return ans;
+}
+
+// Returns the name under which commands of type 'command_type', other than
+// propagate and backprop commands, are profiled.
+static const char *CommandTypeName(CommandType command_type) {
+  switch (command_type) {
+    case kAllocMatrix: return "AllocMatrix";
+    case kDeallocMatrix: return "DeallocMatrix";
+    case kSwapMatrix: return "SwapMatrix";
+    case kSetConst: return "SetConst";
+    case kMatrixCopy: return "MatrixCopy";
+    case kMatrixAdd: return "MatrixAdd";
+    case kCopyRows: return "CopyRows";
+    case kAddRows: return "AddRows";
+    case kCopyRowsMulti: return "CopyRowsMulti";
+    case kCopyToRowsMulti: return "CopyToRowsMulti";
+    case kAddRowsMulti: return "AddRowsMulti";
+    case kAddToRowsMulti: return "AddToRowsMulti";
+    case kAddRowRanges: return "AddRowRanges";
+    case kCompressMatrix: return "CompressMatrix";
+    case kDecompressMatrix: return "DecompressMatrix";
+    default: return "Other";
+  }
+}
+
+void NnetComputer::GetCommandCost(const NnetComputation::Command &c,
+                                  std::string *name, double *flops,
+                                  double *bytes) const {
+  const std::vector<NnetComputation::SubMatrixInfo> &submatrices =
+      computation_.submatrices;
+  // The zeroth submatrix is empty, so unused arguments count as nothing.
+  int32 args[7] = { c.arg1, c.arg2, c.arg3, c.arg4, c.arg5, c.arg6, c.arg7 };
+  double value_size = sizeof(BaseFloat);
+  *flops = 0.0;
+  *bytes = 0.0;
+  switch (c.command_type) {
+    case kPropagate: case kBackprop: case kBackpropNoModelUpdate: {
+      const Component *component = nnet_.GetComponent(c.arg1);
+      bool is_propagate = (c.command_type == kPropagate);
+      *name = (is_propagate ? "Propagate " : "Backprop ") + component->Type();
+      // For propagate the submatrices are arg3 and arg4 (input and output);
+      // for backprop, arg3 through arg6 (input and output values and
+      // derivatives).
+      int32 last_arg = (is_propagate ? 4 : 6), num_rows = 0;
+      for (int32 i = 3; i <= last_arg; i++) {
+        const NnetComputation::SubMatrixInfo &info = submatrices[args[i - 1]];
+        *bytes += value_size * info.num_rows * info.num_cols;
+        num_rows = std::max(num_rows, info.num_rows);
+      }
+      const UpdatableComponent *uc =
+          dynamic_cast<const UpdatableComponent*>(component);
+      if (uc != NULL) {
+        // A multiply-add per parameter per row, e.g. for an affine component
+        // 2 * rows * input-dim * output-dim; the backprop does this once for
+        // the input derivative and once for the parameter derivative.
+        double num_params = uc->NumParameters(),
+            num_products = 1.0;
+        if (!is_propagate)
+          num_products = (c.arg6 != 0) +
+              (c.command_type == kBackprop &&
+               computation_.need_model_derivative);
+        *flops = 2.0 * num_rows * num_params * num_products;
+        *bytes += value_size * num_params;
+      } else {
+        // Assume one operation per element of the output (or input
+        // derivative) for nonlinearities and the like.
+        const NnetComputation::SubMatrixInfo &info =
+            submatrices[is_propagate ? c.arg4 : c.arg6];
+        *flops = static_cast<double>(info.num_rows) * info.num_cols;
+      }
+      if (is_propagate && c.arg7 >= 0) {
+        // A fused in-place component (see FusePropagateCommands()).
+        *name += "+" + nnet_.GetComponent(c.arg7)->Type();
+        const NnetComputation::SubMatrixInfo &info = submatrices[c.arg4];
+        *flops += static_cast<double>(info.num_rows) * info.num_cols;
+      }
+      return;
+    }
+    default:
+      break;
+  }
+  *name = CommandTypeName(c.command_type);
+  const NnetComputation::SubMatrixInfo &info = submatrices[c.arg1];
+  double dest_elements = static_cast<double>(info.num_rows) * info.num_cols;
+  switch (c.command_type) {
+    case kSetConst:
+      *bytes = value_size * dest_elements;
+      break;
+    case kMatrixCopy: case kCopyRows: case kCopyRowsMulti:
+    case kCopyToRowsMulti:
+      // Read one matrix and write the other.
+      *bytes = 2.0 * value_size * dest_elements;
+      break;
+    case kMatrixAdd: case kAddRows: case kAddRowsMulti: case kAddToRowsMulti:
+      // Read both matrices and write one.
+      *flops = 2.0 * dest_elements;
+      *bytes = 3.0 * value_size * dest_elements;
+      break;
+    case kAddRowRanges: {
+      // Each output row is the sum of a range of input rows.
+      const NnetComputation::SubMatrixInfo &src = submatrices[c.arg2];
+      double src_elements = static_cast<double>(src.num_rows) * src.num_cols;
+      *flops = src_elements;
+      *bytes = value_size * (src_elements + 2.0 * dest_elements);
+      break;
+    }
+    case kCompressMatrix: case kDecompressMatrix: {
+      // We count only the uncompressed side.
+      const NnetComputation::MatrixInfo &m =
+          computation_.matrices[info.matrix_index];
+      *bytes = value_size * m.num_rows * m.num_cols;
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+void NnetComputer::ExecuteCommandProfiled(int32 command_index) {
+  const NnetComputation::Command &c = computation_.commands[command_index];
+  switch (c.command_type) {
+    case kNoOperation: case kNoOperationPermanent: case kNoOperationMarker:
+    case kNoOperationLabel: case kGotoLabel:
+      ExecuteCommand(command_index);
+      return;
+    default:
+      break;
+  }
+  // We wait for the GPU before and after the command so that the time is
+  // that of the command itself.
+#if HAVE_CUDA == 1
+  bool use_gpu = CuDevice::Instantiate().Enabled();
+  if (use_gpu)
+    CU_SAFE_CALL(cudaStreamSynchronize(GetCudaStream()));
+#endif
+  Timer timer;
+  ExecuteCommand(command_index);
+#if HAVE_CUDA == 1
+  if (use_gpu)
+    CU_SAFE_CALL(cudaStreamSynchronize(GetCudaStream()));
+#endif
+  double seconds = timer.Elapsed();
+  std::string name;
+  double flops, bytes;
+  GetCommandCost(c, &name, &flops, &bytes);
+  NnetComputeProfile::Global().Add(name, seconds, flops, bytes);
+}
+
+
+NnetComputeProfile &NnetComputeProfile::Global() {
+  static NnetComputeProfile profile;
+  return profile;
+}
+
+void NnetComputeProfile::Add(const std::string &name, double seconds,
+                             double flops, double bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Entry &entry = entries_[name];
+  entry.count++;
+  entry.seconds += seconds;
+  entry.flops += flops;
+  entry.bytes += bytes;
+}
+
+bool NnetComputeProfile::Empty() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return entries_.empty();
+}
+
+void NnetComputeProfile::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.clear();
+}
+
+std::map<std::string, NnetComputeProfile::Entry>
+NnetComputeProfile::Entries() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return entries_;
+}
+
+// Prints one line of the table printed by NnetComputeProfile::Print().
+static void PrintProfileLine(const std::string &name,
+                             const NnetComputeProfile::Entry &entry,
+                             double total_seconds, std::ostream &os) {
+  double seconds = std::max(entry.seconds, 1.0e-10);
+  os << std::left << std::setw(48) << name << std::right
+     << std::setw(10) << entry.count
+     << std::setw(12) << std::fixed << std::setprecision(4) << entry.seconds
+     << std::setw(8) << std::setprecision(1)
+     << (100.0 * entry.seconds / std::max(total_seconds, 1.0e-10))
+     << std::setw(12) << std::setprecision(2) << (entry.flops * 1.0e-09 / seconds)
+     << std::setw(10) << (entry.bytes * 1.0e-09 / seconds) << '\n';
+}
+
+void NnetComputeProfile::Print(std::ostream &os) const {
+  std::map<std::string, Entry> entries = Entries();
+  std::vector<std::pair<double, std::string> > sorted;
+  Entry total;
+  for (std::map<std::string, Entry>::const_iterator iter = entries.begin();
+       iter != entries.end(); ++iter) {
+    sorted.push_back(std::make_pair(-iter->second.seconds, iter->first));
+    total.count += iter->second.count;
+    total.seconds += iter->second.seconds;
+    total.flops += iter->second.flops;
+    total.bytes += iter->second.bytes;
+  }
+  std::sort(sorted.begin(), sorted.end());
+  std::ios_base::fmtflags flags = os.flags();
+  std::streamsize precision = os.precision();
+  os << std::left << std::setw(48) << "command/component" << std::right
+     << std::setw(10) << "count" << std::setw(12) << "seconds"
+     << std::setw(8) << "%" << std::setw(12) << "GFLOP/s"
+     << std::setw(10) << "GB/s" << '\n';
+  for (size_t i = 0; i < sorted.size(); i++)
+    PrintProfileLine(sorted[i].second, entries[sorted[i].second],
+                     total.seconds, os);
+  PrintProfileLine("total", total, total.seconds, os);
+  os.flags(flags);
+  os.precision(precision);
+}
+
+void NnetComputeProfile::WriteJson(std::ostream &os) const {
+  std::map<std::string, Entry> entries = Entries();
+  std::streamsize precision = os.precision(10);
+  os << "{";
+  for (std::map<std::string, Entry>::const_iterator iter = entries.begin();
+       iter != entries.end(); ++iter) {
+    // The names are component types and command types, which need no
+    // escaping.
+    os << (iter == entries.begin() ? "\n" : ",\n")
+       << "  \"" << iter->first << "\": {\"count\": " << iter->second.count
+       << ", \"seconds\": " << iter->second.seconds
+       << ", \"flops\": " << iter->second.flops
+       << ", \"bytes\": " << iter->second.bytes << "}";
+  }
+  os << "\n}\n";
+  os.precision(precision);
+}
+
+
 NnetComputer::~NnetComputer() {
   // Delete any pointers that are present in compressed_matrices_.  Actually
   // they should all already have been deallocated and set to NULL if the
@@ -681,6 +1274,10 @@ NnetComputer::~NnetComputer() {
   // the forward propagation but not the backprop.
   for (size_t i = 0; i < compressed_matrices_.size(); i++)
     delete compressed_matrices_[i];
+#if HAVE_CUDA == 1
+  for (size_t i = 0; i < command_events_.size(); i++)
+    cudaEventDestroy(command_events_[i]);
+#endif
 }
 
 } // namespace nnet3
@@ -27,6 +27,8 @@
 #include "nnet3/nnet-example.h"
 
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <sstream>
 #include <vector>
 #include <map>
@@ -38,16 +40,101 @@ namespace nnet3 {
 
 struct NnetComputeOptions {
   bool debug;
-  NnetComputeOptions(): debug(false) { }
+  bool profile;
+  int32 num_threads;
+  NnetComputeOptions(): debug(false), profile(false), num_threads(1) { }
   void Register(OptionsItf *opts) {
     opts->Register("debug", &debug, "If true, turn on "
                    "debug for the neural net computation (very verbose!) "
                    "Will be turned on regardless if --verbose >= 5");
+    opts->Register("profile", &profile, "If true, record the time taken by "
+                   "each type of command and component, with estimates of "
+                   "its floating-point operations and memory traffic, "
+                   "summed over the run (see class NnetComputeProfile).  "
+                   "The commands are then executed one at a time, waiting "
+                   "for the GPU after each, so this slows the computation "
+                   "down.");
+    opts->Register("num-threads", &num_threads, "If >1, the number of threads "
+                   "(the calling thread and threads of the global thread "
+                   "pool) on which independent commands of the computation, "
+                   "e.g. separate branches of the network, are executed in "
+                   "parallel.  On GPU, the threads use separate CUDA "
+                   "streams.  The results are the same as with one thread.");
   }
 
 };
 
 
+/**
+   This class accumulates, over all the computations run with
+   NnetComputeOptions::profile set, how many times each type of command was
+   executed, how long it took, and estimates of the floating-point operations
+   (FLOPs) it did and the bytes of memory it read and wrote.  Propagate and
+   backprop commands are broken down by component type, e.g. "Propagate
+   AffineComponent", and other commands by command type, e.g. "AddRows".  The
+   FLOP and byte counts are rough (see NnetComputer::GetCommandCost()): they
+   are meant for seeing where the time goes and which commands are limited by
+   memory bandwidth rather than arithmetic, not for exact accounting.
+
+   All the functions are thread-safe.
+ */
+class NnetComputeProfile {
+ public:
+  struct Entry {
+    int64 count;
+    double seconds;
+    double flops;
+    double bytes;
+    Entry(): count(0), seconds(0.0), flops(0.0), bytes(0.0) { }
+  };
+
+  /// The profile that NnetComputer adds to.
+  static NnetComputeProfile &Global();
+
+  /// Adds one execution of the command or component type called 'name'.
+  void Add(const std::string &name, double seconds, double flops,
+           double bytes);
+
+  bool Empty() const;
+  void Clear();
+  /// Returns a copy of the entries, indexed by name.
+  std::map<std::string, Entry> Entries() const;
+
+  /// Prints a table with a line for each entry, sorted by decreasing time,
+  /// giving the count, the time and its percentage of the total, the GFLOP/s
+  /// and the GB/s; and a line for the total.
+  void Print(std::ostream &os) const;
+
+  /// Writes the entries as a JSON object, e.g.
+  /// {"Propagate AffineComponent": {"count": 120, "seconds": 0.51,
+  ///  "flops": 2.1e+11, "bytes": 3.4e+09}, ... }
+  void WriteJson(std::ostream &os) const;
+
+ private:
+  mutable std::mutex mutex_;
+  std::map<std::string, Entry> entries_;
+};
+
+
+/**
+   Interface for objects that want to be told, while NnetComputer does the
+   backward computation, when the derivative w.r.t. the parameters of an
+   updatable component is complete, i.e. when the last kBackprop command of
+   the computation for that component has been executed.  This is used in
+   multi-GPU training to start averaging the derivatives of the later layers
+   while the backprop continues through the earlier ones (see class
+   NnetDataParallel).
+ */
+class ComponentDerivObserver {
+ public:
+  /// 'component_index' is the index of the component in the nnet being
+  /// updated (the 'nnet_to_update' of NnetComputer), whose derivative
+  /// will not be changed further by the computation.
+  virtual void DerivativeComplete(int32 component_index) = 0;
+  virtual ~ComponentDerivObserver() { }
+};
+
+
 /**
   class NnetComputer is responsible for executing the computation described in the
   "computation" object.
@@ -112,6 +199,13 @@ class NnetComputer {
   /// Forward() and Backward().
   void Run();
 
+  /// If 'observer' is non-NULL, it will be told (from the thread that calls
+  /// Run()) when the derivatives of the updatable components are complete.
+  /// Must be called before the backward computation starts.  Has no effect
+  /// for looped computations (those with a kGotoLabel command), in which a
+  /// component's kBackprop commands may be executed repeatedly.
+  void SetDerivObserver(ComponentDerivObserver *observer);
+
   // e.g. GetOutput("output").  This function can also be used to get
   // derivatives w.r.t. inputs.  It's non-const because it may only
   // be called once and it keeps track of that.
@@ -124,6 +218,25 @@ class NnetComputer {
   void GetOutputDestructive(const std::string &output_name,
                             CuMatrix<BaseFloat> *output);
 
+  /// Writes the state of the computation between calls to Run(): the command
+  /// it has got to, and the contents of its matrices (but not the computation
+  /// itself).  This is for looped computations (see decodable-online-looped.h),
+  /// whose matrices hold the recurrent state from one chunk to the next.  It
+  /// is not supported while memos or compressed matrices are held, i.e. in
+  /// the middle of training.
+  void WriteState(std::ostream &os, bool binary) const;
+
+  /// Reads the state written by WriteState().  This object must have been
+  /// constructed with the same computation and nnet as the one written.
+  void ReadState(std::istream &is, bool binary);
+
+  /// Returns the memory in bytes currently held by the matrices of the
+  /// computation (including the workspace, if there is a static memory plan,
+  /// but not any compressed matrices).  For looped computations, this is the
+  /// memory held between chunks.  The most memory the computation will use at
+  /// any point is given by GetMaxMemoryUse() in nnet-analyze.h.
+  int64 MemoryUsage() const;
+
 
   ~NnetComputer();
  private:
@@ -156,9 +269,14 @@ class NnetComputer {
   // command_strings_ is only used if debug_=true, or in case of error.
   std::vector<std::string> command_strings_;
 
-  // The matrices used in the computation.
+  // The matrices used in the computation.  Matrices that are in the
+  // workspace (see NnetComputation::workspace_offsets) stay empty here.
   std::vector<CuMatrix<BaseFloat> > matrices_;
 
+  // The workspace that holds the matrices in the computation's static memory
+  // plan, if it has one; allocated once, in Init().
+  CuVector<BaseFloat> workspace_;
+
   // Memos returned by Propagate() that must be passed to the corresponding
   // Backprop() routines, indexed by memo-index (zeroth element always
   // NULL).
@@ -172,9 +290,65 @@ class NnetComputer {
   // happens.
   std::vector<CuCompressedMatrixBase*> compressed_matrices_;
 
+  // Only set up if options_.num_threads > 1 (and debug_ and options_.profile
+  // are false): for each command, the earlier commands it depends on (see
+  // ComputeCommandDependencies()).
+  std::vector<std::vector<int32> > command_dependencies_;
+  // Only set up with command_dependencies_: true for the commands that use
+  // random components.  ExecuteCommandsParallel() runs these on the calling
+  // thread, as on GPU each thread has its own random generator.
+  std::vector<bool> random_commands_;
+#if HAVE_CUDA == 1
+  // Used when executing commands in parallel on a GPU: an event recorded on
+  // the stream of the thread that executed each command, so commands that
+  // depend on it can wait for it on the streams of their threads.  Created
+  // the first time they are needed.
+  std::vector<cudaEvent_t> command_events_;
+#endif
+
+  // See SetDerivObserver(); may be NULL.
+  ComponentDerivObserver *deriv_observer_;
+  // Only set up if deriv_observer_ != NULL: for each command, the components
+  // whose derivatives are complete after it has been executed.
+  std::vector<std::vector<int32> > deriv_complete_components_;
+
+  // Tells deriv_observer_, if set, about the components whose derivatives
+  // are complete after command 'command_index'.
+  inline void NotifyDerivObserver(int32 command_index) {
+    if (deriv_observer_ != NULL) {
+      const std::vector<int32> &components =
+          deriv_complete_components_[command_index];
+      for (size_t i = 0; i < components.size(); i++)
+        deriv_observer_->DerivativeComplete(components[i]);
+    }
+  }
 
-  // executes the command in computation_.commands[program_counter_].
-  void ExecuteCommand();
+  // executes the command in computation_.commands[command_index].
+  void ExecuteCommand(int32 command_index);
+
+  // Does the same as ExecuteCommand(), and adds its time and cost to
+  // NnetComputeProfile::Global(); used if options_.profile is true.
+  void ExecuteCommandProfiled(int32 command_index);
+
+  // Outputs the name under which command 'c' is profiled (see class
+  // NnetComputeProfile), and estimates of the floating-point operations it
+  // does and of the bytes of memory it reads and writes.
+  void GetCommandCost(const NnetComputation::Command &c, std::string *name,
+                      double *flops, double *bytes) const;
+
+  // Executes commands 'begin' through 'end' - 1, none of which may be I/O
+  // or kGotoLabel commands, on up to options_.num_threads threads, in an
+  // order that respects command_dependencies_.  The calling thread takes
+  // part, and the other threads are tasks of GlobalThreadPool().
+  void ExecuteCommandsParallel(int32 begin, int32 end);
+
+  // The state of ExecuteCommandsParallel() shared by its threads.
+  struct ParallelState;
+  // The loop of each of the threads of ExecuteCommandsParallel(); the
+  // calling thread waits for commands to become ready, the others return
+  // when there are none.
+  static void ParallelWorker(std::shared_ptr<ParallelState> state,
+                             bool is_caller);
 
   // Returns the matrix index where the input (if is_output==false) or output
   // matrix index for "node_name" is stored.  This looks at the next command (at
@@ -195,6 +369,16 @@ class NnetComputer {
 
   CuSubMatrix<BaseFloat> GetSubMatrix(int32 submatrix_index);
 
+  // Returns true if matrix 'matrix_index' is stored in workspace_ rather
+  // than in matrices_.
+  inline bool InWorkspace(int32 matrix_index) const {
+    return !computation_.workspace_offsets.empty() &&
+        computation_.workspace_offsets[matrix_index] >= 0;
+  }
+
+  // Returns the whole of matrix 'matrix_index' (used in debugging code).
+  CuSubMatrix<BaseFloat> GetWholeMatrix(int32 matrix_index);
+
   void GetPointers(int32 indexes_multi_index,
                    int32 num_cols,
                    CuArray<BaseFloat*> *pointers);
@@ -564,6 +564,9 @@ ComponentPrecomputedIndexes* TimeHeightConvolutionComponent::PrecomputeIndexes(
   using namespace time_height_convolution;
   ConvolutionComputationOptions opts;
   opts.max_memory_mb = max_memory_mb_;
+#if HAVE_CUDA == 1
+  opts.use_im2col = CuDevice::Instantiate().Enabled();
+#endif
   PrecomputedIndexes *ans = new PrecomputedIndexes();
   std::vector<Index> input_indexes_modified,
       output_indexes_modified;
@@ -638,11 +641,35 @@ void TimeHeightConvolutionComponent::UnVectorize(
   bias_params_.CopyFromVec(params.Range(linear_size, bias_size));
 }
 
+void TimeHeightConvolutionComponent::CuVectorize(
+    CuVectorBase<BaseFloat> *params) const {
+  KALDI_ASSERT(params->Dim() == NumParameters());
+  int32 linear_size = linear_params_.NumRows() * linear_params_.NumCols(),
+      bias_size = bias_params_.Dim();
+  params->Range(0, linear_size).CopyRowsFromMat(linear_params_);
+  params->Range(linear_size, bias_size).CopyFromVec(bias_params_);
+}
+
+void TimeHeightConvolutionComponent::CuUnVectorize(
+    const CuVectorBase<BaseFloat> &params) {
+  KALDI_ASSERT(params.Dim() == NumParameters());
+  int32 linear_size = linear_params_.NumRows() * linear_params_.NumCols(),
+      bias_size = bias_params_.Dim();
+  linear_params_.CopyRowsFromVec(params.Range(0, linear_size));
+  bias_params_.CopyFromVec(params.Range(linear_size, bias_size));
+}
+
 void TimeHeightConvolutionComponent::FreezeNaturalGradient(bool freeze) {
   preconditioner_in_.Freeze(freeze);
   preconditioner_out_.Freeze(freeze);
 }
 
+void TimeHeightConvolutionComponent::SetNaturalGradientMaxUpdatePeriod(
+    int32 max_update_period) {
+  preconditioner_in_.SetMaxUpdatePeriod(max_update_period);
+  preconditioner_out_.SetMaxUpdatePeriod(max_update_period);
+}
+
 TimeHeightConvolutionComponent::PrecomputedIndexes*
 TimeHeightConvolutionComponent::PrecomputedIndexes::Copy() const {
   return new PrecomputedIndexes(*this);
@@ -280,7 +280,10 @@ class TimeHeightConvolutionComponent: public UpdatableComponent {
   virtual int32 NumParameters() const;
   virtual void Vectorize(VectorBase<BaseFloat> *params) const;
   virtual void UnVectorize(const VectorBase<BaseFloat> &params);
+  virtual void CuVectorize(CuVectorBase<BaseFloat> *params) const;
+  virtual void CuUnVectorize(const CuVectorBase<BaseFloat> &params);
   virtual void FreezeNaturalGradient(bool freeze);
+  virtual void SetNaturalGradientMaxUpdatePeriod(int32 max_update_period);
 
 
   class PrecomputedIndexes: public ComponentPrecomputedIndexes {
@@ -521,7 +524,10 @@ class TdnnComponent: public UpdatableComponent {
   virtual int32 NumParameters() const;
   virtual void Vectorize(VectorBase<BaseFloat> *params) const;
   virtual void UnVectorize(const VectorBase<BaseFloat> &params);
+  virtual void CuVectorize(CuVectorBase<BaseFloat> *params) const;
+  virtual void CuUnVectorize(const CuVectorBase<BaseFloat> &params);
   virtual void FreezeNaturalGradient(bool freeze);
+  virtual void SetNaturalGradientMaxUpdatePeriod(int32 max_update_period);
 
 
   class PrecomputedIndexes: public ComponentPrecomputedIndexes {
@@ -552,11 +558,16 @@ class TdnnComponent: public UpdatableComponent {
   };
 
   CuMatrixBase<BaseFloat> &LinearParams() { return linear_params_; }
+  const CuMatrix<BaseFloat> &LinearParams() const { return linear_params_; }
 
   // This allows you to resize the vector in order to add a bias where
   // there previously was none-- obviously this should be done carefully.
   CuVector<BaseFloat> &BiasParams() { return bias_params_; }
 
+  const CuVector<BaseFloat> &BiasParams() const { return bias_params_; }
+
+  const std::vector<int32> &TimeOffsets() const { return time_offsets_; }
+
   BaseFloat OrthonormalConstraint() const { return orthonormal_constraint_; }
 
   void ConsolidateMemory();
@@ -0,0 +1,294 @@
+// nnet3/nnet-data-parallel.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdio>
+#include <fstream>
+#include "nnet3/nnet-data-parallel.h"
+#include "nnet3/nnet-utils.h"
+#include "cudamatrix/cu-device.h"
+
+namespace kaldi {
+namespace nnet3 {
+
+#if HAVE_NCCL == 1
+#define NCCL_SAFE_CALL(fun) \
+  { \
+    ncclResult_t ret = fun; \
+    if (ret != ncclSuccess) \
+      KALDI_ERR << "NCCL error " << ncclGetErrorString(ret) \
+                << " returned by " #fun; \
+  }
+
+// Worker 0 creates the NCCL id and writes it to 'filename'; the other
+// workers wait for the file and read it.
+static void ExchangeNcclId(const NnetDataParallelOptions &opts,
+                           ncclUniqueId *id) {
+  const std::string &filename = opts.nccl_id_file;
+  if (opts.worker_index == 0) {
+    NCCL_SAFE_CALL(ncclGetUniqueId(id));
+    // Write to a temporary file and rename it, so the other workers never
+    // see a partly written file.
+    std::string tmp_filename = filename + ".tmp";
+    {
+      std::ofstream os(tmp_filename.c_str(), std::ios::binary);
+      os.write(id->internal, sizeof(id->internal));
+      if (!os.good())
+        KALDI_ERR << "Error writing NCCL id to " << tmp_filename;
+    }
+    if (std::rename(tmp_filename.c_str(), filename.c_str()) != 0)
+      KALDI_ERR << "Error renaming " << tmp_filename << " to " << filename;
+    return;
+  }
+  BaseFloat waited = 0.0, interval = 0.5;
+  while (true) {
+    std::ifstream is(filename.c_str(), std::ios::binary);
+    if (is.is_open()) {
+      is.read(id->internal, sizeof(id->internal));
+      if (!is.good())
+        KALDI_ERR << "Error reading NCCL id from " << filename;
+      return;
+    }
+    if (waited >= opts.wait_timeout)
+      KALDI_ERR << "Timed out waiting for worker 0 to write " << filename;
+    Sleep(interval);
+    waited += interval;
+  }
+}
+#endif
+
+
+NnetDataParallel::NnetDataParallel(const NnetDataParallelOptions &opts):
+    opts_(opts), num_minibatches_unsynced_(0), nnet_(NULL), next_bucket_(0) {
+  KALDI_ASSERT(opts.sync_period > 0 && opts.bucket_size > 0);
+  if (opts.num_workers <= 1)
+    return;
+  if (opts.worker_index < 0 || opts.worker_index >= opts.num_workers)
+    KALDI_ERR << "Invalid --worker-index=" << opts.worker_index
+              << " with --num-workers=" << opts.num_workers;
+  if (opts.nccl_id_file.empty())
+    KALDI_ERR << "--nccl-id-file is required if --num-workers > 1";
+#if HAVE_NCCL == 1
+  if (!CuDevice::Instantiate().Enabled())
+    KALDI_ERR << "--num-workers > 1 requires a GPU (--use-gpu=yes).";
+  ncclUniqueId id;
+  ExchangeNcclId(opts, &id);
+  NCCL_SAFE_CALL(ncclCommInitRank(&comm_, opts.num_workers, id,
+                                  opts.worker_index));
+  // ncclCommInitRank() returns when all the workers have joined, so they have
+  // all read the file.
+  if (opts.worker_index == 0)
+    std::remove(opts.nccl_id_file.c_str());
+  CU_SAFE_CALL(cudaStreamCreateWithFlags(&stream_, cudaStreamNonBlocking));
+  CU_SAFE_CALL(cudaEventCreateWithFlags(&ready_event_,
+                                        cudaEventDisableTiming));
+  CU_SAFE_CALL(cudaEventCreateWithFlags(&done_event_,
+                                        cudaEventDisableTiming));
+  KALDI_LOG << "Worker " << opts.worker_index << " of " << opts.num_workers
+            << " joined the data-parallel training.";
+#else
+  KALDI_ERR << "--num-workers > 1 requires Kaldi to be compiled with NCCL "
+            << "(see configure --nccl-root).";
+#endif
+}
+
+
+void NnetDataParallel::StartAllReduce(BaseFloat *data, int32 dim) {
+#if HAVE_NCCL == 1
+  ncclDataType_t type = (sizeof(BaseFloat) == 4 ? ncclFloat : ncclDouble);
+  CU_SAFE_CALL(cudaEventRecord(ready_event_, GetCudaStream()));
+  CU_SAFE_CALL(cudaStreamWaitEvent(stream_, ready_event_, 0));
+  NCCL_SAFE_CALL(ncclAllReduce(data, data, dim, type, ncclSum,
+                               comm_, stream_));
+#endif
+}
+
+
+void NnetDataParallel::WaitForAllReduces() {
+#if HAVE_NCCL == 1
+  CU_SAFE_CALL(cudaEventRecord(done_event_, stream_));
+  CU_SAFE_CALL(cudaStreamWaitEvent(GetCudaStream(), done_event_, 0));
+#endif
+}
+
+
+bool NnetDataParallel::AllHaveData(bool have_data) {
+  if (opts_.num_workers <= 1)
+    return have_data;
+  KALDI_ASSERT(nnet_ == NULL);
+  CuVector<BaseFloat> flag(1);
+  flag(0) = (have_data ? 1.0 : 0.0);
+  StartAllReduce(flag.Data(), 1);
+  WaitForAllReduces();
+  // The sum is num_workers only if all the workers have data.
+  return (flag(0) > opts_.num_workers - 0.5);
+}
+
+
+void NnetDataParallel::InitBuckets(const Nnet &nnet) {
+  int32 num_components = nnet.NumComponents();
+  if (static_cast<int32>(component_offset_.size()) == num_components)
+    return;
+  component_offset_.assign(num_components, -1);
+  component_bucket_.assign(num_components, -1);
+  buckets_.clear();
+  int32 offset = 0;
+  for (int32 c = num_components - 1; c >= 0; c--) {
+    const Component *comp = nnet.GetComponent(c);
+    if (!(comp->Properties() & kUpdatableComponent))
+      continue;
+    const UpdatableComponent *uc =
+        dynamic_cast<const UpdatableComponent*>(comp);
+    if (uc == NULL)
+      KALDI_ERR << "Updatable component does not inherit from class "
+          "UpdatableComponent; change this code.";
+    if (buckets_.empty() || buckets_.back().dim >= opts_.bucket_size) {
+      Bucket bucket;
+      bucket.offset = offset;
+      bucket.dim = 0;
+      bucket.num_components = 0;
+      buckets_.push_back(bucket);
+    }
+    component_offset_[c] = offset;
+    component_bucket_[c] = buckets_.size() - 1;
+    buckets_.back().dim += uc->NumParameters();
+    buckets_.back().num_components++;
+    offset += uc->NumParameters();
+  }
+  KALDI_LOG << "Averaging " << offset << " parameters over "
+            << opts_.num_workers << " workers in " << buckets_.size()
+            << " buckets.";
+}
+
+
+void NnetDataParallel::StartAveraging(Nnet *nnet) {
+  KALDI_ASSERT(nnet_ == NULL);
+  InitBuckets(*nnet);
+  nnet_ = nnet;
+  int32 num_parameters = NumParameters(*nnet);
+  if (buffer_.Dim() != num_parameters)
+    buffer_.Resize(num_parameters, kUndefined);
+  component_ready_.assign(nnet->NumComponents(), false);
+  bucket_num_pending_.resize(buckets_.size());
+  for (size_t b = 0; b < buckets_.size(); b++)
+    bucket_num_pending_[b] = buckets_[b].num_components;
+  next_bucket_ = 0;
+}
+
+
+void NnetDataParallel::ComponentReady(int32 c) {
+  int32 bucket = component_bucket_[c];
+  if (bucket < 0 || component_ready_[c])
+    return;
+  component_ready_[c] = true;
+  const UpdatableComponent *uc =
+      dynamic_cast<const UpdatableComponent*>(nnet_->GetComponent(c));
+  CuSubVector<BaseFloat> params(buffer_, component_offset_[c],
+                                uc->NumParameters());
+  uc->CuVectorize(&params);
+  bucket_num_pending_[bucket]--;
+  while (next_bucket_ < static_cast<int32>(buckets_.size()) &&
+         bucket_num_pending_[next_bucket_] == 0) {
+    const Bucket &b = buckets_[next_bucket_];
+    StartAllReduce(buffer_.Data() + b.offset, b.dim);
+    next_bucket_++;
+  }
+}
+
+
+void NnetDataParallel::FinishAveraging() {
+  int32 num_components = nnet_->NumComponents();
+  for (int32 c = num_components - 1; c >= 0; c--)
+    ComponentReady(c);
+  KALDI_ASSERT(next_bucket_ == static_cast<int32>(buckets_.size()));
+  WaitForAllReduces();
+  buffer_.Scale(1.0 / opts_.num_workers);
+  for (int32 c = 0; c < num_components; c++) {
+    if (component_offset_[c] < 0)
+      continue;
+    UpdatableComponent *uc =
+        dynamic_cast<UpdatableComponent*>(nnet_->GetComponent(c));
+    uc->CuUnVectorize(CuSubVector<BaseFloat>(buffer_, component_offset_[c],
+                                             uc->NumParameters()));
+  }
+  nnet_ = NULL;
+}
+
+
+void NnetDataParallel::StartUpdate(Nnet *delta_nnet, NnetComputer *computer) {
+  if (opts_.num_workers <= 1 || opts_.sync_period != 1)
+    return;
+  StartAveraging(delta_nnet);
+  if (opts_.overlap)
+    computer->SetDerivObserver(this);
+}
+
+
+void NnetDataParallel::DerivativeComplete(int32 component_index) {
+  if (nnet_ != NULL)
+    ComponentReady(component_index);
+}
+
+
+void NnetDataParallel::AverageUpdate(Nnet *delta_nnet) {
+  if (opts_.num_workers <= 1 || opts_.sync_period != 1)
+    return;
+  if (nnet_ == NULL)
+    StartAveraging(delta_nnet);
+  KALDI_ASSERT(nnet_ == delta_nnet);
+  FinishAveraging();
+}
+
+
+void NnetDataParallel::MinibatchDone(Nnet *nnet) {
+  if (opts_.num_workers <= 1 || opts_.sync_period == 1)
+    return;
+  if (++num_minibatches_unsynced_ == opts_.sync_period) {
+    StartAveraging(nnet);
+    FinishAveraging();
+    num_minibatches_unsynced_ = 0;
+  }
+}
+
+
+void NnetDataParallel::Finish(Nnet *nnet) {
+  // With sync_period == 1 the workers apply the same averaged update, so
+  // their models only differ by round-off; we average them anyway so that
+  // they write identical models.
+  if (opts_.num_workers > 1) {
+    StartAveraging(nnet);
+    FinishAveraging();
+    num_minibatches_unsynced_ = 0;
+  }
+}
+
+
+NnetDataParallel::~NnetDataParallel() {
+#if HAVE_NCCL == 1
+  if (opts_.num_workers > 1) {
+    ncclCommDestroy(comm_);
+    cudaStreamDestroy(stream_);
+    cudaEventDestroy(ready_event_);
+    cudaEventDestroy(done_event_);
+  }
+#endif
+}
+
+
+} // namespace nnet3
+} // namespace kaldi
@@ -0,0 +1,226 @@
+// nnet3/nnet-data-parallel.h
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_NNET3_NNET_DATA_PARALLEL_H_
+#define KALDI_NNET3_NNET_DATA_PARALLEL_H_
+
+#include <string>
+
+#include "nnet3/nnet-nnet.h"
+#include "nnet3/nnet-compute.h"
+#include "cudamatrix/cu-vector.h"
+
+#if HAVE_NCCL == 1
+#include <nccl.h>
+#endif
+
+namespace kaldi {
+namespace nnet3 {
+
+
+struct NnetDataParallelOptions {
+  int32 num_workers;
+  int32 worker_index;
+  std::string nccl_id_file;
+  int32 sync_period;
+  int32 bucket_size;
+  bool overlap;
+  BaseFloat wait_timeout;
+  NnetDataParallelOptions(): num_workers(1), worker_index(0),
+                             sync_period(1), bucket_size(1000000),
+                             overlap(true), wait_timeout(600.0) { }
+  void Register(OptionsItf *opts) {
+    opts->Register("num-workers", &num_workers, "Number of training jobs "
+                   "(one per GPU) that train the same model synchronously on "
+                   "different data; if >1, requires Kaldi to be compiled "
+                   "with NCCL (configure --nccl-root).");
+    opts->Register("worker-index", &worker_index, "Zero-based index of this "
+                   "job among the --num-workers training jobs.");
+    opts->Register("nccl-id-file", &nccl_id_file, "File through which the "
+                   "training jobs exchange the NCCL id at startup; worker 0 "
+                   "writes it and the others wait for it.  It must be on a "
+                   "filesystem they all see, and must not exist when they "
+                   "start.  Required if --num-workers > 1.");
+    opts->Register("sync-period", &sync_period, "If 1, the parameter change "
+                   "is averaged over the training jobs on every minibatch, "
+                   "before the max-change is applied; if >1, each job "
+                   "updates its own copy of the model and the parameters are "
+                   "averaged every this-many minibatches.");
+    opts->Register("bucket-size", &bucket_size, "The parameters of "
+                   "consecutive components are averaged together, in "
+                   "all-reduces of at least this many parameters, so small "
+                   "components don't need a message each.");
+    opts->Register("overlap-communication", &overlap, "If true (and "
+                   "--sync-period=1), start averaging the parameter changes "
+                   "of the later components while the backprop continues "
+                   "through the earlier ones.");
+    opts->Register("nccl-wait-timeout", &wait_timeout, "Time in seconds for "
+                   "which workers other than 0 wait for --nccl-id-file to "
+                   "appear.");
+  }
+};
+
+
+/**
+   This class does the communication for synchronous data-parallel training,
+   in which --num-workers training processes, each using its own GPU and
+   reading its own examples, train the same model.  The parameter changes
+   (or, with --sync-period > 1, the parameters) are averaged over the
+   processes with NCCL all-reduces on the GPUs, so there is no need to write
+   the models to disk and average them between iterations.
+
+   The parameters are averaged in "buckets" of consecutive updatable
+   components, taken from the last component to the first (the order in
+   which the backprop finishes with them), each bucket having at least
+   --bucket-size parameters.  With --sync-period=1, the trainers tell this
+   class (via NnetComputer::SetDerivObserver()) when the backprop has
+   finished with each component, and the all-reduce for a bucket is started
+   on a separate CUDA stream as soon as its components are complete, so the
+   communication overlaps with the rest of the backprop.
+
+   With --num-workers=1 (the default) all the functions do nothing, so the
+   training programs can use this class unconditionally.  AllHaveData(),
+   AverageUpdate(), MinibatchDone() and Finish() are collective: they must be
+   called the same number of times, in the same order, by all the workers
+   (the trainer classes and the loop over the examples in the training
+   programs take care of this).  All the workers must use the same --srand,
+   so that they do backstitch training on the same minibatches.
+
+   The parameters that are averaged are those of the updatable components,
+   as given by UpdatableComponent::CuVectorize(); the component stats and
+   the state of the natural-gradient preconditioners stay local to each
+   worker.
+ */
+class NnetDataParallel: public ComponentDerivObserver {
+ public:
+  /// If opts.num_workers > 1, sets up the NCCL communicator; this blocks
+  /// until all the workers have started.  If using a GPU, this must be
+  /// constructed after selecting it.
+  explicit NnetDataParallel(const NnetDataParallelOptions &opts);
+
+  int32 NumWorkers() const { return opts_.num_workers; }
+
+  /// Returns true if 'have_data' is true for all the workers.  The training
+  /// programs call this before each minibatch, so that all the workers stop
+  /// when the first of them runs out of examples.
+  bool AllHaveData(bool have_data);
+
+  /// Called by the trainers before the backward computation of a minibatch.
+  /// If opts.sync_period == 1 and opts.overlap is true, sets this object as
+  /// the derivative observer of 'computer', so that the averaging of
+  /// 'delta_nnet' starts during the backprop.
+  void StartUpdate(Nnet *delta_nnet, NnetComputer *computer);
+
+  /// Called by the trainers after the backward computation of a minibatch
+  /// and before applying the parameter change; if opts.sync_period == 1,
+  /// replaces 'delta_nnet' by its average over the workers.  Since the
+  /// workers have the same parameters, terms of the update that depend only
+  /// on the parameters (like the l2 regularization) can be added afterwards.
+  void AverageUpdate(Nnet *delta_nnet);
+
+  /// Called by the trainers after each minibatch; if opts.sync_period > 1,
+  /// averages the parameters of 'nnet' over the workers every
+  /// opts.sync_period minibatches.
+  void MinibatchDone(Nnet *nnet);
+
+  /// Called by the training programs after the last minibatch, before
+  /// writing the model: averages the parameters of 'nnet' over the workers,
+  /// so they all write the same model.
+  void Finish(Nnet *nnet);
+
+  /// From ComponentDerivObserver.
+  virtual void DerivativeComplete(int32 component_index);
+
+  ~NnetDataParallel();
+
+ private:
+  // A group of consecutive components whose parameters are averaged in one
+  // all-reduce, as the range (offset, dim) of buffer_.
+  struct Bucket {
+    int32 offset;
+    int32 dim;
+    int32 num_components;
+  };
+
+  // Sets up the buckets for the structure of 'nnet', if not already done.
+  void InitBuckets(const Nnet &nnet);
+
+  // Starts averaging the parameters of 'nnet' (which is nnet_ until
+  // FinishAveraging() is called).
+  void StartAveraging(Nnet *nnet);
+
+  // Called when the parameters of component c of nnet_ are ready to be
+  // averaged: copies them to buffer_ and starts the all-reduces of the
+  // buckets that are complete.
+  void ComponentReady(int32 c);
+
+  // Copies the parameters of the components that were not yet ready to
+  // buffer_, waits for all the all-reduces and copies the averages back to
+  // nnet_.
+  void FinishAveraging();
+
+  // Starts summing the 'dim' elements at 'data' (on the GPU) over the
+  // workers, after the work already queued on this thread's CUDA stream has
+  // been done.
+  void StartAllReduce(BaseFloat *data, int32 dim);
+
+  // Makes the work queued after this on this thread's CUDA stream wait for
+  // the all-reduces that have been started.
+  void WaitForAllReduces();
+
+  const NnetDataParallelOptions &opts_;
+  // The number of minibatches since the parameters were last averaged (only
+  // used if opts_.sync_period > 1).
+  int32 num_minibatches_unsynced_;
+
+  // The nnet whose parameters are being averaged, or NULL.
+  Nnet *nnet_;
+  // The offset of the parameters of each updatable component in buffer_, and
+  // -1 for the other components.
+  std::vector<int32> component_offset_;
+  // The bucket that each updatable component is in, and -1 for the others.
+  std::vector<int32> component_bucket_;
+  std::vector<Bucket> buckets_;
+  // For the current averaging: which components are ready, the number of
+  // components of each bucket that are not ready yet, and the index of the
+  // first bucket whose all-reduce hasn't been started.  The all-reduces are
+  // started in the same order on all the workers, as NCCL requires.
+  std::vector<bool> component_ready_;
+  std::vector<int32> bucket_num_pending_;
+  int32 next_bucket_;
+
+  // The parameters of the components being averaged.
+  CuVector<BaseFloat> buffer_;
+#if HAVE_NCCL == 1
+  ncclComm_t comm_;
+  // The stream that the all-reduces are done on, and events used to make it
+  // and this thread's stream wait for each other.
+  cudaStream_t stream_;
+  cudaEvent_t ready_event_;
+  cudaEvent_t done_event_;
+#endif
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(NnetDataParallel);
+};
+
+
+} // namespace nnet3
+} // namespace kaldi
+
+#endif // KALDI_NNET3_NNET_DATA_PARALLEL_H_
@@ -0,0 +1,200 @@
+// nnet3/nnet-example-index.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <map>
+#include "nnet3/nnet-example-index.h"
+#include "nnet3/nnet-chain-example.h"
+#include "nnet3/nnet-discriminative-example.h"
+#include "util/kaldi-holder.h"
+#include "util/text-utils.h"
+
+namespace kaldi {
+namespace nnet3 {
+
+
+void GetExampleIndexInfo(const NnetExample &eg,
+                         int32 *num_frames, std::string *output_name) {
+  for (size_t i = 0; i < eg.io.size(); i++) {
+    if (eg.io[i].name.compare(0, 6, "output") == 0) {
+      *num_frames = eg.io[i].indexes.size();
+      *output_name = eg.io[i].name;
+      return;
+    }
+  }
+  KALDI_ERR << "Example has no output (no NnetIo named output*).";
+}
+
+void GetExampleIndexInfo(const NnetChainExample &eg,
+                         int32 *num_frames, std::string *output_name) {
+  if (eg.outputs.empty())
+    KALDI_ERR << "Chain example has no outputs.";
+  *num_frames = eg.outputs[0].indexes.size();
+  *output_name = eg.outputs[0].name;
+}
+
+void GetExampleIndexInfo(const NnetDiscriminativeExample &eg,
+                         int32 *num_frames, std::string *output_name) {
+  if (eg.outputs.empty())
+    KALDI_ERR << "Discriminative example has no outputs.";
+  *num_frames = eg.outputs[0].indexes.size();
+  *output_name = eg.outputs[0].name;
+}
+
+
+void ReadExampleIndex(const std::string &rxfilename,
+                      std::vector<ExampleIndexEntry> *index) {
+  index->clear();
+  Input ki(rxfilename);
+  std::string line;
+  std::vector<std::string> fields;
+  while (std::getline(ki.Stream(), line)) {
+    SplitStringToVector(line, " \t\r", true, &fields);
+    if (fields.empty())
+      continue;
+    ExampleIndexEntry entry;
+    if (fields.size() != 4 ||
+        !ConvertStringToInteger(fields[2], &entry.num_frames))
+      KALDI_ERR << "Bad line in egs index "
+                << PrintableRxfilename(rxfilename) << ": " << line;
+    entry.key = fields[0];
+    entry.rxfilename = fields[1];
+    entry.output_name = fields[3];
+    index->push_back(entry);
+  }
+}
+
+void WriteExampleIndex(const std::string &wxfilename,
+                       const std::vector<ExampleIndexEntry> &index) {
+  Output ko(wxfilename, false);
+  std::ostream &os = ko.Stream();
+  for (size_t i = 0; i < index.size(); i++)
+    os << index[i].key << ' ' << index[i].rxfilename << ' '
+       << index[i].num_frames << ' ' << index[i].output_name << '\n';
+}
+
+void WriteExampleIndexAsScp(const std::string &wxfilename,
+                            const std::vector<ExampleIndexEntry> &index) {
+  Output ko(wxfilename, false);
+  std::ostream &os = ko.Stream();
+  for (size_t i = 0; i < index.size(); i++)
+    os << index[i].key << ' ' << index[i].rxfilename << '\n';
+}
+
+
+void ShuffleExampleIndex(int32 group_size,
+                         std::vector<ExampleIndexEntry> *index) {
+  std::random_shuffle(index->begin(), index->end());
+  if (group_size <= 1)
+    return;
+  // Put the entries into groups of entries with the same output name and
+  // number of frames; the group for each kind that's being filled is the
+  // last one in 'groups' with its index in 'current_group'.
+  std::vector<std::vector<ExampleIndexEntry> > groups;
+  std::map<std::pair<std::string, int32>, size_t> current_group;
+  for (size_t i = 0; i < index->size(); i++) {
+    const ExampleIndexEntry &entry = (*index)[i];
+    std::pair<std::string, int32> kind(entry.output_name, entry.num_frames);
+    std::map<std::pair<std::string, int32>, size_t>::iterator iter =
+        current_group.find(kind);
+    if (iter == current_group.end() ||
+        groups[iter->second].size() == static_cast<size_t>(group_size)) {
+      current_group[kind] = groups.size();
+      groups.resize(groups.size() + 1);
+      groups.back().reserve(group_size);
+      groups.back().push_back(entry);
+    } else {
+      groups[iter->second].push_back(entry);
+    }
+  }
+  std::random_shuffle(groups.begin(), groups.end());
+  index->clear();
+  for (size_t g = 0; g < groups.size(); g++)
+    index->insert(index->end(), groups[g].begin(), groups[g].end());
+}
+
+
+template <class Example>
+ShardedExampleWriter<Example>::ShardedExampleWriter(
+    const std::string &prefix, int32 num_shards, bool binary):
+    prefix_(prefix), binary_(binary), closed_(false) {
+  KALDI_ASSERT(num_shards > 0);
+  for (int32 i = 1; i <= num_shards; i++) {
+    std::ostringstream name;
+    name << prefix << '.' << i << ".ark";
+    if (ClassifyWxfilename(name.str()) != kFileOutput)
+      KALDI_ERR << "The shards of sharded egs must be ordinary files: "
+                << name.str();
+    shard_names_.push_back(name.str());
+    // The archives are in table format, so we write their binary
+    // header for each example, like TableWriter does.
+    bool write_header = false;
+    shards_.push_back(new Output(name.str(), binary, write_header));
+  }
+}
+
+template <class Example>
+void ShardedExampleWriter<Example>::Write(const std::string &key,
+                                          const Example &eg) {
+  KALDI_ASSERT(!closed_);
+  if (!IsToken(key))
+    KALDI_ERR << "Using invalid key " << key;
+  int32 shard = index_.size() % shards_.size();
+  std::ostream &os = shards_[shard]->Stream();
+  os << key << ' ';
+  ExampleIndexEntry entry;
+  entry.key = key;
+  std::ostringstream rxfilename;
+  rxfilename << shard_names_[shard] << ':' << os.tellp();
+  entry.rxfilename = rxfilename.str();
+  GetExampleIndexInfo(eg, &entry.num_frames, &entry.output_name);
+  if (!KaldiObjectHolder<Example>::Write(os, binary_, eg))
+    KALDI_ERR << "Error writing example to " << shard_names_[shard];
+  index_.push_back(entry);
+}
+
+template <class Example>
+void ShardedExampleWriter<Example>::Close() {
+  if (closed_)
+    return;
+  closed_ = true;
+  for (size_t i = 0; i < shards_.size(); i++) {
+    if (!shards_[i]->Close())
+      KALDI_ERR << "Error closing " << shard_names_[i];
+    delete shards_[i];
+  }
+  shards_.clear();
+  WriteExampleIndexAsScp(prefix_ + ".scp", index_);
+  WriteExampleIndex(prefix_ + ".index", index_);
+}
+
+template <class Example>
+ShardedExampleWriter<Example>::~ShardedExampleWriter() {
+  Close();
+}
+
+
+// Instantiate the template for the types of example that it's used with.
+template class ShardedExampleWriter<NnetExample>;
+template class ShardedExampleWriter<NnetChainExample>;
+template class ShardedExampleWriter<NnetDiscriminativeExample>;
+
+
+} // namespace nnet3
+} // namespace kaldi
@@ -0,0 +1,142 @@
+// nnet3/nnet-example-index.h
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_NNET3_NNET_EXAMPLE_INDEX_H_
+#define KALDI_NNET3_NNET_EXAMPLE_INDEX_H_
+
+#include <string>
+#include <vector>
+
+#include "nnet3/nnet-example.h"
+#include "util/kaldi-io.h"
+
+namespace kaldi {
+namespace nnet3 {
+
+struct NnetChainExample;  // defined in nnet-chain-example.h
+struct NnetDiscriminativeExample;  // defined in nnet-discriminative-example.h
+
+
+/*
+  This header contains code for "sharded" egs: examples written to several
+  archives (the shards), with an index that says where each example is, so
+  they can be read in any order without reading the archives through.  For a
+  prefix like exp/egs/train, the files are:
+
+     exp/egs/train.1.ark ...  The shards: ordinary archives of the examples.
+     exp/egs/train.scp        An ordinary scp file, "<key> <shard>.ark:<offset>"
+                              on each line, so "scp:exp/egs/train.scp" can be
+                              given to any program that reads egs.
+     exp/egs/train.index      The index: "<key> <shard>.ark:<offset>
+                              <num-frames> <output-name>" on each line, where
+                              <num-frames> is the number of frames of the first
+                              output of the example and <output-name> its name.
+
+  For training, nnet3-shuffle-egs-index writes a shuffled scp file from the
+  index, and the egs are read from that (e.g. by nnet3-merge-egs) one at a
+  time, seeking in the shards, rather than being held in memory for the
+  shuffle as nnet3-shuffle-egs --buffer-size does.
+*/
+
+
+/// An entry in the index of sharded egs (see above).
+struct ExampleIndexEntry {
+  std::string key;
+  /// Where the example is, e.g. "exp/egs/train.3.ark:125930".
+  std::string rxfilename;
+  /// The number of frames of the first output of the example.
+  int32 num_frames;
+  /// The name of the first output of the example, e.g. "output".
+  std::string output_name;
+
+  ExampleIndexEntry(): num_frames(0) { }
+};
+
+/// Returns the number of frames and the name of the first output of the
+/// example, as stored in the index.  For NnetExample, the outputs are the
+/// NnetIo objects whose name starts with "output".
+void GetExampleIndexInfo(const NnetExample &eg,
+                         int32 *num_frames, std::string *output_name);
+void GetExampleIndexInfo(const NnetChainExample &eg,
+                         int32 *num_frames, std::string *output_name);
+void GetExampleIndexInfo(const NnetDiscriminativeExample &eg,
+                         int32 *num_frames, std::string *output_name);
+
+void ReadExampleIndex(const std::string &rxfilename,
+                      std::vector<ExampleIndexEntry> *index);
+
+void WriteExampleIndex(const std::string &wxfilename,
+                       const std::vector<ExampleIndexEntry> &index);
+
+/// Writes the index as an ordinary scp file ("<key> <rxfilename>" lines).
+void WriteExampleIndexAsScp(const std::string &wxfilename,
+                            const std::vector<ExampleIndexEntry> &index);
+
+/**
+   Randomly shuffles the entries of 'index'.  If group_size > 1, the shuffled
+   entries are then put in groups of 'group_size' entries with the same
+   output name and number of frames (the last group of each kind may be
+   smaller), and the groups are shuffled; so when the examples are read in
+   this order and merged into minibatches of 'group_size' egs (e.g. by
+   nnet3-merge-egs --minibatch-size=<group-size>), each minibatch is made of
+   egs from one group.  Uses the global random number generator.
+ */
+void ShuffleExampleIndex(int32 group_size,
+                         std::vector<ExampleIndexEntry> *index);
+
+
+/**
+   This class writes examples to sharded egs (see the comment at the top of
+   this file), assigning them to the shards in turn.  'Example' is NnetExample,
+   NnetChainExample or NnetDiscriminativeExample.
+ */
+template <class Example>
+class ShardedExampleWriter {
+ public:
+  /// Opens the shards <prefix>.1.ark to <prefix>.<num_shards>.ark, which
+  /// must be ordinary files.
+  ShardedExampleWriter(const std::string &prefix, int32 num_shards,
+                       bool binary);
+
+  void Write(const std::string &key, const Example &eg);
+
+  /// Closes the shards and writes <prefix>.scp and <prefix>.index.  Called
+  /// by the destructor if you don't call it.
+  void Close();
+
+  int32 NumWritten() const { return index_.size(); }
+
+  ~ShardedExampleWriter();
+
+ private:
+  std::string prefix_;
+  bool binary_;
+  std::vector<std::string> shard_names_;
+  std::vector<Output*> shards_;
+  std::vector<ExampleIndexEntry> index_;
+  bool closed_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(ShardedExampleWriter);
+};
+
+
+} // namespace nnet3
+} // namespace kaldi
+
+#endif // KALDI_NNET3_NNET_EXAMPLE_INDEX_H_
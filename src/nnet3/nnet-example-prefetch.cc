@@ -0,0 +1,304 @@
+// nnet3/nnet-example-prefetch.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <map>
+#include "nnet3/nnet-example-prefetch.h"
+#include "nnet3/nnet-chain-example.h"
+
+namespace kaldi {
+namespace nnet3 {
+
+
+void PrefetchedInputs::CopyToComputer(NnetComputer *computer) const {
+  KALDI_ASSERT(names.size() == features.size());
+  for (size_t i = 0; i < names.size(); i++) {
+    CuMatrix<BaseFloat> input(features[i]);
+    computer->AcceptInput(names[i], &input);
+  }
+}
+
+
+void AugmentInputFeatures(const NnetAugmentOptions &opts,
+                          const NnetIo &io,
+                          RandomState *state,
+                          CuMatrixBase<BaseFloat> *features) {
+  int32 num_rows = features->NumRows(), dim = features->NumCols();
+  KALDI_ASSERT(static_cast<int32>(io.indexes.size()) == num_rows);
+  if (num_rows == 0)
+    return;
+  // Number the sequences, and find the range of 't' values of each.
+  std::map<int32, int32> n_to_seq;
+  std::vector<int32> row_to_seq(num_rows), min_t, max_t;
+  for (int32 r = 0; r < num_rows; r++) {
+    const Index &index = io.indexes[r];
+    std::map<int32, int32>::iterator iter = n_to_seq.find(index.n);
+    if (iter == n_to_seq.end()) {
+      iter = n_to_seq.insert(std::make_pair(index.n,
+                                            static_cast<int32>(min_t.size())))
+          .first;
+      min_t.push_back(index.t);
+      max_t.push_back(index.t);
+    }
+    int32 seq = iter->second;
+    row_to_seq[r] = seq;
+    min_t[seq] = std::min(min_t[seq], index.t);
+    max_t[seq] = std::max(max_t[seq], index.t);
+  }
+  int32 num_seqs = min_t.size();
+
+  bool time_mask = (opts.time_mask_width > 0 && opts.num_time_masks > 0),
+      freq_mask = (opts.freq_mask_width > 0 && opts.num_freq_masks > 0),
+      gain = (opts.max_log_gain > 0.0);
+
+  if (gain) {
+    Vector<BaseFloat> seq_log_gain(num_seqs), row_log_gain(num_rows);
+    for (int32 s = 0; s < num_seqs; s++)
+      seq_log_gain(s) = (2.0 * RandUniform(state) - 1.0) * opts.max_log_gain;
+    for (int32 r = 0; r < num_rows; r++)
+      row_log_gain(r) = seq_log_gain(row_to_seq[r]);
+    CuVector<BaseFloat> cu_row_log_gain(row_log_gain);
+    features->AddVecToCols(1.0, cu_row_log_gain);
+  }
+
+  if (freq_mask) {
+    // The mask of each sequence is expanded to one row per frame on the GPU.
+    Matrix<BaseFloat> seq_mask(num_seqs, dim);
+    seq_mask.Set(1.0);
+    for (int32 s = 0; s < num_seqs; s++) {
+      for (int32 m = 0; m < opts.num_freq_masks; m++) {
+        int32 width = RandInt(0, std::min(opts.freq_mask_width, dim), state),
+            start = RandInt(0, dim - width, state);
+        if (width > 0)
+          seq_mask.Row(s).Range(start, width).SetZero();
+      }
+    }
+    CuMatrix<BaseFloat> cu_seq_mask(seq_mask), mask(num_rows, dim, kUndefined);
+    CuArray<MatrixIndexT> cu_row_to_seq(row_to_seq);
+    mask.CopyRows(cu_seq_mask, cu_row_to_seq);
+    features->MulElements(mask);
+  }
+
+  if (time_mask) {
+    // Each mask covers the frames with t in [begin, end).
+    std::vector<std::vector<std::pair<int32, int32> > > masks(num_seqs);
+    for (int32 s = 0; s < num_seqs; s++) {
+      for (int32 m = 0; m < opts.num_time_masks; m++) {
+        int32 width = RandInt(0, opts.time_mask_width, state),
+            begin = RandInt(min_t[s], std::max(min_t[s], max_t[s] - width + 1),
+                            state);
+        masks[s].push_back(std::make_pair(begin, begin + width));
+      }
+    }
+    Vector<BaseFloat> row_scale(num_rows);
+    row_scale.Set(1.0);
+    for (int32 r = 0; r < num_rows; r++) {
+      const std::vector<std::pair<int32, int32> > &seq_masks =
+          masks[row_to_seq[r]];
+      int32 t = io.indexes[r].t;
+      for (size_t m = 0; m < seq_masks.size(); m++)
+        if (t >= seq_masks[m].first && t < seq_masks[m].second)
+          row_scale(r) = 0.0;
+    }
+    CuVector<BaseFloat> cu_row_scale(row_scale);
+    features->MulRowsVec(cu_row_scale);
+  }
+}
+
+
+// The NnetIo objects of an example that may be inputs.
+static const std::vector<NnetIo> &ExampleIo(const NnetExample &eg) {
+  return eg.io;
+}
+static const std::vector<NnetIo> &ExampleIo(const NnetChainExample &eg) {
+  return eg.inputs;
+}
+
+
+template <class Example>
+ExamplePrefetcher<Example>::ExamplePrefetcher(
+    const NnetPrefetchOptions &opts,
+    const Nnet &nnet,
+    const std::string &examples_rspecifier):
+    opts_(opts), reader_(examples_rspecifier), finished_(false),
+    stop_(false), pinned_buffer_(NULL), pinned_buffer_size_(0) {
+  KALDI_ASSERT(opts_.num_minibatches > 0);
+  for (int32 n = 0; n < nnet.NumNodes(); n++)
+    if (nnet.IsInputNode(n))
+      input_names_.push_back(nnet.GetNodeName(n));
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled())
+    CuDevice::Instantiate().AllowMultithreading();
+#endif
+  thread_ = std::thread(&ExamplePrefetcher<Example>::ReadMinibatches, this);
+}
+
+
+template <class Example>
+void ExamplePrefetcher<Example>::PrepareInputs(Minibatch *mb) {
+  const std::vector<NnetIo> &io = ExampleIo(mb->eg);
+  for (size_t i = 0; i < io.size(); i++) {
+    if (std::find(input_names_.begin(), input_names_.end(), io[i].name) ==
+        input_names_.end())
+      continue;
+    const GeneralMatrix &features = io[i].features;
+    int32 num_rows = features.NumRows(), num_cols = features.NumCols();
+    mb->inputs.names.push_back(io[i].name);
+    mb->inputs.features.push_back(CuMatrix<BaseFloat>());
+    CuMatrix<BaseFloat> &dest = mb->inputs.features.back();
+    dest.Resize(num_rows, num_cols, kUndefined);
+#if HAVE_CUDA == 1
+    if (CuDevice::Instantiate().Enabled() &&
+        features.Type() != kSparseMatrix && num_rows * num_cols > 0) {
+      size_t size = static_cast<size_t>(num_rows) * num_cols;
+      if (size > pinned_buffer_size_) {
+        if (pinned_buffer_ != NULL)
+          CU_SAFE_CALL(cudaFreeHost(pinned_buffer_));
+        CU_SAFE_CALL(cudaMallocHost(reinterpret_cast<void**>(&pinned_buffer_),
+                                    size * sizeof(BaseFloat)));
+        pinned_buffer_size_ = size;
+      }
+      SubMatrix<BaseFloat> staging(pinned_buffer_, num_rows, num_cols,
+                                   num_cols);
+      if (features.Type() == kCompressedMatrix)
+        features.GetCompressedMatrix().CopyToMat(&staging);
+      else
+        staging.CopyFromMat(features.GetFullMatrix());
+      CU_SAFE_CALL(cudaMemcpy2DAsync(
+          dest.Data(), dest.Stride() * sizeof(BaseFloat),
+          pinned_buffer_, num_cols * sizeof(BaseFloat),
+          num_cols * sizeof(BaseFloat), num_rows,
+          cudaMemcpyHostToDevice, GetCudaStream()));
+      // The buffer is reused for the next matrix, and the training thread
+      // must not see the matrix before the copy has finished.
+      CU_SAFE_CALL(cudaStreamSynchronize(GetCudaStream()));
+      continue;
+    }
+#endif
+    dest.CopyFromGeneralMat(features);
+  }
+  if (opts_.augment.Enabled()) {
+    for (size_t i = 0; i < io.size(); i++) {
+      if (io[i].name != "input")
+        continue;
+      for (size_t j = 0; j < mb->inputs.names.size(); j++)
+        if (mb->inputs.names[j] == "input")
+          AugmentInputFeatures(opts_.augment, io[i], &rand_state_,
+                               &(mb->inputs.features[j]));
+    }
+  }
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled())
+    CU_SAFE_CALL(cudaStreamSynchronize(GetCudaStream()));
+#endif
+}
+
+
+template <class Example>
+void ExamplePrefetcher<Example>::ReadMinibatches() {
+  try {
+    for (; !reader_.Done(); reader_.Next()) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stop_ && minibatches_.size() >=
+               static_cast<size_t>(opts_.num_minibatches))
+          cond_.wait(lock);
+        if (stop_)
+          break;
+      }
+      Minibatch *mb = new Minibatch();
+      mb->eg.Swap(&(reader_.Value()));
+      PrepareInputs(mb);
+      std::unique_lock<std::mutex> lock(mutex_);
+      minibatches_.push_back(mb);
+      cond_.notify_all();
+    }
+  } catch (const std::exception &e) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    error_ = e.what();
+    if (error_.empty())
+      error_ = "unknown error";
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  finished_ = true;
+  cond_.notify_all();
+}
+
+
+template <class Example>
+bool ExamplePrefetcher<Example>::Done() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (minibatches_.empty() && !finished_)
+    cond_.wait(lock);
+  if (minibatches_.empty() && !error_.empty())
+    KALDI_ERR << "Error reading examples: " << error_;
+  return minibatches_.empty();
+}
+
+
+template <class Example>
+const Example &ExamplePrefetcher<Example>::Value() {
+  KALDI_ASSERT(!Done());
+  std::unique_lock<std::mutex> lock(mutex_);
+  return minibatches_.front()->eg;
+}
+
+
+template <class Example>
+const PrefetchedInputs &ExamplePrefetcher<Example>::Inputs() {
+  KALDI_ASSERT(!Done());
+  std::unique_lock<std::mutex> lock(mutex_);
+  return minibatches_.front()->inputs;
+}
+
+
+template <class Example>
+void ExamplePrefetcher<Example>::Next() {
+  KALDI_ASSERT(!Done());
+  std::unique_lock<std::mutex> lock(mutex_);
+  delete minibatches_.front();
+  minibatches_.pop_front();
+  cond_.notify_all();
+}
+
+
+template <class Example>
+ExamplePrefetcher<Example>::~ExamplePrefetcher() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stop_ = true;
+    cond_.notify_all();
+  }
+  thread_.join();
+  for (size_t i = 0; i < minibatches_.size(); i++)
+    delete minibatches_[i];
+#if HAVE_CUDA == 1
+  if (pinned_buffer_ != NULL)
+    cudaFreeHost(pinned_buffer_);
+#endif
+}
+
+
+// Instantiate the template for the types of example that it's used with.
+template class ExamplePrefetcher<NnetExample>;
+template class ExamplePrefetcher<NnetChainExample>;
+
+
+} // namespace nnet3
+} // namespace kaldi
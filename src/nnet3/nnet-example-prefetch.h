@@ -0,0 +1,209 @@
+// nnet3/nnet-example-prefetch.h
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_NNET3_NNET_EXAMPLE_PREFETCH_H_
+#define KALDI_NNET3_NNET_EXAMPLE_PREFETCH_H_
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "nnet3/nnet-example.h"
+#include "nnet3/nnet-compute.h"
+#include "nnet3/nnet-nnet.h"
+#include "util/kaldi-table.h"
+
+namespace kaldi {
+namespace nnet3 {
+
+struct NnetChainExample;  // defined in nnet-chain-example.h
+
+
+/// Options for the data augmentation that ExamplePrefetcher applies to the
+/// "input" features of the minibatches after they are copied to the GPU: the
+/// frequency and time masks of SpecAugment and a random gain, all chosen
+/// independently for each sequence (value of 'n') of the minibatch.  These
+/// are meant for log-mel filterbank features; with MFCCs you would probably
+/// want to use the masking of GeneralDropoutComponent and
+/// SpecAugmentTimeMaskComponent inside the network instead.
+struct NnetAugmentOptions {
+  int32 freq_mask_width;
+  int32 num_freq_masks;
+  int32 time_mask_width;
+  int32 num_time_masks;
+  BaseFloat max_log_gain;
+  NnetAugmentOptions(): freq_mask_width(0), num_freq_masks(1),
+                        time_mask_width(0), num_time_masks(1),
+                        max_log_gain(0.0) { }
+  void Register(OptionsItf *opts) {
+    opts->Register("augment-freq-mask-width", &freq_mask_width, "If >0, the "
+                   "maximum width of the frequency masks (bands of feature "
+                   "dimensions set to zero) applied to the input features "
+                   "of the minibatches.");
+    opts->Register("augment-num-freq-masks", &num_freq_masks, "Number of "
+                   "frequency masks per sequence (see "
+                   "--augment-freq-mask-width).");
+    opts->Register("augment-time-mask-width", &time_mask_width, "If >0, the "
+                   "maximum width, in frames, of the time masks (frames set "
+                   "to zero) applied to the input features of the "
+                   "minibatches.");
+    opts->Register("augment-num-time-masks", &num_time_masks, "Number of "
+                   "time masks per sequence (see --augment-time-mask-width).");
+    opts->Register("augment-max-log-gain", &max_log_gain, "If >0, a gain "
+                   "whose log is uniformly distributed in [-x, x] is applied "
+                   "to each sequence of the minibatches, by adding its log "
+                   "to the (log-filterbank) input features.");
+  }
+  bool Enabled() const {
+    return (freq_mask_width > 0 && num_freq_masks > 0) ||
+        (time_mask_width > 0 && num_time_masks > 0) || max_log_gain > 0.0;
+  }
+};
+
+
+struct NnetPrefetchOptions {
+  int32 num_minibatches;
+  NnetAugmentOptions augment;
+  NnetPrefetchOptions(): num_minibatches(2) { }
+  void Register(OptionsItf *opts) {
+    opts->Register("prefetch", &num_minibatches, "Number of minibatches "
+                   "that are read, decompressed and (if using a GPU) copied "
+                   "to the GPU by a background thread ahead of the training; "
+                   "if 0, this is done in the training thread.");
+    augment.Register(opts);
+  }
+};
+
+
+/// The input features of a minibatch, copied to CuMatrix form (i.e. to the
+/// GPU, if we are using one) ahead of time by class ExamplePrefetcher.
+struct PrefetchedInputs {
+  /// The names of the input nodes.
+  std::vector<std::string> names;
+  /// The features for each of the input nodes.
+  std::vector<CuMatrix<BaseFloat> > features;
+
+  /// Gives a copy of the features to 'computer' as its inputs, like
+  /// NnetComputer::AcceptInputs() does for the features of an example.
+  void CopyToComputer(NnetComputer *computer) const;
+};
+
+
+/**
+   Applies the augmentation configured in 'opts' to 'features', which are the
+   features of 'io' (typically the "input" of a merged minibatch) in CuMatrix
+   form.  The masks and gains are chosen independently for each sequence,
+   i.e. each value of 'n' in io.indexes, using 'state' for the random
+   numbers; the time masks are in terms of the 't' values of the rows.  The
+   work is done with a few matrix operations, so if 'features' is on the GPU
+   the features are never copied back to the CPU.
+*/
+void AugmentInputFeatures(const NnetAugmentOptions &opts,
+                          const NnetIo &io,
+                          RandomState *state,
+                          CuMatrixBase<BaseFloat> *features);
+
+
+/**
+   This class reads examples from a table on a background thread, keeping up
+   to opts.num_minibatches of them ahead of the caller, and copies their input
+   features to CuMatrix form, so the training thread doesn't have to wait for
+   the reading, the decompression of the features or their copying to the GPU.
+   When using a GPU, the features are decompressed to pinned memory and copied
+   from there on the background thread's CUDA stream.  If opts.augment is
+   enabled, the features of the input named "input" are then augmented (see
+   AugmentInputFeatures()), also on the background thread.
+
+   The interface is like that of SequentialTableReader; 'Example' is
+   NnetExample or NnetChainExample.  The merging of examples into
+   minibatches stays in the nnet3-merge-egs (or nnet3-chain-merge-egs)
+   process of the input pipeline, which already runs concurrently.
+ */
+template <class Example>
+class ExamplePrefetcher {
+ public:
+  /// 'nnet' is only used in the constructor, to see which of the NnetIo
+  /// objects of the examples are inputs.  If using a GPU, this must be
+  /// constructed after selecting it.
+  ExamplePrefetcher(const NnetPrefetchOptions &opts,
+                    const Nnet &nnet,
+                    const std::string &examples_rspecifier);
+
+  /// Returns true if there are no more examples; waits for the background
+  /// thread if necessary.
+  bool Done();
+
+  /// The current example; only valid if !Done().
+  const Example &Value();
+
+  /// The input features of the current example; only valid if !Done().
+  const PrefetchedInputs &Inputs();
+
+  void Next();
+
+  ~ExamplePrefetcher();
+
+ private:
+  struct Minibatch {
+    Example eg;
+    PrefetchedInputs inputs;
+  };
+
+  // The function run by the background thread.
+  void ReadMinibatches();
+
+  // Copies the input features of mb->eg to mb->inputs.
+  void PrepareInputs(Minibatch *mb);
+
+  const NnetPrefetchOptions &opts_;
+  // Used for the augmentation; only used by the background thread.
+  RandomState rand_state_;
+  // The names of the input nodes of the nnet.
+  std::vector<std::string> input_names_;
+  SequentialTableReader<KaldiObjectHolder<Example> > reader_;
+
+  // The variables below are guarded by mutex_.
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::deque<Minibatch*> minibatches_;
+  bool finished_;  // true when the background thread has finished reading.
+  bool stop_;  // set by the destructor to tell the background thread to stop.
+  std::string error_;  // error message from the background thread, if any.
+
+  // Pinned host memory that the features are decompressed to before they are
+  // copied to the GPU; only used by the background thread.
+  BaseFloat *pinned_buffer_;
+  size_t pinned_buffer_size_;  // in elements.
+
+  std::thread thread_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(ExamplePrefetcher);
+};
+
+typedef ExamplePrefetcher<NnetExample> NnetExamplePrefetcher;
+typedef ExamplePrefetcher<NnetChainExample> NnetChainExamplePrefetcher;
+
+
+} // namespace nnet3
+} // namespace kaldi
+
+#endif // KALDI_NNET3_NNET_EXAMPLE_PREFETCH_H_
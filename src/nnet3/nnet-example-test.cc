@@ -92,6 +92,15 @@ void UnitTestNnetMergeExamples() {
     MergeExamples(egs_to_be_merged, compress, &eg_merged);
     KALDI_LOG << "Merged example is: ";
     eg_merged.Write(std::cerr, false);
+
+    // The version that reuses memory should give the same result, also when
+    // it is called again with the same output.
+    NnetExample eg_reused;
+    std::vector<Matrix<BaseFloat> > buffers;
+    for (int32 i = 0; i < 2; i++) {
+      MergeExamples(egs_to_be_merged, compress, &buffers, &eg_reused);
+      KALDI_ASSERT(eg_reused == eg_merged);
+    }
   }
 }
 
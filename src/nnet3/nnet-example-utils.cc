@@ -83,12 +83,69 @@ static void GetIoSizes(const std::vector<NnetExample> &src,
 
 
 
+// Appends the rows of the matrices in 'src' and puts the result in 'dest',
+// compressing it if 'compress' is true.  If 'buffer' is non-NULL and the
+// features are not sparse, it reuses the memory of the full matrix in 'dest'
+// (or, if compressing, of 'buffer') when it has the right size.
+static void AppendFeatures(const std::vector<GeneralMatrix const*> &src,
+                           bool compress,
+                           Matrix<BaseFloat> *buffer,
+                           GeneralMatrix *dest) {
+  bool sparse = false;
+  int32 tot_rows = 0, num_cols = 0;
+  for (size_t i = 0; i < src.size(); i++) {
+    if (src[i]->NumRows() == 0)
+      continue;
+    if (src[i]->Type() == kSparseMatrix)
+      sparse = true;
+    tot_rows += src[i]->NumRows();
+    num_cols = src[i]->NumCols();  // GetIoSizes() checked the dims.
+  }
+  if (buffer == NULL || sparse || tot_rows == 0) {
+    AppendGeneralMatrixRows(src, dest);
+    if (compress) {
+      // the following won't do anything if the features were sparse.
+      dest->Compress();
+    }
+    return;
+  }
+  Matrix<BaseFloat> mat;
+  if (compress)
+    mat.Swap(buffer);
+  else if (dest->Type() == kFullMatrix)
+    dest->SwapFullMatrix(&mat);
+  // This does not reallocate if the size is unchanged.
+  mat.Resize(tot_rows, num_cols, kUndefined);
+  int32 row_offset = 0;
+  for (size_t i = 0; i < src.size(); i++) {
+    int32 src_rows = src[i]->NumRows();
+    if (src_rows != 0) {
+      SubMatrix<BaseFloat> dest_submat(mat, row_offset, src_rows,
+                                       0, num_cols);
+      src[i]->CopyToMat(&dest_submat);
+      row_offset += src_rows;
+    }
+  }
+  dest->Clear();
+  if (compress) {
+    CompressedMatrix cmat(mat);
+    dest->SwapCompressedMatrix(&cmat);
+    mat.Swap(buffer);
+  } else {
+    dest->SwapFullMatrix(&mat);
+  }
+}
+
+
 // Do the final merging of NnetIo, once we have obtained the names, dims and
-// sizes for each feature/supervision type.
+// sizes for each feature/supervision type.  If 'buffers' is non-NULL, memory
+// in 'merged_eg' and 'buffers' is reused where possible (see the 2nd version
+// of MergeExamples()).
 static void MergeIo(const std::vector<NnetExample> &src,
                     const std::vector<std::string> &names,
                     const std::vector<int32> &sizes,
                     bool compress,
+                    std::vector<Matrix<BaseFloat> > *buffers,
                     NnetExample *merged_eg) {
   // The total number of Indexes we have across all examples.
   int32 num_feats = names.size();
@@ -98,9 +155,18 @@ static void MergeIo(const std::vector<NnetExample> &src,
   // The features in the different NnetIo in the Indexes across all examples
   std::vector<std::vector<GeneralMatrix const*> > output_lists(num_feats);
 
-  // Initialize the merged_eg
-  merged_eg->io.clear();
-  merged_eg->io.resize(num_feats);
+  // Initialize the merged_eg.  We keep its NnetIo objects if they are for the
+  // same names, so that the memory of their Indexes can be reused.
+  bool same_names = (static_cast<int32>(merged_eg->io.size()) == num_feats);
+  for (int32 f = 0; same_names && f < num_feats; f++)
+    if (merged_eg->io[f].name != names[f])
+      same_names = false;
+  if (!same_names) {
+    merged_eg->io.clear();
+    merged_eg->io.resize(num_feats);
+  }
+  if (buffers != NULL)
+    buffers->resize(num_feats);
   for (int32 f = 0; f < num_feats; f++) {
     NnetIo &io = merged_eg->io[f];
     int32 size = sizes[f];
@@ -147,14 +213,10 @@ static void MergeIo(const std::vector<NnetExample> &src,
     }
   }
   KALDI_ASSERT(cur_size == sizes);
-  for (int32 f = 0; f < num_feats; f++) {
-    AppendGeneralMatrixRows(output_lists[f],
-                            &(merged_eg->io[f].features));
-    if (compress) {
-      // the following won't do anything if the features were sparse.
-      merged_eg->io[f].features.Compress();
-    }
-  }
+  for (int32 f = 0; f < num_feats; f++)
+    AppendFeatures(output_lists[f], compress,
+                   (buffers != NULL ? &((*buffers)[f]) : NULL),
+                   &(merged_eg->io[f].features));
 }
 
 
@@ -168,7 +230,19 @@ void MergeExamples(const std::vector<NnetExample> &src,
   // the sizes are the total number of Indexes we have across all examples.
   std::vector<int32> io_sizes;
   GetIoSizes(src, io_names, &io_sizes);
-  MergeIo(src, io_names, io_sizes, compress, merged_eg);
+  MergeIo(src, io_names, io_sizes, compress, NULL, merged_eg);
+}
+
+void MergeExamples(const std::vector<NnetExample> &src,
+                   bool compress,
+                   std::vector<Matrix<BaseFloat> > *buffers,
+                   NnetExample *merged_eg) {
+  KALDI_ASSERT(!src.empty() && buffers != NULL);
+  std::vector<std::string> io_names;
+  GetIoNames(src, &io_names);
+  std::vector<int32> io_sizes;
+  GetIoSizes(src, io_names, &io_sizes);
+  MergeIo(src, io_names, io_sizes, compress, buffers, merged_eg);
 }
 
 void ShiftExampleTimes(int32 t_offset,
@@ -1229,11 +1303,12 @@ void ExampleMerger::WriteMinibatch(const std::vector<NnetExample> &egs) {
   size_t structure_hash = eg_hasher(egs[0]);
   int32 minibatch_size = egs.size();
   stats_.WroteExample(eg_size, structure_hash, minibatch_size);
-  NnetExample merged_eg;
-  MergeExamples(egs, config_.compress, &merged_eg);
+  MergingBuffer &buffer =
+      buffers_[std::make_pair(structure_hash, minibatch_size)];
+  MergeExamples(egs, config_.compress, &(buffer.features), &(buffer.eg));
   std::ostringstream key;
   key << "merged-" << (num_egs_written_++) << "-" << minibatch_size;
-  writer_->Write(key.str(), merged_eg);
+  writer_->Write(key.str(), buffer.eg);
 }
 
 void ExampleMerger::Finish() {
@@ -38,6 +38,19 @@ void MergeExamples(const std::vector<NnetExample> &src,
                    bool compress,
                    NnetExample *dest);
 
+/** This version of MergeExamples() reuses memory from one minibatch to the
+    next.  'dest' would normally hold the result of a previous call for
+    examples of the same structure and number (see class ExampleMerger); its
+    Indexes and uncompressed feature matrices are then overwritten in place
+    instead of being reallocated.  If "compress" is true, 'buffers' holds the
+    uncompressed features between calls (one matrix per NnetIo).  The result
+    is the same as from the version above.
+ */
+void MergeExamples(const std::vector<NnetExample> &src,
+                   bool compress,
+                   std::vector<Matrix<BaseFloat> > *buffers,
+                   NnetExample *dest);
+
 
 /** Shifts the time-index t of everything in the "eg" by adding "t_offset" to
     all "t" values.  This might be useful in things like clockwork RNNs that are
@@ -509,6 +522,16 @@ class ExampleMerger {
   NnetExampleWriter *writer_;
   ExampleMergingStats stats_;
 
+  // The merged example and feature buffers for each (structure-hash,
+  // minibatch-size), which are reused to avoid reallocating them for each
+  // minibatch; there are only a few distinct sizes, as set by the config.
+  struct MergingBuffer {
+    NnetExample eg;
+    std::vector<Matrix<BaseFloat> > features;
+  };
+  unordered_map<std::pair<size_t, int32>, MergingBuffer,
+                PairHasher<size_t, int32> > buffers_;
+
   // Note: the "key" into the egs is the first element of the vector.
   typedef unordered_map<NnetExample*, std::vector<NnetExample*>,
                         NnetExampleStructureHasher,
@@ -259,6 +259,9 @@ class StatisticsExtractionComponent: public Component {
       const std::vector<Index> &output_indexes,
       bool need_backprop) const;
 
+  // The statistics are output only for 't' values that are multiples of this.
+  int32 OutputPeriod() const { return output_period_; }
+
  private:
   // Checks that the parameters are valid.
   void Check() const;
@@ -396,6 +399,10 @@ class StatisticsPoolingComponent: public Component {
       const std::vector<Index> &output_indexes,
       bool need_backprop) const;
 
+  // The input statistics are only used for 't' values that are multiples of
+  // this.
+  int32 InputPeriod() const { return input_period_; }
+
  private:
   // Checks that the parameters are valid.
   void Check() const;
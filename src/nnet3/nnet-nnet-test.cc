@@ -24,6 +24,34 @@ namespace kaldi {
 namespace nnet3 {
 
 
+void UnitTestRemoveOrphanInputs() {
+  // 'ivector' and 'extra' are both unused, and are next to each other in the
+  // list of orphan nodes; RemoveOrphanNodes() should keep both of them, as
+  // remove_orphan_inputs is false.
+  std::string config =
+    "component name=affine1 type=AffineComponent input-dim=10 output-dim=4\n"
+    "component name=affine2 type=AffineComponent input-dim=10 output-dim=4\n"
+    "\n"
+    "input-node name=input dim=10\n"
+    "input-node name=ivector dim=5\n"
+    "input-node name=extra dim=3\n"
+    "component-node name=affine1 component=affine1 input=input\n"
+    "component-node name=affine2 component=affine2 input=input\n"
+    "output-node name=output input=affine1\n";
+  Nnet nnet;
+  std::istringstream is(config);
+  nnet.ReadConfig(is);
+  nnet.RemoveOrphanNodes();
+  KALDI_ASSERT(nnet.GetNodeIndex("input") != -1 &&
+               nnet.GetNodeIndex("ivector") != -1 &&
+               nnet.GetNodeIndex("extra") != -1 &&
+               nnet.GetNodeIndex("affine2") == -1);
+  nnet.RemoveOrphanNodes(true);
+  KALDI_ASSERT(nnet.GetNodeIndex("input") != -1 &&
+               nnet.GetNodeIndex("ivector") == -1 &&
+               nnet.GetNodeIndex("extra") == -1);
+}
+
 void UnitTestNnetIo() {
   for (int32 n = 0; n < 100; n++) {
     struct NnetGenerationOptions gen_config;
@@ -55,6 +83,29 @@ void UnitTestNnetIo() {
   }
 }
 
+void UnitTestNnetIoParamBlob() {
+  for (int32 n = 0; n < 20; n++) {
+    struct NnetGenerationOptions gen_config;
+
+    std::vector<std::string> configs;
+    GenerateConfigSequence(gen_config, &configs);
+    Nnet nnet;
+    std::istringstream is(configs[0]);
+    nnet.ReadConfig(is);
+
+    std::ostringstream os, blob_os;
+    nnet.Write(os, true);
+    nnet.WriteWithParamBlob(blob_os);
+
+    std::istringstream nnet_is(blob_os.str());
+    Nnet nnet2;
+    nnet2.Read(nnet_is, true);
+    std::ostringstream os2;
+    nnet2.Write(os2, true);
+    KALDI_ASSERT(os2.str() == os.str());
+  }
+}
+
 } // namespace nnet3
 } // namespace kaldi
 
@@ -62,7 +113,9 @@ int main() {
   using namespace kaldi;
   using namespace kaldi::nnet3;
 
+  UnitTestRemoveOrphanInputs();
   UnitTestNnetIo();
+  UnitTestNnetIoParamBlob();
 
   KALDI_LOG << "Nnet tests succeeded.";
 
@@ -25,6 +25,7 @@
 #include "nnet3/nnet-simple-component.h"
 #include "nnet3/am-nnet-simple.h"
 #include "hmm/transition-model.h"
+#include "matrix/param-blob.h"
 
 namespace kaldi {
 namespace nnet3 {
@@ -598,6 +599,15 @@ void Nnet::Read(std::istream &is, bool binary) {
     return;
   }
 
+  ParamBlob param_blob;
+  if (first_char == 'P') {
+    // This nnet was written by WriteWithParamBlob(), so the data of the
+    // components' matrices and vectors comes first, as one block.
+    param_blob.Read(is, binary);
+  }
+  ParamBlobReadScope blob_scope(first_char == 'P' ? &param_blob :
+                                ParamBlob::CurrentReadBlob());
+
   ExpectToken(is, binary, "<Nnet3>");
   std::ostringstream config_file_out;
   std::string cur_line;
@@ -655,6 +665,18 @@ void Nnet::Write(std::ostream &os, bool binary) const {
   WriteToken(os, binary, "</Nnet3>");
 }
 
+void Nnet::WriteWithParamBlob(std::ostream &os) const {
+  ParamBlob param_blob;
+  std::ostringstream structure;
+  {
+    ParamBlobWriteScope blob_scope(&param_blob);
+    Write(structure, true);
+  }
+  param_blob.Write(os, true);
+  std::string structure_str = structure.str();
+  os.write(structure_str.data(), structure_str.size());
+}
+
 int32 Nnet::Modulus() const {
   int32 ans = 1;
   for (int32 n = 0; n < NumNodes(); n++) {
@@ -935,7 +957,7 @@ void Nnet::RemoveOrphanNodes(bool remove_orphan_inputs) {
   if (!remove_orphan_inputs)
     for (int32 i = 0; i < orphan_nodes.size(); i++)
       if (IsInputNode(orphan_nodes[i]))
-        orphan_nodes.erase(orphan_nodes.begin() + i);
+        orphan_nodes.erase(orphan_nodes.begin() + i--);
   // For each component-node, its component-input node (which is kind of a
   // "hidden" node) would be included in 'orphan_nodes', but for diagnostic
   // purposes we want to exclude these from 'num_nodes_removed' to avoid
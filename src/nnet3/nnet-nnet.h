@@ -216,6 +216,13 @@ class Nnet {
 
   void Write(std::ostream &ostream, bool binary) const;
 
+  /// Writes the nnet in binary form like Write(), except that the data of all
+  /// the matrices and vectors of the components is written first as a single
+  /// block (see ParamBlob in matrix/param-blob.h), and the components refer to
+  /// it.  This is faster to read, since all the parameters are read with one
+  /// large read.  Read() reads either form.
+  void WriteWithParamBlob(std::ostream &ostream) const;
+
   /// Checks the neural network for validity (dimension matches and various
   /// other requirements).
   /// You can call this with warn_for_orphans = false to disable the warnings
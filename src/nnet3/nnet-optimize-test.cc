@@ -23,6 +23,7 @@
 #include "nnet3/nnet-test-utils.h"
 #include "nnet3/nnet-optimize.h"
 #include "nnet3/nnet-compute.h"
+#include "nnet3/nnet-utils.h"
 
 namespace kaldi {
 namespace nnet3 {
@@ -265,6 +266,16 @@ static void UnitTestNnetOptimizeInternal(int32 srand_seed) {
                                                               compiler);
   optimize = optimize_all;
 
+  optimize.fuse_propagate = false;
+  bool succ_no_fuse_propagate = UnitTestNnetOptimizeWithOptions(srand_seed, optimize,
+                                                                compiler);
+  optimize = optimize_all;
+
+  optimize.static_memory_plan = false;
+  bool succ_no_static_memory_plan = UnitTestNnetOptimizeWithOptions(srand_seed, optimize,
+                                                                    compiler);
+  optimize = optimize_all;
+
 
   optimize.min_deriv_time = std::numeric_limits<int32>::min();
   optimize.max_deriv_time = std::numeric_limits<int32>::max();
@@ -288,6 +299,8 @@ static void UnitTestNnetOptimizeInternal(int32 srand_seed) {
     << "\n  allocate_from_other  ... " << KALDI_SUCCFAIL(succ_no_allocate_from_other)
     << "\n  move_sizing_commands ... " << KALDI_SUCCFAIL(succ_no_move_sizing_commands)
     << "\n  snip_row_ops         ... " << KALDI_SUCCFAIL(succ_no_snip_row_ops)
+    << "\n  fuse_propagate       ... " << KALDI_SUCCFAIL(succ_no_fuse_propagate)
+    << "\n  static_memory_plan   ... " << KALDI_SUCCFAIL(succ_no_static_memory_plan)
     << "\n  no_deriv_time        ... " << KALDI_SUCCFAIL(succ_no_deriv_time);
 #undef KALDI_SUCCFAIL
 }
@@ -300,6 +313,209 @@ static void UnitTestNnetOptimize() {
   }
 }
 
+// Tests the caching of computations in a directory
+// (CachingOptimizingCompilerOptions::cache_dir).
+static void UnitTestCompilerCacheDir() {
+  struct NnetGenerationOptions gen_config;
+  std::vector<std::string> configs;
+  GenerateConfigSequence(gen_config, &configs);
+  Nnet nnet;
+  for (size_t j = 0; j < configs.size(); j++) {
+    std::istringstream is(configs[j]);
+    nnet.ReadConfig(is);
+  }
+  ComputationRequest request;
+  std::vector<Matrix<BaseFloat> > inputs;
+  ComputeExampleComputationRequestSimple(nnet, &request, &inputs);
+
+  NnetOptimizeOptions opt_config;
+  CachingOptimizingCompilerOptions compiler_config;
+  compiler_config.cache_dir = ".";
+  std::string filename = GetComputationCacheFilename(
+      compiler_config.cache_dir, nnet, opt_config,
+      compiler_config.use_shortcut);
+  std::remove(filename.c_str());
+
+  // The file should not depend on the parameters.
+  Nnet nnet_scaled(nnet);
+  ScaleNnet(0.5, &nnet_scaled);
+  KALDI_ASSERT(GetComputationCacheFilename(compiler_config.cache_dir,
+                                           nnet_scaled, opt_config,
+                                           compiler_config.use_shortcut) ==
+               filename);
+
+  std::string computation_str;
+  {
+    CachingOptimizingCompiler compiler(nnet, opt_config, compiler_config);
+    std::ostringstream os;
+    compiler.Compile(request)->Print(os, nnet);
+    computation_str = os.str();
+  }  // the destructor writes the file.
+
+  {
+    bool binary;
+    Input ki(filename, &binary);
+    NnetOptimizeOptions opt_config_cached;
+    opt_config_cached.Read(ki.Stream(), binary);
+    KALDI_ASSERT(opt_config_cached == opt_config);
+    ComputationCache cache(compiler_config.cache_capacity);
+    cache.Read(ki.Stream(), binary);
+    std::shared_ptr<const NnetComputation> computation = cache.Find(request);
+    KALDI_ASSERT(computation != NULL);
+    std::ostringstream os;
+    computation->Print(os, nnet);
+    KALDI_ASSERT(os.str() == computation_str);
+  }
+  {
+    // A second process would read the computation.
+    CachingOptimizingCompiler compiler(nnet_scaled, opt_config,
+                                       compiler_config);
+    std::ostringstream os;
+    compiler.Compile(request)->Print(os, nnet);
+    KALDI_ASSERT(os.str() == computation_str);
+  }
+  {
+    // ReadAndMerge() should find the computation we have in the file.
+    ComputationCache cache(compiler_config.cache_capacity);
+    NnetComputation *computation = new NnetComputation();
+    Compiler compiler(request, nnet);
+    CompilerOptions opts;
+    compiler.CreateComputation(opts, computation);
+    cache.Insert(request, computation);
+    bool binary;
+    Input ki(filename, &binary);
+    NnetOptimizeOptions opt_config_cached;
+    opt_config_cached.Read(ki.Stream(), binary);
+    KALDI_ASSERT(cache.ReadAndMerge(ki.Stream(), binary));
+  }
+  std::remove(filename.c_str());
+}
+
+
+
+// Returns the binary form of 'computation', for comparing computations.
+static std::string ComputationToString(const NnetComputation &computation) {
+  std::ostringstream os;
+  computation.Write(os, true);
+  return os.str();
+}
+
+// Tests 'time shortcut' compilation (see RequestIsTimePeriodic() and
+// ExtrapolateComputation()): the computations for long requests that are
+// extrapolated from shorter ones should be exactly the ones that are compiled
+// directly.
+static void UnitTestCompilerTimeShortcut() {
+  int32 num_extrapolated = 0;
+  for (int32 i = 0; i < 20; i++) {
+    struct NnetGenerationOptions gen_config;
+    gen_config.allow_ivector = true;
+    std::vector<std::string> configs;
+    GenerateConfigSequence(gen_config, &configs);
+    Nnet nnet;
+    for (size_t j = 0; j < configs.size(); j++) {
+      std::istringstream is(configs[j]);
+      nnet.ReadConfig(is);
+    }
+    int32 left_context, right_context;
+    ComputeSimpleNnetContext(nnet, &left_context, &right_context);
+
+    // A request like those for whole utterances in nnet3-compute.
+    int32 num_sequences = RandInt(1, 2), num_frames = RandInt(100, 300);
+    ComputationRequest request;
+    for (int32 node = 0; node < nnet.NumNodes(); node++) {
+      if (!nnet.IsInputNode(node) && !nnet.IsOutputNode(node))
+        continue;
+      IoSpecification io_spec;
+      io_spec.name = nnet.GetNodeName(node);
+      int32 begin_t = 0, end_t = num_frames;
+      if (io_spec.name == "ivector") {
+        end_t = 1;
+      } else if (nnet.IsInputNode(node)) {
+        begin_t = -left_context;
+        end_t = num_frames + right_context;
+      }
+      for (int32 t = begin_t; t < end_t; t++)
+        for (int32 n = 0; n < num_sequences; n++)
+          io_spec.indexes.push_back(Index(n, t));
+      if (nnet.IsInputNode(node))
+        request.inputs.push_back(io_spec);
+      else
+        request.outputs.push_back(io_spec);
+    }
+
+    NnetOptimizeOptions opt_config;
+    std::vector<ComputationRequest> base_requests;
+    int32 num_periods;
+    if (RequestIsTimePeriodic(nnet, request, &base_requests, &num_periods)) {
+      KALDI_ASSERT(base_requests.size() == 4 && num_periods > 3);
+      // As in CachingOptimizingCompiler, extrapolating to 3 periods should
+      // give the computation for R(3) before we rely on it.
+      NnetComputation computations[4];
+      for (int32 k = 0; k < 4; k++) {
+        Compiler compiler(base_requests[k], nnet);
+        CompilerOptions opts;
+        opts.store_precomputed_indexes_info = true;
+        compiler.CreateComputation(opts, &(computations[k]));
+        Optimize(opt_config, nnet, MaxOutputTimeInRequest(base_requests[k]),
+                 &(computations[k]));
+      }
+      NnetComputation extrapolated;
+      if (ExtrapolateComputation(nnet, request.misc_info, computations[0],
+                                 computations[1], computations[2], 3, true,
+                                 &extrapolated)) {
+        ComputeMemoryPlan(&extrapolated);
+        if (ComputationToString(extrapolated) ==
+            ComputationToString(computations[3])) {
+          KALDI_ASSERT(ExtrapolateComputation(nnet, request.misc_info,
+                                              computations[0], computations[1],
+                                              computations[2], num_periods,
+                                              false, &extrapolated));
+          ComputeMemoryPlan(&extrapolated);
+          CheckComputation(nnet, extrapolated, false);
+          NnetComputation computation;
+          Compiler compiler(request, nnet);
+          CompilerOptions opts;
+          compiler.CreateComputation(opts, &computation);
+          Optimize(opt_config, nnet, MaxOutputTimeInRequest(request),
+                   &computation);
+          KALDI_ASSERT(ComputationToString(extrapolated) ==
+                       ComputationToString(computation));
+          num_extrapolated++;
+        }
+      }
+    }
+
+    // Whether or not the time shortcut is used, CachingOptimizingCompiler
+    // should give the same computation as without it.
+    CachingOptimizingCompilerOptions compiler_config;
+    compiler_config.use_time_shortcut = false;
+    CachingOptimizingCompiler compiler(nnet, opt_config, compiler_config);
+    compiler_config.use_time_shortcut = true;
+    CachingOptimizingCompiler compiler_time_shortcut(nnet, opt_config,
+                                                     compiler_config);
+    for (int32 j = 0; j < 3; j++) {
+      KALDI_ASSERT(ComputationToString(*compiler.Compile(request)) ==
+                   ComputationToString(
+                       *compiler_time_shortcut.Compile(request)));
+      // Make the request one frame longer, as for the next utterance; it
+      // may reuse the same base computations.
+      for (size_t k = 0; k < request.inputs.size() + request.outputs.size();
+           k++) {
+        IoSpecification &io_spec = (k < request.inputs.size() ?
+                                    request.inputs[k] :
+                                    request.outputs[k - request.inputs.size()]);
+        if (io_spec.name == "ivector")
+          continue;
+        int32 t = io_spec.indexes.back().t + 1;
+        for (int32 n = 0; n < num_sequences; n++)
+          io_spec.indexes.push_back(Index(n, t));
+      }
+    }
+  }
+  KALDI_LOG << "Extrapolated " << num_extrapolated << " out of 20 "
+            << "computations.";
+  KALDI_ASSERT(num_extrapolated > 0);
+}
 
 
 } // namespace nnet3
@@ -317,6 +533,8 @@ int main() {
   CuDevice::Instantiate().SelectGpuId("yes");
 #endif
   UnitTestNnetOptimize();
+  UnitTestCompilerCacheDir();
+  UnitTestCompilerTimeShortcut();
 
   KALDI_LOG << "Nnet tests succeeded.";
 
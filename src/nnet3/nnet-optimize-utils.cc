@@ -20,6 +20,7 @@
 #include <map>
 #include "nnet3/nnet-optimize-utils.h"
 #include "nnet3/nnet-optimize.h"
+#include "nnet3/nnet-general-component.h"
 
 namespace kaldi {
 namespace nnet3 {
@@ -32,6 +33,8 @@ void IdentifySubmatrixArgs(NnetComputation::Command *c,
     case kAllocMatrix:
     case kDeallocMatrix:
     case kSetConst:
+    case kCompressMatrix:
+    case kDecompressMatrix:
       submatrix_args->push_back(&c->arg1);
       break;
     case kSwapMatrix:
@@ -2327,6 +2330,218 @@ bool ReplaceRowWithMatrixOps(NnetComputation *computation) {
 
 
 
+// This function, called from FusePropagateCommands(), returns true if command
+// 'c' may be moved to just after the kPropagate command that precedes it,
+// without changing the result, given that the propagate command writes to
+// matrix 'matrix_index'.  We only allow commands that do nothing, or that just
+// allocate, deallocate or set other matrices (these are what typically end up
+// between the propagate commands after MoveSizingCommands()).
+static bool CanSkipCommand(const NnetComputation &computation,
+                           const NnetComputation::Command &c,
+                           int32 matrix_index) {
+  switch (c.command_type) {
+    case kNoOperation:
+      return true;
+    case kAllocMatrix: case kDeallocMatrix: case kSetConst:
+      return computation.submatrices[c.arg1].matrix_index != matrix_index;
+    default:
+      return false;
+  }
+}
+
+bool FusePropagateCommands(const Nnet &nnet, NnetComputation *computation) {
+  bool ans = false;
+  int32 num_commands = computation->commands.size();
+  for (int32 command_index = 1; command_index < num_commands;
+       command_index++) {
+    NnetComputation::Command &c = computation->commands[command_index];
+    // We can only fuse in-place propagation of simple components that don't
+    // need precomputed indexes, memos or stats.
+    if (c.command_type != kPropagate || c.arg3 != c.arg4 ||
+        c.arg2 != 0 || c.arg5 != 0 || c.arg6 != 0 || c.arg7 >= 0)
+      continue;
+    int32 properties = nnet.GetComponent(c.arg1)->Properties();
+    if (!(properties & kSimpleComponent) ||
+        !(properties & kPropagateInPlace) ||
+        (properties & (kUsesMemo | kPropagateAdds)))
+      continue;
+    int32 matrix_index = computation->submatrices[c.arg4].matrix_index,
+        prev_index = command_index - 1;
+    while (prev_index > 0 &&
+           CanSkipCommand(*computation, computation->commands[prev_index],
+                          matrix_index))
+      prev_index--;
+    NnetComputation::Command &prev_c = computation->commands[prev_index];
+    if (prev_c.command_type != kPropagate || prev_c.arg4 != c.arg3 ||
+        prev_c.arg7 >= 0)
+      continue;
+    prev_c.arg7 = c.arg1;
+    c.command_type = kNoOperation;
+    ans = true;
+  }
+  if (ans) {
+    RemoveNoOps(computation);
+    // removing commands may have invalidated the destination of any kGotoLabel
+    // command (in looped computations).
+    FixGotoLabel(computation);
+  }
+  return ans;
+}
+
+
+namespace {
+// Used in ComputeMemoryPlan(): a matrix that is to be placed in the workspace,
+// with the range of commands [begin_command, end_command] during which it may
+// be live, and its size in BaseFloats.
+struct WorkspaceMatrix {
+  int32 matrix_index;
+  int32 begin_command;
+  int32 end_command;
+  int64 size;
+  int64 offset;
+  bool Overlaps(const WorkspaceMatrix &other) const {
+    return begin_command <= other.end_command &&
+        other.begin_command <= end_command;
+  }
+  // Sort on decreasing size, so the biggest matrices are placed first.
+  bool operator < (const WorkspaceMatrix &other) const {
+    if (size != other.size) return size > other.size;
+    return matrix_index < other.matrix_index;
+  }
+};
+
+bool OffsetLess(const WorkspaceMatrix &a, const WorkspaceMatrix &b) {
+  return a.offset < b.offset;
+}
+}  // namespace
+
+void ComputeMemoryPlan(NnetComputation *computation) {
+  computation->workspace_offsets.clear();
+  int32 num_matrices = computation->matrices.size(),
+      num_commands = computation->commands.size();
+  // For each matrix: the commands that allocate and deallocate it, and the
+  // first and last commands that refer to it.  Note: we can't use class
+  // Analyzer here because it doesn't work for looped computations.
+  std::vector<int32> alloc_command(num_matrices, -1),
+      dealloc_command(num_matrices, -1),
+      first_access(num_matrices, num_commands),
+      last_access(num_matrices, -1);
+  // Matrices whose memory is exchanged with other matrices or with the user,
+  // or that are compressed, keep their own memory.
+  std::vector<bool> excluded(num_matrices, false);
+  excluded[0] = true;
+  std::vector<int32*> submatrix_args;
+  for (int32 c = 0; c < num_commands; c++) {
+    // make a copy, as IdentifySubmatrixArgs() wants a non-const pointer.
+    NnetComputation::Command command = computation->commands[c];
+    int32 m;
+    switch (command.command_type) {
+      case kAllocMatrix:
+        m = computation->submatrices[command.arg1].matrix_index;
+        if (alloc_command[m] != -1) excluded[m] = true;
+        alloc_command[m] = c;
+        break;
+      case kDeallocMatrix:
+        m = computation->submatrices[command.arg1].matrix_index;
+        if (dealloc_command[m] != -1) excluded[m] = true;
+        dealloc_command[m] = c;
+        break;
+      case kSwapMatrix:
+        excluded[computation->submatrices[command.arg2].matrix_index] = true;
+        // fall through.
+      case kCompressMatrix: case kDecompressMatrix:
+      case kAcceptInput: case kProvideOutput:
+        excluded[computation->submatrices[command.arg1].matrix_index] = true;
+        break;
+      case kAddRowsMulti: case kAddToRowsMulti:
+      case kCopyRowsMulti: case kCopyToRowsMulti: {
+        const std::vector<std::pair<int32, int32> > &pairs =
+            computation->indexes_multi[command.arg2];
+        for (size_t i = 0; i < pairs.size(); i++) {
+          if (pairs[i].first > 0) {
+            int32 m2 = computation->submatrices[pairs[i].first].matrix_index;
+            first_access[m2] = std::min(first_access[m2], c);
+            last_access[m2] = std::max(last_access[m2], c);
+          }
+        }
+        break;
+      }
+      default:
+        break;
+    }
+    IdentifySubmatrixArgs(&command, &submatrix_args);
+    for (size_t i = 0; i < submatrix_args.size(); i++) {
+      if (*(submatrix_args[i]) > 0) {
+        int32 m2 = computation->submatrices[*(submatrix_args[i])].matrix_index;
+        first_access[m2] = std::min(first_access[m2], c);
+        last_access[m2] = std::max(last_access[m2], c);
+      }
+    }
+  }
+
+  std::vector<WorkspaceMatrix> to_place;
+  for (int32 m = 1; m < num_matrices; m++) {
+    if (excluded[m] || alloc_command[m] == -1)
+      continue;
+    WorkspaceMatrix w;
+    w.matrix_index = m;
+    w.begin_command = alloc_command[m];
+    // A matrix that is never deallocated (e.g. in looped computations) is
+    // live until the end.
+    w.end_command = (dealloc_command[m] == -1 ? num_commands :
+                     dealloc_command[m]);
+    // Leave out matrices that are accessed outside their allocated lifetime,
+    // as can happen in looped computations.
+    if (first_access[m] < w.begin_command || last_access[m] > w.end_command)
+      continue;
+    // Round the size up to a multiple of 64 floats (256 bytes), which keeps
+    // the matrices aligned as the CUDA allocator would.
+    w.size = static_cast<int64>(computation->matrices[m].num_rows) *
+        computation->WorkspaceStride(m);
+    w.size = (w.size + 63) & ~static_cast<int64>(63);
+    w.offset = -1;
+    to_place.push_back(w);
+  }
+  if (to_place.empty())
+    return;
+
+  // Greedy placement: in order of decreasing size, put each matrix at the
+  // lowest offset at which it doesn't overlap any already-placed matrix whose
+  // lifetime overlaps its own.  'placed' is kept sorted on offset.
+  std::sort(to_place.begin(), to_place.end());
+  std::vector<WorkspaceMatrix> placed;
+  placed.reserve(to_place.size());
+  int64 workspace_size = 0;
+  for (size_t i = 0; i < to_place.size(); i++) {
+    WorkspaceMatrix &w = to_place[i];
+    int64 offset = 0;
+    for (size_t j = 0; j < placed.size(); j++) {
+      const WorkspaceMatrix &p = placed[j];
+      if (!w.Overlaps(p))
+        continue;
+      if (p.offset >= offset + w.size)
+        break;  // 'w' fits in the gap before 'p'.
+      offset = std::max(offset, p.offset + p.size);
+    }
+    w.offset = offset;
+    workspace_size = std::max(workspace_size, offset + w.size);
+    placed.insert(std::upper_bound(placed.begin(), placed.end(), w,
+                                   OffsetLess), w);
+  }
+  if (workspace_size > std::numeric_limits<int32>::max()) {
+    KALDI_WARN << "Workspace would be too large (" << workspace_size
+               << " floats), not using a static memory plan.";
+    return;
+  }
+  computation->workspace_offsets.resize(num_matrices, -1);
+  for (size_t i = 0; i < placed.size(); i++)
+    computation->workspace_offsets[placed[i].matrix_index] = placed[i].offset;
+  KALDI_VLOG(4) << "Static memory plan places " << placed.size() << " of "
+                << (num_matrices - 1) << " matrices in a workspace of "
+                << workspace_size << " floats.";
+}
+
+
 /*
   This function, used in SnipSingleRowOp(),
   finds the number of leading, and trailing, negative numbers
@@ -3887,6 +4102,457 @@ bool RequestIsDecomposable(const ComputationRequest &request,
 }
 
 
+// Describes the time structure of an input or output of a computation
+// request; used in RequestIsTimePeriodic().
+struct IoTimeStructure {
+  int32 block_size;  // The number of Indexes with each 't' value.
+  int32 num_blocks;  // The number of 't' values.
+  int32 t_step;      // The difference in 't' between blocks (0 if
+                     // num_blocks == 1).
+};
+
+// This helper function is used in RequestIsTimePeriodic(); it works out the
+// time structure of 'io_spec' and returns true if it is one of the kinds that
+// RequestIsTimePeriodic() accepts.
+static bool GetIoTimeStructure(const IoSpecification &io_spec,
+                               IoTimeStructure *structure) {
+  const std::vector<Index> &indexes = io_spec.indexes;
+  int32 size = indexes.size();
+  if (size == 0)
+    return false;
+  int32 block_size = 1;
+  while (block_size < size && indexes[block_size].t == indexes[0].t)
+    block_size++;
+  if (size % block_size != 0)
+    return false;
+  int32 num_blocks = size / block_size,
+      t_step = (num_blocks > 1 ? indexes[block_size].t - indexes[0].t : 0);
+  if (num_blocks > 1 && t_step <= 0)
+    return false;
+  for (int32 i = block_size; i < size; i++) {
+    const Index &index = indexes[i], &prev_index = indexes[i - block_size];
+    if (index.n != prev_index.n || index.x != prev_index.x ||
+        index.t != prev_index.t + t_step)
+      return false;
+  }
+  structure->block_size = block_size;
+  structure->num_blocks = num_blocks;
+  structure->t_step = t_step;
+  return true;
+}
+
+// This helper function is used in RequestIsTimePeriodic().  It returns the
+// period in 't' of the network's structure: the least common multiple of
+// nnet.Modulus() and the periods of the statistics components, which only
+// produce or use statistics for 't' values that are multiples of their period.
+static int32 GetNnetTimePeriod(const Nnet &nnet) {
+  int32 ans = nnet.Modulus();
+  for (int32 c = 0; c < nnet.NumComponents(); c++) {
+    const Component *component = nnet.GetComponent(c);
+    const StatisticsExtractionComponent *extraction_component =
+        dynamic_cast<const StatisticsExtractionComponent*>(component);
+    if (extraction_component != NULL)
+      ans = Lcm(ans, extraction_component->OutputPeriod());
+    const StatisticsPoolingComponent *pooling_component =
+        dynamic_cast<const StatisticsPoolingComponent*>(component);
+    if (pooling_component != NULL)
+      ans = Lcm(ans, pooling_component->InputPeriod());
+  }
+  return ans;
+}
+
+bool RequestIsTimePeriodic(const Nnet &nnet,
+                           const ComputationRequest &request,
+                           std::vector<ComputationRequest> *base_requests,
+                           int32 *num_periods) {
+  if (request.NeedDerivatives())
+    return false;
+  size_t num_inputs = request.inputs.size(),
+      num_outputs = request.outputs.size();
+  // the inputs followed by the outputs.
+  std::vector<IoTimeStructure> structures(num_inputs + num_outputs);
+  for (size_t i = 0; i < num_inputs + num_outputs; i++) {
+    const IoSpecification &io_spec = (i < num_inputs ? request.inputs[i] :
+                                      request.outputs[i - num_inputs]);
+    if (!GetIoTimeStructure(io_spec, &(structures[i])))
+      return false;
+  }
+  // 'period' is the period in 't'; 'min_span' and 'max_span' are the least and
+  // greatest number of frames covered by the time-periodic inputs and outputs.
+  int32 period = GetNnetTimePeriod(nnet),
+      min_span = std::numeric_limits<int32>::max(), max_span = 0;
+  for (size_t i = 0; i < structures.size(); i++) {
+    if (structures[i].num_blocks == 1)
+      continue;
+    period = Lcm(period, structures[i].t_step);
+    int32 span = structures[i].num_blocks * structures[i].t_step;
+    min_span = std::min(min_span, span);
+    max_span = std::max(max_span, span);
+  }
+  if (max_span == 0)
+    return false;  // Nothing depends on time.
+  // The difference in spans is about the context of the network.  R(0) should
+  // have room for the left and right context effects and a few periods in
+  // between; and it should be long enough that decisions in optimization that
+  // depend on proportions of matrix sizes (e.g. in ExtendMatrices(), which
+  // needs 80%) come out the same way as for longer requests.
+  int32 min_base_span = 8 * (max_span - min_span) + 4 * period,
+      min_num_periods = 4;
+  if (min_span - min_base_span < min_num_periods * period)
+    return false;
+  *num_periods = (min_span - min_base_span) / period;
+
+  base_requests->clear();
+  base_requests->resize(4, request);
+  for (int32 k = 0; k < 4; k++) {
+    ComputationRequest &base_request = (*base_requests)[k];
+    for (size_t i = 0; i < structures.size(); i++) {
+      const IoTimeStructure &structure = structures[i];
+      if (structure.num_blocks == 1)
+        continue;
+      IoSpecification &io_spec = (i < num_inputs ? base_request.inputs[i] :
+                                  base_request.outputs[i - num_inputs]);
+      int32 blocks_removed =
+          (*num_periods - k) * (period / structure.t_step);
+      io_spec.indexes.resize((structure.num_blocks - blocks_removed) *
+                             structure.block_size);
+    }
+  }
+  return true;
+}
+
+
+// The following functions, used in ExtrapolateComputation(), convert vectors
+// of structs or pairs to and from vectors of integers, with each struct
+// represented by a fixed number of integers; FlattenTuples() returns that
+// number.
+static int32 FlattenTuples(const std::vector<int32> &in,
+                           std::vector<int32> *out) {
+  *out = in;
+  return 1;
+}
+static void UnflattenTuples(const std::vector<int32> &in,
+                            std::vector<int32> *out) {
+  *out = in;
+}
+static int32 FlattenTuples(const std::vector<std::pair<int32, int32> > &in,
+                           std::vector<int32> *out) {
+  out->resize(2 * in.size());
+  for (size_t i = 0; i < in.size(); i++) {
+    (*out)[2 * i] = in[i].first;
+    (*out)[2 * i + 1] = in[i].second;
+  }
+  return 2;
+}
+static void UnflattenTuples(const std::vector<int32> &in,
+                            std::vector<std::pair<int32, int32> > *out) {
+  out->resize(in.size() / 2);
+  for (size_t i = 0; i < out->size(); i++)
+    (*out)[i] = std::pair<int32, int32>(in[2 * i], in[2 * i + 1]);
+}
+static int32 FlattenTuples(const std::vector<Index> &in,
+                           std::vector<int32> *out) {
+  out->resize(3 * in.size());
+  for (size_t i = 0; i < in.size(); i++) {
+    (*out)[3 * i] = in[i].n;
+    (*out)[3 * i + 1] = in[i].t;
+    (*out)[3 * i + 2] = in[i].x;
+  }
+  return 3;
+}
+static void UnflattenTuples(const std::vector<int32> &in,
+                            std::vector<Index> *out) {
+  out->resize(in.size() / 3);
+  for (size_t i = 0; i < out->size(); i++)
+    (*out)[i] = Index(in[3 * i], in[3 * i + 1], in[3 * i + 2]);
+}
+static int32 FlattenTuples(const std::vector<Cindex> &in,
+                           std::vector<int32> *out) {
+  out->resize(4 * in.size());
+  for (size_t i = 0; i < in.size(); i++) {
+    (*out)[4 * i] = in[i].first;
+    (*out)[4 * i + 1] = in[i].second.n;
+    (*out)[4 * i + 2] = in[i].second.t;
+    (*out)[4 * i + 3] = in[i].second.x;
+  }
+  return 4;
+}
+static void UnflattenTuples(const std::vector<int32> &in,
+                            std::vector<Cindex> *out) {
+  out->resize(in.size() / 4);
+  for (size_t i = 0; i < out->size(); i++)
+    (*out)[i] = Cindex(in[4 * i], Index(in[4 * i + 1], in[4 * i + 2],
+                                        in[4 * i + 3]));
+}
+static int32 FlattenTuples(const std::vector<NnetComputation::MatrixInfo> &in,
+                           std::vector<int32> *out) {
+  out->resize(3 * in.size());
+  for (size_t i = 0; i < in.size(); i++) {
+    (*out)[3 * i] = in[i].num_rows;
+    (*out)[3 * i + 1] = in[i].num_cols;
+    (*out)[3 * i + 2] = static_cast<int32>(in[i].stride_type);
+  }
+  return 3;
+}
+static void UnflattenTuples(const std::vector<int32> &in,
+                            std::vector<NnetComputation::MatrixInfo> *out) {
+  out->resize(in.size() / 3);
+  for (size_t i = 0; i < out->size(); i++)
+    (*out)[i] = NnetComputation::MatrixInfo(
+        in[3 * i], in[3 * i + 1], static_cast<MatrixStrideType>(in[3 * i + 2]));
+}
+static int32 FlattenTuples(
+    const std::vector<NnetComputation::SubMatrixInfo> &in,
+    std::vector<int32> *out) {
+  out->resize(5 * in.size());
+  for (size_t i = 0; i < in.size(); i++) {
+    (*out)[5 * i] = in[i].matrix_index;
+    (*out)[5 * i + 1] = in[i].row_offset;
+    (*out)[5 * i + 2] = in[i].num_rows;
+    (*out)[5 * i + 3] = in[i].col_offset;
+    (*out)[5 * i + 4] = in[i].num_cols;
+  }
+  return 5;
+}
+static void UnflattenTuples(const std::vector<int32> &in,
+                            std::vector<NnetComputation::SubMatrixInfo> *out) {
+  out->resize(in.size() / 5);
+  for (size_t i = 0; i < out->size(); i++)
+    (*out)[i] = NnetComputation::SubMatrixInfo(
+        in[5 * i], in[5 * i + 1], in[5 * i + 2], in[5 * i + 3], in[5 * i + 4]);
+}
+
+// This helper function is used in ExtrapolateIntegerSequence().  It tries the
+// hypothesis that each period inserts 'block_size' elements at position
+// 'block_begin' of the sequences v0, v1 and v2 (for 0, 1 and 2 periods), and if
+// it is consistent with them, outputs the sequence for 'num_periods' periods
+// and returns true.
+static bool ExtrapolateWithBlockAt(const std::vector<int32> &v0,
+                                   const std::vector<int32> &v1,
+                                   const std::vector<int32> &v2,
+                                   size_t block_begin, size_t block_size,
+                                   int32 num_periods,
+                                   std::vector<int32> *ans) {
+  size_t suffix_size = v0.size() - block_begin;
+  ans->resize(v0.size() + num_periods * block_size);
+  for (size_t i = 0; i < block_begin; i++) {
+    if (v1[i] != v0[i] || v2[i] != v0[i])
+      return false;
+    (*ans)[i] = v0[i];
+  }
+  // The elements of the first block are the same in v1 and v2; each
+  // following block differs from the one before by the same amount.
+  for (size_t j = 0; j < block_size; j++) {
+    int32 value = v1[block_begin + j];
+    if (v2[block_begin + j] != value)
+      return false;
+    int64 step = static_cast<int64>(v2[block_begin + block_size + j]) - value;
+    for (int32 k = 0; k < num_periods; k++) {
+      int64 this_value = value + k * step;
+      if (this_value != static_cast<int32>(this_value))
+        return false;
+      (*ans)[block_begin + k * block_size + j] = this_value;
+    }
+  }
+  for (size_t i = 0; i < suffix_size; i++) {
+    int32 value0 = v0[block_begin + i],
+        value1 = v1[block_begin + block_size + i],
+        value2 = v2[block_begin + 2 * block_size + i];
+    int64 step = static_cast<int64>(value1) - value0;
+    if (static_cast<int64>(value2) - value1 != step)
+      return false;
+    int64 this_value = value0 + num_periods * step;
+    if (this_value != static_cast<int32>(this_value))
+      return false;
+    (*ans)[block_begin + num_periods * block_size + i] = this_value;
+  }
+  return true;
+}
+
+// This helper function is used in ExtrapolateComputation().  'v0', 'v1' and
+// 'v2' are sequences of tuples of 'width' integers, for 0, 1 and 2 periods.
+// If they fit the model described for ExtrapolateComputation() in the header,
+// it outputs the sequence for 'num_periods' periods and returns true.
+static bool ExtrapolateIntegerSequence(const std::vector<int32> &v0,
+                                       const std::vector<int32> &v1,
+                                       const std::vector<int32> &v2,
+                                       int32 width, int32 num_periods,
+                                       std::vector<int32> *ans) {
+  if (v1.size() < v0.size() || v2.size() - v1.size() != v1.size() - v0.size())
+    return false;
+  size_t block_size = v1.size() - v0.size();
+  if (block_size % width != 0)
+    return false;
+  if (block_size == 0)
+    return ExtrapolateWithBlockAt(v0, v1, v2, 0, 0, num_periods, ans);
+  // The block is inserted at or before the end of the common prefix of the
+  // three sequences.  It's usually at the end, but the prefix may extend into
+  // the block if the block's first elements happen to equal the ones after it,
+  // so we also try a few earlier positions.
+  size_t block_begin = 0;
+  while (block_begin < v0.size() && v1[block_begin] == v0[block_begin] &&
+         v2[block_begin] == v0[block_begin])
+    block_begin++;
+  block_begin -= block_begin % width;
+  for (int32 attempt = 0; attempt < 8; attempt++) {
+    if (ExtrapolateWithBlockAt(v0, v1, v2, block_begin, block_size,
+                               num_periods, ans))
+      return true;
+    if (block_begin < static_cast<size_t>(width))
+      break;
+    block_begin -= width;
+  }
+  return false;
+}
+
+// This helper function is used in ExtrapolateComputation(); it applies
+// ExtrapolateIntegerSequence() to vectors of types that FlattenTuples() and
+// UnflattenTuples() handle.
+template <class T>
+static bool ExtrapolateVector(const std::vector<T> &v0,
+                              const std::vector<T> &v1,
+                              const std::vector<T> &v2,
+                              int32 num_periods,
+                              std::vector<T> *ans) {
+  std::vector<int32> flat0, flat1, flat2, flat_ans;
+  int32 width = FlattenTuples(v0, &flat0);
+  FlattenTuples(v1, &flat1);
+  FlattenTuples(v2, &flat2);
+  if (!ExtrapolateIntegerSequence(flat0, flat1, flat2, width, num_periods,
+                                  &flat_ans))
+    return false;
+  UnflattenTuples(flat_ans, ans);
+  return true;
+}
+
+static bool CommandsAreEqual(const NnetComputation::Command &c1,
+                             const NnetComputation::Command &c2) {
+  return c1.command_type == c2.command_type && c1.alpha == c2.alpha &&
+      c1.arg1 == c2.arg1 && c1.arg2 == c2.arg2 && c1.arg3 == c2.arg3 &&
+      c1.arg4 == c2.arg4 && c1.arg5 == c2.arg5 && c1.arg6 == c2.arg6 &&
+      c1.arg7 == c2.arg7;
+}
+
+bool ExtrapolateComputation(const Nnet &nnet,
+                            const MiscComputationInfo &misc_info,
+                            const NnetComputation &computation0,
+                            const NnetComputation &computation1,
+                            const NnetComputation &computation2,
+                            int32 num_periods,
+                            bool store_precomputed_indexes_info,
+                            NnetComputation *computation) {
+  const NnetComputation *computations[3] = { &computation0, &computation1,
+                                             &computation2 };
+  const NnetComputation &c0 = computation0, &c1 = computation1,
+      &c2 = computation2;
+  for (int32 k = 1; k < 3; k++) {
+    const NnetComputation &c = *(computations[k]);
+    if (c.matrices.size() != c0.matrices.size() ||
+        c.matrix_debug_info.size() != c0.matrix_debug_info.size() ||
+        c.submatrices.size() != c0.submatrices.size() ||
+        c.component_precomputed_indexes.size() !=
+        c0.component_precomputed_indexes.size() ||
+        c.indexes.size() != c0.indexes.size() ||
+        c.indexes_multi.size() != c0.indexes_multi.size() ||
+        c.indexes_ranges.size() != c0.indexes_ranges.size() ||
+        c.commands.size() != c0.commands.size() ||
+        c.need_model_derivative != c0.need_model_derivative)
+      return false;
+    for (size_t i = 0; i < c0.commands.size(); i++)
+      if (!CommandsAreEqual(c.commands[i], c0.commands[i]))
+        return false;
+    for (size_t m = 0; m < c0.matrix_debug_info.size(); m++)
+      if (c.matrix_debug_info[m].is_deriv != c0.matrix_debug_info[m].is_deriv)
+        return false;
+  }
+  computation->Clear();
+  computation->commands = c0.commands;
+  computation->need_model_derivative = c0.need_model_derivative;
+  if (!ExtrapolateVector(c0.matrices, c1.matrices, c2.matrices, num_periods,
+                         &(computation->matrices)) ||
+      !ExtrapolateVector(c0.submatrices, c1.submatrices, c2.submatrices,
+                         num_periods, &(computation->submatrices)))
+    return false;
+  computation->matrix_debug_info.resize(c0.matrix_debug_info.size());
+  for (size_t m = 0; m < c0.matrix_debug_info.size(); m++) {
+    computation->matrix_debug_info[m].is_deriv =
+        c0.matrix_debug_info[m].is_deriv;
+    if (!ExtrapolateVector(c0.matrix_debug_info[m].cindexes,
+                           c1.matrix_debug_info[m].cindexes,
+                           c2.matrix_debug_info[m].cindexes, num_periods,
+                           &(computation->matrix_debug_info[m].cindexes)))
+      return false;
+  }
+  computation->indexes.resize(c0.indexes.size());
+  for (size_t i = 0; i < c0.indexes.size(); i++)
+    if (!ExtrapolateVector(c0.indexes[i], c1.indexes[i], c2.indexes[i],
+                           num_periods, &(computation->indexes[i])))
+      return false;
+  computation->indexes_multi.resize(c0.indexes_multi.size());
+  for (size_t i = 0; i < c0.indexes_multi.size(); i++)
+    if (!ExtrapolateVector(c0.indexes_multi[i], c1.indexes_multi[i],
+                           c2.indexes_multi[i], num_periods,
+                           &(computation->indexes_multi[i])))
+      return false;
+  computation->indexes_ranges.resize(c0.indexes_ranges.size());
+  for (size_t i = 0; i < c0.indexes_ranges.size(); i++)
+    if (!ExtrapolateVector(c0.indexes_ranges[i], c1.indexes_ranges[i],
+                           c2.indexes_ranges[i], num_periods,
+                           &(computation->indexes_ranges[i])))
+      return false;
+
+  // The precomputed indexes are regenerated from the extrapolated Indexes, as
+  // in ComputationExpander::ComputePrecomputedIndexes().
+  int32 num_precomputed_indexes = c0.component_precomputed_indexes.size();
+  std::vector<bool> need_backprop(num_precomputed_indexes, false);
+  std::vector<int32> component_index(num_precomputed_indexes, -1);
+  for (size_t i = 0; i < c0.commands.size(); i++) {
+    const NnetComputation::Command &c = c0.commands[i];
+    if (c.command_type == kPropagate && c.arg2 > 0) {
+      KALDI_ASSERT(c.arg2 < num_precomputed_indexes);
+      component_index[c.arg2] = c.arg1;
+    }
+    if ((c.command_type == kBackprop ||
+         c.command_type == kBackpropNoModelUpdate) && c.arg2 > 0) {
+      KALDI_ASSERT(c.arg2 < num_precomputed_indexes);
+      need_backprop[c.arg2] = true;
+    }
+  }
+  computation->component_precomputed_indexes.resize(num_precomputed_indexes);
+  for (int32 p = 1; p < num_precomputed_indexes; p++) {
+    const NnetComputation::PrecomputedIndexesInfo
+        &info0 = c0.component_precomputed_indexes[p],
+        &info1 = c1.component_precomputed_indexes[p],
+        &info2 = c2.component_precomputed_indexes[p];
+    KALDI_ASSERT(!info0.input_indexes.empty() &&
+                 !info0.output_indexes.empty() &&
+                 "Input/output indexes not present in precomputed info of "
+                 "computation to be extrapolated.");
+    std::vector<Index> input_indexes, output_indexes;
+    if (!ExtrapolateVector(info0.input_indexes, info1.input_indexes,
+                           info2.input_indexes, num_periods, &input_indexes) ||
+        !ExtrapolateVector(info0.output_indexes, info1.output_indexes,
+                           info2.output_indexes, num_periods,
+                           &output_indexes))
+      return false;
+    KALDI_ASSERT(component_index[p] >= 0);
+    const Component *component = nnet.GetComponent(component_index[p]);
+    NnetComputation::PrecomputedIndexesInfo &info =
+        computation->component_precomputed_indexes[p];
+    info.data = component->PrecomputeIndexes(misc_info, input_indexes,
+                                             output_indexes, need_backprop[p]);
+    if (info.data == NULL)
+      return false;
+    if (store_precomputed_indexes_info ||
+        (input_indexes.back().n == 1 && output_indexes.back().n == 1)) {
+      info.input_indexes.swap(input_indexes);
+      info.output_indexes.swap(output_indexes);
+    }
+  }
+  return true;
+}
+
+
 class ComputationLoopedOptimizer {
  public:
   ComputationLoopedOptimizer(const Nnet &nnet,
@@ -5034,6 +5700,39 @@ void ComputationCache::Read(std::istream &is, bool binary) {
   }
 }
 
+bool ComputationCache::ReadAndMerge(std::istream &is, bool binary) {
+  int32 computation_cache_size;
+  ExpectToken(is, binary, "<ComputationCacheSize>");
+  ReadBasicType(is, binary, &computation_cache_size);
+  KALDI_ASSERT(computation_cache_size >= 0);
+  ExpectToken(is, binary, "<ComputationCache>");
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t num_existing = computation_cache_.size(), num_found = 0;
+  for (size_t c = 0; c < computation_cache_size; c++) {
+    ComputationRequest request;
+    request.Read(is, binary);
+    // we have to read the computation even if we don't keep it.
+    NnetComputation *computation = new NnetComputation();
+    computation->Read(is, binary);
+    if (computation_cache_.count(&request) != 0) {
+      num_found++;
+      delete computation;
+    } else if (static_cast<int32>(computation_cache_.size()) <
+               cache_capacity_) {
+      ComputationRequest *request_copy = new ComputationRequest(request);
+      std::shared_ptr<const NnetComputation> computation_ptr(computation);
+      AqType::iterator ait = access_queue_.insert(access_queue_.begin(),
+                                                  request_copy);
+      computation_cache_.insert(
+          std::make_pair(request_copy, std::make_pair(computation_ptr, ait)));
+    } else {
+      delete computation;
+    }
+  }
+  return num_found == num_existing;
+}
+
 void ComputationCache::Check(const Nnet &nnet) const {
   CacheType::const_iterator iter = computation_cache_.begin(),
       end = computation_cache_.end();
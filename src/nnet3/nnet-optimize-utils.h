@@ -433,6 +433,82 @@ void ExpandComputation(const Nnet &nnet,
                        NnetComputation *expanded_computation);
 
 
+/**  This function, used in 'time shortcut' compilation (see
+     CachingOptimizingCompilerOptions::use_time_shortcut), works out whether
+     the computation for a long request can be obtained by extrapolating the
+     computations for shorter requests with the same structure; this is to the
+     't' dimension what RequestIsDecomposable() is to the 'n' dimension.
+
+     Each input and output of the request must either have a single 't' value
+     (like an i-vector), or be 'time-periodic': it must consist of blocks of
+     Indexes, each with a single 't' value, where each block has the same (n, x)
+     values and the 't' values of successive blocks differ by a fixed step.
+     The period P is the least common multiple of those steps, nnet.Modulus()
+     and the periods of any statistics components.  The request must not need
+     derivatives.
+
+     If these conditions hold and the request is long enough, this function
+     outputs the 'base requests' R(0) ... R(3) and the number of periods K > 3,
+     and returns true.  R(k) is the request truncated at the end so that all
+     its time-periodic inputs and outputs are (K - k) * P frames shorter, so
+     R(K) would be the request itself.  R(0) is chosen to be long enough that
+     its computation contains the effects of both ends of the request, with a
+     'steady state' in between.
+ */
+bool RequestIsTimePeriodic(const Nnet &nnet,
+                           const ComputationRequest &request,
+                           std::vector<ComputationRequest> *base_requests,
+                           int32 *num_periods);
+
+
+/**
+  This function is used in 'time shortcut' compilation to extrapolate the
+  optimized computations for the base requests R(0), R(1) and R(2) output by
+  RequestIsTimePeriodic() to the computation for R(num_periods).
+
+  It relies on the computations having a regular structure: they must have the
+  same commands and the same numbers of matrices, submatrices, index vectors
+  and precomputed indexes.  The sizes and offsets of the matrices and
+  submatrices must change by a fixed amount per period; and each vector (of row
+  indexes, of the Cindexes in the debug info, or of the Indexes stored with the
+  precomputed indexes) must grow by a block of elements inserted at a fixed
+  position, whose values change by a fixed amount from one period to the next,
+  with the elements after it also changing by a fixed amount per period.  If
+  not, it returns false.  These conditions are necessary but not sufficient
+  for the result to be right, so the caller should check that extrapolating to
+  3 periods gives the computation compiled for R(3).
+
+     @param [in] nnet         The neural network for which the computations
+                              were compiled.
+     @param [in] misc_info    The MiscComputationInfo of the requests
+                              (required to generate the PrecomputedIndexes).
+     @param [in] computation0, computation1, computation2  The computations
+                              for R(0), R(1) and R(2).  They must have debug
+                              info and must have been compiled with
+                              CompilerOptions::store_precomputed_indexes_info
+                              = true.
+     @param [in] num_periods  The number of periods to extrapolate to.
+     @param [in] store_precomputed_indexes_info  If true, keep the input and
+                              output Indexes with the precomputed indexes of
+                              the output; otherwise only keep them if the
+                              Compiler would have (see
+                              Compiler::SetUpPrecomputedIndexes()).
+     @param [out] computation  The extrapolated computation.  Its
+                              workspace_offsets and CUDA indexes are not set
+                              up.
+     @return                  Returns true on success, false if the
+                              computations were not regular enough.
+*/
+bool ExtrapolateComputation(const Nnet &nnet,
+                            const MiscComputationInfo &misc_info,
+                            const NnetComputation &computation0,
+                            const NnetComputation &computation1,
+                            const NnetComputation &computation2,
+                            int32 num_periods,
+                            bool store_precomputed_indexes_info,
+                            NnetComputation *computation);
+
+
 
 /// This function detects cases where commands of type kCopyRows, kAddRows or
 /// kAddToRows can be converted to commands of type kMatrixCopy or kMatrixAdd,
@@ -444,6 +520,31 @@ void ExpandComputation(const Nnet &nnet,
 /// computation->indexes.
 bool ReplaceRowWithMatrixOps(NnetComputation *computation);
 
+/// This function, which is mostly useful in test-time computations, detects
+/// cases where a kPropagate command for a simple component that operates in
+/// place (e.g. RectifiedLinearComponent, or BatchNormComponent in test mode)
+/// works on the output of the kPropagate command just before it (e.g. for an
+/// AffineComponent), and fuses it into that command by setting its arg7 to the
+/// component index (see the documentation of kPropagate in
+/// nnet-computation.h).  This saves the overhead of a separate command, and
+/// means that the nonlinearity is applied to the output of the matrix
+/// multiplication while it is still likely to be in cache.  Only one
+/// component can be fused into each propagate command.
+///
+/// Returns true if it made any changes to the computation.
+bool FusePropagateCommands(const Nnet &nnet, NnetComputation *computation);
+
+/// This function computes a static memory plan for the computation (see the
+/// documentation of NnetComputation::workspace_offsets), so that NnetComputer
+/// can store most of the matrices in a single workspace that it allocates once,
+/// rather than calling the memory allocator for each kAllocMatrix and
+/// kDeallocMatrix command.  Matrices whose lifetimes (from allocation to
+/// deallocation) overlap are given disjoint memory.  Inputs and outputs of the
+/// computation, and matrices that are swapped or compressed, are left out of
+/// the plan.  Because the plan depends on the exact sequence of commands, this
+/// must be called after any other optimizations.
+void ComputeMemoryPlan(NnetComputation *computation);
+
 /// This function detects cases where commands of type kCopyRows, kAddRows,
 /// kAddRowsMulti, kAddToRowsMulti, kCopyRowsMulti, kCopyToRowsMulti or
 /// kAddRowRanges use indexes that start or end with -1's or equivalents,
@@ -632,6 +733,13 @@ class ComputationCache {
 
   void Write(std::ostream &os, bool binary) const;
 
+  // This is like Read(), but it adds the computations read to those already
+  // in the cache: computations for requests that we already have are not
+  // changed, and the others are added as the least recently used ones, while
+  // there is space in the cache (so none are purged).  Returns true if the
+  // stream contained all the requests that were in the cache before we were
+  // called.
+  bool ReadAndMerge(std::istream &is, bool binary);
 
   // Searches for the computation corresponding to this computation, and returns
   // it if cached, or NULL (as std::shared_ptr) if not.  (We need shared_ptr to
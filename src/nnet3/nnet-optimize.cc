@@ -18,11 +18,15 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <cstdio>
+#include <fstream>
 #include <iomanip>
+#include <random>
 #include "nnet3/nnet-optimize.h"
 #include "nnet3/nnet-optimize-utils.h"
 #include "nnet3/nnet-utils.h"
 #include "base/timer.h"
+#include "util/kaldi-metrics.h"
 
 namespace kaldi {
 namespace nnet3 {
@@ -79,6 +83,14 @@ void NnetOptimizeOptions::Read(std::istream &is, bool binary) {
     ExpectToken(is, binary, "<MemoryCompressionLevel>");
     ReadBasicType(is, binary, &memory_compression_level);
   }
+  if (PeekToken(is, binary) == 'F') {
+    ExpectToken(is, binary, "<FusePropagate>");
+    ReadBasicType(is, binary, &fuse_propagate);
+  }
+  if (PeekToken(is, binary) == 'S') {
+    ExpectToken(is, binary, "<StaticMemoryPlan>");
+    ReadBasicType(is, binary, &static_memory_plan);
+  }
   ExpectToken(is, binary, "</NnetOptimizeOptions>");
 }
 
@@ -122,6 +134,10 @@ void NnetOptimizeOptions::Write(std::ostream &os, bool binary) const {
   WriteBasicType(os, binary, snip_row_ops);
   WriteToken(os, binary, "<MemoryCompressionLevel>");
   WriteBasicType(os, binary, memory_compression_level);
+  WriteToken(os, binary, "<FusePropagate>");
+  WriteBasicType(os, binary, fuse_propagate);
+  WriteToken(os, binary, "<StaticMemoryPlan>");
+  WriteBasicType(os, binary, static_memory_plan);
   WriteToken(os, binary, "</NnetOptimizeOptions>");
 }
 
@@ -143,7 +159,9 @@ bool NnetOptimizeOptions::operator == (const NnetOptimizeOptions &other) const {
           other.max_deriv_time == max_deriv_time &&
           other.max_deriv_time_relative == max_deriv_time_relative &&
           other.snip_row_ops == snip_row_ops &&
-          other.memory_compression_level == memory_compression_level);
+          other.memory_compression_level == memory_compression_level &&
+          other.fuse_propagate == fuse_propagate &&
+          other.static_memory_plan == static_memory_plan);
 }
 
 // move commands that resize and zero matrices to as late/early as possible.
@@ -597,15 +615,21 @@ void Optimize(const NnetOptimizeOptions &config,
   }
 
   if (config.optimize && config.allocate_from_other &&
-      !config.optimize_looped_computation) {
+      !config.static_memory_plan && !config.optimize_looped_computation) {
     // Don't do this if it's an looped computation because we're not sure if it
     // would be correct in that case, as written.  In any case the performance
-    // benefit is tiny.
+    // benefit is tiny.  With a static memory plan it would only get in the
+    // way, as matrices that are swapped are left out of the plan.
     RemoveUnnecessaryAllocation(nnet, computation);
     if (GetVerboseLevel() >= 3)
       CheckComputation(nnet, *computation, false);
   }
 
+  if (config.optimize && config.fuse_propagate) {
+    if (FusePropagateCommands(nnet, computation) && GetVerboseLevel() >= 3)
+      CheckComputation(nnet, *computation, false);
+  }
+
   // The following is not configurable because it is necessary for
   // the computation to run correctly (we do it after compilation too,
   // but the operations may have been put out of order by
@@ -624,6 +648,11 @@ void Optimize(const NnetOptimizeOptions &config,
       CheckComputation(nnet, *computation, false);
   }
 
+  // This must be last, as it relies on the matrix sizes and the exact
+  // sequence of commands.
+  if (config.optimize && config.static_memory_plan)
+    ComputeMemoryPlan(computation);
+
   if (GetVerboseLevel() >= 3) {
     CheckComputation(nnet, *computation, false);
     KALDI_LOG << "After optimization, max memory use (bytes) = "
@@ -638,9 +667,15 @@ CachingOptimizingCompiler::CachingOptimizingCompiler(
     nnet_(nnet), config_(config),
     seconds_taken_total_(0.0), seconds_taken_compile_(0.0),
     seconds_taken_optimize_(0.0), seconds_taken_expand_(0.0),
+    seconds_taken_extrapolate_(0.0),
     seconds_taken_check_(0.0), seconds_taken_indexes_(0.0),
     seconds_taken_io_(0.0), cache_(config.cache_capacity),
-    nnet_left_context_(-1), nnet_right_context_(-1) { }
+    time_shortcut_cache_(config.cache_capacity),
+    new_computations_(false),
+    nnet_left_context_(-1), nnet_right_context_(-1) {
+  if (!config_.cache_dir.empty())
+    ReadCacheDir();
+}
 
 CachingOptimizingCompiler::CachingOptimizingCompiler(
     const Nnet &nnet,
@@ -649,9 +684,113 @@ CachingOptimizingCompiler::CachingOptimizingCompiler(
     nnet_(nnet), config_(config), opt_config_(opt_config),
     seconds_taken_total_(0.0), seconds_taken_compile_(0.0),
     seconds_taken_optimize_(0.0), seconds_taken_expand_(0.0),
+    seconds_taken_extrapolate_(0.0),
     seconds_taken_check_(0.0), seconds_taken_indexes_(0.0),
     seconds_taken_io_(0.0), cache_(config.cache_capacity),
-    nnet_left_context_(-1), nnet_right_context_(-1) { }
+    time_shortcut_cache_(config.cache_capacity),
+    new_computations_(false),
+    nnet_left_context_(-1), nnet_right_context_(-1) {
+  if (!config_.cache_dir.empty())
+    ReadCacheDir();
+}
+
+std::string GetComputationCacheFilename(
+    const std::string &cache_dir, const Nnet &nnet,
+    const NnetOptimizeOptions &opt_config, bool use_shortcut) {
+  // The name is a hash of everything that the computations depend on: the
+  // network with its parameters, learning rates, stats and dropout
+  // proportions zeroed, and the options.
+  Nnet nnet_structure(nnet);
+  ScaleNnet(0.0, &nnet_structure);
+  SetLearningRate(0.0, &nnet_structure);
+  ZeroComponentStats(&nnet_structure);
+  SetDropoutProportion(0.0, &nnet_structure);
+  std::ostringstream os;
+  nnet_structure.Write(os, true);
+  opt_config.Write(os, true);
+  WriteBasicType(os, true, use_shortcut);
+  std::string str = os.str();
+  std::ostringstream filename;
+  filename << cache_dir << "/" << std::hex << std::setfill('0')
+           << std::setw(16) << StringHasher()(str) << "-" << str.size()
+           << ".cache";
+  return filename.str();
+}
+
+void CachingOptimizingCompiler::ReadCacheDir() {
+  cache_dir_filename_ = GetComputationCacheFilename(
+      config_.cache_dir, nnet_, opt_config_, config_.use_shortcut);
+  std::ifstream is(cache_dir_filename_.c_str(), std::ios::binary);
+  if (!is.is_open()) {
+    KALDI_VLOG(1) << "No cached computations in " << cache_dir_filename_;
+    return;
+  }
+  try {
+    bool binary;
+    if (!InitKaldiInputStream(is, &binary))
+      KALDI_ERR << "Could not initialize stream";
+    ReadCache(is, binary);
+    KALDI_VLOG(1) << "Read cached computations from " << cache_dir_filename_;
+  } catch (const std::exception &e) {
+    // the computations read before the error are still usable.
+    KALDI_WARN << "Error reading cached computations from "
+               << cache_dir_filename_ << ": " << e.what();
+  }
+}
+
+void CachingOptimizingCompiler::WriteCacheDir() {
+  if (!new_computations_) return;
+  Timer timer;
+  try {
+    // another process may have written the file since we read it.
+    std::ifstream is(cache_dir_filename_.c_str(), std::ios::binary);
+    bool binary;
+    if (is.is_open() && InitKaldiInputStream(is, &binary)) {
+      NnetOptimizeOptions opt_config_cached;
+      opt_config_cached.Read(is, binary);
+      if (opt_config_ == opt_config_cached &&
+          cache_.ReadAndMerge(is, binary)) {
+        KALDI_VLOG(1) << "Not writing " << cache_dir_filename_
+                      << " since it already has all our computations.";
+        seconds_taken_io_ += timer.Elapsed();
+        return;
+      }
+    }
+  } catch (const std::exception &e) {
+    KALDI_WARN << "Error reading cached computations from "
+               << cache_dir_filename_ << " (will overwrite it): " << e.what();
+  }
+
+  std::random_device random;
+  std::ostringstream tmp_filename;
+  tmp_filename << cache_dir_filename_ << ".tmp." << std::hex << random()
+               << random();
+  try {
+    {
+      std::ofstream os(tmp_filename.str().c_str(), std::ios::binary);
+      if (!os.is_open())
+        KALDI_ERR << "Could not open " << tmp_filename.str()
+                  << " for writing (does the directory exist?)";
+      InitKaldiOutputStream(os, true);
+      WriteCache(os, true);
+      os.close();
+      if (os.fail())
+        KALDI_ERR << "Error writing " << tmp_filename.str();
+    }
+    // rename() replaces the file atomically, so readers see either the old or
+    // the new version.
+    if (std::rename(tmp_filename.str().c_str(),
+                    cache_dir_filename_.c_str()) != 0)
+      KALDI_ERR << "Could not rename " << tmp_filename.str() << " to "
+                << cache_dir_filename_;
+    KALDI_VLOG(1) << "Wrote cached computations to " << cache_dir_filename_;
+  } catch (const std::exception &e) {
+    KALDI_WARN << "Failed to write cached computations to "
+               << cache_dir_filename_ << ": " << e.what();
+    std::remove(tmp_filename.str().c_str());
+  }
+  seconds_taken_io_ += timer.Elapsed();
+}
 
 void CachingOptimizingCompiler::GetSimpleNnetContext(
     int32 *nnet_left_context, int32 *nnet_right_context) {
@@ -693,16 +832,20 @@ void CachingOptimizingCompiler::WriteCache(std::ostream &os, bool binary) {
 }
 
 CachingOptimizingCompiler::~CachingOptimizingCompiler() {
+  if (!config_.cache_dir.empty())
+    WriteCacheDir();
   if (seconds_taken_total_ > 0.0 || seconds_taken_io_ > 0.0) {
     std::ostringstream os;
     double seconds_taken_misc = seconds_taken_total_ - seconds_taken_compile_
         - seconds_taken_optimize_ - seconds_taken_expand_
-        - seconds_taken_check_ - seconds_taken_indexes_;
+        - seconds_taken_extrapolate_ - seconds_taken_check_
+        - seconds_taken_indexes_;
     os << std::setprecision(3) << seconds_taken_total_
        << " seconds taken in nnet3 compilation total (breakdown: "
        << seconds_taken_compile_ << " compilation, "
        << seconds_taken_optimize_ << " optimization, "
        << seconds_taken_expand_ << " shortcut expansion, "
+       << seconds_taken_extrapolate_ << " time-shortcut extrapolation, "
        << seconds_taken_check_ << " checking, "
        << seconds_taken_indexes_ << " computing indexes, "
        << seconds_taken_misc << " misc.) + "
@@ -721,6 +864,16 @@ std::shared_ptr<const NnetComputation> CachingOptimizingCompiler::Compile(
   return ans;
 }
 
+// Returns the histogram of the most memory used by each computation that is
+// compiled (see util/kaldi-metrics.h).
+static MetricsHistogram *ComputationMemoryHistogram() {
+  static MetricsHistogram *ans = MetricsRegistry::Global().GetHistogram(
+      "kaldi_nnet3_computation_max_bytes", "The most memory used at any point "
+      "by the matrices of each nnet3 computation compiled, in bytes.",
+      ExponentialBuckets(65536.0, 2.0, 18));
+  return ans;
+}
+
 std::shared_ptr<const NnetComputation> CachingOptimizingCompiler::CompileInternal(
     const ComputationRequest  &request) {
   std::shared_ptr<const NnetComputation> ans = cache_.Find(request);
@@ -730,21 +883,29 @@ std::shared_ptr<const NnetComputation> CachingOptimizingCompiler::CompileInterna
     const NnetComputation *computation = NULL;
     if (config_.use_shortcut)
       computation = CompileViaShortcut(request);
+    if (computation == NULL && config_.use_time_shortcut)
+      computation = CompileViaTimeShortcut(request);
     if (computation == NULL)
       computation = CompileNoShortcut(request);
     KALDI_ASSERT(computation != NULL);
+    new_computations_ = true;
+    int64 max_memory_use = GetMaxMemoryUse(*computation);
+    ComputationMemoryHistogram()->Observe(max_memory_use);
+    KALDI_VLOG(2) << "Compiled a computation whose matrices use at most "
+                  << max_memory_use << " bytes.";
     return cache_.Insert(request, computation);
   }
 }
 
 
 const NnetComputation *CachingOptimizingCompiler::CompileNoShortcut(
-    const ComputationRequest &request) {
+    const ComputationRequest &request, bool for_time_shortcut) {
 
   Compiler compiler(request, nnet_);
-  // note: 'opts' only contains 'output_debug_info', which is true by default.
-  // There may be situations where we'd prefer not to keep it, for speed.
+  // note: 'output_debug_info' is true by default.  There may be situations
+  // where we'd prefer not to keep it, for speed.
   CompilerOptions opts;
+  opts.store_precomputed_indexes_info = for_time_shortcut;
   NnetComputation *computation = new NnetComputation;
 
   {
@@ -796,7 +957,7 @@ const NnetComputation *CachingOptimizingCompiler::CompileNoShortcut(
     seconds_taken_check_ += timer.Elapsed();
   }
 
-  {
+  if (!for_time_shortcut) {
     Timer timer;
     computation->ComputeCudaIndexes();
     seconds_taken_indexes_ += timer.Elapsed();
@@ -834,6 +995,10 @@ const NnetComputation *CachingOptimizingCompiler::CompileViaShortcut(
   if (GetVerboseLevel() >= 3) {
     CheckComputation(nnet_, *ans, false);
   }
+  // The expanded computation has different matrix sizes, so it needs its own
+  // memory plan.
+  if (opt_config_.optimize && opt_config_.static_memory_plan)
+    ComputeMemoryPlan(ans);
 
   {
     Timer timer;
@@ -845,6 +1010,102 @@ const NnetComputation *CachingOptimizingCompiler::CompileViaShortcut(
 
 
 
+// Returns the binary form of 'computation', for comparing computations.
+static std::string ComputationToString(const NnetComputation &computation) {
+  std::ostringstream os;
+  computation.Write(os, true);
+  return os.str();
+}
+
+const NnetComputation *CachingOptimizingCompiler::CompileViaTimeShortcut(
+    const ComputationRequest &request) {
+  std::vector<ComputationRequest> base_requests;
+  int32 num_periods;
+  if (!RequestIsTimePeriodic(nnet_, request, &base_requests, &num_periods))
+    return NULL;
+  size_t base_hash = ComputationRequestHasher()(&(base_requests[0]));
+  {
+    std::lock_guard<std::mutex> lock(time_shortcut_mutex_);
+    if (time_shortcut_failures_.count(base_hash) != 0)
+      return NULL;
+  }
+
+  std::shared_ptr<const NnetComputation> base_computations[3];
+  for (int32 k = 0; k < 3; k++)
+    base_computations[k] = time_shortcut_cache_.Find(base_requests[k]);
+  if (base_computations[0] == NULL || base_computations[1] == NULL ||
+      base_computations[2] == NULL) {
+    // Compile the computations for R(0) ... R(3), and check that
+    // extrapolating the first three to 3 periods gives the fourth, before we
+    // rely on extrapolating them.
+    const NnetComputation *computations[4];
+    for (int32 k = 0; k < 4; k++)
+      computations[k] = CompileNoShortcut(base_requests[k], true);
+    NnetComputation extrapolated;
+    bool ok;
+    {
+      Timer timer;
+      ok = ExtrapolateComputation(nnet_, request.misc_info, *computations[0],
+                                  *computations[1], *computations[2], 3, true,
+                                  &extrapolated);
+      if (ok && opt_config_.optimize && opt_config_.static_memory_plan)
+        ComputeMemoryPlan(&extrapolated);
+      seconds_taken_extrapolate_ += timer.Elapsed();
+    }
+    {
+      Timer timer;
+      ok = ok && (ComputationToString(extrapolated) ==
+                  ComputationToString(*computations[3]));
+      seconds_taken_check_ += timer.Elapsed();
+    }
+    delete computations[3];
+    if (!ok) {
+      KALDI_VLOG(2) << "Computation is not time-periodic, not using the "
+                    << "time shortcut.";
+      for (int32 k = 0; k < 3; k++)
+        delete computations[k];
+      std::lock_guard<std::mutex> lock(time_shortcut_mutex_);
+      time_shortcut_failures_.insert(base_hash);
+      return NULL;
+    }
+    for (int32 k = 0; k < 3; k++)
+      base_computations[k] = time_shortcut_cache_.Insert(base_requests[k],
+                                                         computations[k]);
+  }
+
+  NnetComputation *ans = new NnetComputation();
+  {
+    Timer timer;
+    bool ok = ExtrapolateComputation(nnet_, request.misc_info,
+                                     *base_computations[0],
+                                     *base_computations[1],
+                                     *base_computations[2], num_periods,
+                                     false, ans);
+    seconds_taken_extrapolate_ += timer.Elapsed();
+    if (!ok) {
+      // This would be odd, as it worked for 3 periods; it could happen if
+      // some value overflowed.
+      KALDI_WARN << "Failed to extrapolate computation to " << num_periods
+                 << " periods.";
+      delete ans;
+      return NULL;
+    }
+  }
+  if (GetVerboseLevel() >= 3) {
+    CheckComputation(nnet_, *ans, false);
+  }
+  if (opt_config_.optimize && opt_config_.static_memory_plan)
+    ComputeMemoryPlan(ans);
+
+  {
+    Timer timer;
+    ans->ComputeCudaIndexes();
+    seconds_taken_indexes_ += timer.Elapsed();
+  }
+  return ans;
+}
+
+
 /// Split the computation up into segments bounded by kNoOperationMarker.  For
 /// each segment, a pair of command-indexes (start, end) is output to the vector
 /// 'segments', so the commands in the segment (not including
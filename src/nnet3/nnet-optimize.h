@@ -21,6 +21,9 @@
 #ifndef KALDI_NNET3_NNET_OPTIMIZE_H_
 #define KALDI_NNET3_NNET_OPTIMIZE_H_
 
+#include <atomic>
+#include <mutex>
+#include <unordered_set>
 #include "nnet3/nnet-compile.h"
 #include "nnet3/nnet-analyze.h"
 #include "nnet3/nnet-optimize-utils.h"
@@ -54,6 +57,8 @@ struct NnetOptimizeOptions {
   int32 max_deriv_time_relative;
   bool snip_row_ops;
   int32 memory_compression_level;
+  bool fuse_propagate;
+  bool static_memory_plan;
   // optimize_looped_computation is a 'hidden config' not available from
   // the command line; it's set to true to enable the optimization for
   // looped computation that turns a linear computation into a loop.
@@ -79,6 +84,8 @@ struct NnetOptimizeOptions {
       max_deriv_time_relative(std::numeric_limits<int32>::max()),
       snip_row_ops(true),
       memory_compression_level(1),
+      fuse_propagate(true),
+      static_memory_plan(true),
       optimize_looped_computation(false) { }
 
   void Register(OptionsItf *opts) {
@@ -120,7 +127,8 @@ struct NnetOptimizeOptions {
                    "deallocation commands to conserve memory.");
     opts->Register("allocate-from-other", &allocate_from_other, "Instead of "
                    "deleting a matrix of a given size and then allocating "
-                   "a matrix of the same size, allow re-use of that memory");
+                   "a matrix of the same size, allow re-use of that memory "
+                   "(has no effect if --static-memory-plan=true)");
     opts->Register("min-deriv-time", &min_deriv_time, "You can set this to "
                    "the minimum t value that you want derivatives to be computed "
                    "at when updating the model.  This is an optimization that "
@@ -145,6 +153,16 @@ struct NnetOptimizeOptions {
                    "potentially at the expense of speed and the accuracy "
                    "of derivatives.  0 means no compression at all; 1 means "
                    "compression that shouldn't affect results at all.");
+    opts->Register("fuse-propagate", &fuse_propagate, "Set this to false to "
+                   "disable an optimization that merges the in-place "
+                   "propagation of simple components such as ReLU into the "
+                   "propagate command of the preceding component, which "
+                   "saves a pass over the data for each such component.");
+    opts->Register("static-memory-plan", &static_memory_plan, "If true, "
+                   "work out in advance where in a single workspace each "
+                   "matrix of the computation will be stored, so that "
+                   "running the computation requires no calls to the memory "
+                   "allocator except to allocate that workspace.");
 
   }
   void Read(std::istream &is, bool binary);
@@ -191,10 +209,13 @@ void Optimize(const NnetOptimizeOptions &config,
 
 struct CachingOptimizingCompilerOptions {
   bool use_shortcut;
+  bool use_time_shortcut;
   int32 cache_capacity;
+  std::string cache_dir;
 
   CachingOptimizingCompilerOptions():
       use_shortcut(true),
+      use_time_shortcut(true),
       cache_capacity(64) { }
 
   void Register(OptionsItf *opts) {
@@ -205,9 +226,24 @@ struct CachingOptimizingCompilerOptions {
                    "values of 'n' is compiled (e.g. 2), and the compiled "
                    "computation is expanded to match the size of the real "
                    "computation request.");
+    opts->Register("use-time-shortcut", &use_time_shortcut,
+                   "If true, use the 'time shortcut' in compilation whereby "
+                   "long computation requests with time-periodic structure "
+                   "(e.g. whole utterances) have their computations "
+                   "extrapolated from those for a few shorter requests, which "
+                   "are compiled once, so the compilation time does not grow "
+                   "with the length of the request.");
     opts->Register("cache-capacity", &cache_capacity,
                    "Determines how many computations the computation-cache will "
                    "store (most-recently-used).");
+    opts->Register("cache-dir", &cache_dir,
+                   "If set, a directory in which compiled computations are "
+                   "cached across processes, keyed by the structure of the "
+                   "model and the optimization options: the cache is read "
+                   "when the compiler is created and, if new computations "
+                   "were compiled, merged with the cache on disk and written "
+                   "back when it is destroyed.  Can be shared by concurrent "
+                   "jobs.");
   }
 };
 
@@ -216,6 +252,15 @@ struct CachingOptimizingCompilerOptions {
 /// one, the compilation process is not repeated.
 /// It is safe to call Compile() from multiple parallel threads without additional
 /// synchronization; synchronization is managed internally by class ComputationCache.
+///
+/// If config.cache_dir is set, the computations are also cached on disk, in a
+/// file in that directory whose name is a hash of the structure of the
+/// network (i.e. everything but its trainable parameters, learning rates and
+/// stats) and of the compilation options: see ReadCacheDir() and
+/// WriteCacheDir().  The file is always replaced atomically, by writing a
+/// temporary file and renaming it, so any number of processes (e.g. the jobs
+/// of a decoding or training stage, possibly on different machines with a
+/// shared filesystem) can use the same directory.
 class CachingOptimizingCompiler {
  public:
   CachingOptimizingCompiler(const Nnet &nnet,
@@ -228,6 +273,8 @@ class CachingOptimizingCompiler {
                             const CachingOptimizingCompilerOptions config =
                             CachingOptimizingCompilerOptions());
 
+  /// If config.cache_dir is set, this writes back the cache (see
+  /// WriteCacheDir()).
   ~CachingOptimizingCompiler();
 
   /// Does the compilation and returns a const pointer to the result, which is
@@ -278,12 +325,38 @@ class CachingOptimizingCompiler {
   // via CompileNoShortcut.
   const NnetComputation *CompileViaShortcut(const ComputationRequest &request);
 
+  // This function, called from CompileInternal(), tries to compile the
+  // ComputationRequest 'request' via 'time shortcut' compilation, in which the
+  // computation is extrapolated from those for shorter requests with the same
+  // structure (see RequestIsTimePeriodic() and ExtrapolateComputation()).
+  // Those computations are compiled the first time they are needed, and kept
+  // in time_shortcut_cache_.  It returns a newly allocated computation, or NULL
+  // if this is not possible, e.g. if the request is not long enough or the
+  // computations are not regular enough to be extrapolated.
+  const NnetComputation *CompileViaTimeShortcut(
+      const ComputationRequest &request);
+
   // This function, called from CompileInternal(), tries to compile the
   // ComputationRequest 'request' via the regular (not shortcut) compilation
   // process; it returns a pointer to a newly allocated computation that it has
   // compiled this way (note: this computation will not yet have been placed in
-  // the computation cache).
-  const NnetComputation *CompileNoShortcut(const ComputationRequest &request);
+  // the computation cache).  If 'for_time_shortcut' is true, the computation
+  // is set up to be extrapolated by CompileViaTimeShortcut().
+  const NnetComputation *CompileNoShortcut(const ComputationRequest &request,
+                                           bool for_time_shortcut = false);
+
+  // Called from the constructor if config_.cache_dir is set: works out
+  // cache_dir_filename_ and, if that file exists, reads the computations in it.
+  // Failure to read it is not an error (it's just a warning).
+  void ReadCacheDir();
+
+  // Called from the destructor if config_.cache_dir is set.  If we have
+  // compiled computations that weren't read from the cache directory, this
+  // reads the file again (it may have been updated by another process), adds
+  // the computations in it to ours while our cache has space, and writes the
+  // result to a temporary file in the directory which is then renamed to
+  // cache_dir_filename_.  Does not throw, as it's called from the destructor.
+  void WriteCacheDir();
 
   const Nnet &nnet_;
   CachingOptimizingCompilerOptions config_;
@@ -295,18 +368,45 @@ class CachingOptimizingCompiler {
   double seconds_taken_compile_;
   double seconds_taken_optimize_;
   double seconds_taken_expand_;
+  double seconds_taken_extrapolate_;
   double seconds_taken_check_;
   double seconds_taken_indexes_;
   double seconds_taken_io_;
 
   ComputationCache cache_;
 
+  // The computations for the base requests R(0), R(1) and R(2) of 'time
+  // shortcut' compilation (see CompileViaTimeShortcut()).
+  ComputationCache time_shortcut_cache_;
+  // Hashes of the base requests R(0) whose computations turned out not to be
+  // extrapolatable, so that we don't try again; protected by
+  // time_shortcut_mutex_.
+  std::unordered_set<size_t> time_shortcut_failures_;
+  std::mutex time_shortcut_mutex_;
+
+  // The file in config_.cache_dir that we read and write (if
+  // config_.cache_dir is set).
+  std::string cache_dir_filename_;
+  // True if we have compiled any computations (which therefore may not be in
+  // the cache directory).
+  std::atomic<bool> new_computations_;
+
   // These following two variables are only used by the function GetSimpleNnetContext().
   int32 nnet_left_context_;
   int32 nnet_right_context_;
 };
 
 
+/// Returns the name of the file in 'cache_dir' in which class
+/// CachingOptimizingCompiler caches the computations for 'nnet' when
+/// CachingOptimizingCompilerOptions::cache_dir is set.  It depends only on the
+/// structure of 'nnet', not on its parameters, learning rates, stats or
+/// dropout proportions, so e.g. all iterations of a training run share it.
+std::string GetComputationCacheFilename(
+    const std::string &cache_dir, const Nnet &nnet,
+    const NnetOptimizeOptions &opt_config, bool use_shortcut);
+
+
 /// This optimization, which has no effect unless you set --min-deriv-time or
 /// --max-deriv-time, modifies the backprop operations for efficiency based on
 /// the assumption that derivatives for any Cindex with t < min_deriv_time or t
@@ -0,0 +1,192 @@
+// nnet3/nnet-quantized-component-test.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nnet3/nnet-quantized-component.h"
+#include "util/common-utils.h"
+
+namespace kaldi {
+namespace nnet3 {
+
+
+void UnitTestQuantizedMatrix() {
+  int32 num_rows = RandInt(1, 50), num_cols = RandInt(1, 60);
+  Matrix<BaseFloat> mat(num_rows, num_cols);
+  mat.SetRandn();
+  if (RandInt(0, 3) == 0)
+    mat.Row(0).SetZero();
+
+  QuantizedMatrix qmat;
+  qmat.Init(mat);
+  KALDI_ASSERT(qmat.NumRows() == num_rows && qmat.NumCols() == num_cols);
+  Matrix<BaseFloat> dequantized;
+  qmat.GetMatrix(&dequantized);
+  for (int32 r = 0; r < num_rows; r++) {
+    BaseFloat max_abs = mat.Row(r).Max() > -mat.Row(r).Min() ?
+        mat.Row(r).Max() : -mat.Row(r).Min();
+    for (int32 c = 0; c < num_cols; c++)
+      KALDI_ASSERT(std::abs(mat(r, c) - dequantized(r, c)) <=
+                   1.001 * max_abs / 254.0);
+  }
+
+  // Test AddMatMat() on a sub-matrix, as TdnnComponent would use it.
+  int32 num_offsets = RandInt(1, 3),
+      dim = num_cols / num_offsets;
+  if (dim == 0) {
+    num_offsets = 1;
+    dim = num_cols;
+  }
+  int32 offset_index = RandInt(0, num_offsets - 1),
+      col_offset = offset_index * dim,
+      row_offset = RandInt(0, 3), row_stride = RandInt(1, 3),
+      num_out_rows = RandInt(0, 20),
+      num_in_rows = row_offset + row_stride * num_out_rows + RandInt(0, 2);
+  Matrix<BaseFloat> input(num_in_rows, dim);
+  input.SetRandn();
+  QuantizedMatrix::Input qinput;
+  qinput.Init(input);
+
+  Matrix<BaseFloat> output(num_out_rows, num_rows), ref_output(output);
+  output.SetRandn();
+  ref_output.CopyFromMat(output);
+  qmat.AddMatMat(qinput, row_offset, row_stride, col_offset, &output);
+  for (int32 t = 0; t < num_out_rows; t++) {
+    SubVector<BaseFloat> in_row(input, row_offset + t * row_stride);
+    ref_output.Row(t).AddMatVec(1.0, dequantized.ColRange(col_offset, dim),
+                                kNoTrans, in_row, 1.0);
+  }
+  // The input is quantized to 7 bits, so each product has a relative error
+  // of up to about 1/126.
+  Matrix<BaseFloat> diff(output);
+  diff.AddMat(-1.0, ref_output);
+  KALDI_ASSERT(diff.FrobeniusNorm() <=
+               0.02 * (1.0 + ref_output.FrobeniusNorm()));
+}
+
+
+// Checks that c1 and c2 give about the same output for random input; if
+// 'exact' is true, the same output up to float rounding (text-mode I/O loses
+// a few digits of the scales).
+void TestSameOutput(const Component &c1, const Component &c2,
+                    bool exact) {
+  KALDI_ASSERT(c1.InputDim() == c2.InputDim() &&
+               c1.OutputDim() == c2.OutputDim());
+  int32 num_rows = RandInt(1, 30);
+  CuMatrix<BaseFloat> input(num_rows, c1.InputDim()),
+      output1(num_rows, c1.OutputDim()),
+      output2(num_rows, c1.OutputDim());
+  input.SetRandn();
+  c1.Propagate(NULL, input, &output1);
+  c2.Propagate(NULL, input, &output2);
+  if (exact)
+    KALDI_ASSERT(output1.ApproxEqual(output2, 1.0e-04));
+  else
+    KALDI_ASSERT(output1.ApproxEqual(output2, 0.02));
+}
+
+
+void UnitTestQuantizedAffineComponent() {
+  int32 input_dim = RandInt(1, 50), output_dim = RandInt(1, 50);
+  AffineComponent affine;
+  affine.Init(input_dim, output_dim, 1.0 / std::sqrt(input_dim), 1.0);
+
+  QuantizedAffineComponent quantized(affine.LinearParams(),
+                                     affine.BiasParams());
+  KALDI_LOG << quantized.Info();
+  TestSameOutput(affine, quantized, false);
+
+  bool binary = (RandInt(0, 1) == 0);
+  std::ostringstream os;
+  quantized.Write(os, binary);
+  std::istringstream is(os.str());
+  Component *read_component = Component::ReadNew(is, binary);
+  KALDI_ASSERT(read_component->Type() == "QuantizedAffineComponent");
+  TestSameOutput(quantized, *read_component, true);
+  Component *copy = read_component->Copy();
+  TestSameOutput(quantized, *copy, true);
+  delete copy;
+  delete read_component;
+}
+
+
+void UnitTestQuantizedTdnnComponent() {
+  int32 input_dim = RandInt(1, 30), output_dim = RandInt(1, 30);
+  bool use_bias = (RandInt(0, 1) == 0);
+  std::ostringstream config;
+  config << "input-dim=" << input_dim << " output-dim=" << output_dim
+         << " time-offsets=-1,0,2 use-bias=" << (use_bias ? "true" : "false");
+  ConfigLine cfl;
+  KALDI_ASSERT(cfl.ParseLine(config.str()));
+
+  QuantizedTdnnComponent quantized;
+  quantized.InitFromConfig(&cfl);
+  KALDI_LOG << quantized.Info();
+  KALDI_ASSERT(quantized.InputDim() == input_dim &&
+               quantized.OutputDim() == output_dim &&
+               ((quantized.Properties() & kPropagateAdds) != 0) == !use_bias);
+
+  bool binary = (RandInt(0, 1) == 0);
+  std::ostringstream os;
+  quantized.Write(os, binary);
+  std::istringstream is(os.str());
+  Component *read_component = Component::ReadNew(is, binary);
+  KALDI_ASSERT(read_component->Type() == "QuantizedTdnnComponent");
+
+  // Input rows are t = -1 ... num_output_rows + 1, output rows are
+  // t = 0 ... num_output_rows - 1.
+  TdnnComponent::PrecomputedIndexes indexes;
+  indexes.row_stride = 1;
+  indexes.row_offsets.push_back(0);
+  indexes.row_offsets.push_back(1);
+  indexes.row_offsets.push_back(3);
+  int32 num_output_rows = RandInt(1, 20);
+  CuMatrix<BaseFloat> input(num_output_rows + 3, input_dim),
+      output1(num_output_rows, output_dim),
+      output2(num_output_rows, output_dim);
+  input.SetRandn();
+  quantized.Propagate(&indexes, input, &output1);
+  read_component->Propagate(&indexes, input, &output2);
+  KALDI_ASSERT(output1.ApproxEqual(output2, 1.0e-04));
+  delete read_component;
+}
+
+
+} // namespace nnet3
+} // namespace kaldi
+
+
+int main() {
+  using namespace kaldi;
+  using namespace kaldi::nnet3;
+  for (int32 loop = 0; loop < 2; loop++) {
+#if HAVE_CUDA == 1
+    CuDevice::Instantiate().SetDebugStrideMode(true);
+    if (loop == 0)
+      CuDevice::Instantiate().SelectGpuId("no"); // -1 means no GPU
+    else
+      CuDevice::Instantiate().SelectGpuId("optional"); // -2 .. automatic selection
+#endif
+    for (int32 i = 0; i < 10; i++) {
+      UnitTestQuantizedMatrix();
+      UnitTestQuantizedAffineComponent();
+      UnitTestQuantizedTdnnComponent();
+    }
+  }
+  KALDI_LOG << "Quantized-component tests succeeded.";
+  return 0;
+}
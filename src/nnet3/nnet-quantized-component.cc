@@ -0,0 +1,438 @@
+// nnet3/nnet-quantized-component.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include "matrix/kaldi-blas.h"
+#include "nnet3/nnet-quantized-component.h"
+#include "nnet3/nnet-parse.h"
+
+// cblas_gemm_s8u8s32() appeared in MKL 2018 update 1.
+#if defined(HAVE_MKL) && defined(INTEL_MKL_VERSION) && \
+  INTEL_MKL_VERSION >= 20180001
+#define KALDI_NNET3_HAVE_INT8_GEMM 1
+#endif
+
+namespace kaldi {
+namespace nnet3 {
+
+
+void QuantizedMatrix::Init(const MatrixBase<BaseFloat> &mat) {
+  int32 num_rows = mat.NumRows(), num_cols = mat.NumCols();
+  num_cols_ = num_cols;
+  data_.resize(static_cast<size_t>(num_rows) * num_cols);
+  row_scales_.Resize(num_rows);
+  for (int32 r = 0; r < num_rows; r++) {
+    const BaseFloat *row = mat.RowData(r);
+    int8 *q = &(data_[static_cast<size_t>(r) * num_cols]);
+    BaseFloat max_abs = 0.0;
+    for (int32 c = 0; c < num_cols; c++)
+      max_abs = std::max(max_abs, std::abs(row[c]));
+    if (max_abs == 0.0) {
+      std::fill(q, q + num_cols, 0);
+      continue;
+    }
+    BaseFloat scale = max_abs / 127.0, inv_scale = 1.0 / scale;
+    row_scales_(r) = scale;
+    for (int32 c = 0; c < num_cols; c++) {
+      int32 i = static_cast<int32>(std::floor(row[c] * inv_scale + 0.5));
+      q[c] = static_cast<int8>(std::max(-127, std::min(127, i)));
+    }
+  }
+}
+
+void QuantizedMatrix::GetMatrix(Matrix<BaseFloat> *mat) const {
+  int32 num_rows = NumRows();
+  mat->Resize(num_rows, num_cols_, kUndefined);
+  for (int32 r = 0; r < num_rows; r++) {
+    const int8 *q = &(data_[static_cast<size_t>(r) * num_cols_]);
+    BaseFloat *row = mat->RowData(r), scale = row_scales_(r);
+    for (int32 c = 0; c < num_cols_; c++)
+      row[c] = scale * q[c];
+  }
+}
+
+void QuantizedMatrix::Input::Init(const MatrixBase<BaseFloat> &mat) {
+  num_rows = mat.NumRows();
+  num_cols = mat.NumCols();
+  data.resize(static_cast<size_t>(num_rows) * num_cols);
+  row_scales.resize(num_rows);
+  for (int32 r = 0; r < num_rows; r++) {
+    const BaseFloat *row = mat.RowData(r);
+    uint8 *q = &(data[static_cast<size_t>(r) * num_cols]);
+    BaseFloat max_abs = 0.0;
+    for (int32 c = 0; c < num_cols; c++)
+      max_abs = std::max(max_abs, std::abs(row[c]));
+    if (max_abs == 0.0) {
+      row_scales[r] = 0.0;
+      std::fill(q, q + num_cols, 64);
+      continue;
+    }
+    BaseFloat scale = max_abs / 63.0, inv_scale = 1.0 / scale;
+    row_scales[r] = scale;
+    for (int32 c = 0; c < num_cols; c++) {
+      int32 i = static_cast<int32>(std::floor(row[c] * inv_scale + 0.5));
+      q[c] = static_cast<uint8>(64 + std::max(-63, std::min(63, i)));
+    }
+  }
+}
+
+bool QuantizedMatrix::HaveInt8Gemm() {
+#ifdef KALDI_NNET3_HAVE_INT8_GEMM
+  return true;
+#else
+  return false;
+#endif
+}
+
+void QuantizedMatrix::AddMatMat(const Input &in, int32 row_offset,
+                                int32 row_stride, int32 col_offset,
+                                MatrixBase<BaseFloat> *out) const {
+  int32 num_rows = out->NumRows(), out_dim = NumRows(),
+      dim = in.num_cols;
+  KALDI_ASSERT(out->NumCols() == out_dim && col_offset >= 0 &&
+               col_offset + dim <= num_cols_ && row_offset >= 0 &&
+               row_stride >= 1);
+  if (num_rows == 0)
+    return;
+  KALDI_ASSERT(row_offset + row_stride * (num_rows - 1) < in.num_rows);
+
+  // products[t * out_dim + o] is the dot product of input row t (i.e. row
+  // row_offset + t * row_stride of 'in') with row o of our sub-matrix, in
+  // quantized units.
+  std::vector<int32> products(static_cast<size_t>(num_rows) * out_dim);
+  const uint8 *in_data = &(in.data[static_cast<size_t>(row_offset) * dim]);
+  const int8 *params_data = &(data_[col_offset]);
+#ifdef KALDI_NNET3_HAVE_INT8_GEMM
+  // In column-major terms this computes the out_dim by num_rows matrix
+  // params^T * (input - 64), where params is viewed as a dim by out_dim matrix
+  // with stride num_cols_ and the input as a dim by num_rows matrix with
+  // stride dim * row_stride.
+  const MKL_INT32 zero = 0;
+  cblas_gemm_s8u8s32(CblasColMajor, CblasTrans, CblasNoTrans, CblasFixOffset,
+                     out_dim, num_rows, dim, 1.0, params_data, num_cols_, 0,
+                     in_data, dim * row_stride, -64, 0.0, &(products[0]),
+                     out_dim, &zero);
+#else
+  for (int32 t = 0; t < num_rows; t++) {
+    const uint8 *x = in_data + static_cast<size_t>(t) * row_stride * dim;
+    int32 *p = &(products[static_cast<size_t>(t) * out_dim]);
+    for (int32 o = 0; o < out_dim; o++) {
+      const int8 *w = params_data + static_cast<size_t>(o) * num_cols_;
+      int32 sum = 0;
+      for (int32 k = 0; k < dim; k++)
+        sum += static_cast<int32>(w[k]) * (static_cast<int32>(x[k]) - 64);
+      p[o] = sum;
+    }
+  }
+#endif
+  const BaseFloat *params_scales = row_scales_.Data();
+  for (int32 t = 0; t < num_rows; t++) {
+    BaseFloat in_scale = in.row_scales[row_offset + t * row_stride];
+    const int32 *p = &(products[static_cast<size_t>(t) * out_dim]);
+    BaseFloat *out_row = out->RowData(t);
+    for (int32 o = 0; o < out_dim; o++)
+      out_row[o] += in_scale * params_scales[o] * p[o];
+  }
+}
+
+void QuantizedMatrix::Write(std::ostream &os, bool binary) const {
+  WriteToken(os, binary, "<NumCols>");
+  WriteBasicType(os, binary, num_cols_);
+  WriteToken(os, binary, "<RowScales>");
+  row_scales_.Write(os, binary);
+  WriteToken(os, binary, "<Data>");
+  WriteIntegerVector(os, binary, data_);
+}
+
+void QuantizedMatrix::Read(std::istream &is, bool binary) {
+  ExpectToken(is, binary, "<NumCols>");
+  ReadBasicType(is, binary, &num_cols_);
+  ExpectToken(is, binary, "<RowScales>");
+  row_scales_.Read(is, binary);
+  ExpectToken(is, binary, "<Data>");
+  ReadIntegerVector(is, binary, &data_);
+  if (data_.size() != static_cast<size_t>(NumRows()) * num_cols_)
+    KALDI_ERR << "Bad quantized matrix: size mismatch.";
+}
+
+
+// Returns true if the quantized components should use the int8 GEMM in
+// Propagate(); otherwise they use their dequantized parameters.
+static bool UseInt8Gemm() {
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled())
+    return false;
+#endif
+  return QuantizedMatrix::HaveInt8Gemm();
+}
+
+
+QuantizedAffineComponent::QuantizedAffineComponent(
+    const QuantizedAffineComponent &other):
+    linear_params_(other.linear_params_),
+    bias_params_(other.bias_params_),
+    linear_params_float_(other.linear_params_float_) { }
+
+QuantizedAffineComponent::QuantizedAffineComponent(
+    const CuMatrixBase<BaseFloat> &linear_params,
+    const CuVectorBase<BaseFloat> &bias_params) {
+  Init(linear_params, bias_params);
+}
+
+void QuantizedAffineComponent::Init(
+    const CuMatrixBase<BaseFloat> &linear_params,
+    const CuVectorBase<BaseFloat> &bias_params) {
+  KALDI_ASSERT(linear_params.NumRows() == bias_params.Dim() &&
+               bias_params.Dim() != 0);
+  Matrix<BaseFloat> params(linear_params);
+  linear_params_.Init(params);
+  linear_params_.GetMatrix(&params);
+  linear_params_float_.Swap(&params);
+  bias_params_ = bias_params;
+}
+
+std::string QuantizedAffineComponent::Info() const {
+  std::ostringstream stream;
+  stream << Component::Info();
+  PrintParameterStats(stream, "linear-params", linear_params_float_);
+  PrintParameterStats(stream, "bias", bias_params_, true);
+  return stream.str();
+}
+
+void QuantizedAffineComponent::InitFromConfig(ConfigLine *cfl) {
+  std::string filename;
+  // Two forms allowed: "matrix=<rxfilename>", or "input-dim=x output-dim=y"
+  // (for testing purposes only).
+  CuMatrix<BaseFloat> mat;
+  if (cfl->GetValue("matrix", &filename)) {
+    if (cfl->HasUnusedValues())
+      KALDI_ERR << "Invalid initializer for layer of type "
+                << Type() << ": \"" << cfl->WholeLine() << "\"";
+    ReadKaldiObject(filename, &mat);
+  } else {
+    int32 input_dim = -1, output_dim = -1;
+    if (!cfl->GetValue("input-dim", &input_dim) ||
+        !cfl->GetValue("output-dim", &output_dim) || cfl->HasUnusedValues()) {
+      KALDI_ERR << "Invalid initializer for layer of type "
+                << Type() << ": \"" << cfl->WholeLine() << "\"";
+    }
+    mat.Resize(output_dim, input_dim + 1);
+    mat.SetRandn();
+  }
+  KALDI_ASSERT(mat.NumRows() != 0 && mat.NumCols() > 1);
+  int32 input_dim = mat.NumCols() - 1;
+  CuVector<BaseFloat> bias(mat.NumRows());
+  bias.CopyColFromMat(mat, input_dim);
+  Init(mat.ColRange(0, input_dim), bias);
+}
+
+void* QuantizedAffineComponent::Propagate(
+    const ComponentPrecomputedIndexes *indexes,
+    const CuMatrixBase<BaseFloat> &in,
+    CuMatrixBase<BaseFloat> *out) const {
+  out->CopyRowsFromVec(bias_params_);
+  if (UseInt8Gemm()) {
+    QuantizedMatrix::Input quantized_in;
+    quantized_in.Init(in.Mat());
+    linear_params_.AddMatMat(quantized_in, 0, 1, 0, &(out->Mat()));
+  } else {
+    out->AddMatMat(1.0, in, kNoTrans, linear_params_float_, kTrans, 1.0);
+  }
+  return NULL;
+}
+
+void QuantizedAffineComponent::Backprop(
+    const std::string &debug_info,
+    const ComponentPrecomputedIndexes *indexes,
+    const CuMatrixBase<BaseFloat> &, // in_value
+    const CuMatrixBase<BaseFloat> &, // out_value
+    const CuMatrixBase<BaseFloat> &, // out_deriv
+    void *memo,
+    Component *, // to_update
+    CuMatrixBase<BaseFloat> *) const {
+  KALDI_ERR << Type() << " cannot be trained or backpropagated through "
+            << "(component " << debug_info << ").";
+}
+
+void QuantizedAffineComponent::Write(std::ostream &os, bool binary) const {
+  WriteToken(os, binary, "<QuantizedAffineComponent>");
+  WriteToken(os, binary, "<LinearParams>");
+  linear_params_.Write(os, binary);
+  WriteToken(os, binary, "<BiasParams>");
+  bias_params_.Write(os, binary);
+  WriteToken(os, binary, "</QuantizedAffineComponent>");
+}
+
+void QuantizedAffineComponent::Read(std::istream &is, bool binary) {
+  ExpectOneOrTwoTokens(is, binary, "<QuantizedAffineComponent>",
+                       "<LinearParams>");
+  linear_params_.Read(is, binary);
+  ExpectToken(is, binary, "<BiasParams>");
+  bias_params_.Read(is, binary);
+  ExpectToken(is, binary, "</QuantizedAffineComponent>");
+  KALDI_ASSERT(bias_params_.Dim() == linear_params_.NumRows());
+  Matrix<BaseFloat> params;
+  linear_params_.GetMatrix(&params);
+  linear_params_float_.Swap(&params);
+}
+
+
+QuantizedTdnnComponent::QuantizedTdnnComponent(
+    const QuantizedTdnnComponent &other):
+    tdnn_(other.tdnn_),
+    linear_params_(other.linear_params_),
+    bias_params_(other.bias_params_) { }
+
+QuantizedTdnnComponent::QuantizedTdnnComponent(const TdnnComponent &tdnn):
+    tdnn_(tdnn) {
+  Init(tdnn.LinearParams(), tdnn.BiasParams());
+}
+
+void QuantizedTdnnComponent::Init(
+    const CuMatrixBase<BaseFloat> &linear_params,
+    const CuVectorBase<BaseFloat> &bias_params) {
+  Matrix<BaseFloat> params(linear_params);
+  linear_params_.Init(params);
+  linear_params_.GetMatrix(&params);
+  tdnn_.LinearParams().CopyFromMat(params);
+  tdnn_.BiasParams() = bias_params;
+  bias_params_ = bias_params;
+}
+
+std::string QuantizedTdnnComponent::Info() const {
+  std::ostringstream stream;
+  stream << Component::Info();
+  const std::vector<int32> &time_offsets = tdnn_.TimeOffsets();
+  stream << ", time-offsets=";
+  for (size_t i = 0; i < time_offsets.size(); i++) {
+    if (i != 0) stream << ',';
+    stream << time_offsets[i];
+  }
+  PrintParameterStats(stream, "linear-params", tdnn_.LinearParams());
+  if (bias_params_.Dim() == 0)
+    stream << ", has-bias=false";
+  else
+    PrintParameterStats(stream, "bias", bias_params_, true);
+  return stream.str();
+}
+
+void QuantizedTdnnComponent::InitFromConfig(ConfigLine *cfl) {
+  tdnn_.InitFromConfig(cfl);
+  if (cfl->HasUnusedValues())
+    KALDI_ERR << "Could not process these elements in initializer: "
+              << cfl->UnusedValues();
+  CuMatrix<BaseFloat> linear_params(tdnn_.LinearParams());
+  CuVector<BaseFloat> bias_params(tdnn_.BiasParams());
+  Init(linear_params, bias_params);
+}
+
+void* QuantizedTdnnComponent::Propagate(
+    const ComponentPrecomputedIndexes *indexes_in,
+    const CuMatrixBase<BaseFloat> &in,
+    CuMatrixBase<BaseFloat> *out) const {
+  if (!UseInt8Gemm())
+    return tdnn_.Propagate(indexes_in, in, out);
+
+  const TdnnComponent::PrecomputedIndexes *indexes =
+      dynamic_cast<const TdnnComponent::PrecomputedIndexes*>(indexes_in);
+  KALDI_ASSERT(indexes != NULL);
+  const std::vector<int32> &time_offsets = tdnn_.TimeOffsets();
+  KALDI_ASSERT(indexes->row_offsets.size() == time_offsets.size());
+
+  // As in TdnnComponent, if there is no bias we add to 'out' (kPropagateAdds).
+  if (bias_params_.Dim() != 0)
+    out->CopyRowsFromVec(bias_params_);
+
+  // We quantize the whole input once; each time offset uses a subset of its
+  // rows.
+  QuantizedMatrix::Input quantized_in;
+  quantized_in.Init(in.Mat());
+  int32 num_offsets = time_offsets.size(),
+      input_dim = InputDim();
+  for (int32 i = 0; i < num_offsets; i++)
+    linear_params_.AddMatMat(quantized_in, indexes->row_offsets[i],
+                             indexes->row_stride, i * input_dim,
+                             &(out->Mat()));
+  return NULL;
+}
+
+void QuantizedTdnnComponent::Backprop(
+    const std::string &debug_info,
+    const ComponentPrecomputedIndexes *indexes,
+    const CuMatrixBase<BaseFloat> &, // in_value
+    const CuMatrixBase<BaseFloat> &, // out_value
+    const CuMatrixBase<BaseFloat> &, // out_deriv
+    void *memo,
+    Component *, // to_update
+    CuMatrixBase<BaseFloat> *) const {
+  KALDI_ERR << Type() << " cannot be trained or backpropagated through "
+            << "(component " << debug_info << ").";
+}
+
+void QuantizedTdnnComponent::Write(std::ostream &os, bool binary) const {
+  WriteToken(os, binary, "<QuantizedTdnnComponent>");
+  WriteToken(os, binary, "<TimeOffsets>");
+  WriteIntegerVector(os, binary, tdnn_.TimeOffsets());
+  WriteToken(os, binary, "<LinearParams>");
+  linear_params_.Write(os, binary);
+  WriteToken(os, binary, "<BiasParams>");
+  bias_params_.Write(os, binary);
+  WriteToken(os, binary, "</QuantizedTdnnComponent>");
+}
+
+void QuantizedTdnnComponent::Read(std::istream &is, bool binary) {
+  ExpectOneOrTwoTokens(is, binary, "<QuantizedTdnnComponent>",
+                       "<TimeOffsets>");
+  std::vector<int32> time_offsets;
+  ReadIntegerVector(is, binary, &time_offsets);
+  ExpectToken(is, binary, "<LinearParams>");
+  linear_params_.Read(is, binary);
+  ExpectToken(is, binary, "<BiasParams>");
+  bias_params_.Read(is, binary);
+  ExpectToken(is, binary, "</QuantizedTdnnComponent>");
+
+  int32 num_offsets = time_offsets.size();
+  if (num_offsets == 0 || linear_params_.NumCols() % num_offsets != 0)
+    KALDI_ERR << "Bad QuantizedTdnnComponent: dimension mismatch.";
+  // Set up tdnn_ with the right structure; its (random) parameters are
+  // replaced below.
+  std::ostringstream config;
+  config << "input-dim=" << (linear_params_.NumCols() / num_offsets)
+         << " output-dim=" << linear_params_.NumRows()
+         << " time-offsets=";
+  for (int32 i = 0; i < num_offsets; i++)
+    config << (i == 0 ? "" : ",") << time_offsets[i];
+  config << " use-bias=" << (bias_params_.Dim() != 0 ? "true" : "false")
+         << " use-natural-gradient=false";
+  ConfigLine cfl;
+  if (!cfl.ParseLine(config.str()))
+    KALDI_ERR << "Could not parse config line " << config.str();
+  tdnn_.InitFromConfig(&cfl);
+
+  Matrix<BaseFloat> params;
+  linear_params_.GetMatrix(&params);
+  tdnn_.LinearParams().CopyFromMat(params);
+  tdnn_.BiasParams() = bias_params_;
+}
+
+
+} // namespace nnet3
+} // namespace kaldi
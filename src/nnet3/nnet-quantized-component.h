@@ -0,0 +1,267 @@
+// nnet3/nnet-quantized-component.h
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_NNET3_NNET_QUANTIZED_COMPONENT_H_
+#define KALDI_NNET3_NNET_QUANTIZED_COMPONENT_H_
+
+#include <vector>
+#include "nnet3/nnet-common.h"
+#include "nnet3/nnet-component-itf.h"
+#include "nnet3/nnet-simple-component.h"
+#include "nnet3/nnet-convolutional-component.h"
+
+namespace kaldi {
+namespace nnet3 {
+
+/// @file  nnet-quantized-component.h
+///
+/// This file contains components for inference with 8-bit integer weights:
+/// QuantizedAffineComponent and QuantizedTdnnComponent, which are versions of
+/// the affine / linear components and of TdnnComponent that can't be
+/// trained.  They are normally created from a trained model by
+/// QuantizeNnet() (see nnet-utils.h), e.g. via the program
+/// nnet3-am-quantize.
+///
+/// On CPU, if Kaldi was compiled with Intel MKL (2018 update 1 or later),
+/// Propagate() multiplies the int8 weights by the input quantized to 8 bits,
+/// with MKL's integer GEMM (cblas_gemm_s8u8s32), which uses the AVX2,
+/// AVX-512 or VNNI instructions available.  Otherwise, and on GPU, the
+/// weights are converted back to floating point and the usual GEMM is used;
+/// this gives the same numbers as the int8 GEMM, up to the rounding of the
+/// input.
+
+
+/**
+   QuantizedMatrix stores a matrix as 8-bit integers with a scale per row: row
+   r is stored as the integers q(r, c) = round(M(r, c) / s(r)), with
+   s(r) = max_c |M(r, c)| / 127.
+ */
+class QuantizedMatrix {
+ public:
+  QuantizedMatrix(): num_cols_(0) { }
+
+  /// Quantizes 'mat'.
+  void Init(const MatrixBase<BaseFloat> &mat);
+
+  int32 NumRows() const { return row_scales_.Dim(); }
+  int32 NumCols() const { return num_cols_; }
+
+  /// Outputs the dequantized matrix, i.e. the elements s(r) * q(r, c).
+  void GetMatrix(Matrix<BaseFloat> *mat) const;
+
+  /**
+     This is the input of AddMatMat(): a matrix quantized with a scale per
+     row, as 7-bit integers stored as unsigned with an offset of 64 (i.e.
+     values 1 ... 127).  We use 7 rather than 8 bits because without VNNI,
+     the int8 GEMM sums pairs of products into 16 bits, which can overflow
+     if both the weights and the input use all 8 bits.
+  */
+  struct Input {
+    int32 num_rows;
+    int32 num_cols;
+    std::vector<uint8> data;  // row-major, with stride num_cols.
+    std::vector<BaseFloat> row_scales;
+    Input(): num_rows(0), num_cols(0) { }
+    void Init(const MatrixBase<BaseFloat> &mat);
+  };
+
+  /// Does *out += X * M(:, col_offset ... col_offset + in.num_cols - 1)^T,
+  /// where M is this matrix and X is the matrix formed by rows row_offset,
+  /// row_offset + row_stride, ... of 'in' (out->NumRows() of them).  The
+  /// sub-matrix formulation is what TdnnComponent needs.
+  void AddMatMat(const Input &in, int32 row_offset, int32 row_stride,
+                 int32 col_offset, MatrixBase<BaseFloat> *out) const;
+
+  /// Returns true if AddMatMat() uses an int8 GEMM (i.e. if we were compiled
+  /// with a suitable version of MKL); otherwise it uses a plain loop, which is
+  /// correct but slower than a floating-point BLAS.
+  static bool HaveInt8Gemm();
+
+  void Write(std::ostream &os, bool binary) const;
+  void Read(std::istream &is, bool binary);
+
+ private:
+  int32 num_cols_;
+  // The integers q(r, c), row-major with stride num_cols_.
+  std::vector<int8> data_;
+  // The scales s(r).
+  Vector<BaseFloat> row_scales_;
+};
+
+
+/**
+   QuantizedAffineComponent is an affine transform whose linear parameters are
+   stored as 8-bit integers (see QuantizedMatrix); it is meant for inference
+   and cannot be trained.  It is normally created by QuantizeNnet() from an
+   AffineComponent, NaturalGradientAffineComponent, FixedAffineComponent or
+   LinearComponent (with a zero bias in the last case).
+
+   Accepts the same config lines as FixedAffineComponent, i.e.
+   matrix=<rxfilename>, with the bias as the last column, or (for testing
+   purposes) input-dim=x output-dim=y; the parameters are quantized.
+ */
+class QuantizedAffineComponent: public Component {
+ public:
+  QuantizedAffineComponent() { }
+  QuantizedAffineComponent(const QuantizedAffineComponent &other);
+
+  /// Quantizes 'linear_params', of dimension output-dim by input-dim; 'bias'
+  /// is not quantized.
+  QuantizedAffineComponent(const CuMatrixBase<BaseFloat> &linear_params,
+                           const CuVectorBase<BaseFloat> &bias_params);
+
+  virtual std::string Type() const { return "QuantizedAffineComponent"; }
+  virtual std::string Info() const;
+  virtual void InitFromConfig(ConfigLine *cfl);
+  virtual int32 Properties() const { return kSimpleComponent; }
+  virtual int32 InputDim() const { return linear_params_.NumCols(); }
+  virtual int32 OutputDim() const { return linear_params_.NumRows(); }
+
+  virtual void* Propagate(const ComponentPrecomputedIndexes *indexes,
+                         const CuMatrixBase<BaseFloat> &in,
+                         CuMatrixBase<BaseFloat> *out) const;
+  // Dies; this component can't be trained.
+  virtual void Backprop(const std::string &debug_info,
+                        const ComponentPrecomputedIndexes *indexes,
+                        const CuMatrixBase<BaseFloat> &in_value,
+                        const CuMatrixBase<BaseFloat> &out_value,
+                        const CuMatrixBase<BaseFloat> &out_deriv,
+                        void *memo,
+                        Component *to_update,
+                        CuMatrixBase<BaseFloat> *in_deriv) const;
+
+  virtual Component* Copy() const {
+    return new QuantizedAffineComponent(*this);
+  }
+  virtual void Read(std::istream &is, bool binary);
+  virtual void Write(std::ostream &os, bool binary) const;
+
+ private:
+  void Init(const CuMatrixBase<BaseFloat> &linear_params,
+            const CuVectorBase<BaseFloat> &bias_params);
+
+  QuantizedMatrix linear_params_;
+  CuVector<BaseFloat> bias_params_;
+  // The dequantized linear_params_, used on GPU or if we don't have an int8
+  // GEMM.
+  CuMatrix<BaseFloat> linear_params_float_;
+
+  QuantizedAffineComponent &operator = (
+      const QuantizedAffineComponent &other);  // Disallow.
+};
+
+
+/**
+   QuantizedTdnnComponent is a version of TdnnComponent whose linear
+   parameters are stored as 8-bit integers (see QuantizedMatrix); it is meant
+   for inference and cannot be trained.  It is normally created by
+   QuantizeNnet() from a TdnnComponent.  It uses the same precomputed indexes
+   as TdnnComponent.
+
+   Accepts the same config lines as TdnnComponent; the parameters are
+   quantized after the initialization.
+ */
+class QuantizedTdnnComponent: public Component {
+ public:
+  QuantizedTdnnComponent() { }
+  QuantizedTdnnComponent(const QuantizedTdnnComponent &other);
+
+  /// Quantizes the parameters of 'tdnn'.
+  explicit QuantizedTdnnComponent(const TdnnComponent &tdnn);
+
+  virtual std::string Type() const { return "QuantizedTdnnComponent"; }
+  virtual std::string Info() const;
+  virtual void InitFromConfig(ConfigLine *cfl);
+  virtual int32 Properties() const {
+    return kReordersIndexes|(bias_params_.Dim() == 0 ? kPropagateAdds : 0);
+  }
+  virtual int32 InputDim() const { return tdnn_.InputDim(); }
+  virtual int32 OutputDim() const { return tdnn_.OutputDim(); }
+
+  virtual void* Propagate(const ComponentPrecomputedIndexes *indexes,
+                         const CuMatrixBase<BaseFloat> &in,
+                         CuMatrixBase<BaseFloat> *out) const;
+  // Dies; this component can't be trained.
+  virtual void Backprop(const std::string &debug_info,
+                        const ComponentPrecomputedIndexes *indexes,
+                        const CuMatrixBase<BaseFloat> &in_value,
+                        const CuMatrixBase<BaseFloat> &out_value,
+                        const CuMatrixBase<BaseFloat> &out_deriv,
+                        void *memo,
+                        Component *to_update,
+                        CuMatrixBase<BaseFloat> *in_deriv) const;
+
+  virtual Component* Copy() const {
+    return new QuantizedTdnnComponent(*this);
+  }
+  virtual void Read(std::istream &is, bool binary);
+  virtual void Write(std::ostream &os, bool binary) const;
+
+  // The following are as in TdnnComponent.
+  virtual void ReorderIndexes(std::vector<Index> *input_indexes,
+                              std::vector<Index> *output_indexes) const {
+    tdnn_.ReorderIndexes(input_indexes, output_indexes);
+  }
+  virtual void GetInputIndexes(const MiscComputationInfo &misc_info,
+                               const Index &output_index,
+                               std::vector<Index> *desired_indexes) const {
+    tdnn_.GetInputIndexes(misc_info, output_index, desired_indexes);
+  }
+  virtual bool IsComputable(const MiscComputationInfo &misc_info,
+                            const Index &output_index,
+                            const IndexSet &input_index_set,
+                            std::vector<Index> *used_inputs) const {
+    return tdnn_.IsComputable(misc_info, output_index, input_index_set,
+                              used_inputs);
+  }
+  virtual ComponentPrecomputedIndexes* PrecomputeIndexes(
+      const MiscComputationInfo &misc_info,
+      const std::vector<Index> &input_indexes,
+      const std::vector<Index> &output_indexes,
+      bool need_backprop) const {
+    return tdnn_.PrecomputeIndexes(misc_info, input_indexes, output_indexes,
+                                   need_backprop);
+  }
+
+ private:
+  // Sets up tdnn_ (which must already have the right time offsets and
+  // dimensions), linear_params_ and bias_params_ from the parameters in
+  // 'linear_params' and 'bias_params'.
+  void Init(const CuMatrixBase<BaseFloat> &linear_params,
+            const CuVectorBase<BaseFloat> &bias_params);
+
+  // A TdnnComponent with the dequantized parameters; it is used for the
+  // index computations, and for Propagate() on GPU or if we don't have an
+  // int8 GEMM.
+  TdnnComponent tdnn_;
+  QuantizedMatrix linear_params_;
+  // The bias, or the empty vector if there is none.  It's the same as
+  // tdnn_.BiasParams().
+  CuVector<BaseFloat> bias_params_;
+
+  QuantizedTdnnComponent &operator = (
+      const QuantizedTdnnComponent &other);  // Disallow.
+};
+
+
+} // namespace nnet3
+} // namespace kaldi
+
+
+#endif
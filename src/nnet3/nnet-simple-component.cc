@@ -1327,6 +1327,20 @@ void AffineComponent::UnVectorize(const VectorBase<BaseFloat> &params) {
                                         OutputDim()));
 }
 
+void AffineComponent::CuVectorize(CuVectorBase<BaseFloat> *params) const {
+  KALDI_ASSERT(params->Dim() == this->NumParameters());
+  params->Range(0, InputDim() * OutputDim()).CopyRowsFromMat(linear_params_);
+  params->Range(InputDim() * OutputDim(),
+                OutputDim()).CopyFromVec(bias_params_);
+}
+
+void AffineComponent::CuUnVectorize(const CuVectorBase<BaseFloat> &params) {
+  KALDI_ASSERT(params.Dim() == this->NumParameters());
+  linear_params_.CopyRowsFromVec(params.Range(0, InputDim() * OutputDim()));
+  bias_params_.CopyFromVec(params.Range(InputDim() * OutputDim(),
+                                        OutputDim()));
+}
+
 RepeatedAffineComponent::RepeatedAffineComponent(const RepeatedAffineComponent & component) :
     UpdatableComponent(component),
     linear_params_(component.linear_params_),
@@ -2096,6 +2110,16 @@ void PerElementScaleComponent::UnVectorize(
   scales_.CopyFromVec(params);
 }
 
+void PerElementScaleComponent::CuVectorize(
+    CuVectorBase<BaseFloat> *params) const {
+  params->CopyFromVec(scales_);
+}
+
+void PerElementScaleComponent::CuUnVectorize(
+    const CuVectorBase<BaseFloat> &params) {
+  scales_.CopyFromVec(params);
+}
+
 void PerElementOffsetComponent::Scale(BaseFloat scale) {
   if (scale == 0.0) {
     offsets_.SetZero();
@@ -2305,6 +2329,16 @@ void PerElementOffsetComponent::UnVectorize(
   offsets_.CopyFromVec(params);
 }
 
+void PerElementOffsetComponent::CuVectorize(
+    CuVectorBase<BaseFloat> *params) const {
+  params->CopyFromVec(offsets_);
+}
+
+void PerElementOffsetComponent::CuUnVectorize(
+    const CuVectorBase<BaseFloat> &params) {
+  offsets_.CopyFromVec(params);
+}
+
 std::string ScaleAndOffsetComponent::Info() const {
   std::ostringstream stream;
   stream << UpdatableComponent::Info()
@@ -3044,6 +3078,12 @@ void NaturalGradientAffineComponent::FreezeNaturalGradient(bool freeze) {
   preconditioner_out_.Freeze(freeze);
 }
 
+void NaturalGradientAffineComponent::SetNaturalGradientMaxUpdatePeriod(
+    int32 max_update_period) {
+  preconditioner_in_.SetMaxUpdatePeriod(max_update_period);
+  preconditioner_out_.SetMaxUpdatePeriod(max_update_period);
+}
+
 void NaturalGradientAffineComponent::ConsolidateMemory() {
   OnlineNaturalGradient temp_in(preconditioner_in_);
   preconditioner_in_.Swap(&temp_in);
@@ -3307,6 +3347,14 @@ void LinearComponent::UnVectorize(const VectorBase<BaseFloat> &params) {
   KALDI_ASSERT(params.Dim() == this->NumParameters());
   params_.CopyRowsFromVec(params);
 }
+void LinearComponent::CuVectorize(CuVectorBase<BaseFloat> *params) const {
+  KALDI_ASSERT(params->Dim() == this->NumParameters());
+  params->CopyRowsFromMat(params_);
+}
+void LinearComponent::CuUnVectorize(const CuVectorBase<BaseFloat> &params) {
+  KALDI_ASSERT(params.Dim() == this->NumParameters());
+  params_.CopyRowsFromVec(params);
+}
 BaseFloat LinearComponent::DotProduct(const UpdatableComponent &other_in) const {
   const LinearComponent *other =
       dynamic_cast<const LinearComponent*>(&other_in);
@@ -3318,6 +3366,12 @@ void LinearComponent::FreezeNaturalGradient(bool freeze) {
   preconditioner_out_.Freeze(freeze);
 }
 
+void LinearComponent::SetNaturalGradientMaxUpdatePeriod(
+    int32 max_update_period) {
+  preconditioner_in_.SetMaxUpdatePeriod(max_update_period);
+  preconditioner_out_.SetMaxUpdatePeriod(max_update_period);
+}
+
 void LinearComponent::ConsolidateMemory() {
   OnlineNaturalGradient temp_in(preconditioner_in_);
   preconditioner_in_.Swap(&temp_in);
@@ -3937,6 +3991,11 @@ void NaturalGradientPerElementScaleComponent::FreezeNaturalGradient(bool freeze)
   preconditioner_.Freeze(freeze);
 }
 
+void NaturalGradientPerElementScaleComponent::SetNaturalGradientMaxUpdatePeriod(
+    int32 max_update_period) {
+  preconditioner_.SetMaxUpdatePeriod(max_update_period);
+}
+
 void NaturalGradientPerElementScaleComponent::ConsolidateMemory() {
   OnlineNaturalGradient temp(preconditioner_);
   preconditioner_.Swap(&temp);
@@ -4539,6 +4598,18 @@ void CompositeComponent::FreezeNaturalGradient(bool freeze) {
   }
 }
 
+void CompositeComponent::SetNaturalGradientMaxUpdatePeriod(
+    int32 max_update_period) {
+  for (size_t i = 0; i < components_.size(); i++) {
+    if (components_[i]->Properties() & kUpdatableComponent) {
+      UpdatableComponent *uc =
+          dynamic_cast<UpdatableComponent*>(components_[i]);
+      KALDI_ASSERT(uc != NULL);
+      uc->SetNaturalGradientMaxUpdatePeriod(max_update_period);
+    }
+  }
+}
+
 // virtual
 Component* CompositeComponent::Copy() const {
   std::vector<Component*> components(components_.size());
@@ -447,6 +447,8 @@ class AffineComponent: public UpdatableComponent {
   virtual int32 NumParameters() const;
   virtual void Vectorize(VectorBase<BaseFloat> *params) const;
   virtual void UnVectorize(const VectorBase<BaseFloat> &params);
+  virtual void CuVectorize(CuVectorBase<BaseFloat> *params) const;
+  virtual void CuUnVectorize(const CuVectorBase<BaseFloat> &params);
 
   // Some functions that are specific to this class.
 
@@ -835,6 +837,7 @@ class NaturalGradientAffineComponent: public AffineComponent {
   virtual void Scale(BaseFloat scale);
   virtual void Add(BaseFloat alpha, const Component &other);
   virtual void FreezeNaturalGradient(bool freeze);
+  virtual void SetNaturalGradientMaxUpdatePeriod(int32 max_update_period);
 
   virtual void ConsolidateMemory();
 
@@ -960,7 +963,10 @@ class LinearComponent: public UpdatableComponent {
   virtual int32 NumParameters() const;
   virtual void Vectorize(VectorBase<BaseFloat> *params) const;
   virtual void UnVectorize(const VectorBase<BaseFloat> &params);
+  virtual void CuVectorize(CuVectorBase<BaseFloat> *params) const;
+  virtual void CuUnVectorize(const CuVectorBase<BaseFloat> &params);
   virtual void FreezeNaturalGradient(bool freeze);
+  virtual void SetNaturalGradientMaxUpdatePeriod(int32 max_update_period);
   virtual void ConsolidateMemory();
 
   // copy constructor
@@ -1551,6 +1557,8 @@ class PerElementScaleComponent: public UpdatableComponent {
   virtual int32 NumParameters() const;
   virtual void Vectorize(VectorBase<BaseFloat> *params) const;
   virtual void UnVectorize(const VectorBase<BaseFloat> &params);
+  virtual void CuVectorize(CuVectorBase<BaseFloat> *params) const;
+  virtual void CuUnVectorize(const CuVectorBase<BaseFloat> &params);
 
   // Some functions that are specific to this class.
   explicit PerElementScaleComponent(const PerElementScaleComponent &other);
@@ -1653,6 +1661,8 @@ class PerElementOffsetComponent: public UpdatableComponent {
   virtual int32 NumParameters() const;
   virtual void Vectorize(VectorBase<BaseFloat> *params) const;
   virtual void UnVectorize(const VectorBase<BaseFloat> &params);
+  virtual void CuVectorize(CuVectorBase<BaseFloat> *params) const;
+  virtual void CuUnVectorize(const CuVectorBase<BaseFloat> &params);
 
   // Copy constructor
   explicit PerElementOffsetComponent(const PerElementOffsetComponent &other);
@@ -1778,6 +1788,7 @@ class NaturalGradientPerElementScaleComponent: public PerElementScaleComponent {
   virtual void Read(std::istream &is, bool binary);
   virtual void Write(std::ostream &os, bool binary) const;
   virtual void FreezeNaturalGradient(bool freeze);
+  virtual void SetNaturalGradientMaxUpdatePeriod(int32 max_update_period);
 
   virtual Component* Copy() const;
 
@@ -1903,6 +1914,11 @@ class ScaleAndOffsetComponent: public UpdatableComponent {
 
   // copy constructor
   explicit ScaleAndOffsetComponent(const ScaleAndOffsetComponent &other);
+
+  // Note: these have dimension block-dim, which may be less than the
+  // component's dim (in which case they are repeated).
+  const CuVector<BaseFloat> &Scales() const { return scales_; }
+  const CuVector<BaseFloat> &Offsets() const { return offsets_; }
  private:
   // Internal version of propagate, requires in.NumCols() equal to scales_.Dim()
   // (if batch-dim was set, this may require the caller to reshape the input and
@@ -2029,6 +2045,7 @@ class CompositeComponent: public UpdatableComponent {
   virtual void Vectorize(VectorBase<BaseFloat> *params) const;
   virtual void UnVectorize(const VectorBase<BaseFloat> &params);
   virtual void FreezeNaturalGradient(bool freeze);
+  virtual void SetNaturalGradientMaxUpdatePeriod(int32 max_update_period);
 
   // note: we dont implement the StoreStats function as it would be quite
   // expensive; instead, by default we call StoreStats() for any components that
@@ -0,0 +1,136 @@
+// nnet3/nnet-sparse-component-test.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nnet3/nnet-sparse-component.h"
+#include "nnet3/nnet-simple-component.h"
+#include "util/common-utils.h"
+
+namespace kaldi {
+namespace nnet3 {
+
+
+void UnitTestPruneMatrixNofM() {
+  int32 num_rows = RandInt(1, 20), num_cols = RandInt(1, 40),
+      m = RandInt(1, 8), n = RandInt(1, m);
+  Matrix<BaseFloat> mat(num_rows, num_cols);
+  mat.SetRandn();
+  Matrix<BaseFloat> pruned(mat);
+  PruneMatrixNofM(n, m, &pruned);
+  for (int32 r = 0; r < num_rows; r++) {
+    for (int32 c = 0; c < num_cols; c += m) {
+      int32 group_size = std::min(m, num_cols - c), num_kept = 0;
+      BaseFloat min_kept = 1.0e+10, max_pruned = 0.0;
+      for (int32 i = c; i < c + group_size; i++) {
+        if (pruned(r, i) != 0.0) {
+          KALDI_ASSERT(pruned(r, i) == mat(r, i));
+          num_kept++;
+          min_kept = std::min(min_kept, std::abs(mat(r, i)));
+        } else {
+          max_pruned = std::max(max_pruned, std::abs(mat(r, i)));
+        }
+      }
+      KALDI_ASSERT(num_kept == std::min(n, group_size) &&
+                   (num_kept == group_size || max_pruned <= min_kept));
+    }
+  }
+}
+
+
+void UnitTestSparseAffineComponent() {
+  int32 input_dim = RandInt(1, 50), output_dim = RandInt(1, 50);
+  AffineComponent affine;
+  affine.Init(input_dim, output_dim, 1.0 / std::sqrt(input_dim), 1.0);
+  Matrix<BaseFloat> linear_params(affine.LinearParams());
+  PruneMatrixNofM(2, 4, &linear_params);
+  CuMatrix<BaseFloat> cu_linear_params(linear_params);
+  affine.SetParams(affine.BiasParams(), cu_linear_params);
+
+  SparseAffineComponent sparse(affine.LinearParams(), affine.BiasParams());
+  KALDI_LOG << sparse.Info();
+  int32 num_nonzero = 0;
+  for (int32 r = 0; r < output_dim; r++)
+    for (int32 c = 0; c < input_dim; c++)
+      num_nonzero += (linear_params(r, c) != 0.0 ? 1 : 0);
+  KALDI_ASSERT(sparse.NumNonzeroParams() == num_nonzero);
+
+  bool binary = (RandInt(0, 1) == 0);
+  std::ostringstream os;
+  sparse.Write(os, binary);
+  std::istringstream is(os.str());
+  Component *read_component = Component::ReadNew(is, binary);
+  KALDI_ASSERT(read_component->Type() == "SparseAffineComponent");
+  Component *copy = read_component->Copy();
+
+  // Use enough rows that there is more than one block of rows in Propagate().
+  int32 num_rows = RandInt(1, 30);
+  CuMatrix<BaseFloat> input(num_rows, input_dim),
+      output1(num_rows, output_dim), output2(num_rows, output_dim),
+      output3(num_rows, output_dim);
+  input.SetRandn();
+  affine.Propagate(NULL, input, &output1);
+  sparse.Propagate(NULL, input, &output2);
+  copy->Propagate(NULL, input, &output3);
+  KALDI_ASSERT(output1.ApproxEqual(output2, 1.0e-04));
+  // text-mode I/O loses a few digits.
+  KALDI_ASSERT(output1.ApproxEqual(output3, 1.0e-03));
+  delete copy;
+  delete read_component;
+}
+
+
+void UnitTestSparseAffineComponentConfig() {
+  int32 input_dim = RandInt(1, 30), output_dim = RandInt(1, 30);
+  std::ostringstream config;
+  config << "input-dim=" << input_dim << " output-dim=" << output_dim
+         << " keep=1 group-size=4";
+  ConfigLine cfl;
+  KALDI_ASSERT(cfl.ParseLine(config.str()));
+  SparseAffineComponent sparse;
+  sparse.InitFromConfig(&cfl);
+  KALDI_ASSERT(sparse.InputDim() == input_dim &&
+               sparse.OutputDim() == output_dim &&
+               sparse.NumNonzeroParams() ==
+               output_dim * ((input_dim + 3) / 4));
+}
+
+
+} // namespace nnet3
+} // namespace kaldi
+
+
+int main() {
+  using namespace kaldi;
+  using namespace kaldi::nnet3;
+  for (int32 loop = 0; loop < 2; loop++) {
+#if HAVE_CUDA == 1
+    CuDevice::Instantiate().SetDebugStrideMode(true);
+    if (loop == 0)
+      CuDevice::Instantiate().SelectGpuId("no"); // -1 means no GPU
+    else
+      CuDevice::Instantiate().SelectGpuId("optional"); // -2 .. automatic selection
+#endif
+    for (int32 i = 0; i < 10; i++) {
+      UnitTestPruneMatrixNofM();
+      UnitTestSparseAffineComponent();
+      UnitTestSparseAffineComponentConfig();
+    }
+  }
+  KALDI_LOG << "Sparse-component tests succeeded.";
+  return 0;
+}
@@ -0,0 +1,213 @@
+// nnet3/nnet-sparse-component.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <sstream>
+#include "nnet3/nnet-sparse-component.h"
+#include "nnet3/nnet-parse.h"
+
+namespace kaldi {
+namespace nnet3 {
+
+
+void PruneMatrixNofM(int32 n, int32 m, MatrixBase<BaseFloat> *mat) {
+  KALDI_ASSERT(n > 0 && n <= m);
+  int32 num_rows = mat->NumRows(), num_cols = mat->NumCols();
+  std::vector<std::pair<BaseFloat, int32> > group;
+  for (int32 r = 0; r < num_rows; r++) {
+    BaseFloat *row = mat->RowData(r);
+    for (int32 c = 0; c < num_cols; c += m) {
+      int32 group_size = std::min(m, num_cols - c);
+      if (group_size <= n)
+        continue;
+      group.clear();
+      for (int32 i = 0; i < group_size; i++)
+        group.push_back(std::pair<BaseFloat, int32>(std::abs(row[c + i]), i));
+      // Put the n largest absolute values first; the rest are zeroed.
+      std::nth_element(group.begin(), group.begin() + n, group.end(),
+                       std::greater<std::pair<BaseFloat, int32> >());
+      for (int32 i = n; i < group_size; i++)
+        row[c + group[i].second] = 0.0;
+    }
+  }
+}
+
+
+SparseAffineComponent::SparseAffineComponent(
+    const SparseAffineComponent &other):
+    linear_params_(other.linear_params_),
+    bias_params_(other.bias_params_),
+    linear_params_gpu_(other.linear_params_gpu_) { }
+
+SparseAffineComponent::SparseAffineComponent(
+    const CuMatrixBase<BaseFloat> &linear_params,
+    const CuVectorBase<BaseFloat> &bias_params) {
+  Init(linear_params, bias_params);
+}
+
+void SparseAffineComponent::Init(
+    const CuMatrixBase<BaseFloat> &linear_params,
+    const CuVectorBase<BaseFloat> &bias_params) {
+  KALDI_ASSERT(linear_params.NumRows() == bias_params.Dim() &&
+               bias_params.Dim() != 0);
+  Matrix<BaseFloat> params(linear_params);
+  // The constructor of SparseMatrix keeps only the nonzero elements.
+  SparseMatrix<BaseFloat> sparse_params(params);
+  linear_params_.Swap(&sparse_params);
+  bias_params_ = bias_params;
+  CopyToGpu();
+}
+
+void SparseAffineComponent::CopyToGpu() {
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled())
+    linear_params_gpu_ = linear_params_;
+#endif
+}
+
+std::string SparseAffineComponent::Info() const {
+  std::ostringstream stream;
+  int32 num_params = InputDim() * OutputDim();
+  stream << Component::Info() << ", num-nonzero-params="
+         << NumNonzeroParams() << ", density="
+         << (num_params == 0 ? 0.0 :
+             NumNonzeroParams() / static_cast<BaseFloat>(num_params));
+  Matrix<BaseFloat> linear_params(OutputDim(), InputDim());
+  linear_params_.CopyToMat(&linear_params);
+  PrintParameterStats(stream, "linear-params",
+                      CuMatrix<BaseFloat>(linear_params));
+  PrintParameterStats(stream, "bias", bias_params_, true);
+  return stream.str();
+}
+
+void SparseAffineComponent::InitFromConfig(ConfigLine *cfl) {
+  std::string filename;
+  int32 keep = 0, group_size = 0;
+  bool prune = cfl->GetValue("keep", &keep);
+  if (prune != cfl->GetValue("group-size", &group_size) ||
+      (prune && !(keep > 0 && keep <= group_size)))
+    KALDI_ERR << "Invalid or incomplete values of keep and group-size: \""
+              << cfl->WholeLine() << "\"";
+  // Two forms allowed: "matrix=<rxfilename>", or "input-dim=x output-dim=y"
+  // (for testing purposes only).
+  CuMatrix<BaseFloat> mat;
+  if (cfl->GetValue("matrix", &filename)) {
+    if (cfl->HasUnusedValues())
+      KALDI_ERR << "Invalid initializer for layer of type "
+                << Type() << ": \"" << cfl->WholeLine() << "\"";
+    ReadKaldiObject(filename, &mat);
+  } else {
+    int32 input_dim = -1, output_dim = -1;
+    if (!cfl->GetValue("input-dim", &input_dim) ||
+        !cfl->GetValue("output-dim", &output_dim) || cfl->HasUnusedValues()) {
+      KALDI_ERR << "Invalid initializer for layer of type "
+                << Type() << ": \"" << cfl->WholeLine() << "\"";
+    }
+    mat.Resize(output_dim, input_dim + 1);
+    mat.SetRandn();
+  }
+  KALDI_ASSERT(mat.NumRows() != 0 && mat.NumCols() > 1);
+  int32 input_dim = mat.NumCols() - 1;
+  CuVector<BaseFloat> bias(mat.NumRows());
+  bias.CopyColFromMat(mat, input_dim);
+  Matrix<BaseFloat> linear_params(mat.ColRange(0, input_dim));
+  if (prune)
+    PruneMatrixNofM(keep, group_size, &linear_params);
+  Init(CuMatrix<BaseFloat>(linear_params), bias);
+}
+
+void* SparseAffineComponent::Propagate(
+    const ComponentPrecomputedIndexes *indexes,
+    const CuMatrixBase<BaseFloat> &in,
+    CuMatrixBase<BaseFloat> *out) const {
+  out->CopyRowsFromVec(bias_params_);
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled()) {
+    if (linear_params_gpu_.NumRows() != linear_params_.NumRows())
+      KALDI_ERR << "The GPU must be selected before " << Type()
+                << " is created or read.";
+    out->AddMatSmat(1.0, in, linear_params_gpu_, kTrans, 1.0);
+    return NULL;
+  }
+#endif
+  // We don't use AddMatSmat() on CPU, as it goes down the columns of the
+  // input and output.  Instead, for each block of a few input rows we go
+  // through the rows of the parameters once, so each parameter is used for
+  // several input rows while it is in cache.
+  const SparseMatrix<BaseFloat> &params = linear_params_;
+  const MatrixBase<BaseFloat> &in_mat = in.Mat();
+  MatrixBase<BaseFloat> &out_mat = out->Mat();
+  const int32 block_size = 8;
+  int32 num_rows = in_mat.NumRows(), output_dim = params.NumRows();
+  for (int32 t_begin = 0; t_begin < num_rows; t_begin += block_size) {
+    int32 t_end = std::min(num_rows, t_begin + block_size);
+    for (int32 j = 0; j < output_dim; j++) {
+      const SparseVector<BaseFloat> &row = params.Row(j);
+      const std::pair<MatrixIndexT, BaseFloat> *elems = row.Data();
+      int32 num_elems = row.NumElements();
+      for (int32 t = t_begin; t < t_end; t++) {
+        const BaseFloat *in_row = in_mat.RowData(t);
+        BaseFloat sum = 0.0;
+        for (int32 e = 0; e < num_elems; e++)
+          sum += elems[e].second * in_row[elems[e].first];
+        out_mat(t, j) += sum;
+      }
+    }
+  }
+  return NULL;
+}
+
+void SparseAffineComponent::Backprop(
+    const std::string &debug_info,
+    const ComponentPrecomputedIndexes *indexes,
+    const CuMatrixBase<BaseFloat> &, // in_value
+    const CuMatrixBase<BaseFloat> &, // out_value
+    const CuMatrixBase<BaseFloat> &, // out_deriv
+    void *memo,
+    Component *, // to_update
+    CuMatrixBase<BaseFloat> *) const {
+  KALDI_ERR << Type() << " cannot be trained or backpropagated through "
+            << "(component " << debug_info << ").";
+}
+
+void SparseAffineComponent::Write(std::ostream &os, bool binary) const {
+  WriteToken(os, binary, "<SparseAffineComponent>");
+  WriteToken(os, binary, "<LinearParams>");
+  linear_params_.Write(os, binary);
+  WriteToken(os, binary, "<BiasParams>");
+  bias_params_.Write(os, binary);
+  WriteToken(os, binary, "</SparseAffineComponent>");
+}
+
+void SparseAffineComponent::Read(std::istream &is, bool binary) {
+  ExpectOneOrTwoTokens(is, binary, "<SparseAffineComponent>",
+                       "<LinearParams>");
+  linear_params_.Read(is, binary);
+  ExpectToken(is, binary, "<BiasParams>");
+  bias_params_.Read(is, binary);
+  ExpectToken(is, binary, "</SparseAffineComponent>");
+  KALDI_ASSERT(bias_params_.Dim() == linear_params_.NumRows());
+  CopyToGpu();
+}
+
+
+} // namespace nnet3
+} // namespace kaldi
@@ -0,0 +1,127 @@
+// nnet3/nnet-sparse-component.h
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_NNET3_NNET_SPARSE_COMPONENT_H_
+#define KALDI_NNET3_NNET_SPARSE_COMPONENT_H_
+
+#include "nnet3/nnet-common.h"
+#include "nnet3/nnet-component-itf.h"
+#include "matrix/sparse-matrix.h"
+#include "cudamatrix/cu-sparse-matrix.h"
+
+namespace kaldi {
+namespace nnet3 {
+
+/// @file  nnet-sparse-component.h
+///
+/// This file contains SparseAffineComponent, an affine component for inference
+/// whose linear parameters are pruned and stored as a sparse matrix.  It is
+/// normally created from a trained model by PruneNnet() (see nnet-utils.h),
+/// e.g. via the program nnet3-am-prune.
+
+
+/**
+   Prunes 'mat' in the "n of m" structured way: in each group of 'm'
+   consecutive elements of each row (the last group in a row may be shorter),
+   all but the 'n' elements with the largest absolute values are set to zero.
+   Requires 0 < n <= m.  E.g. with n = 2 and m = 4, half the elements are
+   zeroed.
+*/
+void PruneMatrixNofM(int32 n, int32 m, MatrixBase<BaseFloat> *mat);
+
+
+/**
+   SparseAffineComponent is an affine transform whose linear parameters are
+   stored as a sparse matrix (only the nonzero elements are stored); it is
+   meant for inference, with parameters that have been pruned (see
+   PruneMatrixNofM()), and cannot be trained.  The amount of computation
+   in Propagate() is proportional to the number of nonzero parameters.
+
+   On CPU, Propagate() goes through the rows of the parameters once per
+   block of a few input rows; on GPU it uses cuSPARSE, via
+   CuMatrixBase::AddMatSmat(), which requires that the GPU was selected
+   before the component was created or read.
+
+   Accepts the same config lines as FixedAffineComponent, i.e.
+   matrix=<rxfilename>, with the bias as the last column, or (for testing
+   purposes) input-dim=x output-dim=y.  In addition the linear parameters can
+   be pruned with the options keep=n group-size=m (see PruneMatrixNofM());
+   the default is not to prune, which keeps the nonzero elements.
+ */
+class SparseAffineComponent: public Component {
+ public:
+  SparseAffineComponent() { }
+  SparseAffineComponent(const SparseAffineComponent &other);
+
+  /// Stores the nonzero elements of 'linear_params', of dimension output-dim
+  /// by input-dim; 'bias_params' is stored as is.
+  SparseAffineComponent(const CuMatrixBase<BaseFloat> &linear_params,
+                        const CuVectorBase<BaseFloat> &bias_params);
+
+  virtual std::string Type() const { return "SparseAffineComponent"; }
+  virtual std::string Info() const;
+  virtual void InitFromConfig(ConfigLine *cfl);
+  virtual int32 Properties() const { return kSimpleComponent; }
+  virtual int32 InputDim() const { return linear_params_.NumCols(); }
+  virtual int32 OutputDim() const { return linear_params_.NumRows(); }
+
+  virtual void* Propagate(const ComponentPrecomputedIndexes *indexes,
+                         const CuMatrixBase<BaseFloat> &in,
+                         CuMatrixBase<BaseFloat> *out) const;
+  // Dies; this component can't be trained.
+  virtual void Backprop(const std::string &debug_info,
+                        const ComponentPrecomputedIndexes *indexes,
+                        const CuMatrixBase<BaseFloat> &in_value,
+                        const CuMatrixBase<BaseFloat> &out_value,
+                        const CuMatrixBase<BaseFloat> &out_deriv,
+                        void *memo,
+                        Component *to_update,
+                        CuMatrixBase<BaseFloat> *in_deriv) const;
+
+  virtual Component* Copy() const {
+    return new SparseAffineComponent(*this);
+  }
+  virtual void Read(std::istream &is, bool binary);
+  virtual void Write(std::ostream &os, bool binary) const;
+
+  /// Returns the number of nonzero linear parameters.
+  int32 NumNonzeroParams() const { return linear_params_.NumElements(); }
+
+ private:
+  void Init(const CuMatrixBase<BaseFloat> &linear_params,
+            const CuVectorBase<BaseFloat> &bias_params);
+
+  // Copies linear_params_ to the GPU, if we are using one.
+  void CopyToGpu();
+
+  SparseMatrix<BaseFloat> linear_params_;
+  CuVector<BaseFloat> bias_params_;
+  // The same as linear_params_, if we are using a GPU; otherwise empty.
+  CuSparseMatrix<BaseFloat> linear_params_gpu_;
+
+  SparseAffineComponent &operator = (
+      const SparseAffineComponent &other);  // Disallow.
+};
+
+
+} // namespace nnet3
+} // namespace kaldi
+
+
+#endif
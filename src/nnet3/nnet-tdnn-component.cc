@@ -663,11 +663,37 @@ void TdnnComponent::UnVectorize(
     bias_params_.CopyFromVec(params.Range(linear_size, bias_size));
 }
 
+void TdnnComponent::CuVectorize(
+    CuVectorBase<BaseFloat> *params) const {
+  KALDI_ASSERT(params->Dim() == NumParameters());
+  int32 linear_size = linear_params_.NumRows() * linear_params_.NumCols(),
+      bias_size = bias_params_.Dim();
+  params->Range(0, linear_size).CopyRowsFromMat(linear_params_);
+  if (bias_size != 0)
+    params->Range(linear_size, bias_size).CopyFromVec(bias_params_);
+}
+
+void TdnnComponent::CuUnVectorize(
+    const CuVectorBase<BaseFloat> &params) {
+  KALDI_ASSERT(params.Dim() == NumParameters());
+  int32 linear_size = linear_params_.NumRows() * linear_params_.NumCols(),
+      bias_size = bias_params_.Dim();
+  linear_params_.CopyRowsFromVec(params.Range(0, linear_size));
+  if (bias_size != 0)
+    bias_params_.CopyFromVec(params.Range(linear_size, bias_size));
+}
+
 void TdnnComponent::FreezeNaturalGradient(bool freeze) {
   preconditioner_in_.Freeze(freeze);
   preconditioner_out_.Freeze(freeze);
 }
 
+void TdnnComponent::SetNaturalGradientMaxUpdatePeriod(
+    int32 max_update_period) {
+  preconditioner_in_.SetMaxUpdatePeriod(max_update_period);
+  preconditioner_out_.SetMaxUpdatePeriod(max_update_period);
+}
+
 TdnnComponent::PrecomputedIndexes*
 TdnnComponent::PrecomputedIndexes::Copy() const {
   return new PrecomputedIndexes(*this);
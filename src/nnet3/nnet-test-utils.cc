@@ -1400,7 +1400,7 @@ void ComputeExampleComputationRequestSimple(
 static void GenerateRandomComponentConfig(std::string *component_type,
                                           std::string *config) {
 
-  int32 n = RandInt(0, 37);
+  int32 n = RandInt(0, 38);
   BaseFloat learning_rate = 0.001 * RandInt(1, 100);
 
   std::ostringstream os;
@@ -1773,6 +1773,18 @@ static void GenerateRandomComponentConfig(std::string *component_type,
 
       break;
     }
+    case 38: {
+      *component_type = "LstmCellComponent";
+      int32 cell_dim = RandInt(1, 50);
+      // set self-repair scale to zero so the derivative tests will pass.  We
+      // don't test use-dropout=true, as the derivatives w.r.t. the dropout
+      // masks are not computed.
+      os << "cell-dim=" << cell_dim
+         << " input-dim=" << (cell_dim + RandInt(1, 50))
+         << " use-natural-gradient=" << (RandInt(0, 1) == 0 ? "true" : "false")
+         << " self-repair-scale=0.0 learning-rate=" << learning_rate;
+      break;
+    }
     default:
       KALDI_ERR << "Error generating random component";
   }
@@ -25,20 +25,29 @@ namespace kaldi {
 namespace nnet3 {
 
 NnetTrainer::NnetTrainer(const NnetTrainerOptions &config,
-                         Nnet *nnet):
+                         Nnet *nnet,
+                         NnetDataParallel *parallel):
     config_(config),
     nnet_(nnet),
+    parallel_(parallel),
     compiler_(*nnet, config_.optimize_config, config_.compiler_config),
     num_minibatches_processed_(0),
     max_change_stats_(*nnet),
+    loss_scaler_(config.loss_scale),
     srand_seed_(RandInt(0, 100000)) {
   if (config.zero_component_stats)
     ZeroComponentStats(nnet);
   KALDI_ASSERT(config.momentum >= 0.0 &&
                config.max_param_change >= 0.0 &&
-               config.backstitch_training_interval > 0);
+               config.backstitch_training_interval > 0 &&
+               config.loss_scale > 0.0);
   delta_nnet_ = nnet_->Copy();
   ScaleNnet(0.0, delta_nnet_);
+  // The natural-gradient preconditioners that are used are those in
+  // delta_nnet_.
+  if (config.natural_gradient_max_update_period > 0)
+    SetNaturalGradientMaxUpdatePeriod(config.natural_gradient_max_update_period,
+                                      delta_nnet_);
 
   if (config_.read_cache != "") {
     bool binary;
@@ -55,6 +64,16 @@ NnetTrainer::NnetTrainer(const NnetTrainerOptions &config,
 
 
 void NnetTrainer::Train(const NnetExample &eg) {
+  TrainMinibatch(eg, NULL);
+}
+
+void NnetTrainer::Train(const NnetExample &eg,
+                        const PrefetchedInputs &inputs) {
+  TrainMinibatch(eg, &inputs);
+}
+
+void NnetTrainer::TrainMinibatch(const NnetExample &eg,
+                                 const PrefetchedInputs *inputs) {
   bool need_model_derivative = true;
   ComputationRequest request;
   GetComputationRequest(*nnet_, eg, need_model_derivative,
@@ -71,15 +90,19 @@ void NnetTrainer::Train(const NnetExample &eg) {
     bool is_backstitch_step1 = true;
     srand(srand_seed_ + num_minibatches_processed_);
     ResetGenerators(nnet_);
-    TrainInternalBackstitch(eg, *computation, is_backstitch_step1);
+    TrainInternalBackstitch(eg, inputs, *computation,
+                            is_backstitch_step1);
     FreezeNaturalGradient(false, delta_nnet_); // un-freeze natural gradient
     is_backstitch_step1 = false;
     srand(srand_seed_ + num_minibatches_processed_);
     ResetGenerators(nnet_);
-    TrainInternalBackstitch(eg, *computation, is_backstitch_step1);
+    TrainInternalBackstitch(eg, inputs, *computation,
+                            is_backstitch_step1);
   } else { // conventional training
-    TrainInternal(eg, *computation);
+    TrainInternal(eg, inputs, *computation);
   }
+  if (parallel_ != NULL)
+    parallel_->MinibatchDone(nnet_);
   if (num_minibatches_processed_ == 0) {
     ConsolidateMemory(nnet_);
     ConsolidateMemory(delta_nnet_);
@@ -89,6 +112,7 @@ void NnetTrainer::Train(const NnetExample &eg) {
 }
 
 void NnetTrainer::TrainInternal(const NnetExample &eg,
+                                const PrefetchedInputs *inputs,
                                 const NnetComputation &computation) {
   // note: because we give the 1st arg (nnet_) as a pointer to the
   // constructor of 'computer', it will use that copy of the nnet to
@@ -96,22 +120,44 @@ void NnetTrainer::TrainInternal(const NnetExample &eg,
   NnetComputer computer(config_.compute_config, computation,
                         nnet_, delta_nnet_);
   // give the inputs to the computer object.
-  computer.AcceptInputs(*nnet_, eg.io);
-  computer.Run();
+  if (inputs != NULL)
+    inputs->CopyToComputer(&computer);
+  else
+    computer.AcceptInputs(*nnet_, eg.io);
+  {
+    // Only the forward and backward passes use the tensor cores, if
+    // --use-tensor-cores=true; the objective function is computed in FP32.
+    CuTensorOpMathScope tensor_op_math(config_.use_tensor_cores);
+    computer.Run();
+  }
 
   this->ProcessOutputs(false, eg, &computer);
-  computer.Run();
+  if (parallel_ != NULL)
+    parallel_->StartUpdate(delta_nnet_, &computer);
+  {
+    CuTensorOpMathScope tensor_op_math(config_.use_tensor_cores);
+    computer.Run();
+  }
+
+  // If doing data-parallel training, average the parameter change over the
+  // workers; this was started during the backprop.
+  if (parallel_ != NULL)
+    parallel_->AverageUpdate(delta_nnet_);
 
   // If relevant, add in the part of the gradient that comes from L2
-  // regularization.
+  // regularization.  delta_nnet_ is multiplied by the loss scale, so this
+  // is too.
+  BaseFloat loss_scale = loss_scaler_.Scale();
   ApplyL2Regularization(*nnet_,
-                        GetNumNvalues(eg.io, false) * config_.l2_regularize_factor,
+                        loss_scale * GetNumNvalues(eg.io, false) *
+                        config_.l2_regularize_factor,
                         delta_nnet_);
 
   // Update the parameters of nnet
   bool success = UpdateNnetWithMaxChange(
       *delta_nnet_, config_.max_param_change,
-      1.0, 1.0 - config_.momentum, nnet_, &max_change_stats_);
+      1.0, (1.0 - config_.momentum) / loss_scale, nnet_, &max_change_stats_);
+  BaseFloat loss_scale_change = loss_scaler_.UpdateDone(success);
 
   // Scale down the batchnorm stats (keeps them fresh... this affects what
   // happens when we use the model with batchnorm test-mode set).
@@ -123,12 +169,13 @@ void NnetTrainer::TrainInternal(const NnetExample &eg,
 
   // Scale deta_nnet
   if (success)
-    ScaleNnet(config_.momentum, delta_nnet_);
+    ScaleNnet(config_.momentum * loss_scale_change, delta_nnet_);
   else
     ScaleNnet(0.0, delta_nnet_);
 }
 
 void NnetTrainer::TrainInternalBackstitch(const NnetExample &eg,
+                                          const PrefetchedInputs *inputs,
                                           const NnetComputation &computation,
                                           bool is_backstitch_step1) {
   // note: because we give the 1st arg (nnet_) as a pointer to the
@@ -137,13 +184,29 @@ void NnetTrainer::TrainInternalBackstitch(const NnetExample &eg,
   NnetComputer computer(config_.compute_config, computation,
                         nnet_, delta_nnet_);
   // give the inputs to the computer object.
-  computer.AcceptInputs(*nnet_, eg.io);
-  computer.Run();
+  if (inputs != NULL)
+    inputs->CopyToComputer(&computer);
+  else
+    computer.AcceptInputs(*nnet_, eg.io);
+  {
+    CuTensorOpMathScope tensor_op_math(config_.use_tensor_cores);
+    computer.Run();
+  }
 
   bool is_backstitch_step2 = !is_backstitch_step1;
   this->ProcessOutputs(is_backstitch_step2, eg, &computer);
-  computer.Run();
+  if (parallel_ != NULL)
+    parallel_->StartUpdate(delta_nnet_, &computer);
+  {
+    CuTensorOpMathScope tensor_op_math(config_.use_tensor_cores);
+    computer.Run();
+  }
+
+  if (parallel_ != NULL)
+    parallel_->AverageUpdate(delta_nnet_);
 
+  // delta_nnet_ is multiplied by the loss scale.
+  BaseFloat loss_scale = loss_scaler_.Scale();
   BaseFloat max_change_scale, scale_adding;
   if (is_backstitch_step1) {
     // max-change is scaled by backstitch_training_scale;
@@ -160,15 +223,17 @@ void NnetTrainer::TrainInternalBackstitch(const NnetExample &eg,
     // passes of the backstitch, like we do here, but it probably minimizes
     // any harmful interactions with the max-change.
     ApplyL2Regularization(*nnet_,
-                          1.0 / scale_adding * GetNumNvalues(eg.io, false) *
+                          loss_scale / scale_adding *
+                          GetNumNvalues(eg.io, false) *
                           config_.l2_regularize_factor, delta_nnet_);
   }
 
   // Updates the parameters of nnet
-  UpdateNnetWithMaxChange(
+  bool success = UpdateNnetWithMaxChange(
       *delta_nnet_, config_.max_param_change,
-      max_change_scale, scale_adding, nnet_,
+      max_change_scale, scale_adding / loss_scale, nnet_,
       &max_change_stats_);
+  loss_scaler_.UpdateDone(success);
 
   if (is_backstitch_step1) {
     // The following will only do something if we have a LinearComponent or
@@ -208,7 +273,7 @@ void NnetTrainer::ProcessOutputs(bool is_backstitch_step2,
       bool supply_deriv = true;
       ComputeObjectiveFunction(io.features, obj_type, io.name,
                                supply_deriv, computer,
-                               &tot_weight, &tot_objf);
+                               &tot_weight, &tot_objf, loss_scaler_.Scale());
       objf_info_[io.name + suffix].UpdateStats(io.name + suffix,
                                       config_.print_interval,
                                       num_minibatches_processed_,
@@ -239,6 +304,37 @@ bool NnetTrainer::PrintTotalStats() const {
   return ans;
 }
 
+LossScaler::LossScaler(BaseFloat initial_scale, int32 growth_interval):
+    dynamic_(initial_scale != 1.0), scale_(initial_scale),
+    growth_interval_(growth_interval), num_good_updates_(0) {
+  KALDI_ASSERT(initial_scale > 0.0 && growth_interval > 0);
+}
+
+BaseFloat LossScaler::UpdateDone(bool success) {
+  if (!dynamic_)
+    return 1.0;
+  // We don't let the scale go below 1.0, as a smaller scale wouldn't help
+  // with overflow in FP16 (which is almost always caused by a large scale);
+  // and 2^24 is plenty.
+  const BaseFloat min_scale = 1.0, max_scale = 16777216.0;
+  BaseFloat old_scale = scale_;
+  if (!success) {
+    num_good_updates_ = 0;
+    if (scale_ > min_scale) {
+      scale_ = std::max(min_scale, scale_ * 0.5f);
+      KALDI_LOG << "Parameter change was not finite; reducing the loss "
+                << "scale to " << scale_;
+    }
+  } else if (++num_good_updates_ >= growth_interval_) {
+    num_good_updates_ = 0;
+    if (scale_ < max_scale) {
+      scale_ = std::min(max_scale, scale_ * 2.0f);
+      KALDI_VLOG(1) << "Increasing the loss scale to " << scale_;
+    }
+  }
+  return scale_ / old_scale;
+}
+
 void ObjectiveFunctionInfo::UpdateStats(
     const std::string &output_name,
     int32 minibatches_per_phase,
@@ -342,7 +438,8 @@ void ComputeObjectiveFunction(const GeneralMatrix &supervision,
                               bool supply_deriv,
                               NnetComputer *computer,
                               BaseFloat *tot_weight,
-                              BaseFloat *tot_objf) {
+                              BaseFloat *tot_objf,
+                              BaseFloat deriv_scale) {
   const CuMatrixBase<BaseFloat> &output = computer->GetOutput(output_name);
 
   if (output.NumCols() != supervision.NumCols())
@@ -366,6 +463,8 @@ void ComputeObjectiveFunction(const GeneralMatrix &supervision,
             CuMatrix<BaseFloat> output_deriv(output.NumRows(), output.NumCols(),
                                              kUndefined);
             cu_post.CopyToMat(&output_deriv);
+            if (deriv_scale != 1.0)
+              output_deriv.Scale(deriv_scale);
             computer->AcceptInput(output_name, &output_deriv);
           }
           break;
@@ -376,8 +475,11 @@ void ComputeObjectiveFunction(const GeneralMatrix &supervision,
           CuMatrix<BaseFloat> cu_post(supervision.GetFullMatrix());
           *tot_weight = cu_post.Sum();
           *tot_objf = TraceMatMat(output, cu_post, kTrans);
-          if (supply_deriv)
+          if (supply_deriv) {
+            if (deriv_scale != 1.0)
+              cu_post.Scale(deriv_scale);
             computer->AcceptInput(output_name, &cu_post);
+          }
           break;
         }
         case kCompressedMatrix: {
@@ -387,8 +489,11 @@ void ComputeObjectiveFunction(const GeneralMatrix &supervision,
           cu_post.Swap(&post);
           *tot_weight = cu_post.Sum();
           *tot_objf = TraceMatMat(output, cu_post, kTrans);
-          if (supply_deriv)
+          if (supply_deriv) {
+            if (deriv_scale != 1.0)
+              cu_post.Scale(deriv_scale);
             computer->AcceptInput(output_name, &cu_post);
+          }
           break;
         }
       }
@@ -403,8 +508,11 @@ void ComputeObjectiveFunction(const GeneralMatrix &supervision,
       diff.AddMat(-1.0, output);
       *tot_weight = diff.NumRows();
       *tot_objf = -0.5 * TraceMatMat(diff, diff, kTrans);
-      if (supply_deriv)
+      if (supply_deriv) {
+        if (deriv_scale != 1.0)
+          diff.Scale(deriv_scale);
         computer->AcceptInput(output_name, &diff);
+      }
       break;
     }
     default:
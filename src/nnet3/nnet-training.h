@@ -26,6 +26,8 @@
 #include "nnet3/nnet-compute.h"
 #include "nnet3/nnet-optimize.h"
 #include "nnet3/nnet-example-utils.h"
+#include "nnet3/nnet-example-prefetch.h"
+#include "nnet3/nnet-data-parallel.h"
 #include "nnet3/nnet-utils.h"
 
 namespace kaldi {
@@ -45,6 +47,9 @@ struct NnetTrainerOptions {
   std::string write_cache;
   bool binary_write_cache;
   BaseFloat max_param_change;
+  int32 natural_gradient_max_update_period;
+  bool use_tensor_cores;
+  BaseFloat loss_scale;
   NnetOptimizeOptions optimize_config;
   NnetComputeOptions compute_config;
   CachingOptimizingCompilerOptions compiler_config;
@@ -59,7 +64,10 @@ struct NnetTrainerOptions {
       backstitch_training_interval(1),
       batchnorm_stats_scale(0.8),
       binary_write_cache(true),
-      max_param_change(2.0) { }
+      max_param_change(2.0),
+      natural_gradient_max_update_period(0),
+      use_tensor_cores(false),
+      loss_scale(1.0) { }
   void Register(OptionsItf *opts) {
     opts->Register("store-component-stats", &store_component_stats,
                    "If true, store activations and derivatives for nonlinear "
@@ -99,6 +107,28 @@ struct NnetTrainerOptions {
                    &backstitch_training_interval,
                    "do backstitch training with the specified interval of "
                    "minibatches. It is referred as 'n' in our publications.");
+    opts->Register("natural-gradient-max-update-period",
+                   &natural_gradient_max_update_period,
+                   "If greater than the update-period of the natural-gradient "
+                   "components (e.g. 4), the period with which their Fisher "
+                   "matrix estimates are updated adapts up to this value, "
+                   "being lengthened while the estimates change slowly.  "
+                   "Saves time in training.");
+    opts->Register("use-tensor-cores", &use_tensor_cores, "If true and we are "
+                   "using a GPU, the matrix multiplications in the forward "
+                   "and backward passes use the tensor cores, i.e. FP16 math "
+                   "with FP32 accumulation.  The parameters and their updates, "
+                   "and the computation of the objective function (e.g. the "
+                   "chain denominator computation), stay in FP32.  Should "
+                   "normally be used with --loss-scale, e.g. 1024.");
+    opts->Register("loss-scale", &loss_scale, "If not 1.0, the initial value "
+                   "of a dynamic scale on the derivatives of the objective "
+                   "function in the backward pass, which is removed before "
+                   "the parameters are updated, so that small derivatives "
+                   "don't underflow with --use-tensor-cores.  It is halved "
+                   "(and the minibatch skipped) whenever the parameter change "
+                   "is not finite, and doubled after 2000 minibatches "
+                   "without that.");
     opts->Register("read-cache", &read_cache, "The location from which to read "
                    "the cached computation.");
     opts->Register("write-cache", &write_cache, "The location to which to write "
@@ -165,6 +195,42 @@ struct ObjectiveFunctionInfo {
 };
 
 
+/**
+   This class implements dynamic loss scaling, for training with
+   --use-tensor-cores, where small derivatives would otherwise be lost in the
+   FP16 math.  The trainer multiplies the derivatives of the objective
+   function by Scale() before the backward pass, so the parameter change in
+   the 'delta_nnet' also comes out multiplied by Scale(); it removes the
+   scale when it adds the change to the model, via the 'scale' argument of
+   UpdateNnetWithMaxChange(), so the max-change is applied to the true
+   parameter change.  UpdateNnetWithMaxChange() refuses changes that are not
+   finite, which is what happens if the scale is too large; then the scale is
+   halved.  After 'growth_interval' successful updates in a row it is doubled.
+   If the initial scale is 1.0, loss scaling is turned off and the scale
+   stays at 1.0.
+ */
+class LossScaler {
+ public:
+  explicit LossScaler(BaseFloat initial_scale, int32 growth_interval = 2000);
+
+  BaseFloat Scale() const { return scale_; }
+
+  // To be called after each update of the model, with the return value of
+  // UpdateNnetWithMaxChange().  Returns the factor (normally 0.5, 1.0 or 2.0)
+  // by which Scale() changed, which is the factor by which any part of the parameter
+  // change that is carried over to the next minibatch (i.e. with momentum)
+  // has to be multiplied.
+  BaseFloat UpdateDone(bool success);
+ private:
+  // False if the initial scale was 1.0.
+  bool dynamic_;
+  BaseFloat scale_;
+  int32 growth_interval_;
+  // The number of successful updates since the scale last changed.
+  int32 num_good_updates_;
+};
+
+
 /** This class is for single-threaded training of neural nets using
     standard objective functions such as cross-entropy (implemented with
     logsoftmax nonlinearity and a linear objective function) and quadratic loss.
@@ -179,25 +245,40 @@ struct ObjectiveFunctionInfo {
  */
 class NnetTrainer {
  public:
+  // If 'parallel' is non-NULL, it is used to average the parameter changes
+  // or the parameters with the other workers of data-parallel training (see
+  // class NnetDataParallel).
   NnetTrainer(const NnetTrainerOptions &config,
-              Nnet *nnet);
+              Nnet *nnet,
+              NnetDataParallel *parallel = NULL);
 
   // train on one minibatch.
   void Train(const NnetExample &eg);
 
+  // train on one minibatch whose input features have already been copied to
+  // CuMatrix form, by class ExamplePrefetcher; 'inputs' are used instead of
+  // the input features of 'eg'.
+  void Train(const NnetExample &eg, const PrefetchedInputs &inputs);
+
   // Prints out the final stats, and return true if there was a nonzero count.
   bool PrintTotalStats() const;
 
   ~NnetTrainer();
  private:
+  // Called by the Train() functions; 'inputs' is NULL or as for Train().
+  void TrainMinibatch(const NnetExample &eg, const PrefetchedInputs *inputs);
+
   // The internal function for doing one step of conventional SGD training.
+  // 'inputs' is NULL or as for Train().
   void TrainInternal(const NnetExample &eg,
+                     const PrefetchedInputs *inputs,
                      const NnetComputation &computation);
 
   // The internal function for doing one step of backstitch training. Depending
   // on whether is_backstitch_step1 is true, It could be either the first
   // (backward) step, or the second (forward) step of backstitch.
   void TrainInternalBackstitch(const NnetExample &eg,
+                               const PrefetchedInputs *inputs,
                                const NnetComputation &computation,
                                bool is_backstitch_step1);
 
@@ -209,6 +290,7 @@ class NnetTrainer {
   Nnet *delta_nnet_;  // nnet representing parameter-change for this minibatch
                       // (or, when using momentum, the moving weighted average
                       // of this).
+  NnetDataParallel *parallel_;  // not owned; may be NULL.
   CachingOptimizingCompiler compiler_;
 
   // This code supports multiple output layers, even though in the
@@ -219,6 +301,10 @@ class NnetTrainer {
   // stats for max-change.
   MaxChangeStats max_change_stats_;
 
+  // The scale on the derivatives in the backward pass; delta_nnet_ is
+  // multiplied by loss_scaler_.Scale().
+  LossScaler loss_scaler_;
+
   unordered_map<std::string, ObjectiveFunctionInfo, StringHasher> objf_info_;
 
   // This value is used in backstitch training when we need to ensure
@@ -260,6 +346,9 @@ class NnetTrainer {
                              this is not supported.
   @param [out] tot_objf      The total objective function; divide this by the
                              tot_weight to get the normalized objective function.
+  @param [in] deriv_scale    A scale on the derivative supplied to the network
+                             (the objective function is not affected); used
+                             for loss scaling, see class LossScaler.
 */
 void ComputeObjectiveFunction(const GeneralMatrix &supervision,
                               ObjectiveType objective_type,
@@ -267,7 +356,8 @@ void ComputeObjectiveFunction(const GeneralMatrix &supervision,
                               bool supply_deriv,
                               NnetComputer *computer,
                               BaseFloat *tot_weight,
-                              BaseFloat *tot_objf);
+                              BaseFloat *tot_objf,
+                              BaseFloat deriv_scale = 1.0);
 
 
 
@@ -21,6 +21,9 @@
 #include "nnet3/nnet-nnet.h"
 #include "nnet3/nnet-simple-component.h"
 #include "nnet3/nnet-test-utils.h"
+#include "nnet3/nnet-utils.h"
+#include "nnet3/nnet-compile.h"
+#include "nnet3/nnet-compute.h"
 
 namespace kaldi {
 namespace nnet3 {
@@ -100,6 +103,311 @@ void UnitTestConvertRepeatedToBlockAffineComposite() {
   }
 }
 
+// Returns the output of 'nnet' for this request and these inputs.
+static void ComputeOutput(const Nnet &nnet, const ComputationRequest &request,
+                          const std::vector<Matrix<BaseFloat> > &inputs,
+                          Matrix<BaseFloat> *output) {
+  NnetComputation computation;
+  Compiler compiler(request, nnet);
+  CompilerOptions opts;
+  compiler.CreateComputation(opts, &computation);
+  computation.ComputeCudaIndexes();
+  NnetComputeOptions compute_opts;
+  NnetComputer computer(compute_opts, computation, nnet, NULL);
+  for (size_t i = 0; i < request.inputs.size(); i++) {
+    CuMatrix<BaseFloat> temp(inputs[i]);
+    computer.AcceptInput(request.inputs[i].name, &temp);
+  }
+  computer.Run();
+  const CuMatrixBase<BaseFloat> &nnet_output = computer.GetOutput("output");
+  output->Resize(nnet_output.NumRows(), nnet_output.NumCols());
+  nnet_output.CopyToMat(output);
+}
+
+void UnitTestFuseLstmCells() {
+  // The structure of an 'lstmp' xconfig layer.  If use_dropout is true, the
+  // nonlinearity has three more inputs, which would be the dropout masks;
+  // for this test any three dimensions will do.
+  bool use_dropout = (RandInt(0, 1) == 0);
+  std::ostringstream config;
+  config <<
+    "component name=lstm1.W_all type=NaturalGradientAffineComponent "
+    "input-dim=12 output-dim=40\n"
+    "component name=lstm1.lstm_nonlin type=LstmNonlinearityComponent "
+    "cell-dim=10 use-dropout=" << (use_dropout ? "true" : "false") << "\n"
+    "component name=lstm1.W_rp type=NaturalGradientAffineComponent "
+    "input-dim=10 output-dim=8\n"
+    "component name=final type=AffineComponent input-dim=8 output-dim=5\n"
+    "\n"
+    "input-node name=input dim=8\n"
+    "component-node name=lstm1.W_all component=lstm1.W_all "
+    "input=Append(input, IfDefined(Offset(lstm1.r, -1)))\n"
+    "component-node name=lstm1.lstm_nonlin component=lstm1.lstm_nonlin "
+    "input=Append(lstm1.W_all, IfDefined(Offset(lstm1.c, -1))"
+         << (use_dropout ? ", IfDefined(Offset(lstm1.p, -1)))\n" : ")\n") <<
+    "dim-range-node name=lstm1.c input-node=lstm1.lstm_nonlin "
+    "dim-offset=0 dim=10\n"
+    "dim-range-node name=lstm1.m input-node=lstm1.lstm_nonlin "
+    "dim-offset=10 dim=10\n"
+    "component-node name=lstm1.W_rp component=lstm1.W_rp input=lstm1.m\n"
+    "dim-range-node name=lstm1.r input-node=lstm1.W_rp dim-offset=0 dim=4\n"
+    "component-node name=final component=final input=lstm1.W_rp\n"
+    "output-node name=output input=final\n";
+  if (use_dropout)
+    config << "dim-range-node name=lstm1.p input-node=lstm1.W_rp "
+        "dim-offset=4 dim=3\n";
+  Nnet nnet;
+  std::istringstream is(config.str());
+  nnet.ReadConfig(is);
+
+  Nnet fused_nnet(nnet);
+  KALDI_ASSERT(FuseLstmCells("*", &fused_nnet) == 1);
+  KALDI_ASSERT(fused_nnet.NumComponents() == nnet.NumComponents() - 1 &&
+               fused_nnet.GetNodeIndex("lstm1.W_all") == -1 &&
+               NumParameters(fused_nnet) == NumParameters(nnet));
+  KALDI_LOG << "Fused nnet is: " << fused_nnet.Info();
+
+  ComputationRequest request;
+  std::vector<Matrix<BaseFloat> > inputs;
+  ComputeExampleComputationRequestSimple(nnet, &request, &inputs);
+  Matrix<BaseFloat> output, fused_output;
+  ComputeOutput(nnet, request, inputs, &output);
+  ComputeOutput(fused_nnet, request, inputs, &fused_output);
+  AssertEqual(output, fused_output);
+
+  // Check that the fused nnet can be written and read back.
+  bool binary = (RandInt(0, 1) == 0);
+  std::ostringstream os;
+  fused_nnet.Write(os, binary);
+  Nnet fused_nnet2;
+  std::istringstream is2(os.str());
+  fused_nnet2.Read(is2, binary);
+  KALDI_ASSERT(NnetParametersAreIdentical(fused_nnet, fused_nnet2, 1.0e-05));
+}
+
+void UnitTestCollapseModelTdnnf() {
+  // A 'relu-batchnorm-dropout' layer followed by the structure of a 'tdnnf'
+  // xconfig layer, with a bypass connection, followed by layers that use
+  // ScaleAndOffsetComponent.
+  std::string config =
+    "component name=tdnn1.affine type=NaturalGradientAffineComponent "
+    "input-dim=10 output-dim=16\n"
+    "component name=tdnn1.relu type=RectifiedLinearComponent dim=16\n"
+    "component name=tdnn1.batchnorm type=BatchNormComponent dim=16\n"
+    "component name=tdnn1.dropout type=GeneralDropoutComponent dim=16 "
+    "dropout-proportion=0.1 continuous=true\n"
+    "component name=tdnnf2.linear type=TdnnComponent input-dim=16 "
+    "output-dim=6 use-bias=false time-offsets=-1,0\n"
+    "component name=tdnnf2.affine type=TdnnComponent input-dim=6 "
+    "output-dim=16 time-offsets=0,1\n"
+    "component name=tdnnf2.relu type=RectifiedLinearComponent dim=16\n"
+    "component name=tdnnf2.batchnorm type=BatchNormComponent dim=16\n"
+    "component name=tdnnf2.dropout type=GeneralDropoutComponent dim=16 "
+    "dropout-proportion=0.1 continuous=true\n"
+    "component name=tdnnf2.noop type=NoOpComponent dim=16\n"
+    "component name=prefinal.affine type=AffineComponent "
+    "input-dim=16 output-dim=12\n"
+    "component name=prefinal.so type=ScaleAndOffsetComponent dim=12\n"
+    "component name=prefinal.relu type=RectifiedLinearComponent dim=12\n"
+    "component name=prefinal.so2 type=ScaleAndOffsetComponent dim=12 "
+    "block-dim=6\n"
+    "component name=final type=AffineComponent input-dim=12 output-dim=5\n"
+    "\n"
+    "input-node name=input dim=10\n"
+    "component-node name=tdnn1.affine component=tdnn1.affine input=input\n"
+    "component-node name=tdnn1.relu component=tdnn1.relu input=tdnn1.affine\n"
+    "component-node name=tdnn1.batchnorm component=tdnn1.batchnorm "
+    "input=tdnn1.relu\n"
+    "component-node name=tdnn1.dropout component=tdnn1.dropout "
+    "input=tdnn1.batchnorm\n"
+    "component-node name=tdnnf2.linear component=tdnnf2.linear "
+    "input=tdnn1.dropout\n"
+    "component-node name=tdnnf2.affine component=tdnnf2.affine "
+    "input=tdnnf2.linear\n"
+    "component-node name=tdnnf2.relu component=tdnnf2.relu "
+    "input=tdnnf2.affine\n"
+    "component-node name=tdnnf2.batchnorm component=tdnnf2.batchnorm "
+    "input=tdnnf2.relu\n"
+    "component-node name=tdnnf2.dropout component=tdnnf2.dropout "
+    "input=tdnnf2.batchnorm\n"
+    "component-node name=tdnnf2.noop component=tdnnf2.noop "
+    "input=Sum(Scale(0.66, tdnn1.dropout), tdnnf2.dropout)\n"
+    "component-node name=prefinal.affine component=prefinal.affine "
+    "input=tdnnf2.noop\n"
+    "component-node name=prefinal.so component=prefinal.so "
+    "input=prefinal.affine\n"
+    "component-node name=prefinal.relu component=prefinal.relu "
+    "input=prefinal.so\n"
+    "component-node name=prefinal.so2 component=prefinal.so2 "
+    "input=prefinal.relu\n"
+    "component-node name=final component=final input=prefinal.so2\n"
+    "output-node name=output input=final\n";
+  Nnet nnet;
+  std::istringstream is(config);
+  nnet.ReadConfig(is);
+  // Make the ScaleAndOffsetComponents something other than the identity.
+  PerturbParams(0.1, &nnet);
+  SetBatchnormTestMode(true, &nnet);
+  SetDropoutTestMode(true, &nnet);
+
+  Nnet collapsed_nnet(nnet);
+  CollapseModel(CollapseModelConfig(), &collapsed_nnet);
+  KALDI_LOG << "Collapsed nnet is: " << collapsed_nnet.Info();
+  for (int32 c = 0; c < collapsed_nnet.NumComponents(); c++) {
+    std::string type = collapsed_nnet.GetComponent(c)->Type();
+    KALDI_ASSERT(type != "GeneralDropoutComponent" &&
+                 type != "ScaleAndOffsetComponent");
+  }
+  // The NoOpComponent caches a sum, so it should be kept.
+  KALDI_ASSERT(collapsed_nnet.GetNodeIndex("tdnnf2.noop") != -1 &&
+               collapsed_nnet.GetNodeIndex("tdnnf2.dropout") == -1);
+
+  ComputationRequest request;
+  std::vector<Matrix<BaseFloat> > inputs;
+  ComputeExampleComputationRequestSimple(nnet, &request, &inputs);
+  Matrix<BaseFloat> output, collapsed_output;
+  ComputeOutput(nnet, request, inputs, &output);
+  ComputeOutput(collapsed_nnet, request, inputs, &collapsed_output);
+  KALDI_ASSERT(ApproxEqual(output, collapsed_output));
+}
+
+void UnitTestApplySvdEnergyThreshold() {
+  // With energy-threshold set, the dimension should be worked out separately
+  // for each component: 'affine1' has (nearly) rank 3 so it is factorized,
+  // and 'final' has full rank so it is left alone.
+  std::string config =
+    "component name=affine1 type=AffineComponent input-dim=20 output-dim=30\n"
+    "component name=relu1 type=RectifiedLinearComponent dim=30\n"
+    "component name=final type=AffineComponent input-dim=30 output-dim=4\n"
+    "\n"
+    "input-node name=input dim=20\n"
+    "component-node name=affine1 component=affine1 input=input\n"
+    "component-node name=relu1 component=relu1 input=affine1\n"
+    "component-node name=final component=final input=relu1\n"
+    "output-node name=output input=final\n";
+  Nnet nnet;
+  std::istringstream is(config);
+  nnet.ReadConfig(is);
+  AffineComponent *affine1 = dynamic_cast<AffineComponent*>(
+      nnet.GetComponent(nnet.GetComponentIndex("affine1")));
+  KALDI_ASSERT(affine1 != NULL);
+  CuMatrix<BaseFloat> a(30, 3), b(3, 20), linear_params(30, 20);
+  a.SetRandn();
+  b.SetRandn();
+  linear_params.SetRandn();
+  linear_params.AddMatMat(1.0, a, kNoTrans, b, kNoTrans, 1.0e-04);
+  affine1->SetParams(affine1->BiasParams(), linear_params);
+
+  Nnet svd_nnet(nnet);
+  std::istringstream edit_config("apply-svd name=* energy-threshold=0.99\n");
+  ReadEditConfig(edit_config, &svd_nnet);
+  KALDI_LOG << "Nnet after SVD is: " << svd_nnet.Info();
+  KALDI_ASSERT(svd_nnet.NumComponents() == nnet.NumComponents() + 1 &&
+               svd_nnet.GetComponentIndex("final") != -1 &&
+               svd_nnet.GetComponentIndex("affine1_a") != -1 &&
+               svd_nnet.GetComponent(svd_nnet.GetComponentIndex(
+                   "affine1_a"))->OutputDim() == 3);
+
+  ComputationRequest request;
+  std::vector<Matrix<BaseFloat> > inputs;
+  ComputeExampleComputationRequestSimple(nnet, &request, &inputs);
+  Matrix<BaseFloat> output, svd_output;
+  ComputeOutput(nnet, request, inputs, &output);
+  ComputeOutput(svd_nnet, request, inputs, &svd_output);
+  KALDI_ASSERT(output.ApproxEqual(svd_output, 0.01));
+}
+
+void UnitTestKeepOnlyOutputs() {
+  // The structure of a chain model, whose 'output-xent' branch shares the
+  // 'tdnn1' layer with 'output', and has a second input that only
+  // 'output-xent' uses.
+  std::string config =
+    "component name=tdnn1.affine type=AffineComponent input-dim=10 "
+    "output-dim=16\n"
+    "component name=tdnn1.relu type=RectifiedLinearComponent dim=16\n"
+    "component name=output.affine type=AffineComponent input-dim=16 "
+    "output-dim=5\n"
+    "component name=prefinal-xent type=AffineComponent input-dim=20 "
+    "output-dim=8\n"
+    "component name=output-xent.affine type=AffineComponent input-dim=8 "
+    "output-dim=5\n"
+    "component name=output-xent.log-softmax type=LogSoftmaxComponent dim=5\n"
+    "\n"
+    "input-node name=input dim=10\n"
+    "input-node name=ivector dim=4\n"
+    "component-node name=tdnn1.affine component=tdnn1.affine input=input\n"
+    "component-node name=tdnn1.relu component=tdnn1.relu input=tdnn1.affine\n"
+    "component-node name=output.affine component=output.affine "
+    "input=tdnn1.relu\n"
+    "output-node name=output input=output.affine\n"
+    "component-node name=prefinal-xent component=prefinal-xent "
+    "input=Append(tdnn1.relu, ReplaceIndex(ivector, t, 0))\n"
+    "component-node name=output-xent.affine component=output-xent.affine "
+    "input=prefinal-xent\n"
+    "component-node name=output-xent.log-softmax "
+    "component=output-xent.log-softmax input=output-xent.affine\n"
+    "output-node name=output-xent input=output-xent.log-softmax\n";
+  Nnet nnet;
+  std::istringstream is(config);
+  nnet.ReadConfig(is);
+
+  Nnet slim_nnet(nnet);
+  KALDI_ASSERT(KeepOnlyOutputs("output", &slim_nnet) == 3);
+  KALDI_LOG << "Nnet after KeepOnlyOutputs() is: " << slim_nnet.Info();
+  KALDI_ASSERT(slim_nnet.NumComponents() == 3 &&
+               slim_nnet.GetNodeIndex("output-xent") == -1 &&
+               slim_nnet.GetNodeIndex("prefinal-xent") == -1 &&
+               slim_nnet.GetNodeIndex("tdnn1.relu") != -1 &&
+               slim_nnet.GetNodeIndex("input") != -1 &&
+               slim_nnet.GetNodeIndex("ivector") != -1);
+  // Nothing more to remove.
+  KALDI_ASSERT(KeepOnlyOutputs("output", &slim_nnet) == 0);
+
+  ComputationRequest request;
+  request.inputs.push_back(IoSpecification("input", 0, 10));
+  request.outputs.push_back(IoSpecification("output", 0, 10));
+  std::vector<Matrix<BaseFloat> > inputs(1, Matrix<BaseFloat>(10, 10));
+  inputs[0].SetRandn();
+  Matrix<BaseFloat> output, slim_output;
+  ComputeOutput(nnet, request, inputs, &output);
+  ComputeOutput(slim_nnet, request, inputs, &slim_output);
+  AssertEqual(output, slim_output);
+}
+
+// Checks that NnetSum gives the same result as ScaleNnet() and AddNnet().
+void UnitTestNnetSum() {
+  NnetGenerationOptions gen_config;
+  std::vector<std::string> configs;
+  GenerateConfigSequence(gen_config, &configs);
+  Nnet nnet1;
+  std::istringstream is(configs[0]);
+  nnet1.ReadConfig(is);
+  Nnet nnet2(nnet1);
+  PerturbParams(1.0, &nnet2);
+
+  BaseFloat weight1 = RandUniform(), weight2 = RandUniform();
+  Nnet ref_nnet(nnet1);
+  ScaleNnet(weight1, &ref_nnet);
+  AddNnet(nnet2, weight2, &ref_nnet);
+
+  NnetSum nnet_sum;
+  nnet_sum.Add(nnet1, weight1);
+  nnet_sum.Add(nnet2, weight2);
+  Nnet sum_nnet, avg_nnet;
+  nnet_sum.GetSum(false, &sum_nnet);
+  nnet_sum.GetSum(true, &avg_nnet);
+
+  int32 num_params = NumParameters(ref_nnet);
+  Vector<BaseFloat> ref_params(num_params), sum_params(num_params),
+      avg_params(num_params);
+  VectorizeNnet(ref_nnet, &ref_params);
+  VectorizeNnet(sum_nnet, &sum_params);
+  VectorizeNnet(avg_nnet, &avg_params);
+  AssertEqual(ref_params, sum_params);
+  ref_params.Scale(1.0 / (weight1 + weight2));
+  AssertEqual(ref_params, avg_params);
+}
+
 } // namespace nnet3
 } // namespace kaldi
 
@@ -111,6 +419,14 @@ int main() {
   UnitTestNnetContext();
   UnitTestConvertRepeatedToBlockAffine();
   UnitTestConvertRepeatedToBlockAffineComposite();
+  for (int32 i = 0; i < 5; i++)
+    UnitTestFuseLstmCells();
+  UnitTestCollapseModelTdnnf();
+  for (int32 i = 0; i < 3; i++)
+    UnitTestApplySvdEnergyThreshold();
+  UnitTestKeepOnlyOutputs();
+  for (int32 i = 0; i < 3; i++)
+    UnitTestNnetSum();
 
   KALDI_LOG << "Nnet tests succeeded.";
 
@@ -22,9 +22,12 @@
 #include "nnet3/nnet-utils.h"
 #include "nnet3/nnet-graph.h"
 #include "nnet3/nnet-simple-component.h"
+#include "nnet3/nnet-combined-component.h"
 #include "nnet3/nnet-normalize-component.h"
 #include "nnet3/nnet-general-component.h"
 #include "nnet3/nnet-convolutional-component.h"
+#include "nnet3/nnet-quantized-component.h"
+#include "nnet3/nnet-sparse-component.h"
 #include "nnet3/nnet-parse.h"
 #include "nnet3/nnet-computation-graph.h"
 #include "nnet3/nnet-diagnostics.h"
@@ -347,6 +350,49 @@ void AddNnet(const Nnet &src, BaseFloat alpha, Nnet *dest) {
   }
 }
 
+void NnetSum::Add(const Nnet &nnet, BaseFloat weight) {
+  if (nnet_.NumComponents() == 0) {
+    nnet_ = nnet;
+    for (int32 c = 0; c < nnet_.NumComponents(); c++) {
+      Component *comp = nnet_.GetComponent(c);
+      if (!(comp->Properties() & kUpdatableComponent))
+        comp->Scale(weight);
+    }
+    params_.Resize(NumParameters(nnet_));
+  } else {
+    if (nnet.NumComponents() != nnet_.NumComponents() ||
+        NumParameters(nnet) != params_.Dim())
+      KALDI_ERR << "Trying to add incompatible nnets.";
+    for (int32 c = 0; c < nnet.NumComponents(); c++) {
+      const Component *src_comp = nnet.GetComponent(c);
+      if (!(src_comp->Properties() & kUpdatableComponent))
+        nnet_.GetComponent(c)->Add(weight, *src_comp);
+    }
+  }
+  temp_.Resize(params_.Dim(), kUndefined);
+  VectorizeNnet(nnet, &temp_);
+  params_.AddVec(weight, temp_);
+  tot_weight_ += weight;
+}
+
+void NnetSum::GetSum(bool normalize, Nnet *nnet) const {
+  KALDI_ASSERT(params_.Dim() == NumParameters(nnet_));
+  *nnet = nnet_;
+  BaseFloat scale = 1.0;
+  if (normalize) {
+    KALDI_ASSERT(tot_weight_ != 0.0);
+    scale = 1.0 / tot_weight_;
+    for (int32 c = 0; c < nnet->NumComponents(); c++) {
+      Component *comp = nnet->GetComponent(c);
+      if (!(comp->Properties() & kUpdatableComponent))
+        comp->Scale(scale);
+    }
+  }
+  Vector<BaseFloat> params(params_);
+  params.Scale(scale);
+  UnVectorizeNnet(params, nnet);
+}
+
 int32 NumParameters(const Nnet &src) {
   int32 ans = 0;
   for (int32 c = 0; c < src.NumComponents(); c++) {
@@ -435,6 +481,19 @@ void FreezeNaturalGradient(bool freeze, Nnet *nnet) {
   }
 }
 
+void SetNaturalGradientMaxUpdatePeriod(int32 max_update_period, Nnet *nnet) {
+  for (int32 c = 0; c < nnet->NumComponents(); c++) {
+    Component *comp = nnet->GetComponent(c);
+    if (comp->Properties() & kUpdatableComponent) {
+      UpdatableComponent *uc = dynamic_cast<UpdatableComponent*>(comp);
+      if (uc == NULL)
+        KALDI_ERR << "Updatable component does not inherit from class "
+            "UpdatableComponent; change this code.";
+      uc->SetNaturalGradientMaxUpdatePeriod(max_update_period);
+    }
+  }
+}
+
 void ConvertRepeatedToBlockAffine(CompositeComponent *c_component) {
   for(int32 i = 0; i < c_component->NumComponents(); i++) {
     const Component *c = c_component->GetComponent(i);
@@ -629,6 +688,33 @@ void FindOrphanNodes(const Nnet &nnet, std::vector<int32> *nodes) {
   }
 }
 
+int32 KeepOnlyOutputs(const std::string &name_pattern, Nnet *nnet) {
+  std::vector<int32> nodes_to_remove;
+  int32 num_outputs_kept = 0;
+  for (int32 n = 0; n < nnet->NumNodes(); n++) {
+    if (nnet->IsOutputNode(n)) {
+      if (NameMatchesPattern(nnet->GetNodeName(n).c_str(),
+                             name_pattern.c_str()))
+        num_outputs_kept++;
+      else
+        nodes_to_remove.push_back(n);
+    }
+  }
+  if (num_outputs_kept == 0)
+    KALDI_ERR << "No output nodes match the pattern " << name_pattern;
+  if (nodes_to_remove.empty())
+    return 0;
+  int32 num_components = nnet->NumComponents();
+  nnet->RemoveSomeNodes(nodes_to_remove);
+  // The nodes that were only used by the removed outputs are now orphans.
+  nnet->RemoveOrphanNodes();
+  nnet->RemoveOrphanComponents();
+  int32 num_removed = num_components - nnet->NumComponents();
+  KALDI_LOG << "Removed " << nodes_to_remove.size() << " output nodes and "
+            << num_removed << " components that they used.";
+  return num_removed;
+}
+
 
 // Parameters used in applying SVD:
 // 1. Energy threshold : For each Affine weights layer in the original baseline nnet3 model,
@@ -666,8 +752,13 @@ class SvdApplier {
     DecomposeComponents();
     if (!modified_component_info_.empty())
       ModifyTopology();
-    KALDI_LOG << "Decomposed " << modified_component_info_.size()
-              << " components with SVD dimension " << bottleneck_dim_;
+    if (energy_threshold_ > 0)
+      KALDI_LOG << "Decomposed " << modified_component_info_.size()
+                << " components with SVD energy threshold "
+                << energy_threshold_;
+    else
+      KALDI_LOG << "Decomposed " << modified_component_info_.size()
+                << " components with SVD dimension " << bottleneck_dim_;
   }
 
  private:
@@ -690,7 +781,10 @@ class SvdApplier {
         }
         int32 input_dim = affine->InputDim(),
             output_dim = affine->OutputDim();
-        if (input_dim <= bottleneck_dim_ || output_dim <= bottleneck_dim_) {
+        // If energy_threshold_ is set, the dimension is worked out separately
+        // for each component, in DecomposeComponent().
+        if (energy_threshold_ <= 0 &&
+            (input_dim <= bottleneck_dim_ || output_dim <= bottleneck_dim_)) {
           KALDI_WARN << "Not decomposing component " << component_name
                      << " with SVD to rank " << bottleneck_dim_
                      << " because its dimension is " << input_dim
@@ -720,8 +814,6 @@ class SvdApplier {
 	}
       }
     }
-    KALDI_LOG << "Converted " << modified_component_info_.size()
-              << " components to FixedAffineComponent.";
   }
 
   // This function finds the minimum index of 
@@ -773,15 +865,24 @@ class SvdApplier {
     s2.AddVec2(1.0, s);
     BaseFloat s2_sum_orig = s2.Sum();
     KALDI_ASSERT(energy_threshold_ < 1);
-    KALDI_ASSERT(shrinkage_threshold_ < 1);
+    KALDI_ASSERT(shrinkage_threshold_ <= 1);
+    // Note: when energy_threshold_ is set, the dimension depends on the
+    // component, so we don't overwrite bottleneck_dim_.
+    int32 bottleneck_dim = bottleneck_dim_;
     if (energy_threshold_ > 0) {
       BaseFloat min_singular_sum = energy_threshold_ * s2_sum_orig;
-      bottleneck_dim_ = GetReducedDimension(s2, 0, s2.Dim()-1, min_singular_sum);
-    } 
-    SubVector<BaseFloat> this_part(s2, 0, bottleneck_dim_);
+      bottleneck_dim = GetReducedDimension(s2, 0, s2.Dim()-1, min_singular_sum);
+      if (bottleneck_dim >= middle_dim) {
+        KALDI_LOG << "For component " << component_name
+                  << " energy threshold " << energy_threshold_
+                  << " requires full rank; skipping SVD for this layer.";
+        return false;
+      }
+    }
+    SubVector<BaseFloat> this_part(s2, 0, bottleneck_dim);
     BaseFloat s2_sum_reduced = this_part.Sum();
     BaseFloat shrinkage_ratio =
-      static_cast<BaseFloat>(bottleneck_dim_ * (input_dim+output_dim))
+      static_cast<BaseFloat>(bottleneck_dim * (input_dim+output_dim))
       / static_cast<BaseFloat>(input_dim * output_dim);
     if (shrinkage_ratio > shrinkage_threshold_) {
       KALDI_LOG << "Shrinkage ratio " << shrinkage_ratio
@@ -790,9 +891,9 @@ class SvdApplier {
       return false;
     }
 
-    s.Resize(bottleneck_dim_, kCopyData);
-    A.Resize(bottleneck_dim_, input_dim, kCopyData);
-    B.Resize(output_dim, bottleneck_dim_, kCopyData);
+    s.Resize(bottleneck_dim, kCopyData);
+    A.Resize(bottleneck_dim, input_dim, kCopyData);
+    B.Resize(output_dim, bottleneck_dim, kCopyData);
     KALDI_LOG << "For component " << component_name
               << " singular value squared sum changed by "
               << (s2_sum_orig - s2_sum_reduced)
@@ -800,8 +901,8 @@ class SvdApplier {
     KALDI_LOG << "For component " << component_name
 	      << " dimension reduced from "
               << " (" << input_dim << "," << output_dim << ")"
-	      << " to [(" << input_dim << "," << bottleneck_dim_
-	      << "), (" << bottleneck_dim_ << "," << output_dim <<")]";
+	      << " to [(" << input_dim << "," << bottleneck_dim
+	      << "), (" << bottleneck_dim << "," << output_dim <<")]";
     KALDI_LOG << "shrinkage ratio : " << shrinkage_ratio;
 
     // we'll divide the singular values equally between the two
@@ -1353,6 +1454,14 @@ void ReadEditConfig(std::istream &edit_config_is, Nnet *nnet) {
       if (outputs_remaining == 0)
         KALDI_ERR << "All outputs were removed.";
       nnet->RemoveSomeNodes(nodes_to_remove);
+    } else if (directive == "keep-outputs") {
+      std::string name_pattern;
+      if (!config_line.GetValue("name", &name_pattern) ||
+          config_line.HasUnusedValues())
+        KALDI_ERR << "In edits-config, could not make sense of "
+                  << "keep-outputs directive: "
+                  << config_line.WholeLine();
+      KeepOnlyOutputs(name_pattern, nnet);
     } else if (directive == "set-dropout-proportion") {
       std::string name_pattern = "*";
       // name_pattern defaults to '*' if none is given.  This pattern
@@ -1406,6 +1515,11 @@ void ReadEditConfig(std::istream &edit_config_is, Nnet *nnet) {
 			 shrinkage_threshold,
 			 nnet);
       applier.ApplySvd();
+    } else if (directive == "fuse-lstm-cells") {
+      std::string name_pattern = "*";
+      config_line.GetValue("name", &name_pattern);
+      int32 num_fused = FuseLstmCells(name_pattern, nnet);
+      KALDI_LOG << "Fused " << num_fused << " LSTM cells.";
     } else if (directive == "reduce-rank") {
       std::string name_pattern;
       int32 rank = -1;
@@ -1447,9 +1561,12 @@ class ModelCollapser {
     int32 num_components1 = nnet_->NumComponents();
     for (; changed; num_iters++) {
       changed = false;
-      for (int32 n = 0; n < num_nodes; n++)
+      for (int32 n = 0; n < num_nodes; n++) {
         if (OptimizeNode(n))
           changed = true;
+        if (config_.collapse_noop && BypassIdentityNode(n))
+          changed = true;
+      }
       // we shouldn't iterate more than a couple of times.
       if (num_iters >= 10)
         KALDI_ERR << "Something went wrong collapsing model.";
@@ -1670,6 +1787,65 @@ class ModelCollapser {
   }
 
 
+  /**
+     This function modifies the neural network in the case where 'node_index'
+     is a component node whose component is the identity at test time (a
+     NoOpComponent, a GeneralDropoutComponent or a DropoutComponent with zero
+     dropout proportion) and whose input-descriptor is a node name like 'foo'
+     or an expression like 'Offset(foo, -1)'.  It replaces the node in all the
+     Descriptors that refer to it with its input-descriptor, so the copy that
+     the component would do is avoided; the node and the component are removed
+     later on by RemoveOrphanNodes() and RemoveOrphanComponents(), if they are
+     no longer used (they may still be used by dim-range nodes).
+
+     More general input-descriptors, like the Sum() whose value the
+     NoOpComponent in TDNN-F layers caches, are left alone, since replacing
+     them would mean the sum would be recomputed everywhere it is used.
+
+     This function returns true if it changed something in the neural net,
+     and false otherwise.
+   */
+  bool BypassIdentityNode(int32 node_index) {
+    const NetworkNode &node = nnet_->GetNode(node_index);
+    if (node.node_type != kComponent)
+      return false;
+    const Component *component = nnet_->GetComponent(node.u.component_index);
+    const DropoutComponent *dropout_component =
+        dynamic_cast<const DropoutComponent*>(component);
+    if (dynamic_cast<const NoOpComponent*>(component) == NULL &&
+        dynamic_cast<const GeneralDropoutComponent*>(component) == NULL &&
+        (dropout_component == NULL ||
+         dropout_component->DropoutProportion() != 0.0))
+      return false;
+    // Make a copy, because we may be modifying the node that it's in.
+    Descriptor input_descriptor = nnet_->GetNode(node_index - 1).descriptor;
+    if (input_descriptor.NumParts() != 1)
+      return false;
+    int32 input_node_index =
+        SumDescriptorIsCollapsible(input_descriptor.Part(0));
+    if (input_node_index == -1 || input_node_index == node_index)
+      return false;
+
+    bool changed = false;
+    int32 num_nodes = nnet_->NumNodes();
+    for (int32 n = 0; n < num_nodes; n++) {
+      NetworkNode &other_node = nnet_->GetNode(n);
+      if (other_node.node_type != kDescriptor)
+        continue;
+      std::vector<int32> dependencies;
+      other_node.descriptor.GetNodeDependencies(&dependencies);
+      if (std::find(dependencies.begin(), dependencies.end(),
+                    node_index) == dependencies.end())
+        continue;
+      other_node.descriptor = ReplaceNodeInDescriptor(other_node.descriptor,
+                                                      node_index,
+                                                      input_descriptor);
+      changed = true;
+    }
+    return changed;
+  }
+
+
   /**
      Tries to produce a component that's equivalent to running the component
      'component_index2' with input given by 'component_index1'.  This handles
@@ -1714,9 +1890,10 @@ class ModelCollapser {
   /**
      Tries to produce a component that's equivalent to running the component
      'component_index2' with input given by 'component_index1'.  This handles
-     the case where 'component_index1' is of type BatchnormComponent, and where
-     'component_index2' is of type AffineComponent or
-     NaturalGradientAffineComponent.
+     the case where 'component_index1' is of type BatchnormComponent or
+     ScaleAndOffsetComponent, and where 'component_index2' is of type
+     AffineComponent, NaturalGradientAffineComponent, LinearComponent or
+     TdnnComponent.
 
      Returns -1 if this code can't produce a combined component (normally
      because the components have the wrong types).
@@ -1726,17 +1903,24 @@ class ModelCollapser {
     const BatchNormComponent *batchnorm_component =
         dynamic_cast<const BatchNormComponent*>(
             nnet_->GetComponent(component_index1));
+    const ScaleAndOffsetComponent *scale_offset_component =
+        dynamic_cast<const ScaleAndOffsetComponent*>(
+            nnet_->GetComponent(component_index1));
+    std::string component_name1 = nnet_->GetComponentName(component_index1);
+    if (scale_offset_component != NULL)
+      return GetDiagonallyPreModifiedComponentIndex(
+          scale_offset_component->Offsets(),
+          scale_offset_component->Scales(),
+          component_name1, component_index2);
     if (batchnorm_component == NULL)
       return -1;
 
     if (batchnorm_component->Offset().Dim() == 0) {
       KALDI_ERR << "Expected batch-norm components to have test-mode set.";
     }
-    std::string batchnorm_component_name = nnet_->GetComponentName(
-        component_index1);
     return GetDiagonallyPreModifiedComponentIndex(batchnorm_component->Offset(),
                                                   batchnorm_component->Scale(),
-                                                  batchnorm_component_name,
+                                                  component_name1,
                                                   component_index2);
   }
 
@@ -1841,10 +2025,10 @@ class ModelCollapser {
      'component_index2' with input given by 'component_index1'.  This handles
      the case where 'component_index1' is of type AffineComponent or
      NaturalGradientAffineComponent, and 'component_index2' is of type
-     FixedScaleComponent, and the output dim of the first is the same as the
-     input dim of the second.  This situation is common in output layers.  Later
-     if it's needed, we could easily enable the code to support
-     PerElementScaleComponent.
+     FixedScaleComponent or ScaleAndOffsetComponent, and the output dim of the
+     first is the same as the input dim of the second.  This situation is
+     common in output layers.  Later if it's needed, we could easily enable the
+     code to support PerElementScaleComponent.
 
      Returns -1 if this code can't produce a combined component.
    */
@@ -1857,10 +2041,13 @@ class ModelCollapser {
     const FixedScaleComponent *fixed_scale_component2 =
         dynamic_cast<const FixedScaleComponent*>(
                     nnet_->GetComponent(component_index2));
+    const ScaleAndOffsetComponent *scale_offset_component2 =
+        dynamic_cast<const ScaleAndOffsetComponent*>(
+                    nnet_->GetComponent(component_index2));
     if (affine_component1 == NULL ||
-        fixed_scale_component2 == NULL ||
+        (fixed_scale_component2 == NULL && scale_offset_component2 == NULL) ||
         affine_component1->OutputDim() !=
-        fixed_scale_component2->InputDim())
+        nnet_->GetComponent(component_index2)->InputDim())
       return -1;
 
     std::ostringstream new_component_name_os;
@@ -1873,10 +2060,27 @@ class ModelCollapser {
 
     CuMatrix<BaseFloat> linear_params(affine_component1->LinearParams());
     CuVector<BaseFloat> bias_params(affine_component1->BiasParams());
-    const CuVector<BaseFloat> &scales = fixed_scale_component2->Scales();
-
-    bias_params.MulElements(scales);
-    linear_params.MulRowsVec(scales);
+    if (fixed_scale_component2 != NULL) {
+      const CuVector<BaseFloat> &scales = fixed_scale_component2->Scales();
+      bias_params.MulElements(scales);
+      linear_params.MulRowsVec(scales);
+    } else {
+      // The scales and offsets of ScaleAndOffsetComponent may have to be
+      // repeated, if it was configured with block-dim < dim.
+      int32 dim = bias_params.Dim(),
+          block_dim = scale_offset_component2->Scales().Dim();
+      CuVector<BaseFloat> full_scales(dim), full_offsets(dim);
+      for (int32 d = 0; d < dim; d += block_dim) {
+        full_scales.Range(d, block_dim).CopyFromVec(
+            scale_offset_component2->Scales());
+        full_offsets.Range(d, block_dim).CopyFromVec(
+            scale_offset_component2->Offsets());
+      }
+      // y = s (a x + b) + o = (s a) x + (s b + o).
+      bias_params.MulElements(full_scales);
+      bias_params.AddVec(1.0, full_offsets);
+      linear_params.MulRowsVec(full_scales);
+    }
 
     AffineComponent *new_affine_component =
         dynamic_cast<AffineComponent*>(affine_component1->Copy());
@@ -2094,6 +2298,156 @@ void CollapseModel(const CollapseModelConfig &config,
   c.Collapse();
 }
 
+int32 QuantizeNnet(const std::string &name_pattern, Nnet *nnet) {
+  int32 num_quantized = 0;
+  for (int32 c = 0; c < nnet->NumComponents(); c++) {
+    if (!NameMatchesPattern(nnet->GetComponentName(c).c_str(),
+                            name_pattern.c_str()))
+      continue;
+    const Component *component = nnet->GetComponent(c);
+    const AffineComponent *affine =
+        dynamic_cast<const AffineComponent*>(component);
+    const FixedAffineComponent *fixed_affine =
+        dynamic_cast<const FixedAffineComponent*>(component);
+    const LinearComponent *linear =
+        dynamic_cast<const LinearComponent*>(component);
+    const TdnnComponent *tdnn =
+        dynamic_cast<const TdnnComponent*>(component);
+    Component *new_component = NULL;
+    if (affine != NULL) {
+      new_component = new QuantizedAffineComponent(affine->LinearParams(),
+                                                   affine->BiasParams());
+    } else if (fixed_affine != NULL) {
+      new_component = new QuantizedAffineComponent(
+          fixed_affine->LinearParams(), fixed_affine->BiasParams());
+    } else if (linear != NULL) {
+      CuVector<BaseFloat> bias_params(linear->OutputDim());
+      new_component = new QuantizedAffineComponent(linear->Params(),
+                                                   bias_params);
+    } else if (tdnn != NULL) {
+      new_component = new QuantizedTdnnComponent(*tdnn);
+    }
+    if (new_component != NULL) {
+      nnet->SetComponent(c, new_component);
+      num_quantized++;
+    }
+  }
+  return num_quantized;
+}
+
+int32 PruneNnet(const std::string &name_pattern, int32 n, int32 m,
+                Nnet *nnet) {
+  int32 num_pruned = 0;
+  for (int32 c = 0; c < nnet->NumComponents(); c++) {
+    if (!NameMatchesPattern(nnet->GetComponentName(c).c_str(),
+                            name_pattern.c_str()))
+      continue;
+    const Component *component = nnet->GetComponent(c);
+    const AffineComponent *affine =
+        dynamic_cast<const AffineComponent*>(component);
+    const FixedAffineComponent *fixed_affine =
+        dynamic_cast<const FixedAffineComponent*>(component);
+    const LinearComponent *linear =
+        dynamic_cast<const LinearComponent*>(component);
+    const CuMatrixBase<BaseFloat> *cu_linear_params;
+    CuVector<BaseFloat> bias_params;
+    if (affine != NULL) {
+      cu_linear_params = &(affine->LinearParams());
+      bias_params = affine->BiasParams();
+    } else if (fixed_affine != NULL) {
+      cu_linear_params = &(fixed_affine->LinearParams());
+      bias_params = fixed_affine->BiasParams();
+    } else if (linear != NULL) {
+      cu_linear_params = &(linear->Params());
+      bias_params.Resize(linear->OutputDim());
+    } else {
+      continue;
+    }
+    Matrix<BaseFloat> linear_params(*cu_linear_params);
+    PruneMatrixNofM(n, m, &linear_params);
+    nnet->SetComponent(c, new SparseAffineComponent(
+        CuMatrix<BaseFloat>(linear_params), bias_params));
+    num_pruned++;
+  }
+  return num_pruned;
+}
+
+int32 FuseLstmCells(const std::string &name_pattern, Nnet *nnet) {
+  int32 num_nodes = nnet->NumNodes();
+  // num_uses[n] is the number of descriptors and dim-range nodes that refer to
+  // node n.
+  std::vector<int32> num_uses(num_nodes, 0),
+      component_uses(nnet->NumComponents(), 0);
+  for (int32 n = 0; n < num_nodes; n++) {
+    const NetworkNode &node = nnet->GetNode(n);
+    if (node.node_type == kDescriptor) {
+      std::vector<int32> dependencies;
+      node.descriptor.GetNodeDependencies(&dependencies);
+      SortAndUniq(&dependencies);
+      for (size_t i = 0; i < dependencies.size(); i++)
+        num_uses[dependencies[i]]++;
+    } else if (node.node_type == kDimRange) {
+      num_uses[node.u.node_index]++;
+    } else if (node.node_type == kComponent) {
+      component_uses[node.u.component_index]++;
+    }
+  }
+
+  const std::vector<std::string> &node_names = nnet->GetNodeNames();
+  int32 num_fused = 0;
+  for (int32 n = 0; n < num_nodes; n++) {
+    if (!nnet->IsComponentNode(n))
+      continue;
+    int32 c = nnet->GetNode(n).u.component_index;
+    const LstmNonlinearityComponent *lstm =
+        dynamic_cast<const LstmNonlinearityComponent*>(nnet->GetComponent(c));
+    if (lstm == NULL || !NameMatchesPattern(nnet->GetComponentName(c).c_str(),
+                                            name_pattern.c_str()))
+      continue;
+    if (component_uses[c] != 1) {
+      KALDI_WARN << "Not fusing component " << nnet->GetComponentName(c)
+                 << " as it is used in more than one node.";
+      continue;
+    }
+    const Descriptor &lstm_input = nnet->GetNode(n - 1).descriptor;
+    if (lstm_input.NumParts() < 2)
+      continue;
+    // The first part of the input must be just the output of the affine node,
+    // with no time offset.
+    std::vector<int32> dependencies;
+    lstm_input.Part(0).GetNodeDependencies(&dependencies);
+    if (dependencies.size() != 1)
+      continue;
+    int32 affine_node = dependencies[0];
+    std::ostringstream part_config;
+    lstm_input.Part(0).WriteConfig(part_config, node_names);
+    if (part_config.str() != node_names[affine_node] ||
+        !nnet->IsComponentNode(affine_node) || num_uses[affine_node] != 1)
+      continue;
+    const AffineComponent *affine = dynamic_cast<const AffineComponent*>(
+        nnet->GetComponent(nnet->GetNode(affine_node).u.component_index));
+    if (affine == NULL || (affine->Type() != "AffineComponent" &&
+                           affine->Type() != "NaturalGradientAffineComponent"))
+      continue;
+
+    const Descriptor &affine_input = nnet->GetNode(affine_node - 1).descriptor;
+    std::vector<SumDescriptor*> parts;
+    for (int32 p = 0; p < affine_input.NumParts(); p++)
+      parts.push_back(affine_input.Part(p).Copy());
+    for (int32 p = 1; p < lstm_input.NumParts(); p++)
+      parts.push_back(lstm_input.Part(p).Copy());
+    nnet->GetNode(n - 1).descriptor = Descriptor(parts);
+    nnet->SetComponent(c, new LstmCellComponent(*affine, *lstm));
+    num_fused++;
+  }
+  if (num_fused > 0) {
+    // Remove the affine nodes and components, which are now not used.
+    nnet->RemoveOrphanNodes();
+    nnet->RemoveOrphanComponents();
+  }
+  return num_fused;
+}
+
 bool UpdateNnetWithMaxChange(const Nnet &delta_nnet,
                              BaseFloat max_param_change,
                              BaseFloat max_change_scale,
@@ -2151,20 +2505,19 @@ bool UpdateNnetWithMaxChange(const Nnet &delta_nnet,
   BaseFloat param_delta = std::sqrt(param_delta_squared);
   // computes the scale for global max-change
   param_delta *= std::abs(scale);
-  if (max_param_change != 0.0) {
-    if (param_delta > max_param_change * max_change_scale) {
-      if (param_delta - param_delta != 0.0) {
-        KALDI_WARN << "Infinite parameter change, will not apply.";
-        return false;
-      } else {
-        scale *= max_param_change * max_change_scale / param_delta;
-        (*num_max_change_global_applied)++;
-      }
-    }
+  // This also catches NaN's, and infinities in components with a max-change
+  // (for which param_delta_squared would be inf * 0 = NaN).
+  if (param_delta - param_delta != 0.0) {
+    KALDI_WARN << "Infinite parameter change, will not apply.";
+    return false;
+  }
+  if (max_param_change != 0.0 &&
+      param_delta > max_param_change * max_change_scale) {
+    scale *= max_param_change * max_change_scale / param_delta;
+    (*num_max_change_global_applied)++;
   }
   if ((max_param_change != 0.0 &&
-      param_delta > max_param_change * max_change_scale &&
-      param_delta - param_delta == 0.0) || min_scale < 1.0) {
+      param_delta > max_param_change * max_change_scale) || min_scale < 1.0) {
     std::ostringstream ostr;
     if (min_scale < 1.0)
       ostr << "Per-component max-change active on "
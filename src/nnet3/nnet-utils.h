@@ -146,12 +146,47 @@ void VectorizeNnet(const Nnet &src,
 void UnVectorizeNnet(const VectorBase<BaseFloat> &params,
                      Nnet *dest);
 
+/**
+   This class computes a weighted sum (or average) of nnets of the same
+   structure, as done by nnet3-average and nnet3-combine.  The parameters of
+   the updatable components are summed in double precision, in a single
+   vector, so summing many nnets does not lose precision and only one nnet
+   (the first one added, which provides the structure) is kept in memory
+   besides that vector.  The stored stats of the other components (e.g. of
+   BatchNormComponent) are summed as by AddNnet().
+*/
+class NnetSum {
+ public:
+  NnetSum(): tot_weight_(0.0) { }
+
+  /// Adds weight * nnet to the sum.
+  void Add(const Nnet &nnet, BaseFloat weight);
+
+  /// Outputs the sum, divided by the total weight if 'normalize' is true.
+  void GetSum(bool normalize, Nnet *nnet) const;
+
+  double TotalWeight() const { return tot_weight_; }
+
+ private:
+  // The first nnet added; the stats of its non-updatable components are the
+  // weighted sum, and its parameters are not used.
+  Nnet nnet_;
+  Vector<double> params_;
+  Vector<BaseFloat> temp_;  // Temporary storage for the parameters of an nnet.
+  double tot_weight_;
+};
+
 /// Returns the number of updatable components in the nnet.
 int32 NumUpdatableComponents(const Nnet &dest);
 
 /// Controls if natural gradient will be updated
 void FreezeNaturalGradient(bool freeze, Nnet *nnet);
 
+/// Sets the maximum update period of the natural-gradient preconditioners of
+/// all components (see OnlineNaturalGradient::SetMaxUpdatePeriod()); 0 means
+/// the update period is fixed.
+void SetNaturalGradientMaxUpdatePeriod(int32 max_update_period, Nnet *nnet);
+
 /// Convert all components of type RepeatedAffineComponent or
 /// NaturalGradientRepeatedAffineComponent to BlockAffineComponent in nnet.
 void ConvertRepeatedToBlockAffine(Nnet *nnet);
@@ -215,6 +250,19 @@ void FindOrphanComponents(const Nnet &nnet, std::vector<int32> *components);
 /// nnet.GetNodeNames() to get their names).
 void FindOrphanNodes(const Nnet &nnet, std::vector<int32> *nodes);
 
+/**
+   This function removes all output nodes of 'nnet' except those whose names
+   match 'name_pattern' (a UNIX-style glob where the only metacharacter is
+   '*'), and then all nodes and components that are no longer used to compute
+   any of the remaining outputs; input nodes are kept.  Nodes and components
+   that are shared with a remaining output are kept.  It is an error if no
+   output matches.  This is useful at test time, e.g. to remove the
+   'output-xent' branch of chain models with KeepOnlyOutputs("output", ...);
+   the decoding programs do this after CollapseModel().  Returns the number
+   of components that were removed.
+*/
+int32 KeepOnlyOutputs(const std::string &name_pattern, Nnet *nnet);
+
 
 
 /**
@@ -224,32 +272,80 @@ void FindOrphanNodes(const Nnet &nnet, std::vector<int32> *nodes);
    For example, dropout components and batch-norm components that
    are in test mode can be combined with the next layer; and if there
    are successive affine components it may also be possible to
-   combine these under some circumstances.
+   combine these under some circumstances.  Components that are the
+   identity in test mode (no-op components, and dropout components that
+   can't be combined with the next layer) can be bypassed.
 
    It expects batch-norm components to be in test mode; you should probably call
    SetBatchnormTestMode() and SetDropoutTestMode() before CollapseModel().
  */
 struct CollapseModelConfig {
   bool collapse_dropout;  // dropout then affine/conv.
-  bool collapse_batchnorm;  // batchnorm then affine.
+  bool collapse_batchnorm;  // batchnorm or scale-and-offset then affine.
   bool collapse_affine;  // affine or fixed-affine then affine.
-  bool collapse_scale;  // affine then fixed-scale.
+  bool collapse_scale;  // affine then fixed-scale or scale-and-offset.
+  bool collapse_noop;  // no-op or test-mode dropout, bypassed.
   CollapseModelConfig(): collapse_dropout(true),
                          collapse_batchnorm(true),
                          collapse_affine(true),
-                         collapse_scale(true) { }
+                         collapse_scale(true),
+                         collapse_noop(true) { }
 };
 
 /**
    This function modifies the neural net for efficiency, in a way that
    suitable to be done in test time.  For example, it tries to get
-   rid of dropout, batchnorm and fixed-scale components, and to
-   collapse subsequent affine components if doing so won't hurt
-   speed.
+   rid of dropout, batchnorm, scale-and-offset, fixed-scale and no-op
+   components, and to collapse subsequent affine components if doing so
+   won't hurt speed.  This is what the --prepare-for-test option of
+   nnet3-copy and nnet3-am-copy does, after setting test mode.
  */
 void CollapseModel(const CollapseModelConfig &config,
                    Nnet *nnet);
 
+/**
+   This function replaces the components of 'nnet' whose names match
+   'name_pattern' (a UNIX-style glob where the only metacharacter is '*') and
+   which are of type AffineComponent (or a child class), FixedAffineComponent,
+   LinearComponent or TdnnComponent with their quantized versions,
+   QuantizedAffineComponent or QuantizedTdnnComponent (see
+   nnet-quantized-component.h), which store their weights as 8-bit integers
+   and can't be trained.  You will normally want to call this on a model that
+   is prepared for test, i.e. after CollapseModel().  Returns the number of
+   components that were quantized.
+ */
+int32 QuantizeNnet(const std::string &name_pattern, Nnet *nnet);
+
+/**
+   This function replaces the components of 'nnet' whose names match
+   'name_pattern' (a UNIX-style glob where the only metacharacter is '*') and
+   which are of type AffineComponent (or a child class), FixedAffineComponent
+   or LinearComponent with SparseAffineComponent (see
+   nnet-sparse-component.h), after pruning their linear parameters so that
+   only the 'n' largest-magnitude weights in each group of 'm' consecutive
+   weights in each row remain (see PruneMatrixNofM()).  The resulting
+   components can't be trained.  As with QuantizeNnet(), you will normally want
+   to call this after CollapseModel().  Returns the number of components that
+   were pruned.
+ */
+int32 PruneNnet(const std::string &name_pattern, int32 n, int32 m,
+                Nnet *nnet);
+
+/**
+   This function replaces each LstmNonlinearityComponent whose name matches
+   'name_pattern' (a UNIX-style glob where the only metacharacter is '*'), and
+   whose input is Append(x, ...) where x is the output of an AffineComponent or
+   NaturalGradientAffineComponent that is not used anywhere else, with an
+   LstmCellComponent that does both (see nnet-combined-component.h).  The input
+   of the new component is Append(<input of the affine component>, ...), and
+   the nodes and components of the affine transforms are removed.  This is the
+   structure of the 'lstmp' and 'fast-lstmp' xconfig layers, whose
+   'W_all' and 'lstm_nonlin' components are fused.  LstmNonlinearityComponents
+   that are used in more than one node are left alone.  Returns the number of
+   components that were replaced.
+ */
+int32 FuseLstmCells(const std::string &name_pattern, Nnet *nnet);
+
 /**
    ReadEditConfig() reads a file with a similar-looking format to the config file
    read by Nnet::ReadConfig(), but this consists of a sequence of operations to
@@ -295,6 +391,12 @@ void CollapseModel(const CollapseModelConfig &config,
        remove internal nodes directly; instead you should use the command
        'remove-orphans'.
 
+    keep-outputs name=<name-pattern>
+       Removes the output nodes that do not match the pattern, and then the
+       nodes and components that are no longer needed; see KeepOnlyOutputs().
+       E.g. 'keep-outputs name=output' removes the 'output-xent' branch of chain
+       models.
+
     set-dropout-proportion [name=<name-pattern>] proportion=<dropout-proportion>
        Sets the dropout rates for any components of type DropoutComponent,
        DropoutMaskComponent or GeneralDropoutComponent whose
@@ -309,11 +411,21 @@ void CollapseModel(const CollapseModelConfig &config,
        components, of types LinearComponent and NaturalGradientAffineComponent.
        Instead we can set the filtering criterion for the Singular values as energy-threshold,
        and retain those values which contribute to energy-threshold times the total energy of
-       the original singular values. A particular SVD factored component is left unshrinked,
+       the original singular values; in this case the retained dimension is worked
+       out separately for each component, and components that would need full rank
+       are left alone. A particular SVD factored component is left unshrinked,
        if the shrinkage ratio of the total no. of its parameters,
-       after the SVD based refactoring, is greater than shrinkage threshold.
+       after the SVD based refactoring, is greater than shrinkage threshold
+       (default 1.0, i.e. only components whose number of parameters would
+       increase are left alone).  The program nnet3-compare-outputs can be used
+       to check the outputs of the factored model against the original.
        See also 'reduce-rank'.
 
+    fuse-lstm-cells [name=<name-pattern>]
+       Replaces the LstmNonlinearityComponents with names matching
+       <name-pattern> (default "*"), and the affine components that compute
+       their inputs, with LstmCellComponents; see FuseLstmCells().
+
     reduce-rank name=<name-pattern> rank=<dim>
        Locates all components with names matching <name-pattern>, which are
        type AffineComponent or child classes thereof.  Does SVD on the
@@ -373,6 +485,9 @@ void ReadEditConfig(std::istream &config_file, Nnet *nnet);
                    this the count for each per-component max-change.
    @param [out] num_max_change_global_applied  We to this the count for the
                    global max-change.
+   @return     Returns true if the parameter change was applied; false if it
+               was not finite (e.g. the gradient contained NaN's or
+               infinities), in which case '*nnet' is not changed.
 */
 bool UpdateNnetWithMaxChange(const Nnet &delta_nnet,
                              BaseFloat max_param_change,
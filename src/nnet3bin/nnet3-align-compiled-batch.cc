@@ -0,0 +1,272 @@
+// nnet3bin/nnet3-align-compiled-batch.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <list>
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "util/kaldi-thread.h"
+#include "hmm/transition-model.h"
+#include "hmm/hmm-utils.h"
+#include "fstext/fstext-lib.h"
+#include "decoder/decoder-wrappers.h"
+#include "decoder/decodable-matrix.h"
+#include "nnet3/nnet-batch-compute.h"
+#include "nnet3/nnet-utils.h"
+
+namespace kaldi {
+
+// The graphs of the utterances that have been given to the
+// NnetBatchInference object, in the same order.
+typedef std::list<std::pair<std::string, fst::VectorFst<fst::StdArc>*> >
+    PendingGraphs;
+
+// Starts the alignment of any utterances whose nnet output is ready.
+void HandleOutput(const AlignConfig &align_config,
+                  const TransitionModel &trans_model,
+                  BaseFloat acoustic_scale,
+                  nnet3::NnetBatchInference *inference,
+                  PendingGraphs *pending_graphs,
+                  TaskSequencer<AlignUtteranceClass> *sequencer,
+                  Int32VectorWriter *alignment_writer,
+                  BaseFloatWriter *scores_writer,
+                  BaseFloatVectorWriter *per_frame_acwt_writer,
+                  int32 *num_done, int32 *num_err, int32 *num_retry,
+                  double *tot_like, int64 *frame_count) {
+  std::string utt;
+  Matrix<BaseFloat> *output = new Matrix<BaseFloat>();
+  while (inference->GetOutput(&utt, output)) {
+    KALDI_ASSERT(!pending_graphs->empty() &&
+                 pending_graphs->front().first == utt);
+    fst::VectorFst<fst::StdArc> *fst = pending_graphs->front().second;
+    pending_graphs->pop_front();
+    int32 num_frames = output->NumRows();
+    // The acoustic scale was already applied by the inference object, so the
+    // decodable object uses a scale of 1.0; it takes ownership of "output".
+    DecodableInterface *decodable =
+        new DecodableMatrixScaledMapped(trans_model, 1.0, output);
+    sequencer->Run(new AlignUtteranceClass(
+        align_config, utt, acoustic_scale, fst, decodable,
+        alignment_writer, scores_writer, num_done, num_err, num_retry,
+        tot_like, frame_count, per_frame_acwt_writer), num_frames);
+    output = new Matrix<BaseFloat>();
+  }
+  delete output;
+}
+
+}  // namespace kaldi
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    using namespace kaldi::nnet3;
+    typedef kaldi::int32 int32;
+    using fst::VectorFst;
+    using fst::StdArc;
+
+    const char *usage =
+        "Align features given nnet3 neural net model.  This version computes\n"
+        "the nnet outputs of many utterances at once (optimized for GPU-based\n"
+        "inference) and aligns them in multiple threads; otherwise it is the\n"
+        "same as nnet3-align-compiled.\n"
+        "Usage:   nnet3-align-compiled-batch [options] <nnet-in> "
+        "<graphs-rspecifier> <features-rspecifier> <alignments-wspecifier> "
+        "[<scores-wspecifier>]\n"
+        "e.g.: \n"
+        " nnet3-align-compiled-batch --num-threads=8 1.mdl ark:graphs.fsts "
+        "scp:train.scp ark:1.ali\n";
+
+    ParseOptions po(usage);
+    AlignConfig align_config;
+    NnetBatchComputerOptions compute_opts;
+    TaskSequencerConfig sequencer_config;
+    std::string use_gpu = "yes";
+    BaseFloat transition_scale = 1.0;
+    BaseFloat self_loop_scale = 1.0;
+    std::string per_frame_acwt_wspecifier;
+
+    std::string ivector_rspecifier,
+        online_ivector_rspecifier,
+        utt2spk_rspecifier;
+    int32 online_ivector_period = 0;
+    align_config.Register(&po);
+    compute_opts.Register(&po);
+    sequencer_config.Register(&po);
+
+    po.Register("use-gpu", &use_gpu,
+                "yes|no|optional|wait, only has effect if compiled with CUDA");
+    po.Register("transition-scale", &transition_scale,
+                "Transition-probability scale [relative to acoustics]");
+    po.Register("self-loop-scale", &self_loop_scale,
+                "Scale of self-loop versus non-self-loop "
+                "log probs [relative to acoustics]");
+    po.Register("write-per-frame-acoustic-loglikes", &per_frame_acwt_wspecifier,
+                "Wspecifier for table of vectors containing the acoustic log-likelihoods "
+                "per frame for each utterance. E.g. ark:foo/per_frame_logprobs.1.ark");
+    po.Register("ivectors", &ivector_rspecifier, "Rspecifier for "
+                "iVectors as vectors (i.e. not estimated online); per utterance "
+                "by default, or per speaker if you provide the --utt2spk option.");
+    po.Register("utt2spk", &utt2spk_rspecifier, "Rspecifier for "
+                "utt2spk option used to get ivectors per speaker");
+    po.Register("online-ivectors", &online_ivector_rspecifier, "Rspecifier for "
+                "iVectors estimated online, as matrices.  If you supply this,"
+                " you must set the --online-ivector-period option.");
+    po.Register("online-ivector-period", &online_ivector_period, "Number of frames "
+                "between iVectors in matrices supplied to the --online-ivectors "
+                "option");
+
+#if HAVE_CUDA==1
+    CuDevice::RegisterDeviceOptions(&po);
+#endif
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() < 4 || po.NumArgs() > 5) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+#if HAVE_CUDA==1
+    CuDevice::Instantiate().AllowMultithreading();
+    CuDevice::Instantiate().SelectGpuId(use_gpu);
+#endif
+
+    std::string model_in_filename = po.GetArg(1),
+        fst_rspecifier = po.GetArg(2),
+        feature_rspecifier = po.GetArg(3),
+        alignment_wspecifier = po.GetArg(4),
+        scores_wspecifier = po.GetOptArg(5);
+
+    int num_done = 0, num_err = 0, num_retry = 0;
+    double tot_like = 0.0;
+    kaldi::int64 frame_count = 0;
+
+    {
+      TransitionModel trans_model;
+      AmNnetSimple am_nnet;
+      {
+        bool binary;
+        Input ki(model_in_filename, &binary);
+        trans_model.Read(ki.Stream(), binary);
+        am_nnet.Read(ki.Stream(), binary);
+      }
+      SetBatchnormTestMode(true, &(am_nnet.GetNnet()));
+      SetDropoutTestMode(true, &(am_nnet.GetNnet()));
+      CollapseModel(CollapseModelConfig(), &(am_nnet.GetNnet()));
+      // Only "output" is used in decoding; this removes e.g. "output-xent".
+      KeepOnlyOutputs("output", &(am_nnet.GetNnet()));
+
+      RandomAccessBaseFloatMatrixReader online_ivector_reader(
+          online_ivector_rspecifier);
+      RandomAccessBaseFloatVectorReaderMapped ivector_reader(
+          ivector_rspecifier, utt2spk_rspecifier);
+
+      SequentialTableReader<fst::VectorFstHolder> fst_reader(fst_rspecifier);
+      RandomAccessBaseFloatMatrixReader feature_reader(feature_rspecifier);
+      Int32VectorWriter alignment_writer(alignment_wspecifier);
+      BaseFloatWriter scores_writer(scores_wspecifier);
+      BaseFloatVectorWriter per_frame_acwt_writer(per_frame_acwt_wspecifier);
+
+      // The sequencer must be destroyed after "inference", as HandleOutput()
+      // gives it jobs until the end; its destructor waits for them.
+      TaskSequencer<AlignUtteranceClass> sequencer(sequencer_config);
+      NnetBatchInference inference(compute_opts, am_nnet.GetNnet(),
+                                   am_nnet.Priors());
+      PendingGraphs pending_graphs;
+
+      for (; !fst_reader.Done(); fst_reader.Next()) {
+        std::string utt = fst_reader.Key();
+        if (!feature_reader.HasKey(utt)) {
+          KALDI_WARN << "No features for utterance " << utt;
+          num_err++;
+          continue;
+        }
+        const Matrix<BaseFloat> &features = feature_reader.Value(utt);
+        if (features.NumRows() == 0) {
+          KALDI_WARN << "Zero-length utterance: " << utt;
+          num_err++;
+          continue;
+        }
+
+        const Matrix<BaseFloat> *online_ivectors = NULL;
+        const Vector<BaseFloat> *ivector = NULL;
+        if (!ivector_rspecifier.empty()) {
+          if (!ivector_reader.HasKey(utt)) {
+            KALDI_WARN << "No iVector available for utterance " << utt;
+            num_err++;
+            continue;
+          } else {
+            ivector = &ivector_reader.Value(utt);
+          }
+        }
+        if (!online_ivector_rspecifier.empty()) {
+          if (!online_ivector_reader.HasKey(utt)) {
+            KALDI_WARN << "No online iVector available for utterance " << utt;
+            num_err++;
+            continue;
+          } else {
+            online_ivectors = &online_ivector_reader.Value(utt);
+          }
+        }
+
+        VectorFst<StdArc> *decode_fst = new VectorFst<StdArc>(
+            fst_reader.Value());
+        fst_reader.FreeCurrent();  // this stops copy-on-write of the fst
+        // by deleting the fst inside the reader, since we're about to mutate
+        // the fst by adding transition probs.
+        {  // Add transition-probs to the FST.
+          std::vector<int32> disambig_syms;  // empty.
+          AddTransitionProbs(trans_model, disambig_syms,
+                             transition_scale, self_loop_scale,
+                             decode_fst);
+        }
+        pending_graphs.push_back(std::make_pair(utt, decode_fst));
+        inference.AcceptInput(utt, features, ivector, online_ivectors,
+                              online_ivector_period);
+
+        HandleOutput(align_config, trans_model, compute_opts.acoustic_scale,
+                     &inference, &pending_graphs, &sequencer,
+                     &alignment_writer, &scores_writer, &per_frame_acwt_writer,
+                     &num_done, &num_err, &num_retry, &tot_like, &frame_count);
+      }
+      inference.Finished();
+      HandleOutput(align_config, trans_model, compute_opts.acoustic_scale,
+                   &inference, &pending_graphs, &sequencer,
+                   &alignment_writer, &scores_writer, &per_frame_acwt_writer,
+                   &num_done, &num_err, &num_retry, &tot_like, &frame_count);
+      KALDI_ASSERT(pending_graphs.empty());
+      sequencer.Wait();
+
+      KALDI_LOG << "Overall log-likelihood per frame is "
+                << (tot_like/frame_count)
+                << " over " << frame_count<< " frames.";
+      KALDI_LOG << "Retried " << num_retry << " out of "
+                << (num_done + num_err) << " utterances.";
+      KALDI_LOG << "Done " << num_done << ", errors on " << num_err;
+    }
+
+#if HAVE_CUDA==1
+    CuDevice::Instantiate().PrintProfile();
+#endif
+    return (num_done != 0 ? 0 : 1);
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
@@ -57,7 +57,7 @@ int main(int argc, char *argv[]) {
     std::string use_gpu = "yes";
     BaseFloat transition_scale = 1.0;
     BaseFloat self_loop_scale = 1.0;
-    std::string per_frame_acwt_wspecifier;
+    std::string per_frame_acwt_wspecifier, loglikes_wspecifier;
 
     std::string ivector_rspecifier,
         online_ivector_rspecifier,
@@ -76,6 +76,12 @@ int main(int argc, char *argv[]) {
     po.Register("write-per-frame-acoustic-loglikes", &per_frame_acwt_wspecifier,
                 "Wspecifier for table of vectors containing the acoustic log-likelihoods "
                 "per frame for each utterance. E.g. ark:foo/per_frame_logprobs.1.ark");
+    po.Register("write-loglikes", &loglikes_wspecifier, "If set, also write "
+                "the pdf-level log-likelihoods (without the acoustic scale, "
+                "compressed) to this table, so that later passes can use "
+                "them, e.g. with align-compiled-mapped or "
+                "lattice-rescore-mapped, instead of running the network "
+                "again.");
     po.Register("ivectors", &ivector_rspecifier, "Rspecifier for "
                 "iVectors as vectors (i.e. not estimated online); per utterance "
                 "by default, or per speaker if you provide the --utt2spk option.");
@@ -119,6 +125,8 @@ int main(int argc, char *argv[]) {
       SetBatchnormTestMode(true, &(am_nnet.GetNnet()));
       SetDropoutTestMode(true, &(am_nnet.GetNnet()));
       CollapseModel(CollapseModelConfig(), &(am_nnet.GetNnet()));
+      // Only "output" is used in decoding; this removes e.g. "output-xent".
+      KeepOnlyOutputs("output", &(am_nnet.GetNnet()));
       // this compiler object allows caching of computations across
       // different utterances.
       CachingOptimizingCompiler compiler(am_nnet.GetNnet(),
@@ -135,6 +143,7 @@ int main(int argc, char *argv[]) {
       Int32VectorWriter alignment_writer(alignment_wspecifier);
       BaseFloatWriter scores_writer(scores_wspecifier);
       BaseFloatVectorWriter per_frame_acwt_writer(per_frame_acwt_wspecifier);
+      CompressedMatrixWriter loglikes_writer(loglikes_wspecifier);
 
       for (; !fst_reader.Done(); fst_reader.Next()) {
         std::string utt = fst_reader.Key();
@@ -187,13 +196,23 @@ int main(int argc, char *argv[]) {
             decodable_opts, trans_model, am_nnet,
             features, ivector, online_ivectors,
             online_ivector_period, &compiler);
+        // If we write the log-likelihoods, we align with the matrix they
+        // were written from, so the network is only run once.
+        DecodableInterface *matrix_decodable = NULL;
+        if (loglikes_writer.IsOpen())
+          matrix_decodable = WriteLogLikelihoods(
+              utt, trans_model, decodable_opts.acoustic_scale,
+              &nnet_decodable, &loglikes_writer);
 
         AlignUtteranceWrapper(align_config, utt,
                               decodable_opts.acoustic_scale,
-                              &decode_fst, &nnet_decodable,
+                              &decode_fst,
+                              (matrix_decodable != NULL ? matrix_decodable :
+                               &nnet_decodable),
                               &alignment_writer, &scores_writer,
                               &num_done, &num_err, &num_retry,
                               &tot_like, &frame_count, &per_frame_acwt_writer);
+        delete matrix_decodable;
       }
       KALDI_LOG << "Overall log-likelihood per frame is "
                 << (tot_like/frame_count)
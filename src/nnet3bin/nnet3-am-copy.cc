@@ -51,6 +51,7 @@ int main(int argc, char *argv[]) {
     bool convert_repeated_to_block = false;
     BaseFloat scale = 1.0;
     bool prepare_for_test = false;
+    bool write_param_blob = false;
     std::string nnet_config, edits_config, edits_str;
 
     ParseOptions po(usage);
@@ -87,6 +88,10 @@ int main(int argc, char *argv[]) {
                 "slightly.  Involves setting test mode in dropout and batch-norm "
                 "components, and calling CollapseModel() which may remove some "
                 "components.");
+    po.Register("write-param-blob", &write_param_blob,
+                "If true, write the parameters of all the components as one "
+                "block at the start of the nnet, which is faster to read "
+                "(requires --binary=true).");
 
     po.Read(argc, argv);
 
@@ -94,6 +99,8 @@ int main(int argc, char *argv[]) {
       po.PrintUsage();
       exit(1);
     }
+    if (write_param_blob && !binary_write)
+      KALDI_ERR << "--write-param-blob=true requires --binary=true";
 
     std::string nnet_rxfilename = po.GetArg(1),
         nnet_wxfilename = po.GetArg(2);
@@ -149,14 +156,22 @@ int main(int argc, char *argv[]) {
     }
 
     if (raw) {
-      WriteKaldiObject(am_nnet.GetNnet(), nnet_wxfilename, binary_write);
+      if (write_param_blob) {
+        Output ko(nnet_wxfilename, binary_write);
+        am_nnet.GetNnet().WriteWithParamBlob(ko.Stream());
+      } else {
+        WriteKaldiObject(am_nnet.GetNnet(), nnet_wxfilename, binary_write);
+      }
       KALDI_LOG << "Copied neural net from " << nnet_rxfilename
                 << " to raw format as " << nnet_wxfilename;
 
     } else {
       Output ko(nnet_wxfilename, binary_write);
       trans_model.Write(ko.Stream(), binary_write);
-      am_nnet.Write(ko.Stream(), binary_write);
+      if (write_param_blob)
+        am_nnet.WriteWithParamBlob(ko.Stream());
+      else
+        am_nnet.Write(ko.Stream(), binary_write);
       KALDI_LOG << "Copied neural net from " << nnet_rxfilename
                 << " to " << nnet_wxfilename;
     }
@@ -0,0 +1,116 @@
+// nnet3bin/nnet3-am-prune.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "hmm/transition-model.h"
+#include "nnet3/am-nnet-simple.h"
+#include "nnet3/nnet-utils.h"
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    using namespace kaldi::nnet3;
+    typedef kaldi::int32 int32;
+
+    const char *usage =
+        "Prepare an nnet3 acoustic model for test and prune the weights of its\n"
+        "affine and linear components in a structured way: in each group of\n"
+        "--group-size consecutive weights in a row of the weight matrix, only\n"
+        "the --keep largest (in absolute value) are kept.  The components are\n"
+        "replaced with SparseAffineComponent (see nnet3/nnet-sparse-component.h),\n"
+        "which only stores and computes with the remaining weights.  The output\n"
+        "model can be used in place of the input one by the decoding programs,\n"
+        "but can't be trained; you will normally want to check its accuracy\n"
+        "for the --keep and --group-size you use.\n"
+        "\n"
+        "Usage:  nnet3-am-prune [options] <model-in> <model-out>\n"
+        "e.g.:\n"
+        " nnet3-am-prune --keep=2 --group-size=4 final.mdl final_sparse.mdl\n"
+        " nnet3-am-prune --name='tdnn*' final.mdl final_sparse.mdl\n";
+
+    bool binary_write = true,
+        raw = false;
+    std::string name_pattern = "*";
+    int32 keep = 2, group_size = 4;
+
+    ParseOptions po(usage);
+    po.Register("binary", &binary_write, "Write output in binary mode");
+    po.Register("raw", &raw, "If true, read and write 'raw' neural nets "
+                "(without transition model and priors), as nnet3-copy does.");
+    po.Register("keep", &keep, "The number of weights to keep in each group "
+                "of --group-size weights.");
+    po.Register("group-size", &group_size, "The size of the groups of "
+                "consecutive weights that are pruned.");
+    po.Register("name", &name_pattern, "Only prune the components whose "
+                "names match this pattern (in which '*' matches any "
+                "sequence of characters).  E.g. you may not want to prune "
+                "the final layer.");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 2 || keep <= 0 || keep > group_size) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string nnet_rxfilename = po.GetArg(1),
+        nnet_wxfilename = po.GetArg(2);
+
+    TransitionModel trans_model;
+    AmNnetSimple am_nnet;
+    Nnet raw_nnet;
+    if (raw) {
+      ReadKaldiObject(nnet_rxfilename, &raw_nnet);
+    } else {
+      bool binary;
+      Input ki(nnet_rxfilename, &binary);
+      trans_model.Read(ki.Stream(), binary);
+      am_nnet.Read(ki.Stream(), binary);
+    }
+    Nnet &nnet = (raw ? raw_nnet : am_nnet.GetNnet());
+
+    // Collapse batch-norm, dropout etc. into the affine components before
+    // pruning them.
+    SetBatchnormTestMode(true, &nnet);
+    SetDropoutTestMode(true, &nnet);
+    CollapseModel(CollapseModelConfig(), &nnet);
+
+    int32 num_pruned = PruneNnet(name_pattern, keep, group_size, &nnet);
+    if (num_pruned == 0)
+      KALDI_WARN << "No components were pruned (check --name?)";
+    else
+      KALDI_LOG << "Pruned " << num_pruned << " components.";
+
+    if (raw) {
+      WriteKaldiObject(nnet, nnet_wxfilename, binary_write);
+    } else {
+      am_nnet.SetContext();
+      Output ko(nnet_wxfilename, binary_write);
+      trans_model.Write(ko.Stream(), binary_write);
+      am_nnet.Write(ko.Stream(), binary_write);
+    }
+    KALDI_LOG << "Wrote pruned neural net from " << nnet_rxfilename
+              << " to " << nnet_wxfilename;
+    return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what() << '\n';
+    return -1;
+  }
+}
@@ -0,0 +1,110 @@
+// nnet3bin/nnet3-am-quantize.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "hmm/transition-model.h"
+#include "nnet3/am-nnet-simple.h"
+#include "nnet3/nnet-utils.h"
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    using namespace kaldi::nnet3;
+    typedef kaldi::int32 int32;
+
+    const char *usage =
+        "Prepare an nnet3 acoustic model for test and quantize its affine,\n"
+        "linear and TDNN components to 8-bit integer weights (see\n"
+        "nnet3/nnet-quantized-component.h).  The output model can be used\n"
+        "in place of the input one by the decoding programs, e.g.\n"
+        "nnet3-latgen-faster or online2-wav-nnet3-latgen-faster, but can't be\n"
+        "trained.  The int8 computation is only used on CPU when Kaldi was\n"
+        "compiled with MKL; otherwise the quantized weights are used in\n"
+        "floating point.\n"
+        "\n"
+        "Usage:  nnet3-am-quantize [options] <model-in> <model-out>\n"
+        "e.g.:\n"
+        " nnet3-am-quantize final.mdl final_int8.mdl\n"
+        " nnet3-am-quantize --name='tdnn*' final.mdl final_int8.mdl\n";
+
+    bool binary_write = true,
+        raw = false;
+    std::string name_pattern = "*";
+
+    ParseOptions po(usage);
+    po.Register("binary", &binary_write, "Write output in binary mode");
+    po.Register("raw", &raw, "If true, read and write 'raw' neural nets "
+                "(without transition model and priors), as nnet3-copy does.");
+    po.Register("name", &name_pattern, "Only quantize the components whose "
+                "names match this pattern (in which '*' matches any "
+                "sequence of characters).  E.g. you may not want to quantize "
+                "the final layer.");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 2) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string nnet_rxfilename = po.GetArg(1),
+        nnet_wxfilename = po.GetArg(2);
+
+    TransitionModel trans_model;
+    AmNnetSimple am_nnet;
+    Nnet raw_nnet;
+    if (raw) {
+      ReadKaldiObject(nnet_rxfilename, &raw_nnet);
+    } else {
+      bool binary;
+      Input ki(nnet_rxfilename, &binary);
+      trans_model.Read(ki.Stream(), binary);
+      am_nnet.Read(ki.Stream(), binary);
+    }
+    Nnet &nnet = (raw ? raw_nnet : am_nnet.GetNnet());
+
+    // Collapse batch-norm, dropout etc. into the affine components before
+    // quantizing them.
+    SetBatchnormTestMode(true, &nnet);
+    SetDropoutTestMode(true, &nnet);
+    CollapseModel(CollapseModelConfig(), &nnet);
+
+    int32 num_quantized = QuantizeNnet(name_pattern, &nnet);
+    if (num_quantized == 0)
+      KALDI_WARN << "No components were quantized (check --name?)";
+    else
+      KALDI_LOG << "Quantized " << num_quantized << " components.";
+
+    if (raw) {
+      WriteKaldiObject(nnet, nnet_wxfilename, binary_write);
+    } else {
+      am_nnet.SetContext();
+      Output ko(nnet_wxfilename, binary_write);
+      trans_model.Write(ko.Stream(), binary_write);
+      am_nnet.Write(ko.Stream(), binary_write);
+    }
+    KALDI_LOG << "Wrote quantized neural net from " << nnet_rxfilename
+              << " to " << nnet_wxfilename;
+    return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what() << '\n';
+    return -1;
+  }
+}
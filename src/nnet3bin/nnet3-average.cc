@@ -17,6 +17,9 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <mutex>
+#include <thread>
+
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
 #include "hmm/transition-model.h"
@@ -51,21 +54,22 @@ void GetWeights(const std::string &weights_str,
   }
 }
 
-// This job is run in a spawned thread; it reads a subset of models with
-// specified weights.  Sets *success to 1 for success and 0 for failure.  (We
+// This job is run in a spawned thread; it reads a subset of models and adds
+// them, with the specified weights, to the shared sum 'nnet_sum', which is
+// guarded by 'mutex'.  Sets *success to 1 for success and 0 for failure.  (We
 // don't use bool because of the weird implementation of std::vector<bool>).
 void ReadModels(std::vector<std::pair<std::string, BaseFloat> > models_and_weights,
-                nnet3::Nnet *output_nnet,
+                std::mutex *mutex,
+                nnet3::NnetSum *nnet_sum,
                 int32 *success) {
   using namespace nnet3;
   try {
     int32 n = models_and_weights.size();
-    ReadKaldiObject(models_and_weights[0].first, output_nnet);
-    ScaleNnet(models_and_weights[0].second, output_nnet);
-    for (int32 i = 1; i < n; i++) {
+    for (int32 i = 0; i < n; i++) {
       Nnet nnet;
       ReadKaldiObject(models_and_weights[i].first, &nnet);
-      AddNnet(nnet, models_and_weights[i].second, output_nnet);
+      std::lock_guard<std::mutex> lock(*mutex);
+      nnet_sum->Add(nnet, models_and_weights[i].second);
     }
     *success = 1;
   } catch (...) {
@@ -85,6 +89,8 @@ int main(int argc, char *argv[]) {
 
     const char *usage =
         "This program averages the parameters over a number of 'raw' nnet3 neural nets.\n"
+        "The models are read in parallel by --num-threads threads, and the\n"
+        "parameters are summed in double precision.\n"
         "\n"
         "Usage:  nnet3-average [options] <model1> <model2> ... <modelN> <model-out>\n"
         "\n"
@@ -100,7 +106,7 @@ int main(int argc, char *argv[]) {
     po.Register("weights", &weights_str, "Colon-separated list of weights, one "
                 "for each input model.  These will be normalized to sum to one.");
     po.Register("num-threads", &num_threads, "Number of threads to read the "
-                "models (will be set automatically if not set.");
+                "models (will be set automatically if not set).");
 
     po.Read(argc, argv);
 
@@ -115,51 +121,59 @@ int main(int argc, char *argv[]) {
 
     int32 num_inputs = po.NumArgs() - 1;
 
-    if (num_threads <= 0) {
-      // Default logic for selecting the number of threads.
-      if (num_inputs > 10) num_threads = 3;
-      else if (num_inputs > 5) num_threads = 2;
-      else num_threads = 1;
-    }
-
-    if (num_threads > 1 && num_threads * 2 > num_inputs) {
-      num_threads = num_inputs / 2;
-    }
+    // Each thread only holds the model it is reading, so we can use more
+    // threads than we used to; the first model is read by this thread.
+    if (num_threads <= 0)
+      num_threads = 8;
+    num_threads = std::max(1, std::min(num_threads, num_inputs - 1));
 
     std::vector<BaseFloat> model_weights;
     GetWeights(weights_str, num_inputs, &model_weights);
 
-    std::vector<Nnet> nnets(num_threads);
-    std::vector<int32> return_statuses(num_threads);
+    // The first model is added first, so it decides the structure and the
+    // output does not depend on the order in which the threads finish.
+    NnetSum nnet_sum;
+    {
+      Nnet nnet;
+      ReadKaldiObject(first_nnet_rxfilename, &nnet);
+      nnet_sum.Add(nnet, model_weights[0]);
+    }
+    std::mutex mutex;
 
-    std::vector<std::thread*> threads(num_threads);
+    std::vector<int32> return_statuses(num_threads, 1);
+    std::vector<std::thread*> threads(num_threads, NULL);
 
     for (int32 thread_id = 0; thread_id < num_threads; thread_id++) {
       std::vector<std::pair<std::string, BaseFloat> > this_models_and_weights;
-      for (int32 j = 1 + thread_id; j < po.NumArgs(); j += num_threads) {
+      for (int32 j = 2 + thread_id; j < po.NumArgs(); j += num_threads) {
         this_models_and_weights.push_back(std::pair<std::string, BaseFloat>(
             po.GetArg(j), model_weights[j - 1]));
       }
+      if (this_models_and_weights.empty())
+        continue;
       threads[thread_id] = new std::thread(ReadModels, this_models_and_weights,
-                                           &(nnets[thread_id]),
+                                           &mutex, &nnet_sum,
                                            &(return_statuses[thread_id]));
     }
 
     bool success = true;
     for (int32 thread_id = 0; thread_id < num_threads; thread_id++) {
-      threads[thread_id]->join();
-      delete threads[thread_id];
+      if (threads[thread_id] != NULL) {
+        threads[thread_id]->join();
+        delete threads[thread_id];
+      }
       if (!return_statuses[thread_id])
         success = false;
-      if (success && thread_id > 0)
-        AddNnet(nnets[thread_id], 1.0, &(nnets[0]));
     }
 
     if (!success) {
       KALDI_ERR << "Error detected in a model-reading thread.";
     }
 
-    WriteKaldiObject(nnets[0], nnet_wxfilename, binary_write);
+    // The weights were normalized to sum to one.
+    Nnet nnet_avg;
+    nnet_sum.GetSum(false, &nnet_avg);
+    WriteKaldiObject(nnet_avg, nnet_wxfilename, binary_write);
 
     KALDI_LOG << "Averaged parameters of " << num_inputs
               << " neural nets, and wrote to " << nnet_wxfilename;
@@ -18,6 +18,8 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <thread>
+
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
 #include "nnet3/nnet-utils.h"
@@ -61,13 +63,16 @@ double ComputeObjf(bool batchnorm_test_mode, bool dropout_test_mode,
   }
 }
 
-// Updates moving average over num_models nnets, given the average over
-// previous (num_models - 1) nnets, and the new nnet.
-void UpdateNnetMovingAverage(int32 num_models,
-    const Nnet &nnet, Nnet *moving_average_nnet) {
-  KALDI_ASSERT(NumParameters(nnet) == NumParameters(*moving_average_nnet));
-  ScaleNnet((num_models - 1.0) / num_models, moving_average_nnet);
-  AddNnet(nnet, 1.0 / num_models, moving_average_nnet);
+// This is run in a spawned thread, so that the next model is read while the
+// objective function is evaluated.  Sets *success to 1 for success and 0 for
+// failure.
+void ReadNnet(std::string nnet_rxfilename, Nnet *nnet, int32 *success) {
+  try {
+    ReadKaldiObject(nnet_rxfilename, nnet);
+    *success = 1;
+  } catch (...) {
+    *success = 0;
+  }
 }
 
 }
@@ -123,6 +128,8 @@ int main(int argc, char *argv[]) {
 
 #if HAVE_CUDA==1
     CuDevice::Instantiate().SelectGpuId(use_gpu);
+    // The models are read on another thread (see ReadNnet()).
+    CuDevice::Instantiate().AllowMultithreading();
 #endif
 
     std::string
@@ -149,6 +156,11 @@ int main(int argc, char *argv[]) {
       KALDI_ASSERT(!egs.empty());
     }
 
+    // The moving average is the average of the models added to this, whose
+    // parameters are summed in double precision.
+    NnetSum nnet_sum;
+    nnet_sum.Add(nnet, 1.0);
+
     // first evaluates the objective using the last model.
     int32 best_num_to_combine = 1;
     double
@@ -162,13 +174,29 @@ int main(int argc, char *argv[]) {
     // num_to_add models to the moving average.
     int32 num_to_add = (num_nnets + max_objective_evaluations - 1) /
                        max_objective_evaluations;
+    // The next model is read in the background.
+    Nnet next_nnet;
+    int32 read_success = 1;
+    std::thread *reader = NULL;
+    if (num_nnets > 1)
+      reader = new std::thread(ReadNnet, po.GetArg(2), &next_nnet,
+                               &read_success);
     for (int32 n = 1; n < num_nnets; n++) {
-      ReadKaldiObject(po.GetArg(1 + n), &nnet);
+      reader->join();
+      delete reader;
+      reader = NULL;
+      if (!read_success)
+        KALDI_ERR << "Error reading the model " << po.GetArg(1 + n);
+      nnet.Swap(&next_nnet);
+      if (n + 1 < num_nnets)
+        reader = new std::thread(ReadNnet, po.GetArg(n + 2), &next_nnet,
+                                 &read_success);
       // updates the moving average
-      UpdateNnetMovingAverage(n + 1, nnet, &moving_average_nnet);
+      nnet_sum.Add(nnet, 1.0);
       // evaluates the objective everytime after adding num_to_add model or
       // all the models to the moving average.
       if ((n - 1) % num_to_add == num_to_add - 1 || n == num_nnets - 1) {
+        nnet_sum.GetSum(true, &moving_average_nnet);
         double objf = ComputeObjf(batchnorm_test_mode, dropout_test_mode,
             egs, moving_average_nnet, &prob_computer);
         KALDI_LOG << "Combining last " << n + 1
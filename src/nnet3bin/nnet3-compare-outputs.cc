@@ -0,0 +1,239 @@
+// nnet3bin/nnet3-compare-outputs.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "hmm/transition-model.h"
+#include "nnet3/nnet-am-decodable-simple.h"
+#include "nnet3/nnet-utils.h"
+
+
+namespace kaldi {
+namespace nnet3 {
+
+// Reads a raw nnet, or (if use_priors == true) the nnet and the priors from a
+// .mdl file, and prepares the nnet for test mode in the same way as
+// nnet3-compute.
+void ReadNnetForTest(const std::string &rxfilename, bool use_priors,
+                     Nnet *nnet, Vector<BaseFloat> *priors) {
+  if (use_priors) {
+    bool binary;
+    TransitionModel trans_model;
+    AmNnetSimple am_nnet;
+    Input ki(rxfilename, &binary);
+    trans_model.Read(ki.Stream(), binary);
+    am_nnet.Read(ki.Stream(), binary);
+    *nnet = am_nnet.GetNnet();
+    *priors = am_nnet.Priors();
+  } else {
+    ReadKaldiObject(rxfilename, nnet);
+  }
+  SetBatchnormTestMode(true, nnet);
+  SetDropoutTestMode(true, nnet);
+  CollapseModel(CollapseModelConfig(), nnet);
+}
+
+} // namespace nnet3
+} // namespace kaldi
+
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    using namespace kaldi::nnet3;
+    typedef kaldi::int32 int32;
+    typedef kaldi::int64 int64;
+
+    const char *usage =
+        "Propagate the features through two neural networks with the same\n"
+        "inputs and outputs, and print statistics of the difference between\n"
+        "their outputs.  This is intended for checking models that have been\n"
+        "converted for faster inference (e.g. by the 'apply-svd' edit of\n"
+        "nnet3-copy or nnet3-am-copy, or by nnet3-am-quantize), against the\n"
+        "original model.  The first model is treated as the reference.\n"
+        "\n"
+        "Usage: nnet3-compare-outputs [options] <nnet1-in> <nnet2-in> "
+        "<features-rspecifier>\n"
+        " e.g.: nnet3-copy --edits='apply-svd name=* energy-threshold=0.9' \\\n"
+        "         final.raw svd.raw\n"
+        "       nnet3-compare-outputs final.raw svd.raw scp:feats.scp\n"
+        "See also: nnet3-compute, nnet3-copy, nnet3-am-copy\n";
+
+    ParseOptions po(usage);
+
+    NnetSimpleComputationOptions opts;
+    opts.acoustic_scale = 1.0; // by default do no scaling.
+
+    bool use_priors = false;
+    std::string use_gpu = "no";
+
+    std::string ivector_rspecifier,
+                online_ivector_rspecifier,
+                utt2spk_rspecifier;
+    int32 online_ivector_period = 0;
+    opts.Register(&po);
+
+    po.Register("ivectors", &ivector_rspecifier, "Rspecifier for "
+                "iVectors as vectors (i.e. not estimated online); per utterance "
+                "by default, or per speaker if you provide the --utt2spk option.");
+    po.Register("utt2spk", &utt2spk_rspecifier, "Rspecifier for "
+                "utt2spk option used to get ivectors per speaker");
+    po.Register("online-ivectors", &online_ivector_rspecifier, "Rspecifier for "
+                "iVectors estimated online, as matrices.  If you supply this,"
+                " you must set the --online-ivector-period option.");
+    po.Register("online-ivector-period", &online_ivector_period, "Number of frames "
+                "between iVectors in matrices supplied to the --online-ivectors "
+                "option");
+    po.Register("use-gpu", &use_gpu,
+                "yes|no|optional|wait, only has effect if compiled with CUDA");
+    po.Register("use-priors", &use_priors, "If true, subtract the logs of the "
+                "priors stored with the models (in this case, .mdl files are "
+                "expected as input), so that the pseudo-likelihoods used in "
+                "decoding are compared.");
+
+#if HAVE_CUDA==1
+    CuDevice::RegisterDeviceOptions(&po);
+#endif
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 3) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+#if HAVE_CUDA==1
+    CuDevice::Instantiate().SelectGpuId(use_gpu);
+#endif
+
+    std::string nnet1_rxfilename = po.GetArg(1),
+                nnet2_rxfilename = po.GetArg(2),
+                feature_rspecifier = po.GetArg(3);
+
+    Nnet nnet1, nnet2;
+    Vector<BaseFloat> priors1, priors2;
+    ReadNnetForTest(nnet1_rxfilename, use_priors, &nnet1, &priors1);
+    ReadNnetForTest(nnet2_rxfilename, use_priors, &nnet2, &priors2);
+    if (nnet1.OutputDim("output") != nnet2.OutputDim("output") ||
+        nnet1.InputDim("input") != nnet2.InputDim("input"))
+      KALDI_ERR << "The two models have different input or output dimensions.";
+
+    RandomAccessBaseFloatMatrixReader online_ivector_reader(
+        online_ivector_rspecifier);
+    RandomAccessBaseFloatVectorReaderMapped ivector_reader(
+        ivector_rspecifier, utt2spk_rspecifier);
+
+    CachingOptimizingCompiler compiler1(nnet1, opts.optimize_config),
+        compiler2(nnet2, opts.optimize_config);
+
+    int32 num_success = 0, num_fail = 0;
+    int64 frame_count = 0, num_same_best = 0;
+    // tot_abs_diff is summed over all output elements; tot_sqdiff and
+    // tot_sq (the sum of squares of the first model's outputs) are for
+    // the relative difference.
+    double tot_abs_diff = 0.0, tot_sqdiff = 0.0, tot_sq = 0.0;
+    BaseFloat max_abs_diff = 0.0;
+
+    SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
+
+    for (; !feature_reader.Done(); feature_reader.Next()) {
+      std::string utt = feature_reader.Key();
+      const Matrix<BaseFloat> &features (feature_reader.Value());
+      if (features.NumRows() == 0) {
+        KALDI_WARN << "Zero-length utterance: " << utt;
+        num_fail++;
+        continue;
+      }
+      const Matrix<BaseFloat> *online_ivectors = NULL;
+      const Vector<BaseFloat> *ivector = NULL;
+      if (!ivector_rspecifier.empty()) {
+        if (!ivector_reader.HasKey(utt)) {
+          KALDI_WARN << "No iVector available for utterance " << utt;
+          num_fail++;
+          continue;
+        } else {
+          ivector = &ivector_reader.Value(utt);
+        }
+      }
+      if (!online_ivector_rspecifier.empty()) {
+        if (!online_ivector_reader.HasKey(utt)) {
+          KALDI_WARN << "No online iVector available for utterance " << utt;
+          num_fail++;
+          continue;
+        } else {
+          online_ivectors = &online_ivector_reader.Value(utt);
+        }
+      }
+
+      DecodableNnetSimple computer1(
+          opts, nnet1, priors1, features, &compiler1,
+          ivector, online_ivectors, online_ivector_period),
+          computer2(
+          opts, nnet2, priors2, features, &compiler2,
+          ivector, online_ivectors, online_ivector_period);
+
+      int32 num_frames = computer1.NumFrames();
+      KALDI_ASSERT(computer2.NumFrames() == num_frames);
+      Vector<BaseFloat> output1(computer1.OutputDim()),
+          output2(computer2.OutputDim());
+      double utt_abs_diff = 0.0;
+      for (int32 t = 0; t < num_frames; t++) {
+        computer1.GetOutputForFrame(t, &output1);
+        computer2.GetOutputForFrame(t, &output2);
+        int32 best1, best2;
+        output1.Max(&best1);
+        output2.Max(&best2);
+        if (best1 == best2)
+          num_same_best++;
+        tot_sq += VecVec(output1, output1);
+        output2.AddVec(-1.0, output1);
+        tot_sqdiff += VecVec(output2, output2);
+        utt_abs_diff += output2.Norm(1.0);
+        max_abs_diff = std::max(max_abs_diff,
+                                std::max(output2.Max(), -output2.Min()));
+      }
+      KALDI_VLOG(1) << "Utterance " << utt << ": average absolute difference "
+                    << (utt_abs_diff / (num_frames * output1.Dim()));
+      tot_abs_diff += utt_abs_diff;
+      frame_count += num_frames;
+      num_success++;
+    }
+
+    if (frame_count != 0) {
+      int32 output_dim = nnet1.OutputDim("output");
+      KALDI_LOG << "Over " << frame_count << " frames, the average absolute "
+                << "difference of the outputs is "
+                << (tot_abs_diff / (frame_count * output_dim))
+                << ", the maximum is " << max_abs_diff
+                << ", and the relative difference ||y2-y1||/||y1|| is "
+                << std::sqrt(tot_sqdiff / std::max(tot_sq, 1.0e-20));
+      KALDI_LOG << "The best-scoring output agrees on "
+                << (100.0 * num_same_best / frame_count) << "% of frames.";
+    }
+    KALDI_LOG << "Done " << num_success << " utterances, failed for "
+              << num_fail;
+
+    if (num_success != 0) return 0;
+    else return 1;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
@@ -52,6 +52,7 @@ int main(int argc, char *argv[]) {
 
     bool apply_exp = false, use_priors = false;
     std::string use_gpu = "yes";
+    std::string profile_wxfilename;
 
     std::string ivector_rspecifier,
                 online_ivector_rspecifier,
@@ -77,6 +78,9 @@ int main(int argc, char *argv[]) {
     po.Register("use-priors", &use_priors, "If true, subtract the logs of the "
                 "priors stored with the model (in this case, "
                 "a .mdl file is expected as input).");
+    po.Register("profile-json", &profile_wxfilename, "If set, profile the "
+                "neural net computation (as --computation.profile=true) and "
+                "write the profile to this file as JSON.");
 
 #if HAVE_CUDA==1
     CuDevice::RegisterDeviceOptions(&po);
@@ -88,6 +92,8 @@ int main(int argc, char *argv[]) {
       po.PrintUsage();
       exit(1);
     }
+    if (!profile_wxfilename.empty())
+      opts.compute_config.profile = true;
 
 #if HAVE_CUDA==1
     CuDevice::Instantiate().SelectGpuId(use_gpu);
@@ -185,6 +191,15 @@ int main(int argc, char *argv[]) {
 #if HAVE_CUDA==1
     CuDevice::Instantiate().PrintProfile();
 #endif
+    if (opts.compute_config.profile) {
+      std::ostringstream os;
+      NnetComputeProfile::Global().Print(os);
+      KALDI_LOG << "Profile of the neural net computation:\n" << os.str();
+      if (!profile_wxfilename.empty()) {
+        Output ko(profile_wxfilename, false);
+        NnetComputeProfile::Global().WriteJson(ko.Stream());
+      }
+    }
     double elapsed = timer.Elapsed();
     KALDI_LOG << "Time taken "<< elapsed
               << "s: real-time factor assuming 100 frames/sec is "
@@ -45,6 +45,7 @@ int main(int argc, char *argv[]) {
     std::string nnet_config, edits_config, edits_str;
     BaseFloat scale = 1.0;
     bool prepare_for_test = false;
+    bool write_param_blob = false;
 
     ParseOptions po(usage);
     po.Register("binary", &binary_write, "Write output in binary mode");
@@ -70,12 +71,18 @@ int main(int argc, char *argv[]) {
                 "slightly.  Involves setting test mode in dropout and batch-norm "
                 "components, and calling CollapseModel() which may remove some "
                 "components.");
+    po.Register("write-param-blob", &write_param_blob,
+                "If true, write the parameters of all the components as one "
+                "block at the start of the nnet, which is faster to read "
+                "(requires --binary=true).");
     po.Read(argc, argv);
 
     if (po.NumArgs() != 2) {
       po.PrintUsage();
       exit(1);
     }
+    if (write_param_blob && !binary_write)
+      KALDI_ERR << "--write-param-blob=true requires --binary=true";
 
     std::string raw_nnet_rxfilename = po.GetArg(1),
                 raw_nnet_wxfilename = po.GetArg(2);
@@ -110,7 +117,12 @@ int main(int argc, char *argv[]) {
       SetDropoutTestMode(true, &nnet);
       CollapseModel(CollapseModelConfig(), &nnet);
     }
-    WriteKaldiObject(nnet, raw_nnet_wxfilename, binary_write);
+    if (write_param_blob) {
+      Output ko(raw_nnet_wxfilename, binary_write);
+      nnet.WriteWithParamBlob(ko.Stream());
+    } else {
+      WriteKaldiObject(nnet, raw_nnet_wxfilename, binary_write);
+    }
     KALDI_LOG << "Copied raw neural net from " << raw_nnet_rxfilename
               << " to " << raw_nnet_wxfilename;
 
@@ -33,7 +33,7 @@ namespace nnet3 {
 static bool ProcessFile(const GeneralMatrix &feats,
                         const MatrixBase<BaseFloat> *ivector_feats,
                         int32 ivector_period,
-                        const Posterior &pdf_post,
+                        const CompactPosterior &pdf_post,
                         const std::string &utt_id,
                         bool compress,
                         int32 num_pdfs,
@@ -42,7 +42,7 @@ static bool ProcessFile(const GeneralMatrix &feats,
                         NnetExampleWriter *example_writer) {
   int32 num_input_frames = feats.NumRows();
   if (!utt_splitter->LengthsMatch(utt_id, num_input_frames,
-                                  static_cast<int32>(pdf_post.size()),
+                                  pdf_post.NumFrames(),
                                   length_tolerance))
     return false;  // LengthsMatch() will have printed a warning.
 
@@ -103,23 +103,21 @@ static bool ProcessFile(const GeneralMatrix &feats,
     int32 start_frame_subsampled = chunk.first_frame / frame_subsampling_factor,
         num_frames_subsampled = chunk.num_frames / frame_subsampling_factor;
 
-    Posterior labels(num_frames_subsampled);
+    SparseMatrix<BaseFloat> labels;
 
     // TODO: it may be that using these weights is not actually helpful (with
     // chain training, it was not), and that setting them all to 1 is better.
     // We could add a boolean option to this program to control that; but I
     // don't want to add such an option if experiments show that it is not
     // helpful.
-    for (int32 i = 0; i < num_frames_subsampled; i++) {
-      int32 t = i + start_frame_subsampled;
-      if (t < pdf_post.size())
-        labels[i] = pdf_post[t];
-      for (std::vector<std::pair<int32, BaseFloat> >::iterator
-               iter = labels[i].begin(); iter != labels[i].end(); ++iter)
-        iter->second *= chunk.output_weights[i];
-    }
+    CompactPosteriorToSparseMatrix(pdf_post, num_pdfs, start_frame_subsampled,
+                                   num_frames_subsampled,
+                                   &chunk.output_weights, &labels);
+    GeneralMatrix output_labels;
+    output_labels.SwapSparseMatrix(&labels);
 
-    eg.io.push_back(NnetIo("output", num_pdfs, 0, labels, frame_subsampling_factor));
+    eg.io.push_back(NnetIo("output", 0, output_labels,
+                           frame_subsampling_factor));
 
     if (compress)
       eg.Compress();
@@ -220,7 +218,7 @@ int main(int argc, char *argv[]) {
     // and it retains the type.  This way, we can generate parts of
     // the feature matrices without uncompressing and re-compressing.
     SequentialGeneralMatrixReader feat_reader(feature_rspecifier);
-    RandomAccessPosteriorReader pdf_post_reader(pdf_post_rspecifier);
+    RandomAccessCompactPosteriorReader pdf_post_reader(pdf_post_rspecifier);
     NnetExampleWriter example_writer(examples_wspecifier);
     RandomAccessBaseFloatMatrixReader online_ivector_reader(
         online_ivector_rspecifier);
@@ -234,7 +232,7 @@ int main(int argc, char *argv[]) {
         KALDI_WARN << "No pdf-level posterior for key " << key;
         num_err++;
       } else {
-        const Posterior &pdf_post = pdf_post_reader.Value(key);
+        const CompactPosterior &pdf_post = pdf_post_reader.Value(key);
         const Matrix<BaseFloat> *online_ivector_feats = NULL;
         if (!online_ivector_rspecifier.empty()) {
           if (!online_ivector_reader.HasKey(key)) {
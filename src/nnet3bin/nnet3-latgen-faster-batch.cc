@@ -107,6 +107,8 @@ int main(int argc, char *argv[]) {
                 "is always 1; this is optimized for use with the GPU.");
     po.Register("use-gpu", &use_gpu,
                 "yes|no|optional|wait, only has effect if compiled with CUDA");
+    RegisterCompactLatticeWriteOptions(&po);
+    RegisterHugePageOptions(&po);
 
 #if HAVE_CUDA==1
     CuDevice::RegisterDeviceOptions(&po);
@@ -139,6 +141,8 @@ int main(int argc, char *argv[]) {
       SetBatchnormTestMode(true, &(am_nnet.GetNnet()));
       SetDropoutTestMode(true, &(am_nnet.GetNnet()));
       CollapseModel(CollapseModelConfig(), &(am_nnet.GetNnet()));
+      // Only "output" is used in decoding; this removes e.g. "output-xent".
+      KeepOnlyOutputs("output", &(am_nnet.GetNnet()));
     }
 
     bool determinize = decoder_opts.determinize_lattice;
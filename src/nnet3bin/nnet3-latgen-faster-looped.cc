@@ -100,6 +100,8 @@ int main(int argc, char *argv[]) {
       SetBatchnormTestMode(true, &(am_nnet.GetNnet()));
       SetDropoutTestMode(true, &(am_nnet.GetNnet()));
       CollapseModel(CollapseModelConfig(), &(am_nnet.GetNnet()));
+      // Only "output" is used in decoding; this removes e.g. "output-xent".
+      KeepOnlyOutputs("output", &(am_nnet.GetNnet()));
     }
 
     bool determinize = config.determinize_lattice;
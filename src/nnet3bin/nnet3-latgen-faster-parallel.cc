@@ -19,6 +19,8 @@
 // limitations under the License.
 
 
+#include <algorithm>
+
 #include "base/timer.h"
 #include "base/kaldi-common.h"
 #include "decoder/decoder-wrappers.h"
@@ -30,7 +32,24 @@
 #include "tree/context-dep.h"
 #include "util/common-utils.h"
 
+namespace kaldi {
+namespace nnet3 {
+
+void ReadModel(const std::string &model_in_filename,
+               TransitionModel *trans_model, AmNnetSimple *am_nnet) {
+  bool binary;
+  Input ki(model_in_filename, &binary);
+  trans_model->Read(ki.Stream(), binary);
+  am_nnet->Read(ki.Stream(), binary);
+  SetBatchnormTestMode(true, &(am_nnet->GetNnet()));
+  SetDropoutTestMode(true, &(am_nnet->GetNnet()));
+  CollapseModel(CollapseModelConfig(), &(am_nnet->GetNnet()));
+  // Only "output" is used in decoding; this removes e.g. "output-xent".
+  KeepOnlyOutputs("output", &(am_nnet->GetNnet()));
+}
 
+}  // namespace nnet3
+}  // namespace kaldi
 
 int main(int argc, char *argv[]) {
   // note: making this program work with GPUs is as simple as initializing the
@@ -49,6 +68,9 @@ int main(int argc, char *argv[]) {
         "multiple decoding threads (using a shared decoding graph.)\n"
         "Usage: nnet3-latgen-faster-parallel [options] <nnet-in> <fst-in|fsts-rspecifier> <features-rspecifier>"
         " <lattice-wspecifier> [ <words-wspecifier> [<alignments-wspecifier>] ]\n"
+        "With --thread-pool-numa=true, there is a copy of the model and the\n"
+        "graph in the memory of each NUMA node, and each utterance is decoded\n"
+        "by the threads of the node whose copy it uses.\n"
         "See also: nnet3-latgen-faster-batch (which supports GPUs)\n";
     ParseOptions po(usage);
 
@@ -64,6 +86,7 @@ int main(int argc, char *argv[]) {
         utt2spk_rspecifier;
     int32 online_ivector_period = 0;
     sequencer_config.Register(&po);
+    RegisterGlobalThreadPoolOptions(&po);
     config.Register(&po);
     decodable_opts.Register(&po);
     po.Register("word-symbol-table", &word_syms_filename,
@@ -79,6 +102,7 @@ int main(int argc, char *argv[]) {
     po.Register("online-ivector-period", &online_ivector_period, "Number of frames "
                 "between iVectors in matrices supplied to the --online-ivectors "
                 "option");
+    RegisterCompactLatticeWriteOptions(&po);
 
     po.Read(argc, argv);
 
@@ -94,18 +118,31 @@ int main(int argc, char *argv[]) {
         words_wspecifier = po.GetOptArg(5),
         alignment_wspecifier = po.GetOptArg(6);
 
-    TaskSequencer<DecodeUtteranceLatticeFasterClass> sequencer(sequencer_config);
+    TaskSequencer<DecodeUtteranceLatticeFasterClass> sequencer(
+        sequencer_config, &GlobalThreadPool());
+    // One copy of the neural net (and below, of the graph) for each NUMA node
+    // of the pool, each made by a thread on its node so that it is in the
+    // node's memory; there is just one if the pool is not NUMA-aware.  The
+    // copies are copied from the first one, so the input may be a pipe.  The
+    // transition model is small, so it is shared.
+    int32 num_nodes = GlobalThreadPool().NumNumaNodes();
     TransitionModel trans_model;
-    AmNnetSimple am_nnet;
-    {
-      bool binary;
-      Input ki(model_in_filename, &binary);
-      trans_model.Read(ki.Stream(), binary);
-      am_nnet.Read(ki.Stream(), binary);
-      SetBatchnormTestMode(true, &(am_nnet.GetNnet()));
-      SetDropoutTestMode(true, &(am_nnet.GetNnet()));
-      CollapseModel(CollapseModelConfig(), &(am_nnet.GetNnet()));
-    }
+    std::vector<std::unique_ptr<AmNnetSimple> > am_nnets(num_nodes);
+    for (int32 node = 0; node < num_nodes; node++)
+      RunOnNumaNode(node, [&]() {
+          if (node == 0) {
+            am_nnets[0].reset(new AmNnetSimple());
+            ReadModel(model_in_filename, &trans_model, am_nnets[0].get());
+          } else {
+            am_nnets[node].reset(new AmNnetSimple(*am_nnets[0]));
+          }
+        });
+    if (num_nodes > 1)
+      KALDI_LOG << "Read a copy of the model for each of " << num_nodes
+                << " NUMA nodes";
+    // The number of frames given to each node so far; each utterance goes to
+    // the node with the fewest.
+    std::vector<int64> node_frames(num_nodes, 0);
 
     bool determinize = config.determinize_lattice;
     CompactLatticeWriter compact_lattice_writer;
@@ -137,7 +174,14 @@ int main(int argc, char *argv[]) {
       SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
 
       // Input FST is just one FST, not a table of FSTs.
-      Fst<StdArc> *decode_fst = fst::ReadFstKaldiGeneric(fst_in_str);
+      std::vector<Fst<StdArc>*> decode_fsts(num_nodes);
+      for (int32 node = 0; node < num_nodes; node++)
+        RunOnNumaNode(node, [&]() {
+            if (node == 0)
+              decode_fsts[0] = fst::ReadFstKaldiGeneric(fst_in_str);
+            else  // A deep copy, unlike Copy().
+              decode_fsts[node] = new fst::ConstFst<StdArc>(*decode_fsts[0]);
+          });
       timer.Reset();
 
       {
@@ -170,12 +214,16 @@ int main(int argc, char *argv[]) {
             }
           }
 
+          int32 node = std::min_element(node_frames.begin(),
+                                        node_frames.end()) - node_frames.begin();
+          node_frames[node] += features.NumRows();
+
           LatticeFasterDecoder *decoder =
-              new LatticeFasterDecoder(*decode_fst, config);
+              new LatticeFasterDecoder(*decode_fsts[node], config);
 
           DecodableInterface *nnet_decodable = new
               DecodableAmNnetSimpleParallel(
-                  decodable_opts, trans_model, am_nnet,
+                  decodable_opts, trans_model, *am_nnets[node],
                   features, ivector, online_ivectors,
                   online_ivector_period);
 
@@ -187,12 +235,15 @@ int main(int argc, char *argv[]) {
                    &compact_lattice_writer, &lattice_writer,
                    &tot_like, &frame_count, &num_success, &num_fail, NULL);
 
-          sequencer.Run(task); // takes ownership of "task",
-                               // and will delete it when done.
+          // takes ownership of "task", and will delete it when done.  The longest
+          // utterances are started first, on the node of their copy of the
+          // model and graph.
+          sequencer.Run(task, features.NumRows(), node);
         }
       }
       sequencer.Wait(); // Waits for all tasks to be done.
-      delete decode_fst;
+      for (int32 node = 0; node < num_nodes; node++)
+        delete decode_fsts[node];
     } else { // We have different FSTs for different utterances.
       SequentialTableReader<fst::VectorFstHolder> fst_reader(fst_in_str);
       RandomAccessBaseFloatMatrixReader feature_reader(feature_rspecifier);
@@ -232,6 +283,10 @@ int main(int argc, char *argv[]) {
           }
         }
 
+        int32 node = std::min_element(node_frames.begin(),
+                                      node_frames.end()) - node_frames.begin();
+        node_frames[node] += features.NumRows();
+
         // the following constructor takes ownership of the FST pointer so that
         // it is deleted when 'decoder' is deleted.
         LatticeFasterDecoder *decoder =
@@ -239,7 +294,7 @@ int main(int argc, char *argv[]) {
 
         DecodableInterface *nnet_decodable = new
             DecodableAmNnetSimpleParallel(
-                decodable_opts, trans_model, am_nnet,
+                decodable_opts, trans_model, *am_nnets[node],
                 features, ivector, online_ivectors,
                 online_ivector_period);
 
@@ -251,8 +306,9 @@ int main(int argc, char *argv[]) {
                 &compact_lattice_writer, &lattice_writer,
                 &tot_like, &frame_count, &num_success, &num_fail, NULL);
 
-        sequencer.Run(task); // takes ownership of "task",
-        // and will delete it when done.
+        // takes ownership of "task", and will delete it when done.  The longest
+        // utterances are started first.
+        sequencer.Run(task, features.NumRows(), node);
       }
       sequencer.Wait(); // Waits for all tasks to be done.
     }
@@ -57,6 +57,7 @@ int main(int argc, char *argv[]) {
     std::string ivector_rspecifier,
         online_ivector_rspecifier,
         utt2spk_rspecifier;
+    std::string profile_wxfilename, loglikes_wspecifier;
     int32 online_ivector_period = 0;
     config.Register(&po);
     decodable_opts.Register(&po);
@@ -75,6 +76,16 @@ int main(int argc, char *argv[]) {
     po.Register("online-ivector-period", &online_ivector_period, "Number of frames "
                 "between iVectors in matrices supplied to the --online-ivectors "
                 "option");
+    po.Register("profile-json", &profile_wxfilename, "If set, profile the "
+                "neural net computation (as --computation.profile=true) and "
+                "write the profile to this file as JSON.");
+    po.Register("write-loglikes", &loglikes_wspecifier, "If set, also write "
+                "the pdf-level log-likelihoods (without the acoustic scale, "
+                "compressed) to this table, so that later passes can use "
+                "them, e.g. with lattice-rescore-mapped or "
+                "align-compiled-mapped, instead of running the network "
+                "again.");
+    RegisterCompactLatticeWriteOptions(&po);
 
     po.Read(argc, argv);
 
@@ -82,6 +93,8 @@ int main(int argc, char *argv[]) {
       po.PrintUsage();
       exit(1);
     }
+    if (!profile_wxfilename.empty())
+      decodable_opts.compute_config.profile = true;
 
     std::string model_in_filename = po.GetArg(1),
         fst_in_str = po.GetArg(2),
@@ -100,6 +113,8 @@ int main(int argc, char *argv[]) {
       SetBatchnormTestMode(true, &(am_nnet.GetNnet()));
       SetDropoutTestMode(true, &(am_nnet.GetNnet()));
       CollapseModel(CollapseModelConfig(), &(am_nnet.GetNnet()));
+      // Only "output" is used in decoding; this removes e.g. "output-xent".
+      KeepOnlyOutputs("output", &(am_nnet.GetNnet()));
     }
 
     bool determinize = config.determinize_lattice;
@@ -117,6 +132,7 @@ int main(int argc, char *argv[]) {
 
     Int32VectorWriter words_writer(words_wspecifier);
     Int32VectorWriter alignment_writer(alignment_wspecifier);
+    CompressedMatrixWriter loglikes_writer(loglikes_wspecifier);
 
     fst::SymbolTable *word_syms = NULL;
     if (word_syms_filename != "")
@@ -175,18 +191,28 @@ int main(int argc, char *argv[]) {
               decodable_opts, trans_model, am_nnet,
               features, ivector, online_ivectors,
               online_ivector_period, &compiler);
+          // If we write the log-likelihoods, we decode from the matrix they
+          // were written from, so the network is only run once.
+          DecodableInterface *matrix_decodable = NULL;
+          if (loglikes_writer.IsOpen())
+            matrix_decodable = WriteLogLikelihoods(
+                utt, trans_model, decodable_opts.acoustic_scale,
+                &nnet_decodable, &loglikes_writer);
+          DecodableInterface &decodable = (matrix_decodable != NULL ?
+                                           *matrix_decodable : nnet_decodable);
 
           double like;
           if (DecodeUtteranceLatticeFaster(
-                  decoder, nnet_decodable, trans_model, word_syms, utt,
+                  decoder, decodable, trans_model, word_syms, utt,
                   decodable_opts.acoustic_scale, determinize, allow_partial,
                   &alignment_writer, &words_writer, &compact_lattice_writer,
                   &lattice_writer,
                   &like)) {
             tot_like += like;
-            frame_count += nnet_decodable.NumFramesReady();
+            frame_count += decodable.NumFramesReady();
             num_success++;
           } else num_fail++;
+          delete matrix_decodable;
         }
       }
       delete decode_fst; // delete this only after decoder goes out of scope.
@@ -235,17 +261,25 @@ int main(int argc, char *argv[]) {
             decodable_opts, trans_model, am_nnet,
             features, ivector, online_ivectors,
             online_ivector_period, &compiler);
+        DecodableInterface *matrix_decodable = NULL;
+        if (loglikes_writer.IsOpen())
+          matrix_decodable = WriteLogLikelihoods(
+              utt, trans_model, decodable_opts.acoustic_scale,
+              &nnet_decodable, &loglikes_writer);
+        DecodableInterface &decodable = (matrix_decodable != NULL ?
+                                         *matrix_decodable : nnet_decodable);
 
         double like;
         if (DecodeUtteranceLatticeFaster(
-                decoder, nnet_decodable, trans_model, word_syms, utt,
+                decoder, decodable, trans_model, word_syms, utt,
                 decodable_opts.acoustic_scale, determinize, allow_partial,
                 &alignment_writer, &words_writer, &compact_lattice_writer,
                 &lattice_writer, &like)) {
           tot_like += like;
-          frame_count += nnet_decodable.NumFramesReady();
+          frame_count += decodable.NumFramesReady();
           num_success++;
         } else num_fail++;
+        delete matrix_decodable;
       }
     }
 
@@ -261,6 +295,15 @@ int main(int argc, char *argv[]) {
     KALDI_LOG << "Overall log-likelihood per frame is "
               << (tot_like / frame_count) << " over "
               << frame_count << " frames.";
+    if (decodable_opts.compute_config.profile) {
+      std::ostringstream os;
+      NnetComputeProfile::Global().Print(os);
+      KALDI_LOG << "Profile of the neural net computation:\n" << os.str();
+      if (!profile_wxfilename.empty()) {
+        Output ko(profile_wxfilename, false);
+        NnetComputeProfile::Global().WriteJson(ko.Stream());
+      }
+    }
 
     delete word_syms;
     if (num_success != 0) return 0;
@@ -60,6 +60,8 @@ int main(int argc, char *argv[]) {
         online_ivector_rspecifier,
         utt2spk_rspecifier;
     int32 online_ivector_period = 0;
+    std::string utt_fsts_rspecifier;
+    int32 utt_nonterminal = -1, utt_fst_cache_size = 1000;
     config.Register(&po);
     decodable_opts.Register(&po);
     po.Register("word-symbol-table", &word_syms_filename,
@@ -77,6 +79,16 @@ int main(int argc, char *argv[]) {
     po.Register("online-ivector-period", &online_ivector_period, "Number of frames "
                 "between iVectors in matrices supplied to the --online-ivectors "
                 "option");
+    po.Register("utt-fsts", &utt_fsts_rspecifier, "Rspecifier for "
+                "per-utterance FSTs for the nonterminal given by "
+                "--utt-nonterminal (e.g. a contact list), prepared by "
+                "make-grammar-fst; they replace or add to the FSTs in the "
+                "grammar for the utterances that have one.");
+    po.Register("utt-nonterminal", &utt_nonterminal, "Integer id in "
+                "phones.txt of the nonterminal (e.g. #nonterm:contact) that "
+                "the FSTs from --utt-fsts are for.");
+    po.Register("utt-fst-cache-size", &utt_fst_cache_size, "Maximum number "
+                "of distinct per-utterance FSTs to keep in memory.");
 
     po.Read(argc, argv);
 
@@ -102,6 +114,8 @@ int main(int argc, char *argv[]) {
       SetBatchnormTestMode(true, &(am_nnet.GetNnet()));
       SetDropoutTestMode(true, &(am_nnet.GetNnet()));
       CollapseModel(CollapseModelConfig(), &(am_nnet.GetNnet()));
+      // Only "output" is used in decoding; this removes e.g. "output-xent".
+      KeepOnlyOutputs("output", &(am_nnet.GetNnet()));
     }
 
     bool determinize = config.determinize_lattice;
@@ -138,6 +152,12 @@ int main(int argc, char *argv[]) {
 
     fst::GrammarFst fst;
     ReadKaldiObject(grammar_fst_rxfilename, &fst);
+
+    if (!utt_fsts_rspecifier.empty() && utt_nonterminal <= 0)
+      KALDI_ERR << "--utt-fsts requires --utt-nonterminal.";
+    RandomAccessTableReader<fst::VectorFstHolder> utt_fst_reader(
+        utt_fsts_rspecifier);
+    fst::GrammarSubFstCache utt_fst_cache(utt_fst_cache_size);
     timer.Reset();
 
     {
@@ -177,9 +197,24 @@ int main(int argc, char *argv[]) {
             features, ivector, online_ivectors,
             online_ivector_period, &compiler);
 
+        // If there is an FST for this utterance, decode with a GrammarFst
+        // that shares the FSTs of 'fst' and adds it.
+        std::unique_ptr<fst::GrammarFst> utt_fst;
+        std::unique_ptr<LatticeFasterDecoderTpl<fst::GrammarFst> > utt_decoder;
+        if (!utt_fsts_rspecifier.empty() && utt_fst_reader.HasKey(utt)) {
+          std::vector<std::pair<int32,
+              std::shared_ptr<const fst::ConstFst<StdArc> > > > extra_ifsts;
+          extra_ifsts.push_back(std::make_pair(
+              utt_nonterminal, utt_fst_cache.Lookup(utt_fst_reader.Value(utt))));
+          utt_fst.reset(new fst::GrammarFst(fst, extra_ifsts));
+          utt_decoder.reset(new LatticeFasterDecoderTpl<fst::GrammarFst>(
+              *utt_fst, config));
+        }
+
         double like;
         if (DecodeUtteranceLatticeFaster(
-                decoder, nnet_decodable, trans_model, word_syms, utt,
+                utt_decoder ? *utt_decoder : decoder, nnet_decodable,
+                trans_model, word_syms, utt,
                 decodable_opts.acoustic_scale, determinize, allow_partial,
                 &alignment_writer, &words_writer, &compact_lattice_writer,
                 &lattice_writer,
@@ -200,6 +235,9 @@ int main(int argc, char *argv[]) {
               << (elapsed * 100.0 / input_frame_count);
     KALDI_LOG << "Done " << num_success << " utterances, failed for "
               << num_fail;
+    if (!utt_fsts_rspecifier.empty())
+      KALDI_LOG << "Per-utterance FSTs: " << utt_fst_cache.NumMisses()
+                << " distinct, " << utt_fst_cache.NumHits() << " reused.";
     KALDI_LOG << "Overall log-likelihood per frame is "
               << (tot_like / frame_count) << " over "
               << frame_count << " frames.";
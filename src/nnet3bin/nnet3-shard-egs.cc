@@ -0,0 +1,111 @@
+// nnet3bin/nnet3-shard-egs.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "nnet3/nnet-example-index.h"
+#include "nnet3/nnet-chain-example.h"
+#include "nnet3/nnet-discriminative-example.h"
+
+namespace kaldi {
+namespace nnet3 {
+
+// Copies the examples of type 'Example' to the sharded egs, and returns the
+// number copied.
+template <class Example>
+int64 CopyToShards(const std::string &examples_rspecifier,
+                   const std::string &prefix, int32 num_shards,
+                   bool binary) {
+  SequentialTableReader<KaldiObjectHolder<Example> > example_reader(
+      examples_rspecifier);
+  ShardedExampleWriter<Example> writer(prefix, num_shards, binary);
+  for (; !example_reader.Done(); example_reader.Next())
+    writer.Write(example_reader.Key(), example_reader.Value());
+  writer.Close();
+  return writer.NumWritten();
+}
+
+}  // namespace nnet3
+}  // namespace kaldi
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    using namespace kaldi::nnet3;
+    typedef kaldi::int32 int32;
+    typedef kaldi::int64 int64;
+
+    const char *usage =
+        "Copy examples for neural network training to 'sharded egs': the\n"
+        "archives <prefix>.1.ark ... <prefix>.<num-shards>.ark, an scp file\n"
+        "<prefix>.scp that any program reading egs can read, and an index\n"
+        "<prefix>.index with the number of frames and the output name of\n"
+        "each example (see nnet3/nnet-example-index.h), from which\n"
+        "nnet3-shuffle-egs-index makes shuffled scp files.\n"
+        "\n"
+        "Usage:  nnet3-shard-egs [options] <egs-rspecifier> <prefix>\n"
+        "\n"
+        "e.g.\n"
+        "nnet3-shard-egs --num-shards=8 ark:train.egs exp/egs/train\n"
+        "nnet3-shard-egs --egs-type=chain ark:cegs.1.ark exp/chain/egs/cegs.1\n";
+
+    bool binary_write = true;
+    int32 num_shards = 1;
+    std::string egs_type = "nnet3";
+
+    ParseOptions po(usage);
+    po.Register("binary", &binary_write, "Write output in binary mode");
+    po.Register("num-shards", &num_shards, "Number of archives that the "
+                "examples are written to (in turn).");
+    po.Register("egs-type", &egs_type, "Type of the examples: nnet3, chain "
+                "or discriminative.");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 2) {
+      po.PrintUsage();
+      exit(1);
+    }
+    if (num_shards <= 0)
+      KALDI_ERR << "Invalid --num-shards=" << num_shards;
+
+    std::string examples_rspecifier = po.GetArg(1),
+        prefix = po.GetArg(2);
+
+    int64 num_written;
+    if (egs_type == "nnet3")
+      num_written = CopyToShards<NnetExample>(examples_rspecifier, prefix,
+                                              num_shards, binary_write);
+    else if (egs_type == "chain")
+      num_written = CopyToShards<NnetChainExample>(
+          examples_rspecifier, prefix, num_shards, binary_write);
+    else if (egs_type == "discriminative")
+      num_written = CopyToShards<NnetDiscriminativeExample>(
+          examples_rspecifier, prefix, num_shards, binary_write);
+    else
+      KALDI_ERR << "Invalid --egs-type=" << egs_type;
+
+    KALDI_LOG << "Wrote " << num_written << " examples to " << num_shards
+              << " shards with prefix " << prefix;
+    return (num_written == 0 ? 1 : 0);
+  } catch(const std::exception &e) {
+    std::cerr << e.what() << '\n';
+    return -1;
+  }
+}
@@ -0,0 +1,79 @@
+// nnet3bin/nnet3-shuffle-egs-index.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "nnet3/nnet-example-index.h"
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    using namespace kaldi::nnet3;
+    typedef kaldi::int32 int32;
+
+    const char *usage =
+        "Write the examples in the index of sharded egs (see nnet3-shard-egs)\n"
+        "in random order, as an scp file.  With --group-size, the examples\n"
+        "are put in groups of that many examples with the same output and\n"
+        "number of frames, and the groups are shuffled, so that merging the\n"
+        "examples with --minibatch-size=<group-size> gives minibatches of\n"
+        "similar examples.  The examples are then read from the shards one\n"
+        "at a time, so the memory used doesn't depend on the number of\n"
+        "examples as it does with nnet3-shuffle-egs.\n"
+        "\n"
+        "Usage:  nnet3-shuffle-egs-index [options] <index-rxfilename> "
+        "<scp-wxfilename>\n"
+        "\n"
+        "e.g.\n"
+        "nnet3-shuffle-egs-index --srand=1 --group-size=128 \\\n"
+        "  exp/egs/train.index exp/egs/train.shuffled.scp\n"
+        "nnet3-merge-egs --minibatch-size=128 scp:exp/egs/train.shuffled.scp "
+        "ark:- | ...\n";
+
+    int32 srand_seed = 0, group_size = 1;
+    ParseOptions po(usage);
+    po.Register("srand", &srand_seed, "Seed for random number generator ");
+    po.Register("group-size", &group_size, "If >1, the number of examples "
+                "with the same output and number of frames that are kept "
+                "together in the shuffled order.");
+
+    po.Read(argc, argv);
+
+    srand(srand_seed);
+
+    if (po.NumArgs() != 2) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string index_rxfilename = po.GetArg(1),
+        scp_wxfilename = po.GetArg(2);
+
+    std::vector<ExampleIndexEntry> index;
+    ReadExampleIndex(index_rxfilename, &index);
+    ShuffleExampleIndex(group_size, &index);
+    WriteExampleIndexAsScp(scp_wxfilename, index);
+
+    KALDI_LOG << "Shuffled " << index.size() << " examples.";
+    return (index.empty() ? 1 : 0);
+  } catch(const std::exception &e) {
+    std::cerr << e.what() << '\n';
+    return -1;
+  }
+}
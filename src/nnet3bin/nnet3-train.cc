@@ -34,7 +34,9 @@ int main(int argc, char *argv[]) {
         "gradient descent.  Minibatches are to be created by nnet3-merge-egs in\n"
         "the input pipeline.  This training program is single-threaded (best to\n"
         "use it with a GPU); see nnet3-train-parallel for multi-threaded training\n"
-        "that is better suited to CPUs.\n"
+        "that is better suited to CPUs.  With --num-workers > 1, that many\n"
+        "copies of this program (one per GPU, each reading its own examples)\n"
+        "train the model synchronously, averaging the updates with NCCL.\n"
         "\n"
         "Usage:  nnet3-train [options] <raw-model-in> <training-examples-in> <raw-model-out>\n"
         "\n"
@@ -42,17 +44,25 @@ int main(int argc, char *argv[]) {
         "nnet3-train 1.raw 'ark:nnet3-merge-egs 1.egs ark:-|' 2.raw\n";
 
     int32 srand_seed = 0;
-    bool binary_write = true;
+    bool binary_write = true, share_model = false;
     std::string use_gpu = "yes";
     NnetTrainerOptions train_config;
+    NnetPrefetchOptions prefetch_opts;
+    NnetDataParallelOptions parallel_opts;
 
     ParseOptions po(usage);
     po.Register("srand", &srand_seed, "Seed for random number generator ");
     po.Register("binary", &binary_write, "Write output in binary mode");
     po.Register("use-gpu", &use_gpu,
                 "yes|no|optional|wait, only has effect if compiled with CUDA");
+    po.Register("share-model", &share_model, "If true, read the model through "
+                "a copy in shared memory that is shared with the other jobs on "
+                "this machine that read it with this option, so that it is "
+                "read from the file system only once.");
 
     train_config.Register(&po);
+    prefetch_opts.Register(&po);
+    parallel_opts.Register(&po);
     RegisterCuAllocatorOptions(&po);
 
     po.Read(argc, argv);
@@ -72,16 +82,32 @@ int main(int argc, char *argv[]) {
         examples_rspecifier = po.GetArg(2),
         nnet_wxfilename = po.GetArg(3);
 
-    Nnet nnet;
-    ReadKaldiObject(nnet_rxfilename, &nnet);
-
-    NnetTrainer trainer(train_config, &nnet);
-
-    SequentialNnetExampleReader example_reader(examples_rspecifier);
+    if (prefetch_opts.augment.Enabled() && prefetch_opts.num_minibatches == 0)
+      KALDI_ERR << "The --augment-* options require --prefetch > 0.";
 
-    for (; !example_reader.Done(); example_reader.Next())
-      trainer.Train(example_reader.Value());
+    Nnet nnet;
+    if (share_model)
+      ReadKaldiObjectNodeShared(nnet_rxfilename, &nnet);
+    else
+      ReadKaldiObject(nnet_rxfilename, &nnet);
+
+    NnetDataParallel parallel(parallel_opts);
+    NnetTrainer trainer(train_config, &nnet, &parallel);
+
+    if (prefetch_opts.num_minibatches > 0) {
+      NnetExamplePrefetcher example_reader(prefetch_opts, nnet,
+                                            examples_rspecifier);
+      for (; parallel.AllHaveData(!example_reader.Done());
+           example_reader.Next())
+        trainer.Train(example_reader.Value(), example_reader.Inputs());
+    } else {
+      SequentialNnetExampleReader example_reader(examples_rspecifier);
+      for (; parallel.AllHaveData(!example_reader.Done());
+           example_reader.Next())
+        trainer.Train(example_reader.Value());
+    }
 
+    parallel.Finish(&nnet);
     bool ok = trainer.PrintTotalStats();
 
 #if HAVE_CUDA==1
@@ -19,6 +19,9 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <utility>
+#include <vector>
 
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
@@ -29,34 +32,148 @@
 namespace kaldi {
 namespace nnet3 {
 
-// Computes an xvector from a chunk of speech features.
-static void RunNnetComputation(const MatrixBase<BaseFloat> &features,
+// Computes the xvectors for a batch of chunks of speech features, all of the
+// same length; each chunk is a separate sequence (a value of the 'n' index) in
+// the computation, and row n of "xvectors" is the xvector for chunks[n].  The
+// statistics pooling is done separately for each sequence, so this gives the
+// same xvectors as computing the chunks one by one.
+static void RunNnetComputation(
+    const std::vector<const MatrixBase<BaseFloat>*> &chunks,
     const Nnet &nnet, CachingOptimizingCompiler *compiler,
-    Vector<BaseFloat> *xvector) {
+    Matrix<BaseFloat> *xvectors) {
+  int32 num_chunks = chunks.size(), num_rows = 0,
+      feat_dim = chunks[0]->NumCols();
   ComputationRequest request;
   request.need_model_derivative = false;
   request.store_component_stats = false;
-  request.inputs.push_back(
-    IoSpecification("input", 0, features.NumRows()));
+  IoSpecification input_spec;
+  input_spec.name = "input";
   IoSpecification output_spec;
   output_spec.name = "output";
   output_spec.has_deriv = false;
-  output_spec.indexes.resize(1);
+  for (int32 n = 0; n < num_chunks; n++) {
+    KALDI_ASSERT(chunks[n]->NumRows() == chunks[0]->NumRows());
+    for (int32 t = 0; t < chunks[n]->NumRows(); t++)
+      input_spec.indexes.push_back(Index(n, t, 0));
+    output_spec.indexes.push_back(Index(n, 0, 0));
+    num_rows += chunks[n]->NumRows();
+  }
+  request.inputs.resize(1);
+  request.inputs[0].Swap(&input_spec);
   request.outputs.resize(1);
   request.outputs[0].Swap(&output_spec);
   std::shared_ptr<const NnetComputation> computation(compiler->Compile(request));
   Nnet *nnet_to_update = NULL;  // we're not doing any update.
   NnetComputer computer(NnetComputeOptions(), *computation,
                   nnet, nnet_to_update);
-  CuMatrix<BaseFloat> input_feats_cu(features);
+  Matrix<BaseFloat> input_feats(num_rows, feat_dim, kUndefined);
+  for (int32 n = 0, row = 0; n < num_chunks; n++) {
+    input_feats.RowRange(row, chunks[n]->NumRows()).CopyFromMat(*(chunks[n]));
+    row += chunks[n]->NumRows();
+  }
+  CuMatrix<BaseFloat> input_feats_cu(input_feats);
   computer.AcceptInput("input", &input_feats_cu);
   computer.Run();
   CuMatrix<BaseFloat> cu_output;
   computer.GetOutputDestructive("output", &cu_output);
-  xvector->Resize(cu_output.NumCols());
-  xvector->CopyFromVec(cu_output.Row(0));
+  xvectors->Resize(cu_output.NumRows(), cu_output.NumCols(), kUndefined);
+  xvectors->CopyFromMat(cu_output);
 }
 
+// This class collects the chunks of features of utterances, computes their
+// xvectors in batches of up to "batch_size" chunks of the same length, and
+// writes the average xvector of each utterance, in the order the utterances
+// were added.  Batches are only made of chunks of the same length because the
+// computation for a given number and length of chunks is compiled once, and
+// then found in the compiler's cache.
+class XvectorBatchComputer {
+ public:
+  XvectorBatchComputer(const Nnet &nnet, CachingOptimizingCompiler *compiler,
+                       int32 batch_size, BaseFloatVectorWriter *writer):
+      nnet_(nnet), compiler_(compiler), batch_size_(batch_size),
+      writer_(writer) { }
+
+  // Adds a chunk of features for utterance "utt", whose xvector gets the
+  // weight "weight" in the average.  The chunks of an utterance must be added
+  // together, before any chunk of the next utterance.
+  void AddChunk(const std::string &utt, const MatrixBase<BaseFloat> &features,
+                BaseFloat weight) {
+    if (utts_.empty() || utts_.back() != utt) {
+      // We compute the xvectors a few batches at a time, which gives us more
+      // chunks of the same length to put together.
+      if (chunks_.size() >= 4 * batch_size_)
+        Flush();
+      utts_.push_back(utt);
+    }
+    chunks_.push_back(new Matrix<BaseFloat>(features));
+    chunk_utts_.push_back(utts_.size() - 1);
+    chunk_weights_.push_back(weight);
+  }
+
+  // Computes the xvectors of all the chunks added, and writes them.  Must be
+  // called after the last utterance has been added.
+  void Flush() {
+    if (utts_.empty())
+      return;
+    // Sort the chunks by length, to divide them into batches of the same length.
+    std::vector<std::pair<int32, int32> > lengths(chunks_.size());
+    for (size_t i = 0; i < chunks_.size(); i++)
+      lengths[i] = std::make_pair(chunks_[i]->NumRows(), i);
+    std::sort(lengths.begin(), lengths.end());
+
+    std::vector<Vector<BaseFloat> > xvectors(utts_.size());
+    std::vector<BaseFloat> tot_weights(utts_.size(), 0.0);
+    for (size_t begin = 0, end; begin < lengths.size(); begin = end) {
+      end = begin + 1;
+      while (end < lengths.size() && end - begin < batch_size_ &&
+             lengths[end].first == lengths[begin].first)
+        end++;
+      // Batches smaller than batch_size_ are made a power of two in size,
+      // so that there are fewer different computations to compile.
+      size_t size = end - begin;
+      if (size < batch_size_) {
+        while ((size & (size - 1)) != 0)
+          size &= size - 1;
+        end = begin + size;
+      }
+      std::vector<const MatrixBase<BaseFloat>*> batch;
+      for (size_t k = begin; k < end; k++)
+        batch.push_back(chunks_[lengths[k].second]);
+      Matrix<BaseFloat> batch_xvectors;
+      RunNnetComputation(batch, nnet_, compiler_, &batch_xvectors);
+      for (size_t k = begin; k < end; k++) {
+        int32 i = lengths[k].second, u = chunk_utts_[i];
+        if (xvectors[u].Dim() == 0)
+          xvectors[u].Resize(batch_xvectors.NumCols());
+        xvectors[u].AddVec(chunk_weights_[i], batch_xvectors.Row(k - begin));
+        tot_weights[u] += chunk_weights_[i];
+      }
+    }
+    for (size_t u = 0; u < utts_.size(); u++) {
+      xvectors[u].Scale(1.0 / tot_weights[u]);
+      writer_->Write(utts_[u], xvectors[u]);
+    }
+    DeletePointers(&chunks_);
+    chunks_.clear();
+    chunk_utts_.clear();
+    chunk_weights_.clear();
+    utts_.clear();
+  }
+
+  ~XvectorBatchComputer() { DeletePointers(&chunks_); }
+
+ private:
+  const Nnet &nnet_;
+  CachingOptimizingCompiler *compiler_;
+  size_t batch_size_;
+  BaseFloatVectorWriter *writer_;
+
+  std::vector<std::string> utts_;  // the utterances not yet written.
+  std::vector<Matrix<BaseFloat>*> chunks_;  // the chunks not yet computed.
+  std::vector<int32> chunk_utts_;  // index into utts_ of each chunk.
+  std::vector<BaseFloat> chunk_weights_;  // the weight of each chunk.
+};
+
 } // namespace nnet3
 } // namespace kaldi
 
@@ -79,7 +196,8 @@ int main(int argc, char *argv[]) {
         "output layer after the statistics pooling layer.  By default, one\n"
         "xvector is extracted directly from the set of features for each\n"
         "utterance.  Optionally, xvectors are extracted from chunks of input\n"
-        "features and averaged, to produce a single vector.\n"
+        "features and averaged, to produce a single vector.  The chunks of\n"
+        "several utterances are computed together, in batches of --batch-size.\n"
         "\n"
         "Usage: nnet3-xvector-compute [options] <raw-nnet-in> "
         "<features-rspecifier> <vector-wspecifier>\n"
@@ -97,7 +215,8 @@ int main(int argc, char *argv[]) {
 
     std::string use_gpu = "no";
     int32 chunk_size = -1,
-      min_chunk_size = 100;
+      min_chunk_size = 100,
+      batch_size = 32;
     bool pad_input = true;
 
     opts.Register(&po);
@@ -110,6 +229,8 @@ int main(int argc, char *argv[]) {
       "If not set, extracts an xvector from all available features.");
     po.Register("min-chunk-size", &min_chunk_size,
       "Minimum chunk-size allowed when extracting xvectors.");
+    po.Register("batch-size", &batch_size, "Number of chunks (from different "
+      "utterances, if needed) to compute at the same time.");
     po.Register("pad-input", &pad_input, "If true, duplicate the first and "
       "last frames of the input features as required to equal min-chunk-size.");
 
@@ -141,10 +262,12 @@ int main(int argc, char *argv[]) {
     CachingOptimizingCompiler compiler(nnet, opts.optimize_config, compiler_config);
 
     BaseFloatVectorWriter vector_writer(vector_wspecifier);
+    KALDI_ASSERT(batch_size > 0);
+    XvectorBatchComputer batch_computer(nnet, &compiler, batch_size,
+                                        &vector_writer);
 
     int32 num_success = 0, num_fail = 0;
     int64 frame_count = 0;
-    int32 xvector_dim = nnet.OutputDim("output");
 
     SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
 
@@ -176,8 +299,6 @@ int main(int argc, char *argv[]) {
 
       int32 num_chunks = ceil(
         num_rows / static_cast<BaseFloat>(this_chunk_size));
-      Vector<BaseFloat> xvector_avg(xvector_dim, kSetZero);
-      BaseFloat tot_weight = 0.0;
 
       // Iterate over the feature chunks.
       for (int32 chunk_indx = 0; chunk_indx < num_chunks; chunk_indx++) {
@@ -190,8 +311,6 @@ int main(int argc, char *argv[]) {
           continue;
         SubMatrix<BaseFloat> sub_features(
           features, chunk_indx * this_chunk_size, offset, 0, feat_dim);
-        Vector<BaseFloat> xvector;
-        tot_weight += offset;
 
         // Pad input if the offset is less than the minimum chunk size
         if (pad_input && offset < min_chunk_size) {
@@ -205,19 +324,18 @@ int main(int argc, char *argv[]) {
             padded_features.Row(min_chunk_size - i - 1).CopyFromVec(sub_features.Row(offset - 1));
           }
           padded_features.Range(left_context, offset, 0, feat_dim).CopyFromMat(sub_features);
-          RunNnetComputation(padded_features, nnet, &compiler, &xvector);
+          batch_computer.AddChunk(utt, padded_features, offset);
         } else {
-          RunNnetComputation(sub_features, nnet, &compiler, &xvector);
+          batch_computer.AddChunk(utt, sub_features, offset);
         }
-        xvector_avg.AddVec(offset, xvector);
       }
-      xvector_avg.Scale(1.0 / tot_weight);
-      vector_writer.Write(utt, xvector_avg);
 
       frame_count += features.NumRows();
       num_success++;
     }
 
+    batch_computer.Flush();
+
 #if HAVE_CUDA==1
     CuDevice::Instantiate().PrintProfile();
 #endif
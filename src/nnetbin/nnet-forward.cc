@@ -33,6 +33,11 @@ int main(int argc, char *argv[]) {
   try {
     const char *usage =
       "Perform forward pass through Neural Network.\n"
+      "With --num-streams > 1 several utterances are forwarded together:\n"
+      "recurrent networks process them as parallel streams (as in\n"
+      "multi-stream training), other networks get their frames concatenated;\n"
+      "networks with frame-splicing or sentence-level components always\n"
+      "process one utterance at a time.\n"
       "Usage: nnet-forward [options] <nnet1-in> <feature-rspecifier> <feature-wspecifier>\n"
       "e.g.: nnet-forward final.nnet ark:input.ark ark:output.ark\n";
 
@@ -54,6 +59,16 @@ int main(int argc, char *argv[]) {
     bool apply_log = false;
     po.Register("apply-log", &apply_log, "Transform NN output by log()");
 
+    int32 num_streams = 1;
+    po.Register("num-streams", &num_streams,
+        "Max number of utterances forwarded together (batching improves the "
+        "GPU utilization)");
+
+    double max_frames = 8000;
+    po.Register("max-frames", &max_frames,
+        "Max number of frames in a batch of utterances (including the padding "
+        "of the parallel streams)");
+
     std::string use_gpu="no";
     po.Register("use-gpu", &use_gpu,
         "yes|no|optional, only has effect if compiled with CUDA");
@@ -112,52 +127,131 @@ int main(int argc, char *argv[]) {
     nnet_transf.SetDropoutRate(0.0);
     nnet.SetDropoutRate(0.0);
 
+    // check whether the utterances can be batched: a batch is either a set of
+    // parallel streams interleaved frame by frame (recurrent networks), or
+    // the concatenation of the utterances (frame-level networks); components
+    // mixing the frames, or with nested networks, work only per utterance,
+    bool can_batch = true, multistream = false;
+    for (int32 c = 0; c < nnet.NumComponents(); c++) {
+      const Component &comp = nnet.GetComponent(c);
+      switch (comp.GetType()) {
+        case Component::kSplice:
+        case Component::kSentenceAveragingComponent:
+        case Component::kSimpleSentenceAveragingComponent:
+        case Component::kParallelComponent:
+        case Component::kMultiBasisComponent:
+          can_batch = false;
+          break;
+        default:
+          if (comp.IsMultistream()) multistream = true;
+      }
+    }
+    if (num_streams > 1 && !can_batch) {
+      KALDI_WARN << "The nnet " << model_filename << " mixes frames across "
+                 << "time, ignoring --num-streams=" << num_streams;
+      num_streams = 1;
+    }
+    if (num_streams < 1) num_streams = 1;
+
     kaldi::int64 tot_t = 0;
 
     SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
     BaseFloatMatrixWriter feature_writer(feature_wspecifier);
 
-    CuMatrix<BaseFloat> feats, feats_transf, nnet_out;
-    Matrix<BaseFloat> nnet_out_host;
+    CuMatrix<BaseFloat> feats, feats_transf, nnet_in, nnet_out;
+    Matrix<BaseFloat> nnet_out_host, utt_out;
+
+    std::vector<std::string> keys;
+    std::vector<CuMatrix<BaseFloat> > feats_utt;
+    std::vector<int32> frame_num_utt;
 
     Timer time;
     double time_now = 0;
     int32 num_done = 0;
 
     // main loop,
-    for (; !feature_reader.Done(); feature_reader.Next()) {
-      // read
-      Matrix<BaseFloat> mat = feature_reader.Value();
-      std::string utt = feature_reader.Key();
-      KALDI_VLOG(2) << "Processing utterance " << num_done+1
-                    << ", " << utt
-                    << ", " << mat.NumRows() << "frm";
+    while (!feature_reader.Done()) {
+      keys.clear();
+      feats_utt.clear();
+      frame_num_utt.clear();
+      int32 batch_frames = 0, max_len = 0;
+      // fill a batch of utterances,
+      for (; !feature_reader.Done(); feature_reader.Next()) {
+        // read
+        const Matrix<BaseFloat> &mat = feature_reader.Value();
+        std::string utt = feature_reader.Key();
+        if (!keys.empty()) {
+          int32 new_max_len = std::max(max_len, mat.NumRows()),
+              new_frames = (multistream ?
+                            new_max_len * static_cast<int32>(keys.size() + 1) :
+                            batch_frames + mat.NumRows());
+          if (keys.size() == static_cast<size_t>(num_streams) || new_frames > max_frames) break;
+        }
+        KALDI_VLOG(2) << "Processing utterance " << num_done+keys.size()+1
+                      << ", " << utt
+                      << ", " << mat.NumRows() << "frm";
 
+        if (!KALDI_ISFINITE(mat.Sum())) {  // check there's no nan/inf,
+          KALDI_ERR << "NaN or inf found in features for " << utt;
+        }
 
-      if (!KALDI_ISFINITE(mat.Sum())) {  // check there's no nan/inf,
-        KALDI_ERR << "NaN or inf found in features for " << utt;
-      }
+        // push it to gpu,
+        feats = mat;
 
-      // push it to gpu,
-      feats = mat;
+        // fwd-pass, feature transform,
+        nnet_transf.Feedforward(feats, &feats_transf);
+        if (!KALDI_ISFINITE(feats_transf.Sum())) {  // check there's no nan/inf,
+          KALDI_ERR << "NaN or inf found in transformed-features for " << utt;
+        }
 
-      // fwd-pass, feature transform,
-      nnet_transf.Feedforward(feats, &feats_transf);
-      if (!KALDI_ISFINITE(feats_transf.Sum())) {  // check there's no nan/inf,
-        KALDI_ERR << "NaN or inf found in transformed-features for " << utt;
+        keys.push_back(utt);
+        feats_utt.resize(feats_utt.size() + 1);
+        feats_utt.back().Swap(&feats_transf);
+        frame_num_utt.push_back(feats_utt.back().NumRows());
+        max_len = std::max(max_len, frame_num_utt.back());
+        batch_frames += frame_num_utt.back();
+        tot_t += mat.NumRows();
       }
+      int32 batch_size = keys.size();
+      std::string batch_utts = keys[0] + (batch_size > 1 ? ", ..." : "");
 
       // fwd-pass, nnet,
-      nnet.Feedforward(feats_transf, &nnet_out);
+      if (multistream) {
+        // interleave the utterances as parallel streams, padded with zeros
+        // to the longest one; frame 'r' of stream 's' is the row
+        // r * batch_size + s (the interleaving is done on the host),
+        Matrix<BaseFloat> nnet_in_host(max_len * batch_size,
+                                       feats_utt[0].NumCols());
+        for (int32 s = 0; s < batch_size; s++) {
+          Matrix<BaseFloat> utt_feats(feats_utt[s]);
+          for (int32 r = 0; r < frame_num_utt[s]; r++) {
+            nnet_in_host.Row(r * batch_size + s).CopyFromVec(utt_feats.Row(r));
+          }
+        }
+        nnet_in = nnet_in_host;
+        nnet.SetSeqLengths(frame_num_utt);
+        nnet.ResetStreams(std::vector<int32>(batch_size, 1));
+        nnet.Feedforward(nnet_in, &nnet_out);
+      } else if (batch_size > 1) {
+        nnet_in.Resize(batch_frames, feats_utt[0].NumCols(), kUndefined);
+        int32 offset = 0;
+        for (int32 s = 0; s < batch_size; s++) {
+          nnet_in.RowRange(offset, frame_num_utt[s]).CopyFromMat(feats_utt[s]);
+          offset += frame_num_utt[s];
+        }
+        nnet.Feedforward(nnet_in, &nnet_out);
+      } else {
+        nnet.Feedforward(feats_utt[0], &nnet_out);
+      }
       if (!KALDI_ISFINITE(nnet_out.Sum())) {  // check there's no nan/inf,
-        KALDI_ERR << "NaN or inf found in nn-output for " << utt;
+        KALDI_ERR << "NaN or inf found in nn-output for " << batch_utts;
       }
 
       // convert posteriors to log-posteriors,
       if (apply_log) {
         if (!(nnet_out.Min() >= 0.0 && nnet_out.Max() <= 1.0)) {
           KALDI_WARN << "Applying 'log()' to data which don't seem to be "
-                     << "probabilities," << utt;
+                     << "probabilities," << batch_utts;
         }
         nnet_out.Add(1e-20);  // avoid log(0),
         nnet_out.ApplyLog();
@@ -171,21 +265,36 @@ int main(int argc, char *argv[]) {
       // download from GPU,
       nnet_out_host = Matrix<BaseFloat>(nnet_out);
 
-      // write,
-      if (!KALDI_ISFINITE(nnet_out_host.Sum())) {  // check there's no nan/inf,
-        KALDI_ERR << "NaN or inf found in final output nn-output for " << utt;
-      }
-      feature_writer.Write(feature_reader.Key(), nnet_out_host);
-
-      // progress log,
-      if (num_done % 100 == 0) {
-        time_now = time.Elapsed();
-        KALDI_VLOG(1) << "After " << num_done << " utterances: time elapsed = "
-                      << time_now/60 << " min; processed " << tot_t/time_now
-                      << " frames per second.";
+      // split the output per utterance, write,
+      int32 offset = 0;
+      for (int32 s = 0; s < batch_size; s++) {
+        if (multistream) {
+          utt_out.Resize(frame_num_utt[s], nnet_out_host.NumCols(),
+                         kUndefined);
+          for (int32 r = 0; r < frame_num_utt[s]; r++) {
+            utt_out.Row(r).CopyFromVec(nnet_out_host.Row(r * batch_size + s));
+          }
+        } else if (batch_size > 1) {
+          utt_out = nnet_out_host.RowRange(offset, frame_num_utt[s]);
+          offset += frame_num_utt[s];
+        } else {
+          utt_out.Swap(&nnet_out_host);
+        }
+        if (!KALDI_ISFINITE(utt_out.Sum())) {  // check there's no nan/inf,
+          KALDI_ERR << "NaN or inf found in final output nn-output for "
+                    << keys[s];
+        }
+        feature_writer.Write(keys[s], utt_out);
+
+        // progress log,
+        if (num_done % 100 == 0) {
+          time_now = time.Elapsed();
+          KALDI_VLOG(1) << "After " << num_done << " utterances: time elapsed = "
+                        << time_now/60 << " min; processed " << tot_t/time_now
+                        << " frames per second.";
+        }
+        num_done++;
       }
-      num_done++;
-      tot_t += mat.NumRows();
     }
 
     // final message,
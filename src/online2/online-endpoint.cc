@@ -71,10 +71,9 @@ bool EndpointDetected(const OnlineEndpointConfig &config,
   return false;
 }
 
-template <typename FST>
-int32 TrailingSilenceLength(const TransitionModel &tmodel,
-                            const std::string &silence_phones_str,
-                            const LatticeFasterOnlineDecoderTpl<FST> &decoder) {
+// Parses the --endpoint.silence-phones option into 'silence_set'.
+static void ParseSilencePhones(const std::string &silence_phones_str,
+                               ConstIntegerSet<int32> *silence_set) {
   std::vector<int32> silence_phones;
   if (!SplitStringToIntegers(silence_phones_str, ":", false, &silence_phones))
     KALDI_ERR << "Bad --silence-phones option in endpointing config: "
@@ -84,7 +83,15 @@ int32 TrailingSilenceLength(const TransitionModel &tmodel,
                "Duplicates in --silence-phones option in endpointing config");
   KALDI_ASSERT(!silence_phones.empty() &&
                "Endpointing requires nonempty --endpoint.silence-phones option");
-  ConstIntegerSet<int32> silence_set(silence_phones);
+  silence_set->Init(silence_phones);
+}
+
+template <typename FST>
+int32 TrailingSilenceLength(const TransitionModel &tmodel,
+                            const std::string &silence_phones_str,
+                            const LatticeFasterOnlineDecoderTpl<FST> &decoder) {
+  ConstIntegerSet<int32> silence_set;
+  ParseSilencePhones(silence_phones_str, &silence_set);
 
   bool use_final_probs = false;
   typename LatticeFasterOnlineDecoderTpl<FST>::BestPathIterator iter =
@@ -126,6 +133,78 @@ bool EndpointDetected(
 }
 
 
+OnlineEndpointDetector::OnlineEndpointDetector(const TransitionModel &tmodel):
+    tmodel_(tmodel) { }
+
+template <typename FST>
+int32 OnlineEndpointDetector::TrailingSilenceLength(
+    const std::string &silence_phones_str,
+    const LatticeFasterOnlineDecoderTpl<FST> &decoder) {
+  if (silence_phones_str != silence_phones_str_ ||
+      silence_phones_str_.empty()) {
+    ParseSilencePhones(silence_phones_str, &silence_set_);
+    silence_phones_str_ = silence_phones_str;
+    frame_info_.clear();
+  }
+  int32 num_frames = decoder.NumFramesDecoded();
+  if (num_frames < static_cast<int32>(frame_info_.size()))
+    frame_info_.clear();  // The decoder must have been re-initialized.
+  frame_info_.resize(num_frames);
+  if (num_frames == 0)
+    return 0;
+
+  // Trace back until we reach a frame whose best path we already know about,
+  // or a non-silence frame.  'new_frames' is the frames we pass, in reverse
+  // order, as pairs (token, is-silence).
+  std::vector<std::pair<void*, bool> > new_frames;
+  int32 trailing_silence = 0;
+  typename LatticeFasterOnlineDecoderTpl<FST>::BestPathIterator iter =
+      decoder.BestPathEnd(false, NULL);
+  for (int32 frame = num_frames - 1; frame >= 0; frame--) {
+    if (frame_info_[frame].token == iter.tok) {
+      trailing_silence = frame_info_[frame].trailing_silence;
+      break;
+    }
+    void *tok = iter.tok;
+    LatticeArc arc;
+    arc.ilabel = 0;
+    while (arc.ilabel == 0)  // skip over input-epsilons
+      iter = decoder.TraceBackBestPath(iter, &arc);
+    bool is_silence =
+        (silence_set_.count(tmodel_.TransitionIdToPhone(arc.ilabel)) != 0);
+    new_frames.push_back(std::pair<void*, bool>(tok, is_silence));
+    if (!is_silence)
+      break;
+  }
+  // Now record the frames we passed, going forwards in time.
+  int32 frame = num_frames - new_frames.size();
+  for (int32 i = new_frames.size() - 1; i >= 0; i--, frame++) {
+    trailing_silence = (new_frames[i].second ? trailing_silence + 1 : 0);
+    frame_info_[frame].token = new_frames[i].first;
+    frame_info_[frame].trailing_silence = trailing_silence;
+  }
+  return trailing_silence;
+}
+
+template <typename FST>
+bool OnlineEndpointDetector::EndpointDetected(
+    const OnlineEndpointConfig &config,
+    BaseFloat frame_shift_in_seconds,
+    const LatticeFasterOnlineDecoderTpl<FST> &decoder) {
+  if (decoder.NumFramesDecoded() == 0) return false;
+
+  BaseFloat final_relative_cost = decoder.FinalRelativeCost();
+
+  int32 num_frames_decoded = decoder.NumFramesDecoded(),
+      trailing_silence_frames = TrailingSilenceLength(config.silence_phones,
+                                                      decoder);
+
+  return kaldi::EndpointDetected(config, num_frames_decoded,
+                                 trailing_silence_frames,
+                                 frame_shift_in_seconds, final_relative_cost);
+}
+
+
 // Instantiate EndpointDetected for the types we need.
 // It will require TrailingSilenceLength so we don't have to instantiate that.
 template
@@ -143,5 +222,17 @@ bool EndpointDetected<fst::GrammarFst>(
     BaseFloat frame_shift_in_seconds,
     const LatticeFasterOnlineDecoderTpl<fst::GrammarFst> &decoder);
 
+template
+bool OnlineEndpointDetector::EndpointDetected<fst::Fst<fst::StdArc> >(
+    const OnlineEndpointConfig &config,
+    BaseFloat frame_shift_in_seconds,
+    const LatticeFasterOnlineDecoderTpl<fst::Fst<fst::StdArc> > &decoder);
+
+template
+bool OnlineEndpointDetector::EndpointDetected<fst::GrammarFst>(
+    const OnlineEndpointConfig &config,
+    BaseFloat frame_shift_in_seconds,
+    const LatticeFasterOnlineDecoderTpl<fst::GrammarFst> &decoder);
+
 
 }  // namespace kaldi
@@ -27,6 +27,7 @@
 
 #include "matrix/matrix-lib.h"
 #include "util/common-utils.h"
+#include "util/const-integer-set.h"
 #include "base/kaldi-error.h"
 #include "feat/feature-functions.h"
 #include "feat/feature-mfcc.h"
@@ -203,6 +204,59 @@ bool EndpointDetected(
     const LatticeFasterOnlineDecoderTpl<FST> &decoder);
 
 
+/// This class does the same as the EndpointDetected() function above that
+/// takes the decoder, but is for when it is called repeatedly during an
+/// utterance, e.g. after each chunk of data is decoded.  It remembers the
+/// trailing-silence length at each frame of the best paths it has traced back
+/// (keyed by the decoder's tokens), so each call only traces back until it
+/// reaches a non-silence frame or a part of the best path it has already seen;
+/// typically that is just the frames decoded since the previous call, however
+/// long the trailing silence is.  It also parses the silence phones only once.
+class OnlineEndpointDetector {
+ public:
+  explicit OnlineEndpointDetector(const TransitionModel &tmodel);
+
+  /// Returns true if the endpointing rules in 'config' say we should stop
+  /// decoding.  'decoder' must be the same decoder each time, and Reset() must
+  /// be called whenever its InitDecoding() is called.
+  template <typename FST>
+  bool EndpointDetected(const OnlineEndpointConfig &config,
+                        BaseFloat frame_shift_in_seconds,
+                        const LatticeFasterOnlineDecoderTpl<FST> &decoder);
+
+  /// Returns the number of frames of trailing silence in the best-path
+  /// traceback, as TrailingSilenceLength() does.
+  template <typename FST>
+  int32 TrailingSilenceLength(
+      const std::string &silence_phones_str,
+      const LatticeFasterOnlineDecoderTpl<FST> &decoder);
+
+  /// Forgets the tracebacks seen so far; call this when starting a new
+  /// utterance with the same decoder.
+  void Reset() { frame_info_.clear(); }
+
+ private:
+  const TransitionModel &tmodel_;
+
+  // The silence phones, and the option string they were parsed from.
+  std::string silence_phones_str_;
+  ConstIntegerSet<int32> silence_set_;
+
+  struct FrameInfo {
+    // The token on the best path at the end of this frame (in the sense of
+    // BestPathIterator::tok), which determines the best path up to this frame.
+    void *token;
+    // The number of frames of silence on the best path ending with this frame.
+    int32 trailing_silence;
+    FrameInfo(): token(NULL), trailing_silence(0) { }
+  };
+  // Indexed by frame.  Tokens on a given frame are never reallocated while an
+  // utterance is decoded, so a token match means the best path up to that
+  // frame is the same as when we recorded it.
+  std::vector<FrameInfo> frame_info_;
+};
+
+
 
 
 /// @} End of "addtogroup onlinedecoding"
@@ -209,7 +209,8 @@ void OnlineIvectorFeature::UpdateStatsForFrames(
     frames.push_back(frame_weights[i].first);
   lda_normalized_->GetFrames(frames, &feats);
 
-  info_.diag_ubm.LogLikelihoods(feats, &log_likes);
+  if (!GetCachedUbmLogLikes(frames, &log_likes))
+    info_.diag_ubm.LogLikelihoods(feats, &log_likes);
 
   // "posteriors" stores, for each frame index in the range of frames, the
   // pruned posteriors for the Gaussians in the UBM.
@@ -230,6 +231,20 @@ void OnlineIvectorFeature::UpdateStatsForFrames(
 }
 
 
+bool OnlineIvectorFeature::GetCachedUbmLogLikes(
+    const std::vector<int32> &frames, Matrix<BaseFloat> *log_likes) const {
+  int32 num_frames = frames.size(),
+      begin = ubm_log_likes_offset_,
+      end = ubm_log_likes_offset_ + ubm_log_likes_.NumRows();
+  for (int32 i = 0; i < num_frames; i++)
+    if (frames[i] < begin || frames[i] >= end)
+      return false;
+  log_likes->Resize(num_frames, ubm_log_likes_.NumCols(), kUndefined);
+  for (int32 i = 0; i < num_frames; i++)
+    log_likes->Row(i).CopyFromVec(ubm_log_likes_.Row(frames[i] - begin));
+  return true;
+}
+
 void OnlineIvectorFeature::UpdateStatsUntilFrame(int32 frame) {
   KALDI_ASSERT(frame >= 0 && frame < this->NumFramesReady() &&
                !delta_weights_provided_);
@@ -309,10 +324,13 @@ void OnlineIvectorFeature::UpdateStatsUntilFrameWeighted(int32 frame) {
 }
 
 
+int32 OnlineIvectorFeature::FrameToUpdateUntil(int32 frame) const {
+  return (info_.greedy_ivector_extractor ? lda_->NumFramesReady() - 1 : frame);
+}
+
 void OnlineIvectorFeature::GetFrame(int32 frame,
                                     VectorBase<BaseFloat> *feat) {
-  int32 frame_to_update_until = (info_.greedy_ivector_extractor ?
-                                 lda_->NumFramesReady() - 1 : frame);
+  int32 frame_to_update_until = FrameToUpdateUntil(frame);
   if (!delta_weights_provided_)  // No silence weighting.
     UpdateStatsUntilFrame(frame_to_update_until);
   else
@@ -339,6 +357,33 @@ void OnlineIvectorFeature::GetFrame(int32 frame,
   }
 }
 
+void OnlineIvectorFeature::GetFrames(const std::vector<int32> &frames,
+                                     MatrixBase<BaseFloat> *feats) {
+  int32 num_frames = frames.size();
+  KALDI_ASSERT(num_frames == feats->NumRows() && feats->NumCols() == Dim());
+  if (num_frames == 0)
+    return;
+  if (info_.use_most_recent_ivector) {
+    OnlineFeatureInterface::GetFrames(frames, feats);
+    return;
+  }
+  int32 max_frame = *std::max_element(frames.begin(), frames.end()),
+      frame_to_update_until = FrameToUpdateUntil(max_frame);
+  if (!delta_weights_provided_)  // No silence weighting.
+    UpdateStatsUntilFrame(frame_to_update_until);
+  else
+    UpdateStatsUntilFrameWeighted(frame_to_update_until);
+  for (int32 i = 0; i < num_frames; i++) {
+    int32 n = frames[i] / info_.ivector_period;  // rounds down.
+    KALDI_ASSERT(frames[i] >= 0 &&
+                 static_cast<size_t>(n) < ivectors_history_.size());
+    feats->Row(i).CopyFromVec(*(ivectors_history_[n]));
+  }
+  // Subtract the prior-mean from the first dimension of the output features
+  // so they're approximately zero-mean.
+  feats->ColRange(0, 1).Add(-info_.extractor.PriorOffset());
+}
+
 void OnlineIvectorFeature::PrintDiagnostics() const {
   if (num_frames_stats_ == 0) {
     KALDI_VLOG(3) << "Processed no data.";
@@ -391,7 +436,8 @@ OnlineIvectorFeature::OnlineIvectorFeature(
                    info_.max_count),
     num_frames_stats_(0), delta_weights_provided_(false),
     updated_with_no_delta_weights_(false),
-    most_recent_frame_with_weight_(-1), tot_ubm_loglike_(0.0) {
+    most_recent_frame_with_weight_(-1), tot_ubm_loglike_(0.0),
+    ubm_log_likes_offset_(0) {
   info.Check();
   KALDI_ASSERT(base_feature != NULL);
   OnlineFeatureInterface *splice_feature = new OnlineSpliceFrames(info_.splice_opts, base_feature);
@@ -437,6 +483,84 @@ void OnlineIvectorFeature::SetAdaptationState(
   cmvn_->SetState(adaptation_state.cmvn_state);
 }
 
+void OnlineIvectorFeature::WriteState(std::ostream &os, bool binary) const {
+  WriteToken(os, binary, "<OnlineIvectorFeatureState>");
+  WriteToken(os, binary, "<IvectorStats>");
+  ivector_stats_.Write(os, binary);
+  WriteToken(os, binary, "<NumFramesStats>");
+  WriteBasicType(os, binary, num_frames_stats_);
+  WriteToken(os, binary, "<DeltaWeights>");
+  // The priority queue can't be iterated over, so we go through a copy.
+  std::vector<std::pair<int32, BaseFloat> > delta_weights;
+  for (DeltaWeightsQueue queue(delta_weights_); !queue.empty(); queue.pop())
+    delta_weights.push_back(queue.top());
+  WriteBasicType(os, binary, static_cast<int32>(delta_weights.size()));
+  for (size_t i = 0; i < delta_weights.size(); i++) {
+    WriteBasicType(os, binary, delta_weights[i].first);
+    WriteBasicType(os, binary, delta_weights[i].second);
+  }
+  WriteToken(os, binary, "<DeltaWeightsProvided>");
+  WriteBasicType(os, binary, delta_weights_provided_);
+  WriteToken(os, binary, "<UpdatedWithNoDeltaWeights>");
+  WriteBasicType(os, binary, updated_with_no_delta_weights_);
+  WriteToken(os, binary, "<MostRecentFrameWithWeight>");
+  WriteBasicType(os, binary, most_recent_frame_with_weight_);
+  WriteToken(os, binary, "<TotUbmLoglike>");
+  WriteBasicType(os, binary, tot_ubm_loglike_);
+  WriteToken(os, binary, "<CurrentIvector>");
+  current_ivector_.Write(os, binary);
+  WriteToken(os, binary, "<IvectorsHistory>");
+  WriteBasicType(os, binary, static_cast<int32>(ivectors_history_.size()));
+  for (size_t i = 0; i < ivectors_history_.size(); i++)
+    ivectors_history_[i]->Write(os, binary);
+  WriteToken(os, binary, "</OnlineIvectorFeatureState>");
+}
+
+void OnlineIvectorFeature::ReadState(std::istream &is, bool binary) {
+  ExpectToken(is, binary, "<OnlineIvectorFeatureState>");
+  ExpectToken(is, binary, "<IvectorStats>");
+  ivector_stats_.Read(is, binary);
+  ExpectToken(is, binary, "<NumFramesStats>");
+  ReadBasicType(is, binary, &num_frames_stats_);
+  ExpectToken(is, binary, "<DeltaWeights>");
+  int32 num_delta_weights;
+  ReadBasicType(is, binary, &num_delta_weights);
+  delta_weights_ = DeltaWeightsQueue();
+  for (int32 i = 0; i < num_delta_weights; i++) {
+    std::pair<int32, BaseFloat> delta_weight;
+    ReadBasicType(is, binary, &delta_weight.first);
+    ReadBasicType(is, binary, &delta_weight.second);
+    delta_weights_.push(delta_weight);
+  }
+  ExpectToken(is, binary, "<DeltaWeightsProvided>");
+  ReadBasicType(is, binary, &delta_weights_provided_);
+  ExpectToken(is, binary, "<UpdatedWithNoDeltaWeights>");
+  ReadBasicType(is, binary, &updated_with_no_delta_weights_);
+  ExpectToken(is, binary, "<MostRecentFrameWithWeight>");
+  ReadBasicType(is, binary, &most_recent_frame_with_weight_);
+  ExpectToken(is, binary, "<TotUbmLoglike>");
+  ReadBasicType(is, binary, &tot_ubm_loglike_);
+  ExpectToken(is, binary, "<CurrentIvector>");
+  current_ivector_.Read(is, binary);
+  ExpectToken(is, binary, "<IvectorsHistory>");
+  int32 num_ivectors;
+  ReadBasicType(is, binary, &num_ivectors);
+  for (size_t i = 0; i < ivectors_history_.size(); i++)
+    delete ivectors_history_[i];
+  ivectors_history_.resize(num_ivectors);
+  for (int32 i = 0; i < num_ivectors; i++) {
+    ivectors_history_[i] = new Vector<BaseFloat>();
+    ivectors_history_[i]->Read(is, binary);
+  }
+  ExpectToken(is, binary, "</OnlineIvectorFeatureState>");
+  if (ivector_stats_.IvectorDim() != info_.extractor.IvectorDim() ||
+      current_ivector_.Dim() != info_.extractor.IvectorDim())
+    KALDI_ERR << "iVector dimension mismatch reading online iVector state.";
+  current_frame_weight_debug_.clear();
+  ubm_log_likes_.Resize(0, 0);
+  ubm_log_likes_offset_ = 0;
+}
+
 BaseFloat OnlineIvectorFeature::UbmLogLikePerFrame() const {
   if (NumFrames() == 0) return 0;
   else return tot_ubm_loglike_ / NumFrames();
@@ -447,6 +571,60 @@ BaseFloat OnlineIvectorFeature::ObjfImprPerFrame() const {
 }
 
 
+void OnlineIvectorBatchComputer::Compute(
+    const std::vector<OnlineIvectorFeature*> &features,
+    const std::vector<int32> &frames) {
+  KALDI_ASSERT(features.size() == frames.size());
+  int32 num_streams = features.size(),
+      feat_dim = info_.diag_ubm.Dim();
+  // The frames that each stream will add to its stats are
+  // [ features[i]->num_frames_stats_, end[i] ).  (With silence weighting,
+  // earlier frames may be revisited; those are not batched.)
+  std::vector<int32> end(num_streams);
+  int32 tot_frames = 0;
+  for (int32 i = 0; i < num_streams; i++) {
+    OnlineIvectorFeature *feature = features[i];
+    KALDI_ASSERT(&(feature->info_) == &info_ &&
+                 frames[i] < feature->NumFramesReady());
+    end[i] = std::max(feature->num_frames_stats_,
+                      feature->FrameToUpdateUntil(frames[i]) + 1);
+    tot_frames += end[i] - feature->num_frames_stats_;
+  }
+  if (tot_frames == 0)
+    return;
+
+  feats_.Resize(tot_frames, feat_dim, kUndefined);
+  std::vector<int32> stream_frames;
+  int32 row = 0;
+  for (int32 i = 0; i < num_streams; i++) {
+    OnlineIvectorFeature *feature = features[i];
+    int32 begin = feature->num_frames_stats_, num_frames = end[i] - begin;
+    if (num_frames == 0)
+      continue;
+    stream_frames.resize(num_frames);
+    for (int32 t = 0; t < num_frames; t++)
+      stream_frames[t] = begin + t;
+    SubMatrix<BaseFloat> stream_feats(feats_, row, num_frames, 0, feat_dim);
+    feature->lda_normalized_->GetFrames(stream_frames, &stream_feats);
+    row += num_frames;
+  }
+
+  info_.diag_ubm.LogLikelihoods(feats_, &log_likes_);
+
+  row = 0;
+  for (int32 i = 0; i < num_streams; i++) {
+    OnlineIvectorFeature *feature = features[i];
+    int32 begin = feature->num_frames_stats_, num_frames = end[i] - begin;
+    if (num_frames == 0)
+      continue;
+    feature->ubm_log_likes_.Resize(num_frames, log_likes_.NumCols(),
+                                   kUndefined);
+    feature->ubm_log_likes_.CopyFromMat(log_likes_.RowRange(row, num_frames));
+    feature->ubm_log_likes_offset_ = begin;
+    row += num_frames;
+  }
+}
+
 OnlineSilenceWeighting::OnlineSilenceWeighting(
     const TransitionModel &trans_model,
     const OnlineSilenceWeightingConfig &config,
@@ -521,6 +699,37 @@ template
 void OnlineSilenceWeighting::ComputeCurrentTraceback<fst::GrammarFst>(
     const LatticeFasterOnlineDecoderTpl<fst::GrammarFst> &decoder);
 
+void OnlineSilenceWeighting::WriteState(std::ostream &os,
+                                        bool binary) const {
+  WriteToken(os, binary, "<OnlineSilenceWeightingState>");
+  WriteToken(os, binary, "<NumFramesOutputAndCorrect>");
+  WriteBasicType(os, binary, num_frames_output_and_correct_);
+  WriteToken(os, binary, "<FrameInfo>");
+  WriteBasicType(os, binary, static_cast<int32>(frame_info_.size()));
+  for (size_t t = 0; t < frame_info_.size(); t++) {
+    WriteBasicType(os, binary, frame_info_[t].transition_id);
+    WriteBasicType(os, binary, frame_info_[t].current_weight);
+  }
+  WriteToken(os, binary, "</OnlineSilenceWeightingState>");
+}
+
+void OnlineSilenceWeighting::ReadState(std::istream &is, bool binary) {
+  ExpectToken(is, binary, "<OnlineSilenceWeightingState>");
+  ExpectToken(is, binary, "<NumFramesOutputAndCorrect>");
+  ReadBasicType(is, binary, &num_frames_output_and_correct_);
+  ExpectToken(is, binary, "<FrameInfo>");
+  int32 num_frames;
+  ReadBasicType(is, binary, &num_frames);
+  frame_info_.clear();
+  frame_info_.resize(num_frames);
+  for (int32 t = 0; t < num_frames; t++) {
+    // The tokens are left NULL; they won't match the decoder's.
+    ReadBasicType(is, binary, &(frame_info_[t].transition_id));
+    ReadBasicType(is, binary, &(frame_info_[t].current_weight));
+  }
+  ExpectToken(is, binary, "</OnlineSilenceWeightingState>");
+}
+
 int32 OnlineSilenceWeighting::GetBeginFrame() {
   int32 max_duration = config_.max_state_duration;
   if (max_duration <= 0 || num_frames_output_and_correct_ == 0)
@@ -269,6 +269,12 @@ class OnlineIvectorFeature: public OnlineFeatureInterface {
   virtual BaseFloat FrameShiftInSeconds() const;
   virtual void GetFrame(int32 frame, VectorBase<BaseFloat> *feat);
 
+  /// Brings the stats up to date for the last of 'frames' once, and then
+  /// copies out the iVectors (unless --use-most-recent-ivector is true, in
+  /// which case the result depends on the order and it calls GetFrame()).
+  virtual void GetFrames(const std::vector<int32> &frames,
+                         MatrixBase<BaseFloat> *feats);
+
   /// Set the adaptation state to a particular value, e.g. reflecting previous
   /// utterances of the same speaker; this will generally be called after
   /// constructing a new instance of this class.
@@ -310,7 +316,28 @@ class OnlineIvectorFeature: public OnlineFeatureInterface {
   void UpdateFrameWeights(
       const std::vector<std::pair<int32, BaseFloat> > &delta_weights);
 
+  /// Writes the state of the iVector estimation for this utterance so far:
+  /// the stats, the iVectors estimated, and any frame weights not yet
+  /// applied.  To carry on from that point, e.g. in another process, construct
+  /// a new object with the same 'info', give it the same adaptation state as
+  /// this one was given (if any), and call ReadState().  The base features must
+  /// be restored too, as the features of earlier frames may be needed again.
+  void WriteState(std::ostream &os, bool binary) const;
+
+  /// Reads the state written by WriteState(), replacing the current state.
+  void ReadState(std::istream &is, bool binary);
+
  private:
+  friend class OnlineIvectorBatchComputer;
+
+  // Returns the last frame whose stats GetFrame(frame) needs.
+  int32 FrameToUpdateUntil(int32 frame) const;
+
+  // If the UBM log-likelihoods of all of 'frames' were cached by
+  // OnlineIvectorBatchComputer, outputs them to 'log_likes' and returns true;
+  // else returns false.
+  bool GetCachedUbmLogLikes(const std::vector<int32> &frames,
+                            Matrix<BaseFloat> *log_likes) const;
 
   // This accumulates i-vector stats for a set of frames, specified as pairs
   // (t, weight).  The weights do not have to be positive.  (In the online
@@ -365,9 +392,11 @@ class OnlineIvectorFeature: public OnlineFeatureInterface {
   /// We provide std::greater<std::pair<int32, BaseFloat> > > as the comparison type
   /// (default is std::less) so that the lowest-numbered frame, not the highest-numbered
   /// one, will be returned by top().
-  std::priority_queue<std::pair<int32, BaseFloat>,
-                      std::vector<std::pair<int32, BaseFloat> >,
-                      std::greater<std::pair<int32, BaseFloat> > > delta_weights_;
+  typedef std::priority_queue<std::pair<int32, BaseFloat>,
+                              std::vector<std::pair<int32, BaseFloat> >,
+                              std::greater<std::pair<int32, BaseFloat> > >
+      DeltaWeightsQueue;
+  DeltaWeightsQueue delta_weights_;
 
   /// this is only used for validating that the frame-weighting code is not buggy.
   std::vector<BaseFloat> current_frame_weight_debug_;
@@ -386,6 +415,11 @@ class OnlineIvectorFeature: public OnlineFeatureInterface {
   /// The following is only needed for diagnostics.
   double tot_ubm_loglike_;
 
+  /// UBM log-likelihoods computed in advance by OnlineIvectorBatchComputer;
+  /// row i is for frame ubm_log_likes_offset_ + i.
+  Matrix<BaseFloat> ubm_log_likes_;
+  int32 ubm_log_likes_offset_;
+
   /// Most recently estimated iVector, will have been
   /// estimated at the greatest time t where t <= num_frames_stats_ and
   /// t % info_.ivector_period == 0.
@@ -401,6 +435,37 @@ class OnlineIvectorFeature: public OnlineFeatureInterface {
 };
 
 
+/// OnlineIvectorBatchComputer is for programs that decode many streams at
+/// once, each with its own OnlineIvectorFeature.  Evaluating the UBM is the
+/// largest part of the cost of iVector extraction, and done for each stream
+/// separately it works on only a few frames at a time; this class evaluates it
+/// for the new frames of all the streams with one matrix multiplication, and
+/// caches the result in the OnlineIvectorFeature objects, whose GetFrame() then
+/// uses it.  The rest of the iVector estimation is still done per stream.
+class OnlineIvectorBatchComputer {
+ public:
+  /// All the OnlineIvectorFeature objects given to Compute() must have been
+  /// constructed with this same 'info'.
+  explicit OnlineIvectorBatchComputer(const OnlineIvectorExtractionInfo &info):
+      info_(info) { }
+
+  /// Computes the UBM log-likelihoods that features[i]->GetFrame(frames[i],
+  /// ...) will need, for all i, and caches them in features[i] (where they
+  /// replace anything cached by an earlier call).  Each frames[i] must be less than
+  /// features[i]->NumFramesReady().  The iVectors may differ very slightly
+  /// from those computed without this class, as the matrix multiplications
+  /// are done in larger batches.
+  void Compute(const std::vector<OnlineIvectorFeature*> &features,
+               const std::vector<int32> &frames);
+
+ private:
+  const OnlineIvectorExtractionInfo &info_;
+  // Temporaries, kept to avoid reallocating them.
+  Matrix<BaseFloat> feats_;
+  Matrix<BaseFloat> log_likes_;
+};
+
+
 struct OnlineSilenceWeightingConfig {
   std::string silence_phones_str;
   // The weighting factor that we apply to silence phones in the iVector
@@ -489,6 +554,15 @@ class OnlineSilenceWeighting {
       int32 num_frames_ready_in,
       std::vector<std::pair<int32, BaseFloat> > *delta_weights);
 
+  // Writes the weights already output for each frame, so that another object
+  // can carry on after ReadState() as this one would, e.g. in another process
+  // (see SingleUtteranceNnet3DecoderTpl::WriteState()).  The traceback is not
+  // written, as it refers to the decoder's tokens; the first call to
+  // ComputeCurrentTraceback() after ReadState() traces back all the way.
+  void WriteState(std::ostream &os, bool binary) const;
+
+  void ReadState(std::istream &is, bool binary);
+
  private:
   const TransitionModel &trans_model_;
   const OnlineSilenceWeightingConfig &config_;
@@ -25,80 +25,6 @@
 
 namespace kaldi {
 
-ThreadSynchronizer::ThreadSynchronizer():
-    abort_(false),
-    producer_waiting_(false),
-    consumer_waiting_(false),
-    num_errors_(0) {
-  producer_semaphore_.Signal();
-  consumer_semaphore_.Signal();
-}
-
-bool ThreadSynchronizer::Lock(ThreadType t) {
-  if (abort_)
-    return false;
-  if (t == ThreadSynchronizer::kProducer) {
-    producer_semaphore_.Wait();
-  } else {
-    consumer_semaphore_.Wait();
-  }
-  if (abort_)
-    return false;
-  mutex_.lock();
-  held_by_ = t;
-  if (abort_) {
-    mutex_.unlock();
-    return false;
-  } else {
-    return true;
-  }
-}
-
-bool ThreadSynchronizer::UnlockSuccess(ThreadType t) {
-  if (t == ThreadSynchronizer::kProducer) {
-    producer_semaphore_.Signal();  // next Lock won't wait.
-    if (consumer_waiting_) {
-      consumer_semaphore_.Signal();
-      consumer_waiting_ = false;
-    }
-  } else {
-    consumer_semaphore_.Signal(); // next Lock won't wait.
-    if (producer_waiting_) {
-      producer_semaphore_.Signal();
-      producer_waiting_ = false;
-    }
-
-  }
-  mutex_.unlock();
-  return !abort_;
-}
-
-bool ThreadSynchronizer::UnlockFailure(ThreadType t) {
-
-  KALDI_ASSERT(held_by_ == t && "Code error: unlocking a mutex you don't hold.");
-
-  if (t == ThreadSynchronizer::kProducer) {
-    KALDI_ASSERT(!producer_waiting_ && "code error.");
-    producer_waiting_ = true;
-  } else {
-    KALDI_ASSERT(!consumer_waiting_ && "code error.");
-    consumer_waiting_ = true;
-  }
-  mutex_.unlock();
-  return !abort_;
-}
-
-void ThreadSynchronizer::SetAbort() {
-  abort_ = true;
-  // we signal the semaphores just in case someone was waiting on either of
-  // them.
-  producer_semaphore_.Signal();
-  consumer_semaphore_.Signal();
-}
-
-ThreadSynchronizer::~ThreadSynchronizer() {
-}
-
 // static
 void OnlineNnet2DecodingThreadedConfig::Check() {
   KALDI_ASSERT(max_buffered_features > 1);
@@ -106,6 +32,8 @@ void OnlineNnet2DecodingThreadedConfig::Check() {
   KALDI_ASSERT(max_loglikes_copy >= 0);
   KALDI_ASSERT(nnet_batch_size > 0);
   KALDI_ASSERT(decode_batch_size >= 1);
+  KALDI_ASSERT(max_waveform_pieces > 0 && waveform_wakeup_batch > 0);
+  frame_skip_opts.Check();
 }
 
 
@@ -118,10 +46,13 @@ SingleUtteranceNnet2DecoderThreaded::SingleUtteranceNnet2DecoderThreaded(
     const OnlineIvectorExtractorAdaptationState &adaptation_state):
   config_(config), am_nnet_(am_nnet), tmodel_(tmodel), sampling_rate_(0.0),
   num_samples_received_(0), input_finished_(false),
+  waveform_queue_(config.max_waveform_pieces, config.waveform_wakeup_batch),
   feature_pipeline_(feature_info),
   num_samples_discarded_(0),
   silence_weighting_(tmodel, feature_info.silence_weighting_config),
-  decodable_(tmodel),
+  loglikes_queue_(std::max(1, config.max_buffered_features /
+                           config.nnet_batch_size)),
+  decodable_(tmodel, config.frame_skip_opts),
   num_frames_decoded_(0), decoder_(fst, config_.decoder_opts),
   abort_(false), error_(false) {
   // if the user supplies an adaptation state that was not freshly initialized,
@@ -145,10 +76,15 @@ SingleUtteranceNnet2DecoderThreaded::~SingleUtteranceNnet2DecoderThreaded() {
   // join all the threads (this avoids leaving zombie threads around, or threads
   // that might be accessing deconstructed object).
   WaitForAllThreads();
-  while (!input_waveform_.empty()) {
-    delete input_waveform_.front();
-    input_waveform_.pop_front();
-  }
+  if (config_.frame_skip_opts.max_skip > 0)
+    KALDI_VLOG(2) << "Frame-skipping dropped " << decodable_.NumFramesSkipped()
+                  << " frames; decoded " << num_frames_decoded_ << " frames.";
+  std::vector<Vector<BaseFloat>*> pending_waveform;
+  waveform_queue_.GetItems(&pending_waveform);
+  DeletePointers(&pending_waveform);
+  std::vector<Matrix<BaseFloat>*> pending_loglikes;
+  loglikes_queue_.GetItems(&pending_loglikes);
+  DeletePointers(&pending_loglikes);
   while (!processed_waveform_.empty()) {
     delete processed_waveform_.front();
     processed_waveform_.pop_front();
@@ -166,30 +102,15 @@ void SingleUtteranceNnet2DecoderThreaded::AcceptWaveform(
   num_samples_received_ += wave_part.Dim();
 
   if (wave_part.Dim() == 0) return;
-  if (!waveform_synchronizer_.Lock(ThreadSynchronizer::kProducer)) {
-    KALDI_ERR << "Failure locking mutex: decoding aborted.";
-  }
-
   Vector<BaseFloat> *new_part = new Vector<BaseFloat>(wave_part);
-  input_waveform_.push_back(new_part);
-  // we always unlock with success because there is no buffer size limitation
-  // for the waveform so no reason why we might wait.
-  waveform_synchronizer_.UnlockSuccess(ThreadSynchronizer::kProducer);
+  if (!waveform_queue_.Push(new_part)) {
+    delete new_part;
+    KALDI_ERR << "Failure giving waveform to the decoder: decoding aborted.";
+  }
 }
 
 int32 SingleUtteranceNnet2DecoderThreaded::NumWaveformPiecesPending() {
-  // Note RE locking: what we really want here is just to lock the mutex.  As a
-  // side effect, because of the way the synchronizer code works, it will also
-  // increment the semaphore and might wake up the consumer thread.  This will
-  // possibly make it do a little useless work (go around a loop once), but
-  // won't really do any harm.  Perhaps we should have implemented a version of
-  // the Lock function that takes no arguments.
-  if (!waveform_synchronizer_.Lock(ThreadSynchronizer::kProducer)) {
-    KALDI_ERR << "Failure locking mutex: decoding aborted.";
-  }
-  int32 ans = input_waveform_.size();
-  waveform_synchronizer_.UnlockSuccess(ThreadSynchronizer::kProducer);
-  return ans;
+  return waveform_queue_.Size();
 }
 
 
@@ -202,12 +123,9 @@ void SingleUtteranceNnet2DecoderThreaded::InputFinished() {
   // setting input_finished_ = true informs the feature-processing pipeline
   // to expect no more input, and to flush out the last few frames if there
   // is any latency in the pipeline (e.g. due to pitch).
-  if (!waveform_synchronizer_.Lock(ThreadSynchronizer::kProducer)) {
-    KALDI_ERR << "Failure locking mutex: decoding aborted.";
-  }
   KALDI_ASSERT(!input_finished_ && "InputFinished called twice");
   input_finished_ = true;
-  waveform_synchronizer_.UnlockSuccess(ThreadSynchronizer::kProducer);
+  waveform_queue_.Close();
 }
 
 void SingleUtteranceNnet2DecoderThreaded::TerminateDecoding() {
@@ -243,9 +161,11 @@ BaseFloat SingleUtteranceNnet2DecoderThreaded::GetRemainingWaveform(
     num_samples_stored += (*iter)->Dim();
     all_pieces.push_back(*iter);
   }
-  for (iter = input_waveform_.begin(); iter != input_waveform_.end(); ++iter) {
-    num_samples_stored += (*iter)->Dim();
-    all_pieces.push_back(*iter);
+  std::vector< Vector<BaseFloat>* > pending_pieces;
+  waveform_queue_.GetItems(&pending_pieces);
+  for (size_t i = 0; i < pending_pieces.size(); i++) {
+    num_samples_stored += pending_pieces[i]->Dim();
+    all_pieces.push_back(pending_pieces[i]);
   }
   int64 samples_shift_per_frame =
       sampling_rate_ * feature_pipeline_.FrameShiftInSeconds();
@@ -336,8 +256,8 @@ void SingleUtteranceNnet2DecoderThreaded::AbortAllThreads(bool error) {
   abort_ = true;
   if (error)
     error_ = true;
-  waveform_synchronizer_.SetAbort();
-  decodable_synchronizer_.SetAbort();
+  waveform_queue_.SetAbort();
+  loglikes_queue_.SetAbort();
 }
 
 int32 SingleUtteranceNnet2DecoderThreaded::NumFramesDecoded() const {
@@ -407,59 +327,52 @@ bool SingleUtteranceNnet2DecoderThreaded::FeatureComputation(
       num_frames_usable = num_frames_ready - num_frames_consumed;
   bool features_done = feature_pipeline_.IsLastFrame(num_frames_ready - 1);
   KALDI_ASSERT(num_frames_usable >= 0);
-  if (features_done) {
-    return true;  // nothing to do. (but not an error).
-  } else {
-    if (num_frames_usable >= config_.nnet_batch_size)
-      return true;  // We don't need more data yet.
-
-    // Now try to get more data, if we can.
-    if (!waveform_synchronizer_.Lock(ThreadSynchronizer::kConsumer)) {
-      return false;
-    }
-    // we've got the lock.
-    if (input_waveform_.empty()) {  // we got no data
-      if (input_finished_ &&
+  if (features_done || num_frames_usable >= config_.nnet_batch_size)
+    return true;  // nothing to do, or we don't need more data yet.
+
+  // Take enough of the waveform to give us a maximum nnet batch size of frames
+  // to decode, if it's there.  We only wait for more if we have no frames at
+  // all to evaluate.
+  while (num_frames_usable < config_.nnet_batch_size) {
+    Vector<BaseFloat> *piece;
+    bool got_piece = (num_frames_usable == 0 ?
+                      waveform_queue_.Pop(&piece) :
+                      waveform_queue_.TryPop(&piece));
+    if (!got_piece) {
+      if (waveform_queue_.Aborted())
+        return false;
+      if (waveform_queue_.Closed() && waveform_queue_.Size() == 0 &&
           !feature_pipeline_.IsLastFrame(feature_pipeline_.NumFramesReady()-1)) {
-        // the main thread called InputFinished() and set input_finished_, and
-        // we haven't yet registered that fact.  This is progress so
-        // unlock with UnlockSuccess().
+        // the main thread called InputFinished() and we have taken all of the
+        // waveform, and we haven't yet registered that fact.
         feature_pipeline_.InputFinished();
-        return waveform_synchronizer_.UnlockSuccess(ThreadSynchronizer::kConsumer);
-      } else {
-        // there is no progress.  Unlock with UnlockFailure() so the next call to
-        // waveform_synchronizer_.Lock() will lock.
-        return waveform_synchronizer_.UnlockFailure(ThreadSynchronizer::kConsumer);
+      } else if (waveform_queue_.Size() != 0) {
+        continue;  // more waveform arrived just before InputFinished().
       }
-    } else {  // we got some data.  Only take enough of the waveform to
-              // give us a maximum nnet batch size of frames to decode.
-      while (num_frames_usable < config_.nnet_batch_size &&
-             !input_waveform_.empty()) {
-        feature_pipeline_.AcceptWaveform(sampling_rate_, *input_waveform_.front());
-        processed_waveform_.push_back(input_waveform_.front());
-        input_waveform_.pop_front();
-        num_frames_ready = feature_pipeline_.NumFramesReady();
-        num_frames_usable = num_frames_ready - num_frames_consumed;
-      }
-      // Delete already-processed pieces of waveform if we have already decoded
-      // those frames.  (If not already decoded, we keep them around for the
-      // sake of GetRemainingWaveform()).
-      int32 samples_shift_per_frame =
-          sampling_rate_ * feature_pipeline_.FrameShiftInSeconds();
-      while (!processed_waveform_.empty() &&
-             num_samples_discarded_ + processed_waveform_.front()->Dim() <
-             samples_shift_per_frame * num_frames_decoded_) {
-        num_samples_discarded_ += processed_waveform_.front()->Dim();
-        delete processed_waveform_.front();
-        processed_waveform_.pop_front();
-      }
-      return waveform_synchronizer_.UnlockSuccess(ThreadSynchronizer::kConsumer);
+      break;
     }
+    feature_pipeline_.AcceptWaveform(sampling_rate_, *piece);
+    processed_waveform_.push_back(piece);
+    num_frames_ready = feature_pipeline_.NumFramesReady();
+    num_frames_usable = num_frames_ready - num_frames_consumed;
+  }
+  // Delete already-processed pieces of waveform if we have already decoded
+  // those frames.  (If not already decoded, we keep them around for the
+  // sake of GetRemainingWaveform()).
+  int32 samples_shift_per_frame =
+      sampling_rate_ * feature_pipeline_.FrameShiftInSeconds();
+  while (!processed_waveform_.empty() &&
+         num_samples_discarded_ + processed_waveform_.front()->Dim() <
+         samples_shift_per_frame * num_frames_decoded_) {
+    num_samples_discarded_ += processed_waveform_.front()->Dim();
+    delete processed_waveform_.front();
+    processed_waveform_.pop_front();
   }
+  return true;
 }
 
 bool SingleUtteranceNnet2DecoderThreaded::RunNnetEvaluationInternal() {
-  // if any of the Lock/Unlock functions return false, it's because AbortAllThreads()
+  // if any of the queue functions return false, it's because AbortAllThreads()
   // was called.
 
   // This object is responsible for keeping track of the context, and avoiding
@@ -553,49 +466,20 @@ bool SingleUtteranceNnet2DecoderThreaded::RunNnetEvaluationInternal() {
 
 
     // OK, at this point we may have some newly created log-likes and we want to
-    // give them to the decoding thread.
-
+    // give them to the decoding thread.  This waits if it's too far behind.
     int32 num_loglike_frames = loglikes.NumRows();
-
     if (num_loglike_frames != 0) {  // if we need to output some loglikes...
-      while (true) {
-        // we may have to grab and release the decodable mutex
-        // a few times before it's ready to accept the loglikes.
-        if (!decodable_synchronizer_.Lock(ThreadSynchronizer::kProducer))
-          return false;
-        int32 num_frames_decoded = num_frames_decoded_;
-        // we can't have output fewer frames than were decoded.
-        KALDI_ASSERT(num_frames_output >= num_frames_decoded);
-        if (num_frames_output - num_frames_decoded <= config_.max_loglikes_copy) {
-          // If we would have to copy fewer than config_.max_loglikes_copy
-          // previously output log-likelihoods inside the decodable object, then
-          // we go ahead and copy them to that object.
-          int32 frames_to_discard = num_frames_decoded_ -
-              decodable_.FirstAvailableFrame();
-          KALDI_ASSERT(frames_to_discard >= 0);
-          num_frames_output += num_loglike_frames;
-          decodable_.AcceptLoglikes(&loglikes, frames_to_discard);
-          if (!decodable_synchronizer_.UnlockSuccess(ThreadSynchronizer::kProducer))
-            return false;
-          break;  // break from the innermost while loop.
-        } else {
-          // There are too many frames already available to the decoder, that it
-          // hasn't processed yet, and we don't want them to have to be copied
-          // inside AcceptLoglikes(), so we wait for a bit.
-          // we want the next call to Lock to block until the decoder has
-          //  processed more frames.
-          if (!decodable_synchronizer_.UnlockFailure(ThreadSynchronizer::kProducer))
-            return false;
-        }
+      Matrix<BaseFloat> *loglikes_chunk = new Matrix<BaseFloat>();
+      loglikes_chunk->Swap(&loglikes);
+      num_frames_output += num_loglike_frames;
+      if (!loglikes_queue_.Push(loglikes_chunk)) {
+        delete loglikes_chunk;
+        return false;
       }
     }
     if (last_time) {
-      // Inform the decodable object that there will be no more input.
-      if (!decodable_synchronizer_.Lock(ThreadSynchronizer::kProducer))
-        return false;
-      decodable_.InputIsFinished();
-      if (!decodable_synchronizer_.UnlockSuccess(ThreadSynchronizer::kProducer))
-        return false;
+      // Inform the decoding thread that there will be no more input.
+      loglikes_queue_.Close();
       KALDI_ASSERT(num_frames_consumed == num_frames_output);
       return true;
     }
@@ -605,22 +489,23 @@ bool SingleUtteranceNnet2DecoderThreaded::RunNnetEvaluationInternal() {
 
 bool SingleUtteranceNnet2DecoderThreaded::RunDecoderSearchInternal() {
   int32 num_frames_decoded = 0;  // this is just a copy of decoder_->NumFramesDecoded();
-  while (true) {  // decode at most one frame each loop.
-    if (!decodable_synchronizer_.Lock(ThreadSynchronizer::kConsumer))
-      return false; // AbortAllThreads() called.
+  while (true) {  // decode at most decode_batch_size frames each loop.
     if (decodable_.NumFramesReady() <= num_frames_decoded) {
-      // no frames available to decode.
+      // no frames available to decode, so wait for more log-likelihoods.
       KALDI_ASSERT(decodable_.NumFramesReady() == num_frames_decoded);
-      if (decodable_.IsLastFrame(num_frames_decoded - 1)) {
-        decodable_synchronizer_.UnlockSuccess(ThreadSynchronizer::kConsumer);
+      Matrix<BaseFloat> *loglikes;
+      if (!loglikes_queue_.Pop(&loglikes)) {
+        if (loglikes_queue_.Aborted())
+          return false;  // AbortAllThreads() called.
+        decodable_.InputIsFinished();
         return true;  // exit from this thread; we're done.
-      } else {
-        // we were not able to advance the decoding due to no available
-        // input.  The next call will ensure that the next call to
-        // decodable_synchronizer_.Lock() will wait.
-        if (!decodable_synchronizer_.UnlockFailure(ThreadSynchronizer::kConsumer))
-          return false;
       }
+      // we have decoded all the frames we had, so none of them have to be
+      // kept (and copied).
+      int32 frames_to_discard = num_frames_decoded -
+          decodable_.FirstAvailableFrame();
+      decodable_.AcceptLoglikes(loglikes, frames_to_discard);
+      delete loglikes;
     } else {
       // Decode at most config_.decode_batch_size frames (e.g. 1 or 2).
       decoder_mutex_.lock();
@@ -633,7 +518,7 @@ bool SingleUtteranceNnet2DecoderThreaded::RunDecoderSearchInternal() {
       }
       decoder_mutex_.unlock();
       num_frames_decoded_ = num_frames_decoded;
-      if (!decodable_synchronizer_.UnlockSuccess(ThreadSynchronizer::kConsumer))
+      if (loglikes_queue_.Aborted())
         return false;
     }
   }
@@ -23,6 +23,7 @@
 
 #include <string>
 #include <vector>
+#include <atomic>
 #include <deque>
 #include <mutex>
 #include <thread>
@@ -36,84 +37,13 @@
 #include "online2/online-endpoint.h"
 #include "decoder/lattice-faster-online-decoder.h"
 #include "hmm/transition-model.h"
-#include "util/kaldi-semaphore.h"
+#include "util/kaldi-thread.h"
 
 namespace kaldi {
 /// @addtogroup  onlinedecoding OnlineDecoding
 /// @{
 
 
-/**
-   class ThreadSynchronizer acts to guard an arbitrary type of buffer between a
-   producing and a consuming thread (note: it's all symmetric between the two
-   thread types).  It has a similar interface to a mutex, except that instead of
-   just Lock and Unlock, it has Lock, UnlockSuccess and UnlockFailure, and each
-   function takes an argument kProducer or kConsumer to identify whether the
-   producing or consuming thread is waiting.
-
-   The basic concept is that you lock the object; and if you discover the you're
-   blocked because you're either trying to read an empty buffer or trying to
-   write to a full buffer, you unlock with UnlockFailure; and this will cause
-   your next call to Lock to block until the *other* thread has called Lock and
-   then UnlockSuccess.  However, if at that point the other thread calls Lock
-   and then UnlockFailure, it is an error because you can't have both producing
-   and consuming threads claiming that the buffer is full/empty.  If you lock
-   the object and were successful you call UnlockSuccess; and you call
-   UnlockSuccess even if, for your own reasons, you ended up not changing the
-   state of the buffer.
-*/
-class ThreadSynchronizer {
- public:
-  ThreadSynchronizer();
-
-  // Most calls to this class should provide the thread-type of the caller,
-  // producing or consuming.  Actually the behavior of this class is symmetric
-  // between the two types of thread.
-  enum ThreadType { kProducer, kConsumer };
-
-  // All functions returning bool will return true normally, and false if
-  // SetAbort() was set; if they return false, you should probably call SetAbort()
-  // on any other ThreadSynchronizer classes you are using and then return from
-  // the thread.
-
-  // call this to lock the object being guarded.
-  bool Lock(ThreadType t);
-
-  // Call this to unlock the object being guarded, if you don't want the next call to
-  // Lock to stall.
-  bool UnlockSuccess(ThreadType t);
-
-  // Call this if you want the next call to Lock() to stall until the other
-  // (producer/consumer) thread has locked and then unlocked the mutex.  Note
-  // that, if the other thread then calls Lock and then UnlockFailure, this will
-  // generate a printed warning (and if repeated too many times, an exception).
-  bool UnlockFailure(ThreadType t);
-
-  // Sets abort_ flag so future calls will return false, and future calls to
-  // Lock() won't lock the mutex but will immediately return false.
-  void SetAbort();
-
-  ~ThreadSynchronizer();
-
- private:
-  bool abort_;
-  bool producer_waiting_;  // true if producer is/will be waiting on semaphore
-  bool consumer_waiting_;  // true if consumer is/will be waiting on semaphore
-  std::mutex mutex_;  // Locks the buffer object.
-  ThreadType held_by_;  // Record of which thread is holding the mutex (if
-                        // held); else undefined.  Used for validation of input.
-  Semaphore producer_semaphore_;  // The producer thread waits on this semaphore
-  Semaphore consumer_semaphore_;  // The consumer thread waits on this semaphore
-  int32 num_errors_;  // Rumber of times the threads alternated doing Lock() and
-                      // UnlockFailure().  This should not happen at all; but
-                      // it's more user-friendly to simply warn a few times; and then
-                      // only after a number of errors, to fail.
-  KALDI_DISALLOW_COPY_AND_ASSIGN(ThreadSynchronizer);
-};
-
-
-
-
 // This is the configuration class for SingleUtteranceNnet2DecoderThreaded.  The
 // actual command line program requires other configs that it creates
 // separately, and which are not included here: namely,
@@ -121,25 +51,22 @@ class ThreadSynchronizer {
 struct OnlineNnet2DecodingThreadedConfig {
 
   LatticeFasterDecoderConfig decoder_opts;
+  DecodableFrameSkipConfig frame_skip_opts;
 
   BaseFloat acoustic_scale;
 
-  int32 max_buffered_features;  // maximum frames of features we allow to be
-                                // held in the feature buffer before we block
-                                // the feature-processing thread.
+  int32 max_buffered_features;  // maximum frames of log-likelihoods we allow
+                                // to be waiting for the decoder-search thread
+                                // before we block the nnet-evaluation thread.
 
   int32 feature_batch_size;  // maximum number of frames at a time that we decode
                              // before unlocking the mutex.  The only real cost
                              // here is a mutex lock/unlock, so it's OK to make
                              // this fairly small.
-  int32 max_loglikes_copy;   // maximum unused frames of log-likelihoods we will
-                             // copy from the decodable object back into another
-                             // matrix to be supplied to the decodable object.
-                             // make this too large-> will block the
-                             // decoder-search thread while copying; too small
-                             // -> the nnet-evaluation thread may get blocked
-                             // for too long while waiting for the decodable
-                             // thread to be ready.
+  int32 max_loglikes_copy;   // no longer has any effect: the decoder-search
+                             // thread only takes more log-likelihoods once it
+                             // has decoded the ones it has, so they are never
+                             // copied.
   int32 nnet_batch_size;    // batch size (number of frames) we evaluate in the
                             // neural net, if this many is available.  To take
                             // best advantage of BLAS, you may want to set this
@@ -149,6 +76,15 @@ struct OnlineNnet2DecodingThreadedConfig {
                             // before unlocking the mutex.  The only real cost
                             // here is a mutex lock/unlock, so it's OK to make
                             // this fairly small.
+  int32 max_waveform_pieces;  // maximum number of pieces of waveform waiting
+                              // for the feature-processing thread before
+                              // AcceptWaveform() blocks.
+  int32 waveform_wakeup_batch;  // once the feature-processing thread is
+                                // waiting for waveform, the number of pieces
+                                // that must be waiting before it's woken
+                                // (or InputFinished() is called).  Larger
+                                // values mean fewer context switches but more
+                                // latency.
 
   OnlineNnet2DecodingThreadedConfig() {
     acoustic_scale = 0.1;
@@ -157,12 +93,15 @@ struct OnlineNnet2DecodingThreadedConfig {
     nnet_batch_size = 32;
     max_loglikes_copy = 20;
     decode_batch_size = 2;
+    max_waveform_pieces = 1000;
+    waveform_wakeup_batch = 1;
   }
 
   void Check();
 
   void Register(OptionsItf *opts) {
     decoder_opts.Register(opts);
+    frame_skip_opts.Register(opts);
     opts->Register("acoustic-scale", &acoustic_scale, "Scale used on acoustics "
                    "when decoding");
     opts->Register("max-buffered-features", &max_buffered_features, "Obscure "
@@ -175,15 +114,26 @@ struct OnlineNnet2DecodingThreadedConfig {
                    "setting, affects multi-threaded decoding.");
     opts->Register("decode-batch-sie", &decode_batch_size, "Obscure "
                    "setting, affects multi-threaded decoding.");
+    opts->Register("max-waveform-pieces", &max_waveform_pieces, "Maximum "
+                   "number of pieces of waveform waiting to be processed "
+                   "before AcceptWaveform() blocks.");
+    opts->Register("waveform-wakeup-batch", &waveform_wakeup_batch, "Number "
+                   "of pieces of waveform that must be waiting before the "
+                   "feature-processing thread is woken, if it was waiting; "
+                   "larger values mean fewer context switches but more "
+                   "latency.");
   }
 };
 
 /**
    You will instantiate this class when you want to decode a single
    utterance using the online-decoding setup for neural nets.  Each time this
-   class is created, it creates three background threads, and the feature
-   extraction, neural net evaluation, and search aspects of decoding all
-   happen in different threads.
+   class is created, it creates two background threads: the feature
+   extraction and neural net evaluation happen in one of them, and the search
+   in the other, while the waveform is supplied from the calling thread.  The
+   data is handed from each stage to the next through an SpscQueue (see
+   util/kaldi-thread.h), so a thread only blocks when it has nothing to do or
+   the next stage is too far behind.
    Note: we assume that all calls to its public interface happen from a single
    thread.
 */
@@ -205,7 +155,8 @@ class SingleUtteranceNnet2DecoderThreaded {
 
 
   /// You call this to provide this class with more waveform to decode.  This
-  /// call is, for all practical purposes, non-blocking.
+  /// call is, for all practical purposes, non-blocking (it only blocks if
+  /// config.max_waveform_pieces pieces are still waiting to be processed).
   void AcceptWaveform(BaseFloat samp_freq,
                       const VectorBase<BaseFloat> &wave_part);
 
@@ -327,7 +278,7 @@ class SingleUtteranceNnet2DecoderThreaded {
   // false on error; if it returns false, then we expect that the calling thread
   // will terminate.  This assumes the caller has already
   // locked feature_pipeline_mutex_.
-  bool FeatureComputation(int32 num_frames_output);
+  bool FeatureComputation(int32 num_frames_consumed);
 
 
   // this function runs the thread that does the neural-net evaluation.
@@ -352,17 +303,11 @@ class SingleUtteranceNnet2DecoderThreaded {
   // far via calls to AcceptWaveform.
   int64 num_samples_received_;
 
-  // The next two variables are written to by AcceptWaveform from the main
-  // thread, and read by the feature-processing thread; they are guarded by
-  // waveform_synchronizer_.  There is no bound on the buffer size here.
-  // Later-arriving data is appended to the vector.  When InputFinished() is
-  // called from the main thread, the main thread sets input_finished_ = true.
+  // The pieces of waveform given to AcceptWaveform() by the main thread, for
+  // the feature-processing thread.  InputFinished() closes the queue.
   // sampling_rate_ is only needed for checking that it matches the config.
   bool input_finished_;
-  std::deque< Vector<BaseFloat>* > input_waveform_;
-
-
-  ThreadSynchronizer waveform_synchronizer_;
+  SpscQueue<Vector<BaseFloat>*> waveform_queue_;
 
   // feature_pipeline_ is accessed by the nnet-evaluation thread, by the main
   // thread if GetAdaptionState() is called, and by the decoding thread via
@@ -372,7 +317,7 @@ class SingleUtteranceNnet2DecoderThreaded {
   std::mutex feature_pipeline_mutex_;
 
   // The next two variables are required only for implementation of the function
-  // GetRemainingWaveform().  After we take waveform from the input_waveform_
+  // GetRemainingWaveform().  After we take waveform from the waveform_queue_
   // queue to be processed into features, we put them onto this deque.  Then we
   // discard from this queue any that we can discard because we have already
   // decoded those frames (see num_frames_decoded_), and we increment
@@ -386,18 +331,19 @@ class SingleUtteranceNnet2DecoderThreaded {
   std::mutex silence_weighting_mutex_;
 
 
+  // The scaled log-likelihoods computed by the nnet-evaluation thread, in
+  // chunks of up to nnet_batch_size frames, for the decoder-search thread; the
+  // nnet-evaluation thread closes the queue after the last chunk.
+  SpscQueue<Matrix<BaseFloat>*> loglikes_queue_;
+
   // this Decodable object just stores a matrix of scaled log-likelihoods
-  // obtained by the nnet-evaluation thread.  It is produced by the
-  // nnet-evaluation thread and consumed by the decoder-search thread.  The
-  // decoding thread sets num_frames_decoded_ so the nnet-evaluation thread
-  // knows which frames of log-likelihoods it can discard.  Both of these
-  // variables are guarded by decodable_synchronizer_.  Note:
-  // the num_frames_decoded_ may be less than the current number of frames
-  // the decoder has decoded; the decoder thread sets this variable when it
-  // locks this mutex.
+  // taken from loglikes_queue_; it is only accessed by the decoder-search
+  // thread.  The decoding thread sets num_frames_decoded_ so the
+  // nnet-evaluation thread knows which pieces of waveform it can discard.
+  // Note: the num_frames_decoded_ may be less than the current number of
+  // frames the decoder has decoded.
   DecodableMatrixMappedOffset decodable_;
-  int32 num_frames_decoded_;
-  ThreadSynchronizer decodable_synchronizer_;
+  std::atomic<int32> num_frames_decoded_;
 
   // the decoder_ object contains everything related to the graph search.
   LatticeFasterOnlineDecoder decoder_;
@@ -128,6 +128,11 @@ void OnlineNnet2FeaturePipeline::GetFrame(int32 frame,
   return final_feature_->GetFrame(frame, feat);
 }
 
+void OnlineNnet2FeaturePipeline::GetFrames(const std::vector<int32> &frames,
+                                           MatrixBase<BaseFloat> *feats) {
+  final_feature_->GetFrames(frames, feats);
+}
+
 void OnlineNnet2FeaturePipeline::UpdateFrameWeights(
     const std::vector<std::pair<int32, BaseFloat> > &delta_weights,
     int32 frame_offset) {
@@ -160,6 +165,39 @@ void OnlineNnet2FeaturePipeline::GetAdaptationState(
 }
 
 
+void OnlineNnet2FeaturePipeline::WriteState(std::ostream &os,
+                                            bool binary) const {
+  if (pitch_ != NULL)
+    KALDI_ERR << "Writing the state of the feature pipeline is not supported "
+              << "with pitch features.";
+  WriteToken(os, binary, "<OnlineNnet2FeaturePipelineState>");
+  if (info_.feature_type == "mfcc")
+    static_cast<const OnlineMfcc*>(base_feature_)->WriteState(os, binary);
+  else if (info_.feature_type == "plp")
+    static_cast<const OnlinePlp*>(base_feature_)->WriteState(os, binary);
+  else
+    static_cast<const OnlineFbank*>(base_feature_)->WriteState(os, binary);
+  if (info_.use_ivectors)
+    ivector_feature_->WriteState(os, binary);
+  WriteToken(os, binary, "</OnlineNnet2FeaturePipelineState>");
+}
+
+void OnlineNnet2FeaturePipeline::ReadState(std::istream &is, bool binary) {
+  if (pitch_ != NULL)
+    KALDI_ERR << "Reading the state of the feature pipeline is not supported "
+              << "with pitch features.";
+  ExpectToken(is, binary, "<OnlineNnet2FeaturePipelineState>");
+  if (info_.feature_type == "mfcc")
+    static_cast<OnlineMfcc*>(base_feature_)->ReadState(is, binary);
+  else if (info_.feature_type == "plp")
+    static_cast<OnlinePlp*>(base_feature_)->ReadState(is, binary);
+  else
+    static_cast<OnlineFbank*>(base_feature_)->ReadState(is, binary);
+  if (info_.use_ivectors)
+    ivector_feature_->ReadState(is, binary);
+  ExpectToken(is, binary, "</OnlineNnet2FeaturePipelineState>");
+}
+
 OnlineNnet2FeaturePipeline::~OnlineNnet2FeaturePipeline() {
   // Note: the delete command only deletes pointers that are non-NULL.  Not all
   // of the pointers below will be non-NULL.
@@ -195,6 +195,8 @@ class OnlineNnet2FeaturePipeline: public OnlineFeatureInterface {
   virtual bool IsLastFrame(int32 frame) const;
   virtual int32 NumFramesReady() const;
   virtual void GetFrame(int32 frame, VectorBase<BaseFloat> *feat);
+  virtual void GetFrames(const std::vector<int32> &frames,
+                         MatrixBase<BaseFloat> *feats);
 
   /// If you are downweighting silence, you can call
   /// OnlineSilenceWeighting::GetDeltaWeights and supply the output to this
@@ -242,6 +244,18 @@ class OnlineNnet2FeaturePipeline: public OnlineFeatureInterface {
   /// rescoring the lattices, this may not be much of an issue.
   void InputFinished();
 
+  /// Writes the state of the feature extraction for this utterance so far
+  /// (the base features computed and any waveform not yet consumed, and the
+  /// iVector estimation state, if used), so that it can be carried on from
+  /// that point without the audio, e.g. in another process.  To do that,
+  /// construct a new object with the same 'info', call SetAdaptationState()
+  /// with the same adaptation state as this one was given (if any), and call
+  /// ReadState().  Not supported with pitch features.
+  void WriteState(std::ostream &os, bool binary) const;
+
+  /// Reads the state written by WriteState(), replacing the current state.
+  void ReadState(std::istream &is, bool binary);
+
   // This function returns the iVector-extracting part of the feature pipeline
   // (or NULL if iVectors are not being used); the pointer ownership is retained
   // by this object and not transferred to the caller.  This function is used in
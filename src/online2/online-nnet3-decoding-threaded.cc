@@ -0,0 +1,424 @@
+// online2/online-nnet3-decoding-threaded.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "online2/online-nnet3-decoding-threaded.h"
+#include "lat/lattice-functions.h"
+#include "lat/determinize-lattice-pruned.h"
+
+namespace kaldi {
+
+void OnlineNnet3DecodingThreadedConfig::Check() {
+  KALDI_ASSERT(max_buffered_chunks > 0);
+  KALDI_ASSERT(decode_batch_size >= 1);
+  KALDI_ASSERT(max_waveform_pieces > 0 && waveform_wakeup_batch > 0);
+}
+
+
+SingleUtteranceNnet3DecoderThreaded::SingleUtteranceNnet3DecoderThreaded(
+    const OnlineNnet3DecodingThreadedConfig &config,
+    const TransitionModel &tmodel,
+    const nnet3::DecodableNnetSimpleLoopedInfo &info,
+    const fst::Fst<fst::StdArc> &fst,
+    const OnlineNnet2FeaturePipelineInfo &feature_info,
+    const OnlineIvectorExtractorAdaptationState &adaptation_state):
+  config_(config), tmodel_(tmodel), info_(info), sampling_rate_(0.0),
+  num_samples_received_(0), input_finished_(false),
+  waveform_queue_(config.max_waveform_pieces, config.waveform_wakeup_batch),
+  feature_pipeline_(feature_info),
+  num_samples_discarded_(0),
+  silence_weighting_(tmodel, feature_info.silence_weighting_config,
+                     info.opts.frame_subsampling_factor),
+  loglikes_queue_(config.max_buffered_chunks),
+  decodable_(tmodel),
+  num_frames_decoded_(0), decoder_(fst, config_.decoder_opts),
+  endpoint_detector_(tmodel),
+  abort_(false), error_(false) {
+  config_.Check();
+  // if the user supplies an adaptation state that was not freshly initialized,
+  // it means that we take the adaptation state from the previous
+  // utterance(s)... this only makes sense if theose previous utterance(s) are
+  // believed to be from the same speaker.
+  feature_pipeline_.SetAdaptationState(adaptation_state);
+  // spawn threads.
+  threads_[0] = std::thread(RunNnetEvaluation, this);
+  decoder_.InitDecoding();
+  threads_[1] = std::thread(RunDecoderSearch, this);
+}
+
+
+SingleUtteranceNnet3DecoderThreaded::~SingleUtteranceNnet3DecoderThreaded() {
+  if (!abort_) {
+    // If we have not already started the process of aborting the threads, do so now.
+    bool error = false;
+    AbortAllThreads(error);
+  }
+  // join all the threads (this avoids leaving zombie threads around, or threads
+  // that might be accessing deconstructed object).
+  WaitForAllThreads();
+  std::vector<Vector<BaseFloat>*> pending_waveform;
+  waveform_queue_.GetItems(&pending_waveform);
+  DeletePointers(&pending_waveform);
+  std::vector<Matrix<BaseFloat>*> pending_loglikes;
+  loglikes_queue_.GetItems(&pending_loglikes);
+  DeletePointers(&pending_loglikes);
+  while (!processed_waveform_.empty()) {
+    delete processed_waveform_.front();
+    processed_waveform_.pop_front();
+  }
+}
+
+void SingleUtteranceNnet3DecoderThreaded::AcceptWaveform(
+    BaseFloat sampling_rate,
+    const VectorBase<BaseFloat> &wave_part) {
+  if (sampling_rate_ <= 0.0)
+    sampling_rate_ = sampling_rate;
+  else {
+    KALDI_ASSERT(sampling_rate == sampling_rate_);
+  }
+  num_samples_received_ += wave_part.Dim();
+
+  if (wave_part.Dim() == 0) return;
+  Vector<BaseFloat> *new_part = new Vector<BaseFloat>(wave_part);
+  if (!waveform_queue_.Push(new_part)) {
+    delete new_part;
+    KALDI_ERR << "Failure giving waveform to the decoder: decoding aborted.";
+  }
+}
+
+int32 SingleUtteranceNnet3DecoderThreaded::NumWaveformPiecesPending() {
+  return waveform_queue_.Size();
+}
+
+int32 SingleUtteranceNnet3DecoderThreaded::NumFramesReceivedApprox() const {
+  return num_samples_received_ /
+      (sampling_rate_ * feature_pipeline_.FrameShiftInSeconds());
+}
+
+void SingleUtteranceNnet3DecoderThreaded::InputFinished() {
+  KALDI_ASSERT(!input_finished_ && "InputFinished called twice");
+  input_finished_ = true;
+  waveform_queue_.Close();
+}
+
+void SingleUtteranceNnet3DecoderThreaded::TerminateDecoding() {
+  bool error = false;
+  AbortAllThreads(error);
+}
+
+void SingleUtteranceNnet3DecoderThreaded::Wait() {
+  if (!input_finished_ && !abort_) {
+    KALDI_ERR << "You cannot call Wait() before calling either InputFinished() "
+              << "or TerminateDecoding().";
+  }
+  WaitForAllThreads();
+}
+
+void SingleUtteranceNnet3DecoderThreaded::FinalizeDecoding() {
+  if (threads_[0].joinable()) {
+    KALDI_ERR << "It is an error to call FinalizeDecoding before Wait().";
+  }
+  decoder_.FinalizeDecoding();
+}
+
+BaseFloat SingleUtteranceNnet3DecoderThreaded::GetRemainingWaveform(
+    Vector<BaseFloat> *waveform) const {
+  if (threads_[0].joinable()) {
+    KALDI_ERR << "It is an error to call GetRemainingWaveform before Wait().";
+  }
+  int64 num_samples_stored = 0;  // number of samples we still have.
+  std::vector< Vector<BaseFloat>* > all_pieces(processed_waveform_.begin(),
+                                               processed_waveform_.end()),
+      pending_pieces;
+  waveform_queue_.GetItems(&pending_pieces);
+  all_pieces.insert(all_pieces.end(), pending_pieces.begin(),
+                    pending_pieces.end());
+  for (size_t i = 0; i < all_pieces.size(); i++)
+    num_samples_stored += all_pieces[i]->Dim();
+  // num_frames_decoded_ is after frame subsampling.
+  int64 samples_shift_per_frame =
+      sampling_rate_ * feature_pipeline_.FrameShiftInSeconds() *
+      info_.opts.frame_subsampling_factor;
+  int64 num_samples_to_discard = samples_shift_per_frame * num_frames_decoded_;
+  KALDI_ASSERT(num_samples_to_discard >= num_samples_discarded_);
+
+  // num_samp_discard is how many samples we must discard from our stored
+  // samples.
+  int64 num_samp_discard = std::min(num_samples_to_discard -
+                                    num_samples_discarded_, num_samples_stored),
+      num_samp_keep = num_samples_stored - num_samp_discard;
+  waveform->Resize(num_samp_keep, kUndefined);
+  int32 offset = 0;  // offset in output waveform.
+  for (size_t i = 0; i < all_pieces.size(); i++) {
+    Vector<BaseFloat> *this_piece = all_pieces[i];
+    int32 this_dim = this_piece->Dim();
+    if (num_samp_discard >= this_dim) {
+      num_samp_discard -= this_dim;
+    } else {
+      int32 this_dim_keep = this_dim - num_samp_discard;
+      waveform->Range(offset, this_dim_keep).CopyFromVec(
+          this_piece->Range(num_samp_discard, this_dim_keep));
+      offset += this_dim_keep;
+      num_samp_discard = 0;
+    }
+  }
+  KALDI_ASSERT(offset == num_samp_keep && num_samp_discard == 0);
+  return sampling_rate_;
+}
+
+void SingleUtteranceNnet3DecoderThreaded::GetAdaptationState(
+    OnlineIvectorExtractorAdaptationState *adaptation_state) {
+  std::lock_guard<std::mutex> lock(feature_pipeline_mutex_);
+  feature_pipeline_.GetAdaptationState(adaptation_state);
+}
+
+void SingleUtteranceNnet3DecoderThreaded::GetLattice(
+    bool end_of_utterance,
+    CompactLattice *clat,
+    BaseFloat *final_relative_cost) const {
+  clat->DeleteStates();
+  decoder_mutex_.lock();
+  if (final_relative_cost != NULL)
+    *final_relative_cost = decoder_.FinalRelativeCost();
+  if (decoder_.NumFramesDecoded() == 0) {
+    decoder_mutex_.unlock();
+    clat->SetFinal(clat->AddState(),
+                   CompactLatticeWeight::One());
+    return;
+  }
+  Lattice raw_lat;
+  decoder_.GetRawLattice(&raw_lat, end_of_utterance);
+  decoder_mutex_.unlock();
+
+  if (!config_.decoder_opts.determinize_lattice)
+    KALDI_ERR << "--determinize-lattice=false option is not supported at the moment";
+
+  BaseFloat lat_beam = config_.decoder_opts.lattice_beam;
+  DeterminizeLatticePhonePrunedWrapper(
+      tmodel_, &raw_lat, lat_beam, clat, config_.decoder_opts.det_opts);
+}
+
+void SingleUtteranceNnet3DecoderThreaded::GetBestPath(
+    bool end_of_utterance,
+    Lattice *best_path,
+    BaseFloat *final_relative_cost) const {
+  std::lock_guard<std::mutex> lock(decoder_mutex_);
+  if (decoder_.NumFramesDecoded() == 0) {
+    best_path->DeleteStates();
+    best_path->SetFinal(best_path->AddState(),
+                        LatticeWeight::One());
+    if (final_relative_cost != NULL)
+      *final_relative_cost = std::numeric_limits<BaseFloat>::infinity();
+  } else {
+    decoder_.GetBestPath(best_path,
+                         end_of_utterance);
+    if (final_relative_cost != NULL)
+      *final_relative_cost = decoder_.FinalRelativeCost();
+  }
+}
+
+void SingleUtteranceNnet3DecoderThreaded::AbortAllThreads(bool error) {
+  abort_ = true;
+  if (error)
+    error_ = true;
+  waveform_queue_.SetAbort();
+  loglikes_queue_.SetAbort();
+}
+
+int32 SingleUtteranceNnet3DecoderThreaded::NumFramesDecoded() const {
+  std::lock_guard<std::mutex> lock(decoder_mutex_);
+  return decoder_.NumFramesDecoded();
+}
+
+void SingleUtteranceNnet3DecoderThreaded::RunNnetEvaluation(
+    SingleUtteranceNnet3DecoderThreaded *me) {
+  try {
+    if (!me->RunNnetEvaluationInternal() && !me->abort_)
+      KALDI_ERR << "Returned abnormally and abort was not called";
+  } catch(const std::exception &e) {
+    KALDI_WARN << "Caught exception: " << e.what();
+    // if an error happened in one thread, we need to make sure the other
+    // threads can exit too.
+    bool error = true;
+    me->AbortAllThreads(error);
+  }
+}
+
+void SingleUtteranceNnet3DecoderThreaded::RunDecoderSearch(
+    SingleUtteranceNnet3DecoderThreaded *me) {
+  try {
+    if (!me->RunDecoderSearchInternal() && !me->abort_)
+      KALDI_ERR << "Returned abnormally and abort was not called";
+  } catch(const std::exception &e) {
+    KALDI_WARN << "Caught exception: " << e.what();
+    bool error = true;
+    me->AbortAllThreads(error);
+  }
+}
+
+void SingleUtteranceNnet3DecoderThreaded::WaitForAllThreads() {
+  for (int32 i = 0; i < 2; i++) {  // there are 2 spawned threads.
+    if (threads_[i].joinable())
+      threads_[i].join();
+  }
+  if (error_)
+    KALDI_ERR << "Error encountered during decoding.  See above.";
+}
+
+void SingleUtteranceNnet3DecoderThreaded::DiscardProcessedWaveform() {
+  // We keep the pieces whose frames have not been decoded yet, for the sake of
+  // GetRemainingWaveform().
+  int64 samples_shift_per_frame =
+      sampling_rate_ * feature_pipeline_.FrameShiftInSeconds() *
+      info_.opts.frame_subsampling_factor;
+  while (!processed_waveform_.empty() &&
+         num_samples_discarded_ + processed_waveform_.front()->Dim() <
+         samples_shift_per_frame * num_frames_decoded_) {
+    num_samples_discarded_ += processed_waveform_.front()->Dim();
+    delete processed_waveform_.front();
+    processed_waveform_.pop_front();
+  }
+}
+
+bool SingleUtteranceNnet3DecoderThreaded::RunNnetEvaluationInternal() {
+  // if any of the queue functions return false, it's because AbortAllThreads()
+  // was called.
+
+  // This object does the looped computation; we only use it to get the
+  // outputs, which we copy to the decoder-search thread.
+  nnet3::DecodableNnetLoopedOnline decodable_nnet(
+      info_, feature_pipeline_.InputFeature(),
+      feature_pipeline_.IvectorFeature());
+
+  // the number of frames (after subsampling) of log-likelihoods given to the
+  // decoder-search thread so far.
+  int32 num_frames_output = 0;
+  bool input_finished = false;
+  std::vector<std::pair<int32, BaseFloat> > delta_weights;
+
+  while (true) {
+    Matrix<BaseFloat> *loglikes = NULL;
+    bool done;
+    {
+      std::lock_guard<std::mutex> lock(feature_pipeline_mutex_);
+      // Take waveform until the network can output some more frames, waiting
+      // for it if necessary.
+      int32 num_frames_ready = decodable_nnet.NumFramesReady();
+      while (num_frames_ready == num_frames_output && !input_finished) {
+        Vector<BaseFloat> *piece;
+        if (waveform_queue_.Pop(&piece)) {
+          feature_pipeline_.AcceptWaveform(sampling_rate_, *piece);
+          processed_waveform_.push_back(piece);
+        } else if (waveform_queue_.Aborted()) {
+          return false;
+        } else {
+          // the main thread called InputFinished() and we have taken all of
+          // the waveform; this flushes out the last few frames.
+          feature_pipeline_.InputFinished();
+          input_finished = true;
+        }
+        num_frames_ready = decodable_nnet.NumFramesReady();
+      }
+
+      // take care of silence weighting, before we compute anything that uses
+      // the iVectors.
+      if (silence_weighting_.Active() &&
+          feature_pipeline_.IvectorFeature() != NULL) {
+        {
+          std::lock_guard<std::mutex> lock(silence_weighting_mutex_);
+          silence_weighting_.GetDeltaWeights(feature_pipeline_.NumFramesReady(),
+                                             &delta_weights);
+        }
+        feature_pipeline_.IvectorFeature()->UpdateFrameWeights(delta_weights);
+      }
+
+      if (num_frames_ready > num_frames_output) {
+        loglikes = new Matrix<BaseFloat>(num_frames_ready - num_frames_output,
+                                         decodable_nnet.NumIndices(),
+                                         kUndefined);
+        for (int32 i = 0; i < loglikes->NumRows(); i++) {
+          SubVector<BaseFloat> row(*loglikes, i);
+          decodable_nnet.GetOutputForFrame(num_frames_output + i, &row);
+        }
+        num_frames_output = num_frames_ready;
+      }
+      done = input_finished;
+      DiscardProcessedWaveform();
+    }
+
+    // Give the new log-likelihoods to the decoding thread; this waits if it's
+    // too far behind.
+    if (loglikes != NULL && !loglikes_queue_.Push(loglikes)) {
+      delete loglikes;
+      return false;
+    }
+    if (done) {
+      // Inform the decoding thread that there will be no more input.
+      loglikes_queue_.Close();
+      return true;
+    }
+  }
+}
+
+
+bool SingleUtteranceNnet3DecoderThreaded::RunDecoderSearchInternal() {
+  int32 num_frames_decoded = 0;  // this is just a copy of decoder_->NumFramesDecoded();
+  while (true) {  // decode at most decode_batch_size frames each loop.
+    if (decodable_.NumFramesReady() <= num_frames_decoded) {
+      // no frames available to decode, so wait for more log-likelihoods.
+      Matrix<BaseFloat> *loglikes;
+      if (!loglikes_queue_.Pop(&loglikes)) {
+        if (loglikes_queue_.Aborted())
+          return false;  // AbortAllThreads() called.
+        decodable_.InputIsFinished();
+        return true;  // exit from this thread; we're done.
+      }
+      // we have decoded all the frames we had, so none of them have to be
+      // kept (and copied).
+      int32 frames_to_discard = num_frames_decoded -
+          decodable_.FirstAvailableFrame();
+      decodable_.AcceptLoglikes(loglikes, frames_to_discard);
+      delete loglikes;
+    } else {
+      // Decode at most config_.decode_batch_size frames (e.g. 1 or 2).
+      decoder_mutex_.lock();
+      decoder_.AdvanceDecoding(&decodable_, config_.decode_batch_size);
+      num_frames_decoded = decoder_.NumFramesDecoded();
+      if (silence_weighting_.Active()) {
+        std::lock_guard<std::mutex> lock(silence_weighting_mutex_);
+        // the next function does not trace back all the way; it's very fast.
+        silence_weighting_.ComputeCurrentTraceback(decoder_);
+      }
+      decoder_mutex_.unlock();
+      num_frames_decoded_ = num_frames_decoded;
+      if (loglikes_queue_.Aborted())
+        return false;
+    }
+  }
+}
+
+bool SingleUtteranceNnet3DecoderThreaded::EndpointDetected(
+    const OnlineEndpointConfig &config) {
+  std::lock_guard<std::mutex> lock(decoder_mutex_);
+  BaseFloat output_frame_shift = feature_pipeline_.FrameShiftInSeconds() *
+      info_.opts.frame_subsampling_factor;
+  return endpoint_detector_.EndpointDetected(config, output_frame_shift,
+                                             decoder_);
+}
+
+}  // namespace kaldi
@@ -0,0 +1,295 @@
+// online2/online-nnet3-decoding-threaded.h
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_ONLINE2_ONLINE_NNET3_DECODING_THREADED_H_
+#define KALDI_ONLINE2_ONLINE_NNET3_DECODING_THREADED_H_
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "matrix/matrix-lib.h"
+#include "util/common-utils.h"
+#include "base/kaldi-error.h"
+#include "decoder/decodable-matrix.h"
+#include "nnet3/decodable-online-looped.h"
+#include "online2/online-nnet2-feature-pipeline.h"
+#include "online2/online-endpoint.h"
+#include "decoder/lattice-faster-online-decoder.h"
+#include "hmm/transition-model.h"
+#include "util/kaldi-thread.h"
+
+namespace kaldi {
+/// @addtogroup  onlinedecoding OnlineDecoding
+/// @{
+
+
+// This is the configuration class for SingleUtteranceNnet3DecoderThreaded.  The
+// actual command line program requires other configs that it creates
+// separately, and which are not included here: namely,
+// OnlineNnet2FeaturePipelineConfig, nnet3::NnetSimpleLoopedComputationOptions
+// (which include the acoustic scale) and OnlineEndpointConfig.
+struct OnlineNnet3DecodingThreadedConfig {
+
+  LatticeFasterDecoderConfig decoder_opts;
+
+  int32 max_buffered_chunks;  // maximum number of chunks of log-likelihoods
+                              // (each the output of one chunk of the looped
+                              // computation) we allow to be waiting for the
+                              // decoder-search thread before we block the
+                              // nnet-evaluation thread.
+  int32 decode_batch_size;  // maximum number of frames at a time that we decode
+                            // before unlocking the mutex.  The only real cost
+                            // here is a mutex lock/unlock, so it's OK to make
+                            // this fairly small.
+  int32 max_waveform_pieces;  // maximum number of pieces of waveform waiting
+                              // for the feature-processing thread before
+                              // AcceptWaveform() blocks.
+  int32 waveform_wakeup_batch;  // once the feature-processing thread is
+                                // waiting for waveform, the number of pieces
+                                // that must be waiting before it's woken
+                                // (or InputFinished() is called).
+
+  OnlineNnet3DecodingThreadedConfig() {
+    max_buffered_chunks = 4;
+    decode_batch_size = 2;
+    max_waveform_pieces = 1000;
+    waveform_wakeup_batch = 1;
+  }
+
+  void Check();
+
+  void Register(OptionsItf *opts) {
+    decoder_opts.Register(opts);
+    opts->Register("max-buffered-chunks", &max_buffered_chunks, "Maximum "
+                   "number of chunks of log-likelihoods waiting to be decoded "
+                   "before the neural net evaluation blocks.");
+    opts->Register("decode-batch-size", &decode_batch_size, "Obscure "
+                   "setting, affects multi-threaded decoding.");
+    opts->Register("max-waveform-pieces", &max_waveform_pieces, "Maximum "
+                   "number of pieces of waveform waiting to be processed "
+                   "before AcceptWaveform() blocks.");
+    opts->Register("waveform-wakeup-batch", &waveform_wakeup_batch, "Number "
+                   "of pieces of waveform that must be waiting before the "
+                   "feature-processing thread is woken, if it was waiting; "
+                   "larger values mean fewer context switches but more "
+                   "latency.");
+  }
+};
+
+/**
+   This is the nnet3 version of SingleUtteranceNnet2DecoderThreaded (see
+   online-nnet2-decoding-threaded.h), with the same interface.  It creates two
+   background threads: one does the feature extraction and the neural net
+   evaluation, using the looped computation as SingleUtteranceNnet3Decoder
+   does, and the other does the search; the waveform is supplied from the
+   calling thread.  The data is handed from each stage to the next through an
+   SpscQueue (see util/kaldi-thread.h).
+   Note: we assume that all calls to its public interface happen from a single
+   thread.
+*/
+class SingleUtteranceNnet3DecoderThreaded {
+ public:
+  // Constructor.  We create the feature_pipeline object inside this class,
+  // since access to it needs to be controlled by a mutex.  The feature_info
+  // and adaptation_state arguments are used to initialize the (locally owned)
+  // feature pipeline.  'info' must outlive this object.
+  SingleUtteranceNnet3DecoderThreaded(
+      const OnlineNnet3DecodingThreadedConfig &config,
+      const TransitionModel &tmodel,
+      const nnet3::DecodableNnetSimpleLoopedInfo &info,
+      const fst::Fst<fst::StdArc> &fst,
+      const OnlineNnet2FeaturePipelineInfo &feature_info,
+      const OnlineIvectorExtractorAdaptationState &adaptation_state);
+
+  /// You call this to provide this class with more waveform to decode.  This
+  /// call is, for all practical purposes, non-blocking (it only blocks if
+  /// config.max_waveform_pieces pieces are still waiting to be processed).
+  void AcceptWaveform(BaseFloat samp_freq,
+                      const VectorBase<BaseFloat> &wave_part);
+
+  /// Returns the number of pieces of waveform that are still waiting to be
+  /// processed.
+  int32 NumWaveformPiecesPending();
+
+  /// You call this to inform the class that no more waveform will be provided;
+  /// this allows it to flush out the last few frames of features, and is
+  /// necessary if you want to call Wait() to wait until all decoding is done.
+  /// After calling InputFinished() you cannot call AcceptWaveform any more.
+  void InputFinished();
+
+  /// You can call this if you don't want the decoding to proceed further with
+  /// this utterance.  You can call Wait() after calling this.
+  void TerminateDecoding();
+
+  /// This call will block until all the data has been decoded; it must only be
+  /// called after either InputFinished() has been called or TerminateDecoding() has
+  /// been called; otherwise, to call it is an error.
+  void Wait();
+
+  /// Finalizes the decoding.  Cleans up and prunes remaining tokens, so the
+  /// final lattice is faster to obtain.  It is an error to call this before
+  /// Wait().
+  void FinalizeDecoding();
+
+  /// Returns *approximately* (ignoring end effects), the number of frames of
+  /// features that we expect given the amount of data that the pipeline has
+  /// received via AcceptWaveform().  Note: this is before frame subsampling.
+  int32 NumFramesReceivedApprox() const;
+
+  /// Returns the number of frames currently decoded (after frame subsampling).
+  int32 NumFramesDecoded() const;
+
+  /// Gets the lattice; see SingleUtteranceNnet2DecoderThreaded::GetLattice().
+  void GetLattice(bool end_of_utterance,
+                  CompactLattice *clat,
+                  BaseFloat *final_relative_cost) const;
+
+  /// Outputs an FST corresponding to the single best path through the current
+  /// lattice; see SingleUtteranceNnet2DecoderThreaded::GetBestPath().
+  void GetBestPath(bool end_of_utterance,
+                   Lattice *best_path,
+                   BaseFloat *final_relative_cost) const;
+
+  /// This function calls OnlineEndpointDetector::EndpointDetected() from
+  /// online-endpoint.h, with the required arguments.
+  bool EndpointDetected(const OnlineEndpointConfig &config);
+
+  /// Outputs the adaptation state of the feature pipeline to
+  /// "adaptation_state".  You may only call this function after either calling
+  /// TerminateDecoding() or InputFinished, and then Wait().
+  void GetAdaptationState(OnlineIvectorExtractorAdaptationState *adaptation_state);
+
+  /// Gets the remaining, un-decoded part of the waveform and returns the sample
+  /// rate.  May only be called after Wait(); see
+  /// SingleUtteranceNnet2DecoderThreaded::GetRemainingWaveform().
+  BaseFloat GetRemainingWaveform(Vector<BaseFloat> *waveform_out) const;
+
+  ~SingleUtteranceNnet3DecoderThreaded();
+ private:
+
+  // This function will instruct all threads to abort operation as soon as they
+  // can safely do so.
+  void AbortAllThreads(bool error);
+
+  // This function waits for all the threads that have been spawned. It is
+  // called in the destructor and Wait(). If called twice it is not an error.
+  void WaitForAllThreads();
+
+  // this function runs the thread that does the feature extraction and
+  // neural-net evaluation. In case of failure, calls
+  // me->AbortAllThreads(true).
+  static void RunNnetEvaluation(SingleUtteranceNnet3DecoderThreaded *me);
+  // member-function version of RunNnetEvaluation, called by RunNnetEvaluation.
+  bool RunNnetEvaluationInternal();
+  // Deletes the pieces of waveform in processed_waveform_ whose frames have
+  // been decoded.  Called from RunNnetEvaluationInternal().
+  void DiscardProcessedWaveform();
+
+  // this function runs the thread that does the decoder search.
+  // In case of failure, calls me->AbortAllThreads(true).
+  static void RunDecoderSearch(SingleUtteranceNnet3DecoderThreaded *me);
+  // member-function version of RunDecoderSearch, called by RunDecoderSearch.
+  bool RunDecoderSearchInternal();
+
+
+  // Member variables:
+
+  OnlineNnet3DecodingThreadedConfig config_;
+
+  const TransitionModel &tmodel_;
+
+  const nnet3::DecodableNnetSimpleLoopedInfo &info_;
+
+  // sampling_rate_ is set the first time AcceptWaveform is called.
+  BaseFloat sampling_rate_;
+  // A record of how many samples have been provided so
+  // far via calls to AcceptWaveform.
+  int64 num_samples_received_;
+
+  // The pieces of waveform given to AcceptWaveform() by the main thread, for
+  // the feature-processing thread.  InputFinished() closes the queue.
+  bool input_finished_;
+  SpscQueue<Vector<BaseFloat>*> waveform_queue_;
+
+  // feature_pipeline_ is accessed by the nnet-evaluation thread, and by the
+  // main thread if GetAdaptionState() is called.  It is guarded by
+  // feature_pipeline_mutex_.
+  OnlineNnet2FeaturePipeline feature_pipeline_;
+  std::mutex feature_pipeline_mutex_;
+
+  // The next two variables are required only for implementation of the
+  // function GetRemainingWaveform(); see the nnet2 version.
+  std::deque< Vector<BaseFloat>* > processed_waveform_;
+  int64 num_samples_discarded_;
+
+  // This object is used to control the (optional) downweighting of silence in
+  // iVector estimation, which is based on the decoder traceback.
+  OnlineSilenceWeighting silence_weighting_;
+  std::mutex silence_weighting_mutex_;
+
+  // The scaled log-likelihoods computed by the nnet-evaluation thread, for the
+  // decoder-search thread; the nnet-evaluation thread closes the queue after
+  // the last chunk.
+  SpscQueue<Matrix<BaseFloat>*> loglikes_queue_;
+
+  // this Decodable object stores the log-likelihoods taken from
+  // loglikes_queue_; it is only accessed by the decoder-search thread.  The
+  // decoding thread sets num_frames_decoded_ so the nnet-evaluation thread
+  // knows which pieces of waveform it can discard.
+  DecodableMatrixMappedOffset decodable_;
+  std::atomic<int32> num_frames_decoded_;
+
+  // the decoder_ object contains everything related to the graph search.
+  LatticeFasterOnlineDecoder decoder_;
+  // decoder_mutex_ guards the decoder_ and endpoint_detector_ objects.  It is
+  // usually held by the decoding thread, but is obtained by the main thread if
+  // you call functions like NumFramesDecoded(), GetLattice() and
+  // GetBestPath().
+  mutable std::mutex decoder_mutex_;
+
+  OnlineEndpointDetector endpoint_detector_;
+
+  // This contains the threads for the nnet-evaluation and decoder-search
+  // respectively.
+  std::thread threads_[2];
+
+  // This is set to true if AbortAllThreads was called for any reason, including
+  // if someone called TerminateDecoding().
+  bool abort_;
+
+  // This is set to true if any kind of unexpected error is encountered,
+  // including if exceptions are raised in any of the threads.
+  bool error_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(SingleUtteranceNnet3DecoderThreaded);
+};
+
+
+/// @} End of "addtogroup onlinedecoding"
+
+}  // namespace kaldi
+
+
+
+#endif  // KALDI_ONLINE2_ONLINE_NNET3_DECODING_THREADED_H_
@@ -25,6 +25,65 @@
 
 namespace kaldi {
 
+// Does the work of GetLattice() in the classes below when
+// decoder_opts.determinize_delay > 0.  'determinized_toks' are the tokens on
+// frame determinizer->NumFramesDeterminized(), in the order in which they were
+// given to it.
+template <typename FST>
+static void GetLatticeIncremental(
+    const LatticeFasterOnlineDecoderTpl<FST> &online_decoder,
+    const LatticeFasterDecoderConfig &decoder_opts,
+    bool end_of_utterance,
+    LatticeIncrementalDeterminizer *determinizer,
+    std::vector<decoder::BackpointerToken*> *determinized_toks,
+    CompactLattice *clat) {
+  typedef decoder::BackpointerToken Token;
+  int32 num_frames = online_decoder.NumFramesDecoded(),
+      delay = decoder_opts.determinize_delay;
+  Lattice raw_lat;
+  std::vector<LatticeArc::StateId> token_states;
+  unordered_map<Token*, LatticeArc::StateId> begin_states;
+
+  if (num_frames - determinizer->NumFramesDeterminized() >= 2 * delay) {
+    // Determinize the frames up to 'delay' frames ago, which are unlikely to
+    // be pruned any more.
+    int32 end_frame = num_frames - delay;
+    determinizer->InitializeRawLatticeChunk(&raw_lat, &token_states);
+    for (size_t i = 0; i < token_states.size(); i++)
+      if (token_states[i] != fst::kNoStateId)
+        begin_states[(*determinized_toks)[i]] = token_states[i];
+    std::vector<std::pair<Token*, LatticeArc::StateId> > end_toks;
+    if (online_decoder.GetRawLatticeChunk(
+            determinizer->NumFramesDeterminized(), end_frame, false,
+            begin_states, &raw_lat, &end_toks)) {
+      std::vector<std::pair<LatticeArc::StateId, BaseFloat> > end_states;
+      determinized_toks->clear();
+      for (size_t i = 0; i < end_toks.size(); i++) {
+        Token *tok = end_toks[i].first;
+        determinized_toks->push_back(tok);
+        // tot_cost plus the backward cost of the token is extra_cost plus
+        // the best cost, which is the same for all tokens.
+        end_states.push_back(std::make_pair(end_toks[i].second,
+                                            tok->extra_cost - tok->tot_cost));
+      }
+      if (!determinizer->AcceptRawLatticeChunk(end_frame, end_states,
+                                               &raw_lat))
+        determinized_toks->clear();
+    }
+  }
+
+  // Now the frames that have not been determinized.
+  determinizer->InitializeRawLatticeChunk(&raw_lat, &token_states);
+  begin_states.clear();
+  for (size_t i = 0; i < token_states.size(); i++)
+    if (token_states[i] != fst::kNoStateId)
+      begin_states[(*determinized_toks)[i]] = token_states[i];
+  online_decoder.GetRawLatticeChunk(determinizer->NumFramesDeterminized(),
+                                    num_frames, end_of_utterance, begin_states,
+                                    &raw_lat, NULL);
+  determinizer->GetLattice(&raw_lat, clat);
+}
+
 template <typename FST>
 SingleUtteranceNnet3DecoderTpl<FST>::SingleUtteranceNnet3DecoderTpl(
     const LatticeFasterDecoderConfig &decoder_opts,
@@ -37,7 +96,10 @@ SingleUtteranceNnet3DecoderTpl<FST>::SingleUtteranceNnet3DecoderTpl(
     trans_model_(trans_model),
     decodable_(trans_model_, info,
                features->InputFeature(), features->IvectorFeature()),
-    decoder_(fst, decoder_opts_) {
+    decoder_(fst, decoder_opts_),
+    determinizer_(trans_model, decoder_opts.lattice_beam,
+                  decoder_opts.det_opts),
+    endpoint_detector_(trans_model) {
   decoder_.InitDecoding();
 }
 
@@ -45,6 +107,9 @@ template <typename FST>
 void SingleUtteranceNnet3DecoderTpl<FST>::InitDecoding(int32 frame_offset) {
   decoder_.InitDecoding();
   decodable_.SetFrameOffset(frame_offset);
+  determinizer_.Init();
+  determinized_toks_.clear();
+  endpoint_detector_.Reset();
 }
 
 template <typename FST>
@@ -62,17 +127,44 @@ int32 SingleUtteranceNnet3DecoderTpl<FST>::NumFramesDecoded() const {
   return decoder_.NumFramesDecoded();
 }
 
+template <typename FST>
+void SingleUtteranceNnet3DecoderTpl<FST>::WriteState(std::ostream &os,
+                                                     bool binary) const {
+  WriteToken(os, binary, "<SingleUtteranceNnet3DecoderState>");
+  decodable_.WriteState(os, binary);
+  decoder_.WriteState(os, binary);
+  WriteToken(os, binary, "</SingleUtteranceNnet3DecoderState>");
+}
+
+template <typename FST>
+void SingleUtteranceNnet3DecoderTpl<FST>::ReadState(std::istream &is,
+                                                    bool binary) {
+  ExpectToken(is, binary, "<SingleUtteranceNnet3DecoderState>");
+  decodable_.ReadState(is, binary);
+  decoder_.ReadState(is, binary);
+  ExpectToken(is, binary, "</SingleUtteranceNnet3DecoderState>");
+  // The incremental determinization will start again from the first frame.
+  determinizer_.Init();
+  determinized_toks_.clear();
+  endpoint_detector_.Reset();
+}
+
 template <typename FST>
 void SingleUtteranceNnet3DecoderTpl<FST>::GetLattice(bool end_of_utterance,
                                              CompactLattice *clat) const {
   if (NumFramesDecoded() == 0)
     KALDI_ERR << "You cannot get a lattice if you decoded no frames.";
-  Lattice raw_lat;
-  decoder_.GetRawLattice(&raw_lat, end_of_utterance);
-
   if (!decoder_opts_.determinize_lattice)
     KALDI_ERR << "--determinize-lattice=false option is not supported at the moment";
 
+  if (decoder_opts_.determinize_delay > 0) {
+    GetLatticeIncremental(decoder_, decoder_opts_, end_of_utterance,
+                          &determinizer_, &determinized_toks_, clat);
+    return;
+  }
+  Lattice raw_lat;
+  decoder_.GetRawLattice(&raw_lat, end_of_utterance);
+
   BaseFloat lat_beam = decoder_opts_.lattice_beam;
   DeterminizeLatticePhonePrunedWrapper(
       trans_model_, &raw_lat, lat_beam, clat, decoder_opts_.det_opts);
@@ -90,13 +182,97 @@ bool SingleUtteranceNnet3DecoderTpl<FST>::EndpointDetected(
   BaseFloat output_frame_shift =
       input_feature_frame_shift_in_seconds_ *
       decodable_.FrameSubsamplingFactor();
-  return kaldi::EndpointDetected(config, trans_model_,
-                                 output_frame_shift, decoder_);
+  return endpoint_detector_.EndpointDetected(config, output_frame_shift,
+                                             decoder_);
+}
+
+
+template <typename FST>
+SingleUtteranceNnet3BatchDecoderTpl<FST>::SingleUtteranceNnet3BatchDecoderTpl(
+    const LatticeFasterDecoderConfig &decoder_opts,
+    const TransitionModel &trans_model,
+    nnet3::NnetBatchComputer *computer,
+    const FST &fst,
+    OnlineNnet2FeaturePipeline *features):
+    decoder_opts_(decoder_opts),
+    input_feature_frame_shift_in_seconds_(features->FrameShiftInSeconds()),
+    trans_model_(trans_model),
+    decodable_(trans_model_, computer,
+               features->InputFeature(), features->IvectorFeature()),
+    decoder_(fst, decoder_opts_),
+    determinizer_(trans_model, decoder_opts.lattice_beam,
+                  decoder_opts.det_opts),
+    endpoint_detector_(trans_model) {
+  decoder_.InitDecoding();
+}
+
+template <typename FST>
+void SingleUtteranceNnet3BatchDecoderTpl<FST>::InitDecoding(
+    int32 frame_offset) {
+  decoder_.InitDecoding();
+  decodable_.SetFrameOffset(frame_offset);
+  determinizer_.Init();
+  determinized_toks_.clear();
+  endpoint_detector_.Reset();
+}
+
+template <typename FST>
+void SingleUtteranceNnet3BatchDecoderTpl<FST>::AdvanceDecoding() {
+  decoder_.AdvanceDecoding(&decodable_);
+}
+
+template <typename FST>
+void SingleUtteranceNnet3BatchDecoderTpl<FST>::FinalizeDecoding() {
+  decoder_.FinalizeDecoding();
+}
+
+template <typename FST>
+int32 SingleUtteranceNnet3BatchDecoderTpl<FST>::NumFramesDecoded() const {
+  return decoder_.NumFramesDecoded();
+}
+
+template <typename FST>
+void SingleUtteranceNnet3BatchDecoderTpl<FST>::GetLattice(
+    bool end_of_utterance, CompactLattice *clat) const {
+  if (NumFramesDecoded() == 0)
+    KALDI_ERR << "You cannot get a lattice if you decoded no frames.";
+  if (!decoder_opts_.determinize_lattice)
+    KALDI_ERR << "--determinize-lattice=false option is not supported at the moment";
+
+  if (decoder_opts_.determinize_delay > 0) {
+    GetLatticeIncremental(decoder_, decoder_opts_, end_of_utterance,
+                          &determinizer_, &determinized_toks_, clat);
+    return;
+  }
+  Lattice raw_lat;
+  decoder_.GetRawLattice(&raw_lat, end_of_utterance);
+
+  BaseFloat lat_beam = decoder_opts_.lattice_beam;
+  DeterminizeLatticePhonePrunedWrapper(
+      trans_model_, &raw_lat, lat_beam, clat, decoder_opts_.det_opts);
+}
+
+template <typename FST>
+void SingleUtteranceNnet3BatchDecoderTpl<FST>::GetBestPath(
+    bool end_of_utterance, Lattice *best_path) const {
+  decoder_.GetBestPath(best_path, end_of_utterance);
+}
+
+template <typename FST>
+bool SingleUtteranceNnet3BatchDecoderTpl<FST>::EndpointDetected(
+    const OnlineEndpointConfig &config) {
+  BaseFloat output_frame_shift =
+      input_feature_frame_shift_in_seconds_ *
+      decodable_.FrameSubsamplingFactor();
+  return endpoint_detector_.EndpointDetected(config, output_frame_shift,
+                                             decoder_);
 }
 
 
-// Instantiate the template for the types needed.
+// Instantiate the templates for the types needed.
 template class SingleUtteranceNnet3DecoderTpl<fst::Fst<fst::StdArc> >;
 template class SingleUtteranceNnet3DecoderTpl<fst::GrammarFst>;
+template class SingleUtteranceNnet3BatchDecoderTpl<fst::Fst<fst::StdArc> >;
+template class SingleUtteranceNnet3BatchDecoderTpl<fst::GrammarFst>;
 
 }  // namespace kaldi
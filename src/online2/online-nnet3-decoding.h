@@ -27,6 +27,7 @@
 #include <deque>
 
 #include "nnet3/decodable-online-looped.h"
+#include "nnet3/decodable-online-batched.h"
 #include "matrix/matrix-lib.h"
 #include "util/common-utils.h"
 #include "base/kaldi-error.h"
@@ -34,6 +35,7 @@
 #include "online2/online-endpoint.h"
 #include "online2/online-nnet2-feature-pipeline.h"
 #include "decoder/lattice-faster-online-decoder.h"
+#include "lat/determinize-lattice-incremental.h"
 #include "hmm/transition-model.h"
 #include "hmm/posterior.h"
 
@@ -80,7 +82,10 @@ class SingleUtteranceNnet3DecoderTpl {
   /// (which will typically be desirable in an online-decoding context); if you
   /// want an un-scaled lattice, scale it using ScaleLattice() with the inverse
   /// of the acoustic weight.  "end_of_utterance" will be true if you want the
-  /// final-probs to be included.
+  /// final-probs to be included.  If decoder_opts.determinize_delay > 0, the
+  /// frames that are far enough behind are only determinized once (see
+  /// LatticeIncrementalDeterminizer), so calling this repeatedly during a long
+  /// utterance does not get slower and slower.
   void GetLattice(bool end_of_utterance,
                   CompactLattice *clat) const;
 
@@ -92,12 +97,26 @@ class SingleUtteranceNnet3DecoderTpl {
                    Lattice *best_path) const;
 
 
-  /// This function calls EndpointDetected from online-endpoint.h,
-  /// with the required arguments.
+  /// This function calls OnlineEndpointDetector::EndpointDetected() from
+  /// online-endpoint.h, with the required arguments.
   bool EndpointDetected(const OnlineEndpointConfig &config);
 
   const LatticeFasterOnlineDecoderTpl<FST> &Decoder() const { return decoder_; }
 
+  /// Writes the state of the decoding so far: the decoder's tokens and the
+  /// state of the neural net computation.  This is for moving a stream to
+  /// another process (or resuming it after a restart) without the audio
+  /// received so far.  The complete state of a stream is this together with
+  /// the state of the feature pipeline (OnlineNnet2FeaturePipeline::WriteState())
+  /// and, if used, of the silence weighting (OnlineSilenceWeighting::
+  /// WriteState()).  To resume, construct the pipeline and read its state,
+  /// then construct this object with the same models and graph and call
+  /// ReadState().  Must not be called after FinalizeDecoding().
+  void WriteState(std::ostream &os, bool binary) const;
+
+  /// Reads the state written by WriteState(), replacing the current state.
+  void ReadState(std::istream &is, bool binary);
+
   ~SingleUtteranceNnet3DecoderTpl() { }
  private:
 
@@ -115,11 +134,103 @@ class SingleUtteranceNnet3DecoderTpl {
 
   LatticeFasterOnlineDecoderTpl<FST> decoder_;
 
+  // These are used by GetLattice() if decoder_opts_.determinize_delay > 0;
+  // determinized_toks_ are the tokens on the last frame determinized.
+  mutable LatticeIncrementalDeterminizer determinizer_;
+  mutable std::vector<decoder::BackpointerToken*> determinized_toks_;
+
+  // Used by EndpointDetected(), so it doesn't trace back the whole trailing
+  // silence each time.
+  OnlineEndpointDetector endpoint_detector_;
 };
 
 
 typedef SingleUtteranceNnet3DecoderTpl<fst::Fst<fst::StdArc> > SingleUtteranceNnet3Decoder;
 
+
+/**
+   This class has the same interface as SingleUtteranceNnet3DecoderTpl, but
+   instead of doing the neural net computation itself with the looped
+   computation, it gives it to a class nnet3::NnetBatchComputer that is shared
+   with many other decoders, e.g. one for each stream that a server is
+   decoding, so that the computation for all the streams is done in
+   minibatches.  See nnet3/decodable-online-batched.h for more information;
+   note that something, normally class nnet3::NnetBatchOnlineComputeThread,
+   must be servicing the NnetBatchComputer while this object is in use.  The
+   template will be instantiated only for FST = fst::Fst<fst::StdArc> and FST =
+   fst::GrammarFst.
+*/
+template <typename FST>
+class SingleUtteranceNnet3BatchDecoderTpl {
+ public:
+
+  // Constructor. The pointers 'computer' and 'features' are not being given to
+  // this class to own and deallocate, they are owned externally.
+  SingleUtteranceNnet3BatchDecoderTpl(
+      const LatticeFasterDecoderConfig &decoder_opts,
+      const TransitionModel &trans_model,
+      nnet3::NnetBatchComputer *computer,
+      const FST &fst,
+      OnlineNnet2FeaturePipeline *features);
+
+  /// See the same-named function in SingleUtteranceNnet3DecoderTpl.
+  void InitDecoding(int32 frame_offset = 0);
+
+  /// Advances the decoding as far as we can.  This blocks while the neural net
+  /// outputs are being computed.
+  void AdvanceDecoding();
+
+  /// Finalizes the decoding. Cleans up and prunes remaining tokens, so the
+  /// GetLattice() call will return faster.
+  void FinalizeDecoding();
+
+  int32 NumFramesDecoded() const;
+
+  /// See the same-named function in SingleUtteranceNnet3DecoderTpl.
+  void GetLattice(bool end_of_utterance,
+                  CompactLattice *clat) const;
+
+  /// See the same-named function in SingleUtteranceNnet3DecoderTpl.
+  void GetBestPath(bool end_of_utterance,
+                   Lattice *best_path) const;
+
+  /// This function calls OnlineEndpointDetector::EndpointDetected() from
+  /// online-endpoint.h, with the required arguments.
+  bool EndpointDetected(const OnlineEndpointConfig &config);
+
+  const LatticeFasterOnlineDecoderTpl<FST> &Decoder() const { return decoder_; }
+
+  ~SingleUtteranceNnet3BatchDecoderTpl() { }
+ private:
+
+  const LatticeFasterDecoderConfig &decoder_opts_;
+
+  // this is remembered from the constructor; it's ultimately
+  // derived from calling FrameShiftInSeconds() on the feature pipeline.
+  BaseFloat input_feature_frame_shift_in_seconds_;
+
+  // we need to keep a reference to the transition model around only because
+  // it's needed by the endpointing code.
+  const TransitionModel &trans_model_;
+
+  nnet3::DecodableAmNnetBatchedOnline decodable_;
+
+  LatticeFasterOnlineDecoderTpl<FST> decoder_;
+
+  // These are used by GetLattice() if decoder_opts_.determinize_delay > 0;
+  // determinized_toks_ are the tokens on the last frame determinized.
+  mutable LatticeIncrementalDeterminizer determinizer_;
+  mutable std::vector<decoder::BackpointerToken*> determinized_toks_;
+
+  // Used by EndpointDetected(), so it doesn't trace back the whole trailing
+  // silence each time.
+  OnlineEndpointDetector endpoint_detector_;
+};
+
+
+typedef SingleUtteranceNnet3BatchDecoderTpl<fst::Fst<fst::StdArc> >
+    SingleUtteranceNnet3BatchDecoder;
+
 /// @} End of "addtogroup onlinedecoding"
 
 }  // namespace kaldi
@@ -17,7 +17,10 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+
 #include "online2/online-timing.h"
+#include "util/kaldi-metrics.h"
 
 namespace kaldi {
 
@@ -43,6 +46,9 @@ void OnlineTimingStats::Print(bool online){
     }
     KALDI_LOG << "Longest delay was " << max_delay_ << " seconds for utterance "
               << '\'' << max_delay_utt_ << '\'';
+    KALDI_LOG << "Delay percentiles: 50% " << DelayPercentile(0.5)
+              << ", 90% " << DelayPercentile(0.9) << ", 99% "
+              << DelayPercentile(0.99) << " seconds.";
   } else {
     // we have processed each utterance in one chunk.
     // the decoding code will have "pretended to wait" (using WaitUntil())
@@ -59,6 +65,18 @@ void OnlineTimingStats::Print(bool online){
   }
 }
 
+double OnlineTimingStats::DelayPercentile(double percentile) const {
+  KALDI_ASSERT(percentile >= 0.0 && percentile <= 1.0);
+  if (delays_.empty())
+    return 0.0;
+  std::vector<double> sorted_delays(delays_);
+  size_t index = static_cast<size_t>(percentile * (sorted_delays.size() - 1) +
+                                     0.5);
+  std::nth_element(sorted_delays.begin(), sorted_delays.begin() + index,
+                   sorted_delays.end());
+  return sorted_delays[index];
+}
+
 OnlineTimer::OnlineTimer(const std::string &utterance_id):
     utterance_id_(utterance_id), waited_(0.0), utterance_length_(0.0) { }
 
@@ -111,11 +129,66 @@ void OnlineTimer::OutputStats(OnlineTimingStats *stats) {
   stats->total_audio_ += utterance_length_;
   stats->total_time_taken_ += processing_time;
   stats->total_time_waited_ += waited_;
+  stats->delays_.push_back(wait_time);
   if (wait_time > stats->max_delay_) {
     stats->max_delay_ = wait_time;
     stats->max_delay_utt_ = utterance_id_;
   }
+
+  // Export the same stats as metrics (see util/kaldi-metrics.h), for servers.
+  // The overall real-time factor is the ratio of the rates of increase of
+  // the processing and audio counters.
+  MetricsRegistry &registry = MetricsRegistry::Global();
+  static MetricsCounter *num_utts = registry.GetCounter(
+      "kaldi_online_utterances_total", "Number of utterances decoded online."),
+      *audio_seconds = registry.GetCounter(
+          "kaldi_online_audio_seconds_total",
+          "Total length of the audio decoded online, in seconds."),
+      *processing_seconds = registry.GetCounter(
+          "kaldi_online_processing_seconds_total",
+          "Total time taken to decode audio online, in seconds, including "
+          "the time spent waiting for audio."),
+      *idle_seconds = registry.GetCounter(
+          "kaldi_online_idle_seconds_total",
+          "Total time spent waiting for audio in online decoding, in seconds "
+          "(only for simulated waiting).");
+  static MetricsHistogram *real_time_factor = registry.GetHistogram(
+      "kaldi_online_real_time_factor",
+      "Real-time factor of each utterance decoded online.",
+      ExponentialBuckets(0.05, 1.5, 12)),
+      *delay = registry.GetHistogram(
+          "kaldi_online_end_delay_seconds",
+          "Delay at the end of each utterance decoded online, in seconds.",
+          ExponentialBuckets(0.01, 2.0, 12));
+  num_utts->Increment();
+  audio_seconds->Increment(utterance_length_);
+  processing_seconds->Increment(processing_time);
+  idle_seconds->Increment(waited_);
+  if (utterance_length_ > 0.0)
+    real_time_factor->Observe(processing_time / utterance_length_);
+  delay->Observe(wait_time);
+}
+
+
+void StartupTimer::Phase(const std::string &name) {
+  Add(name, phase_timer_.Elapsed());
+  phase_timer_.Reset();
 }
 
+void StartupTimer::Add(const std::string &name, double seconds) {
+  phases_.push_back(std::make_pair(name, seconds));
+  MetricsRegistry::Global().GetGauge(
+      "kaldi_online_startup_" + name + "_seconds",
+      "Time taken by the phase '" + name + "' of the startup of online "
+      "decoding, in seconds.")->Set(seconds);
+}
+
+void StartupTimer::Print() const {
+  std::ostringstream os;
+  for (size_t i = 0; i < phases_.size(); i++)
+    os << ' ' << phases_[i].first << '=' << phases_[i].second << 's';
+  KALDI_LOG << "Startup took " << total_timer_.Elapsed() << " seconds;"
+            << os.str();
+}
 
 }  // namespace kaldi
@@ -24,6 +24,7 @@
 #include <string>
 #include <vector>
 #include <deque>
+#include <utility>
 
 #include "base/timer.h"
 #include "base/kaldi-error.h"
@@ -45,6 +46,16 @@ class OnlineTimingStats {
   /// not-really-online mode where the chunk length was the whole file.  We need
   /// to change the way we interpret the stats and print results, in this case.
   void Print(bool online = true);
+
+  /// Returns the delay at utterance end (in seconds) below which the given
+  /// proportion of utterances fell, e.g. percentile = 0.9 for the 90th
+  /// percentile; this is for programs that want to export latency statistics
+  /// rather than just print them.  Returns zero if no utterances were seen.
+  double DelayPercentile(double percentile) const;
+
+  /// Returns the delay at utterance end (in seconds) of the most recent
+  /// utterance, or zero if none were seen.
+  double LastDelay() const { return delays_.empty() ? 0.0 : delays_.back(); }
  protected:
   friend class OnlineTimer;
   int32 num_utts_;
@@ -56,6 +67,8 @@ class OnlineTimingStats {
                              // called SleepUntil instead of WaitUntil().
   double max_delay_; // maximum delay at utterance end.
   std::string max_delay_utt_;
+  std::vector<double> delays_; // the delay at end of each utterance, in the
+                               // order they were seen.
 };
 
 
@@ -116,6 +129,45 @@ class OnlineTimer {
 };
 
 
+/// class StartupTimer times the phases of the startup of an online decoding
+/// program (reading the model and the FST, compiling the computation, and so
+/// on), for finding out where the time goes when cold-start latency matters.
+/// Usage:
+/// \code
+/// StartupTimer startup_timer;
+/// ... read the model ...
+/// startup_timer.Phase("read_model");
+/// ... compile ...
+/// startup_timer.Phase("compile");
+/// startup_timer.Print();
+/// \endcode
+/// Each phase is also exported as the gauge
+/// kaldi_online_startup_<name>_seconds in MetricsRegistry::Global(), so names
+/// should be valid in metric names.
+class StartupTimer {
+ public:
+  StartupTimer() { }
+
+  /// Records the time since the previous call to Phase(), or since this
+  /// object was created, as the time taken by phase 'name'.
+  void Phase(const std::string &name);
+
+  /// Records 'seconds' as the time taken by phase 'name'; this is for phases
+  /// timed separately, e.g. ones run in another thread, and does not affect
+  /// what the next call to Phase() records.
+  void Add(const std::string &name, double seconds);
+
+  /// Prints the time taken by each phase and the total time since this object
+  /// was created, using KALDI_LOG.
+  void Print() const;
+
+ private:
+  Timer total_timer_;
+  Timer phase_timer_;
+  std::vector<std::pair<std::string, double> > phases_;
+};
+
+
 /// @} End of "addtogroup onlinedecoding"
 }  // namespace kaldi
 
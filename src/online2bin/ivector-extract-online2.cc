@@ -25,6 +25,132 @@
 #include "util/kaldi-thread.h"
 #include "base/timer.h"
 
+namespace kaldi {
+
+// The diagnostics accumulated over all speakers.
+struct IvectorExtractOnlineStats {
+  double tot_ubm_loglike, tot_objf_impr, tot_t, tot_length,
+      tot_length_utt_end;
+  int32 num_done;
+  IvectorExtractOnlineStats(): tot_ubm_loglike(0.0), tot_objf_impr(0.0),
+                               tot_t(0.0), tot_length(0.0),
+                               tot_length_utt_end(0.0), num_done(0) { }
+};
+
+// This class is used to process the speakers in parallel on several threads.
+// The utterances of a speaker have to be processed in order, as the
+// adaptation state is carried from one to the next, so each task is one
+// speaker.  The work happens in the operator (), the output (and the
+// accumulation of the diagnostics) happens in the destructor, which the
+// TaskSequencer calls in the order the tasks were started.  The
+// OnlineIvectorExtractionInfo, with the extractor and the UBM, is shared by
+// all the tasks and only read.
+class IvectorExtractOnlineSpeakerTask {
+ public:
+  IvectorExtractOnlineSpeakerTask(const OnlineIvectorExtractionInfo &info,
+                                  bool repeat,
+                                  const std::string &spk,
+                                  BaseFloatMatrixWriter *writer,
+                                  IvectorExtractOnlineStats *stats):
+      info_(info), repeat_(repeat), spk_(spk), writer_(writer),
+      stats_(stats) { }
+
+  // 'weights' may be NULL if we are not using frame weights; otherwise it
+  // is zero-padded or truncated to the number of frames.
+  void AddUtterance(const std::string &utt, const Matrix<BaseFloat> &feats,
+                    const Vector<BaseFloat> *weights) {
+    utts_.push_back(utt);
+    frames_.push_back(feats.NumRows());
+    feats_.push_back(feats);
+    weights_.resize(weights_.size() + 1);
+    if (weights != NULL) {
+      int32 T = feats.NumRows(), dim = std::min(T, weights->Dim());
+      weights_.back().Resize(T);
+      weights_.back().Range(0, dim).CopyFromVec(weights->Range(0, dim));
+    }
+  }
+
+  bool Empty() const { return utts_.empty(); }
+
+  void operator () () {
+    OnlineIvectorExtractorAdaptationState adaptation_state(info_);
+    size_t num_utts = utts_.size();
+    ivectors_.resize(num_utts);
+    ubm_loglike_.resize(num_utts);
+    objf_impr_.resize(num_utts);
+    for (size_t u = 0; u < num_utts; u++) {
+      const Matrix<BaseFloat> &feats = feats_[u];
+      OnlineMatrixFeature matrix_feature(feats);
+      OnlineIvectorFeature ivector_feature(info_, &matrix_feature);
+      ivector_feature.SetAdaptationState(adaptation_state);
+
+      if (weights_[u].Dim() != 0) {
+        std::vector<std::pair<int32, BaseFloat> > frame_weights;
+        for (int32 i = 0; i < feats.NumRows(); i++)
+          frame_weights.push_back(std::make_pair(i, weights_[u](i)));
+        ivector_feature.UpdateFrameWeights(frame_weights);
+      }
+
+      int32 T = feats.NumRows(),
+          n = (repeat_ ? 1 : info_.ivector_period),
+          num_ivectors = (T + n - 1) / n;
+      Matrix<BaseFloat> &ivectors = ivectors_[u];
+      ivectors.Resize(num_ivectors, ivector_feature.Dim());
+      for (int32 i = 0; i < num_ivectors; i++) {
+        int32 t = i * n;
+        SubVector<BaseFloat> ivector(ivectors, i);
+        ivector_feature.GetFrame(t, &ivector);
+      }
+      ubm_loglike_[u] = ivector_feature.UbmLogLikePerFrame();
+      objf_impr_[u] = ivector_feature.ObjfImprPerFrame();
+      ivector_feature.GetAdaptationState(&adaptation_state);
+    }
+    // The features are no longer needed; free them before we wait for the
+    // earlier tasks to be written out.
+    std::vector<Matrix<BaseFloat> >().swap(feats_);
+  }
+
+  ~IvectorExtractOnlineSpeakerTask() {
+    for (size_t u = 0; u < utts_.size(); u++) {
+      const Matrix<BaseFloat> &ivectors = ivectors_[u];
+      int32 num_ivectors = ivectors.NumRows(),
+          T = frames_[u];
+      // Update diagnostics.
+      stats_->tot_ubm_loglike += T * ubm_loglike_[u];
+      stats_->tot_objf_impr += T * objf_impr_[u];
+      stats_->tot_length_utt_end +=
+          T * ivectors.Row(num_ivectors - 1).Norm(2.0);
+      for (int32 i = 0; i < num_ivectors; i++)
+        stats_->tot_length += T * ivectors.Row(i).Norm(2.0) / num_ivectors;
+      stats_->tot_t += T;
+      KALDI_VLOG(2) << "For utterance " << utts_[u] << " of speaker " << spk_
+                    << ", UBM loglike/frame was " << ubm_loglike_[u]
+                    << ", iVector length (at utterance end) was "
+                    << ivectors.Row(num_ivectors-1).Norm(2.0)
+                    << ", objf improvement/frame from iVector estimation was "
+                    << objf_impr_[u];
+      writer_->Write(utts_[u], ivectors);
+      stats_->num_done++;
+    }
+  }
+ private:
+  const OnlineIvectorExtractionInfo &info_;
+  bool repeat_;
+  std::string spk_;
+  BaseFloatMatrixWriter *writer_;
+  IvectorExtractOnlineStats *stats_;
+  std::vector<std::string> utts_;
+  std::vector<int32> frames_;
+  std::vector<Matrix<BaseFloat> > feats_;
+  // Empty for utterances with no frame weights.
+  std::vector<Vector<BaseFloat> > weights_;
+  std::vector<Matrix<BaseFloat> > ivectors_;
+  std::vector<BaseFloat> ubm_loglike_;
+  std::vector<BaseFloat> objf_impr_;
+};
+
+}  // namespace kaldi
+
 int main(int argc, char *argv[]) {
   using namespace kaldi;
   typedef kaldi::int32 int32;
@@ -42,6 +168,8 @@ int main(int argc, char *argv[]) {
         "The iVectors are output as an archive of matrices, indexed by utterance-id;\n"
         "each row corresponds to an iVector.  If --repeat=true, outputs the whole matrix\n"
         "of iVectors, not just every (ivector-period)'th frame\n"
+        "With --num-threads > 1 the speakers are processed in parallel, sharing one\n"
+        "copy of the extractor and UBM; the output is in the same order as the input.\n"
         "The input features are the raw, non-cepstral-mean-normalized features, e.g. MFCC.\n"
         "\n"
         "Usage:  ivector-extract-online2 [options] <spk2utt-rspecifier> <feature-rspecifier> <ivector-wspecifier>\n"
@@ -54,14 +182,12 @@ int main(int argc, char *argv[]) {
     OnlineIvectorExtractionConfig ivector_config;
     ivector_config.Register(&po);
 
-    g_num_threads = 8;
+    TaskSequencerConfig sequencer_config;
     bool repeat = false;
     int32 length_tolerance = 0;
     std::string frame_weights_rspecifier;
 
-    po.Register("num-threads", &g_num_threads,
-                "Number of threads to use for computing derived variables "
-                "of iVector extractor, at process start-up.");
+    sequencer_config.Register(&po);
     po.Register("repeat", &repeat,
                 "If true, output the same number of iVectors as input frames "
                 "(including repeated data).");
@@ -82,10 +208,12 @@ int main(int argc, char *argv[]) {
         feature_rspecifier = po.GetArg(2),
         ivectors_wspecifier = po.GetArg(3);
 
-    double tot_ubm_loglike = 0.0, tot_objf_impr = 0.0, tot_t = 0.0,
-        tot_length = 0.0, tot_length_utt_end = 0.0;
-    int32 num_done = 0, num_err = 0;
+    int32 num_err = 0;
+    IvectorExtractOnlineStats stats;
 
+    // g_num_threads affects how ComputeDerivedVars is called when we read the
+    // extractor; we have always used at least 8 threads for that.
+    g_num_threads = std::max<int32>(8, sequencer_config.num_threads);
     ivector_config.use_most_recent_ivector = false;
     OnlineIvectorExtractionInfo ivector_info(ivector_config);
 
@@ -94,98 +222,63 @@ int main(int argc, char *argv[]) {
     RandomAccessBaseFloatVectorReader frame_weights_reader(frame_weights_rspecifier);
     BaseFloatMatrixWriter ivector_writer(ivectors_wspecifier);
 
-    for (; !spk2utt_reader.Done(); spk2utt_reader.Next()) {
-      std::string spk = spk2utt_reader.Key();
-      const std::vector<std::string> &uttlist = spk2utt_reader.Value();
-      OnlineIvectorExtractorAdaptationState adaptation_state(
-          ivector_info);
-      for (size_t i = 0; i < uttlist.size(); i++) {
-        std::string utt = uttlist[i];
-        if (!feature_reader.HasKey(utt)) {
-          KALDI_WARN << "Did not find audio for utterance " << utt;
-          num_err++;
-          continue;
-        }
-        const Matrix<BaseFloat> &feats = feature_reader.Value(utt);
-
-        OnlineMatrixFeature matrix_feature(feats);
-
-        OnlineIvectorFeature ivector_feature(ivector_info,
-                                             &matrix_feature);
-
-        ivector_feature.SetAdaptationState(adaptation_state);
-
-        if (!frame_weights_rspecifier.empty()) {
-          if (!frame_weights_reader.HasKey(utt)) {
-            KALDI_WARN << "Did not find weights for utterance " << utt;
+    {
+      TaskSequencer<IvectorExtractOnlineSpeakerTask> sequencer(
+          sequencer_config);
+      for (; !spk2utt_reader.Done(); spk2utt_reader.Next()) {
+        std::string spk = spk2utt_reader.Key();
+        const std::vector<std::string> &uttlist = spk2utt_reader.Value();
+        IvectorExtractOnlineSpeakerTask *task =
+            new IvectorExtractOnlineSpeakerTask(ivector_info, repeat, spk,
+                                                &ivector_writer, &stats);
+        for (size_t i = 0; i < uttlist.size(); i++) {
+          std::string utt = uttlist[i];
+          if (!feature_reader.HasKey(utt)) {
+            KALDI_WARN << "Did not find audio for utterance " << utt;
             num_err++;
             continue;
           }
-          const Vector<BaseFloat> &weights = frame_weights_reader.Value(utt);
+          const Matrix<BaseFloat> &feats = feature_reader.Value(utt);
 
-          if (std::abs(weights.Dim() - feats.NumRows()) > length_tolerance) {
-            num_err++;
-            continue;
-          }
+          if (!frame_weights_rspecifier.empty()) {
+            if (!frame_weights_reader.HasKey(utt)) {
+              KALDI_WARN << "Did not find weights for utterance " << utt;
+              num_err++;
+              continue;
+            }
+            const Vector<BaseFloat> &weights = frame_weights_reader.Value(utt);
 
-          std::vector<std::pair<int32, BaseFloat> > frame_weights;
-          for (int32 i = 0; i < feats.NumRows(); i++) {
-            if (i < weights.Dim())
-              frame_weights.push_back(std::make_pair(i, weights(i)));
-            else
-              frame_weights.push_back(std::make_pair(i, 0.0));
+            if (std::abs(weights.Dim() - feats.NumRows()) > length_tolerance) {
+              num_err++;
+              continue;
+            }
+            task->AddUtterance(utt, feats, &weights);
+          } else {
+            task->AddUtterance(utt, feats, NULL);
           }
-
-
-          ivector_feature.UpdateFrameWeights(frame_weights);
-        }
-
-        int32 T = feats.NumRows(),
-            n = (repeat ? 1 : ivector_config.ivector_period),
-            num_ivectors = (T + n - 1) / n;
-
-        Matrix<BaseFloat> ivectors(num_ivectors,
-                                   ivector_feature.Dim());
-
-        for (int32 i = 0; i < num_ivectors; i++) {
-          int32 t = i * n;
-          SubVector<BaseFloat> ivector(ivectors, i);
-          ivector_feature.GetFrame(t, &ivector);
         }
-        // Update diagnostics.
-
-        tot_ubm_loglike += T * ivector_feature.UbmLogLikePerFrame();
-        tot_objf_impr += T * ivector_feature.ObjfImprPerFrame();
-        tot_length_utt_end += T * ivectors.Row(num_ivectors - 1).Norm(2.0);
-        for (int32 i = 0; i < num_ivectors; i++)
-          tot_length += T * ivectors.Row(i).Norm(2.0) / num_ivectors;
-        tot_t += T;
-        KALDI_VLOG(2) << "For utterance " << utt << " of speaker " << spk
-                      << ", UBM loglike/frame was "
-                      << ivector_feature.UbmLogLikePerFrame()
-                      << ", iVector length (at utterance end) was "
-                      << ivectors.Row(num_ivectors-1).Norm(2.0)
-                      << ", objf improvement/frame from iVector estimation was "
-                      << ivector_feature.ObjfImprPerFrame();
-
-        ivector_feature.GetAdaptationState(&adaptation_state);
-        ivector_writer.Write(utt, ivectors);
-        num_done++;
+        if (task->Empty())
+          delete task;
+        else
+          sequencer.Run(task);
       }
+      // Destructor of "sequencer" will wait for any remaining tasks.
     }
 
-    KALDI_LOG << "Estimated iVectors for " << num_done << " files, " << num_err
-              << " with errors.";
+    KALDI_LOG << "Estimated iVectors for " << stats.num_done << " files, "
+              << num_err << " with errors.";
     KALDI_LOG << "Average objective-function improvement was "
-              << (tot_objf_impr / tot_t) << " per frame, over "
-              << tot_t << " frames (weighted).";
-    KALDI_LOG << "Average iVector length was " << (tot_length / tot_t)
-              << " and at utterance-end was " << (tot_length_utt_end / tot_t)
-              << ", over " << tot_t << " frames (weighted); "
+              << (stats.tot_objf_impr / stats.tot_t) << " per frame, over "
+              << stats.tot_t << " frames (weighted).";
+    KALDI_LOG << "Average iVector length was "
+              << (stats.tot_length / stats.tot_t)
+              << " and at utterance-end was "
+              << (stats.tot_length_utt_end / stats.tot_t)
+              << ", over " << stats.tot_t << " frames (weighted); "
               << " expected length is "
               << sqrt(ivector_info.extractor.IvectorDim());
 
-    return (num_done != 0 ? 0 : 1);
+    return (stats.num_done != 0 ? 0 : 1);
   } catch(const std::exception &e) {
     std::cerr << e.what();
     return -1;
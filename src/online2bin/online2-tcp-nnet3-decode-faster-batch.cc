@@ -0,0 +1,867 @@
+// online2bin/online2-tcp-nnet3-decode-faster-batch.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "feat/wave-reader.h"
+#include "online2/online-nnet3-decoding.h"
+#include "online2/online-nnet2-feature-pipeline.h"
+#include "online2/onlinebin-util.h"
+#include "online2/online-timing.h"
+#include "online2/online-endpoint.h"
+#include "fstext/fstext-lib.h"
+#include "lat/lattice-functions.h"
+#include "util/kaldi-thread.h"
+#include "nnet3/nnet-utils.h"
+#include "nnet3/decodable-online-batched.h"
+
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <poll.h>
+#include <signal.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstring>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace kaldi {
+
+// Listens for clients on a TCP port.  The socket is non-blocking, so that
+// Accept() can be called from the event loop of class StreamServer.
+class TcpListener {
+ public:
+  TcpListener(): server_desc_(-1) { }
+  ~TcpListener();
+
+  bool Listen(int32 port, int32 backlog);  // start listening on a given port
+  int32 Accept();  // accept a client and return its descriptor, or -1
+  int32 Descriptor() const { return server_desc_; }
+
+ private:
+  int32 server_desc_;
+};
+
+// One client connection.  The audio is read from the socket by the event loop
+// of class StreamServer, which appends it here with AppendInput(); the
+// client's decoding thread takes it in chunks with ReadChunk() and writes the
+// transcripts back with Write().  So that a client that sends audio faster
+// than we can decode it doesn't make us buffer without limit, we stop reading
+// from its socket while more than 'max_buffered_samples' samples are waiting
+// (which makes TCP flow control slow down the client), and start again when
+// the decoding thread has caught up by half of that.
+class StreamSession {
+ public:
+  StreamSession(int32 client_desc, int32 epoll_desc, int32 session_id,
+                size_t max_buffered_samples, int read_timeout);
+  ~StreamSession();  // closes the socket.
+
+  // Called from the event loop when the socket is readable.  Returns false
+  // at end of stream (or on error), after which the socket has been removed
+  // from the event loop and this should not be called again.
+  bool AppendInput();
+
+  // Called from the decoding thread: waits until 'len' samples are available
+  // or the stream has ended (or --read-timeout has passed), and puts up to
+  // 'len' samples in 'chunk'.  Returns false if there was no more data.
+  // '*arrival_time' is set to the time, in seconds since the session started,
+  // at which the last sample of the chunk was received.
+  bool ReadChunk(size_t len, Vector<BaseFloat> *chunk, double *arrival_time);
+
+  bool Write(const std::string &msg); // write to the client
+  bool WriteLn(const std::string &msg, const std::string &eol = "\n"); // write line to the client
+
+  // Called from the decoding thread when it is done; makes the event loop see
+  // the end of the stream (if it hasn't already), so that it lets go of this
+  // object.
+  void Shutdown();
+
+  int32 Id() const { return session_id_; }
+  // Seconds since the session started.
+  double Elapsed() const { return timer_.Elapsed(); }
+
+ private:
+  // Adds the socket to the event loop, or removes it; called with mutex_
+  // held.
+  void StartReading();
+  void StopReading();
+
+  int32 client_desc_;
+  int32 epoll_desc_;
+  int32 session_id_;
+  size_t max_buffered_samples_;
+  int read_timeout_;
+  Timer timer_;
+
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::deque<int16> samples_;  // samples received and not yet read.
+  // For each AppendInput() call whose samples have not all been read: the
+  // number of samples received up to and including it (counting from the
+  // start of the session), and the time it happened.
+  std::deque<std::pair<int64, double> > arrivals_;
+  int64 num_samples_read_;  // number of samples taken by ReadChunk().
+  bool reading_;  // true if the socket is in the event loop.
+  bool ended_;  // true if we reached the end of the stream.
+  // If the client sent an odd number of bytes, the last one is kept here
+  // until the other half of the sample arrives.
+  bool has_odd_byte_;
+  char odd_byte_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(StreamSession);
+};
+
+// The things that are shared between all the streams.
+struct StreamDecodingInfo {
+  const OnlineNnet2FeaturePipelineInfo &feature_info;
+  const LatticeFasterDecoderConfig &decoder_opts;
+  const OnlineEndpointConfig &endpoint_opts;
+  const TransitionModel &trans_model;
+  nnet3::NnetBatchComputer *computer;
+  const fst::Fst<fst::StdArc> &decode_fst;
+  const fst::SymbolTable &word_syms;
+  BaseFloat chunk_length_secs;
+  BaseFloat output_period;
+  BaseFloat samp_freq;
+  int32 frame_subsampling;
+  int read_timeout;
+  bool produce_time;
+};
+
+std::string LatticeToString(const Lattice &lat, const fst::SymbolTable &word_syms) {
+  LatticeWeight weight;
+  std::vector<int32> alignment;
+  std::vector<int32> words;
+  GetLinearSymbolSequence(lat, &alignment, &words, &weight);
+
+  std::ostringstream msg;
+  for (size_t i = 0; i < words.size(); i++) {
+    std::string s = word_syms.Find(words[i]);
+    if (s.empty()) {
+      KALDI_WARN << "Word-id " << words[i] << " not in symbol table.";
+      msg << "<#" << std::to_string(i) << "> ";
+    } else
+      msg << s << " ";
+  }
+  return msg.str();
+}
+
+std::string GetTimeString(int32 t_beg, int32 t_end, BaseFloat time_unit) {
+  char buffer[100];
+  double t_beg2 = t_beg * time_unit;
+  double t_end2 = t_end * time_unit;
+  snprintf(buffer, 100, "%.2f %.2f", t_beg2, t_end2);
+  return std::string(buffer);
+}
+
+int32 GetLatticeTimeSpan(const Lattice& lat) {
+  std::vector<int32> times;
+  LatticeStateTimes(lat, &times);
+  return times.back();
+}
+
+std::string LatticeToString(const CompactLattice &clat, const fst::SymbolTable &word_syms) {
+  if (clat.NumStates() == 0) {
+    KALDI_WARN << "Empty lattice.";
+    return "";
+  }
+  CompactLattice best_path_clat;
+  CompactLatticeShortestPath(clat, &best_path_clat);
+
+  Lattice best_path_lat;
+  ConvertLattice(best_path_clat, &best_path_lat);
+  return LatticeToString(best_path_lat, word_syms);
+}
+
+// Decodes the audio from one client until it disconnects, sending back the
+// transcripts; this is the same as the main loop of
+// online2-tcp-nnet3-decode-faster.cc, except that the neural net computation
+// is done by the shared NnetBatchComputer.  At the end it logs the latency of
+// the session: for each chunk, the time from when its last sample arrived to
+// when the decoder had processed it (this includes any time the chunk was
+// queued because we were behind).
+void DecodeStream(const StreamDecodingInfo &info, StreamSession *session) {
+  BaseFloat frame_shift = info.feature_info.FrameShiftInSeconds();
+  int32 frame_subsampling = info.frame_subsampling;
+
+  int32 samp_count = 0;// this is used for output refresh rate
+  size_t chunk_len = static_cast<size_t>(info.chunk_length_secs *
+                                         info.samp_freq);
+  int32 check_period = static_cast<int32>(info.samp_freq * info.output_period);
+  int32 check_count = check_period;
+
+  int32 frame_offset = 0;
+
+  bool eos = false;
+
+  int64 num_chunks = 0;
+  double total_latency = 0.0, max_latency = 0.0, processing_time = 0.0;
+
+  OnlineNnet2FeaturePipeline feature_pipeline(info.feature_info);
+  SingleUtteranceNnet3BatchDecoder decoder(info.decoder_opts, info.trans_model,
+                                           info.computer, info.decode_fst,
+                                           &feature_pipeline);
+
+  while (!eos) {
+
+    decoder.InitDecoding(frame_offset);
+    OnlineSilenceWeighting silence_weighting(
+        info.trans_model,
+        info.feature_info.silence_weighting_config,
+        frame_subsampling);
+    std::vector<std::pair<int32, BaseFloat>> delta_weights;
+
+    while (true) {
+      Vector<BaseFloat> wave_part;
+      double arrival_time;
+      eos = !session->ReadChunk(chunk_len, &wave_part, &arrival_time);
+
+      if (eos) {
+        feature_pipeline.InputFinished();
+        decoder.AdvanceDecoding();
+        decoder.FinalizeDecoding();
+        frame_offset += decoder.NumFramesDecoded();
+        if (decoder.NumFramesDecoded() > 0) {
+          CompactLattice lat;
+          decoder.GetLattice(true, &lat);
+          std::string msg = LatticeToString(lat, info.word_syms);
+
+          // get time-span from previous endpoint to end of audio,
+          if (info.produce_time) {
+            int32 t_beg = frame_offset - decoder.NumFramesDecoded();
+            int32 t_end = frame_offset;
+            msg = GetTimeString(t_beg, t_end, frame_shift * frame_subsampling) + " " + msg;
+          }
+
+          KALDI_VLOG(1) << "EndOfAudio, sending message: " << msg;
+          session->WriteLn(msg);
+        } else
+          session->Write("\n");
+        break;
+      }
+
+      double start_time = session->Elapsed();
+      feature_pipeline.AcceptWaveform(info.samp_freq, wave_part);
+      samp_count += wave_part.Dim();
+
+      if (silence_weighting.Active() &&
+          feature_pipeline.IvectorFeature() != NULL) {
+        silence_weighting.ComputeCurrentTraceback(decoder.Decoder());
+        silence_weighting.GetDeltaWeights(feature_pipeline.NumFramesReady(),
+                                          &delta_weights);
+        feature_pipeline.UpdateFrameWeights(delta_weights,
+                                            frame_offset * frame_subsampling);
+      }
+
+      decoder.AdvanceDecoding();
+
+      double end_time = session->Elapsed(),
+          latency = end_time - arrival_time;
+      processing_time += end_time - start_time;
+      num_chunks++;
+      total_latency += latency;
+      max_latency = std::max(max_latency, latency);
+
+      if (samp_count > check_count) {
+        if (decoder.NumFramesDecoded() > 0) {
+          Lattice lat;
+          decoder.GetBestPath(false, &lat);
+          TopSort(&lat); // for LatticeStateTimes(),
+          std::string msg = LatticeToString(lat, info.word_syms);
+
+          // get time-span after previous endpoint,
+          if (info.produce_time) {
+            int32 t_beg = frame_offset;
+            int32 t_end = frame_offset + GetLatticeTimeSpan(lat);
+            msg = GetTimeString(t_beg, t_end, frame_shift * frame_subsampling) + " " + msg;
+          }
+
+          KALDI_VLOG(1) << "Temporary transcript: " << msg;
+          session->WriteLn(msg, "\r");
+        }
+        check_count += check_period;
+      }
+
+      if (decoder.EndpointDetected(info.endpoint_opts)) {
+        decoder.FinalizeDecoding();
+        frame_offset += decoder.NumFramesDecoded();
+        CompactLattice lat;
+        decoder.GetLattice(true, &lat);
+        std::string msg = LatticeToString(lat, info.word_syms);
+
+        // get time-span between endpoints,
+        if (info.produce_time) {
+          int32 t_beg = frame_offset - decoder.NumFramesDecoded();
+          int32 t_end = frame_offset;
+          msg = GetTimeString(t_beg, t_end, frame_shift * frame_subsampling) + " " + msg;
+        }
+
+        KALDI_VLOG(1) << "Endpoint, sending message: " << msg;
+        session->WriteLn(msg);
+        break; // while (true)
+      }
+    }
+  }
+  double audio_length = samp_count / info.samp_freq;
+  KALDI_LOG << "Session " << session->Id() << ": decoded " << audio_length
+            << " seconds of audio in " << processing_time
+            << " seconds of processing (real-time factor "
+            << (audio_length > 0.0 ? processing_time / audio_length : 0.0)
+            << "); latency per chunk was "
+            << (num_chunks > 0 ? total_latency / num_chunks : 0.0)
+            << " seconds on average and " << max_latency << " at most.";
+}
+
+// Accepts clients and reads their audio, for all of them in one thread using
+// epoll; each client is decoded in a thread of its own (see DecodeStream()),
+// which takes the audio from its StreamSession.  At most 'max_sessions'
+// clients are served at a time; while that many are connected we stop
+// accepting, so further clients wait in the listen queue.
+class StreamServer {
+ public:
+  StreamServer(const StreamDecodingInfo &info, int32 max_sessions,
+               size_t max_buffered_samples);
+  ~StreamServer();
+
+  // Runs the event loop; it does not return.
+  void Run(int32 port);
+
+ private:
+  // Accepts a client and starts its decoding thread.
+  void AcceptClient();
+
+  // Stops or starts watching the listening socket; called with
+  // slots_mutex_ held.
+  void StopAccepting();
+  void StartAccepting();
+
+  // Called by the decoding thread of a session when it finishes.
+  void SessionDone();
+
+  static void DecodeStreamThread(StreamServer *server,
+                                 std::shared_ptr<StreamSession> session);
+
+  const StreamDecodingInfo &info_;
+  int32 max_sessions_;
+  size_t max_buffered_samples_;
+  int32 epoll_desc_;
+  TcpListener listener_;
+  int32 next_session_id_;
+  // The sessions whose sockets are still open, indexed by descriptor.  Only
+  // the event loop uses this.
+  std::unordered_map<int32, std::shared_ptr<StreamSession> > sessions_;
+
+  std::mutex slots_mutex_;
+  int32 num_active_;  // the number of sessions that are being decoded.
+  bool accepting_;  // true if the listening socket is in the event loop.
+};
+
+}
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    using namespace fst;
+
+    typedef kaldi::int32 int32;
+    typedef kaldi::int64 int64;
+
+    const char *usage =
+        "Reads in audio from network sockets and performs online\n"
+        "decoding with neural nets (nnet3 setup), with iVector-based\n"
+        "speaker adaptation and endpointing.  Unlike\n"
+        "online2-tcp-nnet3-decode-faster, this serves up to --num-streams\n"
+        "clients at a time, sharing one copy of the model and graph: the\n"
+        "sockets are read by one thread using epoll, each client is decoded\n"
+        "in a thread of its own, and the neural net computation for all the\n"
+        "streams is done together in minibatches (see --minibatch-size and\n"
+        "--batch-max-wait).  Audio that a client sends faster than it can be\n"
+        "decoded is buffered up to --max-buffered-audio seconds, after which\n"
+        "we stop reading from the client until we catch up.  Note that this uses the 'simple' chunked neural\n"
+        "net computation, not the 'looped' one, so for recurrent models you\n"
+        "will want to set --extra-left-context, and the latency is about one\n"
+        "chunk (--frames-per-chunk) plus the model's right context.\n"
+        "Note: some configuration values and inputs are set via config\n"
+        "files whose filenames are passed as options\n"
+        "\n"
+        "Usage: online2-tcp-nnet3-decode-faster-batch [options] <nnet3-in> "
+        "<fst-in> <word-symbol-table>\n";
+
+    ParseOptions po(usage);
+
+
+    // feature_opts includes configuration for the iVector adaptation,
+    // as well as the basic features.
+    OnlineNnet2FeaturePipelineConfig feature_opts;
+    nnet3::NnetBatchComputerOptions compute_opts;
+    LatticeFasterDecoderConfig decoder_opts;
+    OnlineEndpointConfig endpoint_opts;
+
+    BaseFloat chunk_length_secs = 0.18;
+    BaseFloat output_period = 1;
+    BaseFloat samp_freq = 16000.0;
+    BaseFloat batch_max_wait = 0.02;
+    BaseFloat max_buffered_audio = 2.0;
+    int port_num = 5050;
+    int read_timeout = 3;
+    int32 num_streams = 32;
+    bool produce_time = false;
+    std::string use_gpu = "no";
+
+    // The default minibatch size of 128 is more suitable for offline use.
+    compute_opts.minibatch_size = 16;
+    compute_opts.edge_minibatch_size = 16;
+
+    po.Register("samp-freq", &samp_freq,
+                "Sampling frequency of the input signal (coded as 16-bit slinear).");
+    po.Register("chunk-length", &chunk_length_secs,
+                "Length of chunk size in seconds, that we process.");
+    po.Register("output-period", &output_period,
+                "How often in seconds, do we check for changes in output.");
+    po.Register("num-threads-startup", &g_num_threads,
+                "Number of threads used when initializing iVector extractor.");
+    po.Register("read-timeout", &read_timeout,
+                "Number of seconds of timout for TCP audio data to appear on the stream. Use -1 for blocking.");
+    po.Register("port-num", &port_num,
+                "Port number the server will listen on.");
+    po.Register("produce-time", &produce_time,
+                "Prepend begin/end times between endpoints (e.g. '5.46 6.81 <text_output>', in seconds)");
+    po.Register("num-streams", &num_streams,
+                "Maximum number of clients that are served at the same time; "
+                "further clients wait until a stream is free.");
+    po.Register("batch-max-wait", &batch_max_wait,
+                "Maximum time in seconds that we wait for a full minibatch "
+                "before we compute a partial one; this is the latency "
+                "budget for batching the streams' neural net computation.");
+    po.Register("max-buffered-audio", &max_buffered_audio,
+                "Maximum amount of audio, in seconds, that we buffer for a "
+                "client that sends it faster than we decode it; beyond this we "
+                "stop reading from its socket, so that TCP flow control slows "
+                "it down.");
+    po.Register("use-gpu", &use_gpu,
+                "yes|no|optional|wait, only has effect if compiled with CUDA");
+
+    feature_opts.Register(&po);
+    compute_opts.Register(&po);
+    decoder_opts.Register(&po);
+    endpoint_opts.Register(&po);
+#if HAVE_CUDA==1
+    CuDevice::RegisterDeviceOptions(&po);
+#endif
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 3) {
+      po.PrintUsage();
+      return 1;
+    }
+    if (num_streams <= 0)
+      KALDI_ERR << "--num-streams must be positive.";
+    if (max_buffered_audio < chunk_length_secs)
+      KALDI_ERR << "--max-buffered-audio must be at least --chunk-length.";
+
+#if HAVE_CUDA==1
+    CuDevice::Instantiate().AllowMultithreading();
+    CuDevice::Instantiate().SelectGpuId(use_gpu);
+#endif
+
+    std::string nnet3_rxfilename = po.GetArg(1),
+        fst_rxfilename = po.GetArg(2),
+        word_syms_filename = po.GetArg(3);
+
+    OnlineNnet2FeaturePipelineInfo feature_info(feature_opts);
+
+    KALDI_VLOG(1) << "Loading AM...";
+
+    TransitionModel trans_model;
+    nnet3::AmNnetSimple am_nnet;
+    {
+      bool binary;
+      Input ki(nnet3_rxfilename, &binary);
+      trans_model.Read(ki.Stream(), binary);
+      am_nnet.Read(ki.Stream(), binary);
+      SetBatchnormTestMode(true, &(am_nnet.GetNnet()));
+      SetDropoutTestMode(true, &(am_nnet.GetNnet()));
+      nnet3::CollapseModel(nnet3::CollapseModelConfig(), &(am_nnet.GetNnet()));
+      // Only "output" is used in decoding; this removes e.g. "output-xent".
+      nnet3::KeepOnlyOutputs("output", &(am_nnet.GetNnet()));
+    }
+
+    // This object does the neural net computation for all the streams, and
+    // contains the cache of compiled computations that they share.
+    nnet3::NnetBatchComputer computer(compute_opts, am_nnet.GetNnet(),
+                                      am_nnet.Priors());
+
+    KALDI_VLOG(1) << "Loading FST...";
+
+    fst::Fst<fst::StdArc> *decode_fst = ReadFstKaldiGeneric(fst_rxfilename);
+
+    fst::SymbolTable *word_syms = NULL;
+    if (!(word_syms = fst::SymbolTable::ReadText(word_syms_filename)))
+      KALDI_ERR << "Could not read symbol table from file "
+                << word_syms_filename;
+
+    StreamDecodingInfo info = {
+      feature_info, decoder_opts, endpoint_opts, trans_model, &computer,
+      *decode_fst, *word_syms, chunk_length_secs, output_period, samp_freq,
+      computer.GetOptions().frame_subsampling_factor, read_timeout,
+      produce_time };
+
+    signal(SIGPIPE, SIG_IGN); // ignore SIGPIPE to avoid crashing when socket forcefully disconnected
+
+    nnet3::NnetBatchOnlineComputeThread compute_thread(&computer,
+                                                       batch_max_wait);
+
+    StreamServer server(info, num_streams,
+                        static_cast<size_t>(max_buffered_audio * samp_freq));
+    server.Run(port_num);
+  } catch (const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+} // main()
+
+
+namespace kaldi {
+bool TcpListener::Listen(int32 port, int32 backlog) {
+  struct ::sockaddr_in h_addr;
+  h_addr.sin_addr.s_addr = INADDR_ANY;
+  h_addr.sin_port = htons(port);
+  h_addr.sin_family = AF_INET;
+
+  server_desc_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+
+  if (server_desc_ == -1) {
+    KALDI_ERR << "Cannot create TCP socket!";
+    return false;
+  }
+
+  int32 flag = 1;
+  int32 len = sizeof(int32);
+  if (setsockopt(server_desc_, SOL_SOCKET, SO_REUSEADDR, &flag, len) == -1) {
+    KALDI_ERR << "Cannot set socket options!";
+    return false;
+  }
+
+  if (bind(server_desc_, (struct sockaddr *) &h_addr, sizeof(h_addr)) == -1) {
+    KALDI_ERR << "Cannot bind to port: " << port << " (is it taken?)";
+    return false;
+  }
+
+  if (listen(server_desc_, backlog) == -1) {
+    KALDI_ERR << "Cannot listen on port!";
+    return false;
+  }
+
+  KALDI_LOG << "TcpListener: Listening on port: " << port;
+
+  return true;
+}
+
+TcpListener::~TcpListener() {
+  if (server_desc_ != -1)
+    close(server_desc_);
+}
+
+int32 TcpListener::Accept() {
+  struct sockaddr_storage addr;
+  socklen_t len = sizeof addr;
+  int32 client_desc = accept4(server_desc_, (struct sockaddr *) &addr, &len,
+                              SOCK_NONBLOCK);
+  if (client_desc == -1) {
+    if (errno != EAGAIN && errno != EWOULDBLOCK)
+      KALDI_WARN << "Failed to accept connection.";
+    return -1;
+  }
+
+  char ipstr[20];
+  struct sockaddr_in *s = (struct sockaddr_in *) &addr;
+  inet_ntop(AF_INET, &s->sin_addr, ipstr, sizeof ipstr);
+
+  KALDI_LOG << "Accepted connection from: " << ipstr;
+
+  return client_desc;
+}
+
+StreamSession::StreamSession(int32 client_desc, int32 epoll_desc,
+                             int32 session_id, size_t max_buffered_samples,
+                             int read_timeout):
+    client_desc_(client_desc), epoll_desc_(epoll_desc),
+    session_id_(session_id), max_buffered_samples_(max_buffered_samples),
+    read_timeout_(read_timeout), num_samples_read_(0), reading_(false),
+    ended_(false), has_odd_byte_(false), odd_byte_(0) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  StartReading();
+}
+
+StreamSession::~StreamSession() {
+  close(client_desc_);
+}
+
+void StreamSession::StartReading() {
+  struct epoll_event event;
+  event.events = EPOLLIN;
+  event.data.fd = client_desc_;
+  if (epoll_ctl(epoll_desc_, EPOLL_CTL_ADD, client_desc_, &event) == -1)
+    KALDI_ERR << "epoll_ctl failed to add a client socket.";
+  reading_ = true;
+}
+
+void StreamSession::StopReading() {
+  if (epoll_ctl(epoll_desc_, EPOLL_CTL_DEL, client_desc_, NULL) == -1)
+    KALDI_ERR << "epoll_ctl failed to remove a client socket.";
+  reading_ = false;
+}
+
+bool StreamSession::AppendInput() {
+  {
+    // We may get an event that was reported before we stopped reading.
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!reading_)
+      return !ended_;
+  }
+  char buf[65536];
+  ssize_t ret = read(client_desc_, static_cast<void*>(buf + 1),
+                     sizeof(buf) - 1);
+  if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+    return true;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (ret <= 0) {
+    if (ret < 0)
+      KALDI_WARN << "Socket error! Disconnecting...";
+    else
+      KALDI_VLOG(1) << "Stream over...";
+    StopReading();
+    ended_ = true;
+    cond_.notify_all();
+    return false;
+  }
+  // The samples start at buf + 1, or at buf if there was an odd byte left
+  // over from last time.
+  char *begin = buf + 1;
+  size_t num_bytes = ret;
+  if (has_odd_byte_) {
+    buf[0] = odd_byte_;
+    begin = buf;
+    num_bytes++;
+  }
+  size_t num_samples = num_bytes / sizeof(int16);
+  has_odd_byte_ = (num_bytes % sizeof(int16) != 0);
+  if (has_odd_byte_)
+    odd_byte_ = begin[num_bytes - 1];
+  if (num_samples == 0)
+    return true;
+  for (size_t i = 0; i < num_samples; i++) {
+    int16 sample;
+    memcpy(&sample, begin + i * sizeof(int16), sizeof(int16));
+    samples_.push_back(sample);
+  }
+  arrivals_.push_back(std::make_pair(num_samples_read_ + samples_.size(),
+                                     timer_.Elapsed()));
+  if (samples_.size() >= max_buffered_samples_) {
+    KALDI_VLOG(2) << "Session " << session_id_ << " is behind by "
+                  << samples_.size() << " samples; pausing input.";
+    StopReading();
+  }
+  cond_.notify_all();
+  return true;
+}
+
+bool StreamSession::ReadChunk(size_t len, Vector<BaseFloat> *chunk,
+                              double *arrival_time) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto ready = [this, len] { return samples_.size() >= len || ended_; };
+  if (read_timeout_ < 0) {
+    cond_.wait(lock, ready);
+  } else if (!cond_.wait_for(lock, std::chrono::seconds(read_timeout_),
+                             ready)) {
+    KALDI_WARN << "Socket timeout! Disconnecting...";
+  }
+  size_t num_samples = std::min(len, samples_.size());
+  chunk->Resize(num_samples, kUndefined);
+  for (size_t i = 0; i < num_samples; i++)
+    (*chunk)(i) = static_cast<BaseFloat>(samples_[i]);
+  samples_.erase(samples_.begin(), samples_.begin() + num_samples);
+  num_samples_read_ += num_samples;
+  // The first remaining entry of arrivals_ is then the one that received the
+  // last sample we took.
+  while (!arrivals_.empty() && arrivals_.front().first < num_samples_read_)
+    arrivals_.pop_front();
+  *arrival_time = (arrivals_.empty() ? timer_.Elapsed() :
+                   arrivals_.front().second);
+  if (!reading_ && !ended_ && samples_.size() <= max_buffered_samples_ / 2)
+    StartReading();
+  return num_samples > 0;
+}
+
+void StreamSession::Shutdown() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (ended_)
+    return;
+  // The event loop will see the end of the stream and let go of us; if we
+  // had stopped reading, we have to start again for it to see it.
+  shutdown(client_desc_, SHUT_RDWR);
+  if (!reading_)
+    StartReading();
+}
+
+bool StreamSession::Write(const std::string &msg) {
+
+  const char *p = msg.c_str();
+  size_t to_write = msg.size();
+  size_t wrote = 0;
+  while (to_write > 0) {
+    ssize_t ret = write(client_desc_, static_cast<const void *>(p + wrote), to_write);
+    if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      // The socket is non-blocking, so wait till the client reads some of
+      // what we sent.
+      pollfd client_set[1];
+      client_set[0].fd = client_desc_;
+      client_set[0].events = POLLOUT;
+      if (poll(client_set, 1, read_timeout_ < 0 ? -1 : 1000 * read_timeout_) <= 0)
+        return false;
+      continue;
+    }
+    if (ret <= 0)
+      return false;
+
+    to_write -= ret;
+    wrote += ret;
+  }
+
+  return true;
+}
+
+bool StreamSession::WriteLn(const std::string &msg, const std::string &eol) {
+  if (Write(msg))
+    return Write(eol);
+  else return false;
+}
+
+StreamServer::StreamServer(const StreamDecodingInfo &info, int32 max_sessions,
+                           size_t max_buffered_samples):
+    info_(info), max_sessions_(max_sessions),
+    max_buffered_samples_(max_buffered_samples), epoll_desc_(-1),
+    next_session_id_(0), num_active_(0), accepting_(false) {
+  epoll_desc_ = epoll_create1(0);
+  if (epoll_desc_ == -1)
+    KALDI_ERR << "Cannot create epoll instance.";
+}
+
+StreamServer::~StreamServer() {
+  sessions_.clear();
+  if (epoll_desc_ != -1)
+    close(epoll_desc_);
+}
+
+void StreamServer::StartAccepting() {
+  struct epoll_event event;
+  event.events = EPOLLIN;
+  event.data.fd = listener_.Descriptor();
+  if (epoll_ctl(epoll_desc_, EPOLL_CTL_ADD, listener_.Descriptor(),
+                &event) == -1)
+    KALDI_ERR << "epoll_ctl failed to add the listening socket.";
+  accepting_ = true;
+}
+
+void StreamServer::StopAccepting() {
+  if (epoll_ctl(epoll_desc_, EPOLL_CTL_DEL, listener_.Descriptor(),
+                NULL) == -1)
+    KALDI_ERR << "epoll_ctl failed to remove the listening socket.";
+  accepting_ = false;
+}
+
+void StreamServer::Run(int32 port) {
+  listener_.Listen(port, max_sessions_);
+  {
+    std::lock_guard<std::mutex> lock(slots_mutex_);
+    StartAccepting();
+  }
+  KALDI_LOG << "Waiting for clients...";
+  const int32 max_events = 64;
+  struct epoll_event events[max_events];
+  while (true) {
+    int32 num_events = epoll_wait(epoll_desc_, events, max_events, -1);
+    if (num_events == -1) {
+      if (errno == EINTR)
+        continue;
+      KALDI_ERR << "epoll_wait failed.";
+    }
+    for (int32 i = 0; i < num_events; i++) {
+      int32 desc = events[i].data.fd;
+      if (desc == listener_.Descriptor()) {
+        AcceptClient();
+        continue;
+      }
+      std::unordered_map<int32, std::shared_ptr<StreamSession> >::iterator
+          iter = sessions_.find(desc);
+      if (iter == sessions_.end())
+        continue;  // It ended earlier in this batch of events.
+      if (!iter->second->AppendInput())
+        sessions_.erase(iter);
+    }
+  }
+}
+
+void StreamServer::AcceptClient() {
+  int32 client_desc = listener_.Accept();
+  if (client_desc < 0)
+    return;
+  std::shared_ptr<StreamSession> session(
+      new StreamSession(client_desc, epoll_desc_, next_session_id_++,
+                        max_buffered_samples_, info_.read_timeout));
+  sessions_[client_desc] = session;
+  {
+    std::lock_guard<std::mutex> lock(slots_mutex_);
+    num_active_++;
+    if (num_active_ >= max_sessions_ && accepting_)
+      StopAccepting();
+  }
+  std::thread(DecodeStreamThread, this, session).detach();
+}
+
+void StreamServer::SessionDone() {
+  std::lock_guard<std::mutex> lock(slots_mutex_);
+  num_active_--;
+  if (num_active_ < max_sessions_ && !accepting_)
+    StartAccepting();
+}
+
+void StreamServer::DecodeStreamThread(StreamServer *server,
+                                      std::shared_ptr<StreamSession> session) {
+  try {
+    DecodeStream(server->info_, session.get());
+  } catch (const std::exception &e) {
+    // An error in one stream should not bring down the server.
+    KALDI_WARN << "Error decoding stream: " << e.what();
+  }
+  session->Shutdown();
+  server->SessionDone();
+}
+
+}  // namespace kaldi
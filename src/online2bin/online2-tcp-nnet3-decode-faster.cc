@@ -196,6 +196,8 @@ int main(int argc, char *argv[]) {
       SetBatchnormTestMode(true, &(am_nnet.GetNnet()));
       SetDropoutTestMode(true, &(am_nnet.GetNnet()));
       nnet3::CollapseModel(nnet3::CollapseModelConfig(), &(am_nnet.GetNnet()));
+      // Only "output" is used in decoding; this removes e.g. "output-xent".
+      nnet3::KeepOnlyOutputs("output", &(am_nnet.GetNnet()));
     }
 
     // this object contains precomputed stuff that is used by all decodable
@@ -18,6 +18,7 @@
 // limitations under the License.
 
 #include "feat/wave-reader.h"
+#include "feat/wave-segments.h"
 #include "online2/online-nnet2-decoding.h"
 #include "online2/online-nnet2-feature-pipeline.h"
 #include "online2/onlinebin-util.h"
@@ -62,6 +63,13 @@ int main(int argc, char *argv[]) {
     
     feature_config.Register(&po);
     
+    std::string segments_rxfilename;
+    po.Register("segments", &segments_rxfilename, "Segments file, with lines "
+                "<utterance-id> <recording-id> <start-time> <end-time> "
+                "[<channel>]; if given, the utterances are these segments of "
+                "the recordings in <wav-rspecifier>, and just the segments are "
+                "read if it is a script file (see extract-segments).");
+
     po.Read(argc, argv);
     
     if (!print_ivector_dim && po.NumArgs() != 3) {
@@ -85,7 +93,8 @@ int main(int argc, char *argv[]) {
     int64 num_frames_tot = 0;
     
     SequentialTokenVectorReader spk2utt_reader(spk2utt_rspecifier);
-    RandomAccessTableReader<WaveHolder> wav_reader(wav_rspecifier);
+    RandomAccessWaveSegmentReader wav_reader(wav_rspecifier,
+                                             segments_rxfilename);
     BaseFloatMatrixWriter feats_writer(feats_wspecifier);
     
     for (; !spk2utt_reader.Done(); spk2utt_reader.Next()) {
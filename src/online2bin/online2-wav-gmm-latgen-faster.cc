@@ -18,6 +18,7 @@
 // limitations under the License.
 
 #include "feat/wave-reader.h"
+#include "feat/wave-segments.h"
 #include "online2/online-feature-pipeline.h"
 #include "online2/online-gmm-decoding.h"
 #include "online2/onlinebin-util.h"
@@ -111,6 +112,13 @@ int main(int argc, char *argv[]) {
     decode_config.Register(&po);
     endpoint_config.Register(&po);
     
+    std::string segments_rxfilename;
+    po.Register("segments", &segments_rxfilename, "Segments file, with lines "
+                "<utterance-id> <recording-id> <start-time> <end-time> "
+                "[<channel>]; if given, the utterances are these segments of "
+                "the recordings in <wav-rspecifier>, and just the segments are "
+                "read if it is a script file (see extract-segments).");
+
     po.Read(argc, argv);
     
     if (po.NumArgs() != 4) {
@@ -142,7 +150,8 @@ int main(int argc, char *argv[]) {
     int64 num_frames = 0;
     
     SequentialTokenVectorReader spk2utt_reader(spk2utt_rspecifier);
-    RandomAccessTableReader<WaveHolder> wav_reader(wav_rspecifier);
+    RandomAccessWaveSegmentReader wav_reader(wav_rspecifier,
+                                             segments_rxfilename);
     CompactLatticeWriter clat_writer(clat_wspecifier);
     
     OnlineTimingStats timing_stats;
@@ -19,6 +19,7 @@
 // limitations under the License.
 
 #include "feat/wave-reader.h"
+#include "feat/wave-segments.h"
 #include "online2/online-nnet2-decoding.h"
 #include "online2/online-nnet2-feature-pipeline.h"
 #include "online2/onlinebin-util.h"
@@ -71,6 +72,13 @@ int main(int argc, char *argv[]) {
                 "--chunk-length=-1.");
     
     feature_config.Register(&po);
+    std::string segments_rxfilename;
+    po.Register("segments", &segments_rxfilename, "Segments file, with lines "
+                "<utterance-id> <recording-id> <start-time> <end-time> "
+                "[<channel>]; if given, the utterances are these segments of "
+                "the recordings in <wav-rspecifier>, and just the segments are "
+                "read if it is a script file (see extract-segments).");
+
     po.Read(argc, argv);
     if (po.NumArgs() != 4) {
       po.PrintUsage();
@@ -101,7 +109,8 @@ int main(int argc, char *argv[]) {
     
     int64 num_done = 0, num_frames = 0;
     SequentialTokenVectorReader spk2utt_reader(spk2utt_rspecifier);
-    RandomAccessTableReader<WaveHolder> wav_reader(wav_rspecifier);
+    RandomAccessWaveSegmentReader wav_reader(wav_rspecifier,
+                                             segments_rxfilename);
     BaseFloatCuMatrixWriter writer(features_or_loglikes_wspecifier);
     
     for (; !spk2utt_reader.Done(); spk2utt_reader.Next()) {
@@ -18,7 +18,10 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <future>
+
 #include "feat/wave-reader.h"
+#include "feat/wave-segments.h"
 #include "online2/online-nnet3-decoding.h"
 #include "online2/online-nnet2-feature-pipeline.h"
 #include "online2/onlinebin-util.h"
@@ -27,6 +30,8 @@
 #include "fstext/fstext-lib.h"
 #include "lat/lattice-functions.h"
 #include "util/kaldi-thread.h"
+#include "util/stl-utils.h"
+#include "util/text-utils.h"
 #include "nnet3/nnet-utils.h"
 
 namespace kaldi {
@@ -72,6 +77,28 @@ void GetDiagnosticsAndPrintOutput(const std::string &utt,
   }
 }
 
+// Returns the index of the chunk size to use for the next utterance, given
+// the index 'cur_index' used for the last one, where the chunk sizes are
+// sorted from smallest to largest.  A looped computation cannot change its
+// chunk size part way through an utterance, so this is decided per utterance.
+// If the last utterance fell behind ('last_delay', the delay at its end,
+// exceeded 'max_delay') or the CPU was overloaded (its real-time factor
+// exceeded 'max_real_time_factor'), we move to a larger chunk, which makes
+// better use of BLAS; if there was plenty of slack in both we move back to a
+// smaller chunk, for lower latency.  The thresholds for moving back are half
+// the limits, to avoid switching back and forth on every utterance.
+int32 ChooseChunkSizeIndex(int32 cur_index, int32 num_chunk_sizes,
+                           double last_delay, double last_real_time_factor,
+                           BaseFloat max_delay,
+                           BaseFloat max_real_time_factor) {
+  if (last_delay > max_delay || last_real_time_factor > max_real_time_factor)
+    return std::min(cur_index + 1, num_chunk_sizes - 1);
+  if (last_delay < 0.5 * max_delay &&
+      last_real_time_factor < 0.5 * max_real_time_factor)
+    return std::max(cur_index - 1, 0);
+  return cur_index;
+}
+
 }
 
 int main(int argc, char *argv[]) {
@@ -107,6 +134,8 @@ int main(int argc, char *argv[]) {
     BaseFloat chunk_length_secs = 0.18;
     bool do_endpointing = false;
     bool online = true;
+    std::string frames_per_chunk_list;
+    BaseFloat max_delay = 0.5, max_real_time_factor = 0.8;
 
     po.Register("chunk-length", &chunk_length_secs,
                 "Length of chunk size in seconds, that we process.  Set to <= 0 "
@@ -124,8 +153,30 @@ int main(int argc, char *argv[]) {
                 "--use-most-recent-ivector=true and --greedy-ivector-extractor=true "
                 "in the file given to --ivector-extraction-config, and "
                 "--chunk-length=-1.");
+    po.Register("frames-per-chunk-list", &frames_per_chunk_list,
+                "If set, a comma-separated list of values of --frames-per-chunk "
+                "(e.g. 20,40,80); a looped computation is compiled for each, "
+                "and the chunk size for each utterance is chosen from the delay "
+                "and real-time factor of the previous one (see --max-delay and "
+                "--max-real-time-factor).  Small chunks give lower latency, "
+                "large chunks are more efficient.");
+    po.Register("max-delay", &max_delay,
+                "With --frames-per-chunk-list, if the delay at the end of an "
+                "utterance exceeds this many seconds, use a larger chunk size "
+                "for the next one.");
+    po.Register("max-real-time-factor", &max_real_time_factor,
+                "With --frames-per-chunk-list, if the processing time of an "
+                "utterance divided by its length exceeds this, use a larger "
+                "chunk size for the next one.");
     po.Register("num-threads-startup", &g_num_threads,
                 "Number of threads used when initializing iVector extractor.");
+    bool parallel_startup = true;
+    po.Register("parallel-startup", &parallel_startup,
+                "If true, read the FST in a separate thread while the model "
+                "is read and its computations are compiled (not done if "
+                "either is read from the standard input).  A breakdown of "
+                "the startup time is logged either way; see also "
+                "--computation-cache-dir.");
 
     feature_opts.Register(&po);
     decodable_opts.Register(&po);
@@ -133,6 +184,13 @@ int main(int argc, char *argv[]) {
     endpoint_opts.Register(&po);
 
 
+    std::string segments_rxfilename;
+    po.Register("segments", &segments_rxfilename, "Segments file, with lines "
+                "<utterance-id> <recording-id> <start-time> <end-time> "
+                "[<channel>]; if given, the utterances are these segments of "
+                "the recordings in <wav-rspecifier>, and just the segments are "
+                "read if it is a script file (see extract-segments).");
+
     po.Read(argc, argv);
 
     if (po.NumArgs() != 5) {
@@ -146,7 +204,23 @@ int main(int argc, char *argv[]) {
         wav_rspecifier = po.GetArg(4),
         clat_wspecifier = po.GetArg(5);
 
+    StartupTimer startup_timer;
+    // The FST is usually the largest thing we read, and reading it does not
+    // depend on the model, so by default we read it in parallel.  (If we exit
+    // with an error before get(), the future's destructor waits for it.)
+    double read_fst_seconds = 0.0;
+    std::future<fst::Fst<fst::StdArc>*> decode_fst_future;
+    if (parallel_startup && fst_rxfilename != "-" && nnet3_rxfilename != "-") {
+      decode_fst_future = std::async(std::launch::async, [&]() {
+          Timer timer;
+          fst::Fst<fst::StdArc> *ans = ReadFstKaldiGeneric(fst_rxfilename);
+          read_fst_seconds = timer.Elapsed();
+          return ans;
+        });
+    }
+
     OnlineNnet2FeaturePipelineInfo feature_info(feature_opts);
+    startup_timer.Phase("feature_info");
 
     if (!online) {
       feature_info.ivector_extractor_info.use_most_recent_ivector = true;
@@ -161,32 +235,80 @@ int main(int argc, char *argv[]) {
       Input ki(nnet3_rxfilename, &binary);
       trans_model.Read(ki.Stream(), binary);
       am_nnet.Read(ki.Stream(), binary);
+      startup_timer.Phase("read_model");
       SetBatchnormTestMode(true, &(am_nnet.GetNnet()));
       SetDropoutTestMode(true, &(am_nnet.GetNnet()));
       nnet3::CollapseModel(nnet3::CollapseModelConfig(), &(am_nnet.GetNnet()));
+      // Only "output" is used in decoding; this removes e.g. "output-xent".
+      nnet3::KeepOnlyOutputs("output", &(am_nnet.GetNnet()));
+      startup_timer.Phase("collapse_model");
     }
 
-    // this object contains precomputed stuff that is used by all decodable
-    // objects.  It takes a pointer to am_nnet because if it has iVectors it has
-    // to modify the nnet to accept iVectors at intervals.
-    nnet3::DecodableNnetSimpleLoopedInfo decodable_info(decodable_opts,
-                                                        &am_nnet);
-
-
-    fst::Fst<fst::StdArc> *decode_fst = ReadFstKaldiGeneric(fst_rxfilename);
+    std::vector<int32> chunk_sizes;
+    if (frames_per_chunk_list.empty()) {
+      chunk_sizes.push_back(decodable_opts.frames_per_chunk);
+    } else if (!SplitStringToIntegers(frames_per_chunk_list, ",", false,
+                                      &chunk_sizes) || chunk_sizes.empty()) {
+      KALDI_ERR << "Invalid --frames-per-chunk-list option: '"
+                << frames_per_chunk_list << "'";
+    }
+    std::sort(chunk_sizes.begin(), chunk_sizes.end());
+    chunk_sizes.erase(std::unique(chunk_sizes.begin(), chunk_sizes.end()),
+                      chunk_sizes.end());
+    int32 num_chunk_sizes = chunk_sizes.size();
+
+    // These objects contain precomputed stuff that is used by all decodable
+    // objects, one for each chunk size.  They take a pointer to the nnet
+    // because if it has iVectors it has to be modified to accept iVectors at
+    // intervals of the chunk size; so in that case each chunk size after the
+    // first needs its own copy of the unmodified nnet.  They keep references to their
+    // options, so those are allocated first and not moved.
+    bool has_ivectors = (am_nnet.GetNnet().InputDim("ivector") > 0);
+    std::vector<nnet3::NnetSimpleLoopedComputationOptions> chunk_opts(
+        num_chunk_sizes, decodable_opts);
+    std::vector<nnet3::AmNnetSimple*> chunk_nnets(num_chunk_sizes, NULL);
+    std::vector<nnet3::DecodableNnetSimpleLoopedInfo*> decodable_infos(
+        num_chunk_sizes, NULL);
+    for (int32 i = 1; i < num_chunk_sizes; i++)  // copy before modifying.
+      if (has_ivectors)
+        chunk_nnets[i] = new nnet3::AmNnetSimple(am_nnet);
+    for (int32 i = 0; i < num_chunk_sizes; i++) {
+      chunk_opts[i].frames_per_chunk = chunk_sizes[i];
+      decodable_infos[i] = new nnet3::DecodableNnetSimpleLoopedInfo(
+          chunk_opts[i], chunk_nnets[i] != NULL ? chunk_nnets[i] : &am_nnet);
+      startup_timer.Phase("compile_chunk_" + std::to_string(chunk_sizes[i]));
+    }
+    // The index into 'chunk_sizes' used for the current utterance; we start
+    // with the smallest chunk size, for the lowest latency.
+    int32 chunk_size_index = 0;
+
+    fst::Fst<fst::StdArc> *decode_fst;
+    if (decode_fst_future.valid()) {
+      decode_fst = decode_fst_future.get();  // rethrows any error.
+      // Only the time we actually waited for the FST adds to the startup
+      // time.
+      startup_timer.Phase("wait_fst");
+      startup_timer.Add("read_fst", read_fst_seconds);
+    } else {
+      decode_fst = ReadFstKaldiGeneric(fst_rxfilename);
+      startup_timer.Phase("read_fst");
+    }
 
     fst::SymbolTable *word_syms = NULL;
     if (word_syms_rxfilename != "")
       if (!(word_syms = fst::SymbolTable::ReadText(word_syms_rxfilename)))
         KALDI_ERR << "Could not read symbol table from file "
                   << word_syms_rxfilename;
+    startup_timer.Phase("word_syms");
+    startup_timer.Print();
 
     int32 num_done = 0, num_err = 0;
     double tot_like = 0.0;
     int64 num_frames = 0;
 
     SequentialTokenVectorReader spk2utt_reader(spk2utt_rspecifier);
-    RandomAccessTableReader<WaveHolder> wav_reader(wav_rspecifier);
+    RandomAccessWaveSegmentReader wav_reader(wav_rspecifier,
+                                             segments_rxfilename);
     CompactLatticeWriter clat_writer(clat_wspecifier);
 
     OnlineTimingStats timing_stats;
@@ -216,10 +338,15 @@ int main(int argc, char *argv[]) {
             feature_info.silence_weighting_config,
             decodable_opts.frame_subsampling_factor);
 
+        const nnet3::DecodableNnetSimpleLoopedInfo &decodable_info =
+            *(decodable_infos[chunk_size_index]);
         SingleUtteranceNnet3Decoder decoder(decoder_opts, trans_model,
                                             decodable_info,
                                             *decode_fst, &feature_pipeline);
         OnlineTimer decoding_timer(utt);
+        // processing_timer measures the time actually spent processing (as
+        // opposed to waiting for audio), for the real-time factor.
+        Timer processing_timer;
 
         BaseFloat samp_freq = wave_data.SampFreq();
         int32 chunk_length;
@@ -273,6 +400,22 @@ int main(int argc, char *argv[]) {
 
         decoding_timer.OutputStats(&timing_stats);
 
+        if (num_chunk_sizes > 1 && samp_offset > 0) {
+          double real_time_factor =
+              processing_timer.Elapsed() / (samp_offset / samp_freq);
+          int32 new_index = ChooseChunkSizeIndex(
+              chunk_size_index, num_chunk_sizes, timing_stats.LastDelay(),
+              real_time_factor, max_delay, max_real_time_factor);
+          if (new_index != chunk_size_index)
+            KALDI_VLOG(1) << "Changing frames-per-chunk from "
+                          << chunk_sizes[chunk_size_index] << " to "
+                          << chunk_sizes[new_index] << " after utterance "
+                          << utt << " (delay " << timing_stats.LastDelay()
+                          << " seconds, real-time factor "
+                          << real_time_factor << ')';
+          chunk_size_index = new_index;
+        }
+
         // In an application you might avoid updating the adaptation state if
         // you felt the utterance had low confidence.  See lat/confidence.h
         feature_pipeline.GetAdaptationState(&adaptation_state);
@@ -295,6 +438,8 @@ int main(int argc, char *argv[]) {
               << " per frame over " << num_frames << " frames.";
     delete decode_fst;
     delete word_syms; // will delete if non-NULL.
+    DeletePointers(&decodable_infos);
+    DeletePointers(&chunk_nnets);
     return (num_done != 0 ? 0 : 1);
   } catch(const std::exception& e) {
     std::cerr << e.what();
@@ -22,6 +22,7 @@
 #include "rnnlm/rnnlm-compute-state.h"
 #include "nnet3/nnet-utils.h"
 #include "nnet3/nnet-compile-looped.h"
+#include "util/stl-utils.h"
 
 namespace kaldi {
 namespace rnnlm {
@@ -83,8 +84,12 @@ RnnlmComputeState::RnnlmComputeState(const RnnlmComputeStateInfo &info,
 RnnlmComputeState::RnnlmComputeState(const RnnlmComputeState &other):
   info_(other.info_), computer_(other.computer_),
   previous_word_(other.previous_word_),
-  normalization_factor_(other.normalization_factor_)
-{}
+  normalization_factor_(other.normalization_factor_) {
+  // 'other' has always been advanced by at least one word, so its output can
+  // be got (again) from our copy of its computer; this lets the copy be used
+  // without calling AddWord() first.
+  predicted_word_embedding_ = &(computer_.GetOutput("output"));
+}
 
 RnnlmComputeState* RnnlmComputeState::GetSuccessorState(int32 next_word) const {
   RnnlmComputeState *ans = new RnnlmComputeState(*this);
@@ -142,6 +147,90 @@ void RnnlmComputeState::GetLogProbOfWords(CuMatrixBase<BaseFloat> *output) const
   output->ColRange(0, 1).Set(-99.0);
 }
 
+void RnnlmComputeState::LogProbsOfWords(
+    const std::vector<const RnnlmComputeState*> &states,
+    const std::vector<int32> &words,
+    std::vector<BaseFloat> *log_probs) {
+  KALDI_ASSERT(states.size() == words.size());
+  int32 num_pairs = states.size();
+  log_probs->resize(num_pairs);
+  if (num_pairs == 0)
+    return;
+  const RnnlmComputeStateInfo &info = states[0]->info_;
+  const CuMatrix<BaseFloat> &word_embedding_mat = info.word_embedding_mat;
+
+  std::vector<const BaseFloat*> predicted_rows(num_pairs);
+  for (int32 i = 0; i < num_pairs; i++) {
+    KALDI_ASSERT(&(states[i]->info_) == &info && words[i] > 0 &&
+                 words[i] < word_embedding_mat.NumRows());
+    predicted_rows[i] = states[i]->predicted_word_embedding_->RowData(0);
+  }
+  CuArray<const BaseFloat*> predicted_rows_cuda(predicted_rows);
+  CuArray<int32> words_cuda(words);
+  CuMatrix<BaseFloat> predicted(num_pairs, word_embedding_mat.NumCols(),
+                                kUndefined),
+      embeddings(num_pairs, word_embedding_mat.NumCols(), kUndefined);
+  predicted.CopyRows(predicted_rows_cuda);
+  embeddings.CopyRows(word_embedding_mat, words_cuda);
+  CuVector<BaseFloat> dot_products(num_pairs, kUndefined);
+  dot_products.AddDiagMatMat(1.0, predicted, kNoTrans, embeddings, kTrans, 0.0);
+
+  Vector<BaseFloat> dot_products_cpu(dot_products);
+  for (int32 i = 0; i < num_pairs; i++) {
+    (*log_probs)[i] = dot_products_cpu(i);
+    if (info.opts.normalize_probs)
+      (*log_probs)[i] -= states[i]->normalization_factor_;
+  }
+}
+
+void RnnlmComputeState::GetSuccessorStates(
+    const std::vector<const RnnlmComputeState*> &states,
+    const std::vector<int32> &next_words,
+    std::vector<RnnlmComputeState*> *successors) {
+  KALDI_ASSERT(states.size() == next_words.size());
+  int32 num_states = states.size();
+  successors->resize(num_states);
+  if (num_states == 0)
+    return;
+  const RnnlmComputeStateInfo &info = states[0]->info_;
+  const CuMatrix<BaseFloat> &word_embedding_mat = info.word_embedding_mat;
+  for (int32 i = 0; i < num_states; i++) {
+    KALDI_ASSERT(&(states[i]->info_) == &info && next_words[i] > 0 &&
+                 next_words[i] < word_embedding_mat.NumRows());
+    RnnlmComputeState *successor = new RnnlmComputeState(*(states[i]));
+    successor->previous_word_ = next_words[i];
+    successor->AdvanceChunk();
+    (*successors)[i] = successor;
+  }
+  if (!info.opts.normalize_probs)
+    return;
+
+  // The rest does what AddWord() does, for many states at once.  The matrix of
+  // probabilities is limited to about 2^24 elements.
+  int32 num_words = word_embedding_mat.NumRows(),
+      batch_size = std::max<int32>(1, (1 << 24) / num_words);
+  for (int32 begin = 0; begin < num_states; begin += batch_size) {
+    int32 this_batch_size = std::min<int32>(batch_size, num_states - begin);
+    std::vector<const BaseFloat*> predicted_rows(this_batch_size);
+    for (int32 i = 0; i < this_batch_size; i++)
+      predicted_rows[i] =
+          (*successors)[begin + i]->predicted_word_embedding_->RowData(0);
+    CuArray<const BaseFloat*> predicted_rows_cuda(predicted_rows);
+    CuMatrix<BaseFloat> predicted(this_batch_size, word_embedding_mat.NumCols(),
+                                  kUndefined);
+    predicted.CopyRows(predicted_rows_cuda);
+    CuMatrix<BaseFloat> probs(this_batch_size, num_words, kUndefined);
+    probs.AddMatMat(1.0, predicted, kNoTrans, word_embedding_mat, kTrans, 0.0);
+    probs.ApplyExp();
+    // We exclude the <eps> symbol which is always 0.
+    CuVector<BaseFloat> sums(this_batch_size);
+    sums.AddColSumMat(1.0, probs.ColRange(1, num_words - 1), 0.0);
+    Vector<BaseFloat> sums_cpu(sums);
+    for (int32 i = 0; i < this_batch_size; i++)
+      (*successors)[begin + i]->normalization_factor_ = Log(sums_cpu(i));
+  }
+}
+
 void RnnlmComputeState::AdvanceChunk() {
   CuMatrix<BaseFloat> input_embeddings(1, info_.word_embedding_mat.NumCols());
   input_embeddings.Row(0).AddVec(1.0,
@@ -157,5 +246,106 @@ void RnnlmComputeState::AdvanceChunk() {
   }
 }
 
+void ComputeSentenceLogProbs(
+    const RnnlmComputeStateInfo &info,
+    const std::vector<std::vector<int32> > &sentences,
+    std::vector<std::vector<BaseFloat> > *log_probs) {
+  // A node of the prefix tree is a history; node 0 is the BOS history.
+  struct Node {
+    int32 parent;
+    int32 word;  // The last word of the history (-1 for node 0).
+    BaseFloat log_prob;  // The log-prob of 'word' given the parent's history.
+    BaseFloat eos_log_prob;  // The log-prob of EOS given this history.
+    bool is_end;  // True if some sentence ends here.
+    std::vector<int32> children;
+  };
+  std::vector<Node> nodes(1);
+  nodes[0].parent = -1;
+  nodes[0].word = -1;
+  nodes[0].is_end = false;
+  std::unordered_map<std::pair<int32, int32>, int32, PairHasher<int32> > arcs;
+  std::vector<int32> end_nodes(sentences.size());
+  for (size_t i = 0; i < sentences.size(); i++) {
+    int32 node = 0;
+    for (size_t j = 0; j < sentences[i].size(); j++) {
+      std::pair<int32, int32> key(node, sentences[i][j]);
+      std::unordered_map<std::pair<int32, int32>, int32,
+                         PairHasher<int32> >::iterator iter = arcs.find(key);
+      if (iter != arcs.end()) {
+        node = iter->second;
+      } else {
+        int32 next_node = nodes.size();
+        nodes.resize(nodes.size() + 1);
+        nodes[next_node].parent = node;
+        nodes[next_node].word = sentences[i][j];
+        nodes[next_node].is_end = false;
+        nodes[node].children.push_back(next_node);
+        arcs[key] = next_node;
+        node = next_node;
+      }
+    }
+    nodes[node].is_end = true;
+    end_nodes[i] = node;
+  }
+
+  // Process the tree one depth at a time; only the states of the nodes at
+  // the current depth exist at any time.
+  std::vector<int32> cur_nodes(1, 0);
+  std::vector<RnnlmComputeState*> cur_states(
+      1, new RnnlmComputeState(info, info.opts.bos_index));
+  while (!cur_nodes.empty()) {
+    std::vector<const RnnlmComputeState*> query_states, parent_states;
+    std::vector<int32> query_words, next_nodes;
+    for (size_t k = 0; k < cur_nodes.size(); k++) {
+      const Node &node = nodes[cur_nodes[k]];
+      for (size_t c = 0; c < node.children.size(); c++) {
+        query_states.push_back(cur_states[k]);
+        query_words.push_back(nodes[node.children[c]].word);
+        next_nodes.push_back(node.children[c]);
+      }
+      if (node.is_end) {
+        query_states.push_back(cur_states[k]);
+        query_words.push_back(info.opts.eos_index);
+      }
+    }
+    std::vector<BaseFloat> query_log_probs;
+    RnnlmComputeState::LogProbsOfWords(query_states, query_words,
+                                       &query_log_probs);
+    size_t q = 0;
+    for (size_t k = 0; k < cur_nodes.size(); k++) {
+      Node &node = nodes[cur_nodes[k]];
+      for (size_t c = 0; c < node.children.size(); c++) {
+        nodes[node.children[c]].log_prob = query_log_probs[q++];
+        parent_states.push_back(cur_states[k]);
+      }
+      if (node.is_end)
+        node.eos_log_prob = query_log_probs[q++];
+    }
+    std::vector<int32> next_words(next_nodes.size());
+    for (size_t k = 0; k < next_nodes.size(); k++)
+      next_words[k] = nodes[next_nodes[k]].word;
+    std::vector<RnnlmComputeState*> next_states;
+    RnnlmComputeState::GetSuccessorStates(parent_states, next_words,
+                                          &next_states);
+    for (size_t k = 0; k < cur_states.size(); k++)
+      delete cur_states[k];
+    cur_nodes.swap(next_nodes);
+    cur_states.swap(next_states);
+  }
+
+  log_probs->resize(sentences.size());
+  for (size_t i = 0; i < sentences.size(); i++) {
+    std::vector<BaseFloat> &this_log_probs = (*log_probs)[i];
+    this_log_probs.resize(sentences[i].size() + 1);
+    int32 node = end_nodes[i];
+    this_log_probs.back() = nodes[node].eos_log_prob;
+    // Walk back up the tree to the root.
+    for (size_t j = sentences[i].size(); j > 0; j--) {
+      this_log_probs[j - 1] = nodes[node].log_prob;
+      node = nodes[node].parent;
+    }
+  }
+}
+
 } // namespace rnnlm
 } // namespace kaldi
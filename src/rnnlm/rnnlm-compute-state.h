@@ -56,7 +56,9 @@ struct RnnlmComputeStateComputationOptions {
                    "debug for the actual computation (very verbose!)");
     opts->Register("normalize-probs", &normalize_probs, "If true, word "
        "probabilities will be correctly normalized (otherwise the sum-to-one "
-       "normalization is approximate)");
+       "normalization is approximate, but closer if the model was trained "
+       "with --self-norm-penalty; this way a log-prob is just one dot "
+       "product)");
     opts->Register("bos-symbol", &bos_index, "Index in wordlist representing "
                    "the begin-of-sentence symbol");
     opts->Register("eos-symbol", &eos_index, "Index in wordlist representing "
@@ -125,6 +127,25 @@ class RnnlmComputeState {
   void GetLogProbOfWords(CuMatrixBase<BaseFloat>* output) const;
   /// Advance the state of the RNNLM by appending this word to the word sequence.
   void AddWord(int32 word_index);
+
+  /// Sets (*log_probs)[i] to states[i]->LogProbOfWord(words[i]) for each i.
+  /// This is done with a few matrix operations for all the pairs, instead of
+  /// a dot product for each, which matters on GPU.  All the states must share
+  /// the same RnnlmComputeStateInfo.
+  static void LogProbsOfWords(
+      const std::vector<const RnnlmComputeState*> &states,
+      const std::vector<int32> &words,
+      std::vector<BaseFloat> *log_probs);
+
+  /// Sets (*successors)[i] to states[i]->GetSuccessorState(next_words[i]) for
+  /// each i; the pointers are owned by the caller.  The recurrent part of the
+  /// computation is still done one state at a time, but if
+  /// opts.normalize_probs is set, the normalizers of all the new states are
+  /// computed with one matrix multiplication by the word embedding.
+  static void GetSuccessorStates(
+      const std::vector<const RnnlmComputeState*> &states,
+      const std::vector<int32> &next_words,
+      std::vector<RnnlmComputeState*> *successors);
  private:
   /// This function does the computation for the next chunk.
   void AdvanceChunk();
@@ -143,6 +164,24 @@ class RnnlmComputeState {
 };
 
 
+/**
+   Computes the log-probs of the words of each of 'sentences' (which must not
+   contain the BOS or EOS symbols), each followed by the EOS symbol, as
+   rnnlm-sentence-probs prints them: (*log_probs)[i] will have
+   sentences[i].size() + 1 elements.  This is meant for n-best rescoring: the
+   sentences are put in a prefix tree, so hypotheses that share a prefix (as
+   those of an n-best list mostly do) share the RNNLM states for it, and the
+   tree is processed one word position at a time, so that the log-probs and
+   normalizers of all the histories at a position are computed with a few
+   matrix operations (see RnnlmComputeState::LogProbsOfWords() and
+   RnnlmComputeState::GetSuccessorStates()).  Pass many sentences at once for
+   speed, especially on GPU.
+*/
+void ComputeSentenceLogProbs(
+    const RnnlmComputeStateInfo &info,
+    const std::vector<std::vector<int32> > &sentences,
+    std::vector<std::vector<BaseFloat> > *log_probs);
+
 } // namespace rnnlm
 } // namespace kaldi
 
@@ -17,6 +17,8 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <cmath>
 #include <numeric>
 #include "rnnlm/rnnlm-embedding-training.h"
 #include "nnet3/natural-gradient-online.h"
@@ -41,18 +43,68 @@ RnnlmEmbeddingTrainer::RnnlmEmbeddingTrainer(
     config_(config),
     embedding_mat_(embedding_mat),
     num_minibatches_(0),
-    max_change_count_(0) {
+    max_change_count_(0),
+    num_momentum_updates_(0) {
   KALDI_ASSERT(embedding_mat->NumRows() > 0);
   initial_embedding_mat_.Resize(embedding_mat->NumRows(),
                                 embedding_mat->NumCols(),
                                 kUndefined);
   embedding_mat->CopyToMat(&initial_embedding_mat_);
-  if (config_.momentum > 0.0)
+  if (config_.momentum > 0.0) {
     embedding_mat_momentum_.Resize(embedding_mat->NumRows(),
                                    embedding_mat->NumCols());
+    row_num_momentum_updates_.resize(embedding_mat->NumRows(), 0);
+  }
   SetNaturalGradientOptions();
 }
 
+void RnnlmEmbeddingTrainer::CatchUpMomentumRows(
+    const std::vector<int32> &words) {
+  BaseFloat momentum = config_.momentum;
+  int32 num_words = words.size();
+  // For each word, 'embedding_scale' is the scale on its momentum that has to
+  // be added to its embedding, and 'momentum_scale' is the scale to be
+  // applied to its momentum.
+  Vector<BaseFloat> embedding_scale(num_words, kUndefined),
+      momentum_scale(num_words, kUndefined);
+  bool need_update = false;
+  for (int32 i = 0; i < num_words; i++) {
+    int64 k = num_momentum_updates_ - row_num_momentum_updates_[words[i]];
+    row_num_momentum_updates_[words[i]] = num_momentum_updates_;
+    BaseFloat momentum_k = std::pow(momentum, static_cast<BaseFloat>(k));
+    embedding_scale(i) = (1.0 - momentum_k) / (1.0 - momentum);
+    momentum_scale(i) = momentum_k;
+    if (k != 0)
+      need_update = true;
+  }
+  if (!need_update)
+    return;
+  CuArray<int32> cu_words(words);
+  CuVector<BaseFloat> cu_embedding_scale(embedding_scale),
+      cu_momentum_scale(momentum_scale);
+  CuMatrix<BaseFloat> rows(num_words, embedding_mat_->NumCols(),
+                           kUndefined);
+  rows.CopyRows(embedding_mat_momentum_, cu_words);
+  // 'delta' will be the change in the momentum rows.
+  CuMatrix<BaseFloat> delta(rows);
+  delta.MulRowsVec(cu_momentum_scale);
+  delta.AddMat(-1.0, rows);
+  rows.MulRowsVec(cu_embedding_scale);
+  rows.AddToRows(1.0, cu_words, embedding_mat_);
+  delta.AddToRows(1.0, cu_words, &embedding_mat_momentum_);
+}
+
+void RnnlmEmbeddingTrainer::CatchUpMomentum() {
+  if (config_.momentum == 0.0)
+    return;
+  std::vector<int32> words;
+  for (size_t i = 0; i < row_num_momentum_updates_.size(); i++)
+    if (row_num_momentum_updates_[i] != num_momentum_updates_)
+      words.push_back(i);
+  if (!words.empty())
+    CatchUpMomentumRows(words);
+}
+
 void RnnlmEmbeddingTrainer::SetNaturalGradientOptions() {
   config_.Check();
   if (!config_.use_natural_gradient)
@@ -67,6 +119,7 @@ void RnnlmEmbeddingTrainer::SetNaturalGradientOptions() {
 
 void RnnlmEmbeddingTrainer::Train(
     CuMatrixBase<BaseFloat> *embedding_deriv) {
+  CatchUpMomentum();
 
   // If relevant, do the following:
   // "embedding_deriv += - 2 * l2_regularize * embedding_mat_"
@@ -108,6 +161,9 @@ void RnnlmEmbeddingTrainer::Train(
     embedding_mat_momentum_.AddMat(scale, *embedding_deriv);
     embedding_mat_->AddMat(1.0, embedding_mat_momentum_);
     embedding_mat_momentum_.Scale(config_.momentum);
+    num_momentum_updates_++;
+    std::fill(row_num_momentum_updates_.begin(),
+              row_num_momentum_updates_.end(), num_momentum_updates_);
   } else {
     embedding_mat_->AddMat(scale, *embedding_deriv);
   }
@@ -168,6 +224,13 @@ void RnnlmEmbeddingTrainer::Train(
 
   KALDI_ASSERT(active_words.Dim() == embedding_deriv->NumRows());
 
+  std::vector<int32> active_words_cpu;
+  if (config_.momentum > 0.0) {
+    // Bring the active rows up to date before we use them.
+    active_words.CopyToVec(&active_words_cpu);
+    CatchUpMomentumRows(active_words_cpu);
+  }
+
   // If relevant, do the following:
   // "embedding_deriv += - 2 * l2_regularize * embedding_mat_"
   // This is an approximate to the regular l2 regularization (add l2 regularization
@@ -204,9 +267,23 @@ void RnnlmEmbeddingTrainer::Train(
     // effective learning rate due to the geometric sum of (1 + momentum +
     // momentum^2, ...).
     scale *= (1.0 - config_.momentum);
-    embedding_deriv->AddToRows(scale, active_words, &embedding_mat_momentum_);
-    embedding_mat_->AddMat(1.0, embedding_mat_momentum_);
-    embedding_mat_momentum_.Scale(config_.momentum);
+    // Only the active rows are updated here; the momentum terms of the other
+    // rows are applied by CatchUpMomentumRows() when they are next used.
+    CuMatrix<BaseFloat> momentum_rows(active_words.Dim(),
+                                      embedding_mat_->NumCols(),
+                                      kUndefined);
+    momentum_rows.CopyRows(embedding_mat_momentum_, active_words);
+    momentum_rows.AddMat(scale, *embedding_deriv);
+    momentum_rows.AddToRows(1.0, active_words, embedding_mat_);
+    // the change in the momentum rows is
+    //   (momentum - 1) * (old rows) + momentum * scale * deriv.
+    embedding_deriv->Scale(scale);
+    momentum_rows.Scale(config_.momentum - 1.0);
+    momentum_rows.AddMat(1.0, *embedding_deriv);
+    momentum_rows.AddToRows(1.0, active_words, &embedding_mat_momentum_);
+    num_momentum_updates_++;
+    for (size_t i = 0; i < active_words_cpu.size(); i++)
+      row_num_momentum_updates_[active_words_cpu[i]] = num_momentum_updates_;
   } else {
     embedding_deriv->AddToRows(scale, active_words, embedding_mat_);
   }
@@ -263,6 +340,7 @@ void RnnlmEmbeddingTrainer::TrainBackstitch(
 }
 
 RnnlmEmbeddingTrainer::~RnnlmEmbeddingTrainer() {
+  CatchUpMomentum();
   PrintStats();
 }
 
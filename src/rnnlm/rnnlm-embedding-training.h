@@ -197,6 +197,17 @@ class RnnlmEmbeddingTrainer {
   // TODO: implement this.
   void PrintStats();
 
+  // Used with momentum in the sparse (active_words) version of Train().
+  // Brings the rows 'words' of embedding_mat_ and embedding_mat_momentum_ up
+  // to date, i.e. applies the momentum terms of the minibatches since each
+  // row was last updated, which did not involve that row.
+  void CatchUpMomentumRows(const std::vector<int32> &words);
+
+  // Brings all rows of embedding_mat_ and embedding_mat_momentum_ up to date
+  // (see CatchUpMomentumRows()).  Called from the dense version of Train()
+  // and from the destructor.
+  void CatchUpMomentum();
+
 
   const RnnlmEmbeddingTrainerOptions &config_;
 
@@ -213,6 +224,21 @@ class RnnlmEmbeddingTrainer {
   // *embedding_mat*, and used for the decaying sum of deltas.
   CuMatrix<BaseFloat> embedding_mat_momentum_;
 
+  // The following are used with momentum in the sparse version of Train(),
+  // which only updates the rows of embedding_mat_ and embedding_mat_momentum_
+  // for the active words of each minibatch.  For a row that is not active in
+  // k successive minibatches, the dense update would add
+  // (1 + momentum + ... + momentum^(k-1)) times its momentum to the
+  // embedding and scale the momentum by momentum^k; the sparse version does
+  // that all at once the next time the row is used (or at the end).  The
+  // result is the same as the dense update, but with a large vocabulary it
+  // touches far less memory.
+  // num_momentum_updates_ is the number of momentum updates done so far, and
+  // row_num_momentum_updates_[i] is the number of them that row i of the
+  // matrices is up to date with.
+  int64 num_momentum_updates_;
+  std::vector<int64> row_num_momentum_updates_;
+
   // This is a copy of the 'embedding_mat' that we were initialized with,
   // which we keep around for purposes of printing stats at the end about how
   // much the matrix changed; we keep it in CPU memory in case GPU memory is a
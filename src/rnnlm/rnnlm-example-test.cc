@@ -110,6 +110,8 @@ void TestRnnlmOutput(const std::string &archive_rxfilename) {
     BaseFloat weight, objf_num, objf_den, objf_den_exact;
 
     RnnlmObjectiveOptions objective_config;
+    if (RandInt(0, 1) == 0)
+      objective_config.self_norm_penalty = 0.5;
     ProcessRnnlmOutput(objective_config,
                        example, derived, embedding, nnet_output,
                        train_embedding ? &embedding_deriv : NULL,
@@ -122,6 +124,22 @@ void TestRnnlmOutput(const std::string &archive_rxfilename) {
               << ", objf=" << (objf_num + objf_den)
               << ", objf-den-exact is " << objf_den_exact;
 
+    if (example.sampled_words.empty()) {
+      // Check that the code path that processes the output in batches of rows
+      // (used when the matrix of word logprobs would be too large) gives the
+      // same objective function.
+      RnnlmObjectiveOptions batched_config(objective_config);
+      batched_config.max_logprob_elements = vocab_size * 3;
+      BaseFloat weight2, objf_num2, objf_den2;
+      ProcessRnnlmOutput(batched_config,
+                         example, derived, embedding, nnet_output,
+                         NULL, NULL,
+                         &weight2, &objf_num2, &objf_den2, NULL);
+      AssertEqual(weight, weight2);
+      AssertEqual(objf_num, objf_num2, 1.0e-03);
+      AssertEqual(objf_den, objf_den2, 1.0e-03);
+    }
+
     if (train_embedding) {
       BaseFloat delta = 0.0004;
       // test the embedding derivatives
@@ -144,7 +162,6 @@ void TestRnnlmOutput(const std::string &archive_rxfilename) {
                   << ", smat sum is " << derived.output_words_smat.Sum();
 
         BaseFloat weight2, objf_num2, objf_den2;
-        RnnlmObjectiveOptions objective_config;
         ProcessRnnlmOutput(objective_config,
                            example, derived, embedding2, nnet_output,
                            NULL, NULL,
@@ -183,7 +200,6 @@ void TestRnnlmOutput(const std::string &archive_rxfilename) {
                   << ", smat sum is " << derived.output_words_smat.Sum();
 
         BaseFloat weight2, objf_num2, objf_den2;
-        RnnlmObjectiveOptions objective_config;
         ProcessRnnlmOutput(objective_config,
                            example, derived, embedding, nnet_output2,
                            NULL, NULL,
@@ -69,6 +69,28 @@ void RnnlmExampleDerived::Swap(RnnlmExampleDerived *other) {
   input_words_smat.Swap(&other->input_words_smat);
 }
 
+// This is called from the ProcessRnnlmOutput*() functions below if
+// objective_config.self_norm_penalty != 0.0.  'den_term' is the vector of
+// den_term(i) = 1.0 - Z(i), where Z(i) is the (estimated) normalizer, for some
+// rows i, and 'output_weights' their weights.  It adds the penalty
+// -self_norm_penalty * \sum_i weight(i) * den_term(i)^2 to *objf_den, and sets
+// 'deriv_scale' to the factor by which the derivatives of the denominator
+// part of the objective w.r.t. q(i, w) have to be scaled to include it.
+static void AddSelfNormPenalty(BaseFloat self_norm_penalty,
+                               const CuVectorBase<BaseFloat> &den_term,
+                               const CuVectorBase<BaseFloat> &output_weights,
+                               BaseFloat *objf_den,
+                               CuVector<BaseFloat> *deriv_scale) {
+  CuVector<BaseFloat> den_term_sq(den_term);
+  den_term_sq.MulElements(den_term);
+  *objf_den -= self_norm_penalty * VecVec(den_term_sq, output_weights);
+  // d(den_term(i) - alpha * den_term(i)^2) / d(den_term(i))
+  //   = 1.0 - 2 alpha den_term(i).
+  deriv_scale->Resize(den_term.Dim(), kUndefined);
+  deriv_scale->Set(1.0);
+  deriv_scale->AddVec(-2.0 * self_norm_penalty, den_term);
+}
+
 // This is called from ProcessRnnlmOutput() when we are doing importance
 // sampling.
 static void ProcessRnnlmOutputSampling(
@@ -167,6 +189,17 @@ static void ProcessRnnlmOutputSampling(
     *objf_den +=  -VecMatVec(output_weights_part, word_logprobs,
                              sample_inv_probs_part);
 
+    CuVector<BaseFloat> deriv_scale;
+    if (objective_config.self_norm_penalty != 0.0) {
+      // den_term(i) = 1.0 - (\sum_w q(w,i) * sample_inv_prob(w,i)).
+      CuVector<BaseFloat> den_term(rows_per_group, kUndefined);
+      den_term.Set(1.0);
+      den_term.AddMatVec(-1.0, word_logprobs, kNoTrans,
+                         sample_inv_probs_part, 1.0);
+      AddSelfNormPenalty(objective_config.self_norm_penalty, den_term,
+                         output_weights_part, objf_den, &deriv_scale);
+    }
+
 
     // The derivative of the function q(l) = (l < 0 ? exp(l) : l + 1.0)
     // equals (l < 0 ? exp(l) : 1.0), which we can compute by
@@ -177,6 +210,8 @@ static void ProcessRnnlmOutputSampling(
     // in the deriviative of the objf w.r.t. the words' logprobs
     // (which is what we're computing now).
     word_logprobs.MulColsVec(sample_inv_probs_part);
+    if (objective_config.self_norm_penalty != 0.0)
+      word_logprobs.MulRowsVec(deriv_scale);
 
     if (objective_config.den_term_limit != 0.0) {
       // If it's nonzero then check that it's negative, and not too close to zero,
@@ -306,6 +341,7 @@ static void ProcessRnnlmOutputNoSampling(
   // and some of these code paths will only be used in test code.
   word_logprobs.ApplyExpSpecial();
 
+  CuVector<BaseFloat> deriv_scale;
   { // This block computes *objf_den.
 
     // we call this variable 'q_noeps' because in the math described in
@@ -322,6 +358,9 @@ static void ProcessRnnlmOutputNoSampling(
     // note: objf = \sum_i weight(i) * ( num_term(i) + den_term(i) ),
     // this is the term \sum_i weight(i) * den_term(i).
     *objf_den = VecVec(den_term, minibatch.output_weights);
+    if (objective_config.self_norm_penalty != 0.0)
+      AddSelfNormPenalty(objective_config.self_norm_penalty, den_term,
+                         minibatch.output_weights, objf_den, &deriv_scale);
   }
 
   // The rest of this function computes the derivative w.r.t.
@@ -339,7 +378,8 @@ static void ProcessRnnlmOutputNoSampling(
   // equals (l < 0 ? exp(l) : 1.0), which we can compute by
   // applying a ceiling to q at 1.0.
   word_logprobs.ApplyCeiling(1.0);
-
+  if (objective_config.self_norm_penalty != 0.0)
+    word_logprobs.MulRowsVec(deriv_scale);
 
   // Include the factor 'minibatch.output_weights'.
   word_logprobs.MulRowsVec(minibatch.output_weights);
@@ -494,6 +534,7 @@ static void ProcessRnnlmOutputNoSamplingBatched(
     // and some of these code paths will only be used in test code.
     word_logprobs.ApplyExpSpecial();
 
+    CuVector<BaseFloat> deriv_scale;
     { // This block computes *objf_den.
 
       // we call this variable 'q_noeps' because in the math described in
@@ -510,12 +551,17 @@ static void ProcessRnnlmOutputNoSamplingBatched(
       // note: objf = \sum_i weight(i) * ( num_term(i) + den_term(i) ),
       // this is the term \sum_i weight(i) * den_term(i).
       *objf_den += VecVec(den_term, this_output_weights);
+      if (objective_config.self_norm_penalty != 0.0)
+        AddSelfNormPenalty(objective_config.self_norm_penalty, den_term,
+                           this_output_weights, objf_den, &deriv_scale);
     }
 
     // The rest of this function computes the derivative w.r.t.
     // word_embedding_deriv and/or nnet_output_deriv, for which we
-    if (!(word_embedding_deriv || nnet_output_deriv))
+    if (!(word_embedding_deriv || nnet_output_deriv)) {
+      this_start += this_size;
       continue;
+    }
 
     // To avoid one CUDA operation, we're going to make 'word_logprobs'
     // the *negative* of the derivative of the objf w.r.t.
@@ -527,6 +573,8 @@ static void ProcessRnnlmOutputNoSamplingBatched(
     // equals (l < 0 ? exp(l) : 1.0), which we can compute by
     // applying a ceiling to q at 1.0.
     word_logprobs.ApplyCeiling(1.0);
+    if (objective_config.self_norm_penalty != 0.0)
+      word_logprobs.MulRowsVec(deriv_scale);
 
     // Include the factor 'minibatch.output_weights'.
     word_logprobs.MulRowsVec(this_output_weights);
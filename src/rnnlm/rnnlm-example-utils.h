@@ -155,9 +155,11 @@ void GetRnnlmExampleDerived(const RnnlmExample &minibatch,
 struct RnnlmObjectiveOptions {
   BaseFloat den_term_limit;
   uint32 max_logprob_elements;
+  BaseFloat self_norm_penalty;
 
   RnnlmObjectiveOptions(): den_term_limit(-10.0),
-                           max_logprob_elements(1000000000) { }
+                           max_logprob_elements(1000000000),
+                           self_norm_penalty(0.0) { }
 
   void Register(OptionsItf *po) {
     po->Register("den-term-limit", &den_term_limit,
@@ -172,6 +174,13 @@ struct RnnlmObjectiveOptions {
                  "[minibatch-size, num-words] for computing logprobs of words. "
                  "If the size is exceeded, we will break the matrix along the "
                  "minibatch axis and compute them separately");
+    po->Register("self-norm-penalty", &self_norm_penalty,
+                 "If nonzero, the scale of a penalty on (1 - Z)^2, where Z is "
+                 "the (estimated) sum of the unnormalized probabilities of the "
+                 "words, which is about (log Z)^2.  It makes the model closer "
+                 "to self-normalized, so that it can be used with "
+                 "--normalize-probs=false at test time, where a log-prob is "
+                 "then just one dot product.  E.g. 0.1.");
   }
 };
 
@@ -212,6 +221,14 @@ struct RnnlmObjectiveOptions {
       for this 't', and 1.0 / (the probability with which it was sampled)
       if it was sampled.
 
+      If objective_config.self_norm_penalty (call it alpha) is nonzero,
+      den_term(i) includes the self-normalization penalty
+          -alpha * (1.0 - den_term'(i))^2 ,
+      where den_term'(i) is the den_term(i) defined above, so 1.0 - den_term'(i)
+      is the normalizer (or, with sampling, its estimate).  This keeps the
+      normalizers close to one, so that the unnormalized log-probs can be used
+      directly at test time.
+
 
        @param [in] minibatch  The minibatch for which we are processing the
                          output.
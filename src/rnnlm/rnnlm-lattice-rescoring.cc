@@ -28,6 +28,55 @@
 namespace kaldi {
 namespace rnnlm {
 
+RnnlmStateCache::RnnlmStateCache(const RnnlmStateCacheOptions &opts):
+    opts_(opts), num_lookups_(0), num_hits_(0) { }
+
+RnnlmStateCache::~RnnlmStateCache() {
+  for (ListType::iterator iter = states_.begin(); iter != states_.end();
+       ++iter)
+    delete iter->second;
+}
+
+RnnlmComputeState *RnnlmStateCache::Lookup(const std::vector<int32> &history) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  num_lookups_++;
+  MapType::iterator iter = history_to_state_.find(history);
+  if (iter == history_to_state_.end())
+    return NULL;
+  num_hits_++;
+  // Move it to the front of the list, as the most recently used.
+  states_.splice(states_.begin(), states_, iter->second);
+  return new RnnlmComputeState(*(iter->second->second));
+}
+
+void RnnlmStateCache::Insert(const std::vector<int32> &history,
+                             const RnnlmComputeState &state) {
+  if (opts_.max_states <= 0)
+    return;
+  RnnlmComputeState *copy = new RnnlmComputeState(state);
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (history_to_state_.count(history) != 0) {
+    // Another thread got there first.
+    delete copy;
+    return;
+  }
+  states_.push_front(std::make_pair(history, copy));
+  history_to_state_[history] = states_.begin();
+  if (static_cast<int32>(history_to_state_.size()) > opts_.max_states) {
+    history_to_state_.erase(states_.back().first);
+    delete states_.back().second;
+    states_.pop_back();
+  }
+}
+
+void RnnlmStateCache::PrintStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  KALDI_LOG << "RNNLM state cache: " << num_hits_ << " hits out of "
+            << num_lookups_ << " lookups ("
+            << (100.0 * num_hits_ / std::max<int64>(num_lookups_, 1))
+            << "%); it holds " << states_.size() << " states.";
+}
+
 KaldiRnnlmDeterministicFst::~KaldiRnnlmDeterministicFst() {
   int32 size = state_to_rnnlm_state_.size();
   for (int32 i = 0; i < size; i++)
@@ -49,10 +98,14 @@ void KaldiRnnlmDeterministicFst::Clear() {
   state_to_wseq_.resize(1);
   wseq_to_state_.clear();
   wseq_to_state_[state_to_wseq_[0]] = 0;
+  prefetched_arcs_.clear();
+  if (cache_ != NULL)
+    state_to_history_.resize(1);
 }
 
 KaldiRnnlmDeterministicFst::KaldiRnnlmDeterministicFst(int32 max_ngram_order,
-    const RnnlmComputeStateInfo &info) {
+    const RnnlmComputeStateInfo &info, RnnlmStateCache *cache):
+    cache_(cache) {
   max_ngram_order_ = max_ngram_order;
   bos_index_ = info.opts.bos_index;
   eos_index_ = info.opts.eos_index;
@@ -65,6 +118,8 @@ KaldiRnnlmDeterministicFst::KaldiRnnlmDeterministicFst(int32 max_ngram_order,
   start_state_ = 0;
 
   state_to_rnnlm_state_.push_back(decodable_rnnlm);
+  if (cache_ != NULL)
+    state_to_history_.push_back(bos_seq);
 }
 
 fst::StdArc::Weight KaldiRnnlmDeterministicFst::Final(StateId s) {
@@ -75,17 +130,10 @@ fst::StdArc::Weight KaldiRnnlmDeterministicFst::Final(StateId s) {
   return Weight(-rnn->LogProbOfWord(eos_index_));
 }
 
-bool KaldiRnnlmDeterministicFst::GetArc(StateId s, Label ilabel,
-                                        fst::StdArc *oarc) {
-  /// At this point, we have created the state.
-  KALDI_ASSERT(static_cast<size_t>(s) < state_to_wseq_.size());
-
+KaldiRnnlmDeterministicFst::StateId KaldiRnnlmDeterministicFst::GetNextState(
+    StateId s, Label word, bool *is_new) {
   std::vector<Label> word_seq = state_to_wseq_[s];
-  const RnnlmComputeState* rnnlm = state_to_rnnlm_state_[s];
-
-  BaseFloat logprob = rnnlm->LogProbOfWord(ilabel);
-
-  word_seq.push_back(ilabel);
+  word_seq.push_back(word);
   if (max_ngram_order_ > 0) {
     while (word_seq.size() >= max_ngram_order_) {
       /// History state has at most <max_ngram_order_> - 1 words in the state.
@@ -102,19 +150,123 @@ bool KaldiRnnlmDeterministicFst::GetArc(StateId s, Label ilabel,
   std::pair<IterType, bool> result = wseq_to_state_.insert(wseq_state_pair);
 
   // If the pair was just inserted, then also add it to state_to_* structures.
+  *is_new = result.second;
   if (result.second == true) {
-    RnnlmComputeState *rnnlm2 = rnnlm->GetSuccessorState(ilabel);
     state_to_wseq_.push_back(word_seq);
-    state_to_rnnlm_state_.push_back(rnnlm2);
+    state_to_rnnlm_state_.push_back(NULL);
+    if (cache_ != NULL) {
+      // The RNNLM state of the new state will be that of state s advanced by
+      // 'word', whatever its n-gram history is.
+      std::vector<Label> history;
+      const std::vector<Label> &src_history = state_to_history_[s];
+      if (!src_history.empty() &&
+          static_cast<int32>(src_history.size()) <=
+          cache_->MaxHistoryLength()) {
+        history = src_history;
+        history.push_back(word);
+      }
+      state_to_history_.push_back(history);
+    }
+  }
+  return result.first->second;
+}
+
+RnnlmComputeState *KaldiRnnlmDeterministicFst::LookupCache(StateId s) {
+  if (cache_ == NULL || state_to_history_[s].empty())
+    return NULL;
+  return cache_->Lookup(state_to_history_[s]);
+}
+
+void KaldiRnnlmDeterministicFst::AddToCache(StateId s) {
+  if (cache_ != NULL && !state_to_history_[s].empty())
+    cache_->Insert(state_to_history_[s], *(state_to_rnnlm_state_[s]));
+}
+
+bool KaldiRnnlmDeterministicFst::GetArc(StateId s, Label ilabel,
+                                        fst::StdArc *oarc) {
+  /// At this point, we have created the state.
+  KALDI_ASSERT(static_cast<size_t>(s) < state_to_wseq_.size());
+
+  BaseFloat logprob;
+  StateId nextstate;
+  ArcMapType::const_iterator iter =
+      prefetched_arcs_.find(std::pair<StateId, Label>(s, ilabel));
+  if (iter != prefetched_arcs_.end()) {
+    logprob = iter->second.first;
+    nextstate = iter->second.second;
+  } else {
+    const RnnlmComputeState* rnnlm = state_to_rnnlm_state_[s];
+    logprob = rnnlm->LogProbOfWord(ilabel);
+    bool is_new;
+    nextstate = GetNextState(s, ilabel, &is_new);
+    if (is_new) {
+      RnnlmComputeState *successor = LookupCache(nextstate);
+      if (successor != NULL) {
+        state_to_rnnlm_state_[nextstate] = successor;
+      } else {
+        state_to_rnnlm_state_[nextstate] = rnnlm->GetSuccessorState(ilabel);
+        AddToCache(nextstate);
+      }
+    }
   }
 
   // Creates the arc.
   oarc->ilabel = ilabel;
   oarc->olabel = ilabel;
-  oarc->nextstate = result.first->second;
+  oarc->nextstate = nextstate;
   oarc->weight = Weight(-logprob);
   return true;
 }
 
+void KaldiRnnlmDeterministicFst::PrefetchArcs(
+    const std::vector<std::pair<StateId, Label> > &queries) {
+  // 'states' and 'words' are the pairs whose log-probs we need;
+  // 'successor_*' describe the new states.
+  std::vector<const RnnlmComputeState*> states, successor_sources;
+  std::vector<int32> words, successor_words;
+  std::vector<ArcMapType::key_type> keys;
+  std::vector<StateId> successor_ids;
+  for (size_t i = 0; i < queries.size(); i++) {
+    StateId s = queries[i].first;
+    Label word = queries[i].second;
+    KALDI_ASSERT(static_cast<size_t>(s) < state_to_wseq_.size());
+    std::pair<ArcMapType::iterator, bool> ret = prefetched_arcs_.insert(
+        ArcMapType::value_type(queries[i],
+                               std::pair<BaseFloat, StateId>(0.0, -1)));
+    if (!ret.second)
+      continue;  // Already prefetched, or a repeat.
+    bool is_new;
+    StateId nextstate = GetNextState(s, word, &is_new);
+    ret.first->second.second = nextstate;
+    const RnnlmComputeState *rnnlm = state_to_rnnlm_state_[s];
+    keys.push_back(queries[i]);
+    states.push_back(rnnlm);
+    words.push_back(word);
+    if (is_new) {
+      RnnlmComputeState *successor = LookupCache(nextstate);
+      if (successor != NULL) {
+        state_to_rnnlm_state_[nextstate] = successor;
+      } else {
+        successor_sources.push_back(rnnlm);
+        successor_words.push_back(word);
+        successor_ids.push_back(nextstate);
+      }
+    }
+  }
+
+  std::vector<BaseFloat> log_probs;
+  RnnlmComputeState::LogProbsOfWords(states, words, &log_probs);
+  for (size_t i = 0; i < keys.size(); i++)
+    prefetched_arcs_[keys[i]].first = log_probs[i];
+
+  std::vector<RnnlmComputeState*> successors;
+  RnnlmComputeState::GetSuccessorStates(successor_sources, successor_words,
+                                        &successors);
+  for (size_t i = 0; i < successors.size(); i++) {
+    state_to_rnnlm_state_[successor_ids[i]] = successors[i];
+    AddToCache(successor_ids[i]);
+  }
+}
+
 }  // namespace rnnlm
 }  // namespace kaldi
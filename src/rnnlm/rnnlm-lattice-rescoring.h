@@ -22,7 +22,10 @@
 #ifndef KALDI_RNNLM_RNNLM_LATTICE_RESCORING_H_
 #define KALDI_RNNLM_RNNLM_LATTICE_RESCORING_H_
 
+#include <list>
+#include <mutex>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "base/kaldi-common.h"
@@ -33,6 +36,63 @@
 namespace kaldi {
 namespace rnnlm {
 
+struct RnnlmStateCacheOptions {
+  int32 max_states;
+  int32 max_history_length;
+  RnnlmStateCacheOptions(): max_states(0), max_history_length(4) { }
+
+  void Register(OptionsItf *opts) {
+    opts->Register("rnnlm-cache-size", &max_states, "Maximum number of RNNLM "
+                   "states, of word histories at the start of a sentence, to "
+                   "keep from one utterance to the next (0 = none).");
+    opts->Register("rnnlm-cache-max-history", &max_history_length, "Longest "
+                   "history (in words, after <s>) whose RNNLM state is kept "
+                   "by --rnnlm-cache-size.");
+  }
+};
+
+/*
+  RnnlmStateCache keeps the RnnlmComputeStates of word histories that start at
+  the beginning of the sentence, so that they need not be computed again for
+  every utterance that starts with the same words.  It holds at most
+  opts.max_states states, of histories of at most opts.max_history_length
+  words (not counting <s>), and removes the least recently used first.  It may
+  be shared by KaldiRnnlmDeterministicFst objects in several threads.
+*/
+class RnnlmStateCache {
+ public:
+  explicit RnnlmStateCache(const RnnlmStateCacheOptions &opts);
+  ~RnnlmStateCache();
+
+  int32 MaxHistoryLength() const { return opts_.max_history_length; }
+
+  /// If the state for 'history' (which starts with <s>) is in the cache,
+  /// returns a copy of it, owned by the caller; otherwise returns NULL.
+  RnnlmComputeState *Lookup(const std::vector<int32> &history);
+
+  /// Adds a copy of 'state' as the state for 'history'.
+  void Insert(const std::vector<int32> &history,
+              const RnnlmComputeState &state);
+
+  /// Logs the number of lookups and the hit rate.
+  void PrintStats() const;
+
+ private:
+  typedef std::list<std::pair<std::vector<int32>, RnnlmComputeState*> >
+      ListType;
+  typedef unordered_map<std::vector<int32>, ListType::iterator,
+                        VectorHasher<int32> > MapType;
+
+  RnnlmStateCacheOptions opts_;
+  // The cached states, the most recently used first.
+  ListType states_;
+  // Maps each history to its position in states_.
+  MapType history_to_state_;
+  int64 num_lookups_;
+  int64 num_hits_;
+  mutable std::mutex mutex_;
+};
+
 class KaldiRnnlmDeterministicFst
     : public fst::DeterministicOnDemandFst<fst::StdArc> {
  public:
@@ -40,9 +100,10 @@ class KaldiRnnlmDeterministicFst
   typedef fst::StdArc::StateId StateId;
   typedef fst::StdArc::Label Label;
 
-  // Does not take ownership.
+  // Does not take ownership.  If 'cache' is not NULL, the states of the
+  // histories at the start of the sentence are looked up in it and added to it.
   KaldiRnnlmDeterministicFst(int32 max_ngram_order,
-      const RnnlmComputeStateInfo &info);
+      const RnnlmComputeStateInfo &info, RnnlmStateCache *cache = NULL);
   ~KaldiRnnlmDeterministicFst();
 
   void Clear();
@@ -57,7 +118,27 @@ class KaldiRnnlmDeterministicFst
 
   virtual bool GetArc(StateId s, Label ilabel, fst::StdArc* oarc);
 
+  // Works out the arcs for all these (state, word) pairs together, as a few
+  // matrix operations (see RnnlmComputeState::LogProbsOfWords() and
+  // GetSuccessorStates()), and keeps them until Clear() for GetArc() to
+  // return.
+  virtual void PrefetchArcs(
+      const std::vector<std::pair<StateId, Label> > &queries);
+
  private:
+  // Returns the state whose history is that of state s followed by 'word',
+  // adding it to state_to_wseq_ and wseq_to_state_ if it does not exist yet.
+  // In that case it sets *is_new to true and adds NULL to
+  // state_to_rnnlm_state_, which the caller must replace.
+  StateId GetNextState(StateId s, Label word, bool *is_new);
+
+  // Returns a copy of the cached RNNLM state for state s, or NULL if there is
+  // none.
+  RnnlmComputeState *LookupCache(StateId s);
+
+  // Adds the RNNLM state of state s to the cache, if appropriate.
+  void AddToCache(StateId s);
+
   typedef unordered_map
       <std::vector<Label>, StateId, VectorHasher<Label> > MapType;
   StateId start_state_;
@@ -74,6 +155,21 @@ class KaldiRnnlmDeterministicFst
   // The pointers are owned in this class
   std::vector<RnnlmComputeState*> state_to_rnnlm_state_;
 
+  // Not owned; may be NULL.
+  RnnlmStateCache *cache_;
+
+  // Mapping from state-id to the whole history (starting with <s>) of its
+  // RNNLM state, if it is short enough to be cached, else the empty vector.
+  // Only used if cache_ != NULL.
+  std::vector<std::vector<Label> > state_to_history_;
+
+  // The arcs worked out by PrefetchArcs(): maps (state, word) to the log-prob
+  // and the next state.
+  typedef unordered_map<std::pair<StateId, Label>,
+                        std::pair<BaseFloat, StateId>,
+                        PairHasher<int32> > ArcMapType;
+  ArcMapType prefetched_arcs_;
+
 };
 
 }  // namespace rnnlm
@@ -82,6 +82,28 @@ void RnnlmTrainer::Train(RnnlmExample *minibatch) {
                 << VocabSize() << ", got "
                 << minibatch->vocab_size;
 
+  std::vector<int32> active_words;
+  if (!minibatch->sampled_words.empty())
+    RenumberRnnlmExample(minibatch, &active_words);
+  TrainRenumbered(minibatch, active_words);
+}
+
+void RnnlmTrainer::Train(RnnlmExample *minibatch,
+                         const std::vector<int32> &active_words) {
+  // check the minibatch for sanity; after renumbering, the vocabulary size is
+  // the number of active words.
+  if (minibatch->sampled_words.empty() ?
+      minibatch->vocab_size != VocabSize() :
+      (active_words.empty() || active_words.back() >= VocabSize()))
+      KALDI_ERR << "Vocabulary size mismatch: expected "
+                << VocabSize() << ", got "
+                << (minibatch->sampled_words.empty() ? minibatch->vocab_size :
+                    (active_words.empty() ? 0 : active_words.back() + 1));
+  TrainRenumbered(minibatch, active_words);
+}
+
+void RnnlmTrainer::TrainRenumbered(RnnlmExample *minibatch,
+                                   const std::vector<int32> &active_words) {
   current_minibatch_.Swap(minibatch);
   num_minibatches_processed_++;
   RnnlmExampleDerived derived;
@@ -90,8 +112,8 @@ void RnnlmTrainer::Train(RnnlmExample *minibatch) {
   CuSparseMatrix<BaseFloat> active_word_features_trans;
 
   if (!current_minibatch_.sampled_words.empty()) {
-    std::vector<int32> active_words;
-    RenumberRnnlmExample(&current_minibatch_, &active_words);
+    KALDI_ASSERT(static_cast<int32>(active_words.size()) ==
+                 current_minibatch_.vocab_size);
     active_words_cuda.CopyFromVec(active_words);
 
     if (word_feature_mat_ != NULL) {
@@ -286,6 +308,74 @@ RnnlmTrainer::~RnnlmTrainer() {
 }
 
 
+RnnlmExamplePrefetcher::RnnlmExamplePrefetcher(
+    const std::string &examples_rspecifier, int32 num_ahead):
+    num_ahead_(num_ahead), done_(false), stop_(false) {
+  KALDI_ASSERT(num_ahead > 0);
+  thread_ = std::thread(&RnnlmExamplePrefetcher::Run, this,
+                        examples_rspecifier);
+}
+
+void RnnlmExamplePrefetcher::Run(std::string examples_rspecifier) {
+  try {
+    SequentialRnnlmExampleReader example_reader(examples_rspecifier);
+    for (; !example_reader.Done(); example_reader.Next()) {
+      PreparedExample *eg = new PreparedExample();
+      eg->minibatch.Swap(&(example_reader.Value()));
+      if (!eg->minibatch.sampled_words.empty())
+        RenumberRnnlmExample(&(eg->minibatch), &(eg->active_words));
+      std::unique_lock<std::mutex> lock(mutex_);
+      cond_.wait(lock, [this] {
+          return stop_ || static_cast<int32>(queue_.size()) < num_ahead_; });
+      if (stop_) {
+        delete eg;
+        break;
+      }
+      queue_.push_back(eg);
+      cond_.notify_all();
+    }
+  } catch (const std::exception &e) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    error_ = e.what();
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  done_ = true;
+  cond_.notify_all();
+}
+
+bool RnnlmExamplePrefetcher::Next(RnnlmExample *minibatch,
+                                  std::vector<int32> *active_words) {
+  PreparedExample *eg;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_.wait(lock, [this] { return done_ || !queue_.empty(); });
+    if (queue_.empty()) {
+      if (!error_.empty())
+        KALDI_ERR << "Error reading RNNLM examples: " << error_;
+      return false;
+    }
+    eg = queue_.front();
+    queue_.pop_front();
+    cond_.notify_all();
+  }
+  minibatch->Swap(&(eg->minibatch));
+  active_words->swap(eg->active_words);
+  delete eg;
+  return true;
+}
+
+RnnlmExamplePrefetcher::~RnnlmExamplePrefetcher() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+    cond_.notify_all();
+  }
+  thread_.join();
+  for (size_t i = 0; i < queue_.size(); i++)
+    delete queue_[i];
+}
+
+
 
 }  // namespace rnnlm
 }  // namespace kaldi
@@ -25,6 +25,10 @@
 #include "rnnlm/rnnlm-utils.h"
 #include "rnnlm/rnnlm-example-utils.h"
 #include "util/kaldi-semaphore.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
 
 
 namespace kaldi {
@@ -81,6 +85,13 @@ class RnnlmTrainer {
   // acquire it destructively, via Swap().
   void Train(RnnlmExample *minibatch);
 
+  // This version of Train() is for minibatches that have already been
+  // renumbered by RenumberRnnlmExample() if they were sampled (as done by
+  // class RnnlmExamplePrefetcher); 'active_words' is the list of active words
+  // it output, and is empty if the minibatch was not sampled.
+  void Train(RnnlmExample *minibatch,
+             const std::vector<int32> &active_words);
+
 
   // The destructor writes out any files that we need to write out.
   ~RnnlmTrainer();
@@ -91,6 +102,10 @@ class RnnlmTrainer {
 
   int32 VocabSize();
 
+  /// Does the part of Train() that comes after the renumbering.
+  void TrainRenumbered(RnnlmExample *minibatch,
+                       const std::vector<int32> &active_words);
+
   /// This function contains the actual training code, it's called from Train();
   /// it trains on minibatch_previous_.
   void TrainInternal();
@@ -189,6 +204,61 @@ class RnnlmTrainer {
 };
 
 
+/**
+   RnnlmExamplePrefetcher reads minibatches (as written by rnnlm-get-egs) in a
+   background thread and, for sampled minibatches, does the CPU-side
+   preparation that RnnlmTrainer::Train() would otherwise do on the thread that
+   drives the GPU, i.e. RenumberRnnlmExample().  With large vocabularies that
+   takes a noticeable fraction of the time per minibatch.  It works up to
+   'num_ahead' minibatches ahead of the trainer.  The output is the same as
+   reading the minibatches and giving them to RnnlmTrainer::Train() directly.
+
+   Usage is:
+  \code
+     RnnlmExamplePrefetcher prefetcher(examples_rspecifier, 2);
+     RnnlmExample minibatch;
+     std::vector<int32> active_words;
+     while (prefetcher.Next(&minibatch, &active_words))
+       trainer.Train(&minibatch, active_words);
+  \endcode
+*/
+class RnnlmExamplePrefetcher {
+ public:
+  /// Starts the background thread, which reads from 'examples_rspecifier'.
+  RnnlmExamplePrefetcher(const std::string &examples_rspecifier,
+                         int32 num_ahead);
+
+  /// Outputs the next minibatch, renumbered if it was sampled, and its list
+  /// of active words (empty if it was not sampled).  Returns false if there
+  /// were no more minibatches.  Throws if the background thread failed.
+  bool Next(RnnlmExample *minibatch, std::vector<int32> *active_words);
+
+  ~RnnlmExamplePrefetcher();
+
+ private:
+  struct PreparedExample {
+    RnnlmExample minibatch;
+    std::vector<int32> active_words;
+  };
+
+  // The function run by the background thread.
+  void Run(std::string examples_rspecifier);
+
+  int32 num_ahead_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  // The prepared minibatches that Next() has not yet output; protected by
+  // mutex_.
+  std::deque<PreparedExample*> queue_;
+  bool done_;  // set by the background thread when it finishes.
+  bool stop_;  // set by the destructor to stop the background thread.
+  std::string error_;  // the error message if the background thread failed.
+  std::thread thread_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(RnnlmExamplePrefetcher);
+};
+
+
 } // namespace rnnlm
 } // namespace kaldi
 
@@ -43,6 +43,11 @@ int main(int argc, char *argv[]) {
         "An example the n-best rescoring usage is at "
         "egs/swbd/s5c$ vi local/rnnlm/run_tdnn_lstm.sh"
         "\n"
+        "Lines are scored --batch-size at a time, with the RNNLM states of\n"
+        "prefixes they share (e.g. hypotheses of the same n-best list)\n"
+        "computed once, and the computation for all the histories at a word\n"
+        "position done together, which is much faster, especially on GPU.\n"
+        "\n"
         "Usage:\n"
         " rnnlm-sentence-probs [options] <rnnlm> <word-embedding-matrix> "
         "<input-text-file> \n"
@@ -52,6 +57,7 @@ int main(int argc, char *argv[]) {
 
     std::string use_gpu = "no";
     bool batchnorm_test_mode = true, dropout_test_mode = true;
+    int32 batch_size = 128;
 
     ParseOptions po(usage);
     rnnlm::RnnlmComputeStateComputationOptions opts;
@@ -62,6 +68,8 @@ int main(int argc, char *argv[]) {
     po.Register("dropout-test-mode", &dropout_test_mode,
                 "If true, set test-mode to true on any DropoutComponents and "
                 "DropoutMaskComponents.");
+    po.Register("batch-size", &batch_size,
+                "Number of lines of the input that are scored together.");
     opts.Register(&po);
 
     po.Read(argc, argv);
@@ -101,24 +109,35 @@ int main(int argc, char *argv[]) {
     std::ifstream ifile(text_filename.c_str());
 
     std::string key, line;
-    while (ifile >> key) {
-      getline(ifile, line);
-      std::vector<int32> v;
-      if (!SplitStringToIntegers(line, " ", true, &v)) {
-        KALDI_ERR << "Input file should contain only integers.";
+    std::vector<std::string> keys;
+    std::vector<std::vector<int32> > sentences;
+    bool done = false;
+    while (!done) {
+      if (ifile >> key) {
+        getline(ifile, line);
+        std::vector<int32> v;
+        if (!SplitStringToIntegers(line, " ", true, &v)) {
+          KALDI_ERR << "Input file should contain only integers.";
+        }
+        keys.push_back(key);
+        sentences.push_back(v);
+      } else {
+        done = true;
       }
-      RnnlmComputeState rnnlm_compute_state(info, opts.bos_index);
-
-      std::cout << key << " ";
-      for (int32 i = 0; i < v.size(); i++) {
-        int32 word_id = v[i];
-        std::cout << rnnlm_compute_state.LogProbOfWord(word_id) << " ";
-
-        rnnlm_compute_state.AddWord(word_id);
+      if (sentences.size() >= std::max<int32>(batch_size, 1) ||
+          (done && !sentences.empty())) {
+        std::vector<std::vector<BaseFloat> > log_probs;
+        ComputeSentenceLogProbs(info, sentences, &log_probs);
+        for (size_t i = 0; i < sentences.size(); i++) {
+          std::cout << keys[i] << " ";
+          // The last log-prob is that of the </s> symbol.
+          for (size_t j = 0; j + 1 < log_probs[i].size(); j++)
+            std::cout << log_probs[i][j] << " ";
+          std::cout << log_probs[i].back() << std::endl;
+        }
+        keys.clear();
+        sentences.clear();
       }
-      // add the </s> symbol
-      int32 word_id = opts.eos_index;
-      std::cout << rnnlm_compute_state.LogProbOfWord(word_id) << std::endl;
     }
 
 #if HAVE_CUDA==1
@@ -44,6 +44,7 @@ int main(int argc, char *argv[]) {
     std::string word_features_rxfilename;
     // binary mode for writing output.
     bool binary = true;
+    int32 num_prefetch = 2;
 
     RnnlmCoreTrainerOptions core_config;
     RnnlmEmbeddingTrainerOptions embedding_config;
@@ -90,6 +91,11 @@ int main(int argc, char *argv[]) {
                 "will be interpreted as a feature-embedding matrix.");
     po.Register("binary", &binary,
                 "If true, write outputs in binary form.");
+    po.Register("num-prefetch", &num_prefetch,
+                "Number of minibatches to read and prepare (i.e. renumber, "
+                "for sampled egs) ahead in a background thread, so that this "
+                "CPU work overlaps with training.  If 0, it is done on the "
+                "training thread.");
 
 
     objective_config.Register(&po);
@@ -165,10 +171,18 @@ int main(int argc, char *argv[]) {
           (word_features_rxfilename != "" ? &word_feature_mat : NULL),
           &embedding_mat, &rnnlm);
 
-      SequentialRnnlmExampleReader example_reader(examples_rspecifier);
-
-      for (; !example_reader.Done(); example_reader.Next())
-        trainer.Train(&(example_reader.Value()));
+      if (num_prefetch > 0) {
+        RnnlmExamplePrefetcher prefetcher(examples_rspecifier, num_prefetch);
+        RnnlmExample minibatch;
+        std::vector<int32> active_words;
+        while (prefetcher.Next(&minibatch, &active_words))
+          trainer.Train(&minibatch, active_words);
+      } else {
+        SequentialRnnlmExampleReader example_reader(examples_rspecifier);
+
+        for (; !example_reader.Done(); example_reader.Next())
+          trainer.Train(&(example_reader.Value()));
+      }
 
       if (trainer.NumMinibatchesProcessed() == 0)
         KALDI_ERR << "There was no data to train on.";
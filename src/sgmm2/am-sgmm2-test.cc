@@ -258,6 +258,64 @@ void TestSgmm2PreXform(const AmSgmm2 &sgmm) {
   KALDI_ASSERT(res_vec.IsZero(1.0e-5));
 }
 
+// Checks SubstateLikelihoods() against LogLikelihood().
+void TestSgmm2SubstateLikelihoods(const kaldi::FullGmm &full_gmm) {
+  using namespace kaldi;
+  std::vector<int32> pdf2group;
+  pdf2group.push_back(0);
+  pdf2group.push_back(1);
+  pdf2group.push_back(1);
+  pdf2group.push_back(2);
+  AmSgmm2 sgmm;
+  int32 dim = full_gmm.Dim();
+  sgmm.InitializeFromFullGmm(full_gmm, pdf2group, dim + 1, 0, false, 0.8);
+  sgmm.ComputeNormalizers();
+
+  Sgmm2GselectConfig config;
+  config.full_gmm_nbest = std::min(config.full_gmm_nbest, sgmm.NumGauss());
+  int32 num_frames = 1 + Rand() % 5;
+  Sgmm2PerSpkDerivedVars empty;
+  std::vector<Sgmm2PerFrameDerivedVars> per_frame(num_frames);
+  for (int32 t = 0; t < num_frames; t++) {
+    Vector<BaseFloat> feat(dim);
+    feat.SetRandn();
+    std::vector<int32> gselect;
+    sgmm.GaussianSelection(config, feat, &gselect);
+    sgmm.ComputePerFrameVars(feat, gselect, empty, &(per_frame[t]));
+  }
+  std::vector<int32> groups;
+  groups.push_back(2);
+  groups.push_back(0);
+  groups.push_back(1);
+  Matrix<BaseFloat> likes, remaining_log_likes;
+  sgmm.SubstateLikelihoods(per_frame, groups, &empty, &likes,
+                           &remaining_log_likes);
+
+  Sgmm2LikelihoodCache cache(sgmm.NumGroups(), sgmm.NumPdfs()),
+      batch_cache(sgmm.NumGroups(), sgmm.NumPdfs());
+  for (int32 t = 0; t < num_frames; t++) {
+    cache.NextFrame();
+    batch_cache.NextFrame();
+    int32 offset = 0;
+    for (size_t g = 0; g < groups.size(); g++) {
+      int32 num_substates = sgmm.NumSubstatesForGroup(groups[g]);
+      Sgmm2LikelihoodCache::SubstateCacheElement &elem =
+          batch_cache.substate_cache[groups[g]];
+      elem.likes = likes.Row(t).Range(offset, num_substates);
+      elem.remaining_log_like = remaining_log_likes(t, g);
+      elem.t = batch_cache.t;
+      offset += num_substates;
+    }
+    for (int32 j2 = 0; j2 < sgmm.NumPdfs(); j2++) {
+      BaseFloat loglike = sgmm.LogLikelihood(per_frame[t], j2, &cache,
+                                             &empty),
+          batch_loglike = sgmm.LogLikelihood(per_frame[t], j2, &batch_cache,
+                                             &empty);
+      AssertEqual(loglike, batch_loglike, 1e-4);
+    }
+  }
+}
+
 void UnitTestSgmm2() {
   size_t dim = 1 + kaldi::RandInt(0, 9);  // random dimension of the gmm
   size_t num_comp = 1 + kaldi::RandInt(0, 9);  // random number of mixtures
@@ -275,6 +333,7 @@ void UnitTestSgmm2() {
   TestSgmm2Substates(sgmm);
   TestSgmm2IncreaseDim(sgmm);
   TestSgmm2PreXform(sgmm);
+  TestSgmm2SubstateLikelihoods(full_gmm);
 }
 
 int main() {
@@ -570,6 +570,84 @@ BaseFloat AmSgmm2::LogLikelihood(const Sgmm2PerFrameDerivedVars &per_frame_vars,
   return log_like;
 }
 
+void AmSgmm2::SubstateLikelihoods(
+    const std::vector<Sgmm2PerFrameDerivedVars> &per_frame_vars,
+    const std::vector<int32> &groups,
+    Sgmm2PerSpkDerivedVars *spk_vars,
+    Matrix<BaseFloat> *likes,
+    Matrix<BaseFloat> *remaining_log_likes) const {
+  int32 num_frames = per_frame_vars.size(), num_groups = groups.size(),
+      phn_dim = PhoneSpaceDim();
+  std::vector<int32> substate_offsets(num_groups + 1, 0),
+      gselect_offsets(num_frames + 1, 0);
+  for (int32 g = 0; g < num_groups; g++) {
+    KALDI_ASSERT(groups[g] >= 0 && groups[g] < NumGroups());
+    substate_offsets[g + 1] = substate_offsets[g] + v_[groups[g]].NumRows();
+  }
+  for (int32 t = 0; t < num_frames; t++)
+    gselect_offsets[t + 1] = gselect_offsets[t] +
+        per_frame_vars[t].gselect.size();
+  int32 tot_substates = substate_offsets[num_groups],
+      tot_gselect = gselect_offsets[num_frames];
+  likes->Resize(num_frames, tot_substates, kUndefined);
+  remaining_log_likes->Resize(num_frames, num_groups, kUndefined);
+  if (tot_substates == 0 || tot_gselect == 0)
+    return;
+
+  bool speaker_dep_weights =
+      (spk_vars->v_s.Dim() != 0 && HasSpeakerDependentWeights());
+  if (speaker_dep_weights) {
+    KALDI_ASSERT(static_cast<int32>(spk_vars->log_d_jms.size()) == NumGroups());
+    KALDI_ASSERT(static_cast<int32>(w_jmi_.size()) == NumGroups() ||
+                 "You need to call ComputeWeights().");
+  }
+
+  // z_{i}(t)^T v_{jm} for all the frames, selected Gaussians, groups and
+  // substates, as one matrix product.
+  Matrix<BaseFloat> z(tot_gselect, phn_dim, kUndefined),
+      v(tot_substates, phn_dim, kUndefined);
+  for (int32 t = 0; t < num_frames; t++)
+    z.RowRange(gselect_offsets[t], gselect_offsets[t + 1] - gselect_offsets[t]).
+        CopyFromMat(per_frame_vars[t].zti);
+  for (int32 g = 0; g < num_groups; g++)
+    v.RowRange(substate_offsets[g], substate_offsets[g + 1] -
+               substate_offsets[g]).CopyFromMat(v_[groups[g]]);
+  Matrix<BaseFloat> loglikes(tot_gselect, tot_substates, kUndefined);
+  loglikes.AddMatMat(1.0, z, kNoTrans, v, kTrans, 0.0);
+
+  // The rest is as in ComponentLogLikes() and LogLikelihood(), for each block
+  // of "loglikes".
+  for (int32 g = 0; g < num_groups; g++) {
+    int32 j1 = groups[g], num_substates = v_[j1].NumRows();
+    if (speaker_dep_weights && spk_vars->log_d_jms[j1].Dim() == 0) {
+      Vector<BaseFloat> &log_d = spk_vars->log_d_jms[j1];
+      log_d.Resize(num_substates);
+      log_d.AddMatVec(1.0, w_jmi_[j1], kNoTrans, spk_vars->b_is, 0.0);
+      log_d.ApplyLog();
+    }
+    for (int32 t = 0; t < num_frames; t++) {
+      const std::vector<int32> &gselect = per_frame_vars[t].gselect;
+      int32 num_gselect = gselect.size();
+      SubMatrix<BaseFloat> block(loglikes, gselect_offsets[t], num_gselect,
+                                 substate_offsets[g], num_substates);
+      for (int32 ki = 0; ki < num_gselect; ki++) {
+        SubVector<BaseFloat> logp_xi(block, ki);
+        logp_xi.AddVec(1.0, n_[j1].Row(gselect[ki]));
+        logp_xi.Add(per_frame_vars[t].nti(ki));
+      }
+      if (speaker_dep_weights)
+        block.AddVecToRows(-1.0, spk_vars->log_d_jms[j1]);
+      BaseFloat max = block.Max();
+      block.Add(-max);
+      block.ApplyExp();
+      (*remaining_log_likes)(t, g) = max;
+      SubVector<BaseFloat> these_likes(likes->Row(t), substate_offsets[g],
+                                       num_substates);
+      these_likes.AddRowSumMat(1.0, block, 0.0);
+    }
+  }
+}
+
 BaseFloat
 AmSgmm2::ComponentPosteriors(const Sgmm2PerFrameDerivedVars &per_frame_vars,
                             int32 j2,
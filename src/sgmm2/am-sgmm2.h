@@ -297,6 +297,23 @@ class AmSgmm2 {
                           Sgmm2PerSpkDerivedVars *spk_vars,
                           BaseFloat log_prune = 0.0) const;
   
+  /// Computes the sub-state likelihoods of the groups "groups" on several
+  /// frames at once (e.g. a few frames of a decoder's input); this is the part
+  /// of LogLikelihood() that is shared by the pdfs of a group.  The products
+  /// of z_{i}(t) with the sub-state vectors v_{jm}, which are most of the
+  /// work, are done as one matrix product.  On exit, "likes" is indexed by
+  /// [frame][offset of group + substate], where the offset of groups[g] is the
+  /// total number of substates of groups[0..g-1], and "remaining_log_likes" is
+  /// indexed by [frame][g]; the likelihoods are as in the
+  /// Sgmm2LikelihoodCache::SubstateCacheElement, i.e. the likelihood is
+  /// likes(t, offset + m) * exp(remaining_log_likes(t, g)).
+  void SubstateLikelihoods(
+      const std::vector<Sgmm2PerFrameDerivedVars> &per_frame_vars,
+      const std::vector<int32> &groups,
+      Sgmm2PerSpkDerivedVars *spk_vars,
+      Matrix<BaseFloat> *likes,
+      Matrix<BaseFloat> *remaining_log_likes) const;
+
   /// Similar to LogLikelihood() function above, but also computes the posterior
   /// probabilities for the pre-selected Gaussian components and all substates.
   /// This one doesn't use caching to share computation for the groups of
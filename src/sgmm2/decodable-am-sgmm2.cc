@@ -34,20 +34,57 @@ DecodableAmSgmm2::~DecodableAmSgmm2() {
   }
 }
 
+void DecodableAmSgmm2::StartWindow(int32 frame) {
+  window_start_ = frame;
+  int32 num_frames = NumFramesReady() - frame;
+  if (num_frames > kFrameWindow)
+    num_frames = kFrameWindow;
+  window_vars_.resize(num_frames);
+  for (int32 t = 0; t < num_frames; t++) {
+    SubVector<BaseFloat> data(*feature_matrix_, frame + t);
+    sgmm_.ComputePerFrameVars(data, (*gselect_)[frame + t], *spk_,
+                              &(window_vars_[t]));
+  }
+  // The groups that were used on the last frame we saw are likely to be
+  // used on these frames too.
+  window_groups_ = used_groups_;
+  sgmm_.SubstateLikelihoods(window_vars_, window_groups_, spk_,
+                            &window_likes_, &window_remaining_log_likes_);
+}
+
 BaseFloat DecodableAmSgmm2::LogLikelihoodForPdf(int32 frame, int32 pdf_id) {
   if (frame != cur_frame_) {
+    if (window_start_ < 0 || frame < window_start_ ||
+        frame >= window_start_ + static_cast<int32>(window_vars_.size()))
+      StartWindow(frame);
     cur_frame_ = frame;
+    used_groups_.clear();
     sgmm_cache_.NextFrame(); // it has a frame-index internally but it doesn't
     // have to match up with our index here, it just needs to be unique.
 
-
-    SubVector<BaseFloat> data(*feature_matrix_, frame);
-    
-    sgmm_.ComputePerFrameVars(data, (*gselect_)[frame], *spk_,
-                              &per_frame_vars_);
+    // Put the sub-state likelihoods computed at the start of the window into
+    // the cache, so LogLikelihood() finds them.
+    int32 t = frame - window_start_, offset = 0;
+    for (size_t g = 0; g < window_groups_.size(); g++) {
+      Sgmm2LikelihoodCache::SubstateCacheElement &substate_cache =
+          sgmm_cache_.substate_cache[window_groups_[g]];
+      int32 num_substates = sgmm_.NumSubstatesForGroup(window_groups_[g]);
+      if (substate_cache.likes.Dim() != num_substates)
+        substate_cache.likes.Resize(num_substates, kUndefined);
+      substate_cache.likes.CopyFromVec(
+          window_likes_.Row(t).Range(offset, num_substates));
+      substate_cache.remaining_log_like = window_remaining_log_likes_(t, g);
+      substate_cache.t = sgmm_cache_.t;
+      offset += num_substates;
+    }
+  }
+  int32 group = sgmm_.Pdf2Group(pdf_id);
+  if (group_used_frame_[group] != frame) {
+    group_used_frame_[group] = frame;
+    used_groups_.push_back(group);
   }
-  return sgmm_.LogLikelihood(per_frame_vars_, pdf_id, &sgmm_cache_, spk_,
-                             log_prune_);  
+  return sgmm_.LogLikelihood(window_vars_[frame - window_start_], pdf_id,
+                             &sgmm_cache_, spk_, log_prune_);
 }
 
 
@@ -30,6 +30,13 @@
 
 namespace kaldi {
 
+/// DecodableAmSgmm2 works on windows of a few frames.  At the start of each
+/// window it computes, for all the frames of the window, the sub-state
+/// likelihoods of the pdf-groups that the decoder asked about on the frame
+/// before, with AmSgmm2::SubstateLikelihoods() (most of which is one matrix
+/// product); as the set of active pdfs changes slowly, this covers most of
+/// what the decoder asks for.  Any other group is computed on its own when it
+/// is first needed on a frame.
 class DecodableAmSgmm2 : public DecodableInterface {
  public:
   DecodableAmSgmm2(const AmSgmm2 &sgmm,
@@ -41,7 +48,8 @@ class DecodableAmSgmm2 : public DecodableInterface {
       sgmm_(sgmm), spk_(spk),
       trans_model_(tm), feature_matrix_(&feats),
       gselect_(&gselect), log_prune_(log_prune), cur_frame_(-1),
-      sgmm_cache_(sgmm.NumGroups(), sgmm.NumPdfs()), delete_vars_(false) {
+      sgmm_cache_(sgmm.NumGroups(), sgmm.NumPdfs()), delete_vars_(false),
+      window_start_(-1), group_used_frame_(sgmm.NumGroups(), -1) {
     KALDI_ASSERT(gselect.size() == static_cast<size_t>(feats.NumRows()));
   }
 
@@ -56,7 +64,8 @@ class DecodableAmSgmm2 : public DecodableInterface {
       sgmm_(sgmm), spk_(spk),
       trans_model_(tm), feature_matrix_(feats),
       gselect_(gselect), log_prune_(log_prune), cur_frame_(-1),
-      sgmm_cache_(sgmm.NumGroups(), sgmm.NumPdfs()), delete_vars_(true) {
+      sgmm_cache_(sgmm.NumGroups(), sgmm.NumPdfs()), delete_vars_(true),
+      window_start_(-1), group_used_frame_(sgmm.NumGroups(), -1) {
     KALDI_ASSERT(gselect->size() == static_cast<size_t>(feats->NumRows()));
   }
 
@@ -86,13 +95,32 @@ class DecodableAmSgmm2 : public DecodableInterface {
   BaseFloat log_prune_;
 
   int32 cur_frame_;
-  Sgmm2PerFrameDerivedVars per_frame_vars_;
   Sgmm2LikelihoodCache sgmm_cache_;
 
   bool delete_vars_; // If true, we will delete feature_matrix_, gselect_, and
   // spk_ in the destructor.
 
  private:
+  static const int32 kFrameWindow = 8;
+
+  // Starts a window of frames at "frame": computes the per-frame quantities of
+  // its frames, and the sub-state likelihoods of the groups in used_groups_.
+  void StartWindow(int32 frame);
+
+  // The first frame of the current window, or -1.
+  int32 window_start_;
+  // The per-frame quantities, indexed by frame - window_start_.
+  std::vector<Sgmm2PerFrameDerivedVars> window_vars_;
+  // The groups whose sub-state likelihoods were computed for the whole window,
+  // and those likelihoods, as output by AmSgmm2::SubstateLikelihoods().
+  std::vector<int32> window_groups_;
+  Matrix<BaseFloat> window_likes_;
+  Matrix<BaseFloat> window_remaining_log_likes_;
+  // The groups asked about on cur_frame_, and for each group the last frame it
+  // was asked about on.
+  std::vector<int32> used_groups_;
+  std::vector<int32> group_used_frame_;
+
   KALDI_DISALLOW_COPY_AND_ASSIGN(DecodableAmSgmm2);
 };
 
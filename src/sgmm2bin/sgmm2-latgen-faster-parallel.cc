@@ -129,6 +129,7 @@ int main(int argc, char *argv[]) {
     TaskSequencerConfig sequencer_config; // has --num-threads option
     decoder_opts.Register(&po);
     sequencer_config.Register(&po);
+    RegisterGlobalThreadPoolOptions(&po);
 
     po.Register("acoustic-scale", &acoustic_scale,
         "Scaling factor for acoustic likelihoods");
@@ -169,7 +170,7 @@ int main(int argc, char *argv[]) {
     fst::SymbolTable *word_syms = NULL;
     
     TaskSequencer<DecodeUtteranceLatticeFasterClass> sequencer(
-        sequencer_config);
+        sequencer_config, &GlobalThreadPool());
     TransitionModel trans_model;
     kaldi::AmSgmm2 am_sgmm;
     {
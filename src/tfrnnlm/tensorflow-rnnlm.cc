@@ -18,6 +18,7 @@
 // limitations under the License.
 
 
+#include <algorithm>
 #include <utility>
 #include <fstream>
 
@@ -61,6 +62,52 @@ void SetUnkPenalties(const string &filename,
   }
 }
 
+// The context and cell tensors of the TF RNNLM hold one history each along
+// their second-to-last axis (e.g. [num-layers, 2, 1, hidden-size] for the
+// context of an LSTM, [1, hidden-size] for the cell).  This stacks several of
+// them into one tensor along that axis.
+static void StackTensors(const std::vector<const Tensor*> &tensors,
+                         Tensor *out) {
+  KALDI_ASSERT(!tensors.empty());
+  tensorflow::TensorShape shape = tensors[0]->shape();
+  int32 rank = shape.dims();
+  KALDI_ASSERT(rank >= 2 && shape.dim_size(rank - 2) == 1);
+  int64 n = tensors.size(),
+      inner = shape.dim_size(rank - 1),
+      outer = shape.num_elements() / inner;
+  shape.set_dim(rank - 2, n);
+  *out = Tensor(tensorflow::DT_FLOAT, shape);
+  float *out_data = out->flat<float>().data();
+  for (int64 b = 0; b < n; b++) {
+    KALDI_ASSERT(tensors[b]->NumElements() == outer * inner);
+    const float *in_data = tensors[b]->flat<float>().data();
+    for (int64 o = 0; o < outer; o++)
+      std::copy(in_data + o * inner, in_data + (o + 1) * inner,
+                out_data + (o * n + b) * inner);
+  }
+}
+
+// The inverse of StackTensors(): splits 'in' along its second-to-last axis.
+static void UnstackTensors(const Tensor &in, std::vector<Tensor> *out) {
+  tensorflow::TensorShape shape = in.shape();
+  int32 rank = shape.dims();
+  KALDI_ASSERT(rank >= 2);
+  int64 n = shape.dim_size(rank - 2),
+      inner = shape.dim_size(rank - 1),
+      outer = shape.num_elements() / (n * inner);
+  shape.set_dim(rank - 2, 1);
+  out->resize(n);
+  const float *in_data = in.flat<float>().data();
+  for (int64 b = 0; b < n; b++) {
+    (*out)[b] = Tensor(tensorflow::DT_FLOAT, shape);
+    float *out_data = (*out)[b].flat<float>().data();
+    for (int64 o = 0; o < outer; o++)
+      std::copy(in_data + (o * n + b) * inner,
+                in_data + (o * n + b + 1) * inner,
+                out_data + o * inner);
+  }
+}
+
 // Read tensorflow checkpoint files
 void KaldiTfRnnlmWrapper::ReadTfModel(const std::string &tf_model_path,
                                       int32 num_threads) {
@@ -84,6 +131,23 @@ void KaldiTfRnnlmWrapper::ReadTfModel(const std::string &tf_model_path,
     KALDI_ERR << status.ToString();
   }
 
+  // The graph accepts batches if the batch dimension of the word input is
+  // unknown.
+  supports_batching_ = false;
+  const tensorflow::GraphDef &graph = graph_def.graph_def();
+  for (int32 i = 0; i < graph.node_size(); i++) {
+    const tensorflow::NodeDef &node = graph.node(i);
+    if (node.name() != "Train/Model/test_word_in")
+      continue;
+    auto iter = node.attr().find("shape");
+    if (iter != node.attr().end() && iter->second.shape().dim_size() > 0 &&
+        iter->second.shape().dim(0).size() == -1)
+      supports_batching_ = true;
+  }
+  KALDI_VLOG(1) << "The TF RNNLM graph "
+                << (supports_batching_ ? "accepts" : "does not accept")
+                << " batches of histories.";
+
   // Add the graph to the session
   status = session_->Create(graph_def.graph_def());
   if (!status.ok()) {
@@ -108,7 +172,8 @@ KaldiTfRnnlmWrapper::KaldiTfRnnlmWrapper(
     const std::string &rnn_wordlist,
     const std::string &word_symbol_table_rxfilename,
     const std::string &unk_prob_file,
-    const std::string &tf_model_path): opts_(opts) {
+    const std::string &tf_model_path): opts_(opts),
+                                       supports_batching_(false) {
   ReadTfModel(tf_model_path, opts.num_threads);
 
   fst::SymbolTable *fst_word_symbols = NULL;
@@ -256,18 +321,91 @@ BaseFloat KaldiTfRnnlmWrapper::GetLogProb(int32 word,
     }
   }
 
-  float ans;
-  if (word != oos_) {
-    ans = outputs[0].scalar<float>()();
+  return AddOosCost(word, fst_word, outputs[0].scalar<float>()());
+}
+
+BaseFloat KaldiTfRnnlmWrapper::AddOosCost(int32 word, int32 fst_word,
+                                          BaseFloat logprob) const {
+  if (word != oos_)
+    return logprob;
+  if (unk_costs_.size() == 0)
+    return logprob - log(num_total_words - num_rnn_words);
+  else
+    return logprob + unk_costs_[fst_word];
+}
+
+void KaldiTfRnnlmWrapper::GetLogProbs(
+    const std::vector<int32> &words,
+    const std::vector<int32> &fst_words,
+    const std::vector<const Tensor*> &contexts_in,
+    const std::vector<const Tensor*> &cells_in,
+    std::vector<BaseFloat> *logprobs,
+    std::vector<Tensor> *contexts_out,
+    std::vector<Tensor> *cells_out) {
+  size_t n = words.size();
+  KALDI_ASSERT(fst_words.size() == n && contexts_in.size() == n &&
+               cells_in.size() == n &&
+               (contexts_out == NULL) == (cells_out == NULL));
+  logprobs->resize(n);
+  if (contexts_out != NULL) {
+    contexts_out->resize(n);
+    cells_out->resize(n);
+  }
+  if (n == 0)
+    return;
+
+  if (!supports_batching_) {
+    for (size_t i = 0; i < n; i++)
+      (*logprobs)[i] = GetLogProb(
+          words[i], fst_words[i], *(contexts_in[i]), *(cells_in[i]),
+          contexts_out != NULL ? &((*contexts_out)[i]) : NULL,
+          cells_out != NULL ? &((*cells_out)[i]) : NULL);
+    return;
+  }
+
+  Tensor thesewords(tensorflow::DT_INT32,
+                    {static_cast<tensorflow::int64>(n), 1});
+  auto word_data = thesewords.flat<int32>();
+  for (size_t i = 0; i < n; i++)
+    word_data(i) = words[i];
+  Tensor cell_in;
+  StackTensors(cells_in, &cell_in);
+
+  std::vector<std::pair<string, Tensor> > inputs;
+  std::vector<Tensor> outputs;
+  Status status;
+  if (contexts_out != NULL) {
+    Tensor context_in;
+    StackTensors(contexts_in, &context_in);
+    inputs = {
+      {"Train/Model/test_word_in", thesewords},
+      {"Train/Model/test_word_out", thesewords},
+      {"Train/Model/test_state_in", context_in},
+      {"Train/Model/test_cell_in", cell_in},
+    };
+    status = session_->Run(inputs,
+        {"Train/Model/test_out",
+         "Train/Model/test_state_out",
+         "Train/Model/test_cell_out"}, {}, &outputs);
   } else {
-    if (unk_costs_.size() == 0) {
-      ans = outputs[0].scalar<float>()() - log(num_total_words - num_rnn_words);
-    } else {
-      ans = outputs[0].scalar<float>()() + unk_costs_[fst_word];
-    }
+    inputs = {
+      {"Train/Model/test_word_out", thesewords},
+      {"Train/Model/test_cell_in", cell_in},
+    };
+    status = session_->Run(inputs, {"Train/Model/test_out"}, {}, &outputs);
+  }
+  if (!status.ok()) {
+    KALDI_ERR << status.ToString();
   }
 
-  return ans;
+  auto out_data = outputs[0].flat<float>();
+  KALDI_ASSERT(out_data.size() == static_cast<int64>(n));
+  for (size_t i = 0; i < n; i++)
+    (*logprobs)[i] = AddOosCost(words[i], fst_words[i], out_data(i));
+  if (contexts_out != NULL) {
+    UnstackTensors(outputs[1], contexts_out);
+    UnstackTensors(outputs[2], cells_out);
+  }
 }
 
 const Tensor& KaldiTfRnnlmWrapper::GetInitialContext() const {
@@ -324,6 +462,7 @@ void TfRnnlmDeterministicFst::Clear() {
   state_to_wseq_.resize(1);
   wseq_to_state_.clear();
   wseq_to_state_[state_to_wseq_[0]] = 0;
+  prefetched_arcs_.clear();
 }
 
 
@@ -339,23 +478,9 @@ fst::StdArc::Weight TfRnnlmDeterministicFst::Final(StateId s) {
   return Weight(-logprob);
 }
 
-bool TfRnnlmDeterministicFst::GetArc(StateId s, Label ilabel,
-                                     fst::StdArc *oarc) {
-  KALDI_ASSERT(static_cast<size_t>(s) < state_to_wseq_.size());
-
+TfRnnlmDeterministicFst::StateId TfRnnlmDeterministicFst::GetNextState(
+    StateId s, Label rnn_word, bool *is_new) {
   std::vector<Label> wseq = state_to_wseq_[s];
-  Tensor *new_context = new Tensor();
-  Tensor *new_cell = new Tensor();
-
-  // look-up the rnn label from the FST label
-  int32 rnn_word = rnnlm_->FstLabelToRnnLabel(ilabel);
-  BaseFloat logprob = rnnlm_->GetLogProb(rnn_word,
-                                         ilabel,
-                                         *state_to_context_[s],
-                                         *state_to_cell_[s],
-                                         new_context,
-                                         new_cell);
-
   wseq.push_back(rnn_word);
   if (max_ngram_order_ > 0) {
     while (wseq.size() >= max_ngram_order_) {
@@ -374,22 +499,98 @@ bool TfRnnlmDeterministicFst::GetArc(StateId s, Label ilabel,
 
   // If the pair was just inserted, then also add it to <state_to_wseq_> and
   // <state_to_context_>.
+  *is_new = result.second;
   if (result.second == true) {
     state_to_wseq_.push_back(wseq);
-    state_to_context_.push_back(new_context);
-    state_to_cell_.push_back(new_cell);
+    state_to_context_.push_back(NULL);
+    state_to_cell_.push_back(NULL);
+  }
+  return result.first->second;
+}
+
+bool TfRnnlmDeterministicFst::GetArc(StateId s, Label ilabel,
+                                     fst::StdArc *oarc) {
+  KALDI_ASSERT(static_cast<size_t>(s) < state_to_wseq_.size());
+
+  BaseFloat logprob;
+  StateId nextstate;
+  ArcMapType::const_iterator iter =
+      prefetched_arcs_.find(std::pair<StateId, Label>(s, ilabel));
+  if (iter != prefetched_arcs_.end()) {
+    logprob = iter->second.first;
+    nextstate = iter->second.second;
   } else {
-    delete new_context;
-    delete new_cell;
+    Tensor *new_context = new Tensor();
+    Tensor *new_cell = new Tensor();
+
+    // look-up the rnn label from the FST label
+    int32 rnn_word = rnnlm_->FstLabelToRnnLabel(ilabel);
+    logprob = rnnlm_->GetLogProb(rnn_word,
+                                 ilabel,
+                                 *state_to_context_[s],
+                                 *state_to_cell_[s],
+                                 new_context,
+                                 new_cell);
+    bool is_new;
+    nextstate = GetNextState(s, rnn_word, &is_new);
+    if (is_new) {
+      state_to_context_[nextstate] = new_context;
+      state_to_cell_[nextstate] = new_cell;
+    } else {
+      delete new_context;
+      delete new_cell;
+    }
   }
 
   // Creates the arc.
   oarc->ilabel = ilabel;
   oarc->olabel = ilabel;
-  oarc->nextstate = result.first->second;
+  oarc->nextstate = nextstate;
   oarc->weight = Weight(-logprob);
 
   return true;
 }
 
+void TfRnnlmDeterministicFst::PrefetchArcs(
+    const std::vector<std::pair<StateId, Label> > &queries) {
+  std::vector<ArcMapType::key_type> keys;
+  std::vector<int32> rnn_words, fst_words;
+  std::vector<const Tensor*> contexts, cells;
+  for (size_t i = 0; i < queries.size(); i++) {
+    StateId s = queries[i].first;
+    Label ilabel = queries[i].second;
+    KALDI_ASSERT(static_cast<size_t>(s) < state_to_wseq_.size());
+    if (!prefetched_arcs_.insert(ArcMapType::value_type(
+            queries[i], std::pair<BaseFloat, StateId>(0.0, -1))).second)
+      continue;  // Already prefetched, or a repeat.
+    keys.push_back(queries[i]);
+    rnn_words.push_back(rnnlm_->FstLabelToRnnLabel(ilabel));
+    fst_words.push_back(ilabel);
+    contexts.push_back(state_to_context_[s]);
+    cells.push_back(state_to_cell_[s]);
+  }
+  if (keys.empty())
+    return;
+
+  // We work out the successor tensors for all the queries in the same
+  // Session::Run() call, even those whose next state already exists, as one
+  // call costs much more than a few extra rows.
+  std::vector<BaseFloat> logprobs;
+  std::vector<Tensor> new_contexts, new_cells;
+  rnnlm_->GetLogProbs(rnn_words, fst_words, contexts, cells,
+                      &logprobs, &new_contexts, &new_cells);
+
+  // Now that we have their tensors, create the states that are new.
+  for (size_t i = 0; i < keys.size(); i++) {
+    bool is_new;
+    StateId nextstate = GetNextState(keys[i].first, rnn_words[i], &is_new);
+    if (is_new) {
+      state_to_context_[nextstate] = new Tensor(new_contexts[i]);
+      state_to_cell_[nextstate] = new Tensor(new_cells[i]);
+    }
+    prefetched_arcs_[keys[i]] =
+        std::pair<BaseFloat, StateId>(logprobs[i], nextstate);
+  }
+}
+
 }  // namespace kaldi
@@ -129,6 +129,27 @@ class KaldiTfRnnlmWrapper {
                        Tensor *context_out,
                        Tensor *cell_out);
 
+  /// The batched version of GetLogProb(): computes the log-probs of words[i]
+  /// given the histories with contexts_in[i] and cells_in[i], and if
+  /// contexts_out and cells_out are not NULL, the tensors of the histories
+  /// extended by words[i].  If the TF graph accepts batches (see
+  /// SupportsBatching()) this is a single Session::Run() call with inputs of
+  /// size [batch x 1], the context and cell tensors being stacked along their
+  /// batch axis; otherwise it calls GetLogProb() for each word.
+  void GetLogProbs(const std::vector<int32> &words,
+                   const std::vector<int32> &fst_words,
+                   const std::vector<const Tensor*> &contexts_in,
+                   const std::vector<const Tensor*> &cells_in,
+                   std::vector<BaseFloat> *logprobs,
+                   std::vector<Tensor> *contexts_out,
+                   std::vector<Tensor> *cells_out);
+
+  /// returns true if the placeholders of the TF graph have an unknown batch
+  /// dimension, as in the graphs written by the current
+  /// steps/tfrnnlm/{lstm,lstm_fast,vanilla_rnnlm}.py; graphs written by older
+  /// versions of those scripts only accept one history at a time.
+  bool SupportsBatching() const { return supports_batching_; }
+
   /// takes in a word-id for FST and return the word-id for RNNLM
   /// return the word-id for <oos> if not found
   int FstLabelToRnnLabel(int i) const;
@@ -141,6 +162,10 @@ class KaldiTfRnnlmWrapper {
   /// do queries on the session to get the initial tensors (cell + context)
   void AcquireInitialTensors();
 
+  /// adds the extra cost of the OOS word to the log-prob the TF model gives
+  /// for rnn word 'word' (FST word 'fst_word'), if it is the OOS word.
+  BaseFloat AddOosCost(int32 word, int32 fst_word, BaseFloat logprob) const;
+
   /// since usually we have a smaller vocab in RNN than the whole vocab,
   /// we use this mapping during rescoring
   std::vector<int> fst_label_to_rnn_label_;
@@ -157,6 +182,7 @@ class KaldiTfRnnlmWrapper {
   int32 num_rnn_words;
 
   Session* session_;  // for TF computation; pointer owned here
+  bool supports_batching_;
   int32 eos_;
   int32 oos_;
 
@@ -187,7 +213,19 @@ class TfRnnlmDeterministicFst:
 
   virtual bool GetArc(StateId s, Label ilabel, fst::StdArc* oarc);
 
+  // Works out the arcs for all these (state, word) pairs with one call to
+  // KaldiTfRnnlmWrapper::GetLogProbs(), and keeps them until Clear() for
+  // GetArc() to return.
+  virtual void PrefetchArcs(
+      const std::vector<std::pair<StateId, Label> > &queries);
+
  private:
+  // Returns the state whose history is that of state s followed by rnn word
+  // 'rnn_word', adding it to state_to_wseq_ and wseq_to_state_ if it does not
+  // exist yet.  In that case it sets *is_new to true and adds NULL to
+  // state_to_context_ and state_to_cell_, which the caller must replace.
+  StateId GetNextState(StateId s, Label rnn_word, bool *is_new);
+
   typedef unordered_map<std::vector<Label>,
                         StateId, VectorHasher<Label> > MapType;
   StateId start_state_;
@@ -198,6 +236,13 @@ class TfRnnlmDeterministicFst:
   int32 max_ngram_order_;
   std::vector<Tensor*> state_to_context_;
   std::vector<Tensor*> state_to_cell_;
+
+  // The arcs worked out by PrefetchArcs(): maps (state, ilabel) to the
+  // log-prob and the next state.
+  typedef unordered_map<std::pair<StateId, Label>,
+                        std::pair<BaseFloat, StateId>,
+                        PairHasher<int32> > ArcMapType;
+  ArcMapType prefetched_arcs_;
 };
 
 }  // namespace tf_rnnlm
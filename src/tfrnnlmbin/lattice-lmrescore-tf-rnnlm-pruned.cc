@@ -44,6 +44,9 @@ int main(int argc, char *argv[]) {
         "Rescores lattice with rnnlm that is trained with TensorFlow.\n"
         "An example script for training and rescoring with the TensorFlow\n"
         "RNNLM is at egs/ami/s5/local/tfrnnlm/run_lstm_fast.sh\n"
+        "With --lm-batch-size > 1, the RNNLM scores of that many pending\n"
+        "histories are computed in one TensorFlow session run, if the model\n"
+        "was written by a version of steps/tfrnnlm/*.py that supports batches.\n"
         "\n"
         "Usage: lattice-lmrescore-tf-rnnlm-pruned [options] [unk-file] \\\n"
         "             <old-lm> <fst-wordlist> <rnnlm-wordlist> \\\n"
@@ -61,6 +61,15 @@ void AccCmvnStats(const MatrixBase<BaseFloat> &feats,
   }
 }
 
+void AccCmvnStats(const MatrixStats &feat_stats, MatrixBase<double> *stats) {
+  int32 dim = feat_stats.NumCols();
+  KALDI_ASSERT(stats != NULL);
+  KALDI_ASSERT(stats->NumRows() == 2 && stats->NumCols() == dim + 1);
+  stats->Row(0).Range(0, dim).AddVec(1.0, feat_stats.Sum());
+  stats->Row(1).Range(0, dim).AddVec(1.0, feat_stats.SumSq());
+  (*stats)(0, dim) += feat_stats.NumRows();
+}
+
 void ApplyCmvn(const MatrixBase<double> &stats,
                bool var_norm,
                MatrixBase<BaseFloat> *feats) {
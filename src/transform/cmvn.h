@@ -43,6 +43,11 @@ void AccCmvnStats(const MatrixBase<BaseFloat> &feats,
                   const VectorBase<BaseFloat> *weights,  // or NULL
                   MatrixBase<double> *stats);
 
+/// Accumulation from the statistics of a feature file (unweighted), which may
+/// have been read from its header without reading the features; see
+/// matrix/matrix-stats.h.
+void AccCmvnStats(const MatrixStats &feat_stats, MatrixBase<double> *stats);
+
 /// Apply cepstral mean and variance normalization to a matrix of features.
 /// If norm_vars == true, expects stats to be of dimension 2 by (dim+1), but
 /// if norm_vars == false, will accept stats of dimension 1 by (dim+1); these
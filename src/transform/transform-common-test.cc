@@ -0,0 +1,75 @@
+// transform/transform-common-test.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "transform/transform-common.h"
+
+namespace kaldi {
+
+// Checks ApplySplicedTransform() against splicing the features explicitly and
+// then applying the transform, and also with a composed transform against
+// applying the two transforms one after the other.
+void UnitTestApplySplicedTransform() {
+  int32 num_frames = RandInt(1, 20), dim = RandInt(1, 10),
+      left_context = RandInt(0, 5), right_context = RandInt(0, 5),
+      num_splice = 1 + left_context + right_context,
+      spliced_dim = dim * num_splice, out_dim = RandInt(1, 15);
+  bool affine = (RandInt(0, 1) == 0);
+  Matrix<BaseFloat> feats(num_frames, dim),
+      xform(out_dim, spliced_dim + (affine ? 1 : 0));
+  feats.SetRandn();
+  xform.SetRandn();
+
+  // Splice the features as splice-feats does, with a 1 appended if the
+  // transform is affine.
+  Matrix<BaseFloat> spliced(num_frames, xform.NumCols());
+  for (int32 t = 0; t < num_frames; t++) {
+    for (int32 j = 0; j < num_splice; j++) {
+      int32 t2 = std::min(num_frames - 1, std::max(0, t + j - left_context));
+      SubVector<BaseFloat> dst(spliced.Row(t), j * dim, dim);
+      dst.CopyFromVec(feats.Row(t2));
+    }
+    if (affine)
+      spliced(t, spliced_dim) = 1.0;
+  }
+  Matrix<BaseFloat> ref_out(num_frames, out_dim), out;
+  ref_out.AddMatMat(1.0, spliced, kNoTrans, xform, kTrans, 0.0);
+  ApplySplicedTransform(xform, left_context, right_context, feats, &out);
+  AssertEqual(ref_out, out, 1.0e-04);
+
+  // Now an fMLLR-like square affine transform on top of it.
+  Matrix<BaseFloat> fmllr(out_dim, out_dim + 1), composed;
+  fmllr.SetRandn();
+  Matrix<BaseFloat> ref_out2(num_frames, out_dim);
+  for (int32 t = 0; t < num_frames; t++) {
+    SubVector<BaseFloat> row(ref_out2, t);
+    row.CopyFromVec(ref_out.Row(t));
+    ApplyAffineTransform(fmllr, &row);
+  }
+  ComposeTransforms(fmllr, xform, affine, &composed);
+  ApplySplicedTransform(composed, left_context, right_context, feats, &out);
+  AssertEqual(ref_out2, out, 1.0e-03);
+}
+
+}  // namespace kaldi
+
+int main() {
+  for (int32 i = 0; i < 20; i++)
+    kaldi::UnitTestApplySplicedTransform();
+  std::cout << "Test OK.\n";
+}
@@ -17,6 +17,7 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <vector>
 
 #include "base/kaldi-common.h"
@@ -177,5 +178,50 @@ void ApplyAffineTransform(const MatrixBase<BaseFloat> &xform,
   vec->AddMatVec(1.0, xform, kNoTrans, tmp, 0.0);
 }
 
+void ApplySplicedTransform(const MatrixBase<BaseFloat> &xform,
+                           int32 left_context, int32 right_context,
+                           const MatrixBase<BaseFloat> &feats,
+                           Matrix<BaseFloat> *feats_out) {
+  int32 num_frames = feats.NumRows(), dim = feats.NumCols(),
+      num_splice = 1 + left_context + right_context,
+      spliced_dim = dim * num_splice, out_dim = xform.NumRows();
+  KALDI_ASSERT(left_context >= 0 && right_context >= 0);
+  if (xform.NumCols() != spliced_dim && xform.NumCols() != spliced_dim + 1)
+    KALDI_ERR << "Transform has " << xform.NumCols() << " columns, expected "
+              << spliced_dim << " or " << (spliced_dim + 1)
+              << " for features of dimension " << dim << " spliced "
+              << num_splice << " times.";
+  feats_out->Resize(num_frames, out_dim);
+
+  Vector<BaseFloat> edge_out(out_dim);
+  for (int32 j = 0; j < num_splice; j++) {
+    // Output frame t sees input frame t + shift in this block, except at the
+    // edges: frames [0, begin) see frame 0, and [end, num_frames) see the
+    // last frame.
+    int32 shift = j - left_context,
+        begin = std::min(num_frames, std::max(0, -shift)),
+        end = std::max(0, std::min(num_frames, num_frames - shift));
+    SubMatrix<BaseFloat> xform_part(xform, 0, out_dim, j * dim, dim);
+    if (begin < end)
+      feats_out->RowRange(begin, end - begin).AddMatMat(
+          1.0, feats.RowRange(begin + shift, end - begin), kNoTrans,
+          xform_part, kTrans, 1.0);
+    if (begin > 0) {
+      edge_out.AddMatVec(1.0, xform_part, kNoTrans, feats.Row(0), 0.0);
+      feats_out->RowRange(0, begin).AddVecToRows(1.0, edge_out);
+    }
+    if (end < num_frames) {
+      edge_out.AddMatVec(1.0, xform_part, kNoTrans,
+                         feats.Row(num_frames - 1), 0.0);
+      feats_out->RowRange(end, num_frames - end).AddVecToRows(1.0, edge_out);
+    }
+  }
+  if (xform.NumCols() == spliced_dim + 1) {  // add the offset.
+    Vector<BaseFloat> offset(out_dim);
+    offset.CopyColFromMat(xform, spliced_dim);
+    feats_out->AddVecToRows(1.0, offset);
+  }
+}
+
 }  // namespace kaldi
 
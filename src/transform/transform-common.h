@@ -66,6 +66,21 @@ bool ComposeTransforms(const Matrix<BaseFloat> &a, const Matrix<BaseFloat> &b,
 void ApplyAffineTransform(const MatrixBase<BaseFloat> &xform,
                           VectorBase<BaseFloat> *vec);
 
+/// Applies the linear or affine transform 'xform' to the features 'feats'
+/// spliced with 'left_context' and 'right_context' frames of context, as
+/// splice-feats does them (the first and last frames are repeated at the
+/// edges), and puts the result in 'feats_out'.  'xform' must have
+/// (1 + left_context + right_context) * feats.NumCols() columns, plus one if
+/// it is affine.  This gives the same result as SpliceFrames() followed by
+/// the transform, but the spliced features are never created: each block of
+/// columns of 'xform' is applied to the frames, shifted, in one matrix
+/// multiplication.  Together with ComposeTransforms(), this lets a chain of
+/// splicing and transforms (e.g. LDA then fMLLR) be applied in one pass.
+void ApplySplicedTransform(const MatrixBase<BaseFloat> &xform,
+                           int32 left_context, int32 right_context,
+                           const MatrixBase<BaseFloat> &feats,
+                           Matrix<BaseFloat> *feats_out);
+
 
 
 }  // namespace kaldi
@@ -816,6 +816,19 @@ void TestSplitDecisionTree() {
         KALDI_ASSERT(fabs(impr - impr_check) < 0.1);
       }
 
+      {  // Check that splitting with several threads gives the same tree.
+        int32 num_leaves_mt = 1;
+        EventMap *split_tree_mt = SplitDecisionTree(*trivial_tree, stats, qo,
+                                                    thresh, max_leaves,
+                                                    &num_leaves_mt, NULL, NULL,
+                                                    1 + Rand() % 4);
+        KALDI_ASSERT(num_leaves_mt == num_leaves);
+        std::ostringstream os, os_mt;
+        split_tree->Write(os, false);
+        split_tree_mt->Write(os_mt, false);
+        KALDI_ASSERT(os.str() == os_mt.str());
+        delete split_tree_mt;
+      }
 
       std::cout << "After splitting, num_leaves = " << num_leaves << '\n';
 
@@ -17,8 +17,10 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <atomic>
 #include <set>
 #include <queue>
+#include "util/kaldi-thread.h"
 #include "util/stl-utils.h"
 #include "tree/build-tree-utils.h"
 
@@ -355,10 +357,18 @@ BaseFloat FindBestSplitForKey(const BuildTreeStatsType &stats,
     return 0.0;  // Can't split as key not always defined.
   }
   std::vector<Clusterable*> summed_stats;  // indexed by value corresponding to key. owned here.
-  {  // compute summed_stats
-    std::vector<BuildTreeStatsType> split_stats;
-    SplitStatsByKey(stats, key, &split_stats);
-    SumStatsVec(split_stats, &summed_stats);
+  {  // compute summed_stats.  This is what SplitStatsByKey() followed by
+     // SumStatsVec() would give, but without copying the event vectors.
+    for (BuildTreeStatsType::const_iterator iter = stats.begin();
+         iter != stats.end(); ++iter) {
+      EventValueType val;
+      EventMap::Lookup(iter->first, key, &val);  // will not fail.
+      if (static_cast<size_t>(val) >= summed_stats.size())
+        summed_stats.resize(val + 1, NULL);
+      if (iter->second == NULL) continue;
+      if (summed_stats[val] == NULL) summed_stats[val] = iter->second->Copy();
+      else summed_stats[val]->Add(*(iter->second));
+    }
   }
 
   std::vector<EventValueType> yes_set;
@@ -444,15 +454,26 @@ class DecisionTreeSplitter {
       best_split_impr_ = std::max(yes_->BestSplit(), no_->BestSplit());  // may have changed.
     }
   }
-  DecisionTreeSplitter(EventAnswerType leaf, const BuildTreeStatsType &stats,
-                      const Questions &q_opts): q_opts_(q_opts), yes_(NULL), no_(NULL), leaf_(leaf), stats_(stats) {
-    // not, this must work when stats is empty too. [just gives zero improvement, non-splittable].
-    FindBestSplit();
+  // Note: the stats are swapped out of "stats", and the best split is not
+  // known until FindBestSplits() has been called with this object.
+  DecisionTreeSplitter(EventAnswerType leaf, BuildTreeStatsType *stats,
+                       const Questions &q_opts, int32 num_threads):
+      q_opts_(q_opts), num_threads_(num_threads), best_split_impr_(0.0),
+      yes_(NULL), no_(NULL), leaf_(leaf) {
+    stats_.swap(*stats);
   }
   ~DecisionTreeSplitter() {
     delete yes_;
     delete no_;
   }
+
+  // Finds the best split of each of "splitters" (which must be leaves); this
+  // sets their best_split_impr_, key_ and yes_set_.  This must work when the
+  // stats are empty too [just gives zero improvement, non-splittable].  The
+  // keys of all the splitters are tried in parallel, and the results are the
+  // same as if they were tried one by one.
+  static void FindBestSplits(const std::vector<DecisionTreeSplitter*> &splitters,
+                             const Questions &q_opts, int32 num_threads);
  private:
   void DoSplitInternal(int32 *next_leaf) {
     // Does the split; applicable only to leaf nodes.
@@ -481,38 +502,28 @@ class DecisionTreeSplitter {
       delete yes_clust; delete no_clust;
     }
 #endif
-    yes_ = new DecisionTreeSplitter(yes_leaf, yes_stats, q_opts_);
-    no_ = new DecisionTreeSplitter(no_leaf, no_stats, q_opts_);
+    // Free the memory of our copy of the stats (clear() would keep it), so
+    // that only the leaves hold copies of the event vectors.  Note: pointers
+    // in stats_ were not owned here.
+    int32 num_stats = stats_.size();
+    BuildTreeStatsType().swap(stats_);
+    yes_ = new DecisionTreeSplitter(yes_leaf, &yes_stats, q_opts_, num_threads_);
+    no_ = new DecisionTreeSplitter(no_leaf, &no_stats, q_opts_, num_threads_);
+    std::vector<DecisionTreeSplitter*> children(2);
+    children[0] = yes_;
+    children[1] = no_;
+    // Starting threads costs more than evaluating the questions on a handful
+    // of stats, which is what most splits near the leaves have.
+    FindBestSplits(children, q_opts_,
+                   (num_stats >= kMinStatsForThreads ? num_threads_ : 1));
     best_split_impr_ = std::max(yes_->BestSplit(), no_->BestSplit());
-    stats_.clear();  // note: pointers in stats_ were not owned here.
   }
-  void FindBestSplit() {
-    // This sets best_split_impr_, key_ and yes_set_.
-    // May just pick best question, or may iterate a bit (depends on
-    // q_opts; see FindBestSplitForKey for details)
-    std::vector<EventKeyType> all_keys;
-    q_opts_.GetKeysWithQuestions(&all_keys);
-    if (all_keys.size() == 0) {
-      KALDI_WARN << "DecisionTreeSplitter::FindBestSplit(), no keys available to split on (maybe no key covered all of your events, or there was a problem with your questions configuration?)";
-    }
-    best_split_impr_ = 0;
-    for (size_t i = 0; i < all_keys.size(); i++) {
-      if (q_opts_.HasQuestionsForKey(all_keys[i])) {
-        std::vector<EventValueType> temp_yes_set;
-        BaseFloat split_improvement = FindBestSplitForKey(stats_, q_opts_, all_keys[i], &temp_yes_set);
-        if (split_improvement > best_split_impr_) {
-          best_split_impr_ = split_improvement;
-          yes_set_ = temp_yes_set;
-          key_ = all_keys[i];
-        }
-      }
-    }
-  }
-
 
+  static const int32 kMinStatsForThreads = 256;
 
   // Data members... Always used:
   const Questions &q_opts_;
+  int32 num_threads_;
   BaseFloat best_split_impr_;
 
   // If already split:
@@ -529,6 +540,84 @@ class DecisionTreeSplitter {
 
 };
 
+// One (leaf, key) pair whose best split is to be found.
+struct SplitTask {
+  const BuildTreeStatsType *stats;
+  EventKeyType key;
+  BaseFloat improvement;
+  std::vector<EventValueType> yes_set;
+};
+
+// Finds the best splits of a subset of the tasks (relates to multi-threading).
+// The tasks take very different amounts of time, so the threads take the next
+// task from a shared counter rather than a fixed subset of them.
+class FindBestSplitClass: public MultiThreadable {
+ public:
+  FindBestSplitClass(const Questions &q_opts, std::vector<SplitTask> *tasks,
+                     std::atomic<size_t> *next_task):
+      q_opts_(q_opts), tasks_(tasks), next_task_(next_task) { }
+  void operator () () {
+    size_t i;
+    while ((i = (*next_task_)++) < tasks_->size()) {
+      SplitTask &task = (*tasks_)[i];
+      task.improvement = FindBestSplitForKey(*(task.stats), q_opts_, task.key,
+                                             &(task.yes_set));
+    }
+  }
+ private:
+  const Questions &q_opts_;
+  std::vector<SplitTask> *tasks_;
+  std::atomic<size_t> *next_task_;
+};
+
+void DecisionTreeSplitter::FindBestSplits(
+    const std::vector<DecisionTreeSplitter*> &splitters,
+    const Questions &q_opts, int32 num_threads) {
+  // May just pick best question, or may iterate a bit (depends on
+  // q_opts; see FindBestSplitForKey for details)
+  std::vector<EventKeyType> all_keys, keys;
+  q_opts.GetKeysWithQuestions(&all_keys);
+  if (all_keys.size() == 0) {
+    KALDI_WARN << "DecisionTreeSplitter::FindBestSplit(), no keys available to split on (maybe no key covered all of your events, or there was a problem with your questions configuration?)";
+  }
+  for (size_t i = 0; i < all_keys.size(); i++)
+    if (q_opts.HasQuestionsForKey(all_keys[i]))
+      keys.push_back(all_keys[i]);
+
+  std::vector<SplitTask> tasks(splitters.size() * keys.size());
+  for (size_t s = 0; s < splitters.size(); s++) {
+    for (size_t k = 0; k < keys.size(); k++) {
+      SplitTask &task = tasks[s * keys.size() + k];
+      task.stats = &(splitters[s]->stats_);
+      task.key = keys[k];
+      task.improvement = 0.0;
+    }
+  }
+  std::atomic<size_t> next_task(0);
+  FindBestSplitClass c(q_opts, &tasks, &next_task);
+  {
+    // With num_threads == 0, MultiThreader runs it in this thread.
+    MultiThreader<FindBestSplitClass> m(
+        num_threads > 1 && tasks.size() > 1 ?
+        std::min<int32>(num_threads, tasks.size()) : 0, c);
+  }
+
+  // Take the keys in order, so ties are resolved as if they had been tried
+  // one by one.
+  for (size_t s = 0; s < splitters.size(); s++) {
+    DecisionTreeSplitter *splitter = splitters[s];
+    splitter->best_split_impr_ = 0;
+    for (size_t k = 0; k < keys.size(); k++) {
+      SplitTask &task = tasks[s * keys.size() + k];
+      if (task.improvement > splitter->best_split_impr_) {
+        splitter->best_split_impr_ = task.improvement;
+        splitter->yes_set_.swap(task.yes_set);
+        splitter->key_ = task.key;
+      }
+    }
+  }
+}
+
 EventMap *SplitDecisionTree(const EventMap &input_map,
                             const BuildTreeStatsType &stats,
                             Questions &q_opts,
@@ -536,7 +625,8 @@ EventMap *SplitDecisionTree(const EventMap &input_map,
                             int32 max_leaves,  // max_leaves<=0 -> no maximum.
                             int32 *num_leaves,
                             BaseFloat *obj_impr_out,
-                            BaseFloat *smallest_split_change_out) {
+                            BaseFloat *smallest_split_change_out,
+                            int32 num_threads) {
   KALDI_ASSERT(num_leaves != NULL && *num_leaves > 0);  // can't be 0 or input_map would be empty.
   int32 num_empty_leaves = 0;
   BaseFloat like_impr = 0.0;
@@ -551,8 +641,10 @@ EventMap *SplitDecisionTree(const EventMap &input_map,
     for (size_t i = 0;i < split_stats.size();i++) {
       EventAnswerType leaf = static_cast<EventAnswerType>(i);
       if (split_stats[i].size() == 0) num_empty_leaves++;
-      builders[i] = new DecisionTreeSplitter(leaf, split_stats[i], q_opts);
+      builders[i] = new DecisionTreeSplitter(leaf, &(split_stats[i]), q_opts,
+                                             num_threads);
     }
+    DecisionTreeSplitter::FindBestSplits(builders, q_opts, num_threads);
   }
 
   {  // Do the splitting.
@@ -20,50 +20,120 @@
 #ifndef KALDI_UTIL_EDIT_DISTANCE_INL_H_
 #define KALDI_UTIL_EDIT_DISTANCE_INL_H_
 #include <algorithm>
+#include <limits>
 #include <utility>
 #include <vector>
 #include "util/stl-utils.h"
 
 namespace kaldi {
 
+namespace internal {
+
+// Returns the edit distance between a and b, computed with the bit-parallel
+// algorithm of Myers (1999) in the multi-word form given by Hyyro (2003).
+// Column j of the edit-distance table (over the positions of a) is stored as
+// bit-vectors of its +1 and -1 vertical differences, and is advanced by one
+// symbol of b in O(ceil(|a| / 64)) word operations, which is 64 times fewer
+// operations than the textbook recursion.
 template<class T>
-int32 LevenshteinEditDistance(const std::vector<T> &a,
+int32 BitParallelEditDistance(const std::vector<T> &a,
                               const std::vector<T> &b) {
-  // Algorithm:
-  //  write A and B for the sequences, with elements a_0 ..
-  //  let |A| = M and |B| = N be the lengths, and have
-  //  elements a_0 ... a_{M-1} and b_0 ... b_{N-1}.
-  //  We are computing the recursion
-  //     E(m, n) = min(  E(m-1, n-1) + (1-delta(a_{m-1}, b_{n-1})),
-  //                    E(m-1, n) + 1,
-  //                    E(m, n-1) + 1).
-  //  where E(m, n) is defined for m = 0..M and n = 0..N and out-of-
-  //  bounds quantities are considered to be infinity (i.e. the
-  //  recursion does not visit them).
-
-  // We do this computation using a vector e of size N+1.
-  // The outer iterations range over m = 0..M.
-
-  int M = a.size(), N = b.size();
-  std::vector<int32> e(N+1);
-  std::vector<int32> e_tmp(N+1);
-  // initialize e.
-  for (size_t i = 0; i < e.size(); i++)
-    e[i] = i;
-  for (int32 m = 1; m <= M; m++) {
-    // computing E(m, .) from E(m-1, .)
-    // handle special case n = 0:
-    e_tmp[0] = e[0] + 1;
-
-    for (int32 n = 1; n <= N; n++) {
-      int32 term1 = e[n-1] + (a[m-1] == b[n-1] ? 0 : 1);
-      int32 term2 = e[n] + 1;
-      int32 term3 = e_tmp[n-1] + 1;
-      e_tmp[n] = std::min(term1, std::min(term2, term3));
+  size_t M = a.size(), N = b.size();
+  if (M == 0 || N == 0)
+    return M + N;
+  size_t num_words = (M + 63) / 64;
+  // For each distinct symbol of a, the bit-vector of the positions in a at
+  // which it occurs; symbol s occupies peq[s * num_words ... ].
+  typedef unordered_map<T, size_t> SymbolMap;
+  SymbolMap symbol_index;
+  std::vector<uint64> peq;
+  for (size_t i = 0; i < M; i++) {
+    std::pair<typename SymbolMap::iterator, bool> ret =
+        symbol_index.insert(std::make_pair(a[i], symbol_index.size()));
+    if (ret.second)
+      peq.resize(peq.size() + num_words, 0);
+    peq[ret.first->second * num_words + i / 64] |= uint64(1) << (i % 64);
+  }
+  std::vector<uint64> no_match(num_words, 0),
+      pv(num_words, ~uint64(0)),  // +1 vertical differences
+      mv(num_words, 0);           // -1 vertical differences
+  const uint64 last_bit = uint64(1) << ((M - 1) % 64);
+  int32 score = M;
+  for (size_t j = 0; j < N; j++) {
+    typename SymbolMap::const_iterator iter = symbol_index.find(b[j]);
+    const uint64 *eq_vec = (iter == symbol_index.end() ? &(no_match[0]) :
+                            &(peq[iter->second * num_words]));
+    // The horizontal difference entering the top of the column; the first
+    // row of the table is 0, 1, 2, ... so it is always +1.
+    int32 h = 1;
+    for (size_t w = 0; w < num_words; w++) {
+      uint64 eq = eq_vec[w], p = pv[w], m = mv[w],
+          xv = eq | m;
+      if (h < 0) eq |= 1;
+      uint64 xh = (((eq & p) + p) ^ p) | eq,
+          ph = m | ~(xh | p),
+          mh = p & xh,
+          top_bit = (w + 1 == num_words ? last_bit : uint64(1) << 63);
+      int32 h_out = ((ph & top_bit) ? 1 : ((mh & top_bit) ? -1 : 0));
+      ph <<= 1;
+      mh <<= 1;
+      if (h < 0) mh |= 1;
+      else if (h > 0) ph |= 1;
+      pv[w] = mh | ~(xv | ph);
+      mv[w] = ph & xv;
+      h = h_out;
+    }
+    score += h;
+  }
+  return score;
+}
+
+// The range [*begin, *end] of columns n that are in the band |m - n| <= band
+// in row m of a table with columns 0 ... num_cols - 1.
+inline void GetBandRange(size_t m, size_t band, size_t num_cols,
+                         size_t *begin, size_t *end) {
+  *begin = (m > band ? m - band : 0);
+  *end = std::min(m + band, num_cols - 1);
+}
+
+// An edit-distance table with rows 0 ... num_rows - 1 and columns
+// 0 ... num_cols - 1 that stores only the cells with |m - n| <= band; row m
+// holds columns GetBandRange(m, ...) contiguously, starting at row_offset_[m].
+// Cost() of a cell outside the band is kInfCost.
+class BandedEditDistanceTable {
+ public:
+  static const int32 kInfCost = std::numeric_limits<int32>::max() / 2;
+
+  BandedEditDistanceTable(size_t num_rows, size_t num_cols, size_t band):
+      band_(band), row_offset_(num_rows + 1) {
+    row_offset_[0] = 0;
+    for (size_t m = 0; m < num_rows; m++) {
+      size_t begin, end;
+      GetBandRange(m, band, num_cols, &begin, &end);
+      row_offset_[m + 1] = row_offset_[m] + (end + 1 - begin);
     }
-    e = e_tmp;
+    cells_.resize(row_offset_.back());
   }
-  return e.back();
+  // Requires the cell to be in the band.
+  int32 &Cell(size_t m, size_t n) {
+    return cells_[row_offset_[m] + n - (m > band_ ? m - band_ : 0)];
+  }
+  int32 Cost(size_t m, size_t n) const {
+    if (n + band_ < m || n > m + band_) return kInfCost;
+    return cells_[row_offset_[m] + n - (m > band_ ? m - band_ : 0)];
+  }
+ private:
+  size_t band_;
+  std::vector<size_t> row_offset_;
+  std::vector<int32> cells_;
+};
+
+}  // namespace internal
+
+template<class T>
+int32 LevenshteinEditDistance(const std::vector<T> &a,
+                              const std::vector<T> &b) {
+  return internal::BitParallelEditDistance(a, b);
 }
 //
 struct error_stats {
@@ -79,12 +149,24 @@ template<class T>
 int32 LevenshteinEditDistance(const std::vector<T> &ref,
                               const std::vector<T> &hyp,
                               int32 *ins, int32 *del, int32 *sub) {
+  // We first get the edit distance d from the bit-parallel algorithm.  Any
+  // cell (hyp_index, ref_index) on a path of cost d has
+  // |hyp_index - ref_index| <= d, so the recursion below only needs to visit
+  // that band of the table; cells outside it are treated as infinitely
+  // costly.  Cells in the band whose cost is at most d, and the choices made
+  // between them, are the same as with the full table, so the counts are
+  // unchanged; for nearly-correct hypotheses this is close to linear time.
+  size_t band = internal::BitParallelEditDistance(ref, hyp);
+  const int32 kInfCost = internal::BandedEditDistanceTable::kInfCost;
+  error_stats inf_stats;
+  inf_stats.ins_num = inf_stats.del_num = inf_stats.sub_num = 0;
+  inf_stats.total_cost = kInfCost;
   // temp sequence to remember error type and stats.
-  std::vector<error_stats> e(ref.size()+1);
-  std::vector<error_stats> cur_e(ref.size()+1);
+  std::vector<error_stats> e(ref.size()+1, inf_stats);
+  std::vector<error_stats> cur_e(ref.size()+1, inf_stats);
   // initialize the first hypothesis aligned to the reference at each
   // position:[hyp_index =0][ref_index]
-  for (size_t i =0; i < e.size(); i ++) {
+  for (size_t i =0; i < e.size() && i <= band; i ++) {
     e[i].ins_num = 0;
     e[i].sub_num = 0;
     e[i].del_num = i;
@@ -93,10 +175,17 @@ int32 LevenshteinEditDistance(const std::vector<T> &ref,
 
   // for other alignments
   for (size_t hyp_index = 1; hyp_index <= hyp.size(); hyp_index ++) {
-    cur_e[0] = e[0];
-    cur_e[0].ins_num++;
-    cur_e[0].total_cost++;
-    for (size_t ref_index = 1; ref_index <= ref.size(); ref_index ++) {
+    size_t begin, end;
+    internal::GetBandRange(hyp_index, band, ref.size() + 1, &begin, &end);
+    if (begin == 0) {
+      cur_e[0] = e[0];
+      cur_e[0].ins_num++;
+      cur_e[0].total_cost++;
+      begin = 1;
+    } else {
+      cur_e[begin - 1] = inf_stats;
+    }
+    for (size_t ref_index = begin; ref_index <= end; ref_index ++) {
      int32 ins_err = e[ref_index].total_cost + 1;
      int32 del_err = cur_e[ref_index-1].total_cost + 1;
      int32 sub_err = e[ref_index-1].total_cost;
@@ -118,9 +207,10 @@ int32 LevenshteinEditDistance(const std::vector<T> &ref,
         cur_e[ref_index].ins_num++;    // insertion number is increased.
      }
   }
-  e = cur_e;  // alternate for the next recursion.
+  e.swap(cur_e);  // alternate for the next recursion.
   }
   size_t ref_index = e.size()-1;
+  KALDI_ASSERT(e[ref_index].total_cost == static_cast<int32>(band));
   *ins = e[ref_index].ins_num, *del =
     e[ref_index].del_num, *sub = e[ref_index].sub_num;
   return e[ref_index].total_cost;
@@ -138,20 +228,28 @@ int32 LevenshteinAlignment(const std::vector<T> &a,
     for (size_t i = 0; i < b.size(); i++) KALDI_ASSERT(b[i] != eps_symbol);
   }
   output->clear();
-  // This is very memory-inefficiently implemented using a vector of vectors.
+  // As in LevenshteinEditDistance() above, only the cells with
+  // |m - n| <= band, where band is the edit distance, can be on the best path,
+  // so we store just those.  This needs O((M + N) * band) memory instead of
+  // O(M * N).
   size_t M = a.size(), N = b.size();
   size_t m, n;
-  std::vector<std::vector<int32> > e(M+1);
-  for (m = 0; m <=M; m++) e[m].resize(N+1);
-  for (n = 0; n <= N; n++)
-    e[0][n]  = n;
+  size_t band = internal::BitParallelEditDistance(a, b);
+  internal::BandedEditDistanceTable e(M + 1, N + 1, band);
+  for (n = 0; n <= N && n <= band; n++)
+    e.Cell(0, n) = n;
   for (m = 1; m <= M; m++) {
-    e[m][0] = e[m-1][0] + 1;
-    for (n = 1; n <= N; n++) {
-      int32 sub_or_ok = e[m-1][n-1] + (a[m-1] == b[n-1] ? 0 : 1);
-      int32 del = e[m-1][n] + 1;  // assumes a == ref, b == hyp.
-      int32 ins = e[m][n-1] + 1;
-      e[m][n] = std::min(sub_or_ok, std::min(del, ins));
+    size_t begin, end;
+    internal::GetBandRange(m, band, N + 1, &begin, &end);
+    if (begin == 0) {
+      e.Cell(m, 0) = e.Cost(m-1, 0) + 1;
+      begin = 1;
+    }
+    for (n = begin; n <= end; n++) {
+      int32 sub_or_ok = e.Cost(m-1, n-1) + (a[m-1] == b[n-1] ? 0 : 1);
+      int32 del = e.Cost(m-1, n) + 1;  // assumes a == ref, b == hyp.
+      int32 ins = e.Cost(m, n-1) + 1;
+      e.Cell(m, n) = std::min(sub_or_ok, std::min(del, ins));
     }
   }
   // get time-reversed output first: trace back.
@@ -166,9 +264,9 @@ int32 LevenshteinAlignment(const std::vector<T> &a,
       last_m = m-1;
       last_n = n;
     } else {
-      int32 sub_or_ok = e[m-1][n-1] + (a[m-1] == b[n-1] ? 0 : 1);
-      int32 del = e[m-1][n] + 1;  // assumes a == ref, b == hyp.
-      int32 ins = e[m][n-1] + 1;
+      int32 sub_or_ok = e.Cost(m-1, n-1) + (a[m-1] == b[n-1] ? 0 : 1);
+      int32 del = e.Cost(m-1, n) + 1;  // assumes a == ref, b == hyp.
+      int32 ins = e.Cost(m, n-1) + 1;
       // choose sub_or_ok if all else equal.
       if (sub_or_ok <= std::min(del, ins)) {
         last_m = m-1;
@@ -191,7 +289,8 @@ int32 LevenshteinAlignment(const std::vector<T> &a,
     n = last_n;
   }
   ReverseVector(output);
-  return e[M][N];
+  KALDI_ASSERT(e.Cost(M, N) == static_cast<int32>(band));
+  return e.Cost(M, N);
 }
 
 
@@ -251,6 +251,101 @@ void TestLevenshteinAlignment() {
   }
 }
 
+// The textbook O(M N) recursion, against which the bit-parallel and banded
+// versions are checked; it breaks ties the same way as the
+// LevenshteinEditDistance() that outputs the error counts.
+int32 ReferenceEditDistance(const std::vector<int32> &ref,
+                            const std::vector<int32> &hyp,
+                            int32 *ins, int32 *del, int32 *sub) {
+  std::vector<error_stats> e(ref.size() + 1), cur_e(ref.size() + 1);
+  for (size_t i = 0; i < e.size(); i++) {
+    e[i].ins_num = e[i].sub_num = 0;
+    e[i].del_num = e[i].total_cost = i;
+  }
+  for (size_t h = 1; h <= hyp.size(); h++) {
+    cur_e[0] = e[0];
+    cur_e[0].ins_num++;
+    cur_e[0].total_cost++;
+    for (size_t r = 1; r <= ref.size(); r++) {
+      bool match = (hyp[h-1] == ref[r-1]);
+      int32 ins_err = e[r].total_cost + 1,
+          del_err = cur_e[r-1].total_cost + 1,
+          sub_err = e[r-1].total_cost + (match ? 0 : 1);
+      if (sub_err < ins_err && sub_err < del_err) {
+        cur_e[r] = e[r-1];
+        if (!match) cur_e[r].sub_num++;
+        cur_e[r].total_cost = sub_err;
+      } else if (del_err < ins_err) {
+        cur_e[r] = cur_e[r-1];
+        cur_e[r].total_cost = del_err;
+        cur_e[r].del_num++;
+      } else {
+        cur_e[r] = e[r];
+        cur_e[r].total_cost = ins_err;
+        cur_e[r].ins_num++;
+      }
+    }
+    e = cur_e;
+  }
+  *ins = e.back().ins_num;
+  *del = e.back().del_num;
+  *sub = e.back().sub_num;
+  return e.back().total_cost;
+}
+
+// Tests the bit-parallel distance and the banded recursions on sequences long
+// enough to need several 64-bit words, both unrelated and nearly equal.
+void TestEditDistanceLong() {
+  for (int32 i = 0; i < 200; i++) {
+    int32 vocab_size = RandInt(1, 50);
+    std::vector<int32> ref(RandInt(0, 300)), hyp;
+    for (size_t j = 0; j < ref.size(); j++)
+      ref[j] = RandInt(1, vocab_size);
+    if (RandInt(0, 1) == 0) {
+      hyp.resize(RandInt(0, 300));
+      for (size_t j = 0; j < hyp.size(); j++)
+        hyp[j] = RandInt(1, vocab_size);
+    } else {
+      hyp = ref;
+      int32 num_edits = RandInt(0, 10);
+      for (int32 k = 0; k < num_edits; k++) {
+        int32 pos = RandInt(0, hyp.size());
+        switch (RandInt(0, 2)) {
+          case 0:
+            hyp.insert(hyp.begin() + pos, RandInt(1, vocab_size));
+            break;
+          case 1:
+            if (pos < static_cast<int32>(hyp.size()))
+              hyp.erase(hyp.begin() + pos);
+            break;
+          default:
+            if (pos < static_cast<int32>(hyp.size()))
+              hyp[pos] = RandInt(1, vocab_size);
+        }
+      }
+    }
+    int32 ins, del, sub, ref_ins, ref_del, ref_sub,
+        ref_cost = ReferenceEditDistance(ref, hyp, &ref_ins, &ref_del,
+                                         &ref_sub);
+    KALDI_ASSERT(LevenshteinEditDistance(ref, hyp) == ref_cost);
+    KALDI_ASSERT(LevenshteinEditDistance(hyp, ref) == ref_cost);
+    KALDI_ASSERT(LevenshteinEditDistance(ref, hyp, &ins, &del, &sub) ==
+                 ref_cost);
+    KALDI_ASSERT(ins == ref_ins && del == ref_del && sub == ref_sub);
+
+    std::vector<std::pair<int32, int32> > ali;
+    KALDI_ASSERT(LevenshteinAlignment(ref, hyp, 0, &ali) == ref_cost);
+    std::vector<int32> ref2, hyp2;
+    int32 ali_cost = 0;
+    for (size_t j = 0; j < ali.size(); j++) {
+      if (ali[j].first != 0) ref2.push_back(ali[j].first);
+      if (ali[j].second != 0) hyp2.push_back(ali[j].second);
+      ali_cost += (ali[j].first != ali[j].second);
+    }
+    KALDI_ASSERT(ref == ref2 && hyp == hyp2 && ali_cost == ref_cost);
+  }
+}
+
 }  // end namespace kaldi
 
 int main() {
@@ -260,6 +355,7 @@ int main() {
   TestEditDistance2();
   TestEditDistance2String();
   TestLevenshteinAlignment();
+  TestEditDistanceLong();
   std::cout << "Test OK\n";
 }
 
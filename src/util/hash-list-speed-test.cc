@@ -0,0 +1,104 @@
+// util/hash-list-speed-test.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "util/hash-list.h"
+#include "util/open-hash-list.h"
+#include "base/timer.h"
+#include <iostream>
+
+namespace kaldi {
+
+// This simulates the way the decoders use HashList: on each "frame" we take
+// the list of the previous frame's elements with Clear(), resize the hash, and
+// for each element insert a few "successor" keys (many of which collide with
+// keys that were already inserted on this frame), then Delete() the old
+// elements.  'num_active' is the (approximate) number of active states per
+// frame and 'num_states' is the size of the key space.
+template<class HashType>
+static double TimeHashList(int32 num_active, int32 num_states,
+                           int32 num_frames, int64 *checksum) {
+  typedef typename HashType::Elem Elem;
+  const int32 num_successors = 4;
+  std::vector<int32> offsets(num_successors);
+  for (int32 i = 0; i < num_successors; i++)
+    offsets[i] = 1 + RandInt(0, 100);
+
+  HashType hash;
+  hash.SetSize(2 * num_active);
+  for (int32 i = 0; i < num_active; i++)
+    hash.Insert(RandInt(0, num_states - 1), i);
+
+  Timer timer;
+  int64 sum = 0;
+  for (int32 frame = 0; frame < num_frames; frame++) {
+    Elem *list = hash.Clear(), *tail;
+    hash.SetSize(2 * num_active);
+    int32 num_inserted = 0;
+    for (Elem *e = list; e != NULL; e = tail) {
+      for (int32 i = 0; i < num_successors && num_inserted < num_active; i++) {
+        int32 key = (e->key + offsets[i] * (frame + 1)) % num_states;
+        Elem *found = hash.Insert(key, e->val);
+        if (found->val == e->val) num_inserted++;
+        else found->val = std::min(found->val, e->val);
+      }
+      tail = e->tail;
+      hash.Delete(e);
+    }
+    for (int32 i = 0; i < 1000; i++) {
+      Elem *e = hash.Find(RandInt(0, num_states - 1));
+      if (e != NULL) sum += e->val;
+    }
+  }
+  for (Elem *e = hash.Clear(), *tail; e != NULL; e = tail) {
+    sum += e->key;
+    tail = e->tail;
+    hash.Delete(e);
+  }
+  *checksum = sum;
+  return timer.Elapsed();
+}
+
+static void TestHashListSpeed() {
+  int32 num_states = 10000000, num_frames = 200;
+  int32 active_sizes[] = { 1000, 7000, 20000, 100000 };
+  for (size_t i = 0; i < sizeof(active_sizes) / sizeof(int32); i++) {
+    int32 num_active = active_sizes[i];
+    int64 checksum1, checksum2;
+    int32 seed = RandInt(0, 1000000);
+    srand(seed);
+    double chained_time = TimeHashList<HashList<int32, int32> >(
+        num_active, num_states, num_frames, &checksum1);
+    srand(seed);
+    double open_time = TimeHashList<OpenHashList<int32, int32> >(
+        num_active, num_states, num_frames, &checksum2);
+    KALDI_LOG << "For " << num_active << " active states per frame, HashList "
+              << "took " << chained_time << " seconds and OpenHashList took "
+              << open_time << " seconds for " << num_frames << " frames.";
+    // The lists are in different orders so the checksums will generally
+    // differ; we print them so that the computation can't be optimized away.
+    KALDI_VLOG(2) << "Checksums are " << checksum1 << " and " << checksum2;
+  }
+}
+
+}  // end namespace kaldi
+
+int main() {
+  kaldi::TestHashListSpeed();
+  std::cout << "Test OK.\n";
+}
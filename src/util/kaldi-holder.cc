@@ -110,6 +110,25 @@ bool ExtractObjectRange(const GeneralMatrix &input, const std::string &range,
   return true;
 }
 
+bool ExtractObjectRange(const SerializedMatrix &input, const std::string &range,
+                        SerializedMatrix *output) {
+  output->Clear();
+  return ExtractObjectRange(input.Value(), range, &(output->MutableValue()));
+}
+
+bool ExtractObjectRange(const MatrixStats &input, const std::string &range,
+                        MatrixStats *output) {
+  if (!input.HasMatrix())
+    KALDI_ERR << "Ranges are not supported for matrices with statistics "
+              << "headers when reading just the statistics; range is "
+              << range;
+  Matrix<BaseFloat> mat;
+  if (!ExtractObjectRange(input.GetMatrix(), range, &mat))
+    return false;
+  output->Compute(mat);
+  return true;
+}
+
 template<class Real>
 bool ExtractObjectRange(const CompressedMatrix &input, const std::string &range,
                         Matrix<Real> *output) {
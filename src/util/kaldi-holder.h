@@ -28,6 +28,8 @@
 #include "util/text-utils.h"
 #include "matrix/kaldi-vector.h"
 #include "matrix/sparse-matrix.h"
+#include "matrix/serialized-matrix.h"
+#include "matrix/matrix-stats.h"
 
 namespace kaldi {
 
@@ -252,6 +254,17 @@ bool ExtractObjectRange(const Vector<Real> &input, const std::string &range,
 bool ExtractObjectRange(const GeneralMatrix &input, const std::string &range,
                         GeneralMatrix *output);
 
+/// SerializedMatrix is always of type BaseFloat; the output is an ordinary
+/// matrix, which will be serialized when written.
+bool ExtractObjectRange(const SerializedMatrix &input, const std::string &range,
+                        SerializedMatrix *output);
+
+/// The output contains the statistics of the range of the matrix.  This only
+/// works if the matrix had no statistics header, as otherwise the matrix
+/// itself was not read.
+bool ExtractObjectRange(const MatrixStats &input, const std::string &range,
+                        MatrixStats *output);
+
 /// CompressedMatrix is always of the type BaseFloat but it is more
 /// efficient to provide template as it uses CompressedMatrix's own
 /// conversion to Matrix<Real>
@@ -259,6 +272,16 @@ template <class Real>
 bool ExtractObjectRange(const CompressedMatrix &input, const std::string &range,
                         Matrix<Real> *output);
 
+/// Parses the range specifier of a matrix with the given dimensions, as used
+/// by ExtractObjectRange() (e.g. "0:9" or "0:9,10:19"), into the first and
+/// last row and the first and last column.  The last row may be up to two
+/// rows past the end of the matrix (with a warning), to allow for rounding in
+/// segment times; callers should limit it.  Throws on invalid ranges.
+bool ParseMatrixRangeSpecifier(const std::string &range,
+                               const int rows, const int cols,
+                               std::vector<int32> *row_range,
+                               std::vector<int32> *col_range);
+
 // In SequentialTableReaderScriptImpl and RandomAccessTableReaderScriptImpl, for
 // cases where the scp contained 'range specifiers' (things in square brackets
 // identifying parts of objects like matrices), use this function to separate
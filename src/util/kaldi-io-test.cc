@@ -305,6 +305,50 @@ void UnitTestIoStandard() {
   }
 }
 
+void UnitTestIoZstd() {
+#ifdef HAVE_ZSTD
+  // Write enough to need several frames, remembering some offsets.
+  std::vector<std::streamoff> offsets;
+  std::vector<int32> values;
+  {
+    Output ko("tmpf.zst", true, false);
+    std::ostream &os = ko.Stream();
+    for (int32 i = 0; i < 100000; i++) {
+      if (Rand() % 1000 == 0) {
+        offsets.push_back(os.tellp());
+        values.push_back(i);
+        KALDI_ASSERT(offsets.back() >= 0);
+      }
+      WriteBasicType(os, true, i);
+    }
+    KALDI_ASSERT(ko.Close());
+  }
+  {
+    Input ki("tmpf.zst");
+    for (int32 i = 0; i < 100000; i++) {
+      int32 j;
+      ReadBasicType(ki.Stream(), true, &j);
+      KALDI_ASSERT(i == j);
+    }
+    KALDI_ASSERT(ki.Stream().peek() == EOF);
+  }
+  {
+    // Read at the offsets, in random order, reusing the Input.
+    Input ki;
+    for (size_t n = 0; n < 2 * offsets.size(); n++) {
+      size_t m = Rand() % offsets.size();
+      std::ostringstream rxfilename;
+      rxfilename << "tmpf.zst:" << offsets[m];
+      KALDI_ASSERT(ki.Open(rxfilename.str()));
+      int32 j;
+      ReadBasicType(ki.Stream(), true, &j);
+      KALDI_ASSERT(j == values[m]);
+    }
+  }
+  unlink("tmpf.zst");
+#endif
+}
+
 // This is Windows-specific.
 void UnitTestNativeFilename() {
 #ifdef KALDI_CYGWIN_COMPAT
@@ -361,6 +405,7 @@ int main(int argc, const char** argv) {
   UnitTestIoPipe(true);
   UnitTestIoPipe(false);
   UnitTestIoStandard();
+  UnitTestIoZstd();
   UnitTestClassifyRxfilename();
   UnitTestClassifyWxfilename();
 
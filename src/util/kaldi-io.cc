@@ -20,12 +20,16 @@
 #include "util/kaldi-io.h"
 #include <errno.h>
 #include <cstdlib>
+#include <memory>
 #include "base/kaldi-math.h"
 #include "util/text-utils.h"
 #include "util/parse-options.h"
 #include "util/kaldi-holder.h"
 #include "util/kaldi-pipebuf.h"
 #include "util/kaldi-table.h"  // for Classify{W,R}specifier
+#include "util/kaldi-mmap.h"
+#include "util/kaldi-url.h"
+#include "util/kaldi-zstdbuf.h"
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -234,6 +238,53 @@ class FileOutputImpl: public OutputImplBase {
   std::ofstream os_;
 };
 
+#ifdef HAVE_ZSTD
+// Writes files whose names end in ".zst", compressed; see kaldi-zstdbuf.h.
+class ZstdFileOutputImpl: public OutputImplBase {
+ public:
+  ZstdFileOutputImpl(): os_(NULL) { }
+
+  // The data is compressed, so the file is always written in binary mode.
+  virtual bool Open(const std::string &filename, bool binary) {
+    if (file_.is_open()) KALDI_ERR << "ZstdFileOutputImpl::Open(), "
+                                   << "open called on already open file.";
+    filename_ = filename;
+    if (file_.open(MapOsPath(filename_).c_str(),
+                   std::ios_base::out | std::ios_base::binary) == NULL)
+      return false;
+    buf_.reset(new ZstdOutputBuf(&file_));
+    os_.rdbuf(buf_.get());  // this also clears the error state.
+    return true;
+  }
+
+  virtual std::ostream &Stream() {
+    if (!file_.is_open())
+      KALDI_ERR << "ZstdFileOutputImpl::Stream(), file is not open.";
+    return os_;
+  }
+
+  virtual bool Close() {
+    if (!file_.is_open())
+      KALDI_ERR << "ZstdFileOutputImpl::Close(), file is not open.";
+    bool ans = buf_->Finish() && !os_.fail();
+    if (file_.close() == NULL)
+      ans = false;
+    os_.rdbuf(NULL);
+    buf_.reset();
+    return ans;
+  }
+  virtual ~ZstdFileOutputImpl() {
+    if (file_.is_open() && !Close())
+      KALDI_ERR << "Error closing output file " << filename_;
+  }
+ private:
+  std::string filename_;
+  std::filebuf file_;
+  std::unique_ptr<ZstdOutputBuf> buf_;
+  std::ostream os_;
+};
+#endif  // HAVE_ZSTD
+
 class StandardOutputImpl: public OutputImplBase {
  public:
   StandardOutputImpl(): is_open_(false) { }
@@ -375,6 +426,18 @@ class InputImplBase {
                                    // call Open twice
   // (has efficiency benefits).
 
+  // Returns true for MappedFileInputImpl, which may also be opened twice.
+  virtual bool IsMapped() { return false; }
+
+  // See Input::MappedData().
+  virtual const char *MappedData(size_t *num_bytes) { return NULL; }
+
+  // Returns true for ZstdFileInputImpl, which may also be opened twice.
+  virtual bool IsZstd() { return false; }
+
+  // Returns true for UrlInputImpl, which may also be opened twice.
+  virtual bool IsUrl() { return false; }
+
   virtual ~InputImplBase() { }
 };
 
@@ -662,6 +725,244 @@ class OffsetFileInputImpl: public InputImplBase {
 };
 
 
+// A stream buffer that reads from memory (a mapped file) without copying it.
+class MappedStreambuf: public std::streambuf {
+ public:
+  // Sets the memory to read from to [begin, end), with the read position at
+  // 'pos'.
+  void SetRange(const char *begin, const char *end, const char *pos) {
+    setg(const_cast<char*>(begin), const_cast<char*>(pos),
+         const_cast<char*>(end));
+  }
+ protected:
+  // Only reading is supported; the default underflow() returns EOF at the end
+  // of the memory.  Seeking is needed for tellg().
+  virtual pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                           std::ios_base::openmode which) {
+    off_type pos = (dir == std::ios_base::beg ? 0 :
+                    dir == std::ios_base::cur ? gptr() - eback() :
+                    egptr() - eback()) + off;
+    if (!(which & std::ios_base::in) || pos < 0 || pos > egptr() - eback())
+      return pos_type(off_type(-1));
+    setg(eback(), eback() + pos, egptr());
+    return pos_type(pos);
+  }
+  virtual pos_type seekpos(pos_type pos, std::ios_base::openmode which) {
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+  }
+};
+
+// Reads files and offsets into files (kFileInput and kOffsetFileInput) from a
+// shared memory mapping of the file; see Input::OpenMapped().  Like
+// OffsetFileInputImpl, it may be opened again while open, which is cheap if
+// the file is the same.  If 'node_shared' is true, it maps a copy of the file
+// that is shared between processes instead; see Input::OpenNodeShared().
+class MappedFileInputImpl: public InputImplBase {
+ public:
+  explicit MappedFileInputImpl(bool node_shared = false):
+      type_(kNoInput), node_shared_(node_shared), is_(&buf_) { }
+
+  // 'binary' makes no difference as we only support mapping on UNIX.
+  virtual bool Open(const std::string &rxfilename, bool binary) {
+    std::string filename;
+    size_t offset = 0;
+    type_ = ClassifyRxfilename(rxfilename);
+    if (type_ == kOffsetFileInput) {
+      OffsetFileInputImpl::SplitFilename(rxfilename, &filename, &offset);
+    } else {
+      KALDI_ASSERT(type_ == kFileInput);
+      filename = rxfilename;
+    }
+    if (file_ == NULL || filename != filename_) {
+      if (node_shared_) {
+        MappedFile *file = new MappedFile();
+        if (file->TryOpenNodeShared(MapOsPath(filename)))
+          file_.reset(file);
+        else
+          delete file;
+      } else {
+        file_ = GetSharedMappedFile(MapOsPath(filename));
+      }
+      filename_ = filename;
+      if (file_ == NULL)
+        return false;
+    }
+    if (offset > file_->Size())
+      return false;
+    const char *data = file_->Data();
+    buf_.SetRange(data, data + file_->Size(), data + offset);
+    is_.clear();
+    return true;
+  }
+
+  virtual std::istream &Stream() {
+    if (file_ == NULL)
+      KALDI_ERR << "MappedFileInputImpl::Stream(), file is not open.";
+    return is_;
+  }
+
+  virtual int32 Close() {
+    if (file_ == NULL)
+      KALDI_ERR << "MappedFileInputImpl::Close(), file is not open.";
+    file_.reset();
+    return 0;
+  }
+
+  virtual InputType MyType() { return type_; }
+
+  virtual bool IsMapped() { return true; }
+
+  virtual const char *MappedData(size_t *num_bytes) {
+    if (file_ == NULL)
+      return NULL;
+    std::streamoff pos = is_.tellg();
+    if (pos < 0)  // The stream is in a failed state.
+      return NULL;
+    *num_bytes = file_->Size() - pos;
+    return file_->Data() + pos;
+  }
+
+ private:
+  InputType type_;  // The type of the rxfilename we last opened.
+  bool node_shared_;
+  std::string filename_;  // The actual filename.
+  std::shared_ptr<const MappedFile> file_;
+  MappedStreambuf buf_;
+  std::istream is_;
+};
+
+
+#ifdef HAVE_CURL
+// Reads URLs and offsets into them (kFileInput and kOffsetFileInput for which
+// IsUrl() is true); see kaldi-url.h.  Like OffsetFileInputImpl, it may be
+// opened again while open, which is cheap if the URL is the same.
+class UrlInputImpl: public InputImplBase {
+ public:
+  UrlInputImpl(): type_(kNoInput), is_open_(false), is_(&buf_) { }
+
+  virtual bool Open(const std::string &rxfilename, bool binary) {
+    std::string url;
+    size_t offset = 0;
+    type_ = ClassifyRxfilename(rxfilename);
+    if (type_ == kOffsetFileInput) {
+      OffsetFileInputImpl::SplitFilename(rxfilename, &url, &offset);
+    } else {
+      KALDI_ASSERT(type_ == kFileInput);
+      url = rxfilename;
+    }
+    is_.clear();
+    is_open_ = buf_.Open(url, offset);
+    return is_open_;
+  }
+
+  virtual std::istream &Stream() {
+    if (!is_open_)
+      KALDI_ERR << "UrlInputImpl::Stream(), file is not open.";
+    return is_;
+  }
+
+  virtual int32 Close() {
+    if (!is_open_)
+      KALDI_ERR << "UrlInputImpl::Close(), file is not open.";
+    is_open_ = false;
+    return 0;
+  }
+
+  virtual InputType MyType() { return type_; }
+
+  virtual bool IsUrl() { return true; }
+
+ private:
+  InputType type_;  // The type of the rxfilename we last opened.
+  bool is_open_;
+  UrlStreambuf buf_;
+  std::istream is_;
+};
+#endif  // HAVE_CURL
+
+#ifdef HAVE_ZSTD
+// Reads files and offsets into files (kFileInput and kOffsetFileInput) whose
+// names end in ".zst", which may also be URLs; the offsets are the virtual
+// offsets described in kaldi-zstdbuf.h.  Like OffsetFileInputImpl, it may be
+// opened again while open, and if the file is the same it will seek in it,
+// which is cheap if the offset is later in the frame that is being read.
+class ZstdFileInputImpl: public InputImplBase {
+ public:
+  ZstdFileInputImpl(): type_(kNoInput), is_(NULL) { }
+
+  // The data is compressed, so the file is always read in binary mode.
+  virtual bool Open(const std::string &rxfilename, bool binary) {
+    std::string filename;
+    size_t offset = 0;
+    type_ = ClassifyRxfilename(rxfilename);
+    if (type_ == kOffsetFileInput) {
+      OffsetFileInputImpl::SplitFilename(rxfilename, &filename, &offset);
+    } else {
+      KALDI_ASSERT(type_ == kFileInput);
+      filename = rxfilename;
+    }
+    if (file_ == NULL || filename != filename_) {
+      is_.rdbuf(NULL);
+      buf_.reset();
+      file_.reset();
+      filename_ = filename;
+      if (kaldi::IsUrl(filename_)) {
+#ifdef HAVE_CURL
+        UrlStreambuf *url_buf = new UrlStreambuf();
+        file_.reset(url_buf);
+        if (!url_buf->Open(filename_, 0)) {
+          file_.reset();
+          return false;
+        }
+#else
+        return false;
+#endif
+      } else {
+        std::filebuf *file_buf = new std::filebuf();
+        file_.reset(file_buf);
+        if (file_buf->open(MapOsPath(filename_).c_str(),
+                           std::ios_base::in | std::ios_base::binary) == NULL) {
+          file_.reset();
+          return false;
+        }
+      }
+      buf_.reset(new ZstdInputBuf(file_.get()));
+      is_.rdbuf(buf_.get());
+    }
+    is_.clear();
+    return buf_->Seek(offset);
+  }
+
+  virtual std::istream &Stream() {
+    if (file_ == NULL)
+      KALDI_ERR << "ZstdFileInputImpl::Stream(), file is not open.";
+    return is_;
+  }
+
+  virtual int32 Close() {
+    if (file_ == NULL)
+      KALDI_ERR << "ZstdFileInputImpl::Close(), file is not open.";
+    is_.rdbuf(NULL);
+    buf_.reset();
+    file_.reset();  // Don't check status.
+    return 0;
+  }
+
+  virtual InputType MyType() { return type_; }
+
+  virtual bool IsZstd() { return true; }
+
+ private:
+  InputType type_;  // The type of the rxfilename we last opened.
+  std::string filename_;  // The actual filename.
+  // The compressed data: a std::filebuf, or a UrlStreambuf for URLs.
+  std::unique_ptr<std::streambuf> file_;
+  std::unique_ptr<ZstdInputBuf> buf_;
+  std::istream is_;
+};
+#endif  // HAVE_ZSTD
+
+
 Output::Output(const std::string &wxfilename, bool binary,
                bool write_header):impl_(NULL) {
   if (!Open(wxfilename, binary, write_header)) {
@@ -719,7 +1020,20 @@ bool Output::Open(const std::string &wxfn, bool binary, bool header) {
   OutputType type = ClassifyWxfilename(wxfn);
   KALDI_ASSERT(impl_ == NULL);
 
-  if (type ==  kFileOutput) {
+  if (type == kFileOutput && IsUrl(wxfn)) {
+    KALDI_WARN << "Cannot write " << PrintableWxfilename(wxfn)
+               << ": writing to URLs is not supported.";
+    return false;
+  } else if (type == kFileOutput && IsZstdFilename(wxfn)) {
+#ifdef HAVE_ZSTD
+    impl_ = new ZstdFileOutputImpl();
+#else
+    KALDI_WARN << "Cannot write " << PrintableWxfilename(wxfn)
+               << ": Kaldi was not configured with zstd (see --zstd-root "
+               << "in src/configure).";
+    return false;
+#endif
+  } else if (type ==  kFileOutput) {
     impl_ = new FileOutputImpl();
   } else if (type == kStandardOutput) {
     impl_ = new StandardOutputImpl();
@@ -771,30 +1085,84 @@ int32 Input::Close() {
 
 bool Input::OpenInternal(const std::string &rxfilename,
                          bool file_binary,
+                         bool mapped,
                          bool *contents_binary) {
   InputType type = ClassifyRxfilename(rxfilename);
+  bool zstd = false, url = false;
+  if (type == kFileInput || type == kOffsetFileInput) {
+    std::string filename = rxfilename;
+    size_t offset;
+    if (type == kOffsetFileInput)
+      OffsetFileInputImpl::SplitFilename(rxfilename, &filename, &offset);
+    zstd = IsZstdFilename(filename);
+    url = IsUrl(filename);
+  }
+  // Compressed files are not mapped, as they have to be decompressed anyway,
+  // and URLs cannot be.
+  mapped = mapped && !zstd && !url &&
+      (type == kFileInput || type == kOffsetFileInput);
   if (IsOpen()) {
     // May have to close the stream first.
-    if (type == kOffsetFileInput && impl_->MyType() == kOffsetFileInput) {
+    if (mapped ? impl_->IsMapped() :
+        (type == kOffsetFileInput && impl_->MyType() == kOffsetFileInput &&
+         !impl_->IsMapped() && impl_->IsZstd() == zstd &&
+         (zstd || impl_->IsUrl() == url))) {
       // We want to use the same object to Open... this is in case
       // the files are the same, so we can just seek.
-      if (!impl_->Open(rxfilename, file_binary)) {  // true is binary mode--
+      if (impl_->Open(rxfilename, file_binary)) {  // true is binary mode--
         // always open in binary.
-        delete impl_;
-        impl_ = NULL;
-        return false;
+        // read the binary header, if requested.
+        if (contents_binary != NULL)
+          return InitKaldiInputStream(impl_->Stream(), contents_binary);
+        else
+          return true;
       }
-      // read the binary header, if requested.
+      delete impl_;
+      impl_ = NULL;
+      if (!mapped)
+        return false;
+      // else fall through to the code below, which will read the file
+      // normally if it cannot be mapped.
+    } else {
+      Close();
+      // and fall through to code below which actually opens the file.
+    }
+  }
+  if (mapped) {
+    impl_ = new MappedFileInputImpl();
+    if (impl_->Open(rxfilename, file_binary)) {
       if (contents_binary != NULL)
         return InitKaldiInputStream(impl_->Stream(), contents_binary);
       else
         return true;
-    } else {
-      Close();
-      // and fall through to code below which actually opens the file.
     }
+    // The file could not be mapped (e.g. it is empty or a named pipe); try to
+    // read it normally.
+    delete impl_;
+    impl_ = NULL;
   }
-  if (type ==  kFileInput) {
+#ifndef HAVE_CURL
+  if (url) {
+    KALDI_WARN << "Cannot read " << PrintableRxfilename(rxfilename)
+               << ": Kaldi was not configured with libcurl (see --curl-root "
+               << "in src/configure).";
+    return false;
+  }
+#endif
+  if (zstd) {
+#ifdef HAVE_ZSTD
+    impl_ = new ZstdFileInputImpl();
+#else
+    KALDI_WARN << "Cannot read " << PrintableRxfilename(rxfilename)
+               << ": Kaldi was not configured with zstd (see --zstd-root "
+               << "in src/configure).";
+    return false;
+#endif
+  } else if (url) {
+#ifdef HAVE_CURL
+    impl_ = new UrlInputImpl();
+#endif
+  } else if (type ==  kFileInput) {
     impl_ = new FileInputImpl();
   } else if (type == kStandardInput) {
     impl_ = new StandardInputImpl();
@@ -828,6 +1196,30 @@ std::istream &Input::Stream() {
   return impl_->Stream();
 }
 
+bool Input::OpenNodeShared(const std::string &rxfilename,
+                           bool *contents_binary) {
+  if (ClassifyRxfilename(rxfilename) == kFileInput &&
+      !IsZstdFilename(rxfilename) && !IsUrl(rxfilename)) {
+    Close();
+    impl_ = new MappedFileInputImpl(true);
+    if (impl_->Open(rxfilename, true)) {
+      if (contents_binary != NULL)
+        return InitKaldiInputStream(impl_->Stream(), contents_binary);
+      else
+        return true;
+    }
+    KALDI_WARN << "Could not read " << rxfilename << " through shared memory ("
+               << strerror(errno) << "); reading it normally.";
+    delete impl_;
+    impl_ = NULL;
+  }
+  return Open(rxfilename, contents_binary);
+}
+
+const char *Input::MappedData(size_t *num_bytes) {
+  return (IsOpen() ? impl_->MappedData(num_bytes) : NULL);
+}
+
 
 template <> void ReadKaldiObject(const std::string &filename,
                                  Matrix<float> *m) {
@@ -70,6 +70,16 @@ class InputImplBase;  // Forward decl; defined in a .cc file
 //   [these are created by the Table and TableWriter classes; I may also write
 //    a program that creates them for arbitrary files]
 //
+// Files whose names end in ".zst" (e.g. "/tmp/abc.ark.zst", or
+// "/tmp/abc.ark.zst:24871") are compressed with zstd when written and
+// decompressed when read, without the cost of a pipe, if Kaldi was configured
+// with zstd.  Offsets into them stay valid for random access; see
+// util/kaldi-zstdbuf.h.
+//
+// Files and offsets into files may also be given as URLs in object storage
+// or on web servers, e.g. "s3://bucket/1.ark:24871", if Kaldi was configured
+// with libcurl; see util/kaldi-url.h.
+//
 
 
 // Typical usage:
@@ -213,6 +223,33 @@ class Input {
   // binary mode (and ignore the \r).
   inline bool OpenTextMode(const std::string &rxfilename);
 
+  /// As Open(), but if 'rxfilename' is a file or an offset into a file (e.g.
+  /// "foo.ark:1234"), reads it from a memory mapping of the file that is
+  /// shared with everything else in the process that has it mapped (see
+  /// GetSharedMappedFile() in kaldi-mmap.h).  Reading then copies straight from
+  /// the page cache, and reopening at another offset in the same file, as the
+  /// RandomAccessTableReader does for scp files with the "mmap" option, only
+  /// sets a pointer.  Other types of rxfilename, and files that cannot be
+  /// mapped, are opened as by Open().
+  inline bool OpenMapped(const std::string &rxfilename,
+                         bool *contents_binary = NULL);
+
+  /// As Open(), but if 'rxfilename' is a file, reads it from a copy in shared
+  /// memory that all the processes on this machine that open it this way
+  /// share, so that it is read from the disk or network only once (see
+  /// MappedFile::TryOpenNodeShared() in kaldi-mmap.h).  This is meant for
+  /// files like models that many jobs read at the same time.  Other types of
+  /// rxfilename, and files that cannot be shared, are opened as by Open().
+  bool OpenNodeShared(const std::string &rxfilename,
+                      bool *contents_binary = NULL);
+
+  /// If the stream was opened by OpenMapped() and the file was mapped, returns
+  /// a pointer to the current read position in the mapped memory and sets
+  /// *num_bytes to the number of bytes from there to the end of the file;
+  /// otherwise returns NULL.  The memory is read-only, and is valid until this
+  /// object is closed or reopened on another file.
+  const char *MappedData(size_t *num_bytes);
+
   // Return true if currently open for reading and Stream() will
   // succeed.  Does not guarantee that the stream is good.
   inline bool IsOpen();
@@ -231,13 +268,14 @@ class Input {
   ~Input();
  private:
   bool OpenInternal(const std::string &rxfilename, bool file_binary,
-                    bool *contents_binary);
+                    bool mapped, bool *contents_binary);
   InputImplBase *impl_;
   KALDI_DISALLOW_COPY_AND_ASSIGN(Input);
 };
 
 template <class C> void ReadKaldiObject(const std::string &filename,
                                         C *c) {
+  KALDI_TRACE_SCOPE("ReadKaldiObject");
   bool binary_in;
   Input ki(filename, &binary_in);
   c->Read(ki.Stream(), binary_in);
@@ -271,6 +309,21 @@ std::string PrintableRxfilename(const std::string &rxfilename);
 /// replaces "" or "-" with "standard output".
 std::string PrintableWxfilename(const std::string &wxfilename);
 
+/// As ReadKaldiObject(), but reads the file through Input::OpenNodeShared(),
+/// so that processes on the same machine that read the same file at about the
+/// same time, such as the training jobs of an iteration reading the model,
+/// read it from the (network) file system only once.
+template <class C> void ReadKaldiObjectNodeShared(const std::string &filename,
+                                                  C *c) {
+  KALDI_TRACE_SCOPE("ReadKaldiObjectNodeShared");
+  bool binary_in;
+  Input ki;
+  if (!ki.OpenNodeShared(filename, &binary_in))
+    KALDI_ERR << "Error opening input stream "
+              << PrintableRxfilename(filename);
+  c->Read(ki.Stream(), binary_in);
+}
+
 /// @}
 
 }  // end namespace kaldi.
@@ -0,0 +1,161 @@
+// util/kaldi-metrics-test.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include "util/kaldi-metrics.h"
+
+namespace kaldi {
+
+static bool Contains(const std::string &text, const std::string &line) {
+  return text.find(line + "\n") != std::string::npos;
+}
+
+void UnitTestMetricsText() {
+  MetricsRegistry registry;
+  MetricsCounter *counter = registry.GetCounter("test_utterances_total",
+                                                "Number of\nutterances.");
+  KALDI_ASSERT(registry.GetCounter("test_utterances_total", "") == counter);
+  counter->Increment();
+  counter->Increment(2.5);
+  MetricsGauge *gauge = registry.GetGauge("test_queue_length", "Queue length.");
+  gauge->Set(5);
+  gauge->Add(-2);
+  MetricsHistogram *histogram = registry.GetHistogram(
+      "test_latency_seconds", "Latency.", ExponentialBuckets(0.1, 10.0, 2));
+  histogram->Observe(0.05);
+  histogram->Observe(0.1);
+  histogram->Observe(0.5);
+  histogram->Observe(100.0);
+  registry.AddCollector([&registry] {
+      registry.GetGauge("test_collected", "Set by a collector.")->Set(7);
+    });
+
+  std::ostringstream os;
+  registry.WriteText(os);
+  std::string text = os.str();
+  KALDI_LOG << text;
+  KALDI_ASSERT(Contains(text, "# HELP test_utterances_total Number of\\n"
+                        "utterances."));
+  KALDI_ASSERT(Contains(text, "# TYPE test_utterances_total counter"));
+  KALDI_ASSERT(Contains(text, "test_utterances_total 3.5"));
+  KALDI_ASSERT(Contains(text, "# TYPE test_queue_length gauge"));
+  KALDI_ASSERT(Contains(text, "test_queue_length 3"));
+  KALDI_ASSERT(Contains(text, "test_collected 7"));
+  KALDI_ASSERT(Contains(text, "# TYPE test_latency_seconds histogram"));
+  // The bucket counts are cumulative, and 0.1 falls in the bucket le="0.1".
+  KALDI_ASSERT(Contains(text, "test_latency_seconds_bucket{le=\"0.1\"} 2"));
+  KALDI_ASSERT(Contains(text, "test_latency_seconds_bucket{le=\"1\"} 3"));
+  KALDI_ASSERT(Contains(text, "test_latency_seconds_bucket{le=\"+Inf\"} 4"));
+  KALDI_ASSERT(Contains(text, "test_latency_seconds_sum 100.65"));
+  KALDI_ASSERT(Contains(text, "test_latency_seconds_count 4"));
+  // The metrics are sorted by name.
+  KALDI_ASSERT(text.find("test_collected") < text.find("test_latency") &&
+               text.find("test_queue") < text.find("test_utterances"));
+
+  bool threw = false;
+  try {
+    registry.GetGauge("test_utterances_total", "");
+  } catch (const std::exception &) {
+    threw = true;
+  }
+  KALDI_ASSERT(threw);
+  threw = false;
+  try {
+    registry.GetGauge("0-bad name", "");
+  } catch (const std::exception &) {
+    threw = true;
+  }
+  KALDI_ASSERT(threw);
+}
+
+void UnitTestMetricsThreads() {
+  MetricsRegistry registry;
+  MetricsCounter *counter = registry.GetCounter("test_total", "");
+  MetricsHistogram *histogram = registry.GetHistogram(
+      "test_histogram", "", ExponentialBuckets(1.0, 2.0, 4));
+  int32 num_threads = 4, num_updates = 10000;
+  std::vector<std::thread> threads;
+  for (int32 t = 0; t < num_threads; t++) {
+    threads.push_back(std::thread([&] {
+          for (int32 i = 0; i < num_updates; i++) {
+            counter->Increment();
+            histogram->Observe(i % 10);
+          }
+        }));
+  }
+  for (int32 t = 0; t < num_threads; t++)
+    threads[t].join();
+  KALDI_ASSERT(counter->Value() == num_threads * num_updates);
+  KALDI_ASSERT(histogram->Count() == num_threads * num_updates);
+  int64 total = 0;
+  for (size_t i = 0; i <= histogram->UpperBounds().size(); i++)
+    total += histogram->BucketCount(i);
+  KALDI_ASSERT(total == histogram->Count());
+  // Each thread observes 0, 1, ..., 9 in turn, of which only 9 exceeds the
+  // last bound of 8.
+  KALDI_ASSERT(histogram->BucketCount(4) == num_threads * num_updates / 10);
+}
+
+void UnitTestMetricsQuantile() {
+  MetricsHistogram histogram(LinearBuckets(10.0, 10.0, 3));
+  KALDI_ASSERT(histogram.UpperBounds() == std::vector<double>({10, 20, 30}));
+  KALDI_ASSERT(KALDI_ISNAN(histogram.Quantile(0.5)));
+  // 10 values in (0, 10] and 10 in (10, 20].
+  for (int32 i = 1; i <= 20; i++)
+    histogram.Observe(i);
+  KALDI_ASSERT(ApproxEqual(histogram.Quantile(0.25), 5.0));
+  KALDI_ASSERT(ApproxEqual(histogram.Quantile(0.5), 10.0));
+  KALDI_ASSERT(ApproxEqual(histogram.Quantile(0.9), 18.0));
+  histogram.Observe(100.0);
+  KALDI_ASSERT(histogram.Quantile(1.0) == 30.0);
+}
+
+void UnitTestMetricsFile() {
+  std::string filename = "tmp.metrics.prom";
+  {
+    MetricsRegistry registry;
+    registry.GetCounter("test_total", "")->Increment(3);
+    KALDI_ASSERT(!registry.Enabled());
+    registry.WriteToFilePeriodically(filename, 0.01);
+    KALDI_ASSERT(registry.Enabled());
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    registry.GetCounter("test_total", "")->Increment();
+  }  // The file is written once more when the registry is destroyed.
+  std::ifstream is(filename.c_str());
+  std::stringstream contents;
+  contents << is.rdbuf();
+  KALDI_ASSERT(Contains(contents.str(), "test_total 4"));
+  std::remove(filename.c_str());
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  UnitTestMetricsText();
+  UnitTestMetricsThreads();
+  UnitTestMetricsQuantile();
+  UnitTestMetricsFile();
+  std::cout << "Test OK.\n";
+  return 0;
+}
@@ -0,0 +1,305 @@
+// util/kaldi-metrics.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <sstream>
+
+#include "util/kaldi-metrics.h"
+
+namespace kaldi {
+
+// Adds 'amount' to 'value'; std::atomic<double> has no fetch_add() before
+// C++20.
+static inline void AtomicAdd(std::atomic<double> *value, double amount) {
+  double old_value = value->load(std::memory_order_relaxed);
+  while (!value->compare_exchange_weak(old_value, old_value + amount,
+                                       std::memory_order_relaxed));
+}
+
+void MetricsCounter::Increment(double amount) {
+  KALDI_ASSERT(amount >= 0.0);
+  AtomicAdd(&value_, amount);
+}
+
+void MetricsGauge::Add(double amount) {
+  AtomicAdd(&value_, amount);
+}
+
+MetricsHistogram::MetricsHistogram(const std::vector<double> &upper_bounds):
+    upper_bounds_(upper_bounds),
+    bucket_counts_(new std::atomic<int64>[upper_bounds.size() + 1]),
+    count_(0), sum_(0.0) {
+  KALDI_ASSERT(!upper_bounds.empty());
+  for (size_t i = 0; i + 1 < upper_bounds.size(); i++)
+    KALDI_ASSERT(upper_bounds[i] < upper_bounds[i + 1]);
+  for (size_t i = 0; i <= upper_bounds.size(); i++)
+    bucket_counts_[i].store(0, std::memory_order_relaxed);
+}
+
+void MetricsHistogram::Observe(double value) {
+  size_t i = std::lower_bound(upper_bounds_.begin(), upper_bounds_.end(),
+                              value) - upper_bounds_.begin();
+  bucket_counts_[i].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  AtomicAdd(&sum_, value);
+}
+
+double MetricsHistogram::Quantile(double q) const {
+  KALDI_ASSERT(q >= 0.0 && q <= 1.0);
+  size_t num_buckets = upper_bounds_.size() + 1;
+  std::vector<int64> counts(num_buckets);
+  int64 total_count = 0;
+  for (size_t i = 0; i < num_buckets; i++) {
+    counts[i] = BucketCount(i);
+    total_count += counts[i];
+  }
+  if (total_count == 0)
+    return std::numeric_limits<double>::quiet_NaN();
+  double rank = q * total_count;
+  int64 cumulative_count = 0;
+  for (size_t i = 0; i + 1 < num_buckets; i++) {
+    if (counts[i] > 0 && cumulative_count + counts[i] >= rank) {
+      double lower = (i == 0 ? std::min(0.0, upper_bounds_[0]) :
+                      upper_bounds_[i - 1]);
+      return lower + (upper_bounds_[i] - lower) *
+          (rank - cumulative_count) / counts[i];
+    }
+    cumulative_count += counts[i];
+  }
+  return upper_bounds_.back();
+}
+
+std::vector<double> ExponentialBuckets(double start, double factor,
+                                       int32 count) {
+  KALDI_ASSERT(start > 0.0 && factor > 1.0 && count > 0);
+  std::vector<double> ans(count);
+  ans[0] = start;
+  for (int32 i = 1; i < count; i++)
+    ans[i] = ans[i - 1] * factor;
+  return ans;
+}
+
+std::vector<double> LinearBuckets(double start, double width, int32 count) {
+  KALDI_ASSERT(width > 0.0 && count > 0);
+  std::vector<double> ans(count);
+  for (int32 i = 0; i < count; i++)
+    ans[i] = start + i * width;
+  return ans;
+}
+
+
+static bool IsValidMetricName(const std::string &name) {
+  if (name.empty() || std::isdigit(name[0]))
+    return false;
+  for (size_t i = 0; i < name.size(); i++) {
+    char c = name[i];
+    if (!(std::isalnum(c) || c == '_' || c == ':'))
+      return false;
+  }
+  return true;
+}
+
+// Writes a value as Prometheus expects, e.g. "+Inf" for infinity.
+static void WriteValue(double value, std::ostream &os) {
+  if (KALDI_ISNAN(value)) os << "NaN";
+  else if (KALDI_ISINF(value)) os << (value > 0 ? "+Inf" : "-Inf");
+  else os << value;
+}
+
+// Writes the HELP text, in which backslashes and newlines must be escaped.
+static void WriteHelp(const std::string &name, const std::string &help,
+                      std::ostream &os) {
+  os << "# HELP " << name << ' ';
+  for (size_t i = 0; i < help.size(); i++) {
+    if (help[i] == '\\') os << "\\\\";
+    else if (help[i] == '\n') os << "\\n";
+    else os << help[i];
+  }
+  os << '\n';
+}
+
+
+MetricsRegistry &MetricsRegistry::Global() {
+  static MetricsRegistry registry;
+  return registry;
+}
+
+MetricsRegistry::~MetricsRegistry() {
+  if (write_thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(write_mutex_);
+      stop_ = true;
+    }
+    write_cv_.notify_all();
+    write_thread_.join();
+    WriteFile();
+  }
+}
+
+MetricsRegistry::Metric *MetricsRegistry::GetMetric(const std::string &name,
+                                                    const std::string &help,
+                                                    MetricType type) {
+  std::map<std::string, Metric>::iterator iter = metrics_.find(name);
+  if (iter != metrics_.end()) {
+    if (iter->second.type != type)
+      KALDI_ERR << "Metric " << name
+                << " was already registered with a different type.";
+    return &(iter->second);
+  }
+  if (!IsValidMetricName(name))
+    KALDI_ERR << "Invalid metric name '" << name << "'";
+  Metric &metric = metrics_[name];
+  metric.type = type;
+  metric.help = help;
+  return &metric;
+}
+
+MetricsCounter *MetricsRegistry::GetCounter(const std::string &name,
+                                            const std::string &help) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Metric *metric = GetMetric(name, help, kCounter);
+  if (!metric->counter)
+    metric->counter.reset(new MetricsCounter());
+  return metric->counter.get();
+}
+
+MetricsGauge *MetricsRegistry::GetGauge(const std::string &name,
+                                        const std::string &help) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Metric *metric = GetMetric(name, help, kGauge);
+  if (!metric->gauge)
+    metric->gauge.reset(new MetricsGauge());
+  return metric->gauge.get();
+}
+
+MetricsHistogram *MetricsRegistry::GetHistogram(
+    const std::string &name, const std::string &help,
+    const std::vector<double> &upper_bounds) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Metric *metric = GetMetric(name, help, kHistogram);
+  if (!metric->histogram)
+    metric->histogram.reset(new MetricsHistogram(upper_bounds));
+  return metric->histogram.get();
+}
+
+void MetricsRegistry::AddCollector(const std::function<void()> &collector) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  collectors_.push_back(collector);
+}
+
+void MetricsRegistry::WriteText(std::ostream &os) const {
+  std::vector<std::function<void()> > collectors;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    collectors = collectors_;
+  }
+  // The collectors are called without holding the lock, as they will
+  // normally look up gauges.
+  for (size_t i = 0; i < collectors.size(); i++)
+    collectors[i]();
+
+  std::ostringstream text;
+  text.precision(15);
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (std::map<std::string, Metric>::const_iterator iter = metrics_.begin();
+       iter != metrics_.end(); ++iter) {
+    const std::string &name = iter->first;
+    const Metric &metric = iter->second;
+    WriteHelp(name, metric.help, text);
+    switch (metric.type) {
+      case kCounter:
+        text << "# TYPE " << name << " counter\n" << name << ' ';
+        WriteValue(metric.counter->Value(), text);
+        text << '\n';
+        break;
+      case kGauge:
+        text << "# TYPE " << name << " gauge\n" << name << ' ';
+        WriteValue(metric.gauge->Value(), text);
+        text << '\n';
+        break;
+      case kHistogram: {
+        text << "# TYPE " << name << " histogram\n";
+        const MetricsHistogram &histogram = *metric.histogram;
+        const std::vector<double> &upper_bounds = histogram.UpperBounds();
+        // The bucket counts in the output are cumulative.  The counts are
+        // read one at a time while other threads may be updating them, so
+        // we derive the total count from the buckets to keep it consistent.
+        int64 cumulative_count = 0;
+        for (size_t i = 0; i <= upper_bounds.size(); i++) {
+          cumulative_count += histogram.BucketCount(i);
+          text << name << "_bucket{le=\"";
+          WriteValue(i < upper_bounds.size() ? upper_bounds[i] : HUGE_VAL,
+                     text);
+          text << "\"} " << cumulative_count << '\n';
+        }
+        text << name << "_sum ";
+        WriteValue(histogram.Sum(), text);
+        text << '\n' << name << "_count " << cumulative_count << '\n';
+        break;
+      }
+    }
+  }
+  os << text.str();
+}
+
+void MetricsRegistry::WriteToFilePeriodically(const std::string &filename,
+                                              double interval_seconds) {
+  KALDI_ASSERT(!filename.empty() && interval_seconds > 0.0);
+  if (write_thread_.joinable())
+    KALDI_ERR << "WriteToFilePeriodically() called twice.";
+  Enable();
+  filename_ = filename;
+  interval_seconds_ = interval_seconds;
+  write_thread_ = std::thread(&MetricsRegistry::WriteLoop, this);
+}
+
+void MetricsRegistry::WriteFile() {
+  std::string tmp_filename = filename_ + ".tmp";
+  {
+    std::ofstream os(tmp_filename.c_str());
+    WriteText(os);
+    if (!os.good()) {
+      KALDI_WARN << "Failed to write metrics to " << tmp_filename;
+      return;
+    }
+  }
+  if (std::rename(tmp_filename.c_str(), filename_.c_str()) != 0)
+    KALDI_WARN << "Failed to rename " << tmp_filename << " to " << filename_;
+}
+
+void MetricsRegistry::WriteLoop() {
+  std::chrono::duration<double> interval(interval_seconds_);
+  std::unique_lock<std::mutex> lock(write_mutex_);
+  while (!stop_) {
+    if (write_cv_.wait_for(lock, interval, [this] { return stop_; }))
+      break;
+    lock.unlock();
+    WriteFile();
+    lock.lock();
+  }
+}
+
+
+}  // namespace kaldi
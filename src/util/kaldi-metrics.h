@@ -0,0 +1,218 @@
+// util/kaldi-metrics.h
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_UTIL_KALDI_METRICS_H_
+#define KALDI_UTIL_KALDI_METRICS_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "base/kaldi-common.h"
+
+namespace kaldi {
+
+/// @file kaldi-metrics.h
+/// This file contains a small registry of named counters, gauges and
+/// histograms that the decoding code updates as it goes (real-time factor,
+/// latencies, queue depths, active tokens, lattice sizes, GPU memory), and
+/// that can be written in the Prometheus text exposition format, for servers
+/// to expose to a scraper.  Updating a metric is a few relaxed atomic
+/// operations, so it may be done once per frame or per utterance; it should
+/// not be done in innermost loops.
+///
+/// Code that updates a metric normally looks it up once, e.g.
+/// \code
+///   static MetricsCounter *num_utts = MetricsRegistry::Global().GetCounter(
+///       "kaldi_online_utterances_total", "Number of utterances decoded.");
+///   num_utts->Increment();
+/// \endcode
+/// and a server calls MetricsRegistry::Global().WriteText() when it is
+/// scraped.  Programs can also use the standard option --metrics-file (see
+/// WriteToFilePeriodically()).  Metrics that would be updated once per frame
+/// are only updated if MetricsRegistry::Global().Enabled(), so that programs
+/// that never export the metrics don't pay for them.
+
+
+/// A value that only goes up, e.g. the number of utterances decoded.
+class MetricsCounter {
+ public:
+  MetricsCounter(): value_(0.0) { }
+  /// Adds 'amount', which must be nonnegative.
+  void Increment(double amount = 1.0);
+  double Value() const { return value_.load(std::memory_order_relaxed); }
+ private:
+  std::atomic<double> value_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(MetricsCounter);
+};
+
+/// A value that can go up and down, e.g. the length of a queue.
+class MetricsGauge {
+ public:
+  MetricsGauge(): value_(0.0) { }
+  void Set(double value) { value_.store(value, std::memory_order_relaxed); }
+  void Add(double amount);
+  double Value() const { return value_.load(std::memory_order_relaxed); }
+ private:
+  std::atomic<double> value_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(MetricsGauge);
+};
+
+/// Counts observed values, e.g. latencies, in buckets.  The buckets are
+/// defined by their upper bounds; there is an implicit last bucket with upper
+/// bound +Inf.
+class MetricsHistogram {
+ public:
+  /// 'upper_bounds' must be nonempty and strictly increasing.
+  explicit MetricsHistogram(const std::vector<double> &upper_bounds);
+
+  void Observe(double value);
+
+  const std::vector<double> &UpperBounds() const { return upper_bounds_; }
+  /// Returns the number of observations in bucket i, i.e. greater than
+  /// UpperBounds()[i-1] and less than or equal to UpperBounds()[i]; i may
+  /// equal UpperBounds().size() for the +Inf bucket.
+  int64 BucketCount(int32 i) const {
+    return bucket_counts_[i].load(std::memory_order_relaxed);
+  }
+  int64 Count() const { return count_.load(std::memory_order_relaxed); }
+  double Sum() const { return sum_.load(std::memory_order_relaxed); }
+
+  /// Returns an estimate of the q'th quantile of the observed values, for
+  /// 0 <= q <= 1, interpolating linearly within the bucket it falls in as
+  /// Prometheus's histogram_quantile() does.  The first bucket is taken to
+  /// start at zero (or at its upper bound, if that is negative), and if the
+  /// quantile falls in the +Inf bucket the last finite bound is returned.
+  /// Returns NaN if nothing was observed.
+  double Quantile(double q) const;
+ private:
+  std::vector<double> upper_bounds_;
+  std::unique_ptr<std::atomic<int64>[]> bucket_counts_;
+  std::atomic<int64> count_;
+  std::atomic<double> sum_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(MetricsHistogram);
+};
+
+/// Returns 'count' bucket upper bounds for MetricsHistogram, starting at
+/// 'start' and each 'factor' times the previous one.
+std::vector<double> ExponentialBuckets(double start, double factor,
+                                       int32 count);
+
+/// Returns 'count' bucket upper bounds for MetricsHistogram, starting at
+/// 'start' and each 'width' more than the previous one.
+std::vector<double> LinearBuckets(double start, double width, int32 count);
+
+
+/// The registry owns the metrics; pointers returned by the Get*() functions
+/// stay valid for its lifetime, and all its functions are thread-safe.
+/// Kaldi's own code registers its metrics with Global(); the names start with
+/// "kaldi_".
+class MetricsRegistry {
+ public:
+  MetricsRegistry(): enabled_(false), stop_(false) { }
+  ~MetricsRegistry();
+
+  /// The registry used by Kaldi's own code.  It is created on first use, so
+  /// it outlives any static object that looked up a metric in its
+  /// constructor.
+  static MetricsRegistry &Global();
+
+  /// Each of these returns the metric called 'name', creating it if it does
+  /// not exist.  The name must match [a-zA-Z_:][a-zA-Z0-9_:]* (as Prometheus
+  /// requires) and it is an error if it was registered as a different type of
+  /// metric.  'help' is a description that is printed with the metric.
+  MetricsCounter *GetCounter(const std::string &name, const std::string &help);
+  MetricsGauge *GetGauge(const std::string &name, const std::string &help);
+  /// 'upper_bounds' is only used if the histogram is created.
+  MetricsHistogram *GetHistogram(const std::string &name,
+                                 const std::string &help,
+                                 const std::vector<double> &upper_bounds);
+
+  /// Adds a function that is called at the start of each WriteText(); this is
+  /// for gauges that are cheaper to compute when needed than to keep up to
+  /// date, e.g. by copying a value from another object.  Anything the
+  /// collector refers to must outlive the registry.
+  void AddCollector(const std::function<void()> &collector);
+
+  /// Says that the metrics will be exported, so the code should also update
+  /// those that are too frequent to be worth keeping otherwise (e.g. the
+  /// number of active tokens on each frame decoded).  Servers that call
+  /// WriteText() should call this at startup; WriteToFilePeriodically()
+  /// calls it.
+  void Enable() { enabled_.store(true, std::memory_order_relaxed); }
+  bool Enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+  /// Writes all the metrics, sorted by name, in the Prometheus text
+  /// exposition format (version 0.0.4).  A server can send this in response
+  /// to a scrape, with Content-Type "text/plain; version=0.0.4".
+  void WriteText(std::ostream &os) const;
+
+  /// Starts a thread that writes the metrics to 'filename' every
+  /// 'interval_seconds' seconds, and once more when the registry is
+  /// destroyed.  Each time, the file is written under a temporary name and
+  /// renamed, so readers (e.g. the textfile collector of the Prometheus node
+  /// exporter) never see a partially written file.  This may only be called
+  /// once.
+  void WriteToFilePeriodically(const std::string &filename,
+                               double interval_seconds);
+
+ private:
+  enum MetricType { kCounter, kGauge, kHistogram };
+  struct Metric {
+    MetricType type;
+    std::string help;
+    std::unique_ptr<MetricsCounter> counter;
+    std::unique_ptr<MetricsGauge> gauge;
+    std::unique_ptr<MetricsHistogram> histogram;
+  };
+  // Returns the metric called 'name' if it exists, checking its type;
+  // otherwise creates it without setting the pointer.  Requires that mutex_
+  // be held.
+  Metric *GetMetric(const std::string &name, const std::string &help,
+                    MetricType type);
+  void WriteFile();
+  void WriteLoop();
+
+  mutable std::mutex mutex_;
+  std::map<std::string, Metric> metrics_;
+  std::vector<std::function<void()> > collectors_;
+  std::atomic<bool> enabled_;
+
+  // For WriteToFilePeriodically().
+  std::string filename_;
+  double interval_seconds_;
+  std::thread write_thread_;
+  std::mutex write_mutex_;
+  std::condition_variable write_cv_;
+  bool stop_;  // protected by write_mutex_.
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(MetricsRegistry);
+};
+
+
+}  // namespace kaldi
+
+#endif  // KALDI_UTIL_KALDI_METRICS_H_
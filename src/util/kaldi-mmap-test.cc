@@ -0,0 +1,253 @@
+// util/kaldi-mmap-test.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "util/kaldi-mmap.h"
+#include "util/kaldi-io.h"
+#include "matrix/compressed-matrix.h"
+#include <unistd.h>
+
+namespace kaldi {
+
+// Writes a token, some padding and an array of floats, in the way that
+// mappable objects do, and checks that the array can be used in place from the
+// mapped file and that the file can also be read normally.
+void UnitTestMmapPadding() {
+  const char *filename = "tmpf.mmap";
+  bool binary = true;
+  int32 num_floats = RandInt(1, 10000);
+  std::vector<float> data(num_floats);
+  for (int32 i = 0; i < num_floats; i++)
+    data[i] = RandGauss();
+  std::string token = (RandInt(0, 1) == 0 ? "<Foo>" : "<LongerToken>");
+  {
+    Output ko(filename, binary);
+    WriteToken(ko.Stream(), binary, token);
+    WriteBasicType(ko.Stream(), binary, num_floats);
+    WriteMmapPadding(ko.Stream());
+    ko.Stream().write(reinterpret_cast<const char*>(data.data()),
+                      sizeof(float) * num_floats);
+    WriteToken(ko.Stream(), binary, "</Foo>");
+  }
+  int64 offset;
+  {
+    bool binary_in;
+    Input ki(filename, &binary_in);
+    KALDI_ASSERT(binary_in);
+    std::istream &is = ki.Stream();
+    int32 n;
+    ExpectToken(is, binary, token);
+    ReadBasicType(is, binary, &n);
+    KALDI_ASSERT(n == num_floats);
+    ReadMmapPadding(is);
+    offset = is.tellg();
+    KALDI_ASSERT(offset % kMmapAlignment == 0);
+    std::vector<float> data2(n);
+    is.read(reinterpret_cast<char*>(data2.data()), sizeof(float) * n);
+    ExpectToken(is, binary, "</Foo>");
+    KALDI_ASSERT(data2 == data);
+  }
+  MappedFile mapped;
+  mapped.Open(filename);
+  KALDI_ASSERT(mapped.IsOpen() &&
+               mapped.Size() > offset + sizeof(float) * num_floats);
+  const float *mapped_data =
+      reinterpret_cast<const float*>(mapped.Data() + offset);
+  for (int32 i = 0; i < num_floats; i++)
+    KALDI_ASSERT(mapped_data[i] == data[i]);
+  mapped.Close();
+  KALDI_ASSERT(!mapped.IsOpen());
+  unlink(filename);
+}
+
+// Checks that ReadMmapPadding() does nothing if there is no padding.
+void UnitTestMmapNoPadding() {
+  bool binary = true;
+  std::ostringstream os;
+  WriteToken(os, binary, "<LmStates>");
+  std::istringstream is(os.str());
+  ReadMmapPadding(is);
+  ExpectToken(is, binary, "<LmStates>");
+}
+
+// Writes matrices to an archive, some of them compressed, and reads them back
+// through MappedMatrix and through Input::OpenMapped().
+void UnitTestMappedMatrix() {
+  int32 num_mats = RandInt(1, 5);
+  std::vector<Matrix<float> > mats(num_mats);
+  std::vector<bool> compressed(num_mats);
+  std::vector<std::string> rxfilenames(num_mats);
+  {
+    Output ko("tmpf.ark", true, false);
+    std::ostream &os = ko.Stream();
+    for (int32 i = 0; i < num_mats; i++) {
+      mats[i].Resize(RandInt(1, 20), RandInt(1, 10));
+      mats[i].SetRandn();
+      os << "mat" << i << ' ';
+      rxfilenames[i] = "tmpf.ark:" + std::to_string(os.tellp());
+      InitKaldiOutputStream(os, true);
+      compressed[i] = (RandInt(0, 2) == 0);
+      if (compressed[i]) {
+        CompressedMatrix cmat(mats[i]);
+        cmat.CopyToMat(&(mats[i]));  // What we should read back.
+        cmat.Write(os, true);
+      } else {
+        mats[i].Write(os, true);
+      }
+    }
+  }
+  MappedMatrix mapped;
+  for (int32 i = 0; i < num_mats; i++) {
+    KALDI_ASSERT(mapped.Open(rxfilenames[i]));
+    KALDI_ASSERT(mapped.InPlace() == !compressed[i]);
+    KALDI_ASSERT(mapped.Value().ApproxEqual(mats[i], 0.0));
+    KALDI_ASSERT(mapped.Open(rxfilenames[i] + "[1:1,0:0]") ||
+                 mats[i].NumRows() == 1);
+    if (mats[i].NumRows() > 1) {
+      KALDI_ASSERT(mapped.InPlace() == !compressed[i] &&
+                   mapped.Value().NumRows() == 1 &&
+                   mapped.Value().NumCols() == 1 &&
+                   mapped.Value()(0, 0) == mats[i](1, 0));
+    }
+  }
+  {
+    // Reads the whole archive through a mapping.
+    Input ki;
+    KALDI_ASSERT(ki.OpenMapped("tmpf.ark"));
+    size_t num_bytes;
+    const char *data = ki.MappedData(&num_bytes);
+    KALDI_ASSERT(data != NULL && num_bytes > 0);
+    const char *end = data + num_bytes;
+    for (int32 i = 0; i < num_mats; i++) {
+      std::string key;
+      ki.Stream() >> key;
+      KALDI_ASSERT(key == "mat" + std::to_string(i));
+      ki.Stream().get();
+      bool binary;
+      KALDI_ASSERT(InitKaldiInputStream(ki.Stream(), &binary) && binary);
+      Matrix<float> mat;
+      mat.Read(ki.Stream(), binary);
+      KALDI_ASSERT(mat.ApproxEqual(mats[i], 0.0));
+    }
+    KALDI_ASSERT(ki.MappedData(&num_bytes) == end && num_bytes == 0);
+  }
+  {
+    // Other inputs are opened normally.
+    Input ki;
+    size_t num_bytes;
+    KALDI_ASSERT(ki.OpenMapped("cat tmpf.ark |") &&
+                 ki.MappedData(&num_bytes) == NULL);
+  }
+  unlink("tmpf.ark");
+}
+
+// Reads files through shared-memory segments, as the processes on a machine
+// would, and checks that a segment is replaced when the file changes.
+void UnitTestNodeShared() {
+  Matrix<float> mat(RandInt(1, 20), RandInt(1, 10));
+  mat.SetRandn();
+  WriteKaldiObject(mat, "tmpf.mat", true);
+  MappedFile::RemoveNodeShared("tmpf.mat");
+  MappedFile file1, file2;
+  // The first creates the segment and the second maps it.
+  KALDI_ASSERT(file1.TryOpenNodeShared("tmpf.mat") &&
+               file2.TryOpenNodeShared("tmpf.mat"));
+  {
+    MappedFile file;
+    file.Open("tmpf.mat");
+    KALDI_ASSERT(file1.Size() == file.Size() && file2.Size() == file.Size() &&
+                 memcmp(file1.Data(), file.Data(), file.Size()) == 0 &&
+                 memcmp(file2.Data(), file.Data(), file.Size()) == 0);
+  }
+  Matrix<float> mat2;
+  ReadKaldiObjectNodeShared("tmpf.mat", &mat2);
+  KALDI_ASSERT(mat2.ApproxEqual(mat, 0.0));
+
+  // Another version of the file replaces the segment, without affecting the
+  // existing mappings.
+  std::vector<char> old_data(file1.Data(), file1.Data() + file1.Size());
+  mat.Resize(mat.NumRows() + 1, mat.NumCols());
+  mat.SetRandn();
+  unlink("tmpf.mat");
+  WriteKaldiObject(mat, "tmpf.mat", true);
+  ReadKaldiObjectNodeShared("tmpf.mat", &mat2);
+  KALDI_ASSERT(mat2.ApproxEqual(mat, 0.0));
+  KALDI_ASSERT(memcmp(file1.Data(), &(old_data[0]), old_data.size()) == 0);
+
+  {
+    // Other inputs are read normally.
+    Input ki;
+    size_t num_bytes;
+    KALDI_ASSERT(ki.OpenNodeShared("cat tmpf.mat |") &&
+                 ki.MappedData(&num_bytes) == NULL);
+  }
+  MappedFile::RemoveNodeShared("tmpf.mat");
+  unlink("tmpf.mat");
+}
+
+// Allocates memory in each of the huge page modes, which should work (maybe
+// without huge pages) whatever the system's settings, and checks that
+// MappedFile::Open() then reads the file.
+void UnitTestHugePages() {
+  const char *modes[] = { "none", "transparent", "explicit" };
+  Matrix<float> mat(RandInt(1, 20), RandInt(1, 10));
+  mat.SetRandn();
+  WriteKaldiObject(mat, "tmpf.mat", true);
+  MappedFile mapped;
+  mapped.Open("tmpf.mat");
+  std::vector<char> file_data(mapped.Data(), mapped.Data() + mapped.Size());
+  mapped.Close();
+  for (int32 m = 0; m < 3; m++) {
+    g_huge_pages = modes[m];
+    HugePageMode mode = GetHugePageMode();
+    KALDI_ASSERT(mode == static_cast<HugePageMode>(m));
+    HugePageBuffer buffer;
+    size_t size = RandInt(1, 3) * (static_cast<size_t>(1) << 20) +
+        RandInt(0, 100);
+    char *data = buffer.Allocate(size, mode);
+    KALDI_ASSERT(data != NULL && data == buffer.Data() &&
+                 buffer.Size() == size &&
+                 reinterpret_cast<size_t>(data) % kMmapAlignment == 0);
+    memset(data, m, size);
+    KALDI_ASSERT(data[0] == m && data[size - 1] == m);
+    buffer.Free();
+    KALDI_ASSERT(buffer.Data() == NULL && !buffer.Explicit());
+
+    mapped.Open("tmpf.mat");
+    KALDI_ASSERT(mapped.Size() == file_data.size() &&
+                 memcmp(mapped.Data(), &(file_data[0]), mapped.Size()) == 0);
+    mapped.Close();
+  }
+  g_huge_pages = "none";
+  unlink("tmpf.mat");
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 10; i++) {
+    UnitTestMmapPadding();
+    UnitTestMmapNoPadding();
+    UnitTestMappedMatrix();
+    UnitTestNodeShared();
+    UnitTestHugePages();
+  }
+  std::cout << "Test OK.\n";
+  return 0;
+}
@@ -0,0 +1,629 @@
+// util/kaldi-mmap.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "util/kaldi-mmap.h"
+#include "util/kaldi-holder.h"
+
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#ifndef _MSC_VER
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if !defined(_MSC_VER) && defined(MAP_HUGETLB)
+// These are only defined in the headers of newer systems.
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+#endif
+
+namespace kaldi {
+
+std::string g_huge_pages = "none";
+int32 g_huge_page_size_mb = 2;
+
+HugePageMode GetHugePageMode() {
+  if (g_huge_pages == "none")
+    return kHugePagesNone;
+  else if (g_huge_pages == "transparent")
+    return kHugePagesTransparent;
+  else if (g_huge_pages == "explicit")
+    return kHugePagesExplicit;
+  KALDI_ERR << "Invalid value --huge-pages=" << g_huge_pages
+            << " (expected none, transparent or explicit)";
+  return kHugePagesNone;  // Suppress compiler warning.
+}
+
+void RegisterHugePageOptions(OptionsItf *opts) {
+  opts->Register("huge-pages", &g_huge_pages, "Back the decoding graph and "
+                 "language model arrays with huge pages, which reduces TLB "
+                 "misses in decoding: none, transparent (transparent huge "
+                 "pages, if the kernel has them enabled) or explicit (the "
+                 "pool of huge pages reserved in /proc/sys/vm/nr_hugepages, "
+                 "falling back to transparent).  Anything other than none "
+                 "also reads files that would be memory-mapped.");
+  opts->Register("huge-page-size", &g_huge_page_size_mb, "Size in MB of the "
+                 "pages used with --huge-pages=explicit: 2 or 1024.");
+}
+
+
+namespace {
+// The size of transparent huge pages on the platforms that have them.
+const size_t kTransparentHugePageSize = static_cast<size_t>(2) << 20;
+
+size_t RoundUpTo(size_t size, size_t multiple) {
+  return (size + multiple - 1) / multiple * multiple;
+}
+
+#ifndef _MSC_VER
+// Reads 'num_bytes' bytes of the file 'filename' into 'data'.
+bool ReadWholeFile(const std::string &filename, char *data, size_t num_bytes) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  while (num_bytes > 0) {
+    ssize_t n = read(fd, data, num_bytes);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0) {
+      int err = (n == 0 ? EIO : errno);  // n == 0: the file was truncated.
+      close(fd);
+      errno = err;
+      return false;
+    }
+    data += n;
+    num_bytes -= n;
+  }
+  close(fd);
+  return true;
+}
+#endif
+}  // namespace
+
+char *HugePageBuffer::Allocate(size_t size, HugePageMode mode) {
+  Free();
+  if (size == 0)
+    return NULL;
+#ifdef _MSC_VER
+  data_ = static_cast<char*>(KALDI_MEMALIGN(kMmapAlignment, size, &orig_));
+  if (data_ == NULL)
+    KALDI_ERR << "Failed to allocate " << size << " bytes of memory.";
+  size_ = size;
+  map_size_ = size;
+  return data_;
+#else
+  if (mode == kHugePagesExplicit) {
+#ifdef MAP_HUGETLB
+    if (g_huge_page_size_mb != 2 && g_huge_page_size_mb != 1024)
+      KALDI_ERR << "Invalid value --huge-page-size=" << g_huge_page_size_mb
+                << " (expected 2 or 1024)";
+    size_t page_size = static_cast<size_t>(g_huge_page_size_mb) << 20;
+    size_t map_size = RoundUpTo(size, page_size);
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB |
+        (g_huge_page_size_mb == 2 ? MAP_HUGE_2MB : MAP_HUGE_1GB);
+    void *ptr = mmap(NULL, map_size, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (ptr != MAP_FAILED) {
+      data_ = static_cast<char*>(ptr);
+      size_ = size;
+      map_size_ = map_size;
+      explicit_ = true;
+      return data_;
+    }
+#else
+    errno = ENOSYS;
+#endif
+    static std::atomic<bool> warned(false);
+    if (!warned.exchange(true))
+      KALDI_WARN << "Could not allocate " << size << " bytes of "
+                 << g_huge_page_size_mb << "MB huge pages ("
+                 << strerror(errno) << "); reserve more of them in "
+                 << "/proc/sys/vm/nr_hugepages.  Using transparent huge pages "
+                 << "instead.";
+    mode = kHugePagesTransparent;
+  }
+  // We map more than we need so that we can align the start to a huge page,
+  // and then unmap what is before and after the aligned range.  Without huge
+  // pages, mmap() gives us page-aligned memory anyway.
+  size_t alignment = (mode == kHugePagesTransparent ?
+                      kTransparentHugePageSize : kMmapAlignment);
+  size_t aligned_size = RoundUpTo(size, alignment);
+  size_t map_size = aligned_size + alignment - kMmapAlignment;
+  void *ptr = mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (ptr == MAP_FAILED)
+    KALDI_ERR << "Failed to allocate " << size << " bytes of memory: "
+              << strerror(errno);
+  char *begin = static_cast<char*>(ptr),
+      *data = begin + (alignment - reinterpret_cast<size_t>(begin) %
+                       alignment) % alignment;
+  if (data != begin)
+    munmap(begin, data - begin);
+  if (data + aligned_size != begin + map_size)
+    munmap(data + aligned_size, begin + map_size - (data + aligned_size));
+#ifdef MADV_HUGEPAGE
+  if (mode == kHugePagesTransparent &&
+      madvise(data, aligned_size, MADV_HUGEPAGE) != 0) {
+    static std::atomic<bool> warned(false);
+    if (!warned.exchange(true))
+      KALDI_WARN << "Could not request transparent huge pages ("
+                 << strerror(errno) << "); are they disabled in "
+                 << "/sys/kernel/mm/transparent_hugepage/enabled?";
+  }
+#endif
+  data_ = data;
+  size_ = size;
+  map_size_ = aligned_size;
+  return data_;
+#endif
+}
+
+void HugePageBuffer::MakeReadOnly() {
+#ifndef _MSC_VER
+  if (data_ != NULL && mprotect(data_, map_size_, PROT_READ) != 0)
+    KALDI_WARN << "Failed to make memory read-only: " << strerror(errno);
+#endif
+}
+
+void HugePageBuffer::Free() {
+  if (data_ == NULL)
+    return;
+#ifdef _MSC_VER
+  KALDI_MEMALIGN_FREE(orig_);
+#else
+  if (munmap(data_, map_size_) != 0)
+    KALDI_WARN << "Failed to free memory: " << strerror(errno);
+#endif
+  data_ = NULL;
+  size_ = 0;
+  map_size_ = 0;
+  explicit_ = false;
+}
+
+
+void MappedFile::Open(const std::string &filename) {
+  if (ClassifyRxfilename(filename) != kFileInput)
+    KALDI_ERR << "Only plain files can be memory-mapped, not "
+              << PrintableRxfilename(filename);
+#ifdef _MSC_VER
+  KALDI_ERR << "Memory-mapping files is not supported on Windows.";
+#else
+  HugePageMode mode = GetHugePageMode();
+  if (mode != kHugePagesNone) {
+    Close();
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0)
+      KALDI_ERR << "Failed to read " << filename << ": " << strerror(errno);
+    if (st.st_size == 0)
+      KALDI_ERR << "Failed to read " << filename << ": file is empty.";
+    char *data = buffer_.Allocate(st.st_size, mode);
+    if (!ReadWholeFile(filename, data, st.st_size)) {
+      int err = errno;
+      buffer_.Free();
+      KALDI_ERR << "Failed to read " << filename << ": " << strerror(err);
+    }
+    buffer_.MakeReadOnly();
+    data_ = data;
+    size_ = st.st_size;
+    return;
+  }
+  if (!TryOpen(filename))
+    KALDI_ERR << "Failed to map " << filename << ": " << strerror(errno);
+#endif
+}
+
+bool MappedFile::TryOpen(const std::string &filename) {
+  Close();
+  if (ClassifyRxfilename(filename) != kFileInput) {
+    errno = EINVAL;
+    return false;
+  }
+#ifdef _MSC_VER
+  errno = ENOSYS;
+  return false;
+#else
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  // mmap() fails with EINVAL for empty files.
+  void *ptr = (fstat(fd, &st) != 0 ? MAP_FAILED :
+               mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0));
+  int err = errno;
+  close(fd);  // The mapping stays valid after the descriptor is closed.
+  if (ptr == MAP_FAILED) {
+    errno = err;
+    return false;
+  }
+  data_ = static_cast<const char*>(ptr);
+  size_ = st.st_size;
+  return true;
+#endif
+}
+
+
+#if !defined(_MSC_VER) && !defined(__ANDROID__)
+namespace {
+// The header of the shared-memory segments of
+// MappedFile::TryOpenNodeShared(); the file follows it at offset
+// kMmapAlignment, so that it is as aligned as a mapped file.
+struct NodeSharedHeader {
+  enum { kWriting = 0, kReady = 1, kFailed = 2 };
+  int32 state;  // Accessed atomically.
+  int32 pid;  // The process writing the segment; zero until it is known.
+  // These identify the version of the file in the segment.
+  int64 device;
+  int64 inode;
+  int64 size;
+  int64 mtime;
+};
+
+// Returns the name of the segment for the file 'filename': there is one per
+// user and directory.
+bool GetNodeSharedName(const std::string &filename, std::string *name) {
+  char *path = realpath(filename.c_str(), NULL);
+  if (path == NULL)
+    return false;
+  std::string dir(path);
+  free(path);
+  dir = dir.substr(0, dir.rfind('/'));
+  std::ostringstream os;
+  os << "/kaldi-" << getuid() << '-' << std::hex
+     << std::hash<std::string>()(dir);
+  *name = os.str();
+  return true;
+}
+
+}  // namespace
+#endif
+
+bool MappedFile::TryOpenNodeShared(const std::string &filename) {
+  Close();
+  if (ClassifyRxfilename(filename) != kFileInput) {
+    errno = EINVAL;
+    return false;
+  }
+#if defined(_MSC_VER) || defined(__ANDROID__)
+  errno = ENOSYS;
+  return false;
+#else
+  struct stat st;
+  std::string name;
+  if (stat(filename.c_str(), &st) != 0 || !GetNodeSharedName(filename, &name))
+    return false;
+  const off_t header_size = kMmapAlignment;
+  // We retry if we find a segment for another file, or one whose writer
+  // died, and remove it; if another process removed and recreated it at the
+  // same time we may remove its new segment too, which wastes a read of the
+  // file but is otherwise harmless, since removing a segment does not affect
+  // the processes that have it mapped.
+  for (int32 attempt = 0; attempt < 10; attempt++) {
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd >= 0) {
+      // We created the segment, so we have to fill it in.
+      size_t map_size = header_size + st.st_size;
+      void *ptr = (ftruncate(fd, map_size) != 0 ? MAP_FAILED :
+                   mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                        fd, 0));
+      int err = errno;
+      close(fd);
+      if (ptr == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        errno = err;
+        return false;
+      }
+      NodeSharedHeader *header = static_cast<NodeSharedHeader*>(ptr);
+      __atomic_store_n(&header->pid, getpid(), __ATOMIC_RELAXED);
+      header->device = st.st_dev;
+      header->inode = st.st_ino;
+      header->size = st.st_size;
+      header->mtime = st.st_mtime;
+      char *data = static_cast<char*>(ptr) + header_size;
+      if (!ReadWholeFile(filename, data, st.st_size)) {
+        err = errno;
+        __atomic_store_n(&header->state, NodeSharedHeader::kFailed,
+                         __ATOMIC_RELEASE);
+        shm_unlink(name.c_str());
+        munmap(ptr, map_size);
+        errno = err;
+        return false;
+      }
+      __atomic_store_n(&header->state, NodeSharedHeader::kReady,
+                       __ATOMIC_RELEASE);
+      mprotect(ptr, map_size, PROT_READ);
+      data_ = data;
+      size_ = st.st_size;
+      offset_ = header_size;
+      return true;
+    }
+    if (errno != EEXIST)
+      return false;
+    fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+      if (errno == ENOENT)
+        continue;  // It was removed in the meantime.
+      return false;
+    }
+    // Wait until the writer has sized the segment.  It does that right after
+    // creating it, so if it takes more than a few seconds the writer must have
+    // died.
+    struct stat shm_st;
+    int32 num_waits = 0;
+    while (fstat(fd, &shm_st) == 0 && shm_st.st_size < header_size &&
+           num_waits < 1000) {
+      Sleep(0.01);
+      num_waits++;
+    }
+    void *ptr = (shm_st.st_size < header_size ? MAP_FAILED :
+                 mmap(NULL, shm_st.st_size, PROT_READ, MAP_SHARED, fd, 0));
+    close(fd);
+    if (ptr == MAP_FAILED) {
+      shm_unlink(name.c_str());
+      continue;
+    }
+    const NodeSharedHeader *header =
+        static_cast<const NodeSharedHeader*>(ptr);
+    int32 state;
+    num_waits = 0;
+    while ((state = __atomic_load_n(&header->state, __ATOMIC_ACQUIRE)) ==
+           NodeSharedHeader::kWriting) {
+      // The writer sets 'pid' right after sizing the segment.
+      int32 pid = __atomic_load_n(&header->pid, __ATOMIC_RELAXED);
+      if ((pid != 0 && kill(pid, 0) != 0 && errno == ESRCH) ||
+          (pid == 0 && ++num_waits > 1000))
+        break;  // The writer died.
+      Sleep(0.01);
+    }
+    bool same_file = (state == NodeSharedHeader::kReady &&
+                      header->device == st.st_dev &&
+                      header->inode == st.st_ino &&
+                      header->size == st.st_size &&
+                      header->mtime == st.st_mtime &&
+                      shm_st.st_size == header_size + st.st_size);
+    if (same_file) {
+      data_ = static_cast<const char*>(ptr) + header_size;
+      size_ = st.st_size;
+      offset_ = header_size;
+      return true;
+    }
+    munmap(ptr, shm_st.st_size);
+    // A failed writer removes the segment itself; otherwise it is stale.
+    if (state != NodeSharedHeader::kFailed)
+      shm_unlink(name.c_str());
+  }
+  errno = EAGAIN;
+  return false;
+#endif
+}
+
+void MappedFile::RemoveNodeShared(const std::string &filename) {
+#if !defined(_MSC_VER) && !defined(__ANDROID__)
+  std::string name;
+  if (GetNodeSharedName(filename, &name))
+    shm_unlink(name.c_str());
+#endif
+}
+
+void MappedFile::Close() {
+  if (data_ == NULL)
+    return;
+  if (buffer_.Data() != NULL) {
+    buffer_.Free();
+  } else {
+#ifndef _MSC_VER
+    if (munmap(const_cast<char*>(data_ - offset_), size_ + offset_) != 0)
+      KALDI_WARN << "Failed to unmap file: " << strerror(errno);
+#endif
+  }
+  data_ = NULL;
+  size_ = 0;
+  offset_ = 0;
+}
+
+
+namespace {
+// An entry in the cache of GetSharedMappedFile().
+struct SharedMappedFile {
+  std::weak_ptr<const MappedFile> file;
+  // These identify the version of the file that was mapped.
+  int64 inode;
+  int64 size;
+  int64 mtime;
+};
+}  // namespace
+
+std::shared_ptr<const MappedFile> GetSharedMappedFile(
+    const std::string &filename) {
+#ifdef _MSC_VER
+  errno = ENOSYS;
+  return std::shared_ptr<const MappedFile>();
+#else
+  static std::mutex mutex;
+  static std::map<std::string, SharedMappedFile> cache;
+
+  struct stat st;
+  if (stat(filename.c_str(), &st) != 0)
+    return std::shared_ptr<const MappedFile>();
+  std::lock_guard<std::mutex> lock(mutex);
+  std::map<std::string, SharedMappedFile>::iterator iter =
+      cache.find(filename);
+  if (iter != cache.end()) {
+    std::shared_ptr<const MappedFile> file = iter->second.file.lock();
+    if (file != NULL && iter->second.inode == st.st_ino &&
+        iter->second.size == st.st_size && iter->second.mtime == st.st_mtime)
+      return file;
+  }
+  MappedFile *file = new MappedFile();
+  if (!file->TryOpen(filename)) {
+    int err = errno;
+    delete file;
+    errno = err;
+    return std::shared_ptr<const MappedFile>();
+  }
+  // Forget the files that are no longer mapped, so the cache doesn't grow.
+  for (iter = cache.begin(); iter != cache.end(); ) {
+    if (iter->second.file.expired())
+      cache.erase(iter++);
+    else
+      ++iter;
+  }
+  std::shared_ptr<const MappedFile> ans(file);
+  SharedMappedFile &entry = cache[filename];
+  entry.file = ans;
+  entry.inode = st.st_ino;
+  entry.size = st.st_size;
+  entry.mtime = st.st_mtime;
+  return ans;
+#endif
+}
+
+
+bool MappedMatrix::Open(const std::string &rxfilename) {
+  delete view_;
+  view_ = NULL;
+  in_place_ = false;
+  mat_.Resize(0, 0);
+  std::string data_rxfilename = rxfilename, range;
+  if (!rxfilename.empty() && rxfilename[rxfilename.size() - 1] == ']' &&
+      !ExtractRangeSpecifier(rxfilename, &data_rxfilename, &range)) {
+    KALDI_WARN << "Could not parse range specifier in " << rxfilename;
+    return false;
+  }
+  bool binary;
+  if (!input_.OpenMapped(data_rxfilename, &binary)) {
+    KALDI_WARN << "Error opening " << PrintableRxfilename(data_rxfilename);
+    return false;
+  }
+  size_t num_bytes;
+  const char *data = input_.MappedData(&num_bytes);
+  // A binary float matrix is "FM ", then the number of rows and of columns
+  // as one byte (the size) and four bytes each, then the data.
+  const size_t header_size = 3 + 2 * (1 + sizeof(int32));
+  int32 num_rows, num_cols;
+  if (binary && data != NULL && num_bytes >= header_size &&
+      strncmp(data, "FM ", 3) == 0 && data[3] == sizeof(int32) &&
+      data[8] == sizeof(int32)) {
+    memcpy(&num_rows, data + 4, sizeof(int32));
+    memcpy(&num_cols, data + 9, sizeof(int32));
+    if (num_rows < 0 || num_cols < 0 || (num_rows == 0) != (num_cols == 0) ||
+        static_cast<size_t>(num_rows) * num_cols * sizeof(float) >
+        num_bytes - header_size) {
+      KALDI_WARN << "Invalid or truncated matrix in "
+                 << PrintableRxfilename(data_rxfilename);
+      return false;
+    }
+    // SubMatrix needs a non-const pointer; see the comment for Value().
+    float *mat_data = reinterpret_cast<float*>(
+        const_cast<char*>(data + header_size));
+    view_ = new SubMatrix<float>(mat_data, num_rows, num_cols, num_cols);
+    in_place_ = true;
+  } else {
+    try {
+      mat_.Read(input_.Stream(), binary);
+    } catch (const std::exception &e) {
+      KALDI_WARN << "Error reading matrix from "
+                 << PrintableRxfilename(data_rxfilename) << ": " << e.what();
+      return false;
+    }
+    view_ = new SubMatrix<float>(mat_, 0, mat_.NumRows(), 0, mat_.NumCols());
+  }
+  if (!range.empty()) {
+    std::vector<int32> row_range, col_range;
+    SubMatrix<float> *range_view = NULL;
+    // ParseMatrixRangeSpecifier() throws on most errors.
+    if (ParseMatrixRangeSpecifier(range, view_->NumRows(), view_->NumCols(),
+                                  &row_range, &col_range)) {
+      int32 last_row = std::min(row_range[1], view_->NumRows() - 1);
+      if (last_row >= row_range[0])
+        range_view = new SubMatrix<float>(
+            *view_, row_range[0], last_row - row_range[0] + 1,
+            col_range[0], col_range[1] - col_range[0] + 1);
+    }
+    delete view_;
+    view_ = range_view;
+    if (view_ == NULL) {
+      KALDI_WARN << "Invalid or empty range in " << rxfilename;
+      in_place_ = false;
+      return false;
+    }
+  }
+  return true;
+}
+
+const SubMatrix<float> &MappedMatrix::Value() const {
+  static const SubMatrix<float> empty(NULL, 0, 0, 0);
+  return (view_ != NULL ? *view_ : empty);
+}
+
+
+void WriteMmapPadding(std::ostream &os, size_t header_size) {
+  bool binary = true;
+  // Work out the size of what we write before the zero bytes.
+  std::ostringstream prefix;
+  WriteToken(prefix, binary, "<Pad>");
+  WriteBasicType(prefix, binary, static_cast<int32>(0));
+
+  int32 num_zeros = 0;
+  std::streamoff pos = os.tellp();
+  if (pos >= 0) {
+    int64 data_pos = static_cast<int64>(pos) + prefix.str().size() +
+        header_size;
+    num_zeros = (kMmapAlignment - data_pos % kMmapAlignment) % kMmapAlignment;
+  }
+  WriteToken(os, binary, "<Pad>");
+  WriteBasicType(os, binary, num_zeros);
+  std::vector<char> zeros(num_zeros, '\0');
+  os.write(zeros.data(), num_zeros);
+  if (!os.good())
+    KALDI_ERR << "Error writing padding to stream.";
+}
+
+void ReadMmapPadding(std::istream &is) {
+  bool binary = true;
+  if (PeekToken(is, binary) != 'P')
+    return;
+  ExpectToken(is, binary, "<Pad>");
+  int32 num_zeros;
+  ReadBasicType(is, binary, &num_zeros);
+  if (num_zeros < 0 || num_zeros >= kMmapAlignment)
+    KALDI_ERR << "Invalid padding size " << num_zeros;
+  is.ignore(num_zeros);
+  if (!is.good())
+    KALDI_ERR << "Error reading padding from stream.";
+}
+
+}  // namespace kaldi
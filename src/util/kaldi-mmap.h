@@ -0,0 +1,252 @@
+// util/kaldi-mmap.h
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_UTIL_KALDI_MMAP_H_
+#define KALDI_UTIL_KALDI_MMAP_H_
+
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include "base/kaldi-common.h"
+#include "itf/options-itf.h"
+#include "matrix/kaldi-matrix.h"
+#include "util/kaldi-io.h"
+
+namespace kaldi {
+
+/// How large, read-mostly arrays such as decoding graphs and language models
+/// are backed by memory; see HugePageBuffer.
+enum HugePageMode {
+  kHugePagesNone,         // Ordinary pages.
+  kHugePagesTransparent,  // Transparent huge pages (Linux), if enabled.
+  kHugePagesExplicit      // Pages from the huge page pool (Linux hugetlbfs).
+};
+
+extern std::string g_huge_pages;  // "none", "transparent" or "explicit"; set
+                                  // by --huge-pages.
+extern int32 g_huge_page_size_mb;  // The size of explicit huge pages in MB (2
+                                   // or 1024); set by --huge-page-size.
+
+/// Returns the mode that g_huge_pages selects; throws if it is invalid.
+HugePageMode GetHugePageMode();
+
+/// Registers the --huge-pages and --huge-page-size options, which set
+/// g_huge_pages and g_huge_page_size_mb.
+void RegisterHugePageOptions(OptionsItf *opts);
+
+/**
+   HugePageBuffer allocates memory for a large array that is accessed at
+   random, such as the arcs of a decoding graph or the LmStates of a
+   ConstArpaLm.  With 4KB pages, a lookup in a multi-gigabyte array nearly
+   always misses in the TLB, and the page walk costs about as much as the
+   cache miss on the data itself; backing the array with 2MB or 1GB pages
+   removes most of that.
+
+   With kHugePagesTransparent, the memory is aligned to 2MB and marked with
+   madvise(MADV_HUGEPAGE), so that the kernel backs it with transparent huge
+   pages if it can (this needs /sys/kernel/mm/transparent_hugepage/enabled to
+   be "always" or "madvise").  With kHugePagesExplicit, it comes from the pool
+   of huge pages of size g_huge_page_size_mb that the administrator reserved
+   (/proc/sys/vm/nr_hugepages, or the per-size files in
+   /sys/kernel/mm/hugepages); if the pool is too small we warn and fall back to
+   transparent huge pages.  Either way, the memory is ordinary memory of the
+   process, not shared with other processes.  On systems without huge pages,
+   all modes give ordinary page-aligned memory.
+ */
+class HugePageBuffer {
+ public:
+  HugePageBuffer(): data_(NULL), size_(0), map_size_(0), explicit_(false) { }
+
+  /// Allocates 'size' bytes (uninitialized) in the mode 'mode', freeing
+  /// anything allocated before, and returns Data().  Throws if the memory
+  /// could not be allocated at all.
+  char *Allocate(size_t size, HugePageMode mode);
+
+  /// Makes the memory read-only, so that writing to it crashes the program.
+  void MakeReadOnly();
+
+  /// Frees the memory, if any.
+  void Free();
+
+  char *Data() const { return data_; }
+  size_t Size() const { return size_; }
+
+  /// Returns true if the memory came from the pool of explicit huge pages
+  /// (with transparent huge pages we cannot tell whether we got them).
+  bool Explicit() const { return explicit_; }
+
+  ~HugePageBuffer() { Free(); }
+ private:
+  char *data_;
+  size_t size_;
+  size_t map_size_;  // The size of what we allocated, from data_ on.
+  bool explicit_;
+#ifdef _MSC_VER
+  void *orig_;  // For KALDI_MEMALIGN_FREE().
+#endif
+  KALDI_DISALLOW_COPY_AND_ASSIGN(HugePageBuffer);
+};
+
+/**
+   MappedFile maps a whole file read-only into memory.  It is used by objects
+   such as FlatFst (decoder/flat-fst.h) and ConstArpaLm (lm/const-arpa-lm.h)
+   that store large arrays as raw memory on disk, so that instead of being
+   read in they can be used directly from the mapped file.  The pages are
+   shared with the page cache, so many processes that map the same file share
+   one copy of it in RAM, and mapping is nearly instantaneous because nothing
+   is read until it is touched.
+
+   Those objects write their arrays after a call to WriteMmapPadding(), which
+   makes sure that the arrays start at a page-aligned offset in the file.
+
+   If huge pages are requested (GetHugePageMode() != kHugePagesNone), Open()
+   reads the file into a read-only HugePageBuffer instead of mapping it: the
+   TLB misses on the mapped pages, which cannot be huge pages, cost more in
+   decoding than loading the file once does, but the memory is then not
+   shared with other processes.
+ */
+class MappedFile {
+ public:
+  MappedFile(): data_(NULL), size_(0), offset_(0) { }
+
+  /// Maps the file 'filename' (which must be an actual file, not a pipe or the
+  /// standard input), or reads it into huge pages as explained above.  Throws
+  /// an exception on failure.  Any previously mapped file is unmapped first.
+  void Open(const std::string &filename);
+
+  /// As Open(), but returns false instead of throwing if the file could not be
+  /// mapped (errno then says why).
+  bool TryOpen(const std::string &filename);
+
+  /// As TryOpen(), but instead of mapping the file itself, maps a copy of it
+  /// in a POSIX shared-memory segment that is shared by all the processes on
+  /// this machine that open the same version of the file this way: the first
+  /// of them reads the file into the segment and the others wait for it and
+  /// map it.  This is for files that many jobs on a machine read at about the
+  /// same time from a network file system, such as the model in each
+  /// iteration of neural net training, so that only one of them reads it over
+  /// the network.  The segment outlives the processes, so that jobs started
+  /// later can use it too, until a different file from the same directory
+  /// replaces it; so there is at most one segment per directory (on Linux,
+  /// they are the files /dev/shm/kaldi-*, which may be deleted at any time).
+  /// Returns false if the segment could not be created or the file could not
+  /// be read (errno then says why); the caller should then read the file
+  /// normally.
+  bool TryOpenNodeShared(const std::string &filename);
+
+  /// Removes the shared-memory segment that TryOpenNodeShared() uses for
+  /// 'filename' (i.e. for its directory), if there is one, e.g. at the end of
+  /// training; this does not affect the processes that have it mapped.
+  static void RemoveNodeShared(const std::string &filename);
+
+  /// Unmaps the file, if one was mapped.  Pointers into it become invalid.
+  void Close();
+
+  bool IsOpen() const { return data_ != NULL; }
+
+  /// Returns the start of the mapped memory.  Note: the memory is mapped
+  /// read-only, so attempting to write to it will crash the program.
+  const char *Data() const { return data_; }
+
+  /// Returns the size of the mapped file in bytes.
+  size_t Size() const { return size_; }
+
+  ~MappedFile() { Close(); }
+ private:
+  const char *data_;
+  size_t size_;
+  size_t offset_;  // The size of the header of a shared-memory segment, which
+                   // is mapped before data_; zero for a file.
+  HugePageBuffer buffer_;  // Holds the file if Open() read it into huge pages.
+  KALDI_DISALLOW_COPY_AND_ASSIGN(MappedFile);
+};
+
+/// Returns a mapping of the file 'filename' that is shared with everything
+/// else in the process that got that file from this function and still holds
+/// it, so that for example many Input objects reading from the same archive
+/// (see Input::OpenMapped()) map it only once.  The mapping is unmapped when
+/// the last pointer to it is released.  If the file has been replaced or
+/// modified since it was mapped, it is mapped again.  Returns NULL if the file
+/// could not be mapped (errno then says why).  Thread-safe.
+std::shared_ptr<const MappedFile> GetSharedMappedFile(
+    const std::string &filename);
+
+/**
+   Class MappedMatrix reads a float matrix from a file or from an offset into
+   a file, such as the "foo.ark:1234" of an scp file, through a shared mapping
+   of the file (see Input::OpenMapped()).  If the matrix is stored in binary
+   mode as uncompressed float, Value() refers to it in place in the mapping
+   and nothing is copied; otherwise (e.g. for a CompressedMatrix, which is
+   decompressed straight from the mapping) it is read into a matrix owned by
+   this object.  Row and column ranges, as in "foo.ark:1234[0:9]", are
+   views too.  This is for programs that look up many matrices at random,
+   such as i-vectors; the RandomAccessTableReader, which has to return a
+   Matrix, can use the mapping but not the views (the "mmap" option of the
+   rspecifier).
+ */
+class MappedMatrix {
+ public:
+  MappedMatrix(): view_(NULL), in_place_(false) { }
+
+  /// Reads the matrix in 'rxfilename'; it may be any rxfilename, but only
+  /// files and offsets into files are mapped.  Returns false on error.
+  bool Open(const std::string &rxfilename);
+
+  /// Returns the matrix (an empty one if not open).  Note: when InPlace(),
+  /// its memory is read-only, and writing to it will crash the program.  It
+  /// stays valid until this object is reopened or destroyed.
+  const SubMatrix<float> &Value() const;
+
+  /// Returns true if Value() refers to the data in the mapped file rather
+  /// than to a copy.
+  bool InPlace() const { return in_place_; }
+
+  ~MappedMatrix() { delete view_; }
+ private:
+  Input input_;
+  Matrix<float> mat_;  // The matrix if it was not stored as binary float.
+  SubMatrix<float> *view_;  // NULL if not open.
+  bool in_place_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(MappedMatrix);
+};
+
+/// The alignment that WriteMmapPadding() pads the file to; this is a multiple
+/// of the page size on all the platforms we support.
+static const int32 kMmapAlignment = 4096;
+
+/// Writes a token "<Pad>", an integer n and then n zero bytes, where n is
+/// chosen so that the data written after the next 'header_size' bytes will
+/// start at an offset that is a multiple of kMmapAlignment from the start of
+/// the stream.  Objects that support memory-mapping call this just before
+/// writing the raw arrays they want to be able to map (header_size is the size
+/// of anything, such as tokens and array sizes, that they write in between).
+/// If the position in the stream is not known (e.g. if we are writing to a
+/// pipe), we write n = 0; that output can still be read normally but may not
+/// be mappable.  Binary mode only.
+void WriteMmapPadding(std::ostream &os, size_t header_size = 0);
+
+/// Reads what WriteMmapPadding() wrote.  If the next token in the stream is not
+/// "<Pad>" it does nothing, so that formats where the padding was introduced
+/// later can still read older files.  Binary mode only.
+void ReadMmapPadding(std::istream &is);
+
+}  // namespace kaldi
+
+#endif  // KALDI_UTIL_KALDI_MMAP_H_
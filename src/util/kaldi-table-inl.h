@@ -24,8 +24,14 @@
 #define KALDI_UTIL_KALDI_TABLE_INL_H_
 
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <sstream>
 #include <string>
 #include <thread>
+#include <type_traits>
 #include <utility>
 #include <vector>
 #include <errno.h>
@@ -34,6 +40,7 @@
 #include "util/text-utils.h"
 #include "util/stl-utils.h"  // for StringHasher.
 #include "util/kaldi-semaphore.h"
+#include "util/kaldi-thread.h"
 
 
 namespace kaldi {
@@ -75,12 +82,50 @@ template<class Holder> class SequentialTableReaderImplBase {
   // this->holder_ with those of 'other_holder'.  It's needed as part of how
   // we implement SequentialTableReaderBackgroundImpl.
   virtual void SwapHolder(Holder *other_holder) = 0;
+  // If the current object has not been read yet and can be read on its own
+  // (i.e. this is a script file, not in permissive mode), GetScriptEntry()
+  // outputs the rxfilename and range (or "") of its scp line and returns true;
+  // the caller may then read it itself and call Next() without having called
+  // Value().  Otherwise it returns false.  This is how
+  // SequentialTableReaderBackgroundImpl reads objects in parallel.
+  virtual bool GetScriptEntry(std::string *rxfilename, std::string *range) {
+    return false;
+  }
   SequentialTableReaderImplBase() { }
   virtual ~SequentialTableReaderImplBase() { }  // throws.
  private:
   KALDI_DISALLOW_COPY_AND_ASSIGN(SequentialTableReaderImplBase);
 };
 
+// Reads the object in 'rxfilename', which is the data part of a line of a
+// script file (e.g. foo.ark:1234), into 'holder', using 'input' (which is
+// reused so that reading from offsets in the same file can use fseek()).
+// If 'mmap' is true the file is read through a memory mapping (see
+// Input::OpenMapped()).  Returns true on success; on failure prints a warning
+// and returns false.
+template<class Holder>
+bool ReadScriptObject(const std::string &rxfilename, bool mmap,
+                      Input *input, Holder *holder) {
+  bool ans;
+  // note, NULL means it doesn't read the binary-mode header
+  if (Holder::IsReadInBinary()) {
+    ans = (mmap ? input->OpenMapped(rxfilename, NULL) :
+           input->Open(rxfilename, NULL));
+  } else {
+    ans = input->OpenTextMode(rxfilename);
+  }
+  if (!ans) {
+    KALDI_WARN << "Failed to open file " << PrintableRxfilename(rxfilename);
+    return false;
+  }
+  if (!holder->Read(input->Stream())) {  // holder will not contain data.
+    KALDI_WARN << "Failed to load object from "
+               << PrintableRxfilename(rxfilename);
+    return false;
+  }
+  return true;
+}
+
 // This is the implementation for SequentialTableReader
 // when it's actually a script file.
 template<class Holder>  class SequentialTableReaderScriptImpl:
@@ -210,6 +255,14 @@ template<class Holder>  class SequentialTableReaderScriptImpl:
     // function needs to be lightweight for the 'bg' feature to work well.
   }
 
+  virtual bool GetScriptEntry(std::string *rxfilename, std::string *range) {
+    if (opts_.permissive || state_ != kHaveScpLine)
+      return false;
+    *rxfilename = data_rxfilename_;
+    *range = range_;
+    return true;
+  }
+
   // Next goes to the next object.
   // It can leave the object in most of the statuses, but
   // the only circumstances under which it will return are:
@@ -299,26 +352,11 @@ template<class Holder>  class SequentialTableReaderScriptImpl:
       KALDI_ERR << "Invalid state (code error)";
 
     if (state_ == kHaveScpLine) {  // need to load the object into holder_.
-      bool ans;
-      // note, NULL means it doesn't read the binary-mode header
-      if (Holder::IsReadInBinary()) {
-        ans = data_input_.Open(data_rxfilename_, NULL);
-      } else {
-        ans = data_input_.OpenTextMode(data_rxfilename_);
-      }
-      if (!ans) {
-        KALDI_WARN << "Failed to open file "
-                   << PrintableRxfilename(data_rxfilename_);
+      KALDI_TRACE_SCOPE("SequentialTableReader: read object");
+      if (!ReadScriptObject(data_rxfilename_, opts_.mmap, &data_input_,
+                            &holder_))
         return false;
-      } else {
-        if (holder_.Read(data_input_.Stream())) {
-          state_ = kHaveObject;
-        } else {  // holder_ will not contain data.
-          KALDI_WARN << "Failed to load object from "
-                     << PrintableRxfilename(data_rxfilename_);
-          return false;
-        }
-      }
+      state_ = kHaveObject;
     }
     // OK, at this point the state must be either
     // kHaveObject or kHaveRange.
@@ -529,6 +567,7 @@ template<class Holder>  class SequentialTableReaderArchiveImpl:
   }
 
   virtual void Next() {
+    KALDI_TRACE_SCOPE("SequentialTableReader: read object");
     switch (state_) {
       case kHaveObject:
         holder_.Clear();
@@ -696,8 +735,12 @@ template<class Holder>  class SequentialTableReaderArchiveImpl:
   } state_;
 };
 
-// this is for when someone adds the 'th' modifier; it wraps around the basic
+// this is for when someone adds the 'bg' modifier; it wraps around the basic
 // implementation and allows it to do the reading in a background thread.
+// With "bg=N" the background thread reads up to N objects ahead, into a ring of
+// N slots that the foreground thread takes them from in order.  With
+// "threads=M", the objects in script files are loaded by a ThreadPool of M
+// threads, in parallel, and the background thread only reads the scp lines.
 template<class Holder>
 class SequentialTableReaderBackgroundImpl:
       public SequentialTableReaderImplBase<Holder> {
@@ -705,8 +748,19 @@ class SequentialTableReaderBackgroundImpl:
   typedef typename Holder::T T;
 
   SequentialTableReaderBackgroundImpl(
-      SequentialTableReaderImplBase<Holder> *base_reader):
-      base_reader_(base_reader) {}
+      SequentialTableReaderImplBase<Holder> *base_reader,
+      const RspecifierOptions &opts):
+      base_reader_(base_reader), mmap_(opts.mmap), head_(0), stop_(false),
+      finished_(false) {
+    int32 num_threads = std::max<int32>(opts.background_threads, 1),
+        depth = opts.background_depth;
+    if (depth <= 0)
+      depth = (num_threads > 1 ? 2 * num_threads : 1);
+    for (int32 i = 0; i < depth; i++)
+      slots_.push_back(std::unique_ptr<Slot>(new Slot()));
+    if (num_threads > 1)
+      pool_.reset(new ThreadPool(num_threads));
+  }
 
   // This function ignores the rxfilename argument.
   // We use the same function signature as the regular Open(),
@@ -714,13 +768,11 @@ class SequentialTableReaderBackgroundImpl:
   virtual bool Open(const std::string &rxfilename) {
     KALDI_ASSERT(base_reader_ != NULL &&
                  base_reader_->IsOpen());  // or code error.
-    {
-      thread_ = std::thread(SequentialTableReaderBackgroundImpl<Holder>::run,
-                            this);
-    }
-
-    if (!base_reader_->Done())
-      Next();
+    for (size_t i = 0; i < slots_.size(); i++)
+      free_sem_.Signal();
+    thread_ = std::thread(SequentialTableReaderBackgroundImpl<Holder>::run,
+                          this);
+    Next();
     return true;
   }
 
@@ -731,38 +783,52 @@ class SequentialTableReaderBackgroundImpl:
   }
 
   void RunInBackground() {
-    try {
-      // This function is called in the background thread.  The whole point of
-      // the background thread is that we don't want to do the actual reading
-      // (inside Next()) in the foreground.
-      while (base_reader_ != NULL && !base_reader_->Done()) {
-        consumer_sem_.Signal();
-        // Here is where the consumer process (parent thread) gets to do its
-        // stuff.  Principally it calls SwapHolder()-- a shallow swap that is
-        // cheap.
-        producer_sem_.Wait();
-        // we check that base_reader_ is not NULL in case Close() was
-        // called in the main thread.
-        if (base_reader_ != NULL)
-          base_reader_->Next();   //  here is where the work happens.
-      }
-      // this signal will be waited on in the Next() function of the foreground
-      // thread if it is still running, or Close() otherwise.
-      consumer_sem_.Signal();
-      // this signal may be waited on in Close().
-      consumer_sem_.Signal();
-    } catch (...) {
-      // There is nothing we called above that could potentially throw due to
-      // user data.  So we treat reaching this point as a code-error condition.
-      // Closing base_reader_ will trigger an exception in Next() in the main
-      // thread when it checks that base_reader_->IsOpen().
-      if (base_reader_->IsOpen()) {
-        base_reader_->Close();
-        delete base_reader_;
-        base_reader_ = NULL;
+    // This function is called in the background thread.  The whole point of
+    // the background thread is that we don't want to do the actual reading
+    // (inside Next() and SwapHolder()) in the foreground.  Only this thread
+    // calls base_reader_ until Close() has joined it.
+    size_t index = 0;
+    while (true) {
+      free_sem_.Wait();
+      if (stop_) return;  // Close() was called.
+      Slot *slot = slots_[index].get();
+      index = (index + 1) % slots_.size();
+      std::string rxfilename, range;
+      try {
+        if (base_reader_->Done()) {
+          slot->status = kEnd;
+          slot->ready.Signal();
+          return;
+        }
+        slot->key = base_reader_->Key();
+        // this frees the object that the foreground thread swapped out of
+        // holder_ into the slot, if any.
+        slot->holder.Clear();
+        if (pool_ != nullptr &&
+            base_reader_->GetScriptEntry(&rxfilename, &range)) {
+          bool mmap = mmap_;
+          pool_->Submit([slot, rxfilename, range, mmap]() {
+              LoadSlot(rxfilename, range, mmap, slot);
+            });
+        } else {
+          // SwapHolder() throws if the object could not be read.
+          try {
+            base_reader_->SwapHolder(&slot->holder);
+            slot->status = kHaveObject;
+          } catch (...) {
+            slot->status = kFailed;
+          }
+          slot->ready.Signal();
+        }
+        base_reader_->Next();
+      } catch (...) {
+        // There is nothing we called above that could potentially throw due to
+        // user data, except SwapHolder().  So we treat reaching this point as a
+        // code-error condition, which Next() in the main thread reports.
+        slot->status = kError;
+        slot->ready.Signal();
+        return;
       }
-      consumer_sem_.Signal();
-      return;
     }
   }
   static void run(SequentialTableReaderBackgroundImpl<Holder> *object) {
@@ -795,28 +861,48 @@ class SequentialTableReaderBackgroundImpl:
     holder_.Clear();
   }
   virtual void Next() {
-    consumer_sem_.Wait();
-    if (base_reader_ == NULL || !base_reader_->IsOpen())
-      KALDI_ERR << "Error detected (likely code error) in background "
-                << "reader (',bg' option)";
-    if (base_reader_->Done()) {
-      // there is nothing else to read.
-      key_ = "";
-    } else {
-      key_ = base_reader_->Key();
-      base_reader_->SwapHolder(&holder_);
+    if (base_reader_ == NULL || finished_)
+      KALDI_ERR << "Next() called at the wrong time (code error) in "
+                << "background reader (',bg' option)";
+    Slot *slot = slots_[head_].get();
+    head_ = (head_ + 1) % slots_.size();
+    slot->ready.Wait();
+    switch (slot->status) {
+      case kHaveObject:
+        key_ = slot->key;
+        holder_.Swap(&slot->holder);
+        break;
+      case kEnd:
+        // there is nothing else to read.
+        key_ = "";
+        finished_ = true;
+        break;
+      case kFailed:
+        finished_ = true;
+        KALDI_ERR << "Failed to read the object for key " << slot->key
+                  << " (to suppress this error, add the permissive "
+                  << "(p, ) option to the rspecifier.";
+      default:
+        finished_ = true;
+        KALDI_ERR << "Error detected (likely code error) in background "
+                  << "reader (',bg' option)";
     }
     // this Signal() tells the producer thread, in the background,
-    // that it's now safe to read the next value.
-    producer_sem_.Signal();
+    // that it's now safe to read another value into the slot.
+    free_sem_.Signal();
   }
 
   // note: we can be sure that Close() won't be called twice, as the TableReader
   // object will delete this object after calling Close.
   virtual bool Close() {
     KALDI_ASSERT(base_reader_ != NULL && thread_.joinable());
-    // wait until the producer thread is idle.
-    consumer_sem_.Wait();
+    // setting stop_ will cause the loop in the producer thread to exit the
+    // next time it waits for a free slot.
+    stop_ = true;
+    free_sem_.Signal();
+    thread_.join();
+    // the destructor of the pool waits for the objects still being loaded.
+    pool_.reset();
     bool ans = true;
     try {
       ans = base_reader_->Close();
@@ -824,12 +910,7 @@ class SequentialTableReaderBackgroundImpl:
       ans = false;
     }
     delete base_reader_;
-    // setting base_reader_ to NULL will cause the loop in the producer thread
-    // to exit.
     base_reader_ = NULL;
-    producer_sem_.Signal();
-
-    thread_.join();
     return ans;
   }
   ~SequentialTableReaderBackgroundImpl() {
@@ -841,16 +922,65 @@ class SequentialTableReaderBackgroundImpl:
     }
   }
  private:
+  enum SlotStatus {
+    kHaveObject,  // The slot contains the object for 'key'.
+    kFailed,      // The object for 'key' could not be read.
+    kEnd,         // There are no more objects.
+    kError        // Error in the background thread (code error).
+  };
+  struct Slot {
+    std::string key;
+    Holder holder;
+    SlotStatus status;
+    // Signaled when 'status' (and the object) have been set.
+    Semaphore ready;
+    Slot(): status(kError) { }
+  };
+
+  // Loads the object of a script-file entry into 'slot', in one of the threads
+  // of pool_.
+  static void LoadSlot(const std::string &rxfilename, const std::string &range,
+                       bool mmap, Slot *slot) {
+    try {
+      Input input;
+      if (!ReadScriptObject(rxfilename, mmap, &input, &slot->holder)) {
+        slot->status = kFailed;
+      } else if (range.empty()) {
+        slot->status = kHaveObject;
+      } else {
+        Holder range_holder;
+        if (range_holder.ExtractRange(slot->holder, range)) {
+          range_holder.Swap(&slot->holder);
+          slot->status = kHaveObject;
+        } else {
+          KALDI_WARN << "Failed to load object from "
+                     << PrintableRxfilename(rxfilename) << "[" << range << "]";
+          slot->status = kFailed;
+        }
+      }
+    } catch (...) {
+      slot->status = kFailed;
+    }
+    slot->ready.Signal();
+  }
+
   std::string key_;
   Holder holder_;
-  // I couldn't figure out what to call these semaphores.  consumer_sem_ is the
-  // one that the consumer (main thread) waits on; producer_sem_ is the one
-  // that the producer (background thread) waits on.
-  Semaphore consumer_sem_;
-  Semaphore producer_sem_;
+  // The objects that have been read ahead; the foreground thread takes them
+  // from slots_[head_], and the background thread fills them in the same
+  // order.
+  std::vector<std::unique_ptr<Slot> > slots_;
+  // The number of slots the background thread may fill; the foreground thread
+  // signals it whenever it has taken an object from a slot.
+  Semaphore free_sem_;
   std::thread thread_;
+  // If non-NULL, the script-file entries are loaded by this pool ("threads=M").
+  std::unique_ptr<ThreadPool> pool_;
   SequentialTableReaderImplBase<Holder> *base_reader_;
-
+  bool mmap_;
+  size_t head_;
+  bool stop_;  // Set by Close() to make the background thread exit.
+  bool finished_;  // True once Next() has reached the end or an error.
 };
 
 template<class Holder>
@@ -887,7 +1017,7 @@ bool SequentialTableReader<Holder>::Open(const std::string &rspecifier) {
   }
   if (opts.background) {
     impl_ = new SequentialTableReaderBackgroundImpl<Holder>(
-        impl_);
+        impl_, opts);
     if (!impl_->Open("")) {
       // the rxfilename is ignored in that Open() call.
       // It should only return false on code error.
@@ -981,6 +1111,9 @@ template<class Holder> class TableWriterImplBase {
 
   virtual bool IsOpen() const = 0;
 
+  // Returns the number of objects that are waiting to be written.
+  virtual int32 NumPending() const { return 0; }
+
   // May throw on write error if Close was not called.
   virtual ~TableWriterImplBase() { }
 
@@ -1039,6 +1172,7 @@ class TableWriterArchiveImpl: public TableWriterImplBase<Holder> {
   // Write returns true on success, false on failure, but
   // some errors may not be detected till we call Close().
   virtual bool Write(const std::string &key, const T &value) {
+    KALDI_TRACE_SCOPE("TableWriter: write object");
     switch (state_) {
       case kOpen: break;
       case kWriteError:
@@ -1463,6 +1597,247 @@ class TableWriterBothImpl: public TableWriterImplBase<Holder> {
 };
 
 
+// The "holder" that TableWriterBackgroundImpl writes with: its objects are the
+// serialized forms of objects of another type (including the binary-mode
+// header, if any), which are written as they are.
+class SerializedObjectHolder {
+ public:
+  typedef std::string T;
+  static bool Write(std::ostream &os, bool binary, const T &t) {
+    os.write(t.data(), t.size());
+    return os.good();
+  }
+};
+
+// Creates the TableWriter implementation for wspecifiers of type 'type',
+// without opening it.
+template<class Holder>
+TableWriterImplBase<Holder> *NewTableWriterImpl(WspecifierType type) {
+  switch (type) {
+    case kBothWspecifier:
+      return new TableWriterBothImpl<Holder>();
+    case kArchiveWspecifier:
+      return new TableWriterArchiveImpl<Holder>();
+    case kScriptWspecifier:
+      return new TableWriterScriptImpl<Holder>();
+    case kNoWspecifier: default:
+      return NULL;
+  }
+}
+
+// TableWriterBackgroundImpl is the implementation of TableWriter for the "bg"
+// option.  Write() puts the object in a queue (a ring of slots) and hands it
+// to a ThreadPool that serializes it into memory; a background thread takes
+// the serialized objects from the queue in order and writes them with an
+// ordinary implementation, whose objects are the serialized forms (see
+// SerializedObjectHolder).
+template<class Holder>
+class TableWriterBackgroundImpl: public TableWriterImplBase<Holder> {
+ public:
+  typedef typename Holder::T T;
+
+  explicit TableWriterBackgroundImpl(const WspecifierOptions &opts):
+      base_writer_(NULL), binary_(opts.binary), flush_(opts.flush), tail_(0),
+      num_pending_(0), max_pending_(0), failed_(false) {
+    int32 num_threads = std::max<int32>(opts.background_threads, 1),
+        depth = opts.background_depth;
+    if (depth <= 0)
+      depth = 4 * num_threads;
+    for (int32 i = 0; i < depth; i++)
+      slots_.push_back(std::unique_ptr<Slot>(new Slot()));
+    pool_.reset(new ThreadPool(num_threads));
+  }
+
+  virtual bool Open(const std::string &wspecifier) {
+    KALDI_ASSERT(base_writer_ == NULL);
+    wspecifier_ = wspecifier;
+    // The base writer must not flush after each object; we flush it when the
+    // queue becomes empty instead, so we add the "nf" option.
+    std::string base_wspecifier(wspecifier);
+    base_wspecifier.insert(wspecifier.find(':'), ",nf");
+    base_writer_ = NewTableWriterImpl<SerializedObjectHolder>(
+        ClassifyWspecifier(wspecifier, NULL, NULL, NULL));
+    if (base_writer_ == NULL || !base_writer_->Open(base_wspecifier)) {
+      delete base_writer_;
+      base_writer_ = NULL;
+      return false;
+    }
+    thread_ = std::thread(TableWriterBackgroundImpl<Holder>::run, this);
+    return true;
+  }
+
+  virtual bool IsOpen() const { return base_writer_ != NULL; }
+
+  virtual bool Write(const std::string &key, const T &value) {
+    if (base_writer_ == NULL)
+      KALDI_ERR << "Write called on invalid stream";
+    if (!IsToken(key))  // e.g. empty string or has spaces...
+      KALDI_ERR << "Using invalid key " << key;
+    Slot *slot = NextSlot();
+    slot->key = key;
+    Serialize(value, slot,
+              std::integral_constant<bool,
+                                     std::is_copy_constructible<T>::value>());
+    if (failed_) {
+      KALDI_WARN << "Write failure detected in background writer: "
+                 << "wspecifier is " << wspecifier_;
+      return false;
+    }
+    return true;
+  }
+
+  virtual void Flush() {
+    if (base_writer_ == NULL) {
+      KALDI_WARN << "Flush called on not-open writer.";
+      return;
+    }
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      while (num_pending_ > 0)
+        cond_.wait(lock);
+    }
+    // The background thread is now waiting for the next object, so it does not
+    // use base_writer_.
+    base_writer_->Flush();
+  }
+
+  virtual int32 NumPending() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return num_pending_;
+  }
+
+  // note: we can be sure that Close() won't be called twice, as the
+  // TableWriter object will delete this object after calling Close.
+  virtual bool Close() {
+    KALDI_ASSERT(base_writer_ != NULL && thread_.joinable());
+    Slot *slot = NextSlot();
+    slot->status = kEnd;
+    slot->ready.Signal();
+    thread_.join();
+    pool_.reset();
+    bool ans = !failed_;
+    try {
+      if (!base_writer_->Close())
+        ans = false;
+    } catch (...) {
+      ans = false;
+    }
+    delete base_writer_;
+    base_writer_ = NULL;
+    KALDI_VLOG(2) << "Background writer for " << wspecifier_ << ": at most "
+                  << max_pending_ << " of " << slots_.size()
+                  << " objects were queued.";
+    if (!ans)
+      KALDI_WARN << "Write failed or stream close failed: " << wspecifier_;
+    return ans;
+  }
+
+  ~TableWriterBackgroundImpl() {
+    if (base_writer_ != NULL && !Close())
+      KALDI_ERR << "Error detected closing background writer "
+                << "(relates to ',bg' modifier)";
+  }
+
+ private:
+  enum SlotStatus {
+    kSerialized,  // 'bytes' is the serialized object for 'key'.
+    kFailed,      // The object could not be serialized.
+    kEnd          // Close() was called.
+  };
+  struct Slot {
+    std::string key;
+    std::string bytes;
+    SlotStatus status;
+    // Signaled when 'status' (and 'bytes') have been set.
+    Semaphore ready;
+    Slot(): status(kFailed) { }
+  };
+
+  // Waits until there is room in the queue and returns the next slot.
+  Slot *NextSlot() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (num_pending_ >= slots_.size())
+      cond_.wait(lock);
+    num_pending_++;
+    max_pending_ = std::max(max_pending_, num_pending_);
+    Slot *slot = slots_[tail_].get();
+    tail_ = (tail_ + 1) % slots_.size();
+    return slot;
+  }
+
+  static void SerializeSlot(bool binary, const T &value, Slot *slot) {
+    try {
+      std::ostringstream os;
+      slot->status = (Holder::Write(os, binary, value) ? kSerialized :
+                      kFailed);
+      slot->bytes = os.str();
+    } catch (...) {
+      slot->status = kFailed;
+    }
+    slot->ready.Signal();
+  }
+
+  // Serializes a copy of the object in pool_.
+  void Serialize(const T &value, Slot *slot, std::true_type is_copyable) {
+    std::shared_ptr<const T> copy(new T(value));
+    bool binary = binary_;
+    pool_->Submit([binary, copy, slot]() {
+        SerializeSlot(binary, *copy, slot);
+      });
+  }
+  // Objects that cannot be copied are serialized here, in Write().
+  void Serialize(const T &value, Slot *slot, std::false_type is_copyable) {
+    SerializeSlot(binary_, value, slot);
+  }
+
+  void RunInBackground() {
+    size_t index = 0;
+    while (true) {
+      Slot *slot = slots_[index].get();
+      index = (index + 1) % slots_.size();
+      slot->ready.Wait();
+      if (slot->status == kEnd)
+        return;
+      if (slot->status != kSerialized) {
+        KALDI_WARN << "Failed to serialize the object for key " << slot->key;
+        failed_ = true;
+      } else if (!failed_) {
+        try {
+          if (!base_writer_->Write(slot->key, slot->bytes))
+            failed_ = true;
+        } catch (...) {
+          failed_ = true;
+        }
+      }
+      slot->bytes.clear();
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (flush_ && num_pending_ == 1)  // The queue is becoming empty.
+        base_writer_->Flush();
+      num_pending_--;
+      cond_.notify_all();
+    }
+  }
+  static void run(TableWriterBackgroundImpl<Holder> *object) {
+    object->RunInBackground();
+  }
+
+  TableWriterImplBase<SerializedObjectHolder> *base_writer_;
+  std::string wspecifier_;
+  bool binary_;
+  bool flush_;
+  // The objects waiting to be written; Write() puts them in slots_[tail_] and
+  // the background thread takes them in the same order.
+  std::vector<std::unique_ptr<Slot> > slots_;
+  size_t tail_;
+  size_t num_pending_;  // The number of slots in use (protected by mutex_).
+  size_t max_pending_;
+  mutable std::mutex mutex_;
+  std::condition_variable cond_;  // Notified when num_pending_ decreases.
+  std::unique_ptr<ThreadPool> pool_;
+  std::thread thread_;
+  std::atomic<bool> failed_;  // Set if a write or serialization failed.
+};
+
 template<class Holder>
 TableWriter<Holder>::TableWriter(const std::string &wspecifier): impl_(NULL) {
   if (wspecifier != "" && !Open(wspecifier))
@@ -1483,21 +1858,16 @@ bool TableWriter<Holder>::Open(const std::string &wspecifier) {
       KALDI_ERR << "Failed to close previously open writer.";
   }
   KALDI_ASSERT(impl_ == NULL);
-  WspecifierType wtype = ClassifyWspecifier(wspecifier, NULL, NULL, NULL);
-  switch (wtype) {
-    case kBothWspecifier:
-      impl_ = new TableWriterBothImpl<Holder>();
-      break;
-    case kArchiveWspecifier:
-      impl_ = new TableWriterArchiveImpl<Holder>();
-      break;
-    case kScriptWspecifier:
-      impl_ = new TableWriterScriptImpl<Holder>();
-      break;
-    case kNoWspecifier: default:
-      KALDI_WARN << "ClassifyWspecifier: invalid wspecifier " << wspecifier;
-      return false;
+  WspecifierOptions opts;
+  WspecifierType wtype = ClassifyWspecifier(wspecifier, NULL, NULL, &opts);
+  if (wtype == kNoWspecifier) {
+    KALDI_WARN << "ClassifyWspecifier: invalid wspecifier " << wspecifier;
+    return false;
   }
+  if (opts.background)
+    impl_ = new TableWriterBackgroundImpl<Holder>(opts);
+  else
+    impl_ = NewTableWriterImpl<Holder>(wtype);
   if (impl_->Open(wspecifier)) {
     return true;
   } else {  // The class will have printed a more specific warning.
@@ -1523,6 +1893,12 @@ void TableWriter<Holder>::Flush() {
   impl_->Flush();
 }
 
+template<class Holder>
+int32 TableWriter<Holder>::NumPending() const {
+  CheckImpl();
+  return impl_->NumPending();
+}
+
 template<class Holder>
 bool TableWriter<Holder>::Close() {
   CheckImpl();
@@ -1765,7 +2141,8 @@ class RandomAccessTableReaderScriptImpl:
         range_ = range;
         if (state_ == kNotHaveObject) {
           // we need to read the object.
-          if (!input_.Open(data_rxfilename)) {
+          if (!(opts_.mmap ? input_.OpenMapped(data_rxfilename) :
+                input_.Open(data_rxfilename))) {
             KALDI_WARN << "Error opening stream "
                        << PrintableRxfilename(data_rxfilename);
             return false;
@@ -2344,6 +2721,229 @@ class RandomAccessTableReaderSortedArchiveImpl:
 
 
 
+// RandomAccessTableReaderIndexedArchiveImpl is for random-access reading of
+// archives when the user specified the idx option.  It looks the keys up in the
+// index of the archive, which it builds (by reading the whole archive) and
+// writes if it does not exist yet, and reads each object from its offset in the
+// archive when it is first asked for.  The objects are kept until Close(),
+// except that with the once (o) or called-sorted (cs) options each one is
+// deleted when another one is asked for.  Without those options, HasKey() and
+// Value() may be called from several threads at once; the objects are then
+// read in parallel.
+template<class Holder>
+class RandomAccessTableReaderIndexedArchiveImpl:
+      public RandomAccessTableReaderImplBase<Holder> {
+ public:
+  typedef typename Holder::T T;
+
+  RandomAccessTableReaderIndexedArchiveImpl():
+      is_open_(false), pending_delete_(static_cast<size_t>(-1)) { }
+
+  virtual bool Open(const std::string &rspecifier) {
+    if (is_open_) {
+      if (!this->Close())  // call Close() yourself to suppress this exception.
+        KALDI_ERR << "Error closing previous input.";
+    }
+    rspecifier_ = rspecifier;
+    RspecifierType rs = ClassifyRspecifier(rspecifier, &archive_rxfilename_,
+                                           &opts_);
+    KALDI_ASSERT(rs == kArchiveRspecifier && opts_.index);
+    if (ClassifyRxfilename(archive_rxfilename_) != kFileInput) {
+      KALDI_WARN << "The idx option requires the archive to be a file: "
+                 << "rspecifier is " << rspecifier_;
+      return false;
+    }
+    if (!ReadArchiveIndex(archive_rxfilename_, &index_)) {
+      if (!BuildIndex()) {
+        if (!opts_.permissive)
+          return false;
+        KALDI_WARN << "Using the objects before the error, because you "
+                   << "specified permissive mode.";
+      } else if (!WriteArchiveIndex(archive_rxfilename_, index_)) {
+        KALDI_WARN << "Could not write "
+                   << ArchiveIndexFilename(archive_rxfilename_)
+                   << "; the index will be built again next time.";
+      }
+    }
+    objects_.resize(index_.size(), NULL);
+    is_open_ = true;
+    return true;
+  }
+
+  virtual bool HasKey(const std::string &key) {
+    size_t pos;
+    if (!LookupKey(key, &pos))
+      return false;
+    HandlePendingDelete(pos);
+    // In permissive mode, we have to check that the object can be read.
+    return !opts_.permissive || GetObject(pos) != NULL;
+  }
+
+  virtual const T &Value(const std::string &key) {
+    size_t pos;
+    if (!LookupKey(key, &pos))
+      KALDI_ERR << "Value() called but no such key " << key
+                << " in archive " << PrintableRxfilename(archive_rxfilename_);
+    HandlePendingDelete(pos);
+    Holder *holder = GetObject(pos);
+    if (holder == NULL)
+      KALDI_ERR << "Could not read object for key " << key << " from archive "
+                << PrintableRxfilename(archive_rxfilename_);
+    if (opts_.once || opts_.called_sorted)
+      pending_delete_ = pos;
+    return holder->Value();
+  }
+
+  virtual bool Close() {
+    if (!is_open_)
+      KALDI_ERR << "Close() called on RandomAccessTableReader that was not"
+                   " open.";
+    for (size_t i = 0; i < objects_.size(); i++)
+      delete objects_[i];
+    objects_.clear();
+    index_.clear();
+    pending_delete_ = static_cast<size_t>(-1);
+    if (input_.IsOpen())
+      input_.Close();
+    is_open_ = false;
+    // Errors in the archive are detected when the index is built or when the
+    // objects are read, so there is nothing to report here.
+    return true;
+  }
+
+  virtual ~RandomAccessTableReaderIndexedArchiveImpl() {
+    if (is_open_)
+      Close();
+  }
+
+ private:
+  // Reads the whole archive to find the offsets of the objects, and puts them
+  // in index_, sorted.  On error, prints a warning and returns false; index_
+  // then has the objects before the error.
+  bool BuildIndex() {
+    index_.clear();
+    Input input;
+    bool ans = (Holder::IsReadInBinary() ?
+                input.Open(archive_rxfilename_, NULL) :
+                input.OpenTextMode(archive_rxfilename_));
+    if (!ans) {
+      KALDI_WARN << "Failed to open stream "
+                 << PrintableRxfilename(archive_rxfilename_);
+      return false;
+    }
+    std::istream &is = input.Stream();
+    std::string key;
+    ans = true;
+    while (true) {
+      is >> key;
+      if (is.eof())
+        break;
+      int c;
+      if (is.fail() || ((c = is.peek()) != ' ' && c != '\t' && c != '\n')) {
+        KALDI_WARN << "Invalid archive file format, reading archive "
+                   << PrintableRxfilename(archive_rxfilename_);
+        ans = false;
+        break;
+      }
+      if (c != '\n') is.get();  // Consume the space or tab.
+      int64 offset = is.tellg();
+      Holder holder;
+      if (offset < 0 || !holder.Read(is)) {
+        KALDI_WARN << "Object read failed, reading archive "
+                   << PrintableRxfilename(archive_rxfilename_);
+        ans = false;
+        break;
+      }
+      index_.push_back(std::make_pair(key, offset));
+    }
+    std::sort(index_.begin(), index_.end());
+    for (size_t i = 0; i + 1 < index_.size(); i++) {
+      if (index_[i].first == index_[i + 1].first) {
+        KALDI_WARN << "Duplicate key " << index_[i].first << " in archive "
+                   << PrintableRxfilename(archive_rxfilename_);
+        index_.clear();
+        return false;
+      }
+    }
+    return ans;
+  }
+
+  bool LookupKey(const std::string &key, size_t *pos) const {
+    std::pair<std::string, int64> pr(key, -1);  // -1 is less than any offset,
+    // so lower_bound points to the element that has the same key.
+    typename std::vector<std::pair<std::string, int64> >::const_iterator
+        iter = std::lower_bound(index_.begin(), index_.end(), pr);
+    if (iter == index_.end() || iter->first != key)
+      return false;
+    *pos = iter - index_.begin();
+    return true;
+  }
+
+  // With the o and cs options, deletes the object that was asked for last,
+  // unless it is the one at 'pos'.
+  void HandlePendingDelete(size_t pos) {
+    const size_t npos = static_cast<size_t>(-1);
+    if (pending_delete_ != npos) {  // Never true if several threads are used.
+      if (pending_delete_ != pos) {
+        delete objects_[pending_delete_];
+        objects_[pending_delete_] = NULL;
+      }
+      pending_delete_ = npos;
+    }
+  }
+
+  // Returns the object at position 'pos' in the index, reading it if needed,
+  // or NULL (after printing a warning) if it could not be read.
+  Holder *GetObject(size_t pos) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (objects_[pos] != NULL)
+        return objects_[pos];
+    }
+    std::ostringstream rxfilename;
+    rxfilename << archive_rxfilename_ << ':' << index_[pos].second;
+    Holder *holder = new Holder;
+    bool ans;
+    {
+      // Reuse input_ unless another thread is using it, so that reading
+      // objects one after the other does not reopen the archive each time.
+      std::unique_lock<std::mutex> input_lock(input_mutex_, std::try_to_lock);
+      if (input_lock.owns_lock()) {
+        ans = ReadScriptObject(rxfilename.str(), opts_.mmap, &input_, holder);
+      } else {
+        Input input;
+        ans = ReadScriptObject(rxfilename.str(), opts_.mmap, &input, holder);
+      }
+    }
+    if (!ans) {
+      delete holder;
+      return NULL;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (objects_[pos] != NULL) {  // Another thread read it at the same time.
+      delete holder;
+      return objects_[pos];
+    }
+    objects_[pos] = holder;
+    return holder;
+  }
+
+  bool is_open_;
+  std::string rspecifier_;
+  std::string archive_rxfilename_;
+  RspecifierOptions opts_;
+  // The keys of the archive, sorted, and the offsets of the objects.
+  std::vector<std::pair<std::string, int64> > index_;
+  // The objects that have been read, indexed like index_ (NULL if not read).
+  std::vector<Holder*> objects_;
+  std::mutex mutex_;  // Protects objects_.
+  Input input_;
+  std::mutex input_mutex_;  // Protects input_.
+  size_t pending_delete_;  // With the o or cs options, the position of the
+                           // object that was asked for last.
+};
+
+
 // RandomAccessTableReaderUnsortedArchiveImpl is for random-access reading of
 // archives when the user does not specify the sorted (s) option (in this case
 // the called-sorted, or "cs" option, is ignored).  This is the least efficient
@@ -2524,7 +3124,9 @@ bool RandomAccessTableReader<Holder>::Open(const std::string &rspecifier) {
       impl_ = new RandomAccessTableReaderScriptImpl<Holder>();
       break;
     case kArchiveRspecifier:
-      if (opts.sorted) {
+      if (opts.index) {
+        impl_ = new RandomAccessTableReaderIndexedArchiveImpl<Holder>();
+      } else if (opts.sorted) {
         if (opts.called_sorted)  // "doubly" sorted case.
           impl_ = new RandomAccessTableReaderDSortedArchiveImpl<Holder>();
         else
@@ -2662,6 +3264,88 @@ const typename Holder::T& RandomAccessTableReaderMapped<Holder>::Value(
 }
 
 
+template<class Holder>
+SharedRandomAccessTableReader<Holder>::SharedRandomAccessTableReader(
+    const std::string &table_rxfilename,
+    const std::string &utt2spk_rxfilename, int32 cache_size):
+    cache_size_(0) {
+  if (!table_rxfilename.empty() &&
+      !Open(table_rxfilename, utt2spk_rxfilename, cache_size))
+    KALDI_ERR << "Error opening SharedRandomAccessTableReader object "
+              << "(rspecifier is: " << table_rxfilename << ")";
+}
+
+template<class Holder>
+bool SharedRandomAccessTableReader<Holder>::Open(
+    const std::string &table_rxfilename,
+    const std::string &utt2spk_rxfilename, int32 cache_size) {
+  if (IsOpen()) Close();
+  KALDI_ASSERT(!table_rxfilename.empty() && cache_size >= 0);
+  cache_size_ = cache_size;
+  utt2spk_rxfilename_ = utt2spk_rxfilename;
+  if (!reader_.Open(table_rxfilename)) return false;
+  if (!utt2spk_rxfilename.empty()) {
+    if (!token_reader_.Open(utt2spk_rxfilename)) {
+      reader_.Close();
+      return false;
+    }
+  }
+  return true;
+}
+
+template<class Holder>
+bool SharedRandomAccessTableReader<Holder>::Close() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  cache_.clear();
+  cache_map_.clear();
+  if (token_reader_.IsOpen()) token_reader_.Close();
+  return reader_.Close();
+}
+
+template<class Holder>
+std::string SharedRandomAccessTableReader<Holder>::MapKey(
+    const std::string &key) {
+  if (!token_reader_.IsOpen())
+    return key;
+  if (!token_reader_.HasKey(key))
+    KALDI_ERR << "Attempting to read key " << key << ", which is not present "
+              << "in utt2spk map or similar map being read from "
+              << PrintableRxfilename(utt2spk_rxfilename_);
+  return token_reader_.Value(key);
+}
+
+template<class Holder>
+bool SharedRandomAccessTableReader<Holder>::HasKey(const std::string &key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::string table_key = MapKey(key);
+  return cache_map_.count(table_key) != 0 || reader_.HasKey(table_key);
+}
+
+template<class Holder>
+std::shared_ptr<const typename Holder::T>
+SharedRandomAccessTableReader<Holder>::Value(const std::string &key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::string table_key = MapKey(key);
+  typename unordered_map<std::string, typename CacheList::iterator,
+                         StringHasher>::iterator iter =
+      cache_map_.find(table_key);
+  if (iter != cache_map_.end()) {
+    // Move it to the front of the list.
+    cache_.splice(cache_.begin(), cache_, iter->second);
+    return iter->second->second;
+  }
+  std::shared_ptr<const T> value(new T(reader_.Value(table_key)));
+  if (cache_size_ > 0) {
+    cache_.push_front(std::make_pair(table_key, value));
+    cache_map_[table_key] = cache_.begin();
+    if (cache_.size() > static_cast<size_t>(cache_size_)) {
+      cache_map_.erase(cache_.back().first);
+      cache_.pop_back();
+    }
+  }
+  return value;
+}
+
 
 /// @}
 
@@ -22,6 +22,8 @@
 #include "util/kaldi-table.h"
 #include "util/kaldi-holder.h"
 #include "util/table-types.h"
+#include <thread>
+#include <utime.h>
 
 namespace kaldi {
 
@@ -177,6 +179,31 @@ void UnitTestClassifyWspecifier() {
     KALDI_ASSERT(ans == kBothWspecifier && ark == "" && scp == "" &&
                  opts.binary == true && opts.flush == false);
   }
+
+  {
+    std::string a = "ark,scp,bg=64,threads=4:a,b";
+    std::string ark = "x", scp = "y";
+    WspecifierOptions opts;
+    WspecifierType ans = ClassifyWspecifier(a, &ark, &scp, &opts);
+    KALDI_ASSERT(ans == kBothWspecifier && ark == "a" && scp == "b" &&
+                 opts.background && opts.background_depth == 64 &&
+                 opts.background_threads == 4);
+  }
+
+  {
+    std::string a = "bg,ark:a";
+    WspecifierOptions opts;
+    WspecifierType ans = ClassifyWspecifier(a, NULL, NULL, &opts);
+    KALDI_ASSERT(ans == kArchiveWspecifier && opts.background &&
+                 opts.background_depth == 0 && opts.background_threads == 1);
+  }
+
+  {
+    KALDI_ASSERT(ClassifyWspecifier("bg=0,ark:a", NULL, NULL, NULL) ==
+                 kNoWspecifier);
+    KALDI_ASSERT(ClassifyWspecifier("threads=x,ark:a", NULL, NULL, NULL) ==
+                 kNoWspecifier);
+  }
 }
 
 
@@ -215,6 +242,42 @@ void UnitTestClassifyRspecifier() {
     KALDI_ASSERT(ans == kScriptRspecifier && fname == "foo|");
   }
 
+  {
+    std::string a = "s,mmap,scp:foo.scp";
+    std::string fname = "x";
+    RspecifierOptions opts;
+    RspecifierType ans = ClassifyRspecifier(a, &fname, &opts);
+    KALDI_ASSERT(ans == kScriptRspecifier && fname == "foo.scp" &&
+                 opts.mmap && opts.sorted && !opts.background);
+  }
+
+  {
+    std::string a = "idx,o,ark:foo.ark";
+    std::string fname = "x";
+    RspecifierOptions opts;
+    RspecifierType ans = ClassifyRspecifier(a, &fname, &opts);
+    KALDI_ASSERT(ans == kArchiveRspecifier && fname == "foo.ark" &&
+                 opts.index && opts.once && !opts.mmap);
+  }
+
+  {
+    std::string a = "bg=4,threads=2,scp:foo.scp";
+    std::string fname = "x";
+    RspecifierOptions opts;
+    RspecifierType ans = ClassifyRspecifier(a, &fname, &opts);
+    KALDI_ASSERT(ans == kScriptRspecifier && fname == "foo.scp" &&
+                 opts.background && opts.background_depth == 4 &&
+                 opts.background_threads == 2);
+  }
+
+  {
+    std::string a = "ark,bg=0:foo";  // invalid, as the depth must be > 0.
+    std::string fname = "x";
+    RspecifierOptions opts;
+    RspecifierType ans = ClassifyRspecifier(a, &fname, &opts);
+    KALDI_ASSERT(ans == kNoRspecifier && fname == "");
+  }
+
   {
     std::string a = "scp,scp,b:foo|";  // invalid as repeated.
     std::string fname = "x";
@@ -456,9 +519,13 @@ void UnitTestTableSequentialDoubleBoth(bool binary, bool read_scp) {
   ans = bw.Close();
   KALDI_ASSERT(ans);
 
-  SequentialDoubleReader sbr(RandInt(0, 1) == 0 ?
-                             (read_scp ? "scp:tmpf.scp" : "ark:tmpf") :
-                             (read_scp ? "scp,bg:tmpf.scp" : "ark,bg:tmpf"));
+  std::string rspecifier = (read_scp ? "scp:tmpf.scp" : "ark:tmpf");
+  switch (RandInt(0, 3)) {
+    case 1: rspecifier = "bg," + rspecifier; break;
+    case 2: rspecifier = "bg=3," + rspecifier; break;
+    case 3: rspecifier = "bg=3,threads=2," + rspecifier; break;
+  }
+  SequentialDoubleReader sbr(rspecifier);
   std::vector<std::string> k2;
   std::vector<double> v2;
   for (; !sbr.Done(); sbr.Next()) {
@@ -734,7 +801,7 @@ void UnitTestTableSequentialBaseFloatVectorBoth(bool binary, bool read_scp) {
   SequentialBaseFloatVectorReader sbr(
       RandInt(0, 1) == 0 ?
       (read_scp ? "scp:tmpf.scp" : "ark:tmpf") :
-      (read_scp ? "scp,bg:tmpf.scp" : "ark,bg:tmpf"));
+      (read_scp ? "scp,bg=4,threads=3:tmpf.scp" : "ark,bg=2:tmpf"));
   std::vector<std::string> k2;
   std::vector<Vector<BaseFloat>* > v2;
   for (; !sbr.Done(); sbr.Next()) {
@@ -975,6 +1042,171 @@ void UnitTestRangesMatrix(bool binary) {
   unlink("tmpf_ranges.scp");
 }
 
+void UnitTestTableZstd(bool binary) {
+#ifdef HAVE_ZSTD
+  int32 sz = RandInt(1, 200);
+  std::vector<std::string> k;
+  std::vector<Matrix<BaseFloat> > v(sz);
+  for (int32 i = 0; i < sz; i++) {
+    k.push_back("utt" + std::to_string(1000 + i));
+    v[i].Resize(RandInt(1, 100), RandInt(1, 40));
+    v[i].SetRandn();
+  }
+  BaseFloatMatrixWriter writer(binary ? "b,ark,scp:tmpf.zst,tmpf.scp" :
+                               "t,ark,scp:tmpf.zst,tmpf.scp");
+  for (int32 i = 0; i < sz; i++)
+    writer.Write(k[i], v[i]);
+  KALDI_ASSERT(writer.Close());
+
+  float tol = (binary ? 0.0 : 0.01);
+  int32 i = 0;
+  for (SequentialBaseFloatMatrixReader reader(RandInt(0, 1) == 0 ?
+                                              "ark:tmpf.zst" :
+                                              "scp:tmpf.scp");
+       !reader.Done(); reader.Next(), i++) {
+    KALDI_ASSERT(reader.Key() == k[i] && reader.Value().ApproxEqual(v[i], tol));
+  }
+  KALDI_ASSERT(i == sz);
+
+  RandomAccessBaseFloatMatrixReader reader("scp:tmpf.scp");
+  for (int32 n = 0; n < 20; n++) {
+    int32 i = RandInt(0, sz - 1);
+    KALDI_ASSERT(reader.HasKey(k[i]) &&
+                 reader.Value(k[i]).ApproxEqual(v[i], tol));
+  }
+#endif
+}
+
+// Copies an archive through SerializedMatrix, which should give the same
+// bytes as copying it through Matrix<BaseFloat>.
+void UnitTestTableSerializedMatrix(bool binary) {
+  int32 sz = RandInt(1, 10);
+  std::vector<std::string> k;
+  std::vector<Matrix<BaseFloat> > v(sz);
+  {
+    BaseFloatMatrixWriter writer(binary ? "ark,scp:tmpf,tmpf.scp" :
+                                 "ark,t,scp:tmpf,tmpf.scp");
+    for (int32 i = 0; i < sz; i++) {
+      k.push_back("utt" + std::to_string(i));
+      if (RandInt(0, 5) != 0) {
+        v[i].Resize(RandInt(1, 20), RandInt(1, 10));
+        v[i].SetRandn();
+      }
+      writer.Write(k[i], v[i]);
+    }
+  }
+  {
+    SequentialSerializedMatrixReader reader("scp:tmpf.scp");
+    SerializedMatrixWriter writer("ark:tmpf2");
+    SerializedMatrixWriter writer_t("ark,t:tmpf2_t");
+    for (int32 i = 0; !reader.Done(); reader.Next(), i++) {
+      const SerializedMatrix &value = reader.Value();
+      KALDI_ASSERT(value.IsSerialized() == binary);
+      KALDI_ASSERT(value.NumRows() == v[i].NumRows() &&
+                   value.NumCols() == v[i].NumCols());
+      writer.Write(reader.Key(), value);
+      writer_t.Write(reader.Key(), value);
+    }
+  }
+  {
+    SequentialBaseFloatMatrixReader reader("scp:tmpf.scp");
+    BaseFloatMatrixWriter writer("ark:tmpf3");
+    BaseFloatMatrixWriter writer_t("ark,t:tmpf3_t");
+    for (; !reader.Done(); reader.Next()) {
+      writer.Write(reader.Key(), reader.Value());
+      writer_t.Write(reader.Key(), reader.Value());
+    }
+  }
+  const char *pairs[][2] = { { "tmpf2", "tmpf3" }, { "tmpf2_t", "tmpf3_t" } };
+  for (int32 n = 0; n < 2; n++) {
+    std::ifstream a(pairs[n][0], std::ios::binary),
+        b(pairs[n][1], std::ios::binary);
+    std::string a_str((std::istreambuf_iterator<char>(a)),
+                      std::istreambuf_iterator<char>()),
+        b_str((std::istreambuf_iterator<char>(b)),
+              std::istreambuf_iterator<char>());
+    KALDI_ASSERT(a_str == b_str);
+  }
+
+  // Random access, ranges, and modifying the value.
+  RandomAccessSerializedMatrixReader reader("ark:tmpf2");
+  for (int32 i = 0; i < sz; i++) {
+    SerializedMatrix copy(reader.Value(k[i]));
+    KALDI_ASSERT(copy.Value().ApproxEqual(v[i], binary ? 0.0 : 0.01));
+    copy.MutableValue().Resize(2, 3);
+    KALDI_ASSERT(!copy.IsSerialized() && copy.NumRows() == 2);
+  }
+  std::ostringstream os;
+  reader.Value(k[0]).Write(os, true);
+  if (v[0].NumRows() > 1) {
+    SerializedMatrix input, output;
+    std::istringstream is(os.str());
+    input.Read(is, true);
+    KALDI_ASSERT(ExtractObjectRange(input, "1:1", &output) &&
+                 output.NumRows() == 1 && output.NumCols() == v[0].NumCols());
+  }
+}
+
+// Writes matrices with statistics headers, and reads back the statistics and
+// the matrices.
+void UnitTestTableMatrixStats(bool binary) {
+  int32 sz = RandInt(1, 10);
+  bool compress = (RandInt(0, 1) == 0);
+  std::vector<std::string> k;
+  std::vector<Matrix<BaseFloat> > v(sz);
+  {
+    MatrixWithStatsWriter writer(binary ? "ark,scp:tmpf,tmpf.scp" :
+                                 "ark,t,scp:tmpf,tmpf.scp");
+    for (int32 i = 0; i < sz; i++) {
+      k.push_back("utt" + std::to_string(i));
+      if (RandInt(0, 5) != 0) {
+        v[i].Resize(RandInt(1, 20), RandInt(1, 10));
+        v[i].SetRandn();
+      }
+      writer.Write(k[i], MatrixWithStats(v[i], compress));
+    }
+  }
+  // Matrix::Read() skips the header; SerializedMatrix keeps it.
+  std::vector<Matrix<BaseFloat> > v2(sz);
+  {
+    SequentialBaseFloatMatrixReader reader("ark:tmpf");
+    SerializedMatrixWriter writer("ark:tmpf2");
+    RandomAccessSerializedMatrixReader serialized_reader("scp:tmpf.scp");
+    for (int32 i = 0; !reader.Done(); reader.Next(), i++) {
+      v2[i] = reader.Value();
+      KALDI_ASSERT(reader.Key() == k[i] &&
+                   v2[i].ApproxEqual(v[i], (binary && !compress ? 0.0 : 0.1)));
+      writer.Write(k[i], serialized_reader.Value(k[i]));
+    }
+  }
+  const char *rspecifiers[] = { "ark:tmpf", "scp:tmpf.scp", "ark:tmpf2" };
+  for (int32 n = 0; n < 3; n++) {
+    SequentialMatrixStatsReader reader(rspecifiers[n]);
+    int32 i = 0;
+    for (; !reader.Done(); reader.Next(), i++) {
+      const MatrixStats &stats = reader.Value();
+      MatrixStats ref(v2[i]);
+      KALDI_ASSERT(reader.Key() == k[i] && stats.NumRows() == ref.NumRows() &&
+                   stats.NumCols() == ref.NumCols() &&
+                   stats.Sum().ApproxEqual(ref.Sum(), 0.0) &&
+                   stats.SumSq().ApproxEqual(ref.SumSq(), 0.0));
+      // The header is only kept by SerializedMatrix if the data is (empty
+      // matrices are not compressed).
+      KALDI_ASSERT(stats.HasMatrix() ==
+                   (!binary || (n == 2 && compress && v[i].NumRows() != 0)));
+    }
+    KALDI_ASSERT(i == sz);
+  }
+  RandomAccessMatrixStatsReader reader("scp:tmpf.scp");
+  for (int32 n = 0; n < 10; n++) {
+    int32 i = RandInt(0, sz - 1);
+    KALDI_ASSERT(reader.Value(k[i]).NumRows() == v[i].NumRows());
+  }
+  unlink("tmpf");
+  unlink("tmpf.scp");
+  unlink("tmpf2");
+}
+
 void UnitTestTableRandomBothDoubleMatrix(bool binary, bool read_scp,
                                          bool sorted, bool called_sorted,
                                          bool once) {
@@ -1016,6 +1248,8 @@ void UnitTestTableRandomBothDoubleMatrix(bool binary, bool read_scp,
   else if (Rand()%2 == 0) name += "ncs,";
   if (once) name += "o,";
   else if (Rand()%2 == 0) name += "no,";
+  if (Rand()%2 == 0) name += "mmap,";
+  if (!read_scp && Rand()%2 == 0) name += "idx,";
   name += std::string(read_scp ? "scp:tmpf.scp" : "ark:tmpf");
   RandomAccessDoubleMatrixReader sbr(name);
 
@@ -1048,9 +1282,159 @@ void UnitTestTableRandomBothDoubleMatrix(bool binary, bool read_scp,
   }
   unlink("tmpf");
   unlink("tmpf.scp");
+  unlink("tmpf.idx");
+}
+
+// Reads an unsorted archive through its index, from several threads.
+void UnitTestTableIndexedArchive(bool binary) {
+  int32 sz = RandInt(1, 50);
+  std::vector<std::string> k;
+  std::vector<Matrix<BaseFloat> > v(sz);
+  for (int32 i = 0; i < sz; i++) {
+    k.push_back("key" + std::to_string(i));
+    v[i].Resize(RandInt(1, 10), RandInt(1, 10));
+    v[i].SetRandn();
+  }
+  std::vector<int32> order(sz);
+  for (int32 i = 0; i < sz; i++)
+    order[i] = i;
+  RandomizeVector(&order);
+  unlink("tmpf.idx");
+  {
+    BaseFloatMatrixWriter writer(binary ? "ark:tmpf" : "ark,t:tmpf");
+    for (int32 i = 0; i < sz; i++)
+      writer.Write(k[order[i]], v[order[i]]);
+  }
+  float tol = (binary ? 0.0 : 0.01);
+  for (int32 n = 0; n < 2; n++) {  // The second time, the index is read.
+    RandomAccessBaseFloatMatrixReader reader("idx,ark:tmpf");
+    std::vector<std::pair<std::string, int64> > index;
+    KALDI_ASSERT(ReadArchiveIndex("tmpf", &index) &&
+                 index.size() == static_cast<size_t>(sz));
+    KALDI_ASSERT(!reader.HasKey("nonexistent"));
+    std::vector<std::thread> threads;
+    for (int32 t = 0; t < 4; t++) {
+      threads.push_back(std::thread([&reader, &k, &v, sz, tol]() {
+            for (int32 j = 0; j < 50; j++) {
+              int32 i = RandInt(0, sz - 1);
+              KALDI_ASSERT(reader.HasKey(k[i]) &&
+                           reader.Value(k[i]).ApproxEqual(v[i], tol));
+            }
+          }));
+    }
+    for (size_t t = 0; t < threads.size(); t++)
+      threads[t].join();
+  }
+  {
+    // In sorted order with the "cs" option, only one object is kept.
+    RandomAccessBaseFloatMatrixReader reader("idx,cs,ark:tmpf");
+    for (int32 i = 0; i < sz; i += RandInt(1, 3))
+      KALDI_ASSERT(reader.Value(k[i]).ApproxEqual(v[i], tol));
+  }
+  {
+    // An out-of-date index is rebuilt.
+    BaseFloatMatrixWriter writer(binary ? "ark:tmpf" : "ark,t:tmpf");
+    writer.Write("other", v[0]);
+  }
+  struct utimbuf times = { 0, 0 };  // Make sure the mtime changes.
+  utime("tmpf", &times);
+  RandomAccessBaseFloatMatrixReader reader("idx,ark:tmpf");
+  KALDI_ASSERT(!reader.HasKey(k[0]) && reader.HasKey("other"));
+  unlink("tmpf");
+  unlink("tmpf.idx");
 }
 
+// Looks up per-speaker vectors for utterances from several threads.
+// Writes with the "bg" option, as archive, script or both, and reads back.
+void UnitTestTableBackgroundWriter(bool binary) {
+  int32 size = RandInt(0, 50), type = RandInt(0, 2);
+  std::vector<std::string> keys;
+  std::vector<Matrix<BaseFloat> > values(size);
+  std::string wspecifier = std::string(binary ? "b" : "t") +
+      (RandInt(0, 1) == 0 ? ",bg" : ",bg=" + std::to_string(RandInt(1, 5))) +
+      ",threads=" + std::to_string(RandInt(1, 4)) +
+      (RandInt(0, 1) == 0 ? ",f" : "");
+  if (type == 0) {
+    wspecifier += ",ark:tmpf";
+  } else if (type == 1) {
+    wspecifier += ",ark,scp:tmpf,tmpf.scp";
+  } else {
+    // A script file that refers to a separate file for each object.
+    Output output("tmpf.scp", false);
+    for (int32 i = 0; i < size; i++)
+      output.Stream() << "key" << i << " tmpf." << i << '\n';
+    wspecifier += ",scp:tmpf.scp";
+  }
+  {
+    BaseFloatMatrixWriter writer(wspecifier);
+    for (int32 i = 0; i < size; i++) {
+      keys.push_back("key" + std::to_string(i));
+      values[i].Resize(RandInt(1, 20), RandInt(1, 20));
+      values[i].SetRandn();
+      writer.Write(keys[i], values[i]);
+      KALDI_ASSERT(writer.NumPending() >= 0);
+      if (RandInt(0, 10) == 0) {
+        writer.Flush();
+        KALDI_ASSERT(writer.NumPending() == 0);
+      }
+    }
+    KALDI_ASSERT(writer.Close());
+  }
+  SequentialBaseFloatMatrixReader reader(type == 0 ? "ark:tmpf" :
+                                         "scp:tmpf.scp");
+  int32 i = 0;
+  for (; !reader.Done(); reader.Next(), i++)
+    KALDI_ASSERT(reader.Key() == keys[i] &&
+                 reader.Value().ApproxEqual(values[i], binary ? 0.0 : 1.0e-04));
+  KALDI_ASSERT(i == size && reader.Close());
+  for (int32 i = 0; i < size; i++)
+    unlink(("tmpf." + std::to_string(i)).c_str());
+  unlink("tmpf");
+  unlink("tmpf.scp");
+}
 
+void UnitTestSharedRandomAccessTableReader() {
+  int32 num_spk = RandInt(1, 10), num_utt = RandInt(1, 50);
+  std::vector<Vector<BaseFloat> > v(num_spk);
+  {
+    BaseFloatVectorWriter writer("ark,scp:tmpf,tmpf.scp");
+    for (int32 i = 0; i < num_spk; i++) {
+      v[i].Resize(RandInt(1, 10));
+      v[i].SetRandn();
+      writer.Write("spk" + std::to_string(i), v[i]);
+    }
+  }
+  std::vector<int32> utt2spk(num_utt);
+  {
+    Output output("tmpf.utt2spk", false);
+    for (int32 i = 0; i < num_utt; i++) {
+      utt2spk[i] = RandInt(0, num_spk - 1);
+      output.Stream() << "utt" << i << " spk" << utt2spk[i] << '\n';
+    }
+  }
+  SharedRandomAccessBaseFloatVectorReader reader(
+      RandInt(0, 1) == 0 ? "ark:tmpf" : "scp:tmpf.scp", "ark:tmpf.utt2spk",
+      RandInt(0, 3));
+  std::vector<std::thread> threads;
+  for (int32 t = 0; t < 4; t++) {
+    threads.push_back(std::thread([&reader, &v, &utt2spk, num_utt]() {
+          for (int32 j = 0; j < 100; j++) {
+            int32 i = RandInt(0, num_utt - 1);
+            std::string utt = "utt" + std::to_string(i);
+            KALDI_ASSERT(reader.HasKey(utt));
+            std::shared_ptr<const Vector<BaseFloat> > value =
+                reader.Value(utt);
+            KALDI_ASSERT(value->ApproxEqual(v[utt2spk[i]], 0.0));
+          }
+        }));
+  }
+  for (size_t t = 0; t < threads.size(); t++)
+    threads[t].join();
+  KALDI_ASSERT(reader.Close());
+  unlink("tmpf");
+  unlink("tmpf.scp");
+  unlink("tmpf.utt2spk");
+}
 
 }  // end namespace kaldi.
 
@@ -1059,6 +1443,7 @@ int main() {
   UnitTestReadScriptFile();
   UnitTestClassifyWspecifier();
   UnitTestClassifyRspecifier();
+  UnitTestSharedRandomAccessTableReader();
   for (int i = 0; i < 10; i++) {
     bool b = (i == 0);
     UnitTestTableSequentialBool(b);
@@ -1066,6 +1451,11 @@ int main() {
     UnitTestTableSequentialInt32Script(b);
     UnitTestTableSequentialDouble(b);
     UnitTestRangesMatrix(b);
+    UnitTestTableZstd(b);
+    UnitTestTableSerializedMatrix(b);
+    UnitTestTableMatrixStats(b);
+    UnitTestTableIndexedArchive(b);
+    UnitTestTableBackgroundWriter(b);
     for (int j = 0; j < 2; j++) {
       bool c = (j == 0);
       UnitTestTableSequentialDoubleBoth(b, c);
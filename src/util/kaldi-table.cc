@@ -17,6 +17,10 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <sstream>
 #include "util/kaldi-table.h"
 #include "util/text-utils.h"
 
@@ -183,6 +187,18 @@ WspecifierType ClassifyWspecifier(const std::string &wspecifier,
       if (opts) opts->binary = false;
     } else if (!strcmp(c, "p")) {
       if (opts) opts->permissive = true;
+    } else if (!strcmp(c, "bg")) {
+      if (opts) opts->background = true;
+    } else if (!strncmp(c, "bg=", 3) || !strncmp(c, "threads=", 8)) {
+      bool is_depth = (c[0] == 'b');
+      int32 n;
+      if (!ConvertStringToInteger(c + (is_depth ? 3 : 8), &n) || n <= 0)
+        return kNoWspecifier;
+      if (opts) {
+        opts->background = true;
+        if (is_depth) opts->background_depth = n;
+        else opts->background_threads = n;
+      }
     } else if (!strcmp(c, "ark")) {
       if (ws == kNoWspecifier) ws = kArchiveWspecifier;
       else
@@ -222,6 +238,92 @@ WspecifierType ClassifyWspecifier(const std::string &wspecifier,
 
 
 
+std::string ArchiveIndexFilename(const std::string &archive_rxfilename) {
+  return archive_rxfilename + ".idx";
+}
+
+// Gets the size in bytes and the modification time of an archive that is a
+// local file; returns false if it is not (e.g. it is a URL).
+static bool ArchiveStat(const std::string &archive_rxfilename, int64 *size,
+                        int64 *mtime) {
+  struct stat st;
+  if (stat(archive_rxfilename.c_str(), &st) != 0)
+    return false;
+  *size = st.st_size;
+  *mtime = st.st_mtime;
+  return true;
+}
+
+bool ReadArchiveIndex(const std::string &archive_rxfilename,
+                      std::vector<std::pair<std::string, int64> > *index) {
+  std::string index_rxfilename = ArchiveIndexFilename(archive_rxfilename);
+  index->clear();
+  Input input;
+  if (!input.OpenTextMode(index_rxfilename))
+    return false;  // No index yet; not worth a warning.
+  std::istream &is = input.Stream();
+  int64 size, mtime, archive_size, archive_mtime;
+  if (!(is >> size >> mtime)) {
+    KALDI_WARN << "Invalid archive index " << index_rxfilename;
+    return false;
+  }
+  if (ArchiveStat(archive_rxfilename, &archive_size, &archive_mtime) &&
+      (size != archive_size || mtime != archive_mtime)) {
+    KALDI_WARN << "Archive index " << index_rxfilename << " is out of date.";
+    return false;
+  }
+  std::string key;
+  int64 offset;
+  while (is >> key >> offset) {
+    if (offset < 0 || (!index->empty() && index->back().first >= key)) {
+      KALDI_WARN << "Invalid archive index " << index_rxfilename
+                 << ": bad offset or keys not sorted, at key " << key;
+      index->clear();
+      return false;
+    }
+    index->push_back(std::make_pair(key, offset));
+  }
+  if (!is.eof()) {
+    KALDI_WARN << "Invalid archive index " << index_rxfilename;
+    index->clear();
+    return false;
+  }
+  return true;
+}
+
+bool WriteArchiveIndex(
+    const std::string &archive_rxfilename,
+    const std::vector<std::pair<std::string, int64> > &index) {
+  std::string index_wxfilename = ArchiveIndexFilename(archive_rxfilename);
+  if (ClassifyWxfilename(index_wxfilename) != kFileOutput)
+    return false;
+  int64 archive_size, archive_mtime;
+  if (!ArchiveStat(archive_rxfilename, &archive_size, &archive_mtime))
+    return false;
+  // The temporary file is in the same directory, so rename() can't fail
+  // because of crossing file systems.
+  std::ostringstream tmp_wxfilename;
+  tmp_wxfilename << index_wxfilename << ".tmp." << getpid();
+  {
+    Output output;
+    if (!output.Open(tmp_wxfilename.str(), false, false))
+      return false;
+    std::ostream &os = output.Stream();
+    os << archive_size << ' ' << archive_mtime << '\n';
+    for (size_t i = 0; i < index.size(); i++)
+      os << index[i].first << ' ' << index[i].second << '\n';
+    if (!output.Close()) {
+      unlink(tmp_wxfilename.str().c_str());
+      return false;
+    }
+  }
+  if (rename(tmp_wxfilename.str().c_str(), index_wxfilename.c_str()) != 0) {
+    unlink(tmp_wxfilename.str().c_str());
+    return false;
+  }
+  return true;
+}
+
 RspecifierType ClassifyRspecifier(const std::string &rspecifier,
                                   std::string *rxfilename,
                                   RspecifierOptions *opts) {
@@ -293,6 +395,20 @@ RspecifierType ClassifyRspecifier(const std::string &rspecifier,
       if (opts) opts->called_sorted = false;
     } else if (!strcmp(c, "bg")) {
       if (opts) opts->background = true;
+    } else if (!strncmp(c, "bg=", 3) || !strncmp(c, "threads=", 8)) {
+      bool is_depth = (c[0] == 'b');
+      int32 n;
+      if (!ConvertStringToInteger(c + (is_depth ? 3 : 8), &n) || n <= 0)
+        return kNoRspecifier;
+      if (opts) {
+        opts->background = true;
+        if (is_depth) opts->background_depth = n;
+        else opts->background_threads = n;
+      }
+    } else if (!strcmp(c, "mmap")) {
+      if (opts) opts->mmap = true;
+    } else if (!strcmp(c, "idx")) {
+      if (opts) opts->index = true;
     } else if (!strcmp(c, "ark")) {
       if (rs == kNoRspecifier) rs = kArchiveRspecifier;
       else
@@ -21,12 +21,16 @@
 #ifndef KALDI_UTIL_KALDI_TABLE_H_
 #define KALDI_UTIL_KALDI_TABLE_H_
 
+#include <list>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <utility>
 
 #include "base/kaldi-common.h"
 #include "util/kaldi-holder.h"
+#include "util/stl-utils.h"
 
 namespace kaldi {
 
@@ -71,12 +75,24 @@ typedef std::vector<std::string> KeyList;
 //  p means permissive mode, when writing to an "scp" file only: will ignore
 //     missing scp entries, i.e. won't write anything for those files but will
 //     return success status).
+//  bg means "background": Write() only queues the object, which is serialized
+//     (into memory) and written in other threads, in the order the objects
+//     were given.  This needs the object to be copied, unless its type cannot
+//     be copied, in which case it is serialized in Write() and only written in
+//     the background.  Write() waits if the queue is full.  Errors are
+//     reported by a later Write() or by Close().  With the f option the
+//     streams are flushed whenever the queue becomes empty, rather than after
+//     each object.
+//  bg=N is like bg, with a queue of N objects (the default is 4 times the
+//     number of threads).
+//  threads=M implies bg, and serializes the objects in M threads (default 1).
 //
 //  So the following are valid wspecifiers:
 //  ark,b,f:foo
 //  "ark,b,b:| gzip -c > foo"
 //  "ark,scp,t,nf:foo.ark,|gzip -c > foo.scp.gz"
 //  ark,b:-
+//  ark,scp,bg=64,threads=4:lat.ark,lat.scp
 //
 //  The meanings of rxfilename and wxfilename are as described in
 //  kaldi-io.h (they are filenames but include pipes, stdin/stdout
@@ -114,7 +130,12 @@ struct WspecifierOptions {
   bool binary;
   bool flush;
   bool permissive;  // will ignore absent scp entries.
-  WspecifierOptions(): binary(true), flush(false), permissive(false) { }
+  bool background;  // "bg": write in background threads.
+  int32 background_depth;  // The N in "bg=N" (0 means the default).
+  int32 background_threads;  // The M in "threads=M".
+  WspecifierOptions(): binary(true), flush(false), permissive(false),
+                       background(false), background_depth(0),
+                       background_threads(1) { }
 };
 
 // ClassifyWspecifier returns the type of the wspecifier string,
@@ -161,6 +182,29 @@ bool WriteScriptFile(std::ostream &os,
                      const std::vector<std::pair<std::string, std::string> >
                      &script);
 
+// An archive index lists the keys of an archive, in sorted order, with the
+// offset of each object in the archive (as in the scp files that are written
+// with archives).  With the "idx" rspecifier option (see below), random-access
+// readers keep it next to the archive, with ".idx" appended to its name.  The
+// file is in text form: its first line is the size of the archive in bytes and
+// its modification time, which are checked when it is read, then each line is
+// "<key> <offset>".
+
+// Returns the name of the index of an archive.
+std::string ArchiveIndexFilename(const std::string &archive_rxfilename);
+
+// Reads the index of an archive into 'index'.  Returns false if there is no
+// index, or (after printing a warning) if it is invalid or out of date.
+bool ReadArchiveIndex(const std::string &archive_rxfilename,
+                      std::vector<std::pair<std::string, int64> > *index);
+
+// Writes the index of an archive; 'index' must be sorted.  The index is written
+// to a temporary file which is then renamed, so that programs that read the
+// archive at the same time do not see a partial index.  Returns false on error.
+bool WriteArchiveIndex(
+    const std::string &archive_rxfilename,
+    const std::vector<std::pair<std::string, int64> > &index);
+
 // Documentation for "rspecifier"
 // "rspecifier" describes how we read a set of objects indexed by keys.
 // The possibilities are:
@@ -189,7 +233,31 @@ bool WriteScriptFile(std::ostream &os,
 //       value, in a background thread.  Recommended when reading larger objects
 //       such as neural-net training examples, especially when you want to
 //       maximize GPU usage.
+//   bg=N is like bg, but reads up to N objects ahead (bg is the same as bg=1).
+//   threads=M implies bg, and for scp files, loads the objects that are being
+//       read ahead in M threads, in parallel; they are still returned in the
+//       order of the scp file.  If bg=N is not given, N defaults to 2M.  Objects
+//       in an archive can only be found by reading the ones before them, so for
+//       archives (and for scp files in permissive mode, where an entry has to
+//       be read to know whether to skip it) only one thread is used; to read
+//       archives in parallel, index them with an scp file first, e.g.
+//       "scp,bg=16,threads=4:feats.scp".
+//   mmap means that for scp files, the objects are read from memory mappings
+//       of the files that the scp file refers to, which are shared by all the
+//       readers in the process.  This makes random access to offsets in
+//       archives, e.g. "scp,mmap:ivectors.scp", cheaper, since each read is
+//       a copy from the page cache instead of a seek and a read through a
+//       file buffer.  It has no effect for archives.
 //
+//   idx means that random-access readers of an archive look the keys up in an
+//       index of the archive (see ReadArchiveIndex()), which is built and
+//       written the first time the archive is read with this option, and read
+//       each object from its offset.  So they only read (and keep in memory)
+//       the objects they are asked for, and the archive need not be sorted.
+//       The archive must be a file, not a pipe.  Without the o or cs options,
+//       HasKey() and Value() of such a reader may be called from several
+//       threads at once.  It has no effect for scp files or sequential
+//       readers.
 //   b   is ignored [for scripting convenience]
 //   t   is ignored [for scripting convenience]
 //
@@ -211,9 +279,20 @@ struct  RspecifierOptions {
   bool background;  // For sequential readers, if the background option ("bg")
                     // is provided, it will read ahead to the next object in a
                     // background thread.
+  int32 background_depth;  // The N in "bg=N": the number of objects to read
+                           // ahead (0 means the default, see above).
+  int32 background_threads;  // The M in "threads=M": the number of threads to
+                             // load scp entries with.
+  bool mmap;  // For scp files, if the "mmap" option is provided, the objects
+              // are read from shared memory mappings of the files that the scp
+              // refers to (see Input::OpenMapped()).
+  bool index;  // For archives read by random-access readers, if the "idx"
+               // option is provided, objects are found through the index of
+               // the archive.
   RspecifierOptions(): once(false), sorted(false),
                        called_sorted(false), permissive(false),
-                       background(false) { }
+                       background(false), background_depth(0),
+                       background_threads(1), mmap(false), index(false) { }
 };
 
 enum RspecifierType  {
@@ -393,6 +472,10 @@ class TableWriter {
   // to ensure good CPU utilization.
   void Flush();
 
+  // Returns the number of objects that were given to Write() but have not
+  // been written yet; this is only nonzero with the "bg" option.
+  int32 NumPending() const;
+
   // Close() is not necessary to call, as the destructor
   // closes it; it's mainly useful if you want to handle
   // error states because the destructor will throw on
@@ -463,6 +546,57 @@ class RandomAccessTableReaderMapped {
 };
 
 
+/// This class is like RandomAccessTableReaderMapped (the utt2spk map is again
+/// optional), but it may be shared by several threads, which call HasKey() and
+/// Value() at the same time, e.g. the worker threads of a multi-threaded
+/// decoder that look up i-vectors or CMVN stats.  Value() returns a shared
+/// pointer to a copy of the object, which stays valid for as long as the caller
+/// keeps it.  The objects that were used most recently are kept in a cache of
+/// 'cache_size' objects (which are per speaker if there is an utt2spk map), so
+/// that looking them up again does not read them again; objects that are not
+/// in the cache are read one at a time.
+template<class Holder>
+class SharedRandomAccessTableReader {
+ public:
+  typedef typename Holder::T T;
+
+  explicit SharedRandomAccessTableReader(
+      const std::string &table_rxfilename,
+      const std::string &utt2spk_rxfilename = "", int32 cache_size = 100);
+
+  SharedRandomAccessTableReader(): cache_size_(0) { }
+
+  /// Note: when calling Open, utt2spk_rxfilename may be empty.
+  bool Open(const std::string &table_rxfilename,
+            const std::string &utt2spk_rxfilename = "",
+            int32 cache_size = 100);
+
+  bool HasKey(const std::string &key);
+  std::shared_ptr<const T> Value(const std::string &key);
+  bool IsOpen() const { return reader_.IsOpen(); }
+  bool Close();
+
+ private:
+  // Returns the key in the table for 'key' (the speaker, if there is an
+  // utt2spk map).  Called with mutex_ locked.
+  std::string MapKey(const std::string &key);
+
+  RandomAccessTableReader<Holder> reader_;
+  RandomAccessTableReader<TokenHolder> token_reader_;
+  std::string utt2spk_rxfilename_;  // Used only in diagnostic messages.
+  int32 cache_size_;
+  // The cached objects, most recently used first, and an index into them.
+  typedef std::list<std::pair<std::string, std::shared_ptr<const T> > >
+      CacheList;
+  CacheList cache_;
+  unordered_map<std::string, typename CacheList::iterator, StringHasher>
+      cache_map_;
+  std::mutex mutex_;  // Protects all of the above, once open.
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(SharedRandomAccessTableReader);
+};
+
+
 /// @} end "addtogroup table_group"
 }  // end namespace kaldi
 
@@ -20,6 +20,9 @@
 // limitations under the License.
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
 #include "base/kaldi-common.h"
 #include "util/kaldi-thread.h"
 
@@ -102,6 +105,56 @@ class MyTaskClass { // spins for a while, then outputs a pre-given integer.
 };
 
 
+// Adds n to *count and then, if n > 0, submits two tasks that do the same for
+// n - 1.  ExpectedCount(n) is the total that this adds.
+void AddCount(ThreadPool *pool, int32 n, std::atomic<int64> *count) {
+  KALDI_ASSERT(pool->InPool());
+  *count += n;
+  if (n > 0) {
+    pool->Submit(std::bind(AddCount, pool, n - 1, count));
+    pool->Submit(std::bind(AddCount, pool, n - 1, count));
+  }
+}
+
+int64 ExpectedCount(int32 n) {
+  return (n == 0 ? 0 : n + 2 * ExpectedCount(n - 1));
+}
+
+void TestThreadPool() {
+  int32 num_threads = 1 + Rand() % 10, n = Rand() % 12;
+  std::atomic<int64> count(0);
+  {
+    ThreadPool pool(num_threads);
+    KALDI_ASSERT(pool.NumThreads() == num_threads && !pool.InPool());
+    for (int32 i = 0; i < 3; i++)
+      pool.Submit(std::bind(AddCount, &pool, n, &count));
+  }  // The destructor waits for all the tasks, including the ones added by
+     // the tasks.
+  KALDI_ASSERT(count == 3 * ExpectedCount(n));
+}
+
+void PushBack(int32 i, std::vector<int32> *vec) {
+  vec->push_back(i);
+}
+
+// Checks that tasks of higher priority are run first.
+void TestThreadPoolPriority() {
+  std::vector<int32> order;
+  {
+    ThreadPool pool(1);
+    Semaphore blocked;
+    // Keep the only thread busy while we submit the other tasks.
+    pool.Submit(std::bind(&Semaphore::Wait, &blocked));
+    pool.Submit(std::bind(PushBack, 0, &order), ThreadPool::kLowPriority);
+    pool.Submit(std::bind(PushBack, 1, &order));
+    pool.Submit(std::bind(PushBack, 2, &order), ThreadPool::kHighPriority);
+    pool.Submit(std::bind(PushBack, 3, &order), ThreadPool::kLowPriority);
+    blocked.Signal();
+  }
+  KALDI_ASSERT(order.size() == 4 && order[0] == 2 && order[1] == 1);
+  KALDI_ASSERT(GlobalThreadPool().NumThreads() > 0);
+}
+
 void TestTaskSequencer() {
   TaskSequencerConfig config;
   config.num_threads = 1 + Rand() % 20;
@@ -110,24 +163,157 @@ void TestTaskSequencer() {
 
   int32 num_tasks = Rand() % 100;
 
-  std::vector<int32> task_output;
+  // Sometimes run the jobs on a pool that's shared with another sequencer.
+  std::unique_ptr<ThreadPool> pool;
+  if (Rand() % 2 == 1)
+    pool.reset(new ThreadPool(config.num_threads + Rand() % 5));
+
+  std::vector<int32> task_output, other_task_output;
   {
-    TaskSequencer<MyTaskClass> sequencer(config);
+    TaskSequencer<MyTaskClass> sequencer(config, pool.get()),
+        other_sequencer(config, pool.get());
+    int32 mode = Rand() % 3;  // no costs, costs, or costs and NUMA nodes.
     for (int32 i = 0; i < num_tasks; i++) {
-      sequencer.Run(new MyTaskClass(i, &task_output));
+      if (mode == 1)
+        sequencer.Run(new MyTaskClass(i, &task_output), Rand() % 10);
+      else if (mode == 2)
+        sequencer.Run(new MyTaskClass(i, &task_output), Rand() % 10,
+                      Rand() % 4);
+      else
+        sequencer.Run(new MyTaskClass(i, &task_output));
+      other_sequencer.Run(new MyTaskClass(i, &other_task_output));
     }
+    other_sequencer.Wait();
+    KALDI_ASSERT(other_task_output.size() == static_cast<size_t>(num_tasks));
   } // and let "sequencer" be destroyed, which waits for the last threads.
   KALDI_ASSERT(task_output.size() == static_cast<size_t>(num_tasks));
   for (int32 i = 0; i < num_tasks; i++)
-    KALDI_ASSERT(task_output[i] == i);
+    KALDI_ASSERT(task_output[i] == i && other_task_output[i] == i);
 }
 
+void SetToOne(int32 *value) { *value = 1; }
+
+void ThrowError() { throw std::runtime_error("error"); }
+
+// Checks the NUMA functions, and that a NUMA-aware pool runs all the tasks
+// whatever node they are submitted to.  (This machine may well have only one
+// node, in which case the pool behaves as one that is not NUMA-aware.)
+void TestNuma() {
+  int32 num_nodes = NumaNumNodes();
+  KALDI_ASSERT(num_nodes >= 1);
+  int32 value = 0;
+  RunOnNumaNode(num_nodes - 1, std::bind(SetToOne, &value));
+  KALDI_ASSERT(value == 1);
+  bool thrown = false;
+  try {
+    RunOnNumaNode(0, ThrowError);
+  } catch (const std::runtime_error &) {
+    thrown = true;
+  }
+  KALDI_ASSERT(thrown);
+
+  int32 num_threads = 1 + Rand() % 8, n = Rand() % 10;
+  std::atomic<int64> count(0);
+  {
+    ThreadPool pool(num_threads, true);
+    KALDI_ASSERT(pool.NumNumaNodes() >= 1 &&
+                 pool.NumNumaNodes() <= std::min(num_nodes, num_threads));
+    for (int32 i = 0; i < 4; i++)
+      pool.Submit(std::bind(AddCount, &pool, n, &count),
+                  ThreadPool::kNormalPriority, i);
+  }
+  KALDI_ASSERT(count == 4 * ExpectedCount(n));
+}
+
+// Records the order in which jobs are started and deleted.
+class OrderTaskClass {
+ public:
+  OrderTaskClass(int32 i, Semaphore *wait, std::vector<int32> *started,
+                 std::vector<int32> *deleted):
+      i_(i), wait_(wait), started_(started), deleted_(deleted) { }
+  void operator() () {
+    if (wait_ != NULL) wait_->Wait();
+    started_->push_back(i_);
+  }
+  ~OrderTaskClass() { deleted_->push_back(i_); }
+ private:
+  int32 i_;
+  Semaphore *wait_;
+  std::vector<int32> *started_, *deleted_;
+};
+
+// Checks that, with costs, the waiting jobs with the largest costs are
+// started first but the output is still in order.
+void TestTaskSequencerCosts() {
+  TaskSequencerConfig config;  // one thread.
+  std::vector<int32> started, deleted;
+  {
+    TaskSequencer<OrderTaskClass> sequencer(config);
+    Semaphore blocked;
+    // Keep the only thread busy while we add the other jobs.
+    sequencer.Run(new OrderTaskClass(0, &blocked, &started, &deleted), 0.0);
+    sequencer.Run(new OrderTaskClass(1, NULL, &started, &deleted), 1.0);
+    sequencer.Run(new OrderTaskClass(2, NULL, &started, &deleted), 3.0);
+    sequencer.Run(new OrderTaskClass(3, NULL, &started, &deleted), 2.0);
+    sequencer.Run(new OrderTaskClass(4, NULL, &started, &deleted), 3.0);
+    blocked.Signal();
+  }
+  int32 started_ref[] = { 0, 2, 4, 3, 1 };
+  KALDI_ASSERT(started.size() == 5 && deleted.size() == 5);
+  for (int32 i = 0; i < 5; i++)
+    KALDI_ASSERT(started[i] == started_ref[i] && deleted[i] == i);
+}
+
+// Pushes the integers 0 .. n-1 through an SpscQueue, from one thread to
+// another, with random waits so that both the full and the empty cases happen.
+void TestSpscQueue() {
+  int32 n = 1000, capacity = 1 + Rand() % 10,
+      wakeup_batch = 1 + Rand() % 4;
+  SpscQueue<int32> queue(capacity, wakeup_batch);
+  std::thread producer([&queue, n]() {
+      for (int32 i = 0; i < n; i++) {
+        if (Rand() % 100 == 0)
+          std::this_thread::sleep_for(std::chrono::microseconds(100));
+        KALDI_ASSERT(queue.Push(i));
+      }
+      queue.Close();
+    });
+  int32 item, expected = 0;
+  while (queue.Pop(&item)) {
+    KALDI_ASSERT(item == expected);
+    expected++;
+    if (Rand() % 100 == 0)
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    if (queue.TryPop(&item)) {
+      KALDI_ASSERT(item == expected);
+      expected++;
+    }
+  }
+  producer.join();
+  KALDI_ASSERT(expected == n && queue.Size() == 0 && queue.Closed());
+
+  // SetAbort() wakes a producer waiting on a full queue.
+  SpscQueue<int32> full_queue(2);
+  KALDI_ASSERT(full_queue.Push(0) && full_queue.Push(1));
+  std::thread aborter([&full_queue]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      full_queue.SetAbort();
+    });
+  KALDI_ASSERT(!full_queue.Push(2) && !full_queue.Pop(&item));
+  aborter.join();
+}
 
 }  // end namespace kaldi.
 
 int main() {
   using namespace kaldi;
   TestThreads();
-  for (int32 i = 0; i < 10; i++)
+  TestThreadPoolPriority();
+  TestTaskSequencerCosts();
+  for (int32 i = 0; i < 10; i++) {
+    TestThreadPool();
+    TestNuma();
     TestTaskSequencer();
+    TestSpscQueue();
+  }
 }
@@ -18,16 +18,309 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#ifdef __linux__
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <sstream>
+
 #include "base/kaldi-common.h"
 #include "util/kaldi-thread.h"
+#include "util/text-utils.h"
 
 namespace kaldi {
 int32 g_num_threads = 8;  // Initialize this global variable.
+int32 g_thread_pool_size = 0;
+bool g_thread_pool_numa = false;
 
 MultiThreadable::~MultiThreadable() {
   // default implementation does nothing
 }
 
 
+// Parses a list of CPUs in the format of the "cpulist" files in /sys, e.g.
+// "0-15,32-47".
+static bool ParseCpuList(const std::string &str, std::vector<int32> *cpus) {
+  std::vector<std::string> ranges;
+  SplitStringToVector(str, ",", true, &ranges);
+  for (size_t i = 0; i < ranges.size(); i++) {
+    std::vector<std::string> ends;
+    SplitStringToVector(ranges[i], "-", false, &ends);
+    int32 first, last;
+    if (ends.size() < 1 || ends.size() > 2 ||
+        !ConvertStringToInteger(ends[0], &first) ||
+        !ConvertStringToInteger(ends.back(), &last) ||
+        first < 0 || last < first)
+      return false;
+    for (int32 cpu = first; cpu <= last; cpu++)
+      cpus->push_back(cpu);
+  }
+  return true;
+}
+
+// The CPUs of each NUMA node that has CPUs, read from /sys once.
+struct NumaTopology {
+  std::vector<std::vector<int32> > node_cpus;
+
+  NumaTopology() {
+#ifdef __linux__
+    const char *dirname = "/sys/devices/system/node";
+    std::vector<int32> node_ids;
+    DIR *dir = opendir(dirname);
+    if (dir != NULL) {
+      struct dirent *entry;
+      while ((entry = readdir(dir)) != NULL) {
+        int32 id;
+        if (strncmp(entry->d_name, "node", 4) == 0 &&
+            ConvertStringToInteger(entry->d_name + 4, &id))
+          node_ids.push_back(id);
+      }
+      closedir(dir);
+    }
+    std::sort(node_ids.begin(), node_ids.end());
+    for (size_t i = 0; i < node_ids.size(); i++) {
+      std::ostringstream filename;
+      filename << dirname << "/node" << node_ids[i] << "/cpulist";
+      std::ifstream is(filename.str().c_str());
+      std::string line;
+      std::vector<int32> cpus;
+      if (!std::getline(is, line) || !ParseCpuList(line, &cpus)) {
+        KALDI_WARN << "Could not read the CPUs of NUMA node " << node_ids[i]
+                   << " from " << filename.str();
+        node_cpus.clear();
+        break;
+      }
+      if (!cpus.empty())  // Nodes that only have memory are of no use here.
+        node_cpus.push_back(cpus);
+    }
+#endif
+    if (node_cpus.empty())
+      node_cpus.resize(1);
+  }
+};
+
+static const NumaTopology &GetNumaTopology() {
+  static const NumaTopology topology;  // Thread-safe in C++11.
+  return topology;
+}
+
+int32 NumaNumNodes() {
+  return GetNumaTopology().node_cpus.size();
+}
+
+const std::vector<int32> &NumaNodeCpus(int32 node) {
+  const NumaTopology &topology = GetNumaTopology();
+  KALDI_ASSERT(node >= 0 && node < topology.node_cpus.size());
+  return topology.node_cpus[node];
+}
+
+bool PinThreadToNumaNode(int32 node) {
+  const std::vector<int32> &cpus = NumaNodeCpus(node);
+#ifdef __linux__
+  if (!cpus.empty()) {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (size_t i = 0; i < cpus.size(); i++)
+      if (cpus[i] < CPU_SETSIZE)
+        CPU_SET(cpus[i], &cpu_set);
+    int ret = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set),
+                                     &cpu_set);
+    if (ret == 0)
+      return true;
+    KALDI_WARN << "Could not pin thread to the CPUs of NUMA node " << node
+               << ": " << strerror(ret);
+    return false;
+  }
+#endif
+  KALDI_WARN << "Could not pin thread to NUMA node " << node
+             << " as the NUMA topology is not known";
+  return false;
+}
+
+static void RunPinnedToNumaNode(int32 node, const std::function<void()> *func,
+                                std::exception_ptr *exception) {
+  PinThreadToNumaNode(node);
+  try {
+    (*func)();
+  } catch (...) {
+    *exception = std::current_exception();
+  }
+}
+
+void RunOnNumaNode(int32 node, const std::function<void()> &func) {
+  if (NumaNumNodes() == 1) {
+    func();
+    return;
+  }
+  std::exception_ptr exception;
+  std::thread thread(RunPinnedToNumaNode, node, &func, &exception);
+  thread.join();
+  if (exception)
+    std::rethrow_exception(exception);
+}
+
+
+// The pool and worker index of the current thread, if it is a worker thread
+// of a ThreadPool.
+static thread_local const ThreadPool *tls_thread_pool = NULL;
+static thread_local int32 tls_worker_index = -1;
+
+ThreadPool::ThreadPool(int32 num_threads, bool numa_aware):
+    num_queued_(0), next_queue_(0), stop_(false) {
+  KALDI_ASSERT(num_threads > 0);
+  for (int32 p = 0; p < kNumPriorities; p++)
+    num_queued_per_priority_[p] = 0;
+  for (int32 i = 0; i < num_threads; i++)
+    queues_.push_back(std::unique_ptr<WorkerQueue>(new WorkerQueue()));
+  // The workers are divided among the nodes in contiguous blocks.
+  int32 num_nodes = (numa_aware ? std::min(NumaNumNodes(), num_threads) : 1);
+  node_workers_.resize(num_nodes);
+  next_node_worker_.resize(num_nodes, 0);
+  for (int32 i = 0; i < num_threads; i++) {
+    int32 node = static_cast<int64>(i) * num_nodes / num_threads;
+    worker_node_.push_back(node);
+    node_workers_[node].push_back(i);
+  }
+  steal_order_.resize(num_threads);
+  for (int32 i = 0; i < num_threads; i++) {
+    for (int32 j = 0; j < num_threads; j++)
+      if (worker_node_[(i + j) % num_threads] == worker_node_[i])
+        steal_order_[i].push_back((i + j) % num_threads);
+    for (int32 j = 0; j < num_threads; j++)
+      if (worker_node_[(i + j) % num_threads] != worker_node_[i])
+        steal_order_[i].push_back((i + j) % num_threads);
+  }
+  for (int32 i = 0; i < num_threads; i++)
+    threads_.push_back(std::thread(&ThreadPool::Worker, this, i));
+}
+
+bool ThreadPool::InPool() const {
+  return tls_thread_pool == this;
+}
+
+void ThreadPool::Submit(std::function<void()> task, Priority priority,
+                        int32 numa_node) {
+  if (numa_node >= 0)
+    numa_node %= node_workers_.size();
+  int32 q;
+  bool own_queue = InPool() && (numa_node < 0 ||
+                                worker_node_[tls_worker_index] == numa_node);
+  if (own_queue) {
+    q = tls_worker_index;
+  } else if (numa_node < 0) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    q = next_queue_;
+    next_queue_ = (next_queue_ + 1) % queues_.size();
+  } else {
+    std::unique_lock<std::mutex> lock(mutex_);
+    const std::vector<int32> &workers = node_workers_[numa_node];
+    int32 &next = next_node_worker_[numa_node];
+    q = workers[next];
+    next = (next + 1) % workers.size();
+  }
+  {
+    WorkerQueue &queue = *(queues_[q]);
+    std::unique_lock<std::mutex> lock(queue.mutex);
+    // Tasks submitted by a task are likely to use the same data, so it's
+    // best for the same worker to run them soon.
+    if (own_queue)
+      queue.tasks[priority].push_front(std::move(task));
+    else
+      queue.tasks[priority].push_back(std::move(task));
+    num_queued_per_priority_[priority]++;
+  }
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    num_queued_++;
+  }
+  cond_.notify_one();
+}
+
+bool ThreadPool::GetTask(int32 worker_index, std::function<void()> *task) {
+  const std::vector<int32> &order = steal_order_[worker_index];
+  for (int32 p = kNumPriorities - 1; p >= 0; p--) {
+    if (num_queued_per_priority_[p] <= 0)
+      continue;
+    for (size_t i = 0; i < order.size(); i++) {
+      WorkerQueue &queue = *(queues_[order[i]]);
+      std::unique_lock<std::mutex> lock(queue.mutex);
+      std::deque<std::function<void()> > &lane = queue.tasks[p];
+      if (lane.empty())
+        continue;
+      if (i == 0) {
+        *task = std::move(lane.front());
+        lane.pop_front();
+      } else {
+        *task = std::move(lane.back());
+        lane.pop_back();
+      }
+      num_queued_per_priority_[p]--;
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::Worker(int32 worker_index) {
+  tls_thread_pool = this;
+  tls_worker_index = worker_index;
+  if (node_workers_.size() > 1)
+    PinThreadToNumaNode(worker_node_[worker_index]);
+  std::function<void()> task;
+  while (true) {
+    if (GetTask(worker_index, &task)) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        num_queued_--;
+      }
+      task();
+      task = nullptr;  // Destroy anything the task holds.
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (num_queued_ <= 0 && !stop_)
+      cond_.wait(lock);
+    if (num_queued_ <= 0 && stop_)
+      return;
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cond_.notify_all();
+  for (size_t i = 0; i < threads_.size(); i++)
+    threads_[i].join();
+}
+
+ThreadPool &GlobalThreadPool() {
+  // This is thread-safe in C++11.
+  static ThreadPool pool(g_thread_pool_size > 0 ? g_thread_pool_size :
+                         std::max<int32>(1, std::thread::hardware_concurrency()),
+                         g_thread_pool_numa);
+  return pool;
+}
+
+void RegisterGlobalThreadPoolOptions(OptionsItf *opts) {
+  opts->Register("thread-pool-size", &g_thread_pool_size, "Number of threads "
+                 "in the thread pool that is shared by all the parts of the "
+                 "program that use it; if <= 0, the number of CPU cores.  "
+                 "Options like --num-threads limit how many of them each part "
+                 "uses.");
+  opts->Register("thread-pool-numa", &g_thread_pool_numa, "If true, divide "
+                 "the threads of the thread pool among the NUMA nodes and pin "
+                 "them to their node's CPUs; programs that support it also "
+                 "keep a copy of the model for each node, and run each job "
+                 "on the node whose copy it uses.");
+}
+
+
 
 }  // end namespace kaldi
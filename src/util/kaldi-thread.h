@@ -22,7 +22,16 @@
 #ifndef KALDI_THREAD_KALDI_THREAD_H_
 #define KALDI_THREAD_KALDI_THREAD_H_ 1
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
 #include <thread>
+#include <vector>
 #include "itf/options-itf.h"
 #include "util/kaldi-semaphore.h"
 
@@ -52,6 +61,24 @@
 // destructor to have side effects such as outputting data.
 // Note: the destructor of TaskSequencer will wait for any remaining jobs that
 // are still running and will call the destructors.
+//
+// The class ThreadPool is a pool of threads that run tasks (function objects)
+// as they are submitted.  Each thread has its own queue of tasks and, when that
+// is empty, steals tasks from the others, so the load is balanced even when the
+// tasks take very different amounts of time.  TaskSequencer runs its jobs on a
+// ThreadPool rather than creating a thread for each job; by default it creates
+// its own, but a ThreadPool may be shared between several TaskSequencers and
+// other users (e.g. the decoder and the lattice determinization of a program),
+// so that they don't compete for the cores with more threads than there are.
+// GlobalThreadPool() returns a ThreadPool that is shared by the whole process;
+// its tasks have priorities, so that e.g. latency-critical work is not held up
+// by background work.
+
+// The class SpscQueue is a bounded queue for handing items from one producing
+// thread to one consuming thread, e.g. between the stages of a pipeline.
+// Pushing and popping don't lock anything while the queue is neither full nor
+// empty; a thread only sleeps (on a condition variable) when it has to wait,
+// and the other thread only does a system call to wake it if it is sleeping.
 
 
 namespace kaldi {
@@ -152,6 +179,145 @@ template<class C> void RunMultiThreaded(const C &c_in) {
 }
 
 
+extern int32 g_thread_pool_size;  // The number of threads of the ThreadPool
+// returned by GlobalThreadPool(), or <= 0 (the default) for the number of
+// cores.  Programs that use GlobalThreadPool() should register it by calling
+// RegisterGlobalThreadPoolOptions().
+extern bool g_thread_pool_numa;  // If true, the ThreadPool returned by
+// GlobalThreadPool() is NUMA-aware (see ThreadPool).  Set by --thread-pool-numa.
+
+
+/// Returns the number of NUMA nodes that have CPUs.  This is 1 if the machine
+/// is not a NUMA machine, or on systems other than Linux, where the topology
+/// is not known.  Nodes are numbered 0 ... NumaNumNodes() - 1 here, whatever
+/// their numbers in the system are.
+int32 NumaNumNodes();
+
+/// Returns the CPUs of NUMA node 'node'; this is empty if the topology is not
+/// known.
+const std::vector<int32> &NumaNodeCpus(int32 node);
+
+/// Restricts the calling thread to the CPUs of NUMA node 'node'.  Returns
+/// false, after a warning, if that fails or the topology is not known.
+bool PinThreadToNumaNode(int32 node);
+
+/// Runs 'func' on a new thread that is pinned to NUMA node 'node', and waits
+/// for it to return; exceptions are passed on to the caller.  With Linux's
+/// default ("first touch") memory policy, the memory that 'func' allocates
+/// and initializes is then on that node, so this is how a read-only copy of a
+/// model can be made local to the threads of a node.  If there is only one
+/// node, 'func' is simply called.
+void RunOnNumaNode(int32 node, const std::function<void()> &func);
+
+/**
+   A pool of worker threads that runs tasks submitted by Submit().  Each worker
+   has its own queue: tasks submitted from a worker (i.e. by a task) go to the
+   front of that worker's own queue, and other tasks are distributed among the
+   queues in turn.  A worker takes tasks from the front of its own queue and,
+   when it is empty, steals them from the back of the other workers' queues.
+   Each queue has a lane for each priority, and a worker takes a task of a
+   lower priority only if there are no tasks of a higher priority in any of the
+   queues; apart from that, there is no guarantee about the order in which the
+   tasks are run.
+
+   A NUMA-aware pool divides its workers among the NUMA nodes and pins each
+   one to the CPUs of its node.  A task may then be submitted to a node, and
+   goes to the queue of one of that node's workers; workers steal from the
+   other workers of their own node before the workers of other nodes, so a
+   task runs on its node unless that node's workers are all busy.  The caller
+   would typically give the task data that is local to the node (see
+   RunOnNumaNode()).
+
+   Submit() may be called from any thread, including the workers.  Tasks
+   should not wait for other tasks of the same pool to finish, as that can
+   deadlock if all the workers are waiting.
+ */
+class ThreadPool {
+ public:
+  enum Priority { kLowPriority = 0, kNormalPriority = 1, kHighPriority = 2 };
+
+  /// Starts 'num_threads' worker threads; num_threads must be > 0.  If
+  /// 'numa_aware' is true and the machine has more than one NUMA node, the
+  /// pool is NUMA-aware (see above).
+  explicit ThreadPool(int32 num_threads, bool numa_aware = false);
+
+  /// Runs the task 'task' in one of the worker threads, at some point.  If
+  /// 'numa_node' is >= 0 the task goes to a worker of that node (modulo
+  /// NumNumaNodes(), so that this works for pools that are not NUMA-aware).
+  void Submit(std::function<void()> task,
+              Priority priority = kNormalPriority,
+              int32 numa_node = -1);
+
+  int32 NumThreads() const { return threads_.size(); }
+
+  /// The number of NUMA nodes the workers are divided among; 1 if the pool is
+  /// not NUMA-aware.
+  int32 NumNumaNodes() const { return node_workers_.size(); }
+
+  /// Returns true if called from one of the worker threads of this pool.
+  bool InPool() const;
+
+  /// The destructor waits for all the tasks that have been submitted
+  /// (including any that they submit) to finish.
+  ~ThreadPool();
+
+ private:
+  static const int32 kNumPriorities = 3;
+
+  struct WorkerQueue {
+    std::mutex mutex;
+    // The lanes, indexed by priority.
+    std::deque<std::function<void()> > tasks[kNumPriorities];
+  };
+
+  // The function that the worker threads run.
+  void Worker(int32 worker_index);
+
+  // Gets a task of the highest priority for which there are tasks: from the
+  // front of worker 'worker_index''s queue, or failing that from the back of
+  // another worker's queue.  Returns false if all the queues are empty.
+  bool GetTask(int32 worker_index, std::function<void()> *task);
+
+  std::vector<std::unique_ptr<WorkerQueue> > queues_;
+  std::vector<std::thread> threads_;
+  // The workers of each NUMA node (just one list if the pool is not
+  // NUMA-aware), and the node of each worker.
+  std::vector<std::vector<int32> > node_workers_;
+  std::vector<int32> worker_node_;
+  // For each worker, the queues in the order it looks at them: its own, those
+  // of the other workers of its node, then the rest.
+  std::vector<std::vector<int32> > steal_order_;
+
+  // mutex_ guards the following members, and is used with 'cond_' to make the
+  // workers sleep when there is nothing to do.
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  // The number of tasks in the queues.  (It may briefly be negative, as a task
+  // may be taken from a queue before Submit() has incremented it.)
+  int64 num_queued_;
+  // The number of tasks in the queues for each priority; this is only used to
+  // avoid looking at lanes that are empty.
+  std::atomic<int64> num_queued_per_priority_[kNumPriorities];
+  // The queue that the next task submitted from outside the pool without a
+  // NUMA node goes to, and for each node, the index in node_workers_ of the
+  // worker whose queue the next task for that node goes to.
+  int32 next_queue_;
+  std::vector<int32> next_node_worker_;
+  bool stop_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(ThreadPool);
+};
+
+/// Returns the process-wide ThreadPool, which has g_thread_pool_size threads
+/// (or as many as there are cores) and is NUMA-aware if g_thread_pool_numa is
+/// true; it is created on the first call, so those must be set before that.
+ThreadPool &GlobalThreadPool();
+
+/// Registers the --thread-pool-size and --thread-pool-numa options, which set
+/// g_thread_pool_size and g_thread_pool_numa.
+void RegisterGlobalThreadPoolOptions(OptionsItf *opts);
+
+
 struct TaskSequencerConfig {
   int32 num_threads;
   int32 num_threads_total;
@@ -161,7 +327,9 @@ struct TaskSequencerConfig {
                    "threads to run in parallel");
     opts->Register("num-threads-total", &num_threads_total, "Total number of "
                    "threads, including those that are waiting on other threads "
-                   "to produce their output.  Controls memory use.  If <= 0, "
+                   "to produce their output (or, in programs that start the "
+                   "largest jobs first, waiting to be started).  Controls "
+                   "memory use.  If <= 0, "
                    "defaults to --num-threads plus 20.  Otherwise, must "
                    "be >= num-threads.");
   }
@@ -170,23 +338,98 @@ struct TaskSequencerConfig {
 // C should have an operator () taking no arguments, that does some kind
 // of computation, and a destructor that produces some kind of output (the
 // destructors will be run sequentially in the same order Run as called.
+//
+// Jobs may be given a cost (see the two-argument Run()), e.g. the size of the
+// input; jobs waiting for a thread are started in order of decreasing cost, so
+// that the largest jobs do not end up running alone at the end while the other
+// threads are idle.  The output is still in the order Run() was called, so the
+// jobs that finish early wait in memory; --num-threads-total bounds how many
+// jobs may be alive (waiting to start, running, or waiting to be deleted).
 template<class C>
 class TaskSequencer {
  public:
-  TaskSequencer(const TaskSequencerConfig &config):
+  /// If 'pool' is NULL, the jobs are run on a ThreadPool with
+  /// config.num_threads threads that is owned by this object; otherwise they
+  /// are run on 'pool', which may be shared with other users and must outlive
+  /// this object.  In either case no more than config.num_threads jobs are
+  /// run at a time.
+  TaskSequencer(const TaskSequencerConfig &config, ThreadPool *pool = NULL):
       num_threads_(config.num_threads),
-      threads_avail_(config.num_threads),
       tot_threads_avail_(config.num_threads_total > 0 ? config.num_threads_total :
                          config.num_threads + 20),
-      thread_list_(NULL) {
+      pool_(pool),
+      num_running_(0),
+      next_seq_(0),
+      deleting_(false) {
     KALDI_ASSERT((config.num_threads_total <= 0 ||
                   config.num_threads_total >= config.num_threads) &&
                  "num-threads-total, if specified, must be >= num-threads");
+    if (pool_ == NULL && num_threads_ > 0) {
+      owned_pool_.reset(new ThreadPool(num_threads_));
+      pool_ = owned_pool_.get();
+    }
+    if (pool_ != NULL && pool_->NumThreads() < num_threads_)
+      KALDI_WARN << "--num-threads=" << num_threads_ << " is more than the "
+                 << "number of threads in the thread pool, "
+                 << pool_->NumThreads();
   }
 
   /// This function takes ownership of the pointer "c", and will delete it
-  /// in the same sequence as Run was called on the jobs.
-  void Run(C *c) {
+  /// in the same sequence as Run was called on the jobs.  It waits until
+  /// a thread is free to run it.
+  void Run(C *c) { RunInternal(c, 0.0, -1, true); }
+
+  /// As Run(c), but the job has a cost, which should be roughly proportional
+  /// to how long it will take (e.g. the number of states and arcs of a
+  /// lattice, or the number of frames of an utterance).  This does not wait
+  /// for a free thread, only for the number of jobs alive to be less than
+  /// --num-threads-total; so the caller can read ahead, and among the jobs
+  /// waiting for a thread the one with the largest cost is started first
+  /// (jobs with equal costs are started in the order of the calls).
+  void Run(C *c, double cost) { RunInternal(c, cost, -1, false); }
+
+  /// As Run(c, cost), but the job is run by a worker of NUMA node
+  /// 'numa_node' if the pool is NUMA-aware (see ThreadPool::Submit()), which
+  /// should be the node that the data 'c' uses is on.
+  void Run(C *c, double cost, int32 numa_node) {
+    RunInternal(c, cost, numa_node, false);
+  }
+
+  void Wait() { // You call this at the end if it's more convenient
+    // than waiting for the destructor.  It waits for all tasks to finish.
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!tasks_.empty() || deleting_)
+      all_deleted_.wait(lock);
+  }
+
+  /// The destructor waits for the last job to be deleted.
+  ~TaskSequencer() {
+    Wait();
+    owned_pool_.reset();
+  }
+ private:
+  struct Task {
+    C *c;
+    int32 numa_node;  // -1 if none.
+    bool done;  // true once the operator () of 'c' has returned.
+    Task(C *c, int32 numa_node): c(c), numa_node(numa_node), done(false) { }
+  };
+
+  // A job waiting for a thread.  The one that compares greatest (largest
+  // cost, then earliest call) is at the top of pending_.
+  struct PendingTask {
+    double cost;
+    int64 seq;
+    Task *task;
+    PendingTask(double cost, int64 seq, Task *task):
+        cost(cost), seq(seq), task(task) { }
+    bool operator < (const PendingTask &other) const {
+      if (cost != other.cost) return cost < other.cost;
+      return seq > other.seq;
+    }
+  };
+
+  void RunInternal(C *c, double cost, int32 numa_node, bool wait_for_thread) {
     // run in main thread
     if (num_threads_ == 0) {
       (*c)();
@@ -194,89 +437,246 @@ class TaskSequencer {
       return;
     }
 
-    threads_avail_.Wait(); // wait till we have a thread for computation free.
-    tot_threads_avail_.Wait(); // this ensures we don't have too many threads
-    // waiting on I/O, and consume too much memory.
+    tot_threads_avail_.Wait(); // this ensures we don't have too many jobs
+    // waiting to be deleted, and consume too much memory.
 
-    // put the new RunTaskArgsList object at head of the singly
-    // linked list thread_list_.
-    thread_list_ = new RunTaskArgsList(this, c, thread_list_);
-    thread_list_->thread = std::thread(TaskSequencer<C>::RunTask,
-                                       thread_list_);
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (wait_for_thread) {
+      // wait till we have a thread for computation free.
+      while (num_running_ + static_cast<int32>(pending_.size()) >= num_threads_)
+        thread_free_.wait(lock);
+    }
+    Task *task = new Task(c, numa_node);
+    tasks_.push_back(task);
+    pending_.push(PendingTask(cost, next_seq_++, task));
+    StartPendingTasks();
   }
 
-  void Wait() { // You call this at the end if it's more convenient
-    // than waiting for the destructor.  It waits for all tasks to finish.
-    if (thread_list_ != NULL) {
-      thread_list_->thread.join();
-      KALDI_ASSERT(thread_list_->tail == NULL); // thread would not
-      // have exited without setting tail to NULL.
-      delete thread_list_;
-      thread_list_ = NULL;
+  // Starts the pending jobs with the largest costs, while fewer than
+  // num_threads_ jobs are running.  Must be called with mutex_ locked.
+  void StartPendingTasks() {
+    while (num_running_ < num_threads_ && !pending_.empty()) {
+      Task *task = pending_.top().task;
+      pending_.pop();
+      num_running_++;
+      pool_->Submit(std::bind(&TaskSequencer<C>::RunTask, this, task),
+                    ThreadPool::kNormalPriority, task->numa_node);
     }
   }
 
-  /// The destructor waits for the last thread to exit.
-  ~TaskSequencer() {
-    Wait();
-  }
- private:
-  struct RunTaskArgsList {
-    TaskSequencer *me; // Think of this as a "this" pointer.
-    C *c; // Clist element of the task we're expected
-    std::thread thread;
-    RunTaskArgsList *tail;
-    RunTaskArgsList(TaskSequencer *me, C *c, RunTaskArgsList *tail):
-        me(me), c(c), tail(tail) {}
-  };
-  // This static function gets run in the threads that we create.
-  static void RunTask(RunTaskArgsList *args) {
+  // This function gets run in the threads of the pool.
+  void RunTask(Task *task) {
     // (1) run the job.
-    (*(args->c))(); // call operator () on args->c, which does the computation.
-    args->me->threads_avail_.Signal(); // Signal that the compute-intensive
-    // part of the thread is done (we want to run no more than
-    // config_.num_threads of these.)
+    (*(task->c))(); // call operator () on task->c, which does the computation.
 
     // (2) we want to destroy the object "c" now, by deleting it.  But for
     //     correct sequencing (this is the whole point of this class, it
     //     is intended to ensure the output of the program is in correct order),
-    //     we first wait till the previous thread, whose details will be in "tail",
-    //     is finished.
-    if (args->tail != NULL) {
-      args->tail->thread.join();
+    //     we can only delete it once all the previous jobs have been deleted.
+    //     So we delete all the jobs at the front of tasks_ that are done; if
+    //     some other thread is already doing that, it will delete this one
+    //     too, if it can.  In either case there is no risk of concurrent
+    //     calls to the destructors.
+    std::unique_lock<std::mutex> lock(mutex_);
+    // The compute-intensive part of the job is done (we want to run no more
+    // than config_.num_threads of these), so start the next one.
+    num_running_--;
+    StartPendingTasks();
+    thread_free_.notify_all();
+    task->done = true;
+    if (deleting_)
+      return;
+    deleting_ = true;
+    while (!tasks_.empty() && tasks_.front()->done) {
+      Task *front = tasks_.front();
+      tasks_.pop_front();
+      lock.unlock();
+      delete front->c; // delete the object "c".  This may cause some output,
+      // e.g. to a stream.
+      delete front;
+      // Signal the "tot_threads_avail_" semaphore which is used to limit the
+      // total number of jobs that are alive, including not only those that
+      // are in active computation in c->operator (), but those that are
+      // waiting for a thread or for previous jobs to be deleted.
+      tot_threads_avail_.Signal();
+      lock.lock();
     }
+    deleting_ = false;
+    if (tasks_.empty())
+      all_deleted_.notify_all();
+  }
 
-    delete args->c; // delete the object "c".  This may cause some output,
-    // e.g. to a stream.  We don't need to worry about concurrent access to
-    // the output stream, because each thread waits for the previous thread
-    // to be done, before doing this.  So there is no risk of concurrent
-    // access.
-    args->c = NULL;
-
-    if (args->tail != NULL) {
-      KALDI_ASSERT(args->tail->tail == NULL); // Because we already
-      // did join on args->tail->thread, which means that
-      // thread was done, and before it exited, it would have
-      // deleted and set to NULL its tail (which is the next line of code).
-      delete args->tail;
-      args->tail = NULL;
+  int32 num_threads_; // copy of config.num_threads.
+
+  Semaphore tot_threads_avail_; // We use this semaphore to ensure we don't
+  // consume too much memory...
+
+  ThreadPool *pool_;  // The pool that runs the jobs (not owned, unless it is
+                      // owned_pool_).
+  std::unique_ptr<ThreadPool> owned_pool_;
+
+  // mutex_ guards the members below.
+  std::mutex mutex_;
+  // The jobs that have not been deleted yet, in the order Run() was called.
+  std::deque<Task*> tasks_;
+  // The jobs that have not been started yet.
+  std::priority_queue<PendingTask> pending_;
+  // The number of jobs whose operator () is running (or has been submitted
+  // to the pool); no more than num_threads_.
+  int32 num_running_;
+  // The number of jobs given to Run() so far.
+  int64 next_seq_;
+  // Notified when a job's operator () returns; Run(c) waits on this.
+  std::condition_variable thread_free_;
+  // True while some thread is deleting the jobs at the front of tasks_.
+  bool deleting_;
+  // Notified when tasks_ becomes empty.
+  std::condition_variable all_deleted_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(TaskSequencer);
+};
+
+
+/**
+   SpscQueue is a bounded first-in-first-out queue for exactly one producing
+   thread and one consuming thread.  It is a ring buffer of 'capacity' items
+   indexed by two counters that are only incremented, each by one of the
+   threads, so that Push() and Pop() need no mutex unless they have to wait.
+   A thread that has to wait (the producer because the queue is full, the
+   consumer because it is empty) sleeps on a condition variable, after setting
+   a flag that the other thread checks.  So that the consumer isn't woken for
+   every item if the items come faster than it needs them, once it is asleep
+   it is only woken when 'wakeup_batch' items are waiting, or when Close() or
+   SetAbort() is called.
+
+   T should be cheap to copy, e.g. a pointer; the queue does not own what the
+   pointers point to.
+*/
+template<class T>
+class SpscQueue {
+ public:
+  explicit SpscQueue(int32 capacity, int32 wakeup_batch = 1):
+      buffer_(capacity), capacity_(capacity),
+      wakeup_batch_(std::min(wakeup_batch, capacity)), head_(0), tail_(0),
+      closed_(false), abort_(false), producer_waiting_(false),
+      consumer_waiting_(false) {
+    KALDI_ASSERT(capacity > 0 && wakeup_batch > 0);
+  }
+
+  /// Called from the producing thread.  Adds 'item' to the queue, waiting if
+  /// it is full.  Returns true normally, and false if SetAbort() was called.
+  bool Push(const T &item) {
+    int64 tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == capacity_) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      producer_waiting_.store(true);
+      while (tail - head_.load() == capacity_ && !abort_.load())
+        producer_cond_.wait(lock);
+      producer_waiting_.store(false);
+    }
+    if (abort_.load(std::memory_order_relaxed))
+      return false;
+    buffer_[tail % capacity_] = item;
+    tail_.store(tail + 1);  // this and the load below must not be reordered.
+    if (consumer_waiting_.load() &&
+        tail + 1 - head_.load() >= wakeup_batch_) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      consumer_cond_.notify_one();
     }
-    // At this point we are exiting from the thread.  Signal the
-    // "tot_threads_avail_" semaphore which is used to limit the total number of threads that are alive, including
-    // not onlhy those that are in active computation in c->operator (), but those
-    // that are waiting on I/O or other threads.
-    args->me->tot_threads_avail_.Signal();
+    return true;
   }
 
-  int32 num_threads_; // copy of config.num_threads (since Semaphore doesn't store original count)
+  /// Called from the producing thread to say that there will be no more items;
+  /// Pop() returns false once the queue is empty.
+  void Close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_.store(true);
+    consumer_cond_.notify_one();
+  }
 
-  Semaphore threads_avail_; // Initialized to the number of threads we are
-  // supposed to run with; the function Run() waits on this.
+  /// Called from the consuming thread.  Sets 'item' to the item at the front
+  /// of the queue and removes it, waiting if the queue is empty.  Returns
+  /// false if SetAbort() was called, or if the queue is empty and Close() was
+  /// called.
+  bool Pop(T *item) {
+    int64 head = head_.load(std::memory_order_relaxed);
+    if (tail_.load(std::memory_order_acquire) == head) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      consumer_waiting_.store(true);
+      while (tail_.load() - head < wakeup_batch_ && !closed_.load() &&
+             !abort_.load())
+        consumer_cond_.wait(lock);
+      consumer_waiting_.store(false);
+    }
+    return PopInternal(head, item);
+  }
 
-  Semaphore tot_threads_avail_; // We use this semaphore to ensure we don't
-  // consume too much memory...
-  RunTaskArgsList *thread_list_;
+  /// Like Pop(), but returns false instead of waiting if the queue is empty.
+  bool TryPop(T *item) {
+    return PopInternal(head_.load(std::memory_order_relaxed), item);
+  }
+
+  /// Makes all calls to Push() and Pop() return false, now and in future,
+  /// waking any thread waiting in them.  May be called from any thread.
+  void SetAbort() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    abort_.store(true);
+    producer_cond_.notify_one();
+    consumer_cond_.notify_one();
+  }
+
+  /// Returns the number of items in the queue (which may be out of date as
+  /// soon as it returns, if the other thread is active).
+  int32 Size() const { return tail_.load() - head_.load(); }
+
+  bool Closed() const { return closed_.load(); }
+  bool Aborted() const { return abort_.load(); }
+
+  /// Outputs the items in the queue, from front to back, without removing
+  /// them.  Only to be called when neither of the threads is active (e.g.
+  /// after they were joined).
+  void GetItems(std::vector<T> *items) const {
+    items->clear();
+    for (int64 i = head_.load(); i < tail_.load(); i++)
+      items->push_back(buffer_[i % capacity_]);
+  }
+
+ private:
+  bool PopInternal(int64 head, T *item) {
+    if (abort_.load(std::memory_order_relaxed) ||
+        tail_.load(std::memory_order_acquire) == head)
+      return false;
+    *item = buffer_[head % capacity_];
+    head_.store(head + 1);  // this and the load below must not be reordered.
+    if (producer_waiting_.load()) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      producer_cond_.notify_one();
+    }
+    return true;
+  }
 
+  std::vector<T> buffer_;
+  int64 capacity_;
+  int64 wakeup_batch_;
+  // The number of items popped and pushed so far; head_ is only changed by the
+  // consumer and tail_ only by the producer.  They are on separate cache
+  // lines, so that the two threads don't keep taking the line from each other.
+  alignas(64) std::atomic<int64> head_;
+  alignas(64) std::atomic<int64> tail_;
+  alignas(64) std::atomic<bool> closed_;
+  std::atomic<bool> abort_;
+  // True while the producer (consumer) is, or is about to be, waiting on
+  // producer_cond_ (consumer_cond_).  The waiting thread sets its flag and
+  // then re-checks the counters, and the other thread changes the counters
+  // and then checks the flag, all with sequentially consistent operations,
+  // so a wakeup can't be missed.
+  std::atomic<bool> producer_waiting_;
+  std::atomic<bool> consumer_waiting_;
+  std::mutex mutex_;
+  std::condition_variable producer_cond_;
+  std::condition_variable consumer_cond_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(SpscQueue);
 };
 
 } // namespace kaldi
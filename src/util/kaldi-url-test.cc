@@ -0,0 +1,208 @@
+// util/kaldi-url-test.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "util/kaldi-url.h"
+#include "util/kaldi-io.h"
+#include "util/parse-options.h"
+#include "util/table-types.h"
+#include <stdlib.h>
+
+#ifdef HAVE_CURL
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <thread>
+#endif
+
+namespace kaldi {
+
+void UnitTestUrlNames() {
+  KALDI_ASSERT(IsUrl("s3://bucket/a.ark") && IsUrl("gs://bucket/a.ark") &&
+               IsUrl("http://host/a.ark:10") && IsUrl("https://host/a.ark"));
+  KALDI_ASSERT(!IsUrl("a.ark") && !IsUrl("/s3://a.ark") && !IsUrl("s3:a"));
+  KALDI_ASSERT(ClassifyRxfilename("s3://bucket/a.ark") == kFileInput);
+  KALDI_ASSERT(ClassifyRxfilename("s3://bucket/a.ark:10") == kOffsetFileInput);
+  KALDI_ASSERT(ClassifyRxfilename("https://host:8080/a.ark") == kFileInput);
+
+  setenv("AWS_REGION", "eu-west-1", 1);
+  unsetenv("AWS_ENDPOINT_URL");
+  KALDI_ASSERT(HttpUrlFor("s3://bucket/dir/a.ark") ==
+               "https://bucket.s3.eu-west-1.amazonaws.com/dir/a.ark");
+  setenv("AWS_ENDPOINT_URL", "http://localhost:9000/", 1);
+  KALDI_ASSERT(HttpUrlFor("s3://bucket/dir/a.ark") ==
+               "http://localhost:9000/bucket/dir/a.ark");
+  unsetenv("AWS_ENDPOINT_URL");
+  KALDI_ASSERT(HttpUrlFor("gs://bucket/a.ark") ==
+               "https://storage.googleapis.com/bucket/a.ark");
+  KALDI_ASSERT(HttpUrlFor("http://host/a.ark") == "http://host/a.ark");
+
+  Output output;
+  KALDI_ASSERT(!output.Open("s3://bucket/a.ark", true, false));
+}
+
+#ifdef HAVE_CURL
+
+// A minimal HTTP server for the files in the current directory, which supports
+// range requests; it runs until the program exits.
+static void ServeFiles(int listen_fd) {
+  while (true) {
+    int fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0)
+      continue;
+    std::string request;
+    char buf[4096];
+    ssize_t n;
+    while (request.find("\r\n\r\n") == std::string::npos &&
+           (n = read(fd, buf, sizeof(buf))) > 0)
+      request.append(buf, n);
+    std::istringstream is(request);
+    std::string method, path;
+    is >> method >> path;
+    std::ifstream file(path.substr(1).c_str(), std::ios::binary);
+    std::string contents((std::istreambuf_iterator<char>(file)),
+                         std::istreambuf_iterator<char>()), body;
+    std::ostringstream response;
+    size_t range_pos = request.find("Range: bytes=");
+    long long begin = 0, end = 0;
+    if (!file) {
+      response << "HTTP/1.1 404 Not Found\r\n";
+    } else if (range_pos != std::string::npos &&
+               sscanf(request.c_str() + range_pos + 13, "%lld-%lld",
+                      &begin, &end) == 2) {
+      long long size = contents.size();
+      if (begin >= size) {
+        response << "HTTP/1.1 416 Range Not Satisfiable\r\n"
+                 << "Content-Range: bytes */" << size << "\r\n";
+      } else {
+        end = std::min(end, size - 1);
+        body = contents.substr(begin, end + 1 - begin);
+        response << "HTTP/1.1 206 Partial Content\r\n"
+                 << "Content-Range: bytes " << begin << "-" << end << "/"
+                 << size << "\r\n";
+      }
+    } else {
+      body = contents;
+      response << "HTTP/1.1 200 OK\r\n";
+    }
+    response << "Content-Length: " << body.size() << "\r\n"
+             << "Connection: close\r\n\r\n" << body;
+    std::string str = response.str();
+    for (size_t i = 0; i < str.size(); i += n)
+      if ((n = write(fd, str.data() + i, str.size() - i)) <= 0)
+        break;
+    close(fd);
+  }
+}
+
+// Starts ServeFiles() in a thread and returns its URL.
+static std::string StartServer() {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  KALDI_ASSERT(fd >= 0);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = 0;  // Any free port.
+  socklen_t len = sizeof(addr);
+  KALDI_ASSERT(bind(fd, reinterpret_cast<sockaddr*>(&addr), len) == 0 &&
+               listen(fd, 16) == 0 &&
+               getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &len) == 0);
+  std::thread(ServeFiles, fd).detach();
+  return "http://127.0.0.1:" + std::to_string(ntohs(addr.sin_port)) + "/";
+}
+
+// Reads an archive and its scp file over HTTP, sequentially and with random
+// access; the blocks are small, so that objects span several of them.  The
+// cache assumes that the files don't change, so each test uses new names.
+void UnitTestUrlTable(const std::string &server, int32 test) {
+  std::string ark = "tmpf" + std::to_string(test) + ".ark",
+      scp = "tmpf" + std::to_string(test) + ".scp",
+      url_scp = "tmpf" + std::to_string(test) + "_url.scp";
+#ifdef HAVE_ZSTD
+  if (test % 2 == 1)
+    ark += ".zst";  // Compressed archives can be read over HTTP too.
+#endif
+  int32 size = RandInt(1, 30);
+  std::vector<std::string> keys;
+  std::vector<Matrix<BaseFloat> > values(size);
+  {
+    BaseFloatMatrixWriter writer("ark,scp:" + ark + "," + scp);
+    for (int32 i = 0; i < size; i++) {
+      keys.push_back("key" + std::to_string(i));
+      values[i].Resize(RandInt(1, 20), RandInt(1, 40));
+      values[i].SetRandn();
+      writer.Write(keys[i], values[i]);
+    }
+  }
+  {
+    // Make a copy of the scp file that refers to the archive by URL.
+    Input input(scp);
+    Output output(url_scp, false);
+    std::string key, rxfilename;
+    while (input.Stream() >> key >> rxfilename)
+      output.Stream() << key << ' ' << server << rxfilename << '\n';
+  }
+
+  const char *rspecifiers[] = { "ark:", "scp:", "scp,bg:" };
+  for (int32 n = 0; n < 3; n++) {
+    std::string rspecifier = rspecifiers[n] +
+        (n == 0 ? server + ark : url_scp);
+    SequentialBaseFloatMatrixReader reader(rspecifier);
+    int32 i = 0;
+    for (; !reader.Done(); reader.Next(), i++)
+      KALDI_ASSERT(reader.Key() == keys[i] &&
+                   reader.Value().ApproxEqual(values[i], 0.0));
+    KALDI_ASSERT(i == size);
+  }
+  RandomAccessBaseFloatMatrixReader reader("scp:" + url_scp);
+  for (int32 n = 0; n < 10; n++) {
+    int32 i = RandInt(0, size - 1);
+    KALDI_ASSERT(reader.Value(keys[i]).ApproxEqual(values[i], 0.0));
+  }
+
+  Input input;
+  KALDI_ASSERT(!input.Open(server + "nonexistent.ark"));
+  unlink(ark.c_str());
+  unlink(scp.c_str());
+  unlink(url_scp.c_str());
+}
+
+#endif  // HAVE_CURL
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  // Use blocks of 1 KiB, before the first URL is read.
+  const char *argv[] = { "kaldi-url-test", "--url-block-size=1",
+                         "--url-read-ahead=2" };
+  ParseOptions po("");
+  RegisterGlobalUrlOptions(&po);
+  po.Read(3, argv);
+
+  UnitTestUrlNames();
+#ifdef HAVE_CURL
+  std::string server = StartServer();
+  for (int32 i = 0; i < 10; i++)
+    UnitTestUrlTable(server, i);
+#endif
+  std::cout << "Test OK.\n";
+  return 0;
+}
@@ -0,0 +1,414 @@
+// util/kaldi-url.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "util/kaldi-url.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <condition_variable>
+#include <list>
+#include <map>
+#include <mutex>
+#include <sstream>
+
+#ifdef HAVE_CURL
+#include <curl/curl.h>
+#include <strings.h>
+#include "util/kaldi-thread.h"
+#endif
+
+namespace kaldi {
+
+static UrlOptions g_url_options;
+
+void RegisterGlobalUrlOptions(OptionsItf *opts) {
+  g_url_options.Register(opts);
+}
+
+static bool HasPrefix(const std::string &str, const char *prefix) {
+  return str.compare(0, strlen(prefix), prefix) == 0;
+}
+
+bool IsUrl(const std::string &filename) {
+  return HasPrefix(filename, "s3://") || HasPrefix(filename, "gs://") ||
+      HasPrefix(filename, "http://") || HasPrefix(filename, "https://");
+}
+
+// Returns the value of the environment variable 'name', or "" if it is not
+// set.
+static std::string GetEnv(const char *name) {
+  const char *value = std::getenv(name);
+  return (value == NULL ? "" : value);
+}
+
+static std::string AwsRegion() {
+  std::string region = GetEnv("AWS_REGION");
+  if (region.empty())
+    region = GetEnv("AWS_DEFAULT_REGION");
+  return (region.empty() ? "us-east-1" : region);
+}
+
+std::string HttpUrlFor(const std::string &url) {
+  if (HasPrefix(url, "s3://")) {
+    size_t slash = url.find('/', 5);
+    std::string bucket(url, 5, slash == std::string::npos ? std::string::npos
+                       : slash - 5),
+        path(slash == std::string::npos ? "/" : url.substr(slash)),
+        endpoint = GetEnv("AWS_ENDPOINT_URL");
+    if (!endpoint.empty()) {
+      // Path-style URL, which is what S3-compatible servers support.
+      if (endpoint[endpoint.size() - 1] == '/')
+        endpoint.resize(endpoint.size() - 1);
+      return endpoint + "/" + bucket + path;
+    }
+    return "https://" + bucket + ".s3." + AwsRegion() + ".amazonaws.com" +
+        path;
+  } else if (HasPrefix(url, "gs://")) {
+    return "https://storage.googleapis.com/" + url.substr(5);
+  } else {
+    return url;
+  }
+}
+
+#ifdef HAVE_CURL
+
+namespace {
+
+// A curl handle for each thread, so that the connections are reused.
+struct CurlHandle {
+  CURL *curl;
+  CurlHandle(): curl(curl_easy_init()) { }
+  ~CurlHandle() { if (curl != NULL) curl_easy_cleanup(curl); }
+};
+
+size_t CurlWrite(char *ptr, size_t size, size_t nmemb, void *userdata) {
+  static_cast<std::string*>(userdata)->append(ptr, size * nmemb);
+  return size * nmemb;
+}
+
+// Gets the size of the object from a header like
+// "Content-Range: bytes 0-4095/123456".
+size_t CurlHeader(char *ptr, size_t size, size_t nmemb, void *userdata) {
+  std::string line(ptr, size * nmemb);
+  if (strncasecmp(line.c_str(), "content-range:", 14) == 0) {
+    size_t slash = line.find('/');
+    if (slash != std::string::npos && isdigit(line[slash + 1]))
+      *static_cast<int64*>(userdata) = strtoll(line.c_str() + slash + 1,
+                                               NULL, 10);
+  }
+  return size * nmemb;
+}
+
+}  // namespace
+
+// Reads the bytes [begin, end) of 'url' into 'data' (fewer at the end of the
+// object, and none past the end), and outputs the size of the object to
+// 'object_size' if the server says it (else -1).  Returns false, after
+// printing a warning, on failure.
+static bool HttpGetRange(const std::string &url, int64 begin, int64 end,
+                         std::string *data, int64 *object_size) {
+  static std::once_flag init_flag;
+  std::call_once(init_flag, []() { curl_global_init(CURL_GLOBAL_DEFAULT); });
+  static thread_local CurlHandle handle;
+  CURL *curl = handle.curl;
+  if (curl == NULL) {
+    KALDI_WARN << "Could not initialize curl to read " << url;
+    return false;
+  }
+  curl_easy_reset(curl);
+
+  std::string http_url = HttpUrlFor(url), user_password, aws_sigv4;
+  std::ostringstream range;
+  range << begin << '-' << (end - 1);
+  std::string range_str = range.str();
+  char error[CURL_ERROR_SIZE] = "";
+  data->clear();
+  *object_size = -1;
+  curl_easy_setopt(curl, CURLOPT_URL, http_url.c_str());
+  curl_easy_setopt(curl, CURLOPT_RANGE, range_str.c_str());
+  curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+  curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);  // We use threads.
+  curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, error);
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, CurlWrite);
+  curl_easy_setopt(curl, CURLOPT_WRITEDATA, data);
+  curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, CurlHeader);
+  curl_easy_setopt(curl, CURLOPT_HEADERDATA, object_size);
+
+  struct curl_slist *headers = NULL;
+  if (HasPrefix(url, "s3://")) {
+    std::string key = GetEnv("AWS_ACCESS_KEY_ID"),
+        secret = GetEnv("AWS_SECRET_ACCESS_KEY"),
+        token = GetEnv("AWS_SESSION_TOKEN");
+    if (!key.empty() && !secret.empty()) {
+      user_password = key + ":" + secret;
+      aws_sigv4 = "aws:amz:" + AwsRegion() + ":s3";
+      curl_easy_setopt(curl, CURLOPT_USERPWD, user_password.c_str());
+      curl_easy_setopt(curl, CURLOPT_AWS_SIGV4, aws_sigv4.c_str());
+      if (!token.empty())
+        headers = curl_slist_append(headers,
+                                    ("x-amz-security-token: " + token).c_str());
+    }
+  } else if (HasPrefix(url, "gs://")) {
+    std::string token = GetEnv("GOOGLE_OAUTH_ACCESS_TOKEN");
+    if (!token.empty())
+      headers = curl_slist_append(headers,
+                                  ("Authorization: Bearer " + token).c_str());
+  }
+  if (headers != NULL)
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+
+  CURLcode ret = curl_easy_perform(curl);
+  long status = 0;
+  curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+  curl_slist_free_all(headers);
+  if (ret != CURLE_OK) {
+    KALDI_WARN << "Error reading " << url << ": "
+               << (error[0] != '\0' ? error : curl_easy_strerror(ret));
+    return false;
+  }
+  if (status == 416) {  // The range is past the end of the object.
+    data->clear();
+    return true;
+  } else if (status == 200) {
+    // The server does not support ranges and sent the whole object.
+    *object_size = data->size();
+    if (begin >= *object_size)
+      data->clear();
+    else
+      *data = data->substr(begin, end - begin);
+    return true;
+  } else if (status != 206) {
+    KALDI_WARN << "Error reading " << url << ": HTTP status " << status;
+    return false;
+  }
+  return true;
+}
+
+
+// The cache of blocks of URLs, which is shared by all the UrlStreambufs.  It
+// also makes sure that each block is fetched only once at a time, whether it
+// is fetched because it is needed or ahead of time.
+class UrlBlockCache {
+ public:
+  UrlBlockCache(): block_size_(std::max<int64>(g_url_options.block_size, 1) *
+                               1024),
+                   capacity_(static_cast<int64>(g_url_options.cache_size) <<
+                             20),
+                   num_bytes_(0) { }
+
+  int64 BlockSize() const { return block_size_; }
+
+  // Returns block 'block' of 'url', which is empty if it is past the end of
+  // the object, fetching it if it is not in the cache; returns NULL if it
+  // could not be fetched.
+  std::shared_ptr<const std::string> Get(const std::string &url,
+                                         int64 block) {
+    Key key(url, block);
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      std::map<Key, Entry>::iterator iter = entries_.find(key);
+      if (iter == entries_.end()) {
+        entries_[key].state = kFetching;
+        break;
+      }
+      Entry &entry = iter->second;
+      if (entry.state == kDone) {
+        lru_.splice(lru_.end(), lru_, entry.lru);
+        return entry.data;
+      } else if (entry.state == kQueued) {
+        // It was queued to be fetched ahead of time but that has not started
+        // yet, so fetch it now instead of waiting.
+        entry.state = kFetching;
+        break;
+      }
+      cond_.wait(lock);  // Another thread is fetching it.
+    }
+    return Fetch(key, &lock);
+  }
+
+  // Starts fetching block 'block' of 'url' in the GlobalThreadPool(), unless
+  // it is in the cache or is known to be past the end of the object.
+  void Prefetch(const std::string &url, int64 block) {
+    Key key(url, block);
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      std::map<std::string, int64>::iterator iter = sizes_.find(url);
+      if ((iter != sizes_.end() && block * block_size_ >= iter->second) ||
+          entries_.count(key) != 0)
+        return;
+      entries_[key].state = kQueued;
+    }
+    GlobalThreadPool().Submit([this, key]() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        std::map<Key, Entry>::iterator iter = entries_.find(key);
+        if (iter != entries_.end() && iter->second.state == kQueued) {
+          iter->second.state = kFetching;
+          Fetch(key, &lock);
+        }
+      }, ThreadPool::kLowPriority);
+  }
+
+ private:
+  typedef std::pair<std::string, int64> Key;
+  enum State { kQueued, kFetching, kDone };
+  struct Entry {
+    State state;
+    std::shared_ptr<const std::string> data;  // Set if kDone.
+    std::list<Key>::iterator lru;  // Set if kDone.
+  };
+
+  // Fetches the block for an entry that the caller has put in state kFetching;
+  // 'lock' must be locked, and is unlocked while fetching.
+  std::shared_ptr<const std::string> Fetch(const Key &key,
+                                           std::unique_lock<std::mutex> *lock) {
+    lock->unlock();
+    std::shared_ptr<std::string> data = std::make_shared<std::string>();
+    int64 object_size;
+    bool ok = HttpGetRange(key.first, key.second * block_size_,
+                           (key.second + 1) * block_size_, data.get(),
+                           &object_size);
+    lock->lock();
+    cond_.notify_all();
+    if (!ok) {
+      entries_.erase(key);
+      return NULL;
+    }
+    if (object_size >= 0)
+      sizes_[key.first] = object_size;
+    Entry &entry = entries_[key];
+    entry.state = kDone;
+    entry.data = data;
+    entry.lru = lru_.insert(lru_.end(), key);
+    num_bytes_ += data->size();
+    // Evict the least recently used blocks, but not the one just fetched.
+    while (num_bytes_ > capacity_ && lru_.size() > 1) {
+      std::map<Key, Entry>::iterator iter = entries_.find(lru_.front());
+      num_bytes_ -= iter->second.data->size();
+      entries_.erase(iter);
+      lru_.pop_front();
+    }
+    return data;
+  }
+
+  int64 block_size_;
+  int64 capacity_;  // in bytes.
+
+  // mutex_ guards the following members.
+  std::mutex mutex_;
+  // Notified when fetching a block has finished.
+  std::condition_variable cond_;
+  std::map<Key, Entry> entries_;
+  // The keys of the entries in state kDone, least recently used first.
+  std::list<Key> lru_;
+  int64 num_bytes_;  // The total size of the blocks in state kDone.
+  // The sizes of the objects, as far as they are known.
+  std::map<std::string, int64> sizes_;
+};
+
+static UrlBlockCache *GetUrlBlockCache() {
+  // Never deleted, as blocks may still be being fetched in the
+  // GlobalThreadPool() when the program exits.
+  static UrlBlockCache *cache = new UrlBlockCache();
+  return cache;
+}
+
+
+UrlStreambuf::UrlStreambuf(): cache_(GetUrlBlockCache()),
+                              block_size_(cache_->BlockSize()), block_(-1) { }
+
+bool UrlStreambuf::Open(const std::string &url, int64 pos) {
+  bool sequential;
+  if (url != url_) {
+    url_ = url;
+    block_ = -1;
+    data_.reset();
+    setg(NULL, NULL, NULL);
+    // Reading from the start of a file is usually reading all of it.
+    sequential = (pos == 0);
+  } else {
+    int64 block = pos / block_size_;
+    sequential = (block_ >= 0 && (block == block_ || block == block_ + 1));
+  }
+  if (pos < 0 || !LoadBlock(pos / block_size_, pos % block_size_,
+                            sequential)) {
+    KALDI_WARN << "Could not read " << url << " at offset " << pos;
+    return false;
+  }
+  return true;
+}
+
+bool UrlStreambuf::LoadBlock(int64 block, int64 offset, bool sequential) {
+  if (block != block_) {
+    data_ = cache_->Get(url_, block);
+    if (data_ == NULL) {
+      block_ = -1;
+      setg(NULL, NULL, NULL);
+      return false;
+    }
+    block_ = block;
+  }
+  if (offset > static_cast<int64>(data_->size()))
+    return false;
+  char *begin = const_cast<char*>(data_->data());
+  setg(begin, begin + offset, begin + data_->size());
+  if (sequential)
+    for (int32 i = 1; i <= g_url_options.read_ahead; i++)
+      cache_->Prefetch(url_, block + i);
+  return true;
+}
+
+UrlStreambuf::int_type UrlStreambuf::underflow() {
+  if (gptr() < egptr())
+    return traits_type::to_int_type(*gptr());
+  // A block shorter than block_size_ is the last one.
+  if (block_ < 0 || static_cast<int64>(data_->size()) < block_size_ ||
+      !LoadBlock(block_ + 1, 0, true) || gptr() == egptr())
+    return traits_type::eof();
+  return traits_type::to_int_type(*gptr());
+}
+
+UrlStreambuf::pos_type UrlStreambuf::seekoff(off_type off,
+                                             std::ios_base::seekdir dir,
+                                             std::ios_base::openmode which) {
+  if (!(which & std::ios_base::in) || block_ < 0)
+    return pos_type(off_type(-1));
+  int64 cur = block_ * block_size_ + (gptr() - eback());
+  if (dir == std::ios_base::cur && off == 0)
+    return pos_type(cur);  // tellg().
+  else if (dir == std::ios_base::cur)
+    return seekpos(pos_type(cur + off), which);
+  else if (dir == std::ios_base::beg)
+    return seekpos(pos_type(off), which);
+  return pos_type(off_type(-1));  // The end is not known.
+}
+
+UrlStreambuf::pos_type UrlStreambuf::seekpos(pos_type pos,
+                                             std::ios_base::openmode which) {
+  int64 p = off_type(pos);
+  if (!(which & std::ios_base::in) || block_ < 0 || p < 0 ||
+      !LoadBlock(p / block_size_, p % block_size_, false))
+    return pos_type(off_type(-1));
+  return pos;
+}
+
+#endif  // HAVE_CURL
+
+}  // namespace kaldi
@@ -0,0 +1,119 @@
+// util/kaldi-url.h
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_UTIL_KALDI_URL_H_
+#define KALDI_UTIL_KALDI_URL_H_
+
+#include <memory>
+#include <streambuf>
+#include <string>
+#include "base/kaldi-common.h"
+#include "itf/options-itf.h"
+
+namespace kaldi {
+
+/**
+   Input (util/kaldi-io.h) can read files in object storage and on web servers,
+   given as URLs: "s3://bucket/key", "gs://bucket/key", "http://..." and
+   "https://...", and offsets into them such as "s3://bucket/1.ark:1234", so
+   that e.g. "scp:s3://bucket/feats.scp" works if the scp file refers to
+   archives in the bucket.  This needs Kaldi to be configured with libcurl (see
+   --curl-root in ../configure).
+
+   The files are read with HTTP range requests for blocks of them, so seeking
+   to an offset does not read the parts before it.  The blocks are kept in a
+   cache that is shared by the whole process, and when a file is read
+   sequentially the next blocks are fetched in parallel, ahead of time, in the
+   GlobalThreadPool().  The cache assumes that the files do not change while
+   the program runs, as is usual for objects in object storage.
+
+   For s3:// URLs the requests are signed with the credentials in the
+   environment variables AWS_ACCESS_KEY_ID, AWS_SECRET_ACCESS_KEY and (if set)
+   AWS_SESSION_TOKEN, for the region in AWS_REGION (default: us-east-1); if
+   AWS_ENDPOINT_URL is set, it is used instead of Amazon's endpoint, e.g. for
+   MinIO.  For gs:// URLs, the OAuth2 token in GOOGLE_OAUTH_ACCESS_TOKEN is
+   used, if set.  Writing to URLs is not supported.
+ */
+bool IsUrl(const std::string &filename);
+
+/// Returns the http:// or https:// URL that an s3://, gs://, http:// or
+/// https:// URL is read from.
+std::string HttpUrlFor(const std::string &url);
+
+/// The options for reading URLs, which apply to the whole process.
+struct UrlOptions {
+  int32 block_size;  // in KiB.
+  int32 cache_size;  // in MiB.
+  int32 read_ahead;
+  UrlOptions(): block_size(4096), cache_size(256), read_ahead(4) { }
+  void Register(OptionsItf *opts) {
+    opts->Register("url-block-size", &block_size, "Size in KiB of the blocks "
+                   "that files given as URLs are read in.");
+    opts->Register("url-cache-size", &cache_size, "Size in MiB of the cache of "
+                   "blocks of files given as URLs.");
+    opts->Register("url-read-ahead", &read_ahead, "Number of blocks to fetch "
+                   "ahead, in parallel, when a file given as a URL is read "
+                   "sequentially.");
+  }
+};
+
+/// Registers the --url-* options, which set the UrlOptions of the process.
+/// They must not be changed after the first URL is read.
+void RegisterGlobalUrlOptions(OptionsItf *opts);
+
+#ifdef HAVE_CURL
+
+class UrlBlockCache;
+
+/// A stream buffer that reads a URL; see above.
+class UrlStreambuf: public std::streambuf {
+ public:
+  UrlStreambuf();
+
+  /// Opens 'url' at byte offset 'pos'; returns false (after printing a
+  /// warning) if it could not be read.  May be called again while open, which
+  /// is cheap if the URL is the same.
+  bool Open(const std::string &url, int64 pos);
+
+ protected:
+  virtual int_type underflow();
+  virtual pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                           std::ios_base::openmode which);
+  virtual pos_type seekpos(pos_type pos, std::ios_base::openmode which);
+
+ private:
+  // Makes the get area the part of block 'block' from byte 'offset' on;
+  // returns false if it could not be fetched.  'sequential' says whether to
+  // start fetching the blocks after it.
+  bool LoadBlock(int64 block, int64 offset, bool sequential);
+
+  UrlBlockCache *cache_;
+  std::string url_;
+  int64 block_size_;
+  int64 block_;  // The block that the get area is in (-1 if none).
+  std::shared_ptr<const std::string> data_;  // The data of that block.
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(UrlStreambuf);
+};
+
+#endif  // HAVE_CURL
+
+}  // namespace kaldi
+
+#endif  // KALDI_UTIL_KALDI_URL_H_
@@ -0,0 +1,206 @@
+// util/kaldi-zstdbuf.cc
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "util/kaldi-zstdbuf.h"
+
+#include <algorithm>
+
+namespace kaldi {
+
+bool IsZstdFilename(const std::string &filename) {
+  size_t len = filename.size();
+  return len > 4 && filename.compare(len - 4, 4, ".zst") == 0;
+}
+
+#ifdef HAVE_ZSTD
+
+ZstdOutputBuf::ZstdOutputBuf(std::streambuf *dest, int32 level):
+    dest_(dest), level_(level), cctx_(ZSTD_createCCtx()),
+    buffer_(kZstdBlockSize), dest_pos_(0), failed_(false) {
+  if (cctx_ == NULL)
+    KALDI_ERR << "Could not create zstd compression context.";
+  setp(buffer_.data(), buffer_.data() + buffer_.size());
+}
+
+ZstdOutputBuf::~ZstdOutputBuf() {
+  ZSTD_freeCCtx(cctx_);
+}
+
+bool ZstdOutputBuf::WriteFrame() {
+  size_t size = pptr() - pbase();
+  if (size == 0 || failed_)
+    return !failed_;
+  compressed_.resize(ZSTD_compressBound(size));
+  size_t compressed_size = ZSTD_compressCCtx(cctx_, compressed_.data(),
+                                             compressed_.size(), pbase(),
+                                             size, level_);
+  if (ZSTD_isError(compressed_size)) {
+    KALDI_WARN << "zstd compression failed: "
+               << ZSTD_getErrorName(compressed_size);
+    failed_ = true;
+    return false;
+  }
+  if (dest_->sputn(compressed_.data(), compressed_size) !=
+      static_cast<std::streamsize>(compressed_size)) {
+    failed_ = true;
+    return false;
+  }
+  dest_pos_ += compressed_size;
+  setp(buffer_.data(), buffer_.data() + buffer_.size());
+  return true;
+}
+
+bool ZstdOutputBuf::Finish() {
+  return WriteFrame() && dest_->pubsync() == 0;
+}
+
+ZstdOutputBuf::int_type ZstdOutputBuf::overflow(int_type c) {
+  if (!WriteFrame())
+    return traits_type::eof();
+  if (traits_type::eq_int_type(c, traits_type::eof()))
+    return traits_type::not_eof(c);
+  *pptr() = traits_type::to_char_type(c);
+  pbump(1);
+  return c;
+}
+
+int ZstdOutputBuf::sync() {
+  return Finish() ? 0 : -1;
+}
+
+ZstdOutputBuf::pos_type ZstdOutputBuf::seekoff(off_type off,
+                                               std::ios_base::seekdir dir,
+                                               std::ios_base::openmode which) {
+  if (off != 0 || dir != std::ios_base::cur || !(which & std::ios_base::out))
+    return pos_type(off_type(-1));
+  // If the buffer is full, the position would not fit in this frame.
+  if (pptr() == epptr() && !WriteFrame())
+    return pos_type(off_type(-1));
+  return pos_type(dest_pos_ * kZstdBlockSize + (pptr() - pbase()));
+}
+
+
+ZstdInputBuf::ZstdInputBuf(std::streambuf *src):
+    src_(src), dctx_(ZSTD_createDCtx()), in_(ZSTD_DStreamInSize()),
+    in_pos_(0), in_size_(0), in_start_(0), out_(ZSTD_DStreamOutSize()),
+    frame_start_(0), frame_offset_(0), frame_done_(true) {
+  if (dctx_ == NULL)
+    KALDI_ERR << "Could not create zstd decompression context.";
+  setg(out_.data(), out_.data(), out_.data());
+}
+
+ZstdInputBuf::~ZstdInputBuf() {
+  ZSTD_freeDCtx(dctx_);
+}
+
+ZstdInputBuf::int_type ZstdInputBuf::underflow() {
+  if (gptr() < egptr())
+    return traits_type::to_int_type(*gptr());
+  size_t num_out = 0;
+  while (num_out == 0) {
+    if (frame_done_) {
+      frame_start_ = in_start_ + in_pos_;
+      frame_offset_ = 0;
+      frame_done_ = false;
+    } else {
+      frame_offset_ += egptr() - eback();
+    }
+    setg(out_.data(), out_.data(), out_.data());
+    if (in_pos_ == in_size_) {
+      in_start_ += in_size_;
+      in_pos_ = 0;
+      in_size_ = src_->sgetn(in_.data(), in_.size());
+      if (in_size_ == 0)
+        return traits_type::eof();  // If the frame was not finished, the file
+                                    // was truncated.
+    }
+    ZSTD_inBuffer input = { in_.data(), in_size_, in_pos_ };
+    ZSTD_outBuffer output = { out_.data(), out_.size(), 0 };
+    // This stops at the end of a frame, and returns 0 there.
+    size_t ret = ZSTD_decompressStream(dctx_, &output, &input);
+    if (ZSTD_isError(ret)) {
+      KALDI_WARN << "zstd decompression failed: " << ZSTD_getErrorName(ret);
+      return traits_type::eof();
+    }
+    in_pos_ = input.pos;
+    num_out = output.pos;
+    frame_done_ = (ret == 0);
+    setg(out_.data(), out_.data(), out_.data() + num_out);
+  }
+  return traits_type::to_int_type(*gptr());
+}
+
+bool ZstdInputBuf::Skip(int64 num_bytes) {
+  while (num_bytes > 0) {
+    if (gptr() == egptr() &&
+        traits_type::eq_int_type(underflow(), traits_type::eof()))
+      return false;
+    int64 n = std::min<int64>(num_bytes, egptr() - gptr());
+    gbump(static_cast<int>(n));
+    num_bytes -= n;
+  }
+  return true;
+}
+
+bool ZstdInputBuf::Seek(int64 pos) {
+  if (pos < 0)
+    return false;
+  int64 frame_start = pos / kZstdBlockSize,
+      frame_offset = pos % kZstdBlockSize,
+      cur_offset = frame_offset_ + (gptr() - eback());
+  if (frame_start == frame_start_ && frame_offset >= cur_offset)
+    return Skip(frame_offset - cur_offset);
+  if (src_->pubseekpos(frame_start, std::ios_base::in) !=
+      pos_type(frame_start))
+    return false;
+  ZSTD_DCtx_reset(dctx_, ZSTD_reset_session_only);
+  in_start_ = frame_start;
+  in_pos_ = in_size_ = 0;
+  frame_start_ = frame_start;
+  frame_offset_ = 0;
+  frame_done_ = true;
+  setg(out_.data(), out_.data(), out_.data());
+  return Skip(frame_offset);
+}
+
+ZstdInputBuf::pos_type ZstdInputBuf::seekoff(off_type off,
+                                             std::ios_base::seekdir dir,
+                                             std::ios_base::openmode which) {
+  if (!(which & std::ios_base::in))
+    return pos_type(off_type(-1));
+  if (dir == std::ios_base::beg)
+    return seekpos(pos_type(off), which);
+  if (off != 0 || dir != std::ios_base::cur)
+    return pos_type(off_type(-1));
+  int64 frame_offset = frame_offset_ + (gptr() - eback());
+  if (frame_offset >= kZstdBlockSize)
+    return pos_type(off_type(-1));
+  return pos_type(frame_start_ * kZstdBlockSize + frame_offset);
+}
+
+ZstdInputBuf::pos_type ZstdInputBuf::seekpos(pos_type pos,
+                                             std::ios_base::openmode which) {
+  if (!(which & std::ios_base::in) || !Seek(off_type(pos)))
+    return pos_type(off_type(-1));
+  return pos;
+}
+
+#endif  // HAVE_ZSTD
+
+}  // namespace kaldi
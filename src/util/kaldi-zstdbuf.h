@@ -0,0 +1,139 @@
+// util/kaldi-zstdbuf.h
+
+// Copyright 2026  Kaldi contributors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_UTIL_KALDI_ZSTDBUF_H_
+#define KALDI_UTIL_KALDI_ZSTDBUF_H_
+
+#include <streambuf>
+#include <string>
+#include <vector>
+#include "base/kaldi-common.h"
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace kaldi {
+
+/**
+   Files whose names end in ".zst" are read and written by Input and Output
+   (util/kaldi-io.h) through the stream buffers below, which compress them with
+   zstd, e.g. "ark,scp:foo.ark.zst,foo.scp" writes a compressed archive.  This
+   needs Kaldi to be configured with zstd (see --zstd-root in ../configure).
+
+   The file is a sequence of zstd frames, each holding kZstdBlockSize bytes of
+   the data (fewer for the last one, or if the stream was flushed), so it can
+   be read by "zstd -dc" and, conversely, any .zst file can be read
+   sequentially.  The positions that tellp() returns for a file being written,
+   which are what the scp files written with an archive contain, are "virtual
+   offsets" as in BGZF: the position in the file of the frame, times
+   kZstdBlockSize, plus the position in the frame's data.  So seeking to an
+   scp entry such as foo.ark.zst:123456 only needs one frame to be
+   decompressed.
+ */
+bool IsZstdFilename(const std::string &filename);
+
+/// The amount of data that is compressed as a frame; it is a power of two.
+static const int64 kZstdBlockSize = 1 << 17;
+
+#ifdef HAVE_ZSTD
+
+/// A stream buffer that compresses the data written to it and writes it to
+/// another stream buffer.
+class ZstdOutputBuf: public std::streambuf {
+ public:
+  /// Writes to 'dest', which is not owned and should be at its start.
+  explicit ZstdOutputBuf(std::streambuf *dest,
+                         int32 level = ZSTD_CLEVEL_DEFAULT);
+
+  /// Writes out the data that has not been written yet; returns false on
+  /// error.  It should be called before the destination is closed.
+  bool Finish();
+
+  ~ZstdOutputBuf();
+
+ protected:
+  virtual int_type overflow(int_type c);
+  // Flushing ends the current frame, so flushing often (e.g. with the "f"
+  // wspecifier option) makes the compression worse.
+  virtual int sync();
+  // Only supports tellp(), which returns the virtual offset described above.
+  virtual pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                           std::ios_base::openmode which);
+
+ private:
+  // Compresses the data in the put area as a frame and writes it.
+  bool WriteFrame();
+
+  std::streambuf *dest_;
+  int32 level_;
+  ZSTD_CCtx *cctx_;
+  std::vector<char> buffer_;
+  std::vector<char> compressed_;
+  int64 dest_pos_;  // The number of bytes written to dest_.
+  bool failed_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(ZstdOutputBuf);
+};
+
+/// A stream buffer that decompresses the data read from another stream buffer.
+class ZstdInputBuf: public std::streambuf {
+ public:
+  /// Reads from 'src', which is not owned and should be at its start.
+  explicit ZstdInputBuf(std::streambuf *src);
+
+  /// Seeks to a virtual offset, as returned by tellp() of the ZstdOutputBuf
+  /// that wrote the file.  Returns false on failure.  If the offset is later
+  /// in the frame that is being read, it just skips forward.
+  bool Seek(int64 pos);
+
+  ~ZstdInputBuf();
+
+ protected:
+  virtual int_type underflow();
+  // tellg() returns the virtual offset, or -1 inside frames that are longer
+  // than kZstdBlockSize (which files written by other programs may have).
+  virtual pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                           std::ios_base::openmode which);
+  virtual pos_type seekpos(pos_type pos, std::ios_base::openmode which);
+
+ private:
+  // Skips 'num_bytes' bytes of the data; returns false at the end of the data.
+  bool Skip(int64 num_bytes);
+
+  std::streambuf *src_;
+  ZSTD_DCtx *dctx_;
+  std::vector<char> in_;  // Compressed data read from src_.
+  size_t in_pos_;  // The part of in_ that has not been decompressed yet is
+  size_t in_size_;  // [in_pos_, in_size_).
+  int64 in_start_;  // The position of in_[0] in the file.
+  std::vector<char> out_;  // The get area is in here.
+  int64 frame_start_;  // The position in the file of the frame that the data
+                       // in the get area is from,
+  int64 frame_offset_;  // and the position in that frame's data of eback().
+  bool frame_done_;  // True if that frame ends at egptr().
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(ZstdInputBuf);
+};
+
+#endif  // HAVE_ZSTD
+
+}  // namespace kaldi
+
+#endif  // KALDI_UTIL_KALDI_ZSTDBUF_H_
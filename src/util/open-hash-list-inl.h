@@ -0,0 +1,211 @@
+// util/open-hash-list-inl.h
+
+// Copyright 2009-2011   Microsoft Corporation
+//                2013   Johns Hopkins University (author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_UTIL_OPEN_HASH_LIST_INL_H_
+#define KALDI_UTIL_OPEN_HASH_LIST_INL_H_
+
+// Do not include this file directly.  It is included by open-hash-list.h
+
+
+namespace kaldi {
+
+template<class I, class T> OpenHashList<I, T>::OpenHashList() {
+  list_head_ = NULL;
+  list_tail_ = NULL;
+  num_elems_ = 0;
+  hash_shift_ = 64;
+  generation_ = 1;
+  freed_head_ = NULL;
+}
+
+template<class I, class T>
+inline size_t OpenHashList<I, T>::HashIndex(I key) const {
+  // Fibonacci hashing: multiply by 2^64 / golden-ratio and take the top bits.
+  // This spreads out consecutive keys (such as FST state ids), which plain
+  // masking would put in consecutive slots, forming long probe runs.
+  return static_cast<size_t>((static_cast<uint64>(key) *
+                              static_cast<uint64>(11400714819323198485ULL))
+                             >> hash_shift_);
+}
+
+template<class I, class T> void OpenHashList<I, T>::SetSize(size_t size) {
+  KALDI_ASSERT(list_head_ == NULL && num_elems_ == 0);  // make sure empty.
+  size_t new_size = 16;
+  while (new_size < size) new_size *= 2;
+  if (new_size > slots_.size())
+    Rehash(new_size);
+}
+
+template<class I, class T> void OpenHashList<I, T>::Rehash(size_t size) {
+  KALDI_ASSERT(size > 0 && (size & (size - 1)) == 0);
+  int32 log_size = 0;
+  while ((static_cast<size_t>(1) << log_size) < size) log_size++;
+  HashSlot empty_slot;
+  empty_slot.key = I();
+  empty_slot.generation = 0;
+  empty_slot.elem = NULL;
+  slots_.assign(size, empty_slot);
+  hash_shift_ = 64 - log_size;
+  generation_ = 1;
+  size_t mask = size - 1;
+  for (Elem *e = list_head_; e != NULL; e = e->tail) {
+    size_t index = HashIndex(e->key);
+    while (slots_[index].generation == generation_) {
+      if (slots_[index].key == e->key) break;  // from InsertMore().
+      index = (index + 1) & mask;
+    }
+    if (slots_[index].generation != generation_) {
+      slots_[index].key = e->key;
+      slots_[index].generation = generation_;
+      slots_[index].elem = e;
+    }
+  }
+}
+
+template<class I, class T>
+typename OpenHashList<I, T>::Elem* OpenHashList<I, T>::Clear() {
+  // Clears the hashtable and gives ownership of the currently contained list
+  // to the user.
+  if (++generation_ == 0) {
+    // The generation counter wrapped around; we have to explicitly mark all the
+    // slots as empty, since some of them may have generation zero.
+    for (size_t i = 0; i < slots_.size(); i++)
+      slots_[i].generation = 0;
+    generation_ = 1;
+  }
+  num_elems_ = 0;
+  Elem *ans = list_head_;
+  list_head_ = NULL;
+  list_tail_ = NULL;
+  return ans;
+}
+
+template<class I, class T>
+const typename OpenHashList<I, T>::Elem* OpenHashList<I, T>::GetList() const {
+  return list_head_;
+}
+
+template<class I, class T>
+inline void OpenHashList<I, T>::Delete(Elem *e) {
+  e->tail = freed_head_;
+  freed_head_ = e;
+}
+
+template<class I, class T>
+inline typename OpenHashList<I, T>::Elem* OpenHashList<I, T>::Find(I key) {
+  size_t mask = slots_.size() - 1,
+      index = HashIndex(key);
+  while (true) {
+    const HashSlot &slot = slots_[index];
+    if (slot.generation != generation_)
+      return NULL;  // Reached an empty slot: not found.
+    if (slot.key == key)
+      return slot.elem;
+    index = (index + 1) & mask;
+  }
+}
+
+template<class I, class T>
+inline typename OpenHashList<I, T>::Elem* OpenHashList<I, T>::New() {
+  if (freed_head_) {
+    Elem *ans = freed_head_;
+    freed_head_ = freed_head_->tail;
+    return ans;
+  } else {
+    Elem *tmp = new Elem[allocate_block_size_];
+    for (size_t i = 0; i+1 < allocate_block_size_; i++)
+      tmp[i].tail = tmp+i+1;
+    tmp[allocate_block_size_-1].tail = NULL;
+    freed_head_ = tmp;
+    allocated_.push_back(tmp);
+    return this->New();
+  }
+}
+
+template<class I, class T>
+OpenHashList<I, T>::~OpenHashList() {
+  // First test whether we had any memory leak within the
+  // OpenHashList, i.e. things for which the user did not call Delete().
+  size_t num_in_list = 0, num_allocated = 0;
+  for (Elem *e = freed_head_; e != NULL; e = e->tail)
+    num_in_list++;
+  for (size_t i = 0; i < allocated_.size(); i++) {
+    num_allocated += allocate_block_size_;
+    delete[] allocated_[i];
+  }
+  if (num_in_list != num_allocated) {
+    KALDI_WARN << "Possible memory leak: " << num_in_list
+               << " != " << num_allocated
+               << ": you might have forgotten to call Delete on "
+               << "some Elems";
+  }
+}
+
+template<class I, class T>
+inline typename OpenHashList<I, T>::Elem* OpenHashList<I, T>::Insert(I key,
+                                                                     T val) {
+  KALDI_ASSERT(!slots_.empty() && "You must call SetSize() before Insert()");
+  size_t mask = slots_.size() - 1,
+      index = HashIndex(key);
+  while (slots_[index].generation == generation_) {
+    if (slots_[index].key == key)
+      return slots_[index].elem;  // Already present.
+    index = (index + 1) & mask;
+  }
+
+  // This is a new element.  Append it to the list.
+  Elem *elem = New();
+  elem->key = key;
+  elem->val = val;
+  elem->tail = NULL;
+  if (list_tail_ == NULL) list_head_ = elem;
+  else list_tail_->tail = elem;
+  list_tail_ = elem;
+
+  HashSlot &slot = slots_[index];
+  slot.key = key;
+  slot.generation = generation_;
+  slot.elem = elem;
+  num_elems_++;
+  // Keep the load factor at most 1/2, so probe sequences stay short.
+  if (2 * num_elems_ > slots_.size())
+    Rehash(2 * slots_.size());
+  return elem;
+}
+
+template<class I, class T>
+void OpenHashList<I, T>::InsertMore(I key, T val) {
+  Elem *e = Find(key);
+  KALDI_ASSERT(e != NULL);  // assume one element is already here
+  // Find the last of the elements with this key.
+  while (e->tail != NULL && e->tail->key == key) e = e->tail;
+  Elem *elem = New();
+  elem->key = key;
+  elem->val = val;
+  elem->tail = e->tail;
+  e->tail = elem;
+  if (list_tail_ == e) list_tail_ = elem;
+}
+
+
+}  // end namespace kaldi
+
+#endif  // KALDI_UTIL_OPEN_HASH_LIST_INL_H_
@@ -0,0 +1,148 @@
+// util/open-hash-list-test.cc
+
+// Copyright 2009-2011     Microsoft Corporation
+//                2013     Johns Hopkins University (author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "util/open-hash-list.h"
+#include <map>  // for baseline.
+#include <cstdlib>
+#include <iostream>
+
+namespace kaldi {
+
+template<class Int, class T> void TestOpenHashList() {
+  typedef typename OpenHashList<Int, T>::Elem Elem;
+
+  OpenHashList<Int, T> hash;
+  hash.SetSize(200);  // must be called before use.
+  std::map<Int, T> m1;
+  for (size_t j = 0; j < 50; j++) {
+    Int key = Rand() % 200;
+    T val = Rand() % 50;
+    m1[key] = val;
+    Elem *e = hash.Find(key);
+    if (e) e->val = val;
+    else  hash.Insert(key, val);
+  }
+
+
+  std::map<Int, T> m2;
+
+  for (int i = 0; i < 100; i++) {
+    m2.clear();
+    for (typename std::map<Int, T>::const_iterator iter = m1.begin();
+        iter != m1.end();
+        iter++) {
+      m2[iter->first + 1] = iter->second;
+    }
+    std::swap(m1, m2);
+
+    Elem *h = hash.Clear(), *tmp;
+
+    hash.SetSize(100 + Rand() % 100);  // note, SetSize is relatively cheap
+    // operation as long as we are not increasing the size more than it's ever
+    // previously been increased to.
+
+    for (; h != NULL; h = tmp) {
+      hash.Insert(h->key + 1, h->val);
+      tmp = h->tail;
+      hash.Delete(h);  // think of this like calling delete.
+    }
+
+    // Now make sure h and m2 are the same.
+    const Elem *list = hash.GetList();
+    size_t count = 0;
+    for (; list != NULL; list = list->tail, count++) {
+      KALDI_ASSERT(m1[list->key] == list->val);
+    }
+
+    for (size_t j = 0; j < 10; j++) {
+      Int key = Rand() % 200;
+      bool found_m1 = (m1.find(key) != m1.end());
+      if (found_m1) m1[key];
+      Elem *e = hash.Find(key);
+      KALDI_ASSERT((e != NULL) == found_m1);
+      if (found_m1)
+        KALDI_ASSERT(m1[key] == e->val);
+    }
+
+    KALDI_ASSERT(m1.size() == count);
+  }
+  for (Elem *h = hash.Clear(), *tmp; h != NULL; h = tmp) {
+    tmp = h->tail;
+    hash.Delete(h);
+  }
+}
+
+// Tests that the table grows correctly when we insert many more elements than
+// were given to SetSize(), and that InsertMore() keeps the elements with the
+// same key together.
+void TestOpenHashListGrowAndInsertMore() {
+  typedef OpenHashList<int32, int32>::Elem Elem;
+  OpenHashList<int32, int32> hash;
+  hash.SetSize(10);
+  int32 num_keys = 1000 + Rand() % 1000;
+  for (int32 i = 0; i < num_keys; i++)
+    KALDI_ASSERT(hash.Insert(3 * i, i)->val == i);
+  KALDI_ASSERT(hash.Size() >= 2 * num_keys);
+  for (int32 i = 0; i < num_keys; i++) {
+    // Inserting a key that is present should return the existing element.
+    KALDI_ASSERT(hash.Insert(3 * i, -1)->val == i);
+    KALDI_ASSERT(hash.Find(3 * i + 1) == NULL);
+    if (i % 10 == 0) hash.InsertMore(3 * i, i + 1);
+  }
+  int32 count = 0;
+  for (const Elem *e = hash.GetList(); e != NULL; e = e->tail, count++) {
+    if (e->key % 30 == 0) {
+      // the InsertMore()'d element comes directly after the original one.
+      KALDI_ASSERT(e->tail != NULL && e->tail->key == e->key &&
+                   e->tail->val == e->val + 1);
+      e = e->tail;
+      count++;
+    }
+  }
+  KALDI_ASSERT(count == num_keys + (num_keys + 9) / 10);
+
+  for (Elem *h = hash.Clear(), *tmp; h != NULL; h = tmp) {
+    tmp = h->tail;
+    hash.Delete(h);
+  }
+  KALDI_ASSERT(hash.GetList() == NULL && hash.Find(0) == NULL);
+}
+
+
+
+
+}  // end namespace kaldi
+
+
+
+int main() {
+  using namespace kaldi;
+  for (size_t i = 0;i < 3;i++) {
+    TestOpenHashList<int, unsigned int>();
+    TestOpenHashList<unsigned int, int>();
+    TestOpenHashList<int16, int32>();
+    TestOpenHashList<int16, int32>();
+    TestOpenHashList<char, unsigned char>();
+    TestOpenHashList<unsigned char, int>();
+    TestOpenHashListGrowAndInsertMore();
+  }
+  std::cout << "Test OK.\n";
+}
@@ -0,0 +1,156 @@
+// util/open-hash-list.h
+
+// Copyright 2009-2011   Microsoft Corporation
+//                2013   Johns Hopkins University (author: Daniel Povey)
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_UTIL_OPEN_HASH_LIST_H_
+#define KALDI_UTIL_OPEN_HASH_LIST_H_
+#include <vector>
+#include <limits>
+#include "util/stl-utils.h"
+
+
+/* This header provides OpenHashList, which has exactly the same interface and
+   semantics as HashList (see hash-list.h) and can be used as a drop-in
+   replacement for it, but which uses a different hash-table implementation.
+
+   HashList uses chained buckets whose chains are threaded through the list of
+   Elems itself, so a lookup follows Elem pointers.  OpenHashList instead keeps
+   an open-addressing table (power-of-two size, linear probing) of (key, Elem*)
+   pairs, so a lookup usually touches only one or two consecutive slots of a
+   contiguous array and never touches the Elems unless the key matches.  Each
+   slot also stores a "generation" number; Clear() just increments the current
+   generation, which makes all slots empty in constant time.  The table grows
+   automatically if it becomes more than half full, so the size given to
+   SetSize() is only a hint.
+
+   The list of Elems is kept in insertion order (except that InsertMore()
+   puts an element right after the existing elements with the same key).  Note
+   that this is a different order from what HashList would give, so code that
+   depends on the exact order of the list (e.g. the order in which a decoder
+   visits states, which can affect pruning) may give slightly different
+   results with the two types.
+
+   See open-hash-list-test.cc for an example of how to use this object, and
+   hash-list-speed-test.cc for a speed comparison with HashList.
+*/
+
+
+namespace kaldi {
+
+template<class I, class T> class OpenHashList {
+ public:
+  struct Elem {
+    I key;
+    T val;
+    Elem *tail;
+  };
+
+  /// Constructor takes no arguments.
+  /// Call SetSize to inform it of the likely size.
+  OpenHashList();
+
+  /// Clears the hash and gives the head of the current list to the user;
+  /// ownership is transferred to the user (the user must call Delete()
+  /// for each element in the list, at his/her leisure).
+  Elem *Clear();
+
+  /// Gives the head of the current list to the user.  Ownership retained in the
+  /// class.
+  const Elem *GetList() const;
+
+  /// Think of this like delete().  It is to be called for each Elem in turn
+  /// after you "obtained ownership" by doing Clear().  This is not the opposite
+  /// of. Insert, it is the opposite of New.  It's really a memory operation.
+  inline void Delete(Elem *e);
+
+  /// This should probably not be needed to be called directly by the user.
+  /// Think of it as opposite
+  /// to Delete();
+  inline Elem *New();
+
+  /// Find tries to find this element in the current list using the hashtable.
+  /// It returns NULL if not present.  The Elem it returns is not owned by the
+  /// user, it is part of the internal list owned by this object, but the user
+  /// is free to modify the "val" element.
+  inline Elem *Find(I key);
+
+  /// Insert inserts a new element into the hashtable/stored list.  If an
+  /// element with this key is already present, nothing is inserted and a
+  /// pointer to the existing element is returned.
+  inline Elem *Insert(I key, T val);
+
+  /// InsertMore inserts another element with same key into the hashtable/
+  /// stored list.  By calling this, the user asserts that one element with that
+  /// key is already present.  The new element is inserted after the existing
+  /// ones, so all elements with the same key follow each other.  Find() will
+  /// return the first one of the elements with the same key.
+  inline void InsertMore(I key, T val);
+
+  /// SetSize tells the object how many hash slots to allocate (this is rounded
+  /// up to a power of two; it should typically be at least twice the number of
+  /// objects we expect to go in the structure).  It must be called while the
+  /// hash is empty (e.g. after Clear() or after initializing the object, but
+  /// before adding anything to the hash).
+  void SetSize(size_t sz);
+
+  /// Returns current number of hash slots.
+  inline size_t Size() { return slots_.size(); }
+
+  ~OpenHashList();
+ private:
+  struct HashSlot {
+    I key;
+    uint32 generation;  // The slot is occupied only if this equals
+                        // generation_.
+    Elem *elem;  // The first Elem in the list with this key.
+  };
+
+  // Returns the slot that 'key' hashes to (before any probing).
+  inline size_t HashIndex(I key) const;
+
+  // Resizes the table to 'size' slots (must be a power of two) and re-inserts
+  // the Elems currently in the list.
+  void Rehash(size_t size);
+
+  Elem *list_head_;  // head of currently stored list.
+  Elem *list_tail_;  // tail of currently stored list; NULL if empty.
+  size_t num_elems_;  // number of distinct keys currently in the hash.
+
+  std::vector<HashSlot> slots_;  // The hash table; its size is zero or a power
+                                 // of two.
+  int32 hash_shift_;  // 64 minus log2 of slots_.size().
+  uint32 generation_;  // The current generation; see HashSlot::generation.
+
+  Elem *freed_head_;  // head of list of currently freed elements. [ready for
+  // allocation]
+
+  std::vector<Elem*> allocated_;  // list of allocated blocks.
+
+  static const size_t allocate_block_size_ = 1024;  // Number of Elements to
+  // allocate in one block.  Must be largish so storing allocated_ doesn't
+  // become a problem.
+};
+
+
+}  // end namespace kaldi
+
+#include "util/open-hash-list-inl.h"
+
+#endif  // KALDI_UTIL_OPEN_HASH_LIST_H_
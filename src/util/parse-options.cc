@@ -31,6 +31,7 @@
 
 #include "util/parse-options.h"
 #include "util/text-utils.h"
+#include "util/kaldi-metrics.h"
 #include "base/kaldi-common.h"
 
 namespace kaldi {
@@ -378,6 +379,11 @@ int ParseOptions::Read(int argc, const char *const argv[]) {
     }
   }
 
+  if (!trace_file_.empty())
+    Tracer::WriteAtExit(trace_file_);
+  if (!metrics_file_.empty())
+    MetricsRegistry::Global().WriteToFilePeriodically(metrics_file_, 10.0);
+
   // if the user did not suppress this with --print-args = false....
   if (print_args_) {
     std::ostringstream strm;
@@ -48,6 +48,14 @@ class ParseOptions : public OptionsItf {
     RegisterStandard("help", &help_, "Print out usage message");
     RegisterStandard("verbose", &g_kaldi_verbose_level,
                      "Verbose level (higher->more logging)");
+    RegisterStandard("trace-file", &trace_file_, "If set, record when things "
+                     "happen (see class Tracer in base/timer.h) and write it "
+                     "to this file at exit, in the Chrome trace-event JSON "
+                     "format that chrome://tracing and Perfetto can display");
+    RegisterStandard("metrics-file", &metrics_file_, "If set, write the "
+                     "metrics (see util/kaldi-metrics.h), e.g. real-time "
+                     "factors and latencies, to this file every 10 seconds "
+                     "and at exit, in the Prometheus text format");
   }
 
   /**
@@ -209,6 +217,8 @@ class ParseOptions : public OptionsItf {
   bool print_args_;     ///< variable for the implicit --print-args parameter
   bool help_;           ///< variable for the implicit --help parameter
   std::string config_;  ///< variable for the implicit --config parameter
+  std::string trace_file_;  ///< variable for the implicit --trace-file parameter
+  std::string metrics_file_;  ///< variable for the implicit --metrics-file parameter
   std::vector<std::string> positional_args_;
   const char *usage_;
   int argc_;
@@ -41,6 +41,8 @@ typedef RandomAccessTableReader<KaldiObjectHolder<Matrix<BaseFloat> > >
                                 RandomAccessBaseFloatMatrixReader;
 typedef RandomAccessTableReaderMapped<KaldiObjectHolder<Matrix<BaseFloat> > >
                                       RandomAccessBaseFloatMatrixReaderMapped;
+typedef SharedRandomAccessTableReader<KaldiObjectHolder<Matrix<BaseFloat> > >
+                                      SharedRandomAccessBaseFloatMatrixReader;
 
 typedef TableWriter<KaldiObjectHolder<Matrix<double> > >
                                       DoubleMatrixWriter;
@@ -62,6 +64,8 @@ typedef RandomAccessTableReader<KaldiObjectHolder<Vector<BaseFloat> > >
                                 RandomAccessBaseFloatVectorReader;
 typedef RandomAccessTableReaderMapped<KaldiObjectHolder<Vector<BaseFloat> > >
                                       RandomAccessBaseFloatVectorReaderMapped;
+typedef SharedRandomAccessTableReader<KaldiObjectHolder<Vector<BaseFloat> > >
+                                      SharedRandomAccessBaseFloatVectorReader;
 
 typedef TableWriter<KaldiObjectHolder<Vector<double> > >
                                       DoubleVectorWriter;
@@ -178,6 +182,24 @@ typedef RandomAccessTableReader<KaldiObjectHolder<GeneralMatrix> >
 typedef RandomAccessTableReaderMapped<KaldiObjectHolder<GeneralMatrix> >
                                       RandomAccessGeneralMatrixReaderMapped;
 
+/// These read and write a Matrix<BaseFloat> without parsing it if it does not
+/// need to be; see SerializedMatrix in matrix/serialized-matrix.h.
+typedef TableWriter<KaldiObjectHolder<SerializedMatrix> >
+                                      SerializedMatrixWriter;
+typedef SequentialTableReader<KaldiObjectHolder<SerializedMatrix> >
+                              SequentialSerializedMatrixReader;
+typedef RandomAccessTableReader<KaldiObjectHolder<SerializedMatrix> >
+                                RandomAccessSerializedMatrixReader;
+
+/// These write feature matrices with a header of their statistics, and read
+/// just the statistics; see matrix/matrix-stats.h.
+typedef TableWriter<KaldiObjectHolder<MatrixWithStats> >
+                                      MatrixWithStatsWriter;
+typedef SequentialTableReader<KaldiObjectHolder<MatrixStats> >
+                              SequentialMatrixStatsReader;
+typedef RandomAccessTableReader<KaldiObjectHolder<MatrixStats> >
+                                RandomAccessMatrixStatsReader;
+
 
 
 /// @}